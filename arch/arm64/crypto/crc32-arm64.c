@@ -25,6 +25,8 @@
 
 #include <crypto/internal/hash.h>
 
+#include <asm/pgtable.h>
+
 MODULE_AUTHOR("Yazen Ghannam <yazen.ghannam@linaro.org>");
 MODULE_DESCRIPTION("CRC32 and CRC32C using optional ARMv8 instructions");
 MODULE_LICENSE("GPL v2");
@@ -86,6 +88,96 @@ static u32 crc32c_arm64_le_hw(u32 crc, const u8 *p, unsigned int len)
 	return crc;
 }
 
+/*
+ * Each crc32 instruction depends on the result of the previous one, so the
+ * loops above run at the instruction latency rather than its throughput.
+ * Large buffers are split in three strides that are checksummed in one
+ * interleaved loop and folded together afterwards. The stride is picked so
+ * that one round covers a 4k metadata block short of its checksum field.
+ */
+#define CRC32_STRIDE		1360
+#define CRC32_NIBBLES		8
+
+/*
+ * shift_tbl[0] advances a crc over 2 strides of zeroes, shift_tbl[1] over
+ * one, a nibble at a time: tbl[n][i][v] is the shifted crc of v << 4 * i.
+ */
+static u32 crc32_shift_tbl[2][CRC32_NIBBLES][16];
+static u32 crc32c_shift_tbl[2][CRC32_NIBBLES][16];
+
+static u32 crc32_shift(const u32 (*tbl)[16], u32 crc)
+{
+	u32 ret = 0;
+	int i;
+
+	for (i = 0; i < CRC32_NIBBLES; i++, crc >>= 4)
+		ret ^= tbl[i][crc & 0xf];
+
+	return ret;
+}
+
+static __always_inline u32 crc32_arm64_le_3way(u32 crc, const u8 *p,
+					unsigned int len,
+					const u32 (*tbl)[CRC32_NIBBLES][16],
+					const bool c)
+{
+	while (len >= 3 * CRC32_STRIDE) {
+		const u8 *p1 = p + CRC32_STRIDE;
+		const u8 *p2 = p1 + CRC32_STRIDE;
+		u32 crc1 = 0, crc2 = 0;
+		unsigned int i;
+
+		for (i = 0; i < CRC32_STRIDE; i += sizeof(u64)) {
+			if (c) {
+				CRC32CX(crc, get_unaligned_le64(p + i));
+				CRC32CX(crc1, get_unaligned_le64(p1 + i));
+				CRC32CX(crc2, get_unaligned_le64(p2 + i));
+			} else {
+				CRC32X(crc, get_unaligned_le64(p + i));
+				CRC32X(crc1, get_unaligned_le64(p1 + i));
+				CRC32X(crc2, get_unaligned_le64(p2 + i));
+			}
+		}
+		crc = crc32_shift(tbl[0], crc) ^ crc32_shift(tbl[1], crc1) ^ crc2;
+		p += 3 * CRC32_STRIDE;
+		len -= 3 * CRC32_STRIDE;
+	}
+
+	return c ? crc32c_arm64_le_hw(crc, p, len) :
+		   crc32_arm64_le_hw(crc, p, len);
+}
+
+static u32 crc32_arm64_le(u32 crc, const u8 *p, unsigned int len)
+{
+	if (len >= 3 * CRC32_STRIDE)
+		return crc32_arm64_le_3way(crc, p, len, crc32_shift_tbl, false);
+	return crc32_arm64_le_hw(crc, p, len);
+}
+
+static u32 crc32c_arm64_le(u32 crc, const u8 *p, unsigned int len)
+{
+	if (len >= 3 * CRC32_STRIDE)
+		return crc32_arm64_le_3way(crc, p, len, crc32c_shift_tbl, true);
+	return crc32c_arm64_le_hw(crc, p, len);
+}
+
+/* the crc of zeroes with no pre/post inversion is linear in the seed */
+static void __init crc32_init_shift_tbl(u32 (*tbl)[CRC32_NIBBLES][16],
+			u32 (*fn)(u32 crc, const u8 *p, unsigned int len))
+{
+	const u8 *zero = (const u8 *)empty_zero_page;
+	int n, i, v;
+
+	BUILD_BUG_ON(2 * CRC32_STRIDE > PAGE_SIZE);
+	BUILD_BUG_ON(CRC32_STRIDE % sizeof(u64));
+
+	for (n = 0; n < 2; n++)
+		for (i = 0; i < CRC32_NIBBLES; i++)
+			for (v = 0; v < 16; v++)
+				tbl[n][i][v] = fn((u32)v << (4 * i), zero,
+						  (2 - n) * CRC32_STRIDE);
+}
+
 #define CHKSUM_BLOCK_SIZE	1
 #define CHKSUM_DIGEST_SIZE	4
 
@@ -130,7 +222,7 @@ static int chksum_update(struct shash_desc *desc, const u8 *data,
 {
 	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
 
-	ctx->crc = crc32_arm64_le_hw(ctx->crc, data, length);
+	ctx->crc = crc32_arm64_le(ctx->crc, data, length);
 	return 0;
 }
 
@@ -139,7 +231,7 @@ static int chksumc_update(struct shash_desc *desc, const u8 *data,
 {
 	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
 
-	ctx->crc = crc32c_arm64_le_hw(ctx->crc, data, length);
+	ctx->crc = crc32c_arm64_le(ctx->crc, data, length);
 	return 0;
 }
 
@@ -161,13 +253,13 @@ static int chksumc_final(struct shash_desc *desc, u8 *out)
 
 static int __chksum_finup(u32 crc, const u8 *data, unsigned int len, u8 *out)
 {
-	put_unaligned_le32(crc32_arm64_le_hw(crc, data, len), out);
+	put_unaligned_le32(crc32_arm64_le(crc, data, len), out);
 	return 0;
 }
 
 static int __chksumc_finup(u32 crc, const u8 *data, unsigned int len, u8 *out)
 {
-	put_unaligned_le32(~crc32c_arm64_le_hw(crc, data, len), out);
+	put_unaligned_le32(~crc32c_arm64_le(crc, data, len), out);
 	return 0;
 }
 
@@ -265,6 +357,9 @@ static int __init crc32_mod_init(void)
 {
 	int err;
 
+	crc32_init_shift_tbl(crc32_shift_tbl, crc32_arm64_le_hw);
+	crc32_init_shift_tbl(crc32c_shift_tbl, crc32c_arm64_le_hw);
+
 	err = crypto_register_shash(&crc32_alg);
 
 	if (err)
@@ -69,6 +69,7 @@
 #define ARM_CPU_PART_FOUNDATION	0xD00
 #define ARM_CPU_PART_CORTEX_A57	0xD07
 #define ARM_CPU_PART_CORTEX_A53	0xD03
+#define ARM_CPU_PART_CORTEX_A72	0xD08
 #define ARM_CPU_PART_CORTEX_ARTEMIS	0xD09
 
 #define APM_CPU_PART_POTENZA	0x000
@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2013 Huawei Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef __ASM_SIMD_H
+#define __ASM_SIMD_H
+
+#include <linux/hardirq.h>
+#include <linux/types.h>
+
+/*
+ * may_use_simd - whether it is allowable at this time to issue SIMD
+ *                instructions or access the SIMD register file
+ *
+ * kernel_neon_begin() preserves the interrupted register contents in
+ * softirq context as well, so small requests issued from softirq (IPsec,
+ * for instance) are handled in place instead of being deferred to cryptd.
+ * Hard interrupt context is left to cryptd: a full register save there
+ * costs more than the deferral.
+ */
+static __must_check inline bool may_use_simd(void)
+{
+	return !in_irq() && !in_nmi();
+}
+
+#endif
@@ -35,10 +35,24 @@ static inline void __tlb_remove_table(void *_table)
 
 #include <asm-generic/tlb.h>
 
+#ifdef CONFIG_TLB_CONFLICT_WORKAROUND
+DECLARE_PER_CPU(unsigned long, tlbi_saved);
+#define count_tlbi_saved()	this_cpu_inc(tlbi_saved)
+#else
+#define count_tlbi_saved()	do { } while (0)
+#endif
+
+/*
+ * When the whole address space is torn down (fullmm), the mm is dead and
+ * the ASID allocator invalidates its ASID before handing it out again, so
+ * the final flush is not needed.  The walk cache flushes for freed tables
+ * are still issued: the pgd stays live in TTBR0 until the task switches
+ * away and the tables may be reused before then.
+ */
 static inline void tlb_flush(struct mmu_gather *tlb)
 {
 	if (tlb->fullmm) {
-		flush_tlb_mm(tlb->mm);
+		count_tlbi_saved();
 	} else {
 		struct vm_area_struct vma = { .vm_mm = tlb->mm, };
 		flush_tlb_range(&vma, tlb->start, tlb->end);
@@ -34,8 +34,24 @@ struct vdso_data {
 	__u32 tz_minuteswest;	/* Whacky timezone stuff */
 	__u32 tz_dsttime;
 	__u32 use_syscall;
+	/*
+	 * Always-on system counter to boottime, for timestamps taken by
+	 * sensors and audio: boot = syscnt_boot + ((s64)(cnt - syscnt_cycle_last)
+	 * * syscnt_mult >> syscnt_shift). syscnt_mult is 0 without a counter.
+	 */
+	__u32 syscnt_seq_count;	/* Syscounter sequence counter */
+	__u32 syscnt_mult;
+	__u32 syscnt_shift;
+	__u32 syscnt_rsvd;
+	__u64 syscnt_cycle_last;
+	__u64 syscnt_boot_sec;
+	__u64 syscnt_boot_nsec;
 };
 
+struct timespec64;
+void update_vsyscall_syscnt(u64 cycle_last, const struct timespec64 *boot,
+			    u32 mult, u32 shift);
+
 #endif /* !__ASSEMBLY__ */
 
 #endif /* __KERNEL__ */
@@ -98,6 +98,12 @@ int main(void)
   DEFINE(VDSO_TZ_MINWEST,	offsetof(struct vdso_data, tz_minuteswest));
   DEFINE(VDSO_TZ_DSTTIME,	offsetof(struct vdso_data, tz_dsttime));
   DEFINE(VDSO_USE_SYSCALL,	offsetof(struct vdso_data, use_syscall));
+  DEFINE(VDSO_SYSCNT_SEQ_COUNT,	offsetof(struct vdso_data, syscnt_seq_count));
+  DEFINE(VDSO_SYSCNT_MULT,	offsetof(struct vdso_data, syscnt_mult));
+  DEFINE(VDSO_SYSCNT_SHIFT,	offsetof(struct vdso_data, syscnt_shift));
+  DEFINE(VDSO_SYSCNT_CYCLE_LAST,offsetof(struct vdso_data, syscnt_cycle_last));
+  DEFINE(VDSO_SYSCNT_BOOT_SEC,	offsetof(struct vdso_data, syscnt_boot_sec));
+  DEFINE(VDSO_SYSCNT_BOOT_NSEC,	offsetof(struct vdso_data, syscnt_boot_nsec));
   BLANK();
   DEFINE(TVAL_TV_SEC,		offsetof(struct timeval, tv_sec));
   DEFINE(TVAL_TV_USEC,		offsetof(struct timeval, tv_usec));
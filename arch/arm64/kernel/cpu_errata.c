@@ -23,6 +23,9 @@
 
 #define MIDR_CORTEX_A53 MIDR_CPU_PART(ARM_CPU_IMP_ARM, ARM_CPU_PART_CORTEX_A53)
 #define MIDR_CORTEX_A57 MIDR_CPU_PART(ARM_CPU_IMP_ARM, ARM_CPU_PART_CORTEX_A57)
+#define MIDR_CORTEX_A72 MIDR_CPU_PART(ARM_CPU_IMP_ARM, ARM_CPU_PART_CORTEX_A72)
+#define MIDR_CORTEX_A73 MIDR_CPU_PART(ARM_CPU_IMP_ARM, ARM_CPU_PART_CORTEX_ARTEMIS)
+#define MIDR_ALL_REVISIONS	(MIDR_VARIANT_MASK | MIDR_REVISION_MASK)
 
 #define CPU_MODEL_MASK (MIDR_IMPLEMENTOR_MASK | MIDR_PARTNUM_MASK | \
 			MIDR_ARCHITECTURE_MASK)
@@ -95,7 +98,37 @@ const struct arm64_cpu_capabilities arm64_errata[] = {
 	}
 };
 
+/*
+ * Prefetch distance of the memcpy/copy_*_user loops. Text is shared by
+ * all cpus, so a system with any Cortex-A53 gets the little core schedule.
+ */
+static const struct arm64_cpu_capabilities arm64_copy_tunes[] = {
+	{
+		.desc = "Cortex-A57",
+		.capability = ARM64_COPY_TUNE_BIG,
+		MIDR_RANGE(MIDR_CORTEX_A57, 0x00, MIDR_ALL_REVISIONS),
+	},
+	{
+		.desc = "Cortex-A72",
+		.capability = ARM64_COPY_TUNE_BIG,
+		MIDR_RANGE(MIDR_CORTEX_A72, 0x00, MIDR_ALL_REVISIONS),
+	},
+	{
+		.desc = "Cortex-A73",
+		.capability = ARM64_COPY_TUNE_BIG,
+		MIDR_RANGE(MIDR_CORTEX_A73, 0x00, MIDR_ALL_REVISIONS),
+	},
+	{
+		.desc = "Cortex-A53",
+		.capability = ARM64_COPY_TUNE_LITTLE,
+		MIDR_RANGE(MIDR_CORTEX_A53, 0x00, MIDR_ALL_REVISIONS),
+	},
+	{
+	}
+};
+
 void check_local_cpu_errata(void)
 {
 	check_cpu_capabilities(arm64_errata, "enabling workaround for");
+	check_cpu_capabilities(arm64_copy_tunes, "tuning copies for");
 }
@@ -223,16 +223,32 @@ void fpsimd_flush_task_state(struct task_struct *t)
 static DEFINE_PER_CPU(struct fpsimd_partial_state, hardirq_fpsimdstate);
 static DEFINE_PER_CPU(struct fpsimd_partial_state, softirq_fpsimdstate);
 
+/* open NEON sections per interrupt context, see kernel_neon_begin_partial() */
+static DEFINE_PER_CPU(unsigned int, hardirq_neon_depth);
+static DEFINE_PER_CPU(unsigned int, softirq_neon_depth);
+
 /*
  * Kernel-side NEON support functions
+ *
+ * Sections nest. In interrupt context only the outermost one saves and
+ * restores the registers, so a caller handling a batch of small requests
+ * (e.g. packets in softirq) can open one section around the whole batch and
+ * the per-request sections inside it cost nothing. The outer section must
+ * claim at least as many registers as any section inside it.
  */
 void kernel_neon_begin_partial(u32 num_regs)
 {
 	if (in_interrupt()) {
 		struct fpsimd_partial_state *s = this_cpu_ptr(
 			in_irq() ? &hardirq_fpsimdstate : &softirq_fpsimdstate);
+		unsigned int *depth = this_cpu_ptr(
+			in_irq() ? &hardirq_neon_depth : &softirq_neon_depth);
 
 		BUG_ON(num_regs > 32);
+		if ((*depth)++) {
+			BUG_ON(roundup(num_regs, 2) > s->num_regs);
+			return;
+		}
 		fpsimd_save_partial_state(s, roundup(num_regs, 2));
 	} else {
 		/*
@@ -255,6 +271,11 @@ void kernel_neon_end(void)
 	if (in_interrupt()) {
 		struct fpsimd_partial_state *s = this_cpu_ptr(
 			in_irq() ? &hardirq_fpsimdstate : &softirq_fpsimdstate);
+		unsigned int *depth = this_cpu_ptr(
+			in_irq() ? &hardirq_neon_depth : &softirq_neon_depth);
+
+		if (--(*depth))
+			return;
 		fpsimd_load_partial_state(s);
 	} else {
 		preempt_enable();
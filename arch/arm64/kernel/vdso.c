@@ -224,6 +224,26 @@ void update_vsyscall(struct timekeeper *tk)
 	++vdso_data->tb_seq_count;
 }
 
+/*
+ * Update the system counter conversion, called by the platform driver of
+ * the always-on counter whenever it takes a new reference point.
+ */
+void update_vsyscall_syscnt(u64 cycle_last, const struct timespec64 *boot,
+			    u32 mult, u32 shift)
+{
+	++vdso_data->syscnt_seq_count;
+	smp_wmb();
+
+	vdso_data->syscnt_cycle_last		= cycle_last;
+	vdso_data->syscnt_boot_sec		= boot->tv_sec;
+	vdso_data->syscnt_boot_nsec		= boot->tv_nsec;
+	vdso_data->syscnt_mult			= mult;
+	vdso_data->syscnt_shift			= shift;
+
+	smp_wmb();
+	++vdso_data->syscnt_seq_count;
+}
+
 void update_vsyscall_tz(void)
 {
 	vdso_data->tz_minuteswest	= sys_tz.tz_minuteswest;
@@ -0,0 +1,610 @@
+/*
+ * Block device benchmark harness
+ *
+ * Copyright (c) 2016 Huawei Technologies Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Unlike test-iosched, which needs its elevator selected on a request
+ * based queue, the benchmark submits bios straight to the block device,
+ * so the same workload runs on UFS, eMMC CMDQ and bio based devices such
+ * as zram. The workload is configured through the files of the
+ * blk-bench debugfs directory:
+ *
+ *   device		path of the block device, opened exclusively
+ *   read_pct		share of reads, the rest are writes
+ *   rand_pct		share of random offsets, the rest are sequential
+ *   qdepth		bios kept in flight
+ *   bs_kb		size of every bio
+ *   flush_pct		share of writes with a preflush
+ *   fua_pct		share of writes with FUA
+ *   fsync_threads	threads issuing cache flushes next to the workload
+ *   fsync_interval_ms	pause between the flushes of one thread
+ *   offset_mb/range_mb	region of the device used, 0 range is all of it
+ *   runtime_ms		length of the run
+ *
+ * Writing 1 to "run" runs the workload and blocks until it completes.
+ * THE WRITES DESTROY THE DATA in the region. "result" then holds one
+ * key=value per line: the configuration, then IOPS, bandwidth and
+ * latency percentiles in us for reads, writes and flushes. Latencies are
+ * kept in log buckets of 1/8th of a power of two.
+ */
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt"\n"
+
+#include <linux/blkdev.h>
+#include <linux/bio.h>
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/kthread.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+
+#define MODULE_NAME		"blk-bench"
+#define BENCH_PATH_LEN		64
+#define BENCH_MAX_QDEPTH	64
+#define BENCH_MAX_BS_KB		512
+#define BENCH_MAX_FSYNC_THREADS	8
+#define BENCH_LAT_SUB_BITS	3
+#define BENCH_LAT_SUB		(1 << BENCH_LAT_SUB_BITS)
+#define BENCH_LAT_BUCKETS	(2 * BENCH_LAT_SUB + 28 * BENCH_LAT_SUB)
+
+enum bench_dir {
+	BENCH_READ,
+	BENCH_WRITE,
+	BENCH_FLUSH,
+	BENCH_DIRS,
+};
+
+static const char * const bench_dir_names[BENCH_DIRS] = {
+	"read", "write", "flush",
+};
+
+struct bench_stat {
+	u64 ios;
+	u64 bytes;
+	u64 lat_max;
+	u32 hist[BENCH_LAT_BUCKETS];
+};
+
+struct bench_io {
+	struct blk_bench *bb;
+	struct list_head list;
+	struct page *pages;
+	enum bench_dir dir;
+	ktime_t start;
+};
+
+struct bench_config {
+	u32 read_pct;
+	u32 rand_pct;
+	u32 qdepth;
+	u32 bs_kb;
+	u32 flush_pct;
+	u32 fua_pct;
+	u32 fsync_threads;
+	u32 fsync_interval_ms;
+	u32 offset_mb;
+	u32 range_mb;
+	u32 runtime_ms;
+};
+
+struct blk_bench {
+	struct mutex lock;	/* held for a whole run and by the readers */
+	struct dentry *root;
+	char path[BENCH_PATH_LEN];
+	/* the debugfs knobs, they can change at any time */
+	struct bench_config cfg;
+
+	/* state of the current run */
+	struct bench_config run;	/* cfg as the run started with it */
+	struct block_device *bdev;
+	struct rnd_state rnd;
+	sector_t first;
+	sector_t nr_blocks;
+	sector_t next_block;
+	spinlock_t io_lock;
+	struct list_head free_ios;
+	atomic_t inflight;
+	wait_queue_head_t wait;
+
+	/* results, protected by io_lock while running */
+	struct bench_stat stat[BENCH_DIRS];
+	u32 errors;
+	u64 elapsed_us;
+	bool valid;
+};
+
+static struct blk_bench bench = {
+	.lock = __MUTEX_INITIALIZER(bench.lock),
+	.io_lock = __SPIN_LOCK_UNLOCKED(bench.io_lock),
+	.wait = __WAIT_QUEUE_HEAD_INITIALIZER(bench.wait),
+	.cfg = {
+		.read_pct = 70,
+		.rand_pct = 100,
+		.qdepth = 32,
+		.bs_kb = 4,
+		.fsync_interval_ms = 100,
+		.runtime_ms = 10000,
+	},
+};
+
+static unsigned int lat_bucket(u64 us)
+{
+	unsigned int msb;
+
+	if (us < 2 * BENCH_LAT_SUB)
+		return us;
+	msb = fls64(us) - 1;
+	return min_t(unsigned int, BENCH_LAT_BUCKETS - 1,
+		     (msb - BENCH_LAT_SUB_BITS + 1) * BENCH_LAT_SUB +
+		     ((us >> (msb - BENCH_LAT_SUB_BITS)) & (BENCH_LAT_SUB - 1)));
+}
+
+/* lower bound in us of a bucket */
+static u64 lat_bucket_us(unsigned int idx)
+{
+	unsigned int shift;
+
+	if (idx < 2 * BENCH_LAT_SUB)
+		return idx;
+	shift = idx / BENCH_LAT_SUB - 1;
+	return (u64)(BENCH_LAT_SUB + idx % BENCH_LAT_SUB) << shift;
+}
+
+static void bench_account(struct blk_bench *bb, enum bench_dir dir,
+			  ktime_t start, unsigned int bytes, int err)
+{
+	struct bench_stat *st = &bb->stat[dir];
+	u64 us = ktime_us_delta(ktime_get(), start);
+	unsigned long flags;
+
+	spin_lock_irqsave(&bb->io_lock, flags);
+	if (err) {
+		bb->errors++;
+	} else {
+		st->ios++;
+		st->bytes += bytes;
+		st->hist[lat_bucket(us)]++;
+		if (us > st->lat_max)
+			st->lat_max = us;
+	}
+	spin_unlock_irqrestore(&bb->io_lock, flags);
+}
+
+static void bench_end_io(struct bio *bio, int err)
+{
+	struct bench_io *io = bio->bi_private;
+	struct blk_bench *bb = io->bb;
+	unsigned long flags;
+
+	bench_account(bb, io->dir, io->start, bb->run.bs_kb << 10, err);
+	bio_put(bio);
+
+	spin_lock_irqsave(&bb->io_lock, flags);
+	list_add(&io->list, &bb->free_ios);
+	spin_unlock_irqrestore(&bb->io_lock, flags);
+	atomic_dec(&bb->inflight);
+	wake_up(&bb->wait);
+}
+
+static struct bench_io *bench_get_io(struct blk_bench *bb)
+{
+	struct bench_io *io = NULL;
+
+	spin_lock_irq(&bb->io_lock);
+	if (!list_empty(&bb->free_ios)) {
+		io = list_first_entry(&bb->free_ios, struct bench_io, list);
+		list_del(&io->list);
+	}
+	spin_unlock_irq(&bb->io_lock);
+
+	return io;
+}
+
+static bool bench_pct(struct blk_bench *bb, u32 pct)
+{
+	return prandom_u32_state(&bb->rnd) % 100 < pct;
+}
+
+static int bench_submit(struct blk_bench *bb, struct bench_io *io)
+{
+	unsigned int nr_pages = (bb->run.bs_kb << 10) >> PAGE_SHIFT;
+	sector_t block;
+	struct bio *bio;
+	int rw, i;
+
+	bio = bio_alloc(GFP_KERNEL, nr_pages);
+	if (!bio)
+		return -ENOMEM;
+
+	if (bench_pct(bb, bb->run.rand_pct)) {
+		block = prandom_u32_state(&bb->rnd) % bb->nr_blocks;
+	} else {
+		block = bb->next_block;
+		bb->next_block = (block + 1) % bb->nr_blocks;
+	}
+
+	bio->bi_bdev = bb->bdev;
+	bio->bi_iter.bi_sector = bb->first + block * (bb->run.bs_kb << 1);
+	bio->bi_end_io = bench_end_io;
+	bio->bi_private = io;
+	for (i = 0; i < nr_pages; i++) {
+		if (!bio_add_page(bio, nth_page(io->pages, i), PAGE_SIZE, 0)) {
+			bio_put(bio);
+			return -EINVAL;
+		}
+	}
+
+	if (bench_pct(bb, bb->run.read_pct)) {
+		io->dir = BENCH_READ;
+		rw = READ;
+	} else {
+		io->dir = BENCH_WRITE;
+		rw = WRITE;
+		if (bench_pct(bb, bb->run.flush_pct))
+			rw |= REQ_FLUSH;
+		if (bench_pct(bb, bb->run.fua_pct))
+			rw |= REQ_FUA;
+	}
+
+	atomic_inc(&bb->inflight);
+	io->start = ktime_get();
+	submit_bio(rw, bio);
+	return 0;
+}
+
+static int bench_fsync_thread(void *data)
+{
+	struct blk_bench *bb = data;
+	ktime_t start;
+	int err;
+
+	while (!kthread_should_stop()) {
+		start = ktime_get();
+		err = blkdev_issue_flush(bb->bdev, GFP_KERNEL, NULL);
+		bench_account(bb, BENCH_FLUSH, start, 0, err);
+		if (bb->run.fsync_interval_ms)
+			msleep_interruptible(bb->run.fsync_interval_ms);
+	}
+
+	return 0;
+}
+
+static void bench_free_ios(struct bench_io *ios, u32 nr, unsigned int order)
+{
+	u32 i;
+
+	for (i = 0; i < nr; i++)
+		if (ios[i].pages)
+			__free_pages(ios[i].pages, order);
+	kfree(ios);
+}
+
+static int bench_check_config(struct blk_bench *bb)
+{
+	if (bb->run.read_pct > 100 || bb->run.rand_pct > 100 ||
+	    bb->run.flush_pct > 100 || bb->run.fua_pct > 100)
+		return -EINVAL;
+	if (!bb->run.qdepth || bb->run.qdepth > BENCH_MAX_QDEPTH)
+		return -EINVAL;
+	if (!bb->run.bs_kb || bb->run.bs_kb > BENCH_MAX_BS_KB ||
+	    !is_power_of_2(bb->run.bs_kb) || (bb->run.bs_kb << 10) < PAGE_SIZE)
+		return -EINVAL;
+	if (bb->run.fsync_threads > BENCH_MAX_FSYNC_THREADS ||
+	    !bb->run.runtime_ms)
+		return -EINVAL;
+	return 0;
+}
+
+static int bench_run(struct blk_bench *bb)
+{
+	struct task_struct *fsync_tasks[BENCH_MAX_FSYNC_THREADS];
+	unsigned int order;
+	struct bench_io *ios;
+	sector_t capacity, range;
+	unsigned long deadline;
+	ktime_t start;
+	u32 i, nr_tasks = 0;
+	int ret;
+
+	/* the pages and bios are sized from it, it must not change */
+	bb->run = bb->cfg;
+	ret = bench_check_config(bb);
+	if (ret)
+		return ret;
+
+	bb->bdev = blkdev_get_by_path(bb->path, FMODE_READ | FMODE_WRITE |
+				      FMODE_EXCL, bb);
+	if (IS_ERR(bb->bdev)) {
+		ret = PTR_ERR(bb->bdev);
+		pr_err("%s: cannot open %s: %d", __func__, bb->path, ret);
+		bb->bdev = NULL;
+		return ret;
+	}
+
+	capacity = i_size_read(bb->bdev->bd_inode) >> 9;
+	bb->first = (sector_t)bb->run.offset_mb << 11;
+	range = bb->run.range_mb ? (sector_t)bb->run.range_mb << 11 : capacity;
+	if (bb->first >= capacity) {
+		ret = -EINVAL;
+		goto out_put;
+	}
+	range = min(range, capacity - bb->first);
+	bb->nr_blocks = range / (bb->run.bs_kb << 1);
+	if (!bb->nr_blocks) {
+		ret = -EINVAL;
+		goto out_put;
+	}
+
+	order = get_order(bb->run.bs_kb << 10);
+	ios = kcalloc(bb->run.qdepth, sizeof(*ios), GFP_KERNEL);
+	if (!ios) {
+		ret = -ENOMEM;
+		goto out_put;
+	}
+	INIT_LIST_HEAD(&bb->free_ios);
+	for (i = 0; i < bb->run.qdepth; i++) {
+		ios[i].bb = bb;
+		ios[i].pages = alloc_pages(GFP_KERNEL, order);
+		if (!ios[i].pages) {
+			ret = -ENOMEM;
+			goto out_free;
+		}
+		/* incompressible, zram would store zero pages for free */
+		prandom_bytes(page_address(ios[i].pages), bb->run.bs_kb << 10);
+		list_add_tail(&ios[i].list, &bb->free_ios);
+	}
+
+	memset(bb->stat, 0, sizeof(bb->stat));
+	bb->errors = 0;
+	bb->next_block = 0;
+	prandom_seed_state(&bb->rnd, get_random_int());
+
+	start = ktime_get();
+	for (i = 0; i < bb->run.fsync_threads; i++) {
+		fsync_tasks[nr_tasks] = kthread_run(bench_fsync_thread, bb,
+						    "blk_bench_fsync/%u", i);
+		if (IS_ERR(fsync_tasks[nr_tasks]))
+			break;
+		nr_tasks++;
+	}
+
+	deadline = jiffies + msecs_to_jiffies(bb->run.runtime_ms);
+	while (time_before(jiffies, deadline) && !signal_pending(current)) {
+		struct bench_io *io;
+
+		wait_event(bb->wait, (io = bench_get_io(bb)) != NULL);
+		ret = bench_submit(bb, io);
+		if (ret) {
+			spin_lock_irq(&bb->io_lock);
+			list_add(&io->list, &bb->free_ios);
+			spin_unlock_irq(&bb->io_lock);
+			break;
+		}
+	}
+
+	for (i = 0; i < nr_tasks; i++)
+		kthread_stop(fsync_tasks[i]);
+	wait_event(bb->wait, !atomic_read(&bb->inflight));
+	bb->elapsed_us = ktime_us_delta(ktime_get(), start);
+	bb->valid = !ret;
+
+out_free:
+	bench_free_ios(ios, bb->run.qdepth, order);
+out_put:
+	blkdev_put(bb->bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	bb->bdev = NULL;
+	return ret;
+}
+
+static u64 bench_percentile(struct bench_stat *st, u32 permille)
+{
+	u64 want = div_u64(st->ios * permille + 999, 1000);
+	u64 seen = 0;
+	unsigned int i;
+
+	for (i = 0; i < BENCH_LAT_BUCKETS; i++) {
+		seen += st->hist[i];
+		if (seen >= want)
+			return lat_bucket_us(i);
+	}
+	return st->lat_max;
+}
+
+static int bench_result_show(struct seq_file *s, void *data)
+{
+	struct blk_bench *bb = s->private;
+	int dir;
+
+	mutex_lock(&bb->lock);
+	if (!bb->valid) {
+		seq_puts(s, "valid=0\n");
+		goto out;
+	}
+
+	seq_printf(s, "valid=1\ndevice=%s\n", bb->path);
+	seq_printf(s, "read_pct=%u\nrand_pct=%u\nqdepth=%u\nbs_kb=%u\n",
+		   bb->run.read_pct, bb->run.rand_pct, bb->run.qdepth,
+		   bb->run.bs_kb);
+	seq_printf(s, "flush_pct=%u\nfua_pct=%u\nfsync_threads=%u\n",
+		   bb->run.flush_pct, bb->run.fua_pct, bb->run.fsync_threads);
+	seq_printf(s, "fsync_interval_ms=%u\noffset_mb=%u\nrange_mb=%u\n",
+		   bb->run.fsync_interval_ms, bb->run.offset_mb, bb->run.range_mb);
+	seq_printf(s, "elapsed_us=%llu\nerrors=%u\n", bb->elapsed_us,
+		   bb->errors);
+
+	for (dir = 0; dir < BENCH_DIRS; dir++) {
+		struct bench_stat *st = &bb->stat[dir];
+		const char *name = bench_dir_names[dir];
+		u64 us = max_t(u64, bb->elapsed_us, 1);
+
+		seq_printf(s, "%s_ios=%llu\n", name, st->ios);
+		seq_printf(s, "%s_iops=%llu\n", name,
+			   div64_u64(st->ios * USEC_PER_SEC, us));
+		seq_printf(s, "%s_kbps=%llu\n", name,
+			   div64_u64(st->bytes * USEC_PER_SEC, us) >> 10);
+		if (!st->ios)
+			continue;
+		seq_printf(s, "%s_lat_p50_us=%llu\n", name,
+			   bench_percentile(st, 500));
+		seq_printf(s, "%s_lat_p90_us=%llu\n", name,
+			   bench_percentile(st, 900));
+		seq_printf(s, "%s_lat_p99_us=%llu\n", name,
+			   bench_percentile(st, 990));
+		seq_printf(s, "%s_lat_p999_us=%llu\n", name,
+			   bench_percentile(st, 999));
+		seq_printf(s, "%s_lat_max_us=%llu\n", name, st->lat_max);
+	}
+out:
+	mutex_unlock(&bb->lock);
+	return 0;
+}
+
+static int bench_result_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bench_result_show, inode->i_private);
+}
+
+static const struct file_operations bench_result_fops = {
+	.open = bench_result_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static ssize_t bench_run_write(struct file *file, const char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	struct blk_bench *bb = file->private_data;
+	unsigned long val;
+	int ret;
+
+	ret = kstrtoul_from_user(buf, count, 0, &val);
+	if (ret)
+		return ret;
+	if (val != 1)
+		return -EINVAL;
+
+	mutex_lock(&bb->lock);
+	bb->valid = false;
+	ret = bench_run(bb);
+	mutex_unlock(&bb->lock);
+	if (ret) {
+		pr_err("%s: run failed: %d", __func__, ret);
+		return ret;
+	}
+
+	return count;
+}
+
+static const struct file_operations bench_run_fops = {
+	.open = simple_open,
+	.write = bench_run_write,
+};
+
+static int bench_device_show(struct seq_file *s, void *data)
+{
+	struct blk_bench *bb = s->private;
+
+	mutex_lock(&bb->lock);
+	seq_printf(s, "%s\n", bb->path);
+	mutex_unlock(&bb->lock);
+	return 0;
+}
+
+static int bench_device_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bench_device_show, inode->i_private);
+}
+
+static ssize_t bench_device_write(struct file *file, const char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	struct blk_bench *bb = file_inode(file)->i_private;
+	char path[BENCH_PATH_LEN];
+
+	if (!count || count >= BENCH_PATH_LEN)
+		return -EINVAL;
+	if (copy_from_user(path, buf, count))
+		return -EFAULT;
+	path[count] = '\0';
+
+	mutex_lock(&bb->lock);
+	strlcpy(bb->path, strim(path), BENCH_PATH_LEN);
+	mutex_unlock(&bb->lock);
+
+	return count;
+}
+
+static const struct file_operations bench_device_fops = {
+	.open = bench_device_open,
+	.read = seq_read,
+	.write = bench_device_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init blk_bench_init(void)
+{
+	struct blk_bench *bb = &bench;
+	struct dentry *root;
+
+	root = debugfs_create_dir(MODULE_NAME, NULL);
+	if (IS_ERR_OR_NULL(root))
+		return -ENOMEM;
+	bb->root = root;
+
+	if (!debugfs_create_file("device", S_IRUSR | S_IWUSR, root, bb,
+				 &bench_device_fops) ||
+	    !debugfs_create_file("run", S_IWUSR, root, bb, &bench_run_fops) ||
+	    !debugfs_create_file("result", S_IRUSR, root, bb,
+				 &bench_result_fops) ||
+	    !debugfs_create_u32("read_pct", S_IRUSR | S_IWUSR, root,
+				&bb->cfg.read_pct) ||
+	    !debugfs_create_u32("rand_pct", S_IRUSR | S_IWUSR, root,
+				&bb->cfg.rand_pct) ||
+	    !debugfs_create_u32("qdepth", S_IRUSR | S_IWUSR, root,
+				&bb->cfg.qdepth) ||
+	    !debugfs_create_u32("bs_kb", S_IRUSR | S_IWUSR, root,
+				&bb->cfg.bs_kb) ||
+	    !debugfs_create_u32("flush_pct", S_IRUSR | S_IWUSR, root,
+				&bb->cfg.flush_pct) ||
+	    !debugfs_create_u32("fua_pct", S_IRUSR | S_IWUSR, root,
+				&bb->cfg.fua_pct) ||
+	    !debugfs_create_u32("fsync_threads", S_IRUSR | S_IWUSR, root,
+				&bb->cfg.fsync_threads) ||
+	    !debugfs_create_u32("fsync_interval_ms", S_IRUSR | S_IWUSR, root,
+				&bb->cfg.fsync_interval_ms) ||
+	    !debugfs_create_u32("offset_mb", S_IRUSR | S_IWUSR, root,
+				&bb->cfg.offset_mb) ||
+	    !debugfs_create_u32("range_mb", S_IRUSR | S_IWUSR, root,
+				&bb->cfg.range_mb) ||
+	    !debugfs_create_u32("runtime_ms", S_IRUSR | S_IWUSR, root,
+				&bb->cfg.runtime_ms)) {
+		debugfs_remove_recursive(root);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static void __exit blk_bench_exit(void)
+{
+	debugfs_remove_recursive(bench.root);
+}
+
+module_init(blk_bench_init);
+module_exit(blk_bench_exit);
+
+MODULE_LICENSE("GPL v2");
+MODULE_DESCRIPTION("Block device benchmark harness");
@@ -40,6 +40,7 @@
 
 #include "blk.h"
 #include "blk-mq.h"
+#include "blk-ra.h"
 
 #include "hisi-blk-mq-dispatch-strategy.h"
 #include "hisi-blk-mq-debug.h"
@@ -1406,10 +1407,11 @@ static void part_round_stats_single(int cpu, struct hd_struct *part,
 				inflight * (now - part->stamp));
 		__part_stat_add(cpu, part, io_ticks, (now - part->stamp));
 #ifdef CONFIG_HISI_BLOCK_FREQUENCE_CONTROL
-		hisi_blk_freq_request(FREQ_REQ_ADD,
+		hisi_blk_freq_request(part_to_disk(part), FREQ_REQ_ADD,
 				inflight * (now - part->stamp));
 	}else{
-		hisi_blk_freq_request(FREQ_REQ_REMOVE, (now - part->stamp));
+		hisi_blk_freq_request(part_to_disk(part), FREQ_REQ_REMOVE,
+				(now - part->stamp));
 #endif
 	}
 	part->stamp = now;
@@ -2661,9 +2663,15 @@ bool blk_update_request(struct request *req, int error, unsigned int nr_bytes)
 #ifdef CONFIG_WBT
 	/*lint -save -e514*/
 	blk_stat_add(&req->q->rq_stats[rq_data_dir(req)], req);
-	if (req->cmd_flags & REQ_FG)
+	blk_stat_hist_add(&req->q->rq_stats_hist[rq_data_dir(req)], req);
+	if (req->cmd_flags & REQ_FG) {
 		blk_stat_add(&req->q->rq_stats[2 + rq_data_dir(req)], req);
+		blk_stat_hist_add(&req->q->rq_stats_hist[2 + rq_data_dir(req)],
+				  req);
+	}
 	/*lint -restore*/
+	if (rq_data_dir(req) == READ)
+		blk_ra_account(req->q, nr_bytes);
 #endif
 
 	if (!req->bio)
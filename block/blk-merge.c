@@ -458,6 +458,15 @@ static void blk_account_io_merge(struct request *req)
 }
 
 #ifdef CONFIG_HISI_BLK_INLINE_CRYPTO
+/*
+ * Data units spanned by @bio. Cloned bios, e.g. from dm-crypt inline_crypt,
+ * share the bvec table of their parent and have no meaningful bi_vcnt.
+ */
+static inline unsigned int blk_bio_key_pages(struct bio *bio)
+{
+	return bio_sectors(bio) >> (PAGE_SHIFT - 9);
+}
+
 static int blk_bio_key_compare(struct request *rq, struct bio *bio)
 {
 	if (!is_blk_queue_support_crypto(rq->q))
@@ -493,11 +502,11 @@ static int blk_bio_key_compare(struct request *rq, struct bio *bio)
 		ret = blk_try_merge(rq, bio);
 		switch (ret) {
 		case ELEVATOR_BACK_MERGE:
-			if (prev->index + prev->bi_vcnt != bio->index)
+			if (prev->index + blk_bio_key_pages(prev) != bio->index)
 				return false;
 			break;
 		case ELEVATOR_FRONT_MERGE:
-			if (bio->index + bio->bi_vcnt != rq->bio->index)
+			if (bio->index + blk_bio_key_pages(bio) != rq->bio->index)
 				return false;
 			break;
 		default:
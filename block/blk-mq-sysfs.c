@@ -12,6 +12,9 @@
 #include <linux/blk-mq.h>
 #include "blk-mq.h"
 #include "blk-mq-tag.h"
+#include "hisi-blk-mq-class-dispatch.h"
+#include "hisi-blk-mq-row.h"
+#include "hisi-blk-mq-ionice.h"
 
 static void blk_mq_sysfs_release(struct kobject *kobj)
 {
@@ -257,6 +260,7 @@ static void blk_mq_stat_clear(struct blk_mq_hw_ctx *hctx)
 		blk_stat_init(&ctx->stat[1]);
 		blk_stat_init(&ctx->stat[2]);
 		blk_stat_init(&ctx->stat[3]);
+		memset(ctx->stat_hist, 0, sizeof(ctx->stat_hist));
 	}
 }
 
@@ -295,6 +299,21 @@ static ssize_t blk_mq_hw_sysfs_stat_show(struct blk_mq_hw_ctx *hctx, char *page)
 	ret += print_stat(page + ret, &stat[3], "fg-write:");
 	return ret;
 }
+
+static ssize_t blk_mq_hw_sysfs_latency_hist_show(struct blk_mq_hw_ctx *hctx,
+						 char *page)
+{
+	struct blk_rq_stat_hist hist[4];
+	ssize_t ret;
+
+	blk_hctx_stat_hist_get(hctx, hist);
+
+	ret = blk_stat_hist_show(page, &hist[0], "read :");
+	ret += blk_stat_hist_show(page + ret, &hist[1], "write:");
+	ret += blk_stat_hist_show(page + ret, &hist[2], "fg-read:");
+	ret += blk_stat_hist_show(page + ret, &hist[3], "fg-write:");
+	return ret;
+}
 #endif
 
 static struct blk_mq_ctx_sysfs_entry blk_mq_sysfs_dispatched = {
@@ -356,6 +375,33 @@ static struct blk_mq_hw_ctx_sysfs_entry blk_mq_hw_sysfs_stat = {
 	.show = blk_mq_hw_sysfs_stat_show,
 	.store = blk_mq_hw_sysfs_stat_store,
 };
+static struct blk_mq_hw_ctx_sysfs_entry blk_mq_hw_sysfs_latency_hist = {
+	.attr = {.name = "latency_hist", .mode = S_IRUGO | S_IWUSR },
+	.show = blk_mq_hw_sysfs_latency_hist_show,
+	.store = blk_mq_hw_sysfs_stat_store,
+};
+#endif
+
+#ifdef CONFIG_HISI_MQ_CLASS_DISPATCH
+static struct blk_mq_hw_ctx_sysfs_entry blk_mq_hw_sysfs_class_dispatch = {
+	.attr = {.name = "class_dispatch", .mode = S_IRUGO | S_IWUSR },
+	.show = hisi_blk_mq_class_dispatch_show,
+	.store = hisi_blk_mq_class_dispatch_store,
+};
+#endif
+#ifdef CONFIG_HISI_MQ_ROW
+static struct blk_mq_hw_ctx_sysfs_entry blk_mq_hw_sysfs_row = {
+	.attr = {.name = "row", .mode = S_IRUGO | S_IWUSR },
+	.show = hisi_blk_mq_row_show,
+	.store = hisi_blk_mq_row_store,
+};
+#endif
+#ifdef CONFIG_HISI_MQ_IONICE_WEIGHT
+static struct blk_mq_hw_ctx_sysfs_entry blk_mq_hw_sysfs_ionice = {
+	.attr = {.name = "ionice", .mode = S_IRUGO | S_IWUSR },
+	.show = hisi_blk_mq_ionice_show,
+	.store = hisi_blk_mq_ionice_store,
+};
 #endif
 
 static struct attribute *default_hw_ctx_attrs[] = {
@@ -368,6 +414,16 @@ static struct attribute *default_hw_ctx_attrs[] = {
 	&blk_mq_hw_sysfs_active.attr,
 #ifdef CONFIG_WBT
 	&blk_mq_hw_sysfs_stat.attr,
+	&blk_mq_hw_sysfs_latency_hist.attr,
+#endif
+#ifdef CONFIG_HISI_MQ_CLASS_DISPATCH
+	&blk_mq_hw_sysfs_class_dispatch.attr,
+#endif
+#ifdef CONFIG_HISI_MQ_ROW
+	&blk_mq_hw_sysfs_row.attr,
+#endif
+#ifdef CONFIG_HISI_MQ_IONICE_WEIGHT
+	&blk_mq_hw_sysfs_ionice.attr,
 #endif
 	NULL,
 };
@@ -31,9 +31,13 @@
 #include "blk-mq.h"
 #include "blk-mq-tag.h"
 #include "blk-stat.h"
+#include "blk-ra.h"
 
 #include "hisi-blk-mq.h"
 #include "hisi-blk-mq-dispatch-strategy.h"
+#include "hisi-blk-mq-class-dispatch.h"
+#include "hisi-blk-mq-row.h"
+#include "hisi-blk-mq-ionice.h"
 #include "hisi-blk-mq-debug.h"
 
 static DEFINE_MUTEX(all_q_mutex);
@@ -52,7 +56,7 @@ static bool blk_mq_hctx_has_pending(struct blk_mq_hw_ctx *hctx)
 		if (hctx->ctx_map.map[i].word)
 			return true;
 
-	return false;
+	return hisi_blk_mq_row_pending(hctx);
 }
 
 static inline struct blk_align_bitmap *get_bm(struct blk_mq_hw_ctx *hctx,
@@ -365,6 +369,8 @@ static void __blk_mq_free_request(struct blk_mq_hw_ctx *hctx,
 		atomic_dec(&hctx->nr_active);
 
 	wbt_done(q->rq_wb, &rq->wb_stat, (bool)(rq->cmd_flags & REQ_FG));
+	hisi_blk_mq_class_dispatch_done(hctx, rq);
+	hisi_blk_mq_ionice_done(hctx, rq);
 	rq->cmd_flags = 0;
 
 	clear_bit(REQ_ATOM_STARTED, &rq->atomic_flags);
@@ -400,7 +406,16 @@ inline void __blk_mq_end_request(struct request *rq, int error)
 	blk_account_io_done(rq);
 
 	if (rq->end_io) {
+		struct blk_mq_hw_ctx *hctx;
+
 		wbt_done(rq->q->rq_wb, &rq->wb_stat, (bool)(rq->cmd_flags & REQ_FG));
+		/*
+		 * The flush request is re-initialised for the next flush
+		 * without ever being freed, so settle its accounting here.
+		 */
+		hctx = rq->q->mq_ops->map_queue(rq->q, rq->mq_ctx->cpu);
+		hisi_blk_mq_class_dispatch_done(hctx, rq);
+		hisi_blk_mq_ionice_done(hctx, rq);
 		rq->end_io(rq, error);
 	} else {
 		if (unlikely(blk_bidi_rq(rq)))
@@ -444,10 +459,12 @@ static void blk_mq_ipi_complete_request(struct request *rq)
 		shared = cpus_share_cache(cpu, ctx->cpu);
 
 	if (cpu != ctx->cpu && !shared && cpu_online(ctx->cpu)) {
-		rq->csd.func = __blk_mq_complete_request_remote;
-		rq->csd.info = rq;
-		rq->csd.flags = 0;
-		smp_call_function_single_async(ctx->cpu, &rq->csd);
+		if (!blk_batch_remote_complete(ctx->cpu, rq)) {
+			rq->csd.func = __blk_mq_complete_request_remote;
+			rq->csd.info = rq;
+			rq->csd.flags = 0;
+			smp_call_function_single_async(ctx->cpu, &rq->csd);
+		}
 	} else {
 		if (hisi_blk_mq_test_queue_quirk(rq->q, HISI_MQ_FORCE_SOFTIRQ))
 			__blk_complete_request(rq);
@@ -469,12 +486,18 @@ static void blk_mq_stat_add(struct request *rq)
 	stat = &rq->mq_ctx->stat[rq_data_dir(rq)];
 
 	blk_stat_add(stat, rq);
+	blk_stat_hist_add(&rq->mq_ctx->stat_hist[rq_data_dir(rq)], rq);
 
 	if (rq->cmd_flags & REQ_FG) {
 		stat = &rq->mq_ctx->stat[2 + rq_data_dir(rq)];
 		blk_stat_add(stat, rq);
+		blk_stat_hist_add(&rq->mq_ctx->stat_hist[2 + rq_data_dir(rq)],
+				  rq);
 	}
 	/*lint -restore*/
+
+	if (rq_data_dir(rq) == READ)
+		blk_ra_account(rq->q, blk_rq_bytes(rq));
 }
 #endif
 
@@ -919,6 +942,10 @@ static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
 		spin_unlock(&hctx->lock);
 	}
 
+	hisi_blk_mq_row_dispatch(hctx, &rq_list, hctx->tags->nr_tags);
+	hisi_blk_mq_ionice_dispatch(hctx, &rq_list);
+	hisi_blk_mq_class_dispatch_reorder(hctx, &rq_list);
+
 #ifdef CONFIG_HISI_BLK_MQ
 	if (list_empty(&rq_list))
 		return;
@@ -1414,6 +1441,9 @@ void blk_mq_flush_plug_list(struct blk_plug *plug, bool from_schedule)
 static void blk_mq_bio_to_request(struct request *rq, struct bio *bio)
 {
 	init_request_from_bio(rq, bio);
+	hisi_blk_mq_class_classify(rq);
+	hisi_blk_mq_row_set_request(rq);
+	hisi_blk_mq_ionice_set_request(rq);
 
 	if (blk_do_io_stat(rq))
 		blk_account_io_start(rq, 1);
@@ -2016,6 +2046,9 @@ static void blk_mq_exit_hctx(struct request_queue *q,
 	if (set->ops->exit_hctx)
 		set->ops->exit_hctx(hctx, hctx_idx);
 
+	hisi_blk_mq_ionice_exit(hctx);
+	hisi_blk_mq_row_exit(hctx);
+	hisi_blk_mq_class_dispatch_exit(hctx);
 	blk_mq_unregister_cpu_notifier(&hctx->cpu_notifier);
 	blk_free_flush_queue(hctx->fq);
 	blk_mq_free_bitmap(&hctx->ctx_map);
@@ -2083,6 +2116,11 @@ static int blk_mq_init_hctx(struct request_queue *q,
 
 	hctx->nr_ctx = 0;
 
+	if (hisi_blk_mq_class_dispatch_init(hctx) ||
+	    hisi_blk_mq_row_init(hctx) ||
+	    hisi_blk_mq_ionice_init(hctx))
+		goto free_bitmap;
+
 	if (set->ops->init_hctx &&
 	    set->ops->init_hctx(hctx, set->driver_data, hctx_idx))
 		goto free_bitmap;
@@ -2105,6 +2143,9 @@ static int blk_mq_init_hctx(struct request_queue *q,
 	if (set->ops->exit_hctx)
 		set->ops->exit_hctx(hctx, hctx_idx);
  free_bitmap:
+	hisi_blk_mq_ionice_exit(hctx);
+	hisi_blk_mq_row_exit(hctx);
+	hisi_blk_mq_class_dispatch_exit(hctx);
 	blk_mq_free_bitmap(&hctx->ctx_map);
  free_ctxs:
 	kfree(hctx->ctxs);
@@ -25,6 +25,7 @@ struct blk_mq_ctx {
 	unsigned long		____cacheline_aligned_in_smp rq_completed[2];
 #ifdef CONFIG_WBT
 	struct blk_rq_stat	stat[4];
+	struct blk_rq_stat_hist	stat_hist[4];
 #endif
 
 	struct request_queue	*queue;
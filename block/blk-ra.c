@@ -0,0 +1,176 @@
+/*
+ * Adaptive readahead window per queue
+ *
+ * Copyright (c) 2013 Huawei Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Once enabled through queue/read_ahead_adaptive, the readahead window of
+ * the queue's bdi follows the read bandwidth-delay product of the device:
+ * twice the mean read latency from blk-stat times the peak read bandwidth
+ * seen lately, so that the synchronous and the asynchronous part of a
+ * window together keep the device busy. High latency devices (SD, eMMC)
+ * end up with large windows, UFS with small ones that don't over-read.
+ */
+#include <linux/kernel.h>
+#include <linux/blkdev.h>
+#include <linux/slab.h>
+#include <linux/math64.h>
+#include <linux/log2.h>
+#include <linux/workqueue.h>
+
+#include "blk-mq.h"
+#include "blk-ra.h"
+
+#define BLK_RA_PERIOD_MS	1000
+#define BLK_RA_MIN_KB		64
+/* windows with fewer read completions don't give a usable mean */
+#define BLK_RA_MIN_SAMPLES	8
+/* nor a usable bandwidth below this many bytes read */
+#define BLK_RA_MIN_BYTES	(1 << 20)
+/* the peak bandwidth decays by 1/16 per period without a new peak */
+#define BLK_RA_BW_DECAY		4
+
+void blk_ra_account(struct request_queue *q, unsigned int bytes)
+{
+	struct blk_ra_tune *ra = q->ra_tune;
+
+	if (ra && ra->max_kb)
+		atomic64_add(bytes, &ra->read_bytes);
+}
+
+static void blk_ra_update(struct blk_ra_tune *ra)
+{
+	struct request_queue *q = ra->q;
+	struct blk_rq_stat stat[4];
+	u64 now = ktime_to_ns(ktime_get());
+	u64 bytes = atomic64_read(&ra->read_bytes);
+	u64 delta_bytes = bytes - ra->last_bytes;
+	u64 delta_ns = now - ra->last_ns;
+	u64 bdp;
+	unsigned int kb;
+
+	ra->last_bytes = bytes;
+	ra->last_ns = now;
+
+	blk_queue_stat_get(q, stat);
+	if (stat[0].nr_samples >= BLK_RA_MIN_SAMPLES && stat[0].mean > 0) {
+		/* smoothed over about 8 periods */
+		if (!ra->lat_ns)
+			ra->lat_ns = stat[0].mean;
+		else
+			ra->lat_ns = (ra->lat_ns * 7 + stat[0].mean) >> 3;
+	}
+
+	if (delta_bytes >= BLK_RA_MIN_BYTES && delta_ns) {
+		u64 bw = div64_u64(delta_bytes * NSEC_PER_SEC, delta_ns);
+
+		if (bw > ra->bw)
+			ra->bw = bw;
+		else
+			ra->bw -= ra->bw >> BLK_RA_BW_DECAY;
+	}
+
+	if (!ra->lat_ns || !ra->bw)
+		return;
+
+	bdp = div64_u64(ra->lat_ns * ra->bw, NSEC_PER_SEC);
+	kb = (unsigned int)min_t(u64, (bdp * 2) >> 10, ra->max_kb);
+	kb = max_t(unsigned int, kb, BLK_RA_MIN_KB);
+	kb = roundup_pow_of_two(kb);
+	kb = min(kb, ra->max_kb);
+
+	if (kb != ra->ra_kb) {
+		ra->ra_kb = kb;
+		ra->adjusts++;
+		q->backing_dev_info.ra_pages = kb >> (PAGE_CACHE_SHIFT - 10);
+	}
+}
+
+static void blk_ra_work(struct work_struct *work)
+{
+	struct blk_ra_tune *ra = container_of(to_delayed_work(work),
+					      struct blk_ra_tune, work);
+
+	blk_ra_update(ra);
+	queue_delayed_work(system_power_efficient_wq, &ra->work,
+			   msecs_to_jiffies(BLK_RA_PERIOD_MS));
+}
+
+/*
+ * blk_ra_set - enable adaptation with windows of at most 'max_kb', or
+ * disable it with 0 and go back to the window set before. Serialized by
+ * q->sysfs_lock.
+ */
+int blk_ra_set(struct request_queue *q, unsigned int max_kb)
+{
+	struct blk_ra_tune *ra = q->ra_tune;
+
+	if (max_kb && max_kb < BLK_RA_MIN_KB)
+		return -EINVAL;
+
+	if (!ra) {
+		if (!max_kb)
+			return 0;
+		ra = kzalloc(sizeof(*ra), GFP_KERNEL);
+		if (!ra)
+			return -ENOMEM;
+		ra->q = q;
+		INIT_DELAYED_WORK(&ra->work, blk_ra_work);
+		q->ra_tune = ra;
+	}
+
+	if (!max_kb) {
+		if (ra->max_kb) {
+			cancel_delayed_work_sync(&ra->work);
+			ra->max_kb = 0;
+			q->backing_dev_info.ra_pages = ra->saved_ra_pages;
+		}
+		return 0;
+	}
+
+	if (!ra->max_kb) {
+		ra->saved_ra_pages = q->backing_dev_info.ra_pages;
+		ra->ra_kb = ra->saved_ra_pages << (PAGE_CACHE_SHIFT - 10);
+		ra->last_bytes = atomic64_read(&ra->read_bytes);
+		ra->last_ns = ktime_to_ns(ktime_get());
+		ra->max_kb = max_kb;
+		queue_delayed_work(system_power_efficient_wq, &ra->work,
+				   msecs_to_jiffies(BLK_RA_PERIOD_MS));
+	} else {
+		ra->max_kb = max_kb;
+	}
+
+	return 0;
+}
+
+unsigned int blk_ra_get(struct request_queue *q)
+{
+	return q->ra_tune ? q->ra_tune->max_kb : 0;
+}
+
+ssize_t blk_ra_stats_show(struct request_queue *q, char *page)
+{
+	struct blk_ra_tune *ra = q->ra_tune;
+
+	if (!ra)
+		return sprintf(page, "off\n");
+
+	return sprintf(page, "lat_us=%llu bw_kbps=%llu ra_kb=%u max_kb=%u adjusts=%lu\n",
+		       div_u64(ra->lat_ns, NSEC_PER_USEC), ra->bw >> 10,
+		       ra->ra_kb, ra->max_kb, ra->adjusts);
+}
+
+void blk_ra_exit(struct request_queue *q)
+{
+	struct blk_ra_tune *ra = q->ra_tune;
+
+	if (!ra)
+		return;
+
+	cancel_delayed_work_sync(&ra->work);
+	q->ra_tune = NULL;
+	kfree(ra);
+}
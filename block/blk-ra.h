@@ -0,0 +1,35 @@
+#ifndef BLK_RA_H
+#define BLK_RA_H
+
+#include <linux/workqueue.h>
+
+struct blk_ra_tune {
+	struct request_queue *q;
+	struct delayed_work work;
+	atomic64_t read_bytes;		/* completed reads */
+	u64 last_bytes;
+	u64 last_ns;
+	u64 lat_ns;			/* smoothed mean read latency */
+	u64 bw;				/* decaying peak read bytes/s */
+	unsigned long saved_ra_pages;	/* window before adaptation */
+	unsigned int max_kb;		/* 0 when adaptation is off */
+	unsigned int ra_kb;
+	unsigned long adjusts;
+};
+
+#ifdef CONFIG_BLK_ADAPTIVE_RA
+void blk_ra_account(struct request_queue *q, unsigned int bytes);
+int blk_ra_set(struct request_queue *q, unsigned int max_kb);
+unsigned int blk_ra_get(struct request_queue *q);
+ssize_t blk_ra_stats_show(struct request_queue *q, char *page);
+void blk_ra_exit(struct request_queue *q);
+#else
+static inline void blk_ra_account(struct request_queue *q, unsigned int bytes)
+{
+}
+static inline void blk_ra_exit(struct request_queue *q)
+{
+}
+#endif
+
+#endif
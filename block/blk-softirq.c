@@ -9,6 +9,7 @@
 #include <linux/interrupt.h>
 #include <linux/cpu.h>
 #include <linux/sched.h>
+#include <linux/llist.h>
 
 #include "blk.h"
 
@@ -36,6 +37,53 @@ static void blk_done_softirq(struct softirq_action *h)
 	}
 }
 
+#ifdef CONFIG_HISI_BLK_BATCH_COMPLETE_IPI
+/*
+ * Remote completions are queued per target cpu and the cpu is only
+ * interrupted when its queue was empty, so a burst of completions from
+ * one controller interrupt costs one IPI per submitting cpu instead of
+ * one per request. rq->csd is not handed to the IPI code on this path,
+ * so its llist node links the queue.
+ */
+static DEFINE_PER_CPU(struct llist_head, blk_cpu_remote_done);
+static DEFINE_PER_CPU(struct call_single_data, blk_cpu_remote_csd);
+
+static void blk_remote_done_run(struct llist_node *entry)
+{
+	struct request *rq, *next;
+	struct list_head *list;
+
+	entry = llist_reverse_order(entry);
+	llist_for_each_entry_safe(rq, next, entry, csd.llist) {
+		if (rq->q->mq_ops) {
+			rq->q->softirq_done_fn(rq);
+			continue;
+		}
+
+		list = this_cpu_ptr(&blk_cpu_done);
+		list_add_tail(&rq->ipi_list, list);
+		if (list->next == &rq->ipi_list)
+			raise_softirq_irqoff(BLOCK_SOFTIRQ);
+	}
+}
+
+static void blk_remote_done_ipi(void *data)
+{
+	blk_remote_done_run(llist_del_all(this_cpu_ptr(&blk_cpu_remote_done)));
+}
+
+bool blk_batch_remote_complete(int cpu, struct request *rq)
+{
+	if (!cpu_online(cpu))
+		return false;
+
+	if (llist_add(&rq->csd.llist, &per_cpu(blk_cpu_remote_done, cpu)))
+		smp_call_function_single_async(cpu,
+				&per_cpu(blk_cpu_remote_csd, cpu));
+	return true;
+}
+#endif
+
 #ifdef CONFIG_SMP
 static void trigger_softirq(void *data)
 {
@@ -58,6 +106,9 @@ static void trigger_softirq(void *data)
  */
 static int raise_blk_irq(int cpu, struct request *rq)
 {
+	if (blk_batch_remote_complete(cpu, rq))
+		return 0;
+
 	if (cpu_online(cpu)) {
 		struct call_single_data *data = &rq->csd;
 
@@ -91,6 +142,10 @@ static int blk_cpu_notify(struct notifier_block *self, unsigned long action,
 		local_irq_disable();
 		list_splice_init(&per_cpu(blk_cpu_done, cpu),
 				 this_cpu_ptr(&blk_cpu_done));
+#ifdef CONFIG_HISI_BLK_BATCH_COMPLETE_IPI
+		blk_remote_done_run(llist_del_all(&per_cpu(blk_cpu_remote_done,
+							   cpu)));
+#endif
 		raise_softirq_irqoff(BLOCK_SOFTIRQ);
 		local_irq_enable();
 	}
@@ -177,8 +232,15 @@ static __init int blk_softirq_init(void)
 {
 	int i;
 
-	for_each_possible_cpu(i)
+	for_each_possible_cpu(i) {
 		INIT_LIST_HEAD(&per_cpu(blk_cpu_done, i));
+#ifdef CONFIG_HISI_BLK_BATCH_COMPLETE_IPI
+		init_llist_head(&per_cpu(blk_cpu_remote_done, i));
+		per_cpu(blk_cpu_remote_csd, i).func = blk_remote_done_ipi;
+		per_cpu(blk_cpu_remote_csd, i).info = NULL;
+		per_cpu(blk_cpu_remote_csd, i).flags = 0;
+#endif
+	}
 
 	open_softirq(BLOCK_SOFTIRQ, blk_done_softirq);
 	register_hotcpu_notifier(&blk_cpu_notifier);
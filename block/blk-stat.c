@@ -4,6 +4,8 @@
  * Copyright (C) 2016 Jens Axboe
  */
 #include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/log2.h>
 #include <linux/blk-mq.h>
 
 #include "blk-stat.h"
@@ -211,6 +213,7 @@ void blk_stat_clear(struct request_queue *q)
 				blk_stat_init(&ctx->stat[1]);
 				blk_stat_init(&ctx->stat[2]);
 				blk_stat_init(&ctx->stat[3]);
+				memset(ctx->stat_hist, 0, sizeof(ctx->stat_hist));
 			}
 		}
 		/*lint -restore*/
@@ -219,5 +222,153 @@ void blk_stat_clear(struct request_queue *q)
 		blk_stat_init(&q->rq_stats[1]);
 		blk_stat_init(&q->rq_stats[2]);
 		blk_stat_init(&q->rq_stats[3]);
+		memset(q->rq_stats_hist, 0, sizeof(q->rq_stats_hist));
 	}
 }
+
+/*
+ * The histograms are never windowed: buckets only ever grow until the
+ * stats are cleared, so a consumer that wants a rolling view snapshots
+ * them and subtracts the previous snapshot (see blk_stat_hist_delta()).
+ * Each blk_mq_ctx is per-cpu, so the bucket increment needs no lock; a
+ * lost update on a cross-cpu completion only costs one sample.
+ */
+void blk_stat_hist_add(struct blk_rq_stat_hist *hist, struct request *rq)
+{
+	u64 now, value;
+	u64 rq_time = wbt_issue_stat_get_time(&rq->wb_stat);
+	unsigned int bucket;
+
+	now = ktime_to_ns(ktime_get());
+	if (now < rq_time)
+		return;
+
+	value = (now - rq_time) >> 10;
+	bucket = value ? ilog2(value) : 0;
+	if (bucket >= BLK_STAT_HIST_BUCKETS)
+		bucket = BLK_STAT_HIST_BUCKETS - 1;
+
+	hist->buckets[bucket]++;
+}
+
+void blk_stat_hist_sum(struct blk_rq_stat_hist *dst,
+		       struct blk_rq_stat_hist *src)
+{
+	unsigned int i;
+
+	for (i = 0; i < BLK_STAT_HIST_BUCKETS; i++)
+		dst->buckets[i] += READ_ONCE(src->buckets[i]);
+}
+
+void blk_stat_hist_delta(struct blk_rq_stat_hist *dst,
+			 struct blk_rq_stat_hist *now,
+			 struct blk_rq_stat_hist *prev)
+{
+	unsigned int i;
+
+	for (i = 0; i < BLK_STAT_HIST_BUCKETS; i++) {
+		if (now->buckets[i] > prev->buckets[i])
+			dst->buckets[i] = now->buckets[i] - prev->buckets[i];
+		else
+			dst->buckets[i] = 0;
+	}
+}
+
+u64 blk_stat_hist_samples(struct blk_rq_stat_hist *hist)
+{
+	u64 total = 0;
+	unsigned int i;
+
+	for (i = 0; i < BLK_STAT_HIST_BUCKETS; i++)
+		total += hist->buckets[i];
+
+	return total;
+}
+
+/*
+ * Return the upper bound in usecs of the bucket holding the given
+ * percentile, expressed in permille (990 for p99, 999 for p999).
+ * Returns 0 if there are no samples.
+ */
+u64 blk_stat_hist_percentile(struct blk_rq_stat_hist *hist,
+			     unsigned int permille)
+{
+	u64 total, target, seen = 0;
+	unsigned int i;
+
+	total = blk_stat_hist_samples(hist);
+	if (!total)
+		return 0;
+
+	target = div_u64(total * permille + 999, 1000);
+	if (!target)
+		target = 1;
+
+	for (i = 0; i < BLK_STAT_HIST_BUCKETS; i++) {
+		seen += hist->buckets[i];
+		if (seen >= target)
+			break;
+	}
+	if (i >= BLK_STAT_HIST_BUCKETS)
+		i = BLK_STAT_HIST_BUCKETS - 1;
+
+	return 2ULL << i;
+}
+
+void blk_hctx_stat_hist_get(struct blk_mq_hw_ctx *hctx,
+			    struct blk_rq_stat_hist *dst)
+{
+	struct blk_mq_ctx *ctx;
+	unsigned int i;
+
+	memset(dst, 0, 4 * sizeof(*dst));
+
+	hctx_for_each_ctx(hctx, ctx, i) {
+		blk_stat_hist_sum(&dst[0], &ctx->stat_hist[0]);
+		blk_stat_hist_sum(&dst[1], &ctx->stat_hist[1]);
+		blk_stat_hist_sum(&dst[2], &ctx->stat_hist[2]);
+		blk_stat_hist_sum(&dst[3], &ctx->stat_hist[3]);
+	}
+}
+
+void blk_queue_stat_hist_get(struct request_queue *q,
+			     struct blk_rq_stat_hist *dst)
+{
+	if (q->mq_ops) {
+		struct blk_rq_stat_hist hist[4];
+		struct blk_mq_hw_ctx *hctx;
+		int i, j;
+
+		memset(dst, 0, 4 * sizeof(*dst));
+
+		/*lint -save -e574 -e737*/
+		queue_for_each_hw_ctx(q, hctx, i) {
+			blk_hctx_stat_hist_get(hctx, hist);
+			for (j = 0; j < 4; j++)
+				blk_stat_hist_sum(&dst[j], &hist[j]);
+		}
+		/*lint -restore*/
+	} else
+		memcpy(dst, q->rq_stats_hist, sizeof(q->rq_stats_hist));
+}
+EXPORT_SYMBOL_GPL(blk_queue_stat_hist_get);
+
+ssize_t blk_stat_hist_show(char *page, struct blk_rq_stat_hist *hist,
+			   const char *pre)
+{
+	ssize_t ret;
+	unsigned int i;
+
+	ret = sprintf(page, "%s samples=%llu, p50=%llu, p90=%llu, p99=%llu, p999=%llu, buckets=",
+			pre, blk_stat_hist_samples(hist),
+			blk_stat_hist_percentile(hist, 500),
+			blk_stat_hist_percentile(hist, 900),
+			blk_stat_hist_percentile(hist, 990),
+			blk_stat_hist_percentile(hist, 999));
+	for (i = 0; i < BLK_STAT_HIST_BUCKETS; i++)
+		ret += sprintf(page + ret, "%llu%c",
+				hist->buckets[i],
+				i == BLK_STAT_HIST_BUCKETS - 1 ? '\n' : ' ');
+
+	return ret;
+}
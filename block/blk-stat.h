@@ -14,6 +14,15 @@ void blk_queue_stat_get(struct request_queue *, struct blk_rq_stat *);
 void blk_stat_clear(struct request_queue *q);
 void blk_stat_init(struct blk_rq_stat *);
 void blk_stat_sum(struct blk_rq_stat *, struct blk_rq_stat *);
+void blk_stat_hist_add(struct blk_rq_stat_hist *, struct request *);
+void blk_stat_hist_sum(struct blk_rq_stat_hist *, struct blk_rq_stat_hist *);
+void blk_stat_hist_delta(struct blk_rq_stat_hist *, struct blk_rq_stat_hist *,
+			 struct blk_rq_stat_hist *);
+u64 blk_stat_hist_samples(struct blk_rq_stat_hist *);
+u64 blk_stat_hist_percentile(struct blk_rq_stat_hist *, unsigned int);
+void blk_hctx_stat_hist_get(struct blk_mq_hw_ctx *, struct blk_rq_stat_hist *);
+void blk_queue_stat_hist_get(struct request_queue *, struct blk_rq_stat_hist *);
+ssize_t blk_stat_hist_show(char *, struct blk_rq_stat_hist *, const char *);
 #else
 static inline void blk_stat_add(struct blk_rq_stat *stat, struct request *rq)
 {
@@ -33,6 +42,32 @@ static inline void blk_stat_init(struct blk_rq_stat *stat)
 static inline void blk_stat_sum(struct blk_rq_stat *dst, struct blk_rq_stat *src)
 {
 }
+static inline void blk_stat_hist_add(struct blk_rq_stat_hist *hist, struct request *rq)
+{
+}
+static inline void blk_stat_hist_sum(struct blk_rq_stat_hist *dst, struct blk_rq_stat_hist *src)
+{
+}
+static inline void blk_stat_hist_delta(struct blk_rq_stat_hist *dst,
+				       struct blk_rq_stat_hist *now,
+				       struct blk_rq_stat_hist *prev)
+{
+}
+static inline u64 blk_stat_hist_samples(struct blk_rq_stat_hist *hist)
+{
+	return 0;
+}
+static inline u64 blk_stat_hist_percentile(struct blk_rq_stat_hist *hist,
+					   unsigned int permille)
+{
+	return 0;
+}
+static inline void blk_hctx_stat_hist_get(struct blk_mq_hw_ctx *hctx, struct blk_rq_stat_hist *dst)
+{
+}
+static inline void blk_queue_stat_hist_get(struct request_queue *q, struct blk_rq_stat_hist *dst)
+{
+}
 #endif
 
 #endif
@@ -13,6 +13,7 @@
 
 #include "blk.h"
 #include "blk-mq.h"
+#include "blk-ra.h"
 #include "hisi-blk-mq.h"
 
 struct queue_sysfs_entry {
@@ -355,6 +356,32 @@ static ssize_t queue_wb_lat_store(struct request_queue *q, const char *page,
 	return (ssize_t)count;
 }
 
+#ifdef CONFIG_BLK_ADAPTIVE_RA
+static ssize_t queue_ra_adaptive_show(struct request_queue *q, char *page)
+{
+	return queue_var_show(blk_ra_get(q), page);
+}
+
+static ssize_t queue_ra_adaptive_store(struct request_queue *q,
+				       const char *page, size_t count)
+{
+	unsigned long max_kb;
+	ssize_t ret = queue_var_store(&max_kb, page, count);
+	int err;
+
+	if (ret < 0)
+		return ret;
+
+	err = blk_ra_set(q, (unsigned int)min_t(unsigned long, max_kb, UINT_MAX));
+	return err ? err : ret;
+}
+
+static ssize_t queue_ra_stats_show(struct request_queue *q, char *page)
+{
+	return blk_ra_stats_show(q, page);
+}
+#endif
+
 static ssize_t queue_wc_show(struct request_queue *q, char *page)
 {
 	if (test_bit(QUEUE_FLAG_WC, &q->queue_flags))
@@ -411,6 +438,20 @@ static ssize_t queue_stats_show(struct request_queue *q, char *page)
 	return ret;
 }
 
+static ssize_t queue_latency_hist_show(struct request_queue *q, char *page)
+{
+	struct blk_rq_stat_hist hist[4];
+	ssize_t ret;
+
+	blk_queue_stat_hist_get(q, hist);
+
+	ret = blk_stat_hist_show(page, &hist[0], "read :");
+	ret += blk_stat_hist_show(page + ret, &hist[1], "write:");
+	ret += blk_stat_hist_show(page + ret, &hist[2], "fg-read:");
+	ret += blk_stat_hist_show(page + ret, &hist[3], "fg-write:");
+	return ret;
+}
+
 static ssize_t queue_wb_ok_cnt_show(struct request_queue *q, char *page)
 {
 	if (!q->rq_wb)
@@ -578,6 +619,11 @@ static struct queue_sysfs_entry queue_stats_entry = {
 	.attr = {.name = "stats", .mode = S_IRUGO },
 	.show = queue_stats_show,
 };
+
+static struct queue_sysfs_entry queue_latency_hist_entry = {
+	.attr = {.name = "latency_hist", .mode = S_IRUGO },
+	.show = queue_latency_hist_show,
+};
 /*lint -restore*/
 
 static struct queue_sysfs_entry queue_wb_lat_entry = {
@@ -599,7 +645,29 @@ static struct queue_sysfs_entry queue_wb_ok_cnt_entry = {
 };
 #endif
 
+#ifdef CONFIG_BLK_ADAPTIVE_RA
+static struct queue_sysfs_entry queue_ra_adaptive_entry = {
+	.attr = {.name = "read_ahead_adaptive", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_ra_adaptive_show,
+	.store = queue_ra_adaptive_store,
+};
+
+/*lint -save -e785*/
+static struct queue_sysfs_entry queue_ra_stats_entry = {
+	.attr = {.name = "read_ahead_stats", .mode = S_IRUGO },
+	.show = queue_ra_stats_show,
+};
+/*lint -restore*/
+#endif
+
 /*lint -save -e785*/
+#ifdef CONFIG_HISI_BLK_MQ
+static struct queue_sysfs_entry queue_flush_reducing_entry = {
+	.attr = {.name = "flush_reducing_stats", .mode = S_IRUGO },
+	.show = flush_reducing_stats_show,
+};
+#endif
+
 static struct queue_sysfs_entry queue_avg_perf_entry = {
 	.attr = {.name = "average_perf", .mode = S_IRUGO },
 	.show = queue_avg_perf_show,
@@ -632,11 +700,19 @@ static struct attribute *default_attrs[] = {
 #ifdef CONFIG_WBT
 	&queue_wc_entry.attr,
 	&queue_stats_entry.attr,
+	&queue_latency_hist_entry.attr,
 	&queue_wb_lat_entry.attr,
 	&queue_wb_win_entry.attr,
 	&queue_wb_ok_cnt_entry.attr,
+#endif
+#ifdef CONFIG_BLK_ADAPTIVE_RA
+	&queue_ra_adaptive_entry.attr,
+	&queue_ra_stats_entry.attr,
 #endif
 	&queue_avg_perf_entry.attr,
+#ifdef CONFIG_HISI_BLK_MQ
+	&queue_flush_reducing_entry.attr,
+#endif
 	NULL,
 };
 
@@ -711,6 +787,7 @@ static void blk_release_queue(struct kobject *kobj)
 	struct request_queue *q =
 		container_of(kobj, struct request_queue, kobj);
 
+	blk_ra_exit(q);
 	bdi_exit(&q->backing_dev_info);
 	blkcg_exit_queue(q);
 
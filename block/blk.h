@@ -167,6 +167,15 @@ static inline void elv_deactivate_rq(struct request_queue *q, struct request *rq
 		e->type->ops.elevator_deactivate_req_fn(q, rq);
 }
 
+#ifdef CONFIG_HISI_BLK_BATCH_COMPLETE_IPI
+bool blk_batch_remote_complete(int cpu, struct request *rq);
+#else
+static inline bool blk_batch_remote_complete(int cpu, struct request *rq)
+{
+	return false;
+}
+#endif
+
 #ifdef CONFIG_FAIL_IO_TIMEOUT
 int blk_should_fake_timeout(struct request_queue *);
 ssize_t part_timeout_show(struct device *, struct device_attribute *, char *);
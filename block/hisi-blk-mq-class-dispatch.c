@@ -0,0 +1,294 @@
+/*
+ * hisi blk-mq multi-class dispatcher
+ *
+ * Requests pulled from the software queues of a hardware context are
+ * regrouped by class (flush/meta, sync read, foreground write,
+ * background) and handed to the driver in class priority order. A
+ * class only spends tokens of its per-hctx token bucket while a higher
+ * class has requests pending or in flight; once its bucket is empty the
+ * rest of its requests are held back on hctx->dispatch and the hardware
+ * queue is rerun shortly after, so background writeback cannot fill a
+ * single UFS queue in front of foreground reads. A class that has not
+ * dispatched anything for HISI_MQ_CLASS_STARVE_MS bypasses its budget.
+ *
+ * The class comes from the request flags and the ioprio of the
+ * submitter, which the ionice cgroup sets for the whole group.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/ioprio.h>
+#include <linux/iocontext.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+
+#include "blk-mq.h"
+#include "hisi-blk-mq-class-dispatch.h"
+
+#define HISI_MQ_CLASS_STARVE_MS		100
+#define HISI_MQ_CLASS_RERUN_MS		2
+
+struct hisi_mq_class_default {
+	const char *name;
+	unsigned int rate;
+	unsigned int burst;
+};
+
+static const struct hisi_mq_class_default class_defaults[HISI_MQ_CLASS_NR] = {
+	[HISI_MQ_CLASS_FLUSH_META]	= { "flush-meta", 0, 0 },
+	[HISI_MQ_CLASS_SYNC_READ]	= { "sync-read", 0, 0 },
+	[HISI_MQ_CLASS_FG_WRITE]	= { "fg-write", 2000, 64 },
+	[HISI_MQ_CLASS_BG]		= { "bg", 400, 16 },
+};
+
+void hisi_blk_mq_class_classify(struct request *rq)
+{
+	int prio;
+
+	rq->mq_dispatch_class = HISI_MQ_CLASS_FLUSH_META;
+	rq->mq_dispatch_counted = 0;
+
+	if (rq->cmd_type != REQ_TYPE_FS ||
+	    (rq->cmd_flags & (REQ_FLUSH | REQ_FUA | REQ_META)))
+		return;
+
+	prio = req_get_ioprio(rq);
+	if (!ioprio_valid(prio) && current->io_context)
+		prio = current->io_context->ioprio;
+
+	if (IOPRIO_PRIO_CLASS(prio) == IOPRIO_CLASS_IDLE ||
+	    (rq->cmd_flags & REQ_BG))
+		rq->mq_dispatch_class = HISI_MQ_CLASS_BG;
+	else if (rq_data_dir(rq) == READ)
+		rq->mq_dispatch_class = HISI_MQ_CLASS_SYNC_READ;
+	else if ((rq->cmd_flags & (REQ_SYNC | REQ_FG)) ||
+		 IOPRIO_PRIO_CLASS(prio) == IOPRIO_CLASS_RT)
+		rq->mq_dispatch_class = HISI_MQ_CLASS_FG_WRITE;
+	else
+		rq->mq_dispatch_class = HISI_MQ_CLASS_BG;
+}
+
+static void hisi_mq_class_refill(struct hisi_mq_class_bucket *b, u64 now)
+{
+	u64 add;
+
+	if (!b->rate)
+		return;
+
+	if (now <= b->last_refill_ns)
+		return;
+
+	add = div_u64((now - b->last_refill_ns) * b->rate, NSEC_PER_SEC);
+	if (!add)
+		return;
+
+	b->tokens = (unsigned int)min_t(u64, b->tokens + add, b->burst);
+	b->last_refill_ns = now;
+}
+
+static bool hisi_mq_class_may_dispatch(struct hisi_mq_class_bucket *b,
+				       bool competing)
+{
+	if (!competing || !b->rate || b->tokens)
+		return true;
+
+	return time_after(jiffies, b->last_dispatch +
+			  msecs_to_jiffies(HISI_MQ_CLASS_STARVE_MS));
+}
+
+void hisi_blk_mq_class_dispatch_reorder(struct blk_mq_hw_ctx *hctx,
+					struct list_head *rq_list)
+{
+	struct hisi_mq_class_dispatch *cd = hctx->class_dispatch;
+	struct list_head lists[HISI_MQ_CLASS_NR];
+	LIST_HEAD(held);
+	struct request *rq, *next;
+	bool competing = false;
+	unsigned long flags;
+	u64 now;
+	int class;
+
+	if (!cd || !hisi_blk_mq_test_queue_quirk(hctx->queue,
+						 HISI_MQ_CLASS_DISPATCH))
+		return;
+
+	for (class = 0; class < HISI_MQ_CLASS_NR; class++)
+		INIT_LIST_HEAD(&lists[class]);
+
+	list_for_each_entry_safe(rq, next, rq_list, queuelist) {
+		class = rq->mq_dispatch_class;
+		if (unlikely(class >= HISI_MQ_CLASS_NR))
+			class = HISI_MQ_CLASS_FLUSH_META;
+		list_move_tail(&rq->queuelist, &lists[class]);
+	}
+
+	now = ktime_to_ns(ktime_get());
+
+	spin_lock_irqsave(&cd->lock, flags);
+	for (class = 0; class < HISI_MQ_CLASS_NR; class++) {
+		struct hisi_mq_class_bucket *b = &cd->bucket[class];
+		bool busy = !list_empty(&lists[class]) ||
+			    atomic_read(&b->inflight);
+
+		hisi_mq_class_refill(b, now);
+
+		list_for_each_entry_safe(rq, next, &lists[class], queuelist) {
+			if (!hisi_mq_class_may_dispatch(b, competing)) {
+				list_move_tail(&rq->queuelist, &held);
+				b->held++;
+				continue;
+			}
+
+			if (competing && b->tokens)
+				b->tokens--;
+			b->last_dispatch = jiffies;
+			b->dispatched++;
+			if (!rq->mq_dispatch_counted) {
+				rq->mq_dispatch_counted = 1;
+				atomic_inc(&b->inflight);
+			}
+			list_move_tail(&rq->queuelist, rq_list);
+		}
+
+		if (busy)
+			competing = true;
+	}
+	spin_unlock_irqrestore(&cd->lock, flags);
+
+	if (list_empty(&held))
+		return;
+
+	spin_lock(&hctx->lock);
+	list_splice_tail_init(&held, &hctx->dispatch);
+	spin_unlock(&hctx->lock);
+
+	kblockd_schedule_delayed_work(&cd->rerun_work,
+				      msecs_to_jiffies(HISI_MQ_CLASS_RERUN_MS));
+}
+
+void hisi_blk_mq_class_dispatch_done(struct blk_mq_hw_ctx *hctx,
+				     struct request *rq)
+{
+	struct hisi_mq_class_dispatch *cd = hctx->class_dispatch;
+
+	if (!cd || !rq->mq_dispatch_counted)
+		return;
+
+	rq->mq_dispatch_counted = 0;
+	if (likely(rq->mq_dispatch_class < HISI_MQ_CLASS_NR))
+		atomic_dec(&cd->bucket[rq->mq_dispatch_class].inflight);
+}
+
+static void hisi_mq_class_rerun_work_fn(struct work_struct *work)
+{
+	struct hisi_mq_class_dispatch *cd = container_of(work,
+			struct hisi_mq_class_dispatch, rerun_work.work);/*lint !e826*/
+
+	blk_mq_run_hw_queue(cd->hctx, true);
+}
+
+int hisi_blk_mq_class_dispatch_init(struct blk_mq_hw_ctx *hctx)
+{
+	struct hisi_mq_class_dispatch *cd;
+	int class;
+
+	cd = kzalloc_node(sizeof(*cd), GFP_KERNEL, hctx->numa_node);
+	if (!cd)
+		return -ENOMEM;
+
+	spin_lock_init(&cd->lock);
+	cd->hctx = hctx;
+	INIT_DELAYED_WORK(&cd->rerun_work, hisi_mq_class_rerun_work_fn);
+
+	for (class = 0; class < HISI_MQ_CLASS_NR; class++) {
+		cd->bucket[class].rate = class_defaults[class].rate;
+		cd->bucket[class].burst = class_defaults[class].burst;
+		cd->bucket[class].tokens = class_defaults[class].burst;
+		cd->bucket[class].last_dispatch = jiffies;
+		atomic_set(&cd->bucket[class].inflight, 0);
+	}
+
+	hctx->class_dispatch = cd;
+	return 0;
+}
+
+void hisi_blk_mq_class_dispatch_exit(struct blk_mq_hw_ctx *hctx)
+{
+	struct hisi_mq_class_dispatch *cd = hctx->class_dispatch;
+
+	if (!cd)
+		return;
+
+	cancel_delayed_work_sync(&cd->rerun_work);
+	hctx->class_dispatch = NULL;
+	kfree(cd);
+}
+
+ssize_t hisi_blk_mq_class_dispatch_show(struct blk_mq_hw_ctx *hctx,
+					char *page)
+{
+	struct hisi_mq_class_dispatch *cd = hctx->class_dispatch;
+	ssize_t ret = 0;
+	int class;
+
+	if (!cd)
+		return -EINVAL;
+
+	ret += sprintf(page + ret, "enabled=%d\n",
+		       hisi_blk_mq_test_queue_quirk(hctx->queue,
+						    HISI_MQ_CLASS_DISPATCH));
+
+	spin_lock_irq(&cd->lock);
+	for (class = 0; class < HISI_MQ_CLASS_NR; class++) {
+		struct hisi_mq_class_bucket *b = &cd->bucket[class];
+
+		ret += sprintf(page + ret,
+			       "%d %s: rate=%u, burst=%u, tokens=%u, inflight=%d, dispatched=%lu, held=%lu\n",
+			       class, class_defaults[class].name, b->rate,
+			       b->burst, b->tokens, atomic_read(&b->inflight),
+			       b->dispatched, b->held);
+	}
+	spin_unlock_irq(&cd->lock);
+
+	return ret;
+}
+
+/*
+ * "<class> <rate> <burst>" sets the budget of a class, rate 0 removes
+ * the limit. "enable <0|1>" turns the dispatcher on or off for the
+ * whole queue.
+ */
+ssize_t hisi_blk_mq_class_dispatch_store(struct blk_mq_hw_ctx *hctx,
+					 const char *page, size_t count)
+{
+	struct hisi_mq_class_dispatch *cd = hctx->class_dispatch;
+	unsigned int class, rate, burst;
+	int enable;
+
+	if (!cd)
+		return -EINVAL;
+
+	if (sscanf(page, "enable %d", &enable) == 1) {
+		if (enable)
+			set_bit(HISI_MQ_CLASS_DISPATCH,
+				&hctx->queue->hisi_blk_mq_quirk_flags);
+		else
+			clear_bit(HISI_MQ_CLASS_DISPATCH,
+				  &hctx->queue->hisi_blk_mq_quirk_flags);
+		return count;
+	}
+
+	if (sscanf(page, "%u %u %u", &class, &rate, &burst) != 3)
+		return -EINVAL;
+	if (class >= HISI_MQ_CLASS_NR || (rate && !burst))
+		return -EINVAL;
+
+	spin_lock_irq(&cd->lock);
+	cd->bucket[class].rate = rate;
+	cd->bucket[class].burst = burst;
+	cd->bucket[class].tokens = burst;
+	spin_unlock_irq(&cd->lock);
+
+	return count;
+}
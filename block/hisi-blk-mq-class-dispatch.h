@@ -0,0 +1,64 @@
+#ifndef _HISI_BLK_MQ_CLASS_DISPATCH_H_
+#define _HISI_BLK_MQ_CLASS_DISPATCH_H_
+
+#include <linux/kernel.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/hisi-blk-mq.h>
+
+/*
+ * Dispatch classes, in priority order. Zero is the default of a
+ * zeroed request (flush_rq, passthrough), so it is flush/meta.
+ */
+enum hisi_mq_dispatch_class {
+	HISI_MQ_CLASS_FLUSH_META	= 0,
+	HISI_MQ_CLASS_SYNC_READ		= 1,
+	HISI_MQ_CLASS_FG_WRITE		= 2,
+	HISI_MQ_CLASS_BG		= 3,
+	HISI_MQ_CLASS_NR,
+};
+
+#ifdef CONFIG_HISI_MQ_CLASS_DISPATCH
+struct hisi_mq_class_bucket {
+	unsigned int		rate;	/* tokens per second, 0 unlimited */
+	unsigned int		burst;
+	unsigned int		tokens;
+	u64			last_refill_ns;
+	unsigned long		last_dispatch;
+	unsigned long		dispatched;
+	unsigned long		held;
+	atomic_t		inflight;
+};
+
+struct hisi_mq_class_dispatch {
+	spinlock_t		lock;
+	struct blk_mq_hw_ctx	*hctx;
+	struct delayed_work	rerun_work;
+	struct hisi_mq_class_bucket bucket[HISI_MQ_CLASS_NR];
+};
+
+int hisi_blk_mq_class_dispatch_init(struct blk_mq_hw_ctx *hctx);
+void hisi_blk_mq_class_dispatch_exit(struct blk_mq_hw_ctx *hctx);
+void hisi_blk_mq_class_classify(struct request *rq);
+void hisi_blk_mq_class_dispatch_reorder(struct blk_mq_hw_ctx *hctx,
+					struct list_head *rq_list);
+void hisi_blk_mq_class_dispatch_done(struct blk_mq_hw_ctx *hctx,
+				     struct request *rq);
+ssize_t hisi_blk_mq_class_dispatch_show(struct blk_mq_hw_ctx *hctx,
+					char *page);
+ssize_t hisi_blk_mq_class_dispatch_store(struct blk_mq_hw_ctx *hctx,
+					 const char *page, size_t count);
+#else /* CONFIG_HISI_MQ_CLASS_DISPATCH */
+static inline int hisi_blk_mq_class_dispatch_init(struct blk_mq_hw_ctx *hctx)
+{
+	return 0;
+}
+static inline void hisi_blk_mq_class_dispatch_exit(struct blk_mq_hw_ctx *hctx) {}
+static inline void hisi_blk_mq_class_classify(struct request *rq) {}
+static inline void hisi_blk_mq_class_dispatch_reorder(struct blk_mq_hw_ctx *hctx,
+		struct list_head *rq_list) {}
+static inline void hisi_blk_mq_class_dispatch_done(struct blk_mq_hw_ctx *hctx,
+		struct request *rq) {}
+#endif /* CONFIG_HISI_MQ_CLASS_DISPATCH */
+
+#endif /* _HISI_BLK_MQ_CLASS_DISPATCH_H_ */
@@ -0,0 +1,299 @@
+/*
+ * hisi blk-mq weighted dispatch between ionice cgroups
+ *
+ * Requests are tagged with the ionice group of their submitter when
+ * they are built from a bio. When several groups have requests queued
+ * or in flight on a hardware context, each dispatch charges the group
+ * a cost of HISI_MQ_IONICE_IO_COST plus one per 4KB, divided by the
+ * group weight, and requests are handed to the driver lowest virtual
+ * time first. A group more than @slack ahead of the slowest active
+ * group is held back on hctx->dispatch until the others caught up or
+ * went idle, so a group gets a share of both the IOPS and the bandwidth
+ * of the queue that follows its weight, and all of it when alone.
+ *
+ * While a group with a latency target is missing it, the groups
+ * without one are charged twice and limited to @pressure_depth
+ * requests in flight.
+ *
+ * Untagged requests (root group, flush, passthrough) are never held.
+ * Completed requests are accounted to their group in any case, see
+ * the ionice.io_stat file of the cgroup.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+
+#include "blk-mq.h"
+#include "hisi-blk-mq-ionice.h"
+
+#define HISI_MQ_IONICE_IO_COST		4
+#define HISI_MQ_IONICE_VSHIFT		8
+#define HISI_MQ_IONICE_SLACK		128
+#define HISI_MQ_IONICE_PRESSURE_DEPTH	4
+#define HISI_MQ_IONICE_RERUN_MS		2
+
+void hisi_blk_mq_ionice_set_request(struct request *rq)
+{
+	rq->mq_ionice_grp = (unsigned char)ionice_current_group();
+	rq->mq_ionice_counted = 0;
+	rq->mq_ionice_bytes = blk_rq_bytes(rq);
+	rq->mq_ionice_start_ns = sched_clock();
+}
+
+static u64 hisi_mq_ionice_cost(struct request *rq, unsigned int id,
+			       bool penalty)
+{
+	u64 cost = HISI_MQ_IONICE_IO_COST + (rq->mq_ionice_bytes >> 12);
+	unsigned int weight = ionice_group_weight(id);
+
+	if (!weight)
+		weight = IONICE_WEIGHT_DEFAULT;
+	cost = div_u64((cost << HISI_MQ_IONICE_VSHIFT) * IONICE_WEIGHT_DEFAULT,
+		       weight);
+
+	return penalty ? cost << 1 : cost;
+}
+
+static u64 hisi_mq_ionice_vmin(struct hisi_mq_ionice *iw,
+			       unsigned long active)
+{
+	u64 vmin = U64_MAX;
+	int id;
+
+	for_each_set_bit(id, &active, IONICE_MAX_GROUPS)
+		vmin = min(vmin, iw->grp[id].vtime);
+
+	return vmin == U64_MAX ? iw->vclock : vmin;
+}
+
+void hisi_blk_mq_ionice_dispatch(struct blk_mq_hw_ctx *hctx,
+				 struct list_head *rq_list)
+{
+	struct hisi_mq_ionice *iw = hctx->ionice;
+	struct list_head lists[IONICE_MAX_GROUPS];
+	unsigned long pending = 0, active, ready;
+	u64 slack, vmin;
+	struct request *rq, *next;
+	unsigned long flags;
+	LIST_HEAD(out);
+	LIST_HEAD(held);
+	bool pressure;
+	int id, best;
+
+	if (!iw || !hisi_blk_mq_test_queue_quirk(hctx->queue,
+						 HISI_MQ_IONICE_WEIGHT))
+		return;
+
+	list_for_each_entry_safe(rq, next, rq_list, queuelist) {
+		id = rq->mq_ionice_grp;
+		if (!id || id >= IONICE_MAX_GROUPS ||
+		    rq->cmd_type != REQ_TYPE_FS || rq->mq_ionice_counted) {
+			list_move_tail(&rq->queuelist, &out);
+			continue;
+		}
+		if (!test_and_set_bit(id, &pending))
+			INIT_LIST_HEAD(&lists[id]);
+		list_move_tail(&rq->queuelist, &lists[id]);
+	}
+
+	if (!pending)
+		goto splice;
+
+	pressure = ionice_latency_pressure();
+
+	spin_lock_irqsave(&iw->lock, flags);
+	active = pending;
+	for (id = 1; id < IONICE_MAX_GROUPS; id++)
+		if (atomic_read(&iw->grp[id].inflight))
+			__set_bit(id, &active);
+
+	/* a group coming back from idle earns no credit for it */
+	for_each_set_bit(id, &pending, IONICE_MAX_GROUPS)
+		if (!atomic_read(&iw->grp[id].inflight))
+			iw->grp[id].vtime = max(iw->grp[id].vtime, iw->vclock);
+
+	slack = (u64)iw->slack << HISI_MQ_IONICE_VSHIFT;
+	if (pressure)
+		iw->nr_pressure++;
+
+	ready = pending;
+	while (ready) {
+		struct hisi_mq_ionice_group *g;
+		bool penalty;
+
+		vmin = hisi_mq_ionice_vmin(iw, active);
+		iw->vclock = max(iw->vclock, vmin);
+
+		best = -1;
+		for_each_set_bit(id, &ready, IONICE_MAX_GROUPS)
+			if (best < 0 || iw->grp[id].vtime < iw->grp[best].vtime)
+				best = id;
+
+		g = &iw->grp[best];
+		penalty = pressure && !ionice_group_has_target(best);
+		if ((hweight_long(active) > 1 && g->vtime > vmin + slack) ||
+		    (penalty && atomic_read(&g->inflight) >=
+				iw->pressure_depth)) {
+			__clear_bit(best, &ready);
+			continue;
+		}
+
+		rq = list_first_entry(&lists[best], struct request, queuelist);
+		list_move_tail(&rq->queuelist, &out);
+		rq->mq_ionice_counted = 1;
+		atomic_inc(&g->inflight);
+		g->vtime += hisi_mq_ionice_cost(rq, best, penalty);
+		g->dispatched++;
+
+		if (list_empty(&lists[best]))
+			__clear_bit(best, &ready);
+	}
+
+	for_each_set_bit(id, &pending, IONICE_MAX_GROUPS) {
+		list_for_each_entry(rq, &lists[id], queuelist)
+			iw->grp[id].held++;
+		list_splice_tail_init(&lists[id], &held);
+	}
+	spin_unlock_irqrestore(&iw->lock, flags);
+
+	if (!list_empty(&held)) {
+		spin_lock(&hctx->lock);
+		list_splice_tail_init(&held, &hctx->dispatch);
+		spin_unlock(&hctx->lock);
+
+		kblockd_schedule_delayed_work(&iw->rerun_work,
+				msecs_to_jiffies(HISI_MQ_IONICE_RERUN_MS));
+	}
+
+splice:
+	list_splice_tail(&out, rq_list);
+}
+
+void hisi_blk_mq_ionice_done(struct blk_mq_hw_ctx *hctx, struct request *rq)
+{
+	struct hisi_mq_ionice *iw = hctx->ionice;
+	unsigned int id = rq->mq_ionice_grp;
+
+	if (rq->mq_ionice_start_ns && id < IONICE_MAX_GROUPS)
+		ionice_io_done(id, rq_data_dir(rq), rq->mq_ionice_bytes,
+			       sched_clock() - rq->mq_ionice_start_ns);
+
+	if (iw && rq->mq_ionice_counted && id < IONICE_MAX_GROUPS)
+		atomic_dec(&iw->grp[id].inflight);
+
+	rq->mq_ionice_grp = 0;
+	rq->mq_ionice_counted = 0;
+	rq->mq_ionice_start_ns = 0;
+}
+
+static void hisi_mq_ionice_rerun_work_fn(struct work_struct *work)
+{
+	struct hisi_mq_ionice *iw = container_of(work,
+			struct hisi_mq_ionice, rerun_work.work);/*lint !e826*/
+
+	blk_mq_run_hw_queue(iw->hctx, true);
+}
+
+int hisi_blk_mq_ionice_init(struct blk_mq_hw_ctx *hctx)
+{
+	struct hisi_mq_ionice *iw;
+	int id;
+
+	iw = kzalloc_node(sizeof(*iw), GFP_KERNEL, hctx->numa_node);
+	if (!iw)
+		return -ENOMEM;
+
+	spin_lock_init(&iw->lock);
+	iw->hctx = hctx;
+	iw->slack = HISI_MQ_IONICE_SLACK;
+	iw->pressure_depth = HISI_MQ_IONICE_PRESSURE_DEPTH;
+	INIT_DELAYED_WORK(&iw->rerun_work, hisi_mq_ionice_rerun_work_fn);
+	for (id = 0; id < IONICE_MAX_GROUPS; id++)
+		atomic_set(&iw->grp[id].inflight, 0);
+
+	hctx->ionice = iw;
+	return 0;
+}
+
+void hisi_blk_mq_ionice_exit(struct blk_mq_hw_ctx *hctx)
+{
+	struct hisi_mq_ionice *iw = hctx->ionice;
+
+	if (!iw)
+		return;
+
+	cancel_delayed_work_sync(&iw->rerun_work);
+	hctx->ionice = NULL;
+	kfree(iw);
+}
+
+ssize_t hisi_blk_mq_ionice_show(struct blk_mq_hw_ctx *hctx, char *page)
+{
+	struct hisi_mq_ionice *iw = hctx->ionice;
+	unsigned long flags;
+	ssize_t ret;
+	int id;
+
+	if (!iw)
+		return -EINVAL;
+
+	spin_lock_irqsave(&iw->lock, flags);
+	ret = sprintf(page, "enabled=%d, slack=%u, pressure_depth=%u, pressure=%lu\n",
+		      hisi_blk_mq_test_queue_quirk(hctx->queue,
+						   HISI_MQ_IONICE_WEIGHT),
+		      iw->slack, iw->pressure_depth, iw->nr_pressure);
+	for (id = 1; id < IONICE_MAX_GROUPS; id++) {
+		struct hisi_mq_ionice_group *g = &iw->grp[id];
+
+		if (!g->dispatched && !g->held)
+			continue;
+		ret += sprintf(page + ret,
+			       "group%d: weight=%u, vtime=%llu, inflight=%d, dispatched=%lu, held=%lu\n",
+			       id, ionice_group_weight(id),
+			       g->vtime >> HISI_MQ_IONICE_VSHIFT,
+			       atomic_read(&g->inflight),
+			       g->dispatched, g->held);
+	}
+	spin_unlock_irqrestore(&iw->lock, flags);
+
+	return ret;
+}
+
+/* "enable <0|1>", "slack <cost>" or "pressure_depth <n>" */
+ssize_t hisi_blk_mq_ionice_store(struct blk_mq_hw_ctx *hctx,
+				 const char *page, size_t count)
+{
+	struct hisi_mq_ionice *iw = hctx->ionice;
+	unsigned long flags;
+	unsigned int val;
+	ssize_t ret = (ssize_t)count;
+
+	if (!iw)
+		return -EINVAL;
+
+	if (sscanf(page, "enable %u", &val) == 1) {
+		if (val)
+			set_bit(HISI_MQ_IONICE_WEIGHT,
+				&hctx->queue->hisi_blk_mq_quirk_flags);
+		else
+			clear_bit(HISI_MQ_IONICE_WEIGHT,
+				  &hctx->queue->hisi_blk_mq_quirk_flags);
+		blk_mq_run_hw_queue(hctx, true);
+		return count;
+	}
+
+	spin_lock_irqsave(&iw->lock, flags);
+	if (sscanf(page, "slack %u", &val) == 1)
+		iw->slack = val;
+	else if (sscanf(page, "pressure_depth %u", &val) == 1 && val)
+		iw->pressure_depth = val;
+	else
+		ret = -EINVAL;
+	spin_unlock_irqrestore(&iw->lock, flags);
+
+	return ret;
+}
@@ -0,0 +1,66 @@
+#ifndef _HISI_BLK_MQ_IONICE_H_
+#define _HISI_BLK_MQ_IONICE_H_
+
+#include <linux/kernel.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/cgroup_ionice.h>
+#include <linux/hisi-blk-mq.h>
+
+#ifdef CONFIG_HISI_MQ_IONICE_WEIGHT
+/**
+ * struct hisi_mq_ionice_group - per-hctx state of an ionice group
+ * @vtime:	service received, in cost units scaled by the weight
+ * @inflight:	requests handed to the driver and not freed yet
+ * @dispatched:	requests handed to the driver
+ * @held:	times a request was held back for a later run
+ */
+struct hisi_mq_ionice_group {
+	u64			vtime;
+	atomic_t		inflight;
+	unsigned long		dispatched;
+	unsigned long		held;
+};
+
+/**
+ * struct hisi_mq_ionice - per-hctx weighted dispatch state
+ * @lock:		protects everything below but the inflight counts
+ * @vclock:		lowest vtime of the active groups
+ * @slack:		vtime a group may run ahead of the slowest one
+ * @pressure_depth:	inflight limit of the groups without a latency
+ *			target while a target is missed
+ */
+struct hisi_mq_ionice {
+	spinlock_t		lock;
+	struct blk_mq_hw_ctx	*hctx;
+	struct delayed_work	rerun_work;
+	u64			vclock;
+	unsigned int		slack;
+	unsigned int		pressure_depth;
+	unsigned long		nr_pressure;
+	struct hisi_mq_ionice_group grp[IONICE_MAX_GROUPS];
+};
+
+int hisi_blk_mq_ionice_init(struct blk_mq_hw_ctx *hctx);
+void hisi_blk_mq_ionice_exit(struct blk_mq_hw_ctx *hctx);
+void hisi_blk_mq_ionice_set_request(struct request *rq);
+void hisi_blk_mq_ionice_dispatch(struct blk_mq_hw_ctx *hctx,
+				 struct list_head *rq_list);
+void hisi_blk_mq_ionice_done(struct blk_mq_hw_ctx *hctx, struct request *rq);
+ssize_t hisi_blk_mq_ionice_show(struct blk_mq_hw_ctx *hctx, char *page);
+ssize_t hisi_blk_mq_ionice_store(struct blk_mq_hw_ctx *hctx,
+				 const char *page, size_t count);
+#else /* CONFIG_HISI_MQ_IONICE_WEIGHT */
+static inline int hisi_blk_mq_ionice_init(struct blk_mq_hw_ctx *hctx)
+{
+	return 0;
+}
+static inline void hisi_blk_mq_ionice_exit(struct blk_mq_hw_ctx *hctx) {}
+static inline void hisi_blk_mq_ionice_set_request(struct request *rq) {}
+static inline void hisi_blk_mq_ionice_dispatch(struct blk_mq_hw_ctx *hctx,
+		struct list_head *rq_list) {}
+static inline void hisi_blk_mq_ionice_done(struct blk_mq_hw_ctx *hctx,
+		struct request *rq) {}
+#endif /* CONFIG_HISI_MQ_IONICE_WEIGHT */
+
+#endif /* _HISI_BLK_MQ_IONICE_H_ */
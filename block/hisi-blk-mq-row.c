@@ -0,0 +1,505 @@
+/*
+ * ROW (Read Over Write) dispatch policy for hisi blk-mq.
+ *
+ * This is the policy of the legacy ROW elevator (row-iosched.c) run
+ * from the blk-mq hardware queue dispatch path: requests pulled from
+ * the software queues are parked in per-hctx priority fifos and handed
+ * to the driver by row_dispatch order, with the same quantums,
+ * starvation limits and read idling. All state is per hctx under its
+ * own lock, the queue_lock is never taken.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/ioprio.h>
+#include <linux/iocontext.h>
+#include <linux/slab.h>
+#include <linux/hrtimer.h>
+#include <linux/workqueue.h>
+
+#include "blk-mq.h"
+#include "hisi-blk-mq-row.h"
+
+/* Default values for idling on read queues (in msec) */
+#define MQ_ROW_IDLE_TIME_MSEC		5
+#define MQ_ROW_READ_FREQ_MSEC		5
+
+#define MQ_ROW_REG_STARVATION_TOLLERANCE	5000
+#define MQ_ROW_LOW_STARVATION_TOLLERANCE	10000
+
+/*
+ * {idling_enabled, quantum} of each queue, same defaults as the
+ * legacy ROW elevator: for every 100 regular reads one regular
+ * write is dispatched.
+ */
+static const struct {
+	bool idling_enabled;
+	unsigned int quantum;
+} mq_row_queues_def[MQ_ROWQ_MAX_PRIO] = {
+	{true, 10},	/* MQ_ROWQ_PRIO_HIGH_READ */
+	{false, 1},	/* MQ_ROWQ_PRIO_HIGH_SWRITE */
+	{true, 100},	/* MQ_ROWQ_PRIO_REG_READ */
+	{false, 1},	/* MQ_ROWQ_PRIO_REG_SWRITE */
+	{false, 1},	/* MQ_ROWQ_PRIO_REG_WRITE */
+	{false, 1},	/* MQ_ROWQ_PRIO_LOW_READ */
+	{false, 1},	/* MQ_ROWQ_PRIO_LOW_SWRITE */
+};
+
+/*
+ * Called at bio-to-request time, so the ioprio of the submitter is
+ * still at hand.
+ */
+void hisi_blk_mq_row_set_request(struct request *rq)
+{
+	const int data_dir = rq_data_dir(rq);
+	const bool is_sync = rq_is_sync(rq);
+	int prio = req_get_ioprio(rq);
+	enum hisi_mq_row_prio q_type;
+
+	if (!ioprio_valid(prio) && current->io_context)
+		prio = current->io_context->ioprio;
+
+	switch (IOPRIO_PRIO_CLASS(prio)) {
+	case IOPRIO_CLASS_RT:
+		if (data_dir == READ)
+			q_type = MQ_ROWQ_PRIO_HIGH_READ;
+		else if (is_sync)
+			q_type = MQ_ROWQ_PRIO_HIGH_SWRITE;
+		else
+			q_type = MQ_ROWQ_PRIO_REG_WRITE;
+		break;
+	case IOPRIO_CLASS_IDLE:
+		if (data_dir == READ)
+			q_type = MQ_ROWQ_PRIO_LOW_READ;
+		else if (is_sync)
+			q_type = MQ_ROWQ_PRIO_LOW_SWRITE;
+		else
+			q_type = MQ_ROWQ_PRIO_REG_WRITE;
+		break;
+	case IOPRIO_CLASS_NONE:
+	case IOPRIO_CLASS_BE:
+	default:
+		if (data_dir == READ)
+			q_type = MQ_ROWQ_PRIO_REG_READ;
+		else if (is_sync)
+			q_type = MQ_ROWQ_PRIO_REG_SWRITE;
+		else
+			q_type = MQ_ROWQ_PRIO_REG_WRITE;
+		break;
+	}
+
+	rq->mq_row_prio = (unsigned char)q_type;
+	rq->mq_row_dispatched = 0;
+}
+
+static inline bool mq_row_bypass(struct request *rq)
+{
+	return rq->cmd_type != REQ_TYPE_FS ||
+		(rq->cmd_flags & (REQ_FLUSH | REQ_FUA | REQ_FLUSH_SEQ)) ||
+		rq->mq_row_prio >= MQ_ROWQ_MAX_PRIO;
+}
+
+static inline bool mq_row_regular_req_pending(struct hisi_mq_row_data *rd)
+{
+	int i;
+
+	for (i = MQ_ROWQ_REG_PRIO_IDX; i < MQ_ROWQ_LOW_PRIO_IDX; i++)
+		if (!list_empty(&rd->row_queues[i].fifo))
+			return true;
+	return false;
+}
+
+static inline bool mq_row_low_req_pending(struct hisi_mq_row_data *rd)
+{
+	int i;
+
+	for (i = MQ_ROWQ_LOW_PRIO_IDX; i < MQ_ROWQ_MAX_PRIO; i++)
+		if (!list_empty(&rd->row_queues[i].fifo))
+			return true;
+	return false;
+}
+
+static void mq_row_cancel_idling(struct hisi_mq_row_data *rd)
+{
+	if (hrtimer_active(&rd->idle_timer) &&
+	    hrtimer_try_to_cancel(&rd->idle_timer) >= 0)
+		rd->idling_queue_idx = MQ_ROWQ_MAX_PRIO;
+}
+
+static void mq_row_add_request(struct hisi_mq_row_data *rd,
+			       struct request *rq)
+{
+	struct hisi_mq_row_queue *rqueue = &rd->row_queues[rq->mq_row_prio];
+	s64 diff_ms;
+
+	rd->nr_reqs[rq_data_dir(rq)]++;
+	rqueue->nr_req++;
+
+	/* Pushed back by the driver, keep its place at the head */
+	if (rq->mq_row_dispatched) {
+		rq->mq_row_dispatched = 0;
+		list_add(&rq->queuelist, &rqueue->fifo);
+		return;
+	}
+
+	list_add_tail(&rq->queuelist, &rqueue->fifo);
+
+	if (!mq_row_queues_def[rq->mq_row_prio].idling_enabled)
+		return;
+
+	if (rd->idling_queue_idx == rq->mq_row_prio)
+		mq_row_cancel_idling(rd);
+
+	diff_ms = ktime_to_ms(ktime_sub(ktime_get(),
+					rqueue->last_insert_time));
+	rqueue->begin_idling = diff_ms >= 0 && diff_ms < rd->read_freq_ms;
+	rqueue->last_insert_time = ktime_get();
+}
+
+static void mq_row_dispatch_insert(struct hisi_mq_row_data *rd,
+				   int prio, struct list_head *out)
+{
+	struct hisi_mq_row_queue *rqueue = &rd->row_queues[prio];
+	struct request *rq;
+
+	rq = list_first_entry(&rqueue->fifo, struct request, queuelist);
+	list_move_tail(&rq->queuelist, out);
+	rq->mq_row_dispatched = 1;
+	rqueue->nr_req--;
+	rd->nr_reqs[rq_data_dir(rq)]--;
+	rqueue->nr_dispatched++;
+	rd->cycle_flags &= ~(1 << prio);
+
+	if (prio < MQ_ROWQ_REG_PRIO_IDX) {
+		if (mq_row_regular_req_pending(rd))
+			rd->reg_starvation++;
+		if (mq_row_low_req_pending(rd))
+			rd->low_starvation++;
+	} else if (prio < MQ_ROWQ_LOW_PRIO_IDX) {
+		rd->reg_starvation = 0;
+		if (mq_row_low_req_pending(rd))
+			rd->low_starvation++;
+	} else {
+		rd->low_starvation = 0;
+	}
+}
+
+/*
+ * Same decision as row_get_ioprio_class_to_serve() without forced
+ * dispatch and urgent requests.
+ */
+static int mq_row_get_ioprio_class_to_serve(struct hisi_mq_row_data *rd)
+{
+	int i;
+
+	if (!rd->nr_reqs[READ] && !rd->nr_reqs[WRITE])
+		return IOPRIO_CLASS_NONE;
+
+	for (i = 0; i < MQ_ROWQ_REG_PRIO_IDX; i++) {
+		if (list_empty(&rd->row_queues[i].fifo))
+			continue;
+
+		mq_row_cancel_idling(rd);
+		if (mq_row_regular_req_pending(rd) &&
+		    rd->reg_starvation >= rd->reg_starvation_limit)
+			return IOPRIO_CLASS_BE;
+		if (mq_row_low_req_pending(rd) &&
+		    rd->low_starvation >= rd->low_starvation_limit)
+			return IOPRIO_CLASS_IDLE;
+		return IOPRIO_CLASS_RT;
+	}
+
+	if (hrtimer_active(&rd->idle_timer))
+		return IOPRIO_CLASS_NONE;
+
+	for (i = 0; i < MQ_ROWQ_REG_PRIO_IDX; i++) {
+		if (rd->row_queues[i].begin_idling &&
+		    mq_row_queues_def[i].idling_enabled)
+			goto initiate_idling;
+	}
+
+	for (i = MQ_ROWQ_REG_PRIO_IDX; i < MQ_ROWQ_LOW_PRIO_IDX; i++) {
+		if (list_empty(&rd->row_queues[i].fifo)) {
+			if (rd->row_queues[i].begin_idling &&
+			    mq_row_queues_def[i].idling_enabled)
+				goto initiate_idling;
+		} else {
+			if (mq_row_low_req_pending(rd) &&
+			    rd->low_starvation >= rd->low_starvation_limit)
+				return IOPRIO_CLASS_IDLE;
+			return IOPRIO_CLASS_BE;
+		}
+	}
+
+	return IOPRIO_CLASS_IDLE;
+
+initiate_idling:
+	hrtimer_start(&rd->idle_timer,
+		      ktime_set(0, rd->idle_time_ms * NSEC_PER_MSEC),
+		      HRTIMER_MODE_REL);
+	rd->idling_queue_idx = i;
+	rd->nr_idled++;
+	return IOPRIO_CLASS_NONE;
+}
+
+static int mq_row_get_next_queue(struct hisi_mq_row_data *rd,
+				 int start_idx, int end_idx)
+{
+	int i = start_idx;
+	bool restart = true;
+
+	do {
+		struct hisi_mq_row_queue *rqueue = &rd->row_queues[i];
+
+		if (!list_empty(&rqueue->fifo) &&
+		    rqueue->nr_dispatched < rqueue->disp_quantum)
+			return i;
+
+		if (++i == end_idx && restart) {
+			/* Restart cycle for this priority class */
+			for (i = start_idx; i < end_idx; i++) {
+				if (rd->row_queues[i].nr_dispatched <
+				    rd->row_queues[i].disp_quantum)
+					rd->cycle_flags |= (1 << i);
+				rd->row_queues[i].nr_dispatched = 0;
+			}
+			i = start_idx;
+			restart = false;
+		}
+	} while (i < end_idx);
+
+	return -EIO;
+}
+
+bool hisi_blk_mq_row_pending(struct blk_mq_hw_ctx *hctx)
+{
+	struct hisi_mq_row_data *rd = hctx->row_data;
+
+	return rd && (READ_ONCE(rd->nr_reqs[READ]) ||
+		      READ_ONCE(rd->nr_reqs[WRITE]));
+}
+
+/*
+ * hisi_blk_mq_row_dispatch() - reorder the hctx dispatch list
+ * @hctx:	hardware queue being run
+ * @rq_list:	requests pulled from the software queues, replaced by
+ *		the requests to hand to the driver now
+ * @budget:	max number of requests to release in this run
+ *
+ * Flush and passthrough requests are never held. The remaining
+ * requests stay in the ROW fifos until a later run, which the idle
+ * timer or the next completion triggers.
+ */
+void hisi_blk_mq_row_dispatch(struct blk_mq_hw_ctx *hctx,
+			      struct list_head *rq_list, unsigned int budget)
+{
+	struct hisi_mq_row_data *rd = hctx->row_data;
+	struct request *rq, *next;
+	LIST_HEAD(out);
+	unsigned long flags;
+	unsigned int nr = 0;
+	bool enabled;
+	int i;
+
+	if (!rd)
+		return;
+
+	enabled = hisi_blk_mq_test_queue_quirk(hctx->queue, HISI_MQ_ROW);
+	if (!enabled && !hisi_blk_mq_row_pending(hctx))
+		return;
+
+	spin_lock_irqsave(&rd->lock, flags);
+	list_for_each_entry_safe(rq, next, rq_list, queuelist) {
+		if (!enabled || mq_row_bypass(rq)) {
+			list_move_tail(&rq->queuelist, &out);
+			continue;
+		}
+		list_del_init(&rq->queuelist);
+		mq_row_add_request(rd, rq);
+	}
+
+	if (!enabled) {
+		/* Switched off: give back whatever is still parked */
+		for (i = 0; i < MQ_ROWQ_MAX_PRIO; i++) {
+			list_splice_tail_init(&rd->row_queues[i].fifo, &out);
+			rd->row_queues[i].nr_req = 0;
+		}
+		rd->nr_reqs[READ] = rd->nr_reqs[WRITE] = 0;
+		mq_row_cancel_idling(rd);
+		goto unlock;
+	}
+
+	while (nr < budget) {
+		int start_idx, end_idx, currq;
+
+		switch (mq_row_get_ioprio_class_to_serve(rd)) {
+		case IOPRIO_CLASS_RT:
+			start_idx = MQ_ROWQ_HIGH_PRIO_IDX;
+			end_idx = MQ_ROWQ_REG_PRIO_IDX;
+			break;
+		case IOPRIO_CLASS_BE:
+			start_idx = MQ_ROWQ_REG_PRIO_IDX;
+			end_idx = MQ_ROWQ_LOW_PRIO_IDX;
+			break;
+		case IOPRIO_CLASS_IDLE:
+			start_idx = MQ_ROWQ_LOW_PRIO_IDX;
+			end_idx = MQ_ROWQ_MAX_PRIO;
+			break;
+		case IOPRIO_CLASS_NONE:
+		default:
+			goto unlock;
+		}
+
+		currq = mq_row_get_next_queue(rd, start_idx, end_idx);
+		if (currq < 0)
+			break;
+
+		mq_row_dispatch_insert(rd, currq, &out);
+		nr++;
+	}
+unlock:
+	spin_unlock_irqrestore(&rd->lock, flags);
+
+	list_splice_init(&out, rq_list);
+}
+
+static void mq_row_kick_hctx(struct work_struct *work)
+{
+	struct hisi_mq_row_data *rd =
+		container_of(work, struct hisi_mq_row_data, idle_work);
+
+	blk_mq_run_hw_queue(rd->hctx, true);
+}
+
+static enum hrtimer_restart mq_row_idle_hrtimer_fn(struct hrtimer *hr_timer)
+{
+	struct hisi_mq_row_data *rd =
+		container_of(hr_timer, struct hisi_mq_row_data, idle_timer);
+	unsigned long flags;
+	bool pending;
+
+	spin_lock_irqsave(&rd->lock, flags);
+	/* Mark idling process as done */
+	if (rd->idling_queue_idx < MQ_ROWQ_MAX_PRIO)
+		rd->row_queues[rd->idling_queue_idx].begin_idling = false;
+	rd->idling_queue_idx = MQ_ROWQ_MAX_PRIO;
+	pending = rd->nr_reqs[READ] || rd->nr_reqs[WRITE];
+	spin_unlock_irqrestore(&rd->lock, flags);
+
+	if (pending)
+		kblockd_schedule_work(&rd->idle_work);
+	return HRTIMER_NORESTART;
+}
+
+int hisi_blk_mq_row_init(struct blk_mq_hw_ctx *hctx)
+{
+	struct hisi_mq_row_data *rd;
+	int i;
+
+	rd = kzalloc_node(sizeof(*rd), GFP_KERNEL, hctx->numa_node);
+	if (!rd)
+		return -ENOMEM;
+
+	spin_lock_init(&rd->lock);
+	rd->hctx = hctx;
+	for (i = 0; i < MQ_ROWQ_MAX_PRIO; i++) {
+		INIT_LIST_HEAD(&rd->row_queues[i].fifo);
+		rd->row_queues[i].disp_quantum = mq_row_queues_def[i].quantum;
+		rd->row_queues[i].last_insert_time = ktime_set(0, 0);
+	}
+
+	rd->reg_starvation_limit = MQ_ROW_REG_STARVATION_TOLLERANCE;
+	rd->low_starvation_limit = MQ_ROW_LOW_STARVATION_TOLLERANCE;
+	rd->idle_time_ms = MQ_ROW_IDLE_TIME_MSEC;
+	rd->read_freq_ms = MQ_ROW_READ_FREQ_MSEC;
+	rd->idling_queue_idx = MQ_ROWQ_MAX_PRIO;
+	hrtimer_init(&rd->idle_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	rd->idle_timer.function = &mq_row_idle_hrtimer_fn;
+	INIT_WORK(&rd->idle_work, mq_row_kick_hctx);
+
+	hctx->row_data = rd;
+	return 0;
+}
+
+void hisi_blk_mq_row_exit(struct blk_mq_hw_ctx *hctx)
+{
+	struct hisi_mq_row_data *rd = hctx->row_data;
+
+	if (!rd)
+		return;
+
+	WARN_ON(rd->nr_reqs[READ] || rd->nr_reqs[WRITE]);
+	hrtimer_cancel(&rd->idle_timer);
+	cancel_work_sync(&rd->idle_work);
+	hctx->row_data = NULL;
+	kfree(rd);
+}
+
+ssize_t hisi_blk_mq_row_show(struct blk_mq_hw_ctx *hctx, char *page)
+{
+	struct hisi_mq_row_data *rd = hctx->row_data;
+	unsigned long flags;
+	ssize_t ret;
+	int i;
+
+	if (!rd)
+		return -EINVAL;
+
+	spin_lock_irqsave(&rd->lock, flags);
+	ret = sprintf(page, "enabled=%d, idle_time_ms=%lld, read_freq_ms=%lld, idled=%lu\n",
+		      hisi_blk_mq_test_queue_quirk(hctx->queue, HISI_MQ_ROW),
+		      (long long)rd->idle_time_ms,
+		      (long long)rd->read_freq_ms, rd->nr_idled);
+	for (i = 0; i < MQ_ROWQ_MAX_PRIO; i++)
+		ret += sprintf(page + ret,
+			       "queue%d: quantum=%u, dispatched=%u, nr_req=%u\n",
+			       i, rd->row_queues[i].disp_quantum,
+			       rd->row_queues[i].nr_dispatched,
+			       rd->row_queues[i].nr_req);
+	spin_unlock_irqrestore(&rd->lock, flags);
+
+	return ret;
+}
+
+/*
+ * "enable <0|1>", "quantum <queue> <n>", "idle_time <ms>" or
+ * "read_freq <ms>".
+ */
+ssize_t hisi_blk_mq_row_store(struct blk_mq_hw_ctx *hctx,
+			      const char *page, size_t count)
+{
+	struct hisi_mq_row_data *rd = hctx->row_data;
+	unsigned long flags;
+	unsigned int idx, val;
+	ssize_t ret = (ssize_t)count;
+
+	if (!rd)
+		return -EINVAL;
+
+	if (sscanf(page, "enable %u", &val) == 1) {
+		if (val)
+			set_bit(HISI_MQ_ROW,
+				&hctx->queue->hisi_blk_mq_quirk_flags);
+		else
+			clear_bit(HISI_MQ_ROW,
+				  &hctx->queue->hisi_blk_mq_quirk_flags);
+		/* let the parked requests out if switched off */
+		blk_mq_run_hw_queue(hctx, true);
+		return count;
+	}
+
+	spin_lock_irqsave(&rd->lock, flags);
+	if (sscanf(page, "quantum %u %u", &idx, &val) == 2 &&
+	    idx < MQ_ROWQ_MAX_PRIO && val)
+		rd->row_queues[idx].disp_quantum = val;
+	else if (sscanf(page, "idle_time %u", &val) == 1)
+		rd->idle_time_ms = val;
+	else if (sscanf(page, "read_freq %u", &val) == 1)
+		rd->read_freq_ms = val;
+	else
+		ret = -EINVAL;
+	spin_unlock_irqrestore(&rd->lock, flags);
+
+	return ret;
+}
@@ -0,0 +1,108 @@
+#ifndef _HISI_BLK_MQ_ROW_H_
+#define _HISI_BLK_MQ_ROW_H_
+
+#include <linux/kernel.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/hrtimer.h>
+#include <linux/hisi-blk-mq.h>
+
+/*
+ * enum hisi_mq_row_prio - Priorities of the blk-mq ROW queues
+ *
+ * Same queues as the legacy ROW elevator (see row-iosched.c), the
+ * first queue of each priority group is given by the *_IDX below.
+ */
+enum hisi_mq_row_prio {
+	MQ_ROWQ_PRIO_HIGH_READ = 0,
+	MQ_ROWQ_PRIO_HIGH_SWRITE,
+	MQ_ROWQ_PRIO_REG_READ,
+	MQ_ROWQ_PRIO_REG_SWRITE,
+	MQ_ROWQ_PRIO_REG_WRITE,
+	MQ_ROWQ_PRIO_LOW_READ,
+	MQ_ROWQ_PRIO_LOW_SWRITE,
+	MQ_ROWQ_MAX_PRIO,
+};
+
+#define MQ_ROWQ_HIGH_PRIO_IDX	MQ_ROWQ_PRIO_HIGH_READ
+#define MQ_ROWQ_REG_PRIO_IDX	MQ_ROWQ_PRIO_REG_READ
+#define MQ_ROWQ_LOW_PRIO_IDX	MQ_ROWQ_PRIO_LOW_READ
+
+#ifdef CONFIG_HISI_MQ_ROW
+/**
+ * struct hisi_mq_row_queue - per-hctx ROW request fifo
+ * @fifo:		fifo of requests
+ * @nr_req:		number of requests in the fifo
+ * @nr_dispatched:	requests dispatched in the current cycle
+ * @disp_quantum:	requests this queue may dispatch per cycle
+ * @last_insert_time:	time the last request was inserted
+ * @begin_idling:	idle on this queue once it runs empty
+ */
+struct hisi_mq_row_queue {
+	struct list_head	fifo;
+	unsigned int		nr_req;
+	unsigned int		nr_dispatched;
+	unsigned int		disp_quantum;
+	ktime_t			last_insert_time;
+	bool			begin_idling;
+};
+
+/**
+ * struct hisi_mq_row_data - per-hctx ROW state
+ * @lock:		protects everything below, per hctx so no
+ *			queue_lock is ever taken
+ * @nr_reqs:		READ/WRITE requests held in the fifos
+ * @idle_time_ms:	idling duration
+ * @read_freq_ms:	max gap between two reads that enables idling
+ * @idle_timer:		idling timer
+ * @idle_work:		reruns the hctx when idling ends
+ * @idling_queue_idx:	queue being idled on, MQ_ROWQ_MAX_PRIO if none
+ * @reg_starvation:	high prio dispatches while regular pending
+ * @low_starvation:	higher prio dispatches while low pending
+ * @cycle_flags:	queues left unserved in the last cycle
+ */
+struct hisi_mq_row_data {
+	spinlock_t		lock;
+	struct blk_mq_hw_ctx	*hctx;
+	struct hisi_mq_row_queue row_queues[MQ_ROWQ_MAX_PRIO];
+	unsigned int		nr_reqs[2];
+
+	s64			idle_time_ms;
+	s64			read_freq_ms;
+	struct hrtimer		idle_timer;
+	struct work_struct	idle_work;
+	enum hisi_mq_row_prio	idling_queue_idx;
+
+	unsigned int		reg_starvation;
+	unsigned int		reg_starvation_limit;
+	unsigned int		low_starvation;
+	unsigned int		low_starvation_limit;
+	unsigned int		cycle_flags;
+	unsigned long		nr_idled;
+};
+
+int hisi_blk_mq_row_init(struct blk_mq_hw_ctx *hctx);
+void hisi_blk_mq_row_exit(struct blk_mq_hw_ctx *hctx);
+void hisi_blk_mq_row_set_request(struct request *rq);
+bool hisi_blk_mq_row_pending(struct blk_mq_hw_ctx *hctx);
+void hisi_blk_mq_row_dispatch(struct blk_mq_hw_ctx *hctx,
+			      struct list_head *rq_list, unsigned int budget);
+ssize_t hisi_blk_mq_row_show(struct blk_mq_hw_ctx *hctx, char *page);
+ssize_t hisi_blk_mq_row_store(struct blk_mq_hw_ctx *hctx,
+			      const char *page, size_t count);
+#else /* CONFIG_HISI_MQ_ROW */
+static inline int hisi_blk_mq_row_init(struct blk_mq_hw_ctx *hctx)
+{
+	return 0;
+}
+static inline void hisi_blk_mq_row_exit(struct blk_mq_hw_ctx *hctx) {}
+static inline void hisi_blk_mq_row_set_request(struct request *rq) {}
+static inline bool hisi_blk_mq_row_pending(struct blk_mq_hw_ctx *hctx)
+{
+	return false;
+}
+static inline void hisi_blk_mq_row_dispatch(struct blk_mq_hw_ctx *hctx,
+		struct list_head *rq_list, unsigned int budget) {}
+#endif /* CONFIG_HISI_MQ_ROW */
+
+#endif /* _HISI_BLK_MQ_ROW_H_ */
@@ -8,6 +8,71 @@
 
 #define MQ_MERGE_MAX_SIZE 0x40000
 
+/*
+ * Bounds of the delayed flush window and the weight (1/2^N) of a new
+ * sample in the fsync inter-arrival and device flush cost averages.
+ */
+#define FLUSH_WINDOW_DEFAULT_MS		10
+#define FLUSH_WINDOW_MIN_MS		2
+#define FLUSH_WINDOW_MAX_MS		50
+#define FLUSH_AVG_WEIGHT_SHIFT		3
+/* never hold a flush back longer than this many device flush costs */
+#define FLUSH_WINDOW_COST_FACTOR	4
+/* ignore inter-arrival gaps above this, the stream has restarted */
+#define FLUSH_INTERVAL_MAX_US		1000000ULL
+
+static inline u64 flush_avg_update(u64 avg, u64 sample)
+{
+	if (!avg)
+		return sample;
+	return avg - (avg >> FLUSH_AVG_WEIGHT_SHIFT) +
+		(sample >> FLUSH_AVG_WEIGHT_SHIFT);
+}
+
+/*
+ * The delay is only worth it if another fsync is likely to arrive
+ * within it, so it covers two average inter-arrival gaps. It is capped
+ * by a multiple of what a flush costs on the device: when fsyncs are
+ * sparse nothing gets coalesced and the flush goes out almost at once.
+ */
+static inline unsigned int flush_reducing_window(struct request_queue *q)
+{
+	u64 interval = READ_ONCE(q->flush_interval_avg_us);
+	u64 cost = READ_ONCE(q->flush_cost_avg_us);
+	u64 window, cap;
+
+	if (!interval || !cost)
+		return FLUSH_WINDOW_DEFAULT_MS;
+
+	cap = cost * FLUSH_WINDOW_COST_FACTOR;
+	window = interval * 2;
+	if (window > cap)
+		window = interval > cap ? 0 : cap;
+
+	window = div_u64(window, USEC_PER_MSEC);
+
+	return (unsigned int)clamp_t(u64, window, FLUSH_WINDOW_MIN_MS,
+				     FLUSH_WINDOW_MAX_MS);
+}
+
+static inline void flush_arrival_update(struct request_queue *q)
+{
+	u64 now = ktime_to_ns(ktime_get());
+	u64 last = READ_ONCE(q->flush_last_arrival_ns);
+	u64 interval;
+
+	WRITE_ONCE(q->flush_last_arrival_ns, now);
+	if (!last || now <= last)
+		return;
+
+	interval = div_u64(now - last, NSEC_PER_USEC);
+	if (interval > FLUSH_INTERVAL_MAX_US)
+		return;
+
+	WRITE_ONCE(q->flush_interval_avg_us,
+		   flush_avg_update(q->flush_interval_avg_us, interval));
+}
+
 static inline void blk_request_queue_disk_register(struct gendisk *disk,struct request_queue *q)
 {
 	q->request_queue_disk = disk;
@@ -18,6 +83,7 @@ extern int blkdev_issue_flush(struct block_device *bdev, gfp_t gfp_mask, sector_
 static void blk_mq_flush_work_fn(struct work_struct* work)
 {
 	int ret;
+	ktime_t start;
 	struct request_queue *q = container_of(work, struct request_queue, flush_work.work);/*lint !e826*/
 	struct block_device *bdev = bdget_disk(q->request_queue_disk, 0);
 	if(bdev == NULL)
@@ -31,9 +97,13 @@ static void blk_mq_flush_work_fn(struct work_struct* work)
 		return;
 	}
 	atomic_set(&q->flush_work_execute, 1);
+	start = ktime_get();
 	ret = blkdev_issue_flush(bdev, GFP_KERNEL, NULL);
 	if(ret)
 		printk(KERN_EMERG "<%s> blkdev_issue_flush fail! \r\n", __func__);
+	else
+		q->flush_cost_avg_us = flush_avg_update(q->flush_cost_avg_us,
+				ktime_us_delta(ktime_get(), start));
 	atomic_set(&q->do_delay_flush, 0);
 	atomic_set(&q->flush_work_execute, 0);
 	blkdev_put(bdev, FMODE_WRITE);
@@ -49,18 +119,24 @@ static inline bool flush_reducing(struct request_queue *q, struct request *rq)
 	}
 	if (rq->cmd_flags & REQ_FLUSH && (rq->__data_len == 0)) {
 		if(atomic_read(&q->wio_after_flush_fua) == 0)
-			goto flush_bypass;
+			goto flush_absorb;
 		if(atomic_read(&q->flush_work_execute) == 1)
-			goto flush_dispatch;
+			goto flush_issue;
+		flush_arrival_update(q);
 		if(atomic_read(&q->flush_work_trigger) == 1)
 			kblockd_schedule_delayed_work_cancel(&q->flush_work);
 		if(atomic_read(&q->do_delay_flush) == 0)
 			atomic_set(&q->do_delay_flush, 1);
-		goto flush_bypass;
+		goto flush_absorb;
 	}
+	goto flush_dispatch;
+flush_issue:
+	atomic64_inc(&q->flush_issued);
 flush_dispatch:
 	atomic_set(&q->wio_after_flush_fua, rq->__data_len ? 1 : 0);
 	return false;
+flush_absorb:
+	atomic64_inc(&q->flush_absorbed);
 flush_bypass:
 	return true;
 }
@@ -77,7 +153,8 @@ static inline void flush_work_trigger(struct request_queue *q)
 		return;
 	if(atomic_read(&q->do_delay_flush) == 0)
 		return;
-	kblockd_schedule_delayed_work(&q->flush_work,msecs_to_jiffies(10));
+	kblockd_schedule_delayed_work(&q->flush_work,
+			msecs_to_jiffies(flush_reducing_window(q)));
 	atomic_set(&q->flush_work_trigger, 1);
 }
 
@@ -101,6 +178,22 @@ static inline void hisi_blk_mq_init(struct request_queue *q)
 	atomic_set(&q->flush_work_trigger, 0);
 	atomic_set(&q->flush_from_flush_work, 0);
 	atomic_set(&q->wio_after_flush_fua,0);
+	q->flush_last_arrival_ns = 0;
+	q->flush_interval_avg_us = 0;
+	q->flush_cost_avg_us = 0;
+	atomic64_set(&q->flush_absorbed, 0);
+	atomic64_set(&q->flush_issued, 0);
+}
+
+static inline ssize_t flush_reducing_stats_show(struct request_queue *q,
+		char *page)
+{
+	return sprintf(page, "absorbed=%lld, issued=%lld, window_ms=%u, interval_us=%llu, cost_us=%llu\n",
+			(long long)atomic64_read(&q->flush_absorbed),
+			(long long)atomic64_read(&q->flush_issued),
+			flush_reducing_window(q),
+			(unsigned long long)q->flush_interval_avg_us,
+			(unsigned long long)q->flush_cost_avg_us);
 }
 
 #else /* CONFIG_HISI_BLK_MQ */
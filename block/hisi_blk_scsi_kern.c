@@ -22,6 +22,8 @@
 #include <linux/idr.h>
 #include <linux/bsg.h>
 #include <linux/slab.h>
+#include <linux/wait.h>
+#include <linux/hisi_blk_scsi_kern.h>
 
 #include <scsi/scsi.h>
 #include <scsi/scsi_ioctl.h>
@@ -51,17 +53,35 @@ static long hisi_blk_kern_copy_data(void *to, const void *from, unsigned long n)
 	memcpy(to, from, n);
 	return 0;
 }
+
+/*
+ * The cdb is either copied into the request or, for ring submissions,
+ * used in place from hdr->request. Only a cdb allocated here is freed.
+ */
+static void hisi_blk_kern_release_cmd(struct request *rq,
+				      struct sg_io_v4 *hdr)
+{
+	if (rq->cmd != rq->__cmd &&
+	    rq->cmd != (unsigned char *)(unsigned long)hdr->request)
+		kfree(rq->cmd);
+	rq->cmd = rq->__cmd;
+}
+
 static int hisi_blk_kern_fill_sgv4_hdr_rq(struct request_queue *q,
 					  struct request *rq,
-					  struct sg_io_v4 *hdr)
+					  struct sg_io_v4 *hdr,
+					  bool cdb_in_place)
 {
-	if (hdr->request_len > BLK_MAX_CDB) {
+	if (cdb_in_place) {
+		rq->cmd = (unsigned char *)(unsigned long)hdr->request;
+	} else if (hdr->request_len > BLK_MAX_CDB) {
 		rq->cmd = kzalloc((size_t)hdr->request_len, GFP_KERNEL);
 		if (!rq->cmd)
 			return -ENOMEM;
 	}
 
-	if (hisi_blk_kern_copy_data((void *)rq->cmd,
+	if (!cdb_in_place &&
+	    hisi_blk_kern_copy_data((void *)rq->cmd,
 				    (void *)(unsigned long)hdr->request,
 				    (unsigned long)hdr->request_len))
 		return -EFAULT;
@@ -116,7 +136,7 @@ static int hisi_blk_kern_validate_sgv4_hdr(struct sg_io_v4 *hdr,
  */
 static struct request *hisi_blk_kern_map_hdr(struct blk_scsi_device *bd,
 					     struct sg_io_v4 *hdr,
-					     u8 *sense)
+					     u8 *sense, bool cdb_in_place)
 {
 	struct request_queue *q = bd->queue;
 	struct request *rq = NULL, *next_rq = NULL;
@@ -144,7 +164,7 @@ static struct request *hisi_blk_kern_map_hdr(struct blk_scsi_device *bd,
 		return rq;
 	blk_rq_set_block_pc(rq);
 
-	ret = hisi_blk_kern_fill_sgv4_hdr_rq(q, rq, hdr);
+	ret = hisi_blk_kern_fill_sgv4_hdr_rq(q, rq, hdr, cdb_in_place);
 	if (ret)
 		goto out;
 
@@ -190,8 +210,7 @@ static struct request *hisi_blk_kern_map_hdr(struct blk_scsi_device *bd,
 
 	return rq;
 out:
-	if (rq->cmd != rq->__cmd)
-		kfree(rq->cmd);
+	hisi_blk_kern_release_cmd(rq, hdr);
 	blk_put_request(rq);
 	if (next_rq) {
 		blk_put_request(next_rq);
@@ -245,8 +264,7 @@ static int hisi_blk_kern_complete_hdr_rq(struct request *rq,
 	if (!ret && rq->errors < 0)
 		ret = rq->errors;
 
-	if (rq->cmd != rq->__cmd)
-		kfree(rq->cmd);
+	hisi_blk_kern_release_cmd(rq, hdr);
 	blk_put_request(rq);
 
 	return ret;
@@ -270,7 +288,7 @@ long blk_scsi_kern_ioctl(unsigned int fd, unsigned int cmd, unsigned long arg)
 		if (hisi_blk_kern_copy_data(&hdr, uarg, sizeof(hdr)))
 			return -EFAULT;
 
-		rq = hisi_blk_kern_map_hdr(bd, &hdr, sense);
+		rq = hisi_blk_kern_map_hdr(bd, &hdr, sense, false);
 
 		if (IS_ERR(rq))
 			return PTR_ERR(rq);
@@ -293,3 +311,210 @@ long blk_scsi_kern_ioctl(unsigned int fd, unsigned int cmd, unsigned long arg)
 	fput(pfile);
 	return ret;
 }
+
+/*
+ * Batched submission ring.
+ *
+ * Every slot owns its sense buffer, so nothing is allocated per
+ * command besides the block request itself. The requests are not
+ * kept across commands: a held request pins a tag (or an nr_requests
+ * slot) that regular I/O could use.
+ */
+struct blk_scsi_kern_slot {
+	struct list_head list;
+	struct blk_scsi_kern_ring *ring;
+	struct request *rq;
+	struct sg_io_v4 *hdr;
+	u8 sense[SCSI_SENSE_BUFFERSIZE];
+};
+
+struct blk_scsi_kern_ring {
+	struct file *file;
+	struct blk_scsi_device *bd;
+	spinlock_t lock;
+	struct list_head free_list;
+	struct list_head done_list;
+	unsigned int depth;
+	unsigned int nr_busy;	/* submitted and not yet reaped */
+	wait_queue_head_t wq_done;
+	struct blk_scsi_kern_slot slots[0];
+};
+
+static void hisi_blk_kern_ring_end_io(struct request *rq, int error)
+{
+	struct blk_scsi_kern_slot *slot = rq->end_io_data;
+	struct blk_scsi_kern_ring *ring = slot->ring;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ring->lock, flags);
+	list_add_tail(&slot->list, &ring->done_list);
+	spin_unlock_irqrestore(&ring->lock, flags);
+
+	wake_up(&ring->wq_done);
+}
+
+struct blk_scsi_kern_ring *blk_scsi_kern_ring_alloc(unsigned int fd,
+						    unsigned int depth)
+{
+	struct blk_scsi_kern_ring *ring;
+	struct file *pfile;
+	unsigned int i;
+
+	if (!depth)
+		return ERR_PTR(-EINVAL);
+
+	pfile = fget(fd);
+	if (pfile == NULL)
+		return ERR_PTR(-EBADF);
+
+	ring = kzalloc(sizeof(*ring) + depth * sizeof(ring->slots[0]),
+		       GFP_KERNEL);
+	if (!ring) {
+		fput(pfile);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	ring->file = pfile;
+	ring->bd = (struct blk_scsi_device *)pfile->private_data;
+	ring->depth = depth;
+	spin_lock_init(&ring->lock);
+	INIT_LIST_HEAD(&ring->free_list);
+	INIT_LIST_HEAD(&ring->done_list);
+	init_waitqueue_head(&ring->wq_done);
+
+	for (i = 0; i < depth; i++) {
+		ring->slots[i].ring = ring;
+		list_add_tail(&ring->slots[i].list, &ring->free_list);
+	}
+
+	return ring;
+}
+EXPORT_SYMBOL(blk_scsi_kern_ring_alloc);
+
+/*
+ * Returns the number of headers queued, in order from hdrs[0]. A short
+ * count means hdrs[ret] was not queued: either the ring is full, or it
+ * failed to map and carries SG_INFO_CHECK in info with the errno in
+ * spare_out, as on completion. Nothing past it is looked at. When not
+ * even hdrs[0] goes out, -EBUSY or the mapping errno is returned.
+ */
+int blk_scsi_kern_ring_submit(struct blk_scsi_kern_ring *ring,
+			      struct sg_io_v4 *hdrs, unsigned int nr)
+{
+	struct blk_scsi_kern_slot *slot;
+	struct request *rq;
+	unsigned long flags;
+	unsigned int i;
+	int at_head;
+
+	for (i = 0; i < nr; i++) {
+		/* output only, a reused header may still carry SG_INFO_CHECK */
+		hdrs[i].info = 0;
+		spin_lock_irqsave(&ring->lock, flags);
+		slot = list_first_entry_or_null(&ring->free_list,
+						struct blk_scsi_kern_slot, list);
+		if (slot) {
+			list_del_init(&slot->list);
+			ring->nr_busy++;
+		}
+		spin_unlock_irqrestore(&ring->lock, flags);
+		if (!slot)
+			return i ? (int)i : -EBUSY;
+
+		rq = hisi_blk_kern_map_hdr(ring->bd, &hdrs[i], slot->sense,
+					   true);
+		if (IS_ERR(rq)) {
+			spin_lock_irqsave(&ring->lock, flags);
+			list_add(&slot->list, &ring->free_list);
+			ring->nr_busy--;
+			spin_unlock_irqrestore(&ring->lock, flags);
+			hdrs[i].info |= SG_INFO_CHECK;
+			hdrs[i].spare_out = (__u32)PTR_ERR(rq);
+			return i ? (int)i : (int)PTR_ERR(rq);
+		}
+
+		slot->rq = rq;
+		slot->hdr = &hdrs[i];
+		rq->end_io_data = slot;
+		at_head = (0 == (hdrs[i].flags & BSG_FLAG_Q_AT_TAIL));
+		blk_execute_rq_nowait(ring->bd->queue, NULL, rq, at_head,
+				      hisi_blk_kern_ring_end_io);
+	}
+
+	return (int)i;
+}
+EXPORT_SYMBOL(blk_scsi_kern_ring_submit);
+
+/*
+ * Hand back up to @max completed headers in @done, with their status
+ * filled in as for SG_IO. A negative completion errno is reported with
+ * SG_INFO_CHECK set in info and the errno in spare_out.
+ */
+int blk_scsi_kern_ring_reap(struct blk_scsi_kern_ring *ring,
+			    struct sg_io_v4 **done, unsigned int max,
+			    bool wait)
+{
+	struct blk_scsi_kern_slot *slot;
+	unsigned long flags;
+	unsigned int nr = 0;
+	int ret;
+
+	if (wait) {
+		ret = wait_event_interruptible(ring->wq_done,
+				!list_empty_careful(&ring->done_list) ||
+				!ring->nr_busy);
+		if (ret)
+			return ret;
+	}
+
+	while (nr < max) {
+		spin_lock_irqsave(&ring->lock, flags);
+		slot = list_first_entry_or_null(&ring->done_list,
+						struct blk_scsi_kern_slot, list);
+		if (slot)
+			list_del_init(&slot->list);
+		spin_unlock_irqrestore(&ring->lock, flags);
+		if (!slot)
+			break;
+
+		ret = hisi_blk_kern_complete_hdr_rq(slot->rq, slot->hdr);
+		if (ret < 0) {
+			slot->hdr->info |= SG_INFO_CHECK;
+			slot->hdr->spare_out = (__u32)ret;
+		}
+		done[nr++] = slot->hdr;
+
+		slot->rq = NULL;
+		slot->hdr = NULL;
+		spin_lock_irqsave(&ring->lock, flags);
+		list_add_tail(&slot->list, &ring->free_list);
+		ring->nr_busy--;
+		spin_unlock_irqrestore(&ring->lock, flags);
+	}
+
+	return (int)nr;
+}
+EXPORT_SYMBOL(blk_scsi_kern_ring_reap);
+
+/*
+ * Waits for the commands still in flight; their headers are completed
+ * but not handed back.
+ */
+void blk_scsi_kern_ring_free(struct blk_scsi_kern_ring *ring)
+{
+	struct sg_io_v4 *done[8];
+
+	if (IS_ERR_OR_NULL(ring))
+		return;
+
+	while (ring->nr_busy) {
+		wait_event(ring->wq_done,
+			   !list_empty_careful(&ring->done_list));
+		(void)blk_scsi_kern_ring_reap(ring, done, ARRAY_SIZE(done),
+					      false);
+	}
+
+	fput(ring->file);
+	kfree(ring);
+}
+EXPORT_SYMBOL(blk_scsi_kern_ring_free);
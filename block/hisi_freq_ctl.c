@@ -4,29 +4,34 @@
 #include <linux/compiler.h>
 #include <linux/syscalls.h>
 #include <linux/bootdevice.h>
+#include <linux/blkdev.h>
+#include <linux/genhd.h>
+#include <linux/blk-mq.h>
+#include <linux/hisi/hisi_ddrflux.h>
 
+#include "blk-stat.h"
 #include "hisi_freq_ctl.h"
 #define HISI_DDR_FREQ_REQ
 
 /*
-The threshold of total io_wait_time:
-If total io_wait_time is bigger than the threshold,
-add ddr frequence request immediately.
+The closed-loop controller samples the boot device every
+FREQ_SAMPLE_PERIOD_MS and turns the average queue depth and the p99
+completion latency of that period into a demand of 0 - FREQ_LEVEL_MAX.
 */
-#define IO_WAIT_TIME_THRESHOLD			100
+#define FREQ_SAMPLE_PERIOD_MS			20
+#define FREQ_LEVEL_MAX				100
+#define FREQ_TARGET_DEPTH			8
+#define FREQ_TARGET_P99_US			8000
+#define FREQ_MIN_SAMPLES			8
+/* io_is_busy is on/off, so it gets a hysteresis band */
+#define FREQ_CPU_BOOST_LEVEL			50
+#define FREQ_CPU_UNBOOST_LEVEL			20
 #ifdef HISI_DDR_FREQ_REQ
 /* The band of ddr request */
 #define DDR_REQUEST_VALUE_DOWN			3841
 /* twice of DDR_REQUEST_VALUE_DOWN */
 #define DDR_REQUEST_VALUE_UP			7682
 #endif
-/*
-The period of the delete_request timer:
-When there is not io_req waiting in flight, this timer should be started.
-Before time out, if one io_req wait in flight, this timer should be canceled.
-*/
-#define REMOVE_REQ_TIME_MS				350
-
 /*
 when io_is_busy is set to 1,will take iowait time into account when
 caculating cpu load the default value is 0
@@ -94,6 +99,28 @@ static void ddr_qos_remove_request(struct pm_qos_request *ddr_req)
 	pm_qos_remove_request(ddr_req);
 	pr_err("%s: block ddr freq request remove\n", __func__);
 }
+
+/*
+The ddr vote of a level is proportional to the level. When the ddr
+traffic is measured, the vote is lowered to that traffic plus a
+quarter of headroom, but not below the proportional share of
+DDR_REQUEST_VALUE_DOWN: a busy boot device on an otherwise idle
+bus does not need ddr at the top band.
+*/
+static s32 ddr_qos_level_value(unsigned int level)
+{
+	s32 value, floor;
+	unsigned int mbps;
+
+	value = (s32)(DDR_REQUEST_VALUE_UP * level / FREQ_LEVEL_MAX);
+	if (ddrflux_get_bandwidth(&mbps))
+		return value;
+
+	floor = (s32)(DDR_REQUEST_VALUE_DOWN * level / FREQ_LEVEL_MAX);
+	mbps = min_t(unsigned int, mbps + mbps / 4, DDR_REQUEST_VALUE_UP);
+
+	return min_t(s32, value, max_t(s32, (s32)mbps, floor));
+}
 #endif
 static long set_io_is_busy(void)
 {
@@ -201,15 +228,22 @@ struct freq_ctrl {
 	struct mutex	m_lock;
 	int cur_type;/* The current stat of ddr frequence request */
 	struct pm_qos_request *ddr_req;
-	int delete_req_timer_start;/* The sign of the delete_request timer */
-	int total_io_wait_time;/* The counter of total io_wait_time */
 	s32 ddr_request_value;
 	struct workqueue_struct *workqueue;
-	struct work_struct work;
-	struct delayed_work del_work;
+	struct delayed_work sample_work;
 	struct hisi_freq_req_ops *req_ops;
-	int new_req_type;
-	int new_time_in_queue;
+	/* Boot device queue the tail latency is sampled from */
+	struct request_queue *q;
+	/* inflight * jiffies accumulated since the last sample */
+	unsigned long sample_io_wait;
+	unsigned long last_sample;
+	int sampling;/* The sign of the sample work being queued */
+	int cpu_boosted;
+	/* Smoothed boost level, 0 - FREQ_LEVEL_MAX */
+	unsigned int level;
+#ifdef CONFIG_WBT
+	struct blk_rq_stat_hist prev_hist[4];
+#endif
 };
 
 static struct freq_ctrl *freq_ctrl_ptr = NULL;
@@ -222,145 +256,215 @@ static struct hisi_freq_req_ops freq_req_ops = {
 	.cpu_freq_req_remove = cpu_freq_request_remove,
 };
 
-static void delete_freq_req_work(struct work_struct *work)
+/*
+The average queue depth score:
+FREQ_TARGET_DEPTH requests in flight over a whole sample period
+is a full (FREQ_LEVEL_MAX) demand.
+*/
+static unsigned int freq_depth_demand(unsigned long io_wait,
+				      unsigned long period)
 {
-	if (unlikely((NULL == freq_ctrl_ptr) ||
-			(NULL == freq_ctrl_ptr->workqueue)))
-		return;
+	unsigned long demand;
 
-	if ((freq_ctrl_ptr->req_ops->ddr_add_req) &&
-			(NULL == freq_ctrl_ptr->ddr_req))
-		return;
+	demand = io_wait * FREQ_LEVEL_MAX / (period * FREQ_TARGET_DEPTH);
 
-	/* Delete the ddr frequence request */
-	mutex_lock(&freq_ctrl_ptr->m_lock);
-	freq_ctrl_ptr->cur_type = FREQ_REQ_REMOVE;
-	if (freq_ctrl_ptr->req_ops->ddr_remove_request)
-		freq_ctrl_ptr->req_ops->ddr_remove_request(
-		    freq_ctrl_ptr->ddr_req);
-	if (freq_ctrl_ptr->req_ops->cpu_freq_req_remove)
-		freq_ctrl_ptr->req_ops->cpu_freq_req_remove();
-	freq_ctrl_ptr->delete_req_timer_start = 0;
-	mutex_unlock(&freq_ctrl_ptr->m_lock);
-	return;
+	return (unsigned int)min_t(unsigned long, demand, FREQ_LEVEL_MAX);
 }
 
-static void hisi_blk_freq_ctrl_work(struct work_struct *work)
+/*
+The tail latency score:
+p99 of the requests completed in the last sample period against
+FREQ_TARGET_P99_US. Periods with fewer than FREQ_MIN_SAMPLES
+completions are ignored, so one isolated slow request does not boost.
+*/
+static unsigned int freq_latency_demand(struct freq_ctrl *ctrl)
 {
-	int req_type;
-	int time_in_queue;
-	unsigned long flags;
+#ifdef CONFIG_WBT
+	struct blk_rq_stat_hist hist[4];
+	struct blk_rq_stat_hist window;
+	u64 p99;
+	int i;
 
-	if (unlikely((NULL == freq_ctrl_ptr) ||
-			(NULL == freq_ctrl_ptr->workqueue)))
-		return;
-	if ((freq_ctrl_ptr->req_ops->ddr_add_req) &&
-		(NULL == freq_ctrl_ptr->ddr_req))
-		return;
+	if (!ctrl->q)
+		return 0;
 
-	spin_lock_irqsave(&freq_ctrl_ptr->lock, flags);
-	req_type = freq_ctrl_ptr->new_req_type;
-	time_in_queue = freq_ctrl_ptr->new_time_in_queue;
-	spin_unlock_irqrestore(&freq_ctrl_ptr->lock, flags);
+	blk_queue_stat_hist_get(ctrl->q, hist);
 
-	mutex_lock(&freq_ctrl_ptr->m_lock);
+	/* read + write, the fg-* entries are a subset of them */
+	memset(&window, 0, sizeof(window));
+	for (i = 0; i < 2; i++) {
+		struct blk_rq_stat_hist delta;
 
-	if (FREQ_REQ_ADD == freq_ctrl_ptr->cur_type) {
-		if (freq_ctrl_ptr->req_ops->ddr_update_req)
-			freq_ctrl_ptr->ddr_request_value =
-			    freq_ctrl_ptr->req_ops->ddr_update_req(
-				freq_ctrl_ptr->ddr_request_value,
-				freq_ctrl_ptr->ddr_req);
+		blk_stat_hist_delta(&delta, &hist[i], &ctrl->prev_hist[i]);
+		blk_stat_hist_sum(&window, &delta);
 	}
+	memcpy(ctrl->prev_hist, hist, sizeof(hist));
 
-	if (FREQ_REQ_ADD == req_type) {
-		if (FREQ_REQ_ADD == freq_ctrl_ptr->cur_type) {
-			/*
-			new request:	add_freq_req
-			current state:	add_freq_req
-			process:	Cancel the delete_request timer,
-			if the timer has already been started.
-			*/
-			if (freq_ctrl_ptr->delete_req_timer_start) {
-				mutex_unlock(&freq_ctrl_ptr->m_lock);
-				cancel_delayed_work_sync(
-				    &freq_ctrl_ptr->del_work);
-				mutex_lock(&freq_ctrl_ptr->m_lock);
-				freq_ctrl_ptr->delete_req_timer_start = 0;
-			}
-		} else {
-			/*
-			new request:	add_ddr_freq_req
-			current state:	remove_ddr_freq_req
-			process:	1) Add total_io_wait_time value.
-			2) If total_io_wait_time is bigger than
-			threshold,start ddr frequence request.
-			*/
-			freq_ctrl_ptr->total_io_wait_time += time_in_queue;
-
-			if (freq_ctrl_ptr->total_io_wait_time >=
-			    IO_WAIT_TIME_THRESHOLD) {
-				if (freq_ctrl_ptr->req_ops->ddr_add_req)
-					freq_ctrl_ptr->ddr_request_value =
-					    freq_ctrl_ptr->req_ops->ddr_add_req(
-						freq_ctrl_ptr->ddr_req);
-				if (freq_ctrl_ptr->req_ops->cpu_freq_req_add)
-					freq_ctrl_ptr->req_ops
-					    ->cpu_freq_req_add();
-
-				freq_ctrl_ptr->cur_type = FREQ_REQ_ADD;
-				freq_ctrl_ptr->total_io_wait_time = 0;
-			}
+	if (blk_stat_hist_samples(&window) < FREQ_MIN_SAMPLES)
+		return 0;
+
+	p99 = blk_stat_hist_percentile(&window, 990);
+
+	return (unsigned int)min_t(u64,
+		div_u64(p99 * FREQ_LEVEL_MAX, FREQ_TARGET_P99_US),
+		FREQ_LEVEL_MAX);
+#else
+	return 0;
+#endif
+}
+
+/*
+Ramp up by half of the gap to the demand, decay by a quarter of it,
+so sustained bursts are caught within two periods while the votes
+are released gradually.
+*/
+static unsigned int freq_level_update(unsigned int level, unsigned int demand)
+{
+	if (demand > level)
+		return level + (demand - level + 1) / 2;
+
+	return level - (level - demand + 3) / 4;
+}
+
+static void freq_ctrl_apply(struct freq_ctrl *ctrl, unsigned int level)
+{
+	struct hisi_freq_req_ops *ops = ctrl->req_ops;
+	s32 value;
+
+	if (!level) {
+		if (FREQ_REQ_ADD == ctrl->cur_type) {
+			/* Delete the ddr frequence request */
+			if (ops->ddr_remove_request)
+				ops->ddr_remove_request(ctrl->ddr_req);
+			ctrl->cur_type = FREQ_REQ_REMOVE;
 		}
-	} else {
-		if (FREQ_REQ_REMOVE == freq_ctrl_ptr->cur_type) {
-			/*
-			new request:	remove_freq_req
-			current state:	remove_freq_req
-			process:	Reduce total_io_wait_time value.
-			*/
-			if (freq_ctrl_ptr->total_io_wait_time <= time_in_queue)
-				freq_ctrl_ptr->total_io_wait_time = 0;
-			else
-				freq_ctrl_ptr->total_io_wait_time -=
-				    time_in_queue;
-		} else {
-			/*
-			new request:	remove_freq_req
-			current state:	add_freq_req
-			process:	Start the delete_request timer.
-			*/
-			if (0 == freq_ctrl_ptr->delete_req_timer_start) {
-				freq_ctrl_ptr->delete_req_timer_start = 1;
-				queue_delayed_work(
-				    freq_ctrl_ptr->workqueue,
-				    &freq_ctrl_ptr->del_work,
-				    msecs_to_jiffies(REMOVE_REQ_TIME_MS));
-			}
+		if (ctrl->cpu_boosted && ops->cpu_freq_req_remove) {
+			ops->cpu_freq_req_remove();
+			ctrl->cpu_boosted = 0;
 		}
+		return;
 	}
 
-	mutex_unlock(&freq_ctrl_ptr->m_lock);
-	return;
+	if (FREQ_REQ_REMOVE == ctrl->cur_type) {
+		if (ops->ddr_add_req)
+			ctrl->ddr_request_value =
+			    ops->ddr_add_req(ctrl->ddr_req);
+		ctrl->cur_type = FREQ_REQ_ADD;
+	}
+
+#ifdef HISI_DDR_FREQ_REQ
+	/* The ddr vote follows the level, see ddr_qos_level_value */
+	if (ops->ddr_add_req &&
+	    BOOT_DEVICE_EMMC != get_bootdevice_type()) {
+		value = ddr_qos_level_value(level);
+		if (value != ctrl->ddr_request_value) {
+			ctrl->ddr_request_value = value;
+			pm_qos_update_request(ctrl->ddr_req, value);
+		}
+	}
+#endif
+
+	if (!ctrl->cpu_boosted && level >= FREQ_CPU_BOOST_LEVEL) {
+		if (ops->cpu_freq_req_add)
+			ops->cpu_freq_req_add();
+		ctrl->cpu_boosted = 1;
+	} else if (ctrl->cpu_boosted && level < FREQ_CPU_UNBOOST_LEVEL) {
+		if (ops->cpu_freq_req_remove)
+			ops->cpu_freq_req_remove();
+		ctrl->cpu_boosted = 0;
+	}
+}
+
+static void hisi_blk_freq_sample_work(struct work_struct *work)
+{
+	struct freq_ctrl *ctrl = freq_ctrl_ptr;
+	unsigned long io_wait, period, now, flags;
+	unsigned int demand;
+
+	if (unlikely((NULL == ctrl) || (NULL == ctrl->workqueue)))
+		return;
+	if ((ctrl->req_ops->ddr_add_req) && (NULL == ctrl->ddr_req))
+		return;
+
+	now = jiffies;
+	spin_lock_irqsave(&ctrl->lock, flags);
+	io_wait = ctrl->sample_io_wait;
+	ctrl->sample_io_wait = 0;
+	spin_unlock_irqrestore(&ctrl->lock, flags);
+
+	period = now - ctrl->last_sample;
+	if (!period)
+		period = 1;
+	ctrl->last_sample = now;
+
+	demand = max(freq_depth_demand(io_wait, period),
+		     freq_latency_demand(ctrl));
+
+	mutex_lock(&ctrl->m_lock);
+	ctrl->level = freq_level_update(ctrl->level, demand);
+	freq_ctrl_apply(ctrl, ctrl->level);
+	mutex_unlock(&ctrl->m_lock);
+
+	spin_lock_irqsave(&ctrl->lock, flags);
+	if (!ctrl->level && !ctrl->sample_io_wait)
+		ctrl->sampling = 0;
+	else
+		queue_delayed_work(ctrl->workqueue, &ctrl->sample_work,
+				   msecs_to_jiffies(FREQ_SAMPLE_PERIOD_MS));
+	spin_unlock_irqrestore(&ctrl->lock, flags);
+}
+
+static bool hisi_blk_freq_is_boot_disk(struct gendisk *disk)
+{
+	if (BOOT_DEVICE_EMMC == get_bootdevice_type())
+		return !strcmp(disk->disk_name, "mmcblk0");
+
+	return !strcmp(disk->disk_name, "sda");
 }
 
-void hisi_blk_freq_request(int req_type, int time_in_queue)
+/*
+Called from part_round_stats with time_in_queue being the
+inflight * jiffies since the last round. The request itself only
+accumulates; the votes are computed by the sample work, which runs
+every FREQ_SAMPLE_PERIOD_MS while the device is busy or boosted.
+*/
+void hisi_blk_freq_request(struct gendisk *disk, int req_type,
+			   int time_in_queue)
 {
 	unsigned long flags;
-	if (unlikely((NULL == freq_ctrl_ptr) ||
-		(NULL == freq_ctrl_ptr->workqueue)))
+	struct freq_ctrl *ctrl = freq_ctrl_ptr;
+
+	if (unlikely((NULL == ctrl) || (NULL == ctrl->workqueue)))
 		return;
 
-	if ((freq_ctrl_ptr->req_ops->ddr_add_req) &&
-		(NULL == freq_ctrl_ptr->ddr_req))
+	if ((ctrl->req_ops->ddr_add_req) && (NULL == ctrl->ddr_req))
 		return;
 
-	spin_lock_irqsave(&freq_ctrl_ptr->lock, flags);
-	freq_ctrl_ptr->new_req_type = req_type;
-	freq_ctrl_ptr->new_time_in_queue = time_in_queue;
-	spin_unlock_irqrestore(&freq_ctrl_ptr->lock, flags);
+	/*
+	 * The boot device is never removed, so the reference taken
+	 * here is intentionally never dropped.
+	 */
+	if (unlikely(!ctrl->q) && disk && disk->queue &&
+	    hisi_blk_freq_is_boot_disk(disk)) {
+		spin_lock_irqsave(&ctrl->lock, flags);
+		if (!ctrl->q && blk_get_queue(disk->queue))
+			ctrl->q = disk->queue;
+		spin_unlock_irqrestore(&ctrl->lock, flags);
+	}
+
+	if (FREQ_REQ_REMOVE == req_type && !ctrl->sampling)
+		return;
 
-	queue_work(freq_ctrl_ptr->workqueue, &freq_ctrl_ptr->work);
+	spin_lock_irqsave(&ctrl->lock, flags);
+	if (FREQ_REQ_ADD == req_type)
+		ctrl->sample_io_wait += time_in_queue;
+	if (!ctrl->sampling) {
+		ctrl->sampling = 1;
+		ctrl->last_sample = jiffies;
+		queue_delayed_work(ctrl->workqueue, &ctrl->sample_work,
+				   msecs_to_jiffies(FREQ_SAMPLE_PERIOD_MS));
+	}
+	spin_unlock_irqrestore(&ctrl->lock, flags);
 	return;
 }
 
@@ -373,9 +477,9 @@ void hisi_blk_freq_ctrl_init(void)
 			pr_err("%s: kzalloc freq_ctrl_ptr error\n", __func__);
 			goto out;
 		}
-		pr_err("%s: hisi blk freq ctrl init: io_wait_time_threshold=%d, remove_req_time=%dms\n",
-				__func__, IO_WAIT_TIME_THRESHOLD,
-				REMOVE_REQ_TIME_MS);
+		pr_err("%s: hisi blk freq ctrl init: sample_period=%dms, target_depth=%d, target_p99=%dus\n",
+				__func__, FREQ_SAMPLE_PERIOD_MS,
+				FREQ_TARGET_DEPTH, FREQ_TARGET_P99_US);
 #ifdef HISI_DDR_FREQ_REQ
 		pr_err("%s: hisi block ddr frequence ctrl: ddr_req_value_down=%d, ddr_req_value_up=%d\n",
 				__func__, DDR_REQUEST_VALUE_DOWN,
@@ -405,9 +509,8 @@ void hisi_blk_freq_ctrl_init(void)
 			pr_err("%s: creat workqueue error\n", __func__);
 			goto free_ddr_req;
 		}
-		INIT_WORK(&freq_ctrl_ptr->work, hisi_blk_freq_ctrl_work);
-		INIT_DELAYED_WORK(&freq_ctrl_ptr->del_work,
-			delete_freq_req_work);
+		INIT_DELAYED_WORK(&freq_ctrl_ptr->sample_work,
+			hisi_blk_freq_sample_work);
 	}
 	goto out;
 free_ddr_req:
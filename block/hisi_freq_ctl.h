@@ -4,7 +4,10 @@
 #define FREQ_REQ_ADD				1
 #define FREQ_REQ_REMOVE				0
 
-void hisi_blk_freq_request(int req_type, int time_in_queue);
+struct gendisk;
+
+void hisi_blk_freq_request(struct gendisk *disk, int req_type,
+			   int time_in_queue);
 void hisi_blk_freq_ctrl_init(void);
 
 #endif
@@ -0,0 +1,238 @@
+/*
+ * Per-command latency trace shared by the UFS and eMMC host drivers.
+ *
+ * Every host owns a ring of fixed size binary records, one per
+ * completed command, holding the sched_clock() time of each stage the
+ * command went through. The host driver fills the in-flight record of
+ * a tag as the command moves on and commits it to the ring once it is
+ * completed, which costs a few clock reads and one short spinlock per
+ * command instead of a printk. Reading debugfs storage_lat/<dev>/trace
+ * returns the records committed since the previous read.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/blkdev.h>
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/hisi_storage_lat.h>
+
+#define STOR_LAT_RING_RECS	1024
+#define STOR_LAT_F_ACTIVE	0x1
+
+struct stor_lat_ring {
+	spinlock_t		lock;
+	bool			enabled;
+	enum stor_lat_backend	backend;
+	char			name[16];
+	unsigned int		nr_tags;
+	u64			seq;		/* records committed */
+	u64			read_seq;	/* records handed to a reader */
+	struct dentry		*dir;
+	struct stor_lat_rec	*inflight;
+	struct stor_lat_rec	recs[STOR_LAT_RING_RECS];
+};
+
+struct stor_lat_snapshot {
+	size_t			len;
+	char			data[0];
+};
+
+static struct dentry *stor_lat_root;
+static DEFINE_MUTEX(stor_lat_mutex);
+
+static u8 stor_lat_op(struct request *rq)
+{
+	if (rq->cmd_flags & REQ_DISCARD)
+		return STOR_LAT_OP_DISCARD;
+	if (rq->cmd_flags & REQ_FLUSH && !blk_rq_bytes(rq))
+		return STOR_LAT_OP_FLUSH;
+	if (rq->cmd_type != REQ_TYPE_FS)
+		return STOR_LAT_OP_OTHER;
+
+	return rq_data_dir(rq) == READ ? STOR_LAT_OP_READ : STOR_LAT_OP_WRITE;
+}
+
+void stor_lat_start(struct stor_lat_ring *ring, unsigned int tag,
+		    struct request *rq)
+{
+	struct stor_lat_rec *rec;
+
+	if (!ring || !ACCESS_ONCE(ring->enabled) || tag >= ring->nr_tags)
+		return;
+
+	rec = &ring->inflight[tag];
+	memset(rec, 0, sizeof(*rec));
+	rec->ts_ns[STOR_LAT_QUEUE] = rq_start_time_ns(rq);
+	rec->ts_ns[STOR_LAT_DISPATCH] = sched_clock();
+	rec->sector = blk_rq_pos(rq);
+	rec->bytes = blk_rq_bytes(rq);
+	rec->tag = (u16)tag;
+	rec->op = stor_lat_op(rq);
+	rec->flags = STOR_LAT_F_ACTIVE;
+}
+EXPORT_SYMBOL(stor_lat_start);
+
+/* @ts_ns 0 takes the current time, callers marking many tags pass one */
+void stor_lat_mark(struct stor_lat_ring *ring, unsigned int tag,
+		   enum stor_lat_stage stage, u64 ts_ns)
+{
+	struct stor_lat_rec *rec;
+
+	if (!ring || tag >= ring->nr_tags || stage >= STOR_LAT_NR_STAGES)
+		return;
+
+	rec = &ring->inflight[tag];
+	if (!(rec->flags & STOR_LAT_F_ACTIVE))
+		return;
+
+	rec->ts_ns[stage] = ts_ns ? ts_ns : sched_clock();
+}
+EXPORT_SYMBOL(stor_lat_mark);
+
+void stor_lat_end(struct stor_lat_ring *ring, unsigned int tag, int status)
+{
+	struct stor_lat_rec *rec;
+	unsigned long flags;
+
+	if (!ring || tag >= ring->nr_tags)
+		return;
+
+	rec = &ring->inflight[tag];
+	if (!(rec->flags & STOR_LAT_F_ACTIVE))
+		return;
+
+	rec->ts_ns[STOR_LAT_COMPLETE] = sched_clock();
+	rec->status = status;
+	rec->flags &= ~STOR_LAT_F_ACTIVE;
+
+	spin_lock_irqsave(&ring->lock, flags);
+	rec->seq = (u32)ring->seq;
+	ring->recs[ring->seq % STOR_LAT_RING_RECS] = *rec;
+	ring->seq++;
+	spin_unlock_irqrestore(&ring->lock, flags);
+}
+EXPORT_SYMBOL(stor_lat_end);
+
+static int stor_lat_trace_open(struct inode *inode, struct file *file)
+{
+	struct stor_lat_ring *ring = inode->i_private;
+	struct stor_lat_snapshot *snap;
+	struct stor_lat_file_hdr *hdr;
+	struct stor_lat_rec *out;
+	unsigned long flags;
+	u64 first, i;
+
+	snap = vmalloc(sizeof(*snap) + sizeof(*hdr) + sizeof(ring->recs));
+	if (!snap)
+		return -ENOMEM;
+
+	hdr = (struct stor_lat_file_hdr *)snap->data;
+	out = (struct stor_lat_rec *)(hdr + 1);
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->magic = STOR_LAT_MAGIC;
+	hdr->version = STOR_LAT_VERSION;
+	hdr->rec_size = sizeof(struct stor_lat_rec);
+	hdr->backend = ring->backend;
+	strlcpy(hdr->name, ring->name, sizeof(hdr->name));
+
+	spin_lock_irqsave(&ring->lock, flags);
+	first = ring->read_seq;
+	if (ring->seq - first > STOR_LAT_RING_RECS)
+		first = ring->seq - STOR_LAT_RING_RECS;
+	hdr->lost = first - ring->read_seq;
+	for (i = first; i < ring->seq; i++)
+		*out++ = ring->recs[i % STOR_LAT_RING_RECS];
+	hdr->nr_recs = (u32)(ring->seq - first);
+	ring->read_seq = ring->seq;
+	spin_unlock_irqrestore(&ring->lock, flags);
+
+	snap->len = sizeof(*hdr) + hdr->nr_recs * sizeof(struct stor_lat_rec);
+	file->private_data = snap;
+
+	return nonseekable_open(inode, file);
+}
+
+static ssize_t stor_lat_trace_read(struct file *file, char __user *ubuf,
+				   size_t cnt, loff_t *ppos)
+{
+	struct stor_lat_snapshot *snap = file->private_data;
+
+	return simple_read_from_buffer(ubuf, cnt, ppos, snap->data, snap->len);
+}
+
+static int stor_lat_trace_release(struct inode *inode, struct file *file)
+{
+	vfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations stor_lat_trace_fops = {
+	.open		= stor_lat_trace_open,
+	.read		= stor_lat_trace_read,
+	.release	= stor_lat_trace_release,
+	.llseek		= no_llseek,
+};
+
+struct stor_lat_ring *stor_lat_ring_alloc(const char *name,
+					  enum stor_lat_backend backend,
+					  unsigned int nr_tags)
+{
+	struct stor_lat_ring *ring;
+
+	ring = vzalloc(sizeof(*ring));
+	if (!ring)
+		return NULL;
+
+	ring->inflight = kcalloc(nr_tags, sizeof(*ring->inflight), GFP_KERNEL);
+	if (!ring->inflight)
+		goto free_ring;
+
+	spin_lock_init(&ring->lock);
+	ring->backend = backend;
+	ring->nr_tags = nr_tags;
+	strlcpy(ring->name, name, sizeof(ring->name));
+
+	mutex_lock(&stor_lat_mutex);
+	if (!stor_lat_root)
+		stor_lat_root = debugfs_create_dir("storage_lat", NULL);
+	if (!IS_ERR_OR_NULL(stor_lat_root))
+		ring->dir = debugfs_create_dir(ring->name, stor_lat_root);
+	mutex_unlock(&stor_lat_mutex);
+
+	if (IS_ERR_OR_NULL(ring->dir)) {
+		pr_err("%s: no debugfs dir for %s\n", __func__, ring->name);
+		goto free_inflight;
+	}
+
+	debugfs_create_bool("enable", S_IRUSR | S_IWUSR, ring->dir,
+			    &ring->enabled);
+	debugfs_create_file("trace", S_IRUSR, ring->dir, ring,
+			    &stor_lat_trace_fops);
+
+	return ring;
+
+free_inflight:
+	kfree(ring->inflight);
+free_ring:
+	vfree(ring);
+	return NULL;
+}
+EXPORT_SYMBOL(stor_lat_ring_alloc);
+
+void stor_lat_ring_free(struct stor_lat_ring *ring)
+{
+	if (!ring)
+		return;
+
+	debugfs_remove_recursive(ring->dir);
+	kfree(ring->inflight);
+	vfree(ring);
+}
+EXPORT_SYMBOL(stor_lat_ring_free);
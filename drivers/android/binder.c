@@ -35,6 +35,7 @@
 #include <linux/seq_file.h>
 #include <linux/uaccess.h>
 #include <linux/vmalloc.h>
+#include <linux/jhash.h>
 #include <linux/slab.h>
 #include <linux/pid_namespace.h>
 #include <linux/security.h>
@@ -123,6 +124,14 @@ module_param_named(debug_mask, binder_debug_mask, uint, S_IWUSR | S_IRUGO);
 static bool binder_debug_no_lock;
 module_param_named(proc_no_lock, binder_debug_no_lock, bool, S_IWUSR | S_IRUGO);
 
+/* parcels copied with at least this many data bytes are accounted as large */
+static unsigned long binder_large_parcel = 256 * SZ_1K;
+module_param_named(large_parcel, binder_large_parcel, ulong, S_IWUSR | S_IRUGO);
+
+/* handlers of sync transactions from SCHED_FIFO/RR callers run at their policy */
+static bool binder_inherit_rt = true;
+module_param_named(inherit_rt, binder_inherit_rt, bool, S_IWUSR | S_IRUGO);
+
 static DECLARE_WAIT_QUEUE_HEAD(binder_user_error_wait);
 static int binder_stop_on_user_error;
 
@@ -166,11 +175,21 @@ enum binder_stat_types {
 	BINDER_STAT_COUNT
 };
 
+/* buffer allocation latency, log2 buckets from 1us */
+#define BINDER_ALLOC_LAT_BUCKETS 8
+
 struct binder_stats {
 	int br[_IOC_NR(BR_FAILED_REPLY) + 1];
 	int bc[_IOC_NR(BC_DEAD_BINDER_DONE) + 1];
 	int obj_created[BINDER_STAT_COUNT];
 	int obj_deleted[BINDER_STAT_COUNT];
+	int alloc_failed;
+	int alloc_lat[BINDER_ALLOC_LAT_BUCKETS];
+	u64 alloc_ns_total;
+	u64 alloc_ns_max;
+	int large_parcels;
+	u64 large_parcel_bytes;
+	u64 large_parcel_ns;
 };
 #define MAINLOCK_TIMEOUT (3000000)
 #define BINDER_TRANCTION_TIMEOUT (500000000)
@@ -297,6 +316,17 @@ struct binder_buffer {
 	uint8_t data[0];
 };
 
+/*
+ * Free buffers are kept in one size sorted tree per power of two size
+ * class: bucket 0 holds buffers below 64 bytes, bucket n > 0 those in
+ * [32 << n, 64 << n), the last one also anything larger. The best fit
+ * is the smallest buffer large enough in the class of the request, or
+ * else the smallest one of the next non empty class, found with
+ * free_bucket_map.
+ */
+#define BINDER_FREE_BUCKET_SHIFT	6
+#define BINDER_FREE_BUCKETS		16
+
 enum binder_deferred_state {
 	BINDER_DEFERRED_PUT_FILES    = 0x01,
 	BINDER_DEFERRED_FLUSH        = 0x02,
@@ -320,7 +350,8 @@ struct binder_proc {
 	ptrdiff_t user_buffer_offset;
 
 	struct list_head buffers;
-	struct rb_root free_buffers;
+	struct rb_root free_buffers[BINDER_FREE_BUCKETS];
+	unsigned long free_bucket_map;	/* non empty free_buffers */
 	struct rb_root allocated_buffers;
 	size_t free_async_space;
 
@@ -336,6 +367,8 @@ struct binder_proc {
 	int requested_threads_started;
 	int ready_threads;
 	long default_priority;
+	int default_policy;
+	int default_rt_prio;
 	struct dentry *debugfs_entry;
 };
 
@@ -363,6 +396,13 @@ struct binder_thread {
 	struct binder_stats stats;
 };
 
+/* a profiled interface, the reply of a call keeps the key of the call */
+struct binder_prof_key {
+	kuid_t uid;		/* euid of the caller */
+	int node;		/* debug_id of the target node */
+	unsigned int code;
+};
+
 struct binder_transaction {
 	int debug_id;
 	struct binder_work work;
@@ -379,11 +419,18 @@ struct binder_transaction {
 	unsigned int	flags;
 	long	priority;
 	long	saved_priority;
+	int	policy;
+	int	rt_prio;
+	int	saved_policy;
+	int	saved_rt_prio;
 	kuid_t	sender_euid;
 	u64     timestamp;
 	unsigned int	init_code;
 	unsigned int	target_handle;
 	struct binder_proc *from_proc;
+	struct binder_prof_key prof_key;
+	u64	queue_ns;	/* 0 when not profiled */
+	u64	pickup_ns;
 };
 
 static void
@@ -453,8 +500,52 @@ static inline u64 binder_clock(void)
 #endif
 	return 0;
 }
+/*
+ * binder_main_lock accounting, protected by the lock itself: how often
+ * it was taken and found held, and how long it was held, as a log2
+ * histogram in us with the longest hold and where it was taken.
+ */
+#define BINDER_LOCK_HOLD_BUCKETS 10
+
+static struct binder_lock_stats {
+	unsigned long acquired;
+	unsigned long contended;
+	int hold[BINDER_LOCK_HOLD_BUCKETS];
+	u64 hold_ns_total;
+	u64 hold_ns_max;
+	const char *max_tag;
+	/* current hold */
+	const char *tag;
+	u64 start;
+} binder_lock_stats;
+
+static inline void binder_lock_acquired(const char *tag, bool contended)
+{
+	binder_lock_stats.acquired++;
+	if (contended)
+		binder_lock_stats.contended++;
+	binder_lock_stats.tag = tag;
+	binder_lock_stats.start = local_clock();
+}
+
+static inline void binder_lock_release(const char *tag)
+{
+	struct binder_lock_stats *ls = &binder_lock_stats;
+	u64 hold = local_clock() - ls->start;
+	int bucket = fls64(div_u64(hold, NSEC_PER_USEC));
+
+	ls->hold[min(bucket, BINDER_LOCK_HOLD_BUCKETS - 1)]++;
+	ls->hold_ns_total += hold;
+	if (hold > ls->hold_ns_max) {
+		ls->hold_ns_max = hold;
+		ls->max_tag = ls->tag;
+	}
+	trace_binder_lock_hold(ls->tag, tag, hold);
+}
+
 static inline void binder_lock(const char *tag)
 {
+	bool contended;
 
 	char comm[TASK_COMM_LEN];
 	u64 pre_time = binder_clock();
@@ -468,8 +559,11 @@ static inline void binder_lock(const char *tag)
 #endif
 	comm[TASK_COMM_LEN - 1] = 0;
 	trace_binder_lock(tag);
-	mutex_lock(&binder_main_lock);
+	contended = !mutex_trylock(&binder_main_lock);
+	if (contended)
+		mutex_lock(&binder_main_lock);
 	preempt_disable();
+	binder_lock_acquired(tag, contended);
 	cur_time = binder_clock();
 	if (cur_time - pre_time > MAINLOCK_TIMEOUT) {
 
@@ -481,10 +575,135 @@ static inline void binder_lock(const char *tag)
 static inline void binder_unlock(const char *tag)
 {
 	trace_binder_unlock(tag);
+	binder_lock_release(tag);
 	mutex_unlock(&binder_main_lock);
 	preempt_enable();
 }
 
+/*
+ * Transaction latency profile per (caller euid, target node, code):
+ * queueing until a thread picks the transaction up, handling until the
+ * reply is sent, and delivery of the reply to the caller. Enabled with
+ * the profile parameter, shown and reset through debugfs
+ * binder/transaction_latency. Protected by binder_main_lock.
+ */
+enum binder_prof_stage {
+	BINDER_PROF_QUEUE,
+	BINDER_PROF_HANDLE,
+	BINDER_PROF_REPLY,
+	BINDER_PROF_STAGES,
+};
+
+#define BINDER_PROF_BUCKETS	16	/* log2 from 1us */
+#define BINDER_PROF_ENTRIES	256
+
+struct binder_prof_entry {
+	struct binder_prof_key key;
+	bool used;
+	u32 hist[BINDER_PROF_STAGES][BINDER_PROF_BUCKETS];
+	u64 total_ns[BINDER_PROF_STAGES];
+	u64 max_ns[BINDER_PROF_STAGES];
+};
+
+static const char * const binder_prof_stage_strings[] = {
+	"queue", "handle", "reply",
+};
+
+static struct binder_prof_entry *binder_prof;
+static unsigned long binder_prof_dropped;
+static bool binder_profile;
+
+static int binder_set_profile(const char *val, struct kernel_param *kp)
+{
+	struct binder_prof_entry *prof = NULL;
+	bool enable;
+	int ret;
+
+	ret = strtobool(val, &enable);
+	if (ret)
+		return ret;
+
+	if (enable && !ACCESS_ONCE(binder_prof)) {
+		prof = vzalloc(sizeof(*prof) * BINDER_PROF_ENTRIES);
+		if (!prof)
+			return -ENOMEM;
+	}
+
+	binder_lock(__func__);
+	if (prof && !binder_prof) {
+		binder_prof = prof;
+		prof = NULL;
+	}
+	binder_profile = enable;
+	binder_unlock(__func__);
+
+	vfree(prof);
+	return 0;
+}
+module_param_call(profile, binder_set_profile, param_get_bool,
+		  &binder_profile, S_IWUSR | S_IRUGO);
+
+static struct binder_prof_entry *binder_prof_get(struct binder_prof_key *key)
+{
+	struct binder_prof_entry *e;
+	u32 i, h;
+
+	h = jhash_3words(__kuid_val(key->uid), key->node, key->code, 0);
+	for (i = 0; i < BINDER_PROF_ENTRIES; i++) {
+		e = &binder_prof[(h + i) % BINDER_PROF_ENTRIES];
+		if (!e->used) {
+			e->used = true;
+			e->key = *key;
+			return e;
+		}
+		if (uid_eq(e->key.uid, key->uid) && e->key.node == key->node &&
+		    e->key.code == key->code)
+			return e;
+	}
+	return NULL;
+}
+
+static void binder_prof_add(struct binder_prof_key *key,
+			    enum binder_prof_stage stage, u64 ns)
+{
+	struct binder_prof_entry *e;
+	int bucket;
+
+	if (!binder_profile || !binder_prof)
+		return;
+
+	e = binder_prof_get(key);
+	if (!e) {
+		binder_prof_dropped++;
+		return;
+	}
+
+	bucket = fls64(div_u64(ns, NSEC_PER_USEC));
+	e->hist[stage][min(bucket, BINDER_PROF_BUCKETS - 1)]++;
+	e->total_ns[stage] += ns;
+	if (ns > e->max_ns[stage])
+		e->max_ns[stage] = ns;
+}
+
+/* @t is picked up by a thread as @cmd */
+static void binder_prof_pickup(struct binder_transaction *t, uint32_t cmd)
+{
+	u64 now;
+
+	if (!t->queue_ns)
+		return;
+
+	now = local_clock();
+	if (cmd == BR_TRANSACTION) {
+		binder_prof_add(&t->prof_key, BINDER_PROF_QUEUE,
+				now - t->queue_ns);
+		t->pickup_ns = now;
+	} else {
+		binder_prof_add(&t->prof_key, BINDER_PROF_REPLY,
+				now - t->queue_ns);
+	}
+}
+
 static inline void *kzalloc_preempt_disabled(size_t size)
 {
 	void *ptr;
@@ -556,6 +775,40 @@ static void binder_set_nice(long nice)
 	binder_user_error("%d RLIMIT_NICE not set\n", current->pid);
 }
 
+static inline bool binder_is_rt_policy(int policy)
+{
+	return policy == SCHED_FIFO || policy == SCHED_RR;
+}
+
+static void binder_set_sched(int policy, int rt_prio)
+{
+	struct sched_param param = { .sched_priority = rt_prio };
+
+	if (current->policy == policy && current->rt_priority == rt_prio)
+		return;
+	if (sched_setscheduler_nocheck(current, policy, &param))
+		binder_debug(BINDER_DEBUG_PRIORITY_CAP,
+			     "%d: policy %d prio %d not allowed\n",
+			     current->pid, policy, rt_prio);
+}
+
+/*
+ * Run the handler of @t at the RT policy of its caller, unless it is
+ * already at least that urgent. Returns whether the policy was taken.
+ */
+static bool binder_inherit_sched(struct binder_transaction *t)
+{
+	if (!binder_inherit_rt || (t->flags & TF_ONE_WAY) ||
+	    !binder_is_rt_policy(t->policy))
+		return false;
+	if (binder_is_rt_policy(current->policy) &&
+	    current->rt_priority >= t->rt_prio)
+		return true;
+
+	binder_set_sched(t->policy, t->rt_prio);
+	return true;
+}
+
 static size_t binder_buffer_size(struct binder_proc *proc,
 				 struct binder_buffer *buffer)
 {
@@ -566,18 +819,31 @@ static size_t binder_buffer_size(struct binder_proc *proc,
 			  struct binder_buffer, entry) - (size_t)buffer->data;
 }
 
+static inline unsigned int binder_free_bucket(size_t size)
+{
+	int bucket = fls_long(size) - BINDER_FREE_BUCKET_SHIFT;
+
+	return clamp(bucket, 0, BINDER_FREE_BUCKETS - 1);
+}
+
 static void binder_insert_free_buffer(struct binder_proc *proc,
 				      struct binder_buffer *new_buffer)
 {
-	struct rb_node **p = &proc->free_buffers.rb_node;
+	struct rb_root *root;
+	struct rb_node **p;
 	struct rb_node *parent = NULL;
 	struct binder_buffer *buffer;
 	size_t buffer_size;
 	size_t new_buffer_size;
+	unsigned int bucket;
 
 	BUG_ON(!new_buffer->free);
 
 	new_buffer_size = binder_buffer_size(proc, new_buffer);
+	bucket = binder_free_bucket(new_buffer_size);
+	root = &proc->free_buffers[bucket];
+	p = &root->rb_node;
+	__set_bit(bucket, &proc->free_bucket_map);
 
 	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "%d: add free buffer, size %zd, at %pK\n",
@@ -596,7 +862,19 @@ static void binder_insert_free_buffer(struct binder_proc *proc,
 			p = &parent->rb_right;
 	}
 	rb_link_node(&new_buffer->rb_node, parent, p);
-	rb_insert_color(&new_buffer->rb_node, &proc->free_buffers);
+	rb_insert_color(&new_buffer->rb_node, root);
+}
+
+/* should be called before the size of @buffer changes */
+static void binder_erase_free_buffer(struct binder_proc *proc,
+				     struct binder_buffer *buffer)
+{
+	unsigned int bucket;
+
+	bucket = binder_free_bucket(binder_buffer_size(proc, buffer));
+	rb_erase(&buffer->rb_node, &proc->free_buffers[bucket]);
+	if (RB_EMPTY_ROOT(&proc->free_buffers[bucket]))
+		__clear_bit(bucket, &proc->free_bucket_map);
 }
 
 static void binder_insert_allocated_buffer(struct binder_proc *proc,
@@ -670,6 +948,13 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 		mm = NULL;
 	else
 		mm = get_task_mm(proc->tsk);
+#ifdef CONFIG_ANDROID_BINDER_BENCH
+	/* benchmark threads map binder from a borrowed mm */
+	if (!vma && !mm && (proc->tsk->flags & PF_KTHREAD) &&
+	    proc->vma_vm_mm &&
+	    atomic_inc_not_zero(&proc->vma_vm_mm->mm_users))
+		mm = proc->vma_vm_mm;
+#endif
 
 	preempt_enable_no_resched();
 
@@ -758,17 +1043,19 @@ err_no_vma:
 	return -ENOMEM;
 }
 
-static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
-					      size_t data_size,
-					      size_t offsets_size, int is_async)
+static struct binder_buffer *__binder_alloc_buf(struct binder_proc *proc,
+						size_t data_size,
+						size_t offsets_size,
+						int is_async)
 {
-	struct rb_node *n = proc->free_buffers.rb_node;
+	struct rb_node *n;
 	struct binder_buffer *buffer;
 	size_t buffer_size;
 	struct rb_node *best_fit = NULL;
 	void *has_page_addr;
 	void *end_page_addr;
 	size_t size;
+	unsigned int bucket;
 
 	if (proc->vma == NULL) {
 		pr_err("%d: binder_alloc_buf, no vma\n",
@@ -808,6 +1095,8 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 		return NULL;
 	}
 
+	bucket = binder_free_bucket(size);
+	n = proc->free_buffers[bucket].rb_node;
 	while (n) {
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
 		BUG_ON(!buffer->free);
@@ -823,6 +1112,13 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 			break;
 		}
 	}
+	if (best_fit == NULL && bucket + 1 < BINDER_FREE_BUCKETS) {
+		/* every buffer of a larger class fits, take the smallest */
+		bucket = find_next_bit(&proc->free_bucket_map,
+				       BINDER_FREE_BUCKETS, bucket + 1);
+		if (bucket < BINDER_FREE_BUCKETS)
+			best_fit = rb_first(&proc->free_buffers[bucket]);
+	}
 	if (best_fit == NULL) {
 		pr_err("%d: binder_alloc_buf size %zd failed, no address space\n",
 			proc->pid, size);
@@ -853,7 +1149,7 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	    (void *)PAGE_ALIGN((uintptr_t)buffer->data), end_page_addr, NULL))
 		return NULL;
 
-	rb_erase(best_fit, &proc->free_buffers);
+	binder_erase_free_buffer(proc, buffer);
 	buffer->free = 0;
 	binder_insert_allocated_buffer(proc, buffer);
 	if (buffer_size != size) {
@@ -879,6 +1175,34 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	return buffer;
 }
 
+static void binder_stats_alloc(struct binder_stats *stats, u64 ns, bool failed)
+{
+	int bucket = fls64(div_u64(ns, NSEC_PER_USEC));
+
+	if (failed)
+		stats->alloc_failed++;
+	stats->alloc_lat[min(bucket, BINDER_ALLOC_LAT_BUCKETS - 1)]++;
+	stats->alloc_ns_total += ns;
+	if (ns > stats->alloc_ns_max)
+		stats->alloc_ns_max = ns;
+}
+
+static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
+					      size_t data_size,
+					      size_t offsets_size, int is_async)
+{
+	struct binder_buffer *buffer;
+	u64 start = local_clock();
+	u64 ns;
+
+	buffer = __binder_alloc_buf(proc, data_size, offsets_size, is_async);
+	ns = local_clock() - start;
+	binder_stats_alloc(&binder_stats, ns, !buffer);
+	binder_stats_alloc(&proc->stats, ns, !buffer);
+
+	return buffer;
+}
+
 static void *buffer_start_page(struct binder_buffer *buffer)
 {
 	return (void *)((uintptr_t)buffer & PAGE_MASK);
@@ -973,7 +1297,7 @@ static void binder_free_buf(struct binder_proc *proc,
 						struct binder_buffer, entry);
 
 		if (next->free) {
-			rb_erase(&next->rb_node, &proc->free_buffers);
+			binder_erase_free_buffer(proc, next);
 			binder_delete_free_buffer(proc, next);
 		}
 	}
@@ -982,8 +1306,9 @@ static void binder_free_buf(struct binder_proc *proc,
 						struct binder_buffer, entry);
 
 		if (prev->free) {
+			/* erased first, deleting @buffer grows prev */
+			binder_erase_free_buffer(proc, prev);
 			binder_delete_free_buffer(proc, buffer);
-			rb_erase(&prev->rb_node, &proc->free_buffers);
 			buffer = prev;
 		}
 	}
@@ -1447,6 +1772,20 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 	}
 }
 
+static void binder_stats_large_parcel(struct binder_proc *proc,
+				      struct binder_transaction *t, u64 ns)
+{
+	size_t size = t->buffer->data_size;
+
+	binder_stats.large_parcels++;
+	binder_stats.large_parcel_bytes += size;
+	binder_stats.large_parcel_ns += ns;
+	proc->stats.large_parcels++;
+	proc->stats.large_parcel_bytes += size;
+	proc->stats.large_parcel_ns += ns;
+	trace_binder_large_parcel(t, size, ns);
+}
+
 static void binder_transaction(struct binder_proc *proc,
 			       struct binder_thread *thread,
 			       struct binder_transaction_data *tr, int reply)
@@ -1463,6 +1802,7 @@ static void binder_transaction(struct binder_proc *proc,
 	struct binder_transaction *in_reply_to = NULL;
 	struct binder_transaction_log_entry *e;
 	uint32_t return_error;
+	u64 copy_start;
 
 	uint32_t len;
 	u16 *p16;
@@ -1483,6 +1823,8 @@ static void binder_transaction(struct binder_proc *proc,
 			return_error = BR_FAILED_REPLY;
 			goto err_empty_call_stack;
 		}
+		binder_set_sched(in_reply_to->saved_policy,
+				 in_reply_to->saved_rt_prio);
 		binder_set_nice(in_reply_to->saved_priority);
 		if (in_reply_to->to_thread != thread) {
 			binder_user_error("%d:%d got reply transaction with bad transaction stack, transaction %d has target %d:%d\n",
@@ -1630,6 +1972,22 @@ static void binder_transaction(struct binder_proc *proc,
 	t->code = tr->code;
 	t->flags = tr->flags;
 	t->priority = task_nice(current);
+	t->policy = current->policy;
+	t->rt_prio = current->rt_priority;
+
+	if (binder_profile) {
+		t->queue_ns = local_clock();
+		if (reply) {
+			t->prof_key = in_reply_to->prof_key;
+			if (in_reply_to->pickup_ns)
+				binder_prof_add(&t->prof_key, BINDER_PROF_HANDLE,
+					t->queue_ns - in_reply_to->pickup_ns);
+		} else {
+			t->prof_key.uid = t->sender_euid;
+			t->prof_key.node = target_node->debug_id;
+			t->prof_key.code = t->code;
+		}
+	}
 
 	trace_binder_transaction(reply, t, target_node);
 
@@ -1650,6 +2008,7 @@ static void binder_transaction(struct binder_proc *proc,
 	offp = (binder_size_t *)(t->buffer->data +
 				 ALIGN(tr->data_size, sizeof(void *)));
 
+	copy_start = tr->data_size >= binder_large_parcel ? local_clock() : 0;
 	if (copy_from_user_preempt_disabled(t->buffer->data, (const void __user *)(uintptr_t)
 			   tr->data.ptr.buffer, tr->data_size)) {
 		binder_user_error("%d:%d got transaction with invalid data ptr\n",
@@ -1657,6 +2016,8 @@ static void binder_transaction(struct binder_proc *proc,
 		return_error = BR_FAILED_REPLY;
 		goto err_copy_data_failed;
 	}
+	if (copy_start)
+		binder_stats_large_parcel(proc, t, local_clock() - copy_start);
 	if (copy_from_user_preempt_disabled(offp, (const void __user *)(uintptr_t)
 			   tr->data.ptr.offsets, tr->offsets_size)) {
 		binder_user_error("%d:%d got transaction with invalid offsets ptr\n",
@@ -2388,6 +2749,8 @@ retry:
 			wait_event_interruptible(binder_user_error_wait,
 						 binder_stop_on_user_error < 2);
 		}
+		/* drop a policy left over from a transaction never replied */
+		binder_set_sched(proc->default_policy, proc->default_rt_prio);
 		binder_set_nice(proc->default_priority);
 		if (non_block) {
 			if (!binder_has_proc_work(proc, thread))
@@ -2564,18 +2927,23 @@ retry:
 			tr.target.ptr = target_node->ptr;
 			tr.cookie =  target_node->cookie;
 			t->saved_priority = task_nice(current);
-			if (t->priority < target_node->min_priority &&
-			    !(t->flags & TF_ONE_WAY))
-				binder_set_nice(t->priority);
-			else if (!(t->flags & TF_ONE_WAY) ||
-				 t->saved_priority > target_node->min_priority)
-				binder_set_nice(target_node->min_priority);
+			t->saved_policy = current->policy;
+			t->saved_rt_prio = current->rt_priority;
+			if (!binder_inherit_sched(t)) {
+				if (t->priority < target_node->min_priority &&
+				    !(t->flags & TF_ONE_WAY))
+					binder_set_nice(t->priority);
+				else if (!(t->flags & TF_ONE_WAY) ||
+					 t->saved_priority > target_node->min_priority)
+					binder_set_nice(target_node->min_priority);
+			}
 			cmd = BR_TRANSACTION;
 		} else {
 			tr.target.ptr = 0;
 			tr.cookie = 0;
 			cmd = BR_REPLY;
 		}
+		binder_prof_pickup(t, cmd);
 		tr.code = t->code;
 		tr.flags = t->flags;
 		tr.sender_euid = from_kuid(current_user_ns(), t->sender_euid);
@@ -2826,6 +3194,8 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	int ret;
 	struct binder_proc *proc = filp->private_data;
 	struct binder_thread *thread;
+	struct binder_write_read bwr;
+	bool copy_bwr = false;
 	unsigned int size = _IOC_SIZE(cmd);
 	void __user *ubuf = (void __user *)arg;
 
@@ -2842,6 +3212,18 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	if (ret)
 		goto err_unlocked;
 
+	/* user copies of the write_read header are done without the lock */
+	if (cmd == BINDER_WRITE_READ) {
+		if (size != sizeof(struct binder_write_read)) {
+			ret = -EINVAL;
+			goto err_unlocked;
+		}
+		if (copy_from_user(&bwr, ubuf, sizeof(bwr))) {
+			ret = -EFAULT;
+			goto err_unlocked;
+		}
+	}
+
 	binder_lock(__func__);
 	thread = binder_get_thread(proc);
 	if (thread == NULL) {
@@ -2851,15 +3233,7 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 
 	switch (cmd) {
 	case BINDER_WRITE_READ: {
-		struct binder_write_read bwr;
-		if (size != sizeof(struct binder_write_read)) {
-			ret = -EINVAL;
-			goto err;
-		}
-		if (copy_from_user_preempt_disabled(&bwr, ubuf, sizeof(bwr))) {
-			ret = -EFAULT;
-			goto err;
-		}
+		copy_bwr = true;
 		binder_debug(BINDER_DEBUG_READ_WRITE,
 			     "%d:%d write %lld at %016llx, read %lld at %016llx\n",
 			     proc->pid, thread->pid,
@@ -2871,8 +3245,6 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 			trace_binder_write_done(ret);
 			if (ret < 0) {
 				bwr.read_consumed = 0;
-				if (copy_to_user_preempt_disabled(ubuf, &bwr, sizeof(bwr)))
-					ret = -EFAULT;
 				goto err;
 			}
 		}
@@ -2881,21 +3253,14 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 			trace_binder_read_done(ret);
 			if (!list_empty(&proc->todo))
 				wake_up_interruptible(&proc->wait);
-			if (ret < 0) {
-				if (copy_to_user_preempt_disabled(ubuf, &bwr, sizeof(bwr)))
-					ret = -EFAULT;
+			if (ret < 0)
 				goto err;
-			}
 		}
 		binder_debug(BINDER_DEBUG_READ_WRITE,
 			     "%d:%d wrote %lld of %lld, read return %lld of %lld\n",
 			     proc->pid, thread->pid,
 			     (u64)bwr.write_consumed, (u64)bwr.write_size,
 			     (u64)bwr.read_consumed, (u64)bwr.read_size);
-		if (copy_to_user_preempt_disabled(ubuf, &bwr, sizeof(bwr))) {
-			ret = -EFAULT;
-			goto err;
-		}
 		break;
 	}
 	case BINDER_SET_MAX_THREADS:
@@ -2958,6 +3323,8 @@ err:
 	if (thread)
 		thread->looper &= ~BINDER_LOOPER_STATE_NEED_RETURN;
 	binder_unlock(__func__);
+	if (copy_bwr && copy_to_user(ubuf, &bwr, sizeof(bwr)))
+		ret = -EFAULT;
 	wait_event_interruptible(binder_user_error_wait, binder_stop_on_user_error < 2);
 	if (ret && ret != -ERESTARTSYS)
 		pr_info("%d:%d ioctl %x %lx returned %d\n", proc->pid, current->pid, cmd, arg, ret);
@@ -3121,6 +3488,8 @@ static int binder_open(struct inode *nodp, struct file *filp)
 	INIT_LIST_HEAD(&proc->todo);
 	init_waitqueue_head(&proc->wait);
 	proc->default_priority = task_nice(current);
+	proc->default_policy = current->policy;
+	proc->default_rt_prio = current->rt_priority;
 
 	binder_lock(__func__);
 
@@ -3341,6 +3710,7 @@ static void binder_deferred_func(struct work_struct *work)
 	do {
 		trace_binder_lock(__func__);
 		mutex_lock(&binder_main_lock);
+		binder_lock_acquired(__func__, false);
 		trace_binder_locked(__func__);
 
 		mutex_lock(&binder_deferred_lock);
@@ -3371,6 +3741,7 @@ static void binder_deferred_func(struct work_struct *work)
 			binder_deferred_release(proc); /* frees proc */
 
 		trace_binder_unlock(__func__);
+		binder_lock_release(__func__);
 		mutex_unlock(&binder_main_lock);
 		preempt_enable_no_resched();
 		if (files)
@@ -3649,6 +4020,38 @@ static void print_binder_stats(struct seq_file *m, const char *prefix,
 				stats->obj_created[i] - stats->obj_deleted[i],
 				stats->obj_created[i]);
 	}
+
+	if (stats->large_parcels)
+		seq_printf(m, "%slarge parcels: %d bytes %llu copy %lluns\n",
+			   prefix, stats->large_parcels,
+			   stats->large_parcel_bytes, stats->large_parcel_ns);
+
+	for (i = 0; i < ARRAY_SIZE(stats->alloc_lat); i++)
+		if (stats->alloc_lat[i])
+			break;
+	if (i == ARRAY_SIZE(stats->alloc_lat))
+		return;
+	seq_printf(m, "%sbuffer alloc: failed %d total %lluns max %lluns\n",
+		   prefix, stats->alloc_failed, stats->alloc_ns_total,
+		   stats->alloc_ns_max);
+	seq_printf(m, "%sbuffer alloc us:", prefix);
+	for (i = 0; i < ARRAY_SIZE(stats->alloc_lat); i++)
+		seq_printf(m, " <%d:%d", 1 << i, stats->alloc_lat[i]);
+	seq_puts(m, "\n");
+}
+
+static void print_binder_lock_stats(struct seq_file *m)
+{
+	struct binder_lock_stats *ls = &binder_lock_stats;
+	int i;
+
+	seq_printf(m, "main lock: acquired %lu contended %lu hold total %lluns max %lluns (%s)\n",
+		   ls->acquired, ls->contended, ls->hold_ns_total,
+		   ls->hold_ns_max, ls->max_tag ? ls->max_tag : "none");
+	seq_puts(m, "main lock hold us:");
+	for (i = 0; i < BINDER_LOCK_HOLD_BUCKETS; i++)
+		seq_printf(m, " <%d:%d", 1 << i, ls->hold[i]);
+	seq_puts(m, "\n");
 }
 
 static void print_binder_proc_stats(struct seq_file *m,
@@ -3739,6 +4142,7 @@ static int binder_stats_show(struct seq_file *m, void *unused)
 	seq_puts(m, "binder stats:\n");
 
 	print_binder_stats(m, "", &binder_stats);
+	print_binder_lock_stats(m);
 
 	hlist_for_each_entry(proc, &binder_procs, proc_node)
 		print_binder_proc_stats(m, proc);
@@ -3799,6 +4203,75 @@ static void print_binder_transaction_log_entry(struct seq_file *m,
 		   e->target_handle, e->data_size, e->offsets_size);
 }
 
+static int binder_transaction_latency_show(struct seq_file *m, void *unused)
+{
+	struct binder_prof_entry *e;
+	int i, stage, b;
+	u32 count;
+
+	binder_lock(__func__);
+	seq_printf(m, "profile %s, dropped %lu\n",
+		   binder_profile ? "on" : "off", binder_prof_dropped);
+	for (i = 0; binder_prof && i < BINDER_PROF_ENTRIES; i++) {
+		e = &binder_prof[i];
+		if (!e->used)
+			continue;
+
+		seq_printf(m, "uid %u node %d code %u\n",
+			   from_kuid(&init_user_ns, e->key.uid), e->key.node,
+			   e->key.code);
+		for (stage = 0; stage < BINDER_PROF_STAGES; stage++) {
+			count = 0;
+			for (b = 0; b < BINDER_PROF_BUCKETS; b++)
+				count += e->hist[stage][b];
+			if (!count)
+				continue;
+
+			seq_printf(m, "  %s: count %u avg %lluus max %lluus us:",
+				   binder_prof_stage_strings[stage], count,
+				   div64_u64(e->total_ns[stage],
+					     (u64)count * NSEC_PER_USEC),
+				   div_u64(e->max_ns[stage], NSEC_PER_USEC));
+			for (b = 0; b < BINDER_PROF_BUCKETS; b++)
+				if (e->hist[stage][b])
+					seq_printf(m, " <%d:%u", 1 << b,
+						   e->hist[stage][b]);
+			seq_puts(m, "\n");
+		}
+	}
+	binder_unlock(__func__);
+	return 0;
+}
+
+static int binder_transaction_latency_open(struct inode *inode,
+					   struct file *file)
+{
+	return single_open(file, binder_transaction_latency_show, NULL);
+}
+
+/* any write clears the profile */
+static ssize_t binder_transaction_latency_write(struct file *file,
+						const char __user *buf,
+						size_t count, loff_t *ppos)
+{
+	binder_lock(__func__);
+	if (binder_prof)
+		memset(binder_prof, 0,
+		       sizeof(*binder_prof) * BINDER_PROF_ENTRIES);
+	binder_prof_dropped = 0;
+	binder_unlock(__func__);
+	return count;
+}
+
+static const struct file_operations binder_transaction_latency_fops = {
+	.owner = THIS_MODULE,
+	.open = binder_transaction_latency_open,
+	.read = seq_read,
+	.write = binder_transaction_latency_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int binder_transaction_log_show(struct seq_file *m, void *unused)
 {
 	struct binder_transaction_log *log = m->private;
@@ -3835,6 +4308,14 @@ BINDER_DEBUG_ENTRY(stats);
 BINDER_DEBUG_ENTRY(transactions);
 BINDER_DEBUG_ENTRY(transaction_log);
 
+#ifdef CONFIG_ANDROID_BINDER_BENCH
+#include "binder_bench.c"
+#else
+static inline void binder_bench_init(struct dentry *root)
+{
+}
+#endif
+
 static int __init binder_init(void)
 {
 	int ret;
@@ -3874,6 +4355,12 @@ static int __init binder_init(void)
 				    binder_debugfs_dir_entry_root,
 				    &binder_transaction_log_failed,
 				    &binder_transaction_log_fops);
+		debugfs_create_file("transaction_latency",
+				    S_IRUGO | S_IWUSR,
+				    binder_debugfs_dir_entry_root,
+				    NULL,
+				    &binder_transaction_latency_fops);
+		binder_bench_init(binder_debugfs_dir_entry_root);
 	}
 	return ret;
 }
@@ -0,0 +1,666 @@
+/* binder_bench.c
+ *
+ * Binder transaction benchmark, included from binder.c.
+ *
+ * Copyright (C) 2016 Huawei Technologies Co., Ltd.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * A server and its clients are kernel threads that each borrow a private
+ * mm, open /dev/binder, mmap it and talk to the driver through
+ * binder_ioctl() exactly like libbinder does, so every transaction takes
+ * the regular locking, buffer allocation and wakeup paths. The only
+ * shortcut is the setup: the server node and the client refs to it are
+ * created directly instead of going through the context manager.
+ *
+ * binder/bench_threads is the largest thread count, runs are made with
+ * 1, 2, 4... server and client threads, each client running
+ * binder/bench_iterations transactions, for sync calls and one-way
+ * transactions of every payload size. Any write to binder/bench_run runs
+ * them, binder/bench_result then holds a line per run with the same log2
+ * latency histogram as binder/transaction_latency. For one-way
+ * transactions the latency is the time to BR_TRANSACTION_COMPLETE.
+ */
+
+#include <linux/kthread.h>
+#include <linux/mman.h>
+#include <linux/mmu_context.h>
+#include <linux/sizes.h>
+
+#define BINDER_BENCH_MAP_SIZE		SZ_1M
+#define BINDER_BENCH_MAX_THREADS	8
+#define BINDER_BENCH_MAX_ITERS		100000
+#define BINDER_BENCH_MAX_RESULTS	64
+#define BINDER_BENCH_NODE_PTR		0xbe7c0000
+#define BINDER_BENCH_CODE		1
+
+/* per thread scratch area in the borrowed mm */
+#define BINDER_BENCH_BWR		0
+#define BINDER_BENCH_WBUF		256
+#define BINDER_BENCH_WBUF_SIZE		256
+#define BINDER_BENCH_RBUF		512
+#define BINDER_BENCH_RBUF_SIZE		512
+#define BINDER_BENCH_PAYLOAD		PAGE_SIZE
+#define BINDER_BENCH_MAX_PAYLOAD	SZ_16K
+
+static const u32 binder_bench_payloads[] = {
+	32, 256, 4096, BINDER_BENCH_MAX_PAYLOAD,
+};
+
+struct binder_bench_ep {
+	struct mm_struct *mm;
+	struct file *file;
+	struct binder_proc *proc;
+};
+
+struct binder_bench_thread {
+	struct binder_bench_ep *ep;
+	struct binder_bench_ep own;	/* client endpoint */
+	bool server;
+	int index;
+	unsigned long scratch;
+	u32 wbuf[BINDER_BENCH_WBUF_SIZE / sizeof(u32)];
+	size_t wlen;
+	u8 rbuf[BINDER_BENCH_RBUF_SIZE];
+	size_t rlen;
+	u32 handle;
+	binder_uintptr_t reply_buf;
+	u32 hist[BINDER_PROF_BUCKETS];
+	u64 total_us;
+	u32 max_us;
+	u32 nr;
+	u32 errors;
+	ktime_t end;
+};
+
+struct binder_bench_result {
+	bool oneway;
+	u32 payload;
+	u32 threads;
+	u32 count;
+	u32 errors;
+	u64 tps;
+	u32 avg_us;
+	u32 max_us;
+	u32 hist[BINDER_PROF_BUCKETS];
+};
+
+struct binder_bench {
+	struct mutex lock;	/* protects results */
+	u32 threads;
+	u32 iterations;
+
+	/* state of the current run */
+	u32 nr_iters;
+	bool oneway;
+	u32 payload;
+	u32 nr_threads;
+	struct binder_bench_ep server;
+	struct completion server_ready;
+	struct completion go;
+	atomic_t servers_alive;
+	atomic_t servers_looping;
+	atomic_t clients_alive;
+	atomic_t clients_ready;
+	wait_queue_head_t wait;
+	bool stopping;
+	int err;
+
+	struct binder_bench_result results[BINDER_BENCH_MAX_RESULTS];
+	u32 nr_results;
+};
+
+static struct binder_bench binder_bench = {
+	.lock = __MUTEX_INITIALIZER(binder_bench.lock),
+	.wait = __WAIT_QUEUE_HEAD_INITIALIZER(binder_bench.wait),
+	.threads = 4,
+	.iterations = 2000,
+};
+
+static void binder_bench_fail(int err)
+{
+	if (!binder_bench.err)
+		binder_bench.err = err;
+}
+
+/* open and mmap binder from a kernel thread running on a fresh mm */
+static int binder_bench_ep_open(struct binder_bench_ep *ep)
+{
+	unsigned long addr;
+
+	ep->mm = mm_alloc();
+	if (!ep->mm)
+		return -ENOMEM;
+	arch_pick_mmap_layout(ep->mm);
+	/* keeps the mm_struct for the deferred release of the proc */
+	atomic_inc(&ep->mm->mm_count);
+	use_mm(ep->mm);
+
+	ep->file = filp_open("/dev/binder", O_RDWR | O_CLOEXEC, 0);
+	if (IS_ERR(ep->file)) {
+		int err = PTR_ERR(ep->file);
+
+		ep->file = NULL;
+		return err;
+	}
+	ep->proc = ep->file->private_data;
+
+	addr = vm_mmap(ep->file, 0, BINDER_BENCH_MAP_SIZE, PROT_READ,
+		       MAP_PRIVATE | MAP_NORESERVE, 0);
+	if (IS_ERR_VALUE(addr))
+		return (int)addr;
+
+	return 0;
+}
+
+/* called with the mm no longer in use by any bench thread */
+static void binder_bench_ep_close(struct binder_bench_ep *ep)
+{
+	if (!ep->mm)
+		return;
+	if (ep->file)
+		filp_close(ep->file, NULL);
+	mmput(ep->mm);
+	/* run binder_release() and the deferred proc release now */
+	flush_delayed_fput();
+	flush_workqueue(binder_deferred_workqueue);
+	mmdrop(ep->mm);
+	memset(ep, 0, sizeof(*ep));
+}
+
+static int binder_bench_scratch(struct binder_bench_thread *bt)
+{
+	unsigned long addr;
+
+	addr = vm_mmap(NULL, 0, BINDER_BENCH_PAYLOAD + BINDER_BENCH_MAX_PAYLOAD,
+		       PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, 0);
+	if (IS_ERR_VALUE(addr))
+		return (int)addr;
+	bt->scratch = addr;
+	return 0;
+}
+
+static void binder_bench_put(struct binder_bench_thread *bt, u32 cmd,
+			     const void *data, size_t len)
+{
+	u8 *p = (u8 *)bt->wbuf + bt->wlen;
+
+	memcpy(p, &cmd, sizeof(cmd));
+	memcpy(p + sizeof(cmd), data, len);
+	bt->wlen += sizeof(cmd) + len;
+}
+
+static int binder_bench_talk(struct binder_bench_thread *bt, bool read)
+{
+	void __user *scratch = (void __user *)bt->scratch;
+	struct binder_write_read bwr = {
+		.write_size = bt->wlen,
+		.write_buffer = bt->scratch + BINDER_BENCH_WBUF,
+		.read_size = read ? BINDER_BENCH_RBUF_SIZE : 0,
+		.read_buffer = bt->scratch + BINDER_BENCH_RBUF,
+	};
+	long ret;
+
+	if (copy_to_user(scratch + BINDER_BENCH_WBUF, bt->wbuf, bt->wlen) ||
+	    copy_to_user(scratch + BINDER_BENCH_BWR, &bwr, sizeof(bwr)))
+		return -EFAULT;
+
+	ret = binder_ioctl(bt->ep->file, BINDER_WRITE_READ,
+			   bt->scratch + BINDER_BENCH_BWR);
+	if (ret)
+		return (int)ret;
+	bt->wlen = 0;
+
+	if (copy_from_user(&bwr, scratch + BINDER_BENCH_BWR, sizeof(bwr)))
+		return -EFAULT;
+	bt->rlen = bwr.read_consumed;
+	if (bt->rlen && copy_from_user(bt->rbuf, scratch + BINDER_BENCH_RBUF,
+				       bt->rlen))
+		return -EFAULT;
+	return 0;
+}
+
+/* return the next BR_ command of the read buffer, 0 at the end */
+static u32 binder_bench_next(struct binder_bench_thread *bt, size_t *pos,
+			     void **data)
+{
+	u32 cmd;
+
+	if (*pos + sizeof(cmd) > bt->rlen)
+		return 0;
+	memcpy(&cmd, bt->rbuf + *pos, sizeof(cmd));
+	*data = bt->rbuf + *pos + sizeof(cmd);
+	*pos += sizeof(cmd) + _IOC_SIZE(cmd);
+	return cmd;
+}
+
+static int binder_bench_serve(struct binder_bench_thread *bt)
+{
+	struct binder_transaction_data tr, reply;
+	size_t pos = 0;
+	void *data;
+	u32 cmd;
+	int ret;
+
+	ret = binder_bench_talk(bt, true);
+	if (ret)
+		return ret;
+
+	while ((cmd = binder_bench_next(bt, &pos, &data))) {
+		if (cmd != BR_TRANSACTION)
+			continue;
+		memcpy(&tr, data, sizeof(tr));
+		binder_bench_put(bt, BC_FREE_BUFFER, &tr.data.ptr.buffer,
+				 sizeof(tr.data.ptr.buffer));
+		if (tr.flags & TF_ONE_WAY)
+			continue;
+		memset(&reply, 0, sizeof(reply));
+		reply.code = tr.code;
+		reply.data_size = sizeof(u32);
+		reply.data.ptr.buffer = bt->scratch + BINDER_BENCH_PAYLOAD;
+		binder_bench_put(bt, BC_REPLY, &reply, sizeof(reply));
+	}
+
+	return 0;
+}
+
+static int binder_bench_server(void *data)
+{
+	struct binder_bench_thread *bt = data;
+	struct binder_bench *bb = &binder_bench;
+	struct binder_node *node;
+	int ret = 0;
+
+	bt->ep = &bb->server;
+	if (!bt->index) {
+		ret = binder_bench_ep_open(bt->ep);
+		if (!ret) {
+			binder_lock(__func__);
+			node = binder_new_node(bt->ep->proc, BINDER_BENCH_NODE_PTR,
+					       0);
+			if (node) {
+				/* held by the server, like the context manager */
+				node->local_weak_refs++;
+				node->local_strong_refs++;
+				node->has_strong_ref = 1;
+				node->has_weak_ref = 1;
+			} else {
+				ret = -ENOMEM;
+			}
+			binder_unlock(__func__);
+		}
+		if (ret)
+			binder_bench_fail(ret);
+		complete_all(&bb->server_ready);
+	} else {
+		wait_for_completion(&bb->server_ready);
+		if (!bb->err)
+			use_mm(bt->ep->mm);
+		else
+			ret = bb->err;
+	}
+
+	if (!ret)
+		ret = binder_bench_scratch(bt);
+	if (!ret) {
+		binder_bench_put(bt, BC_ENTER_LOOPER, NULL, 0);
+		ret = binder_bench_talk(bt, false);
+	}
+	atomic_inc(&bb->servers_looping);
+	wake_up(&bb->wait);
+
+	while (!ret && !ACCESS_ONCE(bb->stopping))
+		ret = binder_bench_serve(bt);
+	if (ret) {
+		pr_err("binder_bench: server %d failed %d\n", bt->index, ret);
+	} else {
+		if (bt->wlen)
+			binder_bench_talk(bt, false);
+		binder_ioctl(bt->ep->file, BINDER_THREAD_EXIT, 0);
+	}
+
+	if (current->mm)
+		unuse_mm(current->mm);
+	if (atomic_dec_and_test(&bb->servers_alive)) {
+		binder_bench_ep_close(&bb->server);
+		wake_up(&bb->wait);
+	}
+	return 0;
+}
+
+static int binder_bench_call(struct binder_bench_thread *bt)
+{
+	struct binder_bench *bb = &binder_bench;
+	struct binder_transaction_data tr;
+	ktime_t start;
+	size_t pos;
+	void *data;
+	u32 cmd, us;
+	int ret;
+
+	if (bt->reply_buf) {
+		binder_bench_put(bt, BC_FREE_BUFFER, &bt->reply_buf,
+				 sizeof(bt->reply_buf));
+		bt->reply_buf = 0;
+	}
+	memset(&tr, 0, sizeof(tr));
+	tr.target.handle = bt->handle;
+	tr.code = BINDER_BENCH_CODE;
+	tr.flags = bb->oneway ? TF_ONE_WAY : 0;
+	tr.data_size = bb->payload;
+	tr.data.ptr.buffer = bt->scratch + BINDER_BENCH_PAYLOAD;
+	binder_bench_put(bt, BC_TRANSACTION, &tr, sizeof(tr));
+
+	start = ktime_get();
+	for (;;) {
+		ret = binder_bench_talk(bt, true);
+		if (ret)
+			return ret;
+		pos = 0;
+		while ((cmd = binder_bench_next(bt, &pos, &data))) {
+			switch (cmd) {
+			case BR_TRANSACTION_COMPLETE:
+				if (!bb->oneway)
+					break;
+				goto done;
+			case BR_REPLY:
+				memcpy(&tr, data, sizeof(tr));
+				bt->reply_buf = tr.data.ptr.buffer;
+				goto done;
+			case BR_DEAD_REPLY:
+			case BR_FAILED_REPLY:
+				bt->errors++;
+				return 0;
+			default:
+				break;
+			}
+		}
+	}
+done:
+	us = (u32)ktime_us_delta(ktime_get(), start);
+	bt->hist[min(fls(us), BINDER_PROF_BUCKETS - 1)]++;
+	bt->total_us += us;
+	if (us > bt->max_us)
+		bt->max_us = us;
+	bt->nr++;
+	return 0;
+}
+
+static int binder_bench_wire(struct binder_bench_thread *bt)
+{
+	struct binder_bench *bb = &binder_bench;
+	struct binder_node *node;
+	struct binder_ref *ref;
+	int ret = -ENOENT;
+
+	binder_lock(__func__);
+	node = binder_get_node(bb->server.proc, BINDER_BENCH_NODE_PTR);
+	if (node) {
+		ref = binder_get_ref_for_node(bt->ep->proc, node);
+		if (!ref) {
+			ret = -ENOMEM;
+		} else {
+			/* has_strong_ref is set, nothing gets queued */
+			ret = binder_inc_ref(ref, 1, &bb->server.proc->todo);
+			bt->handle = ref->desc;
+		}
+	}
+	binder_unlock(__func__);
+	return ret;
+}
+
+static int binder_bench_client(void *data)
+{
+	struct binder_bench_thread *bt = data;
+	struct binder_bench *bb = &binder_bench;
+	u32 i;
+	int ret;
+
+	bt->ep = &bt->own;
+	ret = binder_bench_ep_open(bt->ep);
+	if (!ret)
+		ret = binder_bench_scratch(bt);
+	wait_for_completion(&bb->server_ready);
+	if (!ret && bb->err)
+		ret = bb->err;
+	if (!ret)
+		ret = binder_bench_wire(bt);
+	if (ret)
+		binder_bench_fail(ret);
+	atomic_inc(&bb->clients_ready);
+	wake_up(&bb->wait);
+
+	wait_for_completion(&bb->go);
+	for (i = 0; !ret && !bb->err && i < bb->nr_iters; i++)
+		ret = binder_bench_call(bt);
+	bt->end = ktime_get();
+	if (ret) {
+		pr_err("binder_bench: client %d failed %d\n", bt->index, ret);
+		binder_bench_fail(ret);
+	}
+	if (!ret && bt->reply_buf) {
+		binder_bench_put(bt, BC_FREE_BUFFER, &bt->reply_buf,
+				 sizeof(bt->reply_buf));
+		binder_bench_talk(bt, false);
+	}
+
+	if (current->mm)
+		unuse_mm(current->mm);
+	binder_bench_ep_close(bt->ep);
+	if (atomic_dec_and_test(&bb->clients_alive))
+		wake_up(&bb->wait);
+	return 0;
+}
+
+static void binder_bench_fold(struct binder_bench_thread *bts, u32 n,
+			      ktime_t start)
+{
+	struct binder_bench *bb = &binder_bench;
+	struct binder_bench_result *res = &bb->results[bb->nr_results++];
+	ktime_t end = start;
+	u64 total_us = 0;
+	u32 i, b;
+	s64 us;
+
+	memset(res, 0, sizeof(*res));
+	res->oneway = bb->oneway;
+	res->payload = bb->payload;
+	res->threads = n;
+
+	for (i = 0; i < n; i++) {
+		for (b = 0; b < BINDER_PROF_BUCKETS; b++)
+			res->hist[b] += bts[i].hist[b];
+		res->count += bts[i].nr;
+		res->errors += bts[i].errors;
+		total_us += bts[i].total_us;
+		res->max_us = max(res->max_us, bts[i].max_us);
+		if (ktime_after(bts[i].end, end))
+			end = bts[i].end;
+	}
+	if (!res->count)
+		return;
+
+	us = max_t(s64, ktime_us_delta(end, start), 1);
+	res->tps = div64_u64((u64)res->count * USEC_PER_SEC, us);
+	res->avg_us = (u32)div_u64(total_us, res->count);
+}
+
+static int binder_bench_run_one(struct binder_bench_thread *servers,
+				struct binder_bench_thread *clients, u32 n)
+{
+	struct binder_bench *bb = &binder_bench;
+	struct task_struct *task;
+	ktime_t start;
+	u32 i;
+
+	bb->nr_threads = n;
+	bb->stopping = false;
+	bb->err = 0;
+	reinit_completion(&bb->server_ready);
+	reinit_completion(&bb->go);
+	atomic_set(&bb->servers_alive, n);
+	atomic_set(&bb->servers_looping, 0);
+	atomic_set(&bb->clients_alive, n);
+	atomic_set(&bb->clients_ready, 0);
+
+	for (i = 0; i < 2 * n; i++) {
+		struct binder_bench_thread *bt = i < n ? &servers[i] :
+						 &clients[i - n];
+
+		memset(bt, 0, sizeof(*bt));
+		bt->server = i < n;
+		bt->index = bt->server ? i : i - n;
+		task = kthread_run(bt->server ? binder_bench_server :
+				   binder_bench_client, bt, "binder_bench/%c%d",
+				   bt->server ? 's' : 'c', bt->index);
+		if (IS_ERR(task)) {
+			binder_bench_fail(PTR_ERR(task));
+			if (bt->server) {
+				if (!i)
+					complete_all(&bb->server_ready);
+				if (atomic_dec_and_test(&bb->servers_alive))
+					wake_up(&bb->wait);
+				atomic_inc(&bb->servers_looping);
+			} else {
+				atomic_dec(&bb->clients_alive);
+				atomic_inc(&bb->clients_ready);
+			}
+		}
+	}
+
+	wait_event(bb->wait, atomic_read(&bb->clients_ready) == n &&
+		   atomic_read(&bb->servers_looping) == n);
+	start = ktime_get();
+	complete_all(&bb->go);
+	wait_event(bb->wait, !atomic_read(&bb->clients_alive));
+
+	bb->stopping = true;
+	smp_mb();
+	binder_lock(__func__);
+	if (bb->server.proc)
+		binder_deferred_flush(bb->server.proc);
+	binder_unlock(__func__);
+	wait_event(bb->wait, !atomic_read(&bb->servers_alive));
+
+	if (bb->err)
+		return bb->err;
+	binder_bench_fold(clients, n, start);
+	return 0;
+}
+
+static int binder_bench_run(void)
+{
+	struct binder_bench *bb = &binder_bench;
+	struct binder_bench_thread *servers, *clients;
+	u32 i, t, max = bb->threads;
+	int mode, ret = 0;
+
+	/* the knobs may be written while the clients run */
+	bb->nr_iters = bb->iterations;
+	if (!max || max > BINDER_BENCH_MAX_THREADS || !bb->nr_iters ||
+	    bb->nr_iters > BINDER_BENCH_MAX_ITERS)
+		return -EINVAL;
+
+	servers = vzalloc(sizeof(*servers) * 2 * max);
+	if (!servers)
+		return -ENOMEM;
+	clients = servers + max;
+
+	bb->nr_results = 0;
+	for (mode = 0; mode < 2; mode++) {
+		bb->oneway = mode;
+		for (i = 0; i < ARRAY_SIZE(binder_bench_payloads); i++) {
+			bb->payload = binder_bench_payloads[i];
+			for (t = 1; t <= max; t <<= 1) {
+				if (bb->nr_results == BINDER_BENCH_MAX_RESULTS)
+					goto out;
+				ret = binder_bench_run_one(servers, clients, t);
+				if (ret)
+					goto out;
+			}
+		}
+	}
+
+out:
+	vfree(servers);
+	return ret;
+}
+
+static int binder_bench_result_show(struct seq_file *m, void *unused)
+{
+	struct binder_bench *bb = &binder_bench;
+	u32 i;
+	int b;
+
+	mutex_lock(&bb->lock);
+	for (i = 0; i < bb->nr_results; i++) {
+		struct binder_bench_result *res = &bb->results[i];
+
+		seq_printf(m, "%s payload %u threads %u: count %u errors %u",
+			   res->oneway ? "oneway" : "sync", res->payload,
+			   res->threads, res->count, res->errors);
+		seq_printf(m, " tps %llu avg %uus max %uus us:",
+			   res->tps, res->avg_us, res->max_us);
+		for (b = 0; b < BINDER_PROF_BUCKETS; b++)
+			if (res->hist[b])
+				seq_printf(m, " <%d:%u", 1 << b, res->hist[b]);
+		seq_puts(m, "\n");
+	}
+	mutex_unlock(&bb->lock);
+	return 0;
+}
+
+static int binder_bench_result_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, binder_bench_result_show, NULL);
+}
+
+static const struct file_operations binder_bench_result_fops = {
+	.owner = THIS_MODULE,
+	.open = binder_bench_result_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/* any write runs the benchmark */
+static ssize_t binder_bench_run_write(struct file *file,
+				      const char __user *buf,
+				      size_t count, loff_t *ppos)
+{
+	int ret;
+
+	mutex_lock(&binder_bench.lock);
+	ret = binder_bench_run();
+	mutex_unlock(&binder_bench.lock);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations binder_bench_run_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.write = binder_bench_run_write,
+};
+
+static void binder_bench_init(struct dentry *root)
+{
+	init_completion(&binder_bench.server_ready);
+	init_completion(&binder_bench.go);
+
+	debugfs_create_file("bench_run", S_IWUSR, root, NULL,
+			    &binder_bench_run_fops);
+	debugfs_create_file("bench_result", S_IRUSR, root, NULL,
+			    &binder_bench_result_fops);
+	debugfs_create_u32("bench_threads", S_IRUSR | S_IWUSR, root,
+			   &binder_bench.threads);
+	debugfs_create_u32("bench_iterations", S_IRUSR | S_IWUSR, root,
+			   &binder_bench.iterations);
+}
@@ -63,6 +63,23 @@ DEFINE_BINDER_LOCK_EVENT(binder_lock);
 DEFINE_BINDER_LOCK_EVENT(binder_locked);
 DEFINE_BINDER_LOCK_EVENT(binder_unlock);
 
+TRACE_EVENT(binder_lock_hold,
+	TP_PROTO(const char *tag, const char *unlock_tag, u64 hold_ns),
+	TP_ARGS(tag, unlock_tag, hold_ns),
+	TP_STRUCT__entry(
+		__field(const char *, tag)
+		__field(const char *, unlock_tag)
+		__field(u64, hold_ns)
+	),
+	TP_fast_assign(
+		__entry->tag = tag;
+		__entry->unlock_tag = unlock_tag;
+		__entry->hold_ns = hold_ns;
+	),
+	TP_printk("locked=%s unlocked=%s hold_ns=%llu",
+		  __entry->tag, __entry->unlock_tag, __entry->hold_ns)
+);
+
 DECLARE_EVENT_CLASS(binder_function_return_class,
 	TP_PROTO(int ret),
 	TP_ARGS(ret),
@@ -320,6 +337,26 @@ TRACE_EVENT(binder_return,
 			  "unknown")
 );
 
+TRACE_EVENT(binder_large_parcel,
+	TP_PROTO(struct binder_transaction *t, size_t size, u64 copy_ns),
+	TP_ARGS(t, size, copy_ns),
+	TP_STRUCT__entry(
+		__field(int, debug_id)
+		__field(int, to_proc)
+		__field(size_t, size)
+		__field(u64, copy_ns)
+	),
+	TP_fast_assign(
+		__entry->debug_id = t->debug_id;
+		__entry->to_proc = t->to_proc->pid;
+		__entry->size = size;
+		__entry->copy_ns = copy_ns;
+	),
+	TP_printk("transaction=%d dest_proc=%d size=%zd copy_ns=%llu",
+		  __entry->debug_id, __entry->to_proc, __entry->size,
+		  __entry->copy_ns)
+);
+
 TRACE_EVENT(binder_mainlock_timeout,
 
 	TP_PROTO(const char *tag, const char *owner, u64 start, u64 end),
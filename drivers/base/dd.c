@@ -25,6 +25,7 @@
 #include <linux/async.h>
 #include <linux/pm_runtime.h>
 #include <linux/pinctrl/devinfo.h>
+#include <linux/hisi/hisi_boottime.h>
 
 #include "base.h"
 #include "power/power.h"
@@ -61,6 +62,7 @@ static void deferred_probe_work_func(struct work_struct *work)
 {
 	struct device *dev;
 	struct device_private *private;
+	ktime_t start;
 	/*
 	 * This block processes every device in the deferred 'active' list.
 	 * Each device is removed from the active list and passed to
@@ -99,7 +101,11 @@ static void deferred_probe_work_func(struct work_struct *work)
 		device_pm_unlock();
 
 		dev_dbg(dev, "Retrying from deferred list\n");
+		start = boot_time_start();
 		bus_probe_device(dev);
+		boot_time_end_dev(BOOT_TIME_DEFERRED_PROBE,
+				  dev->driver ? dev->driver->name : NULL,
+				  dev_name(dev), start, dev->driver ? 0 : -EPROBE_DEFER);
 
 		mutex_lock(&deferred_probe_mutex);
 
@@ -279,6 +285,7 @@ static int really_probe(struct device *dev, struct device_driver *drv)
 {
 	int ret = 0;
 	int local_trigger_count = atomic_read(&deferred_trigger_count);
+	ktime_t start = boot_time_start();
 
 	atomic_inc(&probe_count);
 	pr_debug("bus: '%s': %s: probing driver %s with device %s\n",
@@ -321,6 +328,7 @@ static int really_probe(struct device *dev, struct device_driver *drv)
 	ret = 1;
 	pr_debug("bus: '%s': %s: bound device %s to driver %s\n",
 		 drv->bus->name, __func__, dev_name(dev), drv->name);
+	boot_time_end_dev(BOOT_TIME_PROBE, drv->name, dev_name(dev), start, 0);
 	goto done;
 
 probe_failed:
@@ -330,6 +338,7 @@ probe_failed:
 	dev_set_drvdata(dev, NULL);
 	if (dev->pm_domain && dev->pm_domain->dismiss)
 		dev->pm_domain->dismiss(dev);
+	boot_time_end_dev(BOOT_TIME_PROBE, drv->name, dev_name(dev), start, ret);
 
 	switch (ret) {
 	case -EPROBE_DEFER:
@@ -383,9 +392,13 @@ int driver_probe_done(void)
  */
 void wait_for_device_probe(void)
 {
+	ktime_t start = boot_time_start();
+
 	/* wait for the known devices to complete their probing */
 	wait_event(probe_waitqueue, atomic_read(&probe_count) == 0);
 	async_synchronize_full();
+	boot_time_end_fn(BOOT_TIME_PROBE_WAIT, __builtin_return_address(0),
+			 start, 0);
 }
 EXPORT_SYMBOL_GPL(wait_for_device_probe);
 
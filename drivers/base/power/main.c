@@ -33,6 +33,7 @@
 #include <linux/cpuidle.h>
 #include <linux/timer.h>
 #include <linux/wakeup_reason.h>
+#include <linux/hisi/hisi_pm_async.h>
 
 #if defined CONFIG_LOG_JANK
 #include <huawei_platform/log/log_jank.h>
@@ -211,6 +212,8 @@ static ktime_t initcall_debug_start(struct device *dev)
 			dev_name(dev), task_pid_nr(current),
 			dev->parent ? dev_name(dev->parent) : "none");
 		calltime = ktime_get();
+	} else if (hisi_pm_dev_times_enabled()) {
+		calltime = ktime_get();
 	}
 
 	return calltime;
@@ -229,6 +232,9 @@ static void initcall_debug_report(struct device *dev, ktime_t calltime,
 		pr_info("call %s+ returned %d after %Ld usecs\n", dev_name(dev),
 			error, (unsigned long long)nsecs >> 10);
 	}
+
+	if (hisi_pm_dev_times_enabled())
+		hisi_pm_dev_time_record(dev, state, info, error, nsecs);
 }
 
 /**
@@ -256,6 +262,17 @@ static void dpm_wait_for_children(struct device *dev, bool async)
        device_for_each_child(dev, &async, dpm_wait_fn);
 }
 
+/* devices outside the parent/child tree that @dev needs, see hisi_pm_async */
+static void dpm_wait_for_suppliers(struct device *dev, bool async)
+{
+	hisi_pm_for_each_dep(dev, true, &async, dpm_wait_fn);
+}
+
+static void dpm_wait_for_consumers(struct device *dev, bool async)
+{
+	hisi_pm_for_each_dep(dev, false, &async, dpm_wait_fn);
+}
+
 /**
  * pm_op - Return the PM operation appropriate for given PM event.
  * @ops: PM operations to choose from.
@@ -520,6 +537,7 @@ static int device_resume_noirq(struct device *dev, pm_message_t state, bool asyn
 		goto Out;
 
 	dpm_wait(dev->parent, async);
+	dpm_wait_for_suppliers(dev, async);
 
 	if (dev->pm_domain) {
 		info = "noirq power domain ";
@@ -649,6 +667,7 @@ static int device_resume_early(struct device *dev, pm_message_t state, bool asyn
 		goto Out;
 
 	dpm_wait(dev->parent, async);
+	dpm_wait_for_suppliers(dev, async);
 
 	if (dev->pm_domain) {
 		info = "early power domain ";
@@ -781,6 +800,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 	}
 
 	dpm_wait(dev->parent, async);
+	dpm_wait_for_suppliers(dev, async);
 	dpm_watchdog_set(&wd, dev);
 	device_lock(dev);
 
@@ -1097,6 +1117,7 @@ static int __device_suspend_noirq(struct device *dev, pm_message_t state, bool a
 		goto Complete;
 
 	dpm_wait_for_children(dev, async);
+	dpm_wait_for_consumers(dev, async);
 
 	if (dev->pm_domain) {
 		info = "noirq power domain ";
@@ -1243,6 +1264,7 @@ static int __device_suspend_late(struct device *dev, pm_message_t state, bool as
 		goto Complete;
 
 	dpm_wait_for_children(dev, async);
+	dpm_wait_for_consumers(dev, async);
 
 	if (dev->pm_domain) {
 		info = "late power domain ";
@@ -1419,6 +1441,7 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 	TRACE_SUSPEND(0);
 
 	dpm_wait_for_children(dev, async);
+	dpm_wait_for_consumers(dev, async);
 
 	if (async_error)
 		goto Complete;
@@ -542,6 +542,11 @@ static void wakeup_source_deactivate(struct wakeup_source *ws)
 	if (ws->autosleep_enabled)
 		update_prevent_sleep_time(ws, now);
 
+	if (ws->blocking) {
+		ws->blocked_time = ktime_add(ws->blocked_time, duration);
+		ws->blocking = false;
+	}
+
 	/*
 	 * Increment the counter of registered wakeup events and decrement the
 	 * couter of wakeup events in progress simultaneously.
@@ -749,6 +754,69 @@ void pm_print_active_wakeup_sources(void)
 }
 EXPORT_SYMBOL_GPL(pm_print_active_wakeup_sources);
 
+/**
+ * pm_wakeup_mark_blockers - Account a blocked suspend attempt.
+ *
+ * Charge the attempt to every active wakeup source, the duration of their
+ * current hold is added when they are deactivated. With none active, the
+ * attempt was blocked by an event registered meanwhile, charge it to the
+ * source that was active last.
+ */
+static void pm_wakeup_mark_blockers(void)
+{
+	struct wakeup_source *ws, *last_ws = NULL;
+	unsigned long flags;
+	bool active = false;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(ws, &wakeup_sources, entry) {
+		spin_lock_irqsave(&ws->lock, flags);
+		if (ws->active) {
+			ws->blocked_count++;
+			ws->blocking = true;
+			active = true;
+		} else if (!last_ws || ktime_to_ns(ws->last_time) >
+					ktime_to_ns(last_ws->last_time)) {
+			last_ws = ws;
+		}
+		spin_unlock_irqrestore(&ws->lock, flags);
+	}
+	if (!active && last_ws) {
+		spin_lock_irqsave(&last_ws->lock, flags);
+		last_ws->blocked_count++;
+		spin_unlock_irqrestore(&last_ws->lock, flags);
+	}
+	rcu_read_unlock();
+}
+
+/**
+ * pm_wakeup_blockers_show - Print the wakeup sources that blocked suspend.
+ * @m: seq_file to print into.
+ */
+void pm_wakeup_blockers_show(struct seq_file *m)
+{
+	struct wakeup_source *ws;
+	unsigned long flags;
+	ktime_t blocked_time;
+
+	seq_puts(m, "name\t\tblocked_count\tblocked_time_ms\n");
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(ws, &wakeup_sources, entry) {
+		spin_lock_irqsave(&ws->lock, flags);
+		blocked_time = ws->blocked_time;
+		if (ws->blocking)
+			blocked_time = ktime_add(blocked_time,
+				ktime_sub(ktime_get(), ws->last_time));
+		if (ws->blocked_count)
+			seq_printf(m, "%-12s\t%lu\t\t%lld\n", ws->name,
+				   ws->blocked_count, ktime_to_ms(blocked_time));
+		spin_unlock_irqrestore(&ws->lock, flags);
+	}
+	rcu_read_unlock();
+}
+EXPORT_SYMBOL_GPL(pm_wakeup_blockers_show);
+
 /**
  * pm_wakeup_pending - Check if power transition in progress should be aborted.
  *
@@ -775,6 +843,7 @@ bool pm_wakeup_pending(void)
 	if (ret) {
 		pr_info("PM: Wakeup pending, aborting suspend\n");
 		pm_print_active_wakeup_sources();
+		pm_wakeup_mark_blockers();
 	}
 
 	return ret || pm_abort_suspend;
@@ -854,6 +923,8 @@ bool pm_save_wakeup_count(unsigned int count)
 		events_check_enabled = true;
 	}
 	spin_unlock_irqrestore(&events_lock, flags);
+	if (!events_check_enabled)
+		pm_wakeup_mark_blockers();
 	return events_check_enabled;
 }
 
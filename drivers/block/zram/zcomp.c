@@ -13,6 +13,8 @@
 #include <linux/slab.h>
 #include <linux/wait.h>
 #include <linux/sched.h>
+#include <linux/cpumask.h>
+#include <linux/percpu.h>
 
 #include "zcomp.h"
 #include "zcomp_lzo.h"
@@ -43,6 +45,22 @@ struct zcomp_strm_multi {
 	wait_queue_head_t strm_wait;
 };
 
+/*
+ * per-cpu zcomp_strm backend: one stream for every possible cpu, so
+ * writers on different cpus never wait for each other. The mutex of a
+ * stream is only contended when its writer is preempted by another one
+ * on the same cpu, it also keeps the stream safe if the writer migrates
+ * while compressing.
+ */
+struct zcomp_strm_percpu_slot {
+	struct mutex strm_lock;
+	struct zcomp_strm *zstrm;
+};
+
+struct zcomp_strm_percpu {
+	struct zcomp_strm_percpu_slot __percpu *slots;
+};
+
 static struct zcomp_backend *backends[] = {
 	&zcomp_lzo,
 #ifdef CONFIG_ZRAM_LZ4_COMPRESS
@@ -226,6 +244,78 @@ static int zcomp_strm_multi_create(struct zcomp *comp, int max_strm)
 	return 0;
 }
 
+static struct zcomp_strm *zcomp_strm_percpu_find(struct zcomp *comp)
+{
+	struct zcomp_strm_percpu *zs = comp->stream;
+	struct zcomp_strm_percpu_slot *slot = raw_cpu_ptr(zs->slots);
+
+	mutex_lock(&slot->strm_lock);
+	return slot->zstrm;
+}
+
+static void zcomp_strm_percpu_release(struct zcomp *comp,
+		struct zcomp_strm *zstrm)
+{
+	struct zcomp_strm_percpu *zs = comp->stream;
+
+	mutex_unlock(&per_cpu_ptr(zs->slots, zstrm->cpu)->strm_lock);
+}
+
+static bool zcomp_strm_percpu_set_max_streams(struct zcomp *comp, int num_strm)
+{
+	/* the number of streams follows the number of cpus */
+	return false;
+}
+
+static void zcomp_strm_percpu_destroy(struct zcomp *comp)
+{
+	struct zcomp_strm_percpu *zs = comp->stream;
+	struct zcomp_strm_percpu_slot *slot;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		slot = per_cpu_ptr(zs->slots, cpu);
+		if (slot->zstrm)
+			zcomp_strm_free(comp, slot->zstrm);
+	}
+	free_percpu(zs->slots);
+	kfree(zs);
+}
+
+static int zcomp_strm_percpu_create(struct zcomp *comp)
+{
+	struct zcomp_strm_percpu *zs;
+	struct zcomp_strm_percpu_slot *slot;
+	int cpu;
+
+	comp->destroy = zcomp_strm_percpu_destroy;
+	comp->strm_find = zcomp_strm_percpu_find;
+	comp->strm_release = zcomp_strm_percpu_release;
+	comp->set_max_streams = zcomp_strm_percpu_set_max_streams;
+	zs = kmalloc(sizeof(struct zcomp_strm_percpu), GFP_KERNEL);
+	if (!zs)
+		return -ENOMEM;
+
+	zs->slots = alloc_percpu(struct zcomp_strm_percpu_slot);
+	if (!zs->slots) {
+		kfree(zs);
+		return -ENOMEM;
+	}
+	comp->stream = zs;
+
+	for_each_possible_cpu(cpu) {
+		slot = per_cpu_ptr(zs->slots, cpu);
+		mutex_init(&slot->strm_lock);
+		slot->zstrm = zcomp_strm_alloc(comp, GFP_KERNEL);
+		if (!slot->zstrm) {
+			zcomp_strm_percpu_destroy(comp);
+			return -ENOMEM;
+		}
+		slot->zstrm->cpu = cpu;
+	}
+	return 0;
+}
+
 static struct zcomp_strm *zcomp_strm_single_find(struct zcomp *comp)
 {
 	struct zcomp_strm_single *zs = comp->stream;
@@ -299,6 +389,16 @@ bool zcomp_available_algorithm(const char *comp)
 	return find_backend(comp) != NULL;
 }
 
+/* max_comp_streams of a new device */
+int zcomp_default_max_streams(void)
+{
+#ifdef CONFIG_ZRAM_PERCPU_STREAMS
+	return num_possible_cpus();
+#else
+	return 1;
+#endif
+}
+
 bool zcomp_set_max_streams(struct zcomp *comp, int num_strm)
 {
 	return comp->set_max_streams(comp, num_strm);
@@ -339,7 +439,8 @@ void zcomp_destroy(struct zcomp *comp)
  * backend pointer or ERR_PTR if things went bad. ERR_PTR(-EINVAL)
  * if requested algorithm is not supported, ERR_PTR(-ENOMEM) in
  * case of allocation error, or any other error potentially
- * returned by functions zcomp_strm_{multi,single}_create.
+ * returned by functions zcomp_strm_{percpu,multi,single}_create.
+ * A stream per possible cpu is used as soon as @max_strm allows it.
  */
 struct zcomp *zcomp_create(const char *compress, int max_strm)
 {
@@ -356,6 +457,11 @@ struct zcomp *zcomp_create(const char *compress, int max_strm)
 		return ERR_PTR(-ENOMEM);
 
 	comp->backend = backend;
+#ifdef CONFIG_ZRAM_PERCPU_STREAMS
+	if (max_strm > 1 && max_strm >= (int)num_possible_cpus())
+		error = zcomp_strm_percpu_create(comp);
+	else
+#endif
 	if (max_strm > 1)
 		error = zcomp_strm_multi_create(comp, max_strm);
 	else
@@ -23,6 +23,8 @@ struct zcomp_strm {
 	void *private;
 	/* used in multi stream backend, protected by backend strm_lock */
 	struct list_head list;
+	/* used in per-cpu stream backend, the cpu owning the stream */
+	int cpu;
 };
 
 /* static compression backend */
@@ -66,4 +68,5 @@ int zcomp_decompress(struct zcomp *comp, const unsigned char *src,
 		size_t src_len, unsigned char *dst);
 
 bool zcomp_set_max_streams(struct zcomp *comp, int num_strm);
+int zcomp_default_max_streams(void);
 #endif /* _ZCOMP_H_ */
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2017 Huawei Technologies Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/jhash.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+
+#include "zram_drv.h"
+
+/* pages per hash bucket, each bucket being an rb tree of checksums */
+#define ZRAM_HASH_SHIFT		8
+
+bool zram_dedup_enabled(struct zram *zram)
+{
+	return ACCESS_ONCE(zram->use_dedup);
+}
+
+u32 zram_dedup_checksum(unsigned char *mem)
+{
+	return jhash(mem, PAGE_SIZE, 0);
+}
+
+static struct zram_hash *zram_dedup_hash(struct zram_meta *meta, u32 checksum)
+{
+	return &meta->hash[checksum % meta->hash_size];
+}
+
+static bool zram_dedup_match(struct zram *zram, struct zram_entry *entry,
+			struct zcomp_strm *zstrm, unsigned char *mem)
+{
+	struct zram_meta *meta = zram->meta;
+	unsigned char *cmem;
+	bool match;
+
+	cmem = zs_map_object(meta->mem_pool, entry->handle, ZS_MM_RO);
+	if (entry->len == PAGE_SIZE)
+		match = !memcmp(mem, cmem, PAGE_SIZE);
+	else
+		/* zstrm->buffer is only compressed into after the lookup */
+		match = !zcomp_decompress(zram->comp, cmem, entry->len,
+					zstrm->buffer) &&
+			!memcmp(mem, zstrm->buffer, PAGE_SIZE);
+	zs_unmap_object(meta->mem_pool, entry->handle);
+
+	return match;
+}
+
+/*
+ * Look for an object holding the same content as the page at @mem,
+ * return it with a new reference taken or NULL.
+ */
+struct zram_entry *zram_dedup_find(struct zram *zram, struct zcomp_strm *zstrm,
+				unsigned char *mem, u32 checksum)
+{
+	struct zram_hash *hash = zram_dedup_hash(zram->meta, checksum);
+	struct zram_entry *entry = NULL;
+	struct rb_node *node;
+
+	spin_lock(&hash->lock);
+	node = hash->rb_root.rb_node;
+	while (node) {
+		entry = rb_entry(node, struct zram_entry, rb_node);
+		if (checksum == entry->checksum)
+			break;
+		node = checksum < entry->checksum ?
+			node->rb_left : node->rb_right;
+	}
+	if (!node) {
+		spin_unlock(&hash->lock);
+		return NULL;
+	}
+	entry->refcount++;
+	atomic64_add(entry->len, &zram->stats.dup_data_size);
+	spin_unlock(&hash->lock);
+
+	if (zram_dedup_match(zram, entry, zstrm, mem))
+		return entry;
+
+	/* a checksum collision, the page gets an object of its own */
+	zram_dedup_put(zram, zram->meta, entry);
+	return NULL;
+}
+
+/* make the new object @handle of @len bytes shareable */
+struct zram_entry *zram_dedup_add(struct zram *zram, unsigned long handle,
+				unsigned int len, u32 checksum)
+{
+	struct zram_hash *hash = zram_dedup_hash(zram->meta, checksum);
+	struct zram_entry *entry, *cur;
+	struct rb_node **link, *parent = NULL;
+
+	entry = kmalloc(sizeof(*entry), GFP_NOIO | __GFP_NOWARN);
+	if (!entry)
+		return NULL;
+
+	entry->checksum = checksum;
+	entry->len = len;
+	entry->handle = handle;
+	entry->refcount = 1;
+
+	spin_lock(&hash->lock);
+	link = &hash->rb_root.rb_node;
+	while (*link) {
+		parent = *link;
+		cur = rb_entry(parent, struct zram_entry, rb_node);
+		if (checksum < cur->checksum)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&entry->rb_node, parent, link);
+	rb_insert_color(&entry->rb_node, &hash->rb_root);
+	spin_unlock(&hash->lock);
+
+	atomic64_add(sizeof(*entry), &zram->stats.meta_data_size);
+	return entry;
+}
+
+/*
+ * Drop a reference to @entry. Returns true when it was the last one
+ * and the compressed object is gone as well, its size already taken
+ * off compr_data_size.
+ */
+bool zram_dedup_put(struct zram *zram, struct zram_meta *meta,
+				struct zram_entry *entry)
+{
+	struct zram_hash *hash = zram_dedup_hash(meta, entry->checksum);
+	unsigned long refcount;
+
+	spin_lock(&hash->lock);
+	refcount = --entry->refcount;
+	if (!refcount)
+		rb_erase(&entry->rb_node, &hash->rb_root);
+	spin_unlock(&hash->lock);
+
+	if (refcount) {
+		atomic64_sub(entry->len, &zram->stats.dup_data_size);
+		return false;
+	}
+
+	zs_free(meta->mem_pool, entry->handle);
+	atomic64_sub(entry->len, &zram->stats.compr_data_size);
+	atomic64_sub(sizeof(*entry), &zram->stats.meta_data_size);
+	kfree(entry);
+	return true;
+}
+
+int zram_dedup_init(struct zram *zram, struct zram_meta *meta,
+				size_t num_pages)
+{
+	size_t i;
+
+	meta->hash_size = max_t(size_t, num_pages >> ZRAM_HASH_SHIFT, 1);
+	meta->hash = vzalloc(meta->hash_size * sizeof(struct zram_hash));
+	if (!meta->hash) {
+		pr_err("Error allocating zram entry hash\n");
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < meta->hash_size; i++) {
+		spin_lock_init(&meta->hash[i].lock);
+		meta->hash[i].rb_root = RB_ROOT;
+	}
+
+	return 0;
+}
+
+/* free every shared object, no I/O may be running on @meta any more */
+void zram_dedup_fini(struct zram_meta *meta)
+{
+	struct zram_entry *entry;
+	struct rb_node *node;
+	size_t i;
+
+	if (!meta->hash)
+		return;
+
+	for (i = 0; i < meta->hash_size; i++) {
+		while ((node = rb_first(&meta->hash[i].rb_root))) {
+			entry = rb_entry(node, struct zram_entry, rb_node);
+			rb_erase(node, &meta->hash[i].rb_root);
+			zs_free(meta->mem_pool, entry->handle);
+			kfree(entry);
+		}
+	}
+
+	vfree(meta->hash);
+	meta->hash = NULL;
+	meta->hash_size = 0;
+}
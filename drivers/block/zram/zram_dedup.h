@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2017 Huawei Technologies Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+#ifndef _ZRAM_DEDUP_H_
+#define _ZRAM_DEDUP_H_
+
+#include <linux/rbtree.h>
+#include <linux/spinlock.h>
+
+struct zram;
+struct zram_meta;
+struct zcomp_strm;
+
+/*
+ * A compressed object shared by all the zram pages with the same
+ * content. table[index].handle points to one of these when the page
+ * has the ZRAM_DEDUP flag.
+ */
+struct zram_entry {
+	struct rb_node rb_node;
+	u32 checksum;
+	unsigned int len;
+	unsigned long handle;
+	unsigned long refcount;		/* protected by the hash lock */
+};
+
+struct zram_hash {
+	spinlock_t lock;
+	struct rb_root rb_root;
+};
+
+#ifdef CONFIG_ZRAM_DEDUP
+bool zram_dedup_enabled(struct zram *zram);
+u32 zram_dedup_checksum(unsigned char *mem);
+struct zram_entry *zram_dedup_find(struct zram *zram, struct zcomp_strm *zstrm,
+				unsigned char *mem, u32 checksum);
+struct zram_entry *zram_dedup_add(struct zram *zram, unsigned long handle,
+				unsigned int len, u32 checksum);
+bool zram_dedup_put(struct zram *zram, struct zram_meta *meta,
+				struct zram_entry *entry);
+int zram_dedup_init(struct zram *zram, struct zram_meta *meta,
+				size_t num_pages);
+void zram_dedup_fini(struct zram_meta *meta);
+#else
+static inline bool zram_dedup_enabled(struct zram *zram) { return false; }
+static inline u32 zram_dedup_checksum(unsigned char *mem) { return 0; }
+static inline struct zram_entry *zram_dedup_find(struct zram *zram,
+		struct zcomp_strm *zstrm, unsigned char *mem, u32 checksum)
+{
+	return NULL;
+}
+static inline struct zram_entry *zram_dedup_add(struct zram *zram,
+		unsigned long handle, unsigned int len, u32 checksum)
+{
+	return NULL;
+}
+static inline bool zram_dedup_put(struct zram *zram,
+		struct zram_meta *meta, struct zram_entry *entry)
+{
+	return true;
+}
+static inline int zram_dedup_init(struct zram *zram, struct zram_meta *meta,
+		size_t num_pages)
+{
+	return 0;
+}
+static inline void zram_dedup_fini(struct zram_meta *meta) {}
+#endif
+
+#endif /* _ZRAM_DEDUP_H_ */
@@ -30,6 +30,12 @@
 #include <linux/err.h>
 #include <linux/idr.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/topology.h>
+#include <linux/bitmap.h>
+#include <linux/fs.h>
+#include <linux/workqueue.h>
+#include <linux/rcc_uid_stat.h>
 
 #include "zram_drv.h"
 
@@ -38,7 +44,11 @@ static DEFINE_IDR(zram_index_idr);
 static DEFINE_MUTEX(zram_index_mutex);
 
 static int zram_major;
+#ifdef CONFIG_ZRAM_LZ4_COMPRESS
+static const char *default_compressor = "lz4";
+#else
 static const char *default_compressor = "lzo";
+#endif
 
 /* Module params (documentation at end) */
 static unsigned int num_devices = 1;
@@ -93,6 +103,14 @@ static void zram_clear_flag(struct zram_meta *meta, u32 index,
 	meta->table[index].value &= ~BIT(flag);
 }
 
+/* zsmalloc handle of the object stored for @index */
+static unsigned long zram_get_handle(struct zram_meta *meta, u32 index)
+{
+	if (zram_test_flag(meta, index, ZRAM_DEDUP))
+		return ((struct zram_entry *)meta->table[index].handle)->handle;
+	return meta->table[index].handle;
+}
+
 static size_t zram_get_obj_size(struct zram_meta *meta, u32 index)
 {
 	return meta->table[index].value & (BIT(ZRAM_FLAG_SHIFT) - 1);
@@ -385,6 +403,36 @@ static ssize_t comp_algorithm_store(struct device *dev,
 	return len;
 }
 
+#ifdef CONFIG_ZRAM_DEDUP
+static ssize_t use_dedup_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", (int)zram->use_dedup);
+}
+
+/*
+ * Can be flipped at any time: pages already shared stay shared, the
+ * setting only decides whether new writes look for a duplicate.
+ */
+static ssize_t use_dedup_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long val;
+
+	if (kstrtoul(buf, 10, &val))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	zram->use_dedup = !!val;
+	up_write(&zram->init_lock);
+
+	return len;
+}
+#endif
+
 static ssize_t compact_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
@@ -412,11 +460,14 @@ static ssize_t io_stat_show(struct device *dev,
 
 	down_read(&zram->init_lock);
 	ret = scnprintf(buf, PAGE_SIZE,
-			"%8llu %8llu %8llu %8llu\n",
+			"%8llu %8llu %8llu %8llu %8llu %8llu %8llu\n",
 			(u64)atomic64_read(&zram->stats.failed_reads),
 			(u64)atomic64_read(&zram->stats.failed_writes),
 			(u64)atomic64_read(&zram->stats.invalid_io),
-			(u64)atomic64_read(&zram->stats.notify_free));
+			(u64)atomic64_read(&zram->stats.notify_free),
+			(u64)atomic64_read(&zram->stats.bd_count),
+			(u64)atomic64_read(&zram->stats.bd_reads),
+			(u64)atomic64_read(&zram->stats.bd_writes));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -443,14 +494,16 @@ static ssize_t mm_stat_show(struct device *dev,
 	max_used = atomic_long_read(&zram->stats.max_used_pages);
 
 	ret = scnprintf(buf, PAGE_SIZE,
-			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu\n",
+			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu %8llu %8llu\n",
 			orig_size << PAGE_SHIFT,
 			(u64)atomic64_read(&zram->stats.compr_data_size),
 			mem_used << PAGE_SHIFT,
 			zram->limit_pages << PAGE_SHIFT,
 			max_used << PAGE_SHIFT,
 			(u64)atomic64_read(&zram->stats.zero_pages),
-			pool_stats.pages_compacted);
+			pool_stats.pages_compacted,
+			(u64)atomic64_read(&zram->stats.dup_data_size),
+			(u64)atomic64_read(&zram->stats.meta_data_size));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -467,6 +520,392 @@ ZRAM_ATTR_RO(notify_free);
 ZRAM_ATTR_RO(zero_pages);
 ZRAM_ATTR_RO(compr_data_size);
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+static inline void zram_accessed(struct zram_meta *meta, u32 index)
+{
+	meta->table[index].ac_time = jiffies;
+}
+
+static void reset_bdev(struct zram *zram)
+{
+	if (!zram->backing_dev)
+		return;
+
+	set_blocksize(zram->bdev, zram->old_block_size);
+	blkdev_put(zram->bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	filp_close(zram->backing_dev, NULL);
+	zram->backing_dev = NULL;
+	zram->bdev = NULL;
+	zram->old_block_size = 0;
+	vfree(zram->bitmap);
+	zram->bitmap = NULL;
+	zram->nr_blocks = 0;
+}
+
+static ssize_t backing_dev_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct file *file;
+	ssize_t ret;
+	char *p;
+
+	down_read(&zram->init_lock);
+	file = zram->backing_dev;
+	if (!file) {
+		ret = scnprintf(buf, PAGE_SIZE, "none\n");
+		goto out;
+	}
+
+	p = d_path(&file->f_path, buf, PAGE_SIZE - 1);
+	if (IS_ERR(p)) {
+		ret = PTR_ERR(p);
+		goto out;
+	}
+
+	ret = strlen(p);
+	memmove(buf, p, ret);
+	buf[ret++] = '\n';
+out:
+	up_read(&zram->init_lock);
+	return ret;
+}
+
+static ssize_t backing_dev_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct file *backing_dev = NULL;
+	struct block_device *bdev = NULL;
+	unsigned long *bitmap = NULL;
+	unsigned long nr_blocks;
+	unsigned int old_block_size;
+	struct inode *inode;
+	char *file_name;
+	size_t sz;
+	int err;
+
+	file_name = kmalloc(PATH_MAX, GFP_KERNEL);
+	if (!file_name)
+		return -ENOMEM;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		pr_info("Can't setup backing device for initialized device\n");
+		err = -EBUSY;
+		goto out;
+	}
+
+	strlcpy(file_name, buf, PATH_MAX);
+	/* ignore trailing newline */
+	sz = strlen(file_name);
+	if (sz > 0 && file_name[sz - 1] == '\n')
+		file_name[sz - 1] = 0x00;
+
+	backing_dev = filp_open(file_name, O_RDWR | O_LARGEFILE, 0);
+	if (IS_ERR(backing_dev)) {
+		err = PTR_ERR(backing_dev);
+		backing_dev = NULL;
+		goto out;
+	}
+
+	/*
+	 * only block devices: going through a file system would cache
+	 * every page written back a second time in the page cache
+	 */
+	inode = backing_dev->f_mapping->host;
+	if (!S_ISBLK(inode->i_mode)) {
+		err = -ENOTBLK;
+		goto out;
+	}
+
+	bdev = bdgrab(I_BDEV(inode));
+	err = blkdev_get(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL, zram);
+	if (err < 0) {
+		/* blkdev_get dropped the reference */
+		bdev = NULL;
+		goto out;
+	}
+
+	nr_blocks = i_size_read(inode) >> PAGE_SHIFT;
+	if (nr_blocks < 2) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	bitmap = vzalloc(BITS_TO_LONGS(nr_blocks) * sizeof(long));
+	if (!bitmap) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	old_block_size = block_size(bdev);
+	err = set_blocksize(bdev, PAGE_SIZE);
+	if (err)
+		goto out;
+
+	reset_bdev(zram);
+	/* block 0 is never used so that a zero handle still means no data */
+	set_bit(0, bitmap);
+
+	zram->old_block_size = old_block_size;
+	zram->bdev = bdev;
+	zram->backing_dev = backing_dev;
+	zram->bitmap = bitmap;
+	zram->nr_blocks = nr_blocks;
+	up_write(&zram->init_lock);
+
+	pr_info("setup backing device %s\n", file_name);
+	kfree(file_name);
+
+	return len;
+out:
+	vfree(bitmap);
+	if (bdev)
+		blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	if (backing_dev)
+		filp_close(backing_dev, NULL);
+	up_write(&zram->init_lock);
+	kfree(file_name);
+	return err;
+}
+
+static ssize_t writeback_age_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n", zram->wb_age);
+}
+
+static ssize_t writeback_age_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned int age;
+	int ret;
+
+	ret = kstrtouint(buf, 10, &age);
+	if (ret)
+		return ret;
+
+	zram->wb_age = age;
+	return len;
+}
+
+/*
+ * Reserve a run of up to *@nr free blocks, halving it until one is
+ * found. *@nr is set to the length reserved, 0 if the device is full.
+ */
+static unsigned long zram_bd_alloc(struct zram *zram, unsigned int *nr)
+{
+	unsigned int want = *nr;
+	unsigned long blk;
+
+	spin_lock(&zram->bitmap_lock);
+	for (; want; want >>= 1) {
+		blk = bitmap_find_next_zero_area(zram->bitmap, zram->nr_blocks,
+						 1, want, 0);
+		if (blk < zram->nr_blocks) {
+			bitmap_set(zram->bitmap, blk, want);
+			break;
+		}
+	}
+	spin_unlock(&zram->bitmap_lock);
+
+	*nr = want;
+	return want ? blk : 0;
+}
+
+static void zram_bd_free(struct zram *zram, unsigned long blk,
+			 unsigned int nr)
+{
+	spin_lock(&zram->bitmap_lock);
+	bitmap_clear(zram->bitmap, blk, nr);
+	spin_unlock(&zram->bitmap_lock);
+}
+
+/* synchronous I/O of @nr pages to the contiguous blocks at @blk */
+static int zram_bd_submit(struct zram *zram, unsigned long blk,
+			  struct page **pages, unsigned int nr, int rw)
+{
+	struct bio *bio;
+	unsigned int i;
+	int ret;
+
+	while (nr) {
+		bio = bio_alloc(GFP_NOIO, nr);
+		if (!bio)
+			return -ENOMEM;
+
+		bio->bi_iter.bi_sector = blk << (PAGE_SHIFT - SECTOR_SHIFT);
+		bio->bi_bdev = zram->bdev;
+		for (i = 0; i < nr; i++)
+			if (!bio_add_page(bio, pages[i], PAGE_SIZE, 0))
+				break;
+		if (!i) {
+			bio_put(bio);
+			return -EIO;
+		}
+
+		ret = submit_bio_wait(rw, bio);
+		bio_put(bio);
+		if (ret)
+			return ret;
+
+		blk += i;
+		pages += i;
+		nr -= i;
+	}
+	return 0;
+}
+
+struct zram_bd_work {
+	struct work_struct work;
+	struct zram *zram;
+	unsigned long blk;
+	struct page *page;
+	int ret;
+};
+
+static void zram_bd_read_work(struct work_struct *work)
+{
+	struct zram_bd_work *zw = container_of(work, struct zram_bd_work, work);
+
+	zw->ret = zram_bd_submit(zw->zram, zw->blk, &zw->page, 1, READ);
+}
+
+static int zram_bd_read_page(struct zram *zram, unsigned long blk,
+			     struct page *page)
+{
+	struct zram_bd_work zw;
+
+	atomic64_inc(&zram->stats.bd_reads);
+	if (!current->bio_list)
+		return zram_bd_submit(zram, blk, &page, 1, READ);
+
+	/*
+	 * Inside make_request a bio submitted by this task is only issued
+	 * once it returns, so waiting for it here would never end.
+	 */
+	zw.zram = zram;
+	zw.blk = blk;
+	zw.page = page;
+	INIT_WORK_ONSTACK(&zw.work, zram_bd_read_work);
+	queue_work(system_unbound_wq, &zw.work);
+	flush_work(&zw.work);
+	destroy_work_on_stack(&zw.work);
+
+	return zw.ret;
+}
+
+/* -EAGAIN when @index is not, or no longer, on the backing device */
+static int zram_bd_read_slot(struct zram *zram, u32 index, struct page *page)
+{
+	struct zram_meta *meta = zram->meta;
+	unsigned long blk;
+	int ret;
+
+	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+	if (!zram_test_flag(meta, index, ZRAM_WB)) {
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		return -EAGAIN;
+	}
+	blk = meta->table[index].handle;
+	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+	ret = zram_bd_read_page(zram, blk, page);
+	if (ret)
+		return ret;
+
+	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+	if (!zram_test_flag(meta, index, ZRAM_WB) ||
+			meta->table[index].handle != blk)
+		ret = -EAGAIN;
+	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+	return ret;
+}
+
+static int zram_bd_read_buf(struct zram *zram, u32 index, char *buf)
+{
+	struct page *page;
+	char *src;
+	int ret;
+
+	page = alloc_page(GFP_NOIO);
+	if (!page)
+		return -ENOMEM;
+
+	ret = zram_bd_read_slot(zram, index, page);
+	if (!ret) {
+		src = kmap_atomic(page);
+		copy_page(buf, src);
+		kunmap_atomic(src);
+	}
+	__free_page(page);
+
+	return ret;
+}
+
+static int zram_bvec_read_bd(struct zram *zram, struct bio_vec *bvec,
+			     u32 index, int offset)
+{
+	struct page *page = bvec->bv_page;
+	unsigned char *user_mem, *uncmem;
+	int ret;
+
+	if (!is_partial_io(bvec)) {
+		ret = zram_bd_read_slot(zram, index, page);
+		if (!ret)
+			flush_dcache_page(page);
+		return ret;
+	}
+
+	/* Use  a temporary buffer to read the page */
+	uncmem = kmalloc(PAGE_SIZE, GFP_NOIO);
+	if (!uncmem)
+		return -ENOMEM;
+
+	ret = zram_bd_read_buf(zram, index, uncmem);
+	if (!ret) {
+		user_mem = kmap_atomic(page);
+		memcpy(user_mem + bvec->bv_offset, uncmem + offset,
+				bvec->bv_len);
+		kunmap_atomic(user_mem);
+		flush_dcache_page(page);
+	}
+	kfree(uncmem);
+
+	return ret;
+}
+
+static void zram_wb_init(struct zram *zram)
+{
+	spin_lock_init(&zram->bitmap_lock);
+	mutex_init(&zram->wb_lock);
+	zram->wb_age = ZRAM_WB_DEFAULT_AGE;
+}
+#else
+static inline void zram_accessed(struct zram_meta *meta, u32 index) {}
+static inline void reset_bdev(struct zram *zram) {}
+static inline void zram_bd_free(struct zram *zram, unsigned long blk,
+				unsigned int nr) {}
+
+static inline int zram_bd_read_buf(struct zram *zram, u32 index, char *buf)
+{
+	return -EIO;
+}
+
+static inline int zram_bvec_read_bd(struct zram *zram, struct bio_vec *bvec,
+				    u32 index, int offset)
+{
+	return -EIO;
+}
+
+static inline void zram_wb_init(struct zram *zram) {}
+#endif
+
 static inline bool zram_meta_get(struct zram *zram)
 {
 	if (atomic_inc_not_zero(&zram->refcount))
@@ -476,7 +915,8 @@ static inline bool zram_meta_get(struct zram *zram)
 
 static inline void zram_meta_put(struct zram *zram)
 {
-	atomic_dec(&zram->refcount);
+	if (atomic_dec_and_test(&zram->refcount))
+		wake_up(&zram->io_done);
 }
 
 static void zram_meta_free(struct zram_meta *meta, u64 disksize)
@@ -488,12 +928,18 @@ static void zram_meta_free(struct zram_meta *meta, u64 disksize)
 	for (index = 0; index < num_pages; index++) {
 		unsigned long handle = meta->table[index].handle;
 
-		if (!handle)
+		/*
+		 * shared objects are freed with the dedup hash, written
+		 * back pages with the backing device
+		 */
+		if (!handle || zram_test_flag(meta, index, ZRAM_DEDUP) ||
+				zram_test_flag(meta, index, ZRAM_WB))
 			continue;
 
 		zs_free(meta->mem_pool, handle);
 	}
 
+	zram_dedup_fini(meta);
 	zs_destroy_pool(meta->mem_pool);
 	vfree(meta->table);
 	kfree(meta);
@@ -538,6 +984,9 @@ static void zram_free_page(struct zram *zram, size_t index)
 	struct zram_meta *meta = zram->meta;
 	unsigned long handle = meta->table[index].handle;
 
+	/* a writeback in flight must not commit the old content */
+	zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+
 	if (unlikely(!handle)) {
 		/*
 		 * No memory is allocated for zero filled pages.
@@ -550,10 +999,18 @@ static void zram_free_page(struct zram *zram, size_t index)
 		return;
 	}
 
-	zs_free(meta->mem_pool, handle);
-
-	atomic64_sub(zram_get_obj_size(meta, index),
-			&zram->stats.compr_data_size);
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		zram_bd_free(zram, handle, 1);
+		zram_clear_flag(meta, index, ZRAM_WB);
+		atomic64_dec(&zram->stats.bd_count);
+	} else if (zram_test_flag(meta, index, ZRAM_DEDUP)) {
+		zram_dedup_put(zram, meta, (struct zram_entry *)handle);
+		zram_clear_flag(meta, index, ZRAM_DEDUP);
+	} else {
+		zs_free(meta->mem_pool, handle);
+		atomic64_sub(zram_get_obj_size(meta, index),
+				&zram->stats.compr_data_size);
+	}
 	atomic64_dec(&zram->stats.pages_stored);
 
 	meta->table[index].handle = 0;
@@ -569,14 +1026,20 @@ static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 	size_t size;
 
 	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
-	handle = meta->table[index].handle;
 	size = zram_get_obj_size(meta, index);
 
-	if (!handle || zram_test_flag(meta, index, ZRAM_ZERO)) {
+	if (!meta->table[index].handle ||
+			zram_test_flag(meta, index, ZRAM_ZERO)) {
 		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 		clear_page(mem);
 		return 0;
 	}
+	/* the caller has to read it from the backing device */
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		return -EAGAIN;
+	}
+	handle = zram_get_handle(meta, index);
 
 	cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_RO);
 	if (size == PAGE_SIZE)
@@ -604,13 +1067,22 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	struct zram_meta *meta = zram->meta;
 	page = bvec->bv_page;
 
+again:
 	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+	zram_accessed(meta, index);
 	if (unlikely(!meta->table[index].handle) ||
 			zram_test_flag(meta, index, ZRAM_ZERO)) {
 		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 		handle_zero_page(bvec);
 		return 0;
 	}
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		ret = zram_bvec_read_bd(zram, bvec, index, offset);
+		if (ret == -EAGAIN)
+			goto again;
+		return ret;
+	}
 	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 
 	if (is_partial_io(bvec))
@@ -642,6 +1114,9 @@ out_cleanup:
 	kunmap_atomic(user_mem);
 	if (is_partial_io(bvec))
 		kfree(uncmem);
+	/* written back since the check above */
+	if (ret == -EAGAIN)
+		goto again;
 	return ret;
 }
 
@@ -650,12 +1125,15 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 {
 	int ret = 0;
 	size_t clen;
-	unsigned long handle;
+	unsigned long handle = 0;
 	struct page *page;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
 	struct zram_meta *meta = zram->meta;
 	struct zcomp_strm *zstrm = NULL;
+	struct zram_entry *entry = NULL;
 	unsigned long alloced_pages;
+	bool dedup, dup = false;
+	u32 checksum = 0;
 
 	page = bvec->bv_page;
 	if (is_partial_io(bvec)) {
@@ -668,7 +1146,12 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			ret = -ENOMEM;
 			goto out;
 		}
-		ret = zram_decompress_page(zram, uncmem, index);
+		while ((ret = zram_decompress_page(zram, uncmem, index)) ==
+				-EAGAIN) {
+			ret = zram_bd_read_buf(zram, index, uncmem);
+			if (ret != -EAGAIN)
+				break;
+		}
 		if (ret)
 			goto out;
 	}
@@ -695,10 +1178,28 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 
 		atomic64_inc(&zram->stats.zero_pages);
+		if (PageSwapCache(bvec->bv_page))
+			rcc_uid_swap_out(PAGE_SIZE, 0);
 		ret = 0;
 		goto out;
 	}
 
+	dedup = zram_dedup_enabled(zram);
+	if (dedup) {
+		checksum = zram_dedup_checksum(uncmem);
+		entry = zram_dedup_find(zram, zstrm, uncmem, checksum);
+		if (entry) {
+			if (!is_partial_io(bvec)) {
+				kunmap_atomic(user_mem);
+				user_mem = NULL;
+				uncmem = NULL;
+			}
+			clen = entry->len;
+			dup = true;
+			goto store;
+		}
+	}
+
 	ret = zcomp_compress(zram->comp, zstrm, uncmem, &clen);
 	if (!is_partial_io(bvec)) {
 		kunmap_atomic(user_mem);
@@ -748,6 +1249,10 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	zstrm = NULL;
 	zs_unmap_object(meta->mem_pool, handle);
 
+	/* without an entry the object is simply not shared */
+	if (dedup)
+		entry = zram_dedup_add(zram, handle, clen, checksum);
+store:
 	/*
 	 * Free memory associated with this sector
 	 * before overwriting unused sectors.
@@ -755,13 +1260,22 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
 	zram_free_page(zram, index);
 
-	meta->table[index].handle = handle;
+	if (entry) {
+		meta->table[index].handle = (unsigned long)entry;
+		zram_set_flag(meta, index, ZRAM_DEDUP);
+	} else {
+		meta->table[index].handle = handle;
+	}
 	zram_set_obj_size(meta, index, clen);
+	zram_accessed(meta, index);
 	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 
 	/* Update stats */
-	atomic64_add(clen, &zram->stats.compr_data_size);
+	if (!dup)
+		atomic64_add(clen, &zram->stats.compr_data_size);
 	atomic64_inc(&zram->stats.pages_stored);
+	if (PageSwapCache(bvec->bv_page))
+		rcc_uid_swap_out(PAGE_SIZE, dup ? 0 : clen);
 out:
 	if (zstrm)
 		zcomp_strm_release(zram->comp, zstrm);
@@ -833,6 +1347,9 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 			atomic64_inc(&zram->stats.failed_reads);
 		else
 			atomic64_inc(&zram->stats.failed_writes);
+	} else if (rw == READ && PageSwapCache(bvec->bv_page)) {
+		/* zram may back a filesystem too, only count swap-ins */
+		rcc_uid_swap_in();
 	}
 
 	return ret;
@@ -892,6 +1409,328 @@ out:
 	bio_io_error(bio);
 }
 
+#ifdef CONFIG_ZRAM_WRITE_OFFLOAD
+/*
+ * Write offload: write bios are queued to a few workers kept on the
+ * cluster of cpu0, the little cores, which compress them in batches of
+ * ZRAM_OFFLOAD_BATCH bios per wakeup. Each queued bio keeps the meta
+ * reference taken by zram_make_request() until a worker is done with
+ * it, so reset still waits for all of them.
+ */
+static int zram_offload_worker(void *data)
+{
+	struct zram *zram = data;
+	struct bio_list batch;
+	struct bio *bio;
+	unsigned int nr, left;
+
+	/* swap-out runs on behalf of reclaim and must not recurse into it */
+	current->flags |= PF_MEMALLOC;
+	set_cpus_allowed_ptr(current, topology_core_cpumask(0));
+
+	for (;;) {
+		wait_event_interruptible_exclusive(zram->offload_wait,
+				ACCESS_ONCE(zram->offload_pending) ||
+				kthread_should_stop());
+
+		bio_list_init(&batch);
+		spin_lock_irq(&zram->offload_lock);
+		for (nr = 0; nr < ZRAM_OFFLOAD_BATCH; nr++) {
+			bio = bio_list_pop(&zram->offload_bios);
+			if (!bio)
+				break;
+			bio_list_add(&batch, bio);
+		}
+		zram->offload_pending -= nr;
+		left = zram->offload_pending;
+		spin_unlock_irq(&zram->offload_lock);
+
+		/* queued bios are drained before stopping */
+		if (!nr && kthread_should_stop())
+			break;
+
+		/* hand the rest to another worker while this batch runs */
+		if (left)
+			wake_up_interruptible(&zram->offload_wait);
+
+		while ((bio = bio_list_pop(&batch))) {
+			__zram_make_request(zram, bio);
+			zram_meta_put(zram);
+		}
+	}
+
+	return 0;
+}
+
+static bool zram_offload_write(struct zram *zram, struct bio *bio)
+{
+	unsigned long flags;
+	unsigned int pending;
+
+	if (!ACCESS_ONCE(zram->offload) || bio_data_dir(bio) != WRITE ||
+			(bio->bi_rw & REQ_DISCARD))
+		return false;
+
+	spin_lock_irqsave(&zram->offload_lock, flags);
+	if (!zram->offload) {
+		spin_unlock_irqrestore(&zram->offload_lock, flags);
+		return false;
+	}
+	bio_list_add(&zram->offload_bios, bio);
+	pending = ++zram->offload_pending;
+	spin_unlock_irqrestore(&zram->offload_lock, flags);
+
+	if (pending == 1 || !(pending % ZRAM_OFFLOAD_BATCH))
+		wake_up_interruptible(&zram->offload_wait);
+	return true;
+}
+
+/* rw_page writes are bounced so that they come back as offloaded bios */
+static inline bool zram_offload_rw_page(struct zram *zram, int rw)
+{
+	return rw == WRITE && ACCESS_ONCE(zram->offload);
+}
+
+/* should be called with offload_mutex held */
+static void zram_offload_stop(struct zram *zram)
+{
+	int i;
+
+	spin_lock_irq(&zram->offload_lock);
+	zram->offload = false;
+	spin_unlock_irq(&zram->offload_lock);
+
+	for (i = 0; i < ZRAM_OFFLOAD_MAX_WORKERS; i++) {
+		if (zram->offload_tsk[i]) {
+			kthread_stop(zram->offload_tsk[i]);
+			zram->offload_tsk[i] = NULL;
+		}
+	}
+}
+
+/* should be called with offload_mutex held */
+static int zram_offload_start(struct zram *zram)
+{
+	struct task_struct *tsk;
+	int i, nr;
+
+	nr = min_t(int, cpumask_weight(topology_core_cpumask(0)),
+			ZRAM_OFFLOAD_MAX_WORKERS);
+	for (i = 0; i < nr; i++) {
+		tsk = kthread_run(zram_offload_worker, zram, "%s_comp/%d",
+				zram->disk->disk_name, i);
+		if (IS_ERR(tsk)) {
+			zram_offload_stop(zram);
+			return PTR_ERR(tsk);
+		}
+		zram->offload_tsk[i] = tsk;
+	}
+
+	spin_lock_irq(&zram->offload_lock);
+	zram->offload = true;
+	spin_unlock_irq(&zram->offload_lock);
+	return 0;
+}
+
+static ssize_t comp_offload_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", ACCESS_ONCE(zram->offload));
+}
+
+static ssize_t comp_offload_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long val;
+	int ret = 0;
+
+	if (kstrtoul(buf, 10, &val))
+		return -EINVAL;
+
+	mutex_lock(&zram->offload_mutex);
+	if (val && !zram->offload)
+		ret = zram_offload_start(zram);
+	else if (!val && zram->offload)
+		zram_offload_stop(zram);
+	mutex_unlock(&zram->offload_mutex);
+
+	return ret ? ret : len;
+}
+
+static void zram_offload_init(struct zram *zram)
+{
+	spin_lock_init(&zram->offload_lock);
+	bio_list_init(&zram->offload_bios);
+	init_waitqueue_head(&zram->offload_wait);
+	mutex_init(&zram->offload_mutex);
+}
+
+static void zram_offload_exit(struct zram *zram)
+{
+	mutex_lock(&zram->offload_mutex);
+	zram_offload_stop(zram);
+	mutex_unlock(&zram->offload_mutex);
+}
+#else
+static inline bool zram_offload_write(struct zram *zram, struct bio *bio)
+{
+	return false;
+}
+
+static inline bool zram_offload_rw_page(struct zram *zram, int rw)
+{
+	return false;
+}
+
+static inline void zram_offload_init(struct zram *zram) {}
+static inline void zram_offload_exit(struct zram *zram) {}
+#endif
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+/* move written back data of @index to @blk, unless it changed meanwhile */
+static void zram_wb_commit(struct zram *zram, u32 index, unsigned long blk)
+{
+	struct zram_meta *meta = zram->meta;
+
+	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+	if (!zram_test_flag(meta, index, ZRAM_UNDER_WB)) {
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		zram_bd_free(zram, blk, 1);
+		return;
+	}
+
+	zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+	zs_free(meta->mem_pool, meta->table[index].handle);
+	atomic64_sub(zram_get_obj_size(meta, index),
+			&zram->stats.compr_data_size);
+	meta->table[index].handle = blk;
+	zram_set_obj_size(meta, index, 0);
+	zram_set_flag(meta, index, ZRAM_WB);
+	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+	atomic64_inc(&zram->stats.bd_count);
+}
+
+static bool zram_wb_idle(struct zram_meta *meta, u32 index, unsigned long age)
+{
+	if (!meta->table[index].handle ||
+			zram_test_flag(meta, index, ZRAM_ZERO) ||
+			zram_test_flag(meta, index, ZRAM_WB) ||
+			zram_test_flag(meta, index, ZRAM_UNDER_WB) ||
+			zram_test_flag(meta, index, ZRAM_DEDUP))
+		return false;
+
+	return time_after(jiffies, meta->table[index].ac_time + age);
+}
+
+/*
+ * Writing "idle" writes every page not accessed for writeback_age
+ * seconds back to the backing device, ZRAM_WB_BATCH pages per bio.
+ */
+static ssize_t writeback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct page *pages[ZRAM_WB_BATCH];
+	u32 slots[ZRAM_WB_BATCH];
+	struct zram_meta *meta;
+	unsigned long nr_pages, index, blk, age;
+	unsigned int nr, done, want, i;
+	ssize_t ret = len;
+	int err = 0;
+
+	if (!sysfs_streq(buf, "idle"))
+		return -EINVAL;
+
+	for (i = 0; i < ZRAM_WB_BATCH; i++) {
+		pages[i] = alloc_page(GFP_KERNEL);
+		if (!pages[i]) {
+			while (i--)
+				__free_page(pages[i]);
+			return -ENOMEM;
+		}
+	}
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		ret = -EINVAL;
+		goto out;
+	}
+	if (!zram->backing_dev) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	meta = zram->meta;
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	age = (unsigned long)zram->wb_age * HZ;
+
+	mutex_lock(&zram->wb_lock);
+	for (index = 0; index < nr_pages; ) {
+		nr = 0;
+		for (; index < nr_pages && nr < ZRAM_WB_BATCH; index++) {
+			bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+			if (zram_wb_idle(meta, index, age)) {
+				zram_set_flag(meta, index, ZRAM_UNDER_WB);
+				slots[nr++] = index;
+			}
+			bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		}
+
+		/* freed slots read back as zeroes and are not committed */
+		for (i = 0; i < nr; i++) {
+			err = zram_decompress_page(zram,
+					page_address(pages[i]), slots[i]);
+			if (err)
+				break;
+		}
+
+		for (done = 0; !err && done < nr; done += want) {
+			want = nr - done;
+			blk = zram_bd_alloc(zram, &want);
+			if (!want) {
+				err = -ENOSPC;
+				break;
+			}
+
+			err = zram_bd_submit(zram, blk, pages + done, want,
+					     WRITE);
+			if (err) {
+				zram_bd_free(zram, blk, want);
+				break;
+			}
+			atomic64_add(want, &zram->stats.bd_writes);
+
+			for (i = 0; i < want; i++)
+				zram_wb_commit(zram, slots[done + i], blk + i);
+		}
+
+		for (i = done; i < nr; i++) {
+			bit_spin_lock(ZRAM_ACCESS, &meta->table[slots[i]].value);
+			zram_clear_flag(meta, slots[i], ZRAM_UNDER_WB);
+			bit_spin_unlock(ZRAM_ACCESS,
+					&meta->table[slots[i]].value);
+		}
+
+		if (err) {
+			ret = err;
+			break;
+		}
+		cond_resched();
+	}
+	mutex_unlock(&zram->wb_lock);
+out:
+	up_read(&zram->init_lock);
+	for (i = 0; i < ZRAM_WB_BATCH; i++)
+		__free_page(pages[i]);
+
+	return ret;
+}
+#endif
+
 /*
  * Handler function for all zram I/O requests.
  */
@@ -908,6 +1747,10 @@ static void zram_make_request(struct request_queue *queue, struct bio *bio)
 		goto put_zram;
 	}
 
+	/* the offload worker puts the meta reference */
+	if (zram_offload_write(zram, bio))
+		return;
+
 	__zram_make_request(zram, bio);
 	zram_meta_put(zram);
 	return;
@@ -941,6 +1784,11 @@ static int zram_rw_page(struct block_device *bdev, sector_t sector,
 	struct bio_vec bv;
 
 	zram = bdev->bd_disk->private_data;
+	if (zram_offload_rw_page(zram, rw)) {
+		err = -EAGAIN;
+		goto out;
+	}
+
 	if (unlikely(!zram_meta_get(zram)))
 		goto out;
 
@@ -985,6 +1833,7 @@ static void zram_reset_device(struct zram *zram)
 	zram->limit_pages = 0;
 
 	if (!init_done(zram)) {
+		reset_bdev(zram);
 		up_write(&zram->init_lock);
 		return;
 	}
@@ -1007,7 +1856,8 @@ static void zram_reset_device(struct zram *zram)
 	/* Reset stats */
 	memset(&zram->stats, 0, sizeof(zram->stats));
 	zram->disksize = 0;
-	zram->max_comp_streams = 1;
+	zram->max_comp_streams = zcomp_default_max_streams();
+	reset_bdev(zram);
 
 	set_capacity(zram->disk, 0);
 	part_stat_set_all(&zram->disk->part0, 0);
@@ -1036,6 +1886,10 @@ static ssize_t disksize_store(struct device *dev,
 	if (!meta)
 		return -ENOMEM;
 
+	err = zram_dedup_init(zram, meta, disksize >> PAGE_SHIFT);
+	if (err)
+		goto out_free_meta;
+
 	comp = zcomp_create(zram->compressor, zram->max_comp_streams);
 	if (IS_ERR(comp)) {
 		pr_err("Cannot initialise %s compressing backend\n",
@@ -1153,6 +2007,17 @@ static DEVICE_ATTR_RW(mem_limit);
 static DEVICE_ATTR_RW(mem_used_max);
 static DEVICE_ATTR_RW(max_comp_streams);
 static DEVICE_ATTR_RW(comp_algorithm);
+#ifdef CONFIG_ZRAM_WRITEBACK
+static DEVICE_ATTR_RW(backing_dev);
+static DEVICE_ATTR_RW(writeback_age);
+static DEVICE_ATTR_WO(writeback);
+#endif
+#ifdef CONFIG_ZRAM_DEDUP
+static DEVICE_ATTR_RW(use_dedup);
+#endif
+#ifdef CONFIG_ZRAM_WRITE_OFFLOAD
+static DEVICE_ATTR_RW(comp_offload);
+#endif
 
 static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_disksize.attr,
@@ -1173,6 +2038,17 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_mem_used_max.attr,
 	&dev_attr_max_comp_streams.attr,
 	&dev_attr_comp_algorithm.attr,
+#ifdef CONFIG_ZRAM_WRITEBACK
+	&dev_attr_backing_dev.attr,
+	&dev_attr_writeback_age.attr,
+	&dev_attr_writeback.attr,
+#endif
+#ifdef CONFIG_ZRAM_DEDUP
+	&dev_attr_use_dedup.attr,
+#endif
+#ifdef CONFIG_ZRAM_WRITE_OFFLOAD
+	&dev_attr_comp_offload.attr,
+#endif
 	&dev_attr_io_stat.attr,
 	&dev_attr_mm_stat.attr,
 	NULL,
@@ -1202,6 +2078,8 @@ static int zram_add(void)
 	device_id = ret;
 
 	init_rwsem(&zram->init_lock);
+	zram_offload_init(zram);
+	zram_wb_init(zram);
 
 	queue = blk_alloc_queue(GFP_KERNEL);
 	if (!queue) {
@@ -1271,7 +2149,7 @@ static int zram_add(void)
 	}
 	strlcpy(zram->compressor, default_compressor, sizeof(zram->compressor));
 	zram->meta = NULL;
-	zram->max_comp_streams = 1;
+	zram->max_comp_streams = zcomp_default_max_streams();
 
 	pr_info("Added device: %s\n", zram->disk->disk_name);
 	return device_id;
@@ -1318,6 +2196,7 @@ static int zram_remove(struct zram *zram)
 
 	/* Make sure all the pending I/O are finished */
 	fsync_bdev(bdev);
+	zram_offload_exit(zram);
 	zram_reset_device(zram);
 	bdput(bdev);
 
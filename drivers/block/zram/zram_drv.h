@@ -16,9 +16,13 @@
 #define _ZRAM_DRV_H_
 
 #include <linux/spinlock.h>
+#include <linux/bio.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
 #include <linux/zsmalloc.h>
 
 #include "zcomp.h"
+#include "zram_dedup.h"
 
 /*-- Configurable parameters */
 
@@ -44,6 +48,14 @@ static const size_t max_zpage_size = PAGE_SIZE / 4 * 3;
 #define ZRAM_SECTOR_PER_LOGICAL_BLOCK	\
 	(1 << (ZRAM_LOGICAL_BLOCK_SHIFT - SECTOR_SHIFT))
 
+/* pages written back to the backing device per bio */
+#define ZRAM_WB_BATCH			32
+#define ZRAM_WB_DEFAULT_AGE		1800
+
+/* write offload: workers, and bios a worker takes per wakeup */
+#define ZRAM_OFFLOAD_MAX_WORKERS	4
+#define ZRAM_OFFLOAD_BATCH		32
+
 
 /*
  * The lower ZRAM_FLAG_SHIFT bits of table.value is for
@@ -62,6 +74,9 @@ enum zram_pageflags {
 	/* Page consists entirely of zeros */
 	ZRAM_ZERO = ZRAM_FLAG_SHIFT,
 	ZRAM_ACCESS,	/* page is now accessed */
+	ZRAM_DEDUP,	/* handle points to a shared struct zram_entry */
+	ZRAM_WB,	/* handle is a block of the backing device */
+	ZRAM_UNDER_WB,	/* page is being written back */
 
 	__NR_ZRAM_PAGEFLAGS,
 };
@@ -72,6 +87,9 @@ enum zram_pageflags {
 struct zram_table_entry {
 	unsigned long handle;
 	unsigned long value;
+#ifdef CONFIG_ZRAM_WRITEBACK
+	unsigned long ac_time;	/* jiffies of the last read or write */
+#endif
 };
 
 struct zram_stats {
@@ -85,11 +103,20 @@ struct zram_stats {
 	atomic64_t zero_pages;		/* no. of zero filled pages */
 	atomic64_t pages_stored;	/* no. of pages currently stored */
 	atomic_long_t max_used_pages;	/* no. of maximum pages stored */
+	atomic64_t dup_data_size;	/* compressed bytes saved by dedup */
+	atomic64_t meta_data_size;	/* bytes of struct zram_entry */
+	atomic64_t bd_count;		/* no. of pages on the backing device */
+	atomic64_t bd_reads;		/* no. of pages read back */
+	atomic64_t bd_writes;		/* no. of pages written back */
 };
 
 struct zram_meta {
 	struct zram_table_entry *table;
 	struct zs_pool *mem_pool;
+#ifdef CONFIG_ZRAM_DEDUP
+	struct zram_hash *hash;
+	size_t hash_size;
+#endif
 };
 
 struct zram {
@@ -118,5 +145,29 @@ struct zram {
 	 * zram is claimed so open request will be failed
 	 */
 	bool claim; /* Protected by bdev->bd_mutex */
+#ifdef CONFIG_ZRAM_DEDUP
+	bool use_dedup;
+#endif
+#ifdef CONFIG_ZRAM_WRITEBACK
+	struct file *backing_dev;
+	struct block_device *bdev;
+	unsigned int old_block_size;
+	/* blocks in use on the backing device, block 0 is never used */
+	unsigned long *bitmap;
+	unsigned long nr_blocks;
+	spinlock_t bitmap_lock;
+	unsigned int wb_age;		/* seconds */
+	struct mutex wb_lock;		/* one writeback at a time */
+#endif
+#ifdef CONFIG_ZRAM_WRITE_OFFLOAD
+	/* write bios waiting for the offload workers */
+	bool offload;
+	spinlock_t offload_lock;
+	struct bio_list offload_bios;
+	unsigned int offload_pending;
+	wait_queue_head_t offload_wait;
+	struct task_struct *offload_tsk[ZRAM_OFFLOAD_MAX_WORKERS];
+	struct mutex offload_mutex;	/* serializes starting/stopping */
+#endif
 };
 #endif
@@ -374,10 +374,14 @@ int32 delete_gnss_head_skb_msg(void)
         PS_PRINT_WARNING("gnss delete msg, skb->len=%d, qlen=%d\n", skb->len, ps_core_d->bfgx_info[BFGX_GNSS].rx_queue.qlen);
 
         seperate_tag = skb->data[skb->len -1];
+        ps_core_d->gnss_rx_bytes -= min_t(uint32, skb->len - 1, ps_core_d->gnss_rx_bytes);
         switch (seperate_tag)
         {
             case GNSS_SEPER_TAG_INIT:
+                kfree_skb(skb);
+                break;
             case GNSS_SEPER_TAG_LAST:
+                ps_core_d->gnss_rx_dropped++;
                 kfree_skb(skb);
                 break;
             default:
@@ -452,6 +456,7 @@ int32 ps_push_skb_queue_gnss(struct ps_core_s *ps_core_d, uint8 *buf_ptr, uint16
         ps_skb_enqueue(ps_core_d, skb, type);
         copy_cnt += (seperate_len -1);
     }while(copy_cnt < pkt_len);
+    ps_core_d->gnss_rx_bytes += pkt_len;
 
     /*ȷgnssskb(RX_GNSS_QUE_MAX_NUM >> 1)ֹһɾǰģһɾ*/
     while (ps_core_d->bfgx_info[BFGX_GNSS].rx_queue.qlen > (RX_GNSS_QUE_MAX_NUM >> 1))
@@ -714,6 +719,86 @@ int32 ps_recv_debug_data(struct ps_core_s *ps_core_d, uint8 *buf_ptr)
     return 0;
 }
 
+/*
+ * one uart buffer usually holds many packets, wake each subsys reader
+ * once for all of them instead of once per packet.
+ */
+static inline void ps_rx_wake_defer(struct ps_core_s *ps_core_d, uint8 subsys)
+{
+    ps_core_d->rx_wake_pending |= (1U << subsys);
+}
+
+static void ps_rx_wake_flush(struct ps_core_s *ps_core_d)
+{
+    uint32 pending = ps_core_d->rx_wake_pending;
+    uint8  subsys;
+
+    ps_core_d->rx_wake_pending = 0;
+    for (subsys = 0; pending && subsys < BFGX_BUTT; subsys++)
+    {
+        if (pending & (1U << subsys))
+        {
+            wake_up_interruptible(&ps_core_d->bfgx_info[subsys].rx_wait);
+            pending &= ~(1U << subsys);
+        }
+    }
+}
+
+/*
+ * gnss batching: the reader declared how late (ms) and how much (bytes)
+ * data may be held back. Until one of those budgets is spent, or the
+ * queue fills, messages are only queued and the reader sleeps.
+ */
+int32 ps_gnss_rx_ready(struct ps_core_s *ps_core_d)
+{
+    if (0 == ps_core_d->bfgx_info[BFGX_GNSS].rx_queue.qlen)
+    {
+        return 0;
+    }
+
+    return (0 == ps_core_d->gnss_batch_latency) || ps_core_d->gnss_batch_ready;
+}
+
+static void ps_gnss_batch_timeout(unsigned long data)
+{
+    struct ps_core_s *ps_core_d = (struct ps_core_s *)data;
+
+    ps_core_d->gnss_batch_ready = 1;
+    wake_up_interruptible(&ps_core_d->bfgx_info[BFGX_GNSS].rx_wait);
+}
+
+void ps_gnss_batch_set(struct ps_core_s *ps_core_d, uint32 latency_ms, uint32 bytes)
+{
+    del_timer_sync(&ps_core_d->gnss_batch_timer);
+    ps_core_d->gnss_batch_bytes   = bytes;
+    ps_core_d->gnss_batch_latency = latency_ms;
+    /* release what is held back under the old budget */
+    ps_core_d->gnss_batch_ready = 1;
+    wake_up_interruptible(&ps_core_d->bfgx_info[BFGX_GNSS].rx_wait);
+    PS_PRINT_INFO("gnss batch latency=%dms bytes=%d\n", latency_ms, bytes);
+}
+
+static void ps_gnss_rx_notify(struct ps_core_s *ps_core_d)
+{
+    if (0 == ps_core_d->gnss_batch_latency)
+    {
+        ps_rx_wake_defer(ps_core_d, BFGX_GNSS);
+        return;
+    }
+
+    if ((ps_core_d->gnss_batch_bytes && ps_core_d->gnss_rx_bytes >= ps_core_d->gnss_batch_bytes)
+        || (ps_core_d->bfgx_info[BFGX_GNSS].rx_queue.qlen >= GNSS_BATCH_MAX_NUM))
+    {
+        del_timer(&ps_core_d->gnss_batch_timer);
+        ps_core_d->gnss_batch_ready = 1;
+        ps_rx_wake_defer(ps_core_d, BFGX_GNSS);
+    }
+    else if (!ps_core_d->gnss_batch_ready && !timer_pending(&ps_core_d->gnss_batch_timer))
+    {
+        mod_timer(&ps_core_d->gnss_batch_timer, jiffies + msecs_to_jiffies(ps_core_d->gnss_batch_latency));
+    }
+}
+
 /**
  * Prototype    : ps_store_rx_sepreated_data
  * Description  : called by core when recive gnss data from device,
@@ -925,6 +1010,11 @@ int32 ps_recv_sepreated_data(struct ps_core_s *ps_core_d, uint8 *buf_ptr, uint8
         if (pst_bfgx_data->rx_queue.qlen >= g_bfgx_rx_queue_max_num[subsys])
         {
             PS_PRINT_WARNING("%s rx queue too large! qlen=%d\n", g_bfgx_subsys_name[subsys], pst_bfgx_data->rx_queue.qlen);
+            if (BFGX_GNSS == subsys)
+            {
+                ps_core_d->gnss_rx_dropped++;
+                ps_core_d->gnss_batch_ready = 1;
+            }
             wake_up_interruptible(&pst_bfgx_data->rx_wait);
             pst_sepreted_data->rx_buf_ptr = pst_sepreted_data->rx_buf_org_ptr;
             pst_sepreted_data->rx_buf_all_len = 0;
@@ -951,7 +1041,14 @@ int32 ps_recv_sepreated_data(struct ps_core_s *ps_core_d, uint8 *buf_ptr, uint8
 
         /*skbѾȷݣѵȴݵĽ*/
         PS_PRINT_DBG("%s rx done! qlen=%d\n", g_bfgx_subsys_name[subsys], pst_bfgx_data->rx_queue.qlen);
-        wake_up_interruptible(&pst_bfgx_data->rx_wait);
+        if (BFGX_GNSS == subsys)
+        {
+            ps_gnss_rx_notify(ps_core_d);
+        }
+        else
+        {
+            ps_rx_wake_defer(ps_core_d, subsys);
+        }
     }
     spin_unlock(&pst_sepreted_data->sepreted_rx_lock);
 
@@ -1019,7 +1116,7 @@ int32 ps_recv_no_sepreated_data(struct ps_core_s *ps_core_d, uint8 *buf_ptr, uin
         }
 
         PS_PRINT_DBG("%s rx done! qlen=%d\n", g_bfgx_subsys_name[subsys], pst_bfgx_data->rx_queue.qlen);
-        wake_up_interruptible(&pst_bfgx_data->rx_wait);
+        ps_rx_wake_defer(ps_core_d, subsys);
     }
 
     return 0;
@@ -1549,6 +1646,7 @@ int32 ps_core_recv(void *disc_data, const uint8 *data, int32 count)
             }
         }
     }
+    ps_rx_wake_flush(ps_core_d);
     return 0;
 }
 
@@ -2313,6 +2411,7 @@ int32 ps_core_init(struct ps_core_s **core_data)
 
     spin_lock_init(&ps_core_d->rx_lock);
     spin_lock_init(&ps_core_d->gnss_rx_lock);
+    setup_timer(&ps_core_d->gnss_batch_timer, ps_gnss_batch_timeout, (unsigned long)ps_core_d);
     init_completion(&ps_core_d->wait_wifi_opened);
     init_completion(&ps_core_d->wait_wifi_closed);
     /* create a singlethread work queue */
@@ -2383,6 +2482,8 @@ int32 ps_core_exit(struct ps_core_s *ps_core_d)
         ps_kfree_skb(ps_core_d, RX_NFC_QUEUE);
         ps_kfree_skb(ps_core_d, RX_IR_QUEUE);
 
+        del_timer_sync(&ps_core_d->gnss_batch_timer);
+
         /* free tx work queue */
         destroy_workqueue(ps_core_d->ps_tx_workqueue);
 
@@ -2213,6 +2213,8 @@ STATIC int32 hw_gnss_open(struct inode *inode, struct file *filp)
     }
 
     ps_core_d->gnss_read_delay = GNSS_READ_DEFAULT_TIME;
+    ps_gnss_batch_set(ps_core_d, 0, 0);
+    ps_core_d->gnss_rx_dropped = 0;
 
     atomic_set(&pst_gnss_data->subsys_state, POWER_STATE_OPEN);
     post_to_visit_node(ps_core_d);
@@ -2268,15 +2270,15 @@ STATIC ssize_t hw_gnss_read(struct file *filp, int8 __user *buf, size_t count, l
 
     skb_queue_head_init(&read_queue);
 
-    if (0 == ps_core_d->bfgx_info[BFGX_GNSS].rx_queue.qlen)
-    {   /* if no data, and wait timeout function */
+    if (!ps_gnss_rx_ready(ps_core_d))
+    {   /* if no data (or the batch budget is not spent), and wait timeout function */
         if (filp->f_flags & O_NONBLOCK)
         {   /* if O_NONBLOCK read and return */
             return -EAGAIN;
         }
         /* timeout function;when have data,can interrupt */
         timeout = wait_event_interruptible_timeout(ps_core_d->bfgx_info[BFGX_GNSS].rx_wait,
-            (ps_core_d->bfgx_info[BFGX_GNSS].rx_queue.qlen > 0), msecs_to_jiffies(ps_core_d->gnss_read_delay));
+            ps_gnss_rx_ready(ps_core_d), msecs_to_jiffies(ps_core_d->gnss_read_delay));
         if (!timeout)
         {
             PS_PRINT_DBG("gnss read time out!\n");
@@ -2315,8 +2317,13 @@ STATIC ssize_t hw_gnss_read(struct file *filp, int8 __user *buf, size_t count, l
                 break;
         }
 
+        ps_core_d->gnss_rx_bytes -= min_t(uint32, skb->len - 1, ps_core_d->gnss_rx_bytes);
         skb_queue_tail(&read_queue, skb);
     }while(GNSS_SEPER_TAG_INIT == seperate_tag);
+    if (0 == ps_core_d->bfgx_info[BFGX_GNSS].rx_queue.qlen)
+    {   /* batch delivered, hold the next messages back again */
+        ps_core_d->gnss_batch_ready = 0;
+    }
     spin_unlock(&ps_core_d->gnss_rx_lock);
 
     copy_cnt = 0;
@@ -2474,6 +2481,25 @@ STATIC int64 hw_gnss_ioctl(struct file *file, uint32 cmd, uint64 arg)
             return -EINVAL;
         }
     }
+    else if (GNSS_SET_BATCH == cmd)
+    {
+        struct gnss_batch_param param;
+
+        if (copy_from_user(&param, (void __user *)arg, sizeof(param)))
+        {
+            return -EFAULT;
+        }
+        if (param.max_latency_ms > GNSS_MAX_READ_TIME)
+        {
+            PS_PRINT_ERR("batch latency %d is too large!\n", param.max_latency_ms);
+            return -EINVAL;
+        }
+        ps_gnss_batch_set(ps_core_d, param.max_latency_ms, param.max_bytes);
+    }
+    else if (GNSS_GET_RX_DROPPED == cmd)
+    {
+        return put_user(ps_core_d->gnss_rx_dropped, (uint32 __user *)arg);
+    }
 
     return 0;
 }
@@ -2661,6 +2687,7 @@ STATIC int32 hw_gnss_release(struct inode *inode, struct file *filp)
 
     pst_gnss_data = &ps_core_d->bfgx_info[BFGX_GNSS];
 
+    ps_gnss_batch_set(ps_core_d, 0, 0);
     wake_up_interruptible(&pst_gnss_data->rx_wait);
 
     ret = prepare_to_visit_node(ps_core_d);
@@ -15,6 +15,7 @@
 #include <linux/kernel.h>
 #include <linux/types.h>
 #include <linux/debugfs.h>
+#include <linux/timer.h>
 #include "plat_type.h"
 
 #define DTS_COMP_HI1101_PS_NAME		"hisilicon,hisi_bfgx"
@@ -118,6 +119,12 @@
 #define GNSS_READ_DEFAULT_TIME      (1000)
 #define GNSS_MAX_READ_TIME          (10000)
 
+/* gnss rx batching, arg of GNSS_SET_BATCH is struct gnss_batch_param */
+#define GNSS_SET_BATCH              (2)
+#define GNSS_GET_RX_DROPPED         (3)
+/* rx skbs queued before the reader is woken whatever the budget */
+#define GNSS_BATCH_MAX_NUM          (RX_GNSS_QUE_MAX_NUM >> 2)
+
 /* timeout for fm read */
 #define FM_SET_READ_TIME            (1)
 #define FM_READ_DEFAULT_TIME        (1000)
@@ -335,6 +342,12 @@ typedef enum
     GNSS_SEPER_TAG_INIT,
     GNSS_SEPER_TAG_LAST,
 }GNSS_SEPERATE_TAG;
+
+struct gnss_batch_param
+{
+    uint32 max_latency_ms;  /* 0: wake the reader on every message */
+    uint32 max_bytes;       /* 0: only the latency budget applies */
+};
 /*****************************************************************************
   3 STRUCT define
 *****************************************************************************/
@@ -435,10 +448,20 @@ struct ps_core_s {
     uint8 *rx_decode_tty_ptr;
     uint8 *rx_public_buf_org_ptr;
     uint8 *rx_decode_public_buf_ptr;
+    /* bit per subsys whose reader is woken once the uart buffer is decoded */
+    uint32 rx_wake_pending;
 
     uint8  tty_have_open;
     uint16 gnss_read_delay;
     uint16 fm_read_delay;
+
+    /* gnss rx batching, the byte count is under gnss_rx_lock */
+    uint32 gnss_batch_latency;
+    uint32 gnss_batch_bytes;
+    uint32 gnss_rx_bytes;
+    uint32 gnss_rx_dropped;
+    uint8  gnss_batch_ready;
+    struct timer_list gnss_batch_timer;
 };
 
 /**
@@ -555,6 +578,8 @@ int32 ps_core_exit(struct ps_core_s *);
 int32 ps_get_core_reference(struct ps_core_s **core_data);
 int32 ps_core_recv(void *disc_data, const uint8 *data, int32 count);
 int32 ps_core_recv_uart_test(void *disc_data, const uint8 *data, int32 count);
+int32 ps_gnss_rx_ready(struct ps_core_s *ps_core_d);
+void ps_gnss_batch_set(struct ps_core_s *ps_core_d, uint32 latency_ms, uint32 bytes);
 int32 ps_tx_sys_cmd(struct ps_core_s *ps_core_d, uint8 type, uint8 content);
 int32 ps_tx_gnssbuf(struct ps_core_s *ps_core_d, const int8 __user *buf, size_t count);
 int32 ps_tx_nfcbuf(struct ps_core_s *ps_core_d, const int8 __user *buf, size_t count);
@@ -2827,6 +2827,41 @@ OAL_STATIC OAL_INLINE oal_int32  oal_netif_rx_ni(oal_netbuf_stru *pst_netbuf)
 }
 
 
+/* one NAPI lane per cpu that receive processing can be steered to */
+#define OAL_NETIF_RX_NAPI_MAX_LANES     8
+
+typedef struct
+{
+    struct napi_struct      st_napi;
+    oal_netbuf_head_stru    st_rx_queue;    /* filled by the hcc thread */
+    oal_netbuf_head_stru    st_poll_queue;  /* drained by the poll, unlocked */
+    struct call_single_data st_csd;         /* schedules st_napi on the lane's cpu */
+    unsigned long           ul_ipi_pending;
+    oal_uint32              ul_rx_pkts;
+    oal_uint32              ul_rx_drops;
+    oal_uint32              ul_polls;
+}oal_netif_rx_lane_stru;
+
+/* NAPI/GRO receive context of one net device, fed by the hcc thread.
+   Lane n runs on cpu n when n is in netif_rx_napi_cpumask. */
+typedef struct
+{
+    oal_netif_rx_lane_stru  ast_lane[OAL_NETIF_RX_NAPI_MAX_LANES];
+    struct list_head        st_entry;       /* on the list of contexts flushed by the hcc thread */
+}oal_netif_rx_napi_stru;
+
+/*****************************************************************************
+     : oal_napi_gro_receive
+   : skbGRO, ֻNAPI pollе
+   : pst_napi: napi, pst_netbuf: skbָ
+   : 
+   ֵ  : gro_result_t
+*****************************************************************************/
+OAL_STATIC OAL_INLINE gro_result_t  oal_napi_gro_receive(struct napi_struct *pst_napi, oal_netbuf_stru *pst_netbuf)
+{
+    return napi_gro_receive(pst_napi, pst_netbuf);
+}
+
 OAL_STATIC OAL_INLINE oal_void  oal_local_bh_disable(oal_void)
 {
     local_bh_disable();
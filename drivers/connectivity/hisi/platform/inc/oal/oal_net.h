@@ -587,6 +587,16 @@ extern oal_int32 init_dev_excp_handler(oal_void);
 extern oal_void deinit_dev_excp_handler(oal_void);
 extern oal_int genl_msg_send_to_user(oal_void *data, oal_int i_len);
 
+#if (_PRE_OS_VERSION_LINUX == _PRE_OS_VERSION)
+extern oal_void  oal_netif_rx_napi_init(oal_netif_rx_napi_stru *pst_rx_napi,
+                                        oal_net_device_stru *pst_net_dev, oal_int32 l_weight);
+extern oal_void  oal_netif_rx_napi_exit(oal_netif_rx_napi_stru *pst_rx_napi);
+extern oal_int32 oal_netif_rx_napi(oal_netif_rx_napi_stru *pst_rx_napi, oal_netbuf_stru *pst_netbuf);
+extern oal_void  oal_netif_rx_napi_flush_all(oal_void);
+extern oal_int32 oal_netbuf_gso_segment(oal_netbuf_stru *pst_netbuf, oal_uint32 ul_headroom,
+                                        oal_uint32 ul_tailroom, oal_netbuf_head_stru *pst_list);
+#endif
+
 
 
 #ifdef __cplusplus
@@ -403,6 +403,8 @@ oal_int32 hcc_tx(struct hcc_handler* hcc, oal_netbuf_stru* netbuf,
               pad_hdr;
     oal_uint8* old_data_addr;
     oal_int32 headroom_add = 0;
+    oal_int32 tailroom_add = 0;
+    oal_uint  tailroom;
     struct hcc_header *hdr;
     hcc_trans_queue *pst_hcc_queue;
     struct hcc_tx_cb_stru* pst_cb_stru;
@@ -564,14 +566,23 @@ oal_int32 hcc_tx(struct hcc_handler* hcc, oal_netbuf_stru* netbuf,
         headroom_add = (oal_int32) (headroom - oal_netbuf_headroom(netbuf));
     }
 
-    if(headroom_add)
+    /*the assembled transfer pads each frame to HISDIO_H2D_SCATT_BUFFLEN_ALIGN,
+      reserve that tailroom here so that one realloc covers both ends*/
+    tailroom = OAL_ROUND_UP(OAL_NETBUF_LEN(netbuf) + headroom, HISDIO_H2D_SCATT_BUFFLEN_ALIGN)
+               - (OAL_NETBUF_LEN(netbuf) + headroom);
+    if(tailroom > oal_netbuf_tailroom(netbuf))
+    {
+        tailroom_add = (oal_int32) (tailroom - oal_netbuf_tailroom(netbuf));
+    }
+
+    if(headroom_add || tailroom_add)
     {
         /*relloc the netbuf*/
-        ret = oal_netbuf_expand_head(netbuf, headroom_add, 0, GFP_ATOMIC);
+        ret = oal_netbuf_expand_head(netbuf, headroom_add, tailroom_add, GFP_ATOMIC);
         if(OAL_UNLIKELY(OAL_SUCC != ret))
         {
-            OAL_IO_PRINT("alloc head room failed,netbuf len is %d,expand len:%d\n",
-                            OAL_NETBUF_LEN(netbuf), headroom_add);
+            OAL_IO_PRINT("alloc head room failed,netbuf len is %d,expand len:%d,%d\n",
+                            OAL_NETBUF_LEN(netbuf), headroom_add, tailroom_add);
             return -OAL_EFAIL;
         }
         old_data_addr = OAL_NETBUF_DATA(netbuf);
@@ -2014,6 +2025,9 @@ oal_int32 hcc_transfer_thread(oal_void *data)
 
         count |= hcc_thread_process(hcc);
 
+        /* hand the frames of this round to the stack in one NAPI run */
+        oal_netif_rx_napi_flush_all();
+
 
 #ifdef _PRE_CONFIG_WLAN_THRANS_THREAD_DEBUG
         if(count)
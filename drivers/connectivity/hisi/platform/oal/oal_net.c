@@ -38,6 +38,7 @@ extern "C" {
 #include <net/genetlink.h>
 #include <linux/module.h>
 #include <linux/kernel.h>
+#include <linux/smp.h>
 #include <linux/init.h>
 #endif
 
@@ -1074,6 +1075,334 @@ oal_void deinit_dev_excp_handler(oal_void)
 #endif
 
 
+#if (_PRE_OS_VERSION_LINUX == _PRE_OS_VERSION)
+/* frames queued to one lane beyond this are dropped, like netdev_max_backlog */
+#define OAL_NETIF_RX_NAPI_MAX_QUEUE    4096
+#define OAL_NETIF_RX_NAPI_LANE_MASK    ((1U << OAL_NETIF_RX_NAPI_MAX_LANES) - 1)
+
+oal_uint32 netif_rx_napi_enable = 1;
+module_param(netif_rx_napi_enable, uint, S_IRUGO|S_IWUSR);
+
+/*cpus receive processing is spread over by flow hash,
+  0 means all of it runs on the cpu of the hcc thread*/
+oal_uint32 netif_rx_napi_cpumask = 0;
+module_param(netif_rx_napi_cpumask, uint, S_IRUGO|S_IWUSR);
+
+OAL_STATIC LIST_HEAD(g_st_netif_rx_napi_list);
+OAL_STATIC DEFINE_SPINLOCK(g_st_netif_rx_napi_lock);
+
+/*****************************************************************************
+     : oal_netif_rx_napi_poll
+   : NAPI poll, budgetѽյskbGRO
+   : pst_napi: napi, l_budget: ദskb
+   : 
+   ֵ  : skb
+*****************************************************************************/
+OAL_STATIC oal_int32  oal_netif_rx_napi_poll(struct napi_struct *pst_napi, oal_int32 l_budget)
+{
+    oal_netif_rx_lane_stru  *pst_lane = container_of(pst_napi, oal_netif_rx_lane_stru, st_napi);
+    oal_netbuf_head_stru    *pst_poll_queue = &pst_lane->st_poll_queue;
+    oal_netbuf_stru         *pst_netbuf;
+    oal_int32                l_work = 0;
+
+    while (l_work < l_budget)
+    {
+        /* take the whole batch queued by the hcc thread under one lock */
+        if (skb_queue_empty(pst_poll_queue))
+        {
+            spin_lock_irq(&pst_lane->st_rx_queue.lock);
+            skb_queue_splice_tail_init(&pst_lane->st_rx_queue, pst_poll_queue);
+            spin_unlock_irq(&pst_lane->st_rx_queue.lock);
+            if (skb_queue_empty(pst_poll_queue))
+            {
+                break;
+            }
+        }
+
+        pst_netbuf = __skb_dequeue(pst_poll_queue);
+        oal_napi_gro_receive(pst_napi, pst_netbuf);
+        l_work++;
+    }
+
+    pst_lane->ul_rx_pkts += (oal_uint32)l_work;
+    pst_lane->ul_polls++;
+
+    if (l_work < l_budget)
+    {
+        napi_complete(pst_napi);
+
+        /* frames queued after the queue was found empty would wait for the next flush */
+        if (!oal_netbuf_list_empty(&pst_lane->st_rx_queue))
+        {
+            napi_schedule(pst_napi);
+        }
+    }
+
+    return l_work;
+}
+
+/* runs on the lane's cpu, the NET_RX softirq follows on the same cpu */
+OAL_STATIC oal_void  oal_netif_rx_lane_ipi(oal_void *p_info)
+{
+    oal_netif_rx_lane_stru  *pst_lane = (oal_netif_rx_lane_stru *)p_info;
+
+    napi_schedule(&pst_lane->st_napi);
+
+    smp_mb__before_atomic();
+    clear_bit(0, &pst_lane->ul_ipi_pending);
+}
+
+/*****************************************************************************
+     : oal_netif_rx_napi_select_lane
+   : hashѡlane, ͬһͬһlane, ֤˳
+   : pst_netbuf: skbָ, Ѿeth_type_trans; ul_mask: õcpu
+   : 
+   ֵ  : lane
+*****************************************************************************/
+OAL_STATIC oal_uint32  oal_netif_rx_napi_select_lane(oal_netbuf_stru *pst_netbuf, oal_uint32 ul_mask)
+{
+    oal_uint32  ul_nth;
+    oal_uint32  ul_lane;
+
+    if (0 == ul_mask)
+    {
+        return 0;
+    }
+
+    ul_nth = reciprocal_scale(skb_get_hash(pst_netbuf), hweight32(ul_mask));
+    for (ul_lane = 0; ul_lane < OAL_NETIF_RX_NAPI_MAX_LANES; ul_lane++)
+    {
+        if ((ul_mask & BIT(ul_lane)) && (0 == ul_nth--))
+        {
+            break;
+        }
+    }
+
+    return ul_lane;
+}
+
+/*****************************************************************************
+     : oal_netif_rx_napi_init
+   : ʼnet deviceNAPI
+   : pst_rx_napi: , pst_net_dev: net device, l_weight: NAPI weight
+   : 
+   ֵ  : 
+*****************************************************************************/
+oal_void  oal_netif_rx_napi_init(oal_netif_rx_napi_stru *pst_rx_napi,
+                                 oal_net_device_stru *pst_net_dev, oal_int32 l_weight)
+{
+    oal_netif_rx_lane_stru  *pst_lane;
+    oal_uint32               ul_lane;
+
+    oal_memset(pst_rx_napi, 0, OAL_SIZEOF(oal_netif_rx_napi_stru));
+
+    for (ul_lane = 0; ul_lane < OAL_NETIF_RX_NAPI_MAX_LANES; ul_lane++)
+    {
+        pst_lane = &pst_rx_napi->ast_lane[ul_lane];
+
+        oal_netbuf_list_head_init(&pst_lane->st_rx_queue);
+        __skb_queue_head_init(&pst_lane->st_poll_queue);
+        pst_lane->st_csd.func = oal_netif_rx_lane_ipi;
+        pst_lane->st_csd.info = pst_lane;
+
+        netif_napi_add(pst_net_dev, &pst_lane->st_napi, oal_netif_rx_napi_poll, l_weight);
+        napi_enable(&pst_lane->st_napi);
+    }
+
+    spin_lock_bh(&g_st_netif_rx_napi_lock);
+    list_add_tail(&pst_rx_napi->st_entry, &g_st_netif_rx_napi_list);
+    spin_unlock_bh(&g_st_netif_rx_napi_lock);
+}
+
+/*****************************************************************************
+     : oal_netif_rx_napi_exit
+   : ȥʼNAPI, ͷδϱskb
+   : pst_rx_napi: 
+   : 
+   ֵ  : 
+*****************************************************************************/
+oal_void  oal_netif_rx_napi_exit(oal_netif_rx_napi_stru *pst_rx_napi)
+{
+    oal_netif_rx_lane_stru  *pst_lane;
+    oal_uint32               ul_lane;
+
+    spin_lock_bh(&g_st_netif_rx_napi_lock);
+    list_del(&pst_rx_napi->st_entry);
+    spin_unlock_bh(&g_st_netif_rx_napi_lock);
+
+    for (ul_lane = 0; ul_lane < OAL_NETIF_RX_NAPI_MAX_LANES; ul_lane++)
+    {
+        pst_lane = &pst_rx_napi->ast_lane[ul_lane];
+
+        /* an ipi sent by the last flush still refers to the lane */
+        while (test_bit(0, &pst_lane->ul_ipi_pending))
+        {
+            cpu_relax();
+        }
+
+        napi_disable(&pst_lane->st_napi);
+        netif_napi_del(&pst_lane->st_napi);
+
+        oal_netbuf_list_purge(&pst_lane->st_rx_queue);
+        __skb_queue_purge(&pst_lane->st_poll_queue);
+    }
+}
+
+/*****************************************************************************
+     : oal_netif_rx_napi
+   : oal_netif_rx_ni: skbӵlane, hcc߳ÿֵһNAPI
+   : pst_rx_napi: , pst_netbuf: skbָ
+   : 
+   ֵ  : 1drop0succ
+*****************************************************************************/
+oal_int32  oal_netif_rx_napi(oal_netif_rx_napi_stru *pst_rx_napi, oal_netbuf_stru *pst_netbuf)
+{
+    oal_netif_rx_lane_stru  *pst_lane;
+    oal_uint32               ul_mask;
+
+    if (0 == netif_rx_napi_enable)
+    {
+        return oal_netif_rx_hw(pst_netbuf);
+    }
+
+    ul_mask  = ACCESS_ONCE(netif_rx_napi_cpumask) & OAL_NETIF_RX_NAPI_LANE_MASK;
+    pst_lane = &pst_rx_napi->ast_lane[oal_netif_rx_napi_select_lane(pst_netbuf, ul_mask)];
+
+    if (OAL_UNLIKELY(oal_netbuf_list_len(&pst_lane->st_rx_queue) >= OAL_NETIF_RX_NAPI_MAX_QUEUE))
+    {
+        pst_lane->ul_rx_drops++;
+        oal_netbuf_free(pst_netbuf);
+        return NET_RX_DROP;
+    }
+
+    oal_netbuf_add_to_list_tail(pst_netbuf, &pst_lane->st_rx_queue);
+    return NET_RX_SUCCESS;
+}
+
+/*****************************************************************************
+     : oal_netif_rx_napi_flush_all
+   : hcc߳ÿִݵlane, cpuֱӵ, cpuͨipi
+   : 
+   : 
+   ֵ  : 
+*****************************************************************************/
+oal_void  oal_netif_rx_napi_flush_all(oal_void)
+{
+    oal_netif_rx_napi_stru  *pst_rx_napi;
+    oal_netif_rx_lane_stru  *pst_lane;
+    oal_uint32               ul_mask;
+    oal_uint32               ul_lane;
+    oal_uint32               ul_cpu;
+
+    ul_mask = ACCESS_ONCE(netif_rx_napi_cpumask) & OAL_NETIF_RX_NAPI_LANE_MASK;
+
+    /* the NET_RX softirq raised here runs at spin_unlock_bh */
+    spin_lock_bh(&g_st_netif_rx_napi_lock);
+    ul_cpu = smp_processor_id();
+    list_for_each_entry(pst_rx_napi, &g_st_netif_rx_napi_list, st_entry)
+    {
+        for (ul_lane = 0; ul_lane < OAL_NETIF_RX_NAPI_MAX_LANES; ul_lane++)
+        {
+            pst_lane = &pst_rx_napi->ast_lane[ul_lane];
+            if (oal_netbuf_list_empty(&pst_lane->st_rx_queue))
+            {
+                continue;
+            }
+
+            /* a lane whose cpu is not steered to, or is offline, runs here */
+            if (!(ul_mask & BIT(ul_lane)) || (ul_lane == ul_cpu) || !cpu_online(ul_lane))
+            {
+                napi_schedule(&pst_lane->st_napi);
+                continue;
+            }
+
+            if (test_and_set_bit(0, &pst_lane->ul_ipi_pending))
+            {
+                continue;
+            }
+
+            if (smp_call_function_single_async((oal_int32)ul_lane, &pst_lane->st_csd))
+            {
+                clear_bit(0, &pst_lane->ul_ipi_pending);
+                napi_schedule(&pst_lane->st_napi);
+            }
+        }
+    }
+    spin_unlock_bh(&g_st_netif_rx_napi_lock);
+}
+
+/*****************************************************************************
+     : oal_netbuf_gso_segment
+   : ͷTSO: GSO skbֶ, ÿԻ, Уͼ, Ԥhccͷβռ
+   : pst_netbuf: skbָ, ul_headroom/ul_tailroom: ÿҪͷβռ
+   : pst_list: ֶκskb
+   ֵ  : skb
+*****************************************************************************/
+oal_int32  oal_netbuf_gso_segment(oal_netbuf_stru *pst_netbuf, oal_uint32 ul_headroom,
+                                  oal_uint32 ul_tailroom, oal_netbuf_head_stru *pst_list)
+{
+    oal_netbuf_stru  *pst_segs;
+    oal_netbuf_stru  *pst_seg;
+    oal_int32         l_head_add;
+    oal_int32         l_tail_add;
+    oal_int32         l_count = 0;
+
+    if (skb_is_gso(pst_netbuf))
+    {
+        /*no device feature: the segments come out linear*/
+        pst_segs = skb_gso_segment(pst_netbuf, 0);
+        if (IS_ERR_OR_NULL(pst_segs))
+        {
+            oal_netbuf_free(pst_netbuf);
+            return 0;
+        }
+        consume_skb(pst_netbuf);
+    }
+    else
+    {
+        pst_segs = pst_netbuf;
+        pst_netbuf->next = NULL;
+    }
+
+    while (NULL != pst_segs)
+    {
+        pst_seg  = pst_segs;
+        pst_segs = pst_seg->next;
+        pst_seg->next = NULL;
+
+        if (OAL_UNLIKELY(skb_linearize(pst_seg)))
+        {
+            oal_netbuf_free(pst_seg);
+            continue;
+        }
+
+        /*one realloc for both ends, instead of one per layer below*/
+        l_head_add = (oal_int32)ul_headroom - (oal_int32)oal_netbuf_headroom(pst_seg);
+        l_tail_add = (oal_int32)ul_tailroom - (oal_int32)oal_netbuf_tailroom(pst_seg);
+        if ((l_head_add > 0) || (l_tail_add > 0))
+        {
+            if (OAL_SUCC != oal_netbuf_expand_head(pst_seg, OAL_MAX(l_head_add, 0),
+                                                   OAL_MAX(l_tail_add, 0), GFP_ATOMIC))
+            {
+                oal_netbuf_free(pst_seg);
+                continue;
+            }
+        }
+
+        if ((CHECKSUM_PARTIAL == pst_seg->ip_summed) && skb_checksum_help(pst_seg))
+        {
+            oal_netbuf_free(pst_seg);
+            continue;
+        }
+
+        oal_netbuf_add_to_list_tail(pst_seg, pst_list);
+        l_count++;
+    }
+
+    return l_count;
+}
+#endif
+
 /*lint -e19*/
 oal_module_symbol(oal_netbuf_is_dhcp_port);
 oal_module_symbol(oal_netbuf_is_dhcp6);
@@ -1090,6 +1419,14 @@ oal_module_symbol(oal_netbuf_get_txtid);
 oal_module_symbol(init_dev_excp_handler);
 oal_module_symbol(deinit_dev_excp_handler);
 
+#if (_PRE_OS_VERSION_LINUX == _PRE_OS_VERSION)
+oal_module_symbol(oal_netif_rx_napi_init);
+oal_module_symbol(oal_netif_rx_napi_exit);
+oal_module_symbol(oal_netif_rx_napi);
+oal_module_symbol(oal_netif_rx_napi_flush_all);
+oal_module_symbol(oal_netbuf_gso_segment);
+#endif
+
 
 /*lint +e19*/
 
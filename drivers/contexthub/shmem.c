@@ -11,6 +11,9 @@
 #include <linux/delay.h>
 #include <linux/io.h>
 #include <linux/workqueue.h>
+#include <linux/spinlock.h>
+#include <linux/semaphore.h>
+#include <linux/bitops.h>
 
 #include <global_ddr_map.h>
 #include "protocol.h"
@@ -170,6 +173,12 @@ const pkt_header_t *shmempack(const char *buf, unsigned int length)
 		return NULL;
 
 	msg = (struct shmem_ipc *)buf;
+#ifdef CONFIG_CONTEXTHUB_SHMEM_DESC
+	/* descriptors carry no payload in the window */
+	if (msg->hd.cmd >= CMD_SHMEM_AP_DESC_RECV_REQ
+	    && msg->hd.cmd <= CMD_SHMEM_AP_DESC_SEND_RESP)
+		return (const pkt_header_t *)buf;
+#endif
 
 	memcpy(recv_buf, shmem_gov.recv_addr, msg->data.buf_size);
 	INIT_WORK(&receive_response_work.worker, receive_response_work_handler);
@@ -277,6 +286,234 @@ static int shmem_send_init(void)
 	return 0;
 }
 
+#ifdef CONFIG_CONTEXTHUB_SHMEM_DESC
+/*
+ * Descriptor mode: a payload is written once into a buffer of the
+ * descriptor carveout and only {module_id, buffer index, size} goes
+ * through the mailbox, instead of a copy into the window above and a copy
+ * out of it on the other side.
+ *
+ * The first half of the carveout is the AP->IOM3 pool: buffers are taken
+ * with shmem_desc_get(), filled in place, sent with shmem_desc_send() and
+ * handed back by IOM3 with CMD_SHMEM_AP_DESC_SEND_RESP once consumed.
+ * The second half is the IOM3->AP pool, allocated by IOM3: the client's
+ * notifier is called on the buffer itself, which goes back to IOM3 with
+ * CMD_SHMEM_AP_DESC_RECV_RESP when the notifier returns. The number of
+ * buffers bounds the payloads in flight each way.
+ */
+#define SHMEM_DESC_PHY_ADDR (HISI_RESERVED_CH_BLOCK_SHMEM_DESC_PHYMEM_BASE)
+#define SHMEM_DESC_PHY_SIZE (HISI_RESERVED_CH_BLOCK_SHMEM_DESC_PHYMEM_SIZE)
+#define SHMEM_DESC_POOL_SIZE (SHMEM_DESC_PHY_SIZE/2)
+#define SHMEM_DESC_BUF_SIZE (64 * 1024)
+#define SHMEM_DESC_MAX_BUFS (BITS_PER_LONG)
+
+struct shmem_desc_ipc_data {
+	unsigned int module_id;
+	unsigned int buf_index;
+	unsigned int buf_size;
+};
+
+struct shmem_desc_ipc {
+	pkt_header_t hd;
+	struct shmem_desc_ipc_data data;
+};
+
+struct shmem_desc_pool {
+	void __iomem *send_addr;
+	void __iomem *recv_addr;
+	unsigned int nr_bufs;
+	/* one bit per AP->IOM3 buffer, set from get until IOM3 hands it back */
+	unsigned long send_busy;
+	spinlock_t lock;
+	/* counts the free AP->IOM3 buffers */
+	struct semaphore send_free;
+};
+
+static struct shmem_desc_pool shmem_desc;
+
+static int shmem_desc_ipc_send(unsigned char cmd, unsigned int module_id,
+			       unsigned int index, unsigned int size)
+{
+	struct shmem_desc_ipc pkt;
+	pkt.hd.tag = TAG_SHAREMEM;
+	pkt.hd.cmd = cmd;
+	pkt.hd.resp = 0;
+	pkt.data.module_id = module_id;
+	pkt.data.buf_index = index;
+	pkt.data.buf_size = size;
+	pkt.hd.length = sizeof(struct shmem_desc_ipc_data);
+	return inputhub_mcu_write_cmd_adapter(&pkt, sizeof(pkt), NULL);
+}
+
+/*
+ * shmem_desc_get - take a free AP->IOM3 buffer of at least 'size' bytes,
+ * waiting up to 500ms for IOM3 to hand one back. Returns the buffer index
+ * and its address in '*buf', or a negative errno.
+ */
+int shmem_desc_get(unsigned int size, void __iomem **buf)
+{
+	unsigned long flags;
+	int index;
+
+	if ((NULL == buf) || (0 == size) || (size > SHMEM_DESC_BUF_SIZE))
+		return -EINVAL;
+	if ((SHMEM_INIT_OK != shmem_gov.init_flag) || !shmem_desc.send_addr)
+		return -EPERM;
+
+	if (down_timeout(&shmem_desc.send_free, msecs_to_jiffies(500))) {
+		pr_warning("[%s]no free buffer in 500ms\n", __func__);
+		return -EBUSY;
+	}
+
+	spin_lock_irqsave(&shmem_desc.lock, flags);
+	index = find_first_zero_bit(&shmem_desc.send_busy, shmem_desc.nr_bufs);
+	__set_bit(index, &shmem_desc.send_busy);
+	spin_unlock_irqrestore(&shmem_desc.lock, flags);
+
+	*buf = shmem_desc.send_addr + index * SHMEM_DESC_BUF_SIZE;
+	return index;
+}
+
+/* shmem_desc_put - give back a buffer taken by shmem_desc_get and not sent */
+void shmem_desc_put(int index)
+{
+	unsigned long flags;
+	int busy;
+
+	if ((index < 0) || (index >= (int)shmem_desc.nr_bufs)) {
+		pr_err("[%s]bad buffer index %d\n", __func__, index);
+		return;
+	}
+
+	spin_lock_irqsave(&shmem_desc.lock, flags);
+	busy = __test_and_clear_bit(index, &shmem_desc.send_busy);
+	spin_unlock_irqrestore(&shmem_desc.lock, flags);
+
+	if (!busy) {
+		pr_err("[%s]buffer %d is not in use\n", __func__, index);
+		return;
+	}
+	up(&shmem_desc.send_free);
+}
+
+/*
+ * shmem_desc_send - pass the first 'size' bytes of buffer 'index' to
+ * 'module_id' on IOM3. The buffer belongs to IOM3 from here on, also on
+ * error, when it is given back at once.
+ */
+int shmem_desc_send(obj_tag_t module_id, int index, unsigned int size)
+{
+	int ret;
+
+	if ((index < 0) || (index >= (int)shmem_desc.nr_bufs)
+	    || (size > SHMEM_DESC_BUF_SIZE))
+		return -EINVAL;
+
+	/* the payload must be in memory before IOM3 sees the descriptor */
+	wmb();
+	ret = shmem_desc_ipc_send(CMD_SHMEM_AP_DESC_SEND_REQ, module_id,
+				  index, size);
+	if (ret)
+		shmem_desc_put(index);
+	return ret;
+}
+
+static int shmem_desc_send_resp(const pkt_header_t * head)
+{
+	const struct shmem_desc_ipc *msg = (const struct shmem_desc_ipc *)head;
+
+	shmem_desc_put(msg->data.buf_index);
+	return 0;
+}
+
+static int shmem_desc_recv(const pkt_header_t * head)
+{
+	const struct shmem_desc_ipc *msg = (const struct shmem_desc_ipc *)head;
+	struct shmem_client *pos;
+	unsigned int index, size;
+	bool found = false;
+
+	if (NULL == head)
+		return -EINVAL;
+
+	index = msg->data.buf_index;
+	size = msg->data.buf_size;
+	if ((index >= shmem_desc.nr_bufs) || (size > SHMEM_DESC_BUF_SIZE)) {
+		pr_err("[%s]bad descriptor index %u size %u\n", __func__,
+		       index, size);
+		return -EINVAL;
+	}
+
+	/* read the payload only after the descriptor */
+	rmb();
+
+	mutex_lock(&shmem_recv_lock);
+	list_for_each_entry(pos, &shmem_client_list, node) {
+		if (pos->module_id == msg->data.module_id) {
+			found = true;
+			if (pos->notifier_call)
+				pos->notifier_call(shmem_desc.recv_addr +
+						   index * SHMEM_DESC_BUF_SIZE,
+						   size);
+			break;
+		}
+	}
+	mutex_unlock(&shmem_recv_lock);
+
+	if (!found)
+		pr_err("[%s]not find module_id[0x%0x]\n", __func__,
+		       msg->data.module_id);
+
+	return shmem_desc_ipc_send(CMD_SHMEM_AP_DESC_RECV_RESP,
+				   msg->data.module_id, index, size);
+}
+
+static int shmem_desc_init(void)
+{
+	int ret;
+
+	shmem_desc.nr_bufs = min_t(unsigned int,
+				   SHMEM_DESC_POOL_SIZE / SHMEM_DESC_BUF_SIZE,
+				   SHMEM_DESC_MAX_BUFS);
+	if (0 == shmem_desc.nr_bufs)
+		return -EINVAL;
+
+	spin_lock_init(&shmem_desc.lock);
+	sema_init(&shmem_desc.send_free, shmem_desc.nr_bufs);
+
+	shmem_desc.send_addr = ioremap_wc(SHMEM_DESC_PHY_ADDR,
+					  SHMEM_DESC_PHY_SIZE);
+	if (!shmem_desc.send_addr) {
+		pr_err("[%s] ioremap err\n", __func__);
+		return -ENOMEM;
+	}
+	shmem_desc.recv_addr = shmem_desc.send_addr + SHMEM_DESC_POOL_SIZE;
+
+	ret = register_mcu_event_notifier(TAG_SHAREMEM,
+					  CMD_SHMEM_AP_DESC_RECV_REQ,
+					  shmem_desc_recv);
+	if (ret)
+		goto err_recv;
+
+	ret = register_mcu_event_notifier(TAG_SHAREMEM,
+					  CMD_SHMEM_AP_DESC_SEND_RESP,
+					  shmem_desc_send_resp);
+	if (ret)
+		goto err_send;
+
+	return 0;
+
+err_send:
+	unregister_mcu_event_notifier(TAG_SHAREMEM, CMD_SHMEM_AP_DESC_RECV_REQ,
+				      shmem_desc_recv);
+err_recv:
+	pr_err("[%s] register_mcu_event_notifier err\n", __func__);
+	iounmap(shmem_desc.send_addr);
+	shmem_desc.send_addr = NULL;
+	return ret;
+}
+#endif
+
 #ifdef CONFIG_DEBUG_FS
 int show_buff = 1;
 long udata_size;
@@ -367,6 +604,11 @@ int __init contexthub_shmem_init(void)
 	ret = shmem_send_init();
 	if (ret)
 		return ret;
+#ifdef CONFIG_CONTEXTHUB_SHMEM_DESC
+	/* the window mode works without it */
+	if (shmem_desc_init())
+		pr_err("[%s]descriptor mode unavailable\n", __func__);
+#endif
 
 #ifdef CONFIG_HISI_DEBUG_FS
 	shmem_gov.debugfs_root = debugfs_create_dir(MODULE_NAME, NULL);
@@ -8,5 +8,10 @@ extern int shmem_notifier_unregister(obj_tag_t module_id);
 extern int shmem_send(obj_tag_t module_id, const void *usr_buf, unsigned int usr_buf_size);
 extern int __init contexthub_shmem_init(void);
 extern const pkt_header_t *shmempack(const char *buf, unsigned int length);
+#ifdef CONFIG_CONTEXTHUB_SHMEM_DESC
+extern int shmem_desc_get(unsigned int size, void __iomem **buf);
+extern void shmem_desc_put(int index);
+extern int shmem_desc_send(obj_tag_t module_id, int index, unsigned int size);
+#endif
 
 #endif
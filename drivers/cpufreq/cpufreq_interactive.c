@@ -30,6 +30,8 @@
 #include <linux/workqueue.h>
 #include <linux/kthread.h>
 #include <linux/slab.h>
+#include <linux/irq_work.h>
+#include <trace/events/sched.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/cpufreq_interactive.h>
@@ -75,6 +77,10 @@ struct cpufreq_interactive_cpuinfo {
 	u64 loc_hispeed_val_time; /* per-cpu hispeed_validate_time */
 	struct rw_semaphore enable_sem;
 	int governor_enabled;
+	struct irq_work event_work;
+	u64 event_ts; /* sched_clock() of the last event evaluation */
+	bool event_eval; /* a sched event asked for a load evaluation */
+	unsigned int migr_boost_freq; /* demand of tasks migrated in, in kHz */
 };
 
 static DEFINE_PER_CPU(struct cpufreq_interactive_cpuinfo, cpuinfo);
@@ -141,6 +147,24 @@ struct cpufreq_interactive_tunables {
 #define DEFAULT_TIMER_SLACK (4 * DEFAULT_TIMER_RATE)
 	int timer_slack_val;
 	bool io_is_busy;
+	/*
+	 * Evaluate the load of a CPU as soon as a task is woken or moved
+	 * onto it, at most once per this many usecs, instead of waiting for
+	 * the timer. 0 means timer sampling only.
+	 */
+	unsigned long sched_event_rate;
+	/*
+	 * Raise the speed of a CPU a task migrates to from another policy
+	 * to what the task needed on its previous CPU, instead of waiting
+	 * for the load to show up in the next samples.
+	 */
+	bool migration_boost;
+	atomic_t migration_boosts;	/* raised the speed */
+	atomic_t migration_boosts_vain;	/* speed was already high enough */
+#ifdef CONFIG_ARCH_HISI
+	atomic_t input_boosts;		/* from cpufreq_interactive_input_boost */
+	atomic_t input_boosts_vain;	/* already boosted or at hispeed */
+#endif
 
 #ifdef CONFIG_HISI_HMPTH_INTERACTIVE
 	/* Non-zero mean hmp boost active */
@@ -551,6 +575,193 @@ static void cpufreq_interactive_idle_end(void)
 	up_read(&pcpu->enable_sem);
 }
 
+static void cpufreq_interactive_migration_boost(
+	struct cpufreq_interactive_cpuinfo *pcpu, int cpu, unsigned int freq)
+{
+	struct cpufreq_interactive_tunables *tunables =
+		pcpu->policy->governor_data;
+	unsigned int index;
+	unsigned long flags;
+	u64 now;
+
+	/* run the migrated demand at the target load, as choose_freq() does */
+	freq = min_t(u64, (u64)freq * 100 / freq_to_targetload(tunables, freq),
+		     pcpu->policy->max);
+	if (cpufreq_frequency_table_target(pcpu->policy, pcpu->freq_table,
+					   freq, CPUFREQ_RELATION_L, &index))
+		return;
+	freq = pcpu->freq_table[index].frequency;
+
+	now = ktime_to_us(ktime_get());
+	spin_lock_irqsave(&pcpu->target_freq_lock, flags);
+	if (freq <= pcpu->target_freq) {
+		spin_unlock_irqrestore(&pcpu->target_freq_lock, flags);
+		atomic_inc(&tunables->migration_boosts_vain);
+		return;
+	}
+
+	trace_cpufreq_interactive_target(cpu, 0, pcpu->target_freq,
+					 pcpu->policy->cur, freq);
+	pcpu->target_freq = freq;
+	/* hold it for min_sample_time as if the timer had picked it */
+	pcpu->floor_freq = freq;
+	pcpu->loc_floor_val_time = now;
+	spin_unlock_irqrestore(&pcpu->target_freq_lock, flags);
+	atomic_inc(&tunables->migration_boosts);
+
+	spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+	cpumask_set_cpu(cpu, &speedchange_cpumask);
+	spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
+	wake_up_process(speedchange_task);
+}
+
+static void cpufreq_interactive_event_work(struct irq_work *work)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu =
+		container_of(work, struct cpufreq_interactive_cpuinfo,
+			     event_work);
+	unsigned int boost_freq;
+
+	if (!down_read_trylock(&pcpu->enable_sem))
+		return;
+	if (!pcpu->governor_enabled) {
+		up_read(&pcpu->enable_sem);
+		return;
+	}
+
+	boost_freq = xchg(&pcpu->migr_boost_freq, 0);
+	if (boost_freq)
+		cpufreq_interactive_migration_boost(pcpu, smp_processor_id(),
+						    boost_freq);
+
+	if (pcpu->event_eval) {
+		pcpu->event_eval = false;
+		pcpu->event_ts = sched_clock();
+		del_timer(&pcpu->cpu_timer);
+		del_timer(&pcpu->cpu_slack_timer);
+		cpufreq_interactive_timer(smp_processor_id());
+		/* the evaluation gave up early if it could not take enable_sem */
+		if (!timer_pending(&pcpu->cpu_timer))
+			cpufreq_interactive_timer_resched(pcpu);
+	}
+
+	up_read(&pcpu->enable_sem);
+}
+
+static void cpufreq_interactive_event_queue(
+	struct cpufreq_interactive_cpuinfo *pcpu, int cpu)
+{
+	if (cpu == smp_processor_id())
+		irq_work_queue(&pcpu->event_work);
+	else
+		irq_work_queue_on(&pcpu->event_work, cpu);
+}
+
+/*
+ * Called from the scheduler with its locks held, so only queue the
+ * evaluation to run on @cpu from irq_work. Only ramping up gains from
+ * reacting early, bringing the speed down is left to the timer.
+ */
+static void cpufreq_interactive_sched_event(int cpu)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, cpu);
+	struct cpufreq_interactive_tunables *tunables;
+	unsigned long rate;
+
+	if (!pcpu->governor_enabled)
+		return;
+
+	tunables = pcpu->policy->governor_data;
+	rate = tunables ? ACCESS_ONCE(tunables->sched_event_rate) : 0;
+	if (!rate || pcpu->target_freq >= pcpu->policy->max)
+		return;
+
+	if (sched_clock() - pcpu->event_ts < (u64)rate * NSEC_PER_USEC)
+		return;
+
+	pcpu->event_eval = true;
+	cpufreq_interactive_event_queue(pcpu, cpu);
+}
+
+/* share of the time @p ran, 0..SCHED_CAPACITY_SCALE */
+static unsigned long cpufreq_interactive_task_demand(struct task_struct *p)
+{
+#ifdef CONFIG_SCHED_HMP
+	return p->se.avg.utilization_avg_contrib;
+#else
+	return p->se.avg.util_avg;
+#endif
+}
+
+/*
+ * @p leaves @src_cpu for @dest_cpu. If they are in different policies,
+ * carry the speed @p used to run at over to @dest_cpu. The demand is
+ * taken clock for clock, which errs on the fast side when moving up to
+ * the bigger cores.
+ */
+static void cpufreq_interactive_sched_migration(struct task_struct *p,
+						int src_cpu, int dest_cpu)
+{
+	struct cpufreq_interactive_cpuinfo *spcpu = &per_cpu(cpuinfo, src_cpu);
+	struct cpufreq_interactive_cpuinfo *dpcpu = &per_cpu(cpuinfo, dest_cpu);
+	struct cpufreq_interactive_tunables *tunables;
+	unsigned int freq;
+
+	if (!spcpu->governor_enabled || !dpcpu->governor_enabled)
+		return;
+
+	tunables = dpcpu->policy->governor_data;
+	if (!tunables || !ACCESS_ONCE(tunables->migration_boost))
+		return;
+	if (cpumask_test_cpu(src_cpu, dpcpu->policy->cpus))
+		return;
+
+	freq = ((u64)cpufreq_interactive_task_demand(p) *
+		spcpu->policy->cur) >> SCHED_CAPACITY_SHIFT;
+	if (freq <= dpcpu->target_freq) {
+		atomic_inc(&tunables->migration_boosts_vain);
+		return;
+	}
+
+	if (freq > ACCESS_ONCE(dpcpu->migr_boost_freq))
+		dpcpu->migr_boost_freq = freq;
+	cpufreq_interactive_event_queue(dpcpu, dest_cpu);
+}
+
+static void cpufreq_interactive_sched_wakeup(void *ignore,
+		struct task_struct *p, int success)
+{
+	if (success)
+		cpufreq_interactive_sched_event(task_cpu(p));
+}
+
+static void cpufreq_interactive_sched_migrate(void *ignore,
+		struct task_struct *p, int dest_cpu)
+{
+	cpufreq_interactive_sched_migration(p, task_cpu(p), dest_cpu);
+	if (p->on_rq)
+		cpufreq_interactive_sched_event(dest_cpu);
+}
+
+static void cpufreq_interactive_sched_events_register(void)
+{
+	register_trace_sched_wakeup(cpufreq_interactive_sched_wakeup, NULL);
+	register_trace_sched_wakeup_new(cpufreq_interactive_sched_wakeup,
+					NULL);
+	register_trace_sched_migrate_task(cpufreq_interactive_sched_migrate,
+					  NULL);
+}
+
+static void cpufreq_interactive_sched_events_unregister(void)
+{
+	unregister_trace_sched_migrate_task(cpufreq_interactive_sched_migrate,
+					    NULL);
+	unregister_trace_sched_wakeup_new(cpufreq_interactive_sched_wakeup,
+					  NULL);
+	unregister_trace_sched_wakeup(cpufreq_interactive_sched_wakeup, NULL);
+	tracepoint_synchronize_unregister();
+}
+
 static void cpufreq_interactive_get_policy_info(struct cpufreq_policy *policy,
 						unsigned int *pmax_freq,
 						u64 *phvt, u64 *pfvt)
@@ -649,7 +860,7 @@ static int cpufreq_interactive_speedchange_task(void *data)
 	return 0;
 }
 
-static void cpufreq_interactive_boost(struct cpufreq_interactive_tunables *tunables)
+static int cpufreq_interactive_boost(struct cpufreq_interactive_tunables *tunables)
 {
 	int i;
 	int anyboost = 0;
@@ -693,9 +904,55 @@ static void cpufreq_interactive_boost(struct cpufreq_interactive_tunables *tunab
 
 	if (anyboost)
 		wake_up_process(speedchange_task);
+
+	return anyboost;
 }
 
 #ifdef CONFIG_ARCH_HISI
+/*
+ * cpufreq_interactive_input_boost - boostpulse of 'duration_us' on every
+ * governor instance, for input drivers to call on touch down without a
+ * round trip through userspace. Returns the number of instances whose
+ * speed was raised.
+ */
+int cpufreq_interactive_input_boost(unsigned int duration_us)
+{
+	struct cpufreq_interactive_tunables *tunables, *last = NULL;
+	struct cpufreq_interactive_cpuinfo *pcpu;
+	u64 endtime = ktime_to_us(ktime_get()) + duration_us;
+	int cpu, raised = 0;
+
+	if (!cpufreq_interactive_initialized)
+		return -ENODEV;
+
+	for_each_online_cpu(cpu) {
+		pcpu = &per_cpu(cpuinfo, cpu);
+
+		if (!down_read_trylock(&pcpu->enable_sem))
+			continue;
+
+		tunables = pcpu->governor_enabled ?
+			pcpu->policy->governor_data : NULL;
+		if (tunables && tunables != last) {
+			last = tunables;
+			atomic_inc(&tunables->input_boosts);
+			if (endtime > tunables->boostpulse_endtime)
+				tunables->boostpulse_endtime = endtime;
+			trace_cpufreq_interactive_boost("input");
+			if (!tunables->boosted &&
+			    cpufreq_interactive_boost(tunables))
+				raised++;
+			else
+				atomic_inc(&tunables->input_boosts_vain);
+		}
+
+		up_read(&pcpu->enable_sem);
+	}
+
+	return raised;
+}
+EXPORT_SYMBOL(cpufreq_interactive_input_boost);
+
 #define MAX_LITTLE_CPU_NR	4
 
 int hisi_little_cluster_boost(void)
@@ -1000,6 +1257,66 @@ static ssize_t store_timer_rate(struct cpufreq_interactive_tunables *tunables,
 	return count;
 }
 
+static ssize_t show_sched_event_rate(
+		struct cpufreq_interactive_tunables *tunables, char *buf)
+{
+	return sprintf(buf, "%lu\n", tunables->sched_event_rate);
+}
+
+static ssize_t store_sched_event_rate(
+		struct cpufreq_interactive_tunables *tunables,
+		const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	tunables->sched_event_rate = val;
+	return count;
+}
+
+static ssize_t show_migration_boost(
+		struct cpufreq_interactive_tunables *tunables, char *buf)
+{
+	return sprintf(buf, "%u\n", tunables->migration_boost);
+}
+
+static ssize_t store_migration_boost(
+		struct cpufreq_interactive_tunables *tunables,
+		const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	tunables->migration_boost = !!val;
+	return count;
+}
+
+static ssize_t show_migration_boost_stats(
+		struct cpufreq_interactive_tunables *tunables, char *buf)
+{
+	return sprintf(buf, "boosts %d\nvain %d\n",
+		       atomic_read(&tunables->migration_boosts),
+		       atomic_read(&tunables->migration_boosts_vain));
+}
+
+#ifdef CONFIG_ARCH_HISI
+static ssize_t show_input_boost_stats(
+		struct cpufreq_interactive_tunables *tunables, char *buf)
+{
+	return sprintf(buf, "boosts %d\nvain %d\n",
+		       atomic_read(&tunables->input_boosts),
+		       atomic_read(&tunables->input_boosts_vain));
+}
+#endif
+
 static ssize_t show_timer_slack(struct cpufreq_interactive_tunables *tunables,
 		char *buf)
 {
@@ -1236,6 +1553,12 @@ show_store_gov_pol_sys(hispeed_freq);
 show_store_gov_pol_sys(go_hispeed_load);
 show_store_gov_pol_sys(min_sample_time);
 show_store_gov_pol_sys(timer_rate);
+show_store_gov_pol_sys(sched_event_rate);
+show_store_gov_pol_sys(migration_boost);
+show_gov_pol_sys(migration_boost_stats);
+#ifdef CONFIG_ARCH_HISI
+show_gov_pol_sys(input_boost_stats);
+#endif
 show_store_gov_pol_sys(timer_slack);
 show_store_gov_pol_sys(boost);
 store_gov_pol_sys(boostpulse);
@@ -1269,6 +1592,8 @@ gov_sys_pol_attr_rw(hispeed_freq);
 gov_sys_pol_attr_rw(go_hispeed_load);
 gov_sys_pol_attr_rw(min_sample_time);
 gov_sys_pol_attr_rw(timer_rate);
+gov_sys_pol_attr_rw(sched_event_rate);
+gov_sys_pol_attr_rw(migration_boost);
 gov_sys_pol_attr_rw(timer_slack);
 gov_sys_pol_attr_rw(boost);
 gov_sys_pol_attr_rw(boostpulse_duration);
@@ -1289,6 +1614,22 @@ static struct global_attr boostpulse_gov_sys =
 static struct freq_attr boostpulse_gov_pol =
 	__ATTR(boostpulse, 0200, NULL, store_boostpulse_gov_pol);
 
+static struct global_attr migration_boost_stats_gov_sys =
+	__ATTR(migration_boost_stats, 0444, show_migration_boost_stats_gov_sys,
+	       NULL);
+
+static struct freq_attr migration_boost_stats_gov_pol =
+	__ATTR(migration_boost_stats, 0444, show_migration_boost_stats_gov_pol,
+	       NULL);
+
+#ifdef CONFIG_ARCH_HISI
+static struct global_attr input_boost_stats_gov_sys =
+	__ATTR(input_boost_stats, 0444, show_input_boost_stats_gov_sys, NULL);
+
+static struct freq_attr input_boost_stats_gov_pol =
+	__ATTR(input_boost_stats, 0444, show_input_boost_stats_gov_pol, NULL);
+#endif
+
 /* One Governor instance for entire system */
 static struct attribute *interactive_attributes_gov_sys[] = {
 	&target_loads_gov_sys.attr,
@@ -1297,12 +1638,16 @@ static struct attribute *interactive_attributes_gov_sys[] = {
 	&go_hispeed_load_gov_sys.attr,
 	&min_sample_time_gov_sys.attr,
 	&timer_rate_gov_sys.attr,
+	&sched_event_rate_gov_sys.attr,
+	&migration_boost_gov_sys.attr,
+	&migration_boost_stats_gov_sys.attr,
 	&timer_slack_gov_sys.attr,
 	&boost_gov_sys.attr,
 	&boostpulse_gov_sys.attr,
 	&boostpulse_duration_gov_sys.attr,
 #ifdef CONFIG_ARCH_HISI
 	&boostpulse_min_interval_gov_sys.attr,
+	&input_boost_stats_gov_sys.attr,
 #endif
 	&io_is_busy_gov_sys.attr,
 #ifdef CONFIG_HISI_HMPTH_INTERACTIVE
@@ -1326,12 +1671,16 @@ static struct attribute *interactive_attributes_gov_pol[] = {
 	&go_hispeed_load_gov_pol.attr,
 	&min_sample_time_gov_pol.attr,
 	&timer_rate_gov_pol.attr,
+	&sched_event_rate_gov_pol.attr,
+	&migration_boost_gov_pol.attr,
+	&migration_boost_stats_gov_pol.attr,
 	&timer_slack_gov_pol.attr,
 	&boost_gov_pol.attr,
 	&boostpulse_gov_pol.attr,
 	&boostpulse_duration_gov_pol.attr,
 #ifdef CONFIG_ARCH_HISI
 	&boostpulse_min_interval_gov_pol.attr,
+	&input_boost_stats_gov_pol.attr,
 #endif
 	&io_is_busy_gov_pol.attr,
 #ifdef CONFIG_HISI_HMPTH_INTERACTIVE
@@ -1451,6 +1800,7 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 			idle_notifier_register(&cpufreq_interactive_idle_nb);
 			cpufreq_register_notifier(&cpufreq_notifier_block,
 					CPUFREQ_TRANSITION_NOTIFIER);
+			cpufreq_interactive_sched_events_register();
 		}
 
 #ifdef CONFIG_ARCH_HISI
@@ -1467,6 +1817,7 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 #endif
 		if (!--tunables->usage_count) {
 			if (policy->governor->initialized == 1) {
+				cpufreq_interactive_sched_events_unregister();
 				cpufreq_unregister_notifier(&cpufreq_notifier_block,
 						CPUFREQ_TRANSITION_NOTIFIER);
 				idle_notifier_unregister(&cpufreq_interactive_idle_nb);
@@ -1523,6 +1874,7 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 			del_timer_sync(&pcpu->cpu_timer);
 			del_timer_sync(&pcpu->cpu_slack_timer);
 			up_write(&pcpu->enable_sem);
+			irq_work_sync(&pcpu->event_work);
 		}
 
 		mutex_unlock(&gov_lock);
@@ -1598,6 +1950,8 @@ static int __init cpufreq_interactive_init(void)
 		spin_lock_init(&pcpu->load_lock);
 		spin_lock_init(&pcpu->target_freq_lock);
 		init_rwsem(&pcpu->enable_sem);
+		init_irq_work(&pcpu->event_work,
+			      cpufreq_interactive_event_work);
 	}
 
 	spin_lock_init(&speedchange_cpumask_lock);
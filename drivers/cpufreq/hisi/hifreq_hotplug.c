@@ -16,6 +16,7 @@
 
 #include <linux/cpu.h>
 #include <linux/cpufreq.h>
+#include <linux/cpuidle.h>
 #include <linux/cpumask.h>
 #include <linux/export.h>
 #include <linux/module.h>
@@ -67,6 +68,27 @@ struct driver_data {
 	unsigned int stay_down_delay;
 	s64 last_up_time;
 	s64 last_down_time;
+	/*
+	 * Decision engine. Going down costs two hotplugs of several ms, so
+	 * it is only worth it when all of these hold:
+	 * - the runnable count stays low on average, not just this sample;
+	 * - the governor asks for more than THRESHOLD_FREQ;
+	 * - the cores to unplug already spend down_idle_pct of their time
+	 *   in a deep idle state, so little runs there to be moved away;
+	 * - the quiet spells of late lasted at least min_quiet_time.
+	 * For shorter ones the cores are left online, idling.
+	 */
+#define NR_AVG_SHIFT		8
+	unsigned int nr_avg;		/* << NR_AVG_SHIFT */
+#define DEFAULT_DOWN_IDLE_PCT	60
+	unsigned int down_idle_pct;
+	unsigned int deep_idle_pct;
+	u64 deep_idle_us;
+	s64 idle_sample_time;
+#define DEFAULT_MIN_QUIET_TIME	(200 * USEC_PER_MSEC)
+	unsigned int min_quiet_time;
+	unsigned int quiet_pred;	/* usecs, average of the quiet spells */
+	s64 quiet_start;
 	bool need_up;
 	bool need_down;
 	bool hotplugged_down;
@@ -142,6 +164,59 @@ static ssize_t show_stay_down_delay(struct kobject *kobj,
 	return sprintf(buf, "%u\n", bL_cpufreq_data.stay_down_delay);
 }
 
+static ssize_t show_down_idle_pct(struct kobject *kobj,
+				 struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", bL_cpufreq_data.down_idle_pct);
+}
+
+static ssize_t show_min_quiet_time(struct kobject *kobj,
+				 struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", bL_cpufreq_data.min_quiet_time);
+}
+
+static ssize_t show_hotplug_stats(struct kobject *kobj,
+				 struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "nr_avg %u.%02u deep_idle %u%% quiet_pred %u\n",
+		bL_cpufreq_data.nr_avg >> NR_AVG_SHIFT,
+		((bL_cpufreq_data.nr_avg & ((1U << NR_AVG_SHIFT) - 1)) * 100)
+			>> NR_AVG_SHIFT,
+		bL_cpufreq_data.deep_idle_pct, bL_cpufreq_data.quiet_pred);
+}
+
+static ssize_t store_down_idle_pct(struct kobject *kobj, struct attribute *attr,
+				  const char *buf, size_t count)
+{
+	int ret;
+	unsigned int val;
+
+	ret = kstrtouint(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	if (val > 100)
+		return -EINVAL;
+
+	bL_cpufreq_data.down_idle_pct = val;
+	return count;
+}
+
+static ssize_t store_min_quiet_time(struct kobject *kobj, struct attribute *attr,
+				  const char *buf, size_t count)
+{
+	int ret;
+	unsigned int val;
+
+	ret = kstrtouint(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	bL_cpufreq_data.min_quiet_time = val;
+	return count;
+}
+
 static ssize_t store_down_nr_threshold(struct kobject *kobj, struct attribute *attr,
 				  const char *buf, size_t count)
 {
@@ -238,6 +313,9 @@ define_one_global_rw(up_cnt_threshold);
 define_one_global_rw(down_cnt_threshold);
 define_one_global_rw(stay_up_delay);
 define_one_global_rw(stay_down_delay);
+define_one_global_rw(down_idle_pct);
+define_one_global_rw(min_quiet_time);
+define_one_global_ro(hotplug_stats);
 
 static void bL_hotplug_sysfs_create(void)
 {
@@ -267,6 +345,18 @@ static void bL_hotplug_sysfs_create(void)
 	if (ret)
 		goto err_create_sysfs;
 
+	ret = cpufreq_sysfs_create_file(&down_idle_pct.attr);
+	if (ret)
+		goto err_create_sysfs;
+
+	ret = cpufreq_sysfs_create_file(&min_quiet_time.attr);
+	if (ret)
+		goto err_create_sysfs;
+
+	ret = cpufreq_sysfs_create_file(&hotplug_stats.attr);
+	if (ret)
+		goto err_create_sysfs;
+
 	return;
 
 err_create_sysfs:
@@ -330,7 +420,10 @@ static void hifreq_hotplug_cpu(bool offline)
 	spin_lock_irqsave(&(bL_cpufreq_data.hotplug_lock), flags);
 	bL_cpufreq_data.hotplug_in_progress = false;
 	bL_cpufreq_data.hotplugged_down = offline;
-	bL_cpufreq_data.last_down_time = ktime_to_us(ktime_get());
+	if (offline)
+		bL_cpufreq_data.last_down_time = ktime_to_us(ktime_get());
+	else
+		bL_cpufreq_data.last_up_time = ktime_to_us(ktime_get());
 	spin_unlock_irqrestore(&(bL_cpufreq_data.hotplug_lock), flags);
 }
 
@@ -407,6 +500,88 @@ retry:
 }
 /*lint +e715*/
 
+/* time the cores of hotplug_cpumask spent in idle states past WFI */
+static u64 bL_hotplug_deep_idle_us(void)
+{
+	struct cpuidle_device *dev;
+	struct cpuidle_driver *drv;
+	unsigned int cpu;
+	u64 sum = 0;
+	int i;
+
+	for_each_cpu(cpu, &hotplug_cpumask) {
+		dev = per_cpu(cpuidle_devices, cpu);
+		drv = cpuidle_get_cpu_driver(dev);
+		if (!dev || !drv)
+			continue;
+		for (i = 1; i < drv->state_count; i++)
+			sum += dev->states_usage[i].time;
+	}
+	return sum;
+}
+
+/* must be called with hotplug_lock held */
+static void bL_hotplug_update_stats(unsigned int nr_runnings, s64 now)
+{
+	struct driver_data *data = &bL_cpufreq_data;
+	u64 idle_us, delta_idle;
+	s64 delta;
+
+	/* 1/4 weight to the new sample */
+	data->nr_avg = data->nr_avg - (data->nr_avg >> 2) +
+		(nr_runnings << (NR_AVG_SHIFT - 2));
+
+	delta = now - data->idle_sample_time;
+	if (delta < 10 * USEC_PER_MSEC)
+		return;
+
+	idle_us = bL_hotplug_deep_idle_us();
+	delta_idle = idle_us - data->deep_idle_us;
+	data->deep_idle_us = idle_us;
+	data->idle_sample_time = now;
+	/* unplugged cores do not count idle time */
+	if (data->hotplugged_down)
+		return;
+
+	data->deep_idle_pct = (unsigned int)min_t(u64, 100,
+		div64_u64(delta_idle * 100,
+			  (u64)delta * cpumask_weight(&hotplug_cpumask)));
+}
+
+/* must be called with hotplug_lock held */
+static void bL_hotplug_quiet_end(s64 now)
+{
+	struct driver_data *data = &bL_cpufreq_data;
+	unsigned int spell;
+
+	if (!data->quiet_start)
+		return;
+
+	spell = (unsigned int)min_t(s64, now - data->quiet_start, UINT_MAX);
+	data->quiet_pred = data->quiet_pred - (data->quiet_pred >> 2) +
+		(spell >> 2);
+	data->quiet_start = 0;
+}
+
+/* must be called with hotplug_lock held */
+static bool bL_hotplug_down_worth(unsigned int target_freq, s64 now)
+{
+	struct driver_data *data = &bL_cpufreq_data;
+
+	if (!data->quiet_start)
+		data->quiet_start = now;
+
+	if (data->nr_avg >= data->down_nr_threshold << NR_AVG_SHIFT)
+		return false;
+	if (target_freq <= THRESHOLD_FREQ)
+		return false;
+	if (data->deep_idle_pct < data->down_idle_pct)
+		return false;
+	/* the spell going on counts as long as it lasts */
+	return max_t(s64, data->quiet_pred, now - data->quiet_start) >=
+		data->min_quiet_time;
+}
+
 static void bL_hifreq_hotplug_clear_req(void)
 {
 	bL_cpufreq_data.req_up_cnt = 0;
@@ -454,6 +629,10 @@ int bL_hifreq_hotplug_set_target(struct cpufreq_policy *policy,
 
 	spin_lock_irqsave(&(bL_cpufreq_data.hotplug_lock), flags);
 	offline = bL_cpufreq_data.hotplugged_down;
+	bL_hotplug_update_stats(nr_runnings, now);
+	if (nr_runnings >= bL_cpufreq_data.down_nr_threshold || boost)
+		bL_hotplug_quiet_end(now);
+
 	if (nr_runnings > bL_cpufreq_data.up_nr_threshold || boost) {
 		/* if already online, freq up to at most THRESHOLD_FREQ */
 		if (!offline) {
@@ -494,6 +673,13 @@ int bL_hifreq_hotplug_set_target(struct cpufreq_policy *policy,
 			goto set_freq;
 		}
 
+		/* keep the cores online and idle rather than unplug them */
+		if (!bL_hotplug_down_worth(target_freq, now)) {
+			bL_hifreq_hotplug_clear_req();
+			spin_unlock_irqrestore(&(bL_cpufreq_data.hotplug_lock), flags);
+			goto verify_freq;
+		}
+
 		bL_cpufreq_data.req_down_cnt++;
 		if (bL_cpufreq_data.req_down_cnt < bL_cpufreq_data.down_cnt_threshold) {
 			trace_hifreq_hotplug_cnt_notyet(cpu,
@@ -584,6 +770,12 @@ void bL_hifreq_hotplug_init(void)
 	data->down_cnt_threshold = DEFAULT_DOWN_CNT_THRESHOLD;
 	data->stay_up_delay = DEFAULT_STAY_UP_DELAY;
 	data->stay_down_delay = DEFAULT_STAY_DOWN_DELAY;
+	data->down_idle_pct = DEFAULT_DOWN_IDLE_PCT;
+	data->min_quiet_time = DEFAULT_MIN_QUIET_TIME;
+	/* no history yet, let the first quiet spell decide */
+	data->quiet_pred = DEFAULT_MIN_QUIET_TIME;
+	data->quiet_start = 0;
+	data->nr_avg = 0;
 	data->req_up_cnt = 0;
 	data->req_down_cnt = 0;
 	data->need_up = false;
@@ -592,6 +784,9 @@ void bL_hifreq_hotplug_init(void)
 	data->hotplug_in_progress = false;
 	data->last_up_time = ktime_to_us(ktime_get());
 	data->last_down_time = data->last_up_time;
+	data->idle_sample_time = data->last_up_time;
+	data->deep_idle_us = 0;
+	data->deep_idle_pct = 0;
 
 	/* physical cpu 4&5(logical 6&7) to be hotplugged up and down */
 	cpumask_set_cpu(6, &hotplug_cpumask);
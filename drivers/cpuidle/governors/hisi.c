@@ -0,0 +1,341 @@
+/*
+ * hisi.c - idle governor for the hisi multi-driver cpuidle
+ *
+ * Copyright (c) 2016 Hisilicon Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/cpu.h>
+#include <linux/cpuidle.h>
+#include <linux/pm_qos.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/tick.h>
+#include <linux/sched.h>
+#include <linux/kernel_stat.h>
+#include <linux/module.h>
+
+/*
+ * The menu governor scales the next timer event by a correction factor
+ * learnt per bucket, which a mix of short timers and interrupts keeps
+ * off and which sends the cluster down too often.
+ *
+ * This one classifies every wakeup by what caused it:
+ * - timer: the CPU slept about as long as its next timer event;
+ * - IPI: the IPI count of the CPU moved;
+ * - IRQ: anything else.
+ * When most of the last HGOV_HIST wakeups were not timers, the idle time
+ * is predicted from how long the most frequent of the other sources let
+ * the CPU sleep, otherwise from the next timer event.
+ *
+ * The deepest state of a driver with more than two states is taken to
+ * be the cluster one. It is only picked when every other online CPU of
+ * the driver is idle and expected to stay so for its target residency.
+ */
+
+#define HGOV_HIST		16
+#define HGOV_EWMA_SHIFT		2
+
+enum hgov_source {
+	HGOV_TIMER,
+	HGOV_IRQ,
+	HGOV_IPI,
+	HGOV_NR_SRC,
+};
+
+static const char * const hgov_source_names[] = {
+	"timer", "irq", "ipi",
+};
+
+struct hgov_device {
+	int		last_state_idx;
+	int		needs_update;
+
+	unsigned int	next_timer_us;
+	unsigned int	predicted_us;
+	u64		wake_ns;	/* expected wakeup, 0 when running */
+	unsigned int	irqs;
+	u64		ipis;
+
+	u8		hist[HGOV_HIST];
+	int		hist_ptr;
+	unsigned int	sleep_us[HGOV_NR_SRC];	/* average sleep per source */
+
+	unsigned long	wakeups[HGOV_NR_SRC];
+	unsigned long	entries[CPUIDLE_STATE_MAX];
+	unsigned long	early[CPUIDLE_STATE_MAX];	/* woke before residency */
+};
+
+static DEFINE_PER_CPU(struct hgov_device, hgov_devices);
+
+static void hgov_update(struct cpuidle_driver *drv, struct cpuidle_device *dev);
+
+static u64 hgov_ipi_count(unsigned int cpu)
+{
+#ifdef arch_irq_stat_cpu
+	return arch_irq_stat_cpu(cpu);
+#else
+	return 0;
+#endif
+}
+
+static unsigned int hgov_predict(struct hgov_device *data)
+{
+	unsigned int count[HGOV_NR_SRC] = { 0 };
+	int i, src;
+
+	for (i = 0; i < HGOV_HIST; i++)
+		count[data->hist[i]]++;
+
+	if (count[HGOV_TIMER] * 2 > HGOV_HIST)
+		return data->next_timer_us;
+
+	src = count[HGOV_IPI] > count[HGOV_IRQ] ? HGOV_IPI : HGOV_IRQ;
+	return min(data->next_timer_us, data->sleep_us[src]);
+}
+
+static int hgov_cluster_state(struct cpuidle_driver *drv)
+{
+	return drv->state_count > CPUIDLE_DRIVER_STATE_START + 2 ?
+		drv->state_count - 1 : -1;
+}
+
+/* the other CPUs of @drv stay idle for @residency_us from @now */
+static bool hgov_cluster_idle(struct cpuidle_driver *drv,
+			      struct cpuidle_device *dev, u64 now,
+			      unsigned int residency_us)
+{
+	u64 until = now + (u64)residency_us * NSEC_PER_USEC;
+	u64 wake_ns;
+	int cpu;
+
+	for_each_cpu(cpu, drv->cpumask) {
+		if (cpu == dev->cpu || !cpu_online(cpu))
+			continue;
+		wake_ns = ACCESS_ONCE(per_cpu(hgov_devices, cpu).wake_ns);
+		if (!wake_ns || wake_ns < until)
+			return false;
+	}
+	return true;
+}
+
+/**
+ * hgov_select - selects the next idle state to enter
+ * @drv: cpuidle driver containing state data
+ * @dev: the CPU
+ */
+static int hgov_select(struct cpuidle_driver *drv, struct cpuidle_device *dev)
+{
+	struct hgov_device *data = this_cpu_ptr(&hgov_devices);
+	int latency_req = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+	int cluster_idx = hgov_cluster_state(drv);
+	u64 now;
+	int i;
+
+	if (data->needs_update) {
+		hgov_update(drv, dev);
+		data->needs_update = 0;
+	}
+
+	data->last_state_idx = CPUIDLE_DRIVER_STATE_START - 1;
+	data->irqs = kstat_cpu_irqs_sum(dev->cpu);
+	data->ipis = hgov_ipi_count(dev->cpu);
+
+	/* Special case when user has set very strict latency requirement */
+	if (unlikely(latency_req == 0))
+		return 0;
+
+	data->next_timer_us = ktime_to_us(tick_nohz_get_sleep_length());
+	data->predicted_us = hgov_predict(data);
+
+	now = sched_clock();
+	ACCESS_ONCE(data->wake_ns) = now +
+		(u64)data->predicted_us * NSEC_PER_USEC;
+	/* order wake_ns against the look at the other CPUs */
+	smp_mb();
+
+	if (data->next_timer_us > 5 &&
+	    !drv->states[CPUIDLE_DRIVER_STATE_START].disabled &&
+		dev->states_usage[CPUIDLE_DRIVER_STATE_START].disable == 0)
+		data->last_state_idx = CPUIDLE_DRIVER_STATE_START;
+
+	for (i = CPUIDLE_DRIVER_STATE_START; i < drv->state_count; i++) {
+		struct cpuidle_state *s = &drv->states[i];
+		struct cpuidle_state_usage *su = &dev->states_usage[i];
+
+		if (s->disabled || su->disable)
+			continue;
+		if (s->target_residency > data->predicted_us)
+			continue;
+		if (s->exit_latency > latency_req)
+			continue;
+		if (i == cluster_idx &&
+		    !hgov_cluster_idle(drv, dev, now, s->target_residency))
+			continue;
+
+		data->last_state_idx = i;
+	}
+
+	return data->last_state_idx;
+}
+
+/**
+ * hgov_reflect - records that data structures need update
+ * @dev: the CPU
+ * @index: the index of actual entered state
+ */
+static void hgov_reflect(struct cpuidle_device *dev, int index)
+{
+	struct hgov_device *data = this_cpu_ptr(&hgov_devices);
+
+	ACCESS_ONCE(data->wake_ns) = 0;
+	data->last_state_idx = index;
+	data->needs_update = 1;
+}
+
+/**
+ * hgov_update - learns from the wakeup that ended the last idle period
+ * @drv: cpuidle driver
+ * @dev: the CPU
+ */
+static void hgov_update(struct cpuidle_driver *drv, struct cpuidle_device *dev)
+{
+	struct hgov_device *data = this_cpu_ptr(&hgov_devices);
+	int last_idx = data->last_state_idx;
+	unsigned int measured_us;
+	int src;
+
+	if (last_idx < 0)
+		return;
+
+	measured_us = cpuidle_get_last_residency(dev);
+
+	if (measured_us + (data->next_timer_us >> 3) >= data->next_timer_us)
+		src = HGOV_TIMER;
+	else if (hgov_ipi_count(dev->cpu) != data->ipis &&
+		 kstat_cpu_irqs_sum(dev->cpu) == data->irqs)
+		src = HGOV_IPI;
+	else
+		src = HGOV_IRQ;
+
+	data->hist[data->hist_ptr++] = src;
+	if (data->hist_ptr >= HGOV_HIST)
+		data->hist_ptr = 0;
+	data->sleep_us[src] = data->sleep_us[src] -
+		(data->sleep_us[src] >> HGOV_EWMA_SHIFT) +
+		(measured_us >> HGOV_EWMA_SHIFT);
+
+	data->wakeups[src]++;
+	data->entries[last_idx]++;
+	if (last_idx > 0 &&
+	    measured_us < drv->states[last_idx].target_residency)
+		data->early[last_idx]++;
+}
+
+/**
+ * hgov_enable_device - scans a CPU's states and does setup
+ * @drv: cpuidle driver
+ * @dev: the CPU
+ */
+static int hgov_enable_device(struct cpuidle_driver *drv,
+			      struct cpuidle_device *dev)
+{
+	struct hgov_device *data = &per_cpu(hgov_devices, dev->cpu);
+
+	memset(data, 0, sizeof(struct hgov_device));
+	data->last_state_idx = -1;
+
+	return 0;
+}
+
+static ssize_t show_hisi_wakeup_sources(struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	struct hgov_device *data;
+	ssize_t len = 0;
+	int cpu, src;
+
+	for_each_possible_cpu(cpu) {
+		data = &per_cpu(hgov_devices, cpu);
+		len += scnprintf(buf + len, PAGE_SIZE - len, "cpu%d", cpu);
+		for (src = 0; src < HGOV_NR_SRC; src++)
+			len += scnprintf(buf + len, PAGE_SIZE - len,
+					 " %s %lu/%uus", hgov_source_names[src],
+					 data->wakeups[src],
+					 data->sleep_us[src]);
+		len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+	}
+	return len;
+}
+
+static ssize_t show_hisi_mispredictions(struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	struct cpuidle_driver *drv;
+	struct hgov_device *data;
+	ssize_t len = 0;
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		data = &per_cpu(hgov_devices, cpu);
+		drv = cpuidle_get_cpu_driver(per_cpu(cpuidle_devices, cpu));
+		if (!drv)
+			continue;
+		len += scnprintf(buf + len, PAGE_SIZE - len, "cpu%d", cpu);
+		for (i = 1; i < drv->state_count; i++)
+			len += scnprintf(buf + len, PAGE_SIZE - len,
+					 " %s %lu/%lu", drv->states[i].name,
+					 data->early[i], data->entries[i]);
+		len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+	}
+	return len;
+}
+
+static DEVICE_ATTR(hisi_wakeup_sources, 0444, show_hisi_wakeup_sources, NULL);
+static DEVICE_ATTR(hisi_mispredictions, 0444, show_hisi_mispredictions, NULL);
+
+static struct cpuidle_governor hgov_governor = {
+	.name =		"hisi",
+	.rating =	25,
+	.enable =	hgov_enable_device,
+	.select =	hgov_select,
+	.reflect =	hgov_reflect,
+	.owner =	THIS_MODULE,
+};
+
+/**
+ * init_hgov - initializes the governor
+ */
+static int __init init_hgov(void)
+{
+	return cpuidle_register_governor(&hgov_governor);
+}
+
+postcore_initcall(init_hgov);
+
+/* the cpuidle sysfs group exists from core_initcall on */
+static int __init init_hgov_sysfs(void)
+{
+	struct kobject *kobj = &cpu_subsys.dev_root->kobj;
+	int ret;
+
+	ret = sysfs_add_file_to_group(kobj, &dev_attr_hisi_wakeup_sources.attr,
+				      "cpuidle");
+	if (ret)
+		return ret;
+
+	ret = sysfs_add_file_to_group(kobj, &dev_attr_hisi_mispredictions.attr,
+				      "cpuidle");
+	if (ret)
+		sysfs_remove_file_from_group(kobj,
+				&dev_attr_hisi_wakeup_sources.attr, "cpuidle");
+	return ret;
+}
+
+late_initcall(init_hgov_sysfs);
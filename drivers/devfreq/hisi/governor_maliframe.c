@@ -0,0 +1,387 @@
+/*
+ *  linux/drivers/devfreq/hisi/governor_maliframe.c
+ *
+ * base on:
+ *  linux/drivers/devfreq/hisi/governor_maliondemand.c
+ *
+ * Frame deadline governor for the Mali GPU. kbase reports the GPU busy
+ * time of every frame when its fragment job completes; the governor turns
+ * it into cycles, so the estimate does not depend on the frequency the
+ * frame ran at, and picks the lowest OPP that fits those cycles into
+ * headroom percent of the target frame time. Fragment jobs completing
+ * within half a frame time of the frame start are merged into that
+ * frame, which keeps offscreen passes from being counted as frames.
+ *
+ * Without frames, e.g. compute only, it falls back to utilisation. A
+ * boost written from userspace raises a floor for a while.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/errno.h>
+#include <linux/module.h>
+#include <linux/devfreq.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/device.h>
+#include <linux/spinlock.h>
+#include <linux/thermal.h>
+#include <linux/hisi/hisi_devfreq.h>
+#include <governor.h>
+
+#define DFMF_DEFAULT_FRAME_US	16667
+#define DFMF_MIN_FRAME_US	4000
+#define DFMF_MAX_FRAME_US	100000
+#define DFMF_DEFAULT_HEADROOM	90
+#define DFMF_MIN_HEADROOM	50
+#define DFMF_MAX_HEADROOM	100
+#define DFMF_DEFAULT_UPTHRESHOLD	85
+#define DFMF_MIN_UPTHRESHOLD	11
+#define DFMF_MAX_UPTHRESHOLD	100
+#define DFMF_MAX_BOOST_MS	5000
+#define DFMF_MAX_BOOST_FREQ	2000000000
+/* frames older than this many frame times do not drive the choice */
+#define DFMF_IDLE_FRAMES	4
+#define DFMF_CONSANTS_DIGIT_MAX	16
+
+struct devfreq_mali_frame_data {
+	/* tunables, written under devfreq->lock */
+	unsigned int target_frame_us;
+	unsigned int headroom;
+	unsigned int upthreshold;
+	unsigned int boost_freq;
+	unsigned int boost_ms;
+	unsigned long boost_until;
+
+	/* frame accounting, fed from the job completion path */
+	spinlock_t lock;
+	unsigned long cur_khz;
+	u64 pending_cycles;
+	u64 pending_ns;
+	u64 frame_cycles;
+	ktime_t frame_start;
+	ktime_t last_frame;
+	unsigned int frames;
+	unsigned int frame_mode;
+};
+
+static struct devfreq_mali_frame_data dfmf = {
+	.target_frame_us = DFMF_DEFAULT_FRAME_US,
+	.headroom = DFMF_DEFAULT_HEADROOM,
+	.upthreshold = DFMF_DEFAULT_UPTHRESHOLD,
+	.lock = __SPIN_LOCK_UNLOCKED(dfmf.lock),
+};
+
+void mali_frame_report(u64 busy_ns)
+{
+	struct devfreq_mali_frame_data *data = &dfmf;
+	unsigned long khz = ACCESS_ONCE(data->cur_khz);
+	s64 half_frame_ns;
+	unsigned long flags;
+	u64 frame_ns = 0;
+	ktime_t now;
+
+	if (!khz)
+		return;
+
+	now = ktime_get();
+	half_frame_ns = (s64)ACCESS_ONCE(data->target_frame_us) *
+				NSEC_PER_USEC / 2;
+
+	spin_lock_irqsave(&data->lock, flags);
+	data->pending_cycles += div_u64(busy_ns * khz, USEC_PER_SEC);
+	data->pending_ns += busy_ns;
+	if (ktime_to_ns(ktime_sub(now, data->frame_start)) >= half_frame_ns) {
+		/* follow a heavier frame at once, decay slowly */
+		if (data->pending_cycles >= data->frame_cycles)
+			data->frame_cycles = data->pending_cycles;
+		else
+			data->frame_cycles = (data->frame_cycles * 3 +
+					      data->pending_cycles) >> 2;
+		frame_ns = data->pending_ns;
+		data->pending_cycles = 0;
+		data->pending_ns = 0;
+		data->frame_start = now;
+		data->last_frame = now;
+		data->frames++;
+	}
+	spin_unlock_irqrestore(&data->lock, flags);
+
+#ifdef CONFIG_HISI_IPA_THERMAL
+	/* lets IPA give the GPU budget while it runs late at this frequency */
+	if (frame_ns)
+		ipa_frame_demand_hint(IPA_GPU, frame_ns,
+				      (u64)half_frame_ns * 2);
+#endif
+}
+EXPORT_SYMBOL(mali_frame_report);
+
+/* lowest frequency running @cycles within the frame budget, 0 if idle */
+static unsigned long mali_frame_deadline_freq(struct devfreq_mali_frame_data *data)
+{
+	u64 budget_us = div_u64((u64)data->target_frame_us * data->headroom,
+				100);
+	s64 idle_ns = (s64)data->target_frame_us * NSEC_PER_USEC *
+				DFMF_IDLE_FRAMES;
+	unsigned long flags;
+	u64 cycles;
+	bool recent;
+
+	spin_lock_irqsave(&data->lock, flags);
+	cycles = data->frame_cycles;
+	recent = data->frames &&
+		ktime_to_ns(ktime_sub(ktime_get(), data->last_frame)) < idle_ns;
+	spin_unlock_irqrestore(&data->lock, flags);
+
+	if (!recent || !budget_us)
+		return 0;
+
+	return (unsigned long)div64_u64(cycles * USEC_PER_SEC, budget_us);
+}
+
+static int devfreq_mali_frame_func(struct devfreq *df, unsigned long *freq)
+{
+	struct devfreq_dev_status stat;
+	struct devfreq_mali_frame_data *data = df->data;
+	unsigned long max = (df->max_freq) ? df->max_freq : UINT_MAX;
+	unsigned long long a;
+	int err;
+
+	if (!data)
+		return -EINVAL;
+
+	err = df->profile->get_dev_status(df->dev.parent, &stat);
+	if (err)
+		return err;
+
+	ACCESS_ONCE(data->cur_khz) = stat.current_frequency / 1000;
+
+	*freq = mali_frame_deadline_freq(data);
+	data->frame_mode = !!*freq;
+	if (data->frame_mode)
+		goto check_boost;
+
+	/* Assume MAX if it is going to be divided by zero */
+	if (unlikely(stat.total_time == 0 || stat.current_frequency == 0)) {
+		*freq = max;
+		goto check_boost;
+	}
+
+	/* Prevent overflow */
+	if (stat.busy_time >= (1 << 24) || stat.total_time >= (1 << 24)) {
+		stat.busy_time >>= 7;
+		stat.total_time >>= 7;
+	}
+
+	a = stat.busy_time;
+	a *= stat.current_frequency;
+	a = div_u64(a, stat.total_time);
+	a *= 100;
+	*freq = (unsigned long)div_u64(a, data->upthreshold);
+
+check_boost:
+	if (time_before(jiffies, ACCESS_ONCE(data->boost_until))) {
+		unsigned long boost = data->boost_freq ? data->boost_freq : max;
+
+		if (*freq < boost)
+			*freq = boost;
+	}
+
+	if (df->min_freq && *freq < df->min_freq)
+		*freq = df->min_freq;
+	if (df->max_freq && *freq > df->max_freq)
+		*freq = df->max_freq;
+
+	return 0;
+}
+
+#define store_one(object, min, max)						\
+static ssize_t store_##object						\
+(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)	\
+{										\
+	struct devfreq *devfreq = to_devfreq(dev);				\
+	struct devfreq_mali_frame_data *data;					\
+	unsigned int input;							\
+	int ret = 0;								\
+	ret = sscanf(buf, "%u", &input);					\
+	if (ret != 1 || input > max || input < min)				\
+		return -EINVAL;							\
+	mutex_lock(&devfreq->lock);						\
+	data = devfreq->data;							\
+	data->object = input;							\
+	ret = update_devfreq(devfreq);						\
+	if (ret == 0)								\
+		ret = count;							\
+	mutex_unlock(&devfreq->lock);						\
+	return ret;								\
+}
+
+store_one(target_frame_us, DFMF_MIN_FRAME_US, DFMF_MAX_FRAME_US)
+store_one(headroom, DFMF_MIN_HEADROOM, DFMF_MAX_HEADROOM)
+store_one(upthreshold, DFMF_MIN_UPTHRESHOLD, DFMF_MAX_UPTHRESHOLD)
+store_one(boost_freq, 0, DFMF_MAX_BOOST_FREQ)
+
+/* raise the boost floor for the given ms, 0 ends a boost */
+static ssize_t store_boost_ms(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct devfreq *devfreq = to_devfreq(dev);
+	struct devfreq_mali_frame_data *data;
+	unsigned int input;
+	int ret;
+
+	ret = sscanf(buf, "%u", &input);
+	if (ret != 1 || input > DFMF_MAX_BOOST_MS)
+		return -EINVAL;
+	mutex_lock(&devfreq->lock);
+	data = devfreq->data;
+	data->boost_ms = input;
+	ACCESS_ONCE(data->boost_until) = jiffies + msecs_to_jiffies(input);
+	ret = update_devfreq(devfreq);
+	if (ret == 0)
+		ret = count;
+	mutex_unlock(&devfreq->lock);
+	return ret;
+}
+
+#define show_one(object)					\
+static ssize_t show_##object					\
+(struct device *dev, struct device_attribute *attr, char *buf)	\
+{								\
+	struct devfreq *devfreq = to_devfreq(dev);		\
+	struct devfreq_mali_frame_data *data;			\
+	int ret = 0;						\
+	mutex_lock(&devfreq->lock);				\
+	data = devfreq->data;					\
+	ret = snprintf(buf, DFMF_CONSANTS_DIGIT_MAX,		\
+				"%u\n", (unsigned int)data->object);		\
+	mutex_unlock(&devfreq->lock);				\
+	return ret;						\
+}
+
+show_one(target_frame_us)
+show_one(headroom)
+show_one(upthreshold)
+show_one(boost_freq)
+show_one(boost_ms)
+show_one(frame_mode)
+show_one(frames)
+
+static ssize_t show_frame_cycles(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	unsigned long flags;
+	u64 cycles;
+
+	spin_lock_irqsave(&dfmf.lock, flags);
+	cycles = dfmf.frame_cycles;
+	spin_unlock_irqrestore(&dfmf.lock, flags);
+
+	return snprintf(buf, PAGE_SIZE, "%llu\n", cycles);
+}
+
+#define MALI_FRAME_ATTR_RW(_name) \
+	static DEVICE_ATTR(_name, 0644, show_##_name, store_##_name)
+
+MALI_FRAME_ATTR_RW(target_frame_us);
+MALI_FRAME_ATTR_RW(headroom);
+MALI_FRAME_ATTR_RW(upthreshold);
+MALI_FRAME_ATTR_RW(boost_freq);
+MALI_FRAME_ATTR_RW(boost_ms);
+
+#define MALI_FRAME_ATTR_RO(_name) \
+	static DEVICE_ATTR(_name, 0444, show_##_name, NULL)
+
+MALI_FRAME_ATTR_RO(frame_mode);
+MALI_FRAME_ATTR_RO(frames);
+MALI_FRAME_ATTR_RO(frame_cycles);
+
+static struct attribute *dev_entries[] = {
+	&dev_attr_target_frame_us.attr,
+	&dev_attr_headroom.attr,
+	&dev_attr_upthreshold.attr,
+	&dev_attr_boost_freq.attr,
+	&dev_attr_boost_ms.attr,
+	&dev_attr_frame_mode.attr,
+	&dev_attr_frames.attr,
+	&dev_attr_frame_cycles.attr,
+	NULL,
+};
+
+static struct attribute_group dev_attr_group = {
+	.name	= "mali_frame",
+	.attrs	= dev_entries,
+};
+
+static int mali_frame_init(struct devfreq *devfreq)
+{
+	int err;
+
+	devfreq->data = &dfmf;
+
+	err = sysfs_create_group(&devfreq->dev.kobj, &dev_attr_group);
+	if (err) {
+		pr_err("%s: sysfs create err %d\n", __func__, err);
+		devfreq->data = NULL;
+	}
+	return err;
+}
+
+static void mali_frame_exit(struct devfreq *devfreq)
+{
+	sysfs_remove_group(&devfreq->dev.kobj, &dev_attr_group);
+	ACCESS_ONCE(dfmf.cur_khz) = 0;
+	devfreq->data = NULL;
+}
+
+static int devfreq_mali_frame_handler(struct devfreq *devfreq,
+				unsigned int event, void *data)
+{
+	int ret = 0;
+
+	switch (event) {
+	case DEVFREQ_GOV_START:
+		ret = mali_frame_init(devfreq);
+		if (!ret)
+			devfreq_monitor_start(devfreq);
+		break;
+
+	case DEVFREQ_GOV_STOP:
+		devfreq_monitor_stop(devfreq);
+		mali_frame_exit(devfreq);
+		break;
+
+	case DEVFREQ_GOV_INTERVAL:
+		devfreq_interval_update(devfreq, (unsigned int *)data);
+		break;
+
+	case DEVFREQ_GOV_SUSPEND:
+		devfreq_monitor_suspend(devfreq);
+		break;
+
+	case DEVFREQ_GOV_RESUME:
+		devfreq_monitor_resume(devfreq);
+		break;
+
+	default:
+		break;
+	}
+
+	return ret;
+}
+
+static struct devfreq_governor devfreq_mali_frame = {
+	.name = "mali_frame",
+	.get_target_freq = devfreq_mali_frame_func,
+	.event_handler = devfreq_mali_frame_handler,
+};
+
+static int __init devfreq_mali_frame_init(void)
+{
+	return devfreq_add_governor(&devfreq_mali_frame);
+}
+subsys_initcall(devfreq_mali_frame_init);
+MODULE_LICENSE("GPL");
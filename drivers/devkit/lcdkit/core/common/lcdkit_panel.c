@@ -38,6 +38,8 @@ void lcdkit_init(struct device_node* np, void* pdata)
 */
 void lcdkit_on_cmd(void* pdata, struct lcdkit_dsi_panel_cmds* cmds)
 {
+    /*the panel comes back with the full window*/
+    lcdkit_info.panel_infos.dirty_region_info.last_valid = false;
     lcdkit_dsi_tx(pdata, cmds);
 }
 
@@ -1060,10 +1062,110 @@ static ssize_t lcdkit_fps_updt_handle(void* pdata)
     return 0;
 }
 
+/*
+ *grow [*start, *start + *len) so the start is a multiple of start_align and
+ *the length a multiple of len_align and at least len_min, inside [0, limit).
+ *an align of 0 or 1 (or the unset -1 from dts) means no constraint.
+ */
+static void lcdkit_dirty_align(int32_t* start, int32_t* len, int start_align, int len_align, int len_min, int limit)
+{
+    int32_t end = *start + *len;
+
+    if (start_align > 1)
+    {
+        *start -= *start % start_align;
+    }
+
+    if (len_align > 1 && (end - *start) % len_align)
+    {
+        end += len_align - (end - *start) % len_align;
+    }
+
+    if (len_min > 0 && end - *start < len_min)
+    {
+        end = *start + len_min;
+    }
+
+    if (end > limit)
+    {
+        /*move the window back inside the panel, then grow it to the left
+         *until its start and length are aligned again*/
+        *start -= end - limit;
+        end = limit;
+
+        if (start_align > 1)
+        {
+            *start -= *start % start_align;
+        }
+
+        if (len_align > 1 && (end - *start) % len_align)
+        {
+            *start -= len_align - (end - *start) % len_align;
+        }
+
+        *start = max(*start, 0);
+    }
+
+    *len = end - *start;
+}
+
+/*
+ *function: turn the dirty rect of a frame into the window sent to the
+ *panel: clipped, aligned to the panel constraints, or the full frame when
+ *it covers more than full_threshold percent of the screen. The rect is
+ *updated in place so the caller sends the matching pixels.
+ *return: true if the window differs from the one the panel already has.
+*/
+static bool lcdkit_dirty_region_adjust(struct dirty_rect* rect)
+{
+    struct lcdkit_dirty_region_info* info = &lcdkit_info.panel_infos.dirty_region_info;
+    int xres = lcdkit_info.panel_infos.xres;
+    int yres = lcdkit_info.panel_infos.yres;
+    int32_t x1, y1;
+
+    x1 = min(rect->x + rect->w, xres);
+    y1 = min(rect->y + rect->h, yres);
+    rect->x = max(rect->x, 0);
+    rect->y = max(rect->y, 0);
+    rect->w = x1 - rect->x;
+    rect->h = y1 - rect->y;
+
+    if (rect->w > 0 && rect->h > 0)
+    {
+        lcdkit_dirty_align(&rect->x, &rect->w, info->left_align, info->width_align, info->w_min, xres);
+        lcdkit_dirty_align(&rect->y, &rect->h, info->top_align, info->height_align, info->h_min, yres);
+    }
+
+    if (rect->w <= 0 || rect->h <= 0 ||
+        (u64)rect->w * rect->h * 100 >= (u64)xres * yres * info->full_threshold)
+    {
+        rect->x = 0;
+        rect->y = 0;
+        rect->w = xres;
+        rect->h = yres;
+        info->full_cnt++;
+    }
+    else
+    {
+        info->partial_cnt++;
+    }
+
+    if (info->last_valid && !memcmp(&info->last, rect, sizeof(*rect)))
+    {
+        info->skip_cnt++;
+        return false;
+    }
+
+    info->last = *rect;
+    info->last_valid = true;
+    return true;
+}
+
 /*function: this function is used to set the Partial  display of LCD
   *input:
   *@pdata: this void point is used to converte to fb data struct.
-  *@dirty: the region of partial display need
+  *@dirty: the region of partial display need, adjusted in place to the
+  *        window actually set
 */
 static ssize_t lcdkit_set_display_region(void* pdata, void* dirty)
 {
@@ -1076,8 +1178,19 @@ static ssize_t lcdkit_set_display_region(void* pdata, void* dirty)
         return ret;
     }
 
+    if (!lcdkit_info.panel_infos.display_region_support || !lcdkit_is_cmd_panel())
+    {
+        return ret;
+    }
+
     dirty_region = (struct dirty_rect*) dirty;
 
+    /*same window as the last frame, nothing to send*/
+    if (!lcdkit_dirty_region_adjust(dirty_region))
+    {
+        return ret;
+    }
+
     lcdkit_dump_cmds(&lcdkit_info.panel_infos.display_region_cmds);
 
     lcdkit_info.panel_infos.display_region_cmds.cmds[0].payload[1] = (dirty_region->x >> 8) & 0xff;
@@ -1095,6 +1208,37 @@ static ssize_t lcdkit_set_display_region(void* pdata, void* dirty)
     return ret;
 }
 
+static ssize_t lcdkit_dirty_region_show(char* buf)
+{
+    struct lcdkit_dirty_region_info* info = &lcdkit_info.panel_infos.dirty_region_info;
+
+    return snprintf(buf, PAGE_SIZE, "support:%d threshold:%u partial:%u full:%u skip:%u last:%d,%d,%d,%d\n",
+                    lcdkit_info.panel_infos.display_region_support, info->full_threshold,
+                    info->partial_cnt, info->full_cnt, info->skip_cnt,
+                    info->last.x, info->last.y, info->last.w, info->last.h);
+}
+
+/*set the full update threshold in percent, 0 always sends the full frame*/
+static ssize_t lcdkit_dirty_region_store(const char* buf)
+{
+    ssize_t ret = 0;
+    unsigned long val = 0;
+    ret = strict_strtoul(buf, 0, &val);
+
+    if (ret)
+    {
+        return ret;
+    }
+
+    if (val > 100)
+    {
+        return -EINVAL;
+    }
+
+    lcdkit_info.panel_infos.dirty_region_info.full_threshold = (u32)val;
+    return ret;
+}
+
 static void lcdkit_vsp_enable(bool en)
 {
     LCDKIT_INFO("vsp enable(%d)\n", en);
@@ -1249,6 +1393,8 @@ struct lcdkit_panel_data lcdkit_info =
     .lcdkit_fps_scence_handle = lcdkit_fps_scence_handle,
     .lcdkit_fps_updt_handle = lcdkit_fps_updt_handle,
     .lcdkit_set_display_region = lcdkit_set_display_region,
+    .lcdkit_dirty_region_show = lcdkit_dirty_region_show,
+    .lcdkit_dirty_region_store = lcdkit_dirty_region_store,
     .lcdkit_current_detect = lcdkit_current_detect,
     .lcdkit_lv_detect = lcdkit_lv_detect,
     .lcdkit_ce_mode_show = lcdkit_ce_mode_show,
@@ -112,6 +112,62 @@ exit_free:
     return -ENOMEM;
 }
 
+static bool lcdkit_dtype_is_read(char dtype)
+{
+    switch (dtype)
+    {
+        case DTYPE_DCS_READ:
+        case DTYPE_GEN_READ:
+        case DTYPE_GEN_READ1:
+        case DTYPE_GEN_READ2:
+        case LCDKIT_DTYPE_MAX_PKTSIZE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*
+*name:lcdkit_pack_dcs_cmds
+*function:chain the commands of a list into as few dsi transfers as the
+*host takes, a command with last == 0 goes out together with the next one.
+*A chain ends at a command with a delay after it, around reads, and before
+*the host command fifo would overflow. It is worked out once here, the tx
+*path only follows the last flags.
+*@pcmds:parsed command list
+*/
+static void lcdkit_pack_dcs_cmds(struct lcdkit_dsi_panel_cmds* pcmds)
+{
+    u32 max_bytes = lcdkit_info.panel_infos.dsi_pack_max_bytes;
+    u32 bytes = 0;
+    int i = 0;
+    struct lcdkit_dsi_cmd_desc* cm = NULL;
+    struct lcdkit_dsi_cmd_desc* next = NULL;
+
+    pcmds->chain_cnt = 0;
+
+    for (i = 0; i < pcmds->cmd_cnt; i++)
+    {
+        cm = &pcmds->cmds[i];
+        next = (i + 1 < pcmds->cmd_cnt) ? &pcmds->cmds[i + 1] : NULL;
+        bytes += cm->dlen + LCDKIT_DSI_PKT_OVERHEAD;
+
+        if (next && !cm->wait && !lcdkit_dtype_is_read(cm->dtype) && !lcdkit_dtype_is_read(next->dtype)
+            && (bytes + next->dlen + LCDKIT_DSI_PKT_OVERHEAD <= max_bytes))
+        {
+            cm->last = 0;
+        }
+        else
+        {
+            cm->last = 1;
+            pcmds->chain_cnt++;
+            bytes = 0;
+        }
+    }
+
+    pcmds->flags |= LCDKIT_CMD_REQ_PACKED;
+}
+
 static int lcdkit_parse_dcs_cmds(struct device_node* np, char* cmd_key,
                                  char* link_key, struct lcdkit_dsi_panel_cmds* pcmds)
 {
@@ -209,6 +265,12 @@ static int lcdkit_parse_dcs_cmds(struct device_node* np, char* cmd_key,
         }
     }
 
+    if (lcdkit_info.panel_infos.dsi_pack_support)
+    {
+        lcdkit_pack_dcs_cmds(pcmds);
+        LCDKIT_INFO("%s: %d cmds in %d transfers\n", cmd_key, pcmds->cmd_cnt, pcmds->chain_cnt);
+    }
+
     return 0;
 
 exit_free:
@@ -241,6 +303,8 @@ void lcdkit_parse_panel_dts(struct device_node* np)
     OF_PROPERTY_READ_U8_DEFAULT(np, "hw,lcdkit-panel-esd-support", &lcdkit_info.panel_infos.esd_support, 0);
     OF_PROPERTY_READ_U8_DEFAULT(np, "hw,lcdkit-panel-check-reg-support", &lcdkit_info.panel_infos.check_reg_support, 0);
     OF_PROPERTY_READ_U8_DEFAULT(np, "hw,lcdkit-panel-display-region-support", &lcdkit_info.panel_infos.display_region_support, 0);
+    OF_PROPERTY_READ_U8_DEFAULT(np, "hw,lcdkit-dsi-pack-support", &lcdkit_info.panel_infos.dsi_pack_support, 0);
+    OF_PROPERTY_READ_U32_DEFAULT(np, "hw,lcdkit-dsi-pack-max-bytes", &lcdkit_info.panel_infos.dsi_pack_max_bytes, LCDKIT_DSI_PACK_MAX_BYTES_DEFAULT);
     OF_PROPERTY_READ_U8_DEFAULT(np, "hw,lcdkit-panel-checksum-support", &lcdkit_info.panel_infos.checksum_support, 0);
     OF_PROPERTY_READ_U8_DEFAULT(np, "hw,lcdkit-panel-dynamic-sram-check-support", &lcdkit_info.panel_infos.dynamic_sram_check_support, 0);
     OF_PROPERTY_READ_U8_DEFAULT(np, "hw,lcdkit-panel-mipi-detect-support", &lcdkit_info.panel_infos.mipi_detect_support, 0);
@@ -326,6 +390,22 @@ void lcdkit_parse_panel_dts(struct device_node* np)
         /*Parse Dirty Region cmds*/
         ret = lcdkit_parse_dcs_cmds(np, "hw,lcdkit-panel-display-region-command", "hw,lcdkit-panel-display-region-command-state",
                                     &lcdkit_info.panel_infos.display_region_cmds);
+
+        /*Parse Dirty Region constraints*/
+        lcdkit_info.panel_infos.dirty_region_info.left_align = -1;
+        lcdkit_info.panel_infos.dirty_region_info.width_align = -1;
+        lcdkit_info.panel_infos.dirty_region_info.top_align = -1;
+        lcdkit_info.panel_infos.dirty_region_info.height_align = -1;
+        lcdkit_info.panel_infos.dirty_region_info.w_min = -1;
+        lcdkit_info.panel_infos.dirty_region_info.h_min = -1;
+        OF_PROPERTY_READ_DIRTYREGION_INFO_RETURN(np, "hw,lcdkit-dirty-left-align", &lcdkit_info.panel_infos.dirty_region_info.left_align);
+        OF_PROPERTY_READ_DIRTYREGION_INFO_RETURN(np, "hw,lcdkit-dirty-width-align", &lcdkit_info.panel_infos.dirty_region_info.width_align);
+        OF_PROPERTY_READ_DIRTYREGION_INFO_RETURN(np, "hw,lcdkit-dirty-top-align", &lcdkit_info.panel_infos.dirty_region_info.top_align);
+        OF_PROPERTY_READ_DIRTYREGION_INFO_RETURN(np, "hw,lcdkit-dirty-height-align", &lcdkit_info.panel_infos.dirty_region_info.height_align);
+        OF_PROPERTY_READ_DIRTYREGION_INFO_RETURN(np, "hw,lcdkit-dirty-width-min", &lcdkit_info.panel_infos.dirty_region_info.w_min);
+        OF_PROPERTY_READ_DIRTYREGION_INFO_RETURN(np, "hw,lcdkit-dirty-height-min", &lcdkit_info.panel_infos.dirty_region_info.h_min);
+        OF_PROPERTY_READ_U32_DEFAULT(np, "hw,lcdkit-dirty-full-threshold", &lcdkit_info.panel_infos.dirty_region_info.full_threshold,
+                                     LCDKIT_DIRTY_FULL_THRESHOLD_DEFAULT);
     }
     else
     {
@@ -281,6 +281,7 @@ struct lcdkit_dsi_panel_cmds
     int cmd_cnt;
     int link_state;
     u32 flags;
+    int chain_cnt;/* transfers when LCDKIT_CMD_REQ_PACKED */
 };
 
 struct lcdkit_dsi_read_compare_data
@@ -321,6 +322,29 @@ struct dirty_rect
     int32_t h;
 };
 
+/* above this share of the screen a partial update isn't worth it */
+#define LCDKIT_DIRTY_FULL_THRESHOLD_DEFAULT    (70)
+
+struct lcdkit_dirty_region_info
+{
+    /* panel constraints from dts, -1 when there is none */
+    int left_align;
+    int width_align;
+    int top_align;
+    int height_align;
+    int w_min;
+    int h_min;
+    /* percent of the screen at which the full frame is sent instead */
+    u32 full_threshold;
+    /* window last sent to the panel */
+    struct dirty_rect last;
+    bool last_valid;
+    /* statistics */
+    u32 partial_cnt;
+    u32 full_cnt;
+    u32 skip_cnt;
+};
+
 struct porch_param
 {
     uint32_t    h_back_porch;
@@ -482,6 +506,11 @@ struct lcdkit_panel_infos
     /*display region*/
     struct lcdkit_dsi_panel_cmds display_region_cmds;
     u8 display_region_support;
+    struct lcdkit_dirty_region_info dirty_region_info;
+
+    /*dsi command packing*/
+    u8 dsi_pack_support;
+    u32 dsi_pack_max_bytes;
 
     /*checksum*/
     struct lcdkit_dsi_panel_cmds checksum_enter_cmds;
@@ -746,6 +775,8 @@ struct lcdkit_panel_data
 
     ssize_t (*lcdkit_check_esd)(void* pdata);
     ssize_t (*lcdkit_set_display_region)(void* pdata, void* dirty);
+    ssize_t (*lcdkit_dirty_region_show)(char* buf);
+    ssize_t (*lcdkit_dirty_region_store)(const char* buf);
     ssize_t (*lcdkit_fps_scence_handle)(struct platform_device* pdev, uint32_t scence);
     ssize_t (*lcdkit_fps_updt_handle)(void* pdata);
     ssize_t (*lcdkit_current_detect)(void* pdata);
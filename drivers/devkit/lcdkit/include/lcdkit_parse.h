@@ -10,6 +10,13 @@
 #define LCDKIT_CMD_REQ_NO_MAX_PKT_SIZE      0x0008
 #define LCDKIT_CMD_REQ_LP_MODE              0x0010
 #define LCDKIT_CMD_REQ_HS_MODE              0x0020
+/* cmds chained through their last field, one transfer per chain */
+#define LCDKIT_CMD_REQ_PACKED               0x0080
+
+/* default host command fifo size for packed transfers */
+#define LCDKIT_DSI_PACK_MAX_BYTES_DEFAULT   256
+/* packet header plus checksum of a long packet */
+#define LCDKIT_DSI_PKT_OVERHEAD             6
 
 enum lcdkit_ctrl_op_mode
 {
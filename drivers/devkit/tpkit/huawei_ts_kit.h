@@ -21,6 +21,8 @@
 #include <linux/platform_device.h>
 #include <huawei_platform/log/hw_log.h>
 #include <linux/wakelock.h>
+#include <linux/ktime.h>
+#include <linux/spinlock.h>
 #define HUAWEI_CHARGER_FB	/*define HUAWEI_CHARGER_FB here to enable charger notify callback*/
 #if defined(HUAWEI_CHARGER_FB)
 //#include <linux/hisi/usb/hisi_usb.h>
@@ -118,6 +120,7 @@
 
 #define I2C_WAIT_TIME 25 //25ms wait period
 #define I2C_RW_TRIES 3 //retry 3 times
+#define TS_BUS_BATCH_MAX 4 //max register reads in one bus_read_batch
 #define I2C_DEFAULT_ADDR 0x70
 #define TS_SUSPEND_LEVEL 1
 #define TS_MAX_REG_VALUE_NUM 80
@@ -831,6 +834,32 @@ struct anti_false_touch_param{
 	/* if x > drv_stop_width, and then the same finger x < drv_stop_width, report it */
 	int edge_status;
 };
+/* touch latency stages, each from the end of the previous one */
+enum ts_latency_stage
+{
+    TS_LAT_READ = 0,    /* irq to bus read done */
+    TS_LAT_ALGO,        /* bus read to algo done */
+    TS_LAT_REPORT,      /* algo to input_sync */
+    TS_LAT_TOTAL,       /* irq to input_sync */
+    TS_LAT_STAGE_NUM,
+};
+
+/* bucket n counts latencies below 2^n us, the last one all the rest */
+#define TS_LAT_BUCKETS 16
+
+struct ts_latency_info
+{
+    spinlock_t lock;
+    /* the event in flight, the irq stays masked until it is reported */
+    ktime_t irq_time;
+    ktime_t read_time;
+    ktime_t algo_time;
+    u32 hist[TS_LAT_STAGE_NUM][TS_LAT_BUCKETS];
+    u32 max_us[TS_LAT_STAGE_NUM];
+    u64 sum_us[TS_LAT_STAGE_NUM];
+    u32 count[TS_LAT_STAGE_NUM];
+};
+
 struct ts_kit_device_data
 {
 	bool is_parade_solution;
@@ -917,6 +946,16 @@ struct ts_kit_device_data
 	bool isbootupdate_finish;
 	bool is_can_device_use_int;
 	struct mutex device_call_lock;
+	struct ts_latency_info latency;
+};
+
+/* one register read of a bus_read_batch, same arguments as bus_read */
+struct ts_bus_xfer
+{
+    u8* reg_addr;
+    u16 reg_len;
+    u8* buf;
+    u16 len;
 };
 
 struct ts_bus_info
@@ -925,6 +964,8 @@ struct ts_bus_info
     int bus_id;
     int (*bus_write) (u8* buf, u16 length);
     int (*bus_read) (u8* reg_addr, u16 reg_len, u8* buf, u16 len);
+    /* issues up to TS_BUS_BATCH_MAX reads as a single bus transaction */
+    int (*bus_read_batch) (struct ts_bus_xfer* xfers, int count);
 };
 
 
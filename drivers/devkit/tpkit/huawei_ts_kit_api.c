@@ -24,6 +24,8 @@
 #include <linux/sched/rt.h>
 #include <linux/fb.h>
 #include <linux/workqueue.h>
+#include <linux/cpufreq.h>
+#include <linux/pm_qos.h>
 #include <huawei_ts_kit.h>
 #include <huawei_ts_kit_api.h>
 #if defined (CONFIG_HUAWEI_DSM)
@@ -33,6 +35,163 @@ extern struct dsm_client *ts_dclient;
 extern struct ts_kit_platform_data g_ts_kit_platform_data;
 atomic_t g_ts_kit_data_report_over = ATOMIC_INIT(1);
 
+/*
+ * On touch down the cpus are pulsed to hispeed and the ddr gets a
+ * PM_QOS_MEMORY_THROUGHPUT vote for ts_boost_ms, so the first frame after
+ * the touch doesn't wait for the governors or the PowerHAL to notice.
+ */
+#define TS_BOOST_DEFAULT_MS		100
+/* the band hisi_freq_ctl votes for a fully busy boot device */
+#define TS_BOOST_DEFAULT_DDR_BAND	7682
+
+static unsigned int ts_boost_ms = TS_BOOST_DEFAULT_MS;
+static unsigned int ts_boost_ddr_band = TS_BOOST_DEFAULT_DDR_BAND;
+static struct pm_qos_request ts_boost_ddr_req;
+static DEFINE_MUTEX(ts_boost_lock);
+static unsigned long ts_boosts;
+static unsigned long ts_boosts_cpu_raised;
+static unsigned long ts_boosts_ddr;
+
+static void ts_touch_boost(void)
+{
+    unsigned int duration_us;
+
+    mutex_lock(&ts_boost_lock);
+    if (!ts_boost_ms)
+    { goto out; }
+
+    duration_us = ts_boost_ms * USEC_PER_MSEC;
+    ts_boosts++;
+    if (cpufreq_interactive_input_boost(duration_us) > 0)
+    { ts_boosts_cpu_raised++; }
+
+    if (ts_boost_ddr_band)
+    {
+        if (!pm_qos_request_active(&ts_boost_ddr_req))
+        { pm_qos_add_request(&ts_boost_ddr_req, PM_QOS_MEMORY_THROUGHPUT, PM_QOS_DEFAULT_VALUE); }
+        pm_qos_update_request_timeout(&ts_boost_ddr_req, ts_boost_ddr_band, duration_us);
+        ts_boosts_ddr++;
+    }
+out:
+    mutex_unlock(&ts_boost_lock);
+}
+
+ssize_t ts_touch_boost_show(char* buf)
+{
+    ssize_t len;
+
+    mutex_lock(&ts_boost_lock);
+    len = snprintf(buf, PAGE_SIZE, "duration_ms:%u ddr_band:%u boosts:%lu cpu_raised:%lu ddr_votes:%lu\n",
+                   ts_boost_ms, ts_boost_ddr_band, ts_boosts, ts_boosts_cpu_raised, ts_boosts_ddr);
+    mutex_unlock(&ts_boost_lock);
+
+    return len;
+}
+
+/* a duration of 0 turns the boost off, a band of 0 leaves the ddr alone */
+int ts_touch_boost_set(unsigned int duration_ms, unsigned int ddr_band)
+{
+    if (duration_ms > MSEC_PER_SEC)
+    { return -EINVAL; }
+
+    mutex_lock(&ts_boost_lock);
+    ts_boost_ms = duration_ms;
+    ts_boost_ddr_band = ddr_band;
+    if ((!duration_ms || !ddr_band) && pm_qos_request_active(&ts_boost_ddr_req))
+    { pm_qos_update_request(&ts_boost_ddr_req, PM_QOS_DEFAULT_VALUE); }
+    mutex_unlock(&ts_boost_lock);
+
+    return NO_ERR;
+}
+
+static const char* ts_latency_stage_name[TS_LAT_STAGE_NUM] =
+{
+    "read", "algo", "report", "total",
+};
+
+static void ts_latency_add(struct ts_latency_info* lat, int stage, ktime_t start, ktime_t end)
+{
+    s64 us;
+    int bucket = 0;
+
+    if (!start.tv64 || !end.tv64)
+    { return; }
+
+    us = ktime_us_delta(end, start);
+    if (us < 0)
+    { return; }
+    if (us > 0)
+    { bucket = min(fls64(us), TS_LAT_BUCKETS - 1); }
+
+    lat->hist[stage][bucket]++;
+    lat->sum_us[stage] += us;
+    lat->count[stage]++;
+    if (us > lat->max_us[stage])
+    { lat->max_us[stage] = (u32)min_t(s64, us, U32_MAX); }
+}
+
+/* called after input_sync of a touch report, closes the event begun at the irq */
+static void ts_latency_record(struct ts_kit_device_data* dev)
+{
+    struct ts_latency_info* lat = &dev->latency;
+    ktime_t now = ktime_get();
+    unsigned long flags;
+
+    if (!lat->irq_time.tv64)
+    { return; }
+
+    spin_lock_irqsave(&lat->lock, flags);
+    ts_latency_add(lat, TS_LAT_READ, lat->irq_time, lat->read_time);
+    ts_latency_add(lat, TS_LAT_ALGO, lat->read_time, lat->algo_time);
+    ts_latency_add(lat, TS_LAT_REPORT, lat->algo_time.tv64 ? lat->algo_time : lat->read_time, now);
+    ts_latency_add(lat, TS_LAT_TOTAL, lat->irq_time, now);
+    lat->irq_time.tv64 = 0;
+    lat->read_time.tv64 = 0;
+    lat->algo_time.tv64 = 0;
+    spin_unlock_irqrestore(&lat->lock, flags);
+}
+
+void ts_latency_reset(struct ts_kit_device_data* dev)
+{
+    struct ts_latency_info* lat = &dev->latency;
+    unsigned long flags;
+
+    spin_lock_irqsave(&lat->lock, flags);
+    memset(lat->hist, 0, sizeof(lat->hist));
+    memset(lat->max_us, 0, sizeof(lat->max_us));
+    memset(lat->sum_us, 0, sizeof(lat->sum_us));
+    memset(lat->count, 0, sizeof(lat->count));
+    spin_unlock_irqrestore(&lat->lock, flags);
+}
+
+/*
+ * One line per stage: name, count, mean and max in us, then the histogram
+ * buckets <1us <2us <4us ... <16ms and >=16ms.
+ */
+ssize_t ts_latency_show(struct ts_kit_device_data* dev, char* buf)
+{
+    struct ts_latency_info* lat = &dev->latency;
+    unsigned long flags;
+    ssize_t len;
+    int stage, bucket;
+
+    spin_lock_irqsave(&lat->lock, flags);
+    len = scnprintf(buf, PAGE_SIZE, "chip:%s module:%s\n", dev->chip_name, dev->module_name);
+    for (stage = 0; stage < TS_LAT_STAGE_NUM; stage++)
+    {
+        len += scnprintf(buf + len, PAGE_SIZE - len, "%s %u %llu %u",
+                         ts_latency_stage_name[stage], lat->count[stage],
+                         lat->count[stage] ? div_u64(lat->sum_us[stage], lat->count[stage]) : 0,
+                         lat->max_us[stage]);
+        for (bucket = 0; bucket < TS_LAT_BUCKETS; bucket++)
+        { len += scnprintf(buf + len, PAGE_SIZE - len, " %u", lat->hist[stage][bucket]); }
+        len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+    }
+    spin_unlock_irqrestore(&lat->lock, flags);
+
+    return len;
+}
+
 void ts_proc_bottom_half(struct ts_cmd_node* in_cmd, struct ts_cmd_node* out_cmd)
 {
     struct ts_kit_device_data* dev = g_ts_kit_platform_data.chip_data;
@@ -43,6 +202,7 @@ void ts_proc_bottom_half(struct ts_cmd_node* in_cmd, struct ts_cmd_node* out_cmd
     //related event need process, use out cmd to notify
     if (dev->ops->chip_irq_bottom_half)
     { dev->ops->chip_irq_bottom_half(in_cmd, out_cmd); }
+    dev->latency.read_time = ktime_get();
 }
 
 void ts_algo_calibrate(struct ts_cmd_node* in_cmd, struct ts_cmd_node* out_cmd)
@@ -82,6 +242,7 @@ void ts_algo_calibrate(struct ts_cmd_node* in_cmd, struct ts_cmd_node* out_cmd)
 out:
     memcpy(&out_cmd->cmd_param.pub_params.report_info, in_finger, sizeof(struct ts_fingers));
     out_cmd->command = TS_REPORT_INPUT;
+    g_ts_kit_platform_data.chip_data->latency.algo_time = ktime_get();
     return;
 }
 
@@ -183,6 +344,7 @@ void ts_report_input(struct ts_cmd_node* in_cmd, struct ts_cmd_node* out_cmd)
     struct ts_fingers* finger = &in_cmd->cmd_param.pub_params.report_info;
     struct input_dev* input_dev = g_ts_kit_platform_data.input_dev;
     struct anti_false_touch_param *local_param = NULL;
+    static int last_finger_num;
     int finger_num = 0;
     int id;
 
@@ -267,6 +429,11 @@ void ts_report_input(struct ts_cmd_node* in_cmd, struct ts_cmd_node* out_cmd)
 
     input_report_key(input_dev, BTN_TOUCH, finger_num);
     input_sync(input_dev);
+    ts_latency_record(g_ts_kit_platform_data.chip_data);
+
+    if (finger_num && !last_finger_num && (TS_WORK == atomic_read(&g_ts_kit_platform_data.state)))
+    { ts_touch_boost(); }
+    last_finger_num = finger_num;
 
     ts_film_touchplus(finger, finger_num, input_dev);
     if (((g_ts_kit_platform_data.chip_data->easy_wakeup_info.sleep_mode == TS_GESTURE_MODE) ||
@@ -29,6 +29,10 @@ extern struct dsm_client *ts_dclient;
 void ts_proc_bottom_half(struct ts_cmd_node* in_cmd, struct ts_cmd_node* out_cmd);
 void ts_algo_calibrate(struct ts_cmd_node* in_cmd, struct ts_cmd_node* out_cmd);
 void ts_report_input(struct ts_cmd_node* in_cmd, struct ts_cmd_node* out_cmd);
+void ts_latency_reset(struct ts_kit_device_data* dev);
+ssize_t ts_latency_show(struct ts_kit_device_data* dev, char* buf);
+ssize_t ts_touch_boost_show(char* buf);
+int ts_touch_boost_set(unsigned int duration_ms, unsigned int ddr_band);
 int ts_power_control(int irq_id, struct ts_cmd_node* in_cmd, struct ts_cmd_node* out_cmd);
 int ts_fw_update_boot(struct ts_cmd_node* in_cmd, struct ts_cmd_node* out_cmd);
 int ts_fw_update_sd(struct ts_cmd_node* in_cmd, struct ts_cmd_node* out_cmd);
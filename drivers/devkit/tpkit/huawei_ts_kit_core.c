@@ -70,6 +70,12 @@ u8 g_ts_kit_log_cfg = 0;
 
 static struct ts_cmd_node ping_cmd_buff;
 static struct ts_cmd_node pang_cmd_buff;
+/* touch reports handled in the irq thread, see ts_irq_thread() */
+static struct ts_cmd_node irq_ping_cmd_buff;
+static struct ts_cmd_node irq_pang_cmd_buff;
+static DEFINE_MUTEX(ts_cmd_proc_lock);
+static bool ts_irq_fast_path = true;
+module_param_named(irq_fast_path, ts_irq_fast_path, bool, S_IRUGO | S_IWUSR);
 static struct work_struct tp_init_work;
 static int ts_gpio_num = 0;
 struct mutex  ts_kit_easy_wake_guesure_lock;
@@ -676,6 +682,8 @@ int ts_i2c_write(u8* buf, u16 length);
 int ts_spi_write(u8* buf, u16 length);
 int ts_i2c_read(u8* reg_addr, u16 reg_len, u8* buf, u16 len);
 int ts_spi_read(u8* reg_addr, u16 reg_len, u8* buf, u16 len);
+int ts_i2c_read_batch(struct ts_bus_xfer* xfers, int count);
+int ts_spi_read_batch(struct ts_bus_xfer* xfers, int count);
 
 
 
@@ -684,6 +692,7 @@ static struct ts_bus_info ts_bus_i2c_info =
     .btype      = TS_BUS_I2C,
     .bus_write  = ts_i2c_write,
     .bus_read   = ts_i2c_read,
+    .bus_read_batch = ts_i2c_read_batch,
 };
 
 static struct ts_bus_info ts_bus_spi_info =
@@ -691,6 +700,7 @@ static struct ts_bus_info ts_bus_spi_info =
     .btype      = TS_BUS_SPI,
     .bus_write  = ts_spi_write,
     .bus_read   = ts_spi_read,
+    .bus_read_batch = ts_spi_read_batch,
 };
 int ts_i2c_write(u8* buf, u16 length)
 {
@@ -831,12 +841,90 @@ int ts_spi_read(u8* reg_addr, u16 reg_len, u8* buf, u16 len)
 {
     return NO_ERR;
 }
+
+/*
+ * Chains several register reads into one i2c_transfer(), so the adapter
+ * is locked, set up and waited for once instead of once per read. If the
+ * combined transfer fails the reads are redone one by one through
+ * ts_i2c_read(), which keeps its retries and dsm reporting.
+ */
+int ts_i2c_read_batch(struct ts_bus_xfer* xfers, int count)
+{
+    struct i2c_msg msgs[TS_BUS_BATCH_MAX * 2];
+    u16 addr = g_ts_kit_platform_data.client->addr;
+    int one_byte = g_ts_kit_platform_data.chip_data->is_i2c_one_byte;
+    int msg_len = 0;
+    int ret;
+    int i;
+
+    if (count <= 0 || count > TS_BUS_BATCH_MAX)
+    {
+        TS_LOG_ERR("%s: invalid count %d\n", __func__, count);
+        return -EINVAL;
+    }
+#if defined (CONFIG_TEE_TUI)
+	if (g_ts_kit_platform_data.chip_data->report_tui_enable) {
+		return NO_ERR;
+	}
+#endif
+
+    for (i = 0; i < count; i++)
+    {
+        if (!one_byte && xfers[i].reg_len > 0)
+        {
+            msgs[msg_len].addr = addr;
+            msgs[msg_len].flags = 0;
+            msgs[msg_len].len = xfers[i].reg_len;
+            msgs[msg_len].buf = xfers[i].reg_addr;
+            msg_len++;
+        }
+        msgs[msg_len].addr = addr;
+        msgs[msg_len].flags = I2C_M_RD;
+        msgs[msg_len].len = xfers[i].len;
+        msgs[msg_len].buf = xfers[i].buf;
+        msg_len++;
+    }
+
+    ret = i2c_transfer(g_ts_kit_platform_data.client->adapter, msgs, msg_len);
+    if (ret == msg_len)
+    {
+        return NO_ERR;
+    }
+
+    TS_LOG_DEBUG("%s: batch of %d failed (%d), reading one by one\n", __func__, count, ret);
+    for (i = 0; i < count; i++)
+    {
+        ret = ts_i2c_read(xfers[i].reg_addr, xfers[i].reg_len, xfers[i].buf, xfers[i].len);
+        if (ret)
+        {
+            return ret;
+        }
+    }
+    return NO_ERR;
+}
+
+int ts_spi_read_batch(struct ts_bus_xfer* xfers, int count)
+{
+    int ret;
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        ret = ts_spi_read(xfers[i].reg_addr, xfers[i].reg_len, xfers[i].buf, xfers[i].len);
+        if (ret)
+        {
+            return ret;
+        }
+    }
+    return NO_ERR;
+}
 static irqreturn_t ts_irq_handler(int irq, void* dev_id)
 {
     int error = NO_ERR;
     struct ts_cmd_node cmd;
 
     wake_lock_timeout(&g_ts_kit_platform_data.ts_wake_lock, HZ);
+    g_ts_kit_platform_data.chip_data->latency.irq_time = ktime_get();
 
     if (g_ts_kit_platform_data.chip_data->ops->chip_irq_top_half)
     { error = g_ts_kit_platform_data.chip_data->ops->chip_irq_top_half(&cmd); }
@@ -846,6 +934,13 @@ static irqreturn_t ts_irq_handler(int irq, void* dev_id)
     else
     { cmd.command = TS_INT_PROCESS; }
 
+    /* touch data is read and reported by ts_irq_thread, the line stays masked until then */
+    if (!error && ts_irq_fast_path && !g_ts_kit_platform_data.chip_data->is_direct_proc_cmd)
+    {
+        irq_ping_cmd_buff = cmd;
+        return IRQ_WAKE_THREAD;
+    }
+
     disable_irq_nosync(g_ts_kit_platform_data.irq_id);
 
     if (ts_kit_put_one_cmd(&cmd, NO_SYNC_TIMEOUT) && (TS_UNINIT != atomic_read(&g_ts_kit_platform_data.state)))
@@ -853,6 +948,61 @@ static irqreturn_t ts_irq_handler(int irq, void* dev_id)
 
     return IRQ_HANDLED;
 }
+
+/*
+ * Reads the touch data and reports it right in the irq thread instead of
+ * handing TS_INT_PROCESS to ts_thread, so that a touch doesn't wait behind
+ * queued commands. If ts_thread is busy with a command, the interrupt goes
+ * through the queue as before: its commands disable_irq(), which waits for
+ * this thread, so it can't wait for them here.
+ */
+static irqreturn_t ts_irq_thread(int irq, void* dev_id)
+{
+    struct ts_cmd_node* proc_cmd = &irq_ping_cmd_buff;
+    struct ts_cmd_node* out_cmd = &irq_pang_cmd_buff;
+
+    if (!mutex_trylock(&ts_cmd_proc_lock))
+    {
+        disable_irq_nosync(g_ts_kit_platform_data.irq_id);
+        if (ts_kit_put_one_cmd(proc_cmd, NO_SYNC_TIMEOUT) && (TS_UNINIT != atomic_read(&g_ts_kit_platform_data.state)))
+        { enable_irq(g_ts_kit_platform_data.irq_id); }
+        return IRQ_HANDLED;
+    }
+
+    if (!ts_cmd_need_process(proc_cmd))
+    {
+        /* as in the queued path, the irq stays off until resume */
+        disable_irq_nosync(g_ts_kit_platform_data.irq_id);
+        goto out;
+    }
+
+    out_cmd->command = TS_INVAILD_CMD;
+    ts_proc_bottom_half(proc_cmd, out_cmd);
+
+    while (out_cmd->command != TS_INVAILD_CMD)
+    {
+        swap(proc_cmd, out_cmd);//ping - pang
+        out_cmd->command = TS_INVAILD_CMD;
+
+        switch (proc_cmd->command)
+        {
+            case TS_INPUT_ALGO:
+                ts_algo_calibrate(proc_cmd, out_cmd);
+                break;
+            case TS_REPORT_INPUT:
+                ts_report_input(proc_cmd, out_cmd);
+                break;
+            default:
+                TS_LOG_DEBUG("related command :%d queued\n", proc_cmd->command);
+                ts_kit_put_one_cmd(proc_cmd, NO_SYNC_TIMEOUT);
+                break;
+        }
+    }
+
+out:
+    mutex_unlock(&ts_cmd_proc_lock);
+    return IRQ_HANDLED;
+}
 #if defined (CONFIG_TEE_TUI)
 void ts_kit_tui_secos_init(void)
 {
@@ -2104,7 +2254,8 @@ static int ts_kit_irq_init(void)
 
     atomic_set(&g_ts_kit_platform_data.state, TS_WORK);//avoid 1st irq unable to handler
 
-    error = request_irq(g_ts_kit_platform_data.irq_id, ts_irq_handler, irq_flags | IRQF_NO_SUSPEND, "ts", &g_ts_kit_platform_data);
+    error = request_threaded_irq(g_ts_kit_platform_data.irq_id, ts_irq_handler, ts_irq_thread,
+                                 irq_flags | IRQF_ONESHOT | IRQF_NO_SUSPEND, "ts", &g_ts_kit_platform_data);
     if (error)
     {
         TS_LOG_ERR("ts request_irq failed\n");
@@ -2936,7 +3087,9 @@ static int ts_thread(void* p)
     {
         while (!get_one_cmd(&ping_cmd_buff)) //get one command
         {
+            mutex_lock(&ts_cmd_proc_lock);
             ts_proc_command(&ping_cmd_buff);
+            mutex_unlock(&ts_cmd_proc_lock);
             memset(&ping_cmd_buff, 0, sizeof(struct ts_cmd_node));
             memset(&pang_cmd_buff, 0, sizeof(struct ts_cmd_node));
         }
@@ -2967,6 +3120,7 @@ int  huawei_ts_chip_register(struct ts_kit_device_data* chipdata)
     {
         if (chipdata->ops->chip_detect)
         {
+            spin_lock_init(&chipdata->latency.lock);
             g_ts_kit_platform_data.chip_data = chipdata;
             error = chipdata->ops->chip_detect(&g_ts_kit_platform_data);
             TS_LOG_INFO(" huawei_ts_chip_register error=%d\n", error);
@@ -2297,6 +2297,43 @@ out:
 	return count;
 }
 
+static ssize_t ts_touch_latency_show(struct device* dev, struct device_attribute* attr, char* buf)
+{
+    if (!g_ts_kit_platform_data.chip_data)
+    { return -ENODEV; }
+
+    return ts_latency_show(g_ts_kit_platform_data.chip_data, buf);
+}
+
+/* any write clears the histograms */
+static ssize_t ts_touch_latency_store(struct device* dev, struct device_attribute* attr, const char* buf, size_t count)
+{
+    if (!g_ts_kit_platform_data.chip_data)
+    { return -ENODEV; }
+
+    ts_latency_reset(g_ts_kit_platform_data.chip_data);
+    return count;
+}
+
+static ssize_t ts_touch_boost_attr_show(struct device* dev, struct device_attribute* attr, char* buf)
+{
+    return ts_touch_boost_show(buf);
+}
+
+/* "<duration_ms> <ddr_band>" */
+static ssize_t ts_touch_boost_attr_store(struct device* dev, struct device_attribute* attr, const char* buf, size_t count)
+{
+    unsigned int duration_ms = 0;
+    unsigned int ddr_band = 0;
+    int error;
+
+    if (sscanf(buf, "%u %u", &duration_ms, &ddr_band) < 1)
+    { return -EINVAL; }
+
+    error = ts_touch_boost_set(duration_ms, ddr_band);
+    return error ? error : count;
+}
+
 static DEVICE_ATTR(touch_chip_info, (S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH), ts_chip_info_show, ts_chip_info_store);
 static DEVICE_ATTR(calibrate, S_IRUSR, ts_calibrate_show, NULL);
 static DEVICE_ATTR(calibrate_wakeup_gesture, S_IRUSR, ts_calibrate_wakeup_gesture_show, NULL);
@@ -2318,6 +2355,8 @@ static DEVICE_ATTR(tp_capacitance_test_type, (S_IRUSR | S_IWUSR), ts_capacitance
 static DEVICE_ATTR(touch_rawdata_debug, S_IRUSR | S_IRGRP | S_IWUSR | S_IWGRP, ts_rawdata_debug_test_show, ts_rawdata_debug_test_store);
 static DEVICE_ATTR(touch_special_hardware_test, S_IRUSR | S_IRGRP | S_IWUSR | S_IWGRP, touch_special_hardware_test_show, touch_special_hardware_test_store);
 static DEVICE_ATTR(anti_false_touch_param, S_IRUSR | S_IRGRP | S_IWUSR | S_IWGRP, ts_anti_false_touch_param_show, ts_anti_false_touch_param_store);
+static DEVICE_ATTR(touch_boost, (S_IRUSR | S_IWUSR | S_IRGRP), ts_touch_boost_attr_show, ts_touch_boost_attr_store);
+static DEVICE_ATTR(touch_latency, (S_IRUSR | S_IWUSR | S_IRGRP), ts_touch_latency_show, ts_touch_latency_store);
 static DEVICE_ATTR(touch_wideth, S_IRUSR | S_IRGRP | S_IWUSR | S_IWGRP, ts_touch_wideth_show, ts_touch_wideth_store);
 static DEVICE_ATTR(roi_enable, (S_IRUSR | S_IRGRP | S_IWUSR | S_IWGRP),  ts_roi_enable_show, ts_roi_enable_store);
 static DEVICE_ATTR(roi_data, (S_IRUSR | S_IRGRP), ts_roi_data_show, NULL);
@@ -2361,6 +2400,8 @@ static struct attribute* ts_attributes[] =
     &dev_attr_touch_special_hardware_test.attr,
     &dev_attr_anti_false_touch_param.attr,
     &dev_attr_touch_wideth.attr,
+    &dev_attr_touch_latency.attr,
+    &dev_attr_touch_boost.attr,
 #if defined (CONFIG_TEE_TUI)
 	&dev_attr_touch_tui_enable.attr,
 #endif
@@ -28,6 +28,7 @@
 #define ADDR_POINT_NUM			(2 - TOUCH_DATA_START_ADDR)
 #define ADDR_XY_POS			(7 - TOUCH_DATA_START_ADDR)
 #define ADDR_MISC			(8 - TOUCH_DATA_START_ADDR)
+#define FTS_ROI_PACKAGE_NUM_ADDR	0x9c
 #define FTS_TOUCH_DATA_LEN		\
 	(3 - TOUCH_DATA_START_ADDR + FTS_POINT_DATA_SIZE * FTS_MAX_TOUCH_POINTS)
 
@@ -200,6 +201,32 @@ int focal_read(u8 *addrs, u16 addr_size, u8 *values, u16 values_size)
 	return ret;
 }
 
+/* falls back to separate reads on buses without bus_read_batch */
+int focal_read_batch(struct ts_bus_xfer *xfers, int count)
+{
+	int i = 0;
+	int ret = 0;
+	struct ts_bus_info *bops = NULL;
+
+	bops = g_focal_dev_data->ts_platform_data->bops;
+
+	if (bops->bus_read_batch) {
+		ret = bops->bus_read_batch(xfers, count);
+		if (ret)
+			TS_LOG_ERR("%s:fail, ret=%d\n", __func__, ret);
+		return ret;
+	}
+
+	for (i = 0; i < count; i++) {
+		ret = focal_read(xfers[i].reg_addr, xfers[i].reg_len,
+			xfers[i].buf, xfers[i].len);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
 int focal_read_default(u8 *values, u16 values_size)
 {
 	return focal_read(NULL, 0, values, values_size);
@@ -417,16 +444,39 @@ int focal_strtolow(char *src_str, size_t size)
 	return 0;
 }
 
-static int focal_read_touch_data(struct ts_event *event_data)
+/*
+ * roi_package_num, when not NULL, is read in the same bus transaction
+ * as the touch data. If that transaction fails the touch data is read
+ * again on its own and roi_package_num is left at 0, so a bad ROI read
+ * never costs a touch report.
+ */
+static int focal_read_touch_data(struct ts_event *event_data,
+	u8 *roi_package_num)
 {
 	int i = 0;
 	int ret = -1;
 	u32 offset = 0;
+	u8 touch_cmd = TOUCH_DATA_START_ADDR;
+	u8 roi_cmd = FTS_ROI_PACKAGE_NUM_ADDR;
+	struct ts_bus_xfer xfers[2];
 
 	u8 buf[FTS_TOUCH_DATA_LEN] = { 0 };
 
-	buf[0] = TOUCH_DATA_START_ADDR;
-	ret = focal_read(buf, 1, buf, FTS_TOUCH_DATA_LEN);
+	xfers[0].reg_addr = &touch_cmd;
+	xfers[0].reg_len = 1;
+	xfers[0].buf = buf;
+	xfers[0].len = FTS_TOUCH_DATA_LEN;
+	xfers[1].reg_addr = &roi_cmd;
+	xfers[1].reg_len = 1;
+	xfers[1].buf = roi_package_num;
+	xfers[1].len = 1;
+	ret = focal_read_batch(xfers, roi_package_num ? 2 : 1);
+	if (ret < 0 && roi_package_num) {
+		TS_LOG_INFO("%s:batched read failed, ret=%d, touchdata only\n",
+			__func__, ret);
+		*roi_package_num = 0;
+		ret = focal_read(&touch_cmd, 1, buf, FTS_TOUCH_DATA_LEN);
+	}
 	if (ret < 0) {
 		TS_LOG_ERR("%s:read touchdata failed, ret=%d.\n",
 			__func__, ret);
@@ -663,7 +713,8 @@ static int focal_irq_bottom_half(struct ts_cmd_node *in_cmd,
 	int i = 0;
 	int ret = 0;
 	int touch_count = 0;
-	int roi_package_num= 0; 
+	u8 roi_package_num = 0;
+	u8 *roi_num = NULL;
 	struct ts_event st_touch_data;
 	struct algo_param *algo_p = NULL;
 	struct ts_fingers *info = NULL;
@@ -675,7 +726,11 @@ static int focal_irq_bottom_half(struct ts_cmd_node *in_cmd,
 	algo_p->algo_order = g_focal_dev_data->algo_id;
 	TS_LOG_DEBUG("%s:algo_order:%d\n", __func__, algo_p->algo_order);
 
-	ret = focal_read_touch_data(&st_touch_data);
+#ifdef ROI
+	if (g_focal_dev_data->ts_platform_data->feature_info.roi_info.roi_switch)
+		roi_num = &roi_package_num;
+#endif
+	ret = focal_read_touch_data(&st_touch_data, roi_num);
 	if (ret)
 		return ret;
 
@@ -700,9 +755,6 @@ static int focal_irq_bottom_half(struct ts_cmd_node *in_cmd,
 			 st_touch_data.finger_id[i], x, y, wx, wy);
 	}
 #ifdef ROI
-	if(g_focal_dev_data->ts_platform_data->feature_info.roi_info.roi_switch){
-		focal_read_reg(0x9c, &roi_package_num);
-	}
 	if(roi_package_num > 0){
 		//focal_roi_data[ROI_DATA_READ_LENGTH] = roi_package_num;
 		focal_read_roidata();
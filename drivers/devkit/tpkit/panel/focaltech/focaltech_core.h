@@ -101,6 +101,7 @@ struct focal_platform_data {
 int focal_read(u8 *addr, u16 addr_len, u8 *value, u16 values_size);
 int focal_read_reg(u8 addr, u8 *val);
 int focal_read_default(u8 *values, u16 values_size);
+int focal_read_batch(struct ts_bus_xfer *xfers, int count);
 int focal_write(u8 *value, u16 values_size);
 int focal_write_reg(u8 addr, u8 val);
 int focal_write_default(u8 value);
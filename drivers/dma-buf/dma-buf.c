@@ -430,6 +430,7 @@ struct dma_buf_attachment *dma_buf_attach(struct dma_buf *dmabuf,
 
 	attach->dev = dev;
 	attach->dmabuf = dmabuf;
+	attach->cache_sgt = dmabuf->ops->cache_sgt_mapping;
 
 	mutex_lock(&dmabuf->lock);
 
@@ -464,6 +465,9 @@ void dma_buf_detach(struct dma_buf *dmabuf, struct dma_buf_attachment *attach)
 
 	mutex_lock(&dmabuf->lock);
 	list_del(&attach->node);
+	WARN_ON(attach->sgt_users);
+	if (attach->sgt)
+		dmabuf->ops->unmap_dma_buf(attach, attach->sgt, attach->dir);
 	if (dmabuf->ops->detach)
 		dmabuf->ops->detach(dmabuf, attach);
 
@@ -472,6 +476,45 @@ void dma_buf_detach(struct dma_buf *dmabuf, struct dma_buf_attachment *attach)
 }
 EXPORT_SYMBOL_GPL(dma_buf_detach);
 
+/*
+ * A cached mapping is reused as long as it is valid and mapped for the
+ * same direction; one for another direction is replaced once unused.
+ */
+static struct sg_table *
+dma_buf_map_attachment_cached(struct dma_buf_attachment *attach,
+			      enum dma_data_direction direction)
+{
+	struct dma_buf *dmabuf = attach->dmabuf;
+	struct sg_table *sg_table;
+
+	mutex_lock(&dmabuf->lock);
+	if (attach->sgt && !attach->sgt_stale && attach->dir == direction) {
+		attach->sgt_users++;
+		mutex_unlock(&dmabuf->lock);
+		return attach->sgt;
+	}
+
+	if (attach->sgt && !attach->sgt_users) {
+		dmabuf->ops->unmap_dma_buf(attach, attach->sgt, attach->dir);
+		attach->sgt = NULL;
+		attach->sgt_stale = false;
+	}
+
+	sg_table = dmabuf->ops->map_dma_buf(attach, direction);
+	if (!sg_table)
+		sg_table = ERR_PTR(-ENOMEM);
+
+	/* the old one is still in use, leave the new one uncached */
+	if (!IS_ERR(sg_table) && !attach->sgt) {
+		attach->sgt = sg_table;
+		attach->dir = direction;
+		attach->sgt_users = 1;
+	}
+	mutex_unlock(&dmabuf->lock);
+
+	return sg_table;
+}
+
 /**
  * dma_buf_map_attachment - Returns the scatterlist table of the attachment;
  * mapped into _device_ address space. Is a wrapper for map_dma_buf() of the
@@ -492,6 +535,9 @@ struct sg_table *dma_buf_map_attachment(struct dma_buf_attachment *attach,
 	if (WARN_ON(!attach || !attach->dmabuf))
 		return ERR_PTR(-EINVAL);
 
+	if (attach->cache_sgt)
+		return dma_buf_map_attachment_cached(attach, direction);
+
 	sg_table = attach->dmabuf->ops->map_dma_buf(attach, direction);
 	if (!sg_table)
 		sg_table = ERR_PTR(-ENOMEM);
@@ -518,11 +564,65 @@ void dma_buf_unmap_attachment(struct dma_buf_attachment *attach,
 	if (WARN_ON(!attach || !attach->dmabuf || !sg_table))
 		return;
 
+	if (attach->cache_sgt) {
+		struct dma_buf *dmabuf = attach->dmabuf;
+
+		mutex_lock(&dmabuf->lock);
+		if (sg_table == attach->sgt) {
+			/* only handed out for attach->dir, leave it be */
+			if (WARN_ON(direction != attach->dir)) {
+				mutex_unlock(&dmabuf->lock);
+				return;
+			}
+			WARN_ON(!attach->sgt_users);
+			/* keep it mapped for the next user, unless stale */
+			if (--attach->sgt_users || !attach->sgt_stale) {
+				mutex_unlock(&dmabuf->lock);
+				return;
+			}
+			attach->sgt = NULL;
+			attach->sgt_stale = false;
+			direction = attach->dir;
+		}
+		mutex_unlock(&dmabuf->lock);
+	}
+
 	attach->dmabuf->ops->unmap_dma_buf(attach, sg_table,
 						direction);
 }
 EXPORT_SYMBOL_GPL(dma_buf_unmap_attachment);
 
+/**
+ * dma_buf_invalidate_mappings - drop the cached mappings of a buffer
+ * @dmabuf:	[in]	buffer whose backing storage moved or changed.
+ *
+ * For exporters caching mappings, when a mapping built before can no
+ * longer be handed out. Unused ones are unmapped right away, the others
+ * once their last user unmaps them; the next map builds a new one.
+ */
+void dma_buf_invalidate_mappings(struct dma_buf *dmabuf)
+{
+	struct dma_buf_attachment *attach;
+
+	if (WARN_ON(!dmabuf))
+		return;
+
+	mutex_lock(&dmabuf->lock);
+	list_for_each_entry(attach, &dmabuf->attachments, node) {
+		if (!attach->sgt)
+			continue;
+
+		if (attach->sgt_users) {
+			attach->sgt_stale = true;
+			continue;
+		}
+		dmabuf->ops->unmap_dma_buf(attach, attach->sgt, attach->dir);
+		attach->sgt = NULL;
+	}
+	mutex_unlock(&dmabuf->lock);
+}
+EXPORT_SYMBOL_GPL(dma_buf_invalidate_mappings);
+
 
 /**
  * dma_buf_begin_cpu_access - Must be called before accessing a dma_buf from the
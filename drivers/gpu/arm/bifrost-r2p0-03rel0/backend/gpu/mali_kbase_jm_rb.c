@@ -1322,6 +1322,11 @@ void kbase_gpu_complete_hw(struct kbase_device *kbdev, int js,
 	if (katom->event_code != BASE_JD_EVENT_JOB_CANCELLED)
 		katom->event_code = (base_jd_event_code)completion_code;
 
+	/* The busy time is complete, the atom was dequeued above */
+	if (completion_code == BASE_JD_EVENT_DONE &&
+			(katom->core_req & BASE_JD_REQ_FS))
+		kbase_pm_metrics_frame_done(kbdev);
+
 	kbase_device_trace_register_access(kctx, REG_WRITE,
 						JOB_CONTROL_REG(JOB_IRQ_CLEAR),
 						1 << js);
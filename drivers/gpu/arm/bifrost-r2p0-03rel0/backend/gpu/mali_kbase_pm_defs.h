@@ -75,6 +75,8 @@ enum kbase_pm_core_type {
  *           Updated when metrics are reset.
  *  @prev_idle: idle time in ns of previous time period
  *           Updated when metrics are reset.
+ *  @frame_busy: number of ns the GPU was busy since the last fragment job
+ *           completed, handed to the frame governor as the frame's cost.
  *  @gpu_active: true when the GPU is executing jobs. false when
  *           not. Updated when the job scheduler informs us a job in submitted
  *           or removed from a GPU slot.
@@ -103,6 +105,7 @@ struct kbasep_pm_metrics_data {
 	u32 time_idle;
 	u32 prev_busy;
 	u32 prev_idle;
+	u64 frame_busy;
 	bool gpu_active;
 	u32 busy_cl[2];
 	u32 busy_gl;
@@ -336,6 +336,16 @@ void kbasep_pm_metrics_term(struct kbase_device *kbdev);
  */
 void kbase_pm_report_vsync(struct kbase_device *kbdev, int buffer_updated);
 
+/**
+ * kbase_pm_metrics_frame_done - Report the GPU busy time of a frame
+ *
+ * Called when a fragment job completed. Hands the time the GPU was busy since
+ * the previous call to the frame aware devfreq governor.
+ *
+ * @kbdev: The kbase device structure for the device (must be a valid pointer)
+ */
+void kbase_pm_metrics_frame_done(struct kbase_device *kbdev);
+
 /**
  * kbase_pm_get_dvfs_action - Determine whether the DVFS system should change
  *                            the clock speed of the GPU.
@@ -25,6 +25,7 @@
 #include <mali_kbase_pm.h>
 #include <backend/gpu/mali_kbase_pm_internal.h>
 #include <backend/gpu/mali_kbase_jm_rb.h>
+#include <linux/hisi/hisi_devfreq.h>
 
 /*lint -e750 -esym(750,*)*/
 /* When VSync is being hit aim for utilisation between 70-90% */
@@ -82,6 +83,7 @@ int kbasep_pm_metrics_init(struct kbase_device *kbdev)
 	kbdev->pm.backend.metrics.time_idle = 0;
 	kbdev->pm.backend.metrics.prev_busy = 0;
 	kbdev->pm.backend.metrics.prev_idle = 0;
+	kbdev->pm.backend.metrics.frame_busy = 0;
 	kbdev->pm.backend.metrics.gpu_active = false;
 	kbdev->pm.backend.metrics.active_cl_ctx[0] = 0;
 	kbdev->pm.backend.metrics.active_cl_ctx[1] = 0;
@@ -150,6 +152,7 @@ static void kbase_pm_get_dvfs_utilisation_calc(struct kbase_device *kbdev,
 		u32 ns_time = (u32) (ktime_to_ns(diff) >> KBASE_PM_TIME_SHIFT);
 
 		kbdev->pm.backend.metrics.time_busy += ns_time;
+		kbdev->pm.backend.metrics.frame_busy += ktime_to_ns(diff);
 		if (kbdev->pm.backend.metrics.active_cl_ctx[0])
 			kbdev->pm.backend.metrics.busy_cl[0] += ns_time;
 		if (kbdev->pm.backend.metrics.active_cl_ctx[1])
@@ -390,6 +393,19 @@ static void kbase_pm_metrics_active_calc(struct kbase_device *kbdev)
 	}
 }
 
+void kbase_pm_metrics_frame_done(struct kbase_device *kbdev)
+{
+	unsigned long flags;
+	u64 busy;
+
+	spin_lock_irqsave(&kbdev->pm.backend.metrics.lock, flags);
+	busy = kbdev->pm.backend.metrics.frame_busy;
+	kbdev->pm.backend.metrics.frame_busy = 0;
+	spin_unlock_irqrestore(&kbdev->pm.backend.metrics.lock, flags);
+
+	mali_frame_report(busy);
+}
+
 /* called when job is submitted to or removed from a GPU slot */
 void kbase_pm_metrics_update(struct kbase_device *kbdev, ktime_t *timestamp)
 {
@@ -467,7 +467,11 @@ static int kbase_platform_init(struct kbase_device *kbdev)
 		dev_set_name(dev, "gpufreq");
 		kbdev->devfreq = devfreq_add_device(dev,
 						&mali_kbase_devfreq_profile,
+#ifdef CONFIG_DEVFREQ_GOV_MALI_FRAME
+						"mali_frame",
+#else
 						"mali_ondemand",
+#endif
 						NULL);
 	}
 
@@ -118,6 +118,18 @@ void kbase_job_hw_submit(struct kbase_device *kbdev,
 	 * handler (up to the KBASE_JS_IRQ_THROTTLE_TIME_US). */
 	katom->start_timestamp = ktime_get();
 
+	/* Queueing latency, resubmissions after a soft-stop are not counted */
+	if (ktime_to_ns(katom->queue_timestamp)) {
+		struct kbase_ctx_slot_stats *stats = &kctx->slot_stats[js];
+		u64 wait = ktime_to_ns(ktime_sub(katom->start_timestamp,
+						 katom->queue_timestamp));
+
+		stats->queue_ns += wait;
+		if (wait > stats->queue_ns_max)
+			stats->queue_ns_max = wait;
+		katom->queue_timestamp = ktime_set(0, 0);
+	}
+
 	/* GO ! */
 	dev_dbg(kbdev->dev, "JS: Submitting atom %p from ctx %p to js[%d] with head=0x%llx, affinity=0x%llx",
 				katom, kctx, js, jc_head, katom->affinity);
@@ -912,6 +912,21 @@ bool kbase_gpu_irq_evict(struct kbase_device *kbdev, int js)
 	return false;
 }
 
+/* Charge the time @katom spent on slot @js to its context */
+static void kbase_gpu_account_slot_time(struct kbase_jd_atom *katom, int js,
+					u32 completion_code,
+					ktime_t *end_timestamp)
+{
+	struct kbase_ctx_slot_stats *stats = &katom->kctx->slot_stats[js];
+	ktime_t end = end_timestamp ? *end_timestamp : ktime_get();
+	s64 busy = ktime_to_ns(ktime_sub(end, katom->start_timestamp));
+
+	if (busy > 0)
+		stats->busy_ns += busy;
+	if (completion_code != BASE_JD_EVENT_STOPPED)
+		stats->jobs++;
+}
+
 void kbase_gpu_complete_hw(struct kbase_device *kbdev, int js,
 				u32 completion_code,
 				u64 job_tail,
@@ -945,6 +960,8 @@ void kbase_gpu_complete_hw(struct kbase_device *kbdev, int js,
 
 	katom = kbase_gpu_dequeue_atom(kbdev, js, end_timestamp);
 
+	kbase_gpu_account_slot_time(katom, js, completion_code, end_timestamp);
+
 	kbase_timeline_job_slot_done(kbdev, katom->kctx, katom, js, 0);
 
 	if (completion_code == BASE_JD_EVENT_STOPPED) {
@@ -27,36 +27,31 @@
 #include <backend/gpu/mali_kbase_device_internal.h>
 
 static inline u64 lock_region(struct kbase_device *kbdev, u64 pfn,
-		u32 num_pages)
+		u64 num_pages)
 {
 	u64 region;
 
 	/* can't lock a zero sized range */
 	KBASE_DEBUG_ASSERT(num_pages);
 
-	region = pfn << PAGE_SHIFT;
-	/*
-	 * fls returns (given the ASSERT above):
-	 * 1 .. 32
-	 *
-	 * 10 + fls(num_pages)
-	 * results in the range (11 .. 42)
-	 */
-
 	/* gracefully handle num_pages being zero */
 	if (0 == num_pages) {
-		region |= 11;
+		region = (pfn << PAGE_SHIFT) | 11;
 	} else {
+		u64 end = pfn + num_pages - 1;
 		u8 region_width;
 
-		region_width = 10 + fls(num_pages);
-		if (num_pages != (1ul << (region_width - 11))) {
-			/* not pow2, so must go up to the next pow2 */
-			region_width += 1;
-		}
-		KBASE_DEBUG_ASSERT(region_width <= KBASE_LOCK_REGION_MAX_SIZE);
-		KBASE_DEBUG_ASSERT(region_width >= KBASE_LOCK_REGION_MIN_SIZE);
-		region |= region_width;
+		/*
+		 * The MMU aligns the locked region down to its size, so it
+		 * has to be the smallest aligned pow2 block that holds both
+		 * ends, not just one as large as the range: a range merged
+		 * from several updates is rarely aligned.
+		 */
+		region_width = 11 + fls64(pfn ^ end);
+		region_width = clamp_t(u8, region_width,
+				KBASE_LOCK_REGION_MIN_SIZE,
+				KBASE_LOCK_REGION_MAX_SIZE);
+		region = (pfn << PAGE_SHIFT) | region_width;
 	}
 
 	return region;
@@ -229,7 +224,7 @@ void kbase_mmu_hw_configure(struct kbase_device *kbdev, struct kbase_as *as,
 }
 
 int kbase_mmu_hw_do_operation(struct kbase_device *kbdev, struct kbase_as *as,
-		struct kbase_context *kctx, u64 vpfn, u32 nr, u32 op,
+		struct kbase_context *kctx, u64 vpfn, u64 nr, u32 op,
 		unsigned int handling_irq)
 {
 	int ret;
@@ -1298,6 +1298,7 @@ static int kbase_open(struct inode *inode, struct file *filp)
 	mutex_init(&kctx->mem_profile_lock);
 
 	kbasep_jd_debugfs_ctx_add(kctx);
+	kbasep_ctx_stats_debugfs_ctx_add(kctx);
 	kbase_debug_mem_view_init(filp);
 
 	kbase_debug_job_fault_context_init(kctx);
@@ -3216,6 +3217,7 @@ static int kbase_device_debugfs_init(struct kbase_device *kbdev)
 
 	kbase_debug_job_fault_debugfs_init(kbdev);
 	kbasep_gpu_memory_debugfs_init(kbdev);
+	kbasep_ctx_stats_debugfs_init(kbdev);
 #if KBASE_GPU_RESET_EN
 	debugfs_create_file("quirks_sc", 0644,
 			kbdev->mali_debugfs_directory, kbdev,
@@ -0,0 +1,149 @@
+/*
+ *
+ * (C) COPYRIGHT 2014-2015 ARM Limited. All rights reserved.
+ *
+ * This program is free software and is provided to you under the terms of the
+ * GNU General Public License version 2 as published by the Free Software
+ * Foundation, and any use by you of this program is subject to the terms
+ * of such GNU licence.
+ *
+ * A copy of the licence is included with the program, and can also be obtained
+ * from Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ */
+
+
+
+#include <linux/seq_file.h>
+
+#include <mali_kbase.h>
+
+#include <mali_kbase_ctx_stats_debugfs.h>
+
+#ifdef CONFIG_DEBUG_FS
+
+/**
+ * kbasep_ctx_stats_get() - Copy the slot statistics of a context
+ * @kctx:  The context
+ * @stats: Filled with BASE_JM_MAX_NR_SLOTS entries
+ */
+static void kbasep_ctx_stats_get(struct kbase_context *kctx,
+		struct kbase_ctx_slot_stats *stats)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&kctx->kbdev->js_data.runpool_irq.lock, flags);
+	memcpy(stats, kctx->slot_stats, sizeof(kctx->slot_stats));
+	spin_unlock_irqrestore(&kctx->kbdev->js_data.runpool_irq.lock, flags);
+}
+
+/**
+ * kbasep_ctx_stats_show - Show callback for the per context gpu_stats file
+ * @sfile: The debugfs entry
+ * @data:  Data associated with the entry
+ *
+ * One line per job slot: completed jobs, ns spent on the slot, total and
+ * longest ns spent waiting to be submitted.
+ *
+ * Return: 0
+ */
+static int kbasep_ctx_stats_show(struct seq_file *sfile, void *data)
+{
+	struct kbase_context *kctx = sfile->private;
+	struct kbase_ctx_slot_stats stats[BASE_JM_MAX_NR_SLOTS];
+	int js;
+
+	KBASE_DEBUG_ASSERT(kctx != NULL);
+
+	kbasep_ctx_stats_get(kctx, stats);
+
+	seq_puts(sfile, "slot,jobs,busy ns,queue ns,queue max ns\n");
+	for (js = 0; js < BASE_JM_MAX_NR_SLOTS; js++)
+		seq_printf(sfile, "%d,%llu,%llu,%llu,%llu\n", js,
+				stats[js].jobs, stats[js].busy_ns,
+				stats[js].queue_ns, stats[js].queue_ns_max);
+
+	return 0;
+}
+
+static int kbasep_ctx_stats_open(struct inode *in, struct file *file)
+{
+	return single_open(file, kbasep_ctx_stats_show, in->i_private);
+}
+
+static const struct file_operations kbasep_ctx_stats_fops = {
+	.open = kbasep_ctx_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void kbasep_ctx_stats_debugfs_ctx_add(struct kbase_context *kctx)
+{
+	KBASE_DEBUG_ASSERT(kctx != NULL);
+
+	debugfs_create_file("gpu_stats", S_IRUGO, kctx->kctx_dentry, kctx,
+			&kbasep_ctx_stats_fops);
+}
+
+/**
+ * kbasep_ctx_stats_all_show - Show callback for the device ctx_gpu_stats file
+ * @sfile: The debugfs entry
+ * @data:  Data associated with the entry
+ *
+ * One line per open context with its totals over all slots, for the
+ * thermal and scheduling daemons to attribute GPU load to processes.
+ *
+ * Return: 0
+ */
+static int kbasep_ctx_stats_all_show(struct seq_file *sfile, void *data)
+{
+	struct kbase_device *kbdev = sfile->private;
+	struct kbasep_kctx_list_element *element;
+	struct kbase_ctx_slot_stats stats[BASE_JM_MAX_NR_SLOTS];
+
+	seq_puts(sfile, "tgid,ctx id,jobs,busy ns,queue ns,queue max ns\n");
+
+	mutex_lock(&kbdev->kctx_list_lock);
+	list_for_each_entry(element, &kbdev->kctx_list, link) {
+		u64 jobs = 0, busy = 0, queue = 0, queue_max = 0;
+		int js;
+
+		kbasep_ctx_stats_get(element->kctx, stats);
+		for (js = 0; js < BASE_JM_MAX_NR_SLOTS; js++) {
+			jobs += stats[js].jobs;
+			busy += stats[js].busy_ns;
+			queue += stats[js].queue_ns;
+			queue_max = max(queue_max, stats[js].queue_ns_max);
+		}
+
+		seq_printf(sfile, "%d,%d,%llu,%llu,%llu,%llu\n",
+				element->kctx->tgid, element->kctx->id,
+				jobs, busy, queue, queue_max);
+	}
+	mutex_unlock(&kbdev->kctx_list_lock);
+
+	return 0;
+}
+
+static int kbasep_ctx_stats_all_open(struct inode *in, struct file *file)
+{
+	return single_open(file, kbasep_ctx_stats_all_show, in->i_private);
+}
+
+static const struct file_operations kbasep_ctx_stats_all_fops = {
+	.open = kbasep_ctx_stats_all_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void kbasep_ctx_stats_debugfs_init(struct kbase_device *kbdev)
+{
+	debugfs_create_file("ctx_gpu_stats", S_IRUGO,
+			kbdev->mali_debugfs_directory, kbdev,
+			&kbasep_ctx_stats_all_fops);
+}
+
+#endif /* CONFIG_DEBUG_FS */
@@ -0,0 +1,45 @@
+/*
+ *
+ * (C) COPYRIGHT 2014-2015 ARM Limited. All rights reserved.
+ *
+ * This program is free software and is provided to you under the terms of the
+ * GNU General Public License version 2 as published by the Free Software
+ * Foundation, and any use by you of this program is subject to the terms
+ * of such GNU licence.
+ *
+ * A copy of the licence is included with the program, and can also be obtained
+ * from Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ */
+
+
+
+/**
+ * @file mali_kbase_ctx_stats_debugfs.h
+ * Header file for the per context GPU usage entries in debugfs
+ */
+
+#ifndef _KBASE_CTX_STATS_DEBUGFS_H
+#define _KBASE_CTX_STATS_DEBUGFS_H
+
+#include <linux/debugfs.h>
+
+#include <mali_kbase.h>
+
+/**
+ * kbasep_ctx_stats_debugfs_ctx_add() - Add the gpu_stats file of a context
+ *
+ * @kctx: Pointer to kbase_context
+ */
+void kbasep_ctx_stats_debugfs_ctx_add(struct kbase_context *kctx);
+
+/**
+ * kbasep_ctx_stats_debugfs_init() - Add the ctx_gpu_stats file listing the
+ *                                   GPU usage of every context of a device
+ *
+ * @kbdev: Pointer to kbase_device
+ */
+void kbasep_ctx_stats_debugfs_init(struct kbase_device *kbdev);
+
+#endif  /*_KBASE_CTX_STATS_DEBUGFS_H*/
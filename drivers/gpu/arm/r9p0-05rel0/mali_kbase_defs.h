@@ -325,6 +325,8 @@ struct kbase_jd_atom {
 	struct work_struct work;
 	ktime_t start_timestamp;
 	u64 time_spent_us; /**< Total time spent on the GPU in microseconds */
+	/** Time the atom became runnable, cleared once handed to the GPU */
+	ktime_t queue_timestamp;
 
 	struct base_jd_udata udata;
 	struct kbase_context *kctx;
@@ -1109,6 +1111,24 @@ struct jsctx_rb {
 					 (((minor) & 0xFFF) << 8) | \
 					 ((0 & 0xFF) << 0))
 
+/**
+ * struct kbase_ctx_slot_stats - GPU usage of a context on one job slot
+ * @jobs:         atoms completed, soft-stopped ones are counted when they
+ *                finally complete
+ * @busy_ns:      time atoms spent on the slot, from submission to the
+ *                completion interrupt
+ * @queue_ns:     time atoms waited from becoming runnable to submission
+ * @queue_ns_max: longest of these waits
+ *
+ * Protected by js_data.runpool_irq.lock.
+ */
+struct kbase_ctx_slot_stats {
+	u64 jobs;
+	u64 busy_ns;
+	u64 queue_ns;
+	u64 queue_ns_max;
+};
+
 struct kbase_context {
 	struct file *filp;
 	struct kbase_device *kbdev;
@@ -1131,6 +1151,11 @@ struct kbase_context {
 	struct page *aliasing_sink_page;
 
 	struct mutex            reg_lock; /* To be converted to a rwlock? */
+	/* GPU VA range whose MMU flush is batched or deferred, under
+	 * reg_lock, empty when mmu_flush_nr is 0 */
+	u64                     mmu_flush_vpfn;
+	u64                     mmu_flush_nr;
+	int                     mmu_flush_batch;
 	struct rb_root          reg_rbtree; /* Red-Black tree of GPU regions (live regions) */
 
 	unsigned long    cookies;
@@ -1234,6 +1259,9 @@ struct kbase_context {
 
 	/* true if context is counted in kbdev->js_data.nr_contexts_runnable */
 	bool ctx_runnable_ref;
+
+	/* Per slot GPU usage, see kbase_ctx_slot_stats */
+	struct kbase_ctx_slot_stats slot_stats[BASE_JM_MAX_NR_SLOTS];
 #if BASE_DEBUG_FENCE_TIMEOUT
 	struct hrtimer fence_wait_timer;
 	int timer_started;
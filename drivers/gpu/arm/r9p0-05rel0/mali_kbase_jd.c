@@ -1338,6 +1338,9 @@ int kbase_jd_submit(struct kbase_context *kctx,
 
 	KBASE_TIMELINE_ATOMS_IN_FLIGHT(kctx, atomic_add_return(submit_data->nr_atoms, &kctx->timeline.jd_atoms_in_flight));
 
+	/* The GPU must not see page tables older than these atoms */
+	kbase_mmu_flush_deferred(kctx);
+
 	/* All atoms submitted in this call have the same flush ID */
 	latest_flush = kbase_backend_get_current_flush_id(kbdev);
 
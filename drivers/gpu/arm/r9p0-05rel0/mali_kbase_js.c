@@ -2426,6 +2426,7 @@ int kbase_js_dep_resolved_submit(struct kbase_context *kctx,
 	}
 
 	katom->atom_flags |= KBASE_KATOM_FLAG_JSCTX_RB_SUBMITTED;
+	katom->queue_timestamp = ktime_get();
 
 	return 0;
 }
@@ -727,11 +727,14 @@ bad_insert:
 
 		stride = reg->gpu_alloc->imported.alias.stride;
 		KBASE_DEBUG_ASSERT(reg->gpu_alloc->imported.alias.aliased);
+		/* the aliased allocs outlive this, flush them all at once */
+		kbase_mmu_flush_batch_begin(kctx);
 		while (i--)
 			if (reg->gpu_alloc->imported.alias.aliased[i].alloc) {
 				kbase_mmu_teardown_pages(kctx, reg->start_pfn + (i * stride), reg->gpu_alloc->imported.alias.aliased[i].length);
 				kbase_mem_phy_alloc_gpu_unmapped(reg->gpu_alloc->imported.alias.aliased[i].alloc);
 			}
+		kbase_mmu_flush_batch_end(kctx);
 	}
 
 	kbase_remove_va_region(kctx, reg);
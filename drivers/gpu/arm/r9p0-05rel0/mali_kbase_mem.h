@@ -607,6 +607,26 @@ int kbase_mmu_insert_single_page(struct kbase_context *kctx, u64 vpfn,
 int kbase_mmu_teardown_pages(struct kbase_context *kctx, u64 vpfn, size_t nr);
 int kbase_mmu_update_pages(struct kbase_context *kctx, u64 vpfn, phys_addr_t *phys, size_t nr, unsigned long flags);
 
+/**
+ * kbase_mmu_flush_batch_begin - start a batch of page table updates
+ * @kctx: Context the updates are made to, its reg_lock must be held
+ *
+ * Teardowns and updates made until kbase_mmu_flush_batch_end() only
+ * record the range they touched, which is then flushed from the GPU
+ * with a single MMU operation. Batches nest.
+ */
+void kbase_mmu_flush_batch_begin(struct kbase_context *kctx);
+void kbase_mmu_flush_batch_end(struct kbase_context *kctx);
+
+/**
+ * kbase_mmu_flush_deferred - issue the MMU flush deferred on @kctx
+ * @kctx: Context about to submit jobs, its reg_lock must not be held
+ *
+ * With CONFIG_MALI_MMU_DEFERRED_FLUSH the flush for an update made while
+ * the context has no job running is left until it submits jobs again.
+ */
+void kbase_mmu_flush_deferred(struct kbase_context *kctx);
+
 /**
  * @brief Register region and map it on the GPU.
  *
@@ -23,6 +23,7 @@
 #include <linux/shrinker.h>
 #include <linux/atomic.h>
 #include <linux/version.h>
+#include <linux/ion.h>
 
 /* This function is only provided for backwards compatibility with kernels
  * which use the old carveout allocator.
@@ -178,6 +179,15 @@ static struct page *kbase_mem_pool_alloc_page(struct kbase_mem_pool *pool)
 	gfp_t gfp;
 	struct device *dev = pool->kbdev->dev;
 	dma_addr_t dma_addr;
+	bool zeroed = false;
+
+	/* Idle pages of ion and kbase share one pool, see release_page() */
+	p = ion_shared_page_get(&zeroed);
+	if (p) {
+		if (!zeroed)
+			clear_highpage(p);
+		goto map;
+	}
 
 #if defined(CONFIG_ARM) && !defined(CONFIG_HAVE_DMA_ATTRS) && \
 	LINUX_VERSION_CODE < KERNEL_VERSION(3, 5, 0)
@@ -197,6 +207,7 @@ static struct page *kbase_mem_pool_alloc_page(struct kbase_mem_pool *pool)
 	if (!p)
 		return NULL;
 
+map:
 	dma_addr = dma_map_page(dev, p, 0, PAGE_SIZE, DMA_BIDIRECTIONAL);
 	if (dma_mapping_error(dev, dma_addr)) {
 		__free_page(p);
@@ -225,6 +236,43 @@ static void kbase_mem_pool_free_page(struct kbase_mem_pool *pool,
 	pool_dbg(pool, "freed page to kernel\n");
 }
 
+#ifdef CONFIG_ION_SHARED_PAGE_POOL
+/*
+ * Release a page none of the kbase pools has room for. Rather than
+ * freeing it, zero it and park it in the ion system heap pool, where
+ * ion and the next kbase_mem_pool_alloc_page() can both take it and the
+ * ion shrinker reclaims it. May sleep, never call with a pool lock held;
+ * the kbase shrinker keeps using kbase_mem_pool_free_page() as moving
+ * pages to ion would not free anything.
+ */
+static void kbase_mem_pool_release_page(struct kbase_mem_pool *pool,
+		struct page *p)
+{
+	struct device *dev = pool->kbdev->dev;
+	dma_addr_t dma_addr = kbase_dma_addr(p);
+
+	/* Unmapping invalidates the cache, zero the page after it */
+	dma_unmap_page(dev, dma_addr, PAGE_SIZE, DMA_BIDIRECTIONAL);
+	kbase_clear_dma_addr(p);
+	clear_highpage(p);
+
+	if (ion_shared_page_put(p, true)) {
+		pool_dbg(pool, "released page to ion\n");
+		return;
+	}
+
+	__free_page(p);
+
+	pool_dbg(pool, "freed page to kernel\n");
+}
+#else
+static void kbase_mem_pool_release_page(struct kbase_mem_pool *pool,
+		struct page *p)
+{
+	kbase_mem_pool_free_page(pool, p);
+}
+#endif
+
 static size_t kbase_mem_pool_shrink_locked(struct kbase_mem_pool *pool,
 		size_t nr_to_shrink)
 {
@@ -458,7 +506,7 @@ void kbase_mem_pool_free(struct kbase_mem_pool *pool, struct page *p,
 		kbase_mem_pool_spill(next_pool, p);
 	} else {
 		/* Free page */
-		kbase_mem_pool_free_page(pool, p);
+		kbase_mem_pool_release_page(pool, p);
 	}
 }
 
@@ -582,7 +630,7 @@ void kbase_mem_pool_free_pages(struct kbase_mem_pool *pool, size_t nr_pages,
 			continue;
 
 		p = phys_to_page(pages[i]);
-		kbase_mem_pool_free_page(pool, p);
+		kbase_mem_pool_release_page(pool, p);
 		pages[i] = 0;
 	}
 
@@ -802,24 +802,65 @@ int kbase_mmu_insert_pages_with_scramble_bit(struct kbase_context *kctx, u64 vpf
 
 KBASE_EXPORT_TEST_API(kbase_mmu_insert_pages_with_scramble_bit)
 
-/**
- * This function is responsible for validating the MMU PTs
- * triggering reguired flushes.
+static void kbase_mmu_flush_hw(struct kbase_context *kctx, u64 vpfn, u64 nr)
+{
+	struct kbase_device *kbdev = kctx->kbdev;
+	int ret;
+	u32 op;
+
+	if (kbase_pm_context_active_handle_suspend(kbdev,
+			KBASE_PM_SUSPEND_HANDLER_DONT_REACTIVATE))
+		return;
+
+	/* AS transaction begin */
+	mutex_lock(&kbdev->as[kctx->as_nr].transaction_mutex);
+
+	if (kbase_hw_has_issue(kbdev, BASE_HW_ISSUE_6367))
+		op = AS_COMMAND_FLUSH;
+	else
+		op = AS_COMMAND_FLUSH_MEM;
+
+	ret = kbase_mmu_hw_do_operation(kbdev, &kbdev->as[kctx->as_nr],
+			kctx, vpfn, nr, op, 0);
+#if KBASE_GPU_RESET_EN
+	if (ret) {
+		/* Flush failed to complete, assume the GPU has hung and
+		 * perform a reset to recover */
+		dev_err(kbdev->dev, "Flush for GPU page table update did not complete. Issueing GPU soft-reset to recover\n");
+		if (kbase_prepare_to_reset_gpu(kbdev))
+			kbase_reset_gpu(kbdev);
+	}
+#endif /* KBASE_GPU_RESET_EN */
+
+	mutex_unlock(&kbdev->as[kctx->as_nr].transaction_mutex);
+	/* AS transaction end */
+
+	kbase_pm_context_idle(kbdev);
+}
+
+/*
+ * Flush the range recorded in kctx->mmu_flush_vpfn/nr. Unless @force is
+ * set, a context which has no job running keeps it recorded for
+ * kbase_mmu_flush_deferred(); a context out of the runpool drops it, its
+ * address space is set up again when it is scheduled in.
  *
- * * IMPORTANT: This uses kbasep_js_runpool_release_ctx() when the context is
+ * IMPORTANT: This uses kbasep_js_runpool_release_ctx() when the context is
  * currently scheduled into the runpool, and so potentially uses a lot of locks.
  * These locks must be taken in the correct order with respect to others
  * already held by the caller. Refer to kbasep_js_runpool_release_ctx() for more
  * information.
  */
-static void kbase_mmu_flush(struct kbase_context *kctx, u64 vpfn, size_t nr)
+static void kbase_mmu_flush_pending(struct kbase_context *kctx, bool force)
 {
-	struct kbase_device *kbdev;
+	struct kbase_device *kbdev = kctx->kbdev;
 	bool ctx_is_in_runpool;
+	u64 vpfn = kctx->mmu_flush_vpfn;
+	u64 nr = kctx->mmu_flush_nr;
 
-	KBASE_DEBUG_ASSERT(NULL != kctx);
+	lockdep_assert_held(&kctx->reg_lock);
 
-	kbdev = kctx->kbdev;
+	if (!nr)
+		return;
 
 	/* We must flush if we're currently running jobs. At the very least, we need to retain the
 	 * context to ensure it doesn't schedule out whilst we're trying to flush it */
@@ -830,48 +871,80 @@ static void kbase_mmu_flush(struct kbase_context *kctx, u64 vpfn, size_t nr)
 
 		/* Second level check is to try to only do this when jobs are running. The refcount is
 		 * a heuristic for this. */
-		if (kbdev->js_data.runpool_irq.per_as_data[kctx->as_nr].as_busy_refcount >= 2) {
-			if (!kbase_pm_context_active_handle_suspend(kbdev,
-				KBASE_PM_SUSPEND_HANDLER_DONT_REACTIVATE)) {
-				int ret;
-				u32 op;
-
-				/* AS transaction begin */
-				mutex_lock(&kbdev->as[
-						kctx->as_nr].transaction_mutex);
-
-				if (kbase_hw_has_issue(kbdev,
-						BASE_HW_ISSUE_6367))
-					op = AS_COMMAND_FLUSH;
-				else
-					op = AS_COMMAND_FLUSH_MEM;
-
-				ret = kbase_mmu_hw_do_operation(kbdev,
-							&kbdev->as[kctx->as_nr],
-							kctx, vpfn, nr,
-							op, 0);
-#if KBASE_GPU_RESET_EN
-				if (ret) {
-					/* Flush failed to complete, assume the
-					 * GPU has hung and perform a reset to
-					 * recover */
-					dev_err(kbdev->dev, "Flush for GPU page table update did not complete. Issueing GPU soft-reset to recover\n");
-					if (kbase_prepare_to_reset_gpu(kbdev))
-						kbase_reset_gpu(kbdev);
-				}
-#endif /* KBASE_GPU_RESET_EN */
-
-				mutex_unlock(&kbdev->as[
-						kctx->as_nr].transaction_mutex);
-				/* AS transaction end */
-
-				kbase_pm_context_idle(kbdev);
-			}
+		if (force || kbdev->js_data.runpool_irq.per_as_data[kctx->as_nr].as_busy_refcount >= 2) {
+			kctx->mmu_flush_nr = 0;
+			kbase_mmu_flush_hw(kctx, vpfn, nr);
 		}
 		kbasep_js_runpool_release_ctx(kbdev, kctx);
+	} else {
+		kctx->mmu_flush_nr = 0;
 	}
 }
 
+/**
+ * This function is responsible for validating the MMU PTs
+ * triggering reguired flushes.
+ *
+ * The range is merged with any batched or deferred one, so that one MMU
+ * operation covers them all.
+ */
+static void kbase_mmu_flush(struct kbase_context *kctx, u64 vpfn, size_t nr)
+{
+	u64 start, end;
+
+	KBASE_DEBUG_ASSERT(NULL != kctx);
+	lockdep_assert_held(&kctx->reg_lock);
+
+	if (!nr)
+		return;
+
+	if (kctx->mmu_flush_nr) {
+		start = min(kctx->mmu_flush_vpfn, vpfn);
+		end = max(kctx->mmu_flush_vpfn + kctx->mmu_flush_nr,
+				vpfn + nr);
+	} else {
+		start = vpfn;
+		end = vpfn + nr;
+	}
+	kctx->mmu_flush_vpfn = start;
+	kctx->mmu_flush_nr = end - start;
+
+	if (kctx->mmu_flush_batch)
+		return;
+
+	kbase_mmu_flush_pending(kctx,
+			!IS_ENABLED(CONFIG_MALI_MMU_DEFERRED_FLUSH));
+}
+
+void kbase_mmu_flush_batch_begin(struct kbase_context *kctx)
+{
+	lockdep_assert_held(&kctx->reg_lock);
+
+	kctx->mmu_flush_batch++;
+}
+
+void kbase_mmu_flush_batch_end(struct kbase_context *kctx)
+{
+	lockdep_assert_held(&kctx->reg_lock);
+	KBASE_DEBUG_ASSERT(kctx->mmu_flush_batch > 0);
+
+	if (--kctx->mmu_flush_batch)
+		return;
+
+	kbase_mmu_flush_pending(kctx,
+			!IS_ENABLED(CONFIG_MALI_MMU_DEFERRED_FLUSH));
+}
+
+void kbase_mmu_flush_deferred(struct kbase_context *kctx)
+{
+	if (!ACCESS_ONCE(kctx->mmu_flush_nr))
+		return;
+
+	kbase_gpu_vm_lock(kctx);
+	kbase_mmu_flush_pending(kctx, true);
+	kbase_gpu_vm_unlock(kctx);
+}
+
 /*
  * We actually only discard the ATE, and not the page table
  * pages. There is a potential DoS here, as we'll leak memory by
@@ -890,6 +963,7 @@ int kbase_mmu_teardown_pages(struct kbase_context *kctx, u64 vpfn, size_t nr)
 	u64 *pgd_page;
 	struct kbase_device *kbdev;
 	size_t requested_nr = nr;
+	u64 start_vpfn = vpfn;
 	struct kbase_mmu_mode const *mmu_mode;
 
 	KBASE_DEBUG_ASSERT(NULL != kctx);
@@ -940,7 +1014,7 @@ int kbase_mmu_teardown_pages(struct kbase_context *kctx, u64 vpfn, size_t nr)
 		kunmap(p);
 	}
 
-	kbase_mmu_flush(kctx, vpfn, requested_nr);
+	kbase_mmu_flush(kctx, start_vpfn, requested_nr);
 	return 0;
 }
 
@@ -963,6 +1037,7 @@ int kbase_mmu_update_pages(struct kbase_context *kctx, u64 vpfn, phys_addr_t *ph
 	phys_addr_t pgd;
 	u64 *pgd_page;
 	size_t requested_nr = nr;
+	u64 start_vpfn = vpfn;
 	struct kbase_mmu_mode const *mmu_mode;
 
 	KBASE_DEBUG_ASSERT(NULL != kctx);
@@ -1013,7 +1088,7 @@ int kbase_mmu_update_pages(struct kbase_context *kctx, u64 vpfn, phys_addr_t *ph
 		kunmap(pfn_to_page(PFN_DOWN(pgd)));
 	}
 
-	kbase_mmu_flush(kctx, vpfn, requested_nr);
+	kbase_mmu_flush(kctx, start_vpfn, requested_nr);
 
 	return 0;
 }
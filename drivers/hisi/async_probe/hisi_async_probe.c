@@ -0,0 +1,195 @@
+/*
+ * hisi_async_probe - parallel registration of hisi platform drivers
+ *
+ * Copyright (c) 2013 Huawei Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * A driver registered through hisi_platform_driver_register_async() is
+ * registered, and so probed, from the hisi async probe domain instead of
+ * from its initcall. Dependencies are declared per device node:
+ *
+ *	noc: noc@e8000000 {
+ *		...
+ *		hisi,async-depends = <&pmctrl &crgctrl>;
+ *	};
+ *
+ * The probe of such a node returns -EPROBE_DEFER until every listed node's
+ * platform device is bound, and is retried by the deferred probe machinery
+ * once it is.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/async.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/of.h>
+#include <linux/of_platform.h>
+#include <linux/platform_device.h>
+#include <linux/hisi/hisi_async_probe.h>
+
+#define MODULE_NAME "[HISI ASYNC PROBE]"
+#define ASYNC_DEPENDS_PROP "hisi,async-depends"
+
+static bool enable = true;
+module_param(enable, bool, S_IRUGO);
+
+static ASYNC_DOMAIN(hisi_probe_domain);
+
+/*
+ * struct hisi_async_driver - a driver registered through this domain
+ * @node:	entry in hisi_async_drivers
+ * @drv:	the driver
+ * @probe:	the driver's own probe, called once the dependencies are bound
+ */
+struct hisi_async_driver {
+	struct list_head node;
+	struct platform_driver *drv;
+	int (*probe)(struct platform_device *);
+};
+
+static LIST_HEAD(hisi_async_drivers);
+static DEFINE_MUTEX(hisi_async_lock);
+
+static struct hisi_async_driver *hisi_async_find(struct platform_driver *drv)
+{
+	struct hisi_async_driver *ad;
+
+	list_for_each_entry(ad, &hisi_async_drivers, node) {
+		if (ad->drv == drv)
+			return ad;
+	}
+
+	return NULL;
+}
+
+/*
+ * hisi_async_depends_ready - returns false while one of the nodes listed in
+ * "hisi,async-depends" has a platform device that is not bound yet. Nodes
+ * without a platform device (disabled, or not a platform device at all)
+ * can never be waited for and are ignored.
+ */
+static bool hisi_async_depends_ready(struct device *dev)
+{
+	struct device_node *np;
+	struct platform_device *dep;
+	bool ready = true;
+	int i;
+
+	if (!dev->of_node)
+		return true;
+
+	for (i = 0; ready; i++) {
+		np = of_parse_phandle(dev->of_node, ASYNC_DEPENDS_PROP, i);
+		if (!np)
+			break;
+
+		dep = of_find_device_by_node(np);
+		if (dep) {
+			ready = !!ACCESS_ONCE(dep->dev.driver);
+			if (!ready)
+				dev_dbg(dev, "waiting for %s\n", np->full_name);
+			put_device(&dep->dev);
+		}
+		of_node_put(np);
+	}
+
+	return ready;
+}
+
+static int hisi_async_probe(struct platform_device *pdev)
+{
+	struct platform_driver *drv = to_platform_driver(pdev->dev.driver);
+	struct hisi_async_driver *ad;
+	int (*probe)(struct platform_device *) = NULL;
+
+	mutex_lock(&hisi_async_lock);
+	ad = hisi_async_find(drv);
+	if (ad)
+		probe = ad->probe;
+	mutex_unlock(&hisi_async_lock);
+
+	if (!probe)
+		return -ENODEV;
+
+	if (!hisi_async_depends_ready(&pdev->dev))
+		return -EPROBE_DEFER;
+
+	return probe(pdev);
+}
+
+static void hisi_async_register(void *data, async_cookie_t cookie)
+{
+	struct platform_driver *drv = data;
+	int ret;
+
+	ret = platform_driver_register(drv);
+	if (ret)
+		pr_err("%s %s: register failed %d\n", MODULE_NAME,
+		       drv->driver.name, ret);
+}
+
+/*
+ * hisi_platform_driver_register_async - register 'drv' from the hisi async
+ * probe domain. Returns 0 once the registration is queued; errors of the
+ * registration itself can only be logged.
+ */
+int hisi_platform_driver_register_async(struct platform_driver *drv)
+{
+	struct hisi_async_driver *ad;
+
+	if (!enable || !drv->probe)
+		return platform_driver_register(drv);
+
+	ad = kzalloc(sizeof(*ad), GFP_KERNEL);
+	if (!ad)
+		return platform_driver_register(drv);
+
+	ad->drv = drv;
+	ad->probe = drv->probe;
+	drv->probe = hisi_async_probe;
+
+	mutex_lock(&hisi_async_lock);
+	list_add_tail(&ad->node, &hisi_async_drivers);
+	mutex_unlock(&hisi_async_lock);
+
+	async_schedule_domain(hisi_async_register, drv, &hisi_probe_domain);
+
+	return 0;
+}
+EXPORT_SYMBOL(hisi_platform_driver_register_async);
+
+void hisi_platform_driver_unregister_async(struct platform_driver *drv)
+{
+	struct hisi_async_driver *ad;
+
+	async_synchronize_full_domain(&hisi_probe_domain);
+	platform_driver_unregister(drv);
+
+	mutex_lock(&hisi_async_lock);
+	ad = hisi_async_find(drv);
+	if (ad) {
+		drv->probe = ad->probe;
+		list_del(&ad->node);
+	}
+	mutex_unlock(&hisi_async_lock);
+
+	kfree(ad);
+}
+EXPORT_SYMBOL(hisi_platform_driver_unregister_async);
+
+/*
+ * Whatever runs from late_initcall_sync on may rely on the hisi drivers
+ * being registered, as it did when they were registered synchronously.
+ */
+static int __init hisi_async_probe_sync(void)
+{
+	async_synchronize_full_domain(&hisi_probe_domain);
+	return 0;
+}
+late_initcall_sync(hisi_async_probe_sync);
@@ -15,6 +15,11 @@
 #include <linux/clk.h>
 #include <linux/bitops.h>
 #include <linux/dma-mapping.h>
+#include <linux/relay.h>
+#include <linux/math64.h>
+#include <linux/hrtimer.h>
+#include <linux/perf_event.h>
+#include <asm/irq_regs.h>
 #include <soc_ddrc_qosb_interface.h>
 #include <soc_dmss_interface.h>
 #include <soc_acpu_baseaddr_interface.h>
@@ -26,6 +31,8 @@
 #include <linux/of_irq.h>
 #include <global_ddr_map.h>
 #include <linux/hisi/hisi_drmdriver.h>
+#include <linux/hisi/hisi_async_probe.h>
+#include <linux/hisi/hisi_ddrflux.h>
 #include "hisi_ddr_ddrcflux.h"
 #include "hisi_ddr_autofsgt_proxy_kernel.h"
 
@@ -171,6 +178,28 @@ struct ddrflux_data {
 	u32		ddrflux_data[MAX_FLUX_REG_NUM];
 };
 struct ddrflux_data	*ddrc_datas = NULL;
+
+/*
+ * Streaming: instead of stopping after sum_time, the timer keeps running,
+ * ddrc_datas becomes a ring of sum_time / interval + 1 records, and every
+ * record is also written to the relay channel ddrflux/stream*. The sum of
+ * the DMSS ASI flux counters (all masters, read + write, in bytes) over
+ * the last interval is kept for ddrflux_get_bandwidth().
+ */
+#define DDRFLUX_STREAM_SUBBUF_SIZE	(64 * 1024)
+#define DDRFLUX_STREAM_N_SUBBUFS	4
+#define DDRFLUX_ASI_FLUX_HEAD		"ASI_FLUX_STAT_"
+/* a bandwidth older than this many intervals is not reported */
+#define DDRFLUX_BW_STALE_INTERVALS	4
+
+static u32 stream;
+static unsigned int nr_datas;
+static struct rchan *ddrflux_chan;
+static int ddrflux_bw_index[MAX_FLUX_REG_NUM];
+static int nr_bw_index;
+static DEFINE_SPINLOCK(ddrflux_bw_lock);
+static unsigned int ddrflux_bw_mbps;
+static u64 ddrflux_bw_time;
 static void dmss_flux_enable_ctrl(int en);
 static void qosbuf_flux_enable_ctrl(int en);
 static void dmc_flux_enable_ctrl(int en);
@@ -440,6 +469,76 @@ void ddrc_flux_data_pull(void)
 	}
 }
 
+static void ddrflux_bw_index_init(void)
+{
+	int i;
+
+	nr_bw_index = 0;
+	for (i = 0; i < DDRFLUX_LIST_LEN && i < MAX_FLUX_REG_NUM; i++) {
+		if (!strncmp(ddrflux_lookups[i].head, DDRFLUX_ASI_FLUX_HEAD,
+			     strlen(DDRFLUX_ASI_FLUX_HEAD)))
+			ddrflux_bw_index[nr_bw_index++] = i;
+	}
+}
+
+/*
+ * ddrflux_stream_record - publish ddrc_datas[count]: the record goes to the
+ * relay channel, and the flux since the previous record becomes the
+ * current bandwidth. The counters are free running 32 bit values, so the
+ * unsigned differences are correct across a wrap.
+ */
+static void ddrflux_stream_record(void)
+{
+	struct ddrflux_data *cur = &ddrc_datas[count];
+	struct ddrflux_data *prev;
+	u64 bytes = 0, delta_ns;
+	unsigned long flags;
+	int i;
+
+	if (ddrflux_chan)
+		relay_write(ddrflux_chan, cur, sizeof(*cur));
+
+	prev = &ddrc_datas[count ? count - 1 : nr_datas - 1];
+	if (!prev->ddrc_time || cur->ddrc_time <= prev->ddrc_time)
+		return;
+
+	for (i = 0; i < nr_bw_index; i++)
+		bytes += (u32)(cur->ddrflux_data[ddrflux_bw_index[i]] -
+			       prev->ddrflux_data[ddrflux_bw_index[i]]);
+
+	/* bytes per us is MB/s */
+	delta_ns = cur->ddrc_time - prev->ddrc_time;
+	bytes = div64_u64(bytes * 1000, delta_ns);
+
+	spin_lock_irqsave(&ddrflux_bw_lock, flags);
+	ddrflux_bw_mbps = (unsigned int)min_t(u64, bytes, UINT_MAX);
+	ddrflux_bw_time = cur->ddrc_time;
+	spin_unlock_irqrestore(&ddrflux_bw_lock, flags);
+}
+
+int ddrflux_get_bandwidth(unsigned int *mbps)
+{
+	unsigned long flags;
+	u64 stale_ns;
+	int ret = -ENODATA;
+
+	if (!mbps)
+		return -EINVAL;
+
+	stale_ns = (u64)usr[interval] * NSEC_PER_USEC * DDRFLUX_BW_STALE_INTERVALS;
+
+	spin_lock_irqsave(&ddrflux_bw_lock, flags);
+	if (stream && ddrflux_bw_time &&
+	    sched_clock() - ddrflux_bw_time <= stale_ns) {
+		*mbps = ddrflux_bw_mbps;
+		ret = 0;
+	}
+	spin_unlock_irqrestore(&ddrflux_bw_lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL(ddrflux_get_bandwidth);
+
 static irqreturn_t hisi_bw_timer_interrupt(int irq, void *dev_id)
 {
 	u32 freq_index;
@@ -471,7 +570,11 @@ static irqreturn_t hisi_bw_timer_interrupt(int irq, void *dev_id)
 			ddrc_flux_data_pull();
 		}
 
-		if (count < (usr[sum_time] / usr[interval]) - 1) {
+		if (stream) {
+			ddrflux_stream_record();
+			count = (count + 1) % nr_datas;
+			stop = 0;
+		} else if (count < (usr[sum_time] / usr[interval]) - 1) {
 			count++;
 			stop = 0;
 		} else if (count == (usr[sum_time] / usr[interval] - 1)) {
@@ -757,6 +860,56 @@ static int __ddrflux_init_unsec(void)
 	return 0;
 }
 
+static struct dentry *ddrflux_create_buf_file(const char *filename,
+		struct dentry *parent, umode_t mode,
+		struct rchan_buf *buf, int *is_global)
+{
+	/* the timer irq is bound to one cpu, one buffer is enough */
+	*is_global = 1;
+
+	return debugfs_create_file(filename, mode, parent, buf,
+				   &relay_file_operations);
+}
+
+static int ddrflux_remove_buf_file(struct dentry *dentry)
+{
+	debugfs_remove(dentry);
+	return 0;
+}
+
+static struct rchan_callbacks ddrflux_relay_callbacks = {
+	.create_buf_file = ddrflux_create_buf_file,
+	.remove_buf_file = ddrflux_remove_buf_file,
+};
+
+static void ddrflux_stream_open(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ddrflux_bw_lock, flags);
+	ddrflux_bw_time = 0;
+	spin_unlock_irqrestore(&ddrflux_bw_lock, flags);
+
+	ddrflux_bw_index_init();
+
+	if (!ddrflux_chan) {
+		ddrflux_chan = relay_open("stream", ddrc_flux_dir,
+					  DDRFLUX_STREAM_SUBBUF_SIZE,
+					  DDRFLUX_STREAM_N_SUBBUFS,
+					  &ddrflux_relay_callbacks, NULL);
+		if (!ddrflux_chan)
+			pr_err("[%s] relay open failed, bandwidth only\n", __func__);
+	}
+}
+
+static void ddrflux_stream_close(void)
+{
+	if (ddrflux_chan) {
+		relay_close(ddrflux_chan);
+		ddrflux_chan = NULL;
+	}
+}
+
 void __ddrflux_init(void)
 {
 	unsigned long mem_size;
@@ -770,7 +923,7 @@ void __ddrflux_init(void)
 	if (WARN_ON(mem_size > MAX_DDRFLUX_PULL_DATA))
 		return;
 
-	ddrc_datas = (struct ddrflux_data *)vmalloc(mem_size);
+	ddrc_datas = (struct ddrflux_data *)vzalloc(mem_size);
 
 	if (!ddrc_datas) {
 		pr_err("[%s] vmalloc size =%ld failed !%d\n", __func__, mem_size, __LINE__);
@@ -827,6 +980,9 @@ void __ddrflux_init(void)
 	}
 
 	count = 0;
+	nr_datas = usr[sum_time] / usr[interval] + 1;
+	if (stream)
+		ddrflux_stream_open();
 	flag = 1;
 	hisi_bw_timer_init(usr[irq_affinity]);
 	pr_info("[%s sucess]%d\n", __func__, __LINE__);
@@ -837,11 +993,14 @@ static void __ddrflux_exit(void)
 {
 	if (ddrc_datas != NULL) {
 		flag = 0;
-		vfree(ddrc_datas);
+		hisi_bw_timer_disable();
 		hisi_bw_timer_deinit();
+		vfree(ddrc_datas);
 		ddrc_datas = NULL;
 	}
 
+	ddrflux_stream_close();
+
 	if (usr[ddrc_unsec_pass] == 0) {
 		if (usr[dmss_enable])
 			*((unsigned long *)dfdev->flux_en_va) &= (~BIT(0));
@@ -1053,6 +1212,48 @@ ddrflux_exit_store(struct file *filp, const char __user *ubuf, size_t cnt, loff_
 	return (ssize_t)cnt;
 }
 
+/*
+ * The ASI flux statistics are shared by the debugfs sampler and the
+ * ddr_flux perf pmu: they are turned on by the first user and only
+ * turned off again by the last one.
+ */
+static DEFINE_RAW_SPINLOCK(dmss_stat_lock);
+static unsigned int dmss_stat_users;
+static bool dmss_stat_held;	/* by the debugfs sampler */
+
+static void dmss_stat_get(void __iomem *dmss_base)
+{
+	unsigned long flags;
+	u32 val;
+
+	raw_spin_lock_irqsave(&dmss_stat_lock, flags);
+	if (!dmss_stat_users++) {
+		val = readl(SOC_DMSS_GLB_STAT_CTRL_ADDR(dmss_base));
+		val |= 0xFFF;
+		writel(val, SOC_DMSS_GLB_STAT_CTRL_ADDR(dmss_base));
+	}
+	raw_spin_unlock_irqrestore(&dmss_stat_lock, flags);
+}
+
+/* returns true if the statistics were turned off */
+static bool dmss_stat_put(void __iomem *dmss_base)
+{
+	unsigned long flags;
+	bool last;
+	u32 val;
+
+	raw_spin_lock_irqsave(&dmss_stat_lock, flags);
+	last = !--dmss_stat_users;
+	if (last) {
+		val = readl(SOC_DMSS_GLB_STAT_CTRL_ADDR(dmss_base));
+		val &= ~(0xFFF);
+		writel(val, SOC_DMSS_GLB_STAT_CTRL_ADDR(dmss_base));
+	}
+	raw_spin_unlock_irqrestore(&dmss_stat_lock, flags);
+
+	return last;
+}
+
 static void dmss_flux_enable_ctrl(int en)
 {
 	u32 asi_base = 0;
@@ -1065,13 +1266,17 @@ static void dmss_flux_enable_ctrl(int en)
 		return;
 
 	if (en) {
-		val = readl(SOC_DMSS_GLB_STAT_CTRL_ADDR(dfdev->dmss_base));
-		val |= 0xFFF;
-		writel(val, SOC_DMSS_GLB_STAT_CTRL_ADDR(dfdev->dmss_base));
+		if (!dmss_stat_held) {
+			dmss_stat_get(dfdev->dmss_base);
+			dmss_stat_held = true;
+		}
 	} else {
-		val = readl(SOC_DMSS_GLB_STAT_CTRL_ADDR(dfdev->dmss_base));
-		val &= ~(0xFFF);
-		writel(val, SOC_DMSS_GLB_STAT_CTRL_ADDR(dfdev->dmss_base));
+		if (!dmss_stat_held)
+			return;
+		dmss_stat_held = false;
+		/* the perf pmu still counts */
+		if (!dmss_stat_put(dfdev->dmss_base))
+			return;
 
 		/*ckg_byp_asi SOC_DMSS_ASI_DYN_CKG_ADDR*/
 
@@ -1242,7 +1447,9 @@ static const struct seq_operations ddrflux_data_seq_ops = {
 
 static int ddrflux_data_open(struct inode *inode, struct file *file)
 {
-	__ddrflux_stop();
+	/* a streaming capture is read from the relay files instead */
+	if (!stream)
+		__ddrflux_stop();
 	return seq_open(file, &ddrflux_data_seq_ops);
 }
 /*lint -e785*/
@@ -1295,6 +1502,8 @@ static int ddrc_flux_dir_init(void)
 					   &usr[sum_time]);
 	debugfs_create_u32("irq_affinity", PRIV_AUTH, ddrc_flux_dir,
 					   &usr[irq_affinity]);
+	debugfs_create_u32("stream", PRIV_AUTH, ddrc_flux_dir,
+					   &stream);
 
 	if (hisi_plat == KIRIN970) {
 		usr[ddrc_unsec_pass] = 1;
@@ -1392,6 +1601,340 @@ static int bl31_smem_init(struct device_node *np)
 	return 0;
 }
 
+#ifdef CONFIG_HISI_DDRC_FLUX_PMU
+/*
+ * "ddr_flux" perf PMU: DDR read and write traffic of all masters, in
+ * bytes, from the DMSS ASI flux counters. It is an uncore PMU, so events
+ * are system wide and bound to one cpu (perf stat -a -e ddr_flux/...).
+ * The 32 bit counters are folded into 64 bit totals by an hrtimer, which
+ * also provides sampling: once an event has counted sample_period bytes,
+ * the next tick records a sample of whatever the cpu was running.
+ */
+#define DDRFLUX_PMU_READ_BYTES		0
+#define DDRFLUX_PMU_WRITE_BYTES		1
+#define DDRFLUX_PMU_NR_EVENTS		2
+#define DDRFLUX_PMU_MAX_ACTIVE		8
+#define DDRFLUX_PMU_NR_ASI		(MAX_DMSS_ASI_BASE + 1)
+/* well below the wrap time of a 32 bit byte counter at full bandwidth */
+#define DDRFLUX_PMU_POLL_NS		(10 * NSEC_PER_MSEC)
+/*
+ * More than an ASI can move in a poll period: a counter that went back
+ * by more than this was reset, not wrapped.
+ */
+#define DDRFLUX_PMU_MAX_DELTA		(U32_MAX / 4)
+
+struct ddrflux_pmu {
+	struct pmu	pmu;
+	void __iomem	*dmss_base;
+	raw_spinlock_t	lock;
+	u32		last[DDRFLUX_PMU_NR_EVENTS][DDRFLUX_PMU_NR_ASI];
+	u64		total[DDRFLUX_PMU_NR_EVENTS];
+	struct perf_event *active[DDRFLUX_PMU_MAX_ACTIVE];
+	int		nr_active;
+	struct hrtimer	timer;
+	int		cpu;
+};
+
+static struct ddrflux_pmu *ddrflux_pmu;
+
+#define to_ddrflux_pmu(p)	container_of(p, struct ddrflux_pmu, pmu)
+
+/* called with dp->lock held */
+static void ddrflux_pmu_fold(struct ddrflux_pmu *dp, int ev, int asi, u32 val)
+{
+	u32 delta = val - dp->last[ev][asi];
+
+	if (delta > DDRFLUX_PMU_MAX_DELTA)
+		delta = val;
+	dp->total[ev] += delta;
+	dp->last[ev][asi] = val;
+}
+
+static void ddrflux_pmu_poll(struct ddrflux_pmu *dp)
+{
+	unsigned long flags;
+	int i;
+
+	raw_spin_lock_irqsave(&dp->lock, flags);
+	for (i = 0; i < DDRFLUX_PMU_NR_ASI; i++) {
+		ddrflux_pmu_fold(dp, DDRFLUX_PMU_READ_BYTES, i,
+			readl(SOC_DMSS_ASI_FLUX_STAT_RD_ADDR(dp->dmss_base, i)));
+		ddrflux_pmu_fold(dp, DDRFLUX_PMU_WRITE_BYTES, i,
+			readl(SOC_DMSS_ASI_FLUX_STAT_WR_ADDR(dp->dmss_base, i)));
+	}
+	raw_spin_unlock_irqrestore(&dp->lock, flags);
+}
+
+/* take the current counters as the base, without counting them */
+static void ddrflux_pmu_sync(struct ddrflux_pmu *dp)
+{
+	unsigned long flags;
+	int i;
+
+	raw_spin_lock_irqsave(&dp->lock, flags);
+	for (i = 0; i < DDRFLUX_PMU_NR_ASI; i++) {
+		dp->last[DDRFLUX_PMU_READ_BYTES][i] =
+			readl(SOC_DMSS_ASI_FLUX_STAT_RD_ADDR(dp->dmss_base, i));
+		dp->last[DDRFLUX_PMU_WRITE_BYTES][i] =
+			readl(SOC_DMSS_ASI_FLUX_STAT_WR_ADDR(dp->dmss_base, i));
+	}
+	raw_spin_unlock_irqrestore(&dp->lock, flags);
+}
+
+static u64 ddrflux_pmu_event_update(struct perf_event *event)
+{
+	struct ddrflux_pmu *dp = to_ddrflux_pmu(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+	u64 prev, now, delta;
+
+	ddrflux_pmu_poll(dp);
+	now = READ_ONCE(dp->total[hwc->idx]);
+	do {
+		prev = local64_read(&hwc->prev_count);
+	} while (local64_cmpxchg(&hwc->prev_count, prev, now) != prev);
+
+	delta = now - prev;
+	local64_add(delta, &event->count);
+	local64_sub(delta, &hwc->period_left);
+
+	return delta;
+}
+
+static enum hrtimer_restart ddrflux_pmu_timer_fn(struct hrtimer *hrtimer)
+{
+	struct ddrflux_pmu *dp = container_of(hrtimer, struct ddrflux_pmu, timer);
+	struct pt_regs *regs = get_irq_regs();
+	struct perf_sample_data data;
+	struct perf_event *event;
+	struct hw_perf_event *hwc;
+	int i;
+
+	for (i = 0; i < dp->nr_active; i++) {
+		event = dp->active[i];
+		hwc = &event->hw;
+		if (hwc->state & PERF_HES_STOPPED)
+			continue;
+
+		ddrflux_pmu_event_update(event);
+		if (!is_sampling_event(event) || !regs ||
+		    local64_read(&hwc->period_left) > 0)
+			continue;
+
+		local64_set(&hwc->period_left, hwc->sample_period);
+		perf_sample_data_init(&data, 0, hwc->sample_period);
+		if (perf_event_overflow(event, &data, regs))
+			event->pmu->stop(event, 0);
+	}
+
+	hrtimer_forward_now(hrtimer, ns_to_ktime(DDRFLUX_PMU_POLL_NS));
+	return HRTIMER_RESTART;
+}
+
+static int ddrflux_pmu_event_init(struct perf_event *event)
+{
+	struct ddrflux_pmu *dp = to_ddrflux_pmu(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+
+	if (event->attr.type != event->pmu->type)
+		return -ENOENT;
+
+	/* system wide only, and there is no notion of privilege levels */
+	if (event->cpu < 0 || (event->attach_state & PERF_ATTACH_TASK))
+		return -EINVAL;
+	if (event->attr.exclude_user || event->attr.exclude_kernel ||
+	    event->attr.exclude_hv || event->attr.exclude_idle)
+		return -EINVAL;
+
+	if (event->attr.config >= DDRFLUX_PMU_NR_EVENTS)
+		return -EINVAL;
+
+	event->cpu = dp->cpu;
+	hwc->idx = (int)event->attr.config;
+	hwc->config = event->attr.config;
+
+	return 0;
+}
+
+static void ddrflux_pmu_event_start(struct perf_event *event, int flags)
+{
+	struct ddrflux_pmu *dp = to_ddrflux_pmu(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+
+	ddrflux_pmu_poll(dp);
+	local64_set(&hwc->prev_count, READ_ONCE(dp->total[hwc->idx]));
+	if (is_sampling_event(event))
+		local64_set(&hwc->period_left, hwc->sample_period);
+	hwc->state = 0;
+}
+
+static void ddrflux_pmu_event_stop(struct perf_event *event, int flags)
+{
+	struct hw_perf_event *hwc = &event->hw;
+
+	if (hwc->state & PERF_HES_STOPPED)
+		return;
+
+	ddrflux_pmu_event_update(event);
+	hwc->state |= PERF_HES_STOPPED | PERF_HES_UPTODATE;
+}
+
+static int ddrflux_pmu_event_add(struct perf_event *event, int flags)
+{
+	struct ddrflux_pmu *dp = to_ddrflux_pmu(event->pmu);
+
+	if (dp->nr_active >= DDRFLUX_PMU_MAX_ACTIVE)
+		return -EAGAIN;
+
+	if (!dp->nr_active++) {
+		dmss_stat_get(dp->dmss_base);
+		ddrflux_pmu_sync(dp);
+		hrtimer_start(&dp->timer, ns_to_ktime(DDRFLUX_PMU_POLL_NS),
+			      HRTIMER_MODE_REL_PINNED);
+	}
+	dp->active[dp->nr_active - 1] = event;
+
+	event->hw.state = PERF_HES_STOPPED | PERF_HES_UPTODATE;
+	if (flags & PERF_EF_START)
+		ddrflux_pmu_event_start(event, flags);
+
+	return 0;
+}
+
+static void ddrflux_pmu_event_del(struct perf_event *event, int flags)
+{
+	struct ddrflux_pmu *dp = to_ddrflux_pmu(event->pmu);
+	int i;
+
+	ddrflux_pmu_event_stop(event, PERF_EF_UPDATE);
+
+	for (i = 0; i < dp->nr_active; i++) {
+		if (dp->active[i] == event) {
+			dp->active[i] = dp->active[--dp->nr_active];
+			break;
+		}
+	}
+	if (!dp->nr_active) {
+		hrtimer_cancel(&dp->timer);
+		dmss_stat_put(dp->dmss_base);
+	}
+}
+
+static void ddrflux_pmu_event_read(struct perf_event *event)
+{
+	ddrflux_pmu_event_update(event);
+}
+
+static ssize_t ddrflux_pmu_cpumask_show(struct device *dev,
+					struct device_attribute *attr, char *buf)
+{
+	return cpumap_print_to_pagebuf(true, buf, cpumask_of(ddrflux_pmu->cpu));
+}
+static DEVICE_ATTR(cpumask, S_IRUGO, ddrflux_pmu_cpumask_show, NULL);
+
+static struct attribute *ddrflux_pmu_cpumask_attrs[] = {
+	&dev_attr_cpumask.attr,
+	NULL,
+};
+
+static struct attribute_group ddrflux_pmu_cpumask_group = {
+	.attrs = ddrflux_pmu_cpumask_attrs,
+};
+
+PMU_FORMAT_ATTR(event, "config:0-7");
+
+static struct attribute *ddrflux_pmu_format_attrs[] = {
+	&format_attr_event.attr,
+	NULL,
+};
+
+static struct attribute_group ddrflux_pmu_format_group = {
+	.name = "format",
+	.attrs = ddrflux_pmu_format_attrs,
+};
+
+#define DDRFLUX_PMU_EVENT_ATTR(_name, _config)				\
+	PMU_EVENT_ATTR_STRING(_name, ddrflux_pmu_event_##_name,		\
+			      "event=" __stringify(_config))
+
+DDRFLUX_PMU_EVENT_ATTR(read_bytes, DDRFLUX_PMU_READ_BYTES);
+DDRFLUX_PMU_EVENT_ATTR(write_bytes, DDRFLUX_PMU_WRITE_BYTES);
+
+static struct attribute *ddrflux_pmu_event_attrs[] = {
+	&ddrflux_pmu_event_read_bytes.attr.attr,
+	&ddrflux_pmu_event_write_bytes.attr.attr,
+	NULL,
+};
+
+static struct attribute_group ddrflux_pmu_events_group = {
+	.name = "events",
+	.attrs = ddrflux_pmu_event_attrs,
+};
+
+static const struct attribute_group *ddrflux_pmu_attr_groups[] = {
+	&ddrflux_pmu_cpumask_group,
+	&ddrflux_pmu_format_group,
+	&ddrflux_pmu_events_group,
+	NULL,
+};
+
+static int ddrflux_pmu_register(void)
+{
+	struct ddrflux_pmu *dp;
+	int ret;
+
+	dp = kzalloc(sizeof(*dp), GFP_KERNEL);
+	if (!dp)
+		return -ENOMEM;
+
+	dp->dmss_base = VIRT(REG_BASE_DMSS, 8);
+	if (!dp->dmss_base) {
+		kfree(dp);
+		return -ENOMEM;
+	}
+
+	raw_spin_lock_init(&dp->lock);
+	hrtimer_init(&dp->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dp->timer.function = ddrflux_pmu_timer_fn;
+	dp->cpu = 0;
+
+	dp->pmu = (struct pmu) {
+		.task_ctx_nr	= perf_invalid_context,
+		.event_init	= ddrflux_pmu_event_init,
+		.add		= ddrflux_pmu_event_add,
+		.del		= ddrflux_pmu_event_del,
+		.start		= ddrflux_pmu_event_start,
+		.stop		= ddrflux_pmu_event_stop,
+		.read		= ddrflux_pmu_event_read,
+		.attr_groups	= ddrflux_pmu_attr_groups,
+	};
+
+	ddrflux_pmu = dp;
+	ret = perf_pmu_register(&dp->pmu, "ddr_flux", -1);
+	if (ret) {
+		pr_err("[%s] perf_pmu_register failed %d\n", __func__, ret);
+		ddrflux_pmu = NULL;
+		iounmap(dp->dmss_base);
+		kfree(dp);
+	}
+
+	return ret;
+}
+
+static void ddrflux_pmu_unregister(void)
+{
+	if (!ddrflux_pmu)
+		return;
+
+	perf_pmu_unregister(&ddrflux_pmu->pmu);
+	iounmap(ddrflux_pmu->dmss_base);
+	kfree(ddrflux_pmu);
+	ddrflux_pmu = NULL;
+}
+#else
+static inline int ddrflux_pmu_register(void) { return 0; }
+static inline void ddrflux_pmu_unregister(void) { }
+#endif
+
 static int ddrc_flux_probe(struct platform_device *pdev)
 {
 	struct device_node *np = pdev->dev.of_node;
@@ -1489,6 +2032,8 @@ static int ddrc_flux_probe(struct platform_device *pdev)
 	spin_lock_init(&dfdev->lock);
 	platform_set_drvdata(pdev, dfdev);
 	ddrc_flux_dir_init();
+	if (ddrflux_pmu_register())
+		dev_warn(&pdev->dev, "no ddr_flux perf pmu\n");
 	pr_info("[%s] probe sucess!\n", dev_name(&pdev->dev));
 	return ret;
 err1:
@@ -1519,6 +2064,7 @@ out:
 static int ddrc_flux_remove(struct platform_device *pdev)
 {
 	platform_set_drvdata(pdev, NULL);
+	ddrflux_pmu_unregister();
 	clk_put(dfdev->ddrc_freq_clk);
 	clk_put(dfdev->ddrc_flux_timer->clk);
 
@@ -1554,7 +2100,7 @@ static struct platform_driver ddrc_flux_driver = {
 /*lint +e785*/
 
 /*lint -e528 -esym(528,*)*/
-module_platform_driver(ddrc_flux_driver);/*lint   !e64*/
+module_hisi_async_platform_driver(ddrc_flux_driver);/*lint   !e64*/
 /*lint -e528 +esym(528,*)*/
 
 /*lint +e438 +e514 +e550 +e715 +e774 +e818 +e835 +e838 +e845 +e712 +e730 +e732 +e747*/
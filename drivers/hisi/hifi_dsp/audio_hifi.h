@@ -92,6 +92,59 @@ struct misc_io_dump_buf_param {
 	unsigned int			buf_size;			/*ûռڴ泤*/
 };
 
+/*
+ * Low latency PCM rings, shared by the AP userspace and HiFi. Map
+ * HIFI_LL_PCM_MMAP_OFFSET of the hifi_misc device: the control page comes
+ * first, each ring at its buf_offset from the start of the mapping.
+ *
+ * Positions are free running byte counts, the ring offset is
+ * pos % buf_size. For playback userspace writes frames and advances
+ * write_pos, HiFi consumes them and advances read_pos, for capture the
+ * other way round. Neither side sends a message per buffer, userspace
+ * paces itself on period_bytes.
+ */
+#define HIFI_LL_PCM_MMAP_OFFSET		(0x10000000)
+#define HIFI_LL_PCM_MAGIC		(0x4C4C5043)	/* "LLPC" */
+
+enum hifi_ll_pcm_dir {
+	HIFI_LL_PCM_PLAYBACK = 0,
+	HIFI_LL_PCM_CAPTURE,
+	HIFI_LL_PCM_DIR_MAX
+};
+
+enum hifi_ll_pcm_state {
+	HIFI_LL_PCM_STOPPED = 0,
+	HIFI_LL_PCM_RUNNING,
+};
+
+struct hifi_ll_pcm_ring {
+	unsigned int			buf_offset;		/* from the start of the mapping */
+	unsigned int			buf_size;
+	unsigned int			write_pos;		/* advanced by the producer */
+	unsigned int			read_pos;		/* advanced by the consumer */
+	unsigned int			xruns;			/* counted by HiFi */
+	unsigned int			reserved[3];
+};
+
+struct hifi_ll_pcm_ctrl {
+	unsigned int			magic;
+	unsigned int			state;
+	unsigned int			rate;
+	unsigned int			channels;
+	unsigned int			bits;
+	unsigned int			period_bytes;
+	unsigned int			reserved[2];
+	struct hifi_ll_pcm_ring	ring[HIFI_LL_PCM_DIR_MAX];
+};
+
+/* misc_io_ll_pcm_param: stream format of the low latency rings */
+struct misc_io_ll_pcm_param {
+	unsigned int			rate;
+	unsigned int			channels;
+	unsigned int			bits;			/* 16 or 32 */
+	unsigned int			period_bytes;	/* at most half a ring */
+};
+
 /*
   *voice proxy interface
   */
@@ -240,6 +293,8 @@ struct voice_proxy_voice_encrypt_key_end {
 #endif
 
 #define HIFI_MISC_IOCTL_GET_VOICE_BSD_PARAM	_IOWR('A',  0x7c, unsigned int)    //ȡVoice BSD
+#define HIFI_MISC_IOCTL_LL_PCM_START	_IOW('A', 0x7d, struct misc_io_ll_pcm_param)	//start the low latency PCM rings
+#define HIFI_MISC_IOCTL_LL_PCM_STOP		_IOW('A', 0x7e, unsigned int)				//stop the low latency PCM rings
 #define INT_TO_ADDR(low,high) (void*) (unsigned long)((unsigned long long)(low) | ((unsigned long long)(high)<<32))
 #define GET_LOW32(x) (unsigned int)(((unsigned long long)(unsigned long)(x))&0xffffffffULL)
 #define GET_HIG32(x) (unsigned int)((((unsigned long long)(unsigned long)(x))>>32)&0xffffffffULL)
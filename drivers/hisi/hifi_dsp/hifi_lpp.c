@@ -96,6 +96,8 @@ struct hifi_misc_priv {
 
 	struct multi_mic multi_mic_ctrl;
 
+	struct mutex	ll_pcm_mutex;
+	struct file	*ll_pcm_owner;	/* fd that started the low latency rings */
 };
 static struct hifi_misc_priv s_misc_data;
 
@@ -1058,6 +1060,122 @@ error1:
 	return ret;
 }
 
+static struct hifi_ll_pcm_ctrl __iomem *hifi_ll_pcm_ctrl(void)
+{
+	return (struct hifi_ll_pcm_ctrl __iomem *)(s_misc_data.hifi_priv_base_virt +
+		(HIFI_LL_PCM_ADDR - HIFI_UNSEC_BASE_ADDR));
+}
+
+/* called with ll_pcm_mutex held */
+static int hifi_ll_pcm_send(unsigned short msg_id)
+{
+	struct hifi_ll_pcm_cmd cmd;
+	int ret;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.msg_id = msg_id;
+	cmd.ctrl_addr_l = GET_LOW32(HIFI_LL_PCM_ADDR);
+	cmd.ctrl_addr_h = GET_HIG32(HIFI_LL_PCM_ADDR);
+
+	ret = (int)mailbox_send_msg(MAILBOX_MAILCODE_ACPU_TO_HIFI_MISC, &cmd, sizeof(cmd));
+	if (OK != ret)
+		loge("msg: 0x%x send to hifi fail, ret is %d.\n", msg_id, ret);
+
+	return ret;
+}
+
+/* called with ll_pcm_mutex held */
+static void hifi_ll_pcm_do_stop(void)
+{
+	struct hifi_ll_pcm_ctrl __iomem *ctrl = hifi_ll_pcm_ctrl();
+
+	writel(HIFI_LL_PCM_STOPPED, &ctrl->state);
+	wmb();
+	(void)hifi_ll_pcm_send(ID_AP_AUDIO_LL_PCM_STOP_CMD);
+	s_misc_data.ll_pcm_owner = NULL;
+}
+
+/*
+ * hifi_dsp_ll_pcm_start - set up the low latency PCM rings and hand them to
+ * HiFi. This is the only message of the stream: the frames then go through
+ * the rings, mapped by the caller at HIFI_LL_PCM_MMAP_OFFSET. The rings are
+ * stopped by HIFI_MISC_IOCTL_LL_PCM_STOP or when the caller's fd is closed.
+ */
+static int hifi_dsp_ll_pcm_start(struct file *fd, unsigned long arg)
+{
+	struct misc_io_ll_pcm_param para;
+	struct hifi_ll_pcm_ctrl __iomem *ctrl = hifi_ll_pcm_ctrl();
+	unsigned int frame_bytes;
+	int dir;
+	int ret;
+
+	if (copy_from_user(&para, (void __user *)arg, sizeof(para))) {
+		loge("copy_from_user fail.\n");
+		return -EFAULT;
+	}
+
+	if ((para.bits != 16 && para.bits != 32) || !para.channels || !para.rate) {
+		loge("invalid format: rate %u channels %u bits %u\n",
+			para.rate, para.channels, para.bits);
+		return -EINVAL;
+	}
+
+	frame_bytes = para.channels * (para.bits / 8);
+	if (!para.period_bytes || para.period_bytes > HIFI_LL_PCM_RING_SIZE / 2 ||
+		para.period_bytes % frame_bytes) {
+		loge("invalid period_bytes %u\n", para.period_bytes);
+		return -EINVAL;
+	}
+
+	mutex_lock(&s_misc_data.ll_pcm_mutex);
+	if (s_misc_data.ll_pcm_owner) {
+		mutex_unlock(&s_misc_data.ll_pcm_mutex);
+		return -EBUSY;
+	}
+
+	memset_io(ctrl, 0, HIFI_LL_PCM_TOTAL_SIZE);
+	writel(para.rate, &ctrl->rate);
+	writel(para.channels, &ctrl->channels);
+	writel(para.bits, &ctrl->bits);
+	writel(para.period_bytes, &ctrl->period_bytes);
+	for (dir = 0; dir < HIFI_LL_PCM_DIR_MAX; dir++) {
+		writel(HIFI_LL_PCM_CTRL_SIZE + dir * HIFI_LL_PCM_RING_SIZE,
+			&ctrl->ring[dir].buf_offset);
+		/* whole periods only, so a period never wraps */
+		writel(HIFI_LL_PCM_RING_SIZE - HIFI_LL_PCM_RING_SIZE % para.period_bytes,
+			&ctrl->ring[dir].buf_size);
+	}
+	writel(HIFI_LL_PCM_RUNNING, &ctrl->state);
+	writel(HIFI_LL_PCM_MAGIC, &ctrl->magic);
+	wmb();
+
+	ret = hifi_ll_pcm_send(ID_AP_AUDIO_LL_PCM_START_CMD);
+	if (OK == ret)
+		s_misc_data.ll_pcm_owner = fd;
+	else
+		writel(HIFI_LL_PCM_STOPPED, &ctrl->state);
+	mutex_unlock(&s_misc_data.ll_pcm_mutex);
+
+	logi("ll pcm start: rate %u channels %u bits %u period %u, ret %d\n",
+		para.rate, para.channels, para.bits, para.period_bytes, ret);
+
+	return ret;
+}
+
+static int hifi_dsp_ll_pcm_stop(struct file *fd)
+{
+	int ret = OK;
+
+	mutex_lock(&s_misc_data.ll_pcm_mutex);
+	if (s_misc_data.ll_pcm_owner == fd)
+		hifi_ll_pcm_do_stop();
+	else
+		ret = -EPERM;
+	mutex_unlock(&s_misc_data.ll_pcm_mutex);
+
+	return ret;
+}
+
 /*****************************************************************************
      : hifi_misc_open
    : Hifi MISC 豸򿪲
@@ -1099,6 +1217,7 @@ static int hifi_misc_open(struct inode *finode, struct file *fd)
 static int hifi_misc_release(struct inode *finode, struct file *fd)
 {
 	logi("close device.\n");
+	(void)hifi_dsp_ll_pcm_stop(fd);
 	return OK;
 }
 
@@ -1201,6 +1320,14 @@ static long hifi_misc_ioctl(struct file *fd,
 			logi("ioctl: HIFI_MISC_IOCTL_WAKEUP_PCM_READ_THREAD.\n");
 			ret = hifi_dsp_wakeup_pcm_read_thread((unsigned long)data32);
 			break;
+		case HIFI_MISC_IOCTL_LL_PCM_START:
+			logi("ioctl: HIFI_MISC_IOCTL_LL_PCM_START.\n");
+			ret = hifi_dsp_ll_pcm_start(fd, (unsigned long)data32);
+			break;
+		case HIFI_MISC_IOCTL_LL_PCM_STOP:
+			logi("ioctl: HIFI_MISC_IOCTL_LL_PCM_STOP.\n");
+			ret = hifi_dsp_ll_pcm_stop(fd);
+			break;
 		default:
 			/*ӡ޸CMD*/
 			ret = (long)ERROR;
@@ -1232,8 +1359,20 @@ static int hifi_misc_mmap(struct file *file, struct vm_area_struct *vma)
 		return ERROR;
 	}
 
-	phys_page_addr = (u64)s_misc_data.hifi_priv_base_phy >> PAGE_SHIFT;
 	size = ((unsigned long)vma->vm_end - (unsigned long)vma->vm_start);
+
+	/* the low latency PCM rings, see struct hifi_ll_pcm_ctrl */
+	if (vma->vm_pgoff == (HIFI_LL_PCM_MMAP_OFFSET >> PAGE_SHIFT)) {
+		if (size > HIFI_LL_PCM_TOTAL_SIZE) {
+			loge("ll pcm mmap size %lu too large\n", size);
+			return -EINVAL;
+		}
+		vma->vm_page_prot = pgprot_writecombine(PAGE_SHARED);
+		return remap_pfn_range(vma, vma->vm_start,
+				HIFI_LL_PCM_ADDR >> PAGE_SHIFT, size, vma->vm_page_prot);
+	}
+
+	phys_page_addr = (u64)s_misc_data.hifi_priv_base_phy >> PAGE_SHIFT;
 	logd("vma=0x%pK.\n", vma);
 	logd("size=%ld, vma->vm_start=%ld, end=%ld.\n", ((unsigned long)vma->vm_end - (unsigned long)vma->vm_start),
 		 (unsigned long)vma->vm_start, (unsigned long)vma->vm_end);
@@ -1686,6 +1825,7 @@ static int hifi_misc_probe (struct platform_device *pdev)
 	memset(&s_misc_data, 0, sizeof(struct hifi_misc_priv));
 
 	s_misc_data.dev = &pdev->dev;
+	mutex_init(&s_misc_data.ll_pcm_mutex);
 
 	/* Register to get PM events */
 	s_hifi_sr_nb.notifier_call = hifi_sr_event;
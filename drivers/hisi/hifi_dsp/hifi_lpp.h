@@ -122,6 +122,13 @@ extern "C" {
 #define HIFI_PCM_UPLOAD_BUFFER_ADDR     (CODEC_DSP_SOUNDTRIGGER_BASE_ADDR + CODEC_DSP_SOUNDTRIGGER_TOTAL_SIZE)
 #define HIFI_UNSEC_RESERVE_ADDR         (HIFI_PCM_UPLOAD_BUFFER_ADDR + HIFI_PCM_UPLOAD_BUFFER_SIZE)
 
+/* low latency PCM rings: a control page and one ring per direction, at the
+ * head of the unsec reserve, mapped to userspace at HIFI_LL_PCM_MMAP_OFFSET */
+#define HIFI_LL_PCM_CTRL_SIZE           (0x1000)
+#define HIFI_LL_PCM_RING_SIZE           (0x8000)
+#define HIFI_LL_PCM_TOTAL_SIZE          (HIFI_LL_PCM_CTRL_SIZE + HIFI_LL_PCM_DIR_MAX * HIFI_LL_PCM_RING_SIZE)
+#define HIFI_LL_PCM_ADDR                (HIFI_UNSEC_RESERVE_ADDR)
+
 #define HIFI_OM_LOG_SIZE                (0xA000)
 #define HIFI_OM_LOG_ADDR                (DRV_DSP_UART_TO_MEM - HIFI_OM_LOG_SIZE)
 #define HIFI_DUMP_BIN_SIZE              (HIFI_UNSEC_RESERVE_ADDR - HIFI_OM_LOG_ADDR)
@@ -289,6 +296,9 @@ typedef enum HIFI_MSG_ID_ {
 
 	ID_AP_ENABLE_MODEM_LOOP_REQ         = 0xDDCD,/* the audio hal notify HIFI to start/stop  MODEM LOOP*/
 	ID_AUDIO_AP_3A_CMD                  = 0xDDCE,
+	/* low latency PCM rings, see struct hifi_ll_pcm_ctrl */
+	ID_AP_AUDIO_LL_PCM_START_CMD        = 0xDDD0,
+	ID_AP_AUDIO_LL_PCM_STOP_CMD         = 0xDDD1,
 	ID_AP_HIFI_REQUEST_VOICE_PARA_REQ   = 0xDF00, /*AP REQUEST VOICE MSG*/
 	ID_HIFI_AP_REQUEST_VOICE_PARA_CNF   = 0xDF01, /*HIFI REPLAY VOICE MSG*/
 } HIFI_MSG_ID;
@@ -343,6 +353,13 @@ typedef struct {
 	audio_vote_ddr_freq_stru *pst_vote_ddr_freq;  /* DDRƵб,ɱ䳤,ȼuhwDdrFreqCount */
 } audio_cpu_load_cfg_stru;
 
+struct hifi_ll_pcm_cmd {
+	unsigned short msg_id;
+	unsigned short reserve;
+	unsigned int   ctrl_addr_l;   /* physical address of struct hifi_ll_pcm_ctrl */
+	unsigned int   ctrl_addr_h;
+};
+
 struct drv_fama_config {
 	unsigned int head_magic;
 	unsigned int flag;
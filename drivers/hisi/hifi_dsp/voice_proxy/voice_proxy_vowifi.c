@@ -19,6 +19,9 @@
  */
 
 #include <linux/miscdevice.h>
+#include <linux/vmalloc.h>
+#include <linux/poll.h>
+#include <linux/mm.h>
 #include "voice_proxy.h"
 
 /*lint -e528 -e753 */
@@ -28,6 +31,33 @@
 
 #define VOICE_PROXY_WAKE_UP_VOWIFI_READ  _IO('P',  0x1)
 
+/*
+ * tx frame ring shared with the reader through mmap, it must hold more
+ * frames than the list of the read path
+ */
+#define VOWIFI_RING_SLOTS 64
+
+struct vowifi_ring_slot {
+	int32_t size;
+	int8_t data[VOICE_PROXY_LIMIT_PARAM_SIZE];
+};
+
+/*
+ * head is only written by the driver and tail only by the reader. Once
+ * mapped, the tx frames from hifi are stored here instead of the read
+ * list, and the reader is only woken up when the ring was empty: it is
+ * expected to drain every slot up to head, then store tail and poll.
+ */
+struct vowifi_ring {
+	uint32_t head;
+	uint32_t tail;
+	uint32_t slot_num;
+	uint32_t slot_size;
+	struct vowifi_ring_slot slot[VOWIFI_RING_SLOTS];
+};
+
+#define VOWIFI_RING_SIZE PAGE_ALIGN(sizeof(struct vowifi_ring))
+
 #ifndef UNUSED_PARAMETER
 #define UNUSED_PARAMETER(x) (void)(x)
 #endif
@@ -59,6 +89,11 @@ struct vowifi_priv {
 
 	/* this handle is get from voice proxy when register sign init callback*/
 	int32_t sign_handle;
+
+	/* tx frame ring, used instead of send_vowifi_tx_queue once mapped*/
+	struct vowifi_ring *ring;
+	bool ring_mapped;
+	uint32_t ring_drops;
 };
 
 static struct vowifi_priv priv;
@@ -70,6 +105,40 @@ static void vowifi_sign_init(void)
 	priv.first_vowifi_rx = true;
 }
 
+static int32_t vowifi_ring_add_tx_data(int8_t *rev_buf, uint32_t buf_size)
+{
+	struct vowifi_ring *ring = priv.ring;
+	struct vowifi_ring_slot *slot;
+	uint32_t head, tail;
+
+	if (buf_size > VOICE_PROXY_LIMIT_PARAM_SIZE)
+		return -EINVAL;
+
+	spin_lock_bh(&priv.vowifi_read_lock);
+	head = ring->head;
+	tail = ACCESS_ONCE(ring->tail);
+	if (head - tail >= VOWIFI_RING_SLOTS) {
+		priv.ring_drops++;
+		spin_unlock_bh(&priv.vowifi_read_lock);
+		wake_up(&priv.vowifi_read_waitq);
+		return -ENOMEM;
+	}
+
+	slot = &ring->slot[head % VOWIFI_RING_SLOTS];
+	memcpy(slot->data, rev_buf, buf_size);
+	slot->size = (int32_t)buf_size;
+	/* the slot must be visible before the reader sees the new head */
+	smp_wmb();
+	ring->head = head + 1;
+	spin_unlock_bh(&priv.vowifi_read_lock);
+
+	/* a reader behind on the ring polls again before it sleeps */
+	if (head == tail)
+		wake_up(&priv.vowifi_read_waitq);
+
+	return 0;
+}
+
 static int32_t vowifi_add_tx_data(int8_t *rev_buf, uint32_t buf_size)
 {
 	int32_t ret;
@@ -77,6 +146,9 @@ static int32_t vowifi_add_tx_data(int8_t *rev_buf, uint32_t buf_size)
 
 	BUG_ON(NULL == rev_buf);/*lint !e730*/
 
+	if (priv.ring_mapped)
+		return vowifi_ring_add_tx_data(rev_buf, buf_size);
+
 	if (priv.vowifi_tx_cnt > VOICE_PROXY_QUEUE_SIZE_MAX) {
 		/*loge("out of queue, vowifi_tx_cnt(%d)>QUEUE_SIZE_MAX(%d)\n",
 			 priv.vowifi_tx_cnt, VOICE_PROXY_QUEUE_SIZE_MAX);*/
@@ -387,6 +459,50 @@ static long vowifi_ioctl(struct file *fd, unsigned int cmd, unsigned long arg)
 	return (long)ret;
 }
 
+static int vowifi_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	int ret;
+
+	UNUSED_PARAMETER(file);
+
+	if (vma->vm_pgoff || vma->vm_end - vma->vm_start > VOWIFI_RING_SIZE)
+		return -EINVAL;
+
+	/* the reader only ever stores tail, through the mapping */
+	ret = remap_vmalloc_range(vma, priv.ring, 0);
+	if (ret) {
+		loge("remap vowifi ring fail, %d\n", ret);
+		return ret;
+	}
+
+	spin_lock_bh(&priv.vowifi_read_lock);
+	priv.ring->head = 0;
+	priv.ring->tail = 0;
+	priv.ring_mapped = true;
+	spin_unlock_bh(&priv.vowifi_read_lock);
+
+	logi("vowifi tx ring mapped, slots:%d\n", VOWIFI_RING_SLOTS);
+	return 0;
+}
+
+static unsigned int vowifi_poll(struct file *file, poll_table *wait)
+{
+	unsigned int mask = 0;
+
+	poll_wait(file, &priv.vowifi_read_waitq, wait);
+
+	spin_lock_bh(&priv.vowifi_read_lock);
+	if (priv.ring_mapped) {
+		if (priv.ring->head != ACCESS_ONCE(priv.ring->tail))
+			mask |= POLLIN | POLLRDNORM;
+	} else if (!list_empty_careful(&send_vowifi_tx_queue)) {
+		mask |= POLLIN | POLLRDNORM;
+	}
+	spin_unlock_bh(&priv.vowifi_read_lock);
+
+	return mask;
+}
+
 static int vowifi_open(struct inode *finode, struct file *fd)
 {
 	//logi("Enter %s\n", __FUNCTION__);
@@ -406,6 +522,11 @@ static int vowifi_close(struct inode *node, struct file *filp)
 
 	spin_lock_bh(&priv.vowifi_read_lock);
 	priv.vowifi_read_wait_flag++;
+	if (priv.ring_mapped) {
+		logi("vowifi tx ring unmapped, drops:%u\n", priv.ring_drops);
+		priv.ring_mapped = false;
+		priv.ring_drops = 0;
+	}
 	spin_unlock_bh(&priv.vowifi_read_lock);
 	wake_up(&priv.vowifi_read_waitq);
 	return 0;
@@ -417,6 +538,8 @@ static const struct file_operations vowifi_misc_fops = {
 	.read = vowifi_read,
 	.write = vowifi_write,
 	.release = vowifi_close,
+	.mmap = vowifi_mmap,
+	.poll = vowifi_poll,
 	.unlocked_ioctl = vowifi_ioctl,
 	.compat_ioctl   = vowifi_ioctl,
 };/*lint !e785*/
@@ -441,9 +564,19 @@ static int vowifi_probe(struct platform_device *pdev)
 	spin_lock_init(&priv.vowifi_read_lock);
 	init_waitqueue_head(&priv.vowifi_read_waitq);
 
+	priv.ring = vmalloc_user(VOWIFI_RING_SIZE);
+	if (NULL == priv.ring) {
+		loge("vowifi ring vmalloc fail\n");
+		return -ENOMEM;
+	}
+	priv.ring->slot_num = VOWIFI_RING_SLOTS;
+	priv.ring->slot_size = sizeof(struct vowifi_ring_slot);
+
 	ret = misc_register(&vowifi_misc_device);
 	if (ret) {
 		loge("vowifi misc register fail\n");
+		vfree(priv.ring);
+		priv.ring = NULL;
 		return ret;
 	}
 
@@ -482,6 +615,9 @@ static int vowifi_remove(struct platform_device *pdev)
 
 	voice_proxy_deregister_sign_init_callback(priv.sign_handle);
 
+	vfree(priv.ring);
+	priv.ring = NULL;
+
 	return 0;
 }
 
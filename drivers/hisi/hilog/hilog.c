@@ -35,6 +35,9 @@
 #include <linux/ioctl.h>
 #include <asm/ioctls.h>
 #include <linux/hardirq.h>
+#include <linux/percpu.h>
+#include <linux/lglock.h>
+#include <linux/workqueue.h>
 
 #include <linux/hisi/hilog.h>
 
@@ -55,6 +58,7 @@
 #define HILOG_FLUSH_REPORT                _IO(__HILOGIO, 4) /* flush hilog */
 #define HILOG_SWITCH_ON                   _IO(__HILOGIO, 5) /* turn on hilog */
 #define HILOG_SWITCH_OFF                  _IO(__HILOGIO, 6) /* turn off hilog */
+#define HILOG_WRITE_BATCH                 _IOW(__HILOGIO, 7, struct hilog_batch) /* write entries */
 
 #define HILOG_IOVEC_COUNT                 4
 
@@ -86,6 +90,65 @@ struct hilog_entry {
 #define HILOG_ENTRY_MAX_LEN               (4 * 1024)
 #define HILOG_ENTRY_MAX_PAYLOAD           (HILOG_ENTRY_MAX_LEN - sizeof(struct hilog_entry))
 
+/*
+ * Small entries are first staged in a per-cpu buffer, so that writers on
+ * different cpus do not serialize on dev->mutex. The stages are merged by
+ * timestamp into the ring buffer whenever somebody looks at the ring.
+ */
+#define HILOG_STAGE_SIZE                  (4 * 1024)
+#define HILOG_STAGE_ENTRY_MAX             (512)
+#define HILOG_STAGE_MAX_PAYLOAD           (HILOG_STAGE_ENTRY_MAX - sizeof(struct hilog_entry))
+#define HILOG_STAGE_ALIGN(len)            ALIGN(len, sizeof(__s32))
+
+/* blocked readers are woken at most once per HILOG_WAKEUP_DELAY */
+#define HILOG_WAKEUP_DELAY                msecs_to_jiffies(10)
+
+/* max entries accepted by one HILOG_WRITE_BATCH */
+#define HILOG_BATCH_MAX_ENTRIES           (64)
+#define HILOG_BATCH_CHUNK                 (16)
+
+/**
+ * struct hilog_batch_entry - one payload of a HILOG_WRITE_BATCH request.
+ *
+ * @msg:             User address of the payload
+ * @len:             The length of the payload
+ * @__pad:           Keeps the layout identical for 32 and 64 bit callers
+ */
+struct hilog_batch_entry {
+    __u64                           msg;
+    __u32                           len;
+    __u32                           __pad;
+};
+
+/**
+ * struct hilog_batch - argument of HILOG_WRITE_BATCH.
+ *
+ * @entries:         User address of an array of struct hilog_batch_entry
+ * @count:           The number of entries in the array
+ * @__pad:           Keeps the layout identical for 32 and 64 bit callers
+ */
+struct hilog_batch {
+    __u64                           entries;
+    __u32                           count;
+    __u32                           __pad;
+};
+
+/**
+ * struct hilog_stage - per-cpu staging area of hilog entries.
+ *
+ * @buf:        Entries in the same layout as the ring buffer, in time order
+ * @used:       Bytes used in @buf
+ * @pos:        Merge cursor, only valid while the stages are being drained
+ */
+struct hilog_stage {
+    unsigned char                   *buf;
+    __u32                           used;
+    __u32                           pos;
+};
+
+static DEFINE_PER_CPU(struct hilog_stage, hilog_stages);
+DEFINE_STATIC_LGLOCK(hilog_stage_lock);
+
 /**
  * struct hilog_device - represents a hilog device
  *
@@ -94,6 +157,7 @@ struct hilog_entry {
  * @wq:         The wait queue for @readers
  * @readers:    This hilog's readers
  * @mutex:      The mutex that protects the @buffer
+ * @wake_work:  Coalesces the wakeups of @wq
  * @w_off:      The current write head offset
  * @r_head:     The head, or location that readers start reading at
  * @size:       The size of the ring buffer
@@ -104,6 +168,7 @@ struct hilog_device {
     wait_queue_head_t               wq;
     struct list_head                readers;
     struct mutex                    mutex;
+    struct delayed_work             wake_work;
     __u32                           w_off;
     __u32                           r_head;
     __u32                           size;
@@ -274,6 +339,8 @@ static ssize_t do_read_hilog_to_user(struct hilog_device *dev,
     return count + get_user_hdr_len();
 }
 
+static void hilog_drain_stages(struct hilog_device *dev);
+
 /*
  * hilog_read - our hilog device's read() method
  *
@@ -299,6 +366,7 @@ start:
 
         prepare_to_wait(&dev->wq, &wait, TASK_INTERRUPTIBLE);
 
+        hilog_drain_stages(dev);
         ret = (dev->w_off == reader->r_off);
         mutex_unlock(&dev->mutex);
         if (!ret) {
@@ -546,92 +614,319 @@ static int calc_iovc_ki_left(const struct iovec *iov, int nr_segs)
     return ret;
 }
 
-#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,1,0))
 /*
- * hilog_write_iter - our write method, implementing support for write(),
- * writev(), and aio_write(). Writes are our fast path, and we try to optimize
- * them above all else.
+ * hilog_stamp_header - fill in the writer and the time of a new entry.
  */
-static ssize_t hilog_write_iter(struct kiocb *kiocb, struct iov_iter *from)
+static void hilog_stamp_header(struct hilog_entry *header)
 {
-    size_t orig = dev->w_off; // only for reset when write fail.
-    struct hilog_entry header;
-    struct timespec now;
-    ssize_t ret = 0;
+    struct timespec now = current_kernel_time();
+
+    header->__pad = 0;
+    header->pid = current->tgid;
+    header->tid = current->pid;
+    header->sec = now.tv_sec;
+    header->nsec = now.tv_nsec;
+}
+
+/*
+ * __hilog_drain_stages - merge the staged entries of all cpus into the ring
+ * buffer, oldest first, and empty the stages.
+ *
+ * The caller needs to hold dev->mutex and hilog_stage_lock globally.
+ */
+static void __hilog_drain_stages(struct hilog_device *dev)
+{
+    struct hilog_stage *stage;
+    int cpu;
 
-    now = current_kernel_time();
+    while (1) {
+        struct hilog_stage *from = NULL;
+        struct hilog_entry *next = NULL;
+        struct hilog_entry *entry;
+        struct iovec iov;
+
+        for_each_possible_cpu(cpu) {
+            stage = per_cpu_ptr(&hilog_stages, cpu);
+            if (stage->pos >= stage->used) {
+                continue;
+            }
+
+            entry = (struct hilog_entry *)(stage->buf + stage->pos);
+            if (!next || entry->sec < next->sec ||
+                    (entry->sec == next->sec && entry->nsec < next->nsec)) {
+                next = entry;
+                from = stage;
+            }
+        }
 
-    header.pid = current->tgid;
-    header.tid = current->pid;
-    header.sec = now.tv_sec;
-    header.nsec = now.tv_nsec;
-    header.len = min_t(size_t, calc_iovc_ki_left(from->iov, from->nr_segs), HILOG_ENTRY_MAX_PAYLOAD);
+        if (!next) {
+            break;
+        }
+
+        iov.iov_base = next->msg;
+        iov.iov_len = next->len;
+        do_write(next, &iov, 1, false);
+
+        from->pos += HILOG_STAGE_ALIGN(sizeof(struct hilog_entry) + next->len);
+    }
+
+    for_each_possible_cpu(cpu) {
+        stage = per_cpu_ptr(&hilog_stages, cpu);
+        stage->used = 0;
+        stage->pos = 0;
+    }
+}
+
+/*
+ * hilog_drain_stages - make every staged entry visible to the readers.
+ *
+ * The caller needs to hold dev->mutex.
+ */
+static void hilog_drain_stages(struct hilog_device *dev)
+{
+    lg_global_lock(&hilog_stage_lock);
+    __hilog_drain_stages(dev);
+    lg_global_unlock(&hilog_stage_lock);
+}
+
+/*
+ * hilog_stage_entry - append an entry to this cpu's stage. The entry is
+ * stamped under the stage lock, so every stage stays sorted by time.
+ *
+ * Returns false if the stage has no room left for the entry.
+ */
+static bool hilog_stage_entry(struct hilog_entry *header, const void *msg)
+{
+    size_t size = HILOG_STAGE_ALIGN(sizeof(struct hilog_entry) + header->len);
+    struct hilog_stage *stage;
+    bool staged = false;
+
+    lg_local_lock(&hilog_stage_lock);
+    stage = this_cpu_ptr(&hilog_stages);
+    if (stage->used + size <= HILOG_STAGE_SIZE) {
+        hilog_stamp_header(header);
+        memcpy(stage->buf + stage->used, header, sizeof(struct hilog_entry));
+        memcpy(stage->buf + stage->used + sizeof(struct hilog_entry),
+            msg, header->len);
+        stage->used += size;
+        staged = true;
+    }
+    lg_local_unlock(&hilog_stage_lock);
+
+    return staged;
+}
+
+/*
+ * hilog_copy_payload - gather the first 'count' bytes of an iovec into 'buf'.
+ */
+static int hilog_copy_payload(void *buf, const struct iovec *iov,
+                              unsigned long nr_segs, size_t count, bool from_user)
+{
+    size_t done = 0;
+
+    while (nr_segs-- > 0 && done < count) {
+        size_t len = min_t(size_t, iov->iov_len, count - done);
+
+        if (from_user) {
+            if (copy_from_user(buf + done, iov->iov_base, len)) {
+                return -EFAULT;
+            }
+        } else {
+            memcpy(buf + done, iov->iov_base, len);
+        }
+
+        iov++;
+        done += len;
+    }
+
+    return 0;
+}
+
+/*
+ * hilog_write_entry - write one entry whose payload is the first 'count'
+ * bytes of the iovec. Small entries go to this cpu's stage, large ones
+ * are written to the ring buffer directly, after the stages were drained
+ * so that the ring stays ordered by time.
+ *
+ * Readers are not woken up, see hilog_kick_readers().
+ */
+static ssize_t hilog_write_entry(const struct iovec *iov, unsigned long nr_segs,
+                                 size_t count, bool from_user)
+{
+    char msg[HILOG_STAGE_MAX_PAYLOAD];
+    struct hilog_entry header;
+    struct iovec kiov;
+    size_t orig;
+    ssize_t ret;
 
     /* null writes succeed, return zero */
-    if (unlikely(!header.len)) {
+    if (unlikely(!count)) {
         return 0;
     }
 
+    header.len = count;
+
+    if (count <= HILOG_STAGE_MAX_PAYLOAD) {
+        ret = hilog_copy_payload(msg, iov, nr_segs, count, from_user);
+        if (unlikely(ret)) {
+            return ret;
+        }
+
+        if (hilog_stage_entry(&header, msg)) {
+            return count;
+        }
+
+        /* the stage is full, flush it and retry once */
+        mutex_lock(&dev->mutex);
+        hilog_drain_stages(dev);
+        mutex_unlock(&dev->mutex);
+
+        if (hilog_stage_entry(&header, msg)) {
+            return count;
+        }
+
+        kiov.iov_base = msg;
+        kiov.iov_len = count;
+        iov = &kiov;
+        nr_segs = 1;
+        from_user = false;
+    }
+
     mutex_lock(&dev->mutex);
 
-    ret = do_write(&header, from->iov, from->nr_segs, true);
+    lg_global_lock(&hilog_stage_lock);
+    __hilog_drain_stages(dev);
+    hilog_stamp_header(&header);
+    lg_global_unlock(&hilog_stage_lock);
 
+    orig = dev->w_off; // only for reset when write fail.
+    ret = do_write(&header, iov, nr_segs, from_user);
     if (unlikely(ret < 0)) {
         dev->w_off = orig;
-        mutex_unlock(&dev->mutex);
-        return ret;
     }
 
     mutex_unlock(&dev->mutex);
 
-    /* wake up any blocked readers */
+    return ret;
+}
+
+/*
+ * hilog_kick_readers - wake up blocked readers. Wakeups are deferred by
+ * HILOG_WAKEUP_DELAY, so a burst of writes costs a single wakeup.
+ */
+static void hilog_kick_readers(struct hilog_device *dev)
+{
+    /* pairs with set_current_state() in prepare_to_wait() */
+    smp_mb();
+    if (waitqueue_active(&dev->wq)) {
+        schedule_delayed_work(&dev->wake_work, HILOG_WAKEUP_DELAY);
+    }
+}
+
+static void hilog_wake_work(struct work_struct *work)
+{
+    struct hilog_device *dev = container_of(to_delayed_work(work),
+        struct hilog_device, wake_work);
+
     wake_up_interruptible(&dev->wq);
+}
+
+/*
+ * hilog_write_batch - write up to HILOG_BATCH_MAX_ENTRIES entries with a
+ * single syscall and a single reader wakeup.
+ *
+ * Returns the number of entries written, negative error code if none was.
+ */
+static long hilog_write_batch(struct hilog_device *dev,
+                              const struct hilog_batch __user *ubatch)
+{
+    struct hilog_batch_entry entries[HILOG_BATCH_CHUNK];
+    const struct hilog_batch_entry __user *uentries;
+    struct hilog_batch batch;
+    struct iovec iov;
+    __u32 done = 0;
+    long ret = 0;
+
+    if (copy_from_user(&batch, ubatch, sizeof(batch))) {
+        return -EFAULT;
+    }
+
+    if (batch.count > HILOG_BATCH_MAX_ENTRIES) {
+        return -EINVAL;
+    }
+
+    uentries = (const struct hilog_batch_entry __user *)(uintptr_t)batch.entries;
+
+    while (done < batch.count) {
+        __u32 nr = min_t(__u32, batch.count - done, HILOG_BATCH_CHUNK);
+        __u32 i;
+
+        if (copy_from_user(entries, uentries + done, nr * sizeof(entries[0]))) {
+            ret = -EFAULT;
+            break;
+        }
+
+        for (i = 0; i < nr; i++) {
+            iov.iov_base = (void __user *)(uintptr_t)entries[i].msg;
+            iov.iov_len = entries[i].len;
+
+            ret = hilog_write_entry(&iov, 1, min_t(size_t, entries[i].len,
+                HILOG_ENTRY_MAX_PAYLOAD), true);
+            if (unlikely(ret < 0)) {
+                goto out;
+            }
+            done++;
+        }
+    }
+
+out:
+    if (done) {
+        hilog_kick_readers(dev);
+        return done;
+    }
 
     return ret;
 }
 
-#else
-
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,1,0))
 /*
- * hilog_aio_write - our write method, implementing support for write(),
+ * hilog_write_iter - our write method, implementing support for write(),
  * writev(), and aio_write(). Writes are our fast path, and we try to optimize
  * them above all else.
  */
-static ssize_t hilog_aio_write(struct kiocb *iocb, const struct iovec *iov,
-             unsigned long nr_segs, loff_t ppos)
+static ssize_t hilog_write_iter(struct kiocb *kiocb, struct iov_iter *from)
 {
-    size_t orig = dev->w_off; // only for reset when write fail.
-    struct hilog_entry header;
-    struct timespec now;
-    ssize_t ret = 0;
-
-    now = current_kernel_time();
+    ssize_t ret;
 
-    header.pid = current->tgid;
-    header.tid = current->pid;
-    header.sec = now.tv_sec;
-    header.nsec = now.tv_nsec;
-    header.len = min_t(size_t, iocb->ki_left, HILOG_ENTRY_MAX_PAYLOAD);
+    ret = hilog_write_entry(from->iov, from->nr_segs,
+        min_t(size_t, calc_iovc_ki_left(from->iov, from->nr_segs),
+        HILOG_ENTRY_MAX_PAYLOAD), true);
 
-    /* null writes succeed, return zero */
-    if (unlikely(!header.len)) {
-        return 0;
+    if (ret > 0) {
+        hilog_kick_readers(dev);
     }
 
-    mutex_lock(&dev->mutex);
+    return ret;
+}
 
-    ret = do_write(&header, iov, nr_segs, true);
+#else
 
-    if (unlikely(ret < 0)) {
-        dev->w_off = orig;
-        mutex_unlock(&dev->mutex);
-        return ret;
-    }
+/*
+ * hilog_aio_write - our write method, implementing support for write(),
+ * writev(), and aio_write(). Writes are our fast path, and we try to optimize
+ * them above all else.
+ */
+static ssize_t hilog_aio_write(struct kiocb *iocb, const struct iovec *iov,
+             unsigned long nr_segs, loff_t ppos)
+{
+    ssize_t ret;
 
-    mutex_unlock(&dev->mutex);
+    ret = hilog_write_entry(iov, nr_segs,
+        min_t(size_t, iocb->ki_left, HILOG_ENTRY_MAX_PAYLOAD), true);
 
-    /* wake up any blocked readers */
-    wake_up_interruptible(&dev->wq);
+    if (ret > 0) {
+        hilog_kick_readers(dev);
+    }
 
     return ret;
 }
@@ -720,6 +1015,7 @@ static unsigned int hilog_poll(struct file *file, poll_table *wait)
     poll_wait(file, &dev->wq, wait);
 
     mutex_lock(&dev->mutex);
+    hilog_drain_stages(dev);
     if (dev->w_off != reader->r_off) {
         ret |= POLLIN | POLLRDNORM;
     }
@@ -736,7 +1032,15 @@ static long hilog_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
     struct hilog_reader *reader;
     long ret = -EINVAL;
 
+    if (cmd == HILOG_WRITE_BATCH) {
+        if (!(file->f_mode & FMODE_WRITE)) {
+            return -EBADF;
+        }
+        return hilog_write_batch(dev, (const struct hilog_batch __user *)arg);
+    }
+
     mutex_lock(&dev->mutex);
+    hilog_drain_stages(dev);
 
     switch (cmd) {
     case HILOG_SWITCH_ON:
@@ -827,6 +1131,40 @@ static const struct file_operations hilog_fops = {
     .release = hilog_release,
 };
 
+/*
+ * free the per-cpu stages, safe on partially allocated ones.
+ */
+static void free_hilog_stages(void)
+{
+    int cpu;
+
+    for_each_possible_cpu(cpu) {
+        struct hilog_stage *stage = per_cpu_ptr(&hilog_stages, cpu);
+
+        kfree(stage->buf);
+        stage->buf = NULL;
+    }
+}
+
+static int alloc_hilog_stages(void)
+{
+    int cpu;
+
+    for_each_possible_cpu(cpu) {
+        struct hilog_stage *stage = per_cpu_ptr(&hilog_stages, cpu);
+
+        stage->buf = kmalloc(HILOG_STAGE_SIZE, GFP_KERNEL);
+        if (!stage->buf) {
+            free_hilog_stages();
+            return -ENOMEM;
+        }
+        stage->used = 0;
+        stage->pos = 0;
+    }
+
+    return 0;
+}
+
 /*
  * Create a hilog device of misc type, register it to system,
  * and assign it a ring buffer which size is HILOG_BUFFER_SIZE.
@@ -841,6 +1179,13 @@ static ssize_t create_hilog_dev(void)
         return -ENOMEM;
     }
 
+    if (alloc_hilog_stages()) {
+        vfree(buffer);
+        return -ENOMEM;
+    }
+
+    lg_lock_init(&hilog_stage_lock, "hilog_stage_lock");
+
     printk(KERN_ALERT"Initializing hilog device, buffer size: %luK.\n", \
         (unsigned long) HILOG_BUFFER_SIZE >> 10);
 
@@ -869,6 +1214,7 @@ static ssize_t create_hilog_dev(void)
     INIT_LIST_HEAD(&dev->readers);
 
     mutex_init(&dev->mutex);
+    INIT_DELAYED_WORK(&dev->wake_work, hilog_wake_work);
     dev->w_off = 0;
     dev->r_head = 0;
     dev->size = HILOG_BUFFER_SIZE;
@@ -894,6 +1240,7 @@ out_free_dev:
     dev = NULL;
 
 out_free_buffer:
+    free_hilog_stages();
     vfree(buffer);
     buffer = NULL;
 
@@ -926,6 +1273,8 @@ static void __exit hilog_exit(void)
     /* delete char device and free memory */
     if(dev) {
         misc_deregister(&dev->misc);
+        cancel_delayed_work_sync(&dev->wake_work);
+        free_hilog_stages();
         vfree(dev->buffer);
         dev->buffer = NULL;
         kfree(dev->misc.name);
@@ -942,8 +1291,6 @@ extern int __hi_log_print(const size_t pri, const char* module, const char* sub_
                            const char* fmt, ...)
 {
     int ret = 0;
-    struct hilog_entry header;
-    struct timespec now;
     struct iovec vec[HILOG_IOVEC_COUNT];
     struct iovec *iov = vec;
     int nr_segs = sizeof(vec) / sizeof(vec[0]);
@@ -951,7 +1298,6 @@ extern int __hi_log_print(const size_t pri, const char* module, const char* sub_
     unsigned char prio = (unsigned char)pri;
     va_list ap;
     char msg[DEFAULT_FORMATTED_LEN + 1] = {0};
-    size_t orig = 0; // only for reset when write fail.
 
     if (pri > HI_LOG_SILENT) {
         printk(KERN_ALERT"Priority is invalid!\n");
@@ -969,8 +1315,6 @@ extern int __hi_log_print(const size_t pri, const char* module, const char* sub_
         return ret;
     }
 
-    orig = dev->w_off;
-
     va_start(ap, fmt);
     vsnprintf(msg, DEFAULT_FORMATTED_LEN, fmt, ap);
     va_end(ap);
@@ -998,34 +1342,15 @@ extern int __hi_log_print(const size_t pri, const char* module, const char* sub_
     vec[3].iov_base   = (void *)msg;
     vec[3].iov_len    = strlen(msg) + 1;
 
-    now = current_kernel_time();
     iovc_ki_left_len = calc_iovc_ki_left(vec, nr_segs);
 
-    header.pid = current->tgid;
-    header.tid = current->pid;
-    header.sec = now.tv_sec;
-    header.nsec = now.tv_nsec;
-    header.len = min(iovc_ki_left_len, (int)DEFAULT_FORMATTED_LEN);
-
-    /* null writes succeed, return zero */
-    if (unlikely(!header.len)) {
-        return ret;
-    }
-
-    mutex_lock(&dev->mutex);
-
-    ret = do_write(&header, iov, nr_segs, false);
-
-    if (unlikely(ret < 0)) {
-        dev->w_off = orig;
-        mutex_unlock(&dev->mutex);
-        return ret;
-    }
-
-    mutex_unlock(&dev->mutex);
+    ret = hilog_write_entry(iov, nr_segs,
+        min(iovc_ki_left_len, (int)DEFAULT_FORMATTED_LEN), false);
 
     /* wake up any blocked readers */
-    wake_up_interruptible(&dev->wq);
+    if (ret > 0) {
+        hilog_kick_readers(dev);
+    }
 
     return ret;
 }
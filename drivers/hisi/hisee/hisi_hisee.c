@@ -33,6 +33,7 @@
 #include <linux/hisi/kirin_partition.h>
 #include <linux/clk.h>
 #include <linux/mm.h>
+#include <linux/ktime.h>
 #include "soc_acpu_baseaddr_interface.h"
 #include "soc_sctrl_interface.h"
 #include "hisi_hisee.h"
@@ -844,14 +845,34 @@ static void set_message_header(atf_message_header *header, unsigned int cmd_type
 	return;
 }
 
+/* called with hisee_mutex held */
+static void hisee_account_smc_latency(se_smc_cmd smc_cmd, ktime_t start, int ret)
+{
+	hisee_smc_latency *lat;
+	unsigned int us;
+
+	if ((unsigned int)smc_cmd >= CMD_END)
+		return;
+	lat = &g_hisee_data.smc_latency[smc_cmd];
+	us = (unsigned int)ktime_us_delta(ktime_get(), start);
+	lat->count++;
+	if (HISEE_OK != ret)
+		lat->failed++;
+	lat->total_us += us;
+	if (us > lat->max_us)
+		lat->max_us = us;
+}
+
 static int send_smc_process(atf_message_header *p_message_header, phys_addr_t phy_addr, unsigned int size,
 							unsigned int timeout, se_smc_cmd smc_cmd)
 {
 	int ret = HISEE_OK;
 	long local_jiffies;
+	ktime_t start;
 
 	mutex_lock(&g_hisee_data.hisee_mutex);
 	g_hisee_data.smc_cmd_running = 1;
+	start = ktime_get();
 
 	if (CMD_HISEE_CHANNEL_TEST != smc_cmd)
 		ret = atfd_hisee_smc((u64)HISEE_FN_MAIN_SERVICE_CMD, (u64)smc_cmd, (u64)phy_addr, (u64)size);
@@ -859,6 +880,7 @@ static int send_smc_process(atf_message_header *p_message_header, phys_addr_t ph
 		ret = atfd_hisee_smc((u64)HISEE_FN_CHANNEL_TEST_CMD, (u64)smc_cmd, (u64)phy_addr, (u64)size);
 	if (ret != HISEE_OK) {
 		pr_err("%s(): atfd_hisee_smc failed, ret=%d\n", __func__, ret);
+		hisee_account_smc_latency(smc_cmd, start, ret);
 		g_hisee_data.smc_cmd_running = 0;
 		mutex_unlock(&g_hisee_data.hisee_mutex);
 		set_errno_and_return(HISEE_FIRST_SMC_CMD_ERROR);
@@ -902,6 +924,7 @@ static int send_smc_process(atf_message_header *p_message_header, phys_addr_t ph
 	}
 
 	pr_err("%s() ret=%d\n", __func__, ret);
+	hisee_account_smc_latency(smc_cmd, start, ret);
 	g_hisee_data.smc_cmd_running = 0;
 	mutex_unlock(&g_hisee_data.hisee_mutex);
 	return ret;
@@ -1098,13 +1121,17 @@ static int send_apdu_cmd(int type)
 	}
 
 	/* send apdu key command */
+	mutex_lock(&g_hisee_data.apdu_mutex);
 	ret = write_apdu_command_func((char *)sel_cmd[0], sel_cmd_len[0]);
+	mutex_unlock(&g_hisee_data.apdu_mutex);
 	if (HISEE_OK != ret) {
 		pr_err("%s()  apdu0 failed,ret=%d\n", __func__, ret);
 		return ret;
 	}
 	hisee_mdelay(DELAY_BETWEEN_STEPS);
+	mutex_lock(&g_hisee_data.apdu_mutex);
 	ret = write_apdu_command_func((char *)sel_cmd[1], sel_cmd_len[1]);
+	mutex_unlock(&g_hisee_data.apdu_mutex);
 	if (HISEE_OK != ret) {
 		pr_err("%s()  apdu1 failed,ret=%d\n", __func__, ret);
 		return ret;
@@ -2652,11 +2679,13 @@ static int write_apdu_command_func (char *apdu_buf, int apdu_len)
 static ssize_t hisee_apdu_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
 	int ret = 0;
+	ssize_t len;
 
 	if (NULL == buf) {
 		pr_err("%s buf paramters is null\n", __func__);
 		set_errno_and_return(HISEE_INVALID_PARAMS);
 	}
+	mutex_lock(&g_hisee_data.apdu_mutex);
 	if (HISEE_APDU_DATA_LEN_MAX < g_hisee_data.apdu_ack.ack_len) {
 		pr_err("%s BUG_ON\n", __func__);
 		BUG_ON(1);/*lint !e730*/
@@ -2675,8 +2704,10 @@ static ssize_t hisee_apdu_show(struct device *dev, struct device_attribute *attr
 		memcpy(buf, g_hisee_data.apdu_ack.ack_buf, (u64)g_hisee_data.apdu_ack.ack_len);
 		buf[g_hisee_data.apdu_ack.ack_len] = 0;
 	}
+	len = (ssize_t)g_hisee_data.apdu_ack.ack_len;
+	mutex_unlock(&g_hisee_data.apdu_mutex);
 
-	return (ssize_t)g_hisee_data.apdu_ack.ack_len;
+	return len;
 }/*lint !e715*/
 
 /** write the apdu command function, size is 0--261 bytes
@@ -2711,7 +2742,9 @@ static ssize_t hisee_apdu_store(struct device *dev, struct device_attribute *att
 	for (i = 0; i < count; i++)
 		pr_err("[%3d]:%x\n", i, buf[i]);
 #endif
+	mutex_lock(&g_hisee_data.apdu_mutex);
 	ret = write_apdu_command_func((char *)buf, (int)count);
+	mutex_unlock(&g_hisee_data.apdu_mutex);
 	if (ret !=  HISEE_OK) {
 		record_hisee_log_by_dmd(DSM_NFC_HISEE_APDU_COMMAND_OPERATION_ERROR_NO, ret);
 		return HISEE_INVALID_PARAMS;
@@ -2721,6 +2754,128 @@ static ssize_t hisee_apdu_store(struct device *dev, struct device_attribute *att
 	}
 }/*lint !e715*/
 
+/** read the results of the last apdu batch
+ * @buf: output, for every command of the batch in order: one status byte
+ * (0 success, 1 failure), 2 bytes big endian ack length, then the ack data
+ */
+static ssize_t hisee_apdu_batch_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	ssize_t len;
+
+	if (NULL == buf) {
+		pr_err("%s buf paramters is null\n", __func__);
+		return HISEE_INVALID_PARAMS;
+	}
+	mutex_lock(&g_hisee_data.apdu_mutex);
+	len = (ssize_t)g_hisee_data.apdu_batch_ack_len;
+	if (len && g_hisee_data.apdu_batch_ack)
+		memcpy(buf, g_hisee_data.apdu_batch_ack, (u64)len);
+	mutex_unlock(&g_hisee_data.apdu_mutex);
+
+	return len;
+}/*lint !e715*/
+
+/** execute a sequence of apdu commands back to back
+ * @buf: input, up to HISEE_APDU_BATCH_MAX commands, each one 2 bytes big
+ * endian length followed by the apdu data. The commands run without other
+ * apdu users in between and without a round trip to user space between
+ * them; a failed command does not stop the rest of the batch.
+ */
+static ssize_t hisee_apdu_batch_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+	unsigned char *ack;
+	unsigned int ack_len = 0;
+	unsigned int apdu_len;
+	size_t offset = 0;
+	int nr_cmds = 0;
+	int failed = 0;
+	int ret;
+
+	if (NULL == buf || count < HISEE_APDU_BATCH_LEN_SIZE) {
+		pr_err("%s buf paramters is invalid\n", __func__);
+		set_errno_and_return(HISEE_INVALID_PARAMS);
+	}
+	if (!g_hisee_data.rpmb_is_ready) {
+		pr_err("%s rpmb is not ready now\n", __func__);
+		set_errno_and_return(HISEE_RPMB_MODULE_INIT_ERROR);
+	}
+	if ((powerctrl_status != HISEE_POWER_ON_BOOTING_SUCCESS && powerctrl_status != HISEE_POWER_ON_UPGRADE_SUCCESS)) {
+		pr_err("%s hisee is not poweron\n", __func__);
+		set_errno_and_return(HISEE_POWERCTRL_FLOW_ERROR);
+	}
+
+	/* validate the whole batch before sending anything */
+	while (offset < count) {
+		if (offset + HISEE_APDU_BATCH_LEN_SIZE > count)
+			break;
+		apdu_len = ((unsigned int)(unsigned char)buf[offset] << 8) | (unsigned char)buf[offset + 1];
+		if (0 == apdu_len || apdu_len > HISEE_APDU_DATA_LEN_MAX ||
+			offset + HISEE_APDU_BATCH_LEN_SIZE + apdu_len > count)
+			break;
+		offset += HISEE_APDU_BATCH_LEN_SIZE + apdu_len;
+		nr_cmds++;
+	}
+	if (offset != count || nr_cmds > HISEE_APDU_BATCH_MAX) {
+		pr_err("%s malformed batch, count=%lu\n", __func__, (unsigned long)count);
+		set_errno_and_return(HISEE_INVALID_PARAMS);
+	}
+
+	mutex_lock(&g_hisee_data.apdu_mutex);
+	if (NULL == g_hisee_data.apdu_batch_ack) {
+		g_hisee_data.apdu_batch_ack = kmalloc(PAGE_SIZE, GFP_KERNEL);
+		if (NULL == g_hisee_data.apdu_batch_ack) {
+			mutex_unlock(&g_hisee_data.apdu_mutex);
+			set_errno_and_return(HISEE_NO_RESOURCES);
+		}
+	}
+	ack = g_hisee_data.apdu_batch_ack;
+
+	for (offset = 0; offset < count; offset += HISEE_APDU_BATCH_LEN_SIZE + apdu_len) {
+		apdu_len = ((unsigned int)(unsigned char)buf[offset] << 8) | (unsigned char)buf[offset + 1];
+		ret = write_apdu_command_func((char *)buf + offset + HISEE_APDU_BATCH_LEN_SIZE, (int)apdu_len);
+		if (HISEE_OK != ret)
+			failed++;
+		ack[ack_len++] = (HISEE_OK == ret) ? 0 : 1;
+		ack[ack_len++] = (unsigned char)(g_hisee_data.apdu_ack.ack_len >> 8);
+		ack[ack_len++] = (unsigned char)g_hisee_data.apdu_ack.ack_len;
+		memcpy(ack + ack_len, g_hisee_data.apdu_ack.ack_buf, (u64)g_hisee_data.apdu_ack.ack_len);
+		ack_len += g_hisee_data.apdu_ack.ack_len;
+	}
+	g_hisee_data.apdu_batch_ack_len = ack_len;
+	mutex_unlock(&g_hisee_data.apdu_mutex);
+
+	if (failed) {
+		pr_err("%s %d of %d commands failed\n", __func__, failed, nr_cmds);
+		record_hisee_log_by_dmd(DSM_NFC_HISEE_APDU_COMMAND_OPERATION_ERROR_NO, HISEE_SMC_CMD_PROCESS_ERROR);
+	}
+	return (ssize_t)count;
+}/*lint !e715*/
+
+/** per smc command type: count failed avg_us max_us
+ */
+static ssize_t hisee_smc_latency_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	hisee_smc_latency lat;
+	ssize_t len = 0;
+	int i;
+
+	if (NULL == buf) {
+		pr_err("%s buf paramters is null\n", __func__);
+		return HISEE_INVALID_PARAMS;
+	}
+	for (i = 0; i < CMD_END; i++) {
+		mutex_lock(&g_hisee_data.hisee_mutex);
+		lat = g_hisee_data.smc_latency[i];
+		mutex_unlock(&g_hisee_data.hisee_mutex);
+		if (!lat.count)
+			continue;
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%d %u %u %llu %u\n", i,
+						lat.count, lat.failed, lat.total_us / lat.count, lat.max_us);
+	}
+
+	return len;
+}/*lint !e715*/
+
 /** check whether the hisee is ready
  * @buf: output, return the hisee ready status
  */
@@ -2815,6 +2970,8 @@ static DEVICE_ATTR(hisee_apdu, (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP), hisee_ap
 static DEVICE_ATTR(hisee_check_ready, (S_IRUSR | S_IRGRP), hisee_check_ready_show, NULL);
 static DEVICE_ATTR(hisee_has_new_cos, (S_IRUSR | S_IRGRP), hisee_has_new_cos_show, NULL);
 static DEVICE_ATTR(hisee_check_upgrade, (S_IRUSR | S_IRGRP), hisee_check_upgrade_show, NULL);
+static DEVICE_ATTR(hisee_apdu_batch, (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP), hisee_apdu_batch_show, hisee_apdu_batch_store);
+static DEVICE_ATTR(hisee_smc_latency, (S_IRUSR | S_IRGRP), hisee_smc_latency_show, NULL);
 /*lint +e778 +esym(778,*) */
 /*lint +e84 +esym(84,*) */
 /*lint +e846 +esym(846,*) */
@@ -2831,6 +2988,8 @@ static int hisee_remove(struct platform_device *pdev)
 		device_remove_file(g_hisee_data.cma_device, &dev_attr_hisee_check_ready);
 		device_remove_file(g_hisee_data.cma_device, &dev_attr_hisee_has_new_cos);
 		device_remove_file(g_hisee_data.cma_device, &dev_attr_hisee_check_upgrade);
+		device_remove_file(g_hisee_data.cma_device, &dev_attr_hisee_apdu_batch);
+		device_remove_file(g_hisee_data.cma_device, &dev_attr_hisee_smc_latency);
 		of_reserved_mem_device_release(g_hisee_data.cma_device);
 	}
 	return ret;
@@ -2883,6 +3042,16 @@ static int __init hisee_probe(struct platform_device *pdev)
 		pr_err("hisee err unable to create hisee_check_upgrade attributes\n");
 		goto err_device_remove_file4;
 	}
+	if (device_create_file(pdevice, &dev_attr_hisee_apdu_batch)) {
+		ret = HISEE_IOCTL_NODE_CREATE_ERROR;
+		pr_err("hisee err unable to create hisee_apdu_batch attributes\n");
+		goto err_device_remove_file5;
+	}
+	if (device_create_file(pdevice, &dev_attr_hisee_smc_latency)) {
+		ret = HISEE_IOCTL_NODE_CREATE_ERROR;
+		pr_err("hisee err unable to create hisee_smc_latency attributes\n");
+		goto err_device_remove_file6;
+	}
 
 	g_hisee_data.hisee_clk = clk_get(NULL, "hise_volt_hold");
 	if (IS_ERR_OR_NULL(g_hisee_data.hisee_clk)) {
@@ -2892,6 +3061,7 @@ static int __init hisee_probe(struct platform_device *pdev)
 	}
 
 	mutex_init(&(g_hisee_data.hisee_mutex));
+	mutex_init(&(g_hisee_data.apdu_mutex));
 	sema_init(&(g_hisee_data.atf_sem), 0);
 	atomic_set(&g_hisee_errno, HISEE_OK);
 	g_hisee_data.factory_test_state = HISEE_FACTORY_TEST_NORUNNING;
@@ -2911,6 +3081,10 @@ static int __init hisee_probe(struct platform_device *pdev)
 	pr_err("hisee module init success!\n");
 	set_errno_and_return(HISEE_OK);
 err_device_remove_file_end:
+	device_remove_file(pdevice, &dev_attr_hisee_smc_latency);
+err_device_remove_file6:
+	device_remove_file(pdevice, &dev_attr_hisee_apdu_batch);
+err_device_remove_file5:
 	device_remove_file(pdevice, &dev_attr_hisee_check_upgrade);
 err_device_remove_file4:
 	device_remove_file(pdevice, &dev_attr_hisee_has_new_cos);
@@ -102,6 +102,9 @@
 #define HISEE_BUF_SHOW_LEN    (128)
 #define HISEE_ERROR_DESCRIPTION_MAX  (64)
 #define HISEE_APDU_DATA_LEN_MAX      (261)
+#define HISEE_APDU_BATCH_MAX         (8)
+/* per command in a batch: 2 bytes big endian length, then the data */
+#define HISEE_APDU_BATCH_LEN_SIZE    (2)
 #define TEST_RESULT_SIZE_DEFAULT     (0x40000)
 
 #define HISEE_IMAGE_PARTITION_NAME  "hisee_img"
@@ -340,6 +343,13 @@ typedef struct _APDU_ACK_HEADER {
 	unsigned int ack_len;
 	unsigned char ack_buf[HISEE_APDU_DATA_LEN_MAX + 1];
 } apdu_ack_header;
+/* time from issuing an smc command until atf signals its completion */
+typedef struct _HISEE_SMC_LATENCY {
+	unsigned int count;
+	unsigned int failed;
+	u64 total_us;
+	unsigned int max_us;
+} hisee_smc_latency;
 typedef struct _HISEE_MODULE_DATA {
 	struct device *cma_device; /* cma memory allocator device */
 	struct clk *hisee_clk;  /* buck 0 voltage hold at 0.8v */
@@ -349,6 +359,10 @@ typedef struct _HISEE_MODULE_DATA {
 	hisee_img_header hisee_img_head; /* store the parsed result for hisee_img partition header */
 	apdu_ack_header  apdu_ack; /* store the apdu response */
 	struct mutex hisee_mutex; /* mutex for global resources */
+	struct mutex apdu_mutex; /* keeps the apdu buffer, ack and a whole batch together */
+	unsigned char *apdu_batch_ack; /* results of the last batch, see hisee_apdu_batch_show */
+	unsigned int apdu_batch_ack_len;
+	hisee_smc_latency smc_latency[CMD_END];
 	hisee_work_struct channel_test_item_result;
 	bool img_header_is_parse; /* indicate the hisee_img partition whether is parsed */
 	unsigned int rpmb_is_ready; /* indicate the rpmb has been initialiazed */
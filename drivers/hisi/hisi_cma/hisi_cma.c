@@ -48,6 +48,10 @@
 #include <linux/of.h>
 #include <linux/of_fdt.h>
 #include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/hisi/hisi_cma.h>
 
 #define HISI_CMA_AREA_NR 8
 
@@ -193,3 +197,138 @@ struct device *hisi_get_cma_area_device(char *name)
 		return NULL;
 	return &(hisi_cma[i].cma_dev);
 }
+
+/*
+ * Background pre-reservation. cma_alloc() migrates every page in use in
+ * the range it picks, which can take 100ms and more on a busy system,
+ * and fails with -EBUSY on pages pinned for a moment. Do that on an
+ * unbound workqueue ahead of time, retrying a few times, and keep the
+ * range until its user takes it.
+ */
+#define HISI_CMA_PREP_TRIES		5
+#define HISI_CMA_PREP_RETRY_MS		50
+
+struct hisi_cma_prep {
+	struct device *dev;
+	size_t count;
+	unsigned int align;
+	struct delayed_work work;
+	spinlock_t lock;
+	enum hisi_cma_prep_state state;
+	unsigned int tries;
+	struct page *pages;
+};
+
+static struct workqueue_struct *hisi_cma_prep_wq;
+
+static void hisi_cma_prep_work(struct work_struct *work)
+{
+	struct hisi_cma_prep *prep = container_of(to_delayed_work(work),
+					struct hisi_cma_prep, work);
+	struct page *pages;
+
+	pages = dma_alloc_from_contiguous(prep->dev, prep->count, prep->align);
+
+	spin_lock(&prep->lock);
+	prep->tries++;
+	if (pages) {
+		prep->pages = pages;
+		prep->state = HISI_CMA_PREP_READY;
+	} else if (prep->tries >= HISI_CMA_PREP_TRIES) {
+		prep->state = HISI_CMA_PREP_FAILED;
+	}
+	spin_unlock(&prep->lock);
+
+	if (prep->state == HISI_CMA_PREP_PENDING)
+		queue_delayed_work(hisi_cma_prep_wq, &prep->work,
+				msecs_to_jiffies(HISI_CMA_PREP_RETRY_MS));
+	else if (prep->state == HISI_CMA_PREP_FAILED)
+		pr_warn("%s: %zu pages for %s not reserved after %u tries\n",
+			__func__, prep->count, dev_name(prep->dev),
+			prep->tries);
+}
+
+struct hisi_cma_prep *hisi_cma_prepare(struct device *dev, size_t count,
+				       unsigned int align)
+{
+	struct hisi_cma_prep *prep;
+
+	if (!dev || !count || !hisi_cma_prep_wq)
+		return ERR_PTR(-EINVAL);
+
+	prep = kzalloc(sizeof(*prep), GFP_KERNEL);
+	if (!prep)
+		return ERR_PTR(-ENOMEM);
+
+	prep->dev = dev;
+	prep->count = count;
+	prep->align = align;
+	prep->state = HISI_CMA_PREP_PENDING;
+	spin_lock_init(&prep->lock);
+	INIT_DELAYED_WORK(&prep->work, hisi_cma_prep_work);
+
+	queue_delayed_work(hisi_cma_prep_wq, &prep->work, 0);
+	return prep;
+}
+
+enum hisi_cma_prep_state hisi_cma_prepare_state(struct hisi_cma_prep *prep,
+						unsigned int *tries)
+{
+	enum hisi_cma_prep_state state;
+
+	if (IS_ERR_OR_NULL(prep))
+		return HISI_CMA_PREP_FAILED;
+
+	spin_lock(&prep->lock);
+	state = prep->state;
+	if (tries)
+		*tries = prep->tries;
+	spin_unlock(&prep->lock);
+
+	return state;
+}
+
+/* @wait for a pending request to finish instead of giving up on it */
+struct page *hisi_cma_prepare_take(struct hisi_cma_prep *prep, bool wait)
+{
+	struct page *pages;
+
+	if (IS_ERR_OR_NULL(prep))
+		return NULL;
+
+	while (wait && hisi_cma_prepare_state(prep, NULL) ==
+					HISI_CMA_PREP_PENDING)
+		flush_delayed_work(&prep->work);
+
+	cancel_delayed_work_sync(&prep->work);
+	pages = prep->pages;
+	kfree(prep);
+
+	return pages;
+}
+
+void hisi_cma_prepare_cancel(struct hisi_cma_prep *prep)
+{
+	struct page *pages;
+	size_t count;
+	struct device *dev;
+
+	if (IS_ERR_OR_NULL(prep))
+		return;
+
+	dev = prep->dev;
+	count = prep->count;
+	pages = hisi_cma_prepare_take(prep, false);
+	if (pages)
+		dma_release_from_contiguous(dev, pages, count);
+}
+
+static int __init hisi_cma_prep_init(void)
+{
+	hisi_cma_prep_wq = alloc_workqueue("hisi_cma_prep",
+					   WQ_UNBOUND | WQ_FREEZABLE, 0);
+	if (!hisi_cma_prep_wq)
+		return -ENOMEM;
+	return 0;
+}
+subsys_initcall(hisi_cma_prep_init);
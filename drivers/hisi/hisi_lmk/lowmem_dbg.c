@@ -8,6 +8,7 @@
 #include <linux/rcupdate.h>
 #include <linux/notifier.h>
 #include <linux/mutex.h>
+#include <linux/spinlock.h>
 #include <linux/delay.h>
 #include <linux/swap.h>
 #include <linux/fs.h>
@@ -30,6 +31,20 @@
 
 static unsigned long long last_jiffs;
 
+#ifdef CONFIG_HISI_LMK_REAPER
+/* victims reaped, pages they freed, and time from kill to freed in us */
+static unsigned long reap_count;
+static unsigned long reap_pages;
+static unsigned long reap_time_total;
+static unsigned long reap_time_max;
+static DEFINE_SPINLOCK(reap_stat_lock);
+
+module_param(reap_count, ulong, S_IRUGO);
+module_param(reap_pages, ulong, S_IRUGO);
+module_param(reap_time_total, ulong, S_IRUGO);
+module_param(reap_time_max, ulong, S_IRUGO);
+#endif
+
 static const char state_to_char[] = TASK_STATE_TO_CHAR_STR;
 
 static void lowmem_dump(struct work_struct *work);
@@ -134,3 +149,19 @@ void hisi_lowmem_dbg_timeout(struct task_struct *p, struct task_struct *leader)
 	}
 	show_stack(leader, NULL);
 }
+
+#ifdef CONFIG_HISI_LMK_REAPER
+void hisi_lowmem_dbg_reaped(pid_t pid, unsigned long pages, s64 usecs)
+{
+	spin_lock(&reap_stat_lock);
+	reap_count++;
+	reap_pages += pages;
+	reap_time_total += usecs;
+	if (usecs > reap_time_max)
+		reap_time_max = usecs;
+	spin_unlock(&reap_stat_lock);
+
+	pr_info("reaped %d: %lukB in %lldus\n", pid,
+		pages << (PAGE_SHIFT - 10), usecs);
+}
+#endif
@@ -4,12 +4,38 @@
 #include <linux/kernel.h>
 #include <linux/mm.h>
 #include <linux/swap.h>
+#include <linux/spinlock.h>
+#include <linux/vmstat.h>
+#include <linux/ion.h>
+#include <linux/hisi/hisi_ion.h>
 
 #include "lowmem_killer.h"
 #define CREATE_TRACE_POINTS
 #include "lowmem_trace.h"
 
 #define ZONE_DMA_LOWMEM_RATIO 30
+/* pressure rates are sampled over at least this long */
+#define LMK_PRESSURE_WINDOW (HZ / 2)
+#define LMK_ION_TASKS 64
+
+/*
+ * refault_thresh: workingset refaults per second at which memory is
+ * considered to be thrashing, 0 disables the check.
+ * stall_thresh: direct reclaims per second also needed for that, 0
+ * for refaults alone.
+ */
+static unsigned int refault_thresh;
+static unsigned int stall_thresh;
+module_param(refault_thresh, uint, S_IRUGO | S_IWUSR);
+module_param(stall_thresh, uint, S_IRUGO | S_IWUSR);
+
+static DEFINE_SPINLOCK(pressure_lock);
+static unsigned long pressure_stamp;
+static unsigned long last_refault, last_stall;
+static unsigned long refault_rate, stall_rate;
+
+static struct ion_task_size ion_tasks[LMK_ION_TASKS];
+static int nr_ion_tasks;
 
 static int nzones = -1;
 
@@ -64,3 +90,81 @@ int hisi_lowmem_tune(int *other_free, int *other_file,
 
 	return 0;
 }
+
+static unsigned long hisi_lowmem_stalls(void)
+{
+#ifdef CONFIG_VM_EVENT_COUNTERS
+	/* under pressure_lock */
+	static unsigned long vm_events[NR_VM_EVENT_ITEMS];
+
+	all_vm_events(vm_events);
+	return vm_events[ALLOCSTALL];
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Whether the workingset refaults, and the direct reclaims stalling the
+ * allocators, are frequent enough that memory is thrashing even though
+ * the minfree levels are not reached.
+ */
+bool hisi_lowmem_thrashing(void)
+{
+	unsigned long now = jiffies, elapsed, refault, stall;
+	bool thrashing;
+
+	if (!refault_thresh)
+		return false;
+
+	/* another reclaimer is sampling, use its rates */
+	if (!spin_trylock(&pressure_lock))
+		goto check;
+
+	elapsed = now - pressure_stamp;
+	if (elapsed >= LMK_PRESSURE_WINDOW) {
+		refault = global_page_state(WORKINGSET_REFAULT);
+		stall = hisi_lowmem_stalls();
+		if (pressure_stamp) {
+			refault_rate = (refault - last_refault) * HZ / elapsed;
+			stall_rate = (stall - last_stall) * HZ / elapsed;
+		}
+		last_refault = refault;
+		last_stall = stall;
+		pressure_stamp = now;
+	}
+	spin_unlock(&pressure_lock);
+
+check:
+	thrashing = ACCESS_ONCE(refault_rate) >= refault_thresh &&
+		ACCESS_ONCE(stall_rate) >= stall_thresh;
+	trace_lowmem_pressure(refault_rate, stall_rate, thrashing);
+	return thrashing;
+}
+
+/*
+ * Snapshot the ion memory held per task, to be read by
+ * hisi_lowmem_ion_pages() while the victims are walked under rcu.
+ * The caller serializes the scans.
+ */
+void hisi_lowmem_ion_snapshot(void)
+{
+	nr_ion_tasks = hisi_ion_task_sizes(ion_tasks, LMK_ION_TASKS);
+}
+
+unsigned long hisi_lowmem_ion_pages(pid_t tgid)
+{
+	int i;
+
+	for (i = 0; i < nr_ion_tasks; i++)
+		if (ion_tasks[i].pid == tgid)
+			return ion_tasks[i].size >> PAGE_SHIFT;
+	return 0;
+}
+
+void hisi_lowmem_trace_select(struct task_struct *p, short adj,
+			      unsigned long rss, unsigned long swap,
+			      unsigned long ion)
+{
+	trace_lowmem_select(p->pid, adj, rss, swap, ion);
+}
@@ -4,12 +4,39 @@
 #ifdef CONFIG_HISI_LOWMEM
 int hisi_lowmem_tune(int *other_free, int *other_file,
 		     struct shrink_control *sc);
+bool hisi_lowmem_thrashing(void);
+void hisi_lowmem_ion_snapshot(void);
+unsigned long hisi_lowmem_ion_pages(pid_t tgid);
+void hisi_lowmem_trace_select(struct task_struct *p, short adj,
+			      unsigned long rss, unsigned long swap,
+			      unsigned long ion);
 #else
 static inline int hisi_lowmem_tune(int *other_free, int *other_file,
 		     struct shrink_control *sc)
 {
 	return 0;
 }
+
+static inline bool hisi_lowmem_thrashing(void)
+{
+	return false;
+}
+
+static inline void hisi_lowmem_ion_snapshot(void)
+{
+}
+
+static inline unsigned long hisi_lowmem_ion_pages(pid_t tgid)
+{
+	return 0;
+}
+
+static inline void hisi_lowmem_trace_select(struct task_struct *p, short adj,
+					    unsigned long rss,
+					    unsigned long swap,
+					    unsigned long ion)
+{
+}
 #endif
 
 #ifdef CONFIG_HISI_LOWMEM_DBG
@@ -30,4 +57,30 @@ static inline void hisi_lowmem_dbg_timeout(struct task_struct *p,
 
 #endif
 
+#ifdef CONFIG_HISI_LMK_REAPER
+void hisi_lowmem_reap(struct task_struct *tsk);
+#else
+static inline void hisi_lowmem_reap(struct task_struct *tsk)
+{
+}
+#endif
+
+#ifdef CONFIG_HISI_LMK_PROTECT
+unsigned long hisi_lowmem_protect_release(short min_score_adj);
+#else
+static inline unsigned long hisi_lowmem_protect_release(short min_score_adj)
+{
+	return 0;
+}
+#endif
+
+#if defined(CONFIG_HISI_LOWMEM_DBG) && defined(CONFIG_HISI_LMK_REAPER)
+void hisi_lowmem_dbg_reaped(pid_t pid, unsigned long pages, s64 usecs);
+#else
+static inline void hisi_lowmem_dbg_reaped(pid_t pid, unsigned long pages,
+					  s64 usecs)
+{
+}
+#endif
+
 #endif /* __HISI_LOWMEM_H */
@@ -0,0 +1,279 @@
+#define pr_fmt(fmt) "hisi_lowmem: " fmt
+
+/*
+ * Protected page cache working set.
+ *
+ * A trusted process (CAP_SYS_ADMIN) names the hot ranges of the
+ * foreground app's code files through /proc/lowmem_protect:
+ *
+ *	echo "add <path> <offset> <length>" > /proc/lowmem_protect
+ *	echo "del <path>" > /proc/lowmem_protect
+ *	echo "clear" > /proc/lowmem_protect
+ *
+ * A length of 0 means up to the end of the file. The ranges are read in if
+ * needed and every page is held with a reference, up to protect_kb in all,
+ * so reclaim can't drop them while the rest of the page cache is shrunk.
+ * Once the lmk would kill a task with an oom_score_adj at or below
+ * release_adj, the protection is dropped first and the pages become
+ * ordinary page cache again.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/pagemap.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/capability.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+
+#include "lowmem_killer.h"
+
+#define LMK_PROTECT_CMD_LEN	(PATH_MAX + 64)
+
+static unsigned int protect_kb = 32 * 1024;
+module_param(protect_kb, uint, S_IRUGO | S_IWUSR);
+
+static int release_adj = 200;
+module_param(release_adj, int, S_IRUGO | S_IWUSR);
+
+struct lmk_protect {
+	struct list_head node;
+	struct file *filp;
+	pgoff_t start;
+	unsigned long nr_pages;		/* pinned, pages[] holds them */
+	struct page **pages;
+};
+
+static LIST_HEAD(lmk_protects);
+static unsigned long lmk_protect_pages;
+static unsigned long lmk_protect_released;
+static DEFINE_MUTEX(lmk_protect_lock);
+
+static void lowmem_protect_free(struct lmk_protect *p)
+{
+	unsigned long i;
+
+	for (i = 0; i < p->nr_pages; i++)
+		page_cache_release(p->pages[i]);
+	lmk_protect_pages -= p->nr_pages;
+	list_del(&p->node);
+	fput(p->filp);
+	vfree(p->pages);
+	kfree(p);
+}
+
+static unsigned long lowmem_protect_quota(void)
+{
+	return (unsigned long)protect_kb >> (PAGE_SHIFT - 10);
+}
+
+/* called with lmk_protect_lock held */
+static int lowmem_protect_add(const char *path, loff_t offset, loff_t len)
+{
+	struct lmk_protect *p;
+	struct file *filp;
+	loff_t isize;
+	pgoff_t index, end;
+	unsigned long nr, room;
+	int ret;
+
+	if (offset < 0 || len < 0)
+		return -EINVAL;
+
+	room = lowmem_protect_quota();
+	room -= min(room, lmk_protect_pages);
+	if (!room)
+		return -ENOSPC;
+
+	filp = filp_open(path, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(filp))
+		return PTR_ERR(filp);
+
+	ret = -EINVAL;
+	if (!S_ISREG(file_inode(filp)->i_mode))
+		goto out_fput;
+
+	isize = i_size_read(file_inode(filp));
+	if (!len || offset + len > isize)
+		len = isize - offset;
+	if (len <= 0)
+		goto out_fput;
+
+	index = offset >> PAGE_CACHE_SHIFT;
+	end = (offset + len - 1) >> PAGE_CACHE_SHIFT;
+	nr = min(end - index + 1, room);
+
+	ret = -ENOMEM;
+	p = kzalloc(sizeof(*p), GFP_KERNEL);
+	if (!p)
+		goto out_fput;
+	p->pages = vmalloc(nr * sizeof(struct page *));
+	if (!p->pages)
+		goto out_free;
+	p->filp = filp;
+	p->start = index;
+
+	/* bring the range in with large reads, then take the pages */
+	force_page_cache_readahead(filp->f_mapping, filp, index, nr);
+	for (; p->nr_pages < nr; index++) {
+		struct page *page = find_get_page(filp->f_mapping, index);
+
+		/* a hole in the cache after readahead, e.g. under pressure */
+		if (!page)
+			break;
+		mark_page_accessed(page);
+		p->pages[p->nr_pages++] = page;
+	}
+
+	lmk_protect_pages += p->nr_pages;
+	list_add_tail(&p->node, &lmk_protects);
+	return 0;
+
+out_free:
+	kfree(p);
+out_fput:
+	fput(filp);
+	return ret;
+}
+
+/* called with lmk_protect_lock held */
+static void lowmem_protect_del(const char *path)
+{
+	struct lmk_protect *p, *tmp;
+	char *buf, *name;
+
+	buf = kmalloc(PATH_MAX, GFP_KERNEL);
+	if (!buf)
+		return;
+
+	list_for_each_entry_safe(p, tmp, &lmk_protects, node) {
+		name = d_path(&p->filp->f_path, buf, PATH_MAX);
+		if (!IS_ERR(name) && (!path || !strcmp(name, path)))
+			lowmem_protect_free(p);
+	}
+
+	kfree(buf);
+}
+
+/*
+ * hisi_lowmem_protect_release - called by the lmk before it kills a task
+ * with oom_score_adj 'min_score_adj' or more. Drops all protection if that
+ * task would be at or below release_adj and returns the number of pages
+ * given back to reclaim, the kill is then not needed yet.
+ */
+unsigned long hisi_lowmem_protect_release(short min_score_adj)
+{
+	struct lmk_protect *p, *tmp;
+	unsigned long released;
+
+	if (min_score_adj > release_adj || !ACCESS_ONCE(lmk_protect_pages))
+		return 0;
+
+	/* the holder may be allocating, never wait for it from reclaim */
+	if (!mutex_trylock(&lmk_protect_lock))
+		return 0;
+
+	released = lmk_protect_pages;
+	list_for_each_entry_safe(p, tmp, &lmk_protects, node)
+		lowmem_protect_free(p);
+	lmk_protect_released += released;
+	mutex_unlock(&lmk_protect_lock);
+
+	pr_info("protection of %lu pages dropped for adj %hd\n",
+		released, min_score_adj);
+	return released;
+}
+
+static int lowmem_protect_show(struct seq_file *m, void *v)
+{
+	struct lmk_protect *p;
+	char *buf, *name;
+
+	buf = kmalloc(PATH_MAX, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	mutex_lock(&lmk_protect_lock);
+	seq_printf(m, "protected %lu quota %lu released %lu\n",
+		   lmk_protect_pages, lowmem_protect_quota(),
+		   lmk_protect_released);
+	list_for_each_entry(p, &lmk_protects, node) {
+		name = d_path(&p->filp->f_path, buf, PATH_MAX);
+		seq_printf(m, "%s %lu %lu\n", IS_ERR(name) ? "?" : name,
+			   (unsigned long)p->start, p->nr_pages);
+	}
+	mutex_unlock(&lmk_protect_lock);
+
+	kfree(buf);
+	return 0;
+}
+
+static int lowmem_protect_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lowmem_protect_show, NULL);
+}
+
+static ssize_t lowmem_protect_write(struct file *file, const char __user *ubuf,
+				    size_t count, loff_t *ppos)
+{
+	char *buf, *path;
+	long long offset = 0, len = 0;
+	int ret = 0;
+
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+	if (count >= LMK_PROTECT_CMD_LEN)
+		return -EINVAL;
+
+	buf = kmalloc(count + 1, GFP_KERNEL);
+	path = kmalloc(count + 1, GFP_KERNEL);
+	if (!buf || !path) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	if (copy_from_user(buf, ubuf, count)) {
+		ret = -EFAULT;
+		goto out;
+	}
+	buf[count] = '\0';
+
+	mutex_lock(&lmk_protect_lock);
+	if (sscanf(buf, "add %s %lld %lld", path, &offset, &len) >= 1)
+		ret = lowmem_protect_add(path, offset, len);
+	else if (sscanf(buf, "del %s", path) == 1)
+		lowmem_protect_del(path);
+	else if (!strncmp(buf, "clear", 5))
+		lowmem_protect_del(NULL);
+	else
+		ret = -EINVAL;
+	mutex_unlock(&lmk_protect_lock);
+
+out:
+	kfree(path);
+	kfree(buf);
+	return ret ? ret : count;
+}
+
+static const struct file_operations lowmem_protect_fops = {
+	.open		= lowmem_protect_open,
+	.read		= seq_read,
+	.write		= lowmem_protect_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init lowmem_protect_init(void)
+{
+	if (!proc_create("lowmem_protect", S_IRUSR | S_IWUSR, NULL,
+			 &lowmem_protect_fops))
+		return -ENOMEM;
+	return 0;
+}
+late_initcall(lowmem_protect_init);
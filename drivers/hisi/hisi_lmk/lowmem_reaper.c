@@ -0,0 +1,129 @@
+#define pr_fmt(fmt) "hisi_lowmem: " fmt
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/oom.h>
+#include <linux/bitops.h>
+#include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
+#include <linux/boost_sigkill_free.h>
+
+#include "lowmem_killer.h"
+
+/* victims reaped at once, enough for the largest multi kill */
+#define LMK_REAP_SLOTS 8
+#define LMK_REAP_RETRIES 10
+#define LMK_REAP_RETRY_MS 20
+
+struct lmk_reap {
+	struct work_struct work;
+	struct mm_struct *mm;
+	pid_t pid;
+	ktime_t kill_time;
+};
+
+static int reap_enable = 1;
+module_param(reap_enable, int, S_IRUGO | S_IWUSR);
+
+static struct workqueue_struct *lmk_reap_wq;
+static struct lmk_reap lmk_reaps[LMK_REAP_SLOTS];
+static unsigned long lmk_reap_busy;
+
+static void lowmem_reap_work(struct work_struct *work)
+{
+	struct lmk_reap *r = container_of(work, struct lmk_reap, work);
+	struct mm_struct *mm = r->mm;
+	unsigned long rss, freed = 0;
+	int tries = 0;
+
+	/* the victim may have exited already */
+	if (atomic_inc_not_zero(&mm->mm_users)) {
+		rss = get_mm_rss(mm);
+		while (!fast_free_mm(mm) &&
+		       !test_bit(MMF_FAST_FREEING, &mm->flags) &&
+		       ++tries < LMK_REAP_RETRIES)
+			msleep(LMK_REAP_RETRY_MS);
+		freed = rss - min(rss, get_mm_rss(mm));
+		mmput(mm);
+	}
+
+	hisi_lowmem_dbg_reaped(r->pid, freed,
+			       ktime_us_delta(ktime_get(), r->kill_time));
+	mmdrop(mm);
+	clear_bit_unlock(r - lmk_reaps, &lmk_reap_busy);
+}
+
+/* another process using the mm would lose its memory too */
+static bool lowmem_mm_shared(struct task_struct *tsk, struct mm_struct *mm)
+{
+	struct task_struct *p;
+
+	for_each_process(p) {
+		if (p->flags & PF_KTHREAD || same_thread_group(p, tsk))
+			continue;
+		if (p->mm == mm)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Queue the memory of @tsk, just sent SIGKILL, to be freed by the
+ * reaper. Called under rcu_read_lock().
+ */
+void hisi_lowmem_reap(struct task_struct *tsk)
+{
+	struct task_struct *p;
+	struct mm_struct *mm;
+	struct lmk_reap *r;
+	int slot;
+
+	if (!reap_enable || !lmk_reap_wq)
+		return;
+
+	p = find_lock_task_mm(tsk);
+	if (!p)
+		return;
+	mm = p->mm;
+	atomic_inc(&mm->mm_count);
+	task_unlock(p);
+
+	if (lowmem_mm_shared(tsk, mm))
+		goto drop;
+
+	for (slot = 0; slot < LMK_REAP_SLOTS; slot++)
+		if (!test_and_set_bit_lock(slot, &lmk_reap_busy))
+			break;
+	if (slot == LMK_REAP_SLOTS)
+		goto drop;
+
+	r = &lmk_reaps[slot];
+	r->mm = mm;
+	r->pid = tsk->pid;
+	r->kill_time = ktime_get();
+	queue_work(lmk_reap_wq, &r->work);
+	return;
+drop:
+	mmdrop(mm);
+}
+
+static int __init lowmem_reaper_init(void)
+{
+	int i;
+
+	for (i = 0; i < LMK_REAP_SLOTS; i++)
+		INIT_WORK(&lmk_reaps[i].work, lowmem_reap_work);
+
+	lmk_reap_wq = alloc_workqueue("lmk_reaper",
+			WQ_UNBOUND | WQ_HIGHPRI | WQ_MEM_RECLAIM,
+			LMK_REAP_SLOTS);
+	if (!lmk_reap_wq) {
+		pr_err("failed to create reaper workqueue\n");
+		return -ENOMEM;
+	}
+	return 0;
+}
+late_initcall(lowmem_reaper_init);
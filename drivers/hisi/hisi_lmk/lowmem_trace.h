@@ -38,6 +38,56 @@ TRACE_EVENT(lowmem_tune,/* [false alarm] */
 		__entry->other_file, __entry->tune_free, __entry->tune_file)
 );
 
+TRACE_EVENT(lowmem_pressure,
+	TP_PROTO(unsigned long refault_rate, unsigned long stall_rate,
+		 bool thrashing),
+
+	TP_ARGS(refault_rate, stall_rate, thrashing),
+
+	TP_STRUCT__entry(
+			__field(unsigned long, refault_rate)
+			__field(unsigned long, stall_rate)
+			__field(bool, thrashing)
+	),
+
+	TP_fast_assign(
+			__entry->refault_rate = refault_rate;
+			__entry->stall_rate = stall_rate;
+			__entry->thrashing = thrashing;
+	),
+
+	TP_printk("refault=%lu/s stall=%lu/s thrashing=%d",
+		__entry->refault_rate, __entry->stall_rate,
+		__entry->thrashing)
+);
+
+TRACE_EVENT(lowmem_select,
+	TP_PROTO(pid_t pid, short adj, unsigned long rss, unsigned long swap,
+		 unsigned long ion),
+
+	TP_ARGS(pid, adj, rss, swap, ion),
+
+	TP_STRUCT__entry(
+			__field(pid_t, pid)
+			__field(short, adj)
+			__field(unsigned long, rss)
+			__field(unsigned long, swap)
+			__field(unsigned long, ion)
+	),
+
+	TP_fast_assign(
+			__entry->pid = pid;
+			__entry->adj = adj;
+			__entry->rss = rss;
+			__entry->swap = swap;
+			__entry->ion = ion;
+	),
+
+	TP_printk("pid=%d adj=%hd rss=%lu swap=%lu ion=%lu",
+		__entry->pid, __entry->adj, __entry->rss, __entry->swap,
+		__entry->ion)
+);
+
 #endif
 
 /* This part must be outside protection */
@@ -17,6 +17,10 @@
 #include <linux/slab.h>
 #include <linux/sched.h>
 #include <linux/delay.h>
+#include <linux/hash.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/workqueue.h>
 #include <linux/hisi/page_tracker.h>
 #ifdef PGTRACK_TEST
 #include <linux/ktime.h>
@@ -62,6 +66,49 @@ static const char * const page_tracker_text[TRACK_MAX] = {
 	"IRQ Page Distribution:",
 };
 
+/*
+ * Sampling mode, page_tracker=sample: one allocation is tracked every
+ * page_tracker_rate pages allocated on a cpu, so an allocation of
+ * order o is sampled with probability (1 << o) / rate. Sampled allocs
+ * and frees are queued to per-cpu rings without locks, and a worker
+ * folds them into a small table of live pages per call site.
+ */
+#define PGTRACK_SAMPLED		2	/* page_tracker.head of a sampled page */
+#define PGTRACK_RING_SIZE	512
+#define PGTRACK_SITE_BITS	10
+#define PGTRACK_DRAIN_INTERVAL	HZ
+
+struct pgtrack_event {
+	unsigned long trace;
+	unsigned char order;
+	bool free;
+};
+
+struct pgtrack_ring {
+	unsigned int head;		/* written by the owning cpu only */
+	unsigned int tail;		/* written by the drain worker only */
+	unsigned long dropped;
+	struct pgtrack_event ev[PGTRACK_RING_SIZE];
+};
+
+struct pgtrack_site {
+	unsigned long trace;
+	unsigned long allocs;
+	unsigned long frees;
+	long pages;			/* live pages, scaled by the rate */
+};
+
+static bool page_tracker_sampling;
+static unsigned int page_tracker_rate = 512;
+static DEFINE_PER_CPU(long, pgtrack_countdown);
+static DEFINE_PER_CPU(struct pgtrack_ring, pgtrack_rings);
+static struct pgtrack_site pgtrack_sites[1 << PGTRACK_SITE_BITS];
+static unsigned long pgtrack_sites_full;
+static DEFINE_MUTEX(pgtrack_lock);
+
+static void pgtrack_drain_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(pgtrack_drain_work, pgtrack_drain_fn);
+
 static int early_page_tracker_param(char *buf)
 {
 	if (!buf)
@@ -69,11 +116,163 @@ static int early_page_tracker_param(char *buf)
 
 	if (strcmp(buf, "on") == 0)
 		page_tracker_disabled = false;
+	if (strcmp(buf, "sample") == 0) {
+		page_tracker_disabled = false;
+		page_tracker_sampling = true;
+	}
 
 	return 0;
 }
 early_param("page_tracker", early_page_tracker_param);
 
+static int early_page_tracker_rate(char *buf)
+{
+	unsigned int rate;
+
+	if (!buf || kstrtouint(buf, 0, &rate) || !rate)
+		return -EINVAL;
+
+	page_tracker_rate = rate;
+	return 0;
+}
+early_param("page_tracker_rate", early_page_tracker_rate);
+
+static bool pgtrack_sample(int order)
+{
+	if (this_cpu_sub_return(pgtrack_countdown, 1 << order) > 0)
+		return false;
+
+	this_cpu_write(pgtrack_countdown, page_tracker_rate);
+	return true;
+}
+
+static void pgtrack_push(unsigned long trace, int order, bool free)
+{
+	struct pgtrack_ring *ring;
+	struct pgtrack_event *ev;
+	unsigned long flags;
+	unsigned int head;
+
+	local_irq_save(flags);
+	ring = this_cpu_ptr(&pgtrack_rings);
+	head = ring->head;
+	if (head - ACCESS_ONCE(ring->tail) >= PGTRACK_RING_SIZE) {
+		ring->dropped++;
+	} else {
+		ev = &ring->ev[head % PGTRACK_RING_SIZE];
+		ev->trace = trace;
+		ev->order = (unsigned char)order;
+		ev->free = free;
+		/* the event is written before the drain can see it */
+		smp_wmb();
+		ACCESS_ONCE(ring->head) = head + 1;
+	}
+	local_irq_restore(flags);
+}
+
+static struct pgtrack_site *pgtrack_site(unsigned long trace)
+{
+	unsigned int i, idx = hash_long(trace, PGTRACK_SITE_BITS);
+	struct pgtrack_site *site;
+
+	for (i = 0; i < ARRAY_SIZE(pgtrack_sites); i++) {
+		site = &pgtrack_sites[(idx + i) & (ARRAY_SIZE(pgtrack_sites) - 1)];
+		if (site->trace == trace)
+			return site;
+		if (!site->trace && !site->allocs) {
+			site->trace = trace;
+			return site;
+		}
+	}
+	return NULL;
+}
+
+/* should be called with pgtrack_lock held */
+static void pgtrack_drain(void)
+{
+	struct pgtrack_ring *ring;
+	struct pgtrack_event *ev;
+	struct pgtrack_site *site;
+	unsigned int head, tail;
+	long pages;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(&pgtrack_rings, cpu);
+		head = ACCESS_ONCE(ring->head);
+		/* pairs with the smp_wmb() in pgtrack_push() */
+		smp_rmb();
+		for (tail = ring->tail; tail != head; tail++) {
+			ev = &ring->ev[tail % PGTRACK_RING_SIZE];
+			site = pgtrack_site(ev->trace);
+			if (!site) {
+				pgtrack_sites_full++;
+				continue;
+			}
+			pages = max_t(long, 1L << ev->order, page_tracker_rate);
+			if (ev->free) {
+				site->frees++;
+				site->pages -= pages;
+			} else {
+				site->allocs++;
+				site->pages += pages;
+			}
+		}
+		/* the events are read before their slots are reused */
+		smp_mb();
+		ACCESS_ONCE(ring->tail) = tail;
+	}
+}
+
+static void pgtrack_drain_fn(struct work_struct *work)
+{
+	mutex_lock(&pgtrack_lock);
+	pgtrack_drain();
+	mutex_unlock(&pgtrack_lock);
+
+	schedule_delayed_work(&pgtrack_drain_work, PGTRACK_DRAIN_INTERVAL);
+}
+
+static int page_tracker_sample_show(struct seq_file *s, void *unused)
+{
+	struct pgtrack_site *site;
+	unsigned long dropped = 0;
+	int cpu, i;
+
+	mutex_lock(&pgtrack_lock);
+	pgtrack_drain();
+
+	for_each_possible_cpu(cpu)
+		dropped += per_cpu_ptr(&pgtrack_rings, cpu)->dropped;
+	seq_printf(s, "rate %u pages, dropped events %lu, sites full %lu\n",
+		   page_tracker_rate, dropped, pgtrack_sites_full);
+	seq_puts(s, "[live KB] [allocs] [frees] [trace]\n");
+
+	for (i = 0; i < ARRAY_SIZE(pgtrack_sites); i++) {
+		site = &pgtrack_sites[i];
+		if (site->pages <= 0)
+			continue;
+		seq_printf(s, "%9ld %8lu %8lu   %pF\n",
+			   site->pages << (PAGE_SHIFT - 10), site->allocs,
+			   site->frees, (void *)site->trace);
+	}
+	mutex_unlock(&pgtrack_lock);
+
+	return 0;
+}
+
+static int page_tracker_sample_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, page_tracker_sample_show, NULL);
+}
+
+static const struct file_operations page_tracker_sample_fops = {
+	.open = page_tracker_sample_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 void page_tracker_show(struct page *page, int order)
 {
 	struct page_ext *page_ext = NULL;
@@ -105,8 +304,17 @@ void page_tracker_set_trace(struct page *page, unsigned long func, int order)
 		return;
 
 	page_ext = lookup_page_ext(page);
-	if (page_ext)
-		page_ext->page_tracker.trace = func;
+	if (!page_ext)
+		return;
+
+	if (page_tracker_sampling) {
+		/* one alloc event per sampled page, at its first trace */
+		if (page_ext->page_tracker.head != PGTRACK_SAMPLED ||
+		    page_ext->page_tracker.trace)
+			return;
+		pgtrack_push(func, page_ext->page_tracker.order, false);
+	}
+	page_ext->page_tracker.trace = func;
 }
 
 void page_tracker_set_type(struct page *page, int type, int order)
@@ -117,8 +325,13 @@ void page_tracker_set_type(struct page *page, int type, int order)
 		return;
 
 	page_ext = lookup_page_ext(page);
-	if (page_ext)
-		page_ext->page_tracker.type = type;
+	if (!page_ext)
+		return;
+
+	if (page_tracker_sampling &&
+	    page_ext->page_tracker.head != PGTRACK_SAMPLED)
+		return;
+	page_ext->page_tracker.type = type;
 }
 
 void page_tracker_set_tracker(struct page *page, int order)
@@ -128,10 +341,16 @@ void page_tracker_set_tracker(struct page *page, int order)
 	if (page_tracker_disabled)
 		return;
 
+	if (page_tracker_sampling && !pgtrack_sample(order))
+		return;
+
 	page_ext = lookup_page_ext(page);
 	if (page_ext) {
 		page_ext->page_tracker.order = (unsigned char)order;
-		page_ext->page_tracker.head = (unsigned char)true;
+		page_ext->page_tracker.head = page_tracker_sampling ?
+				PGTRACK_SAMPLED : (unsigned char)true;
+		if (page_tracker_sampling)
+			page_ext->page_tracker.trace = 0;
 		page_ext->page_tracker.type = TRACK_PROC;
 		if (!in_interrupt())
 			page_ext->page_tracker.pid = current->pid;
@@ -148,7 +367,8 @@ void page_tracker_change_tracker(struct page *new_page,
 	struct page_ext *page_old_ext = NULL;
 	struct page_ext *page_new_ext = NULL;
 
-	if (page_tracker_disabled)
+	/* a sampled page is accounted until the old page is freed */
+	if (page_tracker_disabled || page_tracker_sampling)
 		return;
 
 	page_old_ext = lookup_page_ext(new_page);
@@ -182,6 +402,16 @@ void page_tracker_reset_tracker(struct page *page, int order)
 		return;
 
 	page_ext = lookup_page_ext(page);
+	if (page_tracker_sampling) {
+		if (page_ext->page_tracker.head == PGTRACK_SAMPLED) {
+			if (page_ext->page_tracker.trace)
+				pgtrack_push(page_ext->page_tracker.trace,
+					     page_ext->page_tracker.order, true);
+			page_ext->page_tracker.head = true;
+		}
+		return;
+	}
+
 	while(nr--) {
 		page_ext->page_tracker.order = 0;
 		page_ext->page_tracker.head = true;
@@ -225,7 +455,8 @@ void page_tracker_wake_up(void)
 {
 	int nid;
 
-	if (page_tracker_disabled)
+	/* there is no ktrackerd to wake when sampling */
+	if (page_tracker_disabled || page_tracker_sampling)
 		return;
 
 	for_each_node_state(nid, N_MEMORY)
@@ -649,6 +880,15 @@ static int __init page_tracker_init(void)
 	if (page_tracker_disabled)
 		return ret;
 
+	if (page_tracker_sampling) {
+		if (!proc_create("page-tracker-sample", 0400, NULL,
+				 &page_tracker_sample_fops))
+			return -ENOMEM;
+		schedule_delayed_work(&pgtrack_drain_work,
+				      PGTRACK_DRAIN_INTERVAL);
+		return 0;
+	}
+
 	for_each_node_state(nid, N_MEMORY) {
 		if (creat_trackerd(nid))
 			ret |= 1 << nid;
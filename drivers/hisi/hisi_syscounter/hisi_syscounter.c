@@ -13,9 +13,19 @@
 #include <linux/hisi/hisi_syscounter.h>
 #include <linux/syscore_ops.h>
 #include <linux/workqueue.h>
+#include <linux/clocksource.h>
+#include <asm/vdso_datapage.h>
 
 #define RECORD_NEED_SYNC_PERIOD  0
 
+/*
+ * The vDSO converts with a 64-bit multiply, so its reference point is
+ * moved forward well before the delta could overflow the maximum the
+ * mult/shift pair was chosen for.
+ */
+#define VDSO_SYNC_MAXSEC	3600
+#define VDSO_SYNC_PERIOD_MS	(600 * MSEC_PER_SEC)
+
 static struct syscnt_device *syscnt_dev;
 
 int syscounter_to_timespec64(u64 syscnt, struct timespec64 *ts)
@@ -98,6 +108,29 @@ int hisi_get_timecounter(unsigned long *lastcycle, struct timespec *ts)
 }
 EXPORT_SYMBOL(hisi_get_timecounter);
 
+/* a reference point taken with the kernel's own conversion, for the vDSO */
+static void hisi_syscounter_vdso_update(struct syscnt_device *d)
+{
+	struct timespec64 ts;
+	u64 syscnt = hisi_get_syscount();
+
+	if (syscounter_to_timespec64(syscnt, &ts))
+		return;
+	update_vsyscall_syscnt(syscnt, &ts, d->vdso_mult, d->vdso_shift);
+}
+
+static void hisi_syscounter_vdso_work(struct work_struct *work)
+{
+	struct syscnt_device *d = syscnt_dev;
+
+	if (!d)
+		return;
+
+	hisi_syscounter_vdso_update(d);
+	queue_delayed_work(system_power_efficient_wq, &d->vdso_work,
+			   msecs_to_jiffies(VDSO_SYNC_PERIOD_MS));
+}
+
 
 #if RECORD_NEED_SYNC_PERIOD
 static void hisi_syscounter_sync_work(struct work_struct *work)
@@ -133,6 +166,7 @@ static int hisi_syscounter_suspend(void)
 #if RECORD_NEED_SYNC_PERIOD
 	cancel_delayed_work(&d->sync_record_work);
 #endif
+	cancel_delayed_work(&d->vdso_work);
 
 	pr_info("%s --", __func__);
 
@@ -160,6 +194,9 @@ static void hisi_syscounter_resume(void)
 #if RECORD_NEED_SYNC_PERIOD
 	schedule_delayed_work(&d->sync_record_work, round_jiffies_relative(msecs_to_jiffies(d->sync_interval)));
 #endif
+	hisi_syscounter_vdso_update(d);
+	queue_delayed_work(system_power_efficient_wq, &d->vdso_work,
+			   msecs_to_jiffies(VDSO_SYNC_PERIOD_MS));
 
 	pr_info("%s --", __func__);
 
@@ -224,10 +261,17 @@ static int hisi_syscounter_probe(struct platform_device *pdev)
 	spin_unlock_irqrestore(&d->sync_lock, flags);
 
 	platform_set_drvdata(pdev, d);
-	register_syscore_ops(&hisi_syscounter_syscore_ops);
 
+	clocks_calc_mult_shift(&d->vdso_mult, &d->vdso_shift, (u32)d->clock_rate,
+			       NSEC_PER_SEC, VDSO_SYNC_MAXSEC);
+	INIT_DELAYED_WORK(&d->vdso_work, hisi_syscounter_vdso_work);
 #if RECORD_NEED_SYNC_PERIOD
 	INIT_DELAYED_WORK(&d->sync_record_work, hisi_syscounter_sync_work);
+#endif
+	register_syscore_ops(&hisi_syscounter_syscore_ops);
+
+	hisi_syscounter_vdso_work(&d->vdso_work.work);
+#if RECORD_NEED_SYNC_PERIOD
 	schedule_delayed_work(&d->sync_record_work, round_jiffies_relative(msecs_to_jiffies(d->sync_interval)));
 #endif
 
@@ -244,8 +288,12 @@ err_probe:
 
 static int hisi_syscounter_remove(struct platform_device *pdev)
 {
+	struct timespec64 ts = { 0 };
+
 	unregister_syscore_ops(&hisi_syscounter_syscore_ops);
 	if (syscnt_dev) {
+		cancel_delayed_work_sync(&syscnt_dev->vdso_work);
+		update_vsyscall_syscnt(0, &ts, 0, 0);
 		iounmap(syscnt_dev->base);
 		kfree(syscnt_dev);
 		syscnt_dev = NULL;
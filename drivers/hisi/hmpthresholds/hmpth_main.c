@@ -21,6 +21,12 @@
 #include <linux/sysfs.h>
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/hash.h>
+#include <linux/atomic.h>
+#include <linux/workqueue.h>
+#include <linux/topology.h>
+#include <linux/cpufreq.h>
+#include <linux/cpu.h>
 #include <trace/events/sched.h>
 #include "hmpth_main.h"
 
@@ -31,6 +37,80 @@ static unsigned int hmpset_enable = 0;
 
 static spinlock_t hmpset_lock;
 
+/*
+ * Adaptive thresholds: the hmp migrations are watched and when too many
+ * of them bounce straight back, the thresholds in use are pulled apart
+ * from the values of the policy in effect, up to adapt_range. When the
+ * bouncing stops they are brought back step by step. What was learnt
+ * is kept per policy, in hmp_adapt[] next to hmp_policy[].
+ */
+static struct hmpth_adapt hmp_adapt[MAX_MUM_POLICY];
+static int hmp_adapt_active = -1;
+static unsigned int hmp_adapt_enable;
+static DEFINE_MUTEX(hmp_adapt_mutex);
+
+/* a move back within this many ms is a bounce */
+static unsigned int adapt_window_ms = 100;
+module_param(adapt_window_ms, uint, 0644);
+/* widen once more than this percent of the migrations bounce */
+static unsigned int adapt_bounce_pct = 10;
+module_param(adapt_bounce_pct, uint, 0644);
+static unsigned int adapt_step = 16;
+module_param(adapt_step, uint, 0644);
+static unsigned int adapt_range = 128;
+module_param(adapt_range, uint, 0644);
+static unsigned int adapt_period_ms = 1000;
+module_param(adapt_period_ms, uint, 0644);
+
+/* fewer migrations than this in a period say nothing */
+#define HMPTH_ADAPT_MIN_MIGRATIONS 8
+
+/* last hmp migration of recently moved tasks, hashed by pid */
+#define HMPTH_TASK_HASH_BITS 8
+#define HMPTH_MIG_UP	1
+#define HMPTH_MIG_DOWN	2
+
+struct hmpth_task_mig {
+	pid_t pid;
+	int dir;
+	u64 ts;
+};
+
+static struct hmpth_task_mig hmpth_task_mig[1 << HMPTH_TASK_HASH_BITS];
+
+static atomic_t hmpth_migrations;
+static atomic_t hmpth_up_bounces;
+static atomic_t hmpth_down_bounces;
+static atomic_t hmpth_up_res_nr;
+static atomic_t hmpth_down_res_nr;
+static atomic64_t hmpth_up_res_ns;
+static atomic64_t hmpth_down_res_ns;
+
+static void hmpth_adapt_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(hmpth_adapt_work, hmpth_adapt_work_fn);
+
+/*
+ * Thermal placement: when the big cluster is capped its capacity drops
+ * towards, or below, that of the little cluster at full clock, and the
+ * policy thresholds still send heavy tasks up to it. Both thresholds are
+ * then raised by up to thermal_range, in proportion to how much of the
+ * big cluster's lead over the little one the cap took away: fewer tasks
+ * go up and more come down.
+ */
+static unsigned int hmp_thermal_enable;
+static unsigned int hmp_thermal_shift;
+static struct hmpth_thermal_sample hmp_thermal_hist[HMPTH_HISTORY_LEN];
+static unsigned int hmp_thermal_nr_samples;
+
+static unsigned int thermal_range = 512;
+module_param(thermal_range, uint, 0644);
+
+/* the policy max has settled and the capacity scale follows it by then */
+#define HMPTH_THERMAL_DELAY_MS 10
+
+static void hmpth_thermal_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(hmpth_thermal_work, hmpth_thermal_work_fn);
+
 #define debug_hmp_policy_struct(n, t) {}
 
 
@@ -50,6 +130,23 @@ static void set_hmp_thresholds(unsigned int tsh_up, unsigned int tsh_down)
 	return;
 }
 
+/* index of @pname at @prio in hmp_policy, or -1 */
+static int find_policy(const char *pname, int prio)
+{
+	int plcon = 0;
+	unsigned long inputlen = strlen(pname);
+
+	while (plcon < MAX_MUM_POLICY) {
+		if ((inputlen == strlen(hmp_policy[plcon].name))
+			&& (strncmp(hmp_policy[plcon].name,
+				pname, inputlen) == 0)
+			&& (hmp_policy[plcon].prior == prio))
+			return plcon;
+		plcon++;
+	}
+	return -1;
+}
+
 static void calc_thresholds(void)
 {
 	int cntpc = 0;
@@ -57,6 +154,7 @@ static void calc_thresholds(void)
 	unsigned int up_value = 0;
 	unsigned int down_value = 0;
 	int prior_direct = LOWPOWER;
+	int top = -1;
 
 	while (cntpc < MAX_MUM_POLICY) {
 		if (strlen(pri_hmp_policy[cntpc].name) == 0)
@@ -74,6 +172,7 @@ static void calc_thresholds(void)
 			up_value = pri_hmp_policy[cntpc].thrsh_up;
 			down_value = pri_hmp_policy[cntpc].thrsh_down;
 			prior_direct = pri_hmp_policy[cntpc].prior_direct;
+			top = cntpc;
 			/*this is the default state*/
 			if (0 == priority)
 				break;
@@ -98,6 +197,25 @@ static void calc_thresholds(void)
 		cntpc++;
 	}
 
+	hmp_adapt_active = top < 0 ? -1 :
+		find_policy(pri_hmp_policy[top].name, pri_hmp_policy[top].prior);
+	if (hmp_adapt_enable && hmp_adapt_active >= 0) {
+		struct hmpth_adapt *ad = &hmp_adapt[hmp_adapt_active];
+
+		up_value = min(up_value + ad->up_widen,
+			       (unsigned int)MAX_THRESHOLDS);
+		down_value = down_value > ad->down_widen + MIN_THRESHOLDS ?
+			down_value - ad->down_widen : MIN_THRESHOLDS;
+	}
+
+	if (hmp_thermal_enable && hmp_thermal_shift) {
+		up_value = min(up_value + hmp_thermal_shift,
+			       (unsigned int)MAX_THRESHOLDS);
+		down_value = min(down_value + hmp_thermal_shift,
+				 up_value - min(up_value,
+						(unsigned int)UP_MUST_BIG_THAN_DOWN));
+	}
+
 	if (up_value - down_value < 100) {
 		pr_err("hmpth: error! it's impossible to enter here!\n");
 		if (up_value < 100)
@@ -172,25 +290,20 @@ static void rearrange_policys(void)
 static int fill_policy_in(const char *pname, int prio, int state,
 		unsigned int up_thresholds, unsigned int down_thresholds)
 {
-	int plcon = 0;
-	unsigned long inputlen = strlen(pname);
+	int plcon;
 
 	/*first, try to find if policy exist*/
-	while (plcon < MAX_MUM_POLICY) {
-		if ((inputlen == strlen(hmp_policy[plcon].name))
-			&& (strncmp(hmp_policy[plcon].name,
-				pname, inputlen) == 0)
-			&& (hmp_policy[plcon].prior == prio)) {
-			cp_policy(&hmp_policy[plcon], pname, prio, state,
-				up_thresholds, down_thresholds);
-			return 0;
-		}
-		plcon++;
+	plcon = find_policy(pname, prio);
+	if (plcon >= 0) {
+		cp_policy(&hmp_policy[plcon], pname, prio, state,
+			up_thresholds, down_thresholds);
+		return 0;
 	}
 	/*second, policy not exist, find a vacant*/
 	plcon = 0;
 	while (plcon < MAX_MUM_POLICY) {
 		if (0 == strlen(hmp_policy[plcon].name)) {
+			memset(&hmp_adapt[plcon], 0x00, sizeof(hmp_adapt[plcon]));
 			cp_policy(&hmp_policy[plcon],
 				pname, prio, state,
 				up_thresholds, down_thresholds);
@@ -275,8 +388,10 @@ int set_hmp_policy(const char *pname, int prio, int state,
 	/*fill the input policy into hmp_policy*/
 	ret = fill_policy_in(pname, prio, state,
 		up_thresholds, down_thresholds);
-	if (ret < 0)
+	if (ret < 0) {
+		spin_unlock_bh(&hmpset_lock);
 		return -1;
+	}
 	debug_hmp_policy_struct("fill_policy_in", &hmp_policy[0]);
 	/*rearrange policys by priority*/
 	rearrange_policys();
@@ -297,6 +412,183 @@ err_input:
 
 }
 
+/*
+ * Called by the scheduler, with its locks held, before @tsk moves to
+ * @dest. Big cores are on the higher cluster ids.
+ */
+static void hmpth_sched_hmp_migrate(void *ignore, struct task_struct *tsk,
+		int dest, int force)
+{
+	struct hmpth_task_mig *tm;
+	int src = task_cpu(tsk);
+	int src_cl = topology_physical_package_id(src);
+	int dest_cl = topology_physical_package_id(dest);
+	int dir;
+	u64 now, res;
+
+	if (src_cl == dest_cl)
+		return;
+
+	dir = dest_cl > src_cl ? HMPTH_MIG_UP : HMPTH_MIG_DOWN;
+	now = sched_clock();
+	atomic_inc(&hmpth_migrations);
+
+	/* racing updates only lose a sample */
+	tm = &hmpth_task_mig[hash_32((u32)tsk->pid, HMPTH_TASK_HASH_BITS)];
+	if (tm->pid == tsk->pid && tm->dir && tm->dir != dir) {
+		res = now - tm->ts;
+		if (tm->dir == HMPTH_MIG_UP) {
+			atomic64_add(res, &hmpth_up_res_ns);
+			atomic_inc(&hmpth_up_res_nr);
+			if (res < (u64)adapt_window_ms * NSEC_PER_MSEC)
+				atomic_inc(&hmpth_up_bounces);
+		} else {
+			atomic64_add(res, &hmpth_down_res_ns);
+			atomic_inc(&hmpth_down_res_nr);
+			if (res < (u64)adapt_window_ms * NSEC_PER_MSEC)
+				atomic_inc(&hmpth_down_bounces);
+		}
+	}
+	tm->pid = tsk->pid;
+	tm->dir = dir;
+	tm->ts = now;
+}
+
+static unsigned int hmpth_adapt_widen(unsigned int widen,
+		unsigned int bounces, unsigned int migrations)
+{
+	if (bounces * 100 > migrations * adapt_bounce_pct)
+		return min(widen + adapt_step, adapt_range);
+	return widen > adapt_step ? widen - adapt_step : 0;
+}
+
+static void hmpth_adapt_work_fn(struct work_struct *work)
+{
+	struct hmpth_adapt_sample s;
+	struct hmpth_adapt *ad;
+	unsigned int nr;
+
+	memset(&s, 0x00, sizeof(s));
+	s.migrations = (unsigned int)atomic_xchg(&hmpth_migrations, 0);
+	s.up_bounces = (unsigned int)atomic_xchg(&hmpth_up_bounces, 0);
+	s.down_bounces = (unsigned int)atomic_xchg(&hmpth_down_bounces, 0);
+	nr = (unsigned int)atomic_xchg(&hmpth_up_res_nr, 0);
+	if (nr)
+		s.up_res_ms = (unsigned int)div64_u64(
+			atomic64_xchg(&hmpth_up_res_ns, 0),
+			(u64)nr * NSEC_PER_MSEC);
+	nr = (unsigned int)atomic_xchg(&hmpth_down_res_nr, 0);
+	if (nr)
+		s.down_res_ms = (unsigned int)div64_u64(
+			atomic64_xchg(&hmpth_down_res_ns, 0),
+			(u64)nr * NSEC_PER_MSEC);
+
+	spin_lock_bh(&hmpset_lock);
+	if (hmpset_enable && hmp_adapt_enable && hmp_adapt_active >= 0) {
+		ad = &hmp_adapt[hmp_adapt_active];
+		if (s.migrations >= HMPTH_ADAPT_MIN_MIGRATIONS) {
+			ad->up_widen = hmpth_adapt_widen(ad->up_widen,
+					s.up_bounces, s.migrations);
+			ad->down_widen = hmpth_adapt_widen(ad->down_widen,
+					s.down_bounces, s.migrations);
+		}
+		s.up_widen = ad->up_widen;
+		s.down_widen = ad->down_widen;
+		ad->hist[ad->nr_samples % HMPTH_HISTORY_LEN] = s;
+		ad->nr_samples++;
+		calc_thresholds();
+	}
+	spin_unlock_bh(&hmpset_lock);
+
+	schedule_delayed_work(&hmpth_adapt_work,
+		msecs_to_jiffies(max(adapt_period_ms, 10U)));
+}
+
+/*
+ * capacity of @cluster's online cpus at their current max frequency, and
+ * uncapped in @full; 0 when the cluster is offline.
+ */
+static unsigned long hmpth_cluster_capacity(int cluster, unsigned long *full,
+		unsigned int *khz)
+{
+	unsigned long cap, scale;
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		if (topology_physical_package_id(cpu) != cluster)
+			continue;
+		cap = arch_scale_cpu_capacity(NULL, cpu);
+		scale = cpufreq_scale_max_freq_capacity(cpu);
+		*full = scale ? (cap << SCHED_CAPACITY_SHIFT) / scale : cap;
+		*khz = cpufreq_quick_get_max(cpu);
+		return cap;
+	}
+
+	return 0;
+}
+
+static void hmpth_thermal_work_fn(struct work_struct *work)
+{
+	struct hmpth_thermal_sample s;
+	unsigned long little_cap, little_full, big_cap, big_full, lead;
+	unsigned int little_khz, big_khz;
+	unsigned int shift = 0;
+	int big = 0, cpu;
+
+	for_each_possible_cpu(cpu)
+		big = max(big, topology_physical_package_id(cpu));
+	if (!big)
+		return;
+
+	get_online_cpus();
+	little_cap = hmpth_cluster_capacity(0, &little_full, &little_khz);
+	big_cap = hmpth_cluster_capacity(big, &big_full, &big_khz);
+	put_online_cpus();
+	if (!little_cap || !big_cap || big_full <= little_full)
+		return;
+
+	/* the little cluster is never capped as hard, compare at full clock */
+	lead = big_cap > little_full ? big_cap - little_full : 0;
+	shift = thermal_range - (unsigned int)(thermal_range * lead /
+					       (big_full - little_full));
+
+	spin_lock_bh(&hmpset_lock);
+	if (shift == hmp_thermal_shift) {
+		spin_unlock_bh(&hmpset_lock);
+		return;
+	}
+	hmp_thermal_shift = shift;
+	if (hmpset_enable)
+		calc_thresholds();
+
+	s.ts_ms = jiffies_to_msecs(jiffies - INITIAL_JIFFIES);
+	s.big_khz = big_khz;
+	s.little_cap = (unsigned int)little_full;
+	s.big_cap = (unsigned int)big_cap;
+	s.big_full = (unsigned int)big_full;
+	s.shift = shift;
+	s.up = hmp_up_threshold;
+	s.down = hmp_down_threshold;
+	hmp_thermal_hist[hmp_thermal_nr_samples % HMPTH_HISTORY_LEN] = s;
+	hmp_thermal_nr_samples++;
+	spin_unlock_bh(&hmpset_lock);
+}
+
+/* a new policy max, e.g. from cpu_cooling, changes the capacities */
+static int hmpth_cpufreq_notify(struct notifier_block *nb,
+		unsigned long event, void *data)
+{
+	if (event == CPUFREQ_NOTIFY)
+		schedule_delayed_work(&hmpth_thermal_work,
+			msecs_to_jiffies(HMPTH_THERMAL_DELAY_MS));
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block hmpth_cpufreq_nb = {
+	.notifier_call = hmpth_cpufreq_notify,
+};
+
 /*lint -e715 -esym(715,*)*/
 static ssize_t policy_show(struct kobject *kobj,
 		struct kobj_attribute *attr, char *buf)
@@ -434,6 +726,7 @@ static ssize_t enable_store(struct kobject *kobj,
 	if (hmpset_enable != input) {
 		if(input) {
 			memset(hmp_policy, 0x00, sizeof(hmp_policy));
+			memset(hmp_adapt, 0x00, sizeof(hmp_adapt));
 			set_hmp_policy(DEFAULT_POLICY_NAME, PRIOR_0, STATE_ON,
 				hmp_up_threshold, hmp_down_threshold);
 		}
@@ -450,11 +743,202 @@ static struct kobj_attribute enable_attr = {
 	.show   = enable_show,
 	.store  = enable_store,
 };
+
+static ssize_t adapt_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	return snprintf(buf, (unsigned long)16, "%u\n", hmp_adapt_enable);
+}
+
+static ssize_t adapt_store(struct kobject *kobj,
+	struct kobj_attribute *attr, const char *buf, size_t n)
+{
+	unsigned int input;
+	int ret;
+
+	ret = sscanf(buf, "%u", &input);
+	if (ret != 1 || input > 1)
+		return -EINVAL;
+
+	mutex_lock(&hmp_adapt_mutex);
+	if (hmp_adapt_enable == input)
+		goto out;
+
+	if (input) {
+		ret = register_trace_sched_hmp_migrate(hmpth_sched_hmp_migrate,
+						       NULL);
+		if (ret) {
+			mutex_unlock(&hmp_adapt_mutex);
+			return ret;
+		}
+		hmp_adapt_enable = input;
+		schedule_delayed_work(&hmpth_adapt_work,
+			msecs_to_jiffies(max(adapt_period_ms, 10U)));
+	} else {
+		unregister_trace_sched_hmp_migrate(hmpth_sched_hmp_migrate,
+						   NULL);
+		tracepoint_synchronize_unregister();
+		cancel_delayed_work_sync(&hmpth_adapt_work);
+		spin_lock_bh(&hmpset_lock);
+		hmp_adapt_enable = input;
+		/* back to the plain policy values */
+		if (hmpset_enable)
+			calc_thresholds();
+		spin_unlock_bh(&hmpset_lock);
+	}
+out:
+	mutex_unlock(&hmp_adapt_mutex);
+	return (int)n;
+}
+
+static struct kobj_attribute adapt_attr = {
+	.attr   = {
+		.name = "adapt",
+		.mode = 0644,
+	},
+	.show   = adapt_show,
+	.store  = adapt_store,
+};
+
+static ssize_t adapt_history_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct hmpth_adapt_sample *s;
+	struct hmpth_adapt *ad;
+	unsigned int i, first;
+	ssize_t len = 0;
+	int plcon;
+
+	spin_lock_bh(&hmpset_lock);
+	for (plcon = 0; plcon < MAX_MUM_POLICY; plcon++) {
+		if (strlen(hmp_policy[plcon].name) == 0)
+			continue;
+		ad = &hmp_adapt[plcon];
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+			"%s %d%s: up +%u down -%u\n",
+			hmp_policy[plcon].name, hmp_policy[plcon].prior,
+			plcon == hmp_adapt_active ? " (active)" : "",
+			ad->up_widen, ad->down_widen);
+
+		first = ad->nr_samples > HMPTH_HISTORY_LEN ?
+			ad->nr_samples - HMPTH_HISTORY_LEN : 0;
+		for (i = first; i < ad->nr_samples; i++) {
+			s = &ad->hist[i % HMPTH_HISTORY_LEN];
+			len += scnprintf(buf + len, PAGE_SIZE - len,
+				"  migr %u bounce %u/%u res_ms %u/%u widen %u/%u\n",
+				s->migrations, s->up_bounces, s->down_bounces,
+				s->up_res_ms, s->down_res_ms,
+				s->up_widen, s->down_widen);
+		}
+	}
+	spin_unlock_bh(&hmpset_lock);
+
+	return len;
+}
+
+static struct kobj_attribute adapt_history_attr = {
+	.attr   = {
+		.name = "adapt_history",
+		.mode = 0444,
+	},
+	.show   = adapt_history_show,
+};
+
+static ssize_t thermal_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	return snprintf(buf, (unsigned long)16, "%u\n", hmp_thermal_enable);
+}
+
+static ssize_t thermal_store(struct kobject *kobj,
+	struct kobj_attribute *attr, const char *buf, size_t n)
+{
+	unsigned int input;
+	int ret;
+
+	ret = sscanf(buf, "%u", &input);
+	if (ret != 1 || input > 1)
+		return -EINVAL;
+
+	mutex_lock(&hmp_adapt_mutex);
+	if (hmp_thermal_enable == input)
+		goto out;
+
+	if (input) {
+		ret = cpufreq_register_notifier(&hmpth_cpufreq_nb,
+						CPUFREQ_POLICY_NOTIFIER);
+		if (ret) {
+			mutex_unlock(&hmp_adapt_mutex);
+			return ret;
+		}
+		hmp_thermal_enable = input;
+		/* the big cluster may be capped already */
+		schedule_delayed_work(&hmpth_thermal_work, 0);
+	} else {
+		cpufreq_unregister_notifier(&hmpth_cpufreq_nb,
+					    CPUFREQ_POLICY_NOTIFIER);
+		cancel_delayed_work_sync(&hmpth_thermal_work);
+		spin_lock_bh(&hmpset_lock);
+		hmp_thermal_enable = input;
+		hmp_thermal_shift = 0;
+		if (hmpset_enable)
+			calc_thresholds();
+		spin_unlock_bh(&hmpset_lock);
+	}
+out:
+	mutex_unlock(&hmp_adapt_mutex);
+	return (int)n;
+}
+
+static struct kobj_attribute thermal_attr = {
+	.attr   = {
+		.name = "thermal",
+		.mode = 0644,
+	},
+	.show   = thermal_show,
+	.store  = thermal_store,
+};
+
+static ssize_t thermal_history_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct hmpth_thermal_sample *s;
+	unsigned int i, first;
+	ssize_t len = 0;
+
+	spin_lock_bh(&hmpset_lock);
+	len += scnprintf(buf + len, PAGE_SIZE - len, "shift %u\n",
+		hmp_thermal_shift);
+	first = hmp_thermal_nr_samples > HMPTH_HISTORY_LEN ?
+		hmp_thermal_nr_samples - HMPTH_HISTORY_LEN : 0;
+	for (i = first; i < hmp_thermal_nr_samples; i++) {
+		s = &hmp_thermal_hist[i % HMPTH_HISTORY_LEN];
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+			"  %u ms big_khz %u cap %u/%u/%u shift %u up %u down %u\n",
+			s->ts_ms, s->big_khz, s->little_cap, s->big_cap,
+			s->big_full, s->shift, s->up, s->down);
+	}
+	spin_unlock_bh(&hmpset_lock);
+
+	return len;
+}
+
+static struct kobj_attribute thermal_history_attr = {
+	.attr   = {
+		.name = "thermal_history",
+		.mode = 0444,
+	},
+	.show   = thermal_history_show,
+};
 /*lint -e715 +esym(715,*)*/
 
 static struct attribute *attrs[] = {
 	&enable_attr.attr,
 	&policy_attr.attr,
+	&adapt_attr.attr,
+	&adapt_history_attr.attr,
+	&thermal_attr.attr,
+	&thermal_history_attr.attr,
 	NULL
 };
 
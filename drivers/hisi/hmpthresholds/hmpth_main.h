@@ -67,6 +67,54 @@ struct hmp_policy_struct {
 	int prior_direct;
 };
 
+/*
+ * adaptive thresholds, one sample per adapt period:
+ * migrations: hmp migrations seen.
+ * up_bounces: tasks back on the little cores soon after going up.
+ * down_bounces: tasks back on the big cores soon after going down.
+ * up_res_ms, down_res_ms: mean time a task stayed after going up/down.
+ * up_widen, down_widen: how far thrsh_up was raised and thrsh_down
+ *		lowered from the policy's own values after this sample.
+ */
+#define HMPTH_HISTORY_LEN 8
+
+struct hmpth_adapt_sample {
+	unsigned int migrations;
+	unsigned int up_bounces;
+	unsigned int down_bounces;
+	unsigned int up_res_ms;
+	unsigned int down_res_ms;
+	unsigned int up_widen;
+	unsigned int down_widen;
+};
+
+struct hmpth_adapt {
+	unsigned int up_widen;
+	unsigned int down_widen;
+	unsigned int nr_samples;
+	struct hmpth_adapt_sample hist[HMPTH_HISTORY_LEN];
+};
+
+/*
+ * thermal placement, one sample per change of the shift:
+ * ts_ms: when the sample was taken, in ms since boot.
+ * big_khz: max frequency the big cluster was allowed.
+ * little_cap, big_cap, big_full: capacity of the little cluster, of the
+ *		big one at big_khz and of the big one uncapped.
+ * shift: how far both thresholds were raised for it.
+ * up, down: the thresholds in use afterwards.
+ */
+struct hmpth_thermal_sample {
+	unsigned int ts_ms;
+	unsigned int big_khz;
+	unsigned int little_cap;
+	unsigned int big_cap;
+	unsigned int big_full;
+	unsigned int shift;
+	unsigned int up;
+	unsigned int down;
+};
+
 /* is lowercase character*/
 static inline int islowchac(int ch)
 {
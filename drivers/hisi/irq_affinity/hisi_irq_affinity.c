@@ -19,6 +19,12 @@
 #include <linux/interrupt.h>
 #include <linux/cpu.h>
 #include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/cpuidle.h>
+#include <linux/topology.h>
+#include <linux/kernel_stat.h>
+#include <linux/workqueue.h>
+#include <linux/seq_file.h>
 #include <asm/irq.h>
 
 #define MODULE_NAME "[HISI IRQ AFFINITY]"
@@ -27,6 +33,16 @@ struct irq_affinity_info {
 	struct list_head node;
 	int cpu;
 	unsigned int irq;
+	/* balancer state, see irqaff_balance_work_fn() */
+	bool balance;
+	pid_t consumer;
+	int consumer_cpu;
+	unsigned int consumer_stable;
+	unsigned int last_count;
+	unsigned int rate;		/* per second */
+	unsigned int stay;		/* periods on the current cpu */
+	unsigned int moves;
+	unsigned long seq;		/* last balance pass */
 };
 
 struct irq_affinity_list {
@@ -36,6 +52,33 @@ struct irq_affinity_list {
 
 struct irq_affinity_list irqaff_list[NR_CPUS];
 
+/*
+ * Load aware balancing of the registered irqs marked for it. Every
+ * balance_interval_ms the rate of those irqs is sampled, and one firing
+ * at least balance_min_rate times a second is moved:
+ * - to the cpu its consumer thread has been running on for two periods
+ *   in a row, if one was given;
+ * - away from a cpu that spent more than balance_idle_pct of the period
+ *   in a deep idle state, to the least idle cpu of the same cluster.
+ * An irq stays at least balance_min_stay periods on a cpu.
+ */
+static unsigned int balance_interval_ms = 1000;
+module_param(balance_interval_ms, uint, 0644);
+static unsigned int balance_min_rate = 200;
+module_param(balance_min_rate, uint, 0644);
+static unsigned int balance_idle_pct = 80;
+module_param(balance_idle_pct, uint, 0644);
+static unsigned int balance_min_stay = 3;
+module_param(balance_min_stay, uint, 0644);
+
+static u64 irqaff_idle_us[NR_CPUS];
+static unsigned int irqaff_idle_pct[NR_CPUS];
+static u64 irqaff_last_balance;
+static unsigned long irqaff_balance_seq;
+
+static void irqaff_balance_work_fn(struct work_struct *work);
+static DECLARE_DEFERRABLE_WORK(irqaff_balance_work, irqaff_balance_work_fn);
+
 void hisi_irqaffinity_status(void)
 {
 	struct irq_affinity_info *p = NULL;
@@ -197,6 +240,211 @@ void hisi_irqaffinity_unregister(unsigned int irq)
 }
 EXPORT_SYMBOL_GPL(hisi_irqaffinity_unregister);
 
+static void irqaff_balance_kick(void)
+{
+	if (balance_interval_ms)
+		mod_delayed_work(system_wq, &irqaff_balance_work,
+				 msecs_to_jiffies(balance_interval_ms));
+}
+
+/* balance @irq, consumed by the thread @consumer if not 0 */
+int hisi_irqaffinity_set_balance(unsigned int irq, bool balance,
+				 pid_t consumer)
+{
+	struct irq_affinity_info *p = NULL;
+	spinlock_t *list_lock = NULL;
+	int cpu, gotten = 0;
+
+	for (cpu = 0; cpu < nr_cpu_ids; cpu++) {
+		list_lock = &irqaff_list[cpu].irqaff_lock;
+
+		spin_lock(list_lock);
+		list_for_each_entry(p, &irqaff_list[cpu].list, node) {
+			if (p->irq == irq) {
+				gotten = 1;
+				p->balance = balance;
+				p->consumer = consumer;
+				p->consumer_stable = 0;
+				p->last_count = kstat_irqs(irq);
+				p->rate = 0;
+				break;
+			}
+		}
+		spin_unlock(list_lock);
+
+		if (gotten)
+			break;
+	}
+
+	if (!gotten)
+		return -ENOENT;
+
+	if (balance)
+		irqaff_balance_kick();
+	return 0;
+}
+EXPORT_SYMBOL_GPL(hisi_irqaffinity_set_balance);
+
+void hisi_irqaffinity_rates(struct seq_file *s)
+{
+	struct irq_affinity_info *p = NULL;
+	spinlock_t *list_lock = NULL;
+	int cpu;
+
+	seq_puts(s, "irq cpu balance rate moves consumer idle%\n");
+	for (cpu = 0; cpu < nr_cpu_ids; cpu++) {
+		list_lock = &irqaff_list[cpu].irqaff_lock;
+
+		spin_lock(list_lock);
+		list_for_each_entry(p, &irqaff_list[cpu].list, node)
+			seq_printf(s, "%3u %3d %7d %4u %5u %8d %5u\n",
+				   p->irq, p->cpu, p->balance, p->rate,
+				   p->moves, p->consumer, irqaff_idle_pct[cpu]);
+		spin_unlock(list_lock);
+	}
+}
+EXPORT_SYMBOL_GPL(hisi_irqaffinity_rates);
+
+static void irqaff_update_idle(u64 elapsed_us)
+{
+	struct cpuidle_device *dev;
+	struct cpuidle_driver *drv;
+	u64 sum, delta;
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		dev = per_cpu(cpuidle_devices, cpu);
+		drv = cpuidle_get_cpu_driver(dev);
+		if (!dev || !drv)
+			continue;
+
+		/* time past WFI, a wakeup there costs the most */
+		sum = 0;
+		for (i = 1; i < drv->state_count; i++)
+			sum += dev->states_usage[i].time;
+		delta = sum - irqaff_idle_us[cpu];
+		irqaff_idle_us[cpu] = sum;
+		irqaff_idle_pct[cpu] = elapsed_us ? (unsigned int)min_t(u64,
+			100, div64_u64(delta * 100, elapsed_us)) : 0;
+		if (!cpu_online(cpu))
+			irqaff_idle_pct[cpu] = 100;
+	}
+}
+
+static int irqaff_consumer_cpu(pid_t pid)
+{
+	struct task_struct *t;
+	int cpu = -1;
+
+	rcu_read_lock();
+	t = find_task_by_vpid(pid);
+	if (t)
+		cpu = task_cpu(t);
+	rcu_read_unlock();
+
+	return cpu;
+}
+
+static int irqaff_least_idle(int cpu)
+{
+	int i, best = cpu;
+
+	for_each_online_cpu(i) {
+		if (topology_physical_package_id(i) !=
+		    topology_physical_package_id(cpu))
+			continue;
+		if (irqaff_idle_pct[i] < irqaff_idle_pct[best])
+			best = i;
+	}
+	return best;
+}
+
+/* must be called with the list lock of @p->cpu held */
+static int irqaff_balance_target(struct irq_affinity_info *p,
+				 unsigned int elapsed_ms)
+{
+	unsigned int count = kstat_irqs(p->irq);
+	int ccpu, target = p->cpu;
+
+	p->rate = elapsed_ms ? (count - p->last_count) * MSEC_PER_SEC /
+		elapsed_ms : 0;
+	p->last_count = count;
+	p->stay++;
+
+	if (p->consumer) {
+		ccpu = irqaff_consumer_cpu(p->consumer);
+		if (ccpu >= 0 && ccpu == p->consumer_cpu)
+			p->consumer_stable++;
+		else
+			p->consumer_stable = 0;
+		p->consumer_cpu = ccpu;
+	}
+
+	if (p->rate < balance_min_rate || p->stay < balance_min_stay)
+		return p->cpu;
+
+	if (p->consumer && p->consumer_stable >= 1 && p->consumer_cpu >= 0 &&
+	    cpu_online(p->consumer_cpu))
+		target = p->consumer_cpu;
+	else if (irqaff_idle_pct[p->cpu] > balance_idle_pct)
+		target = irqaff_least_idle(p->cpu);
+
+	return target;
+}
+
+static void irqaff_balance_work_fn(struct work_struct *work)
+{
+	struct irq_affinity_info *p = NULL, *tmp = NULL;
+	unsigned int elapsed_ms;
+	bool any = false;
+	int cpu, target;
+	u64 now;
+
+	now = ktime_to_us(ktime_get());
+	elapsed_ms = (unsigned int)div_u64(now - irqaff_last_balance,
+					   USEC_PER_MSEC);
+	irqaff_update_idle(now - irqaff_last_balance);
+	irqaff_last_balance = now;
+	irqaff_balance_seq++;
+
+	get_online_cpus();
+	for (cpu = 0; cpu < nr_cpu_ids; cpu++) {
+		spinlock_t *list_lock = &irqaff_list[cpu].irqaff_lock;
+
+		spin_lock(list_lock);
+		list_for_each_entry_safe(p, tmp, &irqaff_list[cpu].list, node) {
+			if (!p->balance)
+				continue;
+			any = true;
+			/* moved to this list earlier in the pass */
+			if (p->seq == irqaff_balance_seq)
+				continue;
+			p->seq = irqaff_balance_seq;
+
+			target = irqaff_balance_target(p, elapsed_ms);
+			if (target == p->cpu || !cpu_online(target))
+				continue;
+			if (irq_set_affinity(p->irq, cpumask_of(target)))
+				continue;
+
+			/* only the balancer nests the list locks */
+			p->cpu = target;
+			p->stay = 0;
+			p->moves++;
+			list_del(&p->node);
+			spin_lock(&irqaff_list[target].irqaff_lock);
+			list_add_tail(&p->node, &irqaff_list[target].list);
+			spin_unlock(&irqaff_list[target].irqaff_lock);
+		}
+		spin_unlock(list_lock);
+	}
+	put_online_cpus();
+
+	if (any && balance_interval_ms)
+		schedule_delayed_work(&irqaff_balance_work,
+				      msecs_to_jiffies(balance_interval_ms));
+}
+
 static int __cpuinit
 hisi_irqaffinity_hotplug_notify(struct notifier_block *self,
 				unsigned long action, void *hcpu)
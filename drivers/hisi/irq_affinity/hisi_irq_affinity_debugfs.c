@@ -11,6 +11,7 @@
 #include <linux/module.h>
 #include <linux/init.h>
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/uaccess.h>
 #include <linux/hisi/hisi_irq_affinity.h>
 
@@ -19,6 +20,7 @@
 
 static struct dentry *irqaff_debug_dir;
 static struct dentry *irqaff_debug_fn;
+static struct dentry *irqaff_rates_fn;
 
 static int irqaff_debugfs_show(struct seq_file *s, void *data)
 {
@@ -31,6 +33,24 @@ static int irqaff_debugfs_open(struct inode *inode, struct file *file)
 	return single_open(file, irqaff_debugfs_show, inode->i_private);
 }
 
+static int irqaff_rates_show(struct seq_file *s, void *data)
+{
+	hisi_irqaffinity_rates(s);
+	return 0;
+}
+
+static int irqaff_rates_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, irqaff_rates_show, inode->i_private);
+}
+
+static const struct file_operations irqaff_rates_fops = {
+	.open = irqaff_rates_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static ssize_t
 irqaff_debugfs_write(struct file *filp, const char __user *ubuf,
 		     size_t cnt, loff_t *ppos)
@@ -95,6 +115,22 @@ irqaff_debugfs_write(struct file *filp, const char __user *ubuf,
 		}
 
 		hisi_irqaffinity_unregister(irq);
+	} else if (!strncmp("balance ", _cmd, strlen("balance "))) {
+		unsigned int on, pid = 0;
+		int n;
+
+		/* balance <irq> <0|1> [consumer pid] */
+		n = sscanf(_cmd + strlen("balance "), "%u %u %u",
+			   &irq, &on, &pid);
+		if (n < 2 || on > 1) {
+			cnt = -EINVAL;
+			goto out;
+		}
+
+		if (hisi_irqaffinity_set_balance(irq, on, (pid_t)pid)) {
+			cnt = -EINVAL;
+			goto out;
+		}
 	} else {
 		cnt = -EINVAL;
 		goto out;
@@ -120,6 +156,11 @@ static int __init irqaff_debugfs_init(void)
 						      S_IRUGO, irqaff_debug_dir,
 						      NULL,
 						      &irqaff_debugfs_fops);
+	if (irqaff_debug_dir)
+		irqaff_rates_fn = debugfs_create_file("rates",
+						      S_IRUGO, irqaff_debug_dir,
+						      NULL,
+						      &irqaff_rates_fops);
 
 	return 0;
 }
@@ -128,6 +169,7 @@ module_init(irqaff_debugfs_init);
 
 static void __exit irqaff_debugfs_exit(void)
 {
+	debugfs_remove(irqaff_rates_fn);
 	debugfs_remove(irqaff_debug_fn);
 	debugfs_remove(irqaff_debug_dir);
 }
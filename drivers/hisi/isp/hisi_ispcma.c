@@ -17,6 +17,9 @@
 #include <linux/hisi/hisi_drmdriver.h>
 #include <linux/platform_data/remoteproc-hisi.h>
 #include <linux/of_reserved_mem.h>
+#include <linux/dma-contiguous.h>
+#include <linux/hisi/hisi_cma.h>
+#include <asm/cacheflush.h>
 #include <isp_ddr_map.h>
 
 #define ISP_CMA_START           SEC_ISP_BASE_ADDR
@@ -30,13 +33,48 @@ struct hisi_ispcma_struct {
     struct device *device;
     void *cma_va;
     dma_addr_t cma_dma;
+    struct hisi_cma_prep *prep;
+    struct page *cma_pages;     /* set when cma_va came from a prepare */
 };
 
 struct hisi_ispcma_struct ispcma_dev;
 
+/*
+ * Start evacuating the isp cma region in the background, so that the
+ * hisi_atfisp_cma_alloc() of the next isp power up does not have to
+ * migrate it synchronously.
+ */
+int hisi_atfisp_cma_prepare(void)
+{
+    struct hisi_ispcma_struct *dev = (struct hisi_ispcma_struct *)&ispcma_dev;
+    struct hisi_cma_prep *prep;
+
+    if (!dev->device)
+        return -EINVAL;
+    if (dev->prep || dev->cma_va)
+        return 0;
+
+    prep = hisi_cma_prepare(dev->device, ISP_CMA_MEM_SIZE >> PAGE_SHIFT,
+            get_order(ISP_CMA_MEM_SIZE));
+    if (IS_ERR_OR_NULL(prep))
+        return prep ? PTR_ERR(prep) : -ENODEV;
+
+    dev->prep = prep;
+    return 0;
+}
+
+void hisi_atfisp_cma_prepare_cancel(void)
+{
+    struct hisi_ispcma_struct *dev = (struct hisi_ispcma_struct *)&ispcma_dev;
+
+    hisi_cma_prepare_cancel(dev->prep);
+    dev->prep = NULL;
+}
+
 int hisi_atfisp_cma_alloc(void)
 {
     struct hisi_ispcma_struct *dev = (struct hisi_ispcma_struct *)&ispcma_dev;
+    struct page *pages = NULL;
     dma_addr_t dma;
     void *va;
 
@@ -46,10 +84,21 @@ int hisi_atfisp_cma_alloc(void)
         return -EINVAL;
     }
 
-    va = dma_alloc_coherent(dev->device, ISP_CMA_MEM_SIZE, &dma, GFP_KERNEL);
-    if (!va) {
-        pr_err("%s: alloc failed.\n", __func__);
-        return -ENOMEM;
+    if (dev->prep) {
+        pages = hisi_cma_prepare_take(dev->prep, true);
+        dev->prep = NULL;
+    }
+
+    if (pages) {
+        va = page_address(pages);
+        dma = page_to_phys(pages);
+        __dma_flush_range(va, va + ISP_CMA_MEM_SIZE);
+    } else {
+        va = dma_alloc_coherent(dev->device, ISP_CMA_MEM_SIZE, &dma, GFP_KERNEL);
+        if (!va) {
+            pr_err("%s: alloc failed.\n", __func__);
+            return -ENOMEM;
+        }
     }
     pr_info("%s: va.0x%p, dma.0x%llx.\n", __func__, va, dma);
 
@@ -62,6 +111,7 @@ int hisi_atfisp_cma_alloc(void)
 
     dev->cma_va = va;
     dev->cma_dma = dma;
+    dev->cma_pages = pages;
 
     pr_info("%s: -\n", __func__);
     return 0;
@@ -85,10 +135,15 @@ void hisi_atfisp_cma_free(void)
     create_mapping_late((phys_addr_t)dev->cma_dma, (unsigned long)phys_to_virt(dev->cma_dma),
             ISP_CMA_MEM_SIZE, __pgprot(PROT_NORMAL));
 
-    dma_free_coherent(dev->device, ISP_CMA_MEM_SIZE, dev->cma_va, dev->cma_dma);
+    if (dev->cma_pages)
+        dma_release_from_contiguous(dev->device, dev->cma_pages,
+                ISP_CMA_MEM_SIZE >> PAGE_SHIFT);
+    else
+        dma_free_coherent(dev->device, ISP_CMA_MEM_SIZE, dev->cma_va, dev->cma_dma);
 
     dev->cma_va = NULL;
     dev->cma_dma = 0;
+    dev->cma_pages = NULL;
     pr_info("%s: -\n", __func__);
 }
 
@@ -109,6 +164,8 @@ int hisi_ispcma_probe(struct platform_device *pdev)
 
     dev->cma_va = NULL;
     dev->cma_dma = 0;
+    dev->prep = NULL;
+    dev->cma_pages = NULL;
     pr_info("%s: -\n", __func__);
     return 0;
 
@@ -128,6 +185,7 @@ int hisi_ispcma_remove(struct platform_device *pdev)
         return -EINVAL;
     }
 
+    hisi_atfisp_cma_prepare_cancel();
     of_reserved_mem_device_release(dev->device);
 
     return 0;
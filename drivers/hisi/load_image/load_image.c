@@ -10,6 +10,8 @@
 #include <linux/syscalls.h>
 #include <linux/unistd.h>
 #include <linux/mutex.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
 #include <linux/hisi/hisi_rproc.h>
 #include <linux/hisi/hifidrvinterface.h>
 #include "device_tree.h"
@@ -274,88 +276,112 @@ static s32 trans_data_to_os(TEEC_Session *session,
 	return ret;
 }
 
-int bsp_read_bin(const char *partion_name, unsigned int offset,
-				unsigned int length, char *buffer)
+/*
+ * Function name:load_image_open.
+ * Discription:open the block device of a partition for reading.
+ * Parameters:
+ *      @ partion_name: the partition name.
+ * return value:
+ *      @ the file-->success, NULL-->failed.
+ */
+static struct file *load_image_open(const char *partion_name)
 {
 	int ret;
 	char *pathname;
 	unsigned long pathlen;
 	struct file *fp;
-	mm_segment_t fs;
-	loff_t pos;
 
-	if ((NULL == partion_name) || (NULL == buffer)) {
-		sec_print_err("partion_name(%pK) or buffer(%pK) is null", partion_name, buffer);
-		return SEC_ERROR;
-	}
-
-    /*get resource*/
 	pathlen = sizeof(DEVICE_PATH) + strnlen(partion_name, (unsigned long)PART_NAMELEN);
 	pathname = kmalloc(pathlen, GFP_KERNEL);
 	if (!pathname) {
 		sec_print_err("pathname malloc failed\n");
-		return SEC_ERROR;
+		return NULL;
 	}
 
 	ret = flash_find_ptn((const char *)partion_name, pathname);
 	if (ret < 0) {
 		sec_print_err("partion_name(%s) is not in partion table!\n", partion_name);
-		goto error;
+		kfree(pathname);
+		return NULL;
 	}
 
 	fp = filp_open(pathname, O_RDONLY, 0600);
 	if (IS_ERR(fp)) {
 		sec_print_err("filp_open(%s) failed", pathname);
-		goto error;
+		fp = NULL;
 	}
 
-	ret = vfs_llseek(fp, offset, SEEK_SET);
-	if (ret < 0) {
-		sec_print_err("seek ops failed, ret %d", ret);
-		goto error2;
-	}
+	kfree(pathname);
+	return fp;
+}
+
+static int load_image_read(struct file *fp, loff_t pos,
+				unsigned int length, char *buffer)
+{
+	int ret;
+	mm_segment_t fs;
 
 	fs = get_fs();
 	set_fs(KERNEL_DS);
-
-	pos = fp->f_pos;
 	ret = vfs_read(fp, (char __user *)buffer, length, &pos);
+	set_fs(fs);
+
 	if (ret != length) {
 		sec_print_err("read ops failed, ret=%d(len=%d)", ret, length);
-		set_fs(fs);
-		goto error2;
+		return SEC_ERROR;
 	}
-	set_fs(fs);
 
-	filp_close(fp, NULL);
+	return SEC_OK;
+}
 
+/*
+ * Function name:load_image_readahead.
+ * Discription:submit the block reads of a range to the page cache
+ *             without waiting for them, so that they go on while the
+ *             caller transfers the previous chunk to sec_OS.
+ */
+static void load_image_readahead(struct file *fp, loff_t offset,
+				unsigned int length)
+{
+	pgoff_t index = offset >> PAGE_CACHE_SHIFT;
+	pgoff_t end = (offset + length - 1) >> PAGE_CACHE_SHIFT;
 
-    /*free resource*/
-	if (NULL != pathname) {
-		kfree(pathname);
-		pathname = NULL;
-	}
+	if (length)
+		force_page_cache_readahead(fp->f_mapping, fp, index, end - index + 1);
+}
 
-	return SEC_OK;
+int bsp_read_bin(const char *partion_name, unsigned int offset,
+				unsigned int length, char *buffer)
+{
+	int ret;
+	struct file *fp;
 
-error2:
-	filp_close(fp, NULL);
+	if ((NULL == partion_name) || (NULL == buffer)) {
+		sec_print_err("partion_name(%pK) or buffer(%pK) is null", partion_name, buffer);
+		return SEC_ERROR;
+	}
 
-error:
-    /*ͷԴ2*/
-	if (NULL != pathname) {
-		kfree(pathname);
-		pathname = NULL;
+	fp = load_image_open(partion_name);
+	if (!fp) {
+		sec_print_err("failed");
+		return SEC_ERROR;
 	}
 
-	sec_print_err("failed");
-	return SEC_ERROR;
+	ret = load_image_read(fp, offset, length, buffer);
+	filp_close(fp, NULL);
 
+	if (SEC_OK != ret)
+		sec_print_err("failed");
+	return ret;
 }
 
 /*
  * Function name:load_data_to_os.
  * Discription:cut the  image data to 1M per block, and trans them to  sec_OS.
+ *             The block reads of the next chunk run while the current one
+ *             is transferred, and the first chunk is read before waiting
+ *             for the shared buffer, so the reads of an image overlap
+ *             the transfer of another one loaded at the same time.
  * Parameters:
  *      @ session: the bridge from unsec world to sec world.
  *      @ image: the data of the image to transfer.
@@ -373,9 +399,9 @@ static s32 load_data_to_os(TEEC_Session *session,
                         u32 offset,
                         u32 sizeToRead)
 {
+	struct file *fp;
 	u32 read_bytes;
 	u32 end_bytes;
-	u32 copy_bytes;
 	u32 timers;
 	u32 i;
 	s32 ret = SEC_ERROR;
@@ -390,55 +416,50 @@ static s32 load_data_to_os(TEEC_Session *session,
 
 	end_bytes = sizeToRead;
 
+	fp = load_image_open(part_name);
+	if (!fp) {
+		sec_print_err("%s: err: open %s\n", __func__, part_name);
+		return SEC_ERROR;
+	}
+
+	load_image_readahead(fp, offset, min_t(u32, end_bytes, SECBOOT_BUFLEN));
+
 	mutex_lock(&load_image_lock);
-	/*call flash_read each time to read to memDst.*/
 	for (i = 0; i < timers; i++)
 	{
-		if (end_bytes >= SECBOOT_BUFLEN)
-			read_bytes = SECBOOT_BUFLEN;
-		else
-			read_bytes = end_bytes;
+		read_bytes = min_t(u32, end_bytes, SECBOOT_BUFLEN);
 
-		if (bsp_read_bin(part_name, offset + i * SECBOOT_BUFLEN, read_bytes, (void *)SECBOOT_BUFFER)) {
+		if (load_image_read(fp, offset + i * SECBOOT_BUFLEN, read_bytes, (void *)SECBOOT_BUFFER)) {
 			sec_print_err("%s: err: flash_read\n", __func__);
-			mutex_unlock(&load_image_lock);
-			return SEC_ERROR;
+			ret = SEC_ERROR;
+			goto out;
 		}
 
-		if (end_bytes >= SECBOOT_BUFLEN) {
-			if (SECBOOT_BUFLEN != read_bytes) {
-				sec_print_err("%s: err: SECBOOT_BUFLEN:%d != read_bytes:%d\r\n", __func__, SECBOOT_BUFLEN, read_bytes);
-				mutex_unlock(&load_image_lock);
-				return SEC_ERROR;
-			}
-			copy_bytes = SECBOOT_BUFLEN;
-		} else {
-			if (end_bytes > read_bytes) {
-				sec_print_err("%s: err: end_bytes:%d!= read_bytes:%d\r\n", __func__, end_bytes, read_bytes);
-				mutex_unlock(&load_image_lock);
-				return SEC_ERROR;
-			}
-			copy_bytes = end_bytes;
-		}
+		/*start reading the next chunk before the transfer of this one*/
+		load_image_readahead(fp, offset + (i + 1) * SECBOOT_BUFLEN,
+				min_t(u32, end_bytes - read_bytes, SECBOOT_BUFLEN));
 
-		ret = trans_data_to_os(session, image, run_addr, (void *)(SECBOOT_BUFFER), (i * SECBOOT_BUFLEN), copy_bytes);
+		ret = trans_data_to_os(session, image, run_addr, (void *)(SECBOOT_BUFFER), (i * SECBOOT_BUFLEN), read_bytes);
 		if (SEC_ERROR == ret)
 		{
 			sec_print_err("image trans to os is failed, error code 0x%x\r\n", ret);
-			mutex_unlock(&load_image_lock);
-			return SEC_ERROR;
+			goto out;
 		}
 
-		end_bytes -= copy_bytes;
+		end_bytes -= read_bytes;
 	}
-	mutex_unlock(&load_image_lock);
 
 	if (0 != end_bytes) {
 		sec_print_err("%s: end_bytes = 0x%x\n", __func__, end_bytes);
-		return SEC_ERROR;
+		ret = SEC_ERROR;
+		goto out;
 	}
+	ret = SEC_OK;
 
-	return SEC_OK;
+out:
+	mutex_unlock(&load_image_lock);
+	filp_close(fp, NULL);
+	return ret;
 }
 
 
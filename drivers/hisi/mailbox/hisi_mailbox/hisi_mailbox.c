@@ -20,6 +20,9 @@
 #include <linux/semaphore.h>
 #include <linux/sched/rt.h>
 #include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/hisi/hisi_mailbox.h>
 
 #define MBOX_PR_ERR(fmt, args ...)	\
@@ -55,6 +58,8 @@
 #define MAILBOX_MAX_TX_FIFO	256
 /* tx_thread warn level to bug_on when tx_thread is blocked by some reasons */
 #define TX_THREAD_BUFFER_WARN_LEVEL	(156 * TX_FIFO_CELL_SIZE)
+/* msgs handled per rx interrupt before the irq is enabled again */
+#define MBOX_RX_DRAIN_BUDGET	8
 
 enum { NOCOMPLETION = 0, COMPLETING, COMPLETED };
 enum { TX_TASK = 0, RX_TASK };
@@ -66,6 +71,130 @@ int g_ContinuousFailCnt = 0;
 /* mailbox device resource pool */
 static LIST_HEAD(mdevices);
 
+#ifdef CONFIG_HISI_MAILBOX_DEBUGFS
+/*
+ * Latency and occupancy of each channel, in debugfs hisi_mailbox/stats.
+ * Updated without locking from the paths they measure, so a sample may
+ * occasionally be lost; writing to the file clears them.
+ */
+static void hisi_mbox_stat_latency(struct hisi_mbox_device *mdev, int hist, u64 start_ns)
+{
+	u64 delta;
+	u64 us;
+
+	if (!start_ns)
+		return;
+
+	delta = ktime_get_ns() - start_ns;
+	if (delta > mdev->stats.max_ns[hist])
+		mdev->stats.max_ns[hist] = delta;
+
+	us = div_u64(delta, NSEC_PER_USEC);
+	mdev->stats.hist[hist][min_t(int, fls64(us), MBOX_HIST_BUCKETS - 1)]++;
+}
+
+/* called with fifo_lock held */
+static void hisi_mbox_stat_enqueue(struct hisi_mbox_device *mdev, struct hisi_mbox_task **tx_tasks, int num)
+{
+	u64 now = ktime_get_ns();
+	u32 depth;
+	int i;
+
+	for (i = 0; i < num; i++)
+		tx_tasks[i]->enqueue_ns = now;
+
+	depth = kfifo_len(&mdev->fifo) / TX_FIFO_CELL_SIZE;
+	if (depth > mdev->stats.fifo_hwm)
+		mdev->stats.fifo_hwm = depth;
+}
+
+#define STAT_LATENCY(mdev, hist, start_ns)	hisi_mbox_stat_latency(mdev, hist, start_ns)
+#define STAT_ENQUEUE(mdev, tx_tasks, num)	hisi_mbox_stat_enqueue(mdev, tx_tasks, num)
+#define STAT_DEQUEUE(mdev, tx_task)		hisi_mbox_stat_latency(mdev, MBOX_HIST_TX_QUEUE, (tx_task)->enqueue_ns)
+#define STAT_STAMP(mdev, field)			((mdev)->stats.field = ktime_get_ns())
+#define STAT_CLEAR(mdev, field)			((mdev)->stats.field = 0)
+
+static const char *const hisi_mbox_hist_names[MBOX_HIST_MAX] = {
+	[MBOX_HIST_TX_QUEUE] = "tx_queue",
+	[MBOX_HIST_TX_ACK] = "tx_ack",
+	[MBOX_HIST_RX_BH] = "rx_bh",
+};
+
+static int hisi_mbox_stats_show(struct seq_file *m, void *v)
+{
+	struct hisi_mbox_device *mdev;
+	struct hisi_mbox_stats *st;
+	int i, j;
+
+	seq_puts(m, "histograms in us:");
+	for (j = 0; j < MBOX_HIST_BUCKETS - 1; j++)
+		seq_printf(m, " <%u", 1U << j);
+	seq_printf(m, " >=%u\n", 1U << (MBOX_HIST_BUCKETS - 2));
+
+	list_for_each_entry(mdev, &mdevices, node) {
+		if (!mdev->configured)
+			continue;
+
+		st = &mdev->stats;
+		seq_printf(m, "%s: fifo_hwm %u fifo_full %u busy_waits %u occupy_retries %u\n",
+			   mdev->name, st->fifo_hwm, st->fifo_full, st->busy_waits, st->occupy_retries);
+		for (i = 0; i < MBOX_HIST_MAX; i++) {
+			seq_printf(m, "  %-8s max %lluus:", hisi_mbox_hist_names[i],
+				   div_u64(st->max_ns[i], NSEC_PER_USEC));
+			for (j = 0; j < MBOX_HIST_BUCKETS; j++)
+				seq_printf(m, " %u", st->hist[i][j]);
+			seq_putc(m, '\n');
+		}
+	}
+
+	return 0;
+}
+
+static int hisi_mbox_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hisi_mbox_stats_show, NULL);
+}
+
+static ssize_t hisi_mbox_stats_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+	struct hisi_mbox_device *mdev;
+
+	list_for_each_entry(mdev, &mdevices, node)
+		memset(&mdev->stats, 0, sizeof(mdev->stats));
+
+	return count;
+}
+
+static const struct file_operations hisi_mbox_stats_fops = {
+	.open = hisi_mbox_stats_open,
+	.read = seq_read,
+	.write = hisi_mbox_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void hisi_mbox_debugfs_init(void)
+{
+	struct dentry *root;
+
+	root = debugfs_create_dir("hisi_mailbox", NULL);
+	if (IS_ERR_OR_NULL(root))
+		return;
+
+	debugfs_create_file("stats", 0660, root, NULL, &hisi_mbox_stats_fops);
+}
+#else
+#define STAT_LATENCY(mdev, hist, start_ns)	do {} while (0)
+#define STAT_ENQUEUE(mdev, tx_tasks, num)	do {} while (0)
+#define STAT_DEQUEUE(mdev, tx_task)		do {} while (0)
+#define STAT_STAMP(mdev, field)			do {} while (0)
+#define STAT_CLEAR(mdev, field)			do {} while (0)
+
+static inline void hisi_mbox_debugfs_init(void)
+{
+}
+#endif
+
 
 struct hisi_mbox_task *hisi_mbox_node_alloc(void)
 {
@@ -128,6 +257,7 @@ struct hisi_mbox_task *hisi_mbox_task_alloc(struct hisi_mbox *mbox,
 	memcpy((void *)tx_task->tx_buffer, (void *)tx_buffer, tx_buffer_len * (sizeof(mbox_msg_t)));
 	tx_task->tx_buffer_len = tx_buffer_len;
 	tx_task->need_auto_ack = need_auto_ack;
+	tx_task->tx_complete = NULL;
 
 	if (MBOX_IS_DEBUG_ON(mbox))
 		TASK_DEBUG_ON(tx_task);
@@ -139,6 +269,19 @@ out:
 
 EXPORT_SYMBOL(hisi_mbox_task_alloc);
 
+/* an async task is finished with: complete it, or give it back */
+static void hisi_mbox_task_done(struct hisi_mbox_task **tx_task, int ret)
+{
+	if ((*tx_task)->tx_complete) {
+		(*tx_task)->tx_ret = ret;
+		(*tx_task)->tx_complete(*tx_task);
+		*tx_task = NULL;
+		return;
+	}
+
+	hisi_mbox_task_free(tx_task);
+}
+
 static inline int set_status(struct hisi_mbox_device *mdev, int status)
 {
 	int ret = 0;
@@ -182,6 +325,8 @@ static int hisi_mbox_task_send_async(struct hisi_mbox_device *mdev, struct hisi_
 	mdev->ops->ensure_channel(mdev);
 
 	mdev->tx_task = tx_task;
+	/* async sends are not waited for, only sync ones feed tx_ack */
+	STAT_CLEAR(mdev, tx_ns);
 	ret = mdev->ops->send(mdev, tx_task->tx_buffer, tx_task->tx_buffer_len, tx_task->need_auto_ack);
 	if (ret) {
 		MBOX_PR_ERR("mdev %s can not be sent\n", mdev->name);
@@ -216,6 +361,7 @@ static int hisi_mbox_task_send_sync(struct hisi_mbox_device *mdev, struct hisi_m
 	mdev->completed = NOCOMPLETION;
 	mdev->tx_task = tx_task;
 
+	STAT_STAMP(mdev, tx_ns);
 	ret = mdev->ops->send(mdev, tx_task->tx_buffer, tx_task->tx_buffer_len, tx_task->need_auto_ack);
 	if (ret) {
 		mdev->tx_task = NULL;
@@ -360,7 +506,11 @@ int hisi_mbox_msg_send_sync(struct hisi_mbox *mbox,
 	}
 
 	/* send */
+#ifdef CONFIG_HISI_MAILBOX_DEBUGFS
+	tx_task.enqueue_ns = ktime_get_ns();
+#endif
 	mutex_lock(&mdev->dev_lock);
+	STAT_DEQUEUE(mdev, p_tx_task);
 	ret = hisi_mbox_task_send_sync(mdev, &tx_task);
 	if (!ret && ack_buffer) {
 		memcpy((void *)ack_buffer, (void *)tx_task.ack_buffer, sizeof(mbox_msg_t) / sizeof(u8) * ack_buffer_len);
@@ -407,6 +557,7 @@ int hisi_mbox_msg_send_async(struct hisi_mbox *mbox, struct hisi_mbox_task *tx_t
 	/* enqueue */
 	spin_lock_irqsave(&mdev->fifo_lock, flags);
 	if (kfifo_avail(&mdev->fifo) < TX_FIFO_CELL_SIZE) {
+		MBOX_STAT_INC(mdev, fifo_full);
 		spin_unlock_irqrestore(&mdev->fifo_lock, flags);
 		ret = -ENOMEM;
 		goto clearstatus;
@@ -420,6 +571,7 @@ int hisi_mbox_msg_send_async(struct hisi_mbox *mbox, struct hisi_mbox_task *tx_t
 	}
 
 	kfifo_in(&mdev->fifo, &tx_task, TX_FIFO_CELL_SIZE);
+	STAT_ENQUEUE(mdev, &tx_task, 1);
 
 	spin_unlock_irqrestore(&mdev->fifo_lock, flags);
 
@@ -434,6 +586,62 @@ out:
 
 EXPORT_SYMBOL(hisi_mbox_msg_send_async);
 
+int hisi_mbox_msg_send_async_batch(struct hisi_mbox *mbox, struct hisi_mbox_task **tx_tasks, int num)
+{
+	struct hisi_mbox_device *mdev = NULL;
+	int ret = 0;
+	int i;
+	unsigned long flags;
+
+	if (!tx_tasks || num <= 0 || !mbox || !mbox->tx) {
+		MBOX_PR_ERR("invalid parameters\n");
+		ret = -EINVAL;
+		goto out;
+	}
+
+	for (i = 0; i < num; i++) {
+		if (!tx_tasks[i]) {
+			MBOX_PR_ERR("invalid parameters\n");
+			ret = -EINVAL;
+			goto out;
+		}
+		START_TTS(tx_tasks[i]);
+	}
+
+	mdev = mbox->tx;
+
+	/* ASYNC_ENQUEUE start */
+	ret = set_status(mdev, MDEV_ASYNC_ENQUEUE);
+	if (ret) {
+		MBOX_PR_ERR("MSG{0x%08x, 0x%08x} x %d\n", tx_tasks[0]->tx_buffer[0], tx_tasks[0]->tx_buffer[1], num);
+		goto out;
+	}
+
+	/* enqueue all or none */
+	spin_lock_irqsave(&mdev->fifo_lock, flags);
+	if (kfifo_avail(&mdev->fifo) < num * TX_FIFO_CELL_SIZE) {
+		MBOX_STAT_INC(mdev, fifo_full);
+		spin_unlock_irqrestore(&mdev->fifo_lock, flags);
+		ret = -ENOMEM;
+		goto clearstatus;
+	}
+
+	kfifo_in(&mdev->fifo, tx_tasks, num * TX_FIFO_CELL_SIZE);
+	STAT_ENQUEUE(mdev, tx_tasks, num);
+
+	spin_unlock_irqrestore(&mdev->fifo_lock, flags);
+
+	wake_up_interruptible(&mdev->tx_wait);
+
+clearstatus:
+	/* ASYNC_ENQUEUE end */
+	clr_status(mdev, MDEV_ASYNC_ENQUEUE);
+out:
+	return ret;
+}
+
+EXPORT_SYMBOL(hisi_mbox_msg_send_async_batch);
+
 static struct hisi_mbox_task *hisi_mbox_dequeue_task(struct hisi_mbox_device *mdev)
 {
 	struct hisi_mbox_task *tx_task = NULL;
@@ -446,9 +654,85 @@ static struct hisi_mbox_task *hisi_mbox_dequeue_task(struct hisi_mbox_device *md
 	}
 
 	spin_unlock_irqrestore(&mdev->fifo_lock, flags);
+	if (tx_task)
+		STAT_DEQUEUE(mdev, tx_task);
+	return tx_task;
+}
+
+/*
+ * dequeue the next task only if it can join the batch frame being built:
+ * same ack mode, and its length word and body fit in the room left.
+ */
+static struct hisi_mbox_task *hisi_mbox_dequeue_batch_task(struct hisi_mbox_device *mdev, int ack_mode, int room)
+{
+	struct hisi_mbox_task *tx_task = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&mdev->fifo_lock, flags);
+	if (kfifo_len(&mdev->fifo) >= TX_FIFO_CELL_SIZE &&
+	    kfifo_out_peek(&mdev->fifo, &tx_task, TX_FIFO_CELL_SIZE) &&
+	    tx_task->need_auto_ack == ack_mode &&
+	    tx_task->tx_buffer_len + 1 <= room) {
+		if (!kfifo_out(&mdev->fifo, &tx_task, TX_FIFO_CELL_SIZE))
+			tx_task = NULL;
+	} else {
+		tx_task = NULL;
+	}
+
+	spin_unlock_irqrestore(&mdev->fifo_lock, flags);
+	if (tx_task)
+		STAT_DEQUEUE(mdev, tx_task);
 	return tx_task;
 }
 
+/*
+ * Send 'first', packed with the tasks queued behind it into one batch
+ * frame when the channel takes batch frames. A lone task is sent as is.
+ * All the tasks sent are done here, in queue order.
+ */
+static int hisi_mbox_task_send_batch(struct hisi_mbox_device *mdev, struct hisi_mbox_task *first)
+{
+	struct hisi_mbox_task *tasks[MBOX_CHAN_DATA_SIZE / 2];
+	struct hisi_mbox_task frame;
+	struct hisi_mbox_task *tx_task = first;
+	int size = min_t(int, mdev->batch_size, MBOX_CHAN_DATA_SIZE);
+	int len = 1;
+	int nr = 0;
+	int ret;
+	int i;
+
+	if (first->tx_buffer_len + 2 > size) {
+		ret = hisi_mbox_task_send_async(mdev, first);
+		PRINT_TTS(first);
+		hisi_mbox_task_done(&first, ret);
+		return ret;
+	}
+
+	frame.need_auto_ack = first->need_auto_ack;
+	do {
+		frame.tx_buffer[len++] = tx_task->tx_buffer_len;
+		memcpy((void *)&frame.tx_buffer[len], (void *)tx_task->tx_buffer, tx_task->tx_buffer_len * (sizeof(mbox_msg_t)));
+		len += tx_task->tx_buffer_len;
+		tasks[nr++] = tx_task;
+	} while (nr < (int)ARRAY_SIZE(tasks) &&
+		 (tx_task = hisi_mbox_dequeue_batch_task(mdev, frame.need_auto_ack, size - len)));
+
+	if (1 == nr) {
+		ret = hisi_mbox_task_send_async(mdev, first);
+	} else {
+		frame.tx_buffer[0] = MBOX_BATCH_HEAD(nr);
+		frame.tx_buffer_len = len;
+		ret = hisi_mbox_task_send_async(mdev, &frame);
+	}
+
+	for (i = 0; i < nr; i++) {
+		PRINT_TTS(tasks[i]);
+		hisi_mbox_task_done(&tasks[i], ret);
+	}
+
+	return ret;
+}
+
 void hisi_mbox_empty_task(struct hisi_mbox_device *mdev)
 {
 	struct hisi_mbox_task *tx_task = NULL;
@@ -457,7 +741,7 @@ void hisi_mbox_empty_task(struct hisi_mbox_device *mdev)
 	spin_lock_irqsave(&mdev->fifo_lock, flags);
 	while (kfifo_len(&mdev->fifo) >= TX_FIFO_CELL_SIZE) {
 		if (kfifo_out(&mdev->fifo, &tx_task, TX_FIFO_CELL_SIZE)) {
-			hisi_mbox_task_free(&tx_task);
+			hisi_mbox_task_done(&tx_task, -ECANCELED);
 		}
 	}
 	spin_unlock_irqrestore(&mdev->fifo_lock, flags);
@@ -487,9 +771,13 @@ static int hisi_mbox_tx_thread(void *context)
 		mutex_lock(&mdev->dev_lock);
 		/*kick out the async send request from  mdev's kfifo one by one and send it out */
 		while ((tx_task = hisi_mbox_dequeue_task(mdev))) {
-			ret = hisi_mbox_task_send_async(mdev, tx_task);
-			PRINT_TTS(tx_task);
-			hisi_mbox_task_free(&tx_task);
+			if (mdev->batch_size) {
+				ret = hisi_mbox_task_send_batch(mdev, tx_task);
+			} else {
+				ret = hisi_mbox_task_send_async(mdev, tx_task);
+				PRINT_TTS(tx_task);
+				hisi_mbox_task_done(&tx_task, ret);
+			}
 			/* current task unlinked */
 			mdev->tx_task = NULL;
 		}
@@ -499,14 +787,43 @@ static int hisi_mbox_tx_thread(void *context)
 	return 0;
 }
 
+/*
+ * Pass a received msg to the users, one notification per msg of a batch
+ * frame on channels that take them.
+ */
+static void hisi_mbox_rx_dispatch(struct hisi_mbox_device *mdev, mbox_msg_t *rx_buffer, mbox_msg_len_t rx_len)
+{
+	mbox_msg_len_t pos = 1;
+	mbox_msg_len_t len;
+	int nr;
+
+	if (!mdev->batch_size || !rx_buffer || rx_len <= 0 || !MBOX_IS_BATCH(rx_buffer[0])) {
+		atomic_notifier_call_chain(&mdev->notifier, rx_len, (void *)rx_buffer);
+		return;
+	}
+
+	nr = MBOX_BATCH_NR(rx_buffer[0]);
+	while (nr-- && pos < rx_len) {
+		len = (mbox_msg_len_t)rx_buffer[pos++];
+		if (len <= 0 || len > rx_len - pos) {
+			MBOX_PR_ERR("mdev %s bad batch frame\n", mdev->name);
+			break;
+		}
+		atomic_notifier_call_chain(&mdev->notifier, len, (void *)&rx_buffer[pos]);
+		pos += len;
+	}
+}
+
 static void hisi_mbox_rx_bh(unsigned long context)
 {
 	struct hisi_mbox_device *mdev = (struct hisi_mbox_device *)context;
 	mbox_msg_t *rx_buffer = NULL;
 	mbox_msg_len_t rx_len = 0;
 	unsigned long flags;
+	int budget;
 
 	MBOX_PR_DEBUG("mdev %s rx enter\n", mdev->name);
+	STAT_LATENCY(mdev, MBOX_HIST_RX_BH, mdev->stats.irq_ns);
 
 	/*
 	 * check msg type
@@ -545,9 +862,17 @@ static void hisi_mbox_rx_bh(unsigned long context)
 		break;
 
 	case RX_TASK:
-		rx_len = mdev->ops->recv(mdev, &rx_buffer);
-		atomic_notifier_call_chain(&mdev->notifier, rx_len, (void *)rx_buffer);
-		mdev->ops->ack(mdev, NULL, 0);
+		/*
+		 * recv acks the msg, so the remote may already have sent the
+		 * next one; take it here rather than through another irq.
+		 * recv clears its irq as well.
+		 */
+		budget = MBOX_RX_DRAIN_BUDGET;
+		do {
+			rx_len = mdev->ops->recv(mdev, &rx_buffer);
+			hisi_mbox_rx_dispatch(mdev, rx_buffer, rx_len);
+			mdev->ops->ack(mdev, NULL, 0);
+		} while (--budget && mdev->ops->is_stm(mdev, DESTINATION_STATUS));
 		break;
 
 	default:
@@ -574,6 +899,8 @@ static int hisi_mbox_interrupt(int irq, void *p)
 		return IRQ_NONE;
 	}
 
+	STAT_STAMP(mdev, irq_ns);
+
 	/* ipc */
 	if (mdev->ops->is_stm(mdev, DESTINATION_STATUS)) {
 		MBOX_PR_DEBUG("mdev %s ipc\n", mdev->name);
@@ -588,6 +915,8 @@ static int hisi_mbox_interrupt(int irq, void *p)
 	spin_lock(&mdev->complete_lock);
 	if (mdev->tx_task && mdev->ops->is_stm(mdev, ACK_STATUS)) {
 		RECEIVE_TTS(mdev->tx_task);
+		STAT_LATENCY(mdev, MBOX_HIST_TX_ACK, mdev->stats.tx_ns);
+		STAT_CLEAR(mdev, tx_ns);
 
 		if (unlikely(COMPLETED == mdev->completed)) {
 			spin_unlock(&mdev->complete_lock);
@@ -688,6 +1017,8 @@ static int hisi_mbox_startup(struct hisi_mbox_device *mdev, mbox_mail_type_t mai
 	unsigned int sched_policy = 0;
 	mutex_lock(&mdev->dev_lock);
 	if (!mdev->configured++) {
+		mdev->batch_size = mdev->ops->get_batch_size ? (int)mdev->ops->get_batch_size(mdev) : 0;
+
 		switch (mail_type) {
 		case TX_MAIL:
 			tx_buff = mdev->ops->get_fifo_size(mdev) * TX_FIFO_CELL_SIZE;
@@ -887,6 +1218,7 @@ void hisi_mbox_device_deactivate(struct hisi_mbox_device **list)
 			ret = hisi_mbox_task_send_sync(mdev, tx_task);
 			/* current task unlinked */
 			mdev->tx_task = NULL;
+			hisi_mbox_task_done(&tx_task, ret);
 		}
 		mutex_unlock(&mdev->dev_lock);
 	}
@@ -1002,6 +1334,7 @@ static int __init hisi_mbox_init(void)
 		return PTR_ERR(hisi_mbox_class);
 
 	spin_lock_init(&g_task_buffer_lock);
+	hisi_mbox_debugfs_init();
 	return 0;
 }
 
@@ -141,6 +141,7 @@ struct hisi_mbox_device_priv {
 	unsigned int sched_priority;
 	unsigned int sched_policy;
 	unsigned int hardware_board_type;
+	unsigned int batch;
 	struct hisi_ipc_device *idev;
 };
 
@@ -556,6 +557,7 @@ static int hisi_mdev_occupy(struct hisi_mbox_device *mdev)
 			if (__ipc_read_src(priv->idev->base, priv->mbox_channel) & IPCBITMASK(priv->src))
 				break;
 		}
+		MBOX_STAT_INC(mdev, occupy_retries);
 		retry--;
 		/* Hardware unlock */
 	} while (retry);
@@ -621,6 +623,7 @@ static void hisi_mdev_ensure_channel(struct hisi_mbox_device *mdev)
 	}
 	/*DEST STATUS and SRC STATUS, the dest is processing, wait here */
 	else {						/*if(mdev->ops->is_stm(mdev, DESTINATION_STATUS) || mdev->ops->is_stm(mdev, SOURCE_STATUS)) */
+		MBOX_STAT_INC(mdev, busy_waits);
 		/*the worst situation is to delay 1000*5us+60*5ms = 305ms */
 		while (timeout < loop) {
 			if (timeout < MAILBOX_ASYNC_UDELAY_CNT) {
@@ -836,6 +839,13 @@ static unsigned int hisi_mdev_timeout(struct hisi_mbox_device *mdev)
 	return priv->timeout;
 }
 
+static unsigned int hisi_mdev_batch_size(struct hisi_mbox_device *mdev)
+{
+	struct hisi_mbox_device_priv *priv = mdev->priv;
+
+	return priv->batch ? (unsigned int)priv->capability : 0;
+}
+
 static unsigned int hisi_mdev_fifo_size(struct hisi_mbox_device *mdev)
 {
 	struct hisi_mbox_device_priv *priv = mdev->priv;/*lint !e838 */
@@ -868,6 +878,7 @@ struct hisi_mbox_dev_ops hisi_mdev_ops = {
 	.get_sched_priority = hisi_mdev_sched_priority,
 	.get_sched_policy = hisi_mdev_sched_policy,
 	.read_board_type = hisi_mdev_board_type,
+	.get_batch_size = hisi_mdev_batch_size,
 	.request_irq = hisi_mdev_irq_request,
 	.free_irq = hisi_mdev_irq_free,
 	.enable_irq = hisi_mdev_irq_enable,
@@ -944,6 +955,7 @@ static int hisi_mdev_get(struct hisi_ipc_device *idev, struct hisi_mbox_device *
 	unsigned int fifo_size;
 	unsigned int sched_priority;
 	unsigned int sched_policy;
+	unsigned int batch;
 	void __iomem *ipc_base = NULL;
 	ipc_base = of_iomap(node, 0);
 	if (!ipc_base) {
@@ -1094,6 +1106,12 @@ static int hisi_mdev_get(struct hisi_ipc_device *idev, struct hisi_mbox_device *
 
 		MDEV_DEBUG("sched_policy: %d\n", (int)sched_policy);
 
+		ret = of_property_read_u32(son, "batch", &batch);
+		if (ret)
+			batch = 0;/* default the remote does not unpack batch frames */
+
+		MDEV_DEBUG("batch: %d\n", (int)batch);
+
 		ret = of_property_read_u32_array(son, "func", output, 3);
 		if (ret)
 			goto free_priv;
@@ -1142,6 +1160,7 @@ static int hisi_mdev_get(struct hisi_ipc_device *idev, struct hisi_mbox_device *
 		priv->fifo_size = fifo_size;
 		priv->sched_priority = sched_priority;
 		priv->sched_policy = sched_policy;
+		priv->batch = batch;
 
 		mdev->name = mdev_name;
 		mdev->priv = priv;
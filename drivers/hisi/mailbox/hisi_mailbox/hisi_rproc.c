@@ -14,6 +14,7 @@
 #include <linux/notifier.h>
 #include <linux/delay.h>
 #include <linux/wait.h>
+#include <linux/spinlock.h>
 #include <linux/hisi/hisi_mailbox.h>
 #include <linux/hisi/hisi_rproc.h>
 
@@ -33,16 +34,43 @@
 			MODULE_NAME, __LINE__, ##args); \
 	})*/
 
+/* async tx ring entries per rproc, must be a power of 2 */
+#define RPROC_RING_SIZE			32
+
 typedef enum {
 	ASYNC_CALL = 0,
 	SYNC_CALL
 } call_type_t;
 
+struct hisi_rproc_ring;
+
+struct hisi_rproc_ring_slot {
+	struct hisi_mbox_task task;
+	rproc_complete_t complete;
+	void *data;
+	int done;
+	struct hisi_rproc_ring *ring;
+};
+
+/*
+ * Async tx ring, preallocated per rproc: hisi_rproc_xfer_async_cb() takes
+ * the slot at head without a lock or an allocation, so there must be one
+ * producer per rproc at a time. Slots are completed by the mailbox tx
+ * thread (or a flush), and tail moves over the completed ones.
+ */
+struct hisi_rproc_ring {
+	unsigned int head;
+	unsigned int tail;
+	spinlock_t tail_lock;
+	struct hisi_rproc_ring_slot slots[RPROC_RING_SIZE];
+};
+
 struct hisi_rproc_info {
 	rproc_id_t rproc_id;
 	struct atomic_notifier_head notifier;
 	struct notifier_block nb;
 	struct hisi_mbox *mbox;
+	struct hisi_rproc_ring *ring;
 };
 
 static int is_ready;
@@ -216,6 +244,126 @@ out:
 
 EXPORT_SYMBOL(hisi_rproc_xfer_async);
 
+static void hisi_rproc_ring_complete(struct hisi_mbox_task *task)
+{
+	struct hisi_rproc_ring_slot *slot = container_of(task, struct hisi_rproc_ring_slot, task);
+	struct hisi_rproc_ring *ring = slot->ring;
+	unsigned long flags;
+
+	if (slot->complete)
+		slot->complete(NULL, 0, task->tx_ret, slot->data);
+
+	/* slots complete in queue order, except across a flush */
+	spin_lock_irqsave(&ring->tail_lock, flags);
+	slot->done = 1;
+	while (ring->tail != ring->head && ring->slots[ring->tail & (RPROC_RING_SIZE - 1)].done)
+		smp_store_release(&ring->tail, ring->tail + 1);
+	spin_unlock_irqrestore(&ring->tail_lock, flags);
+}
+
+/*
+ * Function name:hisi_rproc_xfer_async_cb.
+ * Discription:send msg like hisi_rproc_xfer_async, from the rproc's
+ *      preallocated ring, and call 'complete' once it is sent or dropped,
+ *      from the mailbox tx thread or atomic context. One producer per
+ *      rproc at a time.
+ * return value:
+ *      @ -EBUSY-->ring full, -ENOMEM-->tx fifo full, 0-->queued.
+ */
+int hisi_rproc_xfer_async_cb(rproc_id_t rproc_id, rproc_msg_t *msg, rproc_msg_len_t len,
+			     rproc_complete_t complete, void *data)
+{
+	struct hisi_rproc_info *rproc;
+	struct hisi_rproc_ring *ring;
+	struct hisi_rproc_ring_slot *slot;
+	struct hisi_mbox_task *tx_task;
+	unsigned int head;
+	int ret = 0;
+
+	BUG_ON(!IS_READY());
+
+	if (MBOX_CHAN_DATA_SIZE < len || !msg) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	rproc = find_rproc(rproc_id);
+	if (!rproc || !rproc->ring) {
+		RPROC_PR_ERR("invalid rproc xfer\n");
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ring = rproc->ring;
+	head = ring->head;
+	if (head - smp_load_acquire(&ring->tail) >= RPROC_RING_SIZE) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	slot = &ring->slots[head & (RPROC_RING_SIZE - 1)];
+	slot->complete = complete;
+	slot->data = data;
+	slot->done = 0;
+
+	tx_task = &slot->task;
+	memcpy((void *)tx_task->tx_buffer, (void *)msg, len * (sizeof(mbox_msg_t)));
+	tx_task->tx_buffer_len = len;
+	tx_task->need_auto_ack = AUTO_ACK;
+	tx_task->tx_complete = hisi_rproc_ring_complete;
+	tx_task->tx_ret = 0;
+
+	/* publish the slot before the tx thread can complete it */
+	smp_store_release(&ring->head, head + 1);
+
+	ret = hisi_mbox_msg_send_async(rproc->mbox, tx_task);
+	if (ret) {
+		RPROC_PR_ERR("%s async send failed, errno: %d (-12:tx_fifo full;)\n", rproc->mbox->tx->name, ret);
+		/* not queued: hand the slot back, complete was not called */
+		slot->complete = NULL;
+		tx_task->tx_ret = ret;
+		hisi_rproc_ring_complete(tx_task);
+	}
+
+out:
+	return ret;
+}
+
+EXPORT_SYMBOL(hisi_rproc_xfer_async_cb);
+
+/*
+ * Function name:hisi_rproc_xfer_async_poll.
+ * Discription:busy wait, without sleeping, until every msg queued by
+ *      hisi_rproc_xfer_async_cb on this rproc is completed, for callers
+ *      that can not sleep or can not afford a wakeup (ISP, IOM3).
+ * return value:
+ *      @ -ETIMEDOUT-->still pending after timeout_us, 0-->all completed.
+ */
+int hisi_rproc_xfer_async_poll(rproc_id_t rproc_id, unsigned int timeout_us)
+{
+	struct hisi_rproc_info *rproc;
+	struct hisi_rproc_ring *ring;
+
+	BUG_ON(!IS_READY());
+
+	rproc = find_rproc(rproc_id);
+	if (!rproc || !rproc->ring) {
+		RPROC_PR_ERR("invalid rproc xfer\n");
+		return -EINVAL;
+	}
+
+	ring = rproc->ring;
+	while (smp_load_acquire(&ring->tail) != ACCESS_ONCE(ring->head)) {
+		if (!timeout_us--)
+			return -ETIMEDOUT;
+		udelay(1);
+	}
+
+	return 0;
+}
+
+EXPORT_SYMBOL(hisi_rproc_xfer_async_poll);
+
 int hisi_rproc_xfer_sync(rproc_id_t rproc_id, rproc_msg_t *msg, rproc_msg_len_t len, rproc_msg_t *ack_buffer, rproc_msg_len_t ack_buffer_len)
 {
 	struct hisi_rproc_info *rproc;
@@ -362,7 +510,7 @@ int hisi_rproc_init(void)
 {
 	struct hisi_rproc_info *rproc;
 	struct hisi_mbox_task *ptask = NULL;
-	int i;
+	int i, j;
 
 	for (i = 0; i < sizeof(rproc_table) / sizeof(struct hisi_rproc_info); i++) {
 		rproc = &rproc_table[i];
@@ -378,6 +526,18 @@ int hisi_rproc_init(void)
 				continue;
 			}
 		}
+
+		if (NULL == rproc->ring && rproc->mbox->tx) {
+			rproc->ring = kzalloc(sizeof(struct hisi_rproc_ring), GFP_KERNEL);
+			if (rproc->ring) {
+				spin_lock_init(&rproc->ring->tail_lock);
+				for (j = 0; j < RPROC_RING_SIZE; j++)
+					rproc->ring->slots[j].ring = rproc->ring;
+			} else {
+				/* hisi_rproc_xfer_async_cb is not available on it */
+				RPROC_PR_ERR("\nrproc %d no mem for tx ring\n", rproc->rproc_id);
+			}
+		}
 	}
 	/*the last rproc info has been initialize, set the rproc ready */
 	if ((sizeof(rproc_table) / sizeof(struct hisi_rproc_info)) == i) {
@@ -414,6 +574,8 @@ static void __exit hisi_rproc_exit(void)
 		rproc = &rproc_table[i];
 		if (rproc->mbox)
 			hisi_mbox_put(&rproc->mbox);
+		kfree(rproc->ring);
+		rproc->ring = NULL;
 	}
 
 	return;
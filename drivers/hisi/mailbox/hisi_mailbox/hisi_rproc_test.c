@@ -11,6 +11,9 @@
 #include <linux/fs.h>
 #include <linux/syscalls.h>
 #include <linux/time.h>
+#include <linux/ktime.h>
+#include <linux/vmalloc.h>
+#include <linux/sort.h>
 #include <linux/hisi/hisi_rproc.h>
 #include <linux/hisi/ipc_msg.h>
 /*total pressure times once*/
@@ -664,6 +667,121 @@ out:
 	return ret;
 }
 
+/*the most msgs of one benchmark run*/
+#define BENCHMARK_MAX_COUNT	100000
+static atomic_t benchmark_errors;
+
+static void test_rproc_benchmark_done(rproc_msg_t *ack_buffer, rproc_msg_len_t ack_buffer_len, int error, void *data)
+{
+	u64 *lat = data;
+
+	*lat = ktime_get_ns() - *lat;
+	if (error)
+		atomic_inc(&benchmark_errors);
+}
+
+static int test_rproc_benchmark_cmp(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a;
+	u64 y = *(const u64 *)b;
+
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/*
+ * Function name:test_rproc_benchmark.
+ * Discription:throughput and latency of one remote processor's channel,
+ *      see also debugfs hisi_mailbox/stats for where the time goes.
+ * Parameters:
+ *      @ rproc_id:the remote processor's mailbox.
+ *      @ type: 1, sync send, latency is send to ack;
+ *              0, async send through the rproc's tx ring, latency is send call
+ *              to the msg being written to the channel, queueing included.
+ *      @ count:msgs to send, at most BENCHMARK_MAX_COUNT.
+ *      @ len:msg length in words, 1 to MAX_MAIL_SIZE.
+ * return value:
+ *      @ 0:success, others failed.
+ */
+int test_rproc_benchmark(unsigned char rproc_id, int type, unsigned int count, unsigned int len)
+{
+	union ipc_data *msg = NULL;
+	rproc_msg_t ack_buffer[2] = {0};
+	u64 *lat = NULL;
+	u64 begin, total;
+	unsigned int index, sent = 0;
+	int ret = 0;
+
+	if (!count || count > BENCHMARK_MAX_COUNT || !len || len > MAX_MAIL_SIZE) {
+		pr_err("rproc_benchmark: bad count %u or len %u\n", count, len);
+		return -EINVAL;
+	}
+
+	msg = kmalloc(sizeof(union ipc_data), GFP_KERNEL);
+	lat = vmalloc(count * sizeof(u64));
+	if (!msg || !lat) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	/*we don't care the msg's content*/
+	memset((void *)msg, 0xFF, sizeof(union ipc_data));
+	atomic_set(&benchmark_errors, 0);
+
+	begin = ktime_get_ns();
+	for (index = 0; index < count; index++) {
+		lat[index] = ktime_get_ns();
+		if (type) {
+			ret = RPROC_SYNC_SEND(rproc_id, (rproc_msg_t *)msg, len, ack_buffer, 2);
+			lat[index] = ktime_get_ns() - lat[index];
+		} else {
+			/*the ring is full, let the tx thread drain it*/
+			while (-EBUSY == (ret = hisi_rproc_xfer_async_cb(rproc_id, (rproc_msg_t *)msg, len,
+							test_rproc_benchmark_done, &lat[index])))
+				usleep_range(50, 100);
+		}
+		if (ret)
+			break;
+		sent++;
+	}
+
+	/*wait for the async msgs still queued, 1s at most*/
+	for (index = 0; !type && index < 1000; index++) {
+		if (!hisi_rproc_xfer_async_poll(rproc_id, 0))
+			break;
+		msleep(1);
+	}
+	total = ktime_get_ns() - begin;
+
+	if (!type && index == 1000) {
+		pr_err("rproc_benchmark: rproc_id %d async msgs still pending\n", rproc_id);
+		ret = -ETIMEDOUT;
+		/*the pending callbacks still write to lat*/
+		lat = NULL;
+		goto out;
+	}
+
+	if (!sent) {
+		pr_err("rproc_benchmark: rproc_id %d send failed %d\n", rproc_id, ret);
+		goto out;
+	}
+
+	sort(lat, sent, sizeof(u64), test_rproc_benchmark_cmp, NULL);
+	pr_err("rproc_benchmark: rproc_id %d %s %u msgs of %u words in %llu us, %llu msgs/s, %llu KB/s, errors %d\n",
+		rproc_id, type ? "sync" : "async", sent, len, div_u64(total, NSEC_PER_USEC),
+		div64_u64((u64)sent * NSEC_PER_SEC, total ? total : 1),
+		div64_u64((u64)sent * len * sizeof(rproc_msg_t) * NSEC_PER_SEC, (total ? total : 1) * 1024),
+		atomic_read(&benchmark_errors) + (ret ? 1 : 0));
+	pr_err("rproc_benchmark: latency us min %llu p50 %llu p90 %llu p99 %llu max %llu\n",
+		div_u64(lat[0], NSEC_PER_USEC),
+		div_u64(lat[sent / 2], NSEC_PER_USEC),
+		div_u64(lat[(u64)sent * 90 / 100], NSEC_PER_USEC),
+		div_u64(lat[(u64)sent * 99 / 100], NSEC_PER_USEC),
+		div_u64(lat[sent - 1], NSEC_PER_USEC));
+
+out:
+	kfree(msg);
+	vfree(lat);
+	return ret;
+}
 
 static int test_async_send_to_lpmcu(void *arg)
 {
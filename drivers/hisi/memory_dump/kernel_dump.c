@@ -65,6 +65,9 @@
 #include <linux/sched/rt.h>
 #include <linux/io.h>
 #include <linux/of_fdt.h>
+#include <linux/bitmap.h>
+
+#include <asm/cacheflush.h>
 
 #include <asm/tlbflush.h>
 /*lint -e451*/
@@ -119,6 +122,97 @@ err:
 	return -1;
 }
 
+#ifdef CONFIG_HISI_KERNELDUMP_PAGE_FILTER
+static unsigned long *g_kdump_bitmap;
+static unsigned long g_kdump_bitmap_pfn;
+static unsigned long g_kdump_bitmap_pages;
+
+/*
+ * Return how many pages from @page on can be left out of the dump, 0 if
+ * @page has to be dumped. Other cpus are stopped, the flags are stable.
+ */
+static unsigned long kernel_dump_skip_pages(struct page *page)
+{
+	unsigned long order;
+
+	if (PageBuddy(page)) {
+		order = page_private(page);
+		return order < MAX_ORDER ? 1UL << order : 1;
+	}
+
+	/* clean page cache can be read back from storage */
+	if (PageLRU(page) && !PageAnon(page) && !PageSwapBacked(page) &&
+	    page->mapping && !PageDirty(page) && !PageWriteback(page))
+		return 1;
+
+	return 0;
+}
+
+static int kernel_dump_panic_notify(struct notifier_block *nb,
+				    unsigned long event, void *buf)
+{
+	struct memblock_region *reg;
+	unsigned long pfn, end, skip, kept = 0;
+
+	if (!g_kdump_cb || !g_kdump_bitmap)
+		return NOTIFY_DONE;
+
+	for_each_memblock(memory, reg) {
+		pfn = memblock_region_memory_base_pfn(reg);
+		end = memblock_region_memory_end_pfn(reg);
+		while (pfn < end) {
+			skip = pfn_valid(pfn) ?
+				kernel_dump_skip_pages(pfn_to_page(pfn)) : 0;
+			if (skip) {
+				pfn += skip;
+				continue;
+			}
+			__set_bit(pfn - g_kdump_bitmap_pfn, g_kdump_bitmap);
+			kept++;
+			pfn++;
+		}
+	}
+
+	__flush_dcache_area(g_kdump_bitmap,
+			    BITS_TO_LONGS(g_kdump_bitmap_pages) * sizeof(long));
+	g_kdump_cb->page_bitmap_magic = KERNELDUMP_BITMAP_MAGIC;
+	printk(KERN_ERR "%s: %lu of %lu pages to dump\n", __func__, kept,
+	       g_kdump_bitmap_pages);
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block kernel_dump_panic_nb = {
+	.notifier_call = kernel_dump_panic_notify,
+	/* after the other panic notifiers have put their state in memory */
+	.priority = INT_MIN,
+};
+
+static void kernel_dump_bitmap_init(struct kernel_dump_cb *cb)
+{
+	size_t size;
+
+	g_kdump_bitmap_pfn = PFN_DOWN(memblock_start_of_DRAM());
+	g_kdump_bitmap_pages = PFN_UP(memblock_end_of_DRAM()) - g_kdump_bitmap_pfn;
+	size = BITS_TO_LONGS(g_kdump_bitmap_pages) * sizeof(long);
+
+	g_kdump_bitmap = alloc_pages_exact(size, GFP_KERNEL | __GFP_ZERO);
+	if (!g_kdump_bitmap) {
+		printk(KERN_ERR "%s: no memory for the page bitmap(0x%zx), dumping all\n",
+		       __func__, size);
+		return;
+	}
+
+	cb->page_bitmap = virt_to_phys(g_kdump_bitmap);
+	cb->page_bitmap_pfn = g_kdump_bitmap_pfn;
+	cb->page_bitmap_size = size;
+	atomic_notifier_chain_register(&panic_notifier_list, &kernel_dump_panic_nb);
+}
+#else
+static inline void kernel_dump_bitmap_init(struct kernel_dump_cb *cb)
+{
+}
+#endif
+
 int kernel_dump_init(void)
 {
 	int i, j;
@@ -182,6 +276,7 @@ int kernel_dump_init(void)
 		printk("print_mb_cb->regions is 0x%llx\n", (print_mb_cb->regions+i)->base);
 		printk("print_mb_cb->regions is 0x%llx\n", (print_mb_cb->regions+i)->size);
 	}
+	kernel_dump_bitmap_init(cb);
 	g_kdump_cb = cb;
 	return 0;
 err:
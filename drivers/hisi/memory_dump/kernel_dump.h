@@ -7,6 +7,7 @@
 #define KERNELDUMP_CB_MAGIC 0xDEADBEEFDEADBEEF
 #define MAX_EXTRA_MEM 32
 #define MAX_DTB_SIZE 0x80000
+#define KERNELDUMP_BITMAP_MAGIC 0x4B44424D50415453
 
 struct kernel_dump_cb
 {
@@ -31,5 +32,12 @@ struct kernel_dump_cb
     u64 extra_mem_phy_base[MAX_EXTRA_MEM];/*physcal address of the extra mem */
     u64 extra_mem_size[MAX_EXTRA_MEM];/*the size of the  extra mem  */
     u32 mbr_size; /*the size of struct memblock_region, the size of which is depended on kernel configuration. */
+    /*the physical address of a bitmap with one bit per page from page_bitmap_pfn on, set for the pages worth dumping.
+	free pages and clean page cache are left clear. only valid when page_bitmap_magic is KERNELDUMP_BITMAP_MAGIC,
+	which is written at panic once the bitmap is filled, otherwise all memory has to be dumped*/
+    u64 page_bitmap;
+    u64 page_bitmap_pfn; /*the pfn of the first bit*/
+    u64 page_bitmap_size; /*the size of the bitmap in bytes*/
+    u64 page_bitmap_magic;
 };
 #endif
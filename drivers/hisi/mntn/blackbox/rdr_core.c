@@ -21,6 +21,7 @@
 #include <linux/syscalls.h>
 #include <linux/wakelock.h>
 #include <linux/reboot.h>
+#include <linux/percpu.h>
 
 #include <linux/hisi/rdr_pub.h>
 #include <linux/hisi/util.h>
@@ -36,7 +37,65 @@ static LIST_HEAD(g_rdr_syserr_list);
 static DEFINE_SPINLOCK(g_rdr_syserr_list_lock);
 static struct wake_lock blackbox_wl;
 
-void rdr_register_system_error(u32 modid, u32 arg1, u32 arg2)
+/*
+ * Exceptions are first recorded in a per cpu ring without taking any
+ * lock or allocating, so that concurrent exceptions from several cpus
+ * (noc errors, modem resets...) are captured at once. rdr main thread
+ * moves them to g_rdr_syserr_list, where the reentrancy check and the
+ * priority ordering are done as before. Only when the ring of a cpu is
+ * full is the exception queued directly with GFP_ATOMIC.
+ */
+#define RDR_SYSERR_SLOTS	16	/* power of 2 */
+
+struct rdr_syserr_ring {
+	u32 modid[RDR_SYSERR_SLOTS];
+	u32 arg1[RDR_SYSERR_SLOTS];
+	u32 arg2[RDR_SYSERR_SLOTS];
+	unsigned int head;	/* written by the owner cpu, irqs off */
+	unsigned int tail;	/* written by rdr main thread */
+};
+
+static DEFINE_PER_CPU(struct rdr_syserr_ring, rdr_syserr_rings);
+
+static bool rdr_syserr_record(u32 modid, u32 arg1, u32 arg2)
+{
+	struct rdr_syserr_ring *r;
+	unsigned long flags;
+	unsigned int head, i;
+	bool ret = false;
+
+	local_irq_save(flags);
+	r = this_cpu_ptr(&rdr_syserr_rings);
+	head = r->head;
+	if (head - ACCESS_ONCE(r->tail) < RDR_SYSERR_SLOTS) {
+		i = head & (RDR_SYSERR_SLOTS - 1);
+		r->modid[i] = modid;
+		r->arg1[i] = arg1;
+		r->arg2[i] = arg2;
+		/* the slot is visible before the new head */
+		smp_wmb();
+		ACCESS_ONCE(r->head) = head + 1;
+		ret = true;
+	}
+	local_irq_restore(flags);
+	return ret;
+}
+
+static bool rdr_syserr_ring_empty(void)
+{
+	struct rdr_syserr_ring *r;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		r = per_cpu_ptr(&rdr_syserr_rings, cpu);
+		if (ACCESS_ONCE(r->head) != r->tail)
+			return false;
+	}
+	return true;
+}
+
+static void __rdr_register_system_error(u32 modid, u32 arg1, u32 arg2,
+					gfp_t gfp)
 {
 	struct rdr_syserr_param_s *p = NULL;
 	struct rdr_exception_info_s *p_exce_info = NULL;
@@ -46,7 +105,7 @@ void rdr_register_system_error(u32 modid, u32 arg1, u32 arg2)
 	int exist = 0;
 
 	BB_PRINT_START();
-	p = kmalloc(sizeof(struct rdr_syserr_param_s), GFP_ATOMIC);
+	p = kmalloc(sizeof(struct rdr_syserr_param_s), gfp);
 	if (p == NULL) {
 		BB_PRINT_PN("kmalloc rdr_syserr_param_s faild.\n");
 		return;
@@ -80,6 +139,35 @@ void rdr_register_system_error(u32 modid, u32 arg1, u32 arg2)
 	BB_PRINT_END();
 }
 
+/* called by rdr main thread only */
+static void rdr_syserr_drain(void)
+{
+	struct rdr_syserr_ring *r;
+	unsigned int head, tail, i;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		r = per_cpu_ptr(&rdr_syserr_rings, cpu);
+		head = ACCESS_ONCE(r->head);
+		/* read the slots published before head */
+		smp_rmb();
+		for (tail = r->tail; tail != head; tail++) {
+			i = tail & (RDR_SYSERR_SLOTS - 1);
+			__rdr_register_system_error(r->modid[i], r->arg1[i],
+						    r->arg2[i], GFP_KERNEL);
+		}
+		/* done with the slots before handing them back */
+		smp_mb();
+		ACCESS_ONCE(r->tail) = head;
+	}
+}
+
+void rdr_register_system_error(u32 modid, u32 arg1, u32 arg2)
+{
+	if (!rdr_syserr_record(modid, arg1, arg2))
+		__rdr_register_system_error(modid, arg1, arg2, GFP_ATOMIC);
+}
+
 void rdr_system_error(u32 modid, u32 arg1, u32 arg2)
 {
 	char *modid_str = NULL;
@@ -325,7 +413,7 @@ out:
 
 bool rdr_syserr_list_empty(void)
 {
-	return list_empty(&g_rdr_syserr_list);
+	return list_empty(&g_rdr_syserr_list) && rdr_syserr_ring_empty();
 }
 
 void rdr_syserr_list_print(void)
@@ -381,6 +469,8 @@ static int rdr_main_thread_body(void *arg)
 		BB_PRINT_DBG
 		    ("============wait for fs ready e n d =============\n");
 		while (!rdr_syserr_list_empty()) {
+			/* pick up what was recorded meanwhile before choosing */
+			rdr_syserr_drain();
 			spin_lock(&g_rdr_syserr_list_lock);
 			list_for_each_safe(cur, next, &g_rdr_syserr_list) {
 				e_cur = list_entry(cur, struct rdr_syserr_param_s, syserr_list);
@@ -30,12 +30,153 @@
 #include <linux/hisi/util.h>
 #include <linux/uaccess.h>
 #include <linux/hisi/hisi_bootup_keypoint.h>
+#include <linux/hisi/hisi_boottime.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/sort.h>
 
-static ssize_t boot_time_proc_read(struct file *file, char __user *userbuf,
-				   size_t bytes, loff_t *off)
+#define BOOT_TIME_RECORDS	512
+#define BOOT_TIME_NAME_LEN	48
+
+/*
+ * Only calls slower than this are kept, most initcalls and probes take
+ * a few microseconds and would just fill the table.
+ */
+static unsigned int threshold_us = 100;
+module_param(threshold_us, uint, S_IRUGO | S_IWUSR);
+
+struct boot_time_record {
+	u64 start_us;
+	u32 duration_us;
+	s32 ret;
+	u32 type;
+	char name[BOOT_TIME_NAME_LEN];
+};
+
+static const char *const boot_time_type_name[BOOT_TIME_TYPE_MAX] = {
+	[BOOT_TIME_INITCALL] = "initcall",
+	[BOOT_TIME_PROBE] = "probe",
+	[BOOT_TIME_DEFERRED_PROBE] = "deferred",
+	[BOOT_TIME_PROBE_WAIT] = "probe_wait",
+};
+
+/* cleared by the first write to /proc/.../boot_time, once boot is over */
+bool boot_time_recording = true;
+
+static struct boot_time_record boot_time_table[BOOT_TIME_RECORDS];
+static unsigned int boot_time_nr;
+static unsigned int boot_time_lost;
+static DEFINE_SPINLOCK(boot_time_lock);
+static DEFINE_MUTEX(boot_time_show_mutex);
+
+static void boot_time_add(enum boot_time_type type, const char *name,
+			  ktime_t start, s64 duration_us, int ret)
+{
+	struct boot_time_record *r;
+	unsigned long flags;
+
+	spin_lock_irqsave(&boot_time_lock, flags);
+	if (boot_time_nr >= BOOT_TIME_RECORDS) {
+		boot_time_lost++;
+		spin_unlock_irqrestore(&boot_time_lock, flags);
+		return;
+	}
+	r = &boot_time_table[boot_time_nr++];
+	r->start_us = ktime_to_us(start);
+	r->duration_us = (u32)min_t(s64, duration_us, U32_MAX);
+	r->ret = ret;
+	r->type = type;
+	strlcpy(r->name, name, sizeof(r->name));
+	spin_unlock_irqrestore(&boot_time_lock, flags);
+}
+
+/*
+ * boot_time_end_fn - record an initcall or a wait, named after 'fn'.
+ */
+void boot_time_end_fn(enum boot_time_type type, void *fn, ktime_t start,
+		      int ret)
+{
+	char name[BOOT_TIME_NAME_LEN];
+	s64 delta;
+
+	if (!boot_time_recording || !ktime_to_ns(start))
+		return;
+
+	delta = ktime_us_delta(ktime_get(), start);
+	if (delta < threshold_us)
+		return;
+
+	snprintf(name, sizeof(name), "%pf", fn);
+	boot_time_add(type, name, start, delta, ret);
+}
+
+/*
+ * boot_time_end_dev - record a probe of 'dev' by the driver 'drv'.
+ */
+void boot_time_end_dev(enum boot_time_type type, const char *drv,
+		       const char *dev, ktime_t start, int ret)
+{
+	char name[BOOT_TIME_NAME_LEN];
+	s64 delta;
+
+	if (!boot_time_recording || !ktime_to_ns(start))
+		return;
+
+	delta = ktime_us_delta(ktime_get(), start);
+	if (delta < threshold_us)
+		return;
+
+	snprintf(name, sizeof(name), "%s:%s", drv ? drv : "-", dev ? dev : "-");
+	boot_time_add(type, name, start, delta, ret);
+}
+
+static int boot_time_cmp(const void *a, const void *b)
+{
+	const struct boot_time_record *ra = a;
+	const struct boot_time_record *rb = b;
+
+	if (ra->duration_us == rb->duration_us)
+		return 0;
+	return ra->duration_us < rb->duration_us ? 1 : -1;
+}
+
+/*
+ * the table is shown slowest first, the start time keeps the boot order.
+ */
+static int boot_time_show(struct seq_file *m, void *v)
+{
+	unsigned long flags;
+	unsigned int nr, lost, i;
+
+	mutex_lock(&boot_time_show_mutex);
+
+	spin_lock_irqsave(&boot_time_lock, flags);
+	nr = boot_time_nr;
+	lost = boot_time_lost;
+	sort(boot_time_table, nr, sizeof(boot_time_table[0]),
+	     boot_time_cmp, NULL);
+	spin_unlock_irqrestore(&boot_time_lock, flags);
+
+	seq_printf(m, "recording %d threshold_us %u records %u lost %u\n",
+		   boot_time_recording, threshold_us, nr, lost);
+	seq_puts(m, "type       duration_us   start_us     ret name\n");
+	for (i = 0; i < nr; i++) {
+		struct boot_time_record *r = &boot_time_table[i];
+
+		seq_printf(m, "%-10s %11u %10llu %7d %s\n",
+			   boot_time_type_name[r->type], r->duration_us,
+			   r->start_us, r->ret, r->name);
+	}
+
+	mutex_unlock(&boot_time_show_mutex);
+
+	return 0;
+}
+
+static int boot_time_proc_open(struct inode *inode, struct file *file)
 {
-	/*do nothing */
-	return bytes;
+	return single_open(file, boot_time_show, NULL);
 }
 
 static ssize_t boot_time_proc_write(struct file *file, const char __user *buf,
@@ -43,19 +184,23 @@ static ssize_t boot_time_proc_write(struct file *file, const char __user *buf,
 {
 	/*only need the print time */
 	pr_err("bootanim has been complete, turn to Lancher!\n");
+	boot_time_recording = false;
 	/*set_boot_keypoint(STAGE_KERNEL_BOOTANIM_COMPLETE);*/
 
 	return nr;
 }
 
 static const struct file_operations boot_time_proc_fops = {
-	.read = boot_time_proc_read,
+	.open = boot_time_proc_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
 	.write = boot_time_proc_write,
 };
 
 static int __init boot_time_proc_init(void)
 {
-	balong_create_stats_proc_entry("boot_time", (S_IWUSR),
+	balong_create_stats_proc_entry("boot_time", (S_IRUSR | S_IWUSR),
 				       &boot_time_proc_fops, NULL);
 
 	return 0;
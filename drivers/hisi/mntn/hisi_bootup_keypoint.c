@@ -17,6 +17,7 @@
 #include <linux/of.h>
 
 #include <linux/hisi/hisi_bootup_keypoint.h>
+#include <linux/hisi/hisi_boottime.h>
 #include <linux/hisi/rdr_pub.h>
 #include <linux/hisi/util.h>
 #include <mntn_public_interface.h>
@@ -41,6 +42,10 @@ void set_boot_keypoint(u32 value)
 
 	if (STAGE_BOOTUP_END == value) {
 		up(&clear_dfx_sem);
+#ifdef CONFIG_HISI_BOOT_TIME
+		/* boot is over, freeze the initcall and probe timings */
+		boot_time_recording = false;
+#endif
 	}
 
 	if (!g_bootup_keypoint_addr) {
@@ -10,6 +10,10 @@
 #include <osl_thread.h>
 #include <osl_malloc.h>
 #include <linux/cdev.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
 //#include "diag_frame.h"
 #include "applog_balong.h"
 
@@ -23,14 +27,34 @@ s32 applog_open(struct inode * inode, struct file * file);
 ssize_t applog_write(struct file *file, const char __user *buf, size_t count,
 			loff_t *ppos);
 s32 applog_release(struct inode * inode, struct file * file);
+static int applog_mmap(struct file *file, struct vm_area_struct *vma);
+static long applog_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
 
 static struct file_operations applog_fops = {
     .open    = applog_open,
     .owner   = THIS_MODULE,
     .write   = applog_write,
     .release = applog_release,
+    .mmap    = applog_mmap,
+    .unlocked_ioctl = applog_ioctl,
+    .compat_ioctl   = applog_ioctl,
 };
 
+/* serializes g_applog_sendbuf and the socp channel between write() and the ring */
+static DEFINE_MUTEX(applog_send_mutex);
+static DEFINE_MUTEX(applog_ring_mutex);
+/* serializes ring allocation and teardown between mmap() and release() */
+static DEFINE_MUTEX(applog_map_mutex);
+static void *g_applog_ring;
+/* the consumer offset, ctrl->tail only publishes it to the daemon */
+static u32 g_applog_ring_tail;
+/* files that have mmapped the ring */
+static u32 g_applog_ring_users;
+static void applog_ring_work_fn(struct work_struct *work);
+static void applog_ring_free(void);
+/* deferrable, so an idle AP is not woken up just to find the ring empty */
+static DECLARE_DEFERRABLE_WORK(applog_ring_work, applog_ring_work_fn);
+
 
 #define APPLOGCHAR_DEVICE_NAME    "applog"
 #define APPLOGCHAR_DEVICE_CLASS   "applog_class"
@@ -161,10 +185,20 @@ s32 applog_open(struct inode *inode, struct file *file)
     }
     return 0;
 }
+
 s32 applog_release(struct inode *inode, struct file *file)
 {
     inode = inode;
-    file  = file;
+    if(file->private_data)
+    {
+        file->private_data = NULL;
+        mutex_lock(&applog_map_mutex);
+        if(0 == --g_applog_ring_users)
+        {
+            applog_ring_free();
+        }
+        mutex_unlock(&applog_map_mutex);
+    }
     return 0;
 }
 
@@ -319,19 +353,23 @@ ssize_t applog_write(struct file *file,const char __user *buf, size_t count, lof
         return len;
     }
     
+    mutex_lock(&applog_send_mutex);
     paramlen = snprintf(g_applog_sendbuf->data, APPLOG_MAX_HIDS_BUFF_LEN,"%s[%d]", "applog", 0); 
     if(paramlen>APPLOG_MAX_FILENAME_LINENO_LEN)
     {
+       mutex_unlock(&applog_send_mutex);
        g_strApplogDebug.u32ApplogLength++;
        return 0;
     }
     if(copy_from_user(g_applog_sendbuf->data+paramlen, buf+1, len-1))
     {
         applog_printf("copy from user fail ,read_buf = %s\n", g_applog_sendbuf->data);
+        mutex_unlock(&applog_send_mutex);
         return  0;
     }
 
     ret=applog_report(g_applog_sendbuf, len-1+paramlen,level);
+    mutex_unlock(&applog_send_mutex);
     if(ret)
     {
         applog_printf("send data fail!\n");
@@ -342,6 +380,216 @@ ssize_t applog_write(struct file *file,const char __user *buf, size_t count, lof
  
     return len;
 }
+/* sends one ring record the way applog_write() sends one line */
+static s32 applog_ring_send(const u8 *text, u32 len, u8 level)
+{
+    u32 paramlen;
+    s32 ret;
+
+    if((0 == g_applog_conn)||(0 == g_applog_enable))
+    {
+        g_strApplogDebug.u32ApplogSwitchOnOff ++;
+        return APPLOG_OK;
+    }
+    if((level>4)||(level > g_applog_level))
+    {
+        g_strApplogDebug.u32ApplogLevel ++;
+        return APPLOG_OK;
+    }
+
+    mutex_lock(&applog_send_mutex);
+    paramlen = snprintf(g_applog_sendbuf->data, APPLOG_MAX_HIDS_BUFF_LEN,"%s[%d]", "applog", 0);
+    if(len > APPLOG_MAX_HIDS_BUFF_LEN - paramlen)
+    {
+        len = APPLOG_MAX_HIDS_BUFF_LEN - paramlen;
+    }
+    memcpy(g_applog_sendbuf->data + paramlen, text, len);
+    ret = applog_report(g_applog_sendbuf, len + paramlen, level);
+    mutex_unlock(&applog_send_mutex);
+    if(ret)
+    {
+        g_strApplogDebug.u32ApplogReport ++;
+    }
+    return ret;
+}
+
+/*
+ * Drains the ring up to the head the daemon has published. A record the
+ * socp channel has no room for stays in the ring for the next pass.
+ *
+ * Everything in the ring is written by user space and may change under
+ * us, so each field is read once and checked before it is used.
+ */
+static void applog_ring_drain(void)
+{
+    struct applog_ring_ctrl *ctrl;
+    struct applog_ring_rec *rec;
+    u8 *data;
+    u32 head, tail, step, len, seen = 0;
+    u8 level;
+
+    mutex_lock(&applog_ring_mutex);
+    if(NULL == g_applog_ring)
+    {
+        mutex_unlock(&applog_ring_mutex);
+        return;
+    }
+    ctrl = (struct applog_ring_ctrl *)g_applog_ring;
+    data = (u8 *)g_applog_ring + PAGE_SIZE;
+
+    head = ACCESS_ONCE(ctrl->head);
+    /* read the records only after the head that covers them */
+    smp_rmb();
+    tail = g_applog_ring_tail;
+    if((head >= APPLOG_RING_DATA_SIZE) || (head & 3))
+    {
+        ctrl->dropped++;
+        mutex_unlock(&applog_ring_mutex);
+        return;
+    }
+
+    while(tail != head)
+    {
+        if(tail + sizeof(*rec) > APPLOG_RING_DATA_SIZE)
+        {
+            tail = 0;
+            continue;
+        }
+        rec = (struct applog_ring_rec *)(data + tail);
+        len = ACCESS_ONCE(rec->len);
+        level = ACCESS_ONCE(rec->level);
+        if(APPLOG_RING_WRAP == len)
+        {
+            step = APPLOG_RING_DATA_SIZE - tail;
+        }
+        else
+        {
+            step = APPLOG_RING_ALIGN(sizeof(*rec) + len);
+        }
+        /* a record overrunning the ring or a wrap loop is corrupt, resync */
+        seen += step;
+        if((tail + step > APPLOG_RING_DATA_SIZE) || (seen > APPLOG_RING_DATA_SIZE))
+        {
+            ctrl->dropped++;
+            tail = head;
+            break;
+        }
+        if((APPLOG_RING_WRAP != len) &&
+           applog_ring_send((u8 *)(rec + 1), len, level))
+        {
+            break;
+        }
+        tail += step;
+        if(APPLOG_RING_DATA_SIZE == tail)
+        {
+            tail = 0;
+        }
+    }
+
+    /* the records are consumed before the daemon may reuse their space */
+    smp_mb();
+    g_applog_ring_tail = tail;
+    ctrl->tail = tail;
+    mutex_unlock(&applog_ring_mutex);
+}
+
+static void applog_ring_work_fn(struct work_struct *work)
+{
+    applog_ring_drain();
+    if(g_applog_ring)
+    {
+        schedule_delayed_work(&applog_ring_work, msecs_to_jiffies(APPLOG_RING_FLUSH_MS));
+    }
+}
+
+static s32 applog_ring_alloc(void)
+{
+    struct applog_ring_ctrl *ctrl;
+    void *ring;
+
+    mutex_lock(&applog_ring_mutex);
+    if(g_applog_ring)
+    {
+        mutex_unlock(&applog_ring_mutex);
+        return APPLOG_OK;
+    }
+    ring = vmalloc_user(APPLOG_RING_MMAP_SIZE);
+    if(NULL == ring)
+    {
+        mutex_unlock(&applog_ring_mutex);
+        applog_printf("ring malloc fail!\n");
+        return -ENOMEM;
+    }
+    ctrl = (struct applog_ring_ctrl *)ring;
+    ctrl->magic     = APPLOG_RING_MAGIC;
+    ctrl->size      = APPLOG_RING_DATA_SIZE;
+    ctrl->watermark = APPLOG_RING_WATERMARK;
+    g_applog_ring_tail = 0;
+    g_applog_ring = ring;
+    mutex_unlock(&applog_ring_mutex);
+
+    schedule_delayed_work(&applog_ring_work, msecs_to_jiffies(APPLOG_RING_FLUSH_MS));
+    return APPLOG_OK;
+}
+
+/* called with applog_map_mutex held once the last mapping is gone */
+static void applog_ring_free(void)
+{
+    void *ring;
+
+    applog_ring_drain();
+    mutex_lock(&applog_ring_mutex);
+    ring = g_applog_ring;
+    g_applog_ring = NULL;
+    mutex_unlock(&applog_ring_mutex);
+
+    cancel_delayed_work_sync(&applog_ring_work);
+    vfree(ring);
+}
+
+static int applog_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    unsigned long size = vma->vm_end - vma->vm_start;
+    s32 ret;
+
+    if((0 != vma->vm_pgoff) || (size > PAGE_ALIGN(APPLOG_RING_MMAP_SIZE)))
+    {
+        return -EINVAL;
+    }
+    mutex_lock(&applog_map_mutex);
+    ret = applog_ring_alloc();
+    if(ret)
+    {
+        mutex_unlock(&applog_map_mutex);
+        return ret;
+    }
+    ret = remap_vmalloc_range(vma, g_applog_ring, 0);
+    if(ret)
+    {
+        if(0 == g_applog_ring_users)
+        {
+            applog_ring_free();
+        }
+    }
+    else if(NULL == file->private_data)
+    {
+        file->private_data = g_applog_ring;
+        g_applog_ring_users++;
+    }
+    mutex_unlock(&applog_map_mutex);
+    return ret;
+}
+
+static long applog_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    if(APPLOG_IOC_KICK != cmd)
+    {
+        return -ENOTTY;
+    }
+    applog_ring_drain();
+    return 0;
+}
+
 /*****************************************************************************
 *     : applog_setup_cdev
 *
@@ -446,6 +694,9 @@ s32 applog_init(void)
 } 
 void applog_exit(void)
 {   
+    cancel_delayed_work_sync(&applog_ring_work);
+    vfree(g_applog_ring);
+    g_applog_ring = NULL;
     osl_free(g_applog_sendbuf);
     cdev_del(&(applog_cdev));
     class_destroy(applog_class);
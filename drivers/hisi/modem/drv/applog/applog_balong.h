@@ -133,6 +133,44 @@ applog_src_cfg_stru      g_astAppLogCoderSrcCfg=
  SOCP_DATA_TYPE_0, SOCP_DATA_TYPE_EN,SOCP_ENC_DEBUG_DIS, SOCP_ENCSRC_CHNMODE_CTSPACKET,SOCP_CHAN_PRIORITY_2,0,SOCP_CODER_SRC_APPLOG_IND,SOCP_CODER_DST_OM_IND, 0x40000
 };
 
+/*
+ * Shared log ring: the logging daemon mmaps /dev/applog and appends
+ * records itself instead of issuing one write() per line. The first page
+ * holds struct applog_ring_ctrl, the records follow. The daemon only moves
+ * head, the driver only moves tail; the daemon issues APPLOG_IOC_KICK once
+ * head - tail passes watermark, anything below that is picked up by a
+ * deferrable work every APPLOG_RING_FLUSH_MS.
+ */
+#define APPLOG_RING_MAGIC          0x41504c47   /* "APLG" */
+#define APPLOG_RING_DATA_SIZE      (256 * 1024)
+#define APPLOG_RING_MMAP_SIZE      (PAGE_SIZE + APPLOG_RING_DATA_SIZE)
+#define APPLOG_RING_WATERMARK      (APPLOG_RING_DATA_SIZE / 4)
+#define APPLOG_RING_FLUSH_MS       200
+/* record len marking that the next record starts at offset 0 */
+#define APPLOG_RING_WRAP           0xffff
+#define APPLOG_RING_ALIGN(len)     (((len) + 3) & ~3U)
+
+#define APPLOG_IOC_MAGIC           'A'
+#define APPLOG_IOC_KICK            _IO(APPLOG_IOC_MAGIC, 1)
+
+struct applog_ring_ctrl
+{
+    u32 magic;
+    u32 size;       /* bytes of record data after the first page */
+    u32 head;       /* written by the daemon, offset into record data */
+    u32 tail;       /* written by the driver */
+    u32 watermark;
+    u32 dropped;    /* malformed records skipped by the driver */
+};
+
+/* a record is this header and len bytes of text, padded to 4 bytes */
+struct applog_ring_rec
+{
+    u16 len;
+    u8  level;
+    u8  reserved;
+};
+
 s32 applog_src_chan_cfg(void);
 s32 applog_send_data(u8* data,u32 len);
 s32 applog_report(applog_send_buff *pstAppLogData,u32 datalen, u8 level);
@@ -31,6 +31,7 @@
 #include <linux/hisi/util.h>
 
 #include <linux/hisi/rdr_hisi_platform.h>
+#include <linux/hisi/hisi_async_probe.h>
 #include "hisi_noc.h"
 #include "hisi_noc_err_probe.h"
 #include "hisi_noc_packet.h"
@@ -1513,12 +1514,12 @@ static struct platform_driver hisi_noc_driver = {
 
 static int __init hisi_noc_init(void)
 {
-	return platform_driver_register(&hisi_noc_driver);
+	return hisi_platform_driver_register_async(&hisi_noc_driver);
 }
 
 static void __exit hisi_noc_exit(void)
 {
-	platform_driver_unregister(&hisi_noc_driver);
+	hisi_platform_driver_unregister_async(&hisi_noc_driver);
 }
 
 late_initcall(hisi_noc_init);
@@ -0,0 +1,345 @@
+/*
+* NoC. (NoC Mntn Module.)
+*
+* Copyright (c) 2016 Huawei Technologies CO., Ltd.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* Continuous sampling of the packet and transaction probes.
+*
+* The probes are programmed from node->packet_cfg / node->tran_cfg as for
+* debugging, but with the statistics period and the alarms off, so no
+* interrupt is ever raised. Every interval_ms the counters of each powered
+* node are read into a ring and restarted with StatGo:
+*
+*  - packet probe nodes: counters 0/1 chained, the bytes that passed the
+*    node's filters, i.e. the traffic of the initiators selected by its
+*    route id filters;
+*  - transaction probe nodes: counters 0..3, the latency histogram bins.
+*
+* The ring is read from debugfs noc_sample/samples.
+*/
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/io.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include "hisi_noc.h"
+#include "hisi_noc_packet.h"
+#include "hisi_noc_transcation.h"
+
+#define NOC_SAMPLE_RING_SIZE	1024	/* must be a power of 2 */
+#define NOC_SAMPLE_MIN_MS	10
+#define NOC_SAMPLE_COUNTERS	4
+
+/* packet probe: counter 1 is chained on counter 0 */
+#define NOC_SAMPLE_CHAIN_SRC	0x10
+
+struct noc_sample {
+	u64 ts_ns;
+	u16 node;
+	u16 type;
+	u32 val[NOC_SAMPLE_COUNTERS];
+};
+
+static struct noc_sample *noc_sample_ring;
+static unsigned int noc_sample_head;	/* total samples written */
+static DEFINE_SPINLOCK(noc_sample_lock);
+static DEFINE_MUTEX(noc_sample_mutex);	/* serializes enable/disable */
+
+static struct noc_node **noc_sample_nodes;
+static unsigned int noc_sample_nr_nodes;
+static bool noc_sample_programmed[MAX_NOC_NODES_NR];
+
+static u32 noc_sample_enabled;
+static u32 noc_sample_interval_ms = 100;
+
+static void noc_sample_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(noc_sample_work, noc_sample_work_fn);
+
+static bool noc_sample_node_valid(const struct noc_node *node)
+{
+	return node && (NOC_PACKET_PROBE_IRQ == node->hwirq_type ||
+			NOC_TRANS_PROBE_IRQ == node->hwirq_type);
+}
+
+static void __iomem *noc_sample_base(const struct noc_node *node)
+{
+	return node->base + node->eprobe_offset;
+}
+
+/*
+ * noc_sample_program - program the probe of 'node' for sampling: the
+ * node's filters and sources, with a manual statistics period and no alarms.
+ */
+static void noc_sample_program(struct noc_node *node)
+{
+	void __iomem *base = noc_sample_base(node);
+	struct noc_node cfg = *node;
+
+	if (NOC_PACKET_PROBE_IRQ == node->hwirq_type) {
+		cfg.packet_cfg.statperiod = 0;
+		cfg.packet_cfg.packet_counters_1_src = NOC_SAMPLE_CHAIN_SRC;
+		cfg.packet_cfg.packet_counters_0_alarmmode = 0;
+		cfg.packet_cfg.packet_counters_1_alarmmode = 0;
+		enable_packet_probe(&cfg, base);
+
+		noc_clear_bit(base, PACKET_MAINCTL, 4);
+		writel_relaxed(0x1, (char *)base + PACKET_STARTGO);
+	} else {
+		cfg.tran_cfg.statperiod = 0;
+		cfg.tran_cfg.trans_m_counters_0_alarmmode = 0;
+		cfg.tran_cfg.trans_m_counters_1_alarmmode = 0;
+		cfg.tran_cfg.trans_m_counters_2_alarmmode = 0;
+		cfg.tran_cfg.trans_m_counters_3_alarmmode = 0;
+		enable_transcation_probe(&cfg, base);
+
+		noc_clear_bit(base, TRANS_M_MAINCTL, 4);
+		writel_relaxed(0x1, (char *)base + TRANS_M_STATGO);
+	}
+	wmb();
+}
+
+static void noc_sample_unprogram(struct noc_node *node)
+{
+	if (NOC_PACKET_PROBE_IRQ == node->hwirq_type)
+		disable_packet_probe(noc_sample_base(node));
+	else
+		disable_transcation_probe(noc_sample_base(node));
+}
+
+/*
+ * noc_sample_read - read and restart the counters of a programmed node.
+ * Returns false if the probe lost its configuration, i.e. the bus was
+ * powered off since it was programmed.
+ */
+static bool noc_sample_read(struct noc_node *node, struct noc_sample *s)
+{
+	char *base = (char *)noc_sample_base(node);
+
+	memset(s->val, 0, sizeof(s->val));
+
+	if (NOC_PACKET_PROBE_IRQ == node->hwirq_type) {
+		if (!(readl_relaxed(base + PACKET_CFGCTL) & 0x1))
+			return false;
+
+		s->val[0] = (readl_relaxed(base + PACKET_COUNTERS_1_VAL) << 16) |
+			    (readl_relaxed(base + PACKET_COUNTERS_0_VAL) & 0xffff);
+		writel_relaxed(0x1, base + PACKET_STARTGO);
+	} else {
+		if (!(readl_relaxed(base + TRANS_M_CFGCTL) & 0x1))
+			return false;
+
+		s->val[0] = readl_relaxed(base + TRANS_M_COUNTERS_0_VAL);
+		s->val[1] = readl_relaxed(base + TRANS_M_COUNTERS_1_VAL);
+		s->val[2] = readl_relaxed(base + TRANS_M_COUNTERS_2_VAL);
+		s->val[3] = readl_relaxed(base + TRANS_M_COUNTERS_3_VAL);
+		writel_relaxed(0x1, base + TRANS_M_STATGO);
+	}
+
+	return true;
+}
+
+static void noc_sample_push(const struct noc_sample *s)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&noc_sample_lock, flags);
+	noc_sample_ring[noc_sample_head & (NOC_SAMPLE_RING_SIZE - 1)] = *s;
+	noc_sample_head++;
+	spin_unlock_irqrestore(&noc_sample_lock, flags);
+}
+
+static void noc_sample_work_fn(struct work_struct *work)
+{
+	struct noc_sample s;
+	struct noc_node *node;
+	unsigned int i;
+
+	for (i = 0; i < noc_sample_nr_nodes; i++) {
+		node = noc_sample_nodes[i];
+		if (!noc_sample_node_valid(node))
+			continue;
+
+		/* a powered-off bus is skipped, and reprogrammed when back */
+		if (!is_noc_node_available(node)) {
+			noc_sample_programmed[i] = false;
+			continue;
+		}
+
+		if (!noc_sample_programmed[i]) {
+			noc_sample_program(node);
+			noc_sample_programmed[i] = true;
+			continue;
+		}
+
+		s.ts_ns = ktime_to_ns(ktime_get());
+		s.node = i;
+		s.type = node->hwirq_type;
+		if (!noc_sample_read(node, &s)) {
+			noc_sample_program(node);
+			continue;
+		}
+		noc_sample_push(&s);
+	}
+
+	schedule_delayed_work(&noc_sample_work,
+			      msecs_to_jiffies(noc_sample_interval_ms));
+}
+
+static int noc_sample_start(void)
+{
+	void *nodes;
+
+	if (!is_noc_init())
+		return -ENODEV;
+
+	if (!noc_sample_ring) {
+		noc_sample_ring = vzalloc(NOC_SAMPLE_RING_SIZE *
+					  sizeof(struct noc_sample));
+		if (!noc_sample_ring)
+			return -ENOMEM;
+	}
+
+	noc_get_bus_nod_info(&nodes, &noc_sample_nr_nodes);
+	noc_sample_nodes = nodes;
+	memset(noc_sample_programmed, 0, sizeof(noc_sample_programmed));
+
+	schedule_delayed_work(&noc_sample_work, 0);
+	return 0;
+}
+
+static void noc_sample_stop(void)
+{
+	unsigned int i;
+
+	cancel_delayed_work_sync(&noc_sample_work);
+
+	for (i = 0; i < noc_sample_nr_nodes; i++) {
+		struct noc_node *node = noc_sample_nodes[i];
+
+		if (noc_sample_programmed[i] && is_noc_node_available(node))
+			noc_sample_unprogram(node);
+		noc_sample_programmed[i] = false;
+	}
+}
+
+static int noc_sample_enable_get(void *data, u64 *val)
+{
+	*val = noc_sample_enabled;
+	return 0;
+}
+
+static int noc_sample_enable_set(void *data, u64 val)
+{
+	int ret = 0;
+
+	mutex_lock(&noc_sample_mutex);
+	if (val && !noc_sample_enabled) {
+		ret = noc_sample_start();
+		if (!ret)
+			noc_sample_enabled = 1;
+	} else if (!val && noc_sample_enabled) {
+		noc_sample_stop();
+		noc_sample_enabled = 0;
+	}
+	mutex_unlock(&noc_sample_mutex);
+
+	return ret;
+}
+DEFINE_SIMPLE_ATTRIBUTE(noc_sample_enable_fops, noc_sample_enable_get,
+			noc_sample_enable_set, "%llu\n");
+
+static int noc_sample_interval_get(void *data, u64 *val)
+{
+	*val = noc_sample_interval_ms;
+	return 0;
+}
+
+static int noc_sample_interval_set(void *data, u64 val)
+{
+	if (val < NOC_SAMPLE_MIN_MS || val > MSEC_PER_SEC * 60)
+		return -EINVAL;
+
+	noc_sample_interval_ms = (u32)val;
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(noc_sample_interval_fops, noc_sample_interval_get,
+			noc_sample_interval_set, "%llu\n");
+
+/*
+ * samples: the ring, oldest first. Packet nodes report bytes in v0,
+ * transaction nodes the four latency bins in v0..v3.
+ */
+static int noc_sample_show(struct seq_file *m, void *v)
+{
+	struct noc_sample *copy;
+	unsigned int head, nr, i;
+	unsigned long flags;
+
+	if (!noc_sample_ring)
+		return 0;
+
+	copy = vmalloc(NOC_SAMPLE_RING_SIZE * sizeof(struct noc_sample));
+	if (!copy)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&noc_sample_lock, flags);
+	head = noc_sample_head;
+	memcpy(copy, noc_sample_ring,
+	       NOC_SAMPLE_RING_SIZE * sizeof(struct noc_sample));
+	spin_unlock_irqrestore(&noc_sample_lock, flags);
+
+	nr = min_t(unsigned int, head, NOC_SAMPLE_RING_SIZE);
+	seq_printf(m, "interval_ms %u total %u\n", noc_sample_interval_ms, head);
+	for (i = head - nr; i != head; i++) {
+		struct noc_sample *s = &copy[i & (NOC_SAMPLE_RING_SIZE - 1)];
+		struct noc_node *node = noc_sample_nodes[s->node];
+
+		seq_printf(m, "%llu %s %s %u %u %u %u\n", s->ts_ns,
+			   node ? node->name : "-",
+			   NOC_PACKET_PROBE_IRQ == s->type ? "bytes" : "latency",
+			   s->val[0], s->val[1], s->val[2], s->val[3]);
+	}
+
+	vfree(copy);
+	return 0;
+}
+
+static int noc_sample_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, noc_sample_show, NULL);
+}
+
+static const struct file_operations noc_sample_fops = {
+	.open = noc_sample_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init noc_sample_init(void)
+{
+	struct dentry *root;
+
+	root = debugfs_create_dir("noc_sample", NULL);
+	if (IS_ERR_OR_NULL(root))
+		return -ENOMEM;
+
+	debugfs_create_file("enable", 0660, root, NULL, &noc_sample_enable_fops);
+	debugfs_create_file("interval_ms", 0660, root, NULL,
+			    &noc_sample_interval_fops);
+	debugfs_create_file("samples", 0440, root, NULL, &noc_sample_fops);
+
+	return 0;
+}
+late_initcall_sync(noc_sample_init);
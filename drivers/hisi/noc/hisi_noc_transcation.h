@@ -34,6 +34,7 @@
 #define TRANS_M_MAINCTL                 (0x0408)/*(SOC_CFG_SYS_NOC_BUS_ASP_TRANS_M_MAINCTL_ADDR(0) - TRANS_F_BASE)*/
 #define TRANS_M_CFGCTL                  (0x040c)/*(SOC_CFG_SYS_NOC_BUS_ASP_TRANS_M_CFGCTL_ADDR(0) - TRANS_F_BASE)*/
 #define TRANS_M_STATPERIOD              (0x0424)/*(SOC_CFG_SYS_NOC_BUS_ASP_TRANS_M_STATPERIOD_ADDR(0) - TRANS_F_BASE)*/
+#define TRANS_M_STATGO                  (0x0428)
 #define TRANS_M_STATALARMMAX            (0x0430)/*(SOC_CFG_SYS_NOC_BUS_ASP_TRANS_M_STATALARMMAX_ADDR(0) - TRANS_F_BASE)*/
 #define TRANS_M_STATALARMCLR            (0x0438)/*(SOC_CFG_SYS_NOC_BUS_ASP_TRANS_M_STATALARMCLR_ADDR(0) - TRANS_F_BASE)*/
 
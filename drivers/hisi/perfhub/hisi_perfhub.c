@@ -9,6 +9,10 @@
 #include <linux/cpu.h>
 #include <linux/security.h>
 #include <linux/cpuset.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/jiffies.h>
+#include <linux/workqueue.h>
 
 #define LITTLE_CPU_START 0
 #define BIG_CPU_START    4
@@ -23,46 +27,30 @@ enum cpu_cluster {
 	CPU_CLUSTER_ALL,
 };
 
-static int bind_cpu_cluster(enum cpu_cluster e_cpu_cluster, pid_t pid)
+static void cpu_cluster_mask(enum cpu_cluster e_cpu_cluster,
+			     struct cpumask *mask)
 {
-	cpumask_var_t cpus_allowed, new_mask;
-	struct task_struct *p = NULL;
-	int retval;
-	struct cpumask mask;
 	int cpu_no;
-	const struct cred *pcred = NULL;
 
-	cpumask_clear(&mask);
+	cpumask_clear(mask);
 
 	switch (e_cpu_cluster) {
-		case CPU_CLUSTER_LITTLE: for (cpu_no = LITTLE_CPU_START; cpu_no < BIG_CPU_START; cpu_no++) cpumask_set_cpu(cpu_no, &mask); break;
-		case CPU_CLUSTER_BIG:    for (cpu_no = BIG_CPU_START; cpu_no < CPU_TOTAL; cpu_no++) cpumask_set_cpu(cpu_no, &mask); break;
-		default:                 for (cpu_no = LITTLE_CPU_START; cpu_no < CPU_TOTAL; cpu_no++) cpumask_set_cpu(cpu_no, &mask); break;
-	}
-
-	get_online_cpus();
-	rcu_read_lock();
-
-	p = find_task_by_vpid(pid);
-	if (!p) {
-		rcu_read_unlock();
-		put_online_cpus();
-		return -ESRCH;
+		case CPU_CLUSTER_LITTLE: for (cpu_no = LITTLE_CPU_START; cpu_no < BIG_CPU_START; cpu_no++) cpumask_set_cpu(cpu_no, mask); break;
+		case CPU_CLUSTER_BIG:    for (cpu_no = BIG_CPU_START; cpu_no < CPU_TOTAL; cpu_no++) cpumask_set_cpu(cpu_no, mask); break;
+		default:                 for (cpu_no = LITTLE_CPU_START; cpu_no < CPU_TOTAL; cpu_no++) cpumask_set_cpu(cpu_no, mask); break;
 	}
+}
 
-	/* Prevent p going away */
-	get_task_struct(p);
-	pcred = __task_cred(p);
-	rcu_read_unlock();
+/* @p must be held, and the cpu hotplug lock too */
+static int set_task_cpus(struct task_struct *p, const struct cpumask *mask)
+{
+	cpumask_var_t cpus_allowed, new_mask;
+	int retval;
 
-	if (p->flags & PF_NO_SETAFFINITY) {
-		retval = -EINVAL;
-		goto out_put_task;
-	}
-	if (!alloc_cpumask_var(&cpus_allowed, GFP_KERNEL)) {
-		retval = -ENOMEM;
-		goto out_put_task;
-	}
+	if (p->flags & PF_NO_SETAFFINITY)
+		return -EINVAL;
+	if (!alloc_cpumask_var(&cpus_allowed, GFP_KERNEL))
+		return -ENOMEM;
 	if (!alloc_cpumask_var(&new_mask, GFP_KERNEL)) {
 		retval = -ENOMEM;
 		goto out_free_cpus_allowed;
@@ -73,7 +61,7 @@ static int bind_cpu_cluster(enum cpu_cluster e_cpu_cluster, pid_t pid)
 		goto out_unlock;
 
 	cpuset_cpus_allowed(p, cpus_allowed);
-	cpumask_and(new_mask, &mask, cpus_allowed);
+	cpumask_and(new_mask, mask, cpus_allowed);
 again:
 	retval = set_cpus_allowed_ptr(p, new_mask);
 
@@ -93,13 +81,371 @@ out_unlock:
 	free_cpumask_var(new_mask);
 out_free_cpus_allowed:
 	free_cpumask_var(cpus_allowed);
-out_put_task:
+
+	return retval;
+}
+
+static int bind_cpu_cluster(enum cpu_cluster e_cpu_cluster, pid_t pid)
+{
+	struct task_struct *p = NULL;
+	int retval;
+	struct cpumask mask;
+
+	cpu_cluster_mask(e_cpu_cluster, &mask);
+
+	get_online_cpus();
+	rcu_read_lock();
+
+	p = find_task_by_vpid(pid);
+	if (!p) {
+		rcu_read_unlock();
+		put_online_cpus();
+		return -ESRCH;
+	}
+
+	/* Prevent p going away */
+	get_task_struct(p);
+	rcu_read_unlock();
+
+	retval = set_task_cpus(p, &mask);
+
 	put_task_struct(p);
 	put_online_cpus();
 
 	return retval;
 }
 
+/*
+ * Placement hints, given per thread group through the "hint" node:
+ *
+ *   echo "<tgid> <hint>[,<hint>...] [<ms>]" > /sys/kernel/perfhub/hint
+ *
+ * big:        keep the threads on the big cluster.
+ * latency:    raise their priority to at least LATENCY_NICE.
+ * background: keep them on the little cluster, at BACKGROUND_NICE or lower.
+ * boost:      big and latency for <ms> (default BOOST_DEFAULT_MS), on
+ *             top of the other hints, which stay after it expires.
+ * none:       drop all the hints of the group.
+ *
+ * The affinity and nice of every thread are saved when it first gets a
+ * hint and put back when the hints are dropped, hints only narrow the
+ * saved mask. Threads that showed up after the hints were given are
+ * picked up by the next write and reset to their cpuset on "none".
+ */
+#define HINT_BIG		0x1
+#define HINT_LATENCY		0x2
+#define HINT_BACKGROUND		0x4
+#define HINT_BOOST		0x8
+
+#define LATENCY_NICE		(-10)
+#define BACKGROUND_NICE		10
+#define BOOST_DEFAULT_MS	1000
+#define MAX_HINT_GROUPS		32
+
+struct hint_thread {
+	pid_t pid;
+	long nice;
+	struct cpumask mask;
+};
+
+struct hint_group {
+	struct list_head list;
+	pid_t tgid;
+	unsigned int hints;		/* without HINT_BOOST */
+	unsigned long boost_end;	/* jiffies, 0 when not boosted */
+	unsigned int nr_threads;
+	struct hint_thread *threads;
+};
+
+static LIST_HEAD(hint_groups);
+static unsigned int nr_hint_groups;
+static DEFINE_MUTEX(hint_mutex);
+
+static void hint_expire_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(hint_expire_work, hint_expire_fn);
+
+static const char * const hint_names[] = {
+	"big", "latency", "background", "boost",
+};
+
+static struct hint_thread *hint_find_thread(struct hint_group *g, pid_t pid)
+{
+	unsigned int i;
+
+	for (i = 0; i < g->nr_threads; i++)
+		if (g->threads[i].pid == pid)
+			return &g->threads[i];
+	return NULL;
+}
+
+static unsigned int hint_effective(struct hint_group *g)
+{
+	if (g->boost_end && time_before(jiffies, g->boost_end))
+		return g->hints | HINT_BIG | HINT_LATENCY;
+	return g->hints;
+}
+
+/* hold references to the threads of @tgid, NULL if it is gone */
+static struct task_struct **hint_get_threads(pid_t tgid, unsigned int *nr)
+{
+	struct task_struct *leader, *t, **tasks;
+	unsigned int max, n = 0;
+
+	rcu_read_lock();
+	leader = find_task_by_vpid(tgid);
+	max = leader ? get_nr_threads(leader) : 0;
+	rcu_read_unlock();
+	if (!max)
+		return NULL;
+
+	/* room for threads forked meanwhile, later ones wait for next time */
+	max += 8;
+	tasks = kcalloc(max, sizeof(*tasks), GFP_KERNEL);
+	if (!tasks)
+		return NULL;
+
+	rcu_read_lock();
+	leader = find_task_by_vpid(tgid);
+	if (leader) {
+		for_each_thread(leader, t) {
+			if (n == max)
+				break;
+			get_task_struct(t);
+			tasks[n++] = t;
+		}
+	}
+	rcu_read_unlock();
+
+	if (!n) {
+		kfree(tasks);
+		return NULL;
+	}
+	*nr = n;
+	return tasks;
+}
+
+/* must be called with hint_mutex held */
+static int hint_apply(struct hint_group *g)
+{
+	unsigned int hints = hint_effective(g);
+	struct task_struct **tasks;
+	struct hint_thread *ht, *grown;
+	struct cpumask mask, cluster;
+	unsigned int nr, i;
+	long nice;
+
+	tasks = hint_get_threads(g->tgid, &nr);
+	if (!tasks)
+		return -ESRCH;
+
+	get_online_cpus();
+	for (i = 0; i < nr; i++) {
+		ht = hint_find_thread(g, tasks[i]->pid);
+		if (!ht && hints) {
+			grown = krealloc(g->threads, (g->nr_threads + 1) *
+					 sizeof(*g->threads), GFP_KERNEL);
+			if (!grown)
+				continue;
+			g->threads = grown;
+			ht = &g->threads[g->nr_threads++];
+			ht->pid = tasks[i]->pid;
+			ht->nice = task_nice(tasks[i]);
+			cpumask_copy(&ht->mask, tsk_cpus_allowed(tasks[i]));
+		}
+
+		if (ht) {
+			cpumask_copy(&mask, &ht->mask);
+			nice = ht->nice;
+		} else {
+			cpu_cluster_mask(CPU_CLUSTER_ALL, &mask);
+			nice = task_nice(tasks[i]);
+		}
+
+		if (hints & (HINT_BIG | HINT_BACKGROUND)) {
+			cpu_cluster_mask(hints & HINT_BIG ? CPU_CLUSTER_BIG :
+					 CPU_CLUSTER_LITTLE, &cluster);
+			/* a hint never takes a thread off all its own cpus */
+			if (cpumask_intersects(&mask, &cluster))
+				cpumask_and(&mask, &mask, &cluster);
+		}
+		if (hints & HINT_LATENCY)
+			nice = min_t(long, nice, LATENCY_NICE);
+		else if (hints & HINT_BACKGROUND)
+			nice = max_t(long, nice, BACKGROUND_NICE);
+
+		set_task_cpus(tasks[i], &mask);
+		if (task_nice(tasks[i]) != nice)
+			set_user_nice(tasks[i], nice);
+		put_task_struct(tasks[i]);
+	}
+	put_online_cpus();
+	kfree(tasks);
+
+	return 0;
+}
+
+static void hint_free_group(struct hint_group *g)
+{
+	list_del(&g->list);
+	nr_hint_groups--;
+	kfree(g->threads);
+	kfree(g);
+}
+
+/* must be called with hint_mutex held */
+static void hint_schedule_expiry(void)
+{
+	struct hint_group *g;
+	unsigned long next = 0;
+
+	list_for_each_entry(g, &hint_groups, list) {
+		if (!g->boost_end)
+			continue;
+		if (!next || time_before(g->boost_end, next))
+			next = g->boost_end;
+	}
+	if (next)
+		mod_delayed_work(system_wq, &hint_expire_work,
+				 time_after(next, jiffies) ? next - jiffies : 0);
+}
+
+static void hint_expire_fn(struct work_struct *work)
+{
+	struct hint_group *g, *tmp;
+
+	mutex_lock(&hint_mutex);
+	list_for_each_entry_safe(g, tmp, &hint_groups, list) {
+		if (!g->boost_end || time_before(jiffies, g->boost_end))
+			continue;
+		g->boost_end = 0;
+		if (hint_apply(g) || !g->hints)
+			hint_free_group(g);
+	}
+	hint_schedule_expiry();
+	mutex_unlock(&hint_mutex);
+}
+
+static int hint_set(pid_t tgid, unsigned int hints, unsigned int boost_ms)
+{
+	struct hint_group *g, *found = NULL, *tmp;
+	int ret;
+
+	mutex_lock(&hint_mutex);
+	list_for_each_entry(g, &hint_groups, list) {
+		if (g->tgid == tgid) {
+			found = g;
+			break;
+		}
+	}
+
+	if (!found) {
+		if (!hints) {
+			mutex_unlock(&hint_mutex);
+			return 0;
+		}
+		if (nr_hint_groups >= MAX_HINT_GROUPS) {
+			/* make room from the groups that exited */
+			list_for_each_entry_safe(g, tmp, &hint_groups, list) {
+				rcu_read_lock();
+				if (!find_task_by_vpid(g->tgid))
+					hint_free_group(g);
+				rcu_read_unlock();
+			}
+		}
+		if (nr_hint_groups >= MAX_HINT_GROUPS) {
+			mutex_unlock(&hint_mutex);
+			return -ENOSPC;
+		}
+		found = kzalloc(sizeof(*found), GFP_KERNEL);
+		if (!found) {
+			mutex_unlock(&hint_mutex);
+			return -ENOMEM;
+		}
+		found->tgid = tgid;
+		list_add_tail(&found->list, &hint_groups);
+		nr_hint_groups++;
+	}
+
+	found->hints = hints & ~HINT_BOOST;
+	if (hints & HINT_BOOST)
+		found->boost_end = jiffies + msecs_to_jiffies(boost_ms) ? : 1;
+	else if (!hints)
+		found->boost_end = 0;
+
+	ret = hint_apply(found);
+	if (ret || !hint_effective(found))
+		hint_free_group(found);
+	hint_schedule_expiry();
+	mutex_unlock(&hint_mutex);
+
+	return ret;
+}
+
+static ssize_t hint_show(struct kobject *kobj, struct kobj_attribute *attr,
+			 char *buf)
+{
+	struct hint_group *g;
+	unsigned int hints, i;
+	ssize_t len = 0;
+	const char *sep;
+
+	mutex_lock(&hint_mutex);
+	list_for_each_entry(g, &hint_groups, list) {
+		hints = g->hints;
+		if (g->boost_end && time_before(jiffies, g->boost_end))
+			hints |= HINT_BOOST;
+
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%d ", g->tgid);
+		sep = "";
+		for (i = 0; i < ARRAY_SIZE(hint_names); i++) {
+			if (!(hints & (1U << i)))
+				continue;
+			len += scnprintf(buf + len, PAGE_SIZE - len, "%s%s",
+					 sep, hint_names[i]);
+			sep = ",";
+		}
+		if (hints & HINT_BOOST)
+			len += scnprintf(buf + len, PAGE_SIZE - len, " %u",
+				jiffies_to_msecs(g->boost_end - jiffies));
+		len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+	}
+	mutex_unlock(&hint_mutex);
+
+	return len;
+}
+
+static ssize_t hint_store(struct kobject *kobj, struct kobj_attribute *attr,
+			  const char *buf, size_t count)
+{
+	char names[64], *cur, *name;
+	unsigned int hints = 0, boost_ms = BOOST_DEFAULT_MS, i;
+	int tgid, n, ret;
+
+	n = sscanf(buf, "%d %63s %u", &tgid, names, &boost_ms);
+	if (n < 2 || tgid <= 0)
+		return -EINVAL;
+
+	cur = names;
+	while ((name = strsep(&cur, ",")) != NULL) {
+		if (!strcmp(name, "none"))
+			continue;
+		for (i = 0; i < ARRAY_SIZE(hint_names); i++)
+			if (!strcmp(name, hint_names[i]))
+				break;
+		if (i == ARRAY_SIZE(hint_names))
+			return -EINVAL;
+		hints |= 1U << i;
+	}
+	if ((hints & HINT_BIG) && (hints & HINT_BACKGROUND))
+		return -EINVAL;
+
+	ret = hint_set(tgid, hints, boost_ms);
+	if (ret)
+		return ret;
+
+	return count;
+}
+
 static ssize_t perfhub_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
 {
 	return snprintf(buf, PAGE_SIZE, "%c|%d\n", g_last_tag, g_last_pid);
@@ -144,6 +490,7 @@ static ssize_t perfhub_store(struct kobject *kobj, struct kobj_attribute *attr,
 }
 
 struct kobj_attribute perfhub_attribute = __ATTR(cpuaffinity, 0660, perfhub_show, perfhub_store);
+struct kobj_attribute hint_attribute = __ATTR(hint, 0660, hint_show, hint_store);
 
 struct kobject *perfhub_kobj = NULL;
 
@@ -156,21 +503,37 @@ static int __init perfhub_init(void)
 		return -ENOMEM;
 
 	retval = sysfs_create_file(perfhub_kobj, &perfhub_attribute.attr);
+	if (retval)
+		goto err;
+
+	retval = sysfs_create_file(perfhub_kobj, &hint_attribute.attr);
 	if (retval) {
-		kobject_put(perfhub_kobj);
-		perfhub_kobj = NULL;
+		sysfs_remove_file(perfhub_kobj, &perfhub_attribute.attr);
+		goto err;
 	}
 
+	return 0;
+
+err:
+	kobject_put(perfhub_kobj);
+	perfhub_kobj = NULL;
 	return retval;
 }
 
 static void __exit perfhub_exit(void)
 {
+	struct hint_group *g, *tmp;
+
 	if (perfhub_kobj) {
+		sysfs_remove_file(perfhub_kobj, &hint_attribute.attr);
 		sysfs_remove_file(perfhub_kobj, &perfhub_attribute.attr);
 		kobject_put(perfhub_kobj);
 		perfhub_kobj = NULL;
 	}
+
+	cancel_delayed_work_sync(&hint_expire_work);
+	list_for_each_entry_safe(g, tmp, &hint_groups, list)
+		hint_free_group(g);
 }
 
 module_init(perfhub_init);
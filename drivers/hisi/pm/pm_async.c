@@ -0,0 +1,497 @@
+/*
+ * hisi_pm_async - asynchronous suspend/resume of hisi devices
+ *
+ * Copyright (c) 2013 Huawei Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * A platform device whose node carries "hisi,pm-async" is suspended and
+ * resumed asynchronously once it is bound. The PM core already orders a
+ * device after its children on suspend and after its parent on resume;
+ * the other devices it needs are the ones listed in "hisi,async-depends",
+ * the same list the async probe domain waits for:
+ *
+ *	noc: noc@e8000000 {
+ *		...
+ *		hisi,pm-async;
+ *		hisi,async-depends = <&pmctrl &crgctrl>;
+ *	};
+ *
+ * A listed device is resumed before and suspended after the node's device
+ * in every phase. The dependencies must not form a cycle.
+ *
+ * The time of every device callback is recorded as well, and the slowest
+ * ones of the last suspend and resume are logged after resume and shown in
+ * debugfs/hisi_pm_dev_times.
+ *
+ * debugfs/hisi_suspend_budget adds up where suspend time went since boot:
+ * the attempts, the wakeup sources whose holds blocked an attempt, and the
+ * suspend and resume callback time of every driver.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include <linux/rwsem.h>
+#include <linux/spinlock.h>
+#include <linux/slab.h>
+#include <linux/of.h>
+#include <linux/of_platform.h>
+#include <linux/platform_device.h>
+#include <linux/suspend.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/hisi/hisi_pm_async.h>
+
+#include "../../base/power/power.h"
+
+#define PM_ASYNC_PROP		"hisi,pm-async"
+#define PM_DEPENDS_PROP		"hisi,async-depends"
+#define PM_DEV_TIMES_NUM	16
+#define PM_DEV_NAME_LEN		32
+#define PM_DRV_TIMES_NUM	96
+
+#define NO_SEQFILE 0
+#define PM_ASYNC_MSG(seq_file, fmt, args ...) \
+		{		\
+			if (NO_SEQFILE == seq_file)	\
+				printk(KERN_INFO fmt, ##args);	\
+			else	\
+				seq_printf(seq_file, fmt, ##args);	\
+		}
+
+static bool enable = true;
+module_param(enable, bool, S_IRUGO);
+
+static bool dev_times = true;
+module_param(dev_times, bool, S_IRUGO | S_IWUSR);
+
+/*
+ * struct hisi_pm_dep - 'consumer' is resumed after and suspended before
+ * 'supplier'. Both are referenced until the consumer is unbound.
+ */
+struct hisi_pm_dep {
+	struct list_head node;
+	struct device *consumer;
+	struct device *supplier;
+};
+
+static LIST_HEAD(hisi_pm_deps);
+/* readers may sleep on a device while holding it, see hisi_pm_for_each_dep */
+static DECLARE_RWSEM(hisi_pm_deps_sem);
+
+struct hisi_pm_dev_time {
+	char name[PM_DEV_NAME_LEN];
+	const char *info;
+	int event;
+	int error;
+	bool async;
+	s64 nsecs;
+};
+
+/* the slowest callbacks since the last PM_SUSPEND_PREPARE, slowest first */
+static struct hisi_pm_dev_time hisi_pm_times[PM_DEV_TIMES_NUM];
+static unsigned int hisi_pm_times_num;
+static DEFINE_SPINLOCK(hisi_pm_times_lock);
+
+/* callback time per driver since boot, also under hisi_pm_times_lock */
+struct hisi_pm_drv_time {
+	char name[PM_DEV_NAME_LEN];
+	unsigned long count;
+	s64 suspend_ns;
+	s64 resume_ns;
+	s64 max_ns;
+};
+
+static struct hisi_pm_drv_time hisi_pm_drv_times[PM_DRV_TIMES_NUM];
+static unsigned int hisi_pm_drv_times_num;
+static unsigned long hisi_pm_drv_times_dropped;
+
+/*
+ * hisi_pm_for_each_dep - call 'fn' for every device 'dev' depends on, when
+ * 'suppliers' is set, or for every device depending on 'dev' otherwise.
+ * Called by the PM core before running a resume respectively suspend
+ * callback of 'dev', 'fn' waits for the other device to complete.
+ */
+int hisi_pm_for_each_dep(struct device *dev, bool suppliers, void *data,
+			 int (*fn)(struct device *, void *))
+{
+	struct hisi_pm_dep *dep;
+	int ret = 0;
+
+	if (list_empty(&hisi_pm_deps))
+		return 0;
+
+	down_read(&hisi_pm_deps_sem);
+	list_for_each_entry(dep, &hisi_pm_deps, node) {
+		if (suppliers && dep->consumer == dev)
+			ret = fn(dep->supplier, data);
+		else if (!suppliers && dep->supplier == dev)
+			ret = fn(dep->consumer, data);
+		if (ret)
+			break;
+	}
+	up_read(&hisi_pm_deps_sem);
+
+	return ret;
+}
+
+/* called with the dpm list locked */
+static int hisi_pm_move_child(struct device *dev, void *data)
+{
+	struct device **last = data;
+
+	device_pm_move_after(dev, *last);
+	*last = dev;
+	return device_for_each_child(dev, last, hisi_pm_move_child);
+}
+
+/*
+ * The sync suspend and resume loops walk dpm_list in order, so a consumer
+ * that sits before its supplier would have the loop wait on a device it
+ * has not started yet. Move it, with its children, right after the
+ * supplier. Its own consumers bind after it, they are moved then.
+ */
+static void hisi_pm_deps_order(struct device *consumer,
+			       struct device *supplier)
+{
+	struct device *dev, *last = supplier;
+
+	device_pm_lock();
+	if (list_empty(&consumer->power.entry) ||
+	    list_empty(&supplier->power.entry))
+		goto out;
+
+	dev = supplier;
+	list_for_each_entry_continue(dev, &dpm_list, power.entry) {
+		if (dev == consumer)
+			goto out;
+	}
+	hisi_pm_move_child(consumer, &last);
+out:
+	device_pm_unlock();
+}
+
+static void hisi_pm_deps_add(struct device *dev)
+{
+	struct device_node *np;
+	struct platform_device *pdev;
+	struct hisi_pm_dep *dep;
+	int i;
+
+	for (i = 0; ; i++) {
+		np = of_parse_phandle(dev->of_node, PM_DEPENDS_PROP, i);
+		if (!np)
+			break;
+
+		/* nodes without a platform device have no PM callbacks here */
+		pdev = of_find_device_by_node(np);
+		of_node_put(np);
+		if (!pdev)
+			continue;
+
+		dep = kzalloc(sizeof(*dep), GFP_KERNEL);
+		if (!dep) {
+			put_device(&pdev->dev);
+			dev_err(dev, "dependency %d dropped\n", i);
+			continue;
+		}
+		dep->consumer = get_device(dev);
+		dep->supplier = &pdev->dev;
+
+		hisi_pm_deps_order(dev, &pdev->dev);
+
+		down_write(&hisi_pm_deps_sem);
+		list_add_tail(&dep->node, &hisi_pm_deps);
+		up_write(&hisi_pm_deps_sem);
+	}
+}
+
+static void hisi_pm_deps_del(struct device *dev)
+{
+	struct hisi_pm_dep *dep, *tmp;
+	LIST_HEAD(dropped);
+
+	down_write(&hisi_pm_deps_sem);
+	list_for_each_entry_safe(dep, tmp, &hisi_pm_deps, node) {
+		if (dep->consumer == dev)
+			list_move(&dep->node, &dropped);
+	}
+	up_write(&hisi_pm_deps_sem);
+
+	list_for_each_entry_safe(dep, tmp, &dropped, node) {
+		put_device(dep->supplier);
+		put_device(dep->consumer);
+		kfree(dep);
+	}
+}
+
+static int hisi_pm_async_notify(struct notifier_block *nb,
+				unsigned long action, void *data)
+{
+	struct device *dev = data;
+
+	if (!dev->of_node)
+		return NOTIFY_DONE;
+
+	switch (action) {
+	case BUS_NOTIFY_BOUND_DRIVER:
+		/*
+		 * Dependencies are kept whether or not this device is async
+		 * itself, one of its suppliers may be.
+		 */
+		hisi_pm_deps_add(dev);
+		if (of_property_read_bool(dev->of_node, PM_ASYNC_PROP))
+			device_enable_async_suspend(dev);
+		break;
+	case BUS_NOTIFY_UNBOUND_DRIVER:
+		if (of_property_read_bool(dev->of_node, PM_ASYNC_PROP))
+			device_disable_async_suspend(dev);
+		hisi_pm_deps_del(dev);
+		break;
+	default:
+		break;
+	}
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block hisi_pm_async_nb = {
+	.notifier_call = hisi_pm_async_notify,
+};
+
+bool hisi_pm_dev_times_enabled(void)
+{
+	return dev_times;
+}
+
+/* devices without a driver are accounted by the name of their bus or class */
+static const char *hisi_pm_drv_name(struct device *dev)
+{
+	if (dev->driver)
+		return dev->driver->name;
+	if (dev->bus)
+		return dev->bus->name;
+	if (dev->class)
+		return dev->class->name;
+	return dev_name(dev);
+}
+
+static void hisi_pm_drv_time_add(struct device *dev, int event, s64 nsecs)
+{
+	const char *name = hisi_pm_drv_name(dev);
+	struct hisi_pm_drv_time *t = NULL;
+	unsigned int i;
+
+	for (i = 0; i < hisi_pm_drv_times_num; i++) {
+		if (!strncmp(hisi_pm_drv_times[i].name, name, PM_DEV_NAME_LEN - 1)) {
+			t = &hisi_pm_drv_times[i];
+			break;
+		}
+	}
+	if (!t) {
+		if (hisi_pm_drv_times_num == PM_DRV_TIMES_NUM) {
+			hisi_pm_drv_times_dropped++;
+			return;
+		}
+		t = &hisi_pm_drv_times[hisi_pm_drv_times_num++];
+		strlcpy(t->name, name, sizeof(t->name));
+	}
+
+	t->count++;
+	if (event == PM_EVENT_SUSPEND)
+		t->suspend_ns += nsecs;
+	else
+		t->resume_ns += nsecs;
+	if (nsecs > t->max_ns)
+		t->max_ns = nsecs;
+}
+
+/*
+ * hisi_pm_dev_time_record - called by the PM core after every device
+ * suspend or resume callback, possibly from several async threads.
+ */
+void hisi_pm_dev_time_record(struct device *dev, pm_message_t state,
+			     const char *info, int error, s64 nsecs)
+{
+	struct hisi_pm_dev_time *t;
+	unsigned long flags;
+	unsigned int i;
+
+	if (state.event != PM_EVENT_SUSPEND && state.event != PM_EVENT_RESUME)
+		return;
+
+	spin_lock_irqsave(&hisi_pm_times_lock, flags);
+	hisi_pm_drv_time_add(dev, state.event, nsecs);
+	for (i = hisi_pm_times_num; i > 0; i--) {
+		if (hisi_pm_times[i - 1].nsecs >= nsecs)
+			break;
+	}
+	if (i < PM_DEV_TIMES_NUM) {
+		if (hisi_pm_times_num < PM_DEV_TIMES_NUM)
+			hisi_pm_times_num++;
+		memmove(&hisi_pm_times[i + 1], &hisi_pm_times[i],
+			(hisi_pm_times_num - i - 1) * sizeof(*t));
+		t = &hisi_pm_times[i];
+		strlcpy(t->name, dev_name(dev), sizeof(t->name));
+		t->info = info;
+		t->event = state.event;
+		t->error = error;
+		t->async = dev->power.async_suspend;
+		t->nsecs = nsecs;
+	}
+	spin_unlock_irqrestore(&hisi_pm_times_lock, flags);
+}
+
+static void hisi_pm_dev_times_show(struct seq_file *s)
+{
+	struct hisi_pm_dev_time *times;
+	unsigned long flags;
+	unsigned int i, num;
+
+	times = kmalloc(sizeof(hisi_pm_times), GFP_KERNEL);
+	if (!times)
+		return;
+
+	spin_lock_irqsave(&hisi_pm_times_lock, flags);
+	num = hisi_pm_times_num;
+	memcpy(times, hisi_pm_times, num * sizeof(*times));
+	spin_unlock_irqrestore(&hisi_pm_times_lock, flags);
+
+	PM_ASYNC_MSG(s, "SR:slowest %u device callbacks:\n", num);
+	for (i = 0; i < num; i++) {
+		PM_ASYNC_MSG(s, "SR:%s %s%s%s%s: %lld usecs, err %d\n",
+			times[i].name,
+			times[i].event == PM_EVENT_SUSPEND ? "suspend" : "resume",
+			times[i].info ? " " : "",
+			times[i].info ? times[i].info : "",
+			times[i].async ? " async" : "",
+			times[i].nsecs >> 10, times[i].error);
+	}
+
+	kfree(times);
+}
+
+static int hisi_pm_times_notify(struct notifier_block *nb,
+				unsigned long action, void *data)
+{
+	unsigned long flags;
+
+	switch (action) {
+	case PM_SUSPEND_PREPARE:
+		spin_lock_irqsave(&hisi_pm_times_lock, flags);
+		hisi_pm_times_num = 0;
+		spin_unlock_irqrestore(&hisi_pm_times_lock, flags);
+		break;
+	case PM_POST_SUSPEND:
+		if (dev_times)
+			hisi_pm_dev_times_show(NO_SEQFILE);
+		break;
+	default:
+		break;
+	}
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block hisi_pm_times_nb = {
+	.notifier_call = hisi_pm_times_notify,
+};
+
+static int hisi_pm_dev_times_seq_show(struct seq_file *s, void *unused)
+{
+	hisi_pm_dev_times_show(s);
+	return 0;
+}
+
+static int hisi_pm_dev_times_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hisi_pm_dev_times_seq_show, NULL);
+}
+
+static const struct file_operations hisi_pm_dev_times_fops = {
+	.open		= hisi_pm_dev_times_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int hisi_suspend_budget_show(struct seq_file *s, void *unused)
+{
+	struct hisi_pm_drv_time *times;
+	unsigned long flags, dropped;
+	unsigned int i, num;
+
+	seq_printf(s, "attempts: success %d fail %d freeze %d suspend %d late %d noirq %d\n\n",
+		   suspend_stats.success, suspend_stats.fail,
+		   suspend_stats.failed_freeze, suspend_stats.failed_suspend,
+		   suspend_stats.failed_suspend_late,
+		   suspend_stats.failed_suspend_noirq);
+
+	pm_wakeup_blockers_show(s);
+
+	times = kmalloc(sizeof(hisi_pm_drv_times), GFP_KERNEL);
+	if (!times)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&hisi_pm_times_lock, flags);
+	num = hisi_pm_drv_times_num;
+	dropped = hisi_pm_drv_times_dropped;
+	memcpy(times, hisi_pm_drv_times, num * sizeof(*times));
+	spin_unlock_irqrestore(&hisi_pm_times_lock, flags);
+
+	seq_puts(s, "\ndriver\t\tcallbacks\tsuspend_us\tresume_us\tmax_us\n");
+	for (i = 0; i < num; i++) {
+		seq_printf(s, "%-12s\t%lu\t\t%lld\t\t%lld\t\t%lld\n",
+			   times[i].name, times[i].count,
+			   div_s64(times[i].suspend_ns, NSEC_PER_USEC),
+			   div_s64(times[i].resume_ns, NSEC_PER_USEC),
+			   div_s64(times[i].max_ns, NSEC_PER_USEC));
+	}
+	if (dropped)
+		seq_printf(s, "(%lu callbacks of further drivers not counted)\n",
+			   dropped);
+
+	kfree(times);
+	return 0;
+}
+
+static int hisi_suspend_budget_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hisi_suspend_budget_show, NULL);
+}
+
+static const struct file_operations hisi_suspend_budget_fops = {
+	.open		= hisi_suspend_budget_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/*
+ * Registered before the platform devices get bound at device_initcall, so
+ * that every bound hisi device is seen by the notifier.
+ */
+static int __init hisi_pm_async_init(void)
+{
+	int ret;
+
+	if (enable) {
+		ret = bus_register_notifier(&platform_bus_type,
+					    &hisi_pm_async_nb);
+		if (ret)
+			pr_err("%s: bus notifier failed %d\n", __func__, ret);
+	}
+
+	register_pm_notifier(&hisi_pm_times_nb);
+	debugfs_create_file("hisi_pm_dev_times", S_IRUSR, NULL, NULL,
+			    &hisi_pm_dev_times_fops);
+	debugfs_create_file("hisi_suspend_budget", S_IRUSR, NULL, NULL,
+			    &hisi_suspend_budget_fops);
+
+	return 0;
+}
+arch_initcall(hisi_pm_async_init);
@@ -6,6 +6,13 @@
   * This program is free software; you can redistribute it and/or modify
   * it under the terms of the GNU General Public License version 2 as
   * published by the Free Software Foundation.
+  *
+  * Before suspend, the dirty data of f2fs is written back in chunks for at
+  * most sync_budget_ms, stopping early on a pending wakeup. Whatever is left
+  * stays in the page cache, which survives suspend. No checkpoint is forced:
+  * if power is lost, f2fs comes back at its last checkpoint plus the data
+  * that was fsync'ed, as it would anyway. Other writable filesystems get a
+  * full sync_filesystem() as before. A budget of 0 falls back to sys_sync().
   */
 
 #include <linux/device.h>
@@ -14,6 +21,24 @@
 #include <linux/wakelock.h>
 #include <linux/syscalls.h>
 #include <linux/suspend.h>
+#include <linux/fs.h>
+#include <linux/writeback.h>
+#include <linux/backing-dev.h>
+#include <linux/magic.h>
+#include <linux/jiffies.h>
+#include <linux/moduleparam.h>
+
+/* 4MB per writeback pass, so the budget and wakeups are checked often */
+#define SUSPEND_SYNC_CHUNK_PAGES	1024
+
+static unsigned int sync_budget_ms = 500;
+module_param(sync_budget_ms, uint, S_IRUGO | S_IWUSR);
+
+struct suspend_sync_ctl {
+	unsigned long deadline;
+	unsigned int chunks;
+	bool partial;
+};
 
 static int suspend_sys_sync_count = 0;
 static DEFINE_SPINLOCK(suspend_sys_sync_lock);
@@ -24,11 +49,43 @@ static bool suspend_sys_sync_abort;
 static void suspend_sys_sync_handler(unsigned long);
 static DEFINE_TIMER(suspend_sys_sync_timer, suspend_sys_sync_handler, 0, 0);
 
+static void suspend_sync_one_sb(struct super_block *sb, void *arg)
+{
+	struct suspend_sync_ctl *ctl = arg;
+
+	if ((sb->s_flags & MS_RDONLY) || sb->s_bdi == &noop_backing_dev_info)
+		return;
+
+	if (sb->s_magic != F2FS_SUPER_MAGIC) {
+		sync_filesystem(sb);
+		return;
+	}
+
+	while (bdi_has_dirty_io(sb->s_bdi)) {
+		if (time_after(jiffies, ctl->deadline) || pm_wakeup_pending()) {
+			ctl->partial = true;
+			return;
+		}
+		writeback_inodes_sb_nr(sb, SUSPEND_SYNC_CHUNK_PAGES,
+				       WB_REASON_SYNC);
+		ctl->chunks++;
+	}
+}
+
 static void suspend_sys_sync(struct work_struct *work)
 {
+	struct suspend_sync_ctl ctl = { 0 };
+	unsigned int budget_ms = ACCESS_ONCE(sync_budget_ms);
+
 	printk("PM: Syncing filesystems +\n");
-	sys_sync();
-	printk("PM: Syncing filesystems -\n");
+	if (budget_ms) {
+		ctl.deadline = jiffies + msecs_to_jiffies(budget_ms);
+		iterate_supers(suspend_sync_one_sb, &ctl);
+	} else {
+		sys_sync();
+	}
+	printk("PM: Syncing filesystems - %u chunks%s\n", ctl.chunks,
+	       ctl.partial ? ", partial" : "");
 
 	spin_lock(&suspend_sys_sync_lock);
 	suspend_sys_sync_count--;
@@ -17,6 +17,8 @@
 #include <linux/kexec.h>
 #include <linux/init.h>
 #include <linux/sched.h>
+#include <linux/percpu.h>
+#include <linux/debugfs.h>
 
 #include <asm/esr.h>
 #include <asm/traps.h>
@@ -64,5 +66,27 @@ int do_tlb_conflict(unsigned long addr, unsigned int esr,
 
 	return 0;
 }
+
+/* tlb invalidations skipped for address spaces being torn down */
+DEFINE_PER_CPU(unsigned long, tlbi_saved);
+
+static int tlbi_saved_get(void *data, u64 *val)
+{
+	int cpu;
+
+	*val = 0;
+	for_each_possible_cpu(cpu)
+		*val += per_cpu(tlbi_saved, cpu);
+
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(tlbi_saved_fops, tlbi_saved_get, NULL, "%llu\n");
+
+static int __init tlb_conflict_debugfs_init(void)
+{
+	debugfs_create_file("tlbi_saved", S_IRUGO, NULL, NULL, &tlbi_saved_fops);
+	return 0;
+}
+late_initcall(tlb_conflict_debugfs_init);
 /*lint +e438 +e529 +e550 +e715*/
 
@@ -42,6 +42,7 @@
 #include "tui.h"
 #include "securec.h"
 #include "tc_ns_log.h"
+#include "tc_profile.h"
 
 #define HASH_FILE_MAX_SIZE 8192
 #define AGENT_BUFF_SIZE (4*1024)
@@ -185,6 +186,7 @@ unsigned int agent_process_work(TC_NS_SMC_CMD *smc_cmd, unsigned int agent_id)
 	}
 	isb();
 	wmb();
+	event_data->prof_start_ns = tc_prof_now();
 	event_data->ret_flag = 1;
 	/* Wake up the agent that will process the command */
 	tlogd("agent_process_work: wakeup the agent");
@@ -282,6 +284,7 @@ int TC_NS_send_event_response(unsigned int agent_id)
 	if (event_data && event_data->ret_flag) {
 		event_data->send_flag = 1;
 		event_data->ret_flag = 0;
+		tc_prof_agent(agent_id, event_data->prof_start_ns);
 		/* Send the command back to the TA session waiting for it */
 		return TC_NS_POST_SMC(&event_data->cmd);
 	}
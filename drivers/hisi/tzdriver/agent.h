@@ -26,6 +26,7 @@ struct __smc_event_data {
 	TC_NS_SMC_CMD cmd;
 	TC_NS_DEV_File *owner;
 	TC_NS_Shared_MEM *buffer;
+	u64 prof_start_ns;	/* request handed to the agent */
 };
 
 struct tee_agent_kernel_ops {
@@ -23,6 +23,7 @@
 #include "gp_ops.h"
 #include "mem.h"
 #include "tlogger.h"
+#include "tc_profile.h"
 
 #define MAX_SHARED_SIZE 0x100000	/* 1 MiB */
 
@@ -262,8 +263,7 @@ static TC_NS_Operation *alloc_operation(TC_NS_DEV_File *dev_file,
 				ret = -EFAULT;
 				break;
 			}
-			temp_buf = (void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO,
-							    get_order(ROUND_UP(buffer_size, SZ_4K)));
+			temp_buf = tc_mem_temp_alloc(buffer_size);
 			/* If buffer size is zero or malloc failed */
 			if (!temp_buf) {
 				tloge("temp_buf malloc failed, i = %d.\n", i);
@@ -273,6 +273,11 @@ static TC_NS_Operation *alloc_operation(TC_NS_DEV_File *dev_file,
 				tlogd("temp_buf malloc ok, i = %d.\n", i);
 			}
 			local_temp_buffer[i].temp_buffer = temp_buf;
+			local_temp_buffer[i].size = buffer_size;
+			/* pooled buffers are not cleared, don't leak the
+			 * previous call's data through an output buffer */
+			if (TEEC_MEMREF_TEMP_OUTPUT == param_type)
+				memset(temp_buf, 0, buffer_size);
 			if ((TEEC_MEMREF_TEMP_INPUT == param_type) ||
 			    (TEEC_MEMREF_TEMP_INOUT == param_type)) {
 				tlogv("client_param->memref.buffer=0x%llx\n",
@@ -290,7 +295,6 @@ static TC_NS_Operation *alloc_operation(TC_NS_DEV_File *dev_file,
 			}
 			operation->params[i].memref.buffer = virt_to_phys((void *)temp_buf);
 			operation->buffer_h_addr[i] = virt_to_phys((void *)temp_buf) >> 32;
-			local_temp_buffer[i].size = buffer_size;
 			operation->params[i].memref.size = buffer_size;
 			/*TEEC_MEMREF_TEMP_INPUT equal
 			 * to TEE_PARAM_TYPE_MEMREF_INPUT*/
@@ -598,16 +602,13 @@ static int free_operation(TC_NS_ClientContext *client_context,
 		if ((TEEC_MEMREF_TEMP_INPUT == param_type) ||
 		    (TEEC_MEMREF_TEMP_OUTPUT == param_type) ||
 		    (TEEC_MEMREF_TEMP_INOUT == param_type)) {
-			/* free temp buffer */
-			/* TODO: this is all sorts of bad */
+			/* free temp buffer, back to its size class pool */
 			temp_buf = local_temp_buffer[i].temp_buffer;
 			tlogd("Free temp buf %p, i = %d\n", temp_buf, i);
 			if (virt_addr_valid(temp_buf) &&
 			    !ZERO_OR_NULL_PTR(temp_buf))
-				free_pages((unsigned long)temp_buf,
-					   get_order(ROUND_UP
-						     (local_temp_buffer[i].size,
-						      SZ_4K))); /*lint !e647 */
+				tc_mem_temp_free(temp_buf,
+						 local_temp_buffer[i].size);
 		} else if ((TEEC_MEMREF_PARTIAL_INPUT == param_type) ||
 			 (TEEC_MEMREF_PARTIAL_OUTPUT == param_type) ||
 			 (TEEC_MEMREF_PARTIAL_INOUT == param_type)) {
@@ -635,6 +636,7 @@ int tc_client_call(TC_NS_ClientContext *client_context,
 	bool global = flags & TC_CALL_GLOBAL;
 	uint32_t uid;
 	unsigned char *hash_buf = NULL;
+	struct tc_prof_call prof = { 0 };
 
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3, 13, 0))
 	kuid_t kuid;
@@ -662,9 +664,11 @@ int tc_client_call(TC_NS_ClientContext *client_context,
 
 	tlogd("Calling command %08x\n", client_context->cmd_id);
 
+	tc_prof_call_start(&prof);
 	if (client_context->paramTypes != 0) {
 		operation = alloc_operation(dev_file, client_context,
 					    local_temp_buffer, flags);
+		tc_prof_call_mark(&prof, TC_PROF_MARSHAL);
 		if (IS_ERR_OR_NULL(operation)) {
 			ret = PTR_ERR(operation);
 			operation = NULL;
@@ -751,6 +755,7 @@ int tc_client_call(TC_NS_ClientContext *client_context,
 					smc_cmd->started);
 			tee_ret = TC_NS_SMC_WITH_NO_NR(smc_cmd, flags);
 		}
+		tc_prof_call_mark(&prof, TC_PROF_SMC);
 		/* Client was interrupted, return and let it handle it's own
 		 * signals first then retry */
 		if (TEEC_CLIENT_INTR == tee_ret) {
@@ -765,6 +770,7 @@ int tc_client_call(TC_NS_ClientContext *client_context,
 		client_context->session_id = smc_cmd->context_id;
 	}
 
+	tc_prof_call_mark(&prof, TC_PROF_SMC);
 	/* wake_up tee log reader */
 	tz_log_write();
 
@@ -802,5 +808,8 @@ error:
 	if (operation)
 		free_operation(client_context, operation, local_temp_buffer);
 
+	tc_prof_call_mark(&prof, TC_PROF_UNMARSHAL);
+	tc_prof_call_end(&prof, client_context->uuid, global,
+			 client_context->cmd_id);
 	return ret;
 }
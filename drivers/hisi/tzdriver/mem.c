@@ -17,6 +17,9 @@
 #include <linux/freezer.h>
 #include <linux/module.h>
 #include <linux/mempool.h>
+#include <linux/spinlock.h>
+#include <linux/bitops.h>
+#include <linux/delay.h>
 
 #include "mem.h"
 #include "smc.h"
@@ -28,11 +31,145 @@
 
 #define ROUND_UP(N, S) ((((N) + (S) - 1) / (S)) * (S))
 
-static DEFINE_MUTEX(prealloc_lock);
+/* bit 0 set while g_mem_pre_allocated is handed out; it stays handed out
+ * until the shared mem is released, possibly from another task, so this
+ * can't be a mutex */
+static unsigned long prealloc_busy;
 /************global reference end*************/
 static void *g_mem_pre_allocated;
 static mempool_t *tc_sharemem_page_pool = NULL;
 
+/*
+ * Cache of free temp buffers for alloc_operation(), one stack of page
+ * blocks per size class, so a TEEC_MEMREF_TEMP_* param of at most 64K
+ * does not go to the page allocator on every call.
+ */
+struct temp_pool {
+	spinlock_t lock;
+	unsigned int order;
+	unsigned int nr;	/* free blocks in blocks[] */
+	unsigned int max;
+	void **blocks;
+};
+
+static struct temp_pool temp_pools[TEMP_POOL_CLASS_NR] = {
+	{ .lock = __SPIN_LOCK_UNLOCKED(temp_pools[0].lock), .order = 0, .max = 16 },
+	{ .lock = __SPIN_LOCK_UNLOCKED(temp_pools[1].lock), .order = 2, .max = 8 },
+	{ .lock = __SPIN_LOCK_UNLOCKED(temp_pools[2].lock), .order = 4, .max = 4 },
+};
+
+static struct temp_pool *temp_pool_of(size_t len)
+{
+	unsigned int order = get_order(ROUND_UP(len, SZ_4K));
+	int i;
+
+	for (i = 0; i < TEMP_POOL_CLASS_NR; i++) {
+		if (order <= temp_pools[i].order)
+			return &temp_pools[i];
+	}
+	return NULL;
+}
+
+/*
+ * tc_mem_temp_alloc - a buffer of at least len bytes for a temp param. The
+ * first len bytes are not cleared, the caller copies the input or zeroes
+ * the output part it hands to the secure world. The rest of the block is
+ * zeroed, the secure world maps whole pages and must not see what an
+ * earlier session left there.
+ */
+void *tc_mem_temp_alloc(size_t len)
+{
+	struct temp_pool *pool = temp_pool_of(len);
+	unsigned int order = pool ? pool->order :
+				get_order(ROUND_UP(len, SZ_4K));
+	void *buf = NULL;
+	unsigned long flags;
+
+	if (pool && pool->blocks) {
+		spin_lock_irqsave(&pool->lock, flags);
+		if (pool->nr)
+			buf = pool->blocks[--pool->nr];
+		spin_unlock_irqrestore(&pool->lock, flags);
+	}
+
+	if (!buf)
+		buf = (void *)__get_free_pages(GFP_KERNEL, order);
+	if (buf)
+		memset(buf + len, 0, (PAGE_SIZE << order) - len);
+
+	return buf;
+}
+
+/* tc_mem_temp_free - len must be the one given to tc_mem_temp_alloc */
+void tc_mem_temp_free(void *buf, size_t len)
+{
+	struct temp_pool *pool = temp_pool_of(len);
+	unsigned long flags;
+
+	if (!buf)
+		return;
+
+	if (pool && pool->blocks) {
+		spin_lock_irqsave(&pool->lock, flags);
+		if (pool->nr < pool->max) {
+			pool->blocks[pool->nr++] = buf;
+			buf = NULL;
+		}
+		spin_unlock_irqrestore(&pool->lock, flags);
+		if (!buf)
+			return;
+	}
+
+	free_pages((unsigned long)buf,
+		   pool ? pool->order : get_order(ROUND_UP(len, SZ_4K)));
+}
+
+static void temp_pool_init(void)
+{
+	struct temp_pool *pool;
+	void *buf;
+	int i;
+
+	for (i = 0; i < TEMP_POOL_CLASS_NR; i++) {
+		pool = &temp_pools[i];
+		pool->blocks = kcalloc(pool->max, sizeof(void *), GFP_KERNEL);
+		if (!pool->blocks) {
+			tloge("temp pool %d alloc failed\n", i);
+			continue;
+		}
+		/* a class left short is refilled by tc_mem_temp_free */
+		while (pool->nr < pool->max) {
+			buf = (void *)__get_free_pages(GFP_KERNEL, pool->order);
+			if (!buf)
+				break;
+			pool->blocks[pool->nr++] = buf;
+		}
+	}
+}
+
+static void temp_pool_destroy(void)
+{
+	struct temp_pool *pool;
+	void **blocks;
+	unsigned int nr;
+	unsigned long flags;
+	int i;
+
+	for (i = 0; i < TEMP_POOL_CLASS_NR; i++) {
+		pool = &temp_pools[i];
+		spin_lock_irqsave(&pool->lock, flags);
+		blocks = pool->blocks;
+		nr = pool->nr;
+		pool->blocks = NULL;
+		pool->nr = 0;
+		spin_unlock_irqrestore(&pool->lock, flags);
+
+		while (nr)
+			free_pages((unsigned long)blocks[--nr], pool->order);
+		kfree(blocks);
+	}
+}
+
 void tc_mem_free(TC_NS_Shared_MEM *shared_mem)
 {
 	if (NULL == shared_mem)
@@ -45,7 +182,7 @@ void tc_mem_free(TC_NS_Shared_MEM *shared_mem)
 		free_pages((unsigned long)shared_mem->kernel_addr,
 			   get_order(ROUND_UP(shared_mem->len, SZ_4K))); /*lint !e647 !e866 !e747 !e647  !e834 !e732*/
 	} else if (shared_mem->kernel_addr == g_mem_pre_allocated) {
-		mutex_unlock(&prealloc_lock);
+		clear_bit_unlock(0, &prealloc_busy);
 	} else {
 	    tloge("failed to release the memory pages of share mem!\n");
 	}
@@ -80,7 +217,7 @@ TC_NS_Shared_MEM *tc_mem_allocate(TC_NS_DEV_File *dev, size_t len)
 	}
 	if (!addr) {
 		tlogw("get free pages from mempool also failed, try pre allocted mem, len is %zx\n", len);
-		if (mutex_trylock(&prealloc_lock)) {
+		if (!test_and_set_bit_lock(0, &prealloc_busy)) {
 			if (g_mem_pre_allocated && (len <= PRE_ALLOCATE_SIZE)) {
 				tlogd("use pre allocted mem to work\n");
 				if(memset_s(g_mem_pre_allocated, PRE_ALLOCATE_SIZE, 0, PRE_ALLOCATE_SIZE)) {
@@ -88,9 +225,9 @@ TC_NS_Shared_MEM *tc_mem_allocate(TC_NS_DEV_File *dev, size_t len)
 				}
 				addr = g_mem_pre_allocated;
 				/* In case we could not use the preallocated
-				 * memory unlock the mutex */
+				 * memory release it */
 			} else
-				mutex_unlock(&prealloc_lock);
+				clear_bit_unlock(0, &prealloc_busy);
 		}
 		/* If we couldn't use the preallocated memory then return */
 		if (!addr) {
@@ -120,6 +257,7 @@ int tc_mem_init(void)
 				   GFP_KERNEL | __GFP_ZERO, NUMA_NO_NODE);
       if (!tc_sharemem_page_pool)
 		tloge("tc_sharemem_page_pool failed\n");
+	temp_pool_init();
 
 	return 0;
 }
@@ -127,7 +265,9 @@ int tc_mem_init(void)
 void tc_mem_destroy(void)
 {
 	tlogi("tc_client exit\n");
-	mutex_lock(&prealloc_lock);
+	temp_pool_destroy();
+	while (test_and_set_bit_lock(0, &prealloc_busy))
+		msleep(1);
 
 	if (g_mem_pre_allocated) {
 		free_pages((unsigned long)g_mem_pre_allocated, /*lint !e778 !e866 !e747 !e732*/
@@ -138,5 +278,5 @@ void tc_mem_destroy(void)
 		mempool_destroy(tc_sharemem_page_pool);
 		tc_sharemem_page_pool = NULL;
 	}
-	mutex_unlock(&prealloc_lock);
+	clear_bit_unlock(0, &prealloc_busy);
 }
@@ -10,12 +10,19 @@
 #define MEM_POOL_ELEMENT_NR (8)
 #define MEM_POOL_ELEMENT_ORDER (4)
 
+/* size classes of the operation temp buffer cache: 4K, 16K, 64K */
+#define TEMP_POOL_CLASS_NR (3)
+#define TEMP_POOL_MAX_ORDER (4)
+
 int tc_mem_init(void);
 void tc_mem_destroy(void);
 
 TC_NS_Shared_MEM *tc_mem_allocate(TC_NS_DEV_File *dev, size_t len);
 void tc_mem_free(TC_NS_Shared_MEM *shared_mem);
 
+void *tc_mem_temp_alloc(size_t len);
+void tc_mem_temp_free(void *buf, size_t len);
+
 static inline void get_sharemem_struct(struct tag_TC_NS_Shared_MEM *sharemem)
 {
 	if (sharemem)
@@ -33,6 +33,7 @@
 #include "teek_ns_client.h"
 
 #include "tlogger.h"
+#include "tc_profile.h"
 /*lint -save -e750 -e529*/
 
 #define MAX_EMPTY_RUNS		100
@@ -56,20 +57,16 @@ struct wait_entry {
 	uint32_t event_nr;
 	TC_NS_SMC_CMD *cmd;
 	struct completion done;
+	u64 done_ns;
 };
 
 struct smc_work {
-	struct kthread_work kthwork;
 	struct work_struct work;
 	TC_NS_SMC_CMD *cmd;
-	struct wait_entry *we;
 	uint32_t cmd_type;
 	unsigned int cmd_ret;
 };
 
-static struct task_struct *cmd_work_thread;
-static DEFINE_KTHREAD_WORKER(cmd_worker);
-
 static struct task_struct *smc_thread;
 static struct task_struct *siq_thread;
 
@@ -84,6 +81,8 @@ typedef struct __attribute__ ((__packed__)) TC_NS_SMC_QUEUE {
 
 /* tzdriver's own queue pointer */
 static uint32_t last_in, last_out;
+/* callers fill the in queue themselves, serialized by this lock */
+static DEFINE_SPINLOCK(cmd_in_lock);
 
 TC_NS_SMC_QUEUE *cmd_data;
 phys_addr_t cmd_phys;
@@ -162,6 +161,7 @@ static int smc_thread_fn(void *arg)
 		/* Start running TrustedCore becasue
 		 * we have a incoming command */
 		ret = TSP_REQUEST;
+		tc_prof_queue_run();
 		if (i % 10 == 0 && atomic_read(&outstading_cmds) > 1)
 			smc_send(TSP_REE_SIQ, 0, 0, false);
 		else
@@ -257,8 +257,10 @@ static int smc_thread_fn(void *arg)
 					tlogd("LOST EVENT!\n");
 					kfree(we);
 					atomic_dec(&outstading_cmds);
-				} else
+				} else {
+					we->done_ns = tc_prof_now();
 					complete(&we->done);
+				}
 			} else {
 				tlogd("LOST EVENT id =%u!!!\n", cmd.event_nr);
 			}
@@ -351,13 +353,20 @@ static void smc_work_no_wait(struct work_struct *work)
 	smc_send(TSP_REQUEST, cmd_phys, s_work->cmd_type, true);
 }
 
-static void smc_work_func(struct kthread_work *work)
+/*
+ * Put a command in the in queue and kick the smc thread. Each caller does
+ * it from its own context: concurrent sessions only meet on cmd_in_lock
+ * instead of queueing behind one worker thread, and commands of one
+ * session, serialized by its ta_session_lock, stay in order.
+ */
+static void smc_enqueue_cmd(TC_NS_SMC_CMD *cmd)
 {
-	struct smc_work *s_work = container_of(work, struct smc_work, kthwork);
+	unsigned long flags;
 
+	spin_lock_irqsave(&cmd_in_lock, flags);
 	if (EOK != memcpy_s(&cmd_data->in[last_in],
 				sizeof(TC_NS_SMC_CMD),
-				s_work->cmd,
+				cmd,
 				sizeof(TC_NS_SMC_CMD)))
 		tloge("memcpy_s failed,%s line:%d", __func__, __LINE__);
 	isb();
@@ -367,11 +376,13 @@ static void smc_work_func(struct kthread_work *work)
 	cmd_data->last_in = last_in;
 	isb();
 	wmb();
+	spin_unlock_irqrestore(&cmd_in_lock, flags);
+	tc_prof_queue_stamp();
 
-	tlogd("***smc_work_func in %d %d ***\n", last_in, cmd_data->last_in);
+	tlogd("***smc_enqueue_cmd in %d %d ***\n", last_in, cmd_data->last_in);
 	tc_smc_wakeup();
 
-	tlogd("***smc_work_func out %d %d ***\n", last_out,
+	tlogd("***smc_enqueue_cmd out %d %d ***\n", last_out,
 		cmd_data->last_out);
 }
 
@@ -380,12 +391,6 @@ static unsigned int smc_send_func(TC_NS_SMC_CMD *cmd, uint32_t cmd_type,
 {
 
 	struct wait_entry *we = kmalloc(sizeof(struct wait_entry), GFP_KERNEL);
-	struct smc_work work = {
-		KTHREAD_WORK_INIT(work.kthwork, smc_work_func),
-		.cmd = cmd,
-		.cmd_type = cmd_type,
-		.we = we,
-	};
 
 	if (we == NULL) {
 		tloge("failed to malloc memory!\n");
@@ -399,6 +404,7 @@ static unsigned int smc_send_func(TC_NS_SMC_CMD *cmd, uint32_t cmd_type,
 
 	we->event_nr = cmd->event_nr;
 	we->cmd = cmd;
+	we->done_ns = 0;
 	init_completion(&we->done);
 	INIT_LIST_HEAD(&we->list);
 
@@ -407,21 +413,15 @@ static unsigned int smc_send_func(TC_NS_SMC_CMD *cmd, uint32_t cmd_type,
 	atomic_inc(&outstading_cmds);
 	mutex_unlock(&wait_th_lock);
 
-	if (!queue_kthread_work(&cmd_worker, &work.kthwork)) {
-		kfree(we);
-		return (unsigned int)TEEC_ERROR_GENERIC;
-
-	}
+	smc_enqueue_cmd(cmd);
 
 	tlogd("***wait_thr_add waiting for completion %u ***\n",
 		cmd->event_nr);
-	/* We need to make sure the flush the work so
-	 * it has made it all the way to the smc thread! */
-	flush_kthread_work(&work.kthwork);
 	/* In sync mode we don't return till we get an answer */
 	wait_for_completion(&we->done);
 	tlogd("***smc_send_func wait for complete done %d***\n",
 		cmd->event_nr);
+	tc_prof_since(TC_PROF_WAKE, we->done_ns);
 	atomic_dec(&outstading_cmds);
 
 	/* We only free it if we actually finished it! */
@@ -631,12 +631,6 @@ unlock:
 
 unsigned int TC_NS_POST_SMC(TC_NS_SMC_CMD *cmd)
 {
-	struct smc_work work = {
-		KTHREAD_WORK_INIT(work.kthwork, smc_work_func),
-		.cmd = cmd,
-		.cmd_type = TC_NS_CMD_TYPE_NS_TO_SECURE,
-		.we = NULL
-	};
 	if (sys_crash)
 		return TEEC_ERROR_GENERIC;
 
@@ -646,12 +640,7 @@ unsigned int TC_NS_POST_SMC(TC_NS_SMC_CMD *cmd)
 	}
 
 	atomic_inc(&outstading_cmds);
-	if (!queue_kthread_work(&cmd_worker, &work.kthwork))
-		return TEEC_ERROR_GENERIC;
-
-	/* We need to make sure the flush the work
-	 * so it has made it all the way to the smc thread! */
-	flush_kthread_work(&work.kthwork);
+	smc_enqueue_cmd(cmd);
 	tlogd("Command posted %u\n", cmd->event_nr);
 
 	return TEEC_SUCCESS;
@@ -740,25 +729,11 @@ int smc_init_data(struct device *class_dev)
 
 	kthread_bind(siq_thread, 0);
 
-	cmd_work_thread =
-	    kthread_create(kthread_worker_fn, &cmd_worker, "tcwork");
-	if (IS_ERR(cmd_work_thread)) {
-		dev_err(class_dev, "couldn't create cmd_work_threads %ld\n",
-			PTR_ERR(cmd_work_thread));
-		ret = (int)PTR_ERR(cmd_work_thread);
-		goto free_siq_worker;
-	}
-
-	wake_up_process(cmd_work_thread);
 	wake_up_process(smc_thread);
 	wake_up_process(siq_thread);
 
 	return 0;
 
-free_siq_worker:
-	kthread_stop(siq_thread);
-	siq_thread = NULL;
-
 free_smc_worker:
 	kthread_stop(smc_thread);
 	smc_thread = NULL;
@@ -802,10 +777,6 @@ void smc_free_data(void)
 {
 	free_page((unsigned long)cmd_data);
 
-	if (!IS_ERR_OR_NULL(cmd_work_thread)) {
-		kthread_stop(cmd_work_thread);
-		cmd_work_thread = NULL;
-	}
 	if (!IS_ERR_OR_NULL(smc_thread)) {
 		kthread_stop(smc_thread);
 		smc_thread = NULL;
@@ -75,6 +75,7 @@
 #include "libhwsecurec/securec.h"
 #include "tck_authentication.h"
 #include "tc_ns_log.h"
+#include "tc_profile.h"
 
 #include <linux/namei.h>
 
@@ -2440,6 +2441,8 @@ static __init int tc_init(void)
 	if (tc_mem_init())
 		goto free_agent;
 
+	tc_prof_init();
+
 	ret = TC_NS_register_rdr_mem();
 	if (ret)
 		TCERR("TC_NS_register_rdr_mem failed %x\n", ret);
@@ -2520,6 +2523,7 @@ free_notify_mem:
 	free_page((unsigned long)g_notify_data);
 	g_notify_data = NULL;
 free_shared_mem:
+	tc_prof_exit();
 	tc_mem_destroy();
 free_agent:
 	agent_exit();
@@ -2553,6 +2557,7 @@ static void tc_exit(void)
 
 	agent_exit();
 	tc_mem_destroy();
+	tc_prof_exit();
 
 	if (drm_ion_client) {
 		ion_client_destroy(drm_ion_client);
@@ -0,0 +1,342 @@
+/*******************************************************************************
+ * All rights reserved, Copyright (C) huawei LIMITED 2012
+ *
+ * This source code has been made available to you by HUAWEI on an
+ * AS-IS basis. Anyone receiving this source code is licensed under HUAWEI
+ * copyrights to use it in any way he or she deems fit, including copying it,
+ * modifying it, compiling it, and redistributing it either with or without
+ * modifications. Any person who transfers this source code or any derivative
+ * work must include the HUAWEI copyright notice and this paragraph in
+ * the transferred software.
+*******************************************************************************/
+/*
+ * TEE call latency profiler.
+ *
+ * Each tc_client_call() is split in marshalling, smc (queued, running in
+ * the secure world, pending on other sessions or agents) and unmarshalling,
+ * and accounted to its TA uuid and command id. The queueing delay to the
+ * smc thread and the wakeup delay of the caller are accounted driver wide,
+ * the agent round trips per agent id.
+ *
+ * Histograms are log2 of the latency in us: bucket n counts latencies of
+ * [2^(n-1), 2^n) us, bucket 0 those below 1us, the last one all above.
+ *
+ * debugfs tzdriver/call_profile shows everything, a write resets it.
+ * tc_prof_dump() prints a summary to the kernel log, from the tlogger.
+ */
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/atomic.h>
+#include <linux/bitops.h>
+#include <linux/math64.h>
+
+#include "securec.h"
+#include "tc_ns_log.h"
+#include "tc_profile.h"
+
+#define TC_PROF_BUCKETS		20
+#define TC_PROF_MAX_TA		64
+#define TC_PROF_MAX_AGENT	8
+#define TC_PROF_UUID_LEN	16
+
+struct tc_prof_hist {
+	u64 count;
+	u64 sum_ns;
+	u64 max_ns;
+	u32 bucket[TC_PROF_BUCKETS];
+};
+
+struct tc_prof_ta {
+	unsigned char uuid[TC_PROF_UUID_LEN];
+	unsigned int cmd_id;
+	bool global;
+	bool used;
+	struct tc_prof_hist phase[TC_PROF_PHASE_MAX];
+};
+
+struct tc_prof_agent {
+	unsigned int agent_id;
+	struct tc_prof_hist rtt;
+};
+
+static DEFINE_SPINLOCK(tc_prof_lock);
+static struct tc_prof_ta tc_prof_tas[TC_PROF_MAX_TA];
+static unsigned int tc_prof_ta_dropped;	/* calls of TAs over the table */
+static struct tc_prof_hist tc_prof_global[TC_PROF_GLOBAL_MAX];
+static struct tc_prof_agent tc_prof_agents[TC_PROF_MAX_AGENT];
+static atomic64_t tc_prof_queued_ns;	/* oldest command not seen yet */
+static struct dentry *tc_prof_dir;
+
+static const char * const tc_prof_phase_name[TC_PROF_PHASE_MAX] = {
+	"marshal", "smc", "unmarshal", "total",
+};
+
+static const char * const tc_prof_global_name[TC_PROF_GLOBAL_MAX] = {
+	"queue", "wake",
+};
+
+static void tc_prof_hist_add(struct tc_prof_hist *h, u64 ns)
+{
+	u64 us = div_u64(ns, NSEC_PER_USEC);
+	unsigned int b = us ? fls64(us) : 0;
+
+	if (b >= TC_PROF_BUCKETS)
+		b = TC_PROF_BUCKETS - 1;
+	h->bucket[b]++;
+	h->count++;
+	h->sum_ns += ns;
+	if (ns > h->max_ns)
+		h->max_ns = ns;
+}
+
+/* called with tc_prof_lock held */
+static struct tc_prof_ta *tc_prof_find_ta(const unsigned char *uuid,
+					  bool global, unsigned int cmd_id)
+{
+	struct tc_prof_ta *ta;
+	int i;
+
+	for (i = 0; i < TC_PROF_MAX_TA; i++) {
+		ta = &tc_prof_tas[i];
+		if (!ta->used) {
+			ta->used = true;
+			ta->global = global;
+			ta->cmd_id = cmd_id;
+			if (EOK != memcpy_s(ta->uuid, sizeof(ta->uuid),
+					    uuid, TC_PROF_UUID_LEN))
+				tloge("memcpy_s failed,%s line:%d",
+				      __func__, __LINE__);
+			return ta;
+		}
+		if (ta->cmd_id == cmd_id && ta->global == global &&
+		    !memcmp(ta->uuid, uuid, TC_PROF_UUID_LEN))
+			return ta;
+	}
+
+	return NULL;
+}
+
+void tc_prof_call_end(struct tc_prof_call *c, const unsigned char *uuid,
+		      bool global, unsigned int cmd_id)
+{
+	struct tc_prof_ta *ta;
+	unsigned long flags;
+	int i;
+
+	c->phase_ns[TC_PROF_TOTAL] = tc_prof_now() - c->start_ns;
+
+	spin_lock_irqsave(&tc_prof_lock, flags);
+	ta = tc_prof_find_ta(uuid, global, cmd_id);
+	if (ta) {
+		for (i = 0; i < TC_PROF_PHASE_MAX; i++)
+			tc_prof_hist_add(&ta->phase[i], c->phase_ns[i]);
+	} else {
+		tc_prof_ta_dropped++;
+	}
+	spin_unlock_irqrestore(&tc_prof_lock, flags);
+}
+
+void tc_prof_since(enum tc_prof_global which, u64 start_ns)
+{
+	unsigned long flags;
+
+	if (!start_ns)
+		return;
+
+	spin_lock_irqsave(&tc_prof_lock, flags);
+	tc_prof_hist_add(&tc_prof_global[which], tc_prof_now() - start_ns);
+	spin_unlock_irqrestore(&tc_prof_lock, flags);
+}
+
+/* a command was queued: keep the time of the oldest one not seen yet */
+void tc_prof_queue_stamp(void)
+{
+	atomic64_cmpxchg(&tc_prof_queued_ns, 0, tc_prof_now());
+}
+
+/* the smc thread is about to enter the secure world */
+void tc_prof_queue_run(void)
+{
+	tc_prof_since(TC_PROF_QUEUE, atomic64_xchg(&tc_prof_queued_ns, 0));
+}
+
+void tc_prof_agent(unsigned int agent_id, u64 start_ns)
+{
+	struct tc_prof_agent *agent = NULL;
+	unsigned long flags;
+	int i;
+
+	if (!start_ns)
+		return;
+
+	spin_lock_irqsave(&tc_prof_lock, flags);
+	for (i = 0; i < TC_PROF_MAX_AGENT; i++) {
+		if (!tc_prof_agents[i].rtt.count ||
+		    tc_prof_agents[i].agent_id == agent_id) {
+			agent = &tc_prof_agents[i];
+			break;
+		}
+	}
+	if (agent) {
+		agent->agent_id = agent_id;
+		tc_prof_hist_add(&agent->rtt, tc_prof_now() - start_ns);
+	}
+	spin_unlock_irqrestore(&tc_prof_lock, flags);
+}
+
+static u64 tc_prof_avg_us(const struct tc_prof_hist *h)
+{
+	return h->count ? div64_u64(h->sum_ns, h->count * NSEC_PER_USEC) : 0;
+}
+
+static void tc_prof_show_hist(struct seq_file *m, const char *name,
+			      const struct tc_prof_hist *h)
+{
+	int i;
+
+	seq_printf(m, "  %-10s n %llu avg %lluus max %lluus |", name, h->count,
+		   tc_prof_avg_us(h), div_u64(h->max_ns, NSEC_PER_USEC));
+	for (i = 0; i < TC_PROF_BUCKETS; i++)
+		seq_printf(m, " %u", h->bucket[i]);
+	seq_puts(m, "\n");
+}
+
+static int tc_prof_show(struct seq_file *m, void *v)
+{
+	struct tc_prof_ta *tas;
+	struct tc_prof_hist global[TC_PROF_GLOBAL_MAX];
+	struct tc_prof_agent agents[TC_PROF_MAX_AGENT];
+	unsigned int dropped;
+	unsigned long flags;
+	int i, j;
+
+	tas = kmalloc(sizeof(tc_prof_tas), GFP_KERNEL);
+	if (!tas)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&tc_prof_lock, flags);
+	memcpy(tas, tc_prof_tas, sizeof(tc_prof_tas));
+	memcpy(global, tc_prof_global, sizeof(global));
+	memcpy(agents, tc_prof_agents, sizeof(agents));
+	dropped = tc_prof_ta_dropped;
+	spin_unlock_irqrestore(&tc_prof_lock, flags);
+
+	seq_printf(m, "buckets: log2(us), %d\n", TC_PROF_BUCKETS);
+	for (i = 0; i < TC_PROF_GLOBAL_MAX; i++)
+		tc_prof_show_hist(m, tc_prof_global_name[i], &global[i]);
+
+	for (i = 0; i < TC_PROF_MAX_AGENT && agents[i].rtt.count; i++) {
+		seq_printf(m, "agent 0x%x\n", agents[i].agent_id);
+		tc_prof_show_hist(m, "roundtrip", &agents[i].rtt);
+	}
+
+	for (i = 0; i < TC_PROF_MAX_TA && tas[i].used; i++) {
+		seq_printf(m, "ta %pUb%s cmd 0x%x\n", tas[i].uuid,
+			   tas[i].global ? " global" : "", tas[i].cmd_id);
+		for (j = 0; j < TC_PROF_PHASE_MAX; j++)
+			tc_prof_show_hist(m, tc_prof_phase_name[j],
+					  &tas[i].phase[j]);
+	}
+	seq_printf(m, "dropped %u\n", dropped);
+
+	kfree(tas);
+	return 0;
+}
+
+static int tc_prof_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tc_prof_show, NULL);
+}
+
+static ssize_t tc_prof_write(struct file *file, const char __user *buf,
+			     size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&tc_prof_lock, flags);
+	memset(tc_prof_tas, 0, sizeof(tc_prof_tas));
+	memset(tc_prof_global, 0, sizeof(tc_prof_global));
+	memset(tc_prof_agents, 0, sizeof(tc_prof_agents));
+	tc_prof_ta_dropped = 0;
+	spin_unlock_irqrestore(&tc_prof_lock, flags);
+
+	return count;
+}
+
+static const struct file_operations tc_prof_fops = {
+	.open = tc_prof_open,
+	.read = seq_read,
+	.write = tc_prof_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/*
+ * tc_prof_dump - print, for every TA command seen, the count and the
+ * average and worst total latency, and the agent round trips.
+ */
+void tc_prof_dump(void)
+{
+	struct tc_prof_ta *ta;
+	struct tc_prof_hist total, rtt;
+	unsigned char uuid[TC_PROF_UUID_LEN];
+	unsigned int cmd_id, agent_id;
+	unsigned long flags;
+	int i;
+
+	tlogi("tee call profile: queue avg %lluus wake avg %lluus\n",
+	      tc_prof_avg_us(&tc_prof_global[TC_PROF_QUEUE]),
+	      tc_prof_avg_us(&tc_prof_global[TC_PROF_WAKE]));
+
+	for (i = 0; i < TC_PROF_MAX_AGENT; i++) {
+		spin_lock_irqsave(&tc_prof_lock, flags);
+		agent_id = tc_prof_agents[i].agent_id;
+		rtt = tc_prof_agents[i].rtt;
+		spin_unlock_irqrestore(&tc_prof_lock, flags);
+		if (!rtt.count)
+			break;
+		tlogi("agent 0x%x n %llu avg %lluus max %lluus\n", agent_id,
+		      rtt.count, tc_prof_avg_us(&rtt),
+		      div_u64(rtt.max_ns, NSEC_PER_USEC));
+	}
+
+	for (i = 0; i < TC_PROF_MAX_TA; i++) {
+		ta = &tc_prof_tas[i];
+		spin_lock_irqsave(&tc_prof_lock, flags);
+		if (!ta->used) {
+			spin_unlock_irqrestore(&tc_prof_lock, flags);
+			break;
+		}
+		memcpy(uuid, ta->uuid, sizeof(uuid));
+		cmd_id = ta->cmd_id;
+		total = ta->phase[TC_PROF_TOTAL];
+		spin_unlock_irqrestore(&tc_prof_lock, flags);
+
+		tlogi("ta %pUb cmd 0x%x n %llu avg %lluus max %lluus\n", uuid,
+		      cmd_id, total.count, tc_prof_avg_us(&total),
+		      div_u64(total.max_ns, NSEC_PER_USEC));
+	}
+}
+
+int tc_prof_init(void)
+{
+	tc_prof_dir = debugfs_create_dir("tzdriver", NULL);
+	if (IS_ERR_OR_NULL(tc_prof_dir)) {
+		tloge("tzdriver debugfs create failed\n");
+		tc_prof_dir = NULL;
+		return 0;
+	}
+
+	debugfs_create_file("call_profile", 0640, tc_prof_dir, NULL,
+			    &tc_prof_fops);
+	return 0;
+}
+
+void tc_prof_exit(void)
+{
+	debugfs_remove_recursive(tc_prof_dir);
+	tc_prof_dir = NULL;
+}
@@ -0,0 +1,111 @@
+#ifndef _TC_PROFILE_H_
+#define _TC_PROFILE_H_
+
+#include <linux/types.h>
+#include <linux/ktime.h>
+
+/* phases of one tc_client_call(), recorded per TA and command */
+enum tc_prof_phase {
+	TC_PROF_MARSHAL = 0,	/* alloc_operation */
+	TC_PROF_SMC,		/* queued, in the secure world, pending */
+	TC_PROF_UNMARSHAL,	/* update_client_operation, free_operation */
+	TC_PROF_TOTAL,
+	TC_PROF_PHASE_MAX,
+};
+
+/* driver wide latencies, not attributable to one call */
+enum tc_prof_global {
+	TC_PROF_QUEUE = 0,	/* command queued until the smc thread runs */
+	TC_PROF_WAKE,		/* answer completed until the caller runs */
+	TC_PROF_GLOBAL_MAX,
+};
+
+struct tc_prof_call {
+	u64 start_ns;
+	u64 mark_ns;
+	u64 phase_ns[TC_PROF_PHASE_MAX];
+};
+
+#ifdef CONFIG_TEE_CALL_PROFILE
+static inline u64 tc_prof_now(void)
+{
+	return ktime_to_ns(ktime_get());
+}
+
+static inline void tc_prof_call_start(struct tc_prof_call *c)
+{
+	c->start_ns = tc_prof_now();
+	c->mark_ns = c->start_ns;
+}
+
+/* account the time since the previous mark to 'phase' */
+static inline void tc_prof_call_mark(struct tc_prof_call *c,
+				     enum tc_prof_phase phase)
+{
+	u64 now = tc_prof_now();
+
+	c->phase_ns[phase] += now - c->mark_ns;
+	c->mark_ns = now;
+}
+
+void tc_prof_call_end(struct tc_prof_call *c, const unsigned char *uuid,
+		      bool global, unsigned int cmd_id);
+void tc_prof_since(enum tc_prof_global which, u64 start_ns);
+void tc_prof_queue_stamp(void);
+void tc_prof_queue_run(void);
+void tc_prof_agent(unsigned int agent_id, u64 start_ns);
+void tc_prof_dump(void);
+int tc_prof_init(void);
+void tc_prof_exit(void);
+#else
+static inline u64 tc_prof_now(void)
+{
+	return 0;
+}
+
+static inline void tc_prof_call_start(struct tc_prof_call *c)
+{
+}
+
+static inline void tc_prof_call_mark(struct tc_prof_call *c,
+				     enum tc_prof_phase phase)
+{
+}
+
+static inline void tc_prof_call_end(struct tc_prof_call *c,
+				    const unsigned char *uuid,
+				    bool global, unsigned int cmd_id)
+{
+}
+
+static inline void tc_prof_since(enum tc_prof_global which, u64 start_ns)
+{
+}
+
+static inline void tc_prof_queue_stamp(void)
+{
+}
+
+static inline void tc_prof_queue_run(void)
+{
+}
+
+static inline void tc_prof_agent(unsigned int agent_id, u64 start_ns)
+{
+}
+
+static inline void tc_prof_dump(void)
+{
+}
+
+static inline int tc_prof_init(void)
+{
+	return 0;
+}
+
+static inline void tc_prof_exit(void)
+{
+}
+#endif
+
+#endif
@@ -24,6 +24,7 @@
 #include "tee_rdr_register.h"
 #include <securec.h>
 #include "tc_ns_log.h"
+#include "tc_profile.h"
 
 static char *m_log_buffer;
 static size_t m_addr_start;
@@ -42,6 +43,8 @@ static size_t m_addr_end;
 #define TEELOGGER_GET_LOG_SIZE		_IO(__TEELOGGERIO, 3)
 /* get the TEE memory status */
 #define TEELOGGER_GET_MEMORY_STATUS		_IO(__TEELOGGERIO, 4)
+/* print the TEE call latency profile to the kernel log */
+#define TEELOGGER_DUMP_CALL_PROFILE		_IO(__TEELOGGERIO, 5)
 
 #define LOG_PATH_HISI_LOGS	"/data/hisi_logs/"
 #define LOG_PATH_RUNNING_TRACE	"/data/hisi_logs/running_trace/"
@@ -483,6 +486,10 @@ static long tlogger_ioctl(struct file *file, unsigned int cmd,
 	case TEELOGGER_GET_MEMORY_STATUS:
 		ret = log->size;
 		break;
+	case TEELOGGER_DUMP_CALL_PROFILE:
+		tc_prof_dump();
+		ret = 0;
+		break;
 	default:
 		tloge("ioctl error default\n");
 		break;
@@ -650,6 +657,9 @@ int tlogger_store_lastmsg(void)
 		return -1;
 	}
 
+	/* the slowest TAs are often the ones to look at after a crash */
+	tc_prof_dump();
+
 	/*exception handling, store trustedcore exception info to file */
 	filep = filp_open(LOG_PATH_TEE_LOG_FILE, O_CREAT | O_RDWR, 0640);
 	if (IS_ERR(filep)) {
@@ -20,6 +20,8 @@
 #include <linux/i2c.h>
 #include <linux/reboot.h>
 #include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
 #include "protocol.h"
 #include "inputhub_route.h"
 #include "inputhub_bridge.h"
@@ -66,6 +68,7 @@
 #define SENSOR_DSM_CONFIG
 #endif
 #define ROUTE_BUFFER_MAX_SIZE (1024 * 128)
+#define ROUTE_WAKE_LATENCY_MAX_MS (60 * 1000)
 #ifdef TIMESTAMP_SIZE
 #undef TIMESTAMP_SIZE
 #define TIMESTAMP_SIZE (8)
@@ -193,6 +196,10 @@ struct inputhub_route_table {
 	wait_queue_head_t read_wait;	/*to block read when no data in buffer*/
 	atomic_t data_ready;
 	spinlock_t buffer_spin_lock;	/*for read write buffer*/
+	struct shb_mmap_ctrl *mmap_ctrl;	/*read position seen by mmap readers*/
+	unsigned int wake_latency_ms;	/*0: wake the reader on every event*/
+	unsigned int wake_watermark;	/*unread bytes that wake it at once*/
+	struct timer_list wake_timer;	/*deferred wakeup*/
 };
 
 static struct inputhub_route_table package_route_tbl[] = {
@@ -321,6 +328,61 @@ static int inputhub_route_item(unsigned short port,
 
 }
 
+static void route_wake_timeout(unsigned long data)
+{
+	struct inputhub_route_table *route_item =
+	    (struct inputhub_route_table *)data;
+
+	wake_up_interruptible(&route_item->read_wait);
+}
+
+/*
+ * Wake the reader of a batched event now, or within its latency budget
+ * when it declared one: at once if 'urgent' or 'unread' bytes reach the
+ * watermark, else when the timer armed by the first deferred event fires.
+ */
+static void route_wake_reader(struct inputhub_route_table *route_item,
+			      unsigned int unread, bool urgent)
+{
+	unsigned int latency_ms = ACCESS_ONCE(route_item->wake_latency_ms);
+
+	if (urgent || !latency_ms || unread >= route_item->wake_watermark) {
+		del_timer(&route_item->wake_timer);
+		wake_up_interruptible(&route_item->read_wait);
+		return;
+	}
+
+	if (!timer_pending(&route_item->wake_timer))
+		mod_timer(&route_item->wake_timer,
+			  jiffies + msecs_to_jiffies(latency_ms));
+}
+
+int inputhub_route_set_wake_latency(unsigned short port,
+				    unsigned int latency_ms,
+				    unsigned int watermark)
+{
+	struct inputhub_route_table *route_item;
+
+	if (inputhub_route_item(port, &route_item) != 0)
+		return -EINVAL;
+
+	if (!route_item->phead.pos || latency_ms > ROUTE_WAKE_LATENCY_MAX_MS
+	    || watermark > ROUTE_BUFFER_MAX_SIZE)
+		return -EINVAL;
+
+	route_item->wake_watermark =
+	    watermark ? watermark : ROUTE_BUFFER_MAX_SIZE / 2;
+	route_item->wake_latency_ms = latency_ms;
+	hwlog_info("port %d wake latency %u ms watermark %u\n", (int)port,
+		   latency_ms, route_item->wake_watermark);
+
+	/*what was deferred under the old budget is delivered now*/
+	del_timer_sync(&route_item->wake_timer);
+	wake_up_interruptible(&route_item->read_wait);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(inputhub_route_set_wake_latency);
+
 int inputhub_route_open(unsigned short port)
 {
 	int ret;
@@ -338,10 +400,24 @@ int inputhub_route_open(unsigned short port)
 		return -EINVAL;
 	}
 
-	pos = kzalloc(ROUTE_BUFFER_MAX_SIZE, GFP_KERNEL);
+	/*whole pages, so that the buffer can be mapped to mmap readers*/
+	pos = (char *)__get_free_pages(GFP_KERNEL | __GFP_ZERO,
+				       get_order(ROUTE_BUFFER_MAX_SIZE));
 	if (!pos)
 		return -ENOMEM;
 
+	route_item->mmap_ctrl = (struct shb_mmap_ctrl *)get_zeroed_page(GFP_KERNEL);
+	if (!route_item->mmap_ctrl) {
+		free_pages((unsigned long)pos, get_order(ROUTE_BUFFER_MAX_SIZE));
+		return -ENOMEM;
+	}
+	route_item->mmap_ctrl->ring_size = ROUTE_BUFFER_MAX_SIZE;
+
+	route_item->wake_latency_ms = 0;
+	route_item->wake_watermark = ROUTE_BUFFER_MAX_SIZE / 2;
+	setup_timer(&route_item->wake_timer, route_wake_timeout,
+		    (unsigned long)route_item);
+
 	route_item->phead.pos = pos;
 	route_item->pWrite.pos = pos;
 	route_item->pRead.pos = pos;
@@ -364,9 +440,15 @@ void inputhub_route_close(unsigned short port)
 	if (ret < 0)
 		return;
 
-	if (route_item->phead.pos)
-		kfree(route_item->phead.pos);
+	if (route_item->phead.pos) {
+		del_timer_sync(&route_item->wake_timer);
+		free_pages((unsigned long)route_item->phead.pos,
+			   get_order(ROUTE_BUFFER_MAX_SIZE));
+	}
+	if (route_item->mmap_ctrl)
+		free_page((unsigned long)route_item->mmap_ctrl);
 
+	route_item->mmap_ctrl = NULL;
 	route_item->phead.pos = NULL;
 	route_item->pWrite.pos = NULL;
 	route_item->pRead.pos = NULL;
@@ -374,6 +456,22 @@ void inputhub_route_close(unsigned short port)
 
 EXPORT_SYMBOL_GPL(inputhub_route_close);
 
+/*publish the read position to mmap readers, with buffer_spin_lock held*/
+static void route_mmap_update(struct inputhub_route_table *route_item)
+{
+	struct shb_mmap_ctrl *ctrl = route_item->mmap_ctrl;
+
+	if (!ctrl)
+		return;
+
+	ctrl->seq++;
+	smp_wmb();
+	ctrl->read_off = route_item->pRead.pos - route_item->phead.pos;
+	ctrl->avail = route_item->pRead.buffer_size;
+	smp_wmb();
+	ctrl->seq++;
+}
+
 static inline bool data_ready(struct inputhub_route_table *route_item,
 			      struct inputhub_buffer_pos *reader)
 {
@@ -478,6 +576,7 @@ ssize_t inputhub_route_read(unsigned short port, char __user *buf,
 		route_item->pWrite.buffer_size +=
 		    (full_pkg_length + LENGTH_SIZE);
 	}
+	route_mmap_update(route_item);
 	spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
 
 	return full_pkg_length;
@@ -489,12 +588,95 @@ clean_buffer:
 	route_item->pRead.pos = route_item->pWrite.pos;
 	route_item->pWrite.buffer_size = ROUTE_BUFFER_MAX_SIZE;
 	route_item->pRead.buffer_size = 0;
+	route_mmap_update(route_item);
 	spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
 	return 0;
 }
 
 EXPORT_SYMBOL_GPL(inputhub_route_read);
 
+/*
+ * Map the control page and the event ring of 'port' read-only, see
+ * struct shb_mmap_ctrl: readers take whole batches of events without a
+ * read() and a copy per event.
+ */
+int inputhub_route_mmap(unsigned short port, struct vm_area_struct *vma)
+{
+	struct inputhub_route_table *route_item;
+	unsigned long size = vma->vm_end - vma->vm_start;
+	int ret;
+
+	if (inputhub_route_item(port, &route_item) != 0)
+		return -EINVAL;
+
+	if (!route_item->phead.pos || !route_item->mmap_ctrl)
+		return -ENODEV;
+
+	if (vma->vm_pgoff || size != PAGE_SIZE + ROUTE_BUFFER_MAX_SIZE)
+		return -EINVAL;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_flags |= VM_DONTEXPAND | VM_DONTDUMP;
+
+	ret = remap_pfn_range(vma, vma->vm_start,
+			      virt_to_phys(route_item->mmap_ctrl) >> PAGE_SHIFT,
+			      PAGE_SIZE, vma->vm_page_prot);
+	if (ret)
+		return ret;
+
+	return remap_pfn_range(vma, vma->vm_start + PAGE_SIZE,
+			       virt_to_phys(route_item->phead.pos) >> PAGE_SHIFT,
+			       ROUTE_BUFFER_MAX_SIZE, vma->vm_page_prot);
+}
+EXPORT_SYMBOL_GPL(inputhub_route_mmap);
+
+unsigned int inputhub_route_poll(unsigned short port, struct file *file,
+				 poll_table *wait)
+{
+	struct inputhub_route_table *route_item;
+	struct inputhub_buffer_pos reader;
+
+	if (inputhub_route_item(port, &route_item) != 0)
+		return POLLERR;
+
+	poll_wait(file, &route_item->read_wait, wait);
+
+	return data_ready(route_item, &reader) ? (POLLIN | POLLRDNORM) : 0;
+}
+EXPORT_SYMBOL_GPL(inputhub_route_poll);
+
+/*hand back 'len' bytes of records processed by an mmap reader*/
+int inputhub_route_consume(unsigned short port, unsigned int len)
+{
+	struct inputhub_route_table *route_item;
+	unsigned int offset;
+	unsigned long flags = 0;
+
+	if (inputhub_route_item(port, &route_item) != 0)
+		return -EINVAL;
+
+	spin_lock_irqsave(&route_item->buffer_spin_lock, flags);
+	if (!route_item->phead.pos || len > route_item->pRead.buffer_size) {
+		spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
+		return -EINVAL;
+	}
+
+	offset = route_item->pRead.pos - route_item->phead.pos + len;
+	if (offset >= route_item->phead.buffer_size)
+		offset -= route_item->phead.buffer_size;
+	route_item->pRead.pos = route_item->phead.pos + offset;
+	route_item->pRead.buffer_size -= len;
+	route_item->pWrite.buffer_size += len;
+	route_mmap_update(route_item);
+	spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(inputhub_route_consume);
+
 static int64_t getTimestamp(void)
 {
 	struct timespec ts;
@@ -629,6 +811,8 @@ ssize_t inputhub_route_write_batch(unsigned short port, char *buf, size_t count,
 	char *buffer_begin, *buffer_end;
 	t_head header;
 	unsigned long flags = 0;
+	unsigned int unread;
+	bool flush;
 
 	if (inputhub_route_item(port, &route_item) != 0) {
 		hwlog_err("inputhub_route_item failed in %s port = %d!\n",
@@ -636,6 +820,9 @@ ssize_t inputhub_route_write_batch(unsigned short port, char *buf, size_t count,
 		return 0;
 	}
 	header.timestamp = timestamp;
+	/*flush complete must reach the HAL without waiting for the budget*/
+	flush = (ROUTE_SHB_PORT == port) && (count >= sizeof(unsigned short))
+	    && (SENSORHUB_TYPE_META_DATA == ((struct sensor_data *)buf)->type);
 
 	spin_lock_irqsave(&route_item->buffer_spin_lock, flags);
 	writer = route_item->pWrite;
@@ -670,9 +857,11 @@ ssize_t inputhub_route_write_batch(unsigned short port, char *buf, size_t count,
 	} else {
 		route_item->pRead.buffer_size += (count + HEAD_SIZE);
 	}
+	route_mmap_update(route_item);
+	unread = route_item->pRead.buffer_size;
 	spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
 	atomic_set(&route_item->data_ready, 1);
-	wake_up_interruptible(&route_item->read_wait);
+	route_wake_reader(route_item, unread, flush);
 
 	return (count + HEAD_SIZE);
 }
@@ -710,6 +899,7 @@ ssize_t inputhub_route_write(unsigned short port, char *buf, size_t count)
 	route_item->pWrite.pos = writer.pos;
 	route_item->pWrite.buffer_size -= (count + HEAD_SIZE);
 	route_item->pRead.buffer_size += (count + HEAD_SIZE);
+	route_mmap_update(route_item);
 	spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
 	atomic_set(&route_item->data_ready, 1);
 	wake_up_interruptible(&route_item->read_wait);
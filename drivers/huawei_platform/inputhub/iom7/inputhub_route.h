@@ -10,6 +10,8 @@
 #define __LINUX_INPUTHUB_ROUTE_H__
 #include "protocol.h"
 #include <linux/version.h>
+#include <linux/poll.h>
+#include <linux/mm_types.h>
 #include <huawei_platform/log/hw_log.h>
 
 #define IOM3_ST_NORMAL			(0)
@@ -147,6 +149,13 @@ extern ssize_t inputhub_route_read(unsigned short port, char __user *buf,
 				   size_t count);
 extern int inputhub_route_cmd(unsigned short port, unsigned int cmd,
 			      unsigned long arg);
+extern int inputhub_route_mmap(unsigned short port, struct vm_area_struct *vma);
+extern unsigned int inputhub_route_poll(unsigned short port, struct file *file,
+					poll_table *wait);
+extern int inputhub_route_consume(unsigned short port, unsigned int len);
+extern int inputhub_route_set_wake_latency(unsigned short port,
+					   unsigned int latency_ms,
+					   unsigned int watermark);
 
 /*called by inputhub_mcu module or test module.*/
 extern int inputhub_route_init(void);
@@ -523,6 +523,10 @@ typedef enum {
 	CMD_SHMEM_AP_RECV_RESP,
 	CMD_SHMEM_AP_SEND_REQ,
 	CMD_SHMEM_AP_SEND_RESP,
+	CMD_SHMEM_AP_DESC_RECV_REQ,
+	CMD_SHMEM_AP_DESC_RECV_RESP,
+	CMD_SHMEM_AP_DESC_SEND_REQ,
+	CMD_SHMEM_AP_DESC_SEND_RESP,
 
 	/* SHELL_DBG */
 	CMD_SHELL_DBG_REQ = CMD_PRIVATE,
@@ -53,6 +53,16 @@ static ssize_t shb_read(struct file *file, char __user *buf, size_t count,
     return inputhub_route_read(ROUTE_SHB_PORT,buf, count);
 }
 
+static unsigned int shb_poll(struct file *file, poll_table *wait)
+{
+    return inputhub_route_poll(ROUTE_SHB_PORT, file, wait);
+}
+
+static int shb_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    return inputhub_route_mmap(ROUTE_SHB_PORT, vma);
+}
+
 static ssize_t shb_write(struct file *file, const char __user *data,
                         size_t len, loff_t *ppos)
 {
@@ -214,6 +224,7 @@ Return:         
 static long shb_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
     void __user *argp = (void __user *)arg;
+    struct shb_wake_latency wake_latency;
     /*begin huangwen 20120706*/
     int sensorMcuMode;
     /*end huangwen 20120706*/
@@ -241,6 +252,13 @@ static long shb_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
     case SHB_IOCTL_APP_SENSOR_FLUSH:
         hwlog_info("shb_ioctl  cmd : batch flush SHB_IOCTL_APP_SENSOR_FLUSH\n");
         break;
+    case SHB_IOCTL_APP_MMAP_CONSUME:
+        return inputhub_route_consume(ROUTE_SHB_PORT, (unsigned int)arg);
+    case SHB_IOCTL_APP_SET_WAKE_LATENCY:
+        if (copy_from_user(&wake_latency, argp, sizeof(wake_latency)))
+            return -EFAULT;
+        return inputhub_route_set_wake_latency(ROUTE_SHB_PORT,
+            wake_latency.latency_ms, wake_latency.watermark);
     default:
         hwlog_err("shb_ioctl unknown cmd : %d\n", cmd);
         return -ENOTTY;
@@ -286,6 +304,8 @@ static const struct file_operations shb_fops = {
     .llseek     =   no_llseek,
     .read = shb_read,
     .write      =   shb_write,
+    .poll       =   shb_poll,
+    .mmap       =   shb_mmap,
     .unlocked_ioctl =   shb_ioctl,
 #ifdef CONFIG_COMPAT
     .compat_ioctl =   shb_ioctl,
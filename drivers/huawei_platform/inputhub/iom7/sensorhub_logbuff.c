@@ -19,6 +19,9 @@
 #include <linux/reboot.h>
 #include <linux/rtc.h>
 #include <linux/timer.h>
+#include <linux/vmalloc.h>
+#include <linux/poll.h>
+#include <linux/mm.h>
 #include "inputhub_route.h"
 #include "inputhub_bridge.h"
 #include "protocol.h"
@@ -37,6 +40,21 @@
 
 /*unite jiffies*/
 #define FLUSH_TIMEOUT (2*HZ)
+/*how long a flush waits for the reader to make room*/
+#define FLUSH_READER_TIMEOUT_MS 100
+
+/*
+ * mmap access: the daemon maps the local buffer read only, gets the
+ * readable range with LOGBUFF_IOC_GET_RANGE and releases what it has
+ * consumed with LOGBUFF_IOC_PUT, poll() tells when there is new data.
+ */
+struct logbuff_range {
+	uint32_t offset;
+	uint32_t len;
+};
+
+#define LOGBUFF_IOC_GET_RANGE _IOR('L', 0x1, struct logbuff_range)
+#define LOGBUFF_IOC_PUT _IOW('L', 0x2, uint32_t)
 
 static int isOpened;
 static int isNewDataAvailable;
@@ -54,6 +72,8 @@ static struct proc_dir_entry *logbuff_dentry;
 static uint32_t log_method = LOG_BUFF;
 static uint32_t sensorhub_log_full_flag;
 static bool inited = false;
+/*the mcu has updated the ddr buff while no reader was there to copy it*/
+static bool local_buff_stale;
 
 #define CONFIG_FLUSH '1'
 #define CONFIG_SERIAL '2'
@@ -68,6 +88,7 @@ typedef struct {
 
 static DECLARE_WAIT_QUEUE_HEAD(sensorhub_log_waitq);
 static DECLARE_WAIT_QUEUE_HEAD(sensorhub_log_flush_waitq);
+static DECLARE_WAIT_QUEUE_HEAD(sensorhub_log_consume_waitq);
 
 static inline void print_stat(int i) {
 	hwlog_debug("[%d][r %x][head %x][rear %x][full_flag %d]\n",
@@ -121,18 +142,42 @@ static int sensorhub_logbuff_open(struct inode *inode, struct file *file)
 		hwlog_err("%s sensorhub logbuff already opened !\n", __func__);
 		return -1;
 	}
+	mutex_lock(&logbuff_mutex);
+	/*
+	 * nothing was copied while nobody was reading, take what the ddr buff
+	 * holds now: the oldest part may already carry newer lines
+	 */
+	if (local_buff_stale && pLocalLogBuff && pDDRLogBuff) {
+		memcpy(pLocalLogBuff, pDDRLogBuff, DDR_LOG_BUFF_SIZE);
+		local_buff_stale = false;
+	}
 	sensorhub_log_r = sensorhub_log_buf_head;
 	isOpened = 1;
+	mutex_unlock(&logbuff_mutex);
 	return 0;
 }
 
 static int sensorhub_logbuff_release(struct inode *inode, struct file *file)
 {
 	hwlog_info("sensorhub logbuff release\n");
+	mutex_lock(&logbuff_mutex);
 	isOpened = 0;
+	mutex_unlock(&logbuff_mutex);
+	wake_up(&sensorhub_log_consume_waitq);
 	return 0;
 }
 
+/*called with logbuff_mutex held*/
+static void sensorhub_log_consume(uint32_t cnt)
+{
+	sensorhub_log_r = (sensorhub_log_r + cnt) % DDR_LOG_BUFF_SIZE;
+	if (!sensorhub_log_full_flag
+	    && sensorhub_log_r == sensorhub_log_buf_rear) {
+		sensorhub_log_full_flag = 1;
+	}
+	wake_up(&sensorhub_log_consume_waitq);
+}
+
 static ssize_t sensorhub_logbuff_read(struct file *file, char __user *buf,
 				      size_t count, loff_t *ppos)
 {
@@ -182,11 +227,7 @@ copy:
 		goto out;
 	}
 	/*update reader pointer*/
-	sensorhub_log_r = (sensorhub_log_r + error) % DDR_LOG_BUFF_SIZE;
-	if (!sensorhub_log_full_flag
-	    && sensorhub_log_r == sensorhub_log_buf_rear) {
-		sensorhub_log_full_flag = 1;
-	}
+	sensorhub_log_consume(error);
 out:
 	mutex_unlock(&logbuff_mutex);
 err:
@@ -194,9 +235,72 @@ err:
 	return error;
 }
 
+static int sensorhub_logbuff_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	if (!pLocalLogBuff || vma->vm_pgoff
+	    || vma->vm_end - vma->vm_start > DDR_LOG_BUFF_SIZE)
+		return -EINVAL;
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	return remap_vmalloc_range(vma, pLocalLogBuff, 0);
+}
+
+static unsigned int sensorhub_logbuff_poll(struct file *file, poll_table *wait)
+{
+	unsigned int mask = 0;
+
+	poll_wait(file, &sensorhub_log_waitq, wait);
+	mutex_lock(&logbuff_mutex);
+	if (sensorhub_log_buff_left() > 0)
+		mask |= POLLIN | POLLRDNORM;
+	mutex_unlock(&logbuff_mutex);
+
+	return mask;
+}
+
+static long sensorhub_logbuff_ioctl(struct file *file, unsigned int cmd,
+				    unsigned long arg)
+{
+	struct logbuff_range range;
+	uint32_t cnt;
+	long ret = 0;
+
+	switch (cmd) {
+	case LOGBUFF_IOC_GET_RANGE:
+		mutex_lock(&logbuff_mutex);
+		range.offset = sensorhub_log_r;
+		range.len = sensorhub_log_buff_left();
+		mutex_unlock(&logbuff_mutex);
+		if (copy_to_user((void __user *)arg, &range, sizeof(range)))
+			ret = -EFAULT;
+		break;
+	case LOGBUFF_IOC_PUT:
+		if (get_user(cnt, (uint32_t __user *)arg))
+			return -EFAULT;
+		mutex_lock(&logbuff_mutex);
+		if (cnt > sensorhub_log_buff_left())
+			ret = -EINVAL;
+		else if (cnt)
+			sensorhub_log_consume(cnt);
+		mutex_unlock(&logbuff_mutex);
+		break;
+	default:
+		ret = -ENOTTY;
+		break;
+	}
+
+	return ret;
+}
+
 static const struct file_operations sensorhub_logbuff_operations = {
 	.open = sensorhub_logbuff_open,
 	.read = sensorhub_logbuff_read,
+	.poll = sensorhub_logbuff_poll,
+	.mmap = sensorhub_logbuff_mmap,
+	.unlocked_ioctl = sensorhub_logbuff_ioctl,
+	.compat_ioctl = sensorhub_logbuff_ioctl,
 	.release = sensorhub_logbuff_release,
 };
 
@@ -223,6 +327,14 @@ static int logbuff_full_callback(const pkt_header_t *head)
 	print_stat(4);
 	update_local_buff_index(new_rear);
 	print_stat(5);
+	/*nobody reads, leave the log in ddr until a reader opens*/
+	if (!isOpened) {
+		local_buff_stale = true;
+		if (!flush_cnt)
+			flush_cnt = 1;
+		mutex_unlock(&logbuff_mutex);
+		return 0;
+	}
 	remain = DDR_LOG_BUFF_SIZE - update_index;
 	/*update reader pointer*/
 	if (remain < DDR_LOG_BUFF_COPY_SIZE) {
@@ -250,18 +362,20 @@ static int logbuff_flush_callback(const pkt_header_t *head)
 	     sensorhub_log_buf_rear) ? (flush_head - sensorhub_log_buf_rear)
 	    : (DDR_LOG_BUFF_SIZE - (sensorhub_log_buf_rear - flush_head));
 	int remain = 0;
-	int timeout_cnt = 100;
 	hwlog_debug("[%s] index: %d\n", __func__, pkt->index);
 	/*wait reader till we can update the head*/
-	while (sensorhub_log_buff_left() > (DDR_LOG_BUFF_COPY_SIZE - flush_size)
-	       && timeout_cnt--) {
-		msleep(1);
-	}
-	if (timeout_cnt < 0)
+	if (isOpened && !wait_event_timeout(sensorhub_log_consume_waitq,
+		    !isOpened || sensorhub_log_buff_left() <=
+		    (DDR_LOG_BUFF_COPY_SIZE - flush_size),
+		    msecs_to_jiffies(FLUSH_READER_TIMEOUT_MS)))
 		hwlog_warn("%s timeout, some log will lost", __func__);
 
 	/*get rotate log buff index*/
 	mutex_lock(&logbuff_mutex);
+	if (!isOpened) {
+		local_buff_stale = true;
+		goto update_index;
+	}
 	remain = DDR_LOG_BUFF_SIZE - sensorhub_log_buf_rear;
 	if (remain < flush_size) {
 		memcpy(pLocalLogBuff, pDDRLogBuff, flush_size - remain);
@@ -270,6 +384,7 @@ static int logbuff_flush_callback(const pkt_header_t *head)
 
 	memcpy(pLocalLogBuff + sensorhub_log_buf_rear,
 	       pDDRLogBuff + sensorhub_log_buf_rear, flush_size);
+update_index:
 	print_stat(6);
 	update_local_buff_index(flush_head);
 	print_stat(7);
@@ -461,12 +576,12 @@ static int sensorhub_logbuff_init(void)
 		hwlog_err("%s failed remap log buff\n", __func__);
 		goto REMAP_ERR;
 	}
-	pLocalLogBuff = (uint8_t *) kmalloc(DDR_LOG_BUFF_SIZE, GFP_KERNEL);
+	/*zeroed, and mappable by the log daemon*/
+	pLocalLogBuff = (uint8_t *) vmalloc_user(DDR_LOG_BUFF_SIZE);
 	if (!pLocalLogBuff) {
 		hwlog_err("%s failed to malloc\n", __func__);
 		goto MALLOC_ERR;
 	}
-	memset(pLocalLogBuff, 0, DDR_LOG_BUFF_SIZE);
 	mutex_init(&logbuff_mutex);
 	mutex_init(&logbuff_flush_mutex);
         inited = true;
@@ -496,7 +611,7 @@ static void sensorhub_logbuff_exit(void)
 {
 	iounmap(pDDRLogBuff);
 	pDDRLogBuff = NULL;
-	kfree(pLocalLogBuff);
+	vfree(pLocalLogBuff);
 	pLocalLogBuff = NULL;
 	unregister_mcu_event_notifier(TAG_LOG_BUFF, CMD_LOG_BUFF_FLUSHP,
 				      logbuff_flush_callback);
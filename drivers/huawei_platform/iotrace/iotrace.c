@@ -3,6 +3,12 @@
 #include <linux/module.h>
 #include <linux/blkdev.h>
 #include <linux/percpu.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/miscdevice.h>
+#include <linux/poll.h>
+#include <linux/irq_work.h>
 #include <linux/init.h>
 #include <linux/mutex.h>
 #include <linux/export.h>
@@ -204,20 +210,25 @@ static unsigned char *rw_name[] = {"R", "W", "N", "N", "S", "M", "P", "D"};
 
 #define IO_F_NAME_LEN  (32)
 #define IO_P_NAME_LEN  (16)
+#define IO_LOG_F_NAME_LEN  (12)
+/*
+ * One cache line per event. delay is in us for the end tags, the
+ * remap and map tags keep the source block there instead.
+ */
 struct io_trace_log_entry
 {
+    u64 time;
+    u64 inode;
     pid_t pid;
     pid_t tgid;
-    unsigned char action;
-    unsigned char rw;
-    unsigned char cpu;
-    unsigned char valid; /*whether it is running*/
-    unsigned int  nr_bytes;
-    unsigned long inode;
-    unsigned long time;
-    unsigned long delay;
+    u32 nr_bytes;
+    u32 delay;
+    u8  action;
+    u8  rw;
+    u8  cpu;
+    u8  valid; /*whether it is running*/
     char comm[IO_P_NAME_LEN];
-    char f_name[IO_F_NAME_LEN];
+    char f_name[IO_LOG_F_NAME_LEN];
 };
 
 #define IO_MAX_PROCESS  (32768)
@@ -231,10 +242,11 @@ struct io_trace_log_entry
 #define IO_MAX_OP_LOG_PER_BUF ((IO_MAX_BUF_ENTRY) / sizeof(struct io_trace_output_entry))
 #define IO_MAX_LOG_PER_BUF ((IO_MAX_BUF_ENTRY) / sizeof(struct io_trace_log_entry))
 #define IO_MAX_LOG_PER_GLOBAL \
-    (((IO_MAX_GLOBAL_ENTRY) / sizeof(struct io_trace_log_entry)) - 1)
+    ((IO_MAX_GLOBAL_ENTRY) / sizeof(struct io_trace_log_entry))
 
 #define IO_TRACE_LIMIT_LOG  (50000000)
 #define io_ns_to_ms(ns) ((ns) / 1000000)
+#define io_us_to_ms(us) ((us) / 1000)
 
 struct io_trace_pid
 {
@@ -248,9 +260,49 @@ struct io_trace_mem_mngt
 {
     int index;    
     unsigned char *buff[IO_RUNNING_MAX_PROCESS];
-    unsigned char *all_trace_buff;
+    unsigned char *all_trace_buff; /*per cpu logs merged for the readers*/
+};
+
+/*
+ * /dev/iotrace maps the cpu rings back to back, one per possible cpu,
+ * each a page holding this head followed by nr_entries log entries.
+ * head counts the entries ever logged on the cpu. The reader consumes
+ * from its tail up to head, stores the new tail and polls the device
+ * to sleep until watermark entries wait on a cpu. head - tail above
+ * nr_entries means the ring was overrun.
+ */
+#define IO_TRACE_RING_VERSION  (1)
+struct io_trace_ring_meta
+{
+    u32 version;
+    u32 entry_size;
+    u32 nr_entries;
+    u32 cpu;
+    u32 head;      /*written by the kernel*/
+    u32 tail;      /*written by the reader*/
+    u32 watermark; /*written by the reader, 0 for nr_entries / 4*/
 };
 
+/*
+ * Every cpu logs to its own ring without any lock, irqs are off while
+ * an entry is filled since mmc end is done in irq context. tail is
+ * only used while merging.
+ */
+struct io_trace_cpu_buf
+{
+    struct io_trace_ring_meta *meta;
+    struct io_trace_log_entry *entries;
+    unsigned int tail;
+};
+
+static DEFINE_PER_CPU(struct io_trace_cpu_buf, io_trace_cpu_bufs);
+static unsigned int io_log_per_cpu; /*power of 2*/
+static unsigned long io_ring_size; /*meta page and entries*/
+
+static atomic_t io_stream_readers = ATOMIC_INIT(0);
+static DECLARE_WAIT_QUEUE_HEAD(io_stream_wait);
+static struct irq_work io_stream_work;
+
 struct io_trace_ctrl
 {
     struct platform_device *pdev;
@@ -273,13 +325,13 @@ struct io_trace_ctrl
 
 static struct io_trace_ctrl *io_trace_this = NULL;
 static DEFINE_RAW_SPINLOCK(trace_buff_spinlock);
-static spinlock_t global_spinlock;
 static struct mutex output_mutex;
 
 static int trace_mm_init(struct io_trace_ctrl *trace_ctrl);
 static void io_trace_setup(struct io_trace_ctrl *trace_ctrl);
 
 static void io_trace_offline(struct io_trace_ctrl *trace_ctrl);
+static void io_trace_merge_logs(struct io_trace_ctrl *trace_ctrl);
 static unsigned char *io_mem_mngt_alloc(struct io_trace_mem_mngt *mem_mngt);
 static void io_mem_mngt_free(struct io_trace_mem_mngt *mem_mngt, unsigned char *buf);
 
@@ -680,7 +732,7 @@ static struct io_trace_log_entry *io_trace_find_log(struct io_trace_interface *i
         {
             io_trace_print("time stamp not allow, first index: %u, now index: %u\n",
                     io_trace_this->all_log_index, index);   
-            io_trace_print("entry time: %ld, time_stamp:%ld, time_span: %ld\n",
+            io_trace_print("entry time: %llu, time_stamp:%ld, time_span: %ld\n",
                     io_ns_to_ms(entry->time), itface->time_stamp, itface->time_span);   
             return NULL;
         }
@@ -732,7 +784,7 @@ static struct io_trace_log_entry *io_trace_find_log(struct io_trace_interface *i
                 trace_ctrl->out_log_count = file_log_count;
             }
             /*this is only one break*/
-            if(blk_entry->time < (entry->time - entry->delay))
+            if(blk_entry->time < (entry->time - (u64)entry->delay * NSEC_PER_USEC))
             {
                 break;
             }
@@ -787,6 +839,8 @@ static ssize_t io_log_data_show(struct kobject *kobj, struct kobj_attribute *att
         goto end;
     }
 
+    io_trace_merge_logs(io_trace_this);
+
     if(!itface)
     {
         io_trace_print("itface is NULL\n");
@@ -855,7 +909,7 @@ static ssize_t io_log_data_show(struct kobject *kobj, struct kobj_attribute *att
         out_entry->inode = log_entry->inode;
         out_entry->rw = log_entry->rw;
         out_entry->time_stamp = log_entry->time;
-        out_entry->delay = io_ns_to_ms(log_entry->delay);
+        out_entry->delay = io_us_to_ms(log_entry->delay);
         memcpy(out_entry->comm, log_entry->comm, IO_P_NAME_LEN);
 
         if(action_is_read(log_entry->action))
@@ -887,15 +941,15 @@ log_end:
         io_trace_print("w_cnt:%d, w_max_delay: %u, w_total_delay: %u\n", w_cnt, w_max_delay, w_total_delay);
         if(r_cnt > 0)
         {
-            head->r_max_delay = io_ns_to_ms(r_max_delay);
-            head->r_aver_delay = io_ns_to_ms(r_total_delay / r_cnt);
-            head->r_total_delay = io_ns_to_ms(r_total_delay);
+            head->r_max_delay = io_us_to_ms(r_max_delay);
+            head->r_aver_delay = io_us_to_ms(r_total_delay / r_cnt);
+            head->r_total_delay = io_us_to_ms(r_total_delay);
         }
         if(w_cnt > 0)
         {
-            head->w_max_delay = io_ns_to_ms(w_max_delay);
-            head->w_aver_delay = io_ns_to_ms(w_total_delay / w_cnt);
-            head->w_total_delay =  io_ns_to_ms(w_total_delay);
+            head->w_max_delay = io_us_to_ms(w_max_delay);
+            head->w_aver_delay = io_us_to_ms(w_total_delay / w_cnt);
+            head->w_total_delay =  io_us_to_ms(w_total_delay);
         }
         /*used for data check*/
         head->data_len = (unsigned int)ret;
@@ -990,6 +1044,7 @@ static ssize_t sysfs_io_trace_attr_show(struct device *dev,
         log_time = (unsigned long )realts.tv_sec*1000000000 + realts.tv_nsec;
 
         io_trace_this->enable = 0;
+        io_trace_merge_logs(io_trace_this);
         sprintf(file_name, "/sdcard/log_%s", "end");
         io_trace_this->filp = open_log_file(file_name);
         if(io_trace_this->filp == NULL)
@@ -1132,7 +1187,7 @@ static int write_head_kernel(struct file *filp)
     unsigned len;
 
     len = sprintf(buf, "%-5s%-10s%-10s%-20s%-20s%-15s%-10s%-15s%-15s%-8s%-15s\n", "CPU","TGID",
-            "PID", "PName","Time", "Inode/Sector", "Nr_Types","Action", "Delay", "RW", "F_NAME");
+            "PID", "PName","Time", "Inode/Sector", "Nr_Types","Action", "Delay(us)", "RW", "F_NAME");
     vec[0].iov_base = buf;
     vec[0].iov_len  = len;
 
@@ -1180,7 +1235,7 @@ static int write_log_kernel(struct file *filp, struct io_trace_log_entry *entry)
     }
     // format: <priority:1><message:N>\0
     io_entry_rw(entry->rw, rw_type);
-    len = sprintf(buf, "%-5d&%-10d&%-10d&%-20s&%-20ld&%-12ld&%-10d&%-10s&%-5d&%-15ld&%-5s&%-32s\n", entry->cpu,
+    len = sprintf(buf, "%-5d&%-10d&%-10d&%-20.16s&%-20llu&%-12llu&%-10u&%-10s&%-5d&%-15u&%-5s&%-32.12s\n", entry->cpu,
             entry->tgid, entry->pid, entry->comm, entry->time, entry->inode, entry->nr_bytes,
             all_trace_action[entry->action].name, entry->action, entry->delay,
             rw_type, entry->f_name);
@@ -1193,6 +1248,98 @@ static int write_log_kernel(struct file *filp, struct io_trace_log_entry *entry)
     return ret;
 }
 
+static int io_stream_open(struct inode *inode, struct file *file)
+{
+    atomic_inc(&io_stream_readers);
+
+    return nonseekable_open(inode, file);
+}
+
+static int io_stream_release(struct inode *inode, struct file *file)
+{
+    atomic_dec(&io_stream_readers);
+
+    return 0;
+}
+
+/*the rings are allocated on the first enable and never freed*/
+static int io_stream_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    unsigned long uaddr = vma->vm_start;
+    int cpu, ret = 0;
+
+    mutex_lock(&output_mutex);
+    if(!io_trace_this->first)
+    {
+        ret = -ENODEV;
+        goto end;
+    }
+
+    if(vma->vm_pgoff != 0 ||
+            vma->vm_end - vma->vm_start != num_possible_cpus() * io_ring_size)
+    {
+        ret = -EINVAL;
+        goto end;
+    }
+
+    for_each_possible_cpu(cpu)
+    {
+        ret = remap_vmalloc_range_partial(vma, uaddr,
+                per_cpu(io_trace_cpu_bufs, cpu).meta, io_ring_size);
+        if(ret)
+        {
+            io_trace_print("cpu %d ring map failed![%d]\n", cpu, ret);
+            goto end;
+        }
+        uaddr += io_ring_size;
+    }
+
+end:
+    mutex_unlock(&output_mutex);
+
+    return ret;
+}
+
+static unsigned int io_stream_poll(struct file *file, poll_table *wait)
+{
+    int cpu;
+
+    poll_wait(file, &io_stream_wait, wait);
+
+    if(!io_trace_this->first)
+    {
+        return 0;
+    }
+
+    for_each_possible_cpu(cpu)
+    {
+        struct io_trace_ring_meta *meta = per_cpu(io_trace_cpu_bufs, cpu).meta;
+
+        if(READ_ONCE(meta->head) - READ_ONCE(meta->tail) >= io_stream_watermark(meta))
+        {
+            return POLLIN | POLLRDNORM;
+        }
+    }
+
+    return 0;
+}
+
+static const struct file_operations io_stream_fops = {
+    .owner = THIS_MODULE,
+    .open = io_stream_open,
+    .release = io_stream_release,
+    .mmap = io_stream_mmap,
+    .poll = io_stream_poll,
+    .llseek = no_llseek,
+};
+
+static struct miscdevice io_stream_dev = {
+    .minor = MISC_DYNAMIC_MINOR,
+    .name = "iotrace",
+    .fops = &io_stream_fops,
+    .mode = 0660,
+};
+
 static struct kobject *kobject_ts;
 static int io_trace_probe(struct platform_device *pdev)
 {
@@ -1211,6 +1358,16 @@ static int io_trace_probe(struct platform_device *pdev)
         io_trace_print("create group failed!\n");
         return -1;
     }
+
+    init_irq_work(&io_stream_work, io_stream_wakeup);
+    ret = misc_register(&io_stream_dev);
+    if(ret)
+    {
+        io_trace_print("register stream device failed![%d]\n", ret);
+        sysfs_remove_group(kobject_ts, &io_trace_attr_group);
+        kobject_put(kobject_ts);
+        return ret;
+    }
     return ret;
 }
 
@@ -1237,32 +1394,109 @@ static struct io_trace_log_entry *io_get_pid_buf(struct io_trace_pid *trace_pid,
     return ret_trace;
 }
 
+static inline struct io_trace_log_entry *io_cpu_buf_entry(
+        struct io_trace_cpu_buf *cpu_buf, unsigned int pos)
+{
+    return cpu_buf->entries + (pos & (io_log_per_cpu - 1));
+}
+
+static inline unsigned int io_stream_watermark(struct io_trace_ring_meta *meta)
+{
+    unsigned int watermark = READ_ONCE(meta->watermark);
+
+    if(watermark == 0 || watermark > io_log_per_cpu)
+    {
+        watermark = io_log_per_cpu / 4;
+    }
+
+    return watermark;
+}
+
+/*called with irqs off, the entry is published by io_put_all_buf()*/
 static struct io_trace_log_entry *io_get_all_buf(struct io_trace_ctrl *trace_ctrl)
 {
-    struct io_trace_log_entry *ret_trace = NULL;
-    unsigned long flags;
+    struct io_trace_cpu_buf *cpu_buf = this_cpu_ptr(&io_trace_cpu_bufs);
 
-    /*must be irq save lock, because mmc end is done in irq context!*/
-    //spin_lock(&global_spinlock);
-    spin_lock_irqsave(&global_spinlock, flags);
+    return io_cpu_buf_entry(cpu_buf, cpu_buf->meta->head);
+}
 
-    ret_trace = ((struct io_trace_log_entry *)(trace_ctrl->mem_mngt->all_trace_buff) + 
-            trace_ctrl->all_log_index);
-    trace_ctrl->all_log_index ++;
-    /*point to next valid entry*/
-    if(trace_ctrl->all_log_index >= IO_MAX_LOG_PER_GLOBAL)    
+static void io_put_all_buf(struct io_trace_ctrl *trace_ctrl)
+{
+    struct io_trace_ring_meta *meta = this_cpu_ptr(&io_trace_cpu_bufs)->meta;
+    unsigned int head = meta->head + 1;
+
+    /*the entry is complete before the readers see the new head*/
+    smp_wmb();
+    WRITE_ONCE(meta->head, head);
+
+    /*only wake on crossing the watermark, not for every entry above it*/
+    if(atomic_read(&io_stream_readers) &&
+            head - READ_ONCE(meta->tail) == io_stream_watermark(meta))
     {
-        trace_ctrl->all_log_index = 0;
+        irq_work_queue(&io_stream_work);
     }
+}
+
+static void io_stream_wakeup(struct irq_work *work)
+{
+    wake_up_interruptible(&io_stream_wait);
+}
 
-    if(trace_ctrl->all_log_count < IO_MAX_LOG_PER_GLOBAL)
+/*
+ * Merge the cpu rings by time, oldest first, into all_trace_buff, so
+ * the readers walk all_log_count entries back from the newest one as
+ * before. Tracing is stopped by the caller, waiting for the probes
+ * already running to finish leaves the rings stable.
+ */
+static void io_trace_merge_logs(struct io_trace_ctrl *trace_ctrl)
+{
+    struct io_trace_log_entry *out =
+        (struct io_trace_log_entry *)(trace_ctrl->mem_mngt->all_trace_buff);
+    struct io_trace_cpu_buf *cpu_buf;
+    unsigned int count = 0;
+    int cpu;
+
+    synchronize_sched();
+
+    for_each_possible_cpu(cpu)
     {
-        trace_ctrl->all_log_count ++;
+        unsigned int head;
+
+        cpu_buf = per_cpu_ptr(&io_trace_cpu_bufs, cpu);
+        head = cpu_buf->meta->head;
+        cpu_buf->tail = head - min(head, io_log_per_cpu);
     }
-    //spin_unlock(&global_spinlock);
-    spin_unlock_irqrestore(&global_spinlock, flags);
 
-    return ret_trace;
+    while(count < IO_MAX_LOG_PER_GLOBAL)
+    {
+        struct io_trace_cpu_buf *oldest = NULL;
+        struct io_trace_log_entry *entry, *oldest_entry = NULL;
+
+        for_each_possible_cpu(cpu)
+        {
+            cpu_buf = per_cpu_ptr(&io_trace_cpu_bufs, cpu);
+            if(cpu_buf->tail == cpu_buf->meta->head)
+            {
+                continue;
+            }
+            entry = io_cpu_buf_entry(cpu_buf, cpu_buf->tail);
+            if(oldest_entry == NULL || entry->time < oldest_entry->time)
+            {
+                oldest = cpu_buf;
+                oldest_entry = entry;
+            }
+        }
+
+        if(oldest == NULL)
+        {
+            break;
+        }
+        out[count ++] = *oldest_entry;
+        oldest->tail ++;
+    }
+
+    trace_ctrl->all_log_index = 0;
+    trace_ctrl->all_log_count = count;
 }
 
 struct io_trace_tag_attr
@@ -1338,7 +1572,7 @@ static unsigned long io_trace_direct_delay(struct io_trace_pid *trace_pid,
 
 static void io_trace_global_log(unsigned int action, unsigned long sector, 
         unsigned int nr_bytes, unsigned int parent, unsigned long own_time, 
-        unsigned long delay, unsigned int rw_flags, char *f_name)
+        unsigned int delay, unsigned int rw_flags, char *f_name)
 {
     struct io_trace_ctrl *trace_ctrl = io_trace_this;
     struct io_trace_log_entry *all_log_entry = NULL;
@@ -1347,6 +1581,7 @@ static void io_trace_global_log(unsigned int action, unsigned long sector,
     pid_t tgid;
     struct timespec realts;
     unsigned long log_time;
+    unsigned long flags;
 
     pid = tsk->pid;
     tgid = tsk->tgid;
@@ -1394,6 +1629,7 @@ static void io_trace_global_log(unsigned int action, unsigned long sector,
     }
 #endif
 
+    local_irq_save(flags);
     all_log_entry = io_get_all_buf(trace_ctrl);
     all_log_entry->action = action;
     all_log_entry->rw = (unsigned char)rw_flags;
@@ -1405,12 +1641,14 @@ static void io_trace_global_log(unsigned int action, unsigned long sector,
     all_log_entry->time = log_time;
     all_log_entry->delay = delay;
     memcpy(all_log_entry->comm, tsk->comm, IO_P_NAME_LEN);
-    memset(all_log_entry->f_name, '\0', IO_F_NAME_LEN);
+    memset(all_log_entry->f_name, '\0', IO_LOG_F_NAME_LEN);
 
     if(f_name)
     {
-        memcpy(all_log_entry->f_name, f_name, IO_F_NAME_LEN);
+        memcpy(all_log_entry->f_name, f_name, IO_LOG_F_NAME_LEN);
     }
+    io_put_all_buf(trace_ctrl);
+    local_irq_restore(flags);
 
     return;
 }
@@ -1490,7 +1728,8 @@ static void io_trace_add_log(unsigned int action, unsigned long i_ino,
             }
             /*don't need log the parent*/
             //io_trace_global_log(tag_attr->parent, i_ino, 0, log_time - delay, 0, rw, f_name);
-            io_trace_global_log(action, i_ino, nr_bytes, 0, log_time, delay, rw, f_name);
+            io_trace_global_log(action, i_ino, nr_bytes, 0, log_time,
+                    delay / NSEC_PER_USEC, rw, f_name);
             skip = 1;
         }
     }
@@ -1510,7 +1749,7 @@ static void io_trace_add_log(unsigned int action, unsigned long i_ino,
         log_entry->tgid = tgid;
         log_entry->inode = i_ino;
         log_entry->time = log_time;
-        log_entry->delay = delay;
+        log_entry->delay = delay / NSEC_PER_USEC;
 
         {
             memcpy(log_entry->comm, tsk->comm, IO_P_NAME_LEN);
@@ -2324,6 +2563,7 @@ static void io_mem_mngt_free(struct io_trace_mem_mngt *mem_mngt, unsigned char *
 static int io_mem_mngt_init(struct io_trace_mem_mngt *mem_mngt)
 {
     int i = 0;
+    int cpu;
 
     mem_mngt->index = 0;
 
@@ -2337,15 +2577,47 @@ static int io_mem_mngt_init(struct io_trace_mem_mngt *mem_mngt)
         }
     }
 
-    mem_mngt->all_trace_buff = kmalloc(IO_MAX_GLOBAL_ENTRY, GFP_KERNEL);
+    mem_mngt->all_trace_buff = vmalloc(IO_MAX_GLOBAL_ENTRY);
     if(mem_mngt->all_trace_buff == NULL)
     {
         io_trace_print("io_mem_mngt_free all trace buff failed!\n");
         goto failed;
     }
 
+    /*the cpu rings together hold no more than the merge buffer*/
+    io_log_per_cpu = rounddown_pow_of_two(IO_MAX_LOG_PER_GLOBAL / num_possible_cpus());
+    io_ring_size = PAGE_SIZE +
+        PAGE_ALIGN(io_log_per_cpu * sizeof(struct io_trace_log_entry));
+    for_each_possible_cpu(cpu)
+    {
+        struct io_trace_cpu_buf *cpu_buf = per_cpu_ptr(&io_trace_cpu_bufs, cpu);
+        unsigned char *ring;
+
+        /*zeroed and allowed to be mapped to the readers*/
+        ring = vmalloc_user(io_ring_size);
+        if(ring == NULL)
+        {
+            io_trace_print("cpu %d trace buff failed!\n", cpu);
+            goto failed_cpu;
+        }
+        cpu_buf->meta = (struct io_trace_ring_meta *)ring;
+        cpu_buf->entries = (struct io_trace_log_entry *)(ring + PAGE_SIZE);
+        cpu_buf->meta->version = IO_TRACE_RING_VERSION;
+        cpu_buf->meta->entry_size = sizeof(struct io_trace_log_entry);
+        cpu_buf->meta->nr_entries = io_log_per_cpu;
+        cpu_buf->meta->cpu = cpu;
+    }
+
     return 0;
 
+failed_cpu:
+    for_each_possible_cpu(cpu)
+    {
+        vfree(per_cpu(io_trace_cpu_bufs, cpu).meta);
+        per_cpu(io_trace_cpu_bufs, cpu).meta = NULL;
+        per_cpu(io_trace_cpu_bufs, cpu).entries = NULL;
+    }
+    vfree(mem_mngt->all_trace_buff);
 failed:
     i--;
     for(; i >=0; i--)
@@ -2474,7 +2746,7 @@ static int __init io_trace_init(void)
 
     io_trace_print("total mem : %d\n", total_mem);
     io_trace_print("Enter %s:%d\n", __FUNCTION__, __LINE__);
-    spin_lock_init(&global_spinlock);
+    BUILD_BUG_ON(sizeof(struct io_trace_log_entry) != 64);
     mutex_init(&output_mutex);
 
     io_trace_this->pdev = platform_device_register_simple("io_trace", -1, NULL, 0);
@@ -6,6 +6,7 @@
 #include<linux/aio.h>
 #include<linux/types.h>
 #include<uapi/linux/uio.h>
+#include<chipset_common/hwlogger/hw_logger.h>
 
 #include <huawei_platform/log/hw_log.h>
 #define HWLOG_TAG	log_exception
@@ -15,7 +16,8 @@ HWLOG_REGIST();
 /**
 *  tag: the tag of this command
 *  msg: concrete command string to write to /dev/log/exception
-*  return: on success return the bytes writed successfully, on error return <0
+*  return: on success return the bytes writed successfully, on error return <0,
+*          -EBUSY if the tag is over its budget in the exception log
 *
 */
 int log_to_exception(char* tag, char* msg)
@@ -31,6 +33,12 @@ int log_to_exception(char* tag, char* msg)
 		return -EINVAL;
 	}
 
+	/* a storming tag is dropped before it costs a printk and a file open */
+	if (hw_logger_over_budget(LOGGER_LOG_EXCEPTION, tag,
+				  sizeof(struct logger_entry) + 1 +
+				  strlen(tag) + 1 + strlen(msg) + 1))
+		return -EBUSY;
+
 	hwlog_info("%s: exception tag '%s' msg '%s'", __func__, tag, msg);
 
 	oldfs = get_fs();
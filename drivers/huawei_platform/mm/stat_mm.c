@@ -5,18 +5,50 @@
 #include <linux/mm.h>
 #include <linux/bitmap.h>
 #include <linux/device.h>
+#include <linux/percpu.h>
+#include <linux/workqueue.h>
 #include <dsm/dsm_pub.h>
 #include <huawei_platform/linux/stat_mm.h>
 
 #define DSM_MM_ENTRY_MAX_NR 100
 #define STAT_MM_MAX_PARA_NUM 5
-#define STAT_MM_BUFFER_SIZE 128
+#define STAT_MM_BUFFER_SIZE 1024	/* a batch of events */
 #define STAT_MM_STR "stat_mm"
+#define STAT_MM_RING_SIZE 64
+#define STAT_MM_DRAIN_DELAY HZ
 
 struct stat_mm_para {
 	unsigned long int para[STAT_MM_MAX_PARA_NUM];
 };
 
+/*
+ * Events are queued to a per-cpu ring by the cpu that records them
+ * and reported to dmd in batches by stat_mm_drain_work, so the slab
+ * and mlock paths never wait on the dsm client.
+ */
+struct stat_mm_event {
+	int id;
+	int type;
+	unsigned int num;
+	char *fmt;
+	char comm[TASK_COMM_LEN];
+	struct stat_mm_para para;
+};
+
+struct stat_mm_ring {
+	unsigned int head;	/* written by the owning cpu only */
+	unsigned int tail;	/* written by the drain work only */
+	unsigned long dropped;	/* ring full */
+	struct stat_mm_event ev[STAT_MM_RING_SIZE];
+};
+
+static DEFINE_PER_CPU(struct stat_mm_ring, stat_mm_rings);
+static unsigned long stat_mm_busy;	/* dsm client still occupied */
+static unsigned long stat_mm_truncated;	/* did not fit in the batch */
+static unsigned long stat_mm_armed;
+static void stat_mm_drain(struct work_struct *work);
+static DECLARE_DELAYED_WORK(stat_mm_drain_work, stat_mm_drain);
+
 static struct dsm_client *stat_mm_client;
 static struct dsm_dev stat_mm_dev = {
 	.name = "dsm_" STAT_MM_STR,
@@ -80,35 +112,117 @@ static const struct stat_mm_callback {
 
 static CLASS_ATTR(mask, S_IWUSR, NULL, stat_mm_mask_store);
 
-static inline void stat_mm_stat_channel_dmd(int id,
-					    int type, unsigned int num,
-					    char *fmt,
-					    struct stat_mm_para *para)
+static ssize_t stat_mm_dropped_show(struct class *class,
+				    struct class_attribute *attr, char *buf)
 {
-	if (likely(stat_mm_client != NULL)) {
-		if (!dsm_client_ocuppy(stat_mm_client)) {
-			int dsm_id = DSM_MM_STAT + num;
-			/* add dmd id */
-			dsm_client_record(stat_mm_client, "%d ", dsm_id);
-			dsm_client_record(stat_mm_client,
-					  fmt,
-					  id,
-					  type,
-					  current->comm,
-					  para->para[0],
-					  para->para[1],
-					  para->para[2],
-					  para->para[3], para->para[4]);
-			dsm_client_notify(stat_mm_client, dsm_id);
+	unsigned long dropped = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		dropped += per_cpu_ptr(&stat_mm_rings, cpu)->dropped;
+	return scnprintf(buf, PAGE_SIZE, "full %lu busy %lu truncated %lu\n",
+			 dropped, ACCESS_ONCE(stat_mm_busy),
+			 ACCESS_ONCE(stat_mm_truncated));
+}
+
+static CLASS_ATTR(dropped, S_IRUGO, stat_mm_dropped_show, NULL);
+
+/* append one event to the occupied dsm client, false once it is full */
+static inline bool stat_mm_stat_channel_dmd(struct stat_mm_event *ev)
+{
+	struct stat_mm_para *para = &ev->para;
+
+	/* add dmd id */
+	if (!dsm_client_record(stat_mm_client, "%d ", DSM_MM_STAT + ev->num))
+		return false;
+	dsm_client_record(stat_mm_client,
+			  ev->fmt,
+			  ev->id,
+			  ev->type,
+			  ev->comm,
+			  para->para[0],
+			  para->para[1],
+			  para->para[2],
+			  para->para[3], para->para[4]);
+	return true;
+}
+
+/*
+ * The whole batch goes out as a single dmd record, under the dmd id of
+ * its first event, each event still starting with its own id.
+ */
+static void stat_mm_drain(struct work_struct *work)
+{
+	struct stat_mm_ring *ring;
+	struct stat_mm_event *ev;
+	unsigned int head, tail;
+	bool occupied = false;
+	int dsm_id = 0;
+	int cpu;
+
+	clear_bit(0, &stat_mm_armed);
+	/* pairs with the test_and_set_bit() in stat_mm_stat_channel() */
+	smp_mb__after_atomic();
+
+	if (likely(stat_mm_client != NULL))
+		occupied = !dsm_client_ocuppy(stat_mm_client);
+
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(&stat_mm_rings, cpu);
+		head = ACCESS_ONCE(ring->head);
+		/* pairs with the smp_wmb() in stat_mm_stat_channel() */
+		smp_rmb();
+		for (tail = ring->tail; tail != head; tail++) {
+			ev = &ring->ev[tail % STAT_MM_RING_SIZE];
+			if (!occupied)
+				stat_mm_busy++;
+			else if (!stat_mm_stat_channel_dmd(ev))
+				stat_mm_truncated++;
+			else if (!dsm_id)
+				dsm_id = DSM_MM_STAT + ev->num;
 		}
+		/* the events are read before their slots are reused */
+		smp_mb();
+		ACCESS_ONCE(ring->tail) = tail;
 	}
+
+	if (dsm_id)
+		dsm_client_notify(stat_mm_client, dsm_id);
+	else if (occupied)
+		dsm_client_unocuppy(stat_mm_client);
 }
 
 static inline void stat_mm_stat_channel(int id,
 					int type, unsigned int num,
 					char *fmt, struct stat_mm_para *para)
 {
-	stat_mm_stat_channel_dmd(id, type, num, fmt, para);
+	struct stat_mm_ring *ring;
+	struct stat_mm_event *ev;
+	unsigned int head;
+
+	/* only called in task context, preemption off serializes the cpu */
+	preempt_disable();
+	ring = this_cpu_ptr(&stat_mm_rings);
+	head = ring->head;
+	if (head - ACCESS_ONCE(ring->tail) >= STAT_MM_RING_SIZE) {
+		ring->dropped++;
+		preempt_enable();
+		return;
+	}
+	ev = &ring->ev[head % STAT_MM_RING_SIZE];
+	ev->id = id;
+	ev->type = type;
+	ev->num = num;
+	ev->fmt = fmt;
+	memcpy(ev->comm, current->comm, TASK_COMM_LEN);
+	ev->para = *para;
+	/* the event is written before the drain can see it */
+	smp_wmb();
+	ACCESS_ONCE(ring->head) = head + 1;
+	preempt_enable();
+
+	if (!test_and_set_bit(0, &stat_mm_armed))
+		schedule_delayed_work(&stat_mm_drain_work, STAT_MM_DRAIN_DELAY);
 }
 
 static void stat_mm_copy_args(struct stat_mm_para *para,
@@ -166,8 +280,12 @@ static int __init stat_mm_init(void)
 		goto out;
 	}
 	err = class_create_file(stat_mm_class, &class_attr_mask);
+	if (err)
+		goto destroy;
+	err = class_create_file(stat_mm_class, &class_attr_dropped);
 	if (err == 0)
 		return 0;
+destroy:
 	class_destroy(stat_mm_class);
 out:
 	return err;
@@ -175,6 +293,7 @@ out:
 
 static void __exit stat_mm_exit(void)
 {
+	cancel_delayed_work_sync(&stat_mm_drain_work);
 	class_destroy(stat_mm_class);
 }
 
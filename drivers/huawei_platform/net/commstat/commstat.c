@@ -3,6 +3,8 @@
 #include <linux/jhash.h>
 #include <linux/slab.h>
 #include <linux/hash.h>
+#include <linux/percpu.h>
+#include <linux/rculist.h>
 
 #include <net/sock.h>
 
@@ -12,18 +14,27 @@
 
 static int num_comm_stats;
 
+/*
+ * Entries are never freed. Lookups walk the hash under RCU and count on
+ * per-cpu counters; comm_stat_list_lock only serializes the insertion of
+ * new entries and the /proc reader.
+ */
 static LIST_HEAD(comm_stat_list);
 static DEFINE_SPINLOCK(comm_stat_list_lock);
 
 struct hlist_head *comm_head;
 
+struct comm_stat_bytes {
+	uint64_t tx_bytes;
+	uint64_t rx_bytes;
+};
+
 struct comm_stat {
 	struct list_head list;
 	struct hlist_node hlist;
 	char *comm;
 	uid_t uid;
-	uint64_t tx_bytes;
-	uint64_t rx_bytes;
+	struct comm_stat_bytes __percpu *bytes;
 };
 
 #define COMM_HASHBITS    8
@@ -49,26 +60,33 @@ static inline struct hlist_head *comm_hash(const char *name)
 	return &comm_head[hash_32(hash, COMM_HASHBITS)];
 }
 
+/* called under rcu_read_lock() or comm_stat_list_lock */
 struct comm_stat *get_comm_stat_entry(const char *comm)
 {
 	struct comm_stat *proc_entry;
 	struct hlist_head *head = comm_hash(comm);
 
-	hlist_for_each_entry(proc_entry, head, hlist)
+	hlist_for_each_entry_rcu(proc_entry, head, hlist)
 		if (!strncmp(comm, proc_entry->comm, TASK_COMM_LEN))
 			return proc_entry;
 
 	return NULL;
 }
 
-static struct comm_stat *alloc_comm_stat_entry(const char *comm)
+static void free_comm_stat_entry(struct comm_stat *entry)
+{
+	free_percpu(entry->bytes);
+	kfree(entry->comm);
+	kfree(entry);
+}
+
+/* allocated without the lock held, added by add_comm_stat_entry() */
+static struct comm_stat *alloc_comm_stat_entry(const char *comm, uid_t uid)
 {
 	struct comm_stat *entry;
 
-	if (num_comm_stats + 1 > MAX_COMM_STATS) {
-		pr_err("%s(): no room to add entry %s\n", __func__, comm);
+	if (ACCESS_ONCE(num_comm_stats) + 1 > MAX_COMM_STATS)
 		return NULL;
-	}
 
 	entry = kzalloc(sizeof(struct comm_stat), GFP_ATOMIC);
 	if (entry == NULL) {
@@ -83,13 +101,56 @@ static struct comm_stat *alloc_comm_stat_entry(const char *comm)
 		return NULL;
 	}
 
-	num_comm_stats++;
-	list_add(&entry->list, &comm_stat_list);
-	hlist_add_head(&entry->hlist, comm_hash(comm));
+	entry->bytes = alloc_percpu_gfp(struct comm_stat_bytes, GFP_ATOMIC);
+	if (entry->bytes == NULL) {
+		pr_err("%s(): alloc_percpu fail for %s\n", __func__, comm);
+		kfree(entry->comm);
+		kfree(entry);
+		return NULL;
+	}
+	entry->uid = uid;
 
 	return entry;
 }
 
+/*
+ * add_comm_stat_entry - publish 'entry', unless another task added one for
+ * the same comm meanwhile. Returns the entry to count on, or NULL if the
+ * table is full; 'entry' is freed if not used.
+ */
+static struct comm_stat *add_comm_stat_entry(struct comm_stat *entry)
+{
+	struct comm_stat *found;
+
+	spin_lock_bh(&comm_stat_list_lock);
+	found = get_comm_stat_entry(entry->comm);
+	if (!found) {
+		if (num_comm_stats + 1 > MAX_COMM_STATS) {
+			pr_err("%s(): no room to add entry %s\n", __func__,
+			       entry->comm);
+		} else {
+			num_comm_stats++;
+			list_add(&entry->list, &comm_stat_list);
+			hlist_add_head_rcu(&entry->hlist, comm_hash(entry->comm));
+			found = entry;
+		}
+	}
+	spin_unlock_bh(&comm_stat_list_lock);
+
+	if (found != entry)
+		free_comm_stat_entry(entry);
+
+	return found;
+}
+
+static void comm_stat_add(struct comm_stat *entry, int tx, int len)
+{
+	if (tx)
+		this_cpu_add(entry->bytes->tx_bytes, len);
+	else
+		this_cpu_add(entry->bytes->rx_bytes, len);
+}
+
 void inet_save_comm_stat(struct socket *sock, int tx, int len)
 {
 	char comm[TASK_COMM_LEN];
@@ -107,26 +168,24 @@ void inet_save_comm_stat(struct socket *sock, int tx, int len)
 		__func__, comm, tx ? "send" : "recv", len);
 	*/
 
-	spin_lock_bh(&comm_stat_list_lock);
-
+	rcu_read_lock();
 	entry = get_comm_stat_entry(comm);
 	if (entry) {
-		entry->tx_bytes += tx ? len : 0;
-		entry->rx_bytes += tx ? 0 : len;
-		spin_unlock_bh(&comm_stat_list_lock);
+		comm_stat_add(entry, tx, len);
+		rcu_read_unlock();
 		return;
 	}
+	rcu_read_unlock();
 
-	entry = alloc_comm_stat_entry(comm);
-	if (!entry) {
-		spin_unlock_bh(&comm_stat_list_lock);
+	/* first traffic of this comm: the slow path */
+	entry = alloc_comm_stat_entry(comm, from_kuid(&init_user_ns, uid));
+	if (!entry)
 		return;
-	}
-	entry->uid = from_kuid(&init_user_ns, uid);
-	entry->tx_bytes = tx ? len : 0;
-	entry->rx_bytes = tx ? 0 : len;
 
-	spin_unlock_bh(&comm_stat_list_lock);
+	/* entries are never freed, no RCU read side needed from here */
+	entry = add_comm_stat_entry(entry);
+	if (entry)
+		comm_stat_add(entry, tx, len);
 
 	return;
 }
@@ -156,14 +215,23 @@ static void comm_stats_proc_stop(struct seq_file *m, void *p)
 static int comm_stats_proc_show(struct seq_file *m, void *v)
 {
 	struct comm_stat *proc_entry;
+	struct comm_stat_bytes *bytes;
+	uint64_t rx_bytes = 0, tx_bytes = 0;
+	int cpu;
 
 	proc_entry = list_entry(v, struct comm_stat, list);
 
+	for_each_possible_cpu(cpu) {
+		bytes = per_cpu_ptr(proc_entry->bytes, cpu);
+		rx_bytes += bytes->rx_bytes;
+		tx_bytes += bytes->tx_bytes;
+	}
+
 	seq_printf(m, "%s %u %llu %llu\n",
 			proc_entry->comm,
 			proc_entry->uid,
-			proc_entry->rx_bytes,
-			proc_entry->tx_bytes);
+			rx_bytes,
+			tx_bytes);
 
 	return 0;
 }
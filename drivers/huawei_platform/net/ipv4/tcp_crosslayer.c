@@ -10,8 +10,9 @@
 #include <linux/string.h>
 #include <linux/slab.h>
 #include <linux/hash.h>
+#include <linux/jhash.h>
+#include <linux/rcupdate.h>
 #include <linux/bootmem.h>
-#include <linux/sort.h>
 #include <uapi/linux/netlink.h>
 #include <net/sock.h>
 #include <net/netlink.h>
@@ -23,6 +24,9 @@
 /* 2^31 + 2^29 - 2^25 + 2^22 - 2^19 - 2^16 + 1 */
 #define GOLDEN_RATIO_PRIME_32 0x9e370001UL
 
+/* Sockets recovered together by one pass over a notification */
+#define ASPEN_CDN_BATCH 16
+
 /****************************/
 /*** Variables definition ***/
 /****************************/
@@ -35,6 +39,12 @@ static struct kmem_cache *cdn_hash_slub;
 /* Global memory cache for storing dropped packets */
 static struct kmem_cache *cdn_drop_slub;
 
+/* Held sockets with queued drops, waiting for retransmission */
+struct aspen_cdn_batch {
+	int			nr;
+	struct sock		*sk[ASPEN_CDN_BATCH];
+};
+
 /* Log level */
 unsigned int aspen_log_level = 8;
 EXPORT_SYMBOL(aspen_log_level);
@@ -60,14 +70,20 @@ static struct aspen_monitor monitor;
 /*** Functions declaration ***/
 /*****************************/
 static inline u32 cdn_hashfn(u32 val, unsigned int bits);
+static inline u32 cdn_tuple_hashfn(const struct aspen_cdn_tuple *t,
+				   unsigned int bits);
+static void aspen_free_hashbucket(struct rcu_head *head);
+static struct sock *aspen_hold_hashbucket(struct aspen_cdn_hashbucket *pos);
 static struct sock *aspen_fetch_hashtable(unsigned short int port);
+static struct sock *aspen_fetch_hashtable_tuple(const struct aspen_cdn_tuple *t);
 static struct cdn_entry *aspen_create_cdn_entry(void);
 static void aspen_destroy_cdn_entry(struct sock *sk);
 static int aspen_crosslayer_dropped_notification(struct sock *sk,
 						 unsigned int seq);
-static int compare_cdn_info(const void *a, const void *b);
-static int aspen_sk_crosslayer_recovery(struct aspen_cdn_info *info,
-					int length);
+static struct sock *aspen_cdn_batch_add(struct aspen_cdn_batch *batch,
+					struct sock *sk);
+static void aspen_cdn_batch_queue(struct sock *sk, unsigned int seq);
+static void aspen_cdn_batch_flush(struct aspen_cdn_batch *batch);
 static void aspen_tcp_crosslayer_recovery(struct sock *sk);
 static int aspen_skb_crosslayer_retransmit(struct sock *sk,
 					   struct tcp_sock *tp,
@@ -104,6 +120,15 @@ static inline u32 cdn_hashfn(u32 val, unsigned int bits)
 	return hash >> (32 - bits);
 }
 
+static inline u32 cdn_tuple_hashfn(const struct aspen_cdn_tuple *t,
+				   unsigned int bits)
+{
+	u32 hash = jhash_3words((__force u32)t->saddr, (__force u32)t->daddr,
+				((u32)t->sport << 16) | t->dport, 0);
+
+	return hash_32(hash, bits);
+}
+
 int aspen_init_hashtable(void)
 {
 	int i, cdn_hash_size;
@@ -174,8 +199,9 @@ EXPORT_SYMBOL(aspen_init_hashtable);
 
 void aspen_mark_hashtable(struct sock *sk, unsigned short int port)
 {
-	unsigned int slot, hit;
+	unsigned int slot;
 	struct aspen_cdn_hashbucket *pos;
+	struct inet_sock *inet = inet_sk(sk);
 
 	/* Check hashtable */
 	if (unlikely(!cdn_hashtable))
@@ -184,88 +210,147 @@ void aspen_mark_hashtable(struct sock *sk, unsigned short int port)
 	if (!aspen_tcp_cdn)
 		return;
 
-	slot = cdn_hashfn(port, cdn_hash_shift);
+	/* Reconnected socket, hash it again under its new tuple */
+	if (unlikely(sk->cdn_hash_node))
+		aspen_unmark_hashtable(sk);
 
-	/* Must disable bottom halves */
-	spin_lock_bh(&cdn_hashtable[slot].lock);
+	pos = kmem_cache_alloc(cdn_hash_slub, GFP_ATOMIC);
+	if (unlikely(!pos))
+		return;
 
-	hit = 0;
-	hlist_for_each_entry(pos, &cdn_hashtable[slot].head, node) {
-		if (pos->port == port) {
-			pos->sk = NULL;
-			pos->refs += 1;
-			hit = 1;
-			break;
-		}
-	}
+	pos->sk = sk;
+	pos->tuple.saddr = inet->inet_saddr;
+	pos->tuple.daddr = inet->inet_daddr;
+	pos->tuple.sport = port;
+	pos->tuple.dport = ntohs(inet->inet_dport);
+	sk->cdn_hash_node = pos;
+
+	/*
+	 * The two chains are updated one after the other, never nested;
+	 * readers may briefly find the socket in only one of them.
+	 */
+	slot = cdn_tuple_hashfn(&pos->tuple, cdn_hash_shift);
+	spin_lock_bh(&cdn_hashtable[slot].lock);
+	hlist_add_head_rcu(&pos->node, &cdn_hashtable[slot].head);
+	spin_unlock_bh(&cdn_hashtable[slot].lock);
 
-	if (likely(!hit)) {
-		pos = kmem_cache_alloc(cdn_hash_slub, GFP_ATOMIC);
-		if (likely(pos)) {
-			pos->sk = sk;
-			pos->port = port;
-			pos->refs = 1;
-			sk->cdn_hash_marker = 1;
-			hlist_add_head(&pos->node,
-				       &cdn_hashtable[slot].head);
+	slot = cdn_hashfn(port, cdn_hash_shift);
+	spin_lock_bh(&cdn_hashtable[slot].lock);
+	hlist_add_head_rcu(&pos->port_node, &cdn_hashtable[slot].head);
+	spin_unlock_bh(&cdn_hashtable[slot].lock);
 #ifdef CONFIG_HW_CROSSLAYER_OPT_DBG_MODULE
-			aspen_monitor_inc(&monitor.cdn_hash_slub_cnts);
+	aspen_monitor_inc(&monitor.cdn_hash_slub_cnts);
 #endif
-		}
-	}
-
-	/* Enable bottom halves */
-	spin_unlock_bh(&cdn_hashtable[slot].lock);
 }
 EXPORT_SYMBOL(aspen_mark_hashtable);
 
+static void aspen_free_hashbucket(struct rcu_head *head)
+{
+	struct aspen_cdn_hashbucket *pos;
+
+	pos = container_of(head, struct aspen_cdn_hashbucket, rcu);
+	kmem_cache_free(cdn_hash_slub, pos);
+}
+
 void aspen_unmark_hashtable(struct sock *sk)
 {
 	unsigned int slot;
 	struct aspen_cdn_hashbucket *pos;
-	struct hlist_node *n;
-	struct inet_sock *inet = inet_sk(sk);
-	u16 port;
 
 	/* Check hashtable */
 	if (unlikely(!cdn_hashtable))
 		return;
 
-	if (sk && sk->cdn_hash_marker) {
-		inet = inet_sk(sk);
-		port = ntohs(inet->inet_sport);
-	} else {
+	if (!sk || !sk->cdn_hash_node)
 		return;
-	}
 
-	slot = cdn_hashfn(port, cdn_hash_shift);
+	pos = sk->cdn_hash_node;
+	sk->cdn_hash_node = NULL;
+
+	/* Readers still walking the chains must not hold sk any more */
+	ACCESS_ONCE(pos->sk) = NULL;
 
-	/* Must disable bottom halves */
+	slot = cdn_tuple_hashfn(&pos->tuple, cdn_hash_shift);
 	spin_lock_bh(&cdn_hashtable[slot].lock);
+	hlist_del_rcu(&pos->node);
+	spin_unlock_bh(&cdn_hashtable[slot].lock);
 
-	hlist_for_each_entry_safe(pos, n, &cdn_hashtable[slot].head, node) {
-		if (pos->port == port) {
-			pos->refs -= 1;
+	slot = cdn_hashfn(pos->tuple.sport, cdn_hash_shift);
+	spin_lock_bh(&cdn_hashtable[slot].lock);
+	hlist_del_rcu(&pos->port_node);
+	spin_unlock_bh(&cdn_hashtable[slot].lock);
 
-			if (pos->refs > 0)
-				break;
+	call_rcu(&pos->rcu, aspen_free_hashbucket);
+#ifdef CONFIG_HW_CROSSLAYER_OPT_DBG_MODULE
+	aspen_monitor_dec(&monitor.cdn_hash_slub_cnts);
+#endif
+}
+EXPORT_SYMBOL(aspen_unmark_hashtable);
+
+/*
+ * TCP sockets are SLAB_DESTROY_BY_RCU: sk stays a sock while we are in the
+ * RCU read side, but may be freed and reused, so take a reference only if
+ * it is alive and check it is still the one hashed.
+ */
+static struct sock *aspen_hold_hashbucket(struct aspen_cdn_hashbucket *pos)
+{
+	struct sock *sk = ACCESS_ONCE(pos->sk);
+
+	if (!sk || !atomic_inc_not_zero(&sk->sk_refcnt))
+		return NULL;
+
+	if (unlikely(ACCESS_ONCE(pos->sk) != sk)) {
+		sock_put(sk);
+		return NULL;
+	}
 
-			hlist_del(&pos->node);
-			kmem_cache_free(cdn_hash_slub, pos);
-			sk->cdn_hash_marker = 0;
 #ifdef CONFIG_HW_CROSSLAYER_OPT_DBG_MODULE
-			aspen_monitor_dec(&monitor.cdn_hash_slub_cnts);
+	aspen_monitor_inc(&monitor.cdn_sock_hold_cnts);
 #endif
+	return sk;
+}
+
+/*
+ * Sockets bound to different destinations may share a source port; the
+ * port alone then does not tell which flow dropped and nothing is returned.
+ */
+static struct sock *aspen_fetch_hashtable(unsigned short int port)
+{
+	unsigned int slot;
+	struct aspen_cdn_hashbucket *pos, *hit;
+	struct sock *res;
+
+	/* Check hashtable */
+	if (unlikely(!cdn_hashtable)) {
+		ASPEN_WARNING("Failed to access hashtable.");
+		return NULL;
+	}
+
+	slot = cdn_hashfn(port, cdn_hash_shift);
+
+	rcu_read_lock();
+
+	hit = NULL;
+	hlist_for_each_entry_rcu(pos, &cdn_hashtable[slot].head, port_node) {
+		if (pos->tuple.sport != port || !ACCESS_ONCE(pos->sk))
+			continue;
+
+		if (hit) {
+			hit = NULL;
+			ASPEN_INFO("port=%u shared by several sockets", port);
 			break;
 		}
+		hit = pos;
 	}
 
-	/* Enable bottom halves */
-	spin_unlock_bh(&cdn_hashtable[slot].lock);
+	res = hit ? aspen_hold_hashbucket(hit) : NULL;
+
+	rcu_read_unlock();
+
+	return res;
 }
-EXPORT_SYMBOL(aspen_unmark_hashtable);
 
-static struct sock *aspen_fetch_hashtable(unsigned short int port)
+static struct sock *aspen_fetch_hashtable_tuple(const struct aspen_cdn_tuple *t)
 {
 	unsigned int slot;
 	struct aspen_cdn_hashbucket *pos;
@@ -277,30 +362,22 @@ static struct sock *aspen_fetch_hashtable(unsigned short int port)
 		return NULL;
 	}
 
-	slot = cdn_hashfn(port, cdn_hash_shift);
+	slot = cdn_tuple_hashfn(t, cdn_hash_shift);
 
-	/* Must disable bottom halves */
-	spin_lock_bh(&cdn_hashtable[slot].lock);
+	rcu_read_lock();
 
 	res = NULL;
-	hlist_for_each_entry(pos, &cdn_hashtable[slot].head, node) {
-		if (pos->port == port) {
-			res = pos->sk;
+	hlist_for_each_entry_rcu(pos, &cdn_hashtable[slot].head, node) {
+		if (pos->tuple.saddr == t->saddr &&
+		    pos->tuple.daddr == t->daddr &&
+		    pos->tuple.sport == t->sport &&
+		    pos->tuple.dport == t->dport) {
+			res = aspen_hold_hashbucket(pos);
 			break;
 		}
 	}
 
-	if (res) {
-		sock_hold(res);
-#ifdef CONFIG_HW_CROSSLAYER_OPT_DBG_MODULE
-		aspen_monitor_inc(&monitor.cdn_sock_hold_cnts);
-#endif
-		ASPEN_INFO("port=%u hashed_sk=%p refs=%d",
-			   port, pos?pos->sk:NULL, pos?pos->refs:0);
-	}
-
-	/* Enable bottom halves */
-	spin_unlock_bh(&cdn_hashtable[slot].lock);
+	rcu_read_unlock();
 
 	return res;
 }
@@ -414,31 +491,76 @@ static int aspen_crosslayer_dropped_notification(struct sock *sk,
 	return 0;
 }
 
-static int compare_cdn_info(const void *a, const void *b)
+/*
+ * aspen_cdn_batch_add - take over the reference on sk held by the lookup.
+ * Returns the socket to queue drops on, or NULL if it is going away.
+ */
+static struct sock *aspen_cdn_batch_add(struct aspen_cdn_batch *batch,
+					struct sock *sk)
 {
-	const struct aspen_cdn_info *_a = a;
-	const struct aspen_cdn_info *_b = b;
-
-	/* Ascending order */
-	if (_a->port == _b->port) {
-		/* Ascending order */
-		if (_a->seq > _b->seq)
-			return 1;
-		else if (_a->seq < _b->seq)
-			return -1;
-		else
-			return 0;
-	} else if (_a->port > _b->port) {
-		return 1;
-	} else {
-		return -1;
+	int i;
+
+	if (sock_flag(sk, SOCK_DEAD) || sk->sk_state == TCP_CLOSE) {
+		ASPEN_DEBUG("Maybe sk(%p) is going to be destroyed.", sk);
+		sock_put(sk);
+#ifdef CONFIG_HW_CROSSLAYER_OPT_DBG_MODULE
+		aspen_monitor_inc(&monitor.cdn_sock_put_cnts);
+#endif
+		return NULL;
+	}
+
+	for (i = 0; i < batch->nr; i++) {
+		if (batch->sk[i] == sk) {
+			/* The batch already holds it */
+			__sock_put(sk);
+#ifdef CONFIG_HW_CROSSLAYER_OPT_DBG_MODULE
+			aspen_monitor_inc(&monitor.cdn_sock_put_cnts);
+#endif
+			return sk;
+		}
+	}
+
+	if (batch->nr == ASPEN_CDN_BATCH)
+		aspen_cdn_batch_flush(batch);
+
+	batch->sk[batch->nr++] = sk;
+	return sk;
+}
+
+/* Called with bottom halves disabled */
+static void aspen_cdn_batch_queue(struct sock *sk, unsigned int seq)
+{
+	bh_lock_sock(sk);
+	aspen_crosslayer_dropped_notification(sk, seq);
+	bh_unlock_sock(sk);
+}
+
+/* Retransmit for every socket of the batch; consumes their references */
+static void aspen_cdn_batch_flush(struct aspen_cdn_batch *batch)
+{
+	int i;
+
+	for (i = 0; i < batch->nr; i++) {
+		bh_lock_sock(batch->sk[i]);
+		aspen_tcp_crosslayer_recovery(batch->sk[i]);
+		bh_unlock_sock(batch->sk[i]);
 	}
+
+	batch->nr = 0;
 }
 
+/*
+ * The drops of a notification are queued on their sockets first, then the
+ * sockets are recovered together, all in one pass with bottom halves off.
+ * Sequences need not be sorted: the cdn queue of a socket keeps them in
+ * order.
+ */
 void aspen_crosslayer_recovery(void *ptr, int length)
 {
-	int i, start_index;
-	struct aspen_cdn_info *info, *start_point;
+	int i;
+	struct aspen_cdn_info *info;
+	struct aspen_cdn_batch batch;
+	struct sock *sk = NULL;
 	struct timeval tv;
 
 	if (unlikely(!ptr || length <= 0)) {
@@ -458,58 +580,79 @@ void aspen_crosslayer_recovery(void *ptr, int length)
 	if (!aspen_tcp_cdn)
 		return;
 
-	/* Heapsort provided by kernel */
-	sort(info, (unsigned long)length, sizeof(struct aspen_cdn_info),
-	     compare_cdn_info, NULL);
-
-	start_point = info;
-	start_index = 0;
-	for (i = 1; i < length; i++) {
-		if (info[i].port != info[i-1].port) {
-			aspen_sk_crosslayer_recovery(start_point,
-						     i - start_index);
-			start_point = &info[i];
-			start_index = i;
+	batch.nr = 0;
+	local_bh_disable();
+
+	for (i = 0; i < length; i++) {
+		/* Drops of one flow are usually reported back to back */
+		if (!i || info[i].port != info[i - 1].port) {
+			sk = aspen_fetch_hashtable(info[i].port);
+			if (!sk) {
+				ASPEN_WARNING("Hash missed while searching sk "
+					      "by port(%u).", info[i].port);
+				continue;
+			}
+			sk = aspen_cdn_batch_add(&batch, sk);
 		}
+
+		if (sk)
+			aspen_cdn_batch_queue(sk, info[i].seq);
 	}
-	aspen_sk_crosslayer_recovery(start_point, i - start_index);
+
+	aspen_cdn_batch_flush(&batch);
+	local_bh_enable();
 }
 EXPORT_SYMBOL(aspen_crosslayer_recovery);
 
-static int aspen_sk_crosslayer_recovery(struct aspen_cdn_info *info,
-					int length)
+void aspen_crosslayer_recovery_tuple(void *ptr, int length)
 {
-	struct sock *sk;
-	int i, ret = 0;
-
-	if (!info || length <= 0) {
-		ASPEN_ERR("Invalid parameter.(info=%p length=%d)",
-			  info, length);
-		return -EFAULT;
-	}
+	int i;
+	struct aspen_cdn_tuple_info *info;
+	struct aspen_cdn_batch batch;
+	struct sock *sk = NULL;
 
-	/* Hold sock */
-	sk = aspen_fetch_hashtable(info[0].port);
-	if (!sk) {
-		ASPEN_WARNING("Hash missed while searching sk by port(%u).",
-			      info[0].port);
-		return -EFAULT;
+	if (unlikely(!ptr || length <= 0)) {
+		ASPEN_ERR("Invalid parameter.(ptr=%p length=%d)", ptr, length);
+		return;
 	}
 
-	/* Must disable bottom halves */
-	spin_lock_bh(&((sk)->sk_lock.slock));
+	info = (struct aspen_cdn_tuple_info *)ptr;
 
 	for (i = 0; i < length; i++)
-		aspen_crosslayer_dropped_notification(sk, info[i].seq);
+		ASPEN_INFO("Cross-layer Dropped Notification(%d): "
+			   "type=%u %pI4:%u->%pI4:%u seq=%u", aspen_tcp_cdn,
+			   info[i].type, &info[i].tuple.saddr,
+			   info[i].tuple.sport, &info[i].tuple.daddr,
+			   info[i].tuple.dport, info[i].seq);
 
-	/* Put sock */
-	aspen_tcp_crosslayer_recovery(sk);
+	if (!aspen_tcp_cdn)
+		return;
+
+	batch.nr = 0;
+	local_bh_disable();
+
+	for (i = 0; i < length; i++) {
+		if (!i || memcmp(&info[i].tuple, &info[i - 1].tuple,
+				 sizeof(info[i].tuple))) {
+			sk = aspen_fetch_hashtable_tuple(&info[i].tuple);
+			if (!sk) {
+				ASPEN_WARNING("Hash missed while searching sk "
+					      "by tuple(%u->%u).",
+					      info[i].tuple.sport,
+					      info[i].tuple.dport);
+				continue;
+			}
+			sk = aspen_cdn_batch_add(&batch, sk);
+		}
 
-	/* Enable bottom halves */
-	spin_unlock_bh(&((sk)->sk_lock.slock));
+		if (sk)
+			aspen_cdn_batch_queue(sk, info[i].seq);
+	}
 
-	return ret;
+	aspen_cdn_batch_flush(&batch);
+	local_bh_enable();
 }
+EXPORT_SYMBOL(aspen_crosslayer_recovery_tuple);
 
 static void aspen_tcp_crosslayer_recovery(struct sock *sk)
 {
@@ -518,13 +661,20 @@ static void aspen_tcp_crosslayer_recovery(struct sock *sk)
 		return;
 	}
 
-	if (!sock_owned_by_user(sk))
+	if (!sock_owned_by_user(sk)) {
 		/* Retransmit immediately */
 		aspen_tcp_crosslayer_retransmit(sk);
-	else
-		/* Deleguate our work to tcp_release_cb() */
-		test_and_set_bit(TCP_CROSSLAYER_RECOVERY_DEFERRED,
-				 &tcp_sk(sk)->tsq_flags);
+	} else if (test_and_set_bit(TCP_CROSSLAYER_RECOVERY_DEFERRED,
+				    &tcp_sk(sk)->tsq_flags)) {
+		/*
+		 * Deleguate our work to tcp_release_cb(); it was already,
+		 * and puts only the reference taken the first time
+		 */
+		__sock_put(sk);
+#ifdef CONFIG_HW_CROSSLAYER_OPT_DBG_MODULE
+		aspen_monitor_inc(&monitor.cdn_sock_put_cnts);
+#endif
+	}
 }
 
 void aspen_tcp_crosslayer_retransmit(struct sock *sk)
@@ -655,11 +805,32 @@ static int aspen_skb_crosslayer_retransmit(struct sock *sk,
 		return -EINVAL;
 	}
 
+	/* While the socket is paced, only mark the skb lost:
+	 * tcp_xmit_retransmit_queue() sends it when the pacing timer fires.
+	 */
+	if (tcp_pacing_check(sk)) {
+		if (!(tcb->sacked & TCPCB_LOST)) {
+			tp->lost_out += tcp_skb_pcount(skb);
+			tp->lost += tcp_skb_pcount(skb);
+			tcb->sacked |= TCPCB_LOST;
+		}
+		if (!tp->retransmit_skb_hint ||
+		    before(tcb->seq, TCP_SKB_CB(tp->retransmit_skb_hint)->seq))
+			tp->retransmit_skb_hint = skb;
+		if (after(tcb->end_seq, tp->retransmit_high))
+			tp->retransmit_high = tcb->end_seq;
+		ASPEN_DEBUG("Paced dropped skb(%u:%u) length(%u) sk(%p).",
+			    tcb->seq, tcb->end_seq, length, sk);
+		return 0;
+	}
+
 	err = __tcp_retransmit_skb(sk, skb);
 	if (!err) {
 		tp->retrans_out += tcp_skb_pcount(skb);
-		if (!(tcb->sacked & TCPCB_LOST))
+		if (!(tcb->sacked & TCPCB_LOST)) {
 			tp->lost_out += tcp_skb_pcount(skb);
+			tp->lost += tcp_skb_pcount(skb);
+		}
 		tcb->sacked |= (TCPCB_LOST | TCPCB_RETRANS);
 		tcb->ack_seq = tp->snd_nxt;
 		ASPEN_DEBUG("Rexmitted dropped skb(%u:%u) length(%u) sk(%p).",
@@ -13,6 +13,11 @@
 #include <linux/kthread.h>
 #include <linux/string.h>
 #include <net/tcp.h>
+#include <linux/percpu.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
 
 #include "wifi_tcp_statistics.h"
 
@@ -85,20 +90,40 @@ static char *s_arrTitle[MAX_ARR_TITLE_COUNT] = {
 #define WIFI_LAN3_HEADER           0xAC100000     /*172.16.x.x ~ 172.31.x.x*/
 #define WIFI_LAN3_MSK                 0xFFF00000
 
-#define WIFI_MAX_UID_CNT   8
-
 #define WIFI_INVALID_VALUE 0xFFFFFFFF
 
-typedef struct {
-	kuid_t uid;
+#define WIFI_UID_HASHBITS	ilog2(WIFI_TCP_UID_SLOTS)
+
+/*
+ * All counters are per-cpu and free running, so the TCP paths only add to
+ * their cpu's copy. A reader sums the cpus; the proc file reports, and the
+ * STOP message discards, what was counted since the last baseline, by
+ * moving the baseline instead of clearing the counters under the writers.
+ *
+ * UIDs are hashed into s_uid_slot[], a slot is claimed with cmpxchg() by
+ * the first segment of its UID and released by the proc reader once it
+ * stayed idle for a whole period. An update racing with the release may
+ * land on the slot's next owner, which is tolerable for statistics.
+ */
+struct wifi_stat_pcpu {
 	unsigned int counter[MAX_ARR_TITLE_COUNT];
-} UIDTCPStat;
+	unsigned int uid_counter[WIFI_TCP_UID_SLOTS][MAX_ARR_TITLE_COUNT];
+	unsigned int uid_rtt[WIFI_TCP_UID_SLOTS][WIFI_TCP_RTT_BUCKETS];
+};
+
+struct wifi_stat_sum {
+	unsigned int counter[MAX_ARR_TITLE_COUNT];
+	unsigned int uid_counter[WIFI_TCP_UID_SLOTS][MAX_ARR_TITLE_COUNT];
+	unsigned int uid_rtt[WIFI_TCP_UID_SLOTS][WIFI_TCP_RTT_BUCKETS];
+};
+
+static DEFINE_PER_CPU(struct wifi_stat_pcpu, s_wifi_stat_pcpu);
+static uid_t s_uid_slot[WIFI_TCP_UID_SLOTS];	/* 0: free */
+static struct wifi_stat_sum s_baseline;
+static DEFINE_MUTEX(s_snap_lock);		/* baseline and slot release */
 
-static unsigned int s_WifiStatics[MAX_ARR_TITLE_COUNT] = {0};
 static unsigned int s_ON = WIFI_STAT_OFF;
 static struct sock *g_wifi_tcp_nlfd;
-static UIDTCPStat s_uidTcpStat[WIFI_MAX_UID_CNT] = { {0} };
-static int s_tcpstat_index;
 static unsigned char s_cVALIDATESTATE[] = { TCP_ESTABLISHED,  TCP_SYN_SENT, TCP_SYN_RECV, TCP_LISTEN};
 
 
@@ -149,83 +174,128 @@ static  kuid_t get_socket_uid(struct sock *sk)
 	return   uid ;
 }
 
+/* slot of 'uid' in s_uid_slot[], claimed if needed, or -1 */
 static int wifi_getTcpStatIndex(kuid_t uid)
 {
-	int index =  WIFI_INVALID_VALUE;
-	int i = 0;
-	if (WIFI_INVALID_VALUE == __kuid_val(uid))
-		return WIFI_INVALID_VALUE;
-
-	if (0 == __kuid_val(uid) || 1000 == __kuid_val(uid))
-		return WIFI_INVALID_VALUE;
-
-	for (i = 0; i < s_tcpstat_index && i < WIFI_MAX_UID_CNT ; i++) {
-		if (__kuid_val(s_uidTcpStat[i].uid) == __kuid_val(uid)) {
-			index = i;
-			goto out;
-		}
-	}
-
-	if (s_tcpstat_index  < WIFI_MAX_UID_CNT) {
-		index = s_tcpstat_index;
-		s_tcpstat_index++;
-		s_uidTcpStat[index].uid = uid;
-	}
+	uid_t val = __kuid_val(uid);
+	unsigned int hash, i, slot;
+	uid_t cur;
 
-out:
-	return index;
-}
+	if (WIFI_INVALID_VALUE == val)
+		return -1;
 
-static void updateTcpStatByUID (kuid_t uid, int index, int count)
-{
-	int result = 0;
+	if (0 == val || 1000 == val)
+		return -1;
 
-	if (s_ON == WIFI_STAT_OFF) {
-		return;
+	hash = hash_32(val, WIFI_UID_HASHBITS);
+	for (i = 0; i < WIFI_TCP_UID_SLOTS; i++) {
+		slot = (hash + i) & (WIFI_TCP_UID_SLOTS - 1);
+		cur = ACCESS_ONCE(s_uid_slot[slot]);
+		if (cur == val)
+			return slot;
+		if (cur == 0) {
+			cur = cmpxchg(&s_uid_slot[slot], 0, val);
+			if (cur == 0 || cur == val)
+				return slot;
+		}
 	}
 
-	result = wifi_getTcpStatIndex(uid);
-
-	if (WIFI_INVALID_VALUE == result)
-		return ;
-
-	if (__kuid_val(uid) != __kuid_val(s_uidTcpStat[result].uid))
-		return;
-
-	s_uidTcpStat[result].counter[index] += count;
+	return -1;
 }
 
-static void wifi_updateCounter(struct sock *sk, int count, int lan, int web)
+/* LAN or WEB index of a segment of 'sk', or -1 if it is not counted */
+static int wifi_counter_index(struct sock *sk, int lan, int web)
 {
 	struct inet_sock *inet = NULL;
 	unsigned int dest_addr = 0;
-	int index = 0;
 
 	if (s_ON == WIFI_STAT_OFF)
-		return ;
+		return -1;
 
 	if (NULL == sk)
-		return ;
+		return -1;
 
 	inet = inet_sk(sk);
 	if (NULL == inet)
-		return;
+		return -1;
 
 	dest_addr = htonl(inet->inet_daddr);
 
 	if (wifi_is_local_sock(dest_addr) == true)
+		return -1;
+
+	if (wifi_is_lan_sock(dest_addr) == true)
+		return lan;
+
+	return web;
+}
+
+static int wifi_uid_slot(struct sock *sk)
+{
+	if (!wifi_is_validate_state(sk))
+		return -1;
+
+	return wifi_getTcpStatIndex(get_socket_uid(sk));
+}
+
+static void wifi_updateCounter(struct sock *sk, int count, int lan, int web)
+{
+	int index = wifi_counter_index(sk, lan, web);
+	int slot;
+
+	if (index < 0)
 		return;
 
-	if (wifi_is_lan_sock(dest_addr) == true) {
-		index = lan;
-	} else {
-		index = web;
+	this_cpu_add(s_wifi_stat_pcpu.counter[index], count);
+
+	slot = wifi_uid_slot(sk);
+	if (slot >= 0)
+		this_cpu_add(s_wifi_stat_pcpu.uid_counter[slot][index], count);
+}
+
+/* current totals minus the baseline; called with s_snap_lock held */
+static void wifi_stat_snapshot(struct wifi_stat_sum *sum)
+{
+	struct wifi_stat_pcpu *pcpu;
+	unsigned int *dst = (unsigned int *)sum;
+	unsigned int *base = (unsigned int *)&s_baseline;
+	unsigned int *src;
+	size_t i, n = sizeof(*sum) / sizeof(unsigned int);
+	int cpu;
+
+	BUILD_BUG_ON(sizeof(struct wifi_stat_sum) != sizeof(struct wifi_stat_pcpu));
+
+	memset(sum, 0, sizeof(*sum));
+	for_each_possible_cpu(cpu) {
+		pcpu = per_cpu_ptr(&s_wifi_stat_pcpu, cpu);
+		src = (unsigned int *)pcpu;
+		for (i = 0; i < n; i++)
+			dst[i] += ACCESS_ONCE(src[i]);
 	}
 
-	s_WifiStatics[index] += count;
+	/* counters are free running, unsigned wrap gives the delta */
+	for (i = 0; i < n; i++)
+		dst[i] -= base[i];
+}
 
-	if (wifi_is_validate_state(sk)) {
-		updateTcpStatByUID(get_socket_uid(sk), index, count);
+/* start a new period at 'sum', releasing the slots idle in the last one */
+static void wifi_stat_rebase(const struct wifi_stat_sum *sum, bool all)
+{
+	unsigned int *dst = (unsigned int *)&s_baseline;
+	const unsigned int *delta = (const unsigned int *)sum;
+	size_t i, n = sizeof(*sum) / sizeof(unsigned int);
+	int slot, j;
+	bool idle;
+
+	for (i = 0; i < n; i++)
+		dst[i] += delta[i];
+
+	for (slot = 0; slot < WIFI_TCP_UID_SLOTS; slot++) {
+		idle = true;
+		for (j = 0; j < MAX_ARR_TITLE_COUNT; j++)
+			idle = idle && !sum->uid_counter[slot][j];
+		if (all || idle)
+			ACCESS_ONCE(s_uid_slot[slot]) = 0;
 	}
 }
 
@@ -233,16 +303,25 @@ static int wifi_network_stat_show(struct seq_file *seq, void *v)
 {
 	int i = 0, j = 0;
 	int bIndex = INDEX_SENDSEGS, eIndex = INDEX_WEBSNDDUPACKS;
-	int index = s_tcpstat_index;
+	struct wifi_stat_sum *sum;
+	uid_t uid;
+
 	if (s_ON == WIFI_STAT_OFF)
 		return 0;
 
+	sum = kmalloc(sizeof(*sum), GFP_KERNEL);
+	if (!sum)
+		return -ENOMEM;
+
+	mutex_lock(&s_snap_lock);
+	wifi_stat_snapshot(sum);
+
 #ifdef CONFIG_HW_WIFIPRO
-	s_WifiStatics[INDEX_WEB_SRTT] = wifipro_get_srtt();
+	sum->counter[INDEX_WEB_SRTT] = wifipro_get_srtt();
 #endif
 
 	for (i = 0; i < MAX_ARR_TITLE_COUNT; i++) {
-		seq_printf(seq, "%s=%u\n",   s_arrTitle[i],  s_WifiStatics[i]);
+		seq_printf(seq, "%s=%u\n",   s_arrTitle[i],  sum->counter[i]);
 	}
 
 	seq_puts(seq, "\nUID\t");
@@ -251,25 +330,92 @@ static int wifi_network_stat_show(struct seq_file *seq, void *v)
 	}
 	seq_puts(seq, "\n");
 
-	for (i = 0; i <  index && i < WIFI_MAX_UID_CNT ; i++) {
-		seq_printf(seq, "%u\t", __kuid_val(s_uidTcpStat[i].uid));
+	for (i = 0; i < WIFI_TCP_UID_SLOTS; i++) {
+		uid = ACCESS_ONCE(s_uid_slot[i]);
+		if (!uid)
+			continue;
+		seq_printf(seq, "%u\t", uid);
 		for (j = bIndex; j <= eIndex; j++) {
-			seq_printf(seq, "%u\t", s_uidTcpStat[i].counter[j]);
+			seq_printf(seq, "%u\t", sum->uid_counter[i][j]);
 		}
 
 		seq_puts(seq, "\n");
 	}
 
-	memset(s_uidTcpStat, 0, sizeof(s_uidTcpStat));
-	s_tcpstat_index = 0;
-	memset(s_WifiStatics, 0, sizeof(s_WifiStatics));
+	/* WEB_SRTT is a gauge, keep it out of the baseline */
+	sum->counter[INDEX_WEB_SRTT] = 0;
+	wifi_stat_rebase(sum, false);
+	mutex_unlock(&s_snap_lock);
+
+	kfree(sum);
 	return 0;
 }
 
+/*
+ * wifi_tcp_nl_dump - answer NETLINK_MSG_WIFI_TCP_DUMP with a struct
+ * wifi_tcp_stat_dump of the current period. Unlike the proc file it does
+ * not start a new period.
+ */
+static void wifi_tcp_nl_dump(u32 portid)
+{
+	struct wifi_stat_sum *sum;
+	struct wifi_tcp_stat_dump *dump;
+	struct nlmsghdr *nlh;
+	struct sk_buff *skb;
+	size_t size = sizeof(*dump) +
+		WIFI_TCP_UID_SLOTS * sizeof(struct wifi_tcp_uid_stat);
+	uid_t uid;
+	int i, nr = 0;
+
+	BUILD_BUG_ON(MAX_ARR_TITLE_COUNT != WIFI_TCP_STAT_COUNTERS);
+
+	sum = kmalloc(sizeof(*sum), GFP_KERNEL);
+	if (!sum)
+		return;
+
+	skb = nlmsg_new(size, GFP_KERNEL);
+	if (!skb)
+		goto out;
+
+	nlh = nlmsg_put(skb, 0, 0, NETLINK_MSG_WIFI_TCP_DUMP, size, 0);
+	if (!nlh) {
+		kfree_skb(skb);
+		goto out;
+	}
+	dump = nlmsg_data(nlh);
+	memset(dump, 0, size);
+
+	mutex_lock(&s_snap_lock);
+	wifi_stat_snapshot(sum);
+	for (i = 0; i < WIFI_TCP_UID_SLOTS; i++) {
+		uid = ACCESS_ONCE(s_uid_slot[i]);
+		if (!uid)
+			continue;
+		dump->uid[nr].uid = uid;
+		memcpy(dump->uid[nr].counter, sum->uid_counter[i],
+		       sizeof(dump->uid[nr].counter));
+		memcpy(dump->uid[nr].rtt_hist, sum->uid_rtt[i],
+		       sizeof(dump->uid[nr].rtt_hist));
+		nr++;
+	}
+	mutex_unlock(&s_snap_lock);
+
+	memcpy(dump->counter, sum->counter, sizeof(dump->counter));
+#ifdef CONFIG_HW_WIFIPRO
+	dump->counter[INDEX_WEB_SRTT] = wifipro_get_srtt();
+#endif
+	dump->nr_uid = nr;
+
+	(void)netlink_unicast(g_wifi_tcp_nlfd, skb, portid, MSG_DONTWAIT);
+out:
+	kfree(sum);
+}
+
 static void wifi_tcp_nl_receive(struct sk_buff *__skb)
 {
 	struct nlmsghdr *nlh;
 	struct sk_buff *skb;
+	struct wifi_stat_sum *sum;
 	skb = skb_get(__skb);
 
 	if (skb->len >= NLMSG_HDRLEN) {
@@ -282,9 +428,16 @@ static void wifi_tcp_nl_receive(struct sk_buff *__skb)
 				s_ON = WIFI_STAT_ON;
 			} else if (NETLINK_MSG_WIFI_TCP_STOP == nlh->nlmsg_type) {
 				s_ON = WIFI_STAT_OFF;
-				memset(s_WifiStatics, 0, sizeof(s_WifiStatics));
-				memset(s_uidTcpStat, 0, sizeof(s_uidTcpStat));
-				s_tcpstat_index = 0;
+				sum = kmalloc(sizeof(*sum), GFP_KERNEL);
+				if (sum) {
+					mutex_lock(&s_snap_lock);
+					wifi_stat_snapshot(sum);
+					wifi_stat_rebase(sum, true);
+					mutex_unlock(&s_snap_lock);
+					kfree(sum);
+				}
+			} else if (NETLINK_MSG_WIFI_TCP_DUMP == nlh->nlmsg_type) {
+				wifi_tcp_nl_dump(NETLINK_CB(skb).portid);
 			} else {
 				printk(KERN_ERR "#### %s:  wrong msg_type(%d)####\n",  __func__, nlh->nlmsg_type);
 			}
@@ -336,9 +489,25 @@ static const struct file_operations wifi_networktest = {
 
 void wifi_update_rtt(unsigned int rtt, struct sock *sk)
 {
+	int dur = wifi_counter_index(sk, INDEX_RTTDURATION, INDEX_WEBRTTDURATION);
+	int slot, bucket;
+
+	if (dur < 0)
+		return;
+
 	rtt = rtt/1000;   //us to ms
-	wifi_updateCounter(sk, rtt, INDEX_RTTDURATION, INDEX_WEBRTTDURATION);
-	wifi_updateCounter(sk, 1,   INDEX_RTTSEGS,   INDEX_WEBRTTSEGS);
+	/* the SEGS index follows the DURATION one, LAN and WEB alike */
+	this_cpu_add(s_wifi_stat_pcpu.counter[dur], rtt);
+	this_cpu_inc(s_wifi_stat_pcpu.counter[dur + 1]);
+
+	slot = wifi_uid_slot(sk);
+	if (slot < 0)
+		return;
+
+	bucket = rtt ? min_t(int, fls(rtt), WIFI_TCP_RTT_BUCKETS - 1) : 0;
+	this_cpu_add(s_wifi_stat_pcpu.uid_counter[slot][dur], rtt);
+	this_cpu_inc(s_wifi_stat_pcpu.uid_counter[slot][dur + 1]);
+	this_cpu_inc(s_wifi_stat_pcpu.uid_rtt[slot][bucket]);
 	/*print_socket_info(sk);*/
 }
 
@@ -1,6 +1,29 @@
 #ifndef _WIFI_TCP_STATISTICS_
 #define _WIFI_TCP_STATISTICS_
 
+#include <linux/types.h>
+
+/* netlink request: reply with a struct wifi_tcp_stat_dump */
+#define NETLINK_MSG_WIFI_TCP_DUMP  2
+
+#define WIFI_TCP_STAT_COUNTERS	19	/* SENDSEGS .. WEBSRTT */
+#define WIFI_TCP_UID_SLOTS	32	/* power of 2 */
+/* RTT histogram: bucket n counts [2^(n-1), 2^n) ms, bucket 0 below 1ms */
+#define WIFI_TCP_RTT_BUCKETS	12
+
+struct wifi_tcp_uid_stat {
+	__u32 uid;
+	__u32 counter[WIFI_TCP_STAT_COUNTERS];
+	__u32 rtt_hist[WIFI_TCP_RTT_BUCKETS];
+};
+
+/* counters since the last read of /proc/net/wifi_network_stat */
+struct wifi_tcp_stat_dump {
+	__u32 nr_uid;
+	__u32 counter[WIFI_TCP_STAT_COUNTERS];
+	struct wifi_tcp_uid_stat uid[0];
+};
+
 void wifi_update_rtt(unsigned int rtt, struct sock *sk);
 void wifi_IncrSendSegs(struct sock *sk, int count) ;
 void wifi_IncrRecvSegs(struct sock *sk, int count);
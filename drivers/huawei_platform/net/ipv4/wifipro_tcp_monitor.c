@@ -23,6 +23,8 @@
 #include <uapi/linux/netlink.h>
 #include <linux/kthread.h>
 #include <linux/string.h>
+#include <linux/percpu.h>
+#include <linux/vmalloc.h>
 #include <net/tcp.h>
 #include "wifipro_tcp_monitor.h"
 
@@ -45,6 +47,7 @@ DEFINE_MUTEX(wifipro_google_sock_sem);
 DEFINE_MUTEX(wifipro_congestion_sem);
 DEFINE_MUTEX(wifipro_trigger_sock_sem);
 DEFINE_MUTEX(wifipro_tcp_trigger_inf_sem);
+DEFINE_MUTEX(wifipro_tm_sem);
 
 #define LINK_UNKNOWN                0
 #define LINK_POOR                   1
@@ -60,7 +63,9 @@ enum wifipro_KnlMsgType {
 	NETLINK_WIFIPRO_CONTINUE_MONITOR,
 	NETLINK_WIFIPRO_NOTIFY_MCC,
 	NETLINK_WIFIPRO_RESET_RTT,
-	NETLINK_WIFIPRO_GET_RTT
+	NETLINK_WIFIPRO_GET_RTT,
+	NETLINK_WIFIPRO_SET_TELEMETRY,	/*nlmsg_flags: report interval in ms, 0 stops */
+	NETLINK_WIFIPRO_TELEMETRY	/*kernel report to WIFIPRO_TM_NLGRP */
 };
 
 enum wifipro_msg_from {
@@ -84,6 +89,31 @@ struct wifipro_nl_packet_msg {
 	unsigned int tcp_retrans_pkts;
 };
 
+/*
+ * Telemetry report, multicast every interval to WIFIPRO_TM_NLGRP: one
+ * record per interface for all UIDs (uid = WIFIPRO_TM_ALL_UIDS), then one
+ * per active UID. Figures cover the last WIFIPRO_TM_WINDOWS intervals.
+ */
+struct wifipro_tm_record {
+	unsigned int iface;	/*WIFIPRO_TM_WLAN or WIFIPRO_TM_MOBILE */
+	unsigned int uid;
+	unsigned int rtt_samples;
+	unsigned int rtt_p50;	/*ms */
+	unsigned int rtt_p90;
+	unsigned int rtt_p99;
+	unsigned int out_segs;
+	unsigned int retrans_segs;
+	unsigned int retrans_permille;	/*of all segments sent */
+	unsigned int tx_goodput;	/*kbit/s, bytes acked by the peer */
+	unsigned int rx_goodput;	/*kbit/s, bytes received in order */
+};
+
+struct wifipro_tm_msg {
+	unsigned int window_ms;
+	unsigned int nr_records;
+	struct wifipro_tm_record records[0];
+};
+
 #ifdef CONFIG_HW_WIFIPRO_PROC
 static const struct snmp_mib wifipro_snmp_tcp_list[] = {
 	SNMP_MIB_ITEM("Unknown InSegs", WIFIPRO_TCP_MIB_INSEGS),
@@ -104,6 +134,7 @@ static const struct snmp_mib wifipro_snmp_tcp_list[] = {
 
 static void wifipro_rtt_monitor_deinit(void);
 static void wifipro_cancel_task(void);
+static int wifipro_tm_set_interval(unsigned int interval_ms);
 
 bool is_wifipro_on = false;
 bool is_mcc_china = true;
@@ -917,6 +948,10 @@ static void wifipro_tcp_monitor_nl_receive(struct sk_buff *__skb)
 				}
 				break;
 
+			case NETLINK_WIFIPRO_SET_TELEMETRY:
+				wifipro_tm_set_interval(nlh->nlmsg_flags);
+				break;
+
 			default:
 				WIFIPRO_WARNING
 				    ("unvalid msg type, nlmsg_type = %d",
@@ -1481,6 +1516,424 @@ static void wifipro_rtt_monitor_deinit(void)
 	wlan_rtt_second_stat_head = NULL;
 }
 
+/*
+ * Connection level telemetry: RTT percentiles, retransmission rate and
+ * goodput per interface and UID, over a sliding window of
+ * WIFIPRO_TM_WINDOWS intervals, pushed as one multicast per interval.
+ *
+ * The TCP hooks only bump free running per-cpu counters. The work folds
+ * them every interval, keeps the deltas in a ring of windows and sums the
+ * ring for the report.
+ */
+#define WIFIPRO_TM_WLAN			0
+#define WIFIPRO_TM_MOBILE		1
+#define WIFIPRO_TM_IFACES		2
+#define WIFIPRO_TM_UIDS			6
+#define WIFIPRO_TM_SLOTS		(WIFIPRO_TM_UIDS + 1)	/*slot 0: all UIDs */
+#define WIFIPRO_TM_ALL_UIDS		0xFFFFFFFF
+#define WIFIPRO_TM_WINDOWS		8
+#define WIFIPRO_TM_RTT_BUCKETS		48
+#define WIFIPRO_TM_MIN_INTERVAL		100
+#define WIFIPRO_TM_NLGRP		1
+
+struct wifipro_tm_counters {
+	u32 rtt[WIFIPRO_TM_RTT_BUCKETS];
+	u32 out_segs;
+	u32 retrans_segs;
+	u32 bytes_acked;
+	u32 bytes_received;
+};
+
+struct wifipro_tm_stat {
+	struct wifipro_tm_counters c[WIFIPRO_TM_IFACES][WIFIPRO_TM_SLOTS];
+};
+
+#define WIFIPRO_TM_WORDS (sizeof(struct wifipro_tm_stat) / sizeof(u32))
+
+static unsigned int wifipro_tm_interval_ms;
+static struct wifipro_tm_stat __percpu *wifipro_tm_pcpu;
+/*uid + 1 of each slot, 0 when free */
+static u32 wifipro_tm_uid[WIFIPRO_TM_UIDS];
+/*work only: totals at the last fold and the deltas of the last windows */
+static struct wifipro_tm_stat *wifipro_tm_prev;
+static struct wifipro_tm_stat *wifipro_tm_ring;
+static struct wifipro_tm_stat *wifipro_tm_sum;
+static unsigned int wifipro_tm_head;
+static struct delayed_work wifipro_tm_work;
+
+/*
+ * RTT buckets in ms: 0..3 exact, then four buckets per power of two,
+ * i.e. about 25% wide, up to 8s.
+ */
+static unsigned int wifipro_tm_rtt_bucket(u32 ms)
+{
+	unsigned int msb, idx;
+
+	if (ms < 4)
+		return ms;
+
+	msb = fls(ms) - 1;
+	idx = (msb - 1) * 4 + ((ms >> (msb - 2)) & 3);
+	return min_t(unsigned int, idx, WIFIPRO_TM_RTT_BUCKETS - 1);
+}
+
+/*upper bound of a bucket, in ms */
+static unsigned int wifipro_tm_rtt_value(unsigned int idx)
+{
+	unsigned int msb, sub;
+
+	if (idx < 4)
+		return idx;
+
+	msb = idx / 4 + 1;
+	sub = idx % 4;
+	return ((4 + sub + 1) << (msb - 2)) - 1;
+}
+
+static int wifipro_tm_iface(struct sock *sk)
+{
+	if (!ACCESS_ONCE(wifipro_tm_interval_ms) || !wifipro_tm_pcpu || !sk)
+		return -1;
+
+	if (!wifipro_is_not_local_or_lan_sock(htonl(inet_sk(sk)->inet_daddr)))
+		return -1;
+
+	if (!strncmp(sk->wifipro_dev_name, "wlan", 4))
+		return WIFIPRO_TM_WLAN;
+	if (!strncmp(sk->wifipro_dev_name, "rmnet", 5))
+		return WIFIPRO_TM_MOBILE;
+	return -1;
+}
+
+/*slot of the socket's UID, claimed if needed, or 0 when all are taken */
+static int wifipro_tm_slot(struct sock *sk)
+{
+	u32 val = __kuid_val(sock_i_uid(sk)) + 1;
+	int i;
+
+	if (!val)
+		return 0;
+
+	for (i = 0; i < WIFIPRO_TM_UIDS; i++) {
+		if (ACCESS_ONCE(wifipro_tm_uid[i]) == val)
+			return i + 1;
+	}
+
+	for (i = 0; i < WIFIPRO_TM_UIDS; i++) {
+		if (!ACCESS_ONCE(wifipro_tm_uid[i]) &&
+		    !cmpxchg(&wifipro_tm_uid[i], 0, val))
+			return i + 1;
+	}
+
+	return 0;
+}
+
+void wifipro_tm_update_rtt(struct sock *sk, u32 rtt_us)
+{
+	int iface = wifipro_tm_iface(sk);
+	unsigned int bucket;
+	int slot;
+
+	if (iface < 0)
+		return;
+
+	bucket = wifipro_tm_rtt_bucket(rtt_us / USEC_PER_MSEC);
+	this_cpu_inc(wifipro_tm_pcpu->c[iface][0].rtt[bucket]);
+	slot = wifipro_tm_slot(sk);
+	if (slot)
+		this_cpu_inc(wifipro_tm_pcpu->c[iface][slot].rtt[bucket]);
+}
+
+void wifipro_tm_update_segs(struct sock *sk, unsigned int segs, bool retrans)
+{
+	int iface = wifipro_tm_iface(sk);
+	int slot;
+
+	if (iface < 0)
+		return;
+
+	slot = wifipro_tm_slot(sk);
+	if (retrans) {
+		this_cpu_add(wifipro_tm_pcpu->c[iface][0].retrans_segs, segs);
+		if (slot)
+			this_cpu_add(wifipro_tm_pcpu->c[iface][slot].retrans_segs,
+				     segs);
+	} else {
+		this_cpu_add(wifipro_tm_pcpu->c[iface][0].out_segs, segs);
+		if (slot)
+			this_cpu_add(wifipro_tm_pcpu->c[iface][slot].out_segs,
+				     segs);
+	}
+}
+
+void wifipro_tm_update_bytes(struct sock *sk, u32 bytes, bool acked)
+{
+	int iface = wifipro_tm_iface(sk);
+	int slot;
+
+	if (iface < 0 || !bytes)
+		return;
+
+	slot = wifipro_tm_slot(sk);
+	if (acked) {
+		this_cpu_add(wifipro_tm_pcpu->c[iface][0].bytes_acked, bytes);
+		if (slot)
+			this_cpu_add(wifipro_tm_pcpu->c[iface][slot].bytes_acked,
+				     bytes);
+	} else {
+		this_cpu_add(wifipro_tm_pcpu->c[iface][0].bytes_received, bytes);
+		if (slot)
+			this_cpu_add(wifipro_tm_pcpu->c[iface][slot].bytes_received,
+				     bytes);
+	}
+}
+
+/*
+ * Fold the per-cpu counters into a new window: the deltas since the last
+ * fold, the counters being free running.
+ */
+static void wifipro_tm_fold(struct wifipro_tm_stat *win)
+{
+	u32 *dst = (u32 *)win;
+	u32 *prev = (u32 *)wifipro_tm_prev;
+	u32 *src;
+	u32 val;
+	size_t i;
+	int cpu;
+
+	memset(win, 0, sizeof(*win));
+	for_each_possible_cpu(cpu) {
+		src = (u32 *)per_cpu_ptr(wifipro_tm_pcpu, cpu);
+		for (i = 0; i < WIFIPRO_TM_WORDS; i++)
+			dst[i] += ACCESS_ONCE(src[i]);
+	}
+
+	for (i = 0; i < WIFIPRO_TM_WORDS; i++) {
+		val = dst[i];
+		dst[i] -= prev[i];
+		prev[i] = val;
+	}
+}
+
+static unsigned int wifipro_tm_percentile(const struct wifipro_tm_counters *c,
+					  unsigned int samples,
+					  unsigned int pct)
+{
+	unsigned int idx;
+	u64 cum = 0;
+
+	for (idx = 0; idx < WIFIPRO_TM_RTT_BUCKETS; idx++) {
+		cum += c->rtt[idx];
+		if (cum * 100 >= (u64)samples * pct)
+			break;
+	}
+
+	return wifipro_tm_rtt_value(min_t(unsigned int, idx,
+					  WIFIPRO_TM_RTT_BUCKETS - 1));
+}
+
+static bool wifipro_tm_fill(struct wifipro_tm_record *rec,
+			    const struct wifipro_tm_counters *c,
+			    unsigned int iface, unsigned int uid,
+			    unsigned int window_ms)
+{
+	unsigned int i, samples = 0;
+
+	for (i = 0; i < WIFIPRO_TM_RTT_BUCKETS; i++)
+		samples += c->rtt[i];
+
+	if (!samples && !c->out_segs && !c->retrans_segs &&
+	    !c->bytes_acked && !c->bytes_received)
+		return false;
+
+	memset(rec, 0, sizeof(*rec));
+	rec->iface = iface;
+	rec->uid = uid;
+	rec->rtt_samples = samples;
+	if (samples) {
+		rec->rtt_p50 = wifipro_tm_percentile(c, samples, 50);
+		rec->rtt_p90 = wifipro_tm_percentile(c, samples, 90);
+		rec->rtt_p99 = wifipro_tm_percentile(c, samples, 99);
+	}
+	rec->out_segs = c->out_segs;
+	rec->retrans_segs = c->retrans_segs;
+	if (c->out_segs + c->retrans_segs)
+		rec->retrans_permille = (u32)div_u64((u64)c->retrans_segs * 1000,
+						     c->out_segs + c->retrans_segs);
+	/*bytes * 8 / ms is kbit/s */
+	rec->tx_goodput = (u32)div_u64((u64)c->bytes_acked * 8, window_ms);
+	rec->rx_goodput = (u32)div_u64((u64)c->bytes_received * 8, window_ms);
+	return true;
+}
+
+static void wifipro_tm_report(unsigned int window_ms)
+{
+	struct wifipro_tm_msg *msg;
+	struct sk_buff *skb;
+	struct nlmsghdr *nlh;
+	unsigned int iface, slot, uid, nr = 0;
+	int size;
+
+	if (!netlink_has_listeners(g_wifipro_nlfd, WIFIPRO_TM_NLGRP))
+		return;
+
+	size = sizeof(*msg) + WIFIPRO_TM_IFACES * WIFIPRO_TM_SLOTS *
+	       sizeof(struct wifipro_tm_record);
+	skb = nlmsg_new(size, GFP_KERNEL);
+	if (!skb) {
+		WIFIPRO_ERROR("alloc skb fail");
+		return;
+	}
+
+	nlh = nlmsg_put(skb, 0, 0, NETLINK_WIFIPRO_TELEMETRY, size, 0);
+	if (!nlh) {
+		kfree_skb(skb);
+		return;
+	}
+
+	msg = nlmsg_data(nlh);
+	for (iface = 0; iface < WIFIPRO_TM_IFACES; iface++) {
+		for (slot = 0; slot < WIFIPRO_TM_SLOTS; slot++) {
+			uid = slot ? ACCESS_ONCE(wifipro_tm_uid[slot - 1]) - 1 :
+				     WIFIPRO_TM_ALL_UIDS;
+			if (slot && uid == WIFIPRO_TM_ALL_UIDS)
+				continue;
+			if (wifipro_tm_fill(&msg->records[nr],
+					    &wifipro_tm_sum->c[iface][slot],
+					    iface, uid, window_ms))
+				nr++;
+		}
+	}
+	msg->window_ms = window_ms;
+	msg->nr_records = nr;
+	nlmsg_trim(skb, &msg->records[nr]);
+	nlh->nlmsg_len = skb_tail_pointer(skb) - (unsigned char *)nlh;
+
+	nlmsg_multicast(g_wifipro_nlfd, skb, 0, WIFIPRO_TM_NLGRP, GFP_KERNEL);
+}
+
+/*
+ * Free the UID slots idle over the whole ring. A hook racing with the
+ * release may still count one sample into the slot, which is then
+ * attributed to the next UID claiming it.
+ */
+static void wifipro_tm_release_idle(void)
+{
+	unsigned int iface, slot;
+	u32 *w;
+	size_t i, n = sizeof(struct wifipro_tm_counters) / sizeof(u32);
+	bool idle;
+
+	for (slot = 1; slot < WIFIPRO_TM_SLOTS; slot++) {
+		idle = true;
+		for (iface = 0; iface < WIFIPRO_TM_IFACES && idle; iface++) {
+			w = (u32 *)&wifipro_tm_sum->c[iface][slot];
+			for (i = 0; i < n && idle; i++)
+				idle = !w[i];
+		}
+		if (idle)
+			ACCESS_ONCE(wifipro_tm_uid[slot - 1]) = 0;
+	}
+}
+
+static void wifipro_tm_work_handler(struct work_struct *work)
+{
+	unsigned int interval_ms = ACCESS_ONCE(wifipro_tm_interval_ms);
+	u32 *sum = (u32 *)wifipro_tm_sum;
+	u32 *win;
+	unsigned int w;
+	size_t i;
+
+	if (!interval_ms)
+		return;
+
+	wifipro_tm_fold(&wifipro_tm_ring[wifipro_tm_head % WIFIPRO_TM_WINDOWS]);
+	wifipro_tm_head++;
+
+	memset(wifipro_tm_sum, 0, sizeof(*wifipro_tm_sum));
+	for (w = 0; w < WIFIPRO_TM_WINDOWS; w++) {
+		win = (u32 *)&wifipro_tm_ring[w];
+		for (i = 0; i < WIFIPRO_TM_WORDS; i++)
+			sum[i] += win[i];
+	}
+
+	wifipro_tm_report(interval_ms *
+			  min_t(unsigned int, wifipro_tm_head,
+				WIFIPRO_TM_WINDOWS));
+	if (wifipro_tm_head >= WIFIPRO_TM_WINDOWS)
+		wifipro_tm_release_idle();
+
+	schedule_delayed_work(&wifipro_tm_work, msecs_to_jiffies(interval_ms));
+}
+
+static int wifipro_tm_alloc(void)
+{
+	if (!wifipro_tm_pcpu) {
+		wifipro_tm_pcpu = alloc_percpu(struct wifipro_tm_stat);
+		if (!wifipro_tm_pcpu)
+			return -ENOMEM;
+	}
+
+	if (!wifipro_tm_ring) {
+		/*prev, sum, then the windows */
+		wifipro_tm_prev = vzalloc((WIFIPRO_TM_WINDOWS + 2) *
+					  sizeof(struct wifipro_tm_stat));
+		if (!wifipro_tm_prev)
+			return -ENOMEM;
+		wifipro_tm_sum = wifipro_tm_prev + 1;
+		wifipro_tm_ring = wifipro_tm_prev + 2;
+	}
+
+	return 0;
+}
+
+static void wifipro_tm_free(void)
+{
+	free_percpu(wifipro_tm_pcpu);
+	wifipro_tm_pcpu = NULL;
+	vfree(wifipro_tm_prev);
+	wifipro_tm_prev = NULL;
+	wifipro_tm_sum = NULL;
+	wifipro_tm_ring = NULL;
+}
+
+/*0 stops the reports, otherwise the report interval in ms */
+static int wifipro_tm_set_interval(unsigned int interval_ms)
+{
+	int ret = 0;
+
+	mutex_lock(&wifipro_tm_sem);
+	if (!interval_ms) {
+		ACCESS_ONCE(wifipro_tm_interval_ms) = 0;
+		cancel_delayed_work_sync(&wifipro_tm_work);
+		goto end;
+	}
+
+	interval_ms = max_t(unsigned int, interval_ms,
+			    WIFIPRO_TM_MIN_INTERVAL);
+	if (!wifipro_tm_interval_ms) {
+		ret = wifipro_tm_alloc();
+		if (ret) {
+			WIFIPRO_ERROR("telemetry alloc failed");
+			goto end;
+		}
+
+		/*start from the current totals with an empty ring */
+		wifipro_tm_fold(wifipro_tm_ring);
+		memset(wifipro_tm_ring, 0,
+		       WIFIPRO_TM_WINDOWS * sizeof(struct wifipro_tm_stat));
+		wifipro_tm_head = 0;
+	}
+
+	ACCESS_ONCE(wifipro_tm_interval_ms) = interval_ms;
+	mod_delayed_work(system_wq, &wifipro_tm_work,
+			 msecs_to_jiffies(interval_ms));
+	WIFIPRO_INFO("telemetry every %ums", interval_ms);
+end:
+	mutex_unlock(&wifipro_tm_sem);
+	return ret;
+}
+
 static int __init wifipro_tcp_monitor_module_init(void)
 {
 	struct netlink_kernel_cfg wifipro_tcp_monitor_nl_cfg = {
@@ -1497,6 +1950,7 @@ static int __init wifipro_tcp_monitor_module_init(void)
 	INIT_WORK(&wifipro_tcp_retrans_work, wifipro_tcp_retrans_work_handler);
 	INIT_DELAYED_WORK(&wifipro_tcp_monitor_work,
 			  wifipro_tcp_monitor_work_handler);
+	INIT_DELAYED_WORK(&wifipro_tm_work, wifipro_tm_work_handler);
 
 	wifipro_tcp_trigger_inf =
 	    kzalloc(sizeof(struct wifipro_tcp_monitor_inf), GFP_KERNEL);
@@ -1553,6 +2007,9 @@ static void __exit wifipro_tcp_monitor_module_exit(void)
 {
 	wifipro_cancel_task();
 	wifipro_rtt_monitor_deinit();
+	wifipro_tm_set_interval(0);
+	synchronize_net();
+	wifipro_tm_free();
 
 	if (g_wifipro_nlfd && g_wifipro_nlfd->sk_socket) {
 		sock_release(g_wifipro_nlfd->sk_socket);
@@ -141,6 +141,9 @@ bool wifipro_is_trigger_sock(unsigned int dest_addr, unsigned int dest_port);
 int wifipro_init_proc(struct net *net);
 void wifipro_update_rtt(unsigned int rtt, struct sock *sk);
 void wifipro_update_tcp_statistics(int mib_type, const struct sk_buff *skb, struct sock *from_sk);
+void wifipro_tm_update_rtt(struct sock *sk, u32 rtt_us);
+void wifipro_tm_update_segs(struct sock *sk, unsigned int segs, bool retrans);
+void wifipro_tm_update_bytes(struct sock *sk, u32 bytes, bool acked);
 
 static inline bool wifipro_is_not_local_or_lan_sock(unsigned int ip_addr)
 {
@@ -113,6 +113,11 @@ extern int bastet_send_msg(struct bst_sock_id *guide, uint8_t *data, uint32_t le
 extern int bastet_set_hb_reply(struct bst_sock_id *guide, uint8_t *data, uint32_t len);
 extern int bastet_filter_hb_reply(struct bst_sock_id *guide);
 extern int bastet_set_freezer(struct freezer_state freezer);
+extern int bastet_sched_hb(struct heartbeat_sched *sched, uint8_t *content);
+extern int bastet_cancel_hb(struct bst_sock_id *guide);
+extern void bastet_clear_hb(void);
+extern void bastet_hb_init(void);
+extern void bastet_hb_exit(void);
 /*
  * Indicate Message Api
  */
@@ -704,6 +709,51 @@ static long bastet_ioctl(struct file *flip, unsigned int cmd, unsigned long arg)
 		rc = 0;
 		break;
 	}
+	case BST_IOC_SCHED_HB: {
+		/*
+		 * let the kernel send the heartbeat periodically,
+		 * batched with the heartbeats of other sockets
+		 */
+		struct heartbeat_sched sched;
+		uint8_t *content = NULL;
+
+		if (copy_from_user(&sched,
+			argp, sizeof(struct heartbeat_sched))) {
+			rc = -EFAULT;
+			break;
+		}
+		if (sched.len == 0 || sched.len > BST_MAX_WRITE_PAYLOAD) {
+			rc = -EINVAL;
+			break;
+		}
+		content = (uint8_t *) kmalloc(sched.len, GFP_KERNEL);
+		if (NULL == content) {
+			BASTET_LOGE("failed to kmalloc heartbeat data");
+			rc = -ENOMEM;
+			break;
+		}
+		if (copy_from_user(content,
+			argp + sizeof(struct heartbeat_sched), sched.len)) {
+			kfree(content);
+			rc = -EFAULT;
+			break;
+		}
+		/*
+		 * the schedule owns the content from now on
+		 */
+		rc = bastet_sched_hb(&sched, content);
+		break;
+	}
+	case BST_IOC_CANCEL_HB: {
+		struct bst_sock_id guide;
+
+		if (copy_from_user(&guide, argp, sizeof(struct bst_sock_id))) {
+			rc = -EFAULT;
+			break;
+		}
+		rc = bastet_cancel_hb(&guide);
+		break;
+	}
 	default: {
 		BASTET_LOGE("unknown ioctl: %d", cmd);
 		break;
@@ -871,6 +921,7 @@ out_release:
 	bastet_dev_en = false;
 	spin_unlock_bh(&bastet_data.read_lock);
 	bastet_partner_release();
+	bastet_clear_hb();
 	BASTET_LOGI("success");
 
 	return 0;
@@ -913,6 +964,7 @@ static int bastet_probe(struct platform_device *pdev)
 	bastet_partner_init();
 	BST_FG_Init();
 	bastet_filter_init();
+	bastet_hb_init();
 	/* register bastet major and minor number */
 	ret = alloc_chrdev_region(&bastet_dev,
 		BST_FIRST_MINOR, BST_DEVICES_NUMBER, BASTET_NAME);
@@ -964,6 +1016,7 @@ static int bastet_remove(struct platform_device *pdev)
 	}
 	cdev_del(&bastet_cdev);
 	unregister_chrdev_region(bastet_dev, BST_DEVICES_NUMBER);
+	bastet_hb_exit();
 	bastet_utils_exit();
 
 	return 0;
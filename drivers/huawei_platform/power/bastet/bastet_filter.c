@@ -19,6 +19,11 @@
 #include <linux/file.h>
 #include <net/tcp.h>
 #include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/rcupdate.h>
+#include <linux/sort.h>
+#include <linux/workqueue.h>
 #include <uapi/linux/netfilter_ipv6.h>
 #include <huawei_platform/power/bastet/bastet_utils.h>
 #include <net/icmp.h> /*icmp_send*/
@@ -31,9 +36,58 @@ struct st_proc_info_node {
 	struct list_head list;
 };
 
+/* accounting of the white list is reported to user space once a minute */
+#define BST_FILTER_FLUSH_INTERVAL	(60 * HZ)
+
+struct bst_filter_stat {
+	u64 bytes;
+	u64 packets;
+};
+
+struct bst_filter_rule {
+	int32_t uid;
+	int32_t pid;
+	struct bst_filter_stat last;	/* totals at the previous flush */
+};
+
+/*
+ * The white list compiled for the LOCAL_OUT hook: rules sorted by uid and
+ * pid, and one per-cpu counter per rule plus one for dropped packets, so
+ * the hook neither locks nor writes shared cache lines. Rebuilt on every
+ * change of the list and replaced under RCU.
+ */
+struct bst_filter_table {
+	int num;
+	struct bst_filter_stat __percpu *stats;	/* num + 1, the last drops */
+	struct bst_filter_stat drop_last;
+	struct bst_filter_rule rules[0];
+};
+
+#pragma pack(1)
+struct bst_filter_stat_info {
+	__s32 uid;
+	__s32 pid;
+	__u64 bytes;
+	__u64 packets;
+};
+
+struct bst_filter_stat_buf {
+	__s32 num;
+	struct bst_filter_stat_info info[0];
+};
+#pragma pack()
+
 struct list_head g_white_list_head;
 static spinlock_t proc_info_lock;
 static int g_special_uid;
+
+/* serializes list changes, table rebuilds and flushes */
+static DEFINE_MUTEX(filter_table_sem);
+static struct bst_filter_table __rcu *filter_table;
+
+static void bastet_filter_flush_work(struct work_struct *work);
+static DECLARE_DELAYED_WORK(filter_flush_work, bastet_filter_flush_work);
+
 /**
  * Function: get_process_info_by_skb
  * Description: get uid and pid by skb
@@ -62,6 +116,39 @@ static void get_process_info_by_skb(struct sk_buff *skb,
 #endif
 	info->pid = current->pid;
 }
+/*
+ * Function: bastet_filter_lookup
+ * Description: find the rule matching uid and pid, the special uid must
+ *				match the pid too, any other uid matches its first rule
+ * Input:	@tbl - compiled white list
+ *			@info - uid and pid of the packet
+ * Output:
+ * Return:	index of the rule, -1 if there is none
+ */
+static int bastet_filter_lookup(const struct bst_filter_table *tbl,
+	const struct set_process_info *info)
+{
+	int lo = 0;
+	int hi = tbl->num;
+	int mid;
+
+	/* first rule with rules[].uid >= uid */
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (tbl->rules[mid].uid < info->uid)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (; lo < tbl->num && tbl->rules[lo].uid == info->uid; lo++) {
+		if (info->uid != ACCESS_ONCE(g_special_uid)
+			|| tbl->rules[lo].pid == info->pid)
+			return lo;
+	}
+	return -1;
+}
+
 /*
  * Function: hook_ipv4_local_out_cb
  * Description: netfilter hook call back function on ipv4 LOCAL_OUT
@@ -80,58 +167,37 @@ static unsigned int hook_local_out_cb(unsigned int hooknum,
 	const struct net_device *out,
 	int (*okfn)(struct sk_buff *))
 {
-
-
 	struct set_process_info info;
-	struct list_head *pos;
-	struct st_proc_info_node *tmp_node;
-	bool found = false;
+	struct bst_filter_table *tbl;
+	int idx = -1;
 
 	info.pid = -1;
 	info.uid = -1;
 	get_process_info_by_skb(skb, &info);
 
-	BASTET_LOGI("uid=%d,pid=%d", info.uid, info.pid);
-	spin_lock_bh(&proc_info_lock);
-	if (list_empty(&g_white_list_head)) {
-		spin_unlock_bh(&proc_info_lock);
-		BASTET_LOGE("ipv4 NF_DROP1");
-		return NF_DROP;
-	}
-	list_for_each(pos, &g_white_list_head) {
-		tmp_node = list_entry(pos, struct st_proc_info_node, list);
-		BASTET_LOGI("uid=%d,pid=%d",
-			tmp_node->info.uid, tmp_node->info.pid);
-		if (tmp_node->info.uid != info.uid)
-			continue;
-		if (tmp_node->info.uid != g_special_uid) {
-			BASTET_LOGI("uid=%d not %d match success",
-				info.uid, g_special_uid);
-			found = true;
-			break;
+	rcu_read_lock();
+	tbl = rcu_dereference(filter_table);
+	if (tbl) {
+		idx = bastet_filter_lookup(tbl, &info);
+		if (idx < 0) {
+			this_cpu_add(tbl->stats[tbl->num].bytes, skb->len);
+			this_cpu_inc(tbl->stats[tbl->num].packets);
 		} else {
-			if (tmp_node->info.pid == info.pid) {
-				BASTET_LOGI("uid=%d,pid=%d match success",
-					info.uid, info.pid);
-				found = true;
-				break;
-			}
+			this_cpu_add(tbl->stats[idx].bytes, skb->len);
+			this_cpu_inc(tbl->stats[idx].packets);
 		}
 	}
+	rcu_read_unlock();
 
-	if (found) {
-		BASTET_LOGE("ipv4 NF_ACCEPT");
-		spin_unlock_bh(&proc_info_lock);
+	if (idx >= 0)
 		return NF_ACCEPT;
-	} else {
-		BASTET_LOGE("ipv4 NF_DROP2");
-		if (skb->sk) {
-			skb->sk->sk_err = icmp_err_convert[ICMP_NET_ANO].errno;
-			skb->sk->sk_error_report(skb->sk);
-		}
-		spin_unlock_bh(&proc_info_lock);
-		return NF_DROP;
+
+	BASTET_LOGE("uid=%d,pid=%d NF_DROP", info.uid, info.pid);
+	if (skb->sk) {
+		skb->sk->sk_err = icmp_err_convert[ICMP_NET_ANO].errno;
+		skb->sk->sk_error_report(skb->sk);
 	}
+	return NF_DROP;
 }
 
 static struct nf_hook_ops ipv4_local_out_ops = {
@@ -250,6 +316,143 @@ static int del_all_proc_info_from_white_list(void)
 	return 0;
 }
 
+static int bastet_filter_rule_cmp(const void *a, const void *b)
+{
+	const struct bst_filter_rule *ra = a;
+	const struct bst_filter_rule *rb = b;
+
+	if (ra->uid != rb->uid)
+		return ra->uid < rb->uid ? -1 : 1;
+	if (ra->pid != rb->pid)
+		return ra->pid < rb->pid ? -1 : 1;
+	return 0;
+}
+
+static void bastet_filter_stat_sum(const struct bst_filter_table *tbl,
+	int idx, struct bst_filter_stat *sum)
+{
+	struct bst_filter_stat *stat;
+	int cpu;
+
+	sum->bytes = 0;
+	sum->packets = 0;
+	for_each_possible_cpu(cpu) {
+		stat = per_cpu_ptr(tbl->stats, cpu) + idx;
+		sum->bytes += stat->bytes;
+		sum->packets += stat->packets;
+	}
+}
+
+/*
+ * Function: bastet_filter_flush
+ * Description: report the traffic accounted since the previous flush,
+ *				one entry per rule that saw traffic, dropped packets
+ *				with uid and pid -1. filter_table_sem must be held.
+ * Input:	@tbl - compiled white list
+ * Output:
+ * Return:
+ */
+static void bastet_filter_flush(struct bst_filter_table *tbl)
+{
+	struct bst_filter_stat_buf *buf;
+	struct bst_filter_stat_info *ind;
+	struct bst_filter_stat *last;
+	struct bst_filter_stat sum;
+	int i, num = 0;
+
+	if (!tbl)
+		return;
+
+	buf = kmalloc(sizeof(*buf) + (tbl->num + 1) * sizeof(*ind),
+		GFP_KERNEL);
+	if (NULL == buf) {
+		BASTET_LOGE("kmalloc stat buf failed");
+		return;
+	}
+
+	for (i = 0; i <= tbl->num; i++) {
+		last = i < tbl->num ? &tbl->rules[i].last : &tbl->drop_last;
+		bastet_filter_stat_sum(tbl, i, &sum);
+		if (sum.packets == last->packets)
+			continue;
+
+		ind = &buf->info[num++];
+		ind->uid = i < tbl->num ? tbl->rules[i].uid : -1;
+		ind->pid = i < tbl->num ? tbl->rules[i].pid : -1;
+		ind->bytes = sum.bytes - last->bytes;
+		ind->packets = sum.packets - last->packets;
+		*last = sum;
+	}
+
+	if (num > 0) {
+		buf->num = num;
+		post_indicate_packet(BST_IND_FILTER_STAT, buf,
+			sizeof(*buf) + num * sizeof(*ind));
+	}
+	kfree(buf);
+}
+
+static void bastet_filter_flush_work(struct work_struct *work)
+{
+	mutex_lock(&filter_table_sem);
+	bastet_filter_flush(rcu_dereference_protected(filter_table,
+		lockdep_is_held(&filter_table_sem)));
+	mutex_unlock(&filter_table_sem);
+
+	schedule_delayed_work(&filter_flush_work, BST_FILTER_FLUSH_INTERVAL);
+}
+
+/*
+ * Function: bastet_filter_rebuild
+ * Description: compile the white list into a new table, replace the
+ *				current one and report what it accounted.
+ *				filter_table_sem must be held.
+ * Input:
+ * Output:
+ * Return:	0 on success, -ENOMEM if the old table stays in place
+ */
+static int bastet_filter_rebuild(void)
+{
+	struct bst_filter_table *tbl, *old;
+	struct st_proc_info_node *node;
+	int num = 0;
+
+	list_for_each_entry(node, &g_white_list_head, list)
+		num++;
+
+	tbl = kzalloc(sizeof(*tbl) + num * sizeof(tbl->rules[0]), GFP_KERNEL);
+	if (NULL == tbl)
+		return -ENOMEM;
+
+	tbl->stats = __alloc_percpu((num + 1) * sizeof(struct bst_filter_stat),
+		__alignof__(struct bst_filter_stat));
+	if (NULL == tbl->stats) {
+		kfree(tbl);
+		return -ENOMEM;
+	}
+
+	spin_lock_bh(&proc_info_lock);
+	list_for_each_entry(node, &g_white_list_head, list) {
+		tbl->rules[tbl->num].uid = node->info.uid;
+		tbl->rules[tbl->num].pid = node->info.pid;
+		tbl->num++;
+	}
+	spin_unlock_bh(&proc_info_lock);
+	sort(tbl->rules, tbl->num, sizeof(tbl->rules[0]),
+		bastet_filter_rule_cmp, NULL);
+
+	old = rcu_dereference_protected(filter_table,
+		lockdep_is_held(&filter_table_sem));
+	rcu_assign_pointer(filter_table, tbl);
+	if (old) {
+		synchronize_net();
+		bastet_filter_flush(old);
+		free_percpu(old->stats);
+		kfree(old);
+	}
+	return 0;
+}
+
 /**
  * Function: set_proc_info
  * Description: set process_info
@@ -263,6 +466,7 @@ int set_proc_info(struct set_process_info *info)
 {
 	int rc = 0;
 
+	mutex_lock(&filter_table_sem);
 	switch (info->cmd) {
 	case CMD_ADD_PROC_INFO:
 		rc = add_proc_info_to_white_list(info);
@@ -278,6 +482,9 @@ int set_proc_info(struct set_process_info *info)
 		rc = -EFAULT;
 		break;
 	}
+	if (rc == 0)
+		rc = bastet_filter_rebuild();
+	mutex_unlock(&filter_table_sem);
 	return rc;
 }
 
@@ -315,6 +522,12 @@ int set_netfilter(bool state)
 		if (isRegistered) {
 			nf_unregister_hook(&ipv4_local_out_ops);
 			nf_unregister_hook(&ipv6_local_out_ops);
+			cancel_delayed_work_sync(&filter_flush_work);
+			mutex_lock(&filter_table_sem);
+			bastet_filter_flush(rcu_dereference_protected(
+				filter_table,
+				lockdep_is_held(&filter_table_sem)));
+			mutex_unlock(&filter_table_sem);
 			isRegistered = false;
 		}
 		return 0;
@@ -332,6 +545,7 @@ int set_netfilter(bool state)
 		return -EFAULT;
 	}
 	isRegistered = true;
+	schedule_delayed_work(&filter_flush_work, BST_FILTER_FLUSH_INTERVAL);
 	return 0;
 }
 
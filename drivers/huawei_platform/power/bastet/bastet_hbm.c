@@ -17,11 +17,59 @@
 
 #include <linux/file.h>
 #include <linux/net.h>
+#include <linux/list.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/alarmtimer.h>
 #include <net/sock.h>
 
 #include <huawei_platform/power/bastet/bastet_utils.h>
 #include <huawei_platform/power/bastet/bastet.h>
 
+#define BST_HB_MIN_INTERVAL			(10 * MSEC_PER_SEC)
+#define BST_HB_WAKE_TIMEOUT			(HZ / 2)
+
+/* heartbeat scheduled by BST_IOC_SCHED_HB */
+struct bastet_hb {
+	struct list_head list;
+	struct bst_sock_id guide;		/* pid and fd to find sock */
+	ktime_t due;					/* latest send time, boottime */
+	ktime_t slack;					/* tolerated advance */
+	uint32_t interval;				/* heartbeat period, in ms */
+	uint32_t len;					/* length of heartbeat content */
+	uint8_t *content;				/* heartbeat content */
+};
+
+static LIST_HEAD(bastet_hb_list);
+static DEFINE_MUTEX(bastet_hb_lock);
+static struct alarm bastet_hb_alarm;
+
+static void bastet_hb_work_fn(struct work_struct *work);
+static DECLARE_WORK(bastet_hb_work, bastet_hb_work_fn);
+
+static int bastet_sock_send(struct sock *sk, uint8_t *data, uint32_t len)
+{
+	struct msghdr msg;
+	struct kvec iov[1];
+	int ret;
+
+	memset(&msg, 0, sizeof(msg));
+	memset(&iov, 0, sizeof(iov));
+	msg.msg_flags  |= MSG_DONTWAIT;
+	iov[0].iov_base = data;
+	iov[0].iov_len  = len;
+
+	/* send data from kernel directly */
+	ret = kernel_sendmsg(sk->sk_socket, &msg, iov, 1, len);
+	if (ret != len) {
+		BASTET_LOGE("kernel_sendmsg failed, ret=%d", ret);
+		return -EFAULT;
+	}
+
+	return 0;
+}
+
 /**
  * Function: bastet_send_msg
  * Description: send data by socket
@@ -38,8 +86,6 @@ int bastet_send_msg(struct bst_sock_id *guide, uint8_t *data, uint32_t len)
 {
 	int ret = 0;
 	struct sock *sk;
-	struct msghdr msg;
-	struct kvec iov[1];
 
 	/* parameters check */
 	if (guide == NULL || data == NULL || len == 0) {
@@ -53,22 +99,10 @@ int bastet_send_msg(struct bst_sock_id *guide, uint8_t *data, uint32_t len)
 					guide->fd, guide->pid);
 		return -ENOENT;
 	}
-	memset(&msg, 0, sizeof(msg));
-	memset(&iov, 0, sizeof(iov));
-	msg.msg_flags  |= MSG_DONTWAIT;
-	iov[0].iov_base = data;
-	iov[0].iov_len  = len;
-
-	/* send data from kernel directly */
-	ret = kernel_sendmsg(sk->sk_socket, &msg, iov, 1, len);
-	if (ret != len) {
-		BASTET_LOGE("kernel_sendmsg failed, ret=%d", ret);
-		sock_put(sk);
-		return -EFAULT;
-	}
+	ret = bastet_sock_send(sk, data, len);
 	sock_put(sk);
 
-	return 0;
+	return ret;
 }
 
 /**
@@ -354,3 +388,233 @@ int bastet_filter_hb_reply(struct bst_sock_id *guide)
 
 	return err;
 }
+
+/**
+ * Function: bastet_hb_send
+ * Description: send a scheduled heartbeat, with the heartbeat
+ *              reply filter armed as BST_IOC_FILTER_HB_REPLY does
+ * Input: struct bastet_hb *hb, scheduled heartbeat
+ * Output:
+ * Return: 0, success
+ *         negative, failed
+ */
+static int bastet_hb_send(struct bastet_hb *hb)
+{
+	struct sock *sk;
+	bool filter;
+	int ret;
+
+	sk = get_sock_by_fd_pid(hb->guide.fd, hb->guide.pid);
+	if (NULL == sk) {
+		BASTET_LOGE("can not find sock by fd: %d pid: %d",
+			hb->guide.fd, hb->guide.pid);
+		return -ENOENT;
+	}
+	filter = is_wifi_proxy(sk) && sk->bastet->hbm.reply_content;
+	if (filter)
+		atomic_inc(&sk->bastet->hbm.reply_filter_cnt);
+
+	ret = bastet_sock_send(sk, hb->content, hb->len);
+	if (ret != 0 && filter)
+		atomic_dec(&sk->bastet->hbm.reply_filter_cnt);
+	sock_put(sk);
+
+	return ret;
+}
+
+static void bastet_hb_free(struct bastet_hb *hb)
+{
+	list_del(&hb->list);
+	kfree(hb->content);
+	kfree(hb);
+}
+
+/* arm the alarm at the earliest due heartbeat, bastet_hb_lock held */
+static void bastet_hb_rearm(void)
+{
+	struct bastet_hb *hb;
+	ktime_t next = ktime_set(KTIME_SEC_MAX, 0);
+
+	if (list_empty(&bastet_hb_list)) {
+		alarm_try_to_cancel(&bastet_hb_alarm);
+		return;
+	}
+
+	list_for_each_entry(hb, &bastet_hb_list, list) {
+		if (ktime_before(hb->due, next))
+			next = hb->due;
+	}
+	alarm_start(&bastet_hb_alarm, next);
+}
+
+/*
+ * The alarm fires when the first heartbeat is due; every heartbeat whose
+ * window is open by then is sent in the same wake, and its next period
+ * starts from now.
+ */
+static void bastet_hb_work_fn(struct work_struct *work)
+{
+	struct bastet_hb *hb, *n;
+	ktime_t now;
+	int sent = 0;
+
+	mutex_lock(&bastet_hb_lock);
+	now = ktime_get_boottime();
+	list_for_each_entry_safe(hb, n, &bastet_hb_list, list) {
+		if (ktime_before(now, ktime_sub(hb->due, hb->slack)))
+			continue;
+
+		if (bastet_hb_send(hb) != 0) {
+			post_indicate_packet(BST_IND_HB_SEND_FAIL, &hb->guide,
+				sizeof(struct bst_sock_id));
+			bastet_hb_free(hb);
+			continue;
+		}
+		hb->due = ktime_add_ms(now, hb->interval);
+		sent++;
+	}
+	bastet_hb_rearm();
+	mutex_unlock(&bastet_hb_lock);
+
+	BASTET_LOGI("%d heartbeats sent in one wake", sent);
+}
+
+static enum alarmtimer_restart bastet_hb_alarm_fn(struct alarm *alarm,
+	ktime_t now)
+{
+	bastet_wakelock_acquire_timeout(BST_HB_WAKE_TIMEOUT);
+	schedule_work(&bastet_hb_work);
+
+	return ALARMTIMER_NORESTART;
+}
+
+static struct bastet_hb *bastet_hb_find(struct bst_sock_id *guide)
+{
+	struct bastet_hb *hb;
+
+	list_for_each_entry(hb, &bastet_hb_list, list) {
+		if (hb->guide.fd == guide->fd && hb->guide.pid == guide->pid)
+			return hb;
+	}
+
+	return NULL;
+}
+
+/**
+ * Function: bastet_sched_hb
+ * Description: let the kernel send the heartbeat of a socket every
+ *              interval, up to jitter early to batch it with others;
+ *              replaces the schedule the socket already had
+ * Input: struct heartbeat_sched *sched, socket, interval and jitter
+ *        uint8_t *content, heartbeat content, owned by the schedule
+ *        from now on and freed on failure
+ * Output:
+ * Return: 0, success
+ *         negative, failed
+ */
+int bastet_sched_hb(struct heartbeat_sched *sched, uint8_t *content)
+{
+	struct bastet_hb *hb;
+	struct sock *sk;
+
+	if (sched == NULL || content == NULL || sched->len == 0
+		|| sched->interval < BST_HB_MIN_INTERVAL) {
+		BASTET_LOGE("Invalid input parameters");
+		kfree(content);
+		return -EINVAL;
+	}
+	sk = get_sock_by_fd_pid(sched->guide.fd, sched->guide.pid);
+	if (NULL == sk) {
+		BASTET_LOGE("can not find sock by fd: %d pid: %d",
+			sched->guide.fd, sched->guide.pid);
+		kfree(content);
+		return -ENOENT;
+	}
+	sock_put(sk);
+
+	mutex_lock(&bastet_hb_lock);
+	hb = bastet_hb_find(&sched->guide);
+	if (hb) {
+		kfree(hb->content);
+	} else {
+		hb = kzalloc(sizeof(*hb), GFP_KERNEL);
+		if (NULL == hb) {
+			mutex_unlock(&bastet_hb_lock);
+			kfree(content);
+			return -ENOMEM;
+		}
+		hb->guide = sched->guide;
+		list_add_tail(&hb->list, &bastet_hb_list);
+	}
+	hb->content = content;
+	hb->len = sched->len;
+	hb->interval = sched->interval;
+	/* an advance of more than half a period would double the rate */
+	hb->slack = ms_to_ktime(min(sched->jitter, sched->interval / 2));
+	hb->due = ktime_add_ms(ktime_get_boottime(), hb->interval);
+	bastet_hb_rearm();
+	mutex_unlock(&bastet_hb_lock);
+
+	BASTET_LOGI("fd: %d pid: %d interval: %u jitter: %u",
+		sched->guide.fd, sched->guide.pid,
+		sched->interval, sched->jitter);
+	return 0;
+}
+
+/**
+ * Function: bastet_cancel_hb
+ * Description: stop the kernel heartbeat of a socket
+ * Input: struct bst_sock_id *guide, pid and fd to find sock
+ * Output:
+ * Return: 0, success
+ *         negative, failed
+ */
+int bastet_cancel_hb(struct bst_sock_id *guide)
+{
+	struct bastet_hb *hb;
+	int err = -ENOENT;
+
+	if (guide == NULL)
+		return -EFAULT;
+
+	mutex_lock(&bastet_hb_lock);
+	hb = bastet_hb_find(guide);
+	if (hb) {
+		bastet_hb_free(hb);
+		bastet_hb_rearm();
+		err = 0;
+	}
+	mutex_unlock(&bastet_hb_lock);
+
+	return err;
+}
+
+/**
+ * Function: bastet_clear_hb
+ * Description: stop all kernel heartbeats, when bastetd goes away
+ * Input:
+ * Output:
+ * Return:
+ */
+void bastet_clear_hb(void)
+{
+	struct bastet_hb *hb, *n;
+
+	mutex_lock(&bastet_hb_lock);
+	list_for_each_entry_safe(hb, n, &bastet_hb_list, list)
+		bastet_hb_free(hb);
+	bastet_hb_rearm();
+	mutex_unlock(&bastet_hb_lock);
+}
+
+void bastet_hb_init(void)
+{
+	alarm_init(&bastet_hb_alarm, ALARM_BOOTTIME, bastet_hb_alarm_fn);
+}
+
+void bastet_hb_exit(void)
+{
+	bastet_clear_hb();
+	alarm_cancel(&bastet_hb_alarm);
+	cancel_work_sync(&bastet_hb_work);
+}
@@ -1622,6 +1622,51 @@ static void water_check(struct charge_device_info *di)
 	}
 }
 
+/**********************************************************
+*  Function:       charge_monitor_interval
+*  Description:    monitor period, longer while the charge is stable
+*  Parameters:   di:charge_device_info
+*  return value:  period in ms
+**********************************************************/
+static unsigned int charge_monitor_interval(struct charge_device_info *di)
+{
+	struct charge_monitor_snapshot now;
+
+	memset(&now, 0, sizeof(now));
+	now.charger_type = di->charger_type;
+	now.input_current = di->input_current;
+	now.charge_current = di->charge_current;
+	now.charge_enable = di->charge_enable;
+	now.iin_thl = di->sysfs_data.iin_thl;
+	now.ichg_thl = di->sysfs_data.ichg_thl;
+
+	if (memcmp(&now, &di->monitor_last, sizeof(now))) {
+		di->monitor_last = now;
+		di->monitor_stable_cnt = 0;
+	} else if (di->monitor_stable_cnt < CHARGING_WORK_STABLE_CNT) {
+		di->monitor_stable_cnt++;
+	}
+
+	if (di->monitor_stable_cnt >= CHARGING_WORK_STABLE_CNT)
+		return CHARGING_WORK_STABLE_TIMEOUT;
+	return CHARGING_WORK_TIMEOUT;
+}
+
+/**********************************************************
+*  Function:       charge_monitor_kick
+*  Description:    run the monitor now on an event that may change the
+*                  charging state, and poll fast again until it settles
+*  Parameters:   di:charge_device_info
+*  return value:  NULL
+**********************************************************/
+static void charge_monitor_kick(struct charge_device_info *di)
+{
+	di->monitor_stable_cnt = 0;
+	/* only while charging, the monitor is not pending otherwise */
+	if (!cancel_work_flag && delayed_work_pending(&di->charge_work))
+		mod_delayed_work(system_wq, &di->charge_work, 0);
+}
+
 /**********************************************************
 *  Function:       charge_monitor_work
 *  Description:    monitor the charging process
@@ -1660,7 +1705,7 @@ static void charge_monitor_work(struct work_struct *work)
 	charge_update_status(di);
 	charge_kick_watchdog(di);
 	schedule_delayed_work(&di->charge_work,
-			      msecs_to_jiffies(CHARGING_WORK_TIMEOUT));
+			      msecs_to_jiffies(charge_monitor_interval(di)));
 }
 
 /**********************************************************
@@ -1912,6 +1957,7 @@ static int charge_fault_notifier_call(struct notifier_block *fault_nb,
 
 	di->charge_fault = (enum charge_fault_type)event;
 	schedule_work(&di->fault_work);
+	charge_monitor_kick(di);
 	return NOTIFY_OK;
 }
 
@@ -2343,6 +2389,7 @@ static ssize_t charge_sysfs_store(struct device *dev,
 			hwlog_info("THERMAL set input current main = %d\n",
 				   di->sysfs_data.iin_thl_main);
 		}
+		charge_monitor_kick(di);
 #endif
 		break;
 	case CHARGE_SYSFS_ICHG_THERMAL:
@@ -2385,6 +2432,7 @@ static ssize_t charge_sysfs_store(struct device *dev,
 			hwlog_info("THERMAL set charge current main = %d\n",
 				   di->sysfs_data.ichg_thl_main);
 		}
+		charge_monitor_kick(di);
 #endif
 		break;
 	case CHARGE_SYSFS_IIN_THERMAL_AUX:
@@ -2407,6 +2455,7 @@ static ssize_t charge_sysfs_store(struct device *dev,
 						   di->sysfs_data.iin_thl_aux);
 		hwlog_info("THERMAL set input current aux = %d\n",
 			   di->sysfs_data.iin_thl_aux);
+		charge_monitor_kick(di);
 #endif
 		break;
 	case CHARGE_SYSFS_ICHG_THERMAL_AUX:
@@ -2434,6 +2483,7 @@ static ssize_t charge_sysfs_store(struct device *dev,
 						    di->sysfs_data.ichg_thl_aux);
 		hwlog_info("THERMAL set charge current aux = %d\n",
 			   di->sysfs_data.ichg_thl_aux);
+		charge_monitor_kick(di);
 #endif
 		break;
 	case CHARGE_SYSFS_IIN_RUNNINGTEST:
@@ -0,0 +1,367 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 1998-2014. All rights reserved.
+ *
+ * File name: hw_kwakeup.c
+ * Description: This file use to collect wakeup sources, the uids of the
+ *              packets that woke the device and the time every resume took,
+ *              and report them to userspace once per period as one binary
+ *              record instead of a message per event.
+ * Version: 0.1
+ */
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/irq.h>
+#include <linux/irqdesc.h>
+#include <linux/interrupt.h>
+#include <linux/ktime.h>
+#include <linux/jiffies.h>
+#include <linux/suspend.h>
+#include <linux/syscore_ops.h>
+#include <linux/workqueue.h>
+#include <linux/wakeup_reason.h>
+#include <linux/err.h>
+#include <huawei_platform/power/hw_kstate.h>
+#include <huawei_platform/power/hw_kwakeup.h>
+
+#define KWAKEUP_IRQ_UNKNOWN	(-1)
+#define KWAKEUP_MAX_IRQS	8
+/* inbound packets this long after resume did not wake the device */
+#define KWAKEUP_PACKET_WINDOW	HZ
+
+struct kwakeup_source {
+	s32 irq;
+	u32 count;
+	u64 resume_us_sum;
+	u32 resume_us_max;
+};
+
+static DEFINE_SPINLOCK(kwakeup_lock);
+static struct kwakeup_source sources[KWAKEUP_MAX_SOURCES];
+static struct kwakeup_uid_rec uids[KWAKEUP_MAX_UIDS];
+static u32 nr_sources;
+static u32 nr_uids;
+static u32 nr_wakeups;
+static u32 dropped;
+static u32 start_s;
+
+static bool collecting = false;
+static u32 period_s = 0;
+static bool resumed = false;
+static ktime_t resume_start;
+static bool packet_armed = false;
+static bool packet_deadline_set = false;
+static unsigned long packet_deadline;
+
+static struct delayed_work report_work;
+
+static u32 boottime_s(void)
+{
+	return (u32)ktime_divns(ktime_get_boottime(), NSEC_PER_SEC);
+}
+
+/*
+ * Function: account_source
+ * Description: count one wakeup by irq, called with kwakeup_lock held
+ * Input: irq -- wakeup irq, KWAKEUP_IRQ_UNKNOWN if none was logged
+ *        resume_us -- time from wakeup to userspace running again
+**/
+static void account_source(s32 irq, u32 resume_us)
+{
+	struct kwakeup_source *src = NULL;
+	u32 i;
+
+	for (i = 0; i < nr_sources; i++) {
+		if (sources[i].irq == irq) {
+			src = &sources[i];
+			break;
+		}
+	}
+	if (!src) {
+		if (nr_sources == KWAKEUP_MAX_SOURCES) {
+			dropped++;
+			return;
+		}
+		src = &sources[nr_sources++];
+		memset(src, 0, sizeof(*src));
+		src->irq = irq;
+	}
+
+	src->count++;
+	src->resume_us_sum += resume_us;
+	if (resume_us > src->resume_us_max)
+		src->resume_us_max = resume_us;
+}
+
+bool kwakeup_packet_armed(void)
+{
+	return ACCESS_ONCE(packet_armed);
+}
+
+/*
+ * Function: kwakeup_packet
+ * Description: count the first inbound packet after a resume against its
+ *              uid, called from the packetmonitor LOCAL_IN hooks
+ * Input: uid -- owner of the receiving socket
+**/
+void kwakeup_packet(kuid_t uid)
+{
+	unsigned long flags;
+	u32 id = __kuid_val(uid);
+	u32 i;
+
+	spin_lock_irqsave(&kwakeup_lock, flags);
+	if (!packet_armed)
+		goto out;
+	packet_armed = false;
+	if (packet_deadline_set && time_after(jiffies, packet_deadline))
+		goto out;
+
+	for (i = 0; i < nr_uids; i++) {
+		if (uids[i].uid == id) {
+			uids[i].packets++;
+			goto out;
+		}
+	}
+	if (nr_uids == KWAKEUP_MAX_UIDS) {
+		dropped++;
+		goto out;
+	}
+	uids[nr_uids].uid = id;
+	uids[nr_uids].packets = 1;
+	nr_uids++;
+out:
+	spin_unlock_irqrestore(&kwakeup_lock, flags);
+}
+
+/*
+ * Function: kwakeup_syscore_resume
+ * Description: the first point after wakeup where time is kept again,
+ *              runs with interrupts disabled on the boot cpu
+**/
+static void kwakeup_syscore_resume(void)
+{
+	if (!collecting)
+		return;
+
+	spin_lock(&kwakeup_lock);
+	resume_start = ktime_get();
+	resumed = true;
+	/* the window starts counting once jiffies are reliable again */
+	packet_deadline_set = false;
+	packet_armed = true;
+	spin_unlock(&kwakeup_lock);
+}
+
+static struct syscore_ops kwakeup_syscore_ops = {
+	.resume = kwakeup_syscore_resume,
+};
+
+static int kwakeup_pm_notify(struct notifier_block *nb,
+			     unsigned long event, void *unused)
+{
+	int irqs[KWAKEUP_MAX_IRQS];
+	unsigned long flags;
+	u32 resume_us;
+	int n, i;
+
+	if (event != PM_POST_SUSPEND)
+		return NOTIFY_DONE;
+
+	n = get_wakeup_reason_irqs(irqs, KWAKEUP_MAX_IRQS);
+
+	spin_lock_irqsave(&kwakeup_lock, flags);
+	/* a suspend aborted before syscore suspend didn't wake up */
+	if (resumed) {
+		resumed = false;
+		resume_us = (u32)ktime_us_delta(ktime_get(), resume_start);
+		nr_wakeups++;
+		if (n <= 0)
+			account_source(KWAKEUP_IRQ_UNKNOWN, resume_us);
+		for (i = 0; i < n; i++)
+			account_source(irqs[i], resume_us);
+		packet_deadline = jiffies + KWAKEUP_PACKET_WINDOW;
+		packet_deadline_set = true;
+	}
+	spin_unlock_irqrestore(&kwakeup_lock, flags);
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block kwakeup_pm_nb = {
+	.notifier_call = kwakeup_pm_notify,
+};
+
+static void source_name(s32 irq, char *name)
+{
+	struct irq_desc *desc;
+
+	if (irq == KWAKEUP_IRQ_UNKNOWN) {
+		strlcpy(name, "unknown", KWAKEUP_NAME_LEN);
+		return;
+	}
+	desc = irq_to_desc(irq);
+	if (desc && desc->action && desc->action->name)
+		strlcpy(name, desc->action->name, KWAKEUP_NAME_LEN);
+	else
+		strlcpy(name, "none", KWAKEUP_NAME_LEN);
+}
+
+/*
+ * Function: report
+ * Description: send the record of the last period by kstate and start a
+ *              new one, periods without a wakeup send nothing
+ * Return: -1--failed, 0--success
+**/
+static int report(void)
+{
+	struct kwakeup_record_hdr *hdr = NULL;
+	struct kwakeup_source_rec *src = NULL;
+	struct kwakeup_uid_rec *uid = NULL;
+	unsigned long flags;
+	size_t len;
+	u32 i;
+	int ret = 0;
+
+	len = sizeof(*hdr) + KWAKEUP_MAX_SOURCES * sizeof(*src) +
+	      KWAKEUP_MAX_UIDS * sizeof(*uid);
+	hdr = kzalloc(len, GFP_KERNEL);
+	if (!hdr) {
+		pr_err("hw_kwakeup %s: no memory\n", __func__);
+		return -1;
+	}
+	src = (struct kwakeup_source_rec *)(hdr + 1);
+
+	spin_lock_irqsave(&kwakeup_lock, flags);
+	if (!nr_wakeups) {
+		spin_unlock_irqrestore(&kwakeup_lock, flags);
+		kfree(hdr);
+		return 0;
+	}
+	hdr->version = KWAKEUP_RECORD_VERSION;
+	hdr->start_s = start_s;
+	hdr->end_s = boottime_s();
+	hdr->nr_wakeups = nr_wakeups;
+	hdr->nr_sources = nr_sources;
+	hdr->nr_uids = nr_uids;
+	hdr->dropped = dropped;
+	for (i = 0; i < nr_sources; i++) {
+		src[i].irq = sources[i].irq;
+		src[i].count = sources[i].count;
+		src[i].resume_us_avg = (u32)div_u64(sources[i].resume_us_sum,
+						    sources[i].count);
+		src[i].resume_us_max = sources[i].resume_us_max;
+	}
+	uid = (struct kwakeup_uid_rec *)(src + nr_sources);
+	memcpy(uid, uids, nr_uids * sizeof(*uid));
+	len = (char *)(uid + nr_uids) - (char *)hdr;
+
+	nr_sources = 0;
+	nr_uids = 0;
+	nr_wakeups = 0;
+	dropped = 0;
+	start_s = hdr->end_s;
+	spin_unlock_irqrestore(&kwakeup_lock, flags);
+
+	/* irq names are looked up outside the lock, kstate may sleep */
+	for (i = 0; i < hdr->nr_sources; i++)
+		source_name(src[i].irq, src[i].name);
+
+	if (kstate(CHANNEL_ID_KWAKEUP, PACKET_TAG_KWAKEUP, (char *)hdr, len) < 0) {
+		pr_err("hw_kwakeup %s: kstate error\n", __func__);
+		ret = -1;
+	}
+	pr_debug("hw_kwakeup %s: wakeups=%u sources=%u uids=%u\n", __func__,
+		 hdr->nr_wakeups, hdr->nr_sources, hdr->nr_uids);
+	kfree(hdr);
+	return ret;
+}
+
+static void report_work_fn(struct work_struct *work)
+{
+	report();
+	if (collecting)
+		queue_delayed_work(system_power_efficient_wq, &report_work,
+				   msecs_to_jiffies(period_s * MSEC_PER_SEC));
+}
+
+/*
+ * Function: kwakeup_cb
+ * Description: kstate call back, userspace sets the report period
+ * Return: -1 -- failed, 0 -- success
+**/
+static int kwakeup_cb(CHANNEL_ID src, PACKET_TAG tag, const char *data, size_t len)
+{
+	struct kwakeup_cmd cmd;
+	unsigned long flags;
+
+	if (IS_ERR_OR_NULL(data) || (len != sizeof(cmd))) {
+		pr_err("hw_kwakeup %s: invalid data or len:%d\n", __func__, (int)len);
+		return -1;
+	}
+	memcpy(&cmd, data, len);
+
+	spin_lock_irqsave(&kwakeup_lock, flags);
+	if (!collecting && cmd.period_s) {
+		nr_sources = 0;
+		nr_uids = 0;
+		nr_wakeups = 0;
+		dropped = 0;
+		start_s = boottime_s();
+	}
+	collecting = cmd.period_s != 0;
+	period_s = cmd.period_s;
+	packet_armed = false;
+	resumed = false;
+	spin_unlock_irqrestore(&kwakeup_lock, flags);
+
+	if (collecting)
+		mod_delayed_work(system_power_efficient_wq, &report_work,
+				 msecs_to_jiffies(period_s * MSEC_PER_SEC));
+	else
+		cancel_delayed_work(&report_work);
+
+	pr_debug("hw_kwakeup %s: src=%d tag=%d period_s=%u\n", __func__, src, tag, period_s);
+	return 0;
+}
+
+static struct kstate_opt kwakeup_opt = {
+	.name = "kwakeup",
+	.tag = PACKET_TAG_KWAKEUP,
+	.dst = CHANNEL_ID_KWAKEUP,
+	.hook = kwakeup_cb,
+};
+
+static int __init kwakeup_init(void)
+{
+	int ret = -1;
+
+	/* deferrable, the report never wakes the device by itself */
+	INIT_DEFERRABLE_WORK(&report_work, report_work_fn);
+
+	ret = kstate_register_hook(&kwakeup_opt);
+	if (ret < 0) {
+		pr_err("hw_kwakeup %s: kstate_register_hook error\n", __func__);
+		return ret;
+	}
+	register_syscore_ops(&kwakeup_syscore_ops);
+	register_pm_notifier(&kwakeup_pm_nb);
+	pr_info("hw_kwakeup %s: kstate_register_hook success\n", __func__);
+	return 0;
+}
+
+static void __exit kwakeup_exit(void)
+{
+	collecting = false;
+	unregister_pm_notifier(&kwakeup_pm_nb);
+	unregister_syscore_ops(&kwakeup_syscore_ops);
+	kstate_unregister_hook(&kwakeup_opt);
+	cancel_delayed_work_sync(&report_work);
+}
+
+late_initcall(kwakeup_init);
+module_exit(kwakeup_exit);
+
+MODULE_LICENSE("Dual BSD/GPL");
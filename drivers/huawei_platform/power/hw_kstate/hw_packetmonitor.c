@@ -27,6 +27,7 @@
 #include <net/inet_hashtables.h>
 #include <net/inet6_hashtables.h>
 #include <huawei_platform/power/hw_kstate.h>
+#include <huawei_platform/power/hw_kwakeup.h>
 
 MODULE_LICENSE("Dual BSD/GPL");
 
@@ -1096,6 +1097,9 @@ static unsigned int hook_ipv4_local_in_cb(unsigned int hooknum,
 												int (*okfn)(struct sk_buff*))
 #endif
 {
+	if (kwakeup_packet_armed()) {
+		kwakeup_packet(get_skb_uid(skb, IP_VERSION_V4, DIR_LOCAL_IN));
+	}
 	if (START_MONITOR == atomic_read(&monitor_state_of_in)) {
 		netfilter_monitor_func(skb, IP_VERSION_V4, DIR_LOCAL_IN);
 	}
@@ -1154,6 +1158,9 @@ static unsigned int hook_ipv6_local_in_cb(unsigned int hooknum,
 												int (*okfn)(struct sk_buff*))
 #endif
 {
+	if (kwakeup_packet_armed()) {
+		kwakeup_packet(get_skb_uid(skb, IP_VERSION_V6, DIR_LOCAL_IN));
+	}
 	if (START_MONITOR == atomic_read(&monitor_state_of_in)) {
 		netfilter_monitor_func(skb, IP_VERSION_V6, DIR_LOCAL_IN);
 	}
@@ -31,6 +31,7 @@
 #define IOSTAT_PID_IN_LINE 5 //output pids in one msg line
 #define IOSTAT_TOP_LIMIT 100 //sum of output pids
 #define IOSTAT_TOP_THRESHOLD 2 //threshold of io r/w stat (MB)
+#define IOSTAT_TOP_WAIT_THRESHOLD 200 //threshold of time blocked on storage (ms)
 #define IOSTAT_COMMANDLEN 16 //pid name lenght
 #define IOSTAT_BUFLEN 512 //io buffer len 
 
@@ -43,6 +44,7 @@
 #define IS_DIGIT(n) (((n) >= '0') && ((n) <= '9'))
 #define BTOKB(n) ((n)>>10)
 #define BTOMB(n) ((n)>>20)
+#define NSTOMS(n) ((u32)div_u64((n), NSEC_PER_MSEC))
 
 
 /*----------------------------------------------------------------------
@@ -60,6 +62,9 @@ struct io_node
     u64 read_bytes;  //The number of bytes which this task has caused to be read from storage.
     u64 write_bytes; //The number of bytes which this task has caused, or shall cause to be written to disk.
     u64 cwrite_bytes;//cancelled write bytes by truncates some dirty pagecache
+    u64 read_wait_ns; //time blocked on page cache miss reads
+    u64 fsync_wait_ns;//time blocked in fsync
+    u64 dirty_wait_ns;//time throttled for dirtying pages
     char command[IOSTAT_COMMANDLEN + 4]; //pid name "[pid]/comm"
     struct hlist_node node; //current node in hash list
     struct hlist_node hlist;//current node in all list
@@ -98,6 +103,7 @@ struct io_output_node
 {
     u32 read_KB;
     u32 write_KB;
+    u32 wait_ms; //read, fsync and dirty wait
     struct io_node *ion;
 };
 
@@ -118,9 +124,22 @@ struct io_proc_node
     int pid;
     u32 read_KB;
     u32 write_KB;
+    u32 read_wait_ms;
+    u32 fsync_wait_ms;
+    u32 dirty_wait_ms;
     char command[IOSTAT_COMMANDLEN + 4];
 };
 
+//increase of one io node during the stat period
+struct io_node_delta
+{
+    u64 read_bytes;
+    u64 write_bytes;
+    u64 read_wait_ns;
+    u64 fsync_wait_ns;
+    u64 dirty_wait_ns;
+};
+
 struct io_proc_info
 {
     unsigned long read_KB; //same as io_output_info
@@ -239,6 +258,9 @@ static void io_top_set_ionode(struct io_node *old_ion, struct io_node *new_ion)
     old_ion->read_bytes = new_ion->read_bytes;
     old_ion->write_bytes = new_ion->write_bytes;
     old_ion->cwrite_bytes = new_ion->cwrite_bytes;
+    old_ion->read_wait_ns = new_ion->read_wait_ns;
+    old_ion->fsync_wait_ns = new_ion->fsync_wait_ns;
+    old_ion->dirty_wait_ns = new_ion->dirty_wait_ns;
 
     return;
 }
@@ -300,17 +322,18 @@ static void io_top_del_invalid_ionode(void)
 *   @brief:    save io information to output container
 *   @param: pio_inf: output container
 *   @param: ion: current io node
-*   @param: read_bytes: increased read bytes
-*   @param: write_bytes: increased write bytes
+*   @param: delta: increased io and wait time
 *   @return: void
 */
 static void io_top_save_io_info(struct io_output_info *pio_inf,
-                                struct io_node *ion, u64 read_bytes, u64 write_bytes)
+                                struct io_node *ion, struct io_node_delta *delta)
 {
     if (pio_inf && ion && (pio_inf->iotop_cnt < IOSTAT_TOP_LIMIT))
     {
-        pio_inf->iotop[pio_inf->iotop_cnt].read_KB = (u32)BTOKB(read_bytes);
-        pio_inf->iotop[pio_inf->iotop_cnt].write_KB = (u32)BTOKB(write_bytes);
+        pio_inf->iotop[pio_inf->iotop_cnt].read_KB = (u32)BTOKB(delta->read_bytes);
+        pio_inf->iotop[pio_inf->iotop_cnt].write_KB = (u32)BTOKB(delta->write_bytes);
+        pio_inf->iotop[pio_inf->iotop_cnt].wait_ms = NSTOMS(delta->read_wait_ns +
+                delta->fsync_wait_ns + delta->dirty_wait_ns);
         pio_inf->iotop[pio_inf->iotop_cnt].ion = ion;
         pio_inf->iotop_cnt++;
     }
@@ -321,11 +344,10 @@ static void io_top_save_io_info(struct io_output_info *pio_inf,
 /**
 *   @brief:    save io information to proc container "io_proc_inf"
 *   @param: ion: current io node
-*   @param: read_bytes: increased read bytes
-*   @param: write_bytes: increased write bytes
+*   @param: delta: increased io and wait time
 *   @return: void
 */
-static void io_top_save_proc_info(struct io_node *ion, u64 read_bytes, u64 write_bytes)
+static void io_top_save_proc_info(struct io_node *ion, struct io_node_delta *delta)
 {
     struct io_proc_node *ion_proc = NULL;
 
@@ -337,8 +359,11 @@ static void io_top_save_proc_info(struct io_node *ion, u64 read_bytes, u64 write
     if (io_proc_inf.iotop_cnt < IOSTAT_TOP_LIMIT)
     {
         ion_proc = &io_proc_inf.iotop[io_proc_inf.iotop_cnt];
-        ion_proc->read_KB = (u32)BTOKB(read_bytes);
-        ion_proc->write_KB = (u32)BTOKB(write_bytes);
+        ion_proc->read_KB = (u32)BTOKB(delta->read_bytes);
+        ion_proc->write_KB = (u32)BTOKB(delta->write_bytes);
+        ion_proc->read_wait_ms = NSTOMS(delta->read_wait_ns);
+        ion_proc->fsync_wait_ms = NSTOMS(delta->fsync_wait_ns);
+        ion_proc->dirty_wait_ms = NSTOMS(delta->dirty_wait_ns);
         ion_proc->pid = ion->pid;
         memcpy(ion_proc->command, ion->command, sizeof(ion_proc->command));
         io_proc_inf.iotop_cnt++;
@@ -393,6 +418,9 @@ static int io_top_get_tast_io(struct task_struct *task, struct io_node *ion, int
     ion->read_bytes = acct.read_bytes;
     ion->write_bytes = acct.write_bytes;
     ion->cwrite_bytes = acct.cancelled_write_bytes;
+    ion->read_wait_ns = acct.read_wait_ns;
+    ion->fsync_wait_ns = acct.fsync_wait_ns;
+    ion->dirty_wait_ns = acct.dirty_wait_ns;
 
     mutex_unlock(&task->signal->cred_guard_mutex);
 
@@ -443,9 +471,9 @@ static void io_top_stat(struct io_output_info *pio_inf, bool proc_flag)
     u64 wchar = 0;
     u64 syscr = 0;
     u64 syscw = 0;
-    u64 read_bytes = 0;
-    u64 write_bytes = 0;
     u64 cwrite_bytes = 0;
+    u64 wait_ns = 0;
+    struct io_node_delta delta;
 
     if (NULL == pio_inf)
     {
@@ -494,9 +522,12 @@ static void io_top_stat(struct io_output_info *pio_inf, bool proc_flag)
             wchar = ion->wchar;
             syscr = ion->syscr;
             syscw = ion->syscw;
-            read_bytes = ion->read_bytes;
-            write_bytes = ion->write_bytes;
+            delta.read_bytes = ion->read_bytes;
+            delta.write_bytes = ion->write_bytes;
             cwrite_bytes = ion->cwrite_bytes;
+            delta.read_wait_ns = ion->read_wait_ns;
+            delta.fsync_wait_ns = ion->fsync_wait_ns;
+            delta.dirty_wait_ns = ion->dirty_wait_ns;
         }
         else
         {
@@ -504,11 +535,15 @@ static void io_top_stat(struct io_output_info *pio_inf, bool proc_flag)
             wchar = ion->wchar - old_ion->wchar;
             syscr = ion->syscr - old_ion->syscr;
             syscw = ion->syscw - old_ion->syscw;
-            read_bytes = ion->read_bytes - old_ion->read_bytes;
-            write_bytes = ion->write_bytes - old_ion->write_bytes;
+            delta.read_bytes = ion->read_bytes - old_ion->read_bytes;
+            delta.write_bytes = ion->write_bytes - old_ion->write_bytes;
             cwrite_bytes = ion->cwrite_bytes - old_ion->cwrite_bytes;
+            delta.read_wait_ns = ion->read_wait_ns - old_ion->read_wait_ns;
+            delta.fsync_wait_ns = ion->fsync_wait_ns - old_ion->fsync_wait_ns;
+            delta.dirty_wait_ns = ion->dirty_wait_ns - old_ion->dirty_wait_ns;
 
-            if (rchar || wchar || syscr || syscw || read_bytes || write_bytes || cwrite_bytes)
+            if (rchar || wchar || syscr || syscw || delta.read_bytes || delta.write_bytes ||
+                cwrite_bytes || delta.read_wait_ns || delta.fsync_wait_ns || delta.dirty_wait_ns)
             {
                 io_top_set_ionode(old_ion, ion);
             }
@@ -520,16 +555,19 @@ static void io_top_stat(struct io_output_info *pio_inf, bool proc_flag)
         //Set one io node to valid, mean the node is useful
         io_top_set_node_to_valid(ion);
 
-        //save rw io information that will to be output
-        if (BTOMB(read_bytes + write_bytes) > IOSTAT_TOP_THRESHOLD)
+        wait_ns = delta.read_wait_ns + delta.fsync_wait_ns + delta.dirty_wait_ns;
+
+        //save rw io information that will to be output, or of the task stalled on storage
+        if ((BTOMB(delta.read_bytes + delta.write_bytes) > IOSTAT_TOP_THRESHOLD) ||
+            (NSTOMS(wait_ns) > IOSTAT_TOP_WAIT_THRESHOLD))
         {
-            io_top_save_io_info(pio_inf, ion, read_bytes, write_bytes);
+            io_top_save_io_info(pio_inf, ion, &delta);
         }
 
         //if have proc request, save io node information to proc container
-        if (proc_flag && ((read_bytes + write_bytes) > 0))
+        if (proc_flag && (((delta.read_bytes + delta.write_bytes) > 0) || (wait_ns > 0)))
         {
-            io_top_save_proc_info(ion, read_bytes, write_bytes);
+            io_top_save_proc_info(ion, &delta);
         }
     }
 
@@ -795,11 +833,12 @@ static void io_info_output_msg(struct io_output_info *pio_inf)
     for (i = 0; i < pio_inf->iotop_cnt; i++)
     {
         io_out = &pio_inf->iotop[i];
-        len += snprintf(buf + len, IOSTAT_BUFLEN - len, "pid:%d %s rw:%u/%u; ",
+        len += snprintf(buf + len, IOSTAT_BUFLEN - len, "pid:%d %s rw:%u/%u wait:%u; ",
                         io_out->ion->pid,
                         io_out->ion->command,
                         io_out->read_KB,
-                        io_out->write_KB);
+                        io_out->write_KB,
+                        io_out->wait_ms);
 
         if (0 == ((i + 1) % IOSTAT_PID_IN_LINE))
         {
@@ -942,15 +981,18 @@ static int ioinfo_proc_show(struct seq_file *m, void *v)
 
 
     //show io information of task
-    seq_printf(m, "-pid-|--read_b--|--write_b-|------comm------\n");
+    seq_printf(m, "-pid-|--read_b--|--write_b-|-rwait_ms-|-fwait_ms-|-dwait_ms-|------comm------\n");
 
     for (i = 0; i < pio_inf->iotop_cnt; i++)
     {
         piotop = &pio_inf->iotop[i];
-        seq_printf(m, "%5d %10u %10u %s\n",
+        seq_printf(m, "%5d %10u %10u %10u %10u %10u %s\n",
                    piotop->pid,
                    piotop->read_KB,
                    piotop->write_KB,
+                   piotop->read_wait_ms,
+                   piotop->fsync_wait_ms,
+                   piotop->dirty_wait_ms,
                    piotop->command);
     }
 
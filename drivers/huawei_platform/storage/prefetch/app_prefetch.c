@@ -0,0 +1,646 @@
+/*
+ * app_prefetch - replay the file reads of an app's previous cold start
+ *
+ * Copyright (c) 2013 Huawei Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * The launcher tells the kernel through /proc/app_prefetch when an app
+ * process is started and when its launch is over:
+ *
+ *	echo "launch <pid> <app>" > /proc/app_prefetch
+ *	echo "done <pid>" > /proc/app_prefetch
+ *	echo "drop <app>" > /proc/app_prefetch	("drop *" drops all)
+ *
+ * On "launch" the ranges recorded for <app> last time, if any, are read
+ * ahead asynchronously in on-disk order, and the reads of <pid> are
+ * recorded again from the iotrace generic_file_read_begin hook until
+ * "done" or record_ms later. The recording then replaces the app's profile:
+ * per file page ranges, merged, sorted by device and physical block.
+ *
+ * Reading /proc/app_prefetch lists the profiles.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/file.h>
+#include <linux/dcache.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/sort.h>
+#include <linux/list.h>
+#include <linux/kref.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/blkdev.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <trace/iotrace.h>
+
+#define PREFETCH_MAX_SESSIONS	4
+#define PREFETCH_MAX_PROFILES	32
+#define PREFETCH_MAX_FILES	256
+#define PREFETCH_MAX_RANGES	4096
+#define PREFETCH_NAME_LEN	64
+/* pages one profile may read ahead, 64MB */
+#define PREFETCH_MAX_PAGES	((64 << 20) >> PAGE_SHIFT)
+
+static unsigned int record_ms = 5000;
+module_param(record_ms, uint, S_IRUGO | S_IWUSR);
+
+struct prefetch_range {
+	u32 file;
+	u32 nr;
+	pgoff_t start;
+	/* sort key: device and physical block of the first page */
+	u32 dev;
+	sector_t pblk;
+};
+
+struct prefetch_profile {
+	struct list_head node;		/* in prefetch_profiles, mru first */
+	struct kref ref;
+	char name[PREFETCH_NAME_LEN];
+	unsigned int nr_files;
+	unsigned int nr_ranges;
+	unsigned long nr_pages;
+	unsigned long launches;
+	char **paths;
+	struct prefetch_range *ranges;
+};
+
+struct prefetch_file {
+	struct inode *inode;		/* identity only, never dereferenced */
+	char *path;
+	int last;			/* last range of this file */
+};
+
+struct prefetch_session {
+	pid_t tgid;
+	char name[PREFETCH_NAME_LEN];
+	struct delayed_work work;
+	unsigned int nr_files;
+	unsigned int nr_ranges;
+	unsigned long nr_pages;
+	int last_file;
+	char *pathbuf;
+	struct prefetch_file files[PREFETCH_MAX_FILES];
+	struct prefetch_range ranges[PREFETCH_MAX_RANGES];
+};
+
+struct prefetch_replay {
+	struct work_struct work;
+	struct prefetch_profile *prof;
+};
+
+/* recording sessions, looked up from the read hook */
+static struct prefetch_session *prefetch_sessions[PREFETCH_MAX_SESSIONS];
+static atomic_t prefetch_nr_sessions = ATOMIC_INIT(0);
+static DEFINE_SPINLOCK(prefetch_lock);
+
+static LIST_HEAD(prefetch_profiles);
+static unsigned int prefetch_nr_profiles;
+static DEFINE_MUTEX(prefetch_mutex);
+
+static void prefetch_profile_free(struct kref *ref)
+{
+	struct prefetch_profile *prof =
+		container_of(ref, struct prefetch_profile, ref);
+	unsigned int i;
+
+	for (i = 0; i < prof->nr_files; i++)
+		kfree(prof->paths[i]);
+	kfree(prof->paths);
+	vfree(prof->ranges);
+	kfree(prof);
+}
+
+static void prefetch_profile_put(struct prefetch_profile *prof)
+{
+	kref_put(&prof->ref, prefetch_profile_free);
+}
+
+/* called with prefetch_mutex held */
+static struct prefetch_profile *prefetch_profile_find(const char *name)
+{
+	struct prefetch_profile *prof;
+
+	list_for_each_entry(prof, &prefetch_profiles, node) {
+		if (!strcmp(prof->name, name))
+			return prof;
+	}
+
+	return NULL;
+}
+
+/* called with prefetch_mutex held */
+static void prefetch_profile_unlink(struct prefetch_profile *prof)
+{
+	list_del(&prof->node);
+	prefetch_nr_profiles--;
+	prefetch_profile_put(prof);
+}
+
+/*
+ * Recording, from the read hook. The hook runs with preemption disabled,
+ * so nothing here may sleep.
+ */
+
+static struct prefetch_session *prefetch_session_find(pid_t tgid)
+{
+	int i;
+
+	for (i = 0; i < PREFETCH_MAX_SESSIONS; i++) {
+		if (prefetch_sessions[i] && prefetch_sessions[i]->tgid == tgid)
+			return prefetch_sessions[i];
+	}
+
+	return NULL;
+}
+
+static int prefetch_file_index(struct prefetch_session *s, struct file *filp)
+{
+	struct inode *inode = file_inode(filp);
+	struct prefetch_file *f;
+	char *path;
+	int i;
+
+	if (s->last_file >= 0 && s->files[s->last_file].inode == inode)
+		return s->last_file;
+
+	for (i = 0; i < s->nr_files; i++) {
+		if (s->files[i].inode == inode)
+			goto found;
+	}
+
+	if (s->nr_files >= PREFETCH_MAX_FILES)
+		return -1;
+
+	path = d_path(&filp->f_path, s->pathbuf, PATH_MAX);
+	if (IS_ERR(path))
+		return -1;
+	path = kstrdup(path, GFP_ATOMIC);
+	if (!path)
+		return -1;
+
+	f = &s->files[s->nr_files];
+	f->inode = inode;
+	f->path = path;
+	f->last = -1;
+	i = s->nr_files++;
+found:
+	s->last_file = i;
+	return i;
+}
+
+static void prefetch_record(struct prefetch_session *s, struct file *filp,
+			    loff_t pos, size_t count)
+{
+	struct prefetch_file *f;
+	struct prefetch_range *r;
+	pgoff_t start, end;
+	int i;
+
+	if (s->nr_pages >= PREFETCH_MAX_PAGES)
+		return;
+
+	i = prefetch_file_index(s, filp);
+	if (i < 0)
+		return;
+	f = &s->files[i];
+
+	start = pos >> PAGE_SHIFT;
+	end = (pos + count - 1) >> PAGE_SHIFT;
+	end = min_t(pgoff_t, end, start + PREFETCH_MAX_PAGES - 1);
+
+	/* most reads continue or repeat the file's previous one */
+	if (f->last >= 0) {
+		r = &s->ranges[f->last];
+		if (start <= r->start + r->nr && end + 1 >= r->start) {
+			pgoff_t lo = min(start, r->start);
+			pgoff_t hi = max(end + 1, r->start + r->nr);
+
+			s->nr_pages += (hi - lo) - r->nr;
+			r->start = lo;
+			r->nr = hi - lo;
+			return;
+		}
+	}
+
+	if (s->nr_ranges >= PREFETCH_MAX_RANGES)
+		return;
+
+	r = &s->ranges[s->nr_ranges];
+	r->file = i;
+	r->start = start;
+	r->nr = end - start + 1;
+	s->nr_pages += r->nr;
+	f->last = s->nr_ranges++;
+}
+
+static void prefetch_read_begin(void *ignore, struct file *filp, size_t count)
+{
+	struct prefetch_session *s;
+
+	if (!atomic_read(&prefetch_nr_sessions) || !count)
+		return;
+	if (!S_ISREG(file_inode(filp)->i_mode))
+		return;
+
+	spin_lock(&prefetch_lock);
+	s = prefetch_session_find(current->tgid);
+	if (s)
+		prefetch_record(s, filp, filp->f_pos, count);
+	spin_unlock(&prefetch_lock);
+}
+
+/*
+ * Profiles
+ */
+
+static int prefetch_range_cmp(const void *a, const void *b)
+{
+	const struct prefetch_range *ra = a, *rb = b;
+
+	if (ra->dev != rb->dev)
+		return ra->dev < rb->dev ? -1 : 1;
+	if (ra->pblk != rb->pblk)
+		return ra->pblk < rb->pblk ? -1 : 1;
+	if (ra->file != rb->file)
+		return ra->file < rb->file ? -1 : 1;
+	if (ra->start != rb->start)
+		return ra->start < rb->start ? -1 : 1;
+	return 0;
+}
+
+/*
+ * prefetch_locate - fill in the sort keys of the ranges of file 'idx'.
+ * Returns false if the file can't be opened anymore; files without bmap
+ * keep pblk 0 and are read in logical order.
+ */
+static bool prefetch_locate(struct prefetch_session *s, unsigned int idx)
+{
+	struct file *filp;
+	struct inode *inode;
+	unsigned int i;
+
+	filp = filp_open(s->files[idx].path, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(filp))
+		return false;
+
+	inode = file_inode(filp);
+	for (i = 0; i < s->nr_ranges; i++) {
+		struct prefetch_range *r = &s->ranges[i];
+
+		if (r->file != idx)
+			continue;
+		r->dev = inode->i_sb->s_dev;
+		r->pblk = 0;
+		if (inode->i_mapping->a_ops->bmap)
+			r->pblk = bmap(inode, (sector_t)r->start <<
+				       (PAGE_SHIFT - inode->i_blkbits));
+	}
+
+	filp_close(filp, NULL);
+	return true;
+}
+
+/* turn a finished recording into the app's profile */
+static void prefetch_session_save(struct prefetch_session *s)
+{
+	struct prefetch_profile *prof, *old;
+	unsigned int i, n;
+
+	if (!s->nr_ranges)
+		return;
+
+	for (i = 0; i < s->nr_files; i++) {
+		if (prefetch_locate(s, i))
+			continue;
+		for (n = 0; n < s->nr_ranges; n++) {
+			if (s->ranges[n].file == i)
+				s->ranges[n].nr = 0;
+		}
+	}
+
+	/* compact away the ranges of vanished files */
+	for (i = 0, n = 0; i < s->nr_ranges; i++) {
+		if (s->ranges[i].nr)
+			s->ranges[n++] = s->ranges[i];
+	}
+	if (!n)
+		return;
+	sort(s->ranges, n, sizeof(s->ranges[0]), prefetch_range_cmp, NULL);
+
+	prof = kzalloc(sizeof(*prof), GFP_KERNEL);
+	if (!prof)
+		return;
+	kref_init(&prof->ref);
+	strlcpy(prof->name, s->name, sizeof(prof->name));
+	prof->ranges = vmalloc(n * sizeof(prof->ranges[0]));
+	if (!prof->ranges) {
+		kfree(prof);
+		return;
+	}
+	memcpy(prof->ranges, s->ranges, n * sizeof(prof->ranges[0]));
+	prof->nr_ranges = n;
+	prof->nr_pages = s->nr_pages;
+
+	/* the paths move over to the profile */
+	prof->paths = kcalloc(s->nr_files, sizeof(char *), GFP_KERNEL);
+	if (!prof->paths) {
+		vfree(prof->ranges);
+		kfree(prof);
+		return;
+	}
+	for (i = 0; i < s->nr_files; i++) {
+		prof->paths[i] = s->files[i].path;
+		s->files[i].path = NULL;
+	}
+	prof->nr_files = s->nr_files;
+
+	mutex_lock(&prefetch_mutex);
+	old = prefetch_profile_find(prof->name);
+	if (old) {
+		prof->launches = old->launches;
+		prefetch_profile_unlink(old);
+	}
+	list_add(&prof->node, &prefetch_profiles);
+	if (++prefetch_nr_profiles > PREFETCH_MAX_PROFILES)
+		prefetch_profile_unlink(list_last_entry(&prefetch_profiles,
+					struct prefetch_profile, node));
+	mutex_unlock(&prefetch_mutex);
+}
+
+static void prefetch_session_free(struct prefetch_session *s)
+{
+	unsigned int i;
+
+	for (i = 0; i < s->nr_files; i++)
+		kfree(s->files[i].path);
+	kfree(s->pathbuf);
+	vfree(s);
+}
+
+/*
+ * prefetch_session_detach - take 's' (or, if NULL, the session of 'tgid')
+ * out of the table. Only the caller that detached a session may save and
+ * free it.
+ */
+static struct prefetch_session *prefetch_session_detach(
+		struct prefetch_session *s, pid_t tgid)
+{
+	struct prefetch_session *found = NULL;
+	int i;
+
+	spin_lock(&prefetch_lock);
+	for (i = 0; i < PREFETCH_MAX_SESSIONS; i++) {
+		struct prefetch_session *cur = prefetch_sessions[i];
+
+		if (!cur || (s ? cur != s : cur->tgid != tgid))
+			continue;
+		prefetch_sessions[i] = NULL;
+		atomic_dec(&prefetch_nr_sessions);
+		found = cur;
+		break;
+	}
+	spin_unlock(&prefetch_lock);
+
+	return found;
+}
+
+static void prefetch_session_timeout(struct work_struct *work)
+{
+	struct prefetch_session *s = container_of(to_delayed_work(work),
+					struct prefetch_session, work);
+
+	if (!prefetch_session_detach(s, 0))
+		return;
+
+	prefetch_session_save(s);
+	prefetch_session_free(s);
+}
+
+static int prefetch_session_start(pid_t tgid, const char *name)
+{
+	struct prefetch_session *s;
+	int i, ret = -EBUSY;
+
+	s = vzalloc(sizeof(*s));
+	if (!s)
+		return -ENOMEM;
+	s->pathbuf = kmalloc(PATH_MAX, GFP_KERNEL);
+	if (!s->pathbuf) {
+		vfree(s);
+		return -ENOMEM;
+	}
+	s->tgid = tgid;
+	s->last_file = -1;
+	strlcpy(s->name, name, sizeof(s->name));
+	INIT_DELAYED_WORK(&s->work, prefetch_session_timeout);
+
+	spin_lock(&prefetch_lock);
+	if (prefetch_session_find(tgid))
+		goto unlock;
+	for (i = 0; i < PREFETCH_MAX_SESSIONS; i++) {
+		if (!prefetch_sessions[i]) {
+			prefetch_sessions[i] = s;
+			atomic_inc(&prefetch_nr_sessions);
+			ret = 0;
+			break;
+		}
+	}
+unlock:
+	spin_unlock(&prefetch_lock);
+
+	if (ret) {
+		prefetch_session_free(s);
+		return ret;
+	}
+
+	schedule_delayed_work(&s->work, msecs_to_jiffies(record_ms));
+	return 0;
+}
+
+static void prefetch_session_done(pid_t tgid)
+{
+	struct prefetch_session *s;
+
+	s = prefetch_session_detach(NULL, tgid);
+	if (!s)
+		return;
+
+	cancel_delayed_work_sync(&s->work);
+	prefetch_session_save(s);
+	prefetch_session_free(s);
+}
+
+/*
+ * Replay
+ */
+
+static void prefetch_replay_fn(struct work_struct *work)
+{
+	struct prefetch_replay *rp = container_of(work,
+					struct prefetch_replay, work);
+	struct prefetch_profile *prof = rp->prof;
+	struct file **filps;
+	struct blk_plug plug;
+	unsigned int i;
+
+	filps = kcalloc(prof->nr_files, sizeof(*filps), GFP_KERNEL);
+	if (!filps)
+		goto out;
+
+	blk_start_plug(&plug);
+	for (i = 0; i < prof->nr_ranges; i++) {
+		struct prefetch_range *r = &prof->ranges[i];
+		struct file *filp = filps[r->file];
+
+		if (!filp) {
+			filp = filp_open(prof->paths[r->file],
+					 O_RDONLY | O_LARGEFILE, 0);
+			filps[r->file] = filp;
+		}
+		if (IS_ERR(filp))
+			continue;
+
+		/* pages already cached are skipped by the readahead code */
+		force_page_cache_readahead(filp->f_mapping, filp,
+					   r->start, r->nr);
+	}
+	blk_finish_plug(&plug);
+
+	for (i = 0; i < prof->nr_files; i++) {
+		if (!IS_ERR_OR_NULL(filps[i]))
+			filp_close(filps[i], NULL);
+	}
+	kfree(filps);
+out:
+	prefetch_profile_put(prof);
+	kfree(rp);
+}
+
+static void prefetch_replay(const char *name)
+{
+	struct prefetch_profile *prof;
+	struct prefetch_replay *rp;
+
+	rp = kmalloc(sizeof(*rp), GFP_KERNEL);
+	if (!rp)
+		return;
+
+	mutex_lock(&prefetch_mutex);
+	prof = prefetch_profile_find(name);
+	if (prof) {
+		list_move(&prof->node, &prefetch_profiles);
+		prof->launches++;
+		kref_get(&prof->ref);
+	}
+	mutex_unlock(&prefetch_mutex);
+
+	if (!prof) {
+		kfree(rp);
+		return;
+	}
+
+	rp->prof = prof;
+	INIT_WORK(&rp->work, prefetch_replay_fn);
+	queue_work(system_unbound_wq, &rp->work);
+}
+
+static void prefetch_drop(const char *name)
+{
+	struct prefetch_profile *prof, *tmp;
+
+	mutex_lock(&prefetch_mutex);
+	list_for_each_entry_safe(prof, tmp, &prefetch_profiles, node) {
+		if (!strcmp(name, "*") || !strcmp(prof->name, name))
+			prefetch_profile_unlink(prof);
+	}
+	mutex_unlock(&prefetch_mutex);
+}
+
+/*
+ * /proc/app_prefetch
+ */
+
+static int app_prefetch_show(struct seq_file *m, void *v)
+{
+	struct prefetch_profile *prof;
+
+	mutex_lock(&prefetch_mutex);
+	list_for_each_entry(prof, &prefetch_profiles, node)
+		seq_printf(m, "%s files %u ranges %u pages %lu launches %lu\n",
+			   prof->name, prof->nr_files, prof->nr_ranges,
+			   prof->nr_pages, prof->launches);
+	mutex_unlock(&prefetch_mutex);
+
+	return 0;
+}
+
+static int app_prefetch_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, app_prefetch_show, NULL);
+}
+
+static ssize_t app_prefetch_write(struct file *file, const char __user *ubuf,
+				  size_t count, loff_t *ppos)
+{
+	char buf[PREFETCH_NAME_LEN + 32];
+	char name[PREFETCH_NAME_LEN];
+	int pid, ret = 0;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	if (sscanf(buf, "launch %d %63s", &pid, name) == 2) {
+		prefetch_replay(name);
+		ret = prefetch_session_start(pid, name);
+	} else if (sscanf(buf, "done %d", &pid) == 1) {
+		prefetch_session_done(pid);
+	} else if (sscanf(buf, "drop %63s", name) == 1) {
+		prefetch_drop(name);
+	} else {
+		ret = -EINVAL;
+	}
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations proc_app_prefetch_operations = {
+	.open		= app_prefetch_open,
+	.read		= seq_read,
+	.write		= app_prefetch_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init app_prefetch_init(void)
+{
+	int ret;
+
+	ret = register_trace_generic_file_read_begin(prefetch_read_begin, NULL);
+	if (ret)
+		return ret;
+
+	if (!proc_create("app_prefetch", S_IRUSR | S_IWUSR, NULL,
+			 &proc_app_prefetch_operations)) {
+		unregister_trace_generic_file_read_begin(prefetch_read_begin,
+							 NULL);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+late_initcall(app_prefetch_init);
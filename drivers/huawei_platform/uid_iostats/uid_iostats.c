@@ -14,27 +14,37 @@
  */
 
 #include <linux/atomic.h>
+#include <linux/cred.h>
 #include <linux/err.h>
 #include <linux/hashtable.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
 #include <linux/list.h>
+#include <linux/percpu.h>
 #include <linux/proc_fs.h>
-#include <linux/profile.h>
+#include <linux/rculist.h>
 #include <linux/sched.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/sysfs.h>
 #include <linux/fs.h>
 #include <linux/uaccess.h>
-#include <linux/task_io_accounting_ops.h>
+#include <linux/uid_iostats.h>
 
 #define UID_HASH_BITS	10
 DECLARE_HASHTABLE(ioflowmeter_hash_table, UID_HASH_BITS);
 
+/*
+ * uid_lock only orders the add and remove writers. The io path looks
+ * the uid up under rcu and adds to the per cpu counters of the entry,
+ * see __uid_iostats_account(), so forks, exits and reads never wait
+ * for each other.
+ */
 static DEFINE_MUTEX(uid_lock);
 static struct proc_dir_entry *parent;
 
+DEFINE_STATIC_KEY_FALSE(uid_iostats_key);
+
 static void ioflowmeter_add_uid_action(uid_t uid);
 static void ioflowmeter_rm_uid_action(uid_t uid);
 
@@ -58,121 +68,67 @@ struct action_handler g_handlers[] = {
 	{ACTION_UNKNOWN,	NULL},
 };
 
-struct pid_node {
-	pid_t pid;
-	struct list_head list;
+struct uid_io_stats {
+	u64 read_bytes;
+	u64 write_bytes;
+	u64 wait_ns[UID_IO_WAIT_NR];
 };
 
 struct uid_entry {
 	uid_t uid;
-	u64 read_bytes;
-	u64 write_bytes;
-	struct list_head pid_list;
+	struct uid_io_stats __percpu *stats;
 	struct hlist_node hash;
+	struct rcu_head rcu;
 };
 
-static int ioflowmeter_io_accounting(
-			struct task_struct *task,
-			struct task_io_accounting *acct,
-			int whole)
-{
-	unsigned long flags;
-	int result = 0;
-
-	if (whole && lock_task_sighand(task, &flags)) {
-		struct task_struct *t = task;
-
-		task_io_accounting_add(acct, &task->signal->ioac);
-		while_each_thread(task, t)
-			task_io_accounting_add(acct, &t->ioac);
-
-		unlock_task_sighand(task, &flags);
-	}
-out_unlock:
-	return result;
-}
-
-static void ioflowmeter_del_pid(struct uid_entry *uid_entry, pid_t pid)
+/* called under rcu_read_lock() or uid_lock */
+static struct uid_entry *ioflowmeter_find_uid(uid_t uid)
 {
-	struct pid_node *cur, *saved_cur;
-
-	if (NULL == uid_entry) {
-		pr_err("%s: the uid_entry invalid\n", __func__);
-		return;
-	}
+	struct uid_entry *uid_entry;
 
-	list_for_each_entry_safe(cur, saved_cur, &uid_entry->pid_list, list) {
-		if (cur && pid == cur->pid) {
-			pr_debug("%s: the pid is %u\n", __func__, cur->pid);
-			list_del(&cur->list);
-			kfree(cur);
-			break;
-		}
+	hash_for_each_possible_rcu(ioflowmeter_hash_table, uid_entry, hash,
+				   uid) {
+		if (uid_entry->uid == uid)
+			return uid_entry;
 	}
 
+	return NULL;
 }
 
-static void ioflowmeter_del_pid_list(struct uid_entry *uid_entry)
+void __uid_iostats_account(size_t bytes, bool write)
 {
-	struct pid_node *cur, *saved_cur;
-
-	if (NULL == uid_entry) {
-		pr_err("%s: the uid_entry invalid\n", __func__);
-		return;
-	}
+	struct uid_entry *uid_entry;
+	uid_t uid = from_kuid_munged(&init_user_ns, current_uid());
 
-	list_for_each_entry_safe(cur, saved_cur, &uid_entry->pid_list, list) {
-		if (cur) {
-			pr_debug("%s: the pid is %u\n", __func__, cur->pid);
-			list_del(&cur->list);
-			kfree(cur);
-		}
+	rcu_read_lock();
+	uid_entry = ioflowmeter_find_uid(uid);
+	if (uid_entry) {
+		if (write)
+			this_cpu_add(uid_entry->stats->write_bytes, bytes);
+		else
+			this_cpu_add(uid_entry->stats->read_bytes, bytes);
 	}
-
+	rcu_read_unlock();
 }
 
-/* different pids in the list */
-static void ioflowmeter_add_pid(struct uid_entry *uid_entry, pid_t the_pid)
+void __uid_iostats_account_wait(enum uid_io_wait type, u64 ns)
 {
-	struct list_head *pre;
-	struct pid_node *cur, *saved_cur;
-	struct pid_node *the_node = NULL;
-
-	pre = &uid_entry->pid_list;
-	list_for_each_entry_safe(cur, saved_cur, &uid_entry->pid_list, list) {
-		pr_debug("%s: the pid is %u\n", __func__, cur->pid);
-		if (the_pid > cur->pid)
-			break;
-		else if (the_pid == cur->pid)
-			return;
-
-		pre = &cur->list;
-	}
-
-	the_node = kzalloc(sizeof(struct pid_node), GFP_KERNEL);
-	if (NULL == the_node) {
-		pr_err("%s: cannot alloc the node\n", __func__);
-		return;
-	}
-
-	the_node->pid = the_pid;
-
-	list_add(&the_node->list, pre);
+	struct uid_entry *uid_entry;
+	uid_t uid = from_kuid_munged(&init_user_ns, current_uid());
 
+	rcu_read_lock();
+	uid_entry = ioflowmeter_find_uid(uid);
+	if (uid_entry)
+		this_cpu_add(uid_entry->stats->wait_ns[type], ns);
+	rcu_read_unlock();
 }
 
-static struct uid_entry *ioflowmeter_find_uid(uid_t uid)
+static void ioflowmeter_free_uid(struct rcu_head *rcu)
 {
-	struct uid_entry *uid_entry;
-	hash_for_each_possible(ioflowmeter_hash_table, uid_entry, hash, uid) {
-		if (uid_entry && uid_entry->uid == uid) {
-			pr_debug("%s: find the uid_entry for %u\n",
-					__func__, uid);
-			return uid_entry;
-		}
-	}
+	struct uid_entry *uid_entry = container_of(rcu, struct uid_entry, rcu);
 
-	return NULL;
+	free_percpu(uid_entry->stats);
+	kfree(uid_entry);
 }
 
 static struct uid_entry *ioflowmeter_register_uid(uid_t uid)
@@ -185,16 +141,23 @@ static struct uid_entry *ioflowmeter_register_uid(uid_t uid)
 		return uid_entry;
 	}
 
-	uid_entry = kzalloc(sizeof(struct uid_entry), GFP_ATOMIC);
+	uid_entry = kzalloc(sizeof(struct uid_entry), GFP_KERNEL);
 	if (!uid_entry) {
 		pr_err("%s: cannot alloc the uid_entry\n", __func__);
 		return NULL;
 	}
 
+	uid_entry->stats = alloc_percpu(struct uid_io_stats);
+	if (!uid_entry->stats) {
+		pr_err("%s: cannot alloc the uid stats\n", __func__);
+		kfree(uid_entry);
+		return NULL;
+	}
+
 	uid_entry->uid = uid;
-	INIT_LIST_HEAD(&uid_entry->pid_list);
 
-	hash_add(ioflowmeter_hash_table, &uid_entry->hash, uid);
+	hash_add_rcu(ioflowmeter_hash_table, &uid_entry->hash, uid);
+	static_branch_inc(&uid_iostats_key);
 
 	return uid_entry;
 }
@@ -203,45 +166,70 @@ static int ioflowmeter_show_stats(struct seq_file *m, void *v)
 {
 	struct uid_entry *uid_entry;
 	unsigned long bkt;
-	struct pid_node *cur, *saved_cur;
-	struct task_struct *t = NULL;
-	u64 pids_read_bytes = 0;
-	u64 pids_write_bytes = 0;
-	struct task_io_accounting acct;
+	u64 read_bytes, write_bytes;
+	int cpu;
 
-	mutex_lock(&uid_lock);
+	rcu_read_lock();
+
+	hash_for_each_rcu(ioflowmeter_hash_table, bkt, uid_entry, hash) {
+		read_bytes = 0;
+		write_bytes = 0;
+		for_each_possible_cpu(cpu) {
+			struct uid_io_stats *stats =
+				per_cpu_ptr(uid_entry->stats, cpu);
 
-	hash_for_each(ioflowmeter_hash_table, bkt, uid_entry, hash) {
-		pids_read_bytes = 0;
-		pids_write_bytes = 0;
-		list_for_each_entry_safe(cur, saved_cur,
-						&uid_entry->pid_list, list) {
-			t = find_task_by_pid_ns(cur->pid, &init_pid_ns);
-			if (t) {
-				memset((void *)&acct, 0, sizeof(acct));
-				acct = t->ioac;
-				ioflowmeter_io_accounting(t, &acct, 1);
-				pids_read_bytes += acct.read_bytes;
-				pids_write_bytes += acct.write_bytes;
-				pr_debug("%s: %d-%d: %llu %llu %llu %llu\n",
-					__func__,
-					uid_entry->uid, cur->pid,
-					acct.read_bytes, acct.write_bytes,
-					pids_read_bytes, pids_write_bytes);
-			}
+			read_bytes += stats->read_bytes;
+			write_bytes += stats->write_bytes;
 		}
-		pr_debug("%s: %d: %llu %llu\n", __func__,
-			uid_entry->uid, uid_entry->read_bytes,
-			uid_entry->write_bytes);
 		seq_printf(m, "%d: %llu %llu\n", uid_entry->uid,
-			uid_entry->read_bytes + pids_read_bytes,
-			uid_entry->write_bytes + pids_write_bytes);
+			read_bytes, write_bytes);
 	}
 
-	mutex_unlock(&uid_lock);
+	rcu_read_unlock();
 	return 0;
 }
 
+/* "uid: read_wait_ms fsync_wait_ms dirty_wait_ms" */
+static int ioflowmeter_show_wait(struct seq_file *m, void *v)
+{
+	struct uid_entry *uid_entry;
+	unsigned long bkt;
+	u64 wait_ns[UID_IO_WAIT_NR];
+	int cpu, i;
+
+	rcu_read_lock();
+
+	hash_for_each_rcu(ioflowmeter_hash_table, bkt, uid_entry, hash) {
+		memset(wait_ns, 0, sizeof(wait_ns));
+		for_each_possible_cpu(cpu) {
+			struct uid_io_stats *stats =
+				per_cpu_ptr(uid_entry->stats, cpu);
+
+			for (i = 0; i < UID_IO_WAIT_NR; i++)
+				wait_ns[i] += stats->wait_ns[i];
+		}
+		seq_printf(m, "%d: %llu %llu %llu\n", uid_entry->uid,
+			div_u64(wait_ns[UID_IO_WAIT_READ], NSEC_PER_MSEC),
+			div_u64(wait_ns[UID_IO_WAIT_FSYNC], NSEC_PER_MSEC),
+			div_u64(wait_ns[UID_IO_WAIT_DIRTY], NSEC_PER_MSEC));
+	}
+
+	rcu_read_unlock();
+	return 0;
+}
+
+static int ioflowmeter_show_wait_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ioflowmeter_show_wait, PDE_DATA(inode));
+}
+
+static const struct file_operations ioflowmeter_show_wait_fops = {
+	.open		= ioflowmeter_show_wait_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int ioflowmeter_show_stats_open(struct inode *inode, struct file *file)
 {
 	return single_open(file, ioflowmeter_show_stats, PDE_DATA(inode));
@@ -281,9 +269,9 @@ static void ioflowmeter_rm_uid_action(uid_t uid)
 
 	uid_entry = ioflowmeter_find_uid(uid);
 	if (uid_entry) {
-		hash_del(&uid_entry->hash);
-		ioflowmeter_del_pid_list(uid_entry);
-		kfree(uid_entry);
+		hash_del_rcu(&uid_entry->hash);
+		static_branch_dec(&uid_iostats_key);
+		call_rcu(&uid_entry->rcu, ioflowmeter_free_uid);
 		uid_entry = NULL;
 	}
 
@@ -413,83 +401,6 @@ static const struct file_operations ioflowmeter_add_uid_fops = {
 	.write		= ioflowmeter_add_uid_write,
 };
 
-static int process_exit_notifier(struct notifier_block *self,
-			unsigned long cmd, void *v)
-{
-	struct task_struct *task = v;
-	struct uid_entry *uid_entry = NULL;
-	uid_t uid;
-	struct task_io_accounting acct;
-
-	if (!task || !thread_group_leader(task))
-		return NOTIFY_OK;
-
-	mutex_lock(&uid_lock);
-	uid = from_kuid_munged(current_user_ns(), task_uid(task));
-	uid_entry = ioflowmeter_find_uid(uid);
-	if (!uid_entry)
-		goto exit;
-
-	memset((void *)&acct, 0, sizeof(struct task_io_accounting));
-	acct = task->ioac;
-	ioflowmeter_io_accounting(task, &acct, 1);
-	pr_debug("%s: the task %s's pid is %d, tgid is %d, the uid is %d, group leader is %d\n",
-			__func__,
-			task->comm,
-			task->pid, task->tgid, uid,
-			thread_group_leader(task));
-
-	pr_debug("%s: the task write_bytes is %llu\n",
-					__func__,
-					acct.write_bytes);
-
-	uid_entry->read_bytes += acct.read_bytes;
-	uid_entry->write_bytes += acct.write_bytes;
-
-	ioflowmeter_del_pid(uid_entry, task->pid);
-
-exit:
-	mutex_unlock(&uid_lock);
-	return NOTIFY_OK;
-}
-
-static struct notifier_block process_exit_notifier_block = {
-	.notifier_call	= process_exit_notifier,
-};
-
-static int process_entry_notifier(struct notifier_block *self,
-			unsigned long cmd, void *v)
-{
-	struct task_struct *task = v;
-	struct uid_entry *uid_entry = NULL;
-	uid_t uid;
-
-	if (!task || !thread_group_leader(task))
-		return NOTIFY_OK;
-
-	mutex_lock(&uid_lock);
-	uid = from_kuid_munged(current_user_ns(), task_uid(task));
-	uid_entry = ioflowmeter_find_uid(uid);
-	if (!uid_entry)
-		goto exit;
-
-	ioflowmeter_add_pid(uid_entry, task->pid);
-	pr_debug("%s: the task %s's pid is %d, tgid is %d, the uid is %d, group leader is %d\n",
-				__func__,
-				task->comm,
-				task->pid, task->tgid, uid,
-				thread_group_leader(task));
-
-
-exit:
-	mutex_unlock(&uid_lock);
-	return NOTIFY_OK;
-}
-
-static struct notifier_block process_entry_notifier_block = {
-	.notifier_call	= process_entry_notifier,
-};
-
 static int __init proc_ioflowmeter_init(void)
 {
 	hash_init(ioflowmeter_hash_table);
@@ -514,12 +425,9 @@ static int __init proc_ioflowmeter_init(void)
 			S_IRUSR | S_IRGRP, parent, &ioflowmeter_show_stats_fops,
 			NULL);
 
-	profile_event_register(PROFILE_TASK_EXIT,
-			&process_exit_notifier_block);
-	profile_event_register(PROFILE_TASK_END_FORK,
-			&process_entry_notifier_block);
-	profile_event_register(PROFILE_END_SETRESUID,
-			&process_entry_notifier_block);
+	proc_create_data("show_uid_iowait",
+			S_IRUSR | S_IRGRP, parent, &ioflowmeter_show_wait_fops,
+			NULL);
 
 	return 0;
 }
@@ -10,6 +10,7 @@
 #include <linux/iommu.h>
 #include <linux/dma-mapping.h>
 #include <linux/slab.h>
+#include <linux/scatterlist.h>
 
 #include <linux/hisi/hi3xxx/global_ddr_map.h>
 #include <linux/hisi/ion-iommu.h>
@@ -270,6 +271,58 @@ static DEVICE_ATTR(dump_pgtbl, S_IRUGO | S_IWUSR, dump_pgtbl_show, dump_pgtbl_st
 
 /* ------------------------------------------------------------------------- */
 
+/*
+ * Time the path ion buffers take: iova allocation from the magazines or
+ * the pool plus the batched map of a @nents entry scatterlist, and the
+ * unmap, @loops times.
+ */
+static void ptbspeed_domain(unsigned long iova_size, unsigned long nents,
+			unsigned long loops)
+{
+	struct timespec stamp1, stamp2;
+	struct iommu_map_format format;
+	struct sg_table table;
+	struct scatterlist *sg;
+	unsigned long ent_size, i;
+	s64 ns_passed;
+
+	if (!nents)
+		nents = iova_size >> PAGE_SHIFT;
+	if (!loops)
+		loops = 1;
+	ent_size = PAGE_ALIGN(iova_size / nents);
+	if (!ent_size)
+		return;
+
+	if (sg_alloc_table(&table, nents, GFP_KERNEL)) {
+		printk(KERN_ERR "sg_alloc_table failed!\n");
+		return;
+	}
+	for_each_sg(table.sgl, sg, table.nents, i)
+		sg_set_page(sg, phys_to_page(0x40000000 + i * ent_size),
+				ent_size, 0);
+
+	getnstimeofday(&stamp1);
+	for (i = 0; i < loops; i++) {
+		memset(&format, 0, sizeof(format));
+		format.prot = IOMMU_READ | IOMMU_WRITE;
+		if (hisi_iommu_map_domain(table.sgl, &format)) {
+			printk(KERN_ERR "hisi_iommu_map_domain failed!\n");
+			break;
+		}
+		hisi_iommu_unmap_domain(&format);
+	}
+	getnstimeofday(&stamp2);
+
+	stamp1 = timespec_sub(stamp2, stamp1);
+	ns_passed = timespec_to_ns(&stamp1);
+
+	printk(KERN_INFO "iommu domain map unmap 0x%lx in %lu ents x %lu needs %lld ns\n",
+			nents * ent_size, nents, i, ns_passed);
+
+	sg_free_table(&table);
+}
+
 static ssize_t ptbspeed_store(struct device *dev, struct device_attribute *attr,
 			const char *buf, size_t size)
 {
@@ -312,6 +365,8 @@ static ssize_t ptbspeed_store(struct device *dev, struct device_attribute *attr,
 
 	printk(KERN_INFO "iommu map unmap 0x%lx needs %lld ns\n",
 			iova_size, ns_passed);
+
+	ptbspeed_domain(iova_size, getopt(buf, "ents"), getopt(buf, "loop"));
 	return size;
 }
 static DEVICE_ATTR(ptbspeed, S_IWUSR, NULL, ptbspeed_store);
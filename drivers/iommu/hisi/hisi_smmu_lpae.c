@@ -183,16 +183,14 @@ static void hisi_smmu_domain_free_lpae(struct iommu_domain *domain)
 
 }
 
-static int hisi_smmu_alloc_init_pte_lpae(smmu_pmd_t *ppmd,
-		unsigned long addr, unsigned long end,
-		unsigned long pfn, u64 prot, unsigned long *flags)
+/* make sure *ppmd points to a pte table */
+static int hisi_smmu_populate_pmd_table_lpae(smmu_pmd_t *ppmd,
+		unsigned long *flags)
 {
-	smmu_pte_t *pte, *start;
 	pgtable_t table;
-	u64 pteval = SMMU_PTE_TYPE;
 
 	if (!smmu_pmd_none_lpae(*ppmd))
-		goto pte_ready;
+		return 0;
 
 	/* Allocate a new set of tables */
 	table = alloc_page(GFP_KERNEL | __GFP_ZERO | __GFP_DMA);
@@ -211,13 +209,41 @@ static int hisi_smmu_alloc_init_pte_lpae(smmu_pmd_t *ppmd,
 		__free_page(table);
 	spin_unlock_irqrestore(&hisi_smmu_dev->lock, *flags);
 
-pte_ready:
-	if (prot & IOMMU_SEC)
-		*ppmd &= (~SMMU_PMD_NS);
+	return 0;
+}
+
+/* make sure *ppgd points to a pmd table */
+static int hisi_smmu_populate_pgd_table_lpae(smmu_pgd_t *ppgd,
+		unsigned long *flags)
+{
+	pgtable_t table;
+
+	if (!smmu_pgd_none_lpae(*ppgd))
+		return 0;
+
+	/* Allocate a new set of tables */
+	table = alloc_page(GFP_KERNEL | __GFP_ZERO | __GFP_DMA);
+	if (!table) {
+		dbg("%s: alloc page fail\n", __func__);
+		return -ENOMEM;
+	}
+	spin_lock_irqsave(&hisi_smmu_dev->lock, *flags);
+	if (smmu_pgd_none_lpae(*ppgd)) {
+		hisi_smmu_flush_pgtable_lpae(page_address(table),
+				SMMU_PAGE_SIZE);
+		smmu_pgd_populate_lpae(ppgd, table, SMMU_PGD_TYPE|SMMU_PGD_NS);
+		hisi_smmu_flush_pgtable_lpae(ppgd, sizeof(*ppgd));
+	} else
+		__free_page(table);
+	spin_unlock_irqrestore(&hisi_smmu_dev->lock, *flags);
+
+	return 0;
+}
+
+static u64 hisi_smmu_pteval_lpae(u64 prot)
+{
+	u64 pteval = SMMU_PTE_TYPE;
 
-	start = (smmu_pte_t *)smmu_pte_page_vaddr_lpae(ppmd)
-		+ smmu_pte_index(addr);
-	pte = start;
 	if (!prot) {
 		pteval |= SMMU_PROT_NORMAL;
 		pteval |= SMMU_PTE_NS;
@@ -248,6 +274,29 @@ pte_ready:
 			pteval |= SMMU_PTE_NS;
 	}
 
+	return pteval;
+}
+
+static int hisi_smmu_alloc_init_pte_lpae(smmu_pmd_t *ppmd,
+		unsigned long addr, unsigned long end,
+		unsigned long pfn, u64 prot, unsigned long *flags)
+{
+	smmu_pte_t *pte, *start;
+	u64 pteval;
+	int ret;
+
+	ret = hisi_smmu_populate_pmd_table_lpae(ppmd, flags);
+	if (ret)
+		return ret;
+
+	if (prot & IOMMU_SEC)
+		*ppmd &= (~SMMU_PMD_NS);
+
+	start = (smmu_pte_t *)smmu_pte_page_vaddr_lpae(ppmd)
+		+ smmu_pte_index(addr);
+	pte = start;
+	pteval = hisi_smmu_pteval_lpae(prot);
+
 	do {
 		if (!pte_is_valid_lpae(pte))
 			*pte = (u64)(__pfn_to_phys(pfn)|pteval);
@@ -269,28 +318,11 @@ static int hisi_smmu_alloc_init_pmd_lpae(smmu_pgd_t *ppgd,
 	int ret = 0;
 	smmu_pmd_t *ppmd, *start;
 	u64 next;
-	pgtable_t table;
 
-	if (!smmu_pgd_none_lpae(*ppgd))
-		goto pmd_ready;
+	ret = hisi_smmu_populate_pgd_table_lpae(ppgd, flags);
+	if (ret)
+		return ret;
 
-	/* Allocate a new set of tables */
-	table = alloc_page(GFP_KERNEL | __GFP_ZERO | __GFP_DMA);
-	if (!table) {
-		dbg("%s: alloc page fail\n", __func__);
-		return -ENOMEM;
-	}
-	spin_lock_irqsave(&hisi_smmu_dev->lock, *flags);
-	if (smmu_pgd_none_lpae(*ppgd)) {
-		hisi_smmu_flush_pgtable_lpae(page_address(table),
-				SMMU_PAGE_SIZE);
-		smmu_pgd_populate_lpae(ppgd, table, SMMU_PGD_TYPE|SMMU_PGD_NS);
-		hisi_smmu_flush_pgtable_lpae(ppgd, sizeof(*ppgd));
-	} else
-		__free_page(table);
-	spin_unlock_irqrestore(&hisi_smmu_dev->lock, *flags);
-
-pmd_ready:
 	if (prot & IOMMU_SEC)
 		*ppgd &= (~SMMU_PGD_NS);
 	start = (smmu_pmd_t *)smmu_pmd_page_vaddr_lpae(ppgd)
@@ -719,21 +751,73 @@ static size_t hisi_smmu_unmap_tile_lpae(struct iommu_domain *domain,
 	return hisi_smmu_unmap_lpae(domain, iova, size);
 }
 
+/* find the pte of @iova, allocating the pmd and pte tables on the way */
+static smmu_pte_t *hisi_smmu_pte_alloc_lpae(unsigned long iova,
+		int prot, unsigned long *flags)
+{
+	smmu_pgd_t *ppgd;
+	smmu_pmd_t *ppmd;
+
+	ppgd = (smmu_pgd_t *)hisi_smmu_dev->va_pgtable_addr
+		+ smmu_pgd_index(iova);
+	if (hisi_smmu_populate_pgd_table_lpae(ppgd, flags))
+		return NULL;
+	if (prot & IOMMU_SEC)
+		*ppgd &= (~SMMU_PGD_NS);
+
+	ppmd = (smmu_pmd_t *)smmu_pmd_page_vaddr_lpae(ppgd)
+		+ smmu_pmd_index(iova);
+	if (hisi_smmu_populate_pmd_table_lpae(ppmd, flags))
+		return NULL;
+	if (prot & IOMMU_SEC)
+		*ppmd &= (~SMMU_PMD_NS);
+
+	return (smmu_pte_t *)smmu_pte_page_vaddr_lpae(ppmd)
+		+ smmu_pte_index(iova);
+}
+
+/*
+ * Map the whole scatterlist in one pass: the range is checked once,
+ * the table walk only happens when the iova crosses into another pte
+ * table, and every pte table touched is cleaned to memory once, after
+ * all of its entries are written, instead of once per sg entry.
+ */
 size_t hisi_iommu_map_sg_lpae(struct iommu_domain *domain, unsigned long iova,
 			 struct scatterlist *sg, unsigned int nents, int prot)
 {
+	struct iommu_domain_data *data;
 	struct scatterlist *s;
-	size_t mapped = 0;
+	smmu_pte_t *pte = NULL, *start = NULL;
+	unsigned long cur = iova;
+	unsigned long flags;
+	size_t mapped = 0, total = 0;
 	unsigned int i, min_pagesz;
-	int ret;
+	u64 pteval;
 
 	if (domain->ops->pgsize_bitmap == 0UL)
 		return 0;
 
+	if (!hisi_smmu_dev->va_pgtable_addr || !domain->priv)
+		return 0;
+
 	min_pagesz = (unsigned int)1 << __ffs(domain->ops->pgsize_bitmap);
 
+	for_each_sg(sg, s, nents, i)
+		total += ALIGN(s->length, SMMU_PAGE_SIZE);
+
+	data = domain->priv;
+	if (!IS_ALIGNED(iova, SMMU_PAGE_SIZE) || iova < data->iova_start ||
+	    iova + total > data->iova_start + data->iova_size) {
+		dbg("%s: iova 0x%lx size 0x%zx out of domain range\n",
+				__func__, iova, total);
+		return 0;
+	}
+
+	pteval = hisi_smmu_pteval_lpae(prot);
+
 	for_each_sg(sg, s, nents, i) {
 		phys_addr_t phys = page_to_phys(sg_page(s)) + s->offset;
+		phys_addr_t end = phys + ALIGN(s->length, SMMU_PAGE_SIZE);
 
 		/*
 		 * We are mapping on IOMMU page boundaries, so offset within
@@ -744,19 +828,40 @@ size_t hisi_iommu_map_sg_lpae(struct iommu_domain *domain, unsigned long iova,
 		if (!IS_ALIGNED(s->offset, min_pagesz))
 			goto out_err;
 
-		ret = hisi_smmu_map_lpae(domain, iova + mapped, phys,
-					(size_t)s->length, prot);
-		if (ret)
-			goto out_err;
+		smmu_trace_hook(MEM_ALLOC, cur, phys, s->length);
+		for (; phys < end; phys += SMMU_PAGE_SIZE,
+				cur += SMMU_PAGE_SIZE, pte++) {
+			if (!pte || !smmu_pte_index(cur)) {
+				if (pte)
+					hisi_smmu_flush_pgtable_lpae(start,
+						sizeof(*pte) * (pte - start));
+				pte = hisi_smmu_pte_alloc_lpae(cur, prot,
+							&flags);
+				if (!pte)
+					goto out_err;
+				start = pte;
+			}
+
+			if (!pte_is_valid_lpae(pte))
+				*pte = (u64)(phys | pteval);
+			else
+				WARN_ONCE(1, "map to same VA more times!\n");
+		}
 
 		mapped += s->length;
 	}
 
+	if (pte)
+		hisi_smmu_flush_pgtable_lpae(start, sizeof(*pte) * (pte - start));
+
 	return mapped;
 
 out_err:
+	if (pte)
+		hisi_smmu_flush_pgtable_lpae(start, sizeof(*pte) * (pte - start));
 	/* undo mappings already done */
-	hisi_smmu_unmap_lpae(domain, iova, mapped);
+	if (cur > iova)
+		hisi_smmu_unmap_lpae(domain, iova, cur - iova);
 
 	return 0;
 }
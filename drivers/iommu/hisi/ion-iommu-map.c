@@ -28,6 +28,7 @@
 #include <linux/seq_file.h>
 #include <linux/sizes.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <linux/types.h>
 #include <linux/hisi/hisi-iommu.h>
 #include <linux/hisi/ion-iommu.h>
@@ -51,23 +52,122 @@ struct iommu_domain_data *domain_info;
 static struct hisi_iommu_domain *m_hisi_domain;
 DEFINE_MUTEX(iova_pool_mutex);
 
+/*
+ * Freed iova ranges of the common small sizes are kept in a magazine per
+ * size, counted in pool granules, and handed out again without going
+ * through the gen_pool bitmap search under iova_pool_mutex. A range is
+ * only put in a magazine once it is unmapped. The magazines are emptied
+ * back to the pool when the pool itself runs out.
+ */
+#define IOVA_MAG_CLASSES	16
+#define IOVA_MAG_SIZE		8
+
+struct iova_magazine {
+	unsigned int nr;
+	unsigned long iova[IOVA_MAG_SIZE];
+};
+
+static struct iova_magazine iova_mags[IOVA_MAG_CLASSES];
+static DEFINE_SPINLOCK(iova_mag_lock);
+
+/* magazine index for @size, or -1 when it is not cached */
+static int iova_mag_class(struct gen_pool *pool, unsigned long size)
+{
+	unsigned long granules;
+
+	granules = DIV_ROUND_UP(size, 1UL << pool->min_alloc_order);
+	if (!granules || granules > IOVA_MAG_CLASSES)
+		return -1;
+	return (int)granules - 1;
+}
+
+static unsigned long iova_mag_get(struct gen_pool *pool, unsigned long size)
+{
+	struct iova_magazine *mag;
+	unsigned long iova = 0;
+	int class = iova_mag_class(pool, size);
+
+	if (class < 0)
+		return 0;
+
+	mag = &iova_mags[class];
+	spin_lock(&iova_mag_lock);
+	if (mag->nr)
+		iova = mag->iova[--mag->nr];
+	spin_unlock(&iova_mag_lock);
+
+	return iova;
+}
+
+static bool iova_mag_put(struct gen_pool *pool, unsigned long iova,
+		unsigned long size)
+{
+	struct iova_magazine *mag;
+	bool cached = false;
+	int class = iova_mag_class(pool, size);
+
+	if (class < 0)
+		return false;
+
+	mag = &iova_mags[class];
+	spin_lock(&iova_mag_lock);
+	if (mag->nr < IOVA_MAG_SIZE) {
+		mag->iova[mag->nr++] = iova;
+		cached = true;
+	}
+	spin_unlock(&iova_mag_lock);
+
+	return cached;
+}
+
+/* should be called with iova_pool_mutex held */
+static unsigned long iova_mag_drain(struct gen_pool *pool)
+{
+	struct iova_magazine *mag;
+	unsigned long iova, freed = 0;
+	size_t size;
+	int class;
+
+	for (class = 0; class < IOVA_MAG_CLASSES; class++) {
+		mag = &iova_mags[class];
+		size = (size_t)(class + 1) << pool->min_alloc_order;
+		spin_lock(&iova_mag_lock);
+		while (mag->nr) {
+			iova = mag->iova[--mag->nr];
+			spin_unlock(&iova_mag_lock);
+			gen_pool_free(pool, iova, size);
+			freed += size;
+			spin_lock(&iova_mag_lock);
+		}
+		spin_unlock(&iova_mag_lock);
+	}
+
+	return freed;
+}
+
 static unsigned long hisi_alloc_iova(struct gen_pool *pool,
 		unsigned long size, unsigned long align)
 {
 	unsigned long iova = 0;
 
+	if (align > (1 << pool->min_alloc_order))
+		WARN(1, "hisi iommu domain cant align to 0x%lx\n", align);
+
+	iova = iova_mag_get(pool, size);
+	if (iova)
+		return iova;
+
 	mutex_lock(&iova_pool_mutex);
 
 	iova = gen_pool_alloc(pool, size);
+	if (!iova && iova_mag_drain(pool))
+		iova = gen_pool_alloc(pool, size);
 	if (!iova) {
 		mutex_unlock(&iova_pool_mutex);
 		pr_err("hisi iommu gen_pool_alloc failed! size = %lu\n", size);
 		return 0;
 	}
 
-	if (align > (1 << pool->min_alloc_order))
-		WARN(1, "hisi iommu domain cant align to 0x%lx\n", align);
-
 	mutex_unlock(&iova_pool_mutex);
 	return iova;
 }
@@ -75,6 +175,9 @@ static unsigned long hisi_alloc_iova(struct gen_pool *pool,
 static void hisi_free_iova(struct gen_pool *pool,
 		unsigned long iova, size_t size)
 {
+	if (iova_mag_put(pool, iova, size))
+		return;
+
 	mutex_lock(&iova_pool_mutex);
 	gen_pool_free(pool, iova, size);
 
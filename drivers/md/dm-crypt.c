@@ -40,10 +40,13 @@ DEFINE_TRACE(block_kcryptd_crypt);
 DEFINE_TRACE(block_crypt_map);
 #endif
 
+struct dm_crypt_io;
+
 /*
  * context holding the current state of a multi-part conversion
  */
 struct convert_context {
+	struct dm_crypt_io *io;
 	struct completion restart;
 	struct bio *bio_in;
 	struct bio *bio_out;
@@ -71,6 +74,14 @@ struct dm_crypt_io {
 	struct rb_node rb_node;
 } CRYPTO_MINALIGN_ATTR;
 
+/*
+ * Part of a bio converted on another CPU, see kcryptd_crypt_split()
+ */
+struct dm_crypt_chunk {
+	struct work_struct work;
+	struct convert_context ctx;
+};
+
 struct dm_crypt_request {
 	struct convert_context *ctx;
 	struct scatterlist sg_in;
@@ -119,7 +130,7 @@ struct iv_tcw_private {
  * and encrypts / decrypts at the same time.
  */
 enum flags { DM_CRYPT_SUSPENDED, DM_CRYPT_KEY_VALID,
-	     DM_CRYPT_SAME_CPU, DM_CRYPT_NO_OFFLOAD };
+	     DM_CRYPT_SAME_CPU, DM_CRYPT_NO_OFFLOAD, DM_CRYPT_INLINE };
 
 /*
  * The fields in here must be read only after initialization.
@@ -139,6 +150,8 @@ struct crypt_config {
 
 	struct workqueue_struct *io_queue;
 	struct workqueue_struct *crypt_queue;
+	struct workqueue_struct *chunk_queue;	/* per-cpu, bio chunks */
+	struct workqueue_struct *sync_queue;	/* per-cpu, small reads */
 
 	struct task_struct *write_thread;
 	wait_queue_head_t write_thread_wait;
@@ -188,6 +201,27 @@ struct crypt_config {
 
 #define MIN_IOS        16
 
+/*
+ * Bios larger than this are converted in chunks of this size in parallel,
+ * one chunk per online CPU at a time.
+ */
+#define DM_CRYPT_CHUNK_SECTORS	128
+
+/*
+ * Reads up to this size are decrypted ahead of the bulk work, see
+ * kcryptd_queue_crypt().
+ */
+#define DM_CRYPT_SMALL_READ_SECTORS	32
+
+/*
+ * inline_crypt: the host controller encrypts with aes-xts and a 512-bit
+ * key, one data unit per 4K page, the data unit number being the page
+ * index in the iv_offset based sector space.
+ */
+#define DM_CRYPT_INLINE_CIPHER		"aes-xts-plain64"
+#define DM_CRYPT_INLINE_KEY_SIZE	64
+#define DM_CRYPT_INLINE_DU_SHIFT	(PAGE_SHIFT - SECTOR_SHIFT)
+
 static void clone_init(struct dm_crypt_io *, struct bio *);
 static void kcryptd_queue_crypt(struct dm_crypt_io *io);
 static u8 *iv_of_dmreq(struct crypt_config *cc, struct dm_crypt_request *dmreq);
@@ -818,6 +852,7 @@ static void crypt_convert_init(struct crypt_config *cc,
 	if (bio_out)
 		ctx->iter_out = bio_out->bi_iter;
 	ctx->cc_sector = sector + cc->iv_offset;
+	atomic_set(&ctx->cc_pending, 1);
 	init_completion(&ctx->restart);
 }
 
@@ -920,8 +955,6 @@ static int crypt_convert(struct crypt_config *cc,
 {
 	int r;
 
-	atomic_set(&ctx->cc_pending, 1);
-
 	while (ctx->iter_in.bi_size && ctx->iter_out.bi_size) {
 
 		crypt_alloc_req(cc, ctx);
@@ -1046,6 +1079,7 @@ static void crypt_io_init(struct dm_crypt_io *io, struct crypt_config *cc,
 	io->base_bio = bio;
 	io->sector = sector;
 	io->error = 0;
+	io->ctx.io = io;
 	io->ctx.req = NULL;
 	atomic_set(&io->io_pending, 0);
 }
@@ -1284,6 +1318,95 @@ static void kcryptd_crypt_write_io_submit(struct dm_crypt_io *io, int async)
 	spin_unlock_irqrestore(&cc->write_thread_wait.lock, flags);
 }
 
+static void kcryptd_crypt_read_done(struct dm_crypt_io *io);
+
+/*
+ * All the sectors of ctx are converted. A chunk then drops its reference
+ * on the context of its bio, and the bio is complete once that one is.
+ */
+static void kcryptd_crypt_done(struct convert_context *ctx)
+{
+	struct dm_crypt_io *io = ctx->io;
+
+	if (ctx != &io->ctx) {
+		if (ctx->req)
+			crypt_free_req(io->cc, ctx->req, io->base_bio);
+		kfree(container_of(ctx, struct dm_crypt_chunk, ctx));
+
+		if (!atomic_dec_and_test(&io->ctx.cc_pending))
+			return;
+	}
+
+	if (bio_data_dir(io->base_bio) == READ)
+		kcryptd_crypt_read_done(io);
+	else
+		kcryptd_crypt_write_io_submit(io, 1);
+}
+
+static void kcryptd_crypt_chunk(struct work_struct *work)
+{
+	struct dm_crypt_chunk *chunk = container_of(work, struct dm_crypt_chunk,
+						    work);
+	struct convert_context *ctx = &chunk->ctx;
+	struct dm_crypt_io *io = ctx->io;
+
+	if (crypt_convert(io->cc, ctx) < 0)
+		io->error = -EIO;
+
+	if (atomic_dec_and_test(&ctx->cc_pending))
+		kcryptd_crypt_done(ctx);
+}
+
+/*
+ * With the CE/NEON ciphers a sector is encrypted on the CPU that submits
+ * it, so one large bio keeps a single CPU busy while the others idle.
+ * Hand all but the last DM_CRYPT_CHUNK_SECTORS of io->ctx to the chunk
+ * workers of the other online CPUs, in turn; io->ctx keeps the tail. If
+ * a chunk cannot be allocated, the rest is simply converted here.
+ */
+static void kcryptd_crypt_split(struct crypt_config *cc, struct dm_crypt_io *io)
+{
+	struct convert_context *ctx = &io->ctx;
+	unsigned int size = DM_CRYPT_CHUNK_SECTORS << SECTOR_SHIFT;
+	struct dm_crypt_chunk *chunk;
+	int cpu;
+
+	if (test_bit(DM_CRYPT_SAME_CPU, &cc->flags) || num_online_cpus() < 2)
+		return;
+
+	cpu = raw_smp_processor_id();
+	while (ctx->iter_in.bi_size > size && ctx->iter_out.bi_size > size) {
+		chunk = kmalloc(sizeof(*chunk), GFP_NOWAIT | __GFP_NOWARN);
+		if (!chunk)
+			break;
+
+		chunk->ctx.io = io;
+		chunk->ctx.bio_in = ctx->bio_in;
+		chunk->ctx.bio_out = ctx->bio_out;
+		chunk->ctx.iter_in = ctx->iter_in;
+		chunk->ctx.iter_in.bi_size = size;
+		chunk->ctx.iter_out = ctx->iter_out;
+		chunk->ctx.iter_out.bi_size = size;
+		chunk->ctx.cc_sector = ctx->cc_sector;
+		chunk->ctx.req = NULL;
+		atomic_set(&chunk->ctx.cc_pending, 1);
+		init_completion(&chunk->ctx.restart);
+
+		bio_advance_iter(ctx->bio_in, &ctx->iter_in, size);
+		bio_advance_iter(ctx->bio_out, &ctx->iter_out, size);
+		ctx->cc_sector += DM_CRYPT_CHUNK_SECTORS;
+
+		atomic_inc(&ctx->cc_pending);
+
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+
+		INIT_WORK(&chunk->work, kcryptd_crypt_chunk);
+		queue_work_on(cpu, cc->chunk_queue, &chunk->work);
+	}
+}
+
 static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 {
 	struct crypt_config *cc = io->cc;
@@ -1310,6 +1433,7 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 	sector += bio_sectors(clone);
 
 	crypt_inc_pending(io);
+	kcryptd_crypt_split(cc, io);
 	r = crypt_convert(cc, &io->ctx);
 	if (r)
 		io->error = -EIO;
@@ -1340,6 +1464,7 @@ static void kcryptd_crypt_read_convert(struct dm_crypt_io *io)
 	crypt_convert_init(cc, &io->ctx, io->base_bio, io->base_bio,
 			   io->sector);
 
+	kcryptd_crypt_split(cc, io);
 	r = crypt_convert(cc, &io->ctx);
 	if (r < 0)
 		io->error = -EIO;
@@ -1355,7 +1480,7 @@ static void kcryptd_async_done(struct crypto_async_request *async_req,
 {
 	struct dm_crypt_request *dmreq = async_req->data;
 	struct convert_context *ctx = dmreq->ctx;
-	struct dm_crypt_io *io = container_of(ctx, struct dm_crypt_io, ctx);
+	struct dm_crypt_io *io = ctx->io;
 	struct crypt_config *cc = io->cc;
 
 	if (error == -EINPROGRESS) {
@@ -1374,10 +1499,7 @@ static void kcryptd_async_done(struct crypto_async_request *async_req,
 	if (!atomic_dec_and_test(&ctx->cc_pending))
 		return;
 
-	if (bio_data_dir(io->base_bio) == READ)
-		kcryptd_crypt_read_done(io);
-	else
-		kcryptd_crypt_write_io_submit(io, 1);
+	kcryptd_crypt_done(ctx);
 }
 
 static void kcryptd_crypt(struct work_struct *work)
@@ -1397,8 +1519,25 @@ static void kcryptd_crypt(struct work_struct *work)
 static void kcryptd_queue_crypt(struct dm_crypt_io *io)
 {
 	struct crypt_config *cc = io->cc;
+	struct bio *bio = io->base_bio;
 
 	INIT_WORK(&io->work, kcryptd_crypt);
+
+	/*
+	 * Someone waits on every read, and a small one is usually a page
+	 * fault or metadata: decrypt it right here if completed in process
+	 * context, else on this CPU's high priority worker rather than
+	 * behind the bulk work of the unbound queue.
+	 */
+	if (bio_data_dir(bio) == READ &&
+	    bio_sectors(bio) <= DM_CRYPT_SMALL_READ_SECTORS) {
+		if (preemptible())
+			kcryptd_crypt(&io->work);
+		else
+			queue_work(cc->sync_queue, &io->work);
+		return;
+	}
+
 	queue_work(cc->crypt_queue, &io->work);
 }
 
@@ -1535,6 +1674,10 @@ static void crypt_dtr(struct dm_target *ti)
 		destroy_workqueue(cc->io_queue);
 	if (cc->crypt_queue)
 		destroy_workqueue(cc->crypt_queue);
+	if (cc->chunk_queue)
+		destroy_workqueue(cc->chunk_queue);
+	if (cc->sync_queue)
+		destroy_workqueue(cc->sync_queue);
 
 	crypt_free_tfms(cc);
 
@@ -1720,6 +1863,44 @@ bad_mem:
 	return -ENOMEM;
 }
 
+/*
+ * inline_crypt feature: leave the encryption to the host controller of the
+ * underlying device. Only possible when its queue supports inline crypto
+ * with our cipher and key size, and when the data units of the device line
+ * up with the pages of the mapping.
+ */
+static int crypt_ctr_inline(struct dm_target *ti)
+{
+	struct crypt_config *cc = ti->private;
+#ifdef CONFIG_HISI_BLK_INLINE_CRYPTO
+	struct request_queue *q = bdev_get_queue(cc->dev->bdev);
+	sector_t mask = (1 << DM_CRYPT_INLINE_DU_SHIFT) - 1;
+
+	if (!q || !is_blk_queue_support_crypto(q)) {
+		ti->error = "Device does not support inline crypto";
+		return -EINVAL;
+	}
+
+	if (strcmp(cc->cipher_string, DM_CRYPT_INLINE_CIPHER) ||
+	    cc->key_size != DM_CRYPT_INLINE_KEY_SIZE) {
+		ti->error = "Inline crypto needs " DM_CRYPT_INLINE_CIPHER
+			    " with a 512-bit key";
+		return -EINVAL;
+	}
+
+	if ((cc->iv_offset & mask) || (cc->start & mask) ||
+	    (ti->begin & mask) || (ti->len & mask)) {
+		ti->error = "Inline crypto mapping not page aligned";
+		return -EINVAL;
+	}
+
+	return 0;
+#else
+	ti->error = "Inline crypto not supported";
+	return -EINVAL;
+#endif
+}
+
 /*
  * Construct an encryption mapping:
  * <cipher> <key> <iv_offset> <dev_path> <start>
@@ -1736,7 +1917,7 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	char dummy;
 
 	static struct dm_arg _args[] = {
-		{0, 3, "Invalid number of feature args"},
+		{0, 4, "Invalid number of feature args"},
 	};
 
 	if (argc < 5) {
@@ -1849,6 +2030,9 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 			else if (!strcasecmp(opt_string, "submit_from_crypt_cpus"))
 				set_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags);
 
+			else if (!strcasecmp(opt_string, "inline_crypt"))
+				set_bit(DM_CRYPT_INLINE, &cc->flags);
+
 			else {
 				ti->error = "Invalid feature arguments";
 				goto bad;
@@ -1856,6 +2040,12 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		}
 	}
 
+	if (test_bit(DM_CRYPT_INLINE, &cc->flags)) {
+		ret = crypt_ctr_inline(ti);
+		if (ret)
+			goto bad;
+	}
+
 	ret = -ENOMEM;
 	cc->io_queue = alloc_workqueue("kcryptd_io", WQ_MEM_RECLAIM, 1);
 	if (!cc->io_queue) {
@@ -1873,6 +2063,20 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		goto bad;
 	}
 
+	cc->chunk_queue = alloc_workqueue("kcryptd_chunk",
+					  WQ_CPU_INTENSIVE | WQ_MEM_RECLAIM, 0);
+	if (!cc->chunk_queue) {
+		ti->error = "Couldn't create kcryptd chunk queue";
+		goto bad;
+	}
+
+	cc->sync_queue = alloc_workqueue("kcryptd_sync", WQ_HIGHPRI |
+					 WQ_CPU_INTENSIVE | WQ_MEM_RECLAIM, 0);
+	if (!cc->sync_queue) {
+		ti->error = "Couldn't create kcryptd sync queue";
+		goto bad;
+	}
+
 	init_waitqueue_head(&cc->write_thread_wait);
 	cc->write_tree = RB_ROOT;
 
@@ -1913,6 +2117,26 @@ static int crypt_map(struct dm_target *ti, struct bio *bio)
 		return DM_MAPIO_REMAPPED;
 	}
 
+#ifdef CONFIG_HISI_BLK_INLINE_CRYPTO
+	/*
+	 * The controller encrypts on the way out and decrypts on the way in:
+	 * tag the bio with the key and its first data unit and pass it on.
+	 * The host requeues the request while no key slot is free and fails
+	 * it if it cannot be encrypted, it never sends it in plaintext.
+	 */
+	if (test_bit(DM_CRYPT_INLINE, &cc->flags)) {
+		sector_t sector = dm_target_offset(ti, bio->bi_iter.bi_sector);
+
+		bio->bi_bdev = cc->dev->bdev;
+		bio->bi_iter.bi_sector = cc->start + sector;
+		bio->ci_key = cc->key;
+		bio->ci_key_len = cc->key_size;
+		bio->index = (pgoff_t)((cc->iv_offset + sector) >>
+				       DM_CRYPT_INLINE_DU_SHIFT);
+		return DM_MAPIO_REMAPPED;
+	}
+#endif
+
 	io = dm_per_bio_data(bio, cc->per_bio_data_size);
 	crypt_io_init(io, cc, bio, dm_target_offset(ti, bio->bi_iter.bi_sector));
 	io->ctx.req = (struct ablkcipher_request *)(io + 1);
@@ -1957,6 +2181,7 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 		num_feature_args += !!ti->num_discard_bios;
 		num_feature_args += test_bit(DM_CRYPT_SAME_CPU, &cc->flags);
 		num_feature_args += test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags);
+		num_feature_args += test_bit(DM_CRYPT_INLINE, &cc->flags);
 		if (num_feature_args) {
 			DMEMIT(" %d", num_feature_args);
 			if (ti->num_discard_bios)
@@ -1965,6 +2190,8 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 				DMEMIT(" same_cpu_crypt");
 			if (test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags))
 				DMEMIT(" submit_from_crypt_cpus");
+			if (test_bit(DM_CRYPT_INLINE, &cc->flags))
+				DMEMIT(" inline_crypt");
 		}
 
 		break;
@@ -2062,6 +2289,8 @@ static int crypt_iterate_devices(struct dm_target *ti,
 
 static void crypt_io_hints(struct dm_target *ti, struct queue_limits *limits)
 {
+	struct crypt_config *cc = ti->private;
+
 	/*
 	 * Unfortunate constraint that is required to avoid the potential
 	 * for exceeding underlying device's max_segments limits -- due to
@@ -2069,11 +2298,22 @@ static void crypt_io_hints(struct dm_target *ti, struct queue_limits *limits)
 	 * bio that are not as physically contiguous as the original bio.
 	 */
 	limits->max_segment_size = PAGE_SIZE;
+
+	/* a bio must cover whole data units of the inline engine */
+	if (test_bit(DM_CRYPT_INLINE, &cc->flags)) {
+		limits->logical_block_size =
+			max_t(unsigned short, limits->logical_block_size,
+			      PAGE_SIZE);
+		limits->physical_block_size =
+			max_t(unsigned int, limits->physical_block_size,
+			      PAGE_SIZE);
+		limits->io_min = max_t(unsigned int, limits->io_min, PAGE_SIZE);
+	}
 }
 
 static struct target_type crypt_target = {
 	.name   = "crypt",
-	.version = {1, 14, 1},
+	.version = {1, 15, 0},
 	.module = THIS_MODULE,
 	.ctr    = crypt_ctr,
 	.dtr    = crypt_dtr,
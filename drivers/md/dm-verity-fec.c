@@ -416,6 +416,175 @@ static int fec_decode_rsb(struct dm_verity *v, struct dm_verity_io *io,
 	return 0;
 }
 
+/*
+ * Look up a recently corrected block and copy it to fio->output. The copy
+ * is validated against the expected hash like a freshly decoded block.
+ */
+static bool fec_cache_get(struct dm_verity *v, struct dm_verity_io *io,
+			  struct dm_verity_fec_io *fio, sector_t block)
+{
+	struct dm_verity_fec *f = v->fec;
+	struct dm_verity_fec_cache_entry *e;
+	bool found = false;
+	int i;
+
+	if (!fio->output) {
+		fio->output = mempool_alloc(f->output_pool, GFP_NOIO);
+		if (!fio->output)
+			return false;
+	}
+
+	spin_lock(&f->cache_lock);
+	for (i = 0; i < DM_VERITY_FEC_CACHE_SIZE; i++) {
+		e = &f->cache_entries[i];
+		if (e->block != block)
+			continue;
+		memcpy(fio->output, e->data, 1 << v->data_dev_block_bits);
+		e->stamp = ++f->cache_clock;
+		found = true;
+		break;
+	}
+	spin_unlock(&f->cache_lock);
+
+	if (!found)
+		return false;
+
+	if (verity_hash(v, verity_io_hash_desc(v, io), fio->output,
+			1 << v->data_dev_block_bits,
+			verity_io_real_digest(v, io)) ||
+	    memcmp(verity_io_real_digest(v, io), verity_io_want_digest(v, io),
+		   v->digest_size))
+		return false;
+
+	atomic_inc(&f->cache_hits);
+	return true;
+}
+
+/*
+ * Remember a corrected block, replacing the least recently used entry.
+ */
+static void fec_cache_put(struct dm_verity *v, sector_t block, u8 *data)
+{
+	struct dm_verity_fec *f = v->fec;
+	struct dm_verity_fec_cache_entry *e, *victim = &f->cache_entries[0];
+	int i;
+
+	spin_lock(&f->cache_lock);
+	for (i = 0; i < DM_VERITY_FEC_CACHE_SIZE; i++) {
+		e = &f->cache_entries[i];
+		if (e->block == block) {
+			victim = e;
+			break;
+		}
+		if (e->stamp < victim->stamp)
+			victim = e;
+	}
+	memcpy(victim->data, data, 1 << v->data_dev_block_bits);
+	victim->block = block;
+	victim->stamp = ++f->cache_clock;
+	spin_unlock(&f->cache_lock);
+}
+
+static bool fec_cache_has(struct dm_verity *v, sector_t block)
+{
+	struct dm_verity_fec *f = v->fec;
+	bool found = false;
+	int i;
+
+	spin_lock(&f->cache_lock);
+	for (i = 0; i < DM_VERITY_FEC_CACHE_SIZE; i++) {
+		if (f->cache_entries[i].block == block) {
+			found = true;
+			break;
+		}
+	}
+	spin_unlock(&f->cache_lock);
+
+	return found;
+}
+
+/*
+ * Corruption on aging flash comes in regions. Once a data block needed
+ * correcting, check the blocks after it in the background and correct the
+ * bad ones into the cache, so that the reads following this one find them
+ * there instead of decoding synchronously.
+ *
+ * The range stays within the hash block of the corrected block, which was
+ * just verified, so checking it never walks an unverified part of the tree.
+ */
+static void fec_scrub_work(struct work_struct *work)
+{
+	struct dm_verity_fec *f = container_of(work, struct dm_verity_fec,
+					       scrub_work);
+	struct dm_verity *v = f->v;
+	struct dm_verity_io *io;
+	struct dm_buffer *buf;
+	sector_t block;
+	bool is_zero;
+	u8 *data;
+	int r;
+
+	io = kmalloc(v->ti->per_bio_data_size, GFP_NOIO | __GFP_NORETRY |
+		     __GFP_NOMEMALLOC | __GFP_NOWARN);
+	if (!io)
+		goto out;
+
+	io->v = v;
+	verity_fec_init_io(io);
+
+	for (block = f->scrub_block; block < f->scrub_end; block++) {
+		if (fec_cache_has(v, block))
+			continue;
+
+		r = verity_hash_for_block(v, io, block,
+					  verity_io_want_digest(v, io),
+					  &is_zero);
+		if (r || is_zero)
+			continue;
+
+		data = dm_bufio_read(f->data_bufio, block, &buf);
+		if (IS_ERR(data))
+			r = -EIO;
+		else {
+			r = verity_hash(v, verity_io_hash_desc(v, io), data,
+					1 << v->data_dev_block_bits,
+					verity_io_real_digest(v, io));
+			if (!r && memcmp(verity_io_real_digest(v, io),
+					 verity_io_want_digest(v, io),
+					 v->digest_size))
+				r = -EILSEQ;
+			dm_bufio_release(buf);
+		}
+
+		if (r)
+			verity_fec_decode(v, io, DM_VERITY_BLOCK_TYPE_DATA,
+					  block, NULL, NULL);
+	}
+
+	verity_fec_finish_io(io);
+	kfree(io);
+out:
+	clear_bit(0, &f->scrub_busy);
+}
+
+static void fec_scrub_queue(struct dm_verity *v, sector_t block)
+{
+	struct dm_verity_fec *f = v->fec;
+	sector_t end;
+
+	if (current_work() == &f->scrub_work ||
+	    test_and_set_bit(0, &f->scrub_busy))
+		return;
+
+	end = ((block >> v->hash_per_block_bits) + 1) << v->hash_per_block_bits;
+	end = min(end, block + 1 + DM_VERITY_FEC_SCRUB_AHEAD);
+	end = min(end, v->data_blocks);
+
+	f->scrub_block = block + 1;
+	f->scrub_end = end;
+	queue_work(v->verify_wq, &f->scrub_work);
+}
+
 static int fec_bv_copy(struct dm_verity *v, struct dm_verity_io *io, u8 *data,
 		       size_t len)
 {
@@ -452,6 +621,12 @@ int verity_fec_decode(struct dm_verity *v, struct dm_verity_io *io,
 	if (type == DM_VERITY_BLOCK_TYPE_METADATA)
 		block += v->data_blocks;
 
+	/* a block of a bad region read again, or corrected ahead */
+	if (fec_cache_get(v, io, fio, block)) {
+		r = 0;
+		goto copy;
+	}
+
 	/*
 	 * For RS(M, N), the continuous FEC data is divided into blocks of N
 	 * bytes. Since block size may not be divisible by N, the last block
@@ -484,6 +659,10 @@ int verity_fec_decode(struct dm_verity *v, struct dm_verity_io *io,
 			goto done;
 	}
 
+	fec_cache_put(v, block, fio->output);
+	if (block < v->data_blocks && fio->level == 1)
+		fec_scrub_queue(v, block);
+copy:
 	if (dest)
 		memcpy(dest, fio->output, 1 << v->data_dev_block_bits);
 	else if (iter) {
@@ -560,10 +739,15 @@ void verity_fec_dtr(struct dm_verity *v)
 {
 	struct dm_verity_fec *f = v->fec;
 	struct kobject *kobj = &f->kobj_holder.kobj;
+	int i;
 
 	if (!verity_fec_is_enabled(v))
 		goto out;
 
+	cancel_work_sync(&f->scrub_work);
+	for (i = 0; i < DM_VERITY_FEC_CACHE_SIZE; i++)
+		kfree(f->cache_entries[i].data);
+
 	mempool_destroy(f->rs_pool);
 	mempool_destroy(f->prealloc_pool);
 	mempool_destroy(f->extra_pool);
@@ -679,10 +863,21 @@ static ssize_t corrected_show(struct kobject *kobj, struct kobj_attribute *attr,
 	return sprintf(buf, "%d\n", atomic_read(&f->corrected));
 }
 
+static ssize_t cache_hits_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	struct dm_verity_fec *f = container_of(kobj, struct dm_verity_fec,
+					       kobj_holder.kobj);
+
+	return sprintf(buf, "%d\n", atomic_read(&f->cache_hits));
+}
+
 static struct kobj_attribute attr_corrected = __ATTR_RO(corrected);
+static struct kobj_attribute attr_cache_hits = __ATTR_RO(cache_hits);
 
 static struct attribute *fec_attrs[] = {
 	&attr_corrected.attr,
+	&attr_cache_hits.attr,
 	NULL
 };
 
@@ -705,6 +900,8 @@ int verity_fec_ctr_alloc(struct dm_verity *v)
 		return -ENOMEM;
 	}
 	v->fec = f;
+	f->v = v;
+	INIT_WORK(&f->scrub_work, fec_scrub_work);
 
 	return 0;
 }
@@ -715,7 +912,7 @@ int verity_fec_ctr_alloc(struct dm_verity *v)
  */
 int verity_fec_ctr(struct dm_verity *v)
 {
-	int r;
+	int r, i;
 	struct dm_verity_fec *f = v->fec;
 	struct dm_target *ti = v->ti;
 	struct mapped_device *md = dm_table_get_md(ti->table);
@@ -863,6 +1060,17 @@ int verity_fec_ctr(struct dm_verity *v)
 		return -ENOMEM;
 	}
 
+	spin_lock_init(&f->cache_lock);
+	for (i = 0; i < DM_VERITY_FEC_CACHE_SIZE; i++) {
+		f->cache_entries[i].block = (sector_t)-1;
+		f->cache_entries[i].data = kmalloc(1 << v->data_dev_block_bits,
+						   GFP_KERNEL);
+		if (!f->cache_entries[i].data) {
+			ti->error = "Cannot allocate FEC cache";
+			return -ENOMEM;
+		}
+	}
+
 	/* Reserve space for our per-bio data */
 	ti->per_bio_data_size += sizeof(struct dm_verity_fec_io);
 
@@ -31,11 +31,23 @@
 /* maximum recursion level for verity_fec_decode */
 #define DM_VERITY_FEC_MAX_RECURSION	4
 
+/* recently corrected blocks kept for repeated reads of a bad region */
+#define DM_VERITY_FEC_CACHE_SIZE	16
+
+/* blocks checked and corrected ahead of a corrected data block */
+#define DM_VERITY_FEC_SCRUB_AHEAD	16
+
 #define DM_VERITY_OPT_FEC_DEV		"use_fec_from_device"
 #define DM_VERITY_OPT_FEC_BLOCKS	"fec_blocks"
 #define DM_VERITY_OPT_FEC_START		"fec_start"
 #define DM_VERITY_OPT_FEC_ROOTS		"fec_roots"
 
+struct dm_verity_fec_cache_entry {
+	sector_t block;		/* FEC block number, or -1 if unused */
+	unsigned long stamp;	/* last use, for replacement */
+	u8 *data;		/* corrected block */
+};
+
 /* configuration */
 struct dm_verity_fec {
 	struct dm_dev *dev;	/* parity data device */
@@ -54,6 +66,15 @@ struct dm_verity_fec {
 	struct kmem_cache *cache;	/* cache for buffers */
 	atomic_t corrected;		/* corrected errors */
 	struct dm_kobject_holder kobj_holder;	/* for sysfs attributes */
+	struct dm_verity *v;
+	spinlock_t cache_lock;		/* protects cache and cache_clock */
+	unsigned long cache_clock;
+	struct dm_verity_fec_cache_entry cache_entries[DM_VERITY_FEC_CACHE_SIZE];
+	atomic_t cache_hits;
+	struct work_struct scrub_work;	/* corrects blocks ahead of a reader */
+	unsigned long scrub_busy;
+	sector_t scrub_block;		/* first block to check */
+	sector_t scrub_end;		/* end of the range to check */
 };
 
 /* per-bio data */
@@ -12,6 +12,13 @@
  * hash device. Setting this greatly improves performance when data and hash
  * are on the same disk on different partitions on devices with poor random
  * access behavior.
+ *
+ * "prefetch_ahead" is how far past a sequential read the hashes are
+ * prefetched, so that they are cached when the next read completes.
+ *
+ * "verify_split" is the largest I/O verified by one worker. Larger bios are
+ * split by device mapper and their parts are verified on several CPUs.
+ * It applies to tables loaded afterwards; 0 disables splitting.
  */
 
 #include "dm-verity.h"
@@ -57,6 +64,8 @@ static unsigned long err_count;
 #define DM_VERITY_IO_VEC_INLINE		16
 #define DM_VERITY_MEMPOOL_SIZE		4
 #define DM_VERITY_DEFAULT_PREFETCH_SIZE	262144
+#define DM_VERITY_DEFAULT_PREFETCH_AHEAD	1048576
+#define DM_VERITY_DEFAULT_VERIFY_SPLIT	65536
 
 #define DM_VERITY_MAX_CORRUPTED_ERRS	100
 
@@ -70,6 +79,14 @@ static unsigned dm_verity_prefetch_cluster = DM_VERITY_DEFAULT_PREFETCH_SIZE;
 
 module_param_named(prefetch_cluster, dm_verity_prefetch_cluster, uint, S_IRUGO | S_IWUSR);
 
+static unsigned dm_verity_prefetch_ahead = DM_VERITY_DEFAULT_PREFETCH_AHEAD;
+
+module_param_named(prefetch_ahead, dm_verity_prefetch_ahead, uint, S_IRUGO | S_IWUSR);
+
+static unsigned dm_verity_verify_split = DM_VERITY_DEFAULT_VERIFY_SPLIT;
+
+module_param_named(verify_split, dm_verity_verify_split, uint, S_IRUGO | S_IWUSR);
+
 struct dm_verity_prefetch_work {
 	struct work_struct work;
 	struct dm_verity *v;
@@ -836,6 +853,28 @@ no_prefetch_cluster:
 static void verity_submit_prefetch(struct dm_verity *v, struct dm_verity_io *io)
 {
 	struct dm_verity_prefetch_work *pw;
+	sector_t start = ACCESS_ONCE(v->prefetch_start);
+	sector_t end = ACCESS_ONCE(v->prefetch_end);
+	sector_t block = io->block;
+	sector_t last = io->block + io->n_blocks;
+
+	/*
+	 * The hashes of reads inside the window of a previous sequential read
+	 * are already on their way. The races on the window are harmless: at
+	 * worst a prefetch is repeated or skipped and the verification reads
+	 * the hash blocks itself.
+	 */
+	if (block >= start && last <= end)
+		return;
+
+	/* a read continuing the last window extends it ahead */
+	if (block >= start && block <= end) {
+		last += ACCESS_ONCE(dm_verity_prefetch_ahead) >> v->data_dev_block_bits;
+		if (last > v->data_blocks)
+			last = v->data_blocks;
+	}
+	v->prefetch_start = block;
+	v->prefetch_end = last;
 
 	pw = kmalloc(sizeof(struct dm_verity_prefetch_work),
 		GFP_NOIO | __GFP_NORETRY | __GFP_NOMEMALLOC | __GFP_NOWARN);
@@ -845,11 +884,31 @@ static void verity_submit_prefetch(struct dm_verity *v, struct dm_verity_io *io)
 
 	INIT_WORK(&pw->work, verity_prefetch_io);
 	pw->v = v;
-	pw->block = io->block;
-	pw->n_blocks = io->n_blocks;
+	pw->block = block;
+	pw->n_blocks = last - block;
 	queue_work(v->verify_wq, &pw->work);
 }
 
+/*
+ * Have device mapper split bios larger than "verify_split", so that the
+ * parts complete and are verified in parallel on the unbound workqueue
+ * instead of one worker hashing the whole bio.
+ */
+static int verity_set_split(struct dm_verity *v)
+{
+	sector_t len = ACCESS_ONCE(dm_verity_verify_split) >> SECTOR_SHIFT;
+	sector_t block_sectors = 1 << (v->data_dev_block_bits - SECTOR_SHIFT);
+
+	if (!len || num_online_cpus() < 2)
+		return 0;
+
+	len &= ~(block_sectors - 1);
+	if (len < block_sectors)
+		len = block_sectors;
+
+	return dm_set_target_max_io_len(v->ti, len);
+}
+
 /*
  * Bio map function. It allocates dm_verity_io structure and bio vector and
  * fills them. Then it issues prefetches and the I/O.
@@ -1392,6 +1451,12 @@ int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		goto bad;
 	}
 
+	r = verity_set_split(v);
+	if (r) {
+		ti->error = "Cannot set verification split size";
+		goto bad;
+	}
+
 	ti->per_bio_data_size = sizeof(struct dm_verity_io) +
 				v->shash_descsize + v->digest_size * 2;
 
@@ -63,6 +63,10 @@ struct dm_verity {
 
 	struct workqueue_struct *verify_wq;
 
+	/* data blocks whose hashes were last prefetched, see verity_submit_prefetch */
+	sector_t prefetch_start;
+	sector_t prefetch_end;
+
 	/* starting blocks for each tree level. 0 is the lowest level. */
 	sector_t hash_level_block[DM_VERITY_MAX_LEVELS];
 
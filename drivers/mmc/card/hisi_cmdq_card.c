@@ -286,12 +286,23 @@ static int mmc_blk_cmdq_issue_rw_rq(struct mmc_queue *mq, struct request *req)
 
 	BUG_ON((req->tag < 0) || (req->tag > card->ext_csd.cmdq_depth));
 	BUG_ON(test_and_set_bit(req->tag, &host->cmdq_ctx.active_reqs));
+	stor_lat_start(host->lat_ring, req->tag, req);
 
 	active_mqrq = &mq->mqrq_cmdq[req->tag];
+#ifdef CONFIG_MMC_CMDQ_PIPELINE
+	if (active_mqrq->cmdq_prepped && active_mqrq->req == req) {
+		active_mqrq->cmdq_prepped = false;
+		mc_rq = &active_mqrq->mmc_cmdq_req;
+		goto start;
+	}
+#endif
 	active_mqrq->req = req;
 
 	mc_rq = mmc_blk_cmdq_rw_prep(active_mqrq, mq);
 
+#ifdef CONFIG_MMC_CMDQ_PIPELINE
+start:
+#endif
 
 	ret = mmc_blk_cmdq_start_req(card->host, mc_rq);
 	return ret;
@@ -741,6 +752,7 @@ void mmc_blk_cmdq_complete_rq(struct request *rq)
 	trace_mmc_blk_cmdq_rw_end(cmdq_req->cmdq_req_flags, cmdq_req->tag, cmdq_req->blk_addr,
 			cmdq_req->data.bytes_xfered);
 #endif
+		stor_lat_end(host->lat_ring, cmdq_req->tag, err);
 		blk_end_request(rq, 0, cmdq_req->data.bytes_xfered);
 	}
 
@@ -761,12 +773,16 @@ void mmc_blk_cmdq_req_done(struct mmc_request *mrq)
 {
 	struct request *req = mrq->req;
 
+	if (mrq->data)
+		stor_lat_mark(mrq->host->lat_ring, mrq->cmdq_req->tag,
+			      STOR_LAT_IRQ, 0);
 	blk_complete_request(req);
 }
 EXPORT_SYMBOL(mmc_blk_cmdq_req_done);
 
 extern int cmdq_is_reset(struct mmc_host *host);
-int mmc_blk_cmdq_issue_rq(struct mmc_queue *mq, struct request *req)
+/* the caller holds the host claimed */
+static int __mmc_blk_cmdq_issue_rq(struct mmc_queue *mq, struct request *req)
 {
 	int ret = 0;
 	struct mmc_blk_data *md = mq->data;
@@ -777,8 +793,6 @@ int mmc_blk_cmdq_issue_rq(struct mmc_queue *mq, struct request *req)
 	struct mmc_queue_req *mq_rq = &mq->mqrq_cmdq[req->tag];
 	struct mmc_cmdq_req *cmdq_req = &mq_rq->mmc_cmdq_req;
 
-	mmc_claim_host(card->host);
-
 	if (cmdq_is_reset(card->host)) {
 		ret = -EHOSTUNREACH;
 		goto requeue_for_reset;
@@ -862,7 +876,18 @@ requeue_for_reset:
 	}
 
 switch_failure:
-	mmc_release_host(card->host);
+	return ret;
+}
+
+int mmc_blk_cmdq_issue_rq(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_host *host = mq->card->host;
+	int ret;
+
+	mmc_claim_host(host);
+	ret = __mmc_blk_cmdq_issue_rq(mq, req);
+	mmc_release_host(host);
+
 	return ret;
 }
 
@@ -960,6 +985,92 @@ static void mmc_cmdq_dispatch_req(struct request_queue *q)
 	queue_work(mq->workqueue_cmdq, &mq->work_cmdq);
 }
 
+#ifdef CONFIG_MMC_CMDQ_PIPELINE
+#define MMC_CMDQ_BATCH_MAX	8
+
+static inline bool mmc_cmdq_is_dcmd_req(struct request *req)
+{
+	return !!(req->cmd_flags & (REQ_DISCARD | REQ_FLUSH));
+}
+
+/*
+ * Tag a batch of requests under one queue_lock hold, build the task
+ * descriptors of all of them and only then start issuing, with the
+ * host claimed once for the whole batch rather than per request.
+ * Nothing is fetched while a DCMD (flush or discard) is outstanding,
+ * and a DCMD always ends the batch it was pulled into.
+ */
+static void mmc_cmdq_req_work(struct work_struct *work)
+{
+	struct request *batch[MMC_CMDQ_BATCH_MAX];
+	int tags[MMC_CMDQ_BATCH_MAX];
+	struct request *req;
+	struct mmc_queue *mq =
+		container_of(work, struct mmc_queue, work_cmdq);
+	struct request_queue *q = mq->queue;
+	struct mmc_card *card = mq->card;
+	struct mmc_host *host = card->host;
+	struct mmc_cmdq_context_info *ctx = &host->cmdq_ctx;
+	struct mmc_queue_req *mqrq;
+	bool stop = false;
+	int nr, i;
+
+	down(&mq->thread_sem);
+	while (!stop) {
+		spin_lock_bh(&ctx->cmdq_ctx_lock);
+		if (!mmc_cmdq_should_pull_reqs(host, ctx)) {
+			test_and_set_bit(0, &ctx->req_starved);
+			spin_unlock_bh(&ctx->cmdq_ctx_lock);
+			break;
+		}
+		spin_unlock_bh(&ctx->cmdq_ctx_lock);
+
+		nr = 0;
+		spin_lock_irq(q->queue_lock);
+		while (nr < MMC_CMDQ_BATCH_MAX) {
+			req = blk_peek_request(q);
+			if (!req) {
+				stop = true;
+				break;
+			}
+			if (blk_queue_start_tag(q, req)) {
+				/* rerun from mmc_blk_cmdq_complete_rq */
+				test_and_set_bit(0, &ctx->req_starved);
+				stop = true;
+				break;
+			}
+			tags[nr] = req->tag;
+			batch[nr++] = req;
+			/* a DCMD claims the slot, nothing else is pulled */
+			if (mmc_cmdq_is_dcmd_req(req))
+				break;
+		}
+		spin_unlock_irq(q->queue_lock);
+
+		if (!nr)
+			break;
+
+		mmc_claim_host(host);
+		for (i = 0; i < nr; i++) {
+			if (mmc_cmdq_is_dcmd_req(batch[i]))
+				continue;
+			mqrq = &mq->mqrq_cmdq[tags[i]];
+			mqrq->req = batch[i];
+			mmc_blk_cmdq_rw_prep(mqrq, mq);
+			mqrq->cmdq_prepped = true;
+		}
+		for (i = 0; i < nr; i++) {
+			__mmc_blk_cmdq_issue_rq(mq, batch[i]);
+			/* only this worker hands out tags, safe after issue */
+			mq->mqrq_cmdq[tags[i]].cmdq_prepped = false;
+		}
+		mmc_release_host(host);
+	}
+	up(&mq->thread_sem);
+
+	return;
+}
+#else
 static void mmc_cmdq_req_work(struct work_struct *work)
 {
 	struct request *req;
@@ -999,6 +1110,7 @@ static void mmc_cmdq_req_work(struct work_struct *work)
 
 	return;
 }
+#endif /* CONFIG_MMC_CMDQ_PIPELINE */
 #endif
 
 /**
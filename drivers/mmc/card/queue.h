@@ -42,6 +42,9 @@ struct mmc_queue_req {
 	enum mmc_packed_type	cmd_type;
 	struct mmc_packed	*packed;
 	struct mmc_cmdq_req	mmc_cmdq_req;
+#ifdef CONFIG_MMC_CMDQ_PIPELINE
+	bool			cmdq_prepped;
+#endif
 };
 
 struct mmc_queue {
@@ -81,6 +81,10 @@ int mmc_start_cmdq_request(struct mmc_host *host,
 	mmc_host_clk_hold(host);
 	led_trigger_event(host->led, LED_FULL);
 
+	/* DCMDs carry no tag of their own, only data tasks are traced */
+	if (mrq->data)
+		stor_lat_mark(host->lat_ring, mrq->cmdq_req->tag,
+			      STOR_LAT_DOORBELL, 0);
 	ret = host->cmdq_ops->request(host, mrq);
 	return ret;
 }
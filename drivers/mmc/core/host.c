@@ -604,6 +604,12 @@ int mmc_add_host(struct mmc_host *host)
 #endif
 	mmc_host_clk_sysfs_init(host);
 
+	/* tags index the cmdq_ctx.active_reqs bitmap */
+	if (host->caps2 & MMC_CAP2_CMD_QUEUE)
+		host->lat_ring = stor_lat_ring_alloc(mmc_hostname(host),
+						     STOR_LAT_BACKEND_EMMC,
+						     BITS_PER_LONG);
+
 	mmc_start_host(host);
 	if (!(host->pm_flags & MMC_PM_IGNORE_PM_NOTIFY))
 		register_pm_notifier(&host->pm_notify);
@@ -631,6 +637,8 @@ void mmc_remove_host(struct mmc_host *host)
 #ifdef CONFIG_DEBUG_FS
 	mmc_remove_host_debugfs(host);
 #endif
+	stor_lat_ring_free(host->lat_ring);
+	host->lat_ring = NULL;
 
 	device_del(&host->class_dev);
 
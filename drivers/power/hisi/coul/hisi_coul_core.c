@@ -5234,6 +5234,7 @@ static int hisi_coul_resume(struct platform_device *pdev)
 
     int current_sec = 0;
     int sr_sleep_time = 0;
+    int ocv_updated = 0;
 
     if(NULL == di)
     {
@@ -5264,6 +5265,7 @@ static int hisi_coul_resume(struct platform_device *pdev)
         && (current_sec - di->charging_stop_time > 30*60)){
         //get_ocv_by_vol(di);
         get_ocv_resume(di);
+        ocv_updated = 1;
     }
     else if (di->batt_delta_rc > di->batt_data->fcc*5*10
         && di->charging_state != CHARGING_STATE_CHARGE_START
@@ -5272,16 +5274,24 @@ static int hisi_coul_resume(struct platform_device *pdev)
     	hwlog_info("Update ocv for delta_rc(%d)!\n", di->batt_delta_rc);
         //get_ocv_by_vol(di);
         get_ocv_resume(di);
+        ocv_updated = 1;
         if (old_ocv != di->batt_ocv){
             di->coul_dev_ops->save_ocv(di->batt_ocv, NOT_UPDATE_FCC);/*for set NOT_UPDATE_fCC Flag*/
             di->batt_ocv_valid_to_refresh_fcc = 0;
         }
     }
 	di->coul_dev_ops->exit_eco();
-    di->soc_limit_flag = 2;
-    di->soc_monitor_flag = 2;
-    di->batt_soc = calculate_state_of_charge(di);
-    di->soc_limit_flag = 1;
+    /*
+     * After a short sleep the CC has moved by little, leave soc to
+     * calculate_soc_work, which reads the FIFO samples of the wake period
+     * in one batch, instead of reading the coul on every resume.
+     */
+    if (ocv_updated || sr_sleep_time < 0 || sr_sleep_time >= SR_BATCH_SLEEP_TIME) {
+        di->soc_limit_flag = 2;
+        di->soc_monitor_flag = 2;
+        di->batt_soc = calculate_state_of_charge(di);
+        di->soc_limit_flag = 1;
+    }
 
     DI_UNLOCK();
     if (di->batt_exist){
@@ -143,6 +143,7 @@ typedef enum BASP_FCC_LEARN_EVENT {
 #define SR_DELTA_WAKEUP_TIME   30         // 30 s
 #define SR_TOTAL_TIME          (30 * 60)  // 30 min
 #define SR_DUTY_RATIO          95
+#define SR_BATCH_SLEEP_TIME    60         // 60 s, shorter sleeps update soc in calculate_soc_work
 #define SR_DEVICE_WAKEUP       1
 #define SR_DEVICE_SLEEP        2
 
@@ -26,6 +26,7 @@
 #include <linux/interrupt.h>
 #include <linux/power/hisi/coul/hisi_coul_drv.h>
 #include <linux/timer.h>
+#include <linux/ktime.h>
 #include <linux/rtc.h>
 #include <linux/module.h>
 #include <linux/of.h>
@@ -144,6 +145,7 @@ struct hisi_bci_device_info {
 	struct device *dev;
 	struct notifier_block nb;
 	struct delayed_work hisi_bci_monitor_work;
+	ktime_t last_monitor_time;	/* boottime of the last monitor run */
 	struct work_interval_para interval_data[WORK_INTERVAL_PARA_LEVEL];
 };
 
@@ -941,6 +943,7 @@ static void hisi_bci_battery_work(struct work_struct *work)
 {
 	struct hisi_bci_device_info *di = container_of(work, struct hisi_bci_device_info, hisi_bci_monitor_work.work);
 
+	di->last_monitor_time = ktime_get_boottime();
 	hisi_get_battery_info(di);
 #if defined (CONFIG_HUAWEI_DSM)
 	hisi_get_error_info(di);
@@ -1580,6 +1583,8 @@ static int hisi_bci_battery_resume(struct platform_device *pdev)
 {
 	struct hisi_bci_device_info *di = platform_get_drvdata(pdev);
 	int i = 0, resume_capacity = 0;
+	s64 elapsed_ms;
+	unsigned long delay = 0;
 
 	if (di == NULL) {
 		hwlog_err("di is NULL!\n");
@@ -1603,7 +1608,15 @@ static int hisi_bci_battery_resume(struct platform_device *pdev)
 #if defined (CONFIG_HUAWEI_DSM)
 	g_curr_zero_times = 0;
 #endif
-	schedule_delayed_work(&di->hisi_bci_monitor_work, 0);
+	/*
+	 * Brief wakeups keep the monitor period instead of refreshing the
+	 * battery on every resume: the coulomb counter integrates in hardware
+	 * while asleep, so the next run catches up on the whole sleep at once.
+	 */
+	elapsed_ms = ktime_ms_delta(ktime_get_boottime(), di->last_monitor_time);
+	if (elapsed_ms >= 0 && elapsed_ms < di->monitoring_interval)
+		delay = msecs_to_jiffies(di->monitoring_interval - elapsed_ms);
+	schedule_delayed_work(&di->hisi_bci_monitor_work, delay);
 	hwlog_info("%s:-\n", __func__);
 	return 0;
 }
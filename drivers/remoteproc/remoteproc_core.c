@@ -54,6 +54,16 @@ typedef int (*rproc_handle_resource_t)(struct rproc *rproc,
 /* Unique indices for remoteproc devices */
 static DEFINE_IDA(rproc_dev_index);
 
+/*
+ * Keep the firmware and bootware images of a remote processor in memory
+ * after the boot that loaded them, so that the next power up does not have
+ * to read them from the filesystem again. Clearing it drops the cached
+ * images at the next boot.
+ */
+static bool fw_warm_standby;
+module_param(fw_warm_standby, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(fw_warm_standby, "Cache rproc images across power cycles");
+
 static const char * const rproc_crash_names[] = {
 	[RPROC_MMUFAULT]	= "mmufault",
 };
@@ -1129,6 +1139,54 @@ static void rproc_crash_handler_work(struct work_struct *work)
 		rproc_trigger_recovery(rproc);
 }
 
+/*
+ * rproc_get_fw() - request_firmware() going through the image cache of
+ * @rproc, @cache is either &rproc->fw_cache or &rproc->bw_cache.
+ */
+static int rproc_get_fw(struct rproc *rproc, const char *name,
+			const struct firmware **cache,
+			const struct firmware **fw)
+{
+	int ret;
+
+	if (*cache) {
+		if (fw_warm_standby) {
+			*fw = *cache;
+			return 0;
+		}
+		release_firmware(*cache);
+		*cache = NULL;
+	}
+
+	ret = request_firmware(fw, name, &rproc->dev);
+	if (ret < 0)
+		return ret;
+
+	if (fw_warm_standby)
+		*cache = *fw;
+	return 0;
+}
+
+/* an image that failed to boot is not kept for the next attempt */
+static void rproc_put_fw(const struct firmware **cache,
+			 const struct firmware *fw, int err)
+{
+	if (fw == *cache) {
+		if (!err)
+			return;
+		*cache = NULL;
+	}
+	release_firmware(fw);
+}
+
+static void rproc_drop_fw_cache(struct rproc *rproc)
+{
+	release_firmware(rproc->fw_cache);
+	rproc->fw_cache = NULL;
+	release_firmware(rproc->bw_cache);
+	rproc->bw_cache = NULL;
+}
+
 /**
  * rproc_boot() - boot a remote processor
  * @rproc: handle of a remote processor
@@ -1203,35 +1261,33 @@ int rproc_boot(struct rproc *rproc)
 	}
 #endif
 	/* load firmware */
-	ret = request_firmware(&firmware_p, rproc->firmware, dev);
+	ret = rproc_get_fw(rproc, rproc->firmware, &rproc->fw_cache, &firmware_p);
 	if (ret < 0) {
 		dev_err(dev, "request_firmware failed: %d\n", ret);
 		goto downref_rproc;
 	}
 
 	ret = rproc_fw_boot(rproc, firmware_p);
+	rproc_put_fw(&rproc->fw_cache, firmware_p, ret);
 	if (0 != ret) {
 		pr_err("%s: rproc_fw_boot failed.\n", __func__);
-		release_firmware(firmware_p);
 		goto downref_rproc;
 	}
-	release_firmware(firmware_p);
 
 #ifdef CONFIG_HISI_REMOTEPROC
 	/* load bootware */
-	ret = request_firmware(&firmware_p, rproc->bootware, dev);
+	ret = rproc_get_fw(rproc, rproc->bootware, &rproc->bw_cache, &firmware_p);
 	if (ret < 0) {
 		dev_err(dev, "Failed: bootware request_firmware.%d\n", ret);
 		goto downref_rproc;
 	}
 
 	ret = rproc_bw_load(rproc, firmware_p);
+	rproc_put_fw(&rproc->bw_cache, firmware_p, ret);
 	if (0 != ret) {
 		pr_err("%s: rproc_bw_load failed.\n", __func__);
-		release_firmware(firmware_p);
 		goto downref_rproc;
 	}
-	release_firmware(firmware_p);
 
 	/* flush memory cache */
 	rproc_memory_cache_flush(rproc);
@@ -1375,6 +1431,8 @@ static void rproc_type_release(struct device *dev)
 
 	rproc_delete_debug_dir(rproc);
 
+	rproc_drop_fw_cache(rproc);
+
 	idr_destroy(&rproc->notifyids);
 
 	if (rproc->index >= 0)
@@ -193,13 +193,122 @@ static int ufs_kirin_check_hibern8(struct ufs_hba *hba)
 }
 
 #ifdef CONFIG_SCSI_UFS_INLINE_CRYPTO
+static void ufs_kirin_ksm_init(struct ufs_kirin_host *host)
+{
+	struct ufs_kirin_keyslot_mgr *ksm = &host->ksm;
+	int i;
+
+	spin_lock_init(&ksm->lock);
+	INIT_LIST_HEAD(&ksm->lru);
+	ksm->nr_slots = min_t(int, host->hba->nutrs, UFS_KIRIN_KEY_SLOTS);
+	if (ksm->nr_slots <= 0)
+		ksm->nr_slots = UFS_KIRIN_KEY_SLOTS;
+
+	for (i = 0; i < ksm->nr_slots; i++)
+		list_add_tail(&ksm->slots[i].lru_node, &ksm->lru);
+}
+
+/* the key registers are cleared when the controller is (re)enabled */
+static void ufs_kirin_ksm_invalidate(struct ufs_kirin_host *host)
+{
+	struct ufs_kirin_keyslot_mgr *ksm = &host->ksm;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&ksm->lock, flags);
+	for (i = 0; i < ksm->nr_slots; i++)
+		ksm->slots[i].valid = false;
+	spin_unlock_irqrestore(&ksm->lock, flags);
+}
+
+/*
+ * Find the slot holding @key or take the least recently used idle slot
+ * for it. Returns the slot with a reference held, or -1 if every slot
+ * is in use. *program is set when the key still has to be written.
+ */
+static int ufs_kirin_ksm_get(struct ufs_kirin_host *host, const void *key,
+			     bool *program)
+{
+	struct ufs_kirin_keyslot_mgr *ksm = &host->ksm;
+	struct ufs_kirin_key_slot *slot;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&ksm->lock, flags);
+	for (i = 0; i < ksm->nr_slots; i++) {
+		slot = &ksm->slots[i];
+		if (!slot->valid || slot->key_ptr != key ||
+		    memcmp(slot->key, key, UFS_KIRIN_KEY_SIZE))
+			continue;
+		if (!slot->refcnt++)
+			list_del_init(&slot->lru_node);
+		ksm->hits++;
+		*program = false;
+		goto out;
+	}
+
+	if (list_empty(&ksm->lru)) {
+		ksm->no_slot++;
+		i = -1;
+		goto out;
+	}
+
+	slot = list_first_entry(&ksm->lru, struct ufs_kirin_key_slot, lru_node);
+	list_del_init(&slot->lru_node);
+	if (slot->valid)
+		ksm->evictions++;
+	ksm->misses++;
+	/* not valid until written, a concurrent lookup takes another slot */
+	slot->valid = false;
+	slot->refcnt = 1;
+	slot->key_ptr = key;
+	memcpy(slot->key, key, UFS_KIRIN_KEY_SIZE);
+	i = (int)(slot - ksm->slots);
+	*program = true;
+out:
+	spin_unlock_irqrestore(&ksm->lock, flags);
+	return i;
+}
+
+static void ufs_kirin_ksm_programmed(struct ufs_kirin_host *host, int idx)
+{
+	struct ufs_kirin_keyslot_mgr *ksm = &host->ksm;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ksm->lock, flags);
+	ksm->slots[idx].valid = true;
+	spin_unlock_irqrestore(&ksm->lock, flags);
+}
+
+static void ufs_kirin_uie_utrd_done(struct ufs_hba *hba,
+				    struct ufshcd_lrb *lrbp)
+{
+	struct ufs_kirin_host *host = hba->priv;
+	struct ufs_kirin_keyslot_mgr *ksm = &host->ksm;
+	struct ufs_kirin_key_slot *slot;
+	unsigned long flags;
+
+	if (lrbp->crypto_cci < 0 || lrbp->crypto_cci >= ksm->nr_slots)
+		return;
+
+	slot = &ksm->slots[lrbp->crypto_cci];
+	spin_lock_irqsave(&ksm->lock, flags);
+	if (!WARN_ON(slot->refcnt <= 0) && !--slot->refcnt)
+		list_add_tail(&slot->lru_node, &ksm->lru);
+	spin_unlock_irqrestore(&ksm->lock, flags);
+}
+
 static int ufs_kirin_uie_config_init(struct ufs_hba *hba)
 {
+#ifdef CONFIG_SCSI_UFS_KIRIN_V21
+	struct ufs_kirin_host *host = hba->priv;
+#endif
 	int reg_value = 0;
 	int err = 0;
 
+	ufs_kirin_ksm_invalidate(hba->priv);
+
 #ifdef CONFIG_SCSI_UFS_KIRIN_V21
-	struct ufs_kirin_host *host = hba->priv;
 	writel(1<<SOC_UFS_Sysctrl_UFS_UMECTRL_ufs_ies_en_mask_START,\
 		SOC_UFS_Sysctrl_UFS_UMECTRL_ADDR(host->ufs_sys_ctrl));
 #endif
@@ -243,9 +352,9 @@ static void ufs_kirin_uie_key_prepare(struct ufs_hba *hba, int key_len,
 	/* key operation start */
 	reg_value = ufshcd_readl(hba, UFS_REG_CRYPTOCFG_0_16 + (key_cfg * 0x80));
 	if ((reg_value >> 31) & 0x1) {
-		/* TODO step 1st
-		 * Verify that no pending transactions reference x-CRYPTOCFG
-		 * in their CCI field, i.e. UTRD.CCI != x for all pending transactions
+		/* step 1st
+		 * No pending transaction references x-CRYPTOCFG in its CCI
+		 * field: the key slot manager only hands out idle slots.
 		 */
 
 		/*step 2nd writing 0x0 to clear x-CRYPTOCFG reg*/
@@ -274,16 +383,22 @@ static void ufs_kirin_uie_key_prepare(struct ufs_hba *hba, int key_len,
 #endif
 }
 
-/* configure UTRD to enable cryptographic operations for this transaction. */
-static void ufs_kirin_uie_utrd_prepare(struct ufs_hba *hba,
+/*
+ * configure UTRD to enable cryptographic operations for this transaction.
+ * A request that carries a key must never be sent in plaintext: returns
+ * -EBUSY when no key slot is free, so it is retried, and -EIO when the
+ * engine cannot handle the command at all.
+ */
+static int ufs_kirin_uie_utrd_prepare(struct ufs_hba *hba,
 		struct ufshcd_lrb *lrbp)
 {
 	struct utp_transfer_req_desc *req_desc = lrbp->utr_descriptor_ptr;
 	u32 dword_0, dword_1, dword_3;
 	u64 dun;
 	u32 crypto_enable;
-	u32 crypto_cci;
+	int crypto_cci;
 	unsigned long flags;
+	bool program = false;
 
 	/*
 	 * According to UFS 2.1 SPEC
@@ -292,23 +407,31 @@ static void ufs_kirin_uie_utrd_prepare(struct ufs_hba *hba,
 	 * And Kirin UFS controller only support SCSI cmd as below:
 	 * READ_6/READ_10/WRITE_6/WRITE_10
 	 */
+	if (!lrbp->cmd->request || !lrbp->cmd->request->ci_key)
+		return 0;
+
 	switch (lrbp->cmd->cmnd[0]) {
 	case READ_10:
 	case WRITE_10:
 		crypto_enable = UTP_REQ_DESC_CRYPTO_ENABLE;
 		break;
 	default:
-		return;
+		dev_err(hba->dev, "%s: opcode 0x%x cannot be encrypted\n",
+			__func__, lrbp->cmd->cmnd[0]);
+		return -EIO;
 	}
 
-	if (lrbp->cmd->request && lrbp->cmd->request->ci_key) {
-		crypto_cci = lrbp->task_tag;
+	crypto_cci = ufs_kirin_ksm_get(hba->priv, lrbp->cmd->request->ci_key,
+				       &program);
+	if (crypto_cci < 0)
+		return -EBUSY;
+	lrbp->crypto_cci = crypto_cci;
+	if (program) {
 		spin_lock_irqsave(hba->host->host_lock, flags);
 		ufs_kirin_uie_key_prepare(hba, lrbp->cmd->request->ci_key_len,
-					 crypto_cci, lrbp->cmd->request->ci_key);
+					  crypto_cci, lrbp->cmd->request->ci_key);
 		spin_unlock_irqrestore(hba->host->host_lock, flags);
-	} else {
-		return;
+		ufs_kirin_ksm_programmed(hba->priv, crypto_cci);
 	}
 
 #if 0
@@ -322,13 +445,15 @@ static void ufs_kirin_uie_utrd_prepare(struct ufs_hba *hba,
 
 	/* dev_err(hba->dev, "%s: dun is 0x%llx\n", __func__, dun); */
 
-	dword_0 = crypto_enable | crypto_cci;
+	dword_0 = crypto_enable | (u32)crypto_cci;
 	dword_1 = (u32)(dun & 0xffffffff);
 	dword_3 = (u32)((dun >> 32)  & 0xffffffff);
 
 	req_desc->header.dword_0 |= cpu_to_le32(dword_0);
 	req_desc->header.dword_1 = cpu_to_le32(dword_1);
 	req_desc->header.dword_3 = cpu_to_le32(dword_3);
+
+	return 0;
 }
 #endif
 
@@ -1496,14 +1621,29 @@ static ssize_t ufs_kirin_inline_stat_show(struct device *dev,
 	struct ufs_hba *hba = dev_get_drvdata(dev);
 #endif
 	int ret_show = 0;
+#ifdef CONFIG_SCSI_UFS_INLINE_CRYPTO
+	struct ufs_kirin_keyslot_mgr *ksm;
+	unsigned long flags;
+	ssize_t ret;
+#endif
 
 #ifdef CONFIG_SCSI_UFS_INLINE_CRYPTO
 	if (ufshcd_readl(hba, REG_CONTROLLER_CAPABILITIES)
 					& MASK_INLINE_ENCRYPTO_SUPPORT)
 		ret_show = 1;
-#endif
 
+	/* first line stays the support flag */
+	ksm = &((struct ufs_kirin_host *)hba->priv)->ksm;
+	spin_lock_irqsave(&ksm->lock, flags);
+	ret = snprintf(buf, PAGE_SIZE,
+		       "%d\nkey_slots=%d\nhits=%lu\nmisses=%lu\nevictions=%lu\nno_slot=%lu\n",
+		       ret_show, ksm->nr_slots, ksm->hits, ksm->misses,
+		       ksm->evictions, ksm->no_slot);
+	spin_unlock_irqrestore(&ksm->lock, flags);
+	return ret;
+#else
 	return snprintf(buf, PAGE_SIZE, "%d\n", ret_show);
+#endif
 }
 /*lint -restore*/
 
@@ -1675,6 +1815,9 @@ static int ufs_kirin_init(struct ufs_hba *hba)
 
 	ufs_kirin_soc_init(hba);
 
+#ifdef CONFIG_SCSI_UFS_INLINE_CRYPTO
+	ufs_kirin_ksm_init(host);
+#endif
 	ufs_kirin_inline_crypto_attr(hba);
 
 	scsi_logging_level = UFS_SCSI_LOGGING_LEVEL;
@@ -1874,6 +2017,7 @@ const struct ufs_hba_variant_ops ufs_hba_kirin_vops = {
 #ifdef CONFIG_SCSI_UFS_INLINE_CRYPTO
 	.uie_config_init = ufs_kirin_uie_config_init,
 	.uie_utrd_pre = ufs_kirin_uie_utrd_prepare,
+	.uie_utrd_done = ufs_kirin_uie_utrd_done,
 #endif
 	.dump_reg = ufs_kirin_reg_dump,
 #ifdef CONFIG_SCSI_UFS_KIRIN_LINERESET_CHECK
@@ -2112,6 +2256,7 @@ const struct ufs_hba_variant_ops ufs_hba_kirin_v21_vops = {
 #ifdef CONFIG_SCSI_UFS_INLINE_CRYPTO
 	.uie_config_init = ufs_kirin_uie_config_init,
 	.uie_utrd_pre = ufs_kirin_uie_utrd_prepare,
+	.uie_utrd_done = ufs_kirin_uie_utrd_done,
 #endif
 	.dump_reg = ufs_kirin_reg_dump,
 };
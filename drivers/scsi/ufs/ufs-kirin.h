@@ -183,6 +183,42 @@ enum {
 #define UFS_KIRIN_LIMIT_HS_RATE		PA_HS_MODE_A
 #define UFS_KIRIN_LIMIT_DESIRED_MODE	FAST
 
+#ifdef CONFIG_SCSI_UFS_INLINE_CRYPTO
+#define UFS_KIRIN_KEY_SLOTS	32
+#define UFS_KIRIN_KEY_SIZE	64
+
+/**
+ * struct ufs_kirin_key_slot - one x-CRYPTOCFG/x-CRYPTOKEY register set
+ * @lru_node: on the idle list while no command references the slot
+ * @key_ptr: key the slot was programmed from, checked before @key
+ * @refcnt: commands in flight using the slot
+ * @valid: the registers hold @key
+ */
+struct ufs_kirin_key_slot {
+	struct list_head lru_node;
+	const void *key_ptr;
+	int refcnt;
+	bool valid;
+	u8 key[UFS_KIRIN_KEY_SIZE];
+};
+
+/**
+ * struct ufs_kirin_keyslot_mgr - cache of the programmed key slots
+ * @lock: protects the slots and the idle list
+ * @lru: idle slots, least recently used first
+ */
+struct ufs_kirin_keyslot_mgr {
+	spinlock_t lock;
+	struct list_head lru;
+	int nr_slots;
+	struct ufs_kirin_key_slot slots[UFS_KIRIN_KEY_SLOTS];
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evictions;
+	unsigned long no_slot;
+};
+#endif
+
 struct ufs_kirin_host {
 	struct ufs_hba *hba;
 
@@ -218,6 +254,9 @@ struct ufs_kirin_host {
 	struct ufs_pa_layer_attr dev_req_params;
 
 	struct ufs_rdr_ctrl rdr_ctrl;
+#ifdef CONFIG_SCSI_UFS_INLINE_CRYPTO
+	struct ufs_kirin_keyslot_mgr ksm;
+#endif
 };
 
 #define ufs_kirin_is_link_off(hba) ufshcd_is_link_off(hba)
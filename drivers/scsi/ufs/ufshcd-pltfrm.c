@@ -39,6 +39,7 @@
 #include <linux/blkdev.h>
 #include <linux/blk-mq.h>
 #include <linux/bootdevice.h>
+#include <linux/hisi/hisi_irq_affinity.h>
 
 #include "ufshcd.h"
 
@@ -334,6 +335,7 @@ static int ufshcd_pltfrm_probe(struct platform_device *pdev)
 	void __iomem *mmio_base;
 	struct resource *mem_res;
 	int irq, err;
+	u32 irq_cpu;
 	struct device *dev = &pdev->dev;
 	struct device_node *np = dev->of_node;
 
@@ -396,6 +398,19 @@ static int ufshcd_pltfrm_probe(struct platform_device *pdev)
 		goto out_disable_rpm;
 	}
 
+	/*
+	 * Keep the UFS interrupt on the cpu given by the dts across
+	 * hotplug, completions for other clusters are sent there in
+	 * batches.
+	 */
+	if (!of_property_read_u32(np, "hisi,irq-affinity-cpu", &irq_cpu)) {
+		(void)hisi_irqaffinity_register((unsigned int)irq, (int)irq_cpu);
+		/* or let it follow the load from there */
+		if (of_find_property(np, "hisi,irq-affinity-balance", NULL))
+			(void)hisi_irqaffinity_set_balance((unsigned int)irq,
+							   true, 0);
+	}
+
 #ifdef CONFIG_SCSI_UFS_INLINE_CRYPTO
 	/* to improve writing key efficiency, remap key regs with writecombine */
 	err = ufshcd_keyregs_remap_wc(hba, mem_res->start);
@@ -427,6 +442,8 @@ static int ufshcd_pltfrm_remove(struct platform_device *pdev)
 	struct ufs_hba *hba =  (struct ufs_hba *)platform_get_drvdata(pdev);
 
 	pm_runtime_get_sync(&(pdev)->dev);
+	if (of_find_property(pdev->dev.of_node, "hisi,irq-affinity-cpu", NULL))
+		hisi_irqaffinity_unregister(hba->irq);
 	ufshcd_remove(hba);
 	return 0;
 }
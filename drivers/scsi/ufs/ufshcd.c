@@ -112,6 +112,13 @@
 /* Interrupt aggregation default timeout, unit: 40us */
 #define INT_AGGR_DEF_TO	0x02
 
+#ifdef CONFIG_SCSI_UFS_DYN_INTR_AGGR
+#define INT_AGGR_TO_UNIT_US		40
+/* below this many commands in flight every command interrupts */
+#define INT_AGGR_DYN_MIN_DEPTH		4
+#define INT_AGGR_DYN_DEF_MAX_LAT_US	200
+#endif
+
 /* default value of auto suspend is 3000ms*/
 /*#define UFSHCD_AUTO_SUSPEND_DELAY_MS 3000*/
 
@@ -628,6 +635,174 @@ static inline void ufshcd_disable_intr_aggr(struct ufs_hba *hba)
 	ufshcd_writel(hba, 0, REG_UTP_TRANSFER_REQ_INT_AGG_CONTROL);
 }
 
+#ifdef CONFIG_SCSI_UFS_DYN_INTR_AGGR
+/**
+ * ufshcd_dyn_intr_aggr_update - follow the load with the aggregation
+ * @hba: per adapter instance
+ * @completed_reqs: commands completed by this interrupt
+ *
+ * The counter threshold is half the commands still in flight and the
+ * timeout the time that many completions take at the current rate,
+ * capped at max_lat_us. Called with the host lock held.
+ */
+static void ufshcd_dyn_intr_aggr_update(struct ufs_hba *hba,
+					unsigned long completed_reqs)
+{
+	struct ufs_intr_aggr *aggr = &hba->intr_aggr;
+	unsigned int nr = (unsigned int)hweight_long(completed_reqs);
+	unsigned int depth;
+	u64 gap, tmout_us;
+	ktime_t now;
+	u8 cnt, tmout;
+
+	aggr->nr_irqs++;
+	aggr->nr_ios += nr;
+
+	if (!aggr->dynamic || !nr)
+		return;
+
+	now = ktime_get();
+	gap = div_u64((u64)ktime_to_ns(ktime_sub(now, aggr->last_irq)), nr);
+	gap = min_t(u64, gap, (u64)aggr->max_lat_us * NSEC_PER_USEC);
+	aggr->last_irq = now;
+	if (aggr->gap_avg_ns)
+		aggr->gap_avg_ns += (gap >> 3) - (aggr->gap_avg_ns >> 3);
+	else
+		aggr->gap_avg_ns = gap;
+
+	depth = (unsigned int)hweight_long(hba->outstanding_reqs);
+	cnt = (u8)clamp_t(unsigned int, depth / 2, 1,
+			  min_t(unsigned int, hba->nutrs - 1, 0x1F));
+	tmout_us = div_u64(cnt * aggr->gap_avg_ns, NSEC_PER_USEC);
+	tmout_us = min_t(u64, tmout_us, aggr->max_lat_us);
+	tmout = (u8)clamp_t(u64, tmout_us / INT_AGGR_TO_UNIT_US, 1, 0xFF);
+
+	if (cnt == aggr->cnt && tmout == aggr->tmout)
+		return;
+
+	aggr->cnt = cnt;
+	aggr->tmout = tmout;
+	ufshcd_config_intr_aggr(hba, cnt, tmout);
+}
+
+/*
+ * A command issued at low depth interrupts on its own completion so
+ * that a lone sync read never waits on the aggregation timer.
+ */
+static inline bool ufshcd_dyn_intr_aggr_want_intr(struct ufs_hba *hba)
+{
+	if (!ufshcd_is_intr_aggr_allowed(hba))
+		return true;
+
+	return hba->intr_aggr.dynamic &&
+	       hweight_long(hba->outstanding_reqs) < INT_AGGR_DYN_MIN_DEPTH;
+}
+
+static ssize_t ufshcd_intr_aggr_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	struct ufs_intr_aggr *aggr = &hba->intr_aggr;
+	u64 irqs, ios;
+	unsigned long flags;
+	ssize_t ret;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	irqs = aggr->nr_irqs;
+	ios = aggr->nr_ios;
+	ret = snprintf(buf, PAGE_SIZE,
+		       "dynamic=%d\ncnt=%u\ntimeout_us=%u\nmax_lat_us=%u\n",
+		       aggr->dynamic, aggr->cnt,
+		       aggr->tmout * INT_AGGR_TO_UNIT_US, aggr->max_lat_us);
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	ret += snprintf(buf + ret, PAGE_SIZE - ret,
+			"irqs=%llu\nios=%llu\nirqs_per_kio=%llu\n",
+			irqs, ios, ios ? div64_u64(irqs * 1000, ios) : 0);
+	return ret;
+}
+
+/*
+ * "dynamic <0|1>", "max_lat_us <us>" or "reset" to clear the counters.
+ */
+static ssize_t ufshcd_intr_aggr_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	struct ufs_intr_aggr *aggr = &hba->intr_aggr;
+	unsigned long flags;
+	unsigned int value;
+
+	if (sysfs_streq(buf, "reset")) {
+		spin_lock_irqsave(hba->host->host_lock, flags);
+		aggr->nr_irqs = 0;
+		aggr->nr_ios = 0;
+		spin_unlock_irqrestore(hba->host->host_lock, flags);
+		return count;
+	}
+
+	if (sscanf(buf, "max_lat_us %u", &value) == 1) {
+		if (value < INT_AGGR_TO_UNIT_US ||
+		    value > 0xFF * INT_AGGR_TO_UNIT_US)
+			return -EINVAL;
+		spin_lock_irqsave(hba->host->host_lock, flags);
+		aggr->max_lat_us = value;
+		spin_unlock_irqrestore(hba->host->host_lock, flags);
+		return count;
+	}
+
+	if (sscanf(buf, "dynamic %u", &value) != 1)
+		return -EINVAL;
+	if (!ufshcd_is_intr_aggr_allowed(hba))
+		return -EPERM;
+
+	pm_runtime_get_sync(hba->dev);
+	ufshcd_hold(hba, false);
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	aggr->dynamic = !!value;
+	aggr->cnt = 0;
+	aggr->tmout = 0;
+	aggr->gap_avg_ns = 0;
+	ufshcd_config_intr_aggr(hba, hba->nutrs - 1, INT_AGGR_DEF_TO);
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+	ufshcd_release(hba);
+	pm_runtime_put_sync(hba->dev);
+
+	return count;
+}
+
+static void ufshcd_init_intr_aggr(struct ufs_hba *hba)
+{
+	struct ufs_intr_aggr *aggr = &hba->intr_aggr;
+
+	/* the variant has set its caps by now */
+	aggr->dynamic = ufshcd_is_intr_aggr_allowed(hba);
+	aggr->max_lat_us = INT_AGGR_DYN_DEF_MAX_LAT_US;
+
+	aggr->attr.show = ufshcd_intr_aggr_show;
+	aggr->attr.store = ufshcd_intr_aggr_store;
+	sysfs_attr_init(&aggr->attr.attr);
+	aggr->attr.attr.name = "intr_aggr";
+	aggr->attr.attr.mode = S_IRUGO | S_IWUSR;
+	if (device_create_file(hba->dev, &aggr->attr))
+		dev_err(hba->dev, "Failed to create sysfs for intr_aggr\n");
+}
+
+static void ufshcd_exit_intr_aggr(struct ufs_hba *hba)
+{
+	device_remove_file(hba->dev, &hba->intr_aggr.attr);
+}
+#else
+static inline void ufshcd_dyn_intr_aggr_update(struct ufs_hba *hba,
+					       unsigned long completed_reqs) {}
+static inline bool ufshcd_dyn_intr_aggr_want_intr(struct ufs_hba *hba)
+{
+	return !ufshcd_is_intr_aggr_allowed(hba);
+}
+static inline void ufshcd_init_intr_aggr(struct ufs_hba *hba) {}
+static inline void ufshcd_exit_intr_aggr(struct ufs_hba *hba) {}
+#endif
+
 static void ufshcd_enable_auto_hibern8(struct ufs_hba *hba)
 {
 	if (hba->auto_bkops_enabled) {
@@ -639,6 +814,9 @@ static void ufshcd_enable_auto_hibern8(struct ufs_hba *hba)
 			      AUTO_HIBERN8_IDLE_TIMER_VAL(hba->ahit_ah8itv),
 			      REG_CONTROLLER_AHIT);
 		hba->auto_hibern8_enabled = true;
+#ifdef CONFIG_SCSI_UFS_H8_PREDICT
+		hba->h8_predict.ahit = 0;
+#endif
 	}
 }
 
@@ -646,8 +824,195 @@ static void ufshcd_disable_auto_hibern8(struct ufs_hba *hba)
 {
 	ufshcd_writel(hba, 0, REG_CONTROLLER_AHIT);
 	hba->auto_hibern8_enabled = false;
+#ifdef CONFIG_SCSI_UFS_H8_PREDICT
+	hba->h8_predict.ahit = 0;
+#endif
 }
 
+#ifdef CONFIG_SCSI_UFS_H8_PREDICT
+#define UFS_H8_DEF_ACTIVE_US	2000
+#define UFS_H8_DEF_GATE_US	50000
+#define UFS_H8_GATE_DELAY_MS	5
+
+static const char *const ufs_h8_decision_name[UFS_H8_DECISIONS] = {
+	[UFS_H8_STAY_ACTIVE]	= "active",
+	[UFS_H8_AUTO_HIBERN8]	= "hibern8",
+	[UFS_H8_CLK_GATE]	= "clkgate",
+};
+
+/* auto-hibern8 timer register value for an idle time in us */
+static u32 ufshcd_h8_ahit_from_us(unsigned int us)
+{
+	u32 scale = 0;
+
+	while (us > 0x3FF && scale < 5) {
+		us /= 10;
+		scale++;
+	}
+
+	return AUTO_HIBERN8_TIMER_SCALE_VAL(scale) |
+	       AUTO_HIBERN8_IDLE_TIMER_VAL(max_t(u32, min_t(u32, us, 0x3FF), 1));
+}
+
+/*
+ * Called under the host lock when a command is issued with nothing in
+ * flight: the idle period that just ended feeds the average and tells
+ * whether the decision taken for it was right.
+ */
+static void ufshcd_h8_predict_arrival(struct ufs_hba *hba)
+{
+	struct ufs_h8_predict *pred = &hba->h8_predict;
+	u64 idle_us;
+
+	if (!pred->enabled || !ktime_to_ns(pred->idle_start))
+		return;
+
+	idle_us = div_u64((u64)ktime_to_ns(ktime_sub(ktime_get(),
+						      pred->idle_start)),
+			  NSEC_PER_USEC);
+	pred->idle_start = ktime_set(0, 0);
+
+	if (pred->idle_avg_us)
+		pred->idle_avg_us = (pred->idle_avg_us * 3 + idle_us) >> 2;
+	else
+		pred->idle_avg_us = idle_us;
+
+	if ((pred->decision == UFS_H8_STAY_ACTIVE && idle_us >= pred->gate_us) ||
+	    (pred->decision != UFS_H8_STAY_ACTIVE && idle_us < pred->active_us))
+		pred->mispredicts[pred->decision]++;
+}
+
+/*
+ * Called under the host lock when the last command in flight completed,
+ * clocks are still on here so the auto-hibern8 timer can be written.
+ */
+static void ufshcd_h8_predict_idle(struct ufs_hba *hba)
+{
+	struct ufs_h8_predict *pred = &hba->h8_predict;
+	enum ufs_h8_decision decision;
+	u32 ahit;
+
+	if (!pred->enabled)
+		return;
+
+	pred->idle_start = ktime_get();
+
+	if (pred->idle_avg_us < pred->active_us)
+		decision = UFS_H8_STAY_ACTIVE;
+	else if (pred->idle_avg_us < pred->gate_us)
+		decision = UFS_H8_AUTO_HIBERN8;
+	else
+		decision = UFS_H8_CLK_GATE;
+	pred->decision = decision;
+	pred->decisions[decision]++;
+
+	if (hba->auto_hibern8_enabled && ufshcd_is_auto_hibern8_allowed(hba)) {
+		ahit = ufshcd_h8_ahit_from_us(decision == UFS_H8_STAY_ACTIVE ?
+					      pred->gate_us : pred->active_us);
+		if (ahit != pred->ahit) {
+			ufshcd_writel(hba, ahit, REG_CONTROLLER_AHIT);
+			pred->ahit = ahit;
+		}
+	}
+
+	if (decision == UFS_H8_CLK_GATE && ufshcd_is_clkgating_allowed(hba) &&
+	    hba->clk_gating.state == REQ_CLKS_OFF &&
+	    hba->clk_gating.delay_ms > UFS_H8_GATE_DELAY_MS)
+		mod_delayed_work(system_wq, &hba->clk_gating.gate_work,
+				 msecs_to_jiffies(UFS_H8_GATE_DELAY_MS));
+}
+
+static ssize_t ufshcd_h8_predict_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	struct ufs_h8_predict *pred = &hba->h8_predict;
+	unsigned long flags;
+	ssize_t ret;
+	int i;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	ret = snprintf(buf, PAGE_SIZE,
+		       "enabled=%d\nactive_us=%u\ngate_us=%u\nidle_avg_us=%llu\n",
+		       pred->enabled, pred->active_us, pred->gate_us,
+		       pred->idle_avg_us);
+	for (i = 0; i < UFS_H8_DECISIONS; i++)
+		ret += snprintf(buf + ret, PAGE_SIZE - ret,
+				"%s: decisions=%lu, mispredicts=%lu\n",
+				ufs_h8_decision_name[i], pred->decisions[i],
+				pred->mispredicts[i]);
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	return ret;
+}
+
+/*
+ * "enable <0|1>", "active_us <us>", "gate_us <us>" or "reset" to clear
+ * the counters.
+ */
+static ssize_t ufshcd_h8_predict_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	struct ufs_h8_predict *pred = &hba->h8_predict;
+	unsigned long flags;
+	unsigned int value;
+	ssize_t ret = (ssize_t)count;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	if (sysfs_streq(buf, "reset")) {
+		memset(pred->decisions, 0, sizeof(pred->decisions));
+		memset(pred->mispredicts, 0, sizeof(pred->mispredicts));
+	} else if (sscanf(buf, "enable %u", &value) == 1) {
+		pred->enabled = !!value;
+		pred->idle_start = ktime_set(0, 0);
+		pred->idle_avg_us = 0;
+	} else if (sscanf(buf, "active_us %u", &value) == 1 &&
+		   value && value < pred->gate_us) {
+		pred->active_us = value;
+	} else if (sscanf(buf, "gate_us %u", &value) == 1 &&
+		   value > pred->active_us) {
+		pred->gate_us = value;
+	} else {
+		ret = -EINVAL;
+	}
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	/*
+	 * Once disabled the static timer is written back the next time
+	 * auto-hibern8 is enabled, on resume or after a reset.
+	 */
+	return ret;
+}
+
+static void ufshcd_init_h8_predict(struct ufs_hba *hba)
+{
+	struct ufs_h8_predict *pred = &hba->h8_predict;
+
+	pred->enabled = true;
+	pred->active_us = UFS_H8_DEF_ACTIVE_US;
+	pred->gate_us = UFS_H8_DEF_GATE_US;
+
+	pred->attr.show = ufshcd_h8_predict_show;
+	pred->attr.store = ufshcd_h8_predict_store;
+	sysfs_attr_init(&pred->attr.attr);
+	pred->attr.attr.name = "h8_predict";
+	pred->attr.attr.mode = S_IRUGO | S_IWUSR;
+	if (device_create_file(hba->dev, &pred->attr))
+		dev_err(hba->dev, "Failed to create sysfs for h8_predict\n");
+}
+
+static void ufshcd_exit_h8_predict(struct ufs_hba *hba)
+{
+	device_remove_file(hba->dev, &hba->h8_predict.attr);
+}
+#else
+static inline void ufshcd_h8_predict_arrival(struct ufs_hba *hba) {}
+static inline void ufshcd_h8_predict_idle(struct ufs_hba *hba) {}
+static inline void ufshcd_init_h8_predict(struct ufs_hba *hba) {}
+static inline void ufshcd_exit_h8_predict(struct ufs_hba *hba) {}
+#endif
+
 /**
  * ufshcd_enable_run_stop_reg - Enable run-stop registers,
  *			When run-stop registers are set to 1, it indicates the
@@ -1000,7 +1365,10 @@ void ufshcd_send_command(struct ufs_hba *hba, unsigned int task_tag)
 	hba->lrb[task_tag].complete_time_stamp = ktime_set(0, 0);
 
 	ufshcd_clk_scaling_start_busy(hba);
+	if (!hba->outstanding_reqs)
+		ufshcd_h8_predict_arrival(hba);
 	__set_bit(task_tag, &hba->outstanding_reqs);
+	stor_lat_mark(hba->lat_ring, task_tag, STOR_LAT_DOORBELL, 0);
 	ufshcd_writel(hba, 1 << task_tag, REG_UTP_TRANSFER_REQ_DOOR_BELL);
 	/* Make sure that doorbell is committed immediately */
 	wmb();
@@ -1382,15 +1750,28 @@ void ufshcd_prepare_utp_scsi_cmd_upiu(struct ufshcd_lrb *lrbp, u32 upiu_flags)
  * for UFS inline encrypt func
  * @hba: UFS hba
  * @lrbp: local reference block pointer
+ *
+ * Returns 0 on success, or a negative error when the request carries a key
+ * that cannot be loaded into the controller.
  */
 #ifdef CONFIG_SCSI_UFS_INLINE_CRYPTO
 static
-void ufshcd_prepare_req_desc_uie(struct ufs_hba *hba, struct ufshcd_lrb *lrbp)
+int ufshcd_prepare_req_desc_uie(struct ufs_hba *hba, struct ufshcd_lrb *lrbp)
 {
 	if (ufshcd_support_inline_encrypt(hba)) {
 		if (hba->vops && hba->vops->uie_utrd_pre)
-			hba->vops->uie_utrd_pre(hba, lrbp);
+			return hba->vops->uie_utrd_pre(hba, lrbp);
 	}
+	return 0;
+}
+
+/* drop the key slot reference taken by ufshcd_prepare_req_desc_uie() */
+static inline
+void ufshcd_complete_req_desc_uie(struct ufs_hba *hba, struct ufshcd_lrb *lrbp)
+{
+	if (lrbp->crypto_cci >= 0 && hba->vops && hba->vops->uie_utrd_done)
+		hba->vops->uie_utrd_done(hba, lrbp);
+	lrbp->crypto_cci = -1;
 }
 #endif
 
@@ -1468,7 +1849,7 @@ int ufshcd_compose_upiu(struct ufs_hba *hba, struct ufshcd_lrb *lrbp)
 					lrbp->cmd->sc_data_direction);
 			ufshcd_prepare_utp_scsi_cmd_upiu(lrbp, upiu_flags);
 #ifdef CONFIG_SCSI_UFS_INLINE_CRYPTO
-			ufshcd_prepare_req_desc_uie(hba, lrbp);
+			ret = ufshcd_prepare_req_desc_uie(hba, lrbp);
 #endif
 		} else {
 			ret = -EINVAL;
@@ -1902,8 +2283,12 @@ static int ufshcd_queuecommand(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 	lrbp->saved_sense_len = 0;
 	lrbp->task_tag = tag;
 	lrbp->lun = ufshcd_scsi_to_upiu_lun(cmd->device->lun);
-	lrbp->intr_cmd = !ufshcd_is_intr_aggr_allowed(hba) ? true : false;
+	lrbp->intr_cmd = ufshcd_dyn_intr_aggr_want_intr(hba);
 	lrbp->command_type = UTP_CMD_TYPE_SCSI;
+#ifdef CONFIG_SCSI_UFS_INLINE_CRYPTO
+	lrbp->crypto_cci = -1;
+#endif
+	stor_lat_start(hba->lat_ring, tag, cmd->request);
 
 	/*rpmb request issue, and pm_runtime delay time reset longer, after 1 second pm_runtime delay time recover*/
 	if( ((UFS_UPIU_RPMB_WLUN & ~UFS_UPIU_WLUN_ID) | SCSI_W_LUN_BASE) == cmd->device->lun){
@@ -1911,9 +2296,30 @@ static int ufshcd_queuecommand(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 	}
 
 	/* form UPIU before issuing the command */
-	ufshcd_compose_upiu(hba, lrbp);
+	err = ufshcd_compose_upiu(hba, lrbp);
+	if (err) {
+		/*
+		 * An encrypted request that could not be set up: retry it
+		 * when no key slot is free, fail it otherwise.
+		 */
+		lrbp->cmd = NULL;
+		clear_bit_unlock(tag, &hba->lrb_in_use);
+		pm_runtime_put(hba->dev);
+		ufshcd_release(hba);
+		if (err == -EBUSY) {
+			err = SCSI_MLQUEUE_HOST_BUSY;
+		} else {
+			cmd->result = DID_ERROR << 16;
+			cmd->scsi_done(cmd);
+			err = 0;
+		}
+		goto out;
+	}
 	err = ufshcd_map_sg(lrbp);
 	if (err) {
+#ifdef CONFIG_SCSI_UFS_INLINE_CRYPTO
+		ufshcd_complete_req_desc_uie(hba, lrbp);
+#endif
 		lrbp->cmd = NULL;
 		clear_bit_unlock(tag, &hba->lrb_in_use);
 		goto out;
@@ -1932,6 +2338,9 @@ static int ufshcd_queuecommand(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 		WARN_ON(1);/*lint !e730 */
 		err = ufshcd_uic_hibern8_exit(hba);
 		if (err) {
+#ifdef CONFIG_SCSI_UFS_INLINE_CRYPTO
+			ufshcd_complete_req_desc_uie(hba, lrbp);
+#endif
 			lrbp->cmd = NULL;
 			clear_bit_unlock(tag, &hba->lrb_in_use);
 			goto out;
@@ -2873,6 +3282,9 @@ static void ufshcd_host_memory_configure(struct ufs_hba *hba)
 			(struct utp_upiu_rsp *)cmd_descp[i].response_upiu;
 		hba->lrb[i].ucd_prdt_ptr =
 			(struct ufshcd_sg_entry *)cmd_descp[i].prd_table;
+#ifdef CONFIG_SCSI_UFS_INLINE_CRYPTO
+		hba->lrb[i].crypto_cci = -1;
+#endif
 	}
 }
 
@@ -3833,6 +4245,10 @@ static int ufshcd_make_hba_operational(struct ufs_hba *hba)
 #endif
 
 	/* Configure interrupt aggregation */
+#ifdef CONFIG_SCSI_UFS_DYN_INTR_AGGR
+	hba->intr_aggr.cnt = 0;
+	hba->intr_aggr.tmout = 0;
+#endif
 	if (ufshcd_is_intr_aggr_allowed(hba))
 		ufshcd_config_intr_aggr(hba, hba->nutrs - 1, INT_AGGR_DEF_TO);
 	else
@@ -4612,6 +5028,7 @@ check:
 	for_each_set_bit(index, &completed_reqs, hba->nutrs) {
 		lrbp = &hba->lrb[index];
 		lrbp->complete_time_stamp = ktime_get();
+		stor_lat_mark(hba->lat_ring, index, STOR_LAT_IRQ, 0);
 
 		cmd = lrbp->cmd;
 		if (cmd && lrbp->command_type != UTP_CMD_TYPE_DEV_MANAGE) {
@@ -4657,6 +5074,10 @@ check:
 			}
 			/* Mark completed command as NULL in LRB */
 			update_req_stats(hba, lrbp);
+			stor_lat_end(hba->lat_ring, index, result);
+#ifdef CONFIG_SCSI_UFS_INLINE_CRYPTO
+			ufshcd_complete_req_desc_uie(hba, lrbp);
+#endif
 			lrbp->cmd = NULL;
 			clear_bit_unlock(index, &hba->lrb_in_use);
 			/* Do not touch lrbp after scsi done */
@@ -4689,6 +5110,9 @@ check:
 
 	/* clear corresponding bits of completed commands */
 	hba->outstanding_reqs ^= completed_reqs;
+	ufshcd_dyn_intr_aggr_update(hba, completed_reqs);
+	if (completed_reqs && !hba->outstanding_reqs)
+		ufshcd_h8_predict_idle(hba);
 #ifdef CONFIG_SCSI_HISI_MQ
 	if(hba->host->use_blk_mq){
 		if(hba->outstanding_reqs == 0){
@@ -5624,6 +6048,9 @@ static int ufshcd_abort(struct scsi_cmnd *cmd)
 
 	spin_lock_irqsave(host->host_lock, flags);
 	ufshcd_outstanding_req_clear(hba, tag);
+#ifdef CONFIG_SCSI_UFS_INLINE_CRYPTO
+	ufshcd_complete_req_desc_uie(hba, &hba->lrb[tag]);
+#endif
 	hba->lrb[tag].cmd = NULL;
 	spin_unlock_irqrestore(host->host_lock, flags);
 
@@ -7239,9 +7666,14 @@ static int __ufshcd_queuecommand_directly(struct ufs_hba *hba,
 	lrbp->lun = ufshcd_scsi_to_upiu_lun((unsigned int)cmd->device->lun);
 	lrbp->intr_cmd = !ufshcd_is_intr_aggr_allowed(hba) ? true : false;
 	lrbp->command_type = UTP_CMD_TYPE_SCSI;
+#ifdef CONFIG_SCSI_UFS_INLINE_CRYPTO
+	lrbp->crypto_cci = -1;
+#endif
 
 	/* form UPIU before issuing the command */
-	ufshcd_compose_upiu(hba, lrbp);
+	err = ufshcd_compose_upiu(hba, lrbp);
+	if (err)
+		goto out;
 	/* Black Magic, dont touch unless you want a BUG */
 	lrbp->command_type = UTP_CMD_TYPE_DEV_MANAGE;
 	err = ufshcd_map_sg(lrbp);
@@ -8138,8 +8570,13 @@ void ufshcd_remove(struct ufs_hba *hba)
 	ufshcd_disable_intr(hba, hba->intr_mask);
 	ufshcd_hba_stop(hba);
 
+	stor_lat_ring_free(hba->lat_ring);
+	hba->lat_ring = NULL;
+
 	scsi_host_put(hba->host);
 
+	ufshcd_exit_h8_predict(hba);
+	ufshcd_exit_intr_aggr(hba);
 	ufshcd_exit_clk_gating(hba);
 	if (ufshcd_is_clkscaling_enabled(hba))
 		devfreq_remove_device(hba->devfreq);
@@ -8424,6 +8861,10 @@ int ufshcd_init(struct ufs_hba *hba, void __iomem *mmio_base, unsigned int irq)
 	init_waitqueue_head(&hba->dev_cmd.tag_wq);
 
 	ufshcd_init_clk_gating(hba);
+	ufshcd_init_intr_aggr(hba);
+	ufshcd_init_h8_predict(hba);
+	hba->lat_ring = stor_lat_ring_alloc(dev_name(hba->dev),
+					    STOR_LAT_BACKEND_UFS, hba->nutrs);
 	/* IRQ registration */
 	err = devm_request_irq(dev, irq, ufshcd_intr, IRQF_SHARED, UFSHCD, hba);
 	if (err) {
@@ -8477,6 +8918,10 @@ int ufshcd_init(struct ufs_hba *hba, void __iomem *mmio_base, unsigned int irq)
 out_remove_scsi_host:
 	scsi_remove_host(hba->host);
 exit_gating:
+	stor_lat_ring_free(hba->lat_ring);
+	hba->lat_ring = NULL;
+	ufshcd_exit_h8_predict(hba);
+	ufshcd_exit_intr_aggr(hba);
 	ufshcd_exit_clk_gating(hba);
 out_disable:
 	hba->is_irq_enabled = false;
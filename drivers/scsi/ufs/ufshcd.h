@@ -54,6 +54,7 @@
 #include <linux/clk.h>
 #include <linux/completion.h>
 #include <linux/regulator/consumer.h>
+#include <linux/hisi_storage_lat.h>
 #ifdef CONFIG_SCSI_UFS_HS_ERROR_RECOVER
 #include <linux/wakelock.h>
 #endif
@@ -246,6 +247,9 @@ struct ufshcd_lrb {
 	int task_tag;
 	u8 lun; /* UPIU LUN id field is only 8-bit wide */
 	bool intr_cmd;
+#ifdef CONFIG_SCSI_UFS_INLINE_CRYPTO
+	int crypto_cci; /* key slot held by this command, -1 if none */
+#endif
 	ktime_t issue_time_stamp;
 	ktime_t complete_time_stamp;
 };
@@ -447,7 +451,8 @@ struct ufs_hba_variant_ops {
 	void    (*full_reset)(struct ufs_hba *);
 #ifdef CONFIG_SCSI_UFS_INLINE_CRYPTO
 	int     (*uie_config_init)(struct ufs_hba *);
-	void    (*uie_utrd_pre)(struct ufs_hba *, struct ufshcd_lrb *);
+	int     (*uie_utrd_pre)(struct ufs_hba *, struct ufshcd_lrb *);
+	void    (*uie_utrd_done)(struct ufs_hba *, struct ufshcd_lrb *);
 #endif
 	void    (*device_reset)(struct ufs_hba *);
 	/* kirin specific ops */
@@ -518,6 +523,67 @@ struct ufs_inline_state {
 	struct device_attribute inline_attr;
 };
 
+#ifdef CONFIG_SCSI_UFS_H8_PREDICT
+enum ufs_h8_decision {
+	UFS_H8_STAY_ACTIVE,
+	UFS_H8_AUTO_HIBERN8,
+	UFS_H8_CLK_GATE,
+	UFS_H8_DECISIONS,
+};
+
+/**
+ * struct ufs_h8_predict - idle period predictor for hibern8/clock gating
+ * @enabled: predictor drives the auto-hibern8 timer and gating delay
+ * @active_us: predicted idle below this stays active
+ * @gate_us: predicted idle above this gates the clocks early
+ * @idle_start: time the last command completed with nothing in flight
+ * @idle_avg_us: running average of the idle periods
+ * @decision: decision taken for the current idle period
+ * @ahit: auto-hibern8 timer value programmed, 0 if not programmed
+ * @decisions: decisions taken, per decision
+ * @mispredicts: decisions proven wrong by the next arrival
+ * @attr: sysfs entry
+ */
+struct ufs_h8_predict {
+	bool enabled;
+	unsigned int active_us;
+	unsigned int gate_us;
+	ktime_t idle_start;
+	u64 idle_avg_us;
+	enum ufs_h8_decision decision;
+	u32 ahit;
+	unsigned long decisions[UFS_H8_DECISIONS];
+	unsigned long mispredicts[UFS_H8_DECISIONS];
+	struct device_attribute attr;
+};
+#endif
+
+#ifdef CONFIG_SCSI_UFS_DYN_INTR_AGGR
+/**
+ * struct ufs_intr_aggr - load driven transfer completion aggregation
+ * @dynamic: counter and timeout follow the load
+ * @cnt: counter threshold programmed, 0 forces a reprogram
+ * @tmout: timeout programmed, in 40us units
+ * @max_lat_us: latency cap, upper bound of the timeout
+ * @gap_avg_ns: running average of the time between two completions
+ * @last_irq: time of the last transfer completion interrupt
+ * @nr_irqs: transfer completion interrupts
+ * @nr_ios: commands completed by those interrupts
+ * @attr: sysfs entry
+ */
+struct ufs_intr_aggr {
+	bool dynamic;
+	u8 cnt;
+	u8 tmout;
+	unsigned int max_lat_us;
+	u64 gap_avg_ns;
+	ktime_t last_irq;
+	u64 nr_irqs;
+	u64 nr_ios;
+	struct device_attribute attr;
+};
+#endif
+
 struct ufs_clk_scaling {
 	ktime_t  busy_start_t;
 	bool is_busy_started;
@@ -791,7 +857,15 @@ struct ufs_hba {
 
 	struct devfreq *devfreq;
 	struct ufs_clk_scaling clk_scaling;
+#ifdef CONFIG_SCSI_UFS_DYN_INTR_AGGR
+	struct ufs_intr_aggr intr_aggr;
+#endif
+#ifdef CONFIG_SCSI_UFS_H8_PREDICT
+	struct ufs_h8_predict h8_predict;
+#endif
 	struct ufs_stats ufs_stats;
+	/* NULL unless CONFIG_HISI_STORAGE_LAT_TRACE */
+	struct stor_lat_ring *lat_ring;
 #ifdef CONFIG_DEBUG_FS
 	struct debugfs_files debugfs_files;
 #endif
@@ -848,8 +922,9 @@ static inline bool ufshcd_can_autobkops_during_suspend(struct ufs_hba *hba)
 
 static inline bool ufshcd_is_intr_aggr_allowed(struct ufs_hba *hba)
 {
-	if ((hba->caps & UFSHCD_CAP_INTR_AGGR) &&
-	    !(hba->quirks & UFSHCD_QUIRK_BROKEN_INTR_AGGR))
+	if (hba->quirks & UFSHCD_QUIRK_BROKEN_INTR_AGGR)
+		return false;
+	if (hba->caps & UFSHCD_CAP_INTR_AGGR)
 		return true;
 	else
 		return false;
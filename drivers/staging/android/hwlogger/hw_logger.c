@@ -30,6 +30,10 @@
 #include <linux/time.h>
 #include <linux/vmalloc.h>
 #include <linux/aio.h>
+#include <linux/hash.h>
+#include <linux/jhash.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,1,0))
 #include <linux/uio.h>
 #endif
@@ -55,6 +59,33 @@ HWLOG_REGIST();
 #define MAX_NAME_AND_LEVEL_BUFF_SIZE (MAX_NAME_LEN+LEVEL_BUFF_LEN+1)
 #define MAX_LEVEL 0XFF
 
+/*
+ * Every log keeps a small table of token buckets, indexed by a hash of the
+ * writer's tgid and log tag. Keys sharing a slot share its budget. A bucket
+ * is refilled with size/8 bytes per second up to size/2, so that a single
+ * chatty component can not evict everything else from the log.
+ */
+#define LOGGER_BUDGET_BITS 6
+#define LOGGER_BUDGET_SLOTS (1 << LOGGER_BUDGET_BITS)
+#define LOGGER_BUDGET_TAG_LEN 32
+
+static bool budget_enable = true;
+module_param(budget_enable, bool, S_IRUGO | S_IWUSR);
+
+/**
+ * struct logger_bucket - write budget of the writers hashed to one slot
+ * @stamp:	jiffies of the last refill
+ * @tokens:	Bytes that may still be written
+ * @last_pid:	The last process that had an entry dropped
+ * @dropped:	The number of entries dropped
+ */
+struct logger_bucket {
+	unsigned long stamp;
+	u32 tokens;
+	pid_t last_pid;
+	u32 dropped;
+};
+
 struct logger_log_tag {
 	unsigned char *tag_save_buff;
 	struct mutex mutex;
@@ -87,6 +118,11 @@ typedef enum android_LogPriority {
  * @head:	The head, or location that readers start reading at.
  * @size:	The size of the log
  * @logs:	The list of log channels
+ * @buckets:	The write budgets, see LOGGER_BUDGET_SLOTS
+ * @budget_rate:	Bytes per second added to each bucket
+ * @budget_burst:	The capacity of each bucket
+ * @dropped:	The number of entries dropped for being over budget
+ * @dropped_bytes:	The number of bytes dropped for being over budget
  *
  * This structure lives from module insertion until module removal, so it does
  * not need additional reference counting. The structure is protected by the
@@ -102,6 +138,11 @@ struct logger_log {
 	size_t head;
 	size_t size;
 	struct list_head logs;
+	struct logger_bucket *buckets;
+	u32 budget_rate;
+	u32 budget_burst;
+	u64 dropped;
+	u64 dropped_bytes;
 };
 
 static LIST_HEAD(log_list);
@@ -501,12 +542,101 @@ static ssize_t do_write_log_from_user(struct logger_log *log,
 	return count;
 }
 
+/*
+ * logger_budget_slot - returns the bucket of the writer 'tgid' logging
+ * under 'tag'. 'tag' may be NULL, in which case the bucket is per process.
+ */
+static struct logger_bucket *logger_budget_slot(struct logger_log *log,
+						pid_t tgid, const char *tag,
+						size_t tag_len)
+{
+	u32 key = jhash(tag, tag ? tag_len : 0, (u32)tgid);
+
+	return &log->buckets[hash_32(key, LOGGER_BUDGET_BITS)];
+}
+
+/*
+ * logger_budget_refill - add the tokens earned since the last refill.
+ *
+ * The caller needs to hold log->mutex.
+ */
+static void logger_budget_refill(struct logger_log *log,
+				 struct logger_bucket *b)
+{
+	unsigned long now = jiffies;
+	u64 refill;
+
+	refill = (u64)(now - b->stamp) * log->budget_rate / HZ;
+	if (refill) {
+		b->tokens = min_t(u64, b->tokens + refill, log->budget_burst);
+		b->stamp = now;
+	}
+}
+
+/*
+ * logger_budget_drop - account an entry of 'len' bytes dropped from 'b'.
+ *
+ * The caller needs to hold log->mutex.
+ */
+static void logger_budget_drop(struct logger_log *log,
+			       struct logger_bucket *b, size_t len)
+{
+	b->dropped++;
+	b->last_pid = current->tgid;
+	log->dropped++;
+	log->dropped_bytes += len;
+}
+
+/*
+ * logger_budget_charge - take 'len' bytes from 'b'.
+ *
+ * Returns false, and counts a drop, if the bucket can not afford 'len'.
+ *
+ * The caller needs to hold log->mutex.
+ */
+static bool logger_budget_charge(struct logger_log *log,
+				 struct logger_bucket *b, size_t len)
+{
+	if (!budget_enable)
+		return true;
+
+	logger_budget_refill(log, b);
+	if (b->tokens < len) {
+		logger_budget_drop(log, b, len);
+		return false;
+	}
+
+	b->tokens -= len;
+	return true;
+}
+
+/*
+ * logger_budget_user_slot - the bucket of a write() from user space. Android
+ * writers send the priority, the tag and the message as three iovecs; for
+ * anything else the bucket is per process.
+ */
+static struct logger_bucket *logger_budget_user_slot(struct logger_log *log,
+						     const struct iovec *iov,
+						     unsigned long nr_segs)
+{
+	char tag[LOGGER_BUDGET_TAG_LEN];
+	size_t tag_len = 0;
+
+	if (nr_segs == 3 && iov[1].iov_len <= sizeof(tag) &&
+	    !copy_from_user(tag, iov[1].iov_base, iov[1].iov_len))
+		tag_len = iov[1].iov_len;
+
+	return logger_budget_slot(log, current->tgid, tag_len ? tag : NULL,
+				  tag_len);
+}
+
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,1,0))
 static ssize_t hw_logger_write_iter(struct kiocb *iocb, struct iov_iter *from)
 {
 	struct logger_log *log = file_get_log(iocb->ki_filp);
 	size_t orig = log->w_off;
 	struct logger_entry header;
+	struct logger_bucket *bucket;
 	struct timespec now;
 	ssize_t ret = 0;
 	unsigned long nr_segs = from->nr_segs;
@@ -528,8 +658,17 @@ static ssize_t hw_logger_write_iter(struct kiocb *iocb, struct iov_iter *from)
 	if (unlikely(!header.len))
 		return 0;
 
+	bucket = logger_budget_user_slot(log, iov, nr_segs);
+
 	mutex_lock(&log->mutex);
 
+	/* entries over budget are dropped, but reported as written */
+	if (!logger_budget_charge(log, bucket,
+				  sizeof(struct logger_entry) + header.len)) {
+		mutex_unlock(&log->mutex);
+		return header.len;
+	}
+
 	/*
 	 * Fix up any readers, pulling them forward to the first readable
 	 * entry after (what will be) the new write offset. We do this now
@@ -578,6 +717,7 @@ static ssize_t hw_logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 	struct logger_log *log = file_get_log(iocb->ki_filp);
 	size_t orig = log->w_off;
 	struct logger_entry header;
+	struct logger_bucket *bucket;
 	struct timespec now;
 	ssize_t ret = 0;
 
@@ -597,8 +737,17 @@ static ssize_t hw_logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 	if (unlikely(!header.len))
 		return 0;
 
+	bucket = logger_budget_user_slot(log, iov, nr_segs);
+
 	mutex_lock(&log->mutex);
 
+	/* entries over budget are dropped, but reported as written */
+	if (!logger_budget_charge(log, bucket,
+				  sizeof(struct logger_entry) + header.len)) {
+		mutex_unlock(&log->mutex);
+		return header.len;
+	}
+
 	/*
 	 * Fix up any readers, pulling them forward to the first readable
 	 * entry after (what will be) the new write offset. We do this now
@@ -992,6 +1141,47 @@ static const struct file_operations log_tag_fops = {
 	.write = log_tag_write,
 };
 
+/*
+ * /proc/hwlog_budget - the budget of every log and the slots that had
+ * entries dropped.
+ */
+static int log_budget_show(struct seq_file *m, void *v)
+{
+	struct logger_log *log;
+	int i;
+
+	seq_printf(m, "enable %d\n", budget_enable);
+
+	list_for_each_entry(log, &log_list, logs) {
+		mutex_lock(&log->mutex);
+		seq_printf(m, "%s rate %u burst %u dropped %llu bytes %llu\n",
+			   log->misc.name, log->budget_rate, log->budget_burst,
+			   log->dropped, log->dropped_bytes);
+		for (i = 0; i < LOGGER_BUDGET_SLOTS; i++) {
+			struct logger_bucket *b = &log->buckets[i];
+
+			if (b->dropped)
+				seq_printf(m, "  slot %d last_pid %d dropped %u\n",
+					   i, b->last_pid, b->dropped);
+		}
+		mutex_unlock(&log->mutex);
+	}
+
+	return 0;
+}
+
+static int log_budget_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, log_budget_show, NULL);
+}
+
+static const struct file_operations log_budget_fops = {
+	.open = log_budget_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static struct miscdevice log_tag_misc_dev = {
 	.minor = MISC_DYNAMIC_MINOR,
 	.name = "hwlog_tag",
@@ -1008,6 +1198,7 @@ static int __init create_log(char *log_name, int size)
 	int ret = 0;
 	struct logger_log *log;
 	unsigned char *buffer;
+	int i;
 
 	buffer = vmalloc(size);
 	if (buffer == NULL)
@@ -1020,6 +1211,19 @@ static int __init create_log(char *log_name, int size)
 	}
 	log->buffer = buffer;
 
+	log->buckets = kcalloc(LOGGER_BUDGET_SLOTS,
+			       sizeof(struct logger_bucket), GFP_KERNEL);
+	if (log->buckets == NULL) {
+		ret = -ENOMEM;
+		goto out_free_log;
+	}
+	log->budget_rate = size / 8;
+	log->budget_burst = size / 2;
+	for (i = 0; i < LOGGER_BUDGET_SLOTS; i++) {
+		log->buckets[i].stamp = jiffies;
+		log->buckets[i].tokens = log->budget_burst;
+	}
+
 	log->misc.minor = MISC_DYNAMIC_MINOR;
 	log->misc.name = kstrdup(log_name, GFP_KERNEL);
 	if (log->misc.name == NULL) {
@@ -1053,6 +1257,7 @@ static int __init create_log(char *log_name, int size)
 	return 0;
 
 out_free_log:
+	kfree(log->buckets);
 	kfree(log);
 
 out_free_buffer:
@@ -1103,6 +1308,9 @@ static int __init logger_init(void)
 	}
 	pr_info("log_tag_misc_dev:%s  register success.",
 		log_tag_misc_dev.name);
+
+	if (!proc_create("hwlog_budget", S_IRUGO, NULL, &log_budget_fops))
+		pr_err("failed to create /proc/hwlog_budget\n");
 out:
 	return ret;
 }
@@ -1115,10 +1323,12 @@ static void __exit logger_exit(void)
 		/* we have to delete all the entry inside log_list */
 		misc_deregister(&current_log->misc);
 		vfree(current_log->buffer);
+		kfree(current_log->buckets);
 		kfree(current_log->misc.name);
 		list_del(&current_log->logs);
 		kfree(current_log);
 	}
+	remove_proc_entry("hwlog_budget", NULL);
 	misc_deregister(&log_tag_misc_dev);
 	if (log_tag->tag_save_buff != NULL) {
 		vfree(log_tag->tag_save_buff);
@@ -1201,6 +1411,14 @@ ssize_t write_log_to_exception(const char *category, char level,
 
 	mutex_lock(&log->mutex);
 
+	if (!logger_budget_charge(log,
+				  logger_budget_slot(log, 0, category,
+						     strlen(category) + 1),
+				  sizeof(struct logger_entry) + header.len)) {
+		mutex_unlock(&log->mutex);
+		return 0;
+	}
+
 	/*
 	 * Fix up any readers, pulling them forward to the first readable
 	 * entry after (what will be) the new write offset. We do this now
@@ -1234,6 +1452,34 @@ ssize_t write_log_to_exception(const char *category, char level,
 }
 
 EXPORT_SYMBOL(write_log_to_exception);
+
+/*
+ * hw_logger_over_budget - returns true if an entry logged by the current
+ * process under 'tag' to the log 'name' would be dropped. Lets in-kernel
+ * writers skip the work of formatting and opening the log; the drop is
+ * counted.
+ */
+bool hw_logger_over_budget(const char *name, const char *tag, size_t len)
+{
+	struct logger_log *log = get_log_from_name(name);
+	struct logger_bucket *b;
+	bool over;
+
+	if (unlikely(!log || !tag) || !budget_enable)
+		return false;
+
+	b = logger_budget_slot(log, current->tgid, tag, strlen(tag) + 1);
+
+	mutex_lock(&log->mutex);
+	logger_budget_refill(log, b);
+	over = b->tokens < len;
+	if (over)
+		logger_budget_drop(log, b, len);
+	mutex_unlock(&log->mutex);
+
+	return over;
+}
+EXPORT_SYMBOL(hw_logger_over_budget);
 device_initcall(logger_init);
 module_exit(logger_exit);
 
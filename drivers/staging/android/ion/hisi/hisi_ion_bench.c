@@ -0,0 +1,488 @@
+/*
+ *
+ * Copyright (C) 2016 hisilicon, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Allocation benchmark of the ion heaps. For every heap of the dts (or
+ * those in heap_mask), every size and every thread count up to threads,
+ * each thread runs iterations of:
+ *
+ *   ion_alloc, ion_map_kernel/ion_unmap_kernel, ion_share_dma_buf and
+ *   dma_buf_put, ion_map_iommu/ion_unmap_iommu, ion_free
+ *
+ * and the latency of each step is recorded. pressure_mb of movable pages
+ * can be held during the run to measure the heaps under reclaim. Writing
+ * 1 to ion_bench/run runs it, ion_bench/result then holds one line of
+ * key=value per heap, size and thread count. Steps a heap does not
+ * support, like the iommu map of a carveout, report a zero count.
+ */
+
+#define pr_fmt(fmt) "ion_bench: " fmt
+
+#include <linux/debugfs.h>
+#include <linux/dma-buf.h>
+#include <linux/err.h>
+#include <linux/iommu.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/seq_file.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/hisi/hisi_ion.h>
+
+#include "ion.h"
+#include "ion_priv.h"
+
+#define ION_BENCH_MAX_HEAPS	32
+#define ION_BENCH_MAX_THREADS	8
+#define ION_BENCH_MAX_ITERS	1024
+
+static const size_t bench_sizes[] = {
+	SZ_4K, SZ_64K, SZ_1M, SZ_8M,
+};
+
+enum bench_op {
+	BENCH_ALLOC,
+	BENCH_FREE,
+	BENCH_KMAP,
+	BENCH_DMABUF,
+	BENCH_IOMMU_MAP,
+	BENCH_IOMMU_UNMAP,
+	BENCH_OPS,
+};
+
+static const char * const bench_op_names[BENCH_OPS] = {
+	"alloc", "free", "kmap", "dmabuf", "iommu_map", "iommu_unmap",
+};
+
+struct bench_op_stat {
+	u32 count;
+	u32 avg_us;
+	u32 p50_us;
+	u32 p99_us;
+	u32 max_us;
+};
+
+struct bench_result {
+	const char *heap;
+	unsigned int heap_id;
+	size_t size;
+	u32 threads;
+	u32 fails;
+	struct bench_op_stat ops[BENCH_OPS];
+};
+
+struct bench_thread {
+	struct task_struct *task;
+	struct ion_client *client;
+	size_t size;
+	unsigned int heap_id;
+	u32 iters;
+	u32 fails;
+	u32 nr[BENCH_OPS];
+	u32 *us[BENCH_OPS];
+};
+
+struct ion_bench {
+	struct mutex lock;	/* protects results */
+	struct dentry *root;
+	u32 heap_mask;		/* ion heap ids, 0 for every heap */
+	u32 threads;
+	u32 iterations;
+	u32 pressure_mb;
+
+	/* state of the current run */
+	struct completion start;
+	atomic_t running;
+	wait_queue_head_t done;
+
+	struct bench_result *results;
+	u32 nr_results;
+};
+
+static struct ion_bench bench = {
+	.lock = __MUTEX_INITIALIZER(bench.lock),
+	.done = __WAIT_QUEUE_HEAD_INITIALIZER(bench.done),
+	.threads = 4,
+	.iterations = 64,
+};
+
+static u32 us_since(ktime_t start)
+{
+	return (u32)ktime_us_delta(ktime_get(), start);
+}
+
+static void bench_sample(struct bench_thread *bt, enum bench_op op,
+			 ktime_t start)
+{
+	bt->us[op][bt->nr[op]++] = us_since(start);
+}
+
+static void bench_iteration(struct bench_thread *bt)
+{
+	struct iommu_map_format format;
+	struct ion_handle *handle;
+	struct dma_buf *dmabuf;
+	ktime_t start;
+	void *vaddr;
+
+	start = ktime_get();
+	handle = ion_alloc(bt->client, bt->size, PAGE_SIZE,
+			   ION_HEAP(bt->heap_id), 0);
+	if (IS_ERR_OR_NULL(handle)) {
+		bt->fails++;
+		return;
+	}
+	bench_sample(bt, BENCH_ALLOC, start);
+
+	start = ktime_get();
+	vaddr = ion_map_kernel(bt->client, handle);
+	if (!IS_ERR_OR_NULL(vaddr)) {
+		ion_unmap_kernel(bt->client, handle);
+		bench_sample(bt, BENCH_KMAP, start);
+	}
+
+	start = ktime_get();
+	dmabuf = ion_share_dma_buf(bt->client, handle);
+	if (!IS_ERR_OR_NULL(dmabuf)) {
+		dma_buf_put(dmabuf);
+		bench_sample(bt, BENCH_DMABUF, start);
+	}
+
+	memset(&format, 0, sizeof(format));
+	start = ktime_get();
+	if (!ion_map_iommu(bt->client, handle, &format)) {
+		bench_sample(bt, BENCH_IOMMU_MAP, start);
+		start = ktime_get();
+		ion_unmap_iommu(bt->client, handle);
+		bench_sample(bt, BENCH_IOMMU_UNMAP, start);
+	}
+
+	start = ktime_get();
+	ion_free(bt->client, handle);
+	bench_sample(bt, BENCH_FREE, start);
+}
+
+static int bench_thread_fn(void *data)
+{
+	struct bench_thread *bt = data;
+	u32 i;
+
+	wait_for_completion(&bench.start);
+	/* us[] is sized for the iterations read when the run started */
+	for (i = 0; i < bt->iters; i++)
+		bench_iteration(bt);
+
+	if (atomic_dec_and_test(&bench.running))
+		wake_up(&bench.done);
+	/* kthread_stop() collects the exit */
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!kthread_should_stop())
+			schedule();
+		__set_current_state(TASK_RUNNING);
+	}
+
+	return 0;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void bench_fold(struct bench_result *res, struct bench_thread *bts,
+		       u32 nr_threads, u32 *scratch)
+{
+	int op;
+	u32 i;
+
+	for (i = 0; i < nr_threads; i++)
+		res->fails += bts[i].fails;
+
+	for (op = 0; op < BENCH_OPS; op++) {
+		struct bench_op_stat *st = &res->ops[op];
+		u64 sum = 0;
+		u32 n = 0;
+
+		for (i = 0; i < nr_threads; i++) {
+			memcpy(scratch + n, bts[i].us[op],
+			       bts[i].nr[op] * sizeof(u32));
+			n += bts[i].nr[op];
+		}
+		if (!n)
+			continue;
+		sort(scratch, n, sizeof(u32), cmp_u32, NULL);
+		for (i = 0; i < n; i++)
+			sum += scratch[i];
+		st->count = n;
+		st->avg_us = (u32)div_u64(sum, n);
+		st->p50_us = scratch[n / 2];
+		st->p99_us = scratch[(n * 99) / 100];
+		st->max_us = scratch[n - 1];
+	}
+}
+
+static int bench_one(struct ion_heap *heap, size_t size, u32 nr_threads,
+		     struct bench_thread *bts, u32 *scratch)
+{
+	struct bench_result *res = &bench.results[bench.nr_results];
+	u32 i, started = 0;
+	int op, ret = 0;
+
+	reinit_completion(&bench.start);
+	atomic_set(&bench.running, nr_threads);
+	for (i = 0; i < nr_threads; i++) {
+		struct bench_thread *bt = &bts[i];
+
+		bt->size = size;
+		bt->heap_id = heap->id;
+		bt->fails = 0;
+		for (op = 0; op < BENCH_OPS; op++)
+			bt->nr[op] = 0;
+		bt->task = kthread_run(bench_thread_fn, bt, "ion_bench/%u", i);
+		if (IS_ERR(bt->task)) {
+			ret = PTR_ERR(bt->task);
+			atomic_sub(nr_threads - started, &bench.running);
+			break;
+		}
+		started++;
+	}
+
+	complete_all(&bench.start);
+	wait_event(bench.done, !atomic_read(&bench.running));
+	for (i = 0; i < started; i++)
+		kthread_stop(bts[i].task);
+	if (ret)
+		return ret;
+
+	memset(res, 0, sizeof(*res));
+	res->heap = heap->name;
+	res->heap_id = heap->id;
+	res->size = size;
+	res->threads = nr_threads;
+	bench_fold(res, bts, nr_threads, scratch);
+	bench.nr_results++;
+	return 0;
+}
+
+static void bench_release_pressure(struct list_head *pages)
+{
+	struct page *page, *tmp;
+
+	list_for_each_entry_safe(page, tmp, pages, lru) {
+		list_del(&page->lru);
+		__free_page(page);
+	}
+}
+
+/* hold movable pages so that the heaps allocate under reclaim */
+static void bench_apply_pressure(struct list_head *pages, u32 mb)
+{
+	unsigned long nr = (unsigned long)mb << (20 - PAGE_SHIFT);
+	struct page *page;
+
+	while (nr--) {
+		page = alloc_page(GFP_HIGHUSER_MOVABLE | __GFP_NORETRY |
+				  __GFP_NOWARN);
+		if (!page)
+			break;
+		list_add(&page->lru, pages);
+	}
+}
+
+static u32 bench_thread_counts(u32 max)
+{
+	u32 n = 0, t;
+
+	for (t = 1; t <= max; t <<= 1)
+		n++;
+	return n;
+}
+
+static int bench_run(void)
+{
+	struct bench_thread bts[ION_BENCH_MAX_THREADS];
+	u32 max_threads = bench.threads;
+	u32 iters = bench.iterations;
+	u32 nr_counts, i, t;
+	LIST_HEAD(pressure);
+	u32 *scratch = NULL;
+	int h, s, op, ret = 0;
+
+	if (!max_threads || max_threads > ION_BENCH_MAX_THREADS ||
+	    !iters || iters > ION_BENCH_MAX_ITERS)
+		return -EINVAL;
+
+	nr_counts = bench_thread_counts(max_threads);
+	kfree(bench.results);
+	bench.nr_results = 0;
+	bench.results = kcalloc(ION_BENCH_MAX_HEAPS * ARRAY_SIZE(bench_sizes) *
+				nr_counts, sizeof(*bench.results), GFP_KERNEL);
+	if (!bench.results)
+		return -ENOMEM;
+
+	memset(bts, 0, sizeof(bts));
+	for (i = 0; i < max_threads; i++) {
+		bts[i].iters = iters;
+		bts[i].client = hisi_ion_client_create("ion_bench");
+		if (IS_ERR_OR_NULL(bts[i].client)) {
+			bts[i].client = NULL;
+			ret = -ENOMEM;
+			goto out;
+		}
+		for (op = 0; op < BENCH_OPS; op++) {
+			bts[i].us[op] = kcalloc(iters, sizeof(u32), GFP_KERNEL);
+			if (!bts[i].us[op]) {
+				ret = -ENOMEM;
+				goto out;
+			}
+		}
+	}
+	scratch = kcalloc(max_threads * iters, sizeof(u32), GFP_KERNEL);
+	if (!scratch) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	bench_apply_pressure(&pressure, bench.pressure_mb);
+
+	for (h = 0; h < ION_BENCH_MAX_HEAPS; h++) {
+		struct ion_heap *heap = hisi_ion_get_heap(h);
+
+		if (!heap)
+			continue;
+		if (bench.heap_mask && !(bench.heap_mask & ION_HEAP(heap->id)))
+			continue;
+		for (s = 0; s < ARRAY_SIZE(bench_sizes); s++) {
+			for (t = 1; t <= max_threads; t <<= 1) {
+				ret = bench_one(heap, bench_sizes[s], t, bts,
+						scratch);
+				if (ret)
+					goto out_pressure;
+			}
+		}
+	}
+
+out_pressure:
+	bench_release_pressure(&pressure);
+out:
+	kfree(scratch);
+	for (i = 0; i < max_threads; i++) {
+		for (op = 0; op < BENCH_OPS; op++)
+			kfree(bts[i].us[op]);
+		if (bts[i].client)
+			ion_client_destroy(bts[i].client);
+	}
+	return ret;
+}
+
+static int bench_result_show(struct seq_file *s, void *data)
+{
+	u32 i;
+	int op;
+
+	mutex_lock(&bench.lock);
+	for (i = 0; i < bench.nr_results; i++) {
+		struct bench_result *res = &bench.results[i];
+
+		seq_printf(s, "heap=%s heap_id=%u size=%zu threads=%u fails=%u",
+			   res->heap, res->heap_id, res->size, res->threads,
+			   res->fails);
+		for (op = 0; op < BENCH_OPS; op++) {
+			struct bench_op_stat *st = &res->ops[op];
+			const char *name = bench_op_names[op];
+
+			seq_printf(s, " %s_n=%u %s_avg_us=%u %s_p50_us=%u",
+				   name, st->count, name, st->avg_us,
+				   name, st->p50_us);
+			seq_printf(s, " %s_p99_us=%u %s_max_us=%u",
+				   name, st->p99_us, name, st->max_us);
+		}
+		seq_puts(s, "\n");
+	}
+	mutex_unlock(&bench.lock);
+	return 0;
+}
+
+static int bench_result_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bench_result_show, NULL);
+}
+
+static const struct file_operations bench_result_fops = {
+	.open = bench_result_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int bench_run_set(void *data, u64 val)
+{
+	int ret;
+
+	if (!val)
+		return 0;
+
+	mutex_lock(&bench.lock);
+	ret = bench_run();
+	mutex_unlock(&bench.lock);
+
+	return ret;
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(bench_run_fops, NULL, bench_run_set, "%llu\n");
+
+static int __init hisi_ion_bench_init(void)
+{
+	struct dentry *root;
+
+	init_completion(&bench.start);
+	root = debugfs_create_dir("ion_bench", NULL);
+	if (IS_ERR_OR_NULL(root))
+		return -ENOMEM;
+	bench.root = root;
+
+	if (!debugfs_create_file("run", S_IWUSR, root, NULL,
+				 &bench_run_fops) ||
+	    !debugfs_create_file("result", S_IRUSR, root, NULL,
+				 &bench_result_fops) ||
+	    !debugfs_create_x32("heap_mask", S_IRUSR | S_IWUSR, root,
+				&bench.heap_mask) ||
+	    !debugfs_create_u32("threads", S_IRUSR | S_IWUSR, root,
+				&bench.threads) ||
+	    !debugfs_create_u32("iterations", S_IRUSR | S_IWUSR, root,
+				&bench.iterations) ||
+	    !debugfs_create_u32("pressure_mb", S_IRUSR | S_IWUSR, root,
+				&bench.pressure_mb)) {
+		debugfs_remove_recursive(root);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static void __exit hisi_ion_bench_exit(void)
+{
+	debugfs_remove_recursive(bench.root);
+	kfree(bench.results);
+}
+
+module_init(hisi_ion_bench_init);
+module_exit(hisi_ion_bench_exit);
+
+MODULE_LICENSE("GPL v2");
+MODULE_DESCRIPTION("ion heap allocation benchmark");
@@ -24,6 +24,54 @@ unsigned long hisi_ion_total(void)
 	return (unsigned long)atomic_long_read(&ion_total_size);
 }
 
+/*
+ * Fill @sizes with the ion memory held by each client pid, up to @max
+ * pids, and return their number. It runs from the lmk in reclaim, so
+ * busy clients are skipped rather than waited for.
+ */
+int hisi_ion_task_sizes(struct ion_task_size *sizes, int max)
+{
+	struct ion_device *dev = get_ion_device();
+	struct rb_node *n, *h;
+	int nr = 0, i;
+
+	if (!dev || !down_read_trylock(&dev->client_lock))
+		return 0;
+
+	for (n = rb_first(&dev->clients); n; n = rb_next(n)) {
+		struct ion_client *client = rb_entry(n,
+				struct ion_client, node);
+		size_t size = 0;
+
+		if (!mutex_trylock(&client->lock))
+			continue;
+		for (h = rb_first(&client->handles); h; h = rb_next(h)) {
+			struct ion_handle *handle = rb_entry(h,
+					struct ion_handle, node);
+			if (!(handle->import) && (handle->buffer->heap->type !=
+						ION_HEAP_TYPE_CARVEOUT))
+				size += handle->buffer->size;
+		}
+		mutex_unlock(&client->lock);
+		if (!size)
+			continue;
+
+		for (i = 0; i < nr; i++)
+			if (sizes[i].pid == client->pid)
+				break;
+		if (i == nr) {
+			if (nr == max)
+				continue;
+			sizes[nr].pid = client->pid;
+			sizes[nr++].size = 0;
+		}
+		sizes[i].size += size;
+	}
+	up_read(&dev->client_lock);
+
+	return nr;
+}
+
 int hisi_ion_memory_info(bool verbose)
 {
 	struct rb_node *n;
@@ -29,6 +29,10 @@
 #include <linux/sizes.h>
 #include <linux/module.h>
 #include <linux/kthread.h>
+#include <linux/math64.h>
+#include <linux/spinlock.h>
+#include <linux/vmstat.h>
+#include <linux/hisi/hisi_ion.h>
 
 #include "ion.h"
 #include "hisi_ion_smart_pool.h"
@@ -53,6 +57,36 @@ static const int smart_pool_num_orders = ARRAY_SIZE(smart_pool_orders);
 
 #define SMART_POOL_MIN(x, y) (((x) < (y)) ? (x) : (y))
 
+/*
+ * Demand learning: the graphic pages allocated within SP_LEARN_WINDOW
+ * of a hint (or of the first allocation without one, learned as the
+ * default trigger) are the demand of that trigger's burst, folded per
+ * order into a running average. The kthread prefills the orders to the
+ * demand of the open burst, or of the default trigger between bursts,
+ * unless memory is short or the shrinker asked for pages back lately.
+ */
+#define SP_TRIGGER_DEFAULT	0
+#define SP_LEARN_WINDOW		(2 * HZ)
+#define SP_BACKOFF_TIME		(5 * HZ)
+#define SP_BACKOFF_WMARK_RATIO	4	/* x min_free_kbytes */
+
+struct sp_trigger {
+	unsigned int demand[ARRAY_SIZE(smart_pool_orders)];	/* 4K pages */
+	unsigned int cur[ARRAY_SIZE(smart_pool_orders)];
+};
+
+static DEFINE_SPINLOCK(sp_learn_lock);
+static struct sp_trigger sp_triggers[ION_SMART_POOL_NR_TRIGGERS];
+static int sp_cur_trigger = -1;
+static unsigned long sp_window_end;
+static unsigned long sp_last_shrink;
+static unsigned int sp_backoff_free_kb;
+
+static atomic_t sp_stat_hit = ATOMIC_INIT(0);		/* 4K pages */
+static atomic_t sp_stat_miss = ATOMIC_INIT(0);
+static atomic_t sp_stat_prefill = ATOMIC_INIT(0);
+static atomic_t sp_stat_backoff = ATOMIC_INIT(0);
+
 bool ion_smart_is_graphic_buffer(struct ion_buffer *buffer)
 {
 	if (NULL == buffer) {
@@ -80,6 +114,94 @@ static int sp_order_to_index(unsigned int order)
 	return -1;
 }
 
+/* should be called with sp_learn_lock held */
+static void sp_close_window(void)
+{
+	struct sp_trigger *t;
+	int i;
+
+	if (sp_cur_trigger < 0)
+		return;
+
+	t = &sp_triggers[sp_cur_trigger];
+	for (i = 0; i < smart_pool_num_orders; i++) {
+		t->demand[i] = t->demand[i] ?
+			(t->demand[i] * 3 + t->cur[i]) / 4 : t->cur[i];
+		t->cur[i] = 0;
+	}
+	sp_cur_trigger = -1;
+}
+
+/* should be called with sp_learn_lock held */
+static void sp_open_window(int trigger)
+{
+	sp_close_window();
+	sp_cur_trigger = trigger;
+	sp_window_end = jiffies + SP_LEARN_WINDOW;
+}
+
+void ion_smart_pool_hint(int trigger)
+{
+	if (!smart_pool_enable)
+		return;
+	if (trigger < 0 || trigger >= ION_SMART_POOL_NR_TRIGGERS)
+		return;
+
+	spin_lock(&sp_learn_lock);
+	sp_open_window(trigger);
+	spin_unlock(&sp_learn_lock);
+
+	ion_smart_pool_wakeup_process();
+}
+
+/* a graphic buffer page, @hit if it came from the smart pool */
+void ion_smart_pool_account(struct page *page, bool hit)
+{
+	unsigned int order = compound_order(page);
+	int i;
+
+	for (i = 0; i < smart_pool_num_orders; i++)
+		if (order == smart_pool_orders[i])
+			break;
+	if (i == smart_pool_num_orders)
+		return;
+
+	atomic_add(1 << order, hit ? &sp_stat_hit : &sp_stat_miss);
+
+	spin_lock(&sp_learn_lock);
+	if (sp_cur_trigger >= 0 && time_after(jiffies, sp_window_end))
+		sp_close_window();
+	if (sp_cur_trigger < 0)
+		sp_open_window(SP_TRIGGER_DEFAULT);
+	sp_triggers[sp_cur_trigger].cur[i] += 1 << order;
+	spin_unlock(&sp_learn_lock);
+}
+
+static void sp_get_prefill_target(unsigned int *target)
+{
+	struct sp_trigger *t;
+
+	spin_lock(&sp_learn_lock);
+	if (sp_cur_trigger >= 0 && time_after(jiffies, sp_window_end))
+		sp_close_window();
+	t = &sp_triggers[sp_cur_trigger >= 0 ?
+			sp_cur_trigger : SP_TRIGGER_DEFAULT];
+	memcpy(target, t->demand, sizeof(t->demand));
+	spin_unlock(&sp_learn_lock);
+}
+
+static bool sp_under_pressure(void)
+{
+	unsigned long free_kb;
+
+	if (time_before(jiffies, ACCESS_ONCE(sp_last_shrink) + SP_BACKOFF_TIME))
+		return true;
+
+	free_kb = global_page_state(NR_FREE_PAGES) << (PAGE_SHIFT - 10);
+	return free_kb < (sp_backoff_free_kb ? sp_backoff_free_kb :
+			(unsigned long)min_free_kbytes * SP_BACKOFF_WMARK_RATIO);
+}
+
 static inline unsigned long sp_order_to_size(int order)
 {
 	return PAGE_SIZE << order;
@@ -94,7 +216,8 @@ static int sp_ion_page_pool_total(struct ion_page_pool *pool)
 		return 0;
 	}
 
-	count = pool->low_count + pool->high_count;
+	count = pool->low_count + pool->high_count + pool->zeroed_count +
+		ion_page_pool_pcp_count(pool);
 
 	return count << pool->order;
 }
@@ -145,6 +268,27 @@ static int sp_fill_pool_once(struct ion_page_pool *pool)
 	return 0;
 }
 
+static void sp_prefill(struct ion_smart_pool *pool)
+{
+	unsigned int target[ARRAY_SIZE(smart_pool_orders)];
+	int i;
+
+	sp_get_prefill_target(target);
+
+	for (i = 0; i < smart_pool_num_orders; i++) {
+		while (sp_ion_page_pool_total(pool->pools[i]) < target[i] &&
+		       sp_pool_total_pages(pool) < MAX_POOL_SIZE) {
+			if (sp_under_pressure()) {
+				atomic_inc(&sp_stat_backoff);
+				return;
+			}
+			if (sp_fill_pool_once(pool->pools[i]) < 0)
+				break;
+			atomic_add(1 << smart_pool_orders[i], &sp_stat_prefill);
+		}
+	}
+}
+
 static int ion_smart_pool_kworkthread(void *p)
 {
 	int i;
@@ -179,6 +323,8 @@ static int ion_smart_pool_kworkthread(void *p)
 					break;
 			}
 		}
+
+		sp_prefill(pool);
 	}
 
 	return 0;
@@ -283,10 +429,20 @@ int ion_smart_pool_shrink(struct ion_smart_pool *smart_pool,
 	if (nr_to_free <= 0)
 		return 0;
 
+	/* hold off prefilling what reclaim is taking back */
+	sp_last_shrink = jiffies;
 	nr_total = ion_page_pool_shrink(pool, gfp_mask, nr_to_free);
 	return nr_total;
 }
 
+static int sp_hit_ratio(void)
+{
+	int hit = atomic_read(&sp_stat_hit);
+	int total = hit + atomic_read(&sp_stat_miss);
+
+	return total ? (int)div_u64((u64)hit * 100, total) : 0;
+}
+
 void ion_smart_pool_debug_show_total(struct seq_file *s,
 				     struct ion_smart_pool *smart_pool)
 {
@@ -297,6 +453,12 @@ void ion_smart_pool_debug_show_total(struct seq_file *s,
 	seq_puts(s, "----------------------------------------------------\n");
 	seq_printf(s, "in smart pool =  %d total\n",
 		   sp_pool_total_pages(smart_pool) * 4 / 1024);
+	seq_printf(s, "smart pool hit %d pages, miss %d pages (%d%% hit)\n",
+		   atomic_read(&sp_stat_hit), atomic_read(&sp_stat_miss),
+		   sp_hit_ratio());
+	seq_printf(s, "smart pool prefilled %d pages, %d backoffs\n",
+		   atomic_read(&sp_stat_prefill),
+		   atomic_read(&sp_stat_backoff));
 }
 
 struct ion_smart_pool *ion_smart_pool_create(void)
@@ -317,6 +479,7 @@ struct ion_smart_pool *ion_smart_pool_create(void)
 		goto free_heap;
 
 	init_waitqueue_head(&smart_pool_wait);
+	sp_last_shrink = jiffies - SP_BACKOFF_TIME;
 	smart_pool_thread = kthread_run(ion_smart_pool_kworkthread, smart_pool,
 					"%s", "smartpool");
 	if (IS_ERR(smart_pool_thread)) {
@@ -343,4 +506,9 @@ MODULE_PARM_DESC(debug_smart_pool_enable, "enable smart pool");
 module_param_named(debug_smart_pool_alloc_size, smart_pool_alloc_size, int,
 		0644);
 MODULE_PARM_DESC(debug_smart_pool_alloc_size, "alloc size from smartpool");
+
+module_param_named(debug_smart_pool_backoff_free_kb, sp_backoff_free_kb, uint,
+		0644);
+MODULE_PARM_DESC(debug_smart_pool_backoff_free_kb,
+		"no prefill below this free memory, 0 for 4x min_free_kbytes");
 /*lint -restore*/
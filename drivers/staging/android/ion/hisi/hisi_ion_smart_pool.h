@@ -39,4 +39,6 @@ int ion_smart_pool_shrink(struct ion_smart_pool *smart_pool,
 struct ion_smart_pool *ion_smart_pool_create(void);
 void ion_smart_pool_wakeup_process(void);
 void ion_smart_set_water_mark(int water_mark);
+void ion_smart_pool_hint(int trigger);
+void ion_smart_pool_account(struct page *page, bool hit);
 #endif /* _ION_SMART_POOL_H */
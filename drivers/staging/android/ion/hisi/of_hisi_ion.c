@@ -222,6 +222,18 @@ void ion_flush_all_cpus_caches(void)
 	preempt_enable();
 }
 
+/*
+ * Return the heap created from the @index-th dts node, NULL when @index is
+ * past the last one or the heap failed to be created.
+ */
+struct ion_heap *hisi_ion_get_heap(int index)
+{
+	if (!heaps || index < 0 || index >= num_heaps)
+		return NULL;
+	return heaps[index];
+}
+EXPORT_SYMBOL(hisi_ion_get_heap);
+
 struct ion_client *hisi_ion_client_create(const char *name)
 {
 	return ion_client_create(idev, name);
@@ -307,6 +319,18 @@ static long hisi_ion_custom_ioctl(struct ion_client *client,
 			ion_smart_set_water_mark(smart_pool_info.water_mark);
 		break;
 	}
+	case ION_HISI_CUSTOM_SMART_POOL_HINT:
+	{
+		struct ion_smart_pool_hint_data hint;
+
+		if (copy_from_user(&hint, (void __user *)arg, sizeof(hint)))
+			return -EFAULT;
+		if (hint.trigger < 0 ||
+		    hint.trigger >= ION_SMART_POOL_NR_TRIGGERS)
+			return -EINVAL;
+		ion_smart_pool_hint(hint.trigger);
+		break;
+	}
 #endif
 
 	case ION_HISI_CLEAN_CACHES:
@@ -1286,6 +1286,22 @@ static void ion_buffer_sync_for_device(struct ion_buffer *buffer,
 				       struct device *dev,
 				       enum dma_data_direction direction);
 
+static int ion_dma_buf_attach(struct dma_buf *dmabuf, struct device *dev,
+			      struct dma_buf_attachment *attachment)
+{
+	struct ion_buffer *buffer = dmabuf->priv;
+
+	/*
+	 * The table the heap built in map_dma() is the same for every map,
+	 * only buffers whose user mappings are faulted in have to be synced
+	 * each time they are handed to the device.
+	 */
+	if (ion_buffer_fault_user_mappings(buffer))
+		attachment->cache_sgt = false;
+
+	return 0;
+}
+
 static struct sg_table *ion_map_dma_buf(struct dma_buf_attachment *attachment,
 					enum dma_data_direction direction)
 {
@@ -1508,6 +1524,7 @@ static void ion_dma_buf_end_cpu_access(struct dma_buf *dmabuf, size_t start,
 }
 
 static struct dma_buf_ops dma_buf_ops = {
+	.attach = ion_dma_buf_attach,
 	.map_dma_buf = ion_map_dma_buf,
 	.unmap_dma_buf = ion_unmap_dma_buf,
 	.mmap = ion_mmap,
@@ -1518,6 +1535,7 @@ static struct dma_buf_ops dma_buf_ops = {
 	.kunmap_atomic = ion_dma_buf_kunmap,
 	.kmap = ion_dma_buf_kmap,
 	.kunmap = ion_dma_buf_kunmap,
+	.cache_sgt_mapping = true,
 };
 
 struct dma_buf *ion_share_dma_buf(struct ion_client *client,
@@ -229,6 +229,27 @@ int ion_sync_for_cpu(struct ion_client *client, int fd);
 int ion_sync_for_device(struct ion_client *client, int fd);
 size_t ion_get_used_memory(struct ion_heap *heap);
 
+#ifdef CONFIG_ION_SHARED_PAGE_POOL
+/*
+ * Order-0 page exchange with the uncached pool of the system heap, for
+ * drivers which would otherwise keep a page pool of their own. Pages
+ * put there are reclaimed by the ion shrinker. A page got from the pool
+ * has page_private() cleared and may have to be zeroed, see @zeroed.
+ */
+struct page *ion_shared_page_get(bool *zeroed);
+bool ion_shared_page_put(struct page *page, bool zeroed);
+#else
+static inline struct page *ion_shared_page_get(bool *zeroed)
+{
+	return NULL;
+}
+
+static inline bool ion_shared_page_put(struct page *page, bool zeroed)
+{
+	return false;
+}
+#endif
+
 
 struct sg_table *ion_sg_table_nolock(struct ion_client *client,
 			      struct ion_handle *handle);
@@ -143,7 +143,7 @@ static int ion_heap_clear_pages(struct page **pages, int num, pgprot_t pgprot)
 }
 
 static int ion_heap_sglist_zero(struct scatterlist *sgl, unsigned int nents,
-						pgprot_t pgprot)
+					pgprot_t pgprot, bool skip_zeroed)
 {
 	int p = 0;
 	int ret = 0;
@@ -151,6 +151,8 @@ static int ion_heap_sglist_zero(struct scatterlist *sgl, unsigned int nents,
 	struct page *pages[32];
 
 	for_each_sg_page(sgl, &piter, nents, 0) {
+		if (skip_zeroed && ion_page_zeroed(sg_page(piter.sg)))
+			continue;
 		pages[p++] = sg_page_iter_page(&piter);
 		if (p == ARRAY_SIZE(pages)) {
 			ret = ion_heap_clear_pages(pages, p, pgprot);
@@ -175,7 +177,31 @@ int ion_heap_buffer_zero(struct ion_buffer *buffer)
 	else
 		pgprot = pgprot_writecombine(PAGE_KERNEL);
 
-	return ion_heap_sglist_zero(table->sgl, table->nents, pgprot);
+	return ion_heap_sglist_zero(table->sgl, table->nents, pgprot, false);
+}
+
+/*
+ * Like ion_heap_buffer_zero() but skips the pages a pool already zeroed,
+ * only for heaps whose pages come from an ion_page_pool.
+ */
+int ion_heap_buffer_zero_dirty(struct ion_buffer *buffer)
+{
+	struct sg_table *table = buffer->sg_table;
+	struct scatterlist *sg;
+	pgprot_t pgprot;
+	int i, ret;
+
+	if (buffer->flags & ION_FLAG_CACHED)
+		pgprot = PAGE_KERNEL;
+	else
+		pgprot = pgprot_writecombine(PAGE_KERNEL);
+
+	ret = ion_heap_sglist_zero(table->sgl, table->nents, pgprot, true);
+
+	for_each_sg(table->sgl, sg, table->nents, i)
+		ion_page_clear_zeroed(sg_page(sg));
+
+	return ret;
 }
 
 int ion_heap_pages_zero(struct page *page, size_t size, pgprot_t pgprot)
@@ -184,7 +210,7 @@ int ion_heap_pages_zero(struct page *page, size_t size, pgprot_t pgprot)
 
 	sg_init_table(&sg, 1);
 	sg_set_page(&sg, page, size, 0);
-	return ion_heap_sglist_zero(&sg, 1, pgprot);
+	return ion_heap_sglist_zero(&sg, 1, pgprot, false);
 }
 
 void ion_heap_freelist_add(struct ion_heap *heap, struct ion_buffer *buffer)
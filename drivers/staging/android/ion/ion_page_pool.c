@@ -21,6 +21,7 @@
 #include <linux/list.h>
 #include <linux/module.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <linux/swap.h>
 #include <linux/vmstat.h>
 
@@ -50,15 +51,14 @@ void *ion_page_pool_alloc_pages(struct ion_page_pool *pool)
 static void ion_page_pool_free_pages(struct ion_page_pool *pool,
 				     struct page *page)
 {
+	ion_page_clear_zeroed(page);
 	ion_page_pool_free_set_cache_policy(pool, page);
 	__free_pages(page, pool->order);
 }
 
-static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
+/* list only, NR_IONCACHE_PAGES is left to the caller */
+static void __ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
 {
-	mutex_lock(&pool->mutex);
-	zone_page_state_add(1 << pool->order, page_zone(page),
-			    NR_IONCACHE_PAGES);
 	if (PageHighMem(page)) {
 		list_add_tail(&page->lru, &pool->high_items);
 		pool->high_count++;
@@ -66,11 +66,10 @@ static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
 		list_add_tail(&page->lru, &pool->low_items);
 		pool->low_count++;
 	}
-	mutex_unlock(&pool->mutex);
-	return 0;
 }
 
-static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
+static struct page *__ion_page_pool_remove(struct ion_page_pool *pool,
+					   bool high)
 {
 	struct page *page;
 
@@ -83,26 +82,264 @@ static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
 		page = list_first_entry(&pool->low_items, struct page, lru);
 		pool->low_count--;
 	}
+
+	list_del(&page->lru);
+	return page;
+}
+
+static struct page *__ion_page_pool_remove_zeroed(struct ion_page_pool *pool)
+{
+	struct page *page;
+
+	BUG_ON(!pool->zeroed_count);
+	page = list_first_entry(&pool->zeroed_items, struct page, lru);
+	pool->zeroed_count--;
+
+	list_del(&page->lru);
+	return page;
+}
+
+static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
+{
+	mutex_lock(&pool->mutex);
+	zone_page_state_add(1 << pool->order, page_zone(page),
+			    NR_IONCACHE_PAGES);
+	__ion_page_pool_add(pool, page);
+	mutex_unlock(&pool->mutex);
+	return 0;
+}
+
+static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
+{
+	struct page *page = __ion_page_pool_remove(pool, high);
+
 	zone_page_state_add(-(1 << pool->order), page_zone(page),
 			    NR_IONCACHE_PAGES);
+	return page;
+}
 
-	list_del(&page->lru);
+static struct page *ion_page_pool_remove_zeroed(struct ion_page_pool *pool)
+{
+	struct page *page = __ion_page_pool_remove_zeroed(pool);
+
+	zone_page_state_add(-(1 << pool->order), page_zone(page),
+			    NR_IONCACHE_PAGES);
 	return page;
 }
 
-struct page *ion_page_pool_alloc(struct ion_page_pool *pool)
+#ifdef CONFIG_ION_PAGE_POOL_PCP
+/*
+ * Per-cpu magazines: a small stack of lowmem pages per cpu in front of
+ * the pool lists. The magazine lock is only ever taken by a remote cpu
+ * when the shrinker drains it, so alloc and free stay local, and the
+ * pool mutex is taken once per half magazine moved. Pages in a
+ * magazine stay accounted in NR_IONCACHE_PAGES like pool pages.
+ */
+#define ION_POOL_PCP_PAGES	32	/* order-0 pages per magazine */
+#define ION_POOL_PCP_MIN	4	/* smaller magazines are not worth it */
+
+struct ion_page_pool_pcp {
+	spinlock_t lock;
+	int count;
+	struct page *pages[ION_POOL_PCP_PAGES];
+};
+
+static void ion_page_pool_add_batch(struct ion_page_pool *pool,
+				    struct page **pages, int nr)
+{
+	int i;
+
+	mutex_lock(&pool->mutex);
+	for (i = 0; i < nr; i++)
+		__ion_page_pool_add(pool, pages[i]);
+	mutex_unlock(&pool->mutex);
+}
+
+static struct page *ion_page_pool_pcp_alloc(struct ion_page_pool *pool)
 {
+	struct page *batch[ION_POOL_PCP_PAGES / 2];
+	struct ion_page_pool_pcp *pcp;
 	struct page *page = NULL;
+	int nr = 0;
 
-	BUG_ON(!pool);
+	if (!pool->pcp)
+		return NULL;
+
+	pcp = raw_cpu_ptr(pool->pcp);
+	spin_lock(&pcp->lock);
+	if (pcp->count)
+		page = pcp->pages[--pcp->count];
+	spin_unlock(&pcp->lock);
+	if (page)
+		goto out;
 
+	/* refill half a magazine under one pool lock */
 	mutex_lock(&pool->mutex);
-	if (pool->high_count)
+	while (nr < pool->pcp_max / 2 && pool->low_count)
+		batch[nr++] = __ion_page_pool_remove(pool, false);
+	mutex_unlock(&pool->mutex);
+	if (!nr)
+		return NULL;
+
+	page = batch[--nr];
+
+	/* we may run on another cpu by now, any magazine will do */
+	pcp = raw_cpu_ptr(pool->pcp);
+	spin_lock(&pcp->lock);
+	while (nr && pcp->count < pool->pcp_max)
+		pcp->pages[pcp->count++] = batch[--nr];
+	spin_unlock(&pcp->lock);
+
+	if (nr)
+		ion_page_pool_add_batch(pool, batch, nr);
+out:
+	mod_zone_page_state(page_zone(page), NR_IONCACHE_PAGES,
+			    -(1 << pool->order));
+	return page;
+}
+
+static bool ion_page_pool_pcp_free(struct ion_page_pool *pool,
+				   struct page *page)
+{
+	struct page *batch[ION_POOL_PCP_PAGES / 2];
+	struct ion_page_pool_pcp *pcp;
+	int nr = 0;
+
+	/* the shrinker may not be allowed to free highmem, keep it listed */
+	if (!pool->pcp || PageHighMem(page))
+		return false;
+
+	pcp = raw_cpu_ptr(pool->pcp);
+	spin_lock(&pcp->lock);
+	if (pcp->count == pool->pcp_max) {
+		/* push the coldest half back to the pool */
+		nr = pool->pcp_max / 2;
+		memcpy(batch, pcp->pages, nr * sizeof(*batch));
+		memmove(pcp->pages, pcp->pages + nr,
+			(pcp->count - nr) * sizeof(*batch));
+		pcp->count -= nr;
+	}
+	pcp->pages[pcp->count++] = page;
+	spin_unlock(&pcp->lock);
+
+	mod_zone_page_state(page_zone(page), NR_IONCACHE_PAGES,
+			    1 << pool->order);
+	if (nr)
+		ion_page_pool_add_batch(pool, batch, nr);
+	return true;
+}
+
+/* move every magazine back to the pool lists */
+static void ion_page_pool_pcp_drain(struct ion_page_pool *pool)
+{
+	struct page *batch[ION_POOL_PCP_PAGES];
+	struct ion_page_pool_pcp *pcp;
+	int cpu, nr;
+
+	if (!pool->pcp)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		pcp = per_cpu_ptr(pool->pcp, cpu);
+		if (!ACCESS_ONCE(pcp->count))
+			continue;
+
+		spin_lock(&pcp->lock);
+		nr = pcp->count;
+		memcpy(batch, pcp->pages, nr * sizeof(*batch));
+		pcp->count = 0;
+		spin_unlock(&pcp->lock);
+
+		if (nr)
+			ion_page_pool_add_batch(pool, batch, nr);
+	}
+}
+
+int ion_page_pool_pcp_count(struct ion_page_pool *pool)
+{
+	int cpu, count = 0;
+
+	if (!pool->pcp)
+		return 0;
+
+	for_each_possible_cpu(cpu)
+		count += ACCESS_ONCE(per_cpu_ptr(pool->pcp, cpu)->count);
+
+	return count;
+}
+
+static void ion_page_pool_pcp_init(struct ion_page_pool *pool)
+{
+	int cpu;
+
+	pool->pcp = NULL;
+	pool->pcp_max = ION_POOL_PCP_PAGES >> pool->order;
+	if (pool->pcp_max < ION_POOL_PCP_MIN)
+		return;
+
+	/* without magazines the pool still works, only slower */
+	pool->pcp = alloc_percpu(struct ion_page_pool_pcp);
+	if (!pool->pcp)
+		return;
+
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu_ptr(pool->pcp, cpu)->lock);
+}
+
+static void ion_page_pool_pcp_destroy(struct ion_page_pool *pool)
+{
+	if (!pool->pcp)
+		return;
+
+	ion_page_pool_pcp_drain(pool);
+	free_percpu(pool->pcp);
+	pool->pcp = NULL;
+}
+#else
+static inline struct page *ion_page_pool_pcp_alloc(struct ion_page_pool *pool)
+{
+	return NULL;
+}
+
+static inline bool ion_page_pool_pcp_free(struct ion_page_pool *pool,
+					  struct page *page)
+{
+	return false;
+}
+
+static inline void ion_page_pool_pcp_drain(struct ion_page_pool *pool) {}
+static inline void ion_page_pool_pcp_init(struct ion_page_pool *pool) {}
+static inline void ion_page_pool_pcp_destroy(struct ion_page_pool *pool) {}
+#endif
+
+/* a pooled page or NULL, never one fresh from the page allocator */
+struct page *ion_page_pool_alloc_pooled(struct ion_page_pool *pool)
+{
+	struct page *page = NULL;
+
+	page = ion_page_pool_pcp_alloc(pool);
+	if (page)
+		return page;
+
+	mutex_lock(&pool->mutex);
+	if (pool->zeroed_count)
+		page = ion_page_pool_remove_zeroed(pool);
+	else if (pool->high_count)
 		page = ion_page_pool_remove(pool, true);
 	else if (pool->low_count)
 		page = ion_page_pool_remove(pool, false);
 	mutex_unlock(&pool->mutex);
 
+	return page;
+}
+
+struct page *ion_page_pool_alloc(struct ion_page_pool *pool)
+{
+	struct page *page;
+
+	BUG_ON(!pool);
+
+	page = ion_page_pool_alloc_pooled(pool);
 	if (!page && !(pool->graphic_buffer_flag))
 		page = ion_page_pool_alloc_pages(pool);
 
@@ -115,19 +352,94 @@ void ion_page_pool_free(struct ion_page_pool *pool, struct page *page)
 
 	BUG_ON(pool->order != compound_order(page));
 
+	/* the buffer owner may have written it since it was zeroed */
+	ion_page_clear_zeroed(page);
+
+	if (ion_page_pool_pcp_free(pool, page))
+		return;
+
 	ret = ion_page_pool_add(pool, page);
 	if (ret)
 		ion_page_pool_free_pages(pool, page);
 }
 
+/*
+ * Give @pool a page its previous owner already zeroed, it goes straight
+ * to the zeroed list so that neither the zeroing thread nor the next
+ * buffer zeroes it again. Highmem pages are pooled as dirty ones.
+ */
+void ion_page_pool_free_zeroed(struct ion_page_pool *pool, struct page *page)
+{
+	BUG_ON(pool->order != compound_order(page));
+
+	if (PageHighMem(page)) {
+		ion_page_pool_free(pool, page);
+		return;
+	}
+
+	set_page_private(page, ION_PAGE_ZEROED);
+
+	mutex_lock(&pool->mutex);
+	zone_page_state_add(1 << pool->order, page_zone(page),
+			    NR_IONCACHE_PAGES);
+	list_add_tail(&page->lru, &pool->zeroed_items);
+	pool->zeroed_count++;
+	mutex_unlock(&pool->mutex);
+}
+
+int ion_page_pool_count(struct ion_page_pool *pool)
+{
+	return pool->low_count + pool->high_count + pool->zeroed_count +
+	       ion_page_pool_pcp_count(pool);
+}
+
 void ion_page_pool_free_immediate(struct ion_page_pool *pool, struct page *page)
 {
 	ion_page_pool_free_pages(pool, page);
 }
 
+/*
+ * Zero up to @nr lowmem items of @pool outside of the pool lock and
+ * move them to the zeroed list. Returns the number of items zeroed.
+ */
+int ion_page_pool_zero(struct ion_page_pool *pool, int nr)
+{
+	LIST_HEAD(pages);
+	struct page *page, *tmp;
+	int i, done = 0;
+
+	mutex_lock(&pool->mutex);
+	while (done < nr && pool->low_count) {
+		page = __ion_page_pool_remove(pool, false);
+		list_add_tail(&page->lru, &pages);
+		done++;
+	}
+	mutex_unlock(&pool->mutex);
+
+	if (!done)
+		return 0;
+
+	list_for_each_entry(page, &pages, lru) {
+		for (i = 0; i < (1 << pool->order); i++)
+			clear_page(page_address(page + i));
+		set_page_private(page, ION_PAGE_ZEROED);
+		cond_resched();
+	}
+
+	mutex_lock(&pool->mutex);
+	list_for_each_entry_safe(page, tmp, &pages, lru) {
+		list_move_tail(&page->lru, &pool->zeroed_items);
+		pool->zeroed_count++;
+	}
+	mutex_unlock(&pool->mutex);
+
+	return done;
+}
+
 static int ion_page_pool_total(struct ion_page_pool *pool, bool high)
 {
-	int count = pool->low_count;
+	int count = pool->low_count + pool->zeroed_count +
+		    ion_page_pool_pcp_count(pool);
 
 	if (high)
 		count += pool->high_count;
@@ -149,14 +461,19 @@ int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
 	if (nr_to_scan == 0)
 		return ion_page_pool_total(pool, high);
 
+	ion_page_pool_pcp_drain(pool);
+
 	while (freed < nr_to_scan) {
 		struct page *page;
 
+		/* zeroed items took work to make, free them last */
 		mutex_lock(&pool->mutex);
 		if (pool->low_count) {
 			page = ion_page_pool_remove(pool, false);
 		} else if (high && pool->high_count) {
 			page = ion_page_pool_remove(pool, true);
+		} else if (pool->zeroed_count) {
+			page = ion_page_pool_remove_zeroed(pool);
 		} else {
 			mutex_unlock(&pool->mutex);
 			break;
@@ -178,19 +495,23 @@ struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order,
 		return NULL;
 	pool->high_count = 0;
 	pool->low_count = 0;
+	pool->zeroed_count = 0;
 	INIT_LIST_HEAD(&pool->low_items);
+	INIT_LIST_HEAD(&pool->zeroed_items);
 	INIT_LIST_HEAD(&pool->high_items);
 	pool->gfp_mask = gfp_mask | __GFP_COMP;
 	pool->order = order;
 	pool->graphic_buffer_flag = graphic_buffer_flag;
 	mutex_init(&pool->mutex);
 	plist_node_init(&pool->list, order);
+	ion_page_pool_pcp_init(pool);
 
 	return pool;
 }
 
 void ion_page_pool_destroy(struct ion_page_pool *pool)
 {
+	ion_page_pool_pcp_destroy(pool);
 	kfree(pool);
 }
 
@@ -20,8 +20,10 @@
 #include <linux/device.h>
 #include <linux/dma-direction.h>
 #include <linux/kref.h>
+#include <linux/mm.h>
 #include <linux/mm_types.h>
 #include <linux/mutex.h>
+#include <linux/percpu.h>
 #include <linux/rbtree.h>
 #include <linux/sched.h>
 #include <linux/shrinker.h>
@@ -253,6 +255,7 @@ int ion_heap_map_iommu(struct ion_buffer *buffer,
 void ion_heap_unmap_iommu(struct ion_iommu_map *map_data);
 void ion_flush_all_cpus_caches(void);
 int ion_heap_buffer_zero(struct ion_buffer *buffer);
+int ion_heap_buffer_zero_dirty(struct ion_buffer *buffer);
 int ion_heap_pages_zero(struct page *page, size_t size, pgprot_t pgprot);
 
 /**
@@ -414,11 +417,16 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
  * @low_count:		number of lowmem items in the pool
  * @high_items:		list of highmem items
  * @low_items:		list of lowmem items
+ * @zeroed_count:	number of items zeroed in the background
+ * @zeroed_items:	list of lowmem items known to be zero
  * @mutex:		lock protecting this struct and especially the count
  *			item list
  * @gfp_mask:		gfp_mask to use from alloc
  * @order:		order of pages in the pool
  * @list:		plist node for list of pools
+ * @pcp:		per-cpu magazines of lowmem pages, NULL if the order
+ *			is too high to cache per cpu
+ * @pcp_max:		pages one magazine holds
  *
  * Allows you to keep a pool of pre allocated pages to use from your heap.
  * Keeping a pool of pages that is ready for dma, ie any cached mapping have
@@ -430,19 +438,55 @@ struct ion_page_pool {
 	int low_count;
 	struct list_head high_items;
 	struct list_head low_items;
+	int zeroed_count;
+	struct list_head zeroed_items;
 	struct mutex mutex;
 	gfp_t gfp_mask;
 	unsigned int order;
 	bool graphic_buffer_flag;
 	struct plist_node list;
+#ifdef CONFIG_ION_PAGE_POOL_PCP
+	struct ion_page_pool_pcp __percpu *pcp;
+	int pcp_max;
+#endif
 };
 
+#ifdef CONFIG_ION_PAGE_POOL_PCP
+int ion_page_pool_pcp_count(struct ion_page_pool *pool);
+#else
+static inline int ion_page_pool_pcp_count(struct ion_page_pool *pool)
+{
+	return 0;
+}
+#endif
+
 struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order,
 			bool graphic_buffer_flag);
 void ion_page_pool_destroy(struct ion_page_pool *);
 struct page *ion_page_pool_alloc(struct ion_page_pool *);
+struct page *ion_page_pool_alloc_pooled(struct ion_page_pool *pool);
 void ion_page_pool_free(struct ion_page_pool *, struct page *);
 void ion_page_pool_free_immediate(struct ion_page_pool *, struct page *);
+void ion_page_pool_free_zeroed(struct ion_page_pool *pool, struct page *page);
+int ion_page_pool_count(struct ion_page_pool *pool);
+int ion_page_pool_zero(struct ion_page_pool *pool, int nr);
+
+/*
+ * Pages zeroed while they sat in a pool carry this in page_private()
+ * of their head page until the buffer they were given to is zeroed or
+ * freed, so that zeroing can skip them.
+ */
+#define ION_PAGE_ZEROED		0x5a45524fUL	/* "ZERO" */
+
+static inline bool ion_page_zeroed(struct page *page)
+{
+	return page_private(page) == ION_PAGE_ZEROED;
+}
+
+static inline void ion_page_clear_zeroed(struct page *page)
+{
+	set_page_private(page, 0);
+}
 
 void *ion_page_pool_alloc_pages(struct ion_page_pool *pool);
 int ion_system_heap_create_pools(struct ion_page_pool **pools,
@@ -18,12 +18,15 @@
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
 #include <linux/highmem.h>
+#include <linux/kthread.h>
 #include <linux/mm.h>
+#include <linux/module.h>
 #include <linux/scatterlist.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include <linux/sizes.h>
+#include <linux/topology.h>
 #include <linux/hisi/ion-iommu.h>
 #include <linux/hisi/page_tracker.h>
 
@@ -70,8 +73,90 @@ struct ion_system_heap {
 
 	struct ion_page_pool *uncached_pools[NUM_ORDERS];
 	struct ion_page_pool *cached_pools[NUM_ORDERS];
+
+#ifdef CONFIG_ION_SYSTEM_HEAP_ZERO_ENGINE
+	struct task_struct *zero_task;
+	wait_queue_head_t zero_wait;
+	atomic_t zero_pending;
+#endif
 };
 
+#ifdef CONFIG_ION_SYSTEM_HEAP_ZERO_ENGINE
+/* bytes zeroed per pool in one round, so no pool waits on the others */
+#define ION_ZERO_BATCH		SZ_1M
+
+static int ion_system_heap_zero_pools(struct ion_system_heap *heap)
+{
+	int i, nr, done = 0;
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		/* order-0 pages are never pooled, see free_buffer_page() */
+		if (!orders[i])
+			continue;
+
+		nr = max_t(int, (ION_ZERO_BATCH >> PAGE_SHIFT) >> orders[i], 1);
+		done += ion_page_pool_zero(heap->uncached_pools[i], nr);
+		done += ion_page_pool_zero(heap->cached_pools[i], nr);
+	}
+
+	return done;
+}
+
+static int ion_system_heap_zero_thread(void *data)
+{
+	struct ion_system_heap *heap = data;
+
+	set_user_nice(current, MAX_NICE);
+	/* zeroing is bound by memory bandwidth, keep it on the little cores */
+	set_cpus_allowed_ptr(current, topology_core_cpumask(0));
+
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(heap->zero_wait,
+				atomic_read(&heap->zero_pending) ||
+				kthread_should_stop());
+		atomic_set(&heap->zero_pending, 0);
+
+		while (!kthread_should_stop() &&
+		       ion_system_heap_zero_pools(heap))
+			;
+	}
+
+	return 0;
+}
+
+static void ion_system_heap_zero_kick(struct ion_system_heap *heap)
+{
+	if (!heap->zero_task)
+		return;
+
+	atomic_set(&heap->zero_pending, 1);
+	wake_up_interruptible(&heap->zero_wait);
+}
+
+static void ion_system_heap_zero_start(struct ion_system_heap *heap)
+{
+	init_waitqueue_head(&heap->zero_wait);
+	atomic_set(&heap->zero_pending, 0);
+
+	heap->zero_task = kthread_run(ion_system_heap_zero_thread, heap,
+				      "ion_zero");
+	if (IS_ERR(heap->zero_task)) {
+		pr_err("%s: creating zeroing thread failed\n", __func__);
+		heap->zero_task = NULL;
+	}
+}
+
+static void ion_system_heap_zero_stop(struct ion_system_heap *heap)
+{
+	if (heap->zero_task)
+		kthread_stop(heap->zero_task);
+}
+#else
+static inline void ion_system_heap_zero_kick(struct ion_system_heap *heap) {}
+static inline void ion_system_heap_zero_start(struct ion_system_heap *heap) {}
+static inline void ion_system_heap_zero_stop(struct ion_system_heap *heap) {}
+#endif
+
 static struct page *alloc_buffer_page(struct ion_system_heap *heap,
 				      struct ion_buffer *buffer,
 				      unsigned long order)
@@ -105,6 +190,73 @@ static struct page *alloc_buffer_page(struct ion_system_heap *heap,
 	return page;
 }
 
+#ifdef CONFIG_ION_SHARED_PAGE_POOL
+static struct ion_system_heap *ion_shared_heap;
+
+/* pages other drivers may park in the shared pool */
+static unsigned int ion_shared_pages_max = SZ_64M >> PAGE_SHIFT;
+module_param_named(shared_pages_max, ion_shared_pages_max, uint, 0644);
+
+static struct ion_page_pool *ion_shared_pool(void)
+{
+	struct ion_system_heap *heap = ACCESS_ONCE(ion_shared_heap);
+
+	if (!heap)
+		return NULL;
+
+	return heap->uncached_pools[order_to_index(0)];
+}
+
+struct page *ion_shared_page_get(bool *zeroed)
+{
+	struct ion_page_pool *pool = ion_shared_pool();
+	struct page *page;
+
+	if (!pool || !ion_page_pool_count(pool))
+		return NULL;
+
+	/* only what is pooled, the caller allocates with its own gfp */
+	page = ion_page_pool_alloc_pooled(pool);
+	if (!page)
+		return NULL;
+
+	*zeroed = ion_page_zeroed(page);
+	ion_page_clear_zeroed(page);
+	return page;
+}
+EXPORT_SYMBOL(ion_shared_page_get);
+
+bool ion_shared_page_put(struct page *page, bool zeroed)
+{
+	struct ion_page_pool *pool = ion_shared_pool();
+
+	if (!pool || ion_page_pool_count(pool) >= ion_shared_pages_max)
+		return false;
+
+	if (zeroed)
+		ion_page_pool_free_zeroed(pool, page);
+	else
+		ion_page_pool_free(pool, page);
+	return true;
+}
+EXPORT_SYMBOL(ion_shared_page_put);
+
+static void ion_shared_pool_attach(struct ion_system_heap *heap)
+{
+	if (!ion_shared_heap)
+		ion_shared_heap = heap;
+}
+
+static void ion_shared_pool_detach(struct ion_system_heap *heap)
+{
+	if (ion_shared_heap == heap)
+		ion_shared_heap = NULL;
+}
+#else
+static inline void ion_shared_pool_attach(struct ion_system_heap *heap) {}
+static inline void ion_shared_pool_detach(struct ion_system_heap *heap) {}
+#endif
+
 static void free_buffer_page(struct ion_system_heap *heap,
 			     struct ion_buffer *buffer, struct page *page)
 {
@@ -191,6 +343,7 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 			if (!page)
 				break;
 
+			ion_smart_pool_account(page, true);
 			list_add_tail(&page->lru, &pages);
 			size_remaining -= PAGE_SIZE << compound_order(page);
 			max_order = compound_order(page);
@@ -212,8 +365,10 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 		}
 
 #ifdef CONFIG_HISI_SMARTPOOL_OPT
-		if (ion_smart_is_graphic_buffer(buffer))
+		if (ion_smart_is_graphic_buffer(buffer)) {
 			ion_smart_sp_init_page(page);
+			ion_smart_pool_account(page, false);
+		}
 #endif
 		list_add_tail(&page->lru, &pages);
 		size_remaining -= PAGE_SIZE << compound_order(page);
@@ -277,6 +432,9 @@ static void ion_system_heap_free(struct ion_buffer *buffer)
 		free_buffer_page(sys_heap, buffer, sg_page(sg));
 	sg_free_table(table);
 	kfree(table);
+
+	if (!(buffer->private_flags & ION_PRIV_FLAG_SHRINKER_FREE))
+		ion_system_heap_zero_kick(sys_heap);
 }
 
 static struct sg_table *ion_system_heap_map_dma(struct ion_heap *heap,
@@ -359,7 +517,7 @@ static int ion_system_heap_shrink(struct ion_heap *heap, gfp_t gfp_mask,
 
 static void ion_system_heap_buffer_zero(struct ion_buffer *buffer)
 {
-	ion_heap_buffer_zero(buffer);
+	ion_heap_buffer_zero_dirty(buffer);
 }
 
 static struct ion_heap_ops system_heap_ops = {
@@ -394,6 +552,13 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 		seq_printf(s, "%d order %u lowmem pages in uncached pool = %lu total\n",
 			   pool->low_count, pool->order,
 			   (PAGE_SIZE << pool->order) * pool->low_count);
+		seq_printf(s, "%d order %u pages in uncached pool magazines = %lu total\n",
+			   ion_page_pool_pcp_count(pool), pool->order,
+			   (PAGE_SIZE << pool->order) *
+			   ion_page_pool_pcp_count(pool));
+		seq_printf(s, "%d order %u zeroed pages in uncached pool = %lu total\n",
+			   pool->zeroed_count, pool->order,
+			   (PAGE_SIZE << pool->order) * pool->zeroed_count);
 	}
 
 	for (i = 0; i < NUM_ORDERS; i++) {
@@ -405,6 +570,13 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 		seq_printf(s, "%d order %u lowmem pages in cached pool = %lu total\n",
 			   pool->low_count, pool->order,
 			   (PAGE_SIZE << pool->order) * pool->low_count);
+		seq_printf(s, "%d order %u pages in cached pool magazines = %lu total\n",
+			   ion_page_pool_pcp_count(pool), pool->order,
+			   (PAGE_SIZE << pool->order) *
+			   ion_page_pool_pcp_count(pool));
+		seq_printf(s, "%d order %u zeroed pages in cached pool = %lu total\n",
+			   pool->zeroed_count, pool->order,
+			   (PAGE_SIZE << pool->order) * pool->zeroed_count);
 	}
 
 #ifdef CONFIG_HISI_SMARTPOOL_OPT
@@ -496,6 +668,8 @@ struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 #endif
 
 	heap->heap.debug_show = ion_system_heap_debug_show;
+	ion_system_heap_zero_start(heap);
+	ion_shared_pool_attach(heap);
 
 	return &heap->heap;
 
@@ -519,6 +693,9 @@ void ion_system_heap_destroy(struct ion_heap *heap)
 							heap);
 	int i;
 
+	ion_shared_pool_detach(sys_heap);
+	ion_system_heap_zero_stop(sys_heap);
+
 	for (i = 0; i < NUM_ORDERS; i++) {
 		ion_page_pool_destroy(sys_heap->uncached_pools[i]);
 		ion_page_pool_destroy(sys_heap->cached_pools[i]);
@@ -91,6 +91,9 @@ static int lmk_timeout_inter = 1;
 
 static unsigned long lowmem_deathpending_timeout;
 
+/* share of a swapped out page a kill gives back, zram keeps the rest */
+#define LMK_SWAP_FREE_PERCENT	60
+
 #define lowmem_print(level, x...)			\
 	do {						\
 		if (lowmem_debug_level >= (level))	\
@@ -112,6 +115,8 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 	struct task_struct *selected = NULL;
 	unsigned long rem = 0;
 	int tasksize;
+	unsigned long rss, swap, ion;
+	bool thrashing = false;
 	int i;
 	short min_score_adj = OOM_SCORE_ADJ_MAX + 1;
 	int minfree = 0;
@@ -143,6 +148,13 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 		}
 	}
 
+	/* thrashing kills from the least important class only */
+	if (min_score_adj == OOM_SCORE_ADJ_MAX + 1 && array_size > 0 &&
+	    hisi_lowmem_thrashing()) {
+		min_score_adj = lowmem_adj[array_size - 1];
+		thrashing = true;
+	}
+
 	lowmem_print(3, "lowmem_scan %lu, %x, ofree %d %d, ma %hd\n",
 			sc->nr_to_scan, sc->gfp_mask, other_free,
 			other_file, min_score_adj);
@@ -153,6 +165,13 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 		return 0;
 	}
 
+	/* protected page cache goes before the tasks it was kept for */
+	if (hisi_lowmem_protect_release(min_score_adj)) {
+		lowmem_print(3, "lowmem_scan %lu, %x, protection dropped\n",
+			     sc->nr_to_scan, sc->gfp_mask);
+		return 0;
+	}
+
 	selected_oom_score_adj = min_score_adj;
 
 	if (atomic_inc_return(&atomic_lmk) > 1) {
@@ -160,6 +179,7 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 		return 0;
 	}
 
+	hisi_lowmem_ion_snapshot();
 	rcu_read_lock();
 #ifdef CONFIG_HISI_MULTI_KILL
 kill_selected:
@@ -197,10 +217,14 @@ kill_selected:
 			task_unlock(p);
 			continue;
 		}
-		tasksize = get_mm_rss(p->mm);
+		rss = get_mm_rss(p->mm);
+		swap = get_mm_counter(p->mm, MM_SWAPENTS);
 		task_unlock(p);
-		if (tasksize <= 0)
+		if (!rss)
 			continue;
+		/* what the kill frees, not only what is resident */
+		ion = hisi_lowmem_ion_pages(p->tgid);
+		tasksize = rss + swap * LMK_SWAP_FREE_PERCENT / 100 + ion;
 		if (selected) {
 			if (oom_score_adj < selected_oom_score_adj)
 				continue;
@@ -213,12 +237,15 @@ kill_selected:
 		selected_oom_score_adj = oom_score_adj;
 		lowmem_print(2, "select '%s' (%d), adj %hd, size %d, to kill\n",
 			     p->comm, p->pid, oom_score_adj, tasksize);
+		hisi_lowmem_trace_select(p, oom_score_adj, rss, swap, ion);
 	}
 	if (selected) {
 		long cache_size = other_file * (long)(PAGE_SIZE / 1024);
 		long cache_limit = minfree * (long)(PAGE_SIZE / 1024);
 		long free = other_free * (long)(PAGE_SIZE / 1024);
 		trace_lowmemory_kill(selected, cache_size, cache_limit, free);
+		if (thrashing)
+			lowmem_print(1, "memory is thrashing above minfree\n");
 		lowmem_print(1, "Killing '%s' (%d), tgid=%d, adj %hd\n" \
 				"   to free %ldkB on behalf of '%s' (%d) because\n" \
 				"   cache %ldkB is below limit %ldkB for oom_score_adj %hd\n" \
@@ -259,6 +286,7 @@ kill_selected:
 		if (selected->mm)
 			mark_tsk_oom_victim(selected);
 		task_unlock(selected);
+		hisi_lowmem_reap(selected);
 		rem += selected_tasksize;
 	}
 
@@ -0,0 +1,244 @@
+/*
+ * Per-uid swap statistics for rcc.
+ *
+ * /proc/rcc_uid_stat lists, for every uid seen swapping, the pages
+ * swapped out and in, and the original and compressed size of what was
+ * swapped out. Writing anything to it clears the counters.
+ */
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/export.h>
+#include <linux/atomic.h>
+#include <linux/cred.h>
+#include <linux/hashtable.h>
+#include <linux/math64.h>
+#include <linux/proc_fs.h>
+#include <linux/rculist.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+#include <linux/rcc_uid_stat.h>
+
+#define RCC_UID_HASH_BITS	7
+/* entries are never freed, so their number is bounded */
+#define RCC_UID_MAX		1024
+/* process reclaims charged at the same time */
+#define RCC_UID_RECLAIMERS	4
+
+struct rcc_uid_stat {
+	struct hlist_node	node;
+	uid_t			uid;
+	atomic64_t		swap_out;
+	atomic64_t		swap_in;
+	atomic64_t		orig_size;
+	atomic64_t		compr_size;
+};
+
+struct rcc_uid_reclaimer {
+	struct task_struct	*task;
+	struct rcc_uid_stat	*stat;
+};
+
+static DEFINE_HASHTABLE(rcc_uid_hash, RCC_UID_HASH_BITS);
+static DEFINE_SPINLOCK(rcc_uid_lock);
+static unsigned int rcc_uid_nr;
+static atomic64_t rcc_uid_dropped;
+
+static struct rcc_uid_reclaimer rcc_uid_reclaimers[RCC_UID_RECLAIMERS];
+static atomic_t rcc_uid_nr_reclaimers;
+
+static struct rcc_uid_stat *rcc_uid_find(uid_t uid)
+{
+	struct rcc_uid_stat *stat;
+
+	hash_for_each_possible_rcu(rcc_uid_hash, stat, node, uid)
+		if (stat->uid == uid)
+			return stat;
+	return NULL;
+}
+
+/* called from the swap i/o path, so it must not sleep */
+static struct rcc_uid_stat *rcc_uid_get(uid_t uid)
+{
+	struct rcc_uid_stat *stat, *new;
+	unsigned long flags;
+
+	rcu_read_lock();
+	stat = rcc_uid_find(uid);
+	rcu_read_unlock();
+	if (stat)
+		return stat;
+
+	new = kzalloc(sizeof(*new), GFP_ATOMIC | __GFP_NOWARN);
+	if (!new)
+		goto dropped;
+	new->uid = uid;
+
+	spin_lock_irqsave(&rcc_uid_lock, flags);
+	stat = rcc_uid_find(uid);
+	if (!stat && rcc_uid_nr < RCC_UID_MAX) {
+		hash_add_rcu(rcc_uid_hash, &new->node, uid);
+		rcc_uid_nr++;
+		stat = new;
+		new = NULL;
+	}
+	spin_unlock_irqrestore(&rcc_uid_lock, flags);
+
+	kfree(new);
+	if (stat)
+		return stat;
+dropped:
+	atomic64_inc(&rcc_uid_dropped);
+	return NULL;
+}
+
+/* the uid charged for the current process reclaim, if any */
+static struct rcc_uid_stat *rcc_uid_reclaiming(void)
+{
+	int i;
+
+	if (!atomic_read(&rcc_uid_nr_reclaimers))
+		return NULL;
+
+	for (i = 0; i < RCC_UID_RECLAIMERS; i++)
+		if (ACCESS_ONCE(rcc_uid_reclaimers[i].task) == current)
+			return rcc_uid_reclaimers[i].stat;
+	return NULL;
+}
+
+/*
+ * Charge the pages stored and read by the current task to @uid until
+ * rcc_uid_reclaim_end(). If too many reclaims run at once the extra
+ * ones are not charged.
+ */
+void rcc_uid_reclaim_begin(uid_t uid)
+{
+	struct rcc_uid_stat *stat = rcc_uid_get(uid);
+	unsigned long flags;
+	int i;
+
+	if (!stat)
+		return;
+
+	spin_lock_irqsave(&rcc_uid_lock, flags);
+	for (i = 0; i < RCC_UID_RECLAIMERS; i++) {
+		if (!rcc_uid_reclaimers[i].task) {
+			rcc_uid_reclaimers[i].stat = stat;
+			ACCESS_ONCE(rcc_uid_reclaimers[i].task) = current;
+			atomic_inc(&rcc_uid_nr_reclaimers);
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&rcc_uid_lock, flags);
+}
+
+void rcc_uid_reclaim_end(void)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&rcc_uid_lock, flags);
+	for (i = 0; i < RCC_UID_RECLAIMERS; i++) {
+		if (rcc_uid_reclaimers[i].task == current) {
+			ACCESS_ONCE(rcc_uid_reclaimers[i].task) = NULL;
+			atomic_dec(&rcc_uid_nr_reclaimers);
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&rcc_uid_lock, flags);
+}
+
+void rcc_uid_swap_out(size_t orig_size, size_t compr_size)
+{
+	struct rcc_uid_stat *stat = rcc_uid_reclaiming();
+
+	if (!stat)
+		return;
+
+	atomic64_inc(&stat->swap_out);
+	atomic64_add(orig_size, &stat->orig_size);
+	atomic64_add(compr_size, &stat->compr_size);
+}
+EXPORT_SYMBOL(rcc_uid_swap_out);
+
+void rcc_uid_swap_in(void)
+{
+	struct rcc_uid_stat *stat = rcc_uid_reclaiming();
+
+	if (!stat)
+		stat = rcc_uid_get(from_kuid(&init_user_ns, current_uid()));
+	if (stat)
+		atomic64_inc(&stat->swap_in);
+}
+EXPORT_SYMBOL(rcc_uid_swap_in);
+
+static int rcc_uid_stat_show(struct seq_file *m, void *v)
+{
+	struct rcc_uid_stat *stat;
+	u64 orig, compr;
+	int bkt;
+
+	seq_printf(m, "%-8s %10s %10s %10s %10s %6s\n", "uid", "swap_out",
+		   "swap_in", "orig_kb", "compr_kb", "ratio");
+
+	rcu_read_lock();
+	hash_for_each_rcu(rcc_uid_hash, bkt, stat, node) {
+		orig = atomic64_read(&stat->orig_size);
+		compr = atomic64_read(&stat->compr_size);
+		seq_printf(m, "%-8u %10llu %10llu %10llu %10llu %5llu%%\n",
+			   stat->uid,
+			   (u64)atomic64_read(&stat->swap_out),
+			   (u64)atomic64_read(&stat->swap_in),
+			   orig >> 10, compr >> 10,
+			   orig ? div64_u64(compr * 100, orig) : 0);
+	}
+	rcu_read_unlock();
+
+	seq_printf(m, "dropped: %llu\n",
+		   (u64)atomic64_read(&rcc_uid_dropped));
+	return 0;
+}
+
+static int rcc_uid_stat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rcc_uid_stat_show, NULL);
+}
+
+static ssize_t rcc_uid_stat_write(struct file *file, const char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	struct rcc_uid_stat *stat;
+	int bkt;
+
+	rcu_read_lock();
+	hash_for_each_rcu(rcc_uid_hash, bkt, stat, node) {
+		atomic64_set(&stat->swap_out, 0);
+		atomic64_set(&stat->swap_in, 0);
+		atomic64_set(&stat->orig_size, 0);
+		atomic64_set(&stat->compr_size, 0);
+	}
+	rcu_read_unlock();
+	atomic64_set(&rcc_uid_dropped, 0);
+
+	return count;
+}
+
+static const struct file_operations rcc_uid_stat_fops = {
+	.open		= rcc_uid_stat_open,
+	.read		= seq_read,
+	.write		= rcc_uid_stat_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init rcc_uid_stat_init(void)
+{
+	if (!proc_create("rcc_uid_stat", 0660, NULL, &rcc_uid_stat_fops)) {
+		pr_err("rcc: failed to create /proc/rcc_uid_stat\n");
+		return -ENOMEM;
+	}
+	return 0;
+}
+late_initcall(rcc_uid_stat_init);
@@ -19,11 +19,53 @@
 #include <linux/fs.h>
 #include <linux/slab.h>
 #include <linux/version.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/jiffies.h>
+#include <asm/tlbflush.h>
 
 /* User knob to show soft reclaim feature */
 static char *soft_reclaim = ".apk .dex .jar .odex";
 module_param_named(soft_reclaim, soft_reclaim, charp, S_IRUGO);
 
+/*
+ * Hotness mode: every soft pass tests and clears the young bit of the
+ * ptes of soft vmas, and only drops the chunks in which no pte was
+ * referenced since the previous pass. Pages just faulted in are young,
+ * so they survive until they have gone one pass untouched.
+ */
+static bool soft_hot_mode;
+module_param_named(soft_hot_mode, soft_hot_mode, bool, S_IRUGO | S_IWUSR);
+
+#define SOFT_CHUNK_PAGES	16
+#define SOFT_CHUNK_SIZE		(SOFT_CHUNK_PAGES << PAGE_SHIFT)
+#define SOFT_REPORTS		32
+
+struct soft_walk_stat {
+	unsigned long scanned;		/* present ptes of soft vmas */
+	unsigned long young;		/* of them, referenced since last pass */
+	unsigned long dropped;		/* ptes zapped */
+	unsigned long zap_start;	/* pending cold range */
+	unsigned long zap_end;
+};
+
+struct soft_report {
+	pid_t pid;
+	char comm[TASK_COMM_LEN];
+	bool hot_mode;
+	unsigned long scanned;
+	unsigned long young;
+	unsigned long dropped;
+	unsigned long time_us;
+	unsigned long stamp;		/* jiffies */
+};
+
+static struct soft_report soft_reports[SOFT_REPORTS];
+static unsigned int soft_report_next;
+static DEFINE_SPINLOCK(soft_report_lock);
+
 /* Below function is same as "madvise_dontneed() in mm/advise.c */
 static long sshrinker_madvise_dontneed(struct vm_area_struct * vma,
 			     unsigned long start, unsigned long end)
@@ -82,21 +124,149 @@ out:
 	return ret;
 }
 
-void smart_soft_shrink(struct mm_struct *mm)
+static void soft_hot_zap(struct vm_area_struct *vma, struct soft_walk_stat *st)
+{
+	if (st->zap_end > st->zap_start)
+		sshrinker_madvise_dontneed(vma, st->zap_start, st->zap_end);
+	st->zap_start = st->zap_end = 0;
+}
+
+static int soft_hot_pte_range(pmd_t *pmd, unsigned long addr,
+				unsigned long end, struct mm_walk *walk)
+{
+	struct soft_walk_stat *st = walk->private;
+	struct vm_area_struct *vma = walk->vma;
+	unsigned long chunk, next, present, young;
+	pte_t *pte, *orig_pte;
+	spinlock_t *ptl;
+
+	split_huge_page_pmd(vma, addr, pmd);
+	if (pmd_trans_unstable(pmd))
+		return 0;
+
+	for (chunk = addr; chunk != end; chunk = next) {
+		next = min(end, (chunk + SOFT_CHUNK_SIZE) & ~(SOFT_CHUNK_SIZE - 1));
+		present = young = 0;
+
+		orig_pte = pte = pte_offset_map_lock(vma->vm_mm, pmd, chunk, &ptl);
+		for (addr = chunk; addr != next; pte++, addr += PAGE_SIZE) {
+			if (!pte_present(*pte))
+				continue;
+			present++;
+			if (ptep_test_and_clear_young(vma, addr, pte))
+				young++;
+		}
+		pte_unmap_unlock(orig_pte, ptl);
+
+		st->scanned += present;
+		st->young += young;
+		if (!present || young)
+			continue;
+
+		/* cold chunk, merge it with the pending range when adjacent */
+		if (st->zap_end != chunk)
+			soft_hot_zap(vma, st);
+		if (!st->zap_end)
+			st->zap_start = chunk;
+		st->zap_end = next;
+		st->dropped += present;
+	}
+
+	/* the range is zapped with the pte lock of this pmd released */
+	soft_hot_zap(vma, st);
+	cond_resched();
+	return 0;
+}
+
+static void soft_report_add(struct task_struct *task, struct soft_walk_stat *st,
+				u64 start_ns)
+{
+	struct soft_report *rep;
+
+	spin_lock(&soft_report_lock);
+	rep = &soft_reports[soft_report_next++ % SOFT_REPORTS];
+	rep->pid = task->pid;
+	get_task_comm(rep->comm, task);
+	rep->hot_mode = soft_hot_mode;
+	rep->scanned = st->scanned;
+	rep->young = st->young;
+	rep->dropped = st->dropped;
+	rep->time_us = (unsigned long)div_u64(sched_clock() - start_ns,
+					NSEC_PER_USEC);
+	rep->stamp = jiffies;
+	spin_unlock(&soft_report_lock);
+}
+
+void smart_soft_shrink(struct task_struct *task, struct mm_struct *mm)
 {
 	struct vm_area_struct *vma;
+	struct soft_walk_stat st = {};
+	struct mm_walk soft_walk = {
+		.pmd_entry = soft_hot_pte_range,
+		.mm = mm,
+		.private = &st,
+	};
+	unsigned long rss = get_mm_counter(mm, MM_FILEPAGES);
+	u64 start_ns = sched_clock();
 
 	down_read(&mm->mmap_sem);
 	for (vma = mm->mmap ; vma; vma = vma->vm_next) {
-		if (is_soft_vma(vma)) {
+		if (!is_soft_vma(vma))
+			continue;
+		if (!soft_hot_mode) {
 			sshrinker_madvise_dontneed(vma, vma->vm_start , vma->vm_end);
+			continue;
 		}
+		if (vma->vm_flags & (VM_LOCKED|VM_HUGETLB|VM_PFNMAP))
+			continue;
+		walk_page_range(vma->vm_start, vma->vm_end, &soft_walk);
 	}
+	if (soft_hot_mode)
+		flush_tlb_mm(mm);
 	up_read(&mm->mmap_sem);
+
+	if (!soft_hot_mode) {
+		st.scanned = rss;
+		st.dropped = rss - min(rss, get_mm_counter(mm, MM_FILEPAGES));
+	}
+	soft_report_add(task, &st, start_ns);
 }
 
+static int soft_report_show(struct seq_file *m, void *v)
+{
+	struct soft_report *rep;
+	unsigned int i, next;
+
+	seq_puts(m, "pid comm mode scanned young dropped time_us age_ms\n");
+	spin_lock(&soft_report_lock);
+	next = soft_report_next;
+	for (i = next > SOFT_REPORTS ? next - SOFT_REPORTS : 0; i < next; i++) {
+		rep = &soft_reports[i % SOFT_REPORTS];
+		seq_printf(m, "%d %s %s %lu %lu %lu %lu %u\n", rep->pid,
+			   rep->comm, rep->hot_mode ? "hot" : "all",
+			   rep->scanned, rep->young, rep->dropped, rep->time_us,
+			   jiffies_to_msecs(jiffies - rep->stamp));
+	}
+	spin_unlock(&soft_report_lock);
+	return 0;
+}
+
+static int soft_report_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, soft_report_show, NULL);
+}
+
+static const struct file_operations soft_report_fops = {
+	.open = soft_report_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int __init smart_reclaim_init(void)
 {
+	debugfs_create_file("smart_reclaim_report", S_IRUSR, NULL, NULL,
+				&soft_report_fops);
 	return 0;
 }
 
@@ -18,7 +18,9 @@
 #include <linux/export.h>
 #include <linux/file.h>
 #include <linux/fs.h>
+#include <linux/init.h>
 #include <linux/kernel.h>
+#include <linux/percpu.h>
 #include <linux/poll.h>
 #include <linux/sched.h>
 #include <linux/seq_file.h>
@@ -34,6 +36,28 @@
 static const struct fence_ops android_fence_ops;
 static const struct file_operations sync_fence_fops;
 
+/*
+ * Most sync_pts are a driver's small wrapper around struct sync_pt and
+ * most fences hold a few points, take both from slab caches and fall
+ * back to kmalloc for anything bigger.
+ */
+#define SYNC_PT_CACHE_SIZE	(sizeof(struct sync_pt) + 64)
+#define SYNC_FENCE_CACHE_PTS	4
+#define SYNC_PT_FLAG_CACHED	FENCE_FLAG_USER_BITS
+
+static struct kmem_cache *sync_pt_cache;
+static struct kmem_cache *sync_fence_cache;
+
+/*
+ * Fences whose last point signaled inside sync_timeline_signal(), woken
+ * after the timeline lock is dropped. Only used with irqs off.
+ */
+struct sync_signal_batch {
+	struct sync_fence *head;
+};
+
+static DEFINE_PER_CPU(struct sync_signal_batch *, sync_signal_batch);
+
 struct sync_timeline *sync_timeline_create(const struct sync_timeline_ops *ops,
 					   int size, const char *name)
 {
@@ -101,23 +125,47 @@ void sync_timeline_destroy(struct sync_timeline *obj)
 }
 EXPORT_SYMBOL(sync_timeline_destroy);
 
+static void sync_fence_free(struct kref *kref);
+
+/*
+ * Signal every point of @obj that has reached its value. The fences
+ * completed by them are woken in one pass once the lock is dropped, so
+ * the woken waiters neither run their wakeup callbacks under the
+ * timeline lock nor spin on it right away.
+ */
 void sync_timeline_signal(struct sync_timeline *obj)
 {
+	struct sync_signal_batch batch = { NULL }, *outer;
 	unsigned long flags;
-	LIST_HEAD(signaled_pts);
 	struct sync_pt *pt, *next;
+	struct sync_fence *fence;
 
 	trace_sync_timeline(obj);
 
 	spin_lock_irqsave(&obj->child_list_lock, flags);
+	/* a nested signal from a fence callback uses the outer batch */
+	outer = this_cpu_read(sync_signal_batch);
+	if (!outer)
+		this_cpu_write(sync_signal_batch, &batch);
 
 	list_for_each_entry_safe(pt, next, &obj->active_list_head,
 				 active_list) {
-		if (fence_is_signaled_locked(&pt->base))
+		if (fence_is_signaled_locked(&pt->base)) {
 			list_del_init(&pt->active_list);
+			sync_timeline_stat_signal(obj, pt);
+		}
 	}
 
+	if (!outer)
+		this_cpu_write(sync_signal_batch, NULL);
 	spin_unlock_irqrestore(&obj->child_list_lock, flags);
+
+	while (batch.head) {
+		fence = batch.head;
+		batch.head = fence->signal_next;
+		wake_up_all(&fence->wq);
+		kref_put(&fence->kref, sync_fence_free);
+	}
 }
 EXPORT_SYMBOL(sync_timeline_signal);
 
@@ -125,11 +173,16 @@ struct sync_pt *sync_pt_create(struct sync_timeline *obj, int size)
 {
 	unsigned long flags;
 	struct sync_pt *pt;
+	bool cached;
 
 	if (size < sizeof(struct sync_pt))
 		return NULL;
 
-	pt = kzalloc(size, GFP_KERNEL);
+	cached = sync_pt_cache && size <= SYNC_PT_CACHE_SIZE;
+	if (cached)
+		pt = kmem_cache_zalloc(sync_pt_cache, GFP_KERNEL);
+	else
+		pt = kzalloc(size, GFP_KERNEL);
 	if (pt == NULL)
 		return NULL;
 
@@ -137,6 +190,9 @@ struct sync_pt *sync_pt_create(struct sync_timeline *obj, int size)
 	sync_timeline_get(obj);
 	fence_init(&pt->base, &android_fence_ops, &obj->child_list_lock,
 		   obj->context, ++obj->value);
+	if (cached)
+		set_bit(SYNC_PT_FLAG_CACHED, &pt->base.flags);
+	pt->create = ktime_get();
 	list_add_tail(&pt->child_list, &obj->child_list_head);
 	INIT_LIST_HEAD(&pt->active_list);
 	spin_unlock_irqrestore(&obj->child_list_lock, flags);
@@ -153,10 +209,16 @@ EXPORT_SYMBOL(sync_pt_free);
 static struct sync_fence *sync_fence_alloc(int size, const char *name)
 {
 	struct sync_fence *fence;
+	bool cached = sync_fence_cache &&
+		size <= offsetof(struct sync_fence, cbs[SYNC_FENCE_CACHE_PTS]);
 
-	fence = kzalloc(size, GFP_KERNEL);
+	if (cached)
+		fence = kmem_cache_zalloc(sync_fence_cache, GFP_KERNEL);
+	else
+		fence = kzalloc(size, GFP_KERNEL);
 	if (fence == NULL)
 		return NULL;
+	fence->cached = cached;
 
 	fence->file = anon_inode_getfile("sync_fence", &sync_fence_fops,
 					 fence, 0);
@@ -171,7 +233,10 @@ static struct sync_fence *sync_fence_alloc(int size, const char *name)
 	return fence;
 
 err:
-	kfree(fence);
+	if (cached)
+		kmem_cache_free(sync_fence_cache, fence);
+	else
+		kfree(fence);
 	return NULL;
 }
 
@@ -179,12 +244,29 @@ static void fence_check_cb_func(struct fence *f, struct fence_cb *cb)
 {
 	struct sync_fence_cb *check;
 	struct sync_fence *fence;
+	struct sync_signal_batch *batch;
 
 	check = container_of(cb, struct sync_fence_cb, cb);
 	fence = check->fence;
 
-	if (atomic_dec_and_test(&fence->status))
-		wake_up_all(&fence->wq);
+	if (!atomic_dec_and_test(&fence->status))
+		return;
+
+	/*
+	 * Inside sync_timeline_signal() the wakeup is deferred until the
+	 * timeline lock is dropped. A fence with no reference left is being
+	 * released and has nobody to wake.
+	 */
+	batch = irqs_disabled() ? this_cpu_read(sync_signal_batch) : NULL;
+	if (batch) {
+		if (kref_get_unless_zero(&fence->kref)) {
+			fence->signal_next = batch->head;
+			batch->head = fence;
+		}
+		return;
+	}
+
+	wake_up_all(&fence->wq);
 }
 
 /* TODO: implement a create which takes more that one sync_pt */
@@ -244,6 +326,13 @@ EXPORT_SYMBOL(sync_fence_install);
 static void sync_fence_add_pt(struct sync_fence *fence,
 			      int *i, struct fence *pt)
 {
+	/* sizing pass, points already signaled will not be added */
+	if (!fence) {
+		if (!test_bit(FENCE_FLAG_SIGNALED_BIT, &pt->flags))
+			(*i)++;
+		return;
+	}
+
 	fence->cbs[*i].sync_pt = pt;
 	fence->cbs[*i].fence = fence;
 
@@ -253,19 +342,15 @@ static void sync_fence_add_pt(struct sync_fence *fence,
 	}
 }
 
-struct sync_fence *sync_fence_merge(const char *name,
-				    struct sync_fence *a, struct sync_fence *b)
+/*
+ * Walk the points of @a and @b in context order, keeping the later one
+ * of a context present in both. With @fence NULL only count the points
+ * that are not signaled yet.
+ */
+static int sync_fence_merge_pts(struct sync_fence *fence,
+				struct sync_fence *a, struct sync_fence *b)
 {
-	int num_fences = a->num_fences + b->num_fences;
-	struct sync_fence *fence;
 	int i, i_a, i_b;
-	unsigned long size = offsetof(struct sync_fence, cbs[num_fences]);
-
-	fence = sync_fence_alloc(size, name);
-	if (fence == NULL)
-		return NULL;
-
-	atomic_set(&fence->status, num_fences);
 
 	/*
 	 * Assume sync_fence a and b are both ordered and have no
@@ -303,6 +388,31 @@ struct sync_fence *sync_fence_merge(const char *name,
 	for (; i_b < b->num_fences; i_b++)
 		sync_fence_add_pt(fence, &i, b->cbs[i_b].sync_pt);
 
+	return i;
+}
+
+/*
+ * Points signaled by the time of the merge are left out, so merging a
+ * long chain of mostly signaled fences stays small and usually fits the
+ * slab cache instead of growing with every merge.
+ */
+struct sync_fence *sync_fence_merge(const char *name,
+				    struct sync_fence *a, struct sync_fence *b)
+{
+	struct sync_fence *fence;
+	int num_fences, i;
+
+	num_fences = sync_fence_merge_pts(NULL, a, b);
+
+	fence = sync_fence_alloc(offsetof(struct sync_fence, cbs[num_fences]),
+				 name);
+	if (fence == NULL)
+		return NULL;
+
+	atomic_set(&fence->status, num_fences);
+
+	i = sync_fence_merge_pts(fence, a, b);
+	/* points that signaled since the sizing pass were not added */
 	if (num_fences > i)
 		atomic_sub(num_fences - i, &fence->status);
 	fence->num_fences = i;
@@ -368,8 +478,46 @@ int sync_fence_cancel_async(struct sync_fence *fence,
 }
 EXPORT_SYMBOL(sync_fence_cancel_async);
 
+/*
+ * Charge a wait to the timeline that made it last: the point signaled
+ * last, or on a timeout the first one still active.
+ */
+static void sync_fence_account_wait(struct sync_fence *fence, ktime_t start,
+				    bool timeout)
+{
+	struct sync_pt *pt, *last = NULL;
+	struct sync_timeline *obj;
+	unsigned long flags;
+	int i;
+
+	for (i = 0; i < fence->num_fences; ++i) {
+		struct fence *f = fence->cbs[i].sync_pt;
+		bool signaled = test_bit(FENCE_FLAG_SIGNALED_BIT, &f->flags);
+
+		if (f->ops != &android_fence_ops || signaled == timeout)
+			continue;
+
+		pt = container_of(f, struct sync_pt, base);
+		if (timeout) {
+			last = pt;
+			break;
+		}
+		if (!last || ktime_after(f->timestamp, last->base.timestamp))
+			last = pt;
+	}
+	if (!last)
+		return;
+
+	obj = sync_pt_parent(last);
+	spin_lock_irqsave(&obj->child_list_lock, flags);
+	sync_timeline_stat_wait(obj, ktime_to_ns(ktime_sub(ktime_get(), start)),
+				timeout);
+	spin_unlock_irqrestore(&obj->child_list_lock, flags);
+}
+
 int sync_fence_wait(struct sync_fence *fence, long timeout)
 {
+	ktime_t start = ktime_get();
 	long ret;
 	int i;
 
@@ -390,6 +538,7 @@ int sync_fence_wait(struct sync_fence *fence, long timeout)
 		return ret;
 	} else if (ret == 0) {
 		if (timeout) {
+			sync_fence_account_wait(fence, start, true);
 			pr_info("fence timeout on [%p] after %dms\n", fence,
 				jiffies_to_msecs(timeout));
 			sync_dump();
@@ -397,6 +546,7 @@ int sync_fence_wait(struct sync_fence *fence, long timeout)
 		return -ETIME;
 	}
 
+	sync_fence_account_wait(fence, start, false);
 	ret = atomic_read(&fence->status);
 	if (ret) {
 		pr_info("fence error %ld on [%p]\n", ret, fence);
@@ -422,6 +572,13 @@ static const char *android_fence_get_timeline_name(struct fence *fence)
 	return parent->name;
 }
 
+static void sync_pt_free_rcu(struct rcu_head *rcu)
+{
+	struct sync_pt *pt = container_of(rcu, struct sync_pt, base.rcu);
+
+	kmem_cache_free(sync_pt_cache, pt);
+}
+
 static void android_fence_release(struct fence *fence)
 {
 	struct sync_pt *pt = container_of(fence, struct sync_pt, base);
@@ -438,7 +595,10 @@ static void android_fence_release(struct fence *fence)
 		parent->ops->free_pt(pt);
 
 	sync_timeline_put(parent);
-	fence_free(&pt->base);
+	if (test_bit(SYNC_PT_FLAG_CACHED, &fence->flags))
+		call_rcu(&fence->rcu, sync_pt_free_rcu);
+	else
+		fence_free(&pt->base);
 }
 
 static bool android_fence_signaled(struct fence *fence)
@@ -534,7 +694,10 @@ static void sync_fence_free(struct kref *kref)
 		fence_put(fence->cbs[i].sync_pt);
 	}
 
-	kfree(fence);
+	if (fence->cached)
+		kmem_cache_free(sync_fence_cache, fence);
+	else
+		kfree(fence);
 }
 
 static int sync_fence_release(struct inode *inode, struct file *file)
@@ -733,3 +896,15 @@ static const struct file_operations sync_fence_fops = {
 	.compat_ioctl = sync_fence_ioctl,
 };
 
+static int __init sync_init(void)
+{
+	sync_pt_cache = kmem_cache_create("sync_pt", SYNC_PT_CACHE_SIZE, 0,
+					  SLAB_HWCACHE_ALIGN, NULL);
+	sync_fence_cache = kmem_cache_create("sync_fence",
+			offsetof(struct sync_fence, cbs[SYNC_FENCE_CACHE_PTS]),
+			0, SLAB_HWCACHE_ALIGN, NULL);
+	if (!sync_pt_cache || !sync_fence_cache)
+		pr_warn("sync: no slab caches, using kmalloc\n");
+	return 0;
+}
+core_initcall(sync_init);
@@ -77,6 +77,20 @@ struct sync_timeline_ops {
 	void (*pt_value_str)(struct sync_pt *pt, char *str, int size);
 };
 
+/*
+ * Latency histograms of a timeline, bucket i counts the latencies below
+ * 2^i us and the last one everything longer.
+ */
+#define SYNC_LAT_BUCKETS	16
+
+struct sync_timeline_stats {
+	u32			signal_hist[SYNC_LAT_BUCKETS];
+	u32			wait_hist[SYNC_LAT_BUCKETS];
+	u64			signal_max_ns;
+	u64			wait_max_ns;
+	u32			wait_timeouts;
+};
+
 /**
  * struct sync_timeline - sync object
  * @kref:		reference count on fence.
@@ -88,6 +102,8 @@ struct sync_timeline_ops {
  *			  sync_pt.status
  * @active_list_head:	list of active (unsignaled/errored) sync_pts
  * @sync_timeline_list:	membership in global sync_timeline_list
+ * @stats:		signal and wait latency histograms, protected by
+ *			  child_list_lock
  */
 struct sync_timeline {
 	struct kref		kref;
@@ -105,6 +121,7 @@ struct sync_timeline {
 
 #ifdef CONFIG_DEBUG_FS
 	struct list_head	sync_timeline_list;
+	struct sync_timeline_stats	stats;
 #endif
 };
 
@@ -113,6 +130,7 @@ struct sync_timeline {
  * @fence:		base fence class
  * @child_list:		membership in sync_timeline.child_list_head
  * @active_list:	membership in sync_timeline.active_list_head
+ * @create:		time the sync_pt was created
  * @signaled_list:	membership in temporary signaled_list on stack
  * @fence:		sync_fence to which the sync_pt belongs
  * @pt_list:		membership in sync_fence.pt_list_head
@@ -125,6 +143,7 @@ struct sync_pt {
 
 	struct list_head	child_list;
 	struct list_head	active_list;
+	ktime_t			create;
 };
 
 static inline struct sync_timeline *sync_pt_parent(struct sync_pt *pt)
@@ -150,6 +169,9 @@ struct sync_fence_cb {
  *
  * @wq:			wait queue for fence signaling
  * @sync_fence_list:	membership in global fence list
+ * @cached:		allocated from the sync_fence slab cache
+ * @signal_next:	membership in the per-cpu list of fences woken once
+ *			  sync_timeline_signal() drops the timeline lock
  */
 struct sync_fence {
 	struct file		*file;
@@ -159,8 +181,10 @@ struct sync_fence {
 	struct list_head	sync_fence_list;
 #endif
 	int num_fences;
+	bool cached;
 
 	wait_queue_head_t	wq;
+	struct sync_fence	*signal_next;
 	atomic_t		status;
 
 	struct sync_fence_cb	cbs[];
@@ -342,6 +366,10 @@ extern void sync_timeline_debug_remove(struct sync_timeline *obj);
 extern void sync_fence_debug_add(struct sync_fence *fence);
 extern void sync_fence_debug_remove(struct sync_fence *fence);
 extern void sync_dump(void);
+extern void sync_timeline_stat_signal(struct sync_timeline *obj,
+				      struct sync_pt *pt);
+extern void sync_timeline_stat_wait(struct sync_timeline *obj, s64 ns,
+				    bool timeout);
 
 #else
 # define sync_timeline_debug_add(obj)
@@ -349,6 +377,8 @@ extern void sync_dump(void);
 # define sync_fence_debug_add(fence)
 # define sync_fence_debug_remove(fence)
 # define sync_dump()
+# define sync_timeline_stat_signal(obj, pt)
+# define sync_timeline_stat_wait(obj, ns, timeout)
 #endif
 int sync_fence_wake_up_wq(wait_queue_t *curr, unsigned mode,
 				 int wake_flags, void *key);
@@ -71,6 +71,55 @@ void sync_fence_debug_remove(struct sync_fence *fence)
 	spin_unlock_irqrestore(&sync_fence_list_lock, flags);
 }
 
+static int sync_lat_bucket(s64 ns)
+{
+	u64 us = ns > 0 ? div_u64(ns, NSEC_PER_USEC) : 0;
+
+	if (!us)
+		return 0;
+	return min_t(int, ilog2(us) + 1, SYNC_LAT_BUCKETS - 1);
+}
+
+/* called with child_list_lock held */
+void sync_timeline_stat_signal(struct sync_timeline *obj, struct sync_pt *pt)
+{
+	struct sync_timeline_stats *st = &obj->stats;
+	s64 ns = ktime_to_ns(ktime_sub(pt->base.timestamp, pt->create));
+
+	st->signal_hist[sync_lat_bucket(ns)]++;
+	if (ns > 0 && ns > st->signal_max_ns)
+		st->signal_max_ns = ns;
+}
+
+/* called with child_list_lock held */
+void sync_timeline_stat_wait(struct sync_timeline *obj, s64 ns, bool timeout)
+{
+	struct sync_timeline_stats *st = &obj->stats;
+
+	st->wait_hist[sync_lat_bucket(ns)]++;
+	if (ns > 0 && ns > st->wait_max_ns)
+		st->wait_max_ns = ns;
+	if (timeout)
+		st->wait_timeouts++;
+}
+
+static void sync_print_hist(struct seq_file *s, const char *name,
+			    const u32 *hist, u64 max_ns)
+{
+	int i, last = -1;
+
+	for (i = 0; i < SYNC_LAT_BUCKETS; i++)
+		if (hist[i])
+			last = i;
+	if (last < 0)
+		return;
+
+	seq_printf(s, "  %s max %lluus:", name, div_u64(max_ns, NSEC_PER_USEC));
+	for (i = 0; i <= last; i++)
+		seq_printf(s, " %u", hist[i]);
+	seq_puts(s, "\n");
+}
+
 static const char *sync_status_str(int status)
 {
 	if (status == 0)
@@ -135,6 +184,14 @@ static void sync_print_obj(struct seq_file *s, struct sync_timeline *obj)
 	seq_puts(s, "\n");
 
 	spin_lock_irqsave(&obj->child_list_lock, flags);
+	/* log2(us) buckets, from <1us up */
+	sync_print_hist(s, "signal", obj->stats.signal_hist,
+			obj->stats.signal_max_ns);
+	sync_print_hist(s, "wait", obj->stats.wait_hist,
+			obj->stats.wait_max_ns);
+	if (obj->stats.wait_timeouts)
+		seq_printf(s, "  wait timeouts %u\n", obj->stats.wait_timeouts);
+
 	list_for_each(pos, &obj->child_list_head) {
 		struct sync_pt *pt =
 			container_of(pos, struct sync_pt, child_list);
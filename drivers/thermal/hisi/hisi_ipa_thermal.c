@@ -25,6 +25,9 @@
 #include <linux/slab.h>
 #include <linux/cpu.h>
 #include <linux/kthread.h>
+#include <linux/jiffies.h>
+#include <linux/math64.h>
+#include <linux/spinlock.h>
 
 #define IPA_SENSOR "tsens_max"
 #define IPA_SENSOR_SYSTEM_H "system_h"
@@ -344,6 +347,181 @@ unsigned long get_soc_temp(void)
 }
 EXPORT_SYMBOL(get_soc_temp);
 
+/*
+ * Frame demand of the soc actors, in percent of the frame deadline the
+ * frame work takes at the current frequency. The power allocator scales
+ * an actor's weighted request by it, so an actor that misses deadlines
+ * (the GPU during a game) wins budget from one without hints or with
+ * slack (a background CPU hog). Hints older than IPA_DEMAND_STALE_MS
+ * count as neutral.
+ */
+#define IPA_DEMAND_NEUTRAL	100
+#define IPA_DEMAND_MIN		25
+#define IPA_DEMAND_MAX		400
+#define IPA_DEMAND_STALE_MS	1000
+
+struct ipa_demand {
+	u32 demand;
+	unsigned long stamp;
+};
+
+static DEFINE_SPINLOCK(ipa_demand_lock);
+static struct ipa_demand ipa_demands[IPA_ACTOR_MAX];
+/* mW each actor keeps under throttling, "hisilicon,ipa-min-power" */
+static u32 ipa_min_power[IPA_ACTOR_MAX];
+
+void ipa_frame_demand_hint(enum ipa_actor actor, u64 work_ns, u64 deadline_ns)
+{
+	struct ipa_demand *d;
+	unsigned long flags;
+	u32 pct;
+
+	if (actor >= IPA_ACTOR_MAX || !deadline_ns)
+		return;
+
+	pct = (u32)min_t(u64, div64_u64(work_ns * 100, deadline_ns),
+			 IPA_DEMAND_MAX);
+	pct = max_t(u32, pct, IPA_DEMAND_MIN);
+
+	d = &ipa_demands[actor];
+	spin_lock_irqsave(&ipa_demand_lock, flags);
+	/* follow a missed deadline quickly, give budget back slowly */
+	if (!d->demand || time_after(jiffies, d->stamp +
+				     msecs_to_jiffies(IPA_DEMAND_STALE_MS)))
+		d->demand = pct;
+	else if (pct > d->demand)
+		d->demand = (d->demand + pct) >> 1;
+	else
+		d->demand = (d->demand * 3 + pct) >> 2;
+	d->stamp = jiffies;
+	spin_unlock_irqrestore(&ipa_demand_lock, flags);
+}
+EXPORT_SYMBOL(ipa_frame_demand_hint);
+
+static enum ipa_actor ipa_cdev_actor(struct thermal_cooling_device *cdev)
+{
+	struct ipa_thermal *soc = &thermal_info.ipa_thermal[SOC];
+	int i;
+
+	for (i = 0; soc->cdevs && i < NUM_CLUSTERS; i++) {
+		if (soc->cdevs[i] == cdev)
+			return (enum ipa_actor)(IPA_CLUSTER0 + i);
+	}
+
+	/* the Mali driver registers the GPU through devfreq_cooling */
+	if (!strncmp(cdev->type, "thermal-devfreq", sizeof("thermal-devfreq") - 1))
+		return IPA_GPU;
+
+	return IPA_ACTOR_MAX;
+}
+
+u32 ipa_actor_demand(struct thermal_cooling_device *cdev, u32 *min_power)
+{
+	enum ipa_actor actor = ipa_cdev_actor(cdev);
+	struct ipa_demand *d;
+	unsigned long flags;
+	u32 demand = IPA_DEMAND_NEUTRAL;
+
+	*min_power = 0;
+	if (actor >= IPA_ACTOR_MAX)
+		return demand;
+
+	*min_power = ipa_min_power[actor];
+
+	d = &ipa_demands[actor];
+	spin_lock_irqsave(&ipa_demand_lock, flags);
+	if (d->demand && time_before(jiffies, d->stamp +
+				     msecs_to_jiffies(IPA_DEMAND_STALE_MS)))
+		demand = d->demand;
+	spin_unlock_irqrestore(&ipa_demand_lock, flags);
+
+	return demand;
+}
+EXPORT_SYMBOL(ipa_actor_demand);
+
+/*
+ * frame_demand: the render thread writes "<actor> <work_us> <deadline_us>"
+ * for the cluster it ran on, reading shows the demand of every actor.
+ */
+static ssize_t frame_demand_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct ipa_demand demands[IPA_ACTOR_MAX];
+	unsigned long flags;
+	ssize_t len = 0;
+	int i;
+
+	spin_lock_irqsave(&ipa_demand_lock, flags);
+	memcpy(demands, ipa_demands, sizeof(demands));
+	spin_unlock_irqrestore(&ipa_demand_lock, flags);
+
+	for (i = 0; i < IPA_ACTOR_MAX; i++) {
+		bool fresh = demands[i].demand &&
+			time_before(jiffies, demands[i].stamp +
+				    msecs_to_jiffies(IPA_DEMAND_STALE_MS));
+
+		len += snprintf(buf + len, PAGE_SIZE - len, "%u%c",
+				fresh ? demands[i].demand : IPA_DEMAND_NEUTRAL,
+				i == IPA_ACTOR_MAX - 1 ? '\n' : ' ');
+	}
+
+	return len;
+}
+
+static ssize_t frame_demand_store(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	unsigned int actor, work_us, deadline_us;
+
+	if (sscanf(buf, "%u %u %u", &actor, &work_us, &deadline_us) != 3)
+		return -EINVAL;
+	if (actor >= IPA_ACTOR_MAX || !deadline_us)
+		return -EINVAL;
+
+	ipa_frame_demand_hint((enum ipa_actor)actor,
+			      (u64)work_us * NSEC_PER_USEC,
+			      (u64)deadline_us * NSEC_PER_USEC);
+
+	return (ssize_t)count;
+}
+static DEVICE_ATTR(frame_demand, S_IWUSR | S_IRUGO, frame_demand_show,
+		   frame_demand_store);
+
+static ssize_t min_power_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u %u %u\n", ipa_min_power[IPA_CLUSTER0],
+			ipa_min_power[IPA_CLUSTER1], ipa_min_power[IPA_GPU]);
+}
+
+static ssize_t min_power_store(struct device *dev,
+			       struct device_attribute *attr,
+			       const char *buf, size_t count)
+{
+	u32 power[IPA_ACTOR_MAX];
+
+	if (sscanf(buf, "%u %u %u", &power[IPA_CLUSTER0], &power[IPA_CLUSTER1],
+		   &power[IPA_GPU]) != IPA_ACTOR_MAX)
+		return -EINVAL;
+
+	memcpy(ipa_min_power, power, sizeof(power));
+
+	return (ssize_t)count;
+}
+static DEVICE_ATTR(min_power, S_IWUSR | S_IRUGO, min_power_show,
+		   min_power_store);
+
+static struct attribute *ipa_demand_attrs[] = {
+	&dev_attr_frame_demand.attr,
+	&dev_attr_min_power.attr,
+	NULL,
+};
+
+static const struct attribute_group ipa_demand_group = {
+	.attrs = ipa_demand_attrs,
+};
+
 static int get_dyn_power_coeff(enum cluster_type cluster, struct ipa_thermal *ipa_dev)
 {
 	if (NULL == ipa_dev) {
@@ -919,6 +1097,10 @@ static int ipa_thermal_probe(struct platform_device *pdev)
 		thermal_data->caps = &g_caps;
 
 		ret = ipa_register_soc_cdev(thermal_data, pdev);
+		if (!ret && of_property_read_u32_array(dev_node,
+				"hisilicon,ipa-min-power", ipa_min_power,
+				(size_t)IPA_ACTOR_MAX))
+			memset(ipa_min_power, 0, sizeof(ipa_min_power));
 	} else if (!strncmp(pdev->name, "ipa-sensor@1", sizeof("ipa-sensor@1") - 1)) {
 		thermal_data = &thermal_info.ipa_thermal[BOARD];
 		thermal_data->caps = &g_caps;
@@ -973,6 +1155,11 @@ static int ipa_thermal_probe(struct platform_device *pdev)
 	}
 
 	update_debugfs(&thermal_data->ipa_sensor);
+
+	if (thermal_data == &thermal_info.ipa_thermal[SOC] &&
+	    sysfs_create_group(&pdev->dev.kobj, &ipa_demand_group))
+		dev_warn(&pdev->dev, "IPA:frame demand attributes not created\n");
+
 	thermal_zone_device_update(thermal_data->tzd);
 
 	platform_set_drvdata(pdev, thermal_data);
@@ -1002,6 +1189,9 @@ static int ipa_thermal_remove(struct platform_device *pdev)
 		return -1;
 	}
 
+	if (thermal_data == &thermal_info.ipa_thermal[SOC])
+		sysfs_remove_group(&pdev->dev.kobj, &ipa_demand_group);
+
 	thermal_zone_of_sensor_unregister(&pdev->dev, thermal_data->tzd);
 	cooling_device_unregister(thermal_data);
 
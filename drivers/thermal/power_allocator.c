@@ -17,6 +17,7 @@
 
 #include <linux/rculist.h>
 #include <linux/slab.h>
+#include <linux/math64.h>
 #include <linux/thermal.h>
 
 #define CREATE_TRACE_POINTS
@@ -33,6 +34,8 @@
 #ifdef CONFIG_HISI_IPA_THERMAL
 #define SOC_THERMAL_NAME "soc_thermal"
 #define MIN_POWER_DIFF 50
+/* ipa_actor_demand() is in percent, 100 without frame hints */
+#define DEMAND_NEUTRAL 100
 #endif
 
 /**
@@ -336,6 +339,45 @@ static void divvy_up_power(u32 *req_power, u32 *max_power, int num_actors,
 }
 
 #ifdef CONFIG_HISI_IPA_THERMAL
+/**
+ * apply_min_power() - raise granted power to each actor's floor
+ * @granted_power:	each actor's granted power, updated
+ * @min_power:	each actor's floor, already capped to its maximum
+ * @num_actors:	size of the arrays
+ * @surplus_power:	temporary storage, as extra_actor_power
+ *
+ * The power given to actors below their floor is taken from the actors
+ * above theirs, in proportion to how far above they are. If the floors
+ * don't fit into the allocated power the zone gets more than allocated
+ * and the pid controller lowers the range in the next periods, so the
+ * floors should add up to less than the sustainable power.
+ */
+static void apply_min_power(u32 *granted_power, u32 *min_power,
+			    int num_actors, u32 *surplus_power)
+{
+	u32 deficit = 0, surplus = 0, taken;
+	int i;
+
+	for (i = 0; i < num_actors; i++) {
+		surplus_power[i] = 0;
+		if (granted_power[i] < min_power[i]) {
+			deficit += min_power[i] - granted_power[i];
+			granted_power[i] = min_power[i];
+		} else {
+			surplus_power[i] = granted_power[i] - min_power[i];
+			surplus += surplus_power[i];
+		}
+	}
+
+	if (!deficit || !surplus)
+		return;
+
+	taken = min(deficit, surplus);
+	for (i = 0; i < num_actors; i++)
+		granted_power[i] -= (u32)div_u64((u64)surplus_power[i] * taken,
+						 surplus);
+}
+
 static void allocate_power_update_pid(struct thermal_zone_device *soc_tz,
 			u32 soc_sustainable_power)
 {
@@ -408,6 +450,9 @@ static int allocate_power(struct thermal_zone_device *tz,
 	struct power_allocator_params *params = tz->governor_data;
 	u32 *req_power, *max_power, *granted_power, *extra_actor_power;
 	u32 *weighted_req_power;
+#ifdef CONFIG_HISI_IPA_THERMAL
+	u32 *min_power, *demand;
+#endif
 	u32 total_req_power, max_allocatable_power, total_weighted_req_power;
 	u32 total_granted_power, power_range;
 	int i, num_actors, total_weight, ret = 0;
@@ -438,13 +483,18 @@ static int allocate_power(struct thermal_zone_device *tz,
 	 * req_power, max_power, granted_power, extra_actor_power and
 	 * weighted_req_power.  They are going to be needed until this
 	 * function returns.  Allocate them all in one go to simplify
-	 * the allocation and deallocation logic.
+	 * the allocation and deallocation logic.  Hisi IPA adds two
+	 * more, min_power and demand.
 	 */
 	BUILD_BUG_ON(sizeof(*req_power) != sizeof(*max_power));
 	BUILD_BUG_ON(sizeof(*req_power) != sizeof(*granted_power));
 	BUILD_BUG_ON(sizeof(*req_power) != sizeof(*extra_actor_power));
 	BUILD_BUG_ON(sizeof(*req_power) != sizeof(*weighted_req_power));
+#ifdef CONFIG_HISI_IPA_THERMAL
+	req_power = kcalloc(num_actors * 7, sizeof(*req_power), GFP_KERNEL);
+#else
 	req_power = kcalloc(num_actors * 5, sizeof(*req_power), GFP_KERNEL);
+#endif
 	if (!req_power) {
 		ret = -ENOMEM;
 		goto unlock;
@@ -454,6 +504,10 @@ static int allocate_power(struct thermal_zone_device *tz,
 	granted_power = &req_power[2 * num_actors];
 	extra_actor_power = &req_power[3 * num_actors];
 	weighted_req_power = &req_power[4 * num_actors];
+#ifdef CONFIG_HISI_IPA_THERMAL
+	min_power = &req_power[5 * num_actors];
+	demand = &req_power[6 * num_actors];
+#endif
 
 	i = 0;
 	total_weighted_req_power = 0;
@@ -483,6 +537,17 @@ static int allocate_power(struct thermal_zone_device *tz,
 		if (power_actor_get_max_power(cdev, tz, &max_power[i]))
 			continue;
 
+#ifdef CONFIG_HISI_IPA_THERMAL
+		/*
+		 * An actor missing its frame deadlines asks for more than its
+		 * utilisation shows, one with slack for less.
+		 */
+		demand[i] = ipa_actor_demand(cdev, &min_power[i]);
+		weighted_req_power[i] = (u32)div_u64((u64)weighted_req_power[i] *
+						     demand[i], DEMAND_NEUTRAL);
+		min_power[i] = min(min_power[i], max_power[i]);
+#endif
+
 		total_req_power += req_power[i];
 		max_allocatable_power += max_power[i];
 		total_weighted_req_power += weighted_req_power[i];
@@ -496,6 +561,10 @@ static int allocate_power(struct thermal_zone_device *tz,
 	divvy_up_power(weighted_req_power, max_power, num_actors,
 		       total_weighted_req_power, power_range, granted_power,
 		       extra_actor_power);
+#ifdef CONFIG_HISI_IPA_THERMAL
+	apply_min_power(granted_power, min_power, num_actors,
+			extra_actor_power);
+#endif
 
 	total_granted_power = 0;
 	i = 0;
@@ -508,6 +577,9 @@ static int allocate_power(struct thermal_zone_device *tz,
 			continue;
 #ifdef CONFIG_HISI_IPA_THERMAL
 		power_actor_set_powers(tz, instance, &soc_sustainable_power, granted_power[i]);
+		trace_IPA_actor_budget(instance->cdev->type, req_power[i],
+				       weighted_req_power[i], demand[i],
+				       min_power[i], granted_power[i]);
 #else
 		power_actor_set_power(instance->cdev, instance,
 				      granted_power[i]);
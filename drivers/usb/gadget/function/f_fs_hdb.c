@@ -33,6 +33,8 @@
 #include <linux/mmu_context.h>
 #include <linux/poll.h>
 #include <linux/eventfd.h>
+#include <linux/scatterlist.h>
+#include <linux/vmalloc.h>
 
 #include "u_fs_hdb.h"
 #include "u_f.h"
@@ -148,9 +150,12 @@ struct ffs_hdb_io_data {
 	struct iov_iter data;
 	const void *to_free;
 	char *buf;
+	/* buf is vmalloc()ed and mapped by sgt */
+	bool use_sg;
+	struct sg_table sgt;
 
 	struct mm_struct *mm;
-	struct work_struct work;
+	struct list_head done;
 
 	struct usb_ep *ep;
 	struct usb_request *req;
@@ -640,12 +645,82 @@ static void ffs_hdb_epfile_io_complete(struct usb_ep *_ep, struct usb_request *r
 	}
 }
 
-static void ffs_hdb_user_copy_worker(struct work_struct *work)
+/*
+ * Transfers bigger than a page are staged in vmalloc()ed memory handed to
+ * the controller as a scatterlist when it can take one, so large aio
+ * requests do not depend on finding physically contiguous memory.
+ */
+static void *ffs_hdb_build_sg_list(struct sg_table *sgt, size_t sz)
+{
+	struct page **pages;
+	void *vaddr, *ptr;
+	unsigned int n_pages;
+	int i;
+
+	vaddr = vmalloc(sz);
+	if (!vaddr)
+		return NULL;
+
+	n_pages = PAGE_ALIGN(sz) >> PAGE_SHIFT;
+	pages = kmalloc_array(n_pages, sizeof(struct page *), GFP_KERNEL);
+	if (!pages) {
+		vfree(vaddr);
+		return NULL;
+	}
+	for (i = 0, ptr = vaddr; i < n_pages; ++i, ptr += PAGE_SIZE)
+		pages[i] = vmalloc_to_page(ptr);
+
+	if (sg_alloc_table_from_pages(sgt, pages, n_pages, 0, sz, GFP_KERNEL)) {
+		kfree(pages);
+		vfree(vaddr);
+		return NULL;
+	}
+	kfree(pages);
+
+	return vaddr;
+}
+
+static void *ffs_hdb_alloc_buffer(struct ffs_hdb_io_data *io_data, size_t data_len)
+{
+	if (io_data->use_sg)
+		return ffs_hdb_build_sg_list(&io_data->sgt, data_len);
+
+	return kmalloc(data_len, GFP_KERNEL);
+}
+
+static void ffs_hdb_free_buffer(struct ffs_hdb_io_data *io_data, void *buf)
+{
+	if (!buf)
+		return;
+
+	if (io_data->use_sg) {
+		sg_free_table(&io_data->sgt);
+		vfree(buf);
+	} else {
+		kfree(buf);
+	}
+}
+
+static void ffs_hdb_prep_req(struct ffs_hdb_io_data *io_data, struct usb_request *req,
+		      void *data, size_t data_len)
+{
+	if (io_data->use_sg) {
+		req->buf = NULL;
+		req->sg = io_data->sgt.sgl;
+		req->num_sgs = io_data->sgt.nents;
+	} else {
+		req->buf = data;
+		req->num_sgs = 0;
+	}
+	req->length = data_len;
+}
+
+/* returns whether the daemon's eventfd should count this completion */
+static bool ffs_hdb_user_copy_complete(struct ffs_hdb_io_data *io_data)
 {
-	struct ffs_hdb_io_data *io_data = container_of(work, struct ffs_hdb_io_data,
-						   work);
 	int ret = io_data->req->status ? io_data->req->status :
 					 io_data->req->actual;
+	bool kiocb_has_eventfd = io_data->kiocb->ki_flags & IOCB_EVENTFD;
 
 	if (io_data->read && ret > 0) {
 		use_mm(io_data->mm);
@@ -657,28 +732,50 @@ static void ffs_hdb_user_copy_worker(struct work_struct *work)
 
 	io_data->kiocb->ki_complete(io_data->kiocb, ret, ret);
 
-	if (io_data->ffs->ffs_hdb_eventfd &&
-	    !(io_data->kiocb->ki_flags & IOCB_EVENTFD))
-		eventfd_signal(io_data->ffs->ffs_hdb_eventfd, 1);
-
 	usb_ep_free_request(io_data->ep, io_data->req);
 
 	io_data->kiocb->private = NULL;
 	if (io_data->read)
 		kfree(io_data->to_free);
-	kfree(io_data->buf);
+	ffs_hdb_free_buffer(io_data, io_data->buf);
 	kfree(io_data);
+
+	return !kiocb_has_eventfd;
+}
+
+static void ffs_hdb_io_completion_work(struct work_struct *work)
+{
+	struct ffs_hdb_data *ffs = container_of(work, struct ffs_hdb_data,
+					     io_completion_work);
+	struct ffs_hdb_io_data *io_data, *tmp;
+	unsigned int events = 0;
+	LIST_HEAD(done);
+
+	spin_lock_irq(&ffs->io_completion_lock);
+	list_splice_init(&ffs->io_completions, &done);
+	spin_unlock_irq(&ffs->io_completion_lock);
+
+	list_for_each_entry_safe(io_data, tmp, &done, done)
+		events += ffs_hdb_user_copy_complete(io_data);
+
+	/* wake the daemon once for everything that completed meanwhile */
+	if (ffs->ffs_hdb_eventfd && events)
+		eventfd_signal(ffs->ffs_hdb_eventfd, events);
 }
 
 static void ffs_hdb_epfile_async_io_complete(struct usb_ep *_ep,
 					 struct usb_request *req)
 {
 	struct ffs_hdb_io_data *io_data = req->context;
+	struct ffs_hdb_data *ffs = io_data->ffs;
+	unsigned long flags;
 
 	ENTER();
 
-	INIT_WORK(&io_data->work, ffs_hdb_user_copy_worker);
-	schedule_work(&io_data->work);
+	spin_lock_irqsave(&ffs->io_completion_lock, flags);
+	list_add_tail(&io_data->done, &ffs->io_completions);
+	spin_unlock_irqrestore(&ffs->io_completion_lock, flags);
+	schedule_work(&ffs->io_completion_work);
 }
 
 static ssize_t ffs_hdb_epfile_io(struct file *file, struct ffs_hdb_io_data *io_data)
@@ -741,7 +838,8 @@ static ssize_t ffs_hdb_epfile_io(struct file *file, struct ffs_hdb_io_data *io_d
 			data_len = usb_ep_align_maybe(gadget, ep->ep, data_len);
 		spin_unlock_irq(&epfile->ffs->eps_lock);
 
-		data = kmalloc(data_len, GFP_KERNEL);
+		io_data->use_sg = gadget->sg_supported && data_len > PAGE_SIZE;
+		data = ffs_hdb_alloc_buffer(io_data, data_len);
 		if (unlikely(!data))
 			return -ENOMEM;
 		if (!io_data->read) {
@@ -796,8 +894,7 @@ static ssize_t ffs_hdb_epfile_io(struct file *file, struct ffs_hdb_io_data *io_d
 			if (unlikely(!req))
 				goto error_lock;
 
-			req->buf      = data;
-			req->length   = data_len;
+			ffs_hdb_prep_req(io_data, req, data, data_len);
 
 			io_data->buf = data;
 			io_data->ep = ep->ep;
@@ -819,8 +916,7 @@ static ssize_t ffs_hdb_epfile_io(struct file *file, struct ffs_hdb_io_data *io_d
 			DECLARE_COMPLETION_ONSTACK(done);
 
 			req = ep->req;
-			req->buf      = data;
-			req->length   = data_len;
+			ffs_hdb_prep_req(io_data, req, data, data_len);
 
 			req->context  = &done;
 			req->complete = ffs_hdb_epfile_io_complete;
@@ -850,7 +946,7 @@ static ssize_t ffs_hdb_epfile_io(struct file *file, struct ffs_hdb_io_data *io_d
 						ret = -EFAULT;
 				}
 			}
-			kfree(data);
+			ffs_hdb_free_buffer(io_data, data);
 		}
 	}
 
@@ -861,7 +957,7 @@ error_lock:
 	spin_unlock_irq(&epfile->ffs->eps_lock);
 	mutex_unlock(&epfile->mutex);
 error:
-	kfree(data);
+	ffs_hdb_free_buffer(io_data, data);
 	return ret;
 }
 
@@ -1453,6 +1549,9 @@ static struct ffs_hdb_data *ffs_hdb_data_new(void)
 	spin_lock_init(&ffs->eps_lock);
 	init_waitqueue_head(&ffs->ev.waitq);
 	init_completion(&ffs->ep0req_completion);
+	spin_lock_init(&ffs->io_completion_lock);
+	INIT_LIST_HEAD(&ffs->io_completions);
+	INIT_WORK(&ffs->io_completion_work, ffs_hdb_io_completion_work);
 
 	/* XXX REVISIT need to update it in some places, or do we? */
 	ffs->ev.can_stall = 1;
@@ -1471,6 +1570,8 @@ static void ffs_hdb_data_clear(struct ffs_hdb_data *ffs)
 	if (ffs->epfiles)
 		ffs_hdb_epfiles_destroy(ffs->epfiles, ffs->eps_count);
 
+	flush_work(&ffs->io_completion_work);
+
 	if (ffs->ffs_hdb_eventfd)
 		eventfd_ctx_put(ffs->ffs_hdb_eventfd);
 
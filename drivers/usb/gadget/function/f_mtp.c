@@ -28,6 +28,8 @@
 
 #include <linux/types.h>
 #include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/backing-dev.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
 
@@ -99,6 +101,7 @@ struct mtp_dev {
 	wait_queue_head_t write_wq;
 	wait_queue_head_t intr_wq;
 	struct usb_request *rx_req[RX_REQ_MAX];
+	/* rx requests completed since the last reset, they complete in order */
 	int rx_done;
 
 	/* for processing MTP_SEND_FILE, MTP_RECEIVE_FILE and
@@ -444,8 +447,10 @@ static void mtp_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct mtp_dev *dev = _mtp_dev;
 
-	dev->rx_done = 1;
-	if (req->status != 0 && dev->state != STATE_CANCELED)
+	dev->rx_done++;
+	/* requests left queued past the end of a file are dequeued */
+	if (req->status != 0 && req->status != -ECONNRESET &&
+	    dev->state != STATE_CANCELED)
 		dev->state = STATE_ERROR;
 
 	wake_up(&dev->read_wq);
@@ -738,6 +743,12 @@ static void send_file_work(struct work_struct *data)
 
 	DBG(cdev, "send_file_work(%lld %lld)\n", offset, count);
 
+	/* the file is read front to back, read ahead like FADV_SEQUENTIAL */
+	spin_lock(&filp->f_lock);
+	filp->f_ra.ra_pages = inode_to_bdi(file_inode(filp))->ra_pages * 2;
+	filp->f_mode &= ~FMODE_RANDOM;
+	spin_unlock(&filp->f_lock);
+
 	if (dev->xfer_send_header) {
 		hdr_size = sizeof(struct mtp_data_header);
 		count += hdr_size;
@@ -824,11 +835,11 @@ static void receive_file_work(struct work_struct *data)
 	struct mtp_dev *dev = container_of(data, struct mtp_dev,
 						receive_file_work);
 	struct usb_composite_dev *cdev = dev->cdev;
-	struct usb_request *read_req = NULL, *write_req = NULL;
+	struct usb_request *req;
 	struct file *filp;
 	loff_t offset;
-	int64_t count;
-	int ret, cur_buf = 0;
+	int64_t count, unqueued;
+	int ret, head = 0, tail = 0, queued = 0, consumed = 0;
 	int r = 0;
 
 	/* read our parameters */
@@ -839,64 +850,82 @@ static void receive_file_work(struct work_struct *data)
 
 	DBG(cdev, "receive_file_work(%lld)\n", count);
 
-	while (count > 0 || write_req) {
-		if (count > 0) {
-			/* queue a request */
-			read_req = dev->rx_req[cur_buf];
-			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
-
-			read_req->length = (count > dev->bulk_buffer_size
-					? dev->bulk_buffer_size : count);
-			dev->rx_done = 0;
-			ret = usb_ep_queue(dev->ep_out, read_req, GFP_KERNEL);
+	/*
+	 * Keep all rx requests queued so that the controller has buffers
+	 * while we write to the file. They complete in order, so the oldest
+	 * one is written next. if xfer_file_length is 0xFFFFFFFF, then we
+	 * read until we get a short packet.
+	 */
+	unqueued = count;
+	dev->rx_done = 0;
+	while (1) {
+		while (unqueued > 0 && queued < RX_REQ_MAX) {
+			req = dev->rx_req[head];
+			req->length = (unqueued > dev->bulk_buffer_size
+					? dev->bulk_buffer_size : unqueued);
+			ret = usb_ep_queue(dev->ep_out, req, GFP_KERNEL);
 			if (ret < 0) {
 				r = -EIO;
 				dev->state = STATE_ERROR;
-				break;
+				goto out;
 			}
+			head = (head + 1) % RX_REQ_MAX;
+			queued++;
+			if (count != 0xFFFFFFFF)
+				unqueued -= req->length;
 		}
+		if (!queued)
+			break;
 
-		if (write_req) {
-			DBG(cdev, "rx %p %d\n", write_req, write_req->actual);
-			ret = vfs_write(filp, write_req->buf, write_req->actual,
-				&offset);
-			DBG(cdev, "vfs_write %d\n", ret);
-			if (ret != write_req->actual) {
-				r = -EIO;
-				dev->state = STATE_ERROR;
-				break;
-			}
-			write_req = NULL;
+		/* wait for the oldest read to complete */
+		ret = wait_event_interruptible(dev->read_wq,
+			dev->rx_done > consumed || dev->state != STATE_BUSY);
+		if (dev->state == STATE_CANCELED) {
+			r = -ECANCELED;
+			break;
+		}
+		if (dev->rx_done <= consumed) {
+			r = ret < 0 ? ret : -EIO;
+			break;
 		}
 
-		if (read_req) {
-			/* wait for our last read to complete */
-			ret = wait_event_interruptible(dev->read_wq,
-				dev->rx_done || dev->state != STATE_BUSY);
-			if (dev->state == STATE_CANCELED) {
-				r = -ECANCELED;
-				if (!dev->rx_done)
-					usb_ep_dequeue(dev->ep_out, read_req);
-				break;
-			}
-			/* if xfer_file_length is 0xFFFFFFFF, then we read until
-			 * we get a zero length packet
-			 */
-			if (count != 0xFFFFFFFF)
-				count -= read_req->actual;
-			if (read_req->actual < read_req->length) {
-				/*
-				 * short packet is used to signal EOF for
-				 * sizes > 4 gig
-				 */
-				DBG(cdev, "got short packet\n");
-				count = 0;
-			}
+		req = dev->rx_req[tail];
+		tail = (tail + 1) % RX_REQ_MAX;
+		queued--;
+		consumed++;
 
-			write_req = read_req;
-			read_req = NULL;
+		DBG(cdev, "rx %p %d\n", req, req->actual);
+		ret = vfs_write(filp, req->buf, req->actual, &offset);
+		DBG(cdev, "vfs_write %d\n", ret);
+		if (ret != req->actual) {
+			r = -EIO;
+			dev->state = STATE_ERROR;
+			break;
 		}
+
+		if (req->actual < req->length) {
+			/*
+			 * short packet is used to signal EOF for
+			 * sizes > 4 gig
+			 */
+			DBG(cdev, "got short packet\n");
+			unqueued = 0;
+			break;
+		}
+	}
+
+out:
+	/* give back what is still queued, newest first */
+	consumed += queued;
+	while (queued--) {
+		head = (head + RX_REQ_MAX - 1) % RX_REQ_MAX;
+		usb_ep_dequeue(dev->ep_out, dev->rx_req[head]);
 	}
+	/*
+	 * The udc may complete the dequeued requests later, wait for them
+	 * before the next transfer resets rx_done and queues them again.
+	 */
+	wait_event(dev->read_wq, dev->rx_done >= consumed);
 
 	DBG(cdev, "receive_file_work returning %d\n", r);
 	/* write the result */
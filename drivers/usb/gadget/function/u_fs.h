@@ -276,6 +276,11 @@ struct ffs_data {
 	bool no_disconnect;
 	struct work_struct reset_work;
 
+	/* completed aio requests, handed back to user space in batches */
+	spinlock_t			io_completion_lock;
+	struct list_head		io_completions;
+	struct work_struct		io_completion_work;
+
 	/*
 	 * The endpoint files, filled by ffs_epfiles_create(),
 	 * destroyed by ffs_epfiles_destroy().
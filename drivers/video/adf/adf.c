@@ -107,12 +107,57 @@ void adf_post_cleanup(struct adf_device *dev, struct adf_pending_post *post)
 static void adf_sw_advance_timeline(struct adf_device *dev)
 {
 #ifdef CONFIG_SW_SYNC
-	sw_sync_timeline_inc(dev->timeline, 1);
+	unsigned long flags;
+	bool released;
+
+	/* the outgoing configuration may have been released already */
+	spin_lock_irqsave(&dev->release_lock, flags);
+	released = dev->onscreen_released;
+	dev->onscreen_released = false;
+	dev->timeline_posted = true;
+	if (!released)
+		sw_sync_timeline_inc(dev->timeline, 1);
+	spin_unlock_irqrestore(&dev->release_lock, flags);
 #else
 	BUG();
 #endif
 }
 
+/**
+ * adf_device_scanout_done - release the on-screen buffers early
+ *
+ * @dev: the display device
+ *
+ * Signals the sw_sync complete fence of the configuration on screen
+ * right away instead of once the next configuration replaces it, so that
+ * producers get the buffers back a frame sooner. Only call it when the
+ * display engine has finished reading those buffers and will not read
+ * them again, such as after a command mode panel took the frame into its
+ * own memory; the next post then leaves the timeline alone.
+ *
+ * Devices implementing their own complete_fence() release their fences
+ * themselves. adf_device_scanout_done() may be called safely from an
+ * atomic context.
+ */
+void adf_device_scanout_done(struct adf_device *dev)
+{
+#ifdef CONFIG_SW_SYNC
+	unsigned long flags;
+
+	if (dev->ops->advance_timeline)
+		return;
+
+	spin_lock_irqsave(&dev->release_lock, flags);
+	if (dev->timeline && dev->timeline_posted &&
+			!dev->onscreen_released) {
+		dev->onscreen_released = true;
+		sw_sync_timeline_inc(dev->timeline, 1);
+	}
+	spin_unlock_irqrestore(&dev->release_lock, flags);
+#endif
+}
+EXPORT_SYMBOL(adf_device_scanout_done);
+
 static void adf_post_work_func(struct kthread_work *work)
 {
 	struct adf_device *dev =
@@ -137,11 +182,12 @@ static void adf_post_work_func(struct kthread_work *work)
 
 		dev->ops->post(dev, &post->config, post->state);
 
-		if (dev->ops->advance_timeline)
+		if (dev->ops->advance_timeline) {
 			dev->ops->advance_timeline(dev, &post->config,
 					post->state);
-		else
+		} else {
 			adf_sw_advance_timeline(dev);
+		}
 
 		list_del(&post->head);
 		if (dev->onscreen)
@@ -557,6 +603,7 @@ int adf_device_init(struct adf_device *dev, struct device *parent,
 	mutex_init(&dev->client_lock);
 	INIT_LIST_HEAD(&dev->post_list);
 	mutex_init(&dev->post_lock);
+	spin_lock_init(&dev->release_lock);
 	init_kthread_worker(&dev->post_worker);
 	INIT_LIST_HEAD(&dev->attached);
 	INIT_LIST_HEAD(&dev->attach_allowed);
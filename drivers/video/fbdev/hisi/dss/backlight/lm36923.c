@@ -18,6 +18,9 @@
 #include <linux/interrupt.h>
 #include <linux/regmap.h>
 #include <linux/semaphore.h>
+#include <linux/mutex.h>
+#include <linux/hrtimer.h>
+#include <linux/workqueue.h>
 #include "lm36923.h"
 #include "hisi_fb.h"
 #if defined (CONFIG_HUAWEI_DSM)
@@ -40,6 +43,11 @@ MODULE_PARM_DESC(debug_lm36923_msg_level, "backlight lm36923 msg level");
 uint32_t last_brightness = -1;
 static int lm36923_led_num = 0;
 
+/* frames an asynchronous brightness change is spread over */
+static unsigned int lm36923_ramp_frames = 8;
+module_param_named(lm36923_ramp_frames, lm36923_ramp_frames, uint, 0644);
+MODULE_PARM_DESC(lm36923_ramp_frames, "backlight lm36923 ramp length in frames");
+
 /* initialize chip */
 static int lm36923_chip_init(struct lm36923_chip_data *pchip)
 {
@@ -198,15 +206,8 @@ i2c_error:
 }
 EXPORT_SYMBOL(lm36923_set_backlight_mode);
 
-/**
- * lm36923_set_backlight_reg(): Set Backlight working mode
- *
- * @bl_level: value for backlight ,range from 0 to 2047
- *
- * A value of zero will be returned on success, a negative errno will
- * be returned in error cases.
- */
-ssize_t lm36923_set_backlight_reg(uint32_t bl_level)
+/* called with level_lock held */
+static ssize_t lm36923_write_level(uint32_t bl_level)
 {
 	ssize_t ret = -1;
 	uint32_t level = 0;
@@ -283,8 +284,193 @@ i2c_error:
 	dev_err(g_pchip->dev, "%s:i2c access fail to register\n", __func__);
 	return ret;
 }
+
+static void lm36923_ramp_stop(struct lm36923_ramp *ramp)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ramp->lock, flags);
+	ramp->target = ramp->cur;
+	spin_unlock_irqrestore(&ramp->lock, flags);
+
+	hrtimer_cancel(&ramp->timer);
+	cancel_work_sync(&ramp->work);
+	hrtimer_cancel(&ramp->timer);
+
+	spin_lock_irqsave(&ramp->lock, flags);
+	ramp->active = false;
+	spin_unlock_irqrestore(&ramp->lock, flags);
+}
+
+/**
+ * lm36923_set_backlight_reg(): Set Backlight working mode
+ *
+ * @bl_level: value for backlight ,range from 0 to 2047
+ *
+ * Sets the level right away from the caller's context, a ramp in
+ * progress ends at this level.
+ *
+ * A value of zero will be returned on success, a negative errno will
+ * be returned in error cases.
+ */
+ssize_t lm36923_set_backlight_reg(uint32_t bl_level)
+{
+	struct lm36923_ramp *ramp;
+	unsigned long flags;
+	ssize_t ret;
+
+	if (!lm36923_init_status) {
+		LM36923_ERR("init fail, return.\n");
+		return -1;
+	}
+
+	/* no step of the ramp may land after this level */
+	ramp = &g_pchip->ramp;
+	lm36923_ramp_stop(ramp);
+	spin_lock_irqsave(&ramp->lock, flags);
+	ramp->target = min_t(uint32_t, bl_level, BL_MAX);
+	ramp->cur = ramp->target;
+	spin_unlock_irqrestore(&ramp->lock, flags);
+
+	mutex_lock(&g_pchip->level_lock);
+	ret = lm36923_write_level(bl_level);
+	mutex_unlock(&g_pchip->level_lock);
+
+	return ret;
+}
 EXPORT_SYMBOL(lm36923_set_backlight_reg);
 
+/* called with ramp->lock held: next step at the vsync after now */
+static void lm36923_ramp_arm(struct lm36923_ramp *ramp)
+{
+	ktime_t now = ktime_get();
+	ktime_t next;
+	s64 since;
+
+	since = ktime_to_ns(ktime_sub(now, ramp->vsync));
+	if (ramp->vsync.tv64 && since >= 0 && since < LM36923_RAMP_VSYNC_STALE_NS)
+		next = ktime_add_ns(ramp->vsync,
+			(div64_u64(since, ramp->period_ns) + 1) * ramp->period_ns);
+	else
+		next = ktime_add_ns(now, ramp->period_ns);
+
+	hrtimer_start(&ramp->timer, next, HRTIMER_MODE_ABS);
+}
+
+static void lm36923_ramp_work(struct work_struct *work)
+{
+	struct lm36923_ramp *ramp = container_of(work, struct lm36923_ramp, work);
+	unsigned long flags;
+	uint32_t level;
+
+	spin_lock_irqsave(&ramp->lock, flags);
+	if (ramp->cur < ramp->target)
+		level = min(ramp->cur + ramp->step, ramp->target);
+	else
+		level = max_t(int, (int)ramp->cur - (int)ramp->step, (int)ramp->target);
+	ramp->cur = level;
+	ramp->steps++;
+	spin_unlock_irqrestore(&ramp->lock, flags);
+
+	mutex_lock(&g_pchip->level_lock);
+	lm36923_write_level(level);
+	mutex_unlock(&g_pchip->level_lock);
+
+	spin_lock_irqsave(&ramp->lock, flags);
+	if (ramp->cur != ramp->target)
+		lm36923_ramp_arm(ramp);
+	else
+		ramp->active = false;
+	spin_unlock_irqrestore(&ramp->lock, flags);
+}
+
+static enum hrtimer_restart lm36923_ramp_timer_fn(struct hrtimer *timer)
+{
+	struct lm36923_ramp *ramp = container_of(timer, struct lm36923_ramp, timer);
+
+	/* the i2c writes can't be done from the timer */
+	queue_work(system_highpri_wq, &ramp->work);
+	return HRTIMER_NORESTART;
+}
+
+/**
+ * lm36923_set_backlight_async(): Ramp Backlight to a level
+ *
+ * @bl_level: value for backlight ,range from 0 to 2047
+ *
+ * Returns at once. The level is reached in lm36923_ramp_frames steps, one
+ * per vsync; a new level while a ramp runs just retargets it, so rapid
+ * updates from the ambient light path coalesce. Turning the backlight on
+ * or off is not ramped.
+ */
+ssize_t lm36923_set_backlight_async(uint32_t bl_level)
+{
+	struct lm36923_ramp *ramp;
+	unsigned long flags;
+	uint32_t diff;
+
+	if (!lm36923_init_status) {
+		LM36923_ERR("init fail, return.\n");
+		return -1;
+	}
+
+	ramp = &g_pchip->ramp;
+	spin_lock_irqsave(&ramp->lock, flags);
+	ramp->requests++;
+	ramp->target = min_t(uint32_t, bl_level, BL_MAX);
+	diff = abs((int)ramp->target - (int)ramp->cur);
+	if (!ramp->target || !ramp->cur || !lm36923_ramp_frames)
+		ramp->step = diff;
+	else
+		ramp->step = max_t(uint32_t, DIV_ROUND_UP(diff, lm36923_ramp_frames), 1);
+
+	if (ramp->active) {
+		ramp->coalesced++;
+	} else if (diff) {
+		/* first step right away, the next ones on vsync */
+		ramp->active = true;
+		queue_work(system_highpri_wq, &ramp->work);
+	}
+	spin_unlock_irqrestore(&ramp->lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL(lm36923_set_backlight_async);
+
+/**
+ * lm36923_backlight_vsync(): vsync timestamp for aligning ramp steps
+ *
+ * @timestamp: time of the vsync, called from the vsync interrupt
+ */
+void lm36923_backlight_vsync(ktime_t timestamp)
+{
+	struct lm36923_ramp *ramp;
+	unsigned long flags;
+	s64 delta;
+
+	if (!lm36923_init_status)
+		return;
+
+	ramp = &g_pchip->ramp;
+	spin_lock_irqsave(&ramp->lock, flags);
+	delta = ktime_to_ns(ktime_sub(timestamp, ramp->vsync));
+	/* follow the refresh rate, ignoring gaps of idle frames */
+	if (ramp->vsync.tv64 && delta > 0 && delta < 2 * LM36923_RAMP_PERIOD_NS)
+		ramp->period_ns = (ramp->period_ns * 7 + delta) >> 3;
+	ramp->vsync = timestamp;
+	spin_unlock_irqrestore(&ramp->lock, flags);
+}
+EXPORT_SYMBOL(lm36923_backlight_vsync);
+
+static void lm36923_ramp_init(struct lm36923_ramp *ramp)
+{
+	spin_lock_init(&ramp->lock);
+	hrtimer_init(&ramp->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	ramp->timer.function = lm36923_ramp_timer_fn;
+	INIT_WORK(&ramp->work, lm36923_ramp_work);
+	ramp->period_ns = LM36923_RAMP_PERIOD_NS;
+}
+
 /**
  * lm36923_set_reg(): Set lm36923 reg
  *
@@ -923,6 +1109,30 @@ lm36923_test_out:
 
 static DEVICE_ATTR(self_test, S_IRUGO|S_IWUSR, lm36923_self_test_show, NULL);
 
+static ssize_t lm36923_ramp_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct lm36923_chip_data *pchip = dev_get_drvdata(dev);
+	struct lm36923_ramp *ramp;
+	unsigned long flags;
+	ssize_t ret;
+
+	if (!pchip)
+		return -EINVAL;
+
+	ramp = &pchip->ramp;
+	spin_lock_irqsave(&ramp->lock, flags);
+	ret = snprintf(buf, PAGE_SIZE,
+		"cur=%u target=%u step=%u period_ns=%llu requests=%lu coalesced=%lu steps=%lu\n",
+		ramp->cur, ramp->target, ramp->step, ramp->period_ns,
+		ramp->requests, ramp->coalesced, ramp->steps);
+	spin_unlock_irqrestore(&ramp->lock, flags);
+
+	return ret;
+}
+
+static DEVICE_ATTR(ramp, S_IRUGO, lm36923_ramp_show, NULL);
+
 static const struct regmap_config lm36923_regmap = {
 	.reg_bits = 8,
 	.val_bits = 8,
@@ -935,6 +1145,7 @@ static struct attribute *lm36923_attributes[] = {
 	&dev_attr_reg_bl.attr,
 	&dev_attr_reg.attr,
 	&dev_attr_self_test.attr,
+	&dev_attr_ramp.attr,
 	NULL,
 };
 
@@ -976,6 +1187,8 @@ static int lm36923_probe(struct i2c_client *client,
 	i2c_set_clientdata(client, pchip);
 
 	sema_init(&(pchip->test_sem), 1);
+	mutex_init(&pchip->level_lock);
+	lm36923_ramp_init(&pchip->ramp);
 
 	/* chip initialize */
 	ret = lm36923_chip_init(pchip);
@@ -1033,6 +1246,7 @@ static int lm36923_remove(struct i2c_client *client)
 {
 	struct lm36923_chip_data *pchip = i2c_get_clientdata(client);
 
+	lm36923_ramp_stop(&pchip->ramp);
 	regmap_write(pchip->regmap, REG_ENABLE, 0x00);
 
 	sysfs_remove_group(&client->dev.kobj, &lm36923_group);
@@ -179,11 +179,34 @@ enum lm36923_ramp_rate{
 #define OVP_OCP_SHUTDOWN_DISABLE 0x07
 #define OCP_SHUTDOWN_OVP_DISABLE 0x05
 
+/* default frame period the ramp steps at without vsync timestamps */
+#define LM36923_RAMP_PERIOD_NS	16666667
+/* vsync timestamps older than this are not used to align steps */
+#define LM36923_RAMP_VSYNC_STALE_NS	(NSEC_PER_SEC)
+
+struct lm36923_ramp {
+	spinlock_t lock;	/* protects the fields below */
+	struct hrtimer timer;
+	struct work_struct work;
+	uint32_t target;
+	uint32_t cur;
+	uint32_t step;
+	bool active;
+	ktime_t vsync;		/* last vsync seen */
+	u64 period_ns;		/* vsync period */
+	/* statistics */
+	unsigned long requests;
+	unsigned long coalesced;
+	unsigned long steps;
+};
+
 struct lm36923_chip_data {
 	struct device *dev;
 	struct i2c_client *client;
 	struct regmap *regmap;
 	struct semaphore test_sem;
+	struct mutex level_lock;	/* serializes the level writes */
+	struct lm36923_ramp ramp;
 };
 
 struct lm36923_platform_data {
@@ -199,6 +222,8 @@ struct lm36923_platform_data {
 };
 
 ssize_t lm36923_set_backlight_reg(uint32_t bl_level);
+ssize_t lm36923_set_backlight_async(uint32_t bl_level);
+void lm36923_backlight_vsync(ktime_t timestamp);
 
 #endif /* __LINUX_LM36923_H */
 
@@ -573,6 +573,7 @@ static int __init fscrypt_init(void)
 	if (!fscrypt_info_cachep)
 		goto fail_free_ctx;
 
+	fscrypt_key_cache_init();
 	return 0;
 
 fail_free_ctx:
@@ -590,6 +591,7 @@ module_init(fscrypt_init)
 static void __exit fscrypt_exit(void)
 {
 	fscrypt_destroy();
+	fscrypt_key_cache_exit();
 
 	if (fscrypt_read_workqueue)
 		destroy_workqueue(fscrypt_read_workqueue);
@@ -15,6 +15,195 @@
 #include <uapi/linux/keyctl.h>
 #include <crypto/hash.h>
 #include <linux/fscrypto.h>
+#include <linux/hashtable.h>
+#include <linux/notifier.h>
+#include <linux/spinlock.h>
+#include <crypto/sha.h>
+#include <asm/unaligned.h>
+
+/*
+ * Cache of derived per-file keys. Opening an encrypted file derives its key
+ * from the master key with AES-GCM; the same files are opened again and
+ * again across app starts, so keep the recent results.
+ *
+ * An entry is tied to the master key it was derived from by a SHA-256
+ * digest of that key, so a payload updated in place or a new key under the
+ * same descriptor never hits old entries. The keys subsystem tells us when
+ * a logon key payload is replaced, revoked, unlinked or destroyed, and the
+ * entries derived from it are dropped right away.
+ */
+#define FS_KEY_CACHE_BITS	6
+#define FS_KEY_CACHE_SIZE	256
+
+struct fscrypt_key_cache_entry {
+	struct hlist_node hnode;
+	struct list_head lru;
+	u8 key_digest[SHA256_DIGEST_SIZE];
+	u8 nonce[FS_KEY_DERIVATION_CIPHER_SIZE];
+	u8 iv[FS_KEY_DERIVATION_IV_SIZE];
+	u8 raw[FS_KEY_DERIVATION_NONCE_SIZE];
+};
+
+static DEFINE_HASHTABLE(fscrypt_key_cache, FS_KEY_CACHE_BITS);
+static LIST_HEAD(fscrypt_key_cache_lru);
+static unsigned int fscrypt_key_cache_count;
+static DEFINE_SPINLOCK(fscrypt_key_cache_lock);
+/* NULL when sha256 is not available, nothing is cached then */
+static struct crypto_shash *fscrypt_key_digest_tfm;
+
+/* the nonce is random, its first bytes make a good hash */
+static u32 fscrypt_key_cache_hash(const struct fscrypt_context *ctx)
+{
+	return get_unaligned((const u32 *)ctx->nonce);
+}
+
+/* callers check that fscrypt_key_digest_tfm is set */
+static int fscrypt_key_digest(const struct fscrypt_key *master_key,
+			      u8 *digest)
+{
+	SHASH_DESC_ON_STACK(desc, fscrypt_key_digest_tfm);
+	int res;
+
+	desc->tfm = fscrypt_key_digest_tfm;
+	desc->flags = 0;
+	res = crypto_shash_digest(desc, master_key->raw, master_key->size,
+				  digest);
+	memzero_explicit(desc, sizeof(*desc) +
+			 crypto_shash_descsize(fscrypt_key_digest_tfm));
+	return res;
+}
+
+static void fscrypt_key_cache_free(struct fscrypt_key_cache_entry *e)
+{
+	hash_del(&e->hnode);
+	list_del(&e->lru);
+	fscrypt_key_cache_count--;
+	kzfree(e);
+}
+
+static bool fscrypt_key_cache_get(const u8 *key_digest,
+				  const struct fscrypt_context *ctx, u8 *raw_key)
+{
+	struct fscrypt_key_cache_entry *e;
+	bool found = false;
+
+	spin_lock(&fscrypt_key_cache_lock);
+	hash_for_each_possible(fscrypt_key_cache, e, hnode,
+			       fscrypt_key_cache_hash(ctx)) {
+		if (memcmp(e->key_digest, key_digest, sizeof(e->key_digest)) ||
+		    memcmp(e->nonce, ctx->nonce, sizeof(e->nonce)) ||
+		    memcmp(e->iv, ctx->iv, sizeof(e->iv)))
+			continue;
+		memcpy(raw_key, e->raw, sizeof(e->raw));
+		list_move(&e->lru, &fscrypt_key_cache_lru);
+		found = true;
+		break;
+	}
+	spin_unlock(&fscrypt_key_cache_lock);
+
+	return found;
+}
+
+static void fscrypt_key_cache_put(const u8 *key_digest,
+				  const struct fscrypt_context *ctx,
+				  const u8 *raw_key)
+{
+	struct fscrypt_key_cache_entry *e;
+
+	e = kmalloc(sizeof(*e), GFP_NOFS);
+	if (!e)
+		return;
+
+	memcpy(e->key_digest, key_digest, sizeof(e->key_digest));
+	memcpy(e->nonce, ctx->nonce, sizeof(e->nonce));
+	memcpy(e->iv, ctx->iv, sizeof(e->iv));
+	memcpy(e->raw, raw_key, sizeof(e->raw));
+
+	spin_lock(&fscrypt_key_cache_lock);
+	if (fscrypt_key_cache_count >= FS_KEY_CACHE_SIZE)
+		fscrypt_key_cache_free(list_last_entry(&fscrypt_key_cache_lru,
+				struct fscrypt_key_cache_entry, lru));
+	hash_add(fscrypt_key_cache, &e->hnode, fscrypt_key_cache_hash(ctx));
+	list_add(&e->lru, &fscrypt_key_cache_lru);
+	fscrypt_key_cache_count++;
+	spin_unlock(&fscrypt_key_cache_lock);
+}
+
+/* drop the keys derived from one master key */
+static void fscrypt_key_cache_drop(const u8 *key_digest)
+{
+	struct fscrypt_key_cache_entry *e, *tmp;
+
+	spin_lock(&fscrypt_key_cache_lock);
+	list_for_each_entry_safe(e, tmp, &fscrypt_key_cache_lru, lru) {
+		if (!memcmp(e->key_digest, key_digest, sizeof(e->key_digest)))
+			fscrypt_key_cache_free(e);
+	}
+	spin_unlock(&fscrypt_key_cache_lock);
+}
+
+/* a logon key payload is going away, forget what was derived from it */
+static int fscrypt_key_cache_notify(struct notifier_block *nb,
+				    unsigned long action, void *data)
+{
+	const struct user_key_payload *ukp = data;
+	const struct fscrypt_key *master_key;
+	u8 key_digest[SHA256_DIGEST_SIZE];
+
+	if (!fscrypt_key_digest_tfm || ukp->datalen != sizeof(struct fscrypt_key))
+		return NOTIFY_DONE;
+	master_key = (const struct fscrypt_key *)ukp->data;
+	if (master_key->size != FS_AES_256_GCM_KEY_SIZE)
+		return NOTIFY_DONE;
+
+	if (!fscrypt_key_digest(master_key, key_digest))
+		fscrypt_key_cache_drop(key_digest);
+	memzero_explicit(key_digest, sizeof(key_digest));
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block fscrypt_key_cache_nb = {
+	.notifier_call = fscrypt_key_cache_notify,
+};
+
+/**
+ * fscrypt_key_cache_init() - set up the cache of per-file keys
+ *
+ * The cache stays disabled when sha256 is not available.
+ */
+void fscrypt_key_cache_init(void)
+{
+	struct crypto_shash *tfm;
+
+	tfm = crypto_alloc_shash("sha256", 0, 0);
+	if (IS_ERR(tfm)) {
+		printk(KERN_WARNING "%s: no sha256, key cache disabled\n",
+		       __func__);
+		return;
+	}
+	fscrypt_key_digest_tfm = tfm;
+	register_logon_key_notifier(&fscrypt_key_cache_nb);
+}
+
+/**
+ * fscrypt_key_cache_exit() - forget all cached per-file keys
+ */
+void fscrypt_key_cache_exit(void)
+{
+	struct fscrypt_key_cache_entry *e, *tmp;
+
+	if (!fscrypt_key_digest_tfm)
+		return;
+
+	unregister_logon_key_notifier(&fscrypt_key_cache_nb);
+	spin_lock(&fscrypt_key_cache_lock);
+	list_for_each_entry_safe(e, tmp, &fscrypt_key_cache_lru, lru)
+		fscrypt_key_cache_free(e);
+	spin_unlock(&fscrypt_key_cache_lock);
+	crypto_free_shash(fscrypt_key_digest_tfm);
+	fscrypt_key_digest_tfm = NULL;
+}
 
 static void derive_crypt_complete(struct crypto_async_request *req, int rc)
 {
@@ -188,6 +377,8 @@ static int validate_user_key(struct fscrypt_info *crypt_info,
 	const struct user_key_payload *ukp;
 	int res;
 	u8 plain_text[FS_KEY_DERIVATION_CIPHER_SIZE] = {0};
+	u8 key_digest[SHA256_DIGEST_SIZE];
+	bool cached;
 
 	keyring_key = fscrypt_request_key(ctx->master_key_descriptor,
 				prefix, prefix_size);
@@ -218,12 +409,24 @@ static int validate_user_key(struct fscrypt_info *crypt_info,
 		up_read(&keyring_key->sem);
 		goto out;
 	}
+	cached = fscrypt_key_digest_tfm &&
+		 !fscrypt_key_digest(master_key, key_digest);
+	if (cached && fscrypt_key_cache_get(key_digest, ctx, raw_key)) {
+		up_read(&keyring_key->sem);
+		memzero_explicit(key_digest, sizeof(key_digest));
+		crypt_info->ci_keyring_key = keyring_key;
+		return 0;
+	}
 	res = derive_aes_gcm_key(master_key->raw, ctx->nonce, plain_text, ctx->iv, 0);
+	if (!res && cached)
+		fscrypt_key_cache_put(key_digest, ctx, plain_text);
 	up_read(&keyring_key->sem);
+	memzero_explicit(key_digest, sizeof(key_digest));
 	if (res)
 		goto out;
 
 	memcpy(raw_key, plain_text, FS_KEY_DERIVATION_NONCE_SIZE);
+	memzero_explicit(plain_text, sizeof(plain_text));
 
 	crypt_info->ci_keyring_key = keyring_key;
 	return 0;
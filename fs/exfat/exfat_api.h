@@ -136,6 +136,15 @@ typedef struct {
 	u8       flags;
 } CHAIN_T;
 
+/* run of contiguous clusters of a file */
+#define EXTENT_CACHE_SIZE       8
+
+typedef struct {
+	u32      fofs;                   /* cluster offset in the file */
+	u32      clu;                    /* first cluster */
+	u32      len;                    /* num of clusters, 0 if unused */
+} EXTENT_T;
+
 /* file id structure */
 typedef struct {
 	CHAIN_T     dir;
@@ -148,6 +157,8 @@ typedef struct {
 	s64       rwoffset;
 	s32       hint_last_off;
 	u32      hint_last_clu;
+	EXTENT_T    extents[EXTENT_CACHE_SIZE]; /* FAT chain runs already walked */
+	u32      extent_next;
 } FILE_ID_T;
 
 typedef struct {
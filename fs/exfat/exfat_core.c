@@ -351,6 +351,7 @@ s32 ffsLookupFile(struct inode *inode, char *path, FILE_ID_T *fid)
 		fid->type = TYPE_DIR;
 		fid->rwoffset = 0;
 		fid->hint_last_off = -1;
+		extent_cache_inval(fid);
 
 		fid->attr = ATTR_SUBDIR;
 		fid->flags = 0x01;
@@ -372,6 +373,7 @@ s32 ffsLookupFile(struct inode *inode, char *path, FILE_ID_T *fid)
 		fid->type = p_fs->fs_func->get_entry_type(ep);
 		fid->rwoffset = 0;
 		fid->hint_last_off = -1;
+		extent_cache_inval(fid);
 		fid->attr = p_fs->fs_func->get_entry_attr(ep);
 
 		fid->size = p_fs->fs_func->get_entry_size(ep2);
@@ -824,6 +826,7 @@ s32 ffsTruncateFile(struct inode *inode, u64 old_size, u64 new_size)
 
 	/* hint information */
 	fid->hint_last_off = -1;
+	extent_cache_inval(fid);
 	if (fid->rwoffset > fid->size)
 		fid->rwoffset = fid->size;
 
@@ -1282,6 +1285,74 @@ s32 ffsSetStat(struct inode *inode, DIR_ENTRY_T *info)
 	return FFS_SUCCESS;
 } /* end of ffsSetStat */
 
+/*
+ * Per file extent cache: the runs of contiguous clusters found while
+ * following a 0x01 FAT chain, so that mapping an offset again (seeks,
+ * page cache misses, rewrites) doesn't read the chain from the start.
+ */
+void extent_cache_inval(FILE_ID_T *fid)
+{
+	memset(fid->extents, 0, sizeof(fid->extents));
+	fid->extent_next = 0;
+} /* end of extent_cache_inval */
+
+static void extent_cache_add(FILE_ID_T *fid, u32 fofs, u32 clu, u32 len)
+{
+	int i;
+	EXTENT_T *e;
+
+	if (len < 2)
+		return;
+
+	for (i = 0; i < EXTENT_CACHE_SIZE; i++) {
+		e = &fid->extents[i];
+		if (e->len && e->fofs == fofs) {
+			if (len > e->len)
+				e->len = len;
+			return;
+		}
+	}
+
+	e = &fid->extents[fid->extent_next];
+	fid->extent_next = (fid->extent_next + 1) % EXTENT_CACHE_SIZE;
+	e->fofs = fofs;
+	e->clu = clu;
+	e->len = len;
+} /* end of extent_cache_add */
+
+/*
+ * Look up cluster offset 'clu_offset'. Returns TRUE with its cluster if it
+ * is cached, else FALSE with the closest cached cluster before it, if any
+ * (*fofs is left alone otherwise).
+ */
+static s32 extent_cache_get(FILE_ID_T *fid, u32 clu_offset, u32 *fofs,
+			    u32 *clu)
+{
+	int i;
+	EXTENT_T *e, *best = NULL;
+
+	for (i = 0; i < EXTENT_CACHE_SIZE; i++) {
+		e = &fid->extents[i];
+		if (!e->len || e->fofs > clu_offset)
+			continue;
+
+		if (clu_offset < e->fofs + e->len) {
+			*fofs = clu_offset;
+			*clu = e->clu + (clu_offset - e->fofs);
+			return TRUE;
+		}
+
+		if (!best || e->fofs + e->len > best->fofs + best->len)
+			best = e;
+	}
+
+	if (best && best->fofs + best->len - 1 > *fofs) {
+		*fofs = best->fofs + best->len - 1;
+		*clu = best->clu + best->len - 1;
+	}
+	return FALSE;
+} /* end of extent_cache_get */
+
 s32 ffsMapCluster(struct inode *inode, s32 clu_offset, u32 *clu)
 {
 	s32 num_clusters, num_alloced, modified = FALSE;
@@ -1312,19 +1383,34 @@ s32 ffsMapCluster(struct inode *inode, s32 clu_offset, u32 *clu)
 				*clu += clu_offset;
 		}
 	} else {
+		u32 off = 0, run_off, run_clu;
+
 		/* hint information */
 		if ((clu_offset > 0) && (fid->hint_last_off > 0) &&
 			(clu_offset >= fid->hint_last_off)) {
-			clu_offset -= fid->hint_last_off;
+			off = fid->hint_last_off;
 			*clu = fid->hint_last_clu;
 		}
 
-		while ((clu_offset > 0) && (*clu != CLUSTER_32(~0))) {
+		if ((clu_offset > 0) && (*clu != CLUSTER_32(~0)))
+			extent_cache_get(fid, clu_offset, &off, clu);
+
+		run_off = off;
+		run_clu = *clu;
+		while ((off < clu_offset) && (*clu != CLUSTER_32(~0))) {
 			last_clu = *clu;
 			if (FAT_read(sb, *clu, clu) == -1)
 				return FFS_MEDIAERR;
-			clu_offset--;
+			off++;
+
+			if (*clu != last_clu + 1) {
+				extent_cache_add(fid, run_off, run_clu, off - run_off);
+				run_off = off;
+				run_clu = *clu;
+			}
 		}
+		if (*clu != CLUSTER_32(~0))
+			extent_cache_add(fid, run_off, run_clu, off - run_off + 1);
 	}
 
 	if (*clu == CLUSTER_32(~0)) {
@@ -1854,7 +1940,14 @@ s32 exfat_alloc_cluster(struct super_block *sb, s32 num_alloc, CHAIN_T *p_chain)
 
 	hint_clu = p_chain->dir;
 	if (hint_clu == CLUSTER_32(~0)) {
-		hint_clu = test_alloc_bitmap(sb, p_fs->clu_srch_ptr-2);
+		/*
+		 * A new chain starts where it can grow contiguously, so that
+		 * it stays a 0x03 chain and needs no FAT updates.
+		 */
+		hint_clu = find_free_extent(sb, p_fs->clu_srch_ptr-2,
+				max_t(u32, num_alloc, CONTIG_ALLOC_CLUSTERS));
+		if (hint_clu == CLUSTER_32(~0))
+			hint_clu = test_alloc_bitmap(sb, p_fs->clu_srch_ptr-2);
 		if (hint_clu == CLUSTER_32(~0))
 			return 0;
 	} else if (hint_clu >= p_fs->num_clusters) {
@@ -2126,6 +2219,49 @@ void exfat_chain_cont_cluster(struct super_block *sb, u32 chain, s32 len)
  *  Allocation Bitmap Management Functions
  */
 
+/*
+ * Count the free clusters of each bitmap sector, so that searches can skip
+ * full sectors and take free ones as a whole. Without the index (no memory)
+ * the bitmap is simply scanned as before.
+ */
+static void load_alloc_bitmap_index(struct super_block *sb)
+{
+	int i, j, bits;
+	u32 num_clu, used;
+	u8 *data;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+	BD_INFO_T *p_bd = &(EXFAT_SB(sb)->bd_info);
+
+	bits = p_bd->sector_size << 3;
+
+	p_fs->vol_amap_free = kmalloc(sizeof(u16) * p_fs->map_sectors, GFP_KERNEL);
+	if (p_fs->vol_amap_free == NULL)
+		return;
+
+	for (i = 0; i < p_fs->map_sectors; i++) {
+		num_clu = p_fs->num_clusters - 2 - i * bits;
+		if (num_clu > bits)
+			num_clu = bits;
+
+		data = (u8 *) p_fs->vol_amap[i]->b_data;
+		for (used = 0, j = 0; j < (num_clu + 7) >> 3; j++)
+			used += used_bit[data[j]];
+
+		p_fs->vol_amap_free[i] = (used < num_clu) ? (num_clu - used) : 0;
+	}
+} /* end of load_alloc_bitmap_index */
+
+/* clusters covered by bitmap sector 'i' */
+static u32 alloc_bitmap_sector_clusters(struct super_block *sb, int i)
+{
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+	BD_INFO_T *p_bd = &(EXFAT_SB(sb)->bd_info);
+	u32 bits = p_bd->sector_size << 3;
+	u32 num_clu = p_fs->num_clusters - 2 - i * bits;
+
+	return (num_clu > bits) ? bits : num_clu;
+}
+
 s32 load_alloc_bitmap(struct super_block *sb)
 {
 	int i, j, ret;
@@ -2184,6 +2320,8 @@ s32 load_alloc_bitmap(struct super_block *sb)
 					}
 				}
 
+				load_alloc_bitmap_index(sb);
+
 				p_fs->pbr_bh = NULL;
 				return FFS_SUCCESS;
 			}
@@ -2209,6 +2347,9 @@ void free_alloc_bitmap(struct super_block *sb)
 	if (p_fs->vol_amap)
 		kfree(p_fs->vol_amap);
 	p_fs->vol_amap = NULL;
+
+	kfree(p_fs->vol_amap_free);
+	p_fs->vol_amap_free = NULL;
 } /* end of free_alloc_bitmap */
 
 s32 set_alloc_bitmap(struct super_block *sb, u32 clu)
@@ -2223,6 +2364,11 @@ s32 set_alloc_bitmap(struct super_block *sb, u32 clu)
 
 	sector = START_SECTOR(p_fs->map_clu) + i;
 
+	if (p_fs->vol_amap_free &&
+	    !exfat_bitmap_test((u8 *) p_fs->vol_amap[i]->b_data, b) &&
+	    p_fs->vol_amap_free[i])
+		p_fs->vol_amap_free[i]--;
+
 	exfat_bitmap_set((u8 *) p_fs->vol_amap[i]->b_data, b);
 
 	return sector_write(sb, sector, p_fs->vol_amap[i], 0);
@@ -2245,6 +2391,10 @@ s32 clr_alloc_bitmap(struct super_block *sb, u32 clu)
 
 	sector = START_SECTOR(p_fs->map_clu) + i;
 
+	if (p_fs->vol_amap_free &&
+	    exfat_bitmap_test((u8 *) p_fs->vol_amap[i]->b_data, b))
+		p_fs->vol_amap_free[i]++;
+
 	exfat_bitmap_clear((u8 *) p_fs->vol_amap[i]->b_data, b);
 
 	return sector_write(sb, sector, p_fs->vol_amap[i], 0);
@@ -2266,7 +2416,7 @@ s32 clr_alloc_bitmap(struct super_block *sb, u32 clu)
 
 u32 test_alloc_bitmap(struct super_block *sb, u32 clu)
 {
-	int i, map_i, map_b;
+	int i, n, map_i, map_b;
 	u32 clu_base, clu_free;
 	u8 k, clu_mask;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
@@ -2279,6 +2429,16 @@ u32 test_alloc_bitmap(struct super_block *sb, u32 clu)
 	map_b = (clu >> 3) & p_bd->sector_size_mask;
 
 	for (i = 2; i < p_fs->num_clusters; i += 8) {
+		if (p_fs->vol_amap_free && !p_fs->vol_amap_free[map_i]) {
+			/* no free cluster in this bitmap sector, skip it */
+			n = p_bd->sector_size - map_b - 1;
+			i += n << 3;
+			clu_base += n << 3;
+			map_b += n;
+			clu_mask = 0;
+			goto next;
+		}
+
 		k = *(((u8 *) p_fs->vol_amap[map_i]->b_data) + map_b);
 		if (clu_mask > 0) {
 			k |= clu_mask;
@@ -2289,6 +2449,7 @@ u32 test_alloc_bitmap(struct super_block *sb, u32 clu)
 			if (clu_free < p_fs->num_clusters)
 				return clu_free;
 		}
+next:
 		clu_base += 8;
 
 		if (((++map_b) >= p_bd->sector_size) || (clu_base >= p_fs->num_clusters)) {
@@ -2303,6 +2464,70 @@ u32 test_alloc_bitmap(struct super_block *sb, u32 clu)
 	return CLUSTER_32(~0);
 } /* end of test_alloc_bitmap */
 
+/*
+ * Find a run of at least 'want' free clusters, searching one round of the
+ * bitmap from 'clu' (bitmap index, i.e. cluster - 2) on. Returns the first
+ * cluster of the run, or CLUSTER_32(~0) if there is none.
+ */
+u32 find_free_extent(struct super_block *sb, u32 clu, u32 want)
+{
+	u32 total, scanned = 0, run = 0, start = 0, bits, num_clu;
+	int map_i;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+	BD_INFO_T *p_bd = &(EXFAT_SB(sb)->bd_info);
+
+	if (p_fs->vol_amap_free == NULL || want == 0)
+		return CLUSTER_32(~0);
+
+	total = p_fs->num_clusters - 2;
+	bits = p_bd->sector_size << 3;
+	if (clu >= total)
+		clu = 0;
+
+	while (scanned < total) {
+		if (clu >= total) {
+			/* wrapped, a run doesn't go on from the end */
+			clu = 0;
+			run = 0;
+		}
+
+		map_i = clu >> (p_bd->sector_size_bits + 3);
+		num_clu = alloc_bitmap_sector_clusters(sb, map_i);
+
+		if ((clu & (bits - 1)) == 0 &&
+		    p_fs->vol_amap_free[map_i] == num_clu) {
+			/* whole sector free */
+			if (run == 0)
+				start = clu;
+			run += num_clu;
+			clu += num_clu;
+			scanned += num_clu;
+		} else if ((clu & (bits - 1)) == 0 &&
+			   p_fs->vol_amap_free[map_i] == 0) {
+			/* whole sector used */
+			run = 0;
+			clu += num_clu;
+			scanned += num_clu;
+		} else {
+			if (exfat_bitmap_test((u8 *) p_fs->vol_amap[map_i]->b_data,
+					      clu & (bits - 1))) {
+				run = 0;
+			} else {
+				if (run == 0)
+					start = clu;
+				run++;
+			}
+			clu++;
+			scanned++;
+		}
+
+		if (run >= want)
+			return start + 2;
+	}
+
+	return CLUSTER_32(~0);
+} /* end of find_free_extent */
+
 void sync_alloc_bitmap(struct super_block *sb)
 {
 	int i;
@@ -4770,6 +4995,7 @@ s32 create_dir(struct inode *inode, CHAIN_T *p_dir, UNI_NAME_T *p_uniname, FILE_
 	fid->type = TYPE_DIR;
 	fid->rwoffset = 0;
 	fid->hint_last_off = -1;
+	extent_cache_inval(fid);
 
 	return FFS_SUCCESS;
 } /* end of create_dir */
@@ -4814,6 +5040,7 @@ s32 create_file(struct inode *inode, CHAIN_T *p_dir, UNI_NAME_T *p_uniname, u8 m
 	fid->type = TYPE_FILE;
 	fid->rwoffset = 0;
 	fid->hint_last_off = -1;
+	extent_cache_inval(fid);
 
 	return FFS_SUCCESS;
 } /* end of create_file */
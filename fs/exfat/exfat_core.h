@@ -117,6 +117,9 @@
 #define CS_PBR_SECTOR           1
 #define CS_DEFAULT              2
 
+/* a new cluster chain starts at a free run of at least this many clusters */
+#define CONTIG_ALLOC_CLUSTERS   32
+
 #define CLUSTER_16(x)           ((u16)(x))
 #define CLUSTER_32(x)           ((u32)(x))
 
@@ -473,6 +476,7 @@ typedef struct __FS_INFO_T {
 	u32      map_clu;                /* allocation bitmap start cluster */
 	u32      map_sectors;            /* num of allocation bitmap sectors */
 	struct buffer_head **vol_amap;      /* allocation bitmap */
+	u16      *vol_amap_free;         /* free clusters per bitmap sector */
 
 	u16      **vol_utbl;               /* upcase table */
 
@@ -565,6 +569,7 @@ s32  count_num_clusters(struct super_block *sb, CHAIN_T *dir);
 s32  fat_count_used_clusters(struct super_block *sb);
 s32  exfat_count_used_clusters(struct super_block *sb);
 void   exfat_chain_cont_cluster(struct super_block *sb, u32 chain, s32 len);
+void   extent_cache_inval(FILE_ID_T *fid);
 
 /* allocation bitmap management functions */
 s32  load_alloc_bitmap(struct super_block *sb);
@@ -572,6 +577,7 @@ void   free_alloc_bitmap(struct super_block *sb);
 s32   set_alloc_bitmap(struct super_block *sb, u32 clu);
 s32   clr_alloc_bitmap(struct super_block *sb, u32 clu);
 u32 test_alloc_bitmap(struct super_block *sb, u32 clu);
+u32 find_free_extent(struct super_block *sb, u32 clu, u32 want);
 void   sync_alloc_bitmap(struct super_block *sb);
 
 /* upcase table management functions */
@@ -559,6 +559,8 @@ enum {
 #define EXT4_GET_BLOCKS_NO_LOCK			0x0100
 	/* Convert written extents to unwritten */
 #define EXT4_GET_BLOCKS_CONVERT_UNWRITTEN	0x0200
+	/* Try to allocate right after the previous extent first */
+#define EXT4_GET_BLOCKS_CONTIG			0x0400
 
 /*
  * The bit position of these flags must not overlap with any of the
@@ -1367,6 +1369,9 @@ struct ext4_sb_info {
 	/* the size of zero-out chunk */
 	unsigned int s_extent_max_zeroout_kb;
 
+	/* delalloc writeback: extent size to accumulate before mapping */
+	unsigned int s_da_wb_batch_kb;
+
 	unsigned int s_log_groups_per_flex;
 	struct flex_groups *s_flex_groups;
 	ext4_group_t s_flex_groups_allocated;
@@ -27,6 +27,7 @@
 #include <linux/sched.h>
 #include <linux/writeback.h>
 #include <linux/blkdev.h>
+#include <linux/task_io_accounting_ops.h>
 
 #include "ext4.h"
 #include "ext4_jbd2.h"
@@ -90,7 +91,8 @@ static int ext4_sync_parent(struct inode *inode)
  * inode to disk.
  */
 
-int ext4_sync_file(struct file *file, loff_t start, loff_t end, int datasync)
+static int __ext4_sync_file(struct file *file, loff_t start, loff_t end,
+			    int datasync)
 {
 	struct inode *inode = file->f_mapping->host;
 	struct ext4_inode_info *ei = EXT4_I(inode);
@@ -164,3 +166,14 @@ out:
 
     return ret;
 }
+
+int ext4_sync_file(struct file *file, loff_t start, loff_t end, int datasync)
+{
+	u64 start_ns = ktime_get_ns();
+	int ret;
+
+	ret = __ext4_sync_file(file, start, end, datasync);
+	task_io_account_fsync_wait(ktime_get_ns() - start_ns);
+
+	return ret;
+}
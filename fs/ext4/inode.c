@@ -1939,6 +1939,21 @@ static int mpage_submit_page(struct mpage_da_data *mpd, struct page *page)
  */
 #define MAX_WRITEPAGES_EXTENT_LEN 2048
 
+/*
+ * Number of pages background writeback of a delalloc inode keeps adding to
+ * the extent it is building even once nr_to_write is used up, so that the
+ * extent gets mapped and submitted as one large piece instead of being cut
+ * at the writeback chunk boundary. 0 when batching is off (da_wb_batch_kb).
+ */
+static pgoff_t ext4_da_wb_batch_pages(struct mpage_da_data *mpd)
+{
+	unsigned int kb = EXT4_SB(mpd->inode->i_sb)->s_da_wb_batch_kb;
+
+	if (mpd->wbc->sync_mode != WB_SYNC_NONE)
+		return 0;
+	return kb >> (PAGE_CACHE_SHIFT - 10);
+}
+
 /*
  * mpage_add_bh_to_extent - try to add bh to extent of blocks to map
  *
@@ -2162,6 +2177,9 @@ static int mpage_map_one_extent(handle_t *handle, struct mpage_da_data *mpd)
 		get_blocks_flags |= EXT4_GET_BLOCKS_IO_CREATE_EXT;
 	if (map->m_flags & (1 << BH_Delay))
 		get_blocks_flags |= EXT4_GET_BLOCKS_DELALLOC_RESERVE;
+	/* a batched extent is worth placing right after the previous one */
+	if (ext4_da_wb_batch_pages(mpd))
+		get_blocks_flags |= EXT4_GET_BLOCKS_CONTIG;
 
 	err = ext4_map_blocks(handle, inode, map, get_blocks_flags);
 	if (err < 0)
@@ -2336,6 +2354,7 @@ static int mpage_prepare_extent_to_map(struct mpage_da_data *mpd)
 	int blkbits = mpd->inode->i_blkbits;
 	ext4_lblk_t lblk;
 	struct buffer_head *head;
+	pgoff_t batch = ext4_da_wb_batch_pages(mpd);
 
 	if (mpd->wbc->sync_mode == WB_SYNC_ALL || mpd->wbc->tagged_writepages)
 		tag = PAGECACHE_TAG_TOWRITE;
@@ -2371,8 +2390,14 @@ static int mpage_prepare_extent_to_map(struct mpage_da_data *mpd)
 			 * dirtying pages, and we might have synced a lot of
 			 * newly appeared dirty pages, but have not synced all
 			 * of the old dirty pages.
+			 *
+			 * With batching, an extent being built is still grown
+			 * up to the batch size, the excess is taken from the
+			 * next writeback chunk anyway.
 			 */
-			if (mpd->wbc->sync_mode == WB_SYNC_NONE && left <= 0)
+			if (mpd->wbc->sync_mode == WB_SYNC_NONE && left <= 0 &&
+			    (!mpd->map.m_len ||
+			     mpd->next_page - mpd->first_page >= batch))
 				goto out;
 
 			/* If we can't merge this page, we are done. */
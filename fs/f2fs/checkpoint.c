@@ -883,6 +883,28 @@ retry:
 	goto retry;
 }
 
+/*
+ * Write back the node pages that are dirty right now while FS-operations
+ * still run, in one plugged pass, so block_operations() only has to flush
+ * what got dirtied meanwhile with cp_rwsem held.
+ */
+static void preflush_node_pages(struct f2fs_sb_info *sbi)
+{
+	struct writeback_control wbc = {
+		.sync_mode = WB_SYNC_NONE,
+		.nr_to_write = get_pages(sbi, F2FS_DIRTY_NODES),
+		.for_reclaim = 0,
+	};
+	struct blk_plug plug;
+
+	if (wbc.nr_to_write <= 0)
+		return;
+
+	blk_start_plug(&plug);
+	sync_node_pages(sbi, &wbc);
+	blk_finish_plug(&plug);
+}
+
 /*
  * Freeze all the FS-operations for checkpoint.
  */
@@ -1194,9 +1216,11 @@ int write_checkpoint(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 {
 	struct f2fs_checkpoint *ckpt = F2FS_CKPT(sbi);
 	unsigned long long ckpt_ver;
+	ktime_t start;
 	int err = 0;
 
 	mutex_lock(&sbi->cp_mutex);
+	start = ktime_get();
 
 	if (!is_sbi_flag_set(sbi, SBI_IS_DIRTY) &&
 		(cpc->reason == CP_FASTBOOT || cpc->reason == CP_SYNC ||
@@ -1211,6 +1235,10 @@ int write_checkpoint(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 		goto out;
 	}
 
+	if (sbi->cp_preflush && cpc->reason != CP_UMOUNT &&
+	    cpc->reason != CP_RECOVERY)
+		preflush_node_pages(sbi);
+
 	trace_f2fs_write_checkpoint(sbi->sb, cpc->reason, "start block_ops");
 
 	err = block_operations(sbi);
@@ -1251,6 +1279,8 @@ int write_checkpoint(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 
 	unblock_operations(sbi);
 	stat_inc_cp_count(sbi->stat_info);
+	stat_update_cp_time(sbi->stat_info,
+			(unsigned int)ktime_us_delta(ktime_get(), start));
 
 	if (cpc->reason == CP_RECOVERY)
 		f2fs_msg(sbi->sb, KERN_NOTICE,
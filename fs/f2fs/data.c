@@ -685,6 +685,23 @@ ssize_t f2fs_preallocate_blocks(struct kiocb *iocb, struct iov_iter *from)
 	return ret;
 }
 
+/*
+ * Cache the part of @map that was read from @dn while the node page is
+ * still locked, so that a concurrent write or gc moving those blocks
+ * cannot leave a stale extent behind.
+ */
+static void f2fs_precache_dnode(struct dnode_of_data *dn,
+			struct f2fs_map_blocks *map, pgoff_t start_pgofs)
+{
+	unsigned int ofs = start_pgofs - map->m_lblk;
+
+	if (!(map->m_flags & F2FS_MAP_MAPPED) || ofs >= map->m_len)
+		return;
+
+	f2fs_update_extent_cache_range(dn, start_pgofs,
+				map->m_pblk + ofs, map->m_len - ofs);
+}
+
 /*
  * f2fs_map_blocks() now supported readahead/bmap/rw direct_IO with
  * f2fs_map_blocks structure.
@@ -701,7 +718,7 @@ int f2fs_map_blocks(struct inode *inode, struct f2fs_map_blocks *map,
 	struct dnode_of_data dn;
 	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
 	int mode = create ? ALLOC_NODE : LOOKUP_NODE_RA;
-	pgoff_t pgofs, end_offset;
+	pgoff_t pgofs, end_offset, start_pgofs;
 	int err = 0, ofs = 1;
 	struct extent_info ei;
 	bool allocated = false;
@@ -719,7 +736,8 @@ int f2fs_map_blocks(struct inode *inode, struct f2fs_map_blocks *map,
 	/* it only supports block size == page size */
 	pgofs =	(pgoff_t)map->m_lblk;
 
-	if (!create && f2fs_lookup_extent_cache(inode, pgofs, &ei)) {
+	if (!create && flag != F2FS_GET_BLOCK_PRECACHE &&
+			f2fs_lookup_extent_cache(inode, pgofs, &ei)) {
 		map->m_pblk = ei.blk + pgofs - ei.fofs;
 		map->m_len = min((pgoff_t)maxblocks, ei.fofs + ei.len - pgofs);
 		map->m_flags = F2FS_MAP_MAPPED;
@@ -733,6 +751,7 @@ next_dnode:
 	/* When reading holes, we need its node page */
 	set_new_dnode(&dn, inode, NULL, NULL, 0);
 	err = get_dnode_of_data(&dn, pgofs, mode);
+	start_pgofs = pgofs;
 	if (err) {
 		if (err == -ENOENT) {
 			err = 0;
@@ -769,7 +788,8 @@ next_block:
 			map->m_flags = F2FS_MAP_NEW;
 			blkaddr = dn.data_blkaddr;
 		} else {
-			if (flag == F2FS_GET_BLOCK_FIEMAP &&
+			if ((flag == F2FS_GET_BLOCK_FIEMAP ||
+					flag == F2FS_GET_BLOCK_PRECACHE) &&
 						blkaddr == NULL_ADDR) {
 				if (map->m_next_pgofs)
 					*map->m_next_pgofs = pgofs + 1;
@@ -811,6 +831,8 @@ next_block:
 
 		if (allocated)
 			sync_inode_page(&dn);
+		if (flag == F2FS_GET_BLOCK_PRECACHE)
+			f2fs_precache_dnode(&dn, map, start_pgofs);
 		f2fs_put_dnode(&dn);
 
 		if (create) {
@@ -824,6 +846,8 @@ next_block:
 sync_out:
 	if (allocated)
 		sync_inode_page(&dn);
+	if (flag == F2FS_GET_BLOCK_PRECACHE)
+		f2fs_precache_dnode(&dn, map, start_pgofs);
 	f2fs_put_dnode(&dn);
 unlock_out:
 	if (create) {
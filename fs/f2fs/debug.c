@@ -17,6 +17,8 @@
 #include <linux/blkdev.h>
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
+#include <linux/relay.h>
+#include <linux/workqueue.h>
 
 #include "f2fs.h"
 #include "node.h"
@@ -38,6 +40,19 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 	si->hit_rbtree = atomic64_read(&sbi->read_hit_rbtree);
 	si->hit_total = si->hit_largest + si->hit_cached + si->hit_rbtree;
 	si->total_ext = atomic64_read(&sbi->total_hit_ext);
+	si->precache_files = atomic64_read(&sbi->precache_files);
+	si->precache_exts = atomic64_read(&sbi->precache_exts);
+	si->dir_index_hit = atomic64_read(&sbi->dir_index_hit);
+	si->dir_index = atomic_read(&sbi->total_dir_index);
+	si->dir_index_ent = atomic_read(&sbi->total_dir_index_ent);
+	si->atomic_commit = atomic64_read(&sbi->atomic_commit);
+	si->atomic_commit_fua = atomic64_read(&sbi->atomic_commit_fua);
+	si->atomic_commit_cp = atomic64_read(&sbi->atomic_commit_cp);
+	si->atomic_commit_us = atomic64_read(&sbi->atomic_commit_us);
+	si->atomic_commit_max_us = atomic64_read(&sbi->atomic_commit_max_us);
+	si->fg_gc_stall = atomic64_read(&sbi->fg_gc_stall);
+	si->fg_gc_stall_us = atomic64_read(&sbi->fg_gc_stall_us);
+	si->fg_gc_stall_max_us = atomic64_read(&sbi->fg_gc_stall_max_us);
 	si->ext_tree = atomic_read(&sbi->total_ext_tree);
 	si->zombie_tree = atomic_read(&sbi->total_zombie_tree);
 	si->ext_node = atomic_read(&sbi->total_ext_node);
@@ -272,8 +287,21 @@ static int stat_show(struct seq_file *s, void *v)
 			   si->prefree_count, si->free_segs, si->free_secs);
 		seq_printf(s, "CP calls: %d (BG: %d)\n",
 				si->cp_count, si->bg_cp_count);
+		seq_printf(s, "  - time: last: %u us, avg: %llu us, max: %u us\n",
+				si->cp_last_us, !si->cp_count ? 0 :
+				div64_u64(si->cp_total_us, si->cp_count),
+				si->cp_max_us);
 		seq_printf(s, "GC calls: %d (BG: %d)\n",
 			   si->call_count, si->bg_gc);
+		seq_printf(s, "  - victims : %llu (avg valid blocks: %llu)\n",
+				si->victim_count, !si->victim_count ? 0 :
+				div64_u64(si->victim_vblocks,
+						si->victim_count));
+		seq_printf(s, "  - FG GC stalls : %llu (avg: %llu us, max: %llu us)\n",
+				si->fg_gc_stall, !si->fg_gc_stall ? 0 :
+				div64_u64(si->fg_gc_stall_us,
+						si->fg_gc_stall),
+				si->fg_gc_stall_max_us);
 		seq_printf(s, "  - data segments : %d (%d)\n",
 				si->data_segs, si->bg_data_segs);
 		seq_printf(s, "  - node segments : %d (%d)\n",
@@ -292,8 +320,25 @@ static int stat_show(struct seq_file *s, void *v)
 				!si->total_ext ? 0 :
 				div64_u64(si->hit_total * 100, si->total_ext),
 				si->hit_total, si->total_ext);
+		seq_printf(s, "  - Miss Count: %llu\n",
+				si->total_ext - si->hit_total);
+		seq_printf(s, "  - Precache: files: %llu, extents: %llu\n",
+				si->precache_files, si->precache_exts);
 		seq_printf(s, "  - Inner Struct Count: tree: %d(%d), node: %d\n",
 				si->ext_tree, si->zombie_tree, si->ext_node);
+		seq_puts(s, "\nDir Name Index:\n");
+		seq_printf(s, "  - dirs: %d, entries: %d, lookups: %llu\n",
+				si->dir_index, si->dir_index_ent,
+				si->dir_index_hit);
+		seq_puts(s, "\nAtomic Write Commit:\n");
+		seq_printf(s, "  - Count: %llu (FUA: %llu, CP: %llu)\n",
+				si->atomic_commit, si->atomic_commit_fua,
+				si->atomic_commit_cp);
+		seq_printf(s, "  - Latency: avg: %llu us, max: %llu us\n",
+				!si->atomic_commit ? 0 :
+				div64_u64(si->atomic_commit_us,
+						si->atomic_commit),
+				si->atomic_commit_max_us);
 		seq_puts(s, "\nBalancing F2FS Async:\n");
 		seq_printf(s, "  - inmem: %4d, wb: %4d\n",
 			   si->inmem_pages, si->wb_pages);
@@ -362,6 +407,163 @@ static const struct file_operations stat_fops = {
 	.release = single_release,
 };
 
+void stat_update_atomic_commit(struct f2fs_sb_info *sbi, s64 us)
+{
+	s64 max;
+
+	atomic64_inc(&sbi->atomic_commit);
+	atomic64_add(us, &sbi->atomic_commit_us);
+
+	do {
+		max = atomic64_read(&sbi->atomic_commit_max_us);
+		if (us <= max)
+			return;
+	} while (atomic64_cmpxchg(&sbi->atomic_commit_max_us, max, us) != max);
+}
+
+void stat_update_fg_gc_stall(struct f2fs_sb_info *sbi, s64 us)
+{
+	s64 max;
+
+	atomic64_inc(&sbi->fg_gc_stall);
+	atomic64_add(us, &sbi->fg_gc_stall_us);
+
+	do {
+		max = atomic64_read(&sbi->fg_gc_stall_max_us);
+		if (us <= max)
+			return;
+	} while (atomic64_cmpxchg(&sbi->fg_gc_stall_max_us, max, us) != max);
+}
+
+#ifdef CONFIG_F2FS_STAT_STREAM
+#define STAT_STREAM_SUBBUF_RECS		64
+#define STAT_STREAM_NR_SUBBUFS		8
+#define DEF_STAT_STREAM_INTERVAL	1000	/* ms */
+
+static struct dentry *stream_create_buf_file(const char *filename,
+						struct dentry *parent,
+						umode_t mode,
+						struct rchan_buf *buf,
+						int *is_global)
+{
+	/* records are written by one work item, one buffer is enough */
+	*is_global = 1;
+	return debugfs_create_file(filename, mode, parent, buf,
+					&relay_file_operations);
+}
+
+static int stream_remove_buf_file(struct dentry *dentry)
+{
+	debugfs_remove(dentry);
+	return 0;
+}
+
+static struct rchan_callbacks stream_relay_callbacks = {
+	.create_buf_file	= stream_create_buf_file,
+	.remove_buf_file	= stream_remove_buf_file,
+};
+
+static void stat_stream_fill(struct f2fs_sb_info *sbi,
+				struct f2fs_stat_stream_rec *rec)
+{
+	struct f2fs_stat_info *si = F2FS_STAT(sbi);
+
+	memset(rec, 0, sizeof(*rec));
+	rec->magic = F2FS_STAT_STREAM_MAGIC;
+	rec->version = F2FS_STAT_STREAM_VERSION;
+	rec->rec_size = sizeof(*rec);
+	rec->dev = new_encode_dev(sbi->sb->s_dev);
+	rec->seq = si->stream_seq++;
+	rec->ts_ns = ktime_get_ns();
+
+	rec->gc_calls = si->call_count;
+	rec->bg_gc_calls = sbi->bg_gc;
+	rec->gc_victims = si->victim_count;
+	rec->gc_victim_vblocks = si->victim_vblocks;
+
+	rec->cp_count = si->cp_count;
+	rec->cp_total_us = si->cp_total_us;
+	rec->cp_last_us = si->cp_last_us;
+	rec->cp_max_us = si->cp_max_us;
+
+	rec->fg_gc_stalls = atomic64_read(&sbi->fg_gc_stall);
+	rec->fg_gc_stall_us = atomic64_read(&sbi->fg_gc_stall_us);
+	rec->fg_gc_stall_max_us = atomic64_read(&sbi->fg_gc_stall_max_us);
+
+	rec->free_secs = free_sections(sbi);
+	rec->reserved_secs = reserved_sections(sbi);
+	rec->prefree_segs = prefree_segments(sbi);
+	rec->dirty_segs = dirty_segments(sbi);
+	rec->main_secs = MAIN_SECS(sbi);
+}
+
+static void stat_stream_work(struct work_struct *work)
+{
+	struct f2fs_stat_info *si = container_of(to_delayed_work(work),
+					struct f2fs_stat_info, stream_work);
+	struct f2fs_sb_info *sbi = si->sbi;
+	unsigned int interval = ACCESS_ONCE(sbi->stat_stream_interval_ms);
+	struct f2fs_stat_stream_rec rec;
+
+	/* a stopped stream still polls the knob to notice a restart */
+	if (interval) {
+		stat_stream_fill(sbi, &rec);
+		relay_write(si->stream_chan, &rec, sizeof(rec));
+	} else {
+		interval = DEF_STAT_STREAM_INTERVAL;
+	}
+
+	schedule_delayed_work(&si->stream_work, msecs_to_jiffies(interval));
+}
+
+static void stat_stream_start(struct f2fs_sb_info *sbi)
+{
+	struct f2fs_stat_info *si = F2FS_STAT(sbi);
+
+	sbi->stat_stream_interval_ms = DEF_STAT_STREAM_INTERVAL;
+	INIT_DELAYED_WORK(&si->stream_work, stat_stream_work);
+
+	if (!f2fs_debugfs_root)
+		return;
+
+	si->stream_dir = debugfs_create_dir(sbi->sb->s_id, f2fs_debugfs_root);
+	if (IS_ERR_OR_NULL(si->stream_dir)) {
+		si->stream_dir = NULL;
+		return;
+	}
+
+	si->stream_chan = relay_open("stream", si->stream_dir,
+			sizeof(struct f2fs_stat_stream_rec) *
+			STAT_STREAM_SUBBUF_RECS, STAT_STREAM_NR_SUBBUFS,
+			&stream_relay_callbacks, NULL);
+	if (!si->stream_chan) {
+		f2fs_msg(sbi->sb, KERN_WARNING,
+				"failed to open the statistics stream");
+		debugfs_remove(si->stream_dir);
+		si->stream_dir = NULL;
+		return;
+	}
+
+	schedule_delayed_work(&si->stream_work,
+			msecs_to_jiffies(sbi->stat_stream_interval_ms));
+}
+
+static void stat_stream_stop(struct f2fs_sb_info *sbi)
+{
+	struct f2fs_stat_info *si = F2FS_STAT(sbi);
+
+	if (!si->stream_chan)
+		return;
+
+	cancel_delayed_work_sync(&si->stream_work);
+	relay_close(si->stream_chan);
+	debugfs_remove(si->stream_dir);
+}
+#else
+static inline void stat_stream_start(struct f2fs_sb_info *sbi) { }
+static inline void stat_stream_stop(struct f2fs_sb_info *sbi) { }
+#endif
+
 int f2fs_build_stats(struct f2fs_sb_info *sbi)
 {
 	struct f2fs_super_block *raw_super = F2FS_RAW_SUPER(sbi);
@@ -386,6 +588,17 @@ int f2fs_build_stats(struct f2fs_sb_info *sbi)
 	atomic64_set(&sbi->read_hit_rbtree, 0);
 	atomic64_set(&sbi->read_hit_largest, 0);
 	atomic64_set(&sbi->read_hit_cached, 0);
+	atomic64_set(&sbi->precache_files, 0);
+	atomic64_set(&sbi->precache_exts, 0);
+	atomic64_set(&sbi->dir_index_hit, 0);
+	atomic64_set(&sbi->atomic_commit, 0);
+	atomic64_set(&sbi->atomic_commit_fua, 0);
+	atomic64_set(&sbi->atomic_commit_cp, 0);
+	atomic64_set(&sbi->atomic_commit_us, 0);
+	atomic64_set(&sbi->atomic_commit_max_us, 0);
+	atomic64_set(&sbi->fg_gc_stall, 0);
+	atomic64_set(&sbi->fg_gc_stall_us, 0);
+	atomic64_set(&sbi->fg_gc_stall_max_us, 0);
 
 	atomic_set(&sbi->inline_xattr, 0);
 	atomic_set(&sbi->inline_inode, 0);
@@ -396,6 +609,8 @@ int f2fs_build_stats(struct f2fs_sb_info *sbi)
 	list_add_tail(&si->stat_list, &f2fs_stat_list);
 	mutex_unlock(&f2fs_stat_mutex);
 
+	stat_stream_start(sbi);
+
 	return 0;
 }
 
@@ -403,6 +618,8 @@ void f2fs_destroy_stats(struct f2fs_sb_info *sbi)
 {
 	struct f2fs_stat_info *si = F2FS_STAT(sbi);
 
+	stat_stream_stop(sbi);
+
 	mutex_lock(&f2fs_stat_mutex);
 	list_del(&si->stat_list);
 	mutex_unlock(&f2fs_stat_mutex);
@@ -269,6 +269,39 @@ static struct f2fs_dir_entry *find_in_level(struct inode *dir,
 	return de;
 }
 
+/* only check the dentry blocks the name index of @dir points at */
+static struct f2fs_dir_entry *find_in_dir_index(struct inode *dir,
+					struct fscrypt_name *fname,
+					unsigned long npages,
+					struct page **res_page,
+					bool *indexed)
+{
+	struct qstr name = FSTR_TO_QSTR(&fname->disk_name);
+	unsigned long bidx[DIR_INDEX_MAX_BLOCKS];
+	struct f2fs_dir_entry *de = NULL;
+	struct page *dentry_page;
+	f2fs_hash_t namehash;
+	int nr, i;
+
+	namehash = f2fs_dentry_hash(&name);
+	nr = f2fs_dir_index_lookup(dir, namehash, npages, bidx,
+						DIR_INDEX_MAX_BLOCKS);
+	*indexed = nr >= 0;
+
+	for (i = 0; i < nr; i++) {
+		dentry_page = find_data_page(dir, bidx[i]);
+		if (IS_ERR(dentry_page))
+			continue;
+
+		de = find_in_block(dir, dentry_page, fname, namehash, NULL,
+							res_page, NULL);
+		if (de)
+			break;
+		f2fs_put_page(dentry_page, 0);
+	}
+	return de;
+}
+
 struct f2fs_dir_entry *__f2fs_find_entry(struct inode *dir,
 			struct fscrypt_name *fname, struct page **res_page,
 			struct fscrypt_str *fstr)
@@ -277,6 +310,7 @@ struct f2fs_dir_entry *__f2fs_find_entry(struct inode *dir,
 	struct f2fs_dir_entry *de = NULL;
 	unsigned int max_depth;
 	unsigned int level;
+	bool indexed;
 
 	*res_page = NULL;
 
@@ -288,6 +322,12 @@ struct f2fs_dir_entry *__f2fs_find_entry(struct inode *dir,
 	if (npages == 0)
 		goto out;
 
+	if (!fstr && !fname->hash) {
+		de = find_in_dir_index(dir, fname, npages, res_page, &indexed);
+		if (indexed)
+			goto out;
+	}
+
 	max_depth = F2FS_I(dir)->i_current_depth;
 	if (unlikely(max_depth > MAX_DIR_HASH_DEPTH)) {
 		f2fs_msg(F2FS_I_SB(dir)->sb, KERN_WARNING,
@@ -680,6 +720,7 @@ add_dentry:
 
 	make_dentry_ptr(NULL, &d, (void *)dentry_blk, 1);
 	f2fs_update_dentry(ino, mode, &d, &new_name, dentry_hash, bit_pos);
+	f2fs_dir_index_add(dir, dentry_hash, block);
 
 	set_page_dirty(dentry_page);
 
@@ -798,6 +839,8 @@ void f2fs_delete_entry(struct f2fs_dir_entry *dentry, struct page *page,
 	lock_page(page);
 	f2fs_wait_on_page_writeback(page, DATA, true);
 
+	f2fs_dir_index_del(dir, dentry->hash_code, page->index);
+
 	dentry_blk = page_address(page);
 	bit_pos = dentry - dentry_blk->dentry;
 	for (i = 0; i < slots; i++)
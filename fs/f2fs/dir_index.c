@@ -0,0 +1,341 @@
+/*
+ * fs/f2fs/dir_index.c
+ *
+ * In-memory name hash index of large directories.
+ *
+ * A lookup in a big directory scans one bucket per hash level and
+ * compares every dentry in it, and a miss has to do that for all the
+ * levels. The index maps each f2fs dentry hash of the directory to the
+ * dentry blocks holding it, so a lookup only reads the blocks that can
+ * actually match and a miss reads none.
+ *
+ * The index is built on the first lookup of a directory with at least
+ * dir_index_min_blocks blocks, kept up to date by add/delete entry, and
+ * dropped on eviction or by the shrinker, least recently used first.
+ * Case-insensitive and encrypted-without-key lookups do not use it.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/fs.h>
+#include <linux/f2fs_fs.h>
+#include <linux/hash.h>
+
+#include "f2fs.h"
+
+static struct kmem_cache *dir_index_entry_slab;
+
+struct dir_index_entry {
+	struct hlist_node node;
+	f2fs_hash_t hash;
+	u32 bidx;
+};
+
+struct f2fs_dir_index {
+	struct list_head list;		/* lru list of the indexed dirs */
+	struct inode *inode;
+	unsigned int nr_entries;
+	unsigned int bits;
+	struct hlist_head buckets[0];
+};
+
+#define DIR_INDEX_MIN_BITS	6
+#define DIR_INDEX_MAX_BITS	16
+
+static inline struct hlist_head *__index_bucket(struct f2fs_dir_index *idx,
+						f2fs_hash_t hash)
+{
+	return &idx->buckets[hash_32(le32_to_cpu(hash), idx->bits)];
+}
+
+static void __insert_entry(struct f2fs_dir_index *idx,
+				struct dir_index_entry *e,
+				f2fs_hash_t hash, unsigned long bidx)
+{
+	e->hash = hash;
+	e->bidx = (u32)bidx;
+	hlist_add_head(&e->node, __index_bucket(idx, hash));
+	idx->nr_entries++;
+}
+
+static void __free_dir_index(struct f2fs_dir_index *idx)
+{
+	struct dir_index_entry *e;
+	struct hlist_node *tmp;
+	unsigned int i;
+
+	for (i = 0; i < (1U << idx->bits); i++)
+		hlist_for_each_entry_safe(e, tmp, &idx->buckets[i], node)
+			kmem_cache_free(dir_index_entry_slab, e);
+	kvfree(idx);
+}
+
+/* should be called with dir_index_lock held, the caller frees @idx */
+static void __detach_dir_index(struct f2fs_sb_info *sbi,
+				struct f2fs_dir_index *idx)
+{
+	F2FS_I(idx->inode)->dir_index = NULL;
+	list_del(&idx->list);
+	atomic_sub(idx->nr_entries, &sbi->total_dir_index_ent);
+	atomic_dec(&sbi->total_dir_index);
+}
+
+static struct f2fs_dir_index *__build_dir_index(struct inode *dir,
+						unsigned long nblock)
+{
+	struct f2fs_dir_index *idx;
+	struct f2fs_dentry_block *dentry_blk;
+	struct dir_index_entry *e;
+	struct page *dentry_page;
+	unsigned long bidx;
+	unsigned int bits, bit_pos;
+
+	bits = clamp_t(unsigned int, ilog2(nblock) + 4,
+				DIR_INDEX_MIN_BITS, DIR_INDEX_MAX_BITS);
+	idx = f2fs_kvzalloc(sizeof(struct f2fs_dir_index) +
+			(sizeof(struct hlist_head) << bits), GFP_NOFS);
+	if (!idx)
+		return NULL;
+
+	INIT_LIST_HEAD(&idx->list);
+	idx->inode = dir;
+	idx->bits = bits;
+
+	for (bidx = 0; bidx < nblock; bidx++) {
+		dentry_page = find_data_page(dir, bidx);
+		if (IS_ERR(dentry_page)) {
+			if (PTR_ERR(dentry_page) == -ENOENT)
+				continue;
+			goto fail;
+		}
+
+		dentry_blk = kmap(dentry_page);
+		bit_pos = 0;
+		while (1) {
+			struct f2fs_dir_entry *de;
+
+			bit_pos = find_next_bit_le(&dentry_blk->dentry_bitmap,
+						NR_DENTRY_IN_BLOCK, bit_pos);
+			if (bit_pos >= NR_DENTRY_IN_BLOCK)
+				break;
+
+			de = &dentry_blk->dentry[bit_pos];
+			if (unlikely(!de->name_len)) {
+				bit_pos++;
+				continue;
+			}
+
+			e = kmem_cache_alloc(dir_index_entry_slab, GFP_NOFS);
+			if (!e) {
+				kunmap(dentry_page);
+				f2fs_put_page(dentry_page, 0);
+				goto fail;
+			}
+			__insert_entry(idx, e, de->hash_code, bidx);
+
+			bit_pos += GET_DENTRY_SLOTS(le16_to_cpu(de->name_len));
+		}
+		kunmap(dentry_page);
+		f2fs_put_page(dentry_page, 0);
+	}
+	return idx;
+fail:
+	__free_dir_index(idx);
+	return NULL;
+}
+
+/*
+ * Fill @bidx with the dentry blocks of @dir (@nblock blocks long) that
+ * hold an entry hashed to @hash. Returns their number, 0 meaning the
+ * name is not in @dir, or a negative errno if the index can not answer
+ * and the levels have to be walked.
+ */
+int f2fs_dir_index_lookup(struct inode *dir, f2fs_hash_t hash,
+			unsigned long nblock, unsigned long *bidx, int max)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(dir);
+	struct f2fs_inode_info *fi = F2FS_I(dir);
+	struct f2fs_dir_index *idx, *new = NULL;
+	struct dir_index_entry *e;
+	unsigned int seq;
+	int nr = 0, i;
+
+	if (!sbi->dir_index_min_blocks || nblock < sbi->dir_index_min_blocks)
+		return -ENOENT;
+
+	spin_lock(&sbi->dir_index_lock);
+	idx = fi->dir_index;
+	if (!idx) {
+		seq = fi->dir_index_seq;
+		spin_unlock(&sbi->dir_index_lock);
+
+		new = __build_dir_index(dir, nblock);
+		if (!new)
+			return -ENOMEM;
+
+		spin_lock(&sbi->dir_index_lock);
+		/* the directory changed while it was read */
+		if (fi->dir_index || fi->dir_index_seq != seq) {
+			spin_unlock(&sbi->dir_index_lock);
+			__free_dir_index(new);
+			return -EAGAIN;
+		}
+		idx = fi->dir_index = new;
+		list_add_tail(&idx->list, &sbi->dir_index_list);
+		atomic_add(idx->nr_entries, &sbi->total_dir_index_ent);
+		atomic_inc(&sbi->total_dir_index);
+	} else {
+		list_move_tail(&idx->list, &sbi->dir_index_list);
+	}
+
+	hlist_for_each_entry(e, __index_bucket(idx, hash), node) {
+		if (e->hash != hash)
+			continue;
+		for (i = 0; i < nr; i++)
+			if (bidx[i] == e->bidx)
+				break;
+		if (i < nr)
+			continue;
+		if (nr == max) {
+			nr = -E2BIG;
+			break;
+		}
+		bidx[nr++] = e->bidx;
+	}
+	spin_unlock(&sbi->dir_index_lock);
+
+	if (nr >= 0)
+		stat_inc_dir_index_hit(sbi);
+	return nr;
+}
+
+void f2fs_dir_index_add(struct inode *dir, f2fs_hash_t hash,
+						unsigned long bidx)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(dir);
+	struct f2fs_inode_info *fi = F2FS_I(dir);
+	struct f2fs_dir_index *idx, *drop = NULL;
+	struct dir_index_entry *e = NULL;
+
+	if (ACCESS_ONCE(fi->dir_index))
+		e = kmem_cache_alloc(dir_index_entry_slab, GFP_NOFS);
+
+	spin_lock(&sbi->dir_index_lock);
+	idx = fi->dir_index;
+	if (!idx) {
+		fi->dir_index_seq++;
+	} else if (!e) {
+		/* an index missing a name would hide it, drop the index */
+		__detach_dir_index(sbi, idx);
+		drop = idx;
+	} else {
+		__insert_entry(idx, e, hash, bidx);
+		atomic_inc(&sbi->total_dir_index_ent);
+		e = NULL;
+	}
+	spin_unlock(&sbi->dir_index_lock);
+
+	if (e)
+		kmem_cache_free(dir_index_entry_slab, e);
+	if (drop)
+		__free_dir_index(drop);
+}
+
+void f2fs_dir_index_del(struct inode *dir, f2fs_hash_t hash,
+						unsigned long bidx)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(dir);
+	struct f2fs_inode_info *fi = F2FS_I(dir);
+	struct f2fs_dir_index *idx;
+	struct dir_index_entry *e, *found = NULL;
+
+	spin_lock(&sbi->dir_index_lock);
+	idx = fi->dir_index;
+	if (!idx) {
+		fi->dir_index_seq++;
+		goto out;
+	}
+
+	hlist_for_each_entry(e, __index_bucket(idx, hash), node) {
+		if (e->hash == hash && e->bidx == bidx) {
+			found = e;
+			break;
+		}
+	}
+	if (found) {
+		hlist_del(&found->node);
+		idx->nr_entries--;
+		atomic_dec(&sbi->total_dir_index_ent);
+	}
+out:
+	spin_unlock(&sbi->dir_index_lock);
+
+	if (found)
+		kmem_cache_free(dir_index_entry_slab, found);
+}
+
+void f2fs_dir_index_drop(struct inode *dir)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(dir);
+	struct f2fs_dir_index *idx;
+
+	if (!F2FS_I(dir)->dir_index)
+		return;
+
+	spin_lock(&sbi->dir_index_lock);
+	idx = F2FS_I(dir)->dir_index;
+	if (idx)
+		__detach_dir_index(sbi, idx);
+	spin_unlock(&sbi->dir_index_lock);
+
+	if (idx)
+		__free_dir_index(idx);
+}
+
+unsigned long f2fs_shrink_dir_index(struct f2fs_sb_info *sbi,
+						unsigned long nr_shrink)
+{
+	struct f2fs_dir_index *idx;
+	unsigned long freed = 0;
+
+	while (freed < nr_shrink) {
+		spin_lock(&sbi->dir_index_lock);
+		if (list_empty(&sbi->dir_index_list)) {
+			spin_unlock(&sbi->dir_index_lock);
+			break;
+		}
+		idx = list_first_entry(&sbi->dir_index_list,
+					struct f2fs_dir_index, list);
+		__detach_dir_index(sbi, idx);
+		spin_unlock(&sbi->dir_index_lock);
+
+		/* an empty index still costs its bucket array */
+		freed += max(idx->nr_entries, 1U);
+		__free_dir_index(idx);
+	}
+	return freed;
+}
+
+void init_dir_index_info(struct f2fs_sb_info *sbi)
+{
+	spin_lock_init(&sbi->dir_index_lock);
+	INIT_LIST_HEAD(&sbi->dir_index_list);
+	atomic_set(&sbi->total_dir_index, 0);
+	atomic_set(&sbi->total_dir_index_ent, 0);
+	sbi->dir_index_min_blocks = DEF_DIR_INDEX_MIN_BLOCKS;
+}
+
+int __init create_dir_index_cache(void)
+{
+	dir_index_entry_slab = f2fs_kmem_cache_create("f2fs_dir_index_entry",
+			sizeof(struct dir_index_entry));
+	if (!dir_index_entry_slab)
+		return -ENOMEM;
+	return 0;
+}
+
+void destroy_dir_index_cache(void)
+{
+	kmem_cache_destroy(dir_index_entry_slab);
+}
@@ -703,6 +703,58 @@ void f2fs_update_extent_cache_range(struct dnode_of_data *dn,
 		sync_inode_page(dn);
 }
 
+/*
+ * Walk the whole block map of a large file once and put every extent in
+ * its tree, so that reads of a cold file hit the cache instead of going
+ * through its dnodes. The nodes land on the usual lru list and are given
+ * back by the shrinker like any other, and nothing is cached while the
+ * extent cache is already over its memory budget.
+ */
+void f2fs_precache_extents(struct inode *inode)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
+	struct f2fs_map_blocks map;
+	pgoff_t next_pgofs, end;
+	loff_t isize = i_size_read(inode);
+	unsigned int nr_ext = 0;
+
+	if (!sbi->extent_precache_kb || !f2fs_may_extent_tree(inode) ||
+			f2fs_has_inline_data(inode))
+		return;
+
+	if (isize < ((loff_t)sbi->extent_precache_kb << 10))
+		return;
+
+	if (!available_free_memory(sbi, EXTENT_CACHE))
+		return;
+
+	if (test_and_set_bit(FI_EXTENT_PRECACHED, &F2FS_I(inode)->flags))
+		return;
+
+	end = (pgoff_t)DIV_ROUND_UP(isize, PAGE_CACHE_SIZE);
+	map.m_lblk = 0;
+	map.m_next_pgofs = &next_pgofs;
+
+	while (map.m_lblk < end) {
+		next_pgofs = map.m_lblk + 1;
+		map.m_len = end - map.m_lblk;
+
+		if (f2fs_map_blocks(inode, &map, 0, F2FS_GET_BLOCK_PRECACHE))
+			break;
+
+		/* f2fs_map_blocks() cached the extent under the dnode lock */
+		if (map.m_flags & F2FS_MAP_MAPPED) {
+			map.m_lblk += map.m_len;
+			nr_ext++;
+		} else {
+			/* hole or preallocated blocks */
+			map.m_lblk = max_t(pgoff_t, next_pgofs, map.m_lblk + 1);
+		}
+	}
+
+	stat_add_precache(sbi, nr_ext);
+}
+
 void init_extent_cache_info(struct f2fs_sb_info *sbi)
 {
 	INIT_RADIX_TREE(&sbi->extent_tree_root, GFP_NOIO);
@@ -417,6 +417,13 @@ enum {
 /* number of extent info in extent cache we try to shrink */
 #define EXTENT_CACHE_SHRINK_NUMBER	128
 
+/* files from this size on get their extent tree filled on open */
+#define DEF_EXTENT_PRECACHE_KB		4096
+
+/* directories from this many blocks on get a name index on lookup */
+#define DEF_DIR_INDEX_MIN_BLOCKS	32
+#define DIR_INDEX_MAX_BLOCKS		4	/* more candidates walk the levels */
+
 struct extent_info {
 	unsigned int fofs;		/* start offset in a file */
 	u32 blk;			/* start block address of the extent */
@@ -466,6 +473,7 @@ struct f2fs_map_blocks {
 #define F2FS_GET_BLOCK_BMAP		3
 #define F2FS_GET_BLOCK_PRE_DIO		4
 #define F2FS_GET_BLOCK_PRE_AIO		5
+#define F2FS_GET_BLOCK_PRECACHE	6
 
 /*
  * i_advise uses FADVISE_XXX_BIT. We can add additional hints later.
@@ -518,6 +526,8 @@ struct f2fs_inode_info {
 	struct list_head inmem_pages;	/* inmemory pages managed by f2fs */
 	struct mutex inmem_lock;	/* lock for inmemory pages */
 	struct extent_tree *extent_tree;	/* cached extent_tree entry */
+	struct f2fs_dir_index *dir_index;	/* name index of large dir */
+	unsigned int dir_index_seq;	/* changes while not indexed */
 };
 
 static inline void get_extent_info(struct extent_info *ext,
@@ -675,6 +685,19 @@ struct flush_cmd_control {
 	struct llist_node *dispatch_list;	/* list for command dispatch */
 };
 
+struct discard_cmd_control {
+	struct task_struct *f2fs_issue_discard;	/* discard thread */
+	wait_queue_head_t discard_wait_queue;	/* waiting queue for wake-up */
+	wait_queue_head_t issue_wait_queue;	/* waiting for an issued range */
+	spinlock_t lock;			/* protects below */
+	struct list_head pend_list;		/* ranges sorted by address */
+	unsigned long *pend_segmap;		/* segments with pending ranges */
+	unsigned int nr_pending;		/* # of pending blocks */
+	block_t issue_start;			/* range being issued */
+	block_t issue_len;
+	int wake;				/* new ranges or too many */
+};
+
 struct f2fs_sm_info {
 	struct sit_info *sit_info;		/* whole segment information */
 	struct free_segmap_info *free_info;	/* free segment information */
@@ -710,6 +733,11 @@ struct f2fs_sm_info {
 	/* for flush command control */
 	struct flush_cmd_control *cmd_control_info;
 
+	/* for discard command control */
+	struct discard_cmd_control *dcc_info;
+	unsigned int discard_granularity;	/* min. blocks of a discard */
+	unsigned int max_discard_pending;	/* issue at once above this */
+
 };
 
 /*
@@ -847,6 +875,9 @@ struct f2fs_sb_info {
 	struct rw_semaphore node_write;		/* locking node writes */
 	struct mutex writepages;		/* mutex for writepages() */
 	wait_queue_head_t cp_wait;
+	unsigned int cp_preflush;		/* write nodes before blocking ops */
+	unsigned int extent_precache_kb;	/* precache extents from this size */
+	unsigned int atomic_commit_fua;		/* FUA node write on commit */
 	unsigned long last_time[MAX_TIME];	/* to store time in jiffies */
 	long interval_time[MAX_TIME];		/* to store thresholds */
 
@@ -869,6 +900,13 @@ struct f2fs_sb_info {
 	atomic_t total_zombie_tree;		/* extent zombie tree count */
 	atomic_t total_ext_node;		/* extent info count */
 
+	/* for directory name index */
+	spinlock_t dir_index_lock;		/* protects all dir indexes */
+	struct list_head dir_index_list;	/* lru list for shrinker */
+	atomic_t total_dir_index;		/* indexed dir count */
+	atomic_t total_dir_index_ent;		/* dir index entry count */
+	unsigned int dir_index_min_blocks;	/* index dirs from this size */
+
 	/* basic filesystem units */
 	unsigned int log_sectors_per_block;	/* log2 sectors per block */
 	unsigned int log_blocksize;		/* log2 block size */
@@ -919,11 +957,25 @@ struct f2fs_sb_info {
 	atomic64_t read_hit_rbtree;		/* # of hit rbtree extent node */
 	atomic64_t read_hit_largest;		/* # of hit largest extent node */
 	atomic64_t read_hit_cached;		/* # of hit cached extent node */
+	atomic64_t precache_files;		/* # of files precached on open */
+	atomic64_t precache_exts;		/* # of extents precached */
+	atomic64_t dir_index_hit;		/* # of lookups by dir index */
+	atomic64_t atomic_commit;		/* # of atomic write commits */
+	atomic64_t atomic_commit_fua;		/* # committed with a FUA node */
+	atomic64_t atomic_commit_cp;		/* # committed by a checkpoint */
+	atomic64_t atomic_commit_us;		/* total commit time */
+	atomic64_t atomic_commit_max_us;	/* slowest commit */
+	atomic64_t fg_gc_stall;			/* # of balance_fs FG GC runs */
+	atomic64_t fg_gc_stall_us;		/* total time writers stalled */
+	atomic64_t fg_gc_stall_max_us;		/* longest stall */
 	atomic_t inline_xattr;			/* # of inline_xattr inodes */
 	atomic_t inline_inode;			/* # of inline_data inodes */
 	atomic_t inline_dir;			/* # of inline_dentry inodes */
 	int bg_gc;				/* background gc calls */
 	unsigned int ndirty_inode[NR_INODE_TYPE];	/* # of dirty inodes */
+#endif
+#ifdef CONFIG_F2FS_STAT_STREAM
+	unsigned int stat_stream_interval_ms;	/* 0 stops the stream */
 #endif
 	unsigned int last_victim[2];		/* last victim segment # */
 	spinlock_t stat_lock;			/* lock for stat operations */
@@ -970,14 +1022,23 @@ static inline bool f2fs_time_over(struct f2fs_sb_info *sbi, int type)
 	return time_after(jiffies, sbi->last_time[type] + interval);
 }
 
-static inline bool is_idle(struct f2fs_sb_info *sbi)
+static inline bool is_disk_busy(struct f2fs_sb_info *sbi)
 {
 	struct block_device *bdev = sbi->sb->s_bdev;
 	struct request_queue *q = bdev_get_queue(bdev);
 	struct request_list *rl = &q->root_rl;
 
 	if (rl->count[BLK_RW_SYNC] || rl->count[BLK_RW_ASYNC])
-		return 0;
+		return true;
+
+	/* blk-mq requests never show up in root_rl, check the whole disk */
+	return part_in_flight(&bdev->bd_disk->part0);
+}
+
+static inline bool is_idle(struct f2fs_sb_info *sbi)
+{
+	if (is_disk_busy(sbi))
+		return false;
 
 	return f2fs_time_over(sbi, REQ_TIME);
 }
@@ -1639,6 +1700,7 @@ enum {
 	FI_DO_DEFRAG,		/* indicate defragment is running */
 	FI_DIRTY_FILE,		/* indicate regular/symlink has dirty pages */
 	FI_NO_PREALLOC,		/* indicate skipped preallocated blocks */
+	FI_EXTENT_PRECACHED,	/* extent tree was filled on open */
 };
 
 static inline void set_inode_flag(struct f2fs_inode_info *fi, int flag)
@@ -1975,7 +2037,7 @@ struct page *get_node_page(struct f2fs_sb_info *, pgoff_t);
 struct page *get_node_page_ra(struct page *, int);
 void sync_inode_page(struct dnode_of_data *);
 int fsync_node_pages(struct f2fs_sb_info *, nid_t, struct writeback_control *,
-								bool);
+							bool, bool *);
 int sync_node_pages(struct f2fs_sb_info *, struct writeback_control *);
 void build_free_nids(struct f2fs_sb_info *, bool);
 bool alloc_nid(struct f2fs_sb_info *, nid_t *);
@@ -2009,6 +2071,8 @@ void f2fs_balance_fs_bg(struct f2fs_sb_info *);
 int f2fs_issue_flush(struct f2fs_sb_info *);
 int create_flush_cmd_control(struct f2fs_sb_info *);
 void destroy_flush_cmd_control(struct f2fs_sb_info *);
+int create_discard_cmd_control(struct f2fs_sb_info *);
+void destroy_discard_cmd_control(struct f2fs_sb_info *);
 void invalidate_blocks(struct f2fs_sb_info *, block_t);
 bool is_checkpointed_data(struct f2fs_sb_info *, block_t);
 void refresh_sit_entry(struct f2fs_sb_info *, block_t, block_t);
@@ -2121,6 +2185,15 @@ struct f2fs_stat_info {
 	int main_area_segs, main_area_sections, main_area_zones;
 	unsigned long long hit_largest, hit_cached, hit_rbtree;
 	unsigned long long hit_total, total_ext;
+	unsigned long long precache_files, precache_exts;
+	unsigned long long dir_index_hit;
+	int dir_index, dir_index_ent;
+	unsigned long long atomic_commit, atomic_commit_fua, atomic_commit_cp;
+	unsigned long long atomic_commit_us, atomic_commit_max_us;
+	unsigned long long fg_gc_stall, fg_gc_stall_us, fg_gc_stall_max_us;
+	unsigned long long victim_count, victim_vblocks;
+	unsigned long long cp_total_us;
+	unsigned int cp_last_us, cp_max_us;
 	int ext_tree, zombie_tree, ext_node;
 	int ndirty_node, ndirty_meta;
 	int ndirty_dent, ndirty_dirs, ndirty_data, ndirty_files;
@@ -2146,6 +2219,13 @@ struct f2fs_stat_info {
 	unsigned int block_count[2];
 	unsigned int inplace_count;
 	unsigned long long base_mem, cache_mem, page_mem;
+
+#ifdef CONFIG_F2FS_STAT_STREAM
+	struct dentry *stream_dir;
+	struct rchan *stream_chan;
+	struct delayed_work stream_work;
+	unsigned int stream_seq;
+#endif
 };
 
 static inline struct f2fs_stat_info *F2FS_STAT(struct f2fs_sb_info *sbi)
@@ -2163,6 +2243,30 @@ static inline struct f2fs_stat_info *F2FS_STAT(struct f2fs_sb_info *sbi)
 #define stat_inc_rbtree_node_hit(sbi)	(atomic64_inc(&(sbi)->read_hit_rbtree))
 #define stat_inc_largest_node_hit(sbi)	(atomic64_inc(&(sbi)->read_hit_largest))
 #define stat_inc_cached_node_hit(sbi)	(atomic64_inc(&(sbi)->read_hit_cached))
+#define stat_add_precache(sbi, n)					\
+	do {								\
+		atomic64_inc(&(sbi)->precache_files);			\
+		atomic64_add(n, &(sbi)->precache_exts);			\
+	} while (0)
+#define stat_inc_atomic_commit_fua(sbi)					\
+		(atomic64_inc(&(sbi)->atomic_commit_fua))
+#define stat_inc_dir_index_hit(sbi)	(atomic64_inc(&(sbi)->dir_index_hit))
+#define stat_inc_atomic_commit_cp(sbi)					\
+		(atomic64_inc(&(sbi)->atomic_commit_cp))
+#define stat_inc_gc_victim(sbi, segno)					\
+	do {								\
+		struct f2fs_stat_info *si = F2FS_STAT(sbi);		\
+		si->victim_count++;					\
+		si->victim_vblocks += get_valid_blocks(sbi, segno,	\
+						sbi->segs_per_sec);	\
+	} while (0)
+#define stat_update_cp_time(si, us)					\
+	do {								\
+		(si)->cp_last_us = (us);				\
+		(si)->cp_total_us += (us);				\
+		if ((si)->cp_max_us < (us))				\
+			(si)->cp_max_us = (us);				\
+	} while (0)
 #define stat_inc_inline_xattr(inode)					\
 	do {								\
 		if (f2fs_has_inline_xattr(inode))			\
@@ -2231,6 +2335,8 @@ static inline struct f2fs_stat_info *F2FS_STAT(struct f2fs_sb_info *sbi)
 		si->bg_node_blks += (gc_type == BG_GC) ? (blks) : 0;	\
 	} while (0)
 
+void stat_update_atomic_commit(struct f2fs_sb_info *, s64);
+void stat_update_fg_gc_stall(struct f2fs_sb_info *, s64);
 int f2fs_build_stats(struct f2fs_sb_info *);
 void f2fs_destroy_stats(struct f2fs_sb_info *);
 int __init f2fs_create_root_stats(void);
@@ -2246,6 +2352,14 @@ void f2fs_destroy_root_stats(void);
 #define stat_inc_rbtree_node_hit(sb)
 #define stat_inc_largest_node_hit(sbi)
 #define stat_inc_cached_node_hit(sbi)
+#define stat_add_precache(sbi, n)
+#define stat_inc_atomic_commit_fua(sbi)
+#define stat_inc_dir_index_hit(sbi)
+#define stat_inc_atomic_commit_cp(sbi)
+#define stat_update_atomic_commit(sbi, us)
+#define stat_inc_gc_victim(sbi, segno)
+#define stat_update_cp_time(si, us)
+#define stat_update_fg_gc_stall(sbi, us)
 #define stat_inc_inline_xattr(inode)
 #define stat_dec_inline_xattr(inode)
 #define stat_inc_inline_inode(inode)
@@ -2324,10 +2438,24 @@ bool f2fs_lookup_extent_cache(struct inode *, pgoff_t, struct extent_info *);
 void f2fs_update_extent_cache(struct dnode_of_data *);
 void f2fs_update_extent_cache_range(struct dnode_of_data *dn,
 						pgoff_t, block_t, unsigned int);
+void f2fs_precache_extents(struct inode *);
 void init_extent_cache_info(struct f2fs_sb_info *);
 int __init create_extent_cache(void);
 void destroy_extent_cache(void);
 
+/*
+ * dir_index.c
+ */
+int f2fs_dir_index_lookup(struct inode *, f2fs_hash_t, unsigned long,
+						unsigned long *, int);
+void f2fs_dir_index_add(struct inode *, f2fs_hash_t, unsigned long);
+void f2fs_dir_index_del(struct inode *, f2fs_hash_t, unsigned long);
+void f2fs_dir_index_drop(struct inode *);
+unsigned long f2fs_shrink_dir_index(struct f2fs_sb_info *, unsigned long);
+void init_dir_index_info(struct f2fs_sb_info *);
+int __init create_dir_index_cache(void);
+void destroy_dir_index_cache(void);
+
 /*
  * hisi rdr support
  */
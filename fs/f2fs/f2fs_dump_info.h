@@ -6,4 +6,43 @@
 void f2fs_print_raw_sb_info(struct f2fs_sb_info *sbi);
 void f2fs_print_ckpt_info(struct f2fs_sb_info *sbi);
 
+/*
+ * Record of the debugfs f2fs/<dev>/stream0 relay file, written every
+ * stat_stream_interval_ms. Counters are totals since mount, so a reader
+ * that missed records still gets correct deltas from the next one, the
+ * *_secs/*_segs fields are the level at ts_ns (ktime_get_ns()).
+ */
+#define F2FS_STAT_STREAM_MAGIC		0x54534632	/* "2FST" */
+#define F2FS_STAT_STREAM_VERSION	1
+
+struct f2fs_stat_stream_rec {
+	__u32	magic;
+	__u16	version;
+	__u16	rec_size;
+	__u32	dev;			/* new_encode_dev() of the partition */
+	__u32	seq;
+	__u64	ts_ns;
+
+	__u64	gc_calls;		/* segments collected, BG and FG */
+	__u64	bg_gc_calls;
+	__u64	gc_victims;		/* victim sections selected */
+	__u64	gc_victim_vblocks;	/* valid blocks they held */
+
+	__u64	cp_count;
+	__u64	cp_total_us;
+	__u32	cp_last_us;
+	__u32	cp_max_us;
+
+	__u64	fg_gc_stalls;		/* writers that had to run FG GC */
+	__u64	fg_gc_stall_us;
+	__u64	fg_gc_stall_max_us;
+
+	__u32	free_secs;
+	__u32	reserved_secs;
+	__u32	prefree_segs;
+	__u32	dirty_segs;
+	__u32	main_secs;
+	__u32	pad;
+};
+
 #endif
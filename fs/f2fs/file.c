@@ -21,6 +21,7 @@
 #include <linux/mount.h>
 #include <linux/pagevec.h>
 #include <linux/random.h>
+#include <linux/task_io_accounting_ops.h>
 
 #include "f2fs.h"
 #include "node.h"
@@ -191,6 +192,7 @@ static int f2fs_do_sync_file(struct file *file, loff_t start, loff_t end,
 	nid_t ino = inode->i_ino;
 	int ret = 0;
 	bool need_cp = false;
+	bool flushed = false;
 	struct writeback_control wbc = {
 		.sync_mode = WB_SYNC_ALL,
 		.nr_to_write = LONG_MAX,
@@ -244,6 +246,9 @@ go_write:
 	up_read(&fi->i_sem);
 
 	if (need_cp) {
+		if (atomic)
+			stat_inc_atomic_commit_cp(sbi);
+
 		/* all the dirty node pages should be flushed for POR */
 		ret = f2fs_sync_fs(inode->i_sb, 1);
 
@@ -257,7 +262,8 @@ go_write:
 		goto out;
 	}
 sync_nodes:
-	ret = fsync_node_pages(sbi, ino, &wbc, atomic);
+	ret = fsync_node_pages(sbi, ino, &wbc, atomic,
+			atomic && sbi->atomic_commit_fua ? &flushed : NULL);
 	if (ret)
 		goto out;
 
@@ -283,7 +289,11 @@ sync_nodes:
 flush_out:
 	remove_ino_entry(sbi, ino, UPDATE_INO);
 	clear_inode_flag(fi, FI_UPDATE_WRITE);
-	ret = f2fs_issue_flush(sbi);
+	/* the FUA node write of an atomic commit did the flush */
+	if (flushed)
+		stat_inc_atomic_commit_fua(sbi);
+	else
+		ret = f2fs_issue_flush(sbi);
 	f2fs_update_time(sbi, REQ_TIME);
 out:
 	trace_f2fs_sync_file_exit(inode, need_cp, datasync, ret);
@@ -293,9 +303,15 @@ out:
 
 int f2fs_sync_file(struct file *file, loff_t start, loff_t end, int datasync)
 {
+	u64 start_ns = ktime_get_ns();
+	int ret;
+
 	/*lint -save -e747*/
-	return f2fs_do_sync_file(file, start, end, datasync, false);
+	ret = f2fs_do_sync_file(file, start, end, datasync, false);
 	/*lint -restore*/
+	task_io_account_fsync_wait(ktime_get_ns() - start_ns);
+
+	return ret;
 }
 
 static pgoff_t __get_first_dirty_index(struct address_space *mapping,
@@ -467,6 +483,9 @@ static int f2fs_file_open(struct inode *inode, struct file *filp)
 		return -EPERM;
 	}
 	dput(dir);
+
+	if (!ret && S_ISREG(inode->i_mode) && !(filp->f_flags & O_TRUNC))
+		f2fs_precache_extents(inode);
 	return ret;
 }
 
@@ -1399,6 +1418,7 @@ static int f2fs_ioc_start_atomic_write(struct file *filp)
 static int f2fs_ioc_commit_atomic_write(struct file *filp)
 {
 	struct inode *inode = file_inode(filp);
+	ktime_t start = ktime_get();
 	int ret;
 
 	if (!inode_owner_or_capable(inode))
@@ -1423,6 +1443,9 @@ static int f2fs_ioc_commit_atomic_write(struct file *filp)
 	/*lint -save -e747*/
 	ret = f2fs_do_sync_file(filp, 0, LLONG_MAX, 0, true);
 	/*lint -restore*/
+	if (!ret)
+		stat_update_atomic_commit(F2FS_I_SB(inode),
+			ktime_to_us(ktime_sub(ktime_get(), start)));
 err_out:
 	mnt_drop_write_file(filp);
 	return ret;
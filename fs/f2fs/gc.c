@@ -16,6 +16,7 @@
 #include <linux/kthread.h>
 #include <linux/delay.h>
 #include <linux/freezer.h>
+#include <linux/fb.h>
 
 #include "f2fs.h"
 #include "node.h"
@@ -28,6 +29,7 @@ static int gc_thread_func(void *data)
 	struct f2fs_sb_info *sbi = data;
 	struct f2fs_gc_kthread *gc_th = sbi->gc_thread;
 	wait_queue_head_t *wq = &sbi->gc_thread->gc_wait_queue_head;
+	bool urgent;
 	long wait_ms;
 
 	wait_ms = gc_th->min_sleep_time;
@@ -37,7 +39,8 @@ static int gc_thread_func(void *data)
 			continue;
 		else
 			wait_event_interruptible_timeout(*wq,
-						kthread_should_stop(),
+						kthread_should_stop() ||
+						gc_wake_pending(gc_th),
 						msecs_to_jiffies(wait_ms));
 		if (kthread_should_stop())
 			break;
@@ -63,7 +66,19 @@ static int gc_thread_func(void *data)
 		if (!mutex_trylock(&sbi->gc_mutex))
 			continue;
 
-		if (!is_idle(sbi)) {
+		/*
+		 * Close to the foreground GC threshold, reclaim now from this
+		 * thread rather than later from a user's write path.
+		 */
+		urgent = gc_urgent(sbi, gc_th);
+		if (urgent) {
+#ifdef CONFIG_F2FS_GC_IDLE_AWARE
+			wait_ms = gc_th->urgent_sleep_time;
+#endif
+			goto do_gc;
+		}
+
+		if (!gc_is_idle(sbi, gc_th)) {
 			increase_sleep_time(gc_th, &wait_ms);
 			mutex_unlock(&sbi->gc_mutex);
 			continue;
@@ -73,6 +88,11 @@ static int gc_thread_func(void *data)
 			decrease_sleep_time(gc_th, &wait_ms);
 		else
 			increase_sleep_time(gc_th, &wait_ms);
+#ifdef CONFIG_F2FS_GC_IDLE_AWARE
+		if (gc_th->screen_off)
+			wait_ms = gc_th->min_sleep_time;
+#endif
+do_gc:
 
 		stat_inc_bggc_count(sbi);
 
@@ -94,7 +114,7 @@ static int gc_thread_func(void *data)
 #endif
 		/* if return value is not zero, no victim was selected */
 		/*lint -save -e747*/
-		if (f2fs_gc(sbi, test_opt(sbi, FORCE_FG_GC), true))
+		if (f2fs_gc(sbi, urgent || test_opt(sbi, FORCE_FG_GC), true))
 			wait_ms = gc_th->no_gc_sleep_time;
 		/*lint -restore*/
 
@@ -108,6 +128,48 @@ static int gc_thread_func(void *data)
 	return 0;
 }
 
+#ifdef CONFIG_F2FS_GC_IDLE_AWARE
+static int gc_fb_notifier_call(struct notifier_block *nb,
+			       unsigned long event, void *data)
+{
+	struct f2fs_gc_kthread *gc_th = container_of(nb,
+				struct f2fs_gc_kthread, fb_notif);
+	struct fb_event *evdata = data;
+	int *blank;
+
+	if (event != FB_EVENT_BLANK || !evdata || !evdata->data)
+		return NOTIFY_DONE;
+
+	blank = evdata->data;
+	gc_th->screen_off = (*blank != FB_BLANK_UNBLANK);
+	if (gc_th->screen_off) {
+		gc_th->wake_pending = 1;
+		wake_up_interruptible_all(&gc_th->gc_wait_queue_head);
+	}
+	return NOTIFY_OK;
+}
+
+static void gc_idle_aware_init(struct f2fs_gc_kthread *gc_th)
+{
+	gc_th->urgent_sleep_time = DEF_GC_THREAD_URGENT_SLEEP_TIME;
+	gc_th->urgent_margin = DEF_GC_URGENT_MARGIN;
+	gc_th->screen_off = false;
+	gc_th->wake_pending = 0;
+	gc_th->fb_notif.notifier_call = gc_fb_notifier_call;
+	if (fb_register_client(&gc_th->fb_notif))
+		gc_th->fb_notif.notifier_call = NULL;
+}
+
+static void gc_idle_aware_exit(struct f2fs_gc_kthread *gc_th)
+{
+	if (gc_th->fb_notif.notifier_call)
+		fb_unregister_client(&gc_th->fb_notif);
+}
+#else
+static inline void gc_idle_aware_init(struct f2fs_gc_kthread *gc_th) {}
+static inline void gc_idle_aware_exit(struct f2fs_gc_kthread *gc_th) {}
+#endif
+
 int start_gc_thread(struct f2fs_sb_info *sbi)
 {
 	struct f2fs_gc_kthread *gc_th;
@@ -128,10 +190,12 @@ int start_gc_thread(struct f2fs_sb_info *sbi)
 
 	sbi->gc_thread = gc_th;
 	init_waitqueue_head(&sbi->gc_thread->gc_wait_queue_head);
+	gc_idle_aware_init(gc_th);
 	sbi->gc_thread->f2fs_gc_task = kthread_run(gc_thread_func, sbi,
 			"f2fs_gc-%u:%u", MAJOR(dev), MINOR(dev));
 	if (IS_ERR(gc_th->f2fs_gc_task)) {
 		err = PTR_ERR(gc_th->f2fs_gc_task);
+		gc_idle_aware_exit(gc_th);
 		kfree(gc_th);
 		sbi->gc_thread = NULL;
 	}
@@ -144,6 +208,7 @@ void stop_gc_thread(struct f2fs_sb_info *sbi)
 	struct f2fs_gc_kthread *gc_th = sbi->gc_thread;
 	if (!gc_th)
 		return;
+	gc_idle_aware_exit(gc_th);
 	kthread_stop(gc_th->f2fs_gc_task);
 	kfree(gc_th);
 	sbi->gc_thread = NULL;
@@ -275,6 +340,46 @@ static unsigned int count_bits(const unsigned long *addr,
 	return sum;
 }
 
+/*
+ * LFS victim selection from the victim index: sections come by ascending
+ * valid blocks and, within a bucket, least recently written first. Greedy
+ * stops at the first bucket holding a usable section, cost-benefit weighs
+ * at most VICTIM_INDEX_SCAN of the emptiest and oldest sections.
+ */
+static void get_victim_from_index(struct f2fs_sb_info *sbi, int gc_type,
+				  struct victim_sel_policy *p)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	struct victim_index *vi = &dirty_i->victim_index;
+	struct victim_entry *ve;
+	unsigned int bucket, secno, segno;
+	unsigned int nsearched = 0;
+	unsigned long cost;
+
+	for_each_set_bit(bucket, vi->nonempty, NR_VICTIM_BUCKETS) {
+		list_for_each_entry(ve, &vi->buckets[bucket], list) {
+			secno = ve - vi->entries;
+
+			if (sec_usage_check(sbi, secno))
+				continue;
+			if (gc_type == BG_GC &&
+			    test_bit(secno, dirty_i->victim_secmap))
+				continue;
+
+			segno = secno * sbi->segs_per_sec;
+			cost = get_gc_cost(sbi, segno, p);
+			if (p->min_cost > cost) {
+				p->min_segno = segno;
+				p->min_cost = cost;
+			}
+			if (++nsearched >= VICTIM_INDEX_SCAN)
+				return;
+		}
+		if (p->gc_mode == GC_GREEDY && p->min_segno != NULL_SEGNO)
+			return;
+	}
+}
+
 /*
  * This function is called from two paths.
  * One is garbage collection and the other is SSR segment selection.
@@ -310,6 +415,11 @@ static int get_victim_by_default(struct f2fs_sb_info *sbi,
 			goto got_it;
 	}
 
+	if (p.alloc_mode == LFS && dirty_i->victim_index.entries) {
+		get_victim_from_index(sbi, gc_type, &p);
+		goto scanned;
+	}
+
 	while (1) {
 		unsigned long cost;
 		unsigned int segno;
@@ -358,6 +468,7 @@ next:
 			break;
 		}
 	}
+scanned:
 	if (p.min_segno != NULL_SEGNO) {
 got_it:
 		if (p.alloc_mode == LFS) {
@@ -366,6 +477,7 @@ got_it:
 				sbi->cur_victim_sec = secno;
 			else
 				set_bit(secno, dirty_i->victim_secmap);
+			stat_inc_gc_victim(sbi, p.min_segno);
 		}
 		*result = (p.min_segno / p.ofs_unit) * p.ofs_unit;
 
@@ -16,11 +16,14 @@
 #define DEF_GC_THREAD_MIN_SLEEP_TIME	30000	/* milliseconds */
 #define DEF_GC_THREAD_MAX_SLEEP_TIME	60000
 #define DEF_GC_THREAD_NOGC_SLEEP_TIME	300000	/* wait 5 min */
+#define DEF_GC_THREAD_URGENT_SLEEP_TIME	500	/* milliseconds */
+#define DEF_GC_URGENT_MARGIN		32	/* sections above FG GC */
 #define LIMIT_INVALID_BLOCK	40 /* percentage over total user space */
 #define LIMIT_FREE_BLOCK	40 /* percentage over invalid + free space */
 
 /* Search max. number of dirty segments to select a victim segment */
 #define DEF_MAX_VICTIM_SEARCH 4096 /* covers 8GB */
+#define VICTIM_INDEX_SCAN	64	/* victim index candidates per GC */
 
 struct f2fs_gc_kthread {
 	struct task_struct *f2fs_gc_task;
@@ -33,6 +36,16 @@ struct f2fs_gc_kthread {
 
 	/* for changing gc mode */
 	unsigned int gc_idle;
+
+#ifdef CONFIG_F2FS_GC_IDLE_AWARE
+	/* reclaim without waiting for idle this close to FG GC */
+	unsigned int urgent_sleep_time;
+	unsigned int urgent_margin;
+
+	struct notifier_block fb_notif;
+	bool screen_off;
+	int wake_pending;
+#endif
 };
 
 struct gc_inode_list {
@@ -86,6 +99,44 @@ static inline void decrease_sleep_time(struct f2fs_gc_kthread *gc_th,
 		*wait = gc_th->min_sleep_time;
 }
 
+#ifdef CONFIG_F2FS_GC_IDLE_AWARE
+static inline bool gc_wake_pending(struct f2fs_gc_kthread *gc_th)
+{
+	return xchg(&gc_th->wake_pending, 0);
+}
+
+static inline bool gc_urgent(struct f2fs_sb_info *sbi,
+			     struct f2fs_gc_kthread *gc_th)
+{
+	return has_not_enough_free_secs(sbi, -(int)gc_th->urgent_margin);
+}
+
+static inline bool gc_is_idle(struct f2fs_sb_info *sbi,
+			      struct f2fs_gc_kthread *gc_th)
+{
+	if (gc_th->screen_off)
+		return !is_disk_busy(sbi);
+	return is_idle(sbi);
+}
+#else
+static inline bool gc_wake_pending(struct f2fs_gc_kthread *gc_th)
+{
+	return false;
+}
+
+static inline bool gc_urgent(struct f2fs_sb_info *sbi,
+			     struct f2fs_gc_kthread *gc_th)
+{
+	return false;
+}
+
+static inline bool gc_is_idle(struct f2fs_sb_info *sbi,
+			      struct f2fs_gc_kthread *gc_th)
+{
+	return is_idle(sbi);
+}
+#endif
+
 static inline bool has_enough_invalid_blocks(struct f2fs_sb_info *sbi)
 {
 	block_t invalid_user_blocks = sbi->user_block_count -
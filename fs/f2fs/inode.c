@@ -348,6 +348,7 @@ void f2fs_evict_inode(struct inode *inode)
 	remove_dirty_inode(inode);
 
 	f2fs_destroy_extent_tree(inode);
+	f2fs_dir_index_drop(inode);
 
 	if (inode->i_nlink || is_bad_inode(inode))
 		goto no_delete;
@@ -1267,14 +1267,95 @@ continue_unlock:
 	return last_page;
 }
 
+static int __write_node_page(struct page *page, bool fua,
+				struct writeback_control *wbc)
+{
+	struct f2fs_sb_info *sbi = F2FS_P_SB(page);
+	nid_t nid;
+	struct node_info ni;
+	/*lint -save -e446*/
+	struct f2fs_io_info fio = {
+		.sbi = sbi,
+		.type = NODE,
+		.rw = wbc_to_write_cmd(wbc),
+		.page = page,
+		.encrypted_page = NULL,
+	};
+	/*lint -restore*/
+
+	trace_f2fs_writepage(page, NODE);
+
+	if (fua)
+		fio.rw = WRITE_FLUSH_FUA;
+
+	if (unlikely(is_sbi_flag_set(sbi, SBI_POR_DOING)))
+		goto redirty_out;
+	if (unlikely(f2fs_cp_error(sbi)))
+		goto redirty_out;
+
+	/* get old block addr of this node page */
+	nid = nid_of_node(page);
+	f2fs_bug_on(sbi, page->index != nid);
+
+	if (wbc->for_reclaim) {
+		if (!down_read_trylock(&sbi->node_write))
+			goto redirty_out;
+	} else {
+		down_read(&sbi->node_write);
+	}
+
+	get_node_info(sbi, nid, &ni);
+
+	/* This page is already truncated */
+	if (unlikely(ni.blk_addr == NULL_ADDR)) {
+		ClearPageUptodate(page);
+		dec_page_count(sbi, F2FS_DIRTY_NODES);
+		up_read(&sbi->node_write);
+		unlock_page(page);
+		return 0;
+	}
+
+	set_page_writeback(page);
+	fio.old_blkaddr = ni.blk_addr;
+	write_node_page(nid, &fio);
+	set_node_addr(sbi, &ni, fio.new_blkaddr, is_fsync_dnode(page));
+	dec_page_count(sbi, F2FS_DIRTY_NODES);
+	up_read(&sbi->node_write);
+
+	if (wbc->for_reclaim || fua)
+		f2fs_submit_merged_bio_cond(sbi, NULL, page, 0, NODE, WRITE);
+
+	unlock_page(page);
+
+	if (unlikely(f2fs_cp_error(sbi)))
+		f2fs_submit_merged_bio(sbi, NODE, WRITE);
+
+	return 0;
+
+redirty_out:
+	redirty_page_for_writepage(wbc, page);
+	return AOP_WRITEPAGE_ACTIVATE;
+}
+
+/*
+ * With @flushed, the fsync marked node of an atomic commit is written
+ * with FLUSH|FUA once every other page of the commit is on the media,
+ * which makes the commit durable without a separate cache flush, and
+ * *flushed tells the caller whether that happened.
+ */
 int fsync_node_pages(struct f2fs_sb_info *sbi, nid_t ino,
-			struct writeback_control *wbc, bool atomic)
+			struct writeback_control *wbc, bool atomic,
+			bool *flushed)
  {
 	pgoff_t index, end;
 	struct pagevec pvec;
 	int ret = 0;
 	struct page *last_page = NULL;
 	bool marked = false;
+	bool fua = atomic && flushed && !test_opt(sbi, NOBARRIER);
+
+	if (flushed)
+		*flushed = false;
 
 	if (atomic) {
 		last_page = last_fsync_dnode(sbi, ino);
@@ -1339,10 +1420,24 @@ continue_unlock:
 					set_page_dirty(page);
 			}
 
+			if (fua && page == last_page) {
+				/* the flush only covers completed writes */
+				f2fs_submit_merged_bio(sbi, NODE, WRITE);
+				ret = wait_on_node_pages_writeback(sbi, ino);
+				if (ret) {
+					unlock_page(page);
+					f2fs_put_page(last_page, 0);
+					break;
+				}
+			}
+
 			if (!clear_page_dirty_for_io(page))
 				goto continue_unlock;
 
-			ret = NODE_MAPPING(sbi)->a_ops->writepage(page, wbc);
+			/*lint -save -e747*/
+			ret = __write_node_page(page, fua && page == last_page,
+									wbc);
+			/*lint -restore*/
 			if (ret) {
 				unlock_page(page);
 				f2fs_put_page(last_page, 0);
@@ -1351,6 +1446,8 @@ continue_unlock:
 			if (page == last_page) {
 				f2fs_put_page(page, 0);
 				marked = true;
+				if (fua)
+					*flushed = true;
 				break;
 			}
 		}
@@ -1522,68 +1619,9 @@ int wait_on_node_pages_writeback(struct f2fs_sb_info *sbi, nid_t ino)
 static int f2fs_write_node_page(struct page *page,
 				struct writeback_control *wbc)
 {
-	struct f2fs_sb_info *sbi = F2FS_P_SB(page);
-	nid_t nid;
-	struct node_info ni;
-	/*lint -save -e446*/
-	struct f2fs_io_info fio = {
-		.sbi = sbi,
-		.type = NODE,
-		.rw = wbc_to_write_cmd(wbc),
-		.page = page,
-		.encrypted_page = NULL,
-	};
+	/*lint -save -e747*/
+	return __write_node_page(page, false, wbc);
 	/*lint -restore*/
-
-	trace_f2fs_writepage(page, NODE);
-
-	if (unlikely(is_sbi_flag_set(sbi, SBI_POR_DOING)))
-		goto redirty_out;
-	if (unlikely(f2fs_cp_error(sbi)))
-		goto redirty_out;
-
-	/* get old block addr of this node page */
-	nid = nid_of_node(page);
-	f2fs_bug_on(sbi, page->index != nid);
-
-	if (wbc->for_reclaim) {
-		if (!down_read_trylock(&sbi->node_write))
-			goto redirty_out;
-	} else {
-		down_read(&sbi->node_write);
-	}
-
-	get_node_info(sbi, nid, &ni);
-
-	/* This page is already truncated */
-	if (unlikely(ni.blk_addr == NULL_ADDR)) {
-		ClearPageUptodate(page);
-		dec_page_count(sbi, F2FS_DIRTY_NODES);
-		up_read(&sbi->node_write);
-		unlock_page(page);
-		return 0;
-	}
-
-	set_page_writeback(page);
-	fio.old_blkaddr = ni.blk_addr;
-	write_node_page(nid, &fio);
-	set_node_addr(sbi, &ni, fio.new_blkaddr, is_fsync_dnode(page));
-	dec_page_count(sbi, F2FS_DIRTY_NODES);
-	up_read(&sbi->node_write);
-
-	if (wbc->for_reclaim)
-		f2fs_submit_merged_bio_cond(sbi, NULL, page, 0, NODE, WRITE);
-
-	unlock_page(page);
-
-	if (unlikely(f2fs_cp_error(sbi)))
-		f2fs_submit_merged_bio(sbi, NODE, WRITE);
-
-	return 0;
-
-redirty_out:
-	redirty_page_for_writepage(wbc, page);
-	return AOP_WRITEPAGE_ACTIVATE;
 }
 
 static int f2fs_write_node_pages(struct address_space *mapping,
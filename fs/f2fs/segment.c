@@ -14,6 +14,7 @@
 #include <linux/blkdev.h>
 #include <linux/prefetch.h>
 #include <linux/kthread.h>
+#include <linux/freezer.h>
 #include <linux/swap.h>
 #include <linux/timer.h>
 #include <linux/delay.h>
@@ -383,6 +384,8 @@ void f2fs_balance_fs(struct f2fs_sb_info *sbi, bool need)
 	 * dir/node pages without enough free segments.
 	 */
 	if (has_not_enough_free_secs(sbi, 0)) {
+		ktime_t start = ktime_get();
+
 #ifdef CONFIG_HUAWEI_F2FS_DSM
 		/* report this behavor to DSM */
 		if (((FG_GC_count++ % 100) == 0) && f2fs_dclient
@@ -401,6 +404,8 @@ void f2fs_balance_fs(struct f2fs_sb_info *sbi, bool need)
 		/*lint -save -e747*/
 		f2fs_gc(sbi, false, false);
 		/*lint -restore*/
+		stat_update_fg_gc_stall(sbi,
+				ktime_us_delta(ktime_get(), start));
 	}
 }
 
@@ -542,6 +547,60 @@ void destroy_flush_cmd_control(struct f2fs_sb_info *sbi)
 	SM_I(sbi)->cmd_control_info = NULL;
 }
 
+static void __del_victim_entry(struct victim_index *vi,
+			       struct victim_entry *ve)
+{
+	list_del_init(&ve->list);
+	if (list_empty(&vi->buckets[ve->bucket]))
+		__clear_bit(ve->bucket, vi->nonempty);
+}
+
+/* requeue the section of @segno at the tail of its valid blocks bucket */
+static void __update_victim_index(struct f2fs_sb_info *sbi, unsigned int segno)
+{
+	struct victim_index *vi = &DIRTY_I(sbi)->victim_index;
+	struct victim_entry *ve;
+	unsigned int vblocks, bucket;
+
+	if (!vi->entries)
+		return;
+
+	vblocks = get_valid_blocks(sbi, segno, sbi->segs_per_sec);
+	bucket = vblocks * NR_VICTIM_BUCKETS /
+			(sbi->blocks_per_seg * sbi->segs_per_sec);
+	if (bucket >= NR_VICTIM_BUCKETS)
+		bucket = NR_VICTIM_BUCKETS - 1;
+
+	ve = &vi->entries[GET_SECNO(sbi, segno)];
+	if (!list_empty(&ve->list))
+		__del_victim_entry(vi, ve);
+	list_add_tail(&ve->list, &vi->buckets[bucket]);
+	ve->bucket = bucket;
+	__set_bit(bucket, vi->nonempty);
+}
+
+static void __remove_victim_index(struct f2fs_sb_info *sbi, unsigned int segno)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	struct victim_index *vi = &dirty_i->victim_index;
+	unsigned int start = GET_SECNO(sbi, segno) * sbi->segs_per_sec;
+	unsigned int end = start + sbi->segs_per_sec;
+	struct victim_entry *ve;
+
+	if (!vi->entries)
+		return;
+
+	/* the section stays a victim while another of its segments is dirty */
+	if (find_next_bit(dirty_i->dirty_segmap[DIRTY], end, start) < end) {
+		__update_victim_index(sbi, segno);
+		return;
+	}
+
+	ve = &vi->entries[GET_SECNO(sbi, segno)];
+	if (!list_empty(&ve->list))
+		__del_victim_entry(vi, ve);
+}
+
 static void __locate_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno,
 		enum dirty_type dirty_type)
 {
@@ -564,6 +623,8 @@ static void __locate_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno,
 		}
 		if (!test_and_set_bit(segno, dirty_i->dirty_segmap[t]))
 			dirty_i->nr_dirty[t]++;
+
+		__update_victim_index(sbi, segno);
 	}
 }
 
@@ -585,6 +646,8 @@ static void __remove_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno,
 		if (get_valid_blocks(sbi, segno, sbi->segs_per_sec) == 0)
 			clear_bit(GET_SECNO(sbi, segno),
 						dirty_i->victim_secmap);
+
+		__remove_victim_index(sbi, segno);
 	}
 }
 
@@ -618,15 +681,12 @@ static void locate_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno)
 	mutex_unlock(&dirty_i->seglist_lock);
 }
 
-static int f2fs_issue_discard(struct f2fs_sb_info *sbi,
+static void __set_discard_map(struct f2fs_sb_info *sbi,
 				block_t blkstart, block_t blklen)
 {
-	sector_t start = SECTOR_FROM_BLOCK(blkstart);
-	sector_t len = SECTOR_FROM_BLOCK(blklen);
 	struct seg_entry *se;
 	unsigned int offset;
 	block_t i;
-	int ret;
 
 	for (i = blkstart; i < blkstart + blklen; i++) {
 		se = get_seg_entry(sbi, GET_SEGNO(sbi, i));
@@ -635,11 +695,391 @@ static int f2fs_issue_discard(struct f2fs_sb_info *sbi,
 		if (!f2fs_test_and_set_bit(offset, se->discard_map))
 			sbi->discard_blks--;
 	}
+}
+
+static int f2fs_issue_discard(struct f2fs_sb_info *sbi,
+				block_t blkstart, block_t blklen)
+{
+	sector_t start = SECTOR_FROM_BLOCK(blkstart);
+	sector_t len = SECTOR_FROM_BLOCK(blklen);
+	int ret;
+
+	__set_discard_map(sbi, blkstart, blklen);
 	trace_f2fs_issue_discard(sbi->sb, blkstart, blklen);
 	ret = blkdev_issue_discard(sbi->sb->s_bdev, start, len, GFP_NOFS, 0);
 	return ret;
 }
 
+/* should be called with dcc->lock held */
+static bool __discard_pend_in_seg(struct f2fs_sb_info *sbi,
+				struct discard_cmd_control *dcc,
+				unsigned int segno)
+{
+	block_t seg_start = START_BLOCK(sbi, segno);
+	block_t seg_end = seg_start + sbi->blocks_per_seg;
+	struct discard_entry *entry;
+
+	list_for_each_entry(entry, &dcc->pend_list, list) {
+		if (entry->blkaddr >= seg_end)
+			break;
+		if (entry->blkaddr + entry->len > seg_start)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Put [blkstart, blkstart + blklen) in the address ordered pending list,
+ * merged with the ranges it touches. Returns false if @new was not used.
+ */
+static bool __insert_discard_range(struct discard_cmd_control *dcc,
+				struct discard_entry *new,
+				block_t blkstart, block_t blklen)
+{
+	struct list_head *head = &dcc->pend_list;
+	struct list_head *pos;
+	struct discard_entry *entry, *next;
+	block_t end = blkstart + blklen;
+	bool used = false;
+
+	/* new ranges mostly come in address order, look from the tail */
+	list_for_each_prev(pos, head) {
+		entry = list_entry(pos, struct discard_entry, list);
+		if (entry->blkaddr <= blkstart)
+			break;
+	}
+
+	entry = pos == head ? NULL : list_entry(pos, struct discard_entry, list);
+	if (entry && entry->blkaddr + entry->len >= blkstart) {
+		dcc->nr_pending -= entry->len;
+		entry->len = max(entry->blkaddr + entry->len, end) -
+							entry->blkaddr;
+	} else {
+		new->blkaddr = blkstart;
+		new->len = blklen;
+		list_add(&new->list, pos);
+		entry = new;
+		used = true;
+	}
+
+	while (!list_is_last(&entry->list, head)) {
+		next = list_next_entry(entry, list);
+		if (next->blkaddr > entry->blkaddr + entry->len)
+			break;
+		dcc->nr_pending -= next->len;
+		entry->len = max(entry->blkaddr + entry->len,
+				next->blkaddr + next->len) - entry->blkaddr;
+		list_del(&next->list);
+		kmem_cache_free(discard_entry_slab, next);
+	}
+	dcc->nr_pending += entry->len;
+
+	return used;
+}
+
+static void f2fs_queue_discard(struct f2fs_sb_info *sbi,
+				block_t blkstart, block_t blklen)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct discard_entry *new;
+	unsigned int segno, end_segno;
+	bool wake;
+
+	/* leave the small ones to fstrim */
+	if (blklen < SM_I(sbi)->discard_granularity)
+		return;
+
+	__set_discard_map(sbi, blkstart, blklen);
+
+	new = f2fs_kmem_cache_alloc(discard_entry_slab, GFP_NOFS);
+
+	spin_lock(&dcc->lock);
+	wake = list_empty(&dcc->pend_list);
+	if (__insert_discard_range(dcc, new, blkstart, blklen))
+		new = NULL;
+
+	end_segno = GET_SEGNO(sbi, blkstart + blklen - 1);
+	for (segno = GET_SEGNO(sbi, blkstart); segno <= end_segno; segno++)
+		__set_bit(segno, dcc->pend_segmap);
+
+	if (dcc->nr_pending >= SM_I(sbi)->max_discard_pending)
+		wake = true;
+	if (wake)
+		dcc->wake = 1;
+	spin_unlock(&dcc->lock);
+
+	if (new)
+		kmem_cache_free(discard_entry_slab, new);
+	if (wake)
+		wake_up(&dcc->discard_wait_queue);
+}
+
+static void f2fs_discard_range(struct f2fs_sb_info *sbi,
+				block_t blkstart, block_t blklen, bool sync)
+{
+	if (!sync && SM_I(sbi)->dcc_info)
+		f2fs_queue_discard(sbi, blkstart, blklen);
+	else
+		f2fs_issue_discard(sbi, blkstart, blklen);
+}
+
+/* should be called with dcc->lock held */
+static inline bool __discard_issuing(struct discard_cmd_control *dcc,
+				block_t start, block_t end)
+{
+	return dcc->issue_len && dcc->issue_start < end &&
+			dcc->issue_start + dcc->issue_len > start;
+}
+
+static bool discard_issuing(struct discard_cmd_control *dcc,
+				block_t start, block_t end)
+{
+	bool ret;
+
+	spin_lock(&dcc->lock);
+	ret = __discard_issuing(dcc, start, end);
+	spin_unlock(&dcc->lock);
+
+	return ret;
+}
+
+/*
+ * A block of @segno is being allocated again: drop what is still pending
+ * in that segment. Returns true if a discard of it is already issued,
+ * the caller then has to wait for it with f2fs_wait_discard() before
+ * writing the block, so that it cannot land after the new data.
+ */
+static bool __cancel_discard(struct f2fs_sb_info *sbi,
+				struct discard_cmd_control *dcc,
+				unsigned int segno)
+{
+	block_t seg_start = START_BLOCK(sbi, segno);
+	block_t seg_end = seg_start + sbi->blocks_per_seg;
+	struct discard_entry *entry, *this, *split;
+	bool issuing;
+
+	spin_lock(&dcc->lock);
+	list_for_each_entry_safe(entry, this, &dcc->pend_list, list) {
+		block_t end = entry->blkaddr + entry->len;
+
+		if (entry->blkaddr >= seg_end)
+			break;
+		if (end <= seg_start)
+			continue;
+
+		dcc->nr_pending -= entry->len;
+		if (entry->blkaddr < seg_start && end > seg_end) {
+			/* the tail is lost if there is no memory */
+			split = kmem_cache_alloc(discard_entry_slab,
+								GFP_ATOMIC);
+			if (split) {
+				split->blkaddr = seg_end;
+				split->len = end - seg_end;
+				list_add(&split->list, &entry->list);
+				dcc->nr_pending += split->len;
+			}
+			entry->len = seg_start - entry->blkaddr;
+		} else if (entry->blkaddr < seg_start) {
+			entry->len = seg_start - entry->blkaddr;
+		} else if (end > seg_end) {
+			entry->blkaddr = seg_end;
+			entry->len = end - seg_end;
+		} else {
+			list_del(&entry->list);
+			kmem_cache_free(discard_entry_slab, entry);
+			continue;
+		}
+		dcc->nr_pending += entry->len;
+	}
+	__clear_bit(segno, dcc->pend_segmap);
+	issuing = __discard_issuing(dcc, seg_start, seg_end);
+	spin_unlock(&dcc->lock);
+
+	return issuing;
+}
+
+/* called under curseg_mutex and sentry_lock, so it must not block */
+static inline bool f2fs_cancel_discard(struct f2fs_sb_info *sbi,
+					block_t blkaddr)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	unsigned int segno = GET_SEGNO(sbi, blkaddr);
+
+	if (dcc && test_bit(segno, dcc->pend_segmap))
+		return __cancel_discard(sbi, dcc, segno);
+	return false;
+}
+
+static void f2fs_wait_discard(struct f2fs_sb_info *sbi, block_t blkaddr)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	block_t seg_start = START_BLOCK(sbi, GET_SEGNO(sbi, blkaddr));
+
+	if (dcc)
+		wait_event(dcc->issue_wait_queue, !discard_issuing(dcc,
+				seg_start, seg_start + sbi->blocks_per_seg));
+}
+
+static bool __issue_pending_discard(struct f2fs_sb_info *sbi,
+				struct discard_cmd_control *dcc)
+{
+	block_t max_len = DISCARD_ISSUE_SEGS << sbi->log_blocks_per_seg;
+	struct discard_entry *entry;
+	unsigned int segno, start_segno, end_segno;
+	block_t start, len;
+
+	spin_lock(&dcc->lock);
+	if (list_empty(&dcc->pend_list)) {
+		spin_unlock(&dcc->lock);
+		return false;
+	}
+
+	entry = list_first_entry(&dcc->pend_list, struct discard_entry, list);
+	start = entry->blkaddr;
+	len = min_t(block_t, entry->len, max_len);
+	if (entry->len > len) {
+		entry->blkaddr += len;
+		entry->len -= len;
+	} else {
+		list_del(&entry->list);
+		kmem_cache_free(discard_entry_slab, entry);
+	}
+	dcc->nr_pending -= len;
+	dcc->issue_start = start;
+	dcc->issue_len = len;
+	spin_unlock(&dcc->lock);
+
+	trace_f2fs_issue_discard(sbi->sb, start, len);
+	blkdev_issue_discard(sbi->sb->s_bdev, SECTOR_FROM_BLOCK(start),
+				SECTOR_FROM_BLOCK(len), GFP_NOFS, 0);
+
+	start_segno = GET_SEGNO(sbi, start);
+	end_segno = GET_SEGNO(sbi, start + len - 1);
+
+	spin_lock(&dcc->lock);
+	dcc->issue_len = 0;
+	for (segno = start_segno; segno <= end_segno; segno++) {
+		/* only the edges can be shared with another range */
+		if ((segno == start_segno || segno == end_segno) &&
+				__discard_pend_in_seg(sbi, dcc, segno))
+			continue;
+		__clear_bit(segno, dcc->pend_segmap);
+	}
+	spin_unlock(&dcc->lock);
+
+	wake_up_all(&dcc->issue_wait_queue);
+	return true;
+}
+
+static inline bool __discard_urgent(struct f2fs_sb_info *sbi,
+				struct discard_cmd_control *dcc)
+{
+	return ACCESS_ONCE(dcc->nr_pending) >= SM_I(sbi)->max_discard_pending;
+}
+
+static int issue_discard_thread(void *data)
+{
+	struct f2fs_sb_info *sbi = data;
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	wait_queue_head_t *q = &dcc->discard_wait_queue;
+	long wait_time;
+
+	set_freezable();
+	set_user_nice(current, MAX_NICE);
+
+	do {
+		if (list_empty_careful(&dcc->pend_list))
+			wait_time = MAX_SCHEDULE_TIMEOUT;
+		else
+			wait_time = msecs_to_jiffies(DEF_DISCARD_IDLE_CHECK_TIME);
+
+		wait_event_interruptible_timeout(*q,
+				kthread_should_stop() || freezing(current) ||
+				ACCESS_ONCE(dcc->wake), wait_time);
+		dcc->wake = 0;
+
+		if (try_to_freeze())
+			continue;
+		if (kthread_should_stop())
+			break;
+		if (unlikely(f2fs_cp_error(sbi)))
+			continue;
+
+		while (!kthread_should_stop() &&
+				(__discard_urgent(sbi, dcc) ||
+				is_idle(sbi))) {
+			if (!__issue_pending_discard(sbi, dcc))
+				break;
+		}
+	} while (!kthread_should_stop());
+
+	return 0;
+}
+
+int create_discard_cmd_control(struct f2fs_sb_info *sbi)
+{
+	dev_t dev = sbi->sb->s_bdev->bd_dev;
+	struct discard_cmd_control *dcc;
+	int err = 0;
+
+	if (!blk_queue_discard(bdev_get_queue(sbi->sb->s_bdev)))
+		return 0;
+
+	dcc = kzalloc(sizeof(struct discard_cmd_control), GFP_KERNEL);
+	if (!dcc)
+		return -ENOMEM;
+
+	dcc->pend_segmap = f2fs_kvzalloc(f2fs_bitmap_size(MAIN_SEGS(sbi)),
+								GFP_KERNEL);
+	if (!dcc->pend_segmap) {
+		kfree(dcc);
+		return -ENOMEM;
+	}
+
+	init_waitqueue_head(&dcc->discard_wait_queue);
+	init_waitqueue_head(&dcc->issue_wait_queue);
+	spin_lock_init(&dcc->lock);
+	INIT_LIST_HEAD(&dcc->pend_list);
+	SM_I(sbi)->dcc_info = dcc;
+	dcc->f2fs_issue_discard = kthread_run(issue_discard_thread, sbi,
+				"f2fs_discard-%u:%u", MAJOR(dev), MINOR(dev));
+	if (IS_ERR(dcc->f2fs_issue_discard)) {
+		err = PTR_ERR(dcc->f2fs_issue_discard);
+		kvfree(dcc->pend_segmap);
+		kfree(dcc);
+		SM_I(sbi)->dcc_info = NULL;
+		return err;
+	}
+
+	return err;
+}
+
+/*
+ * The ranges still pending are issued here, at umount or when the discard
+ * option goes away, unless a checkpoint error stopped the fs: those are
+ * dropped and fstrim finds them in the next mount.
+ */
+void destroy_discard_cmd_control(struct f2fs_sb_info *sbi)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct discard_entry *entry, *this;
+
+	if (!dcc)
+		return;
+
+	kthread_stop(dcc->f2fs_issue_discard);
+	if (!f2fs_cp_error(sbi))
+		while (__issue_pending_discard(sbi, dcc))
+			;
+	list_for_each_entry_safe(entry, this, &dcc->pend_list, list) {
+		list_del(&entry->list);
+		kmem_cache_free(discard_entry_slab, entry);
+	}
+	kvfree(dcc->pend_segmap);
+	kfree(dcc);
+	SM_I(sbi)->dcc_info = NULL;
+}
+
 bool discard_next_dnode(struct f2fs_sb_info *sbi, block_t blkaddr)
 {
 	int err = -EOPNOTSUPP;
@@ -783,8 +1223,8 @@ void clear_prefree_segments(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 		if (force || !test_opt(sbi, DISCARD))
 			continue;
 
-		f2fs_issue_discard(sbi, START_BLOCK(sbi, start),
-				(end - start) << sbi->log_blocks_per_seg);
+		f2fs_discard_range(sbi, START_BLOCK(sbi, start),
+				(end - start) << sbi->log_blocks_per_seg, false);
 	}
 	mutex_unlock(&dirty_i->seglist_lock);
 
@@ -792,7 +1232,7 @@ void clear_prefree_segments(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 	list_for_each_entry_safe(entry, this, head, list) {
 		if (force && entry->len < cpc->trim_minlen)
 			goto skip;
-		f2fs_issue_discard(sbi, entry->blkaddr, entry->len);
+		f2fs_discard_range(sbi, entry->blkaddr, entry->len, force);
 		cpc->trimmed += entry->len;
 skip:
 		list_del(&entry->list);
@@ -1418,6 +1858,7 @@ void allocate_data_block(struct f2fs_sb_info *sbi, struct page *page,
 	struct sit_info *sit_i = SIT_I(sbi);
 	struct curseg_info *curseg;
 	bool direct_io = (type == CURSEG_DIRECT_IO);
+	bool wait_discard;
 
 	type = direct_io ? CURSEG_WARM_DATA : type;
 
@@ -1432,6 +1873,7 @@ void allocate_data_block(struct f2fs_sb_info *sbi, struct page *page,
 		__allocate_new_segments(sbi, type);
 
 	*new_blkaddr = NEXT_FREE_BLKADDR(sbi, curseg);
+	wait_discard = f2fs_cancel_discard(sbi, *new_blkaddr);
 
 	/*
 	 * __add_sum_entry should be resided under the curseg_mutex
@@ -1458,6 +1900,10 @@ void allocate_data_block(struct f2fs_sb_info *sbi, struct page *page,
 		fill_node_footer_blkaddr(page, NEXT_FREE_BLKADDR(sbi, curseg));
 
 	mutex_unlock(&curseg->curseg_mutex);
+
+	/* the block is written by the caller, only after this returns */
+	if (wait_discard)
+		f2fs_wait_discard(sbi, *new_blkaddr);
 }
 
 static void do_write_page(struct f2fs_summary *sum, struct f2fs_io_info *fio)
@@ -2376,6 +2822,24 @@ static int init_victim_secmap(struct f2fs_sb_info *sbi)
 	return 0;
 }
 
+/* GC falls back to scanning the dirty segmap if this fails */
+static void init_victim_index(struct f2fs_sb_info *sbi)
+{
+	struct victim_index *vi = &DIRTY_I(sbi)->victim_index;
+	unsigned int i;
+
+	for (i = 0; i < NR_VICTIM_BUCKETS; i++)
+		INIT_LIST_HEAD(&vi->buckets[i]);
+
+	vi->entries = f2fs_kvzalloc(MAIN_SECS(sbi) * sizeof(*vi->entries),
+				    GFP_KERNEL);
+	if (!vi->entries)
+		return;
+
+	for (i = 0; i < MAIN_SECS(sbi); i++)
+		INIT_LIST_HEAD(&vi->entries[i].list);
+}
+
 static int build_dirty_segmap(struct f2fs_sb_info *sbi)
 {
 	struct dirty_seglist_info *dirty_i;
@@ -2397,6 +2861,7 @@ static int build_dirty_segmap(struct f2fs_sb_info *sbi)
 			return -ENOMEM;
 	}
 
+	init_victim_index(sbi);
 	init_dirty_segmap(sbi);
 	return init_victim_secmap(sbi);
 }
@@ -2458,6 +2923,8 @@ int build_segment_manager(struct f2fs_sb_info *sbi)
 	INIT_LIST_HEAD(&sm_info->discard_list);
 	sm_info->nr_discards = 0;
 	sm_info->max_discards = 0;
+	sm_info->discard_granularity = DEF_DISCARD_GRANULARITY;
+	sm_info->max_discard_pending = DEF_MAX_DISCARD_PENDING;
 
 	sm_info->trim_sections = DEF_BATCHED_TRIM_SECTIONS;
 
@@ -2469,6 +2936,12 @@ int build_segment_manager(struct f2fs_sb_info *sbi)
 			return err;
 	}
 
+	if (test_opt(sbi, DISCARD) && !f2fs_readonly(sbi->sb)) {
+		err = create_discard_cmd_control(sbi);
+		if (err)
+			return err;
+	}
+
 	err = build_sit_info(sbi);
 	if (err)
 		return err;
@@ -2506,6 +2979,7 @@ static void destroy_victim_secmap(struct f2fs_sb_info *sbi)
 {
 	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
 	kvfree(dirty_i->victim_secmap);
+	kvfree(dirty_i->victim_index.entries);
 }
 
 static void destroy_dirty_segmap(struct f2fs_sb_info *sbi)
@@ -2584,6 +3058,7 @@ void destroy_segment_manager(struct f2fs_sb_info *sbi)
 	if (!sm_info)
 		return;
 	destroy_flush_cmd_control(sbi);
+	destroy_discard_cmd_control(sbi);
 	destroy_dirty_segmap(sbi);
 	destroy_curseg(sbi);
 	destroy_free_segmap(sbi);
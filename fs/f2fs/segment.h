@@ -240,12 +240,31 @@ enum dirty_type {
 	NR_DIRTY_TYPE
 };
 
+/*
+ * Dirty sections bucketed by valid blocks for GC victim selection. Each
+ * bucket is kept in update order, so its head is the section that was
+ * least recently written to. Protected by seglist_lock.
+ */
+#define NR_VICTIM_BUCKETS	64
+
+struct victim_entry {
+	struct list_head list;			/* in buckets[bucket] if dirty */
+	unsigned int bucket;
+};
+
+struct victim_index {
+	struct victim_entry *entries;		/* per section, NULL if off */
+	struct list_head buckets[NR_VICTIM_BUCKETS];
+	DECLARE_BITMAP(nonempty, NR_VICTIM_BUCKETS);
+};
+
 struct dirty_seglist_info {
 	const struct victim_selection *v_ops;	/* victim selction operation */
 	unsigned long *dirty_segmap[NR_DIRTY_TYPE];
 	struct mutex seglist_lock;		/* lock for segment bitmaps */
 	int nr_dirty[NR_DIRTY_TYPE];		/* # of dirty segments */
 	unsigned long *victim_secmap;		/* background GC victims */
+	struct victim_index victim_index;	/* dirty sections for LFS GC */
 };
 
 /* victim selection function for cleaning and SSR */
@@ -513,6 +532,17 @@ static inline int utilization(struct f2fs_sb_info *sbi)
 #define DEF_MIN_IPU_UTIL	70
 #define DEF_MIN_FSYNC_BLOCKS	20
 
+/*
+ * Discards found at checkpoint are queued and issued by the discard
+ * thread once the device is idle, or right away when more than
+ * max_discard_pending blocks wait. Ranges shorter than
+ * discard_granularity are left to fstrim.
+ */
+#define DEF_DISCARD_GRANULARITY		16
+#define DEF_MAX_DISCARD_PENDING		(1 << 18)	/* 1GB */
+#define DEF_DISCARD_IDLE_CHECK_TIME	1000		/* ms */
+#define DISCARD_ISSUE_SEGS		16	/* max. segments per command */
+
 enum {
 	F2FS_IPU_FORCE,
 	F2FS_IPU_SSR,
@@ -284,9 +284,16 @@ F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_min_sleep_time, min_sleep_time);
 F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_max_sleep_time, max_sleep_time);
 F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_no_gc_sleep_time, no_gc_sleep_time);
 F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_idle, gc_idle);
+#ifdef CONFIG_F2FS_GC_IDLE_AWARE
+F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_urgent_sleep_time,
+						urgent_sleep_time);
+F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_urgent_margin, urgent_margin);
+#endif
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, reclaim_segments, rec_prefree_segments);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, max_small_discards, max_discards);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, batched_trim_sections, trim_sections);
+F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, discard_granularity, discard_granularity);
+F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, max_discard_pending, max_discard_pending);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, ipu_policy, ipu_policy);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, min_ipu_util, min_ipu_util);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, min_fsync_blocks, min_fsync_blocks);
@@ -297,6 +304,14 @@ F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, max_victim_search, max_victim_search);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, dir_level, dir_level);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, cp_interval, interval_time[CP_TIME]);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, idle_interval, interval_time[REQ_TIME]);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, cp_preflush, cp_preflush);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, extent_precache_kb, extent_precache_kb);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, dir_index_min_blocks, dir_index_min_blocks);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, atomic_commit_fua, atomic_commit_fua);
+#ifdef CONFIG_F2FS_STAT_STREAM
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, stat_stream_interval_ms,
+					stat_stream_interval_ms);
+#endif
 F2FS_GENERAL_RO_ATTR(lifetime_write_kbytes);
 
 #define ATTR_LIST(name) (&f2fs_attr_##name.attr)
@@ -305,9 +320,15 @@ static struct attribute *f2fs_attrs[] = {
 	ATTR_LIST(gc_max_sleep_time),
 	ATTR_LIST(gc_no_gc_sleep_time),
 	ATTR_LIST(gc_idle),
+#ifdef CONFIG_F2FS_GC_IDLE_AWARE
+	ATTR_LIST(gc_urgent_sleep_time),
+	ATTR_LIST(gc_urgent_margin),
+#endif
 	ATTR_LIST(reclaim_segments),
 	ATTR_LIST(max_small_discards),
 	ATTR_LIST(batched_trim_sections),
+	ATTR_LIST(discard_granularity),
+	ATTR_LIST(max_discard_pending),
 	ATTR_LIST(ipu_policy),
 	ATTR_LIST(min_ipu_util),
 	ATTR_LIST(min_fsync_blocks),
@@ -318,6 +339,13 @@ static struct attribute *f2fs_attrs[] = {
 	ATTR_LIST(dirty_nats_ratio),
 	ATTR_LIST(cp_interval),
 	ATTR_LIST(idle_interval),
+	ATTR_LIST(cp_preflush),
+	ATTR_LIST(extent_precache_kb),
+	ATTR_LIST(dir_index_min_blocks),
+	ATTR_LIST(atomic_commit_fua),
+#ifdef CONFIG_F2FS_STAT_STREAM
+	ATTR_LIST(stat_stream_interval_ms),
+#endif
 	ATTR_LIST(lifetime_write_kbytes),
 	NULL,
 };
@@ -1039,6 +1067,8 @@ static int f2fs_remount(struct super_block *sb, int *flags, char *data)
 	int err, active_logs;
 	bool need_restart_gc = false;
 	bool need_stop_gc = false;
+	bool need_restart_discard = false;
+	bool need_stop_discard = false;
 	bool no_extent_cache = !test_opt(sbi, EXTENT_CACHE);
 
 	/*
@@ -1098,6 +1128,22 @@ static int f2fs_remount(struct super_block *sb, int *flags, char *data)
 		clear_sbi_flag(sbi, SBI_IS_CLOSE);
 	}
 
+	/*
+	 * The same for the discard thread and the discard option, the
+	 * pending discards are issued when it stops.
+	 */
+	if ((*flags & MS_RDONLY) || !test_opt(sbi, DISCARD)) {
+		if (SM_I(sbi)->dcc_info) {
+			destroy_discard_cmd_control(sbi);
+			need_restart_discard = true;
+		}
+	} else if (!SM_I(sbi)->dcc_info) {
+		err = create_discard_cmd_control(sbi);
+		if (err)
+			goto restore_gc;
+		need_stop_discard = true;
+	}
+
 	/*
 	 * We stop issue flush thread if FS is mounted as RO
 	 * or if flush_merge is not passed in mount option.
@@ -1107,13 +1153,21 @@ static int f2fs_remount(struct super_block *sb, int *flags, char *data)
 	} else if (!SM_I(sbi)->cmd_control_info) {
 		err = create_flush_cmd_control(sbi);
 		if (err)
-			goto restore_gc;
+			goto restore_discard;
 	}
 skip:
 	/* Update the POSIXACL Flag */
 	 sb->s_flags = (sb->s_flags & ~MS_POSIXACL) |
 		(test_opt(sbi, POSIX_ACL) ? MS_POSIXACL : 0);
 	return 0;
+restore_discard:
+	if (need_restart_discard) {
+		if (create_discard_cmd_control(sbi))
+			f2fs_msg(sbi->sb, KERN_WARNING,
+				"discard thread has stopped");
+	} else if (need_stop_discard) {
+		destroy_discard_cmd_control(sbi);
+	}
 restore_gc:
 	if (need_restart_gc) {
 		if (start_gc_thread(sbi))
@@ -1514,6 +1568,9 @@ static void init_sb_info(struct f2fs_sb_info *sbi)
 	sbi->meta_ino_num = le32_to_cpu(raw_super->meta_ino);
 	sbi->cur_victim_sec = NULL_SECNO;
 	sbi->max_victim_search = DEF_MAX_VICTIM_SEARCH;
+	sbi->cp_preflush = 1;
+	sbi->extent_precache_kb = DEF_EXTENT_PRECACHE_KB;
+	sbi->atomic_commit_fua = 1;
 
 	for (i = 0; i < NR_COUNT_TYPE; i++)
 		atomic_set(&sbi->nr_pages[i], 0);
@@ -1752,6 +1809,7 @@ try_onemore:
 	}
 
 	init_extent_cache_info(sbi);
+	init_dir_index_info(sbi);
 
 	init_ino_entry_info(sbi);
 
@@ -2032,10 +2090,13 @@ static int __init init_f2fs_fs(void)
 	err = create_extent_cache();
 	if (err)
 		goto free_checkpoint_caches;
+	err = create_dir_index_cache();
+	if (err)
+		goto free_extent_cache;
 	f2fs_kset = kset_create_and_add("f2fs", NULL, fs_kobj);
 	if (!f2fs_kset) {
 		err = -ENOMEM;
-		goto free_extent_cache;
+		goto free_dir_index_cache;
 	}
 	err = register_shrinker(&f2fs_shrinker_info);
 	if (err)
@@ -2064,6 +2125,8 @@ free_shrinker:
 	unregister_shrinker(&f2fs_shrinker_info);
 free_kset:
 	kset_unregister(f2fs_kset);
+free_dir_index_cache:
+	destroy_dir_index_cache();
 free_extent_cache:
 	destroy_extent_cache();
 free_checkpoint_caches:
@@ -2084,6 +2147,7 @@ static void __exit exit_f2fs_fs(void)
 	f2fs_destroy_root_stats();
 	unregister_shrinker(&f2fs_shrinker_info);
 	unregister_filesystem(&f2fs_fs_type);
+	destroy_dir_index_cache();
 	destroy_extent_cache();
 	destroy_checkpoint_caches();
 	destroy_segment_manager_caches();
@@ -322,7 +322,7 @@ static u64 fuse_get_unique(struct fuse_conn *fc)
 	return fc->reqctr;
 }
 
-static void queue_request(struct fuse_conn *fc, struct fuse_req *req)
+static void __queue_request(struct fuse_conn *fc, struct fuse_req *req)
 {
 	req->in.h.len = sizeof(struct fuse_in_header) +
 		len_args(req->in.numargs, (struct fuse_arg *) req->in.args);
@@ -332,6 +332,11 @@ static void queue_request(struct fuse_conn *fc, struct fuse_req *req)
 		req->waiting = 1;
 		atomic_inc(&fc->num_waiting);
 	}
+}
+
+static void queue_request(struct fuse_conn *fc, struct fuse_req *req)
+{
+	__queue_request(fc, req);
 	wake_up(&fc->waitq);
 	kill_fasync(&fc->fasync, SIGIO, POLL_IN);
 }
@@ -356,6 +361,8 @@ void fuse_queue_forget(struct fuse_conn *fc, struct fuse_forget_link *forget,
 
 static void flush_bg_queue(struct fuse_conn *fc)
 {
+	int queued = 0;
+
 	while (fc->active_background < fc->max_background &&
 	       !list_empty(&fc->bg_queue)) {
 		struct fuse_req *req;
@@ -364,7 +371,21 @@ static void flush_bg_queue(struct fuse_conn *fc)
 		list_del(&req->list);
 		fc->active_background++;
 		req->in.h.unique = fuse_get_unique(fc);
-		queue_request(fc, req);
+		__queue_request(fc, req);
+		queued++;
+	}
+
+	/*
+	 * One reader per request, but no more: a batching reader may take
+	 * several at once and the others would only find the list empty.
+	 */
+	if (queued) {
+		if (fc->read_batch)
+			wake_up(&fc->waitq);
+		else
+			while (queued--)
+				wake_up(&fc->waitq);
+		kill_fasync(&fc->fasync, SIGIO, POLL_IN);
 	}
 }
 
@@ -1268,6 +1289,37 @@ __releases(fc->lock)
  * request_end().  Otherwise add it to the processing list, and set
  * the 'sent' flag.
  */
+/*
+ * With FUSE_READ_BATCH, a read of the device goes on with the next pending
+ * request as long as it fits in what is left of the buffer. Interrupts are
+ * left for the next read, so they don't wait behind a long batch. A splice
+ * read is limited by the pipe and returns a single request.
+ */
+static struct fuse_req *fuse_read_batch_next(struct fuse_conn *fc,
+					     struct fuse_copy_state *cs,
+					     size_t nbytes)
+{
+	struct fuse_req *req = NULL;
+
+	if (!fc->read_batch || cs->pipebufs)
+		return NULL;
+
+	spin_lock(&fc->lock);
+	if (fc->connected && list_empty(&fc->interrupts) &&
+	    !list_empty(&fc->pending)) {
+		req = list_entry(fc->pending.next, struct fuse_req, list);
+		if (req->in.h.len <= nbytes) {
+			req->state = FUSE_REQ_READING;
+			list_move(&req->list, &fc->io);
+		} else {
+			req = NULL;
+		}
+	}
+	spin_unlock(&fc->lock);
+
+	return req;
+}
+
 static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 				struct fuse_copy_state *cs, size_t nbytes)
 {
@@ -1275,6 +1327,7 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 	struct fuse_req *req;
 	struct fuse_in *in;
 	unsigned reqsize;
+	ssize_t copied = 0;
 
  restart:
 	spin_lock(&fc->lock);
@@ -1321,22 +1374,24 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 		goto restart;
 	}
 	spin_unlock(&fc->lock);
+ copy:
 	cs->req = req;
 	err = fuse_copy_one(cs, &in->h, sizeof(in->h));
 	if (!err)
 		err = fuse_copy_args(cs, in->numargs, in->argpages,
 				     (struct fuse_arg *) in->args, 0);
-	fuse_copy_finish(cs);
 	spin_lock(&fc->lock);
 	req->locked = 0;
 	if (req->aborted) {
 		request_end(fc, req);
-		return -ENODEV;
+		fuse_copy_finish(cs);
+		return copied ? copied : -ENODEV;
 	}
 	if (err) {
 		req->out.h.error = -EIO;
 		request_end(fc, req);
-		return err;
+		fuse_copy_finish(cs);
+		return copied ? copied : err;
 	}
 	if (!req->isreply)
 		request_end(fc, req);
@@ -1347,7 +1402,18 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 			queue_interrupt(fc, req);
 		spin_unlock(&fc->lock);
 	}
-	return reqsize;
+	copied += reqsize;
+	nbytes -= reqsize;
+
+	/* the copy state still maps the rest of the buffer, keep it */
+	req = fuse_read_batch_next(fc, cs, nbytes);
+	if (req) {
+		in = &req->in;
+		reqsize = in->h.len;
+		goto copy;
+	}
+	fuse_copy_finish(cs);
+	return copied;
 
  err_unlock:
 	spin_unlock(&fc->lock);
@@ -1725,7 +1791,7 @@ static int fuse_retrieve(struct fuse_conn *fc, struct inode *inode,
 		num = file_size - outarg->offset;
 
 	num_pages = (num + offset + PAGE_SIZE - 1) >> PAGE_SHIFT;
-	num_pages = min(num_pages, FUSE_MAX_PAGES_PER_REQ);
+	num_pages = min_t(unsigned int, num_pages, fc->max_pages);
 
 	req = fuse_get_req(fc, num_pages);
 	if (IS_ERR(req))
@@ -2590,6 +2590,9 @@ static const struct pid_entry tgid_base_stuff[] = {
 #ifdef CONFIG_HISI_SWAP_ZDATA
 	ONE("reclaim_result",      S_IRUSR, process_reclaim_result_read),
 #endif
+#ifdef CONFIG_PROCESS_RECLAIM_ASYNC
+	REG("reclaim_async", S_IWUSR, proc_reclaim_async_operations),
+#endif
 #endif
 #ifdef CONFIG_PROC_PAGE_MONITOR
 	REG("clear_refs", S_IWUSR, proc_clear_refs_operations),
@@ -210,11 +210,13 @@ extern const struct inode_operations proc_link_inode_operations;
 
 extern const struct inode_operations proc_pid_link_inode_operations;
 extern const struct file_operations proc_reclaim_operations;
+extern const struct file_operations proc_reclaim_async_operations;
 
 #ifdef CONFIG_HISI_SMART_RECLAIM
-extern void smart_soft_shrink(struct mm_struct *);
+extern void smart_soft_shrink(struct task_struct *, struct mm_struct *);
 #else
-static inline void smart_soft_shrink(void) { }
+static inline void smart_soft_shrink(struct task_struct *task,
+				     struct mm_struct *mm) { }
 #endif
 
 extern void proc_init_inodecache(void);
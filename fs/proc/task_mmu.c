@@ -15,6 +15,7 @@
 #include <linux/mmu_notifier.h>
 #include <linux/mm_inline.h>
 #include <linux/ctype.h>
+#include <linux/rcc_uid_stat.h>
 
 #include <asm/elf.h>
 #include <asm/uaccess.h>
@@ -24,6 +25,11 @@
 #ifdef CONFIG_HISI_SWAP_ZDATA
 #include <linux/signal.h>
 #endif
+#ifdef CONFIG_PROCESS_RECLAIM_ASYNC
+#include <linux/workqueue.h>
+#include <linux/topology.h>
+#include <linux/timekeeping.h>
+#endif
 
 void task_mem(struct seq_file *m, struct mm_struct *mm)
 {
@@ -1507,6 +1513,8 @@ struct reclaim_walk_data {
 	struct vm_area_struct *vma;
 	bool inactive_lru;
 	enum reclaim_type type;
+	unsigned long nr_to_reclaim;	/* 0 for no limit */
+	bool clean_only;		/* skip dirty file pages */
 };
 
 static int swapin_pte_range(pmd_t *pmd, unsigned long addr,
@@ -1572,6 +1580,9 @@ cont:
 			continue;
 		if (walk_data->type == RECLAIM_FILE && PageAnon(page))
 			continue;
+		if (walk_data->clean_only && !PageAnon(page) &&
+		    (pte_dirty(ptent) || PageDirty(page)))
+			continue;
 
 		if (isolate_lru_page(page))
 			continue;
@@ -1587,6 +1598,9 @@ cont:
 #ifdef CONFIG_HISI_SWAP_ZDATA
 	walk->nr_reclaimed += reclaim_pages_from_list(&page_list, vma,
 				walk->hiber, &walk->nr_writedblock);
+	if (walk_data->nr_to_reclaim &&
+	    walk->nr_reclaimed >= walk_data->nr_to_reclaim)
+		return 1;
 #else
 	reclaim_pages_from_list(&page_list, vma);
 #endif
@@ -1701,7 +1715,7 @@ static ssize_t reclaim_write(struct file *file, const char __user *buf,
 
 	//here we add a soft shrinker for reclaim
 	if (type == RECLAIM_SOFT) {
-		smart_soft_shrink(mm);
+		smart_soft_shrink(task, mm);
 		mmput(mm);
 		goto out;
 	}
@@ -1711,6 +1725,7 @@ static ssize_t reclaim_write(struct file *file, const char __user *buf,
 
 	reclaim_walk.mm = mm;
 	reclaim_walk.pmd_entry = reclaim_pte_range;
+	rcc_uid_reclaim_begin(from_kuid(&init_user_ns, task_uid(task)));
 
 #ifdef CONFIG_HISI_SWAP_ZDATA
 	if (reclaim_walk.hiber)
@@ -1757,6 +1772,7 @@ static ssize_t reclaim_write(struct file *file, const char __user *buf,
 	}
 	flush_tlb_mm(mm);
 	up_read(&mm->mmap_sem);
+	rcc_uid_reclaim_end();
 	mmput(mm);
 #ifdef CONFIG_HISI_SWAP_ZDATA
 	if (reclaim_walk.hiber) {
@@ -1780,6 +1796,185 @@ const struct file_operations proc_reclaim_operations = {
 	.write		= reclaim_write,
 	.llseek		= noop_llseek,
 };
+
+#ifdef CONFIG_PROCESS_RECLAIM_ASYNC
+/*
+ * "anon <nr_pages>" or "file <nr_pages>" written to /proc/<pid>/reclaim_async
+ * queues the reclaim of up to nr_pages of that type from the task and
+ * returns at once. Anon pages go to swap, only clean file pages are
+ * dropped. The work runs on an unbound workqueue kept on the cluster
+ * of cpu0, the little one, and its cpumask can be changed in
+ * /sys/devices/virtual/workqueue/proc_reclaim/. The amount reclaimed
+ * and the time spent are read from /proc/<pid>/reclaim_result.
+ */
+#define RECLAIM_ASYNC_MAX_PENDING	64
+
+struct reclaim_async_work {
+	struct work_struct work;
+	struct task_struct *task;
+	enum reclaim_type type;
+	unsigned long nr_pages;
+};
+
+static struct workqueue_struct *reclaim_async_wq;
+static atomic_t reclaim_async_pending = ATOMIC_INIT(0);
+
+static void reclaim_async_fn(struct work_struct *work)
+{
+	struct reclaim_async_work *rw =
+		container_of(work, struct reclaim_async_work, work);
+	struct reclaim_walk_data walk_data = {NULL, false, rw->type,
+					      rw->nr_pages, true};
+	struct mm_walk reclaim_walk = {};
+	struct vm_area_struct *vma;
+	struct mm_struct *mm;
+	u64 start_ns;
+
+	mm = get_task_mm(rw->task);
+	if (!mm)
+		goto out;
+
+	start_ns = ktime_get_ns();
+	reclaim_walk.mm = mm;
+	reclaim_walk.pmd_entry = reclaim_pte_range;
+	reclaim_walk.private = &walk_data;
+	rcc_uid_reclaim_begin(from_kuid(&init_user_ns, task_uid(rw->task)));
+
+	down_read(&mm->mmap_sem);
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (is_vm_hugetlb_page(vma))
+			continue;
+		if (fatal_signal_pending(rw->task))
+			break;
+
+		walk_data.vma = vma;
+		if (walk_page_range(vma->vm_start, vma->vm_end, &reclaim_walk))
+			break;
+	}
+	flush_tlb_mm(mm);
+	up_read(&mm->mmap_sem);
+	rcc_uid_reclaim_end();
+	mmput(mm);
+
+	process_reclaim_result_write(rw->task, reclaim_walk.nr_reclaimed,
+			reclaim_walk.nr_writedblock, ktime_get_ns() - start_ns);
+out:
+	put_task_struct(rw->task);
+	kfree(rw);
+	atomic_dec(&reclaim_async_pending);
+}
+
+static int __process_reclaim_async(struct task_struct *task,
+				   enum reclaim_type type,
+				   unsigned long nr_pages)
+{
+	struct reclaim_async_work *rw;
+
+	if (!reclaim_async_wq)
+		return -ENODEV;
+
+	if (atomic_inc_return(&reclaim_async_pending) >
+	    RECLAIM_ASYNC_MAX_PENDING) {
+		atomic_dec(&reclaim_async_pending);
+		return -EBUSY;
+	}
+
+	rw = kmalloc(sizeof(*rw), GFP_KERNEL);
+	if (!rw) {
+		atomic_dec(&reclaim_async_pending);
+		return -ENOMEM;
+	}
+
+	get_task_struct(task);
+	INIT_WORK(&rw->work, reclaim_async_fn);
+	rw->task = task;
+	rw->type = type;
+	rw->nr_pages = nr_pages;
+	queue_work(reclaim_async_wq, &rw->work);
+	return 0;
+}
+
+/*
+ * Queues the reclaim of up to @nr_pages anon (to swap) or clean file
+ * pages of @task, as /proc/<pid>/reclaim_async does.
+ */
+int process_reclaim_async(struct task_struct *task, bool anon,
+			  unsigned long nr_pages)
+{
+	if (!nr_pages)
+		return -EINVAL;
+
+	return __process_reclaim_async(task,
+				       anon ? RECLAIM_ANON : RECLAIM_FILE,
+				       nr_pages);
+}
+
+static ssize_t reclaim_async_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct task_struct *task;
+	enum reclaim_type type;
+	unsigned long nr_pages;
+	char buffer[32];
+	char *str, *token;
+	int ret;
+
+	if (!reclaim_async_wq)
+		return -ENODEV;
+
+	memset(buffer, 0, sizeof(buffer));
+	if (count > sizeof(buffer) - 1)
+		count = sizeof(buffer) - 1;
+	if (copy_from_user(buffer, buf, count))
+		return -EFAULT;
+
+	str = strstrip(buffer);
+	token = strsep(&str, " ");
+	if (!strcmp(token, "anon"))
+		type = RECLAIM_ANON;
+	else if (!strcmp(token, "file"))
+		type = RECLAIM_FILE;
+	else
+		return -EINVAL;
+	if (!str || kstrtoul(skip_spaces(str), 0, &nr_pages) || !nr_pages)
+		return -EINVAL;
+
+	task = get_proc_task(file->f_path.dentry->d_inode);
+	if (!task)
+		return -ESRCH;
+
+	ret = __process_reclaim_async(task, type, nr_pages);
+	put_task_struct(task);
+
+	return ret ? ret : count;
+}
+
+const struct file_operations proc_reclaim_async_operations = {
+	.write		= reclaim_async_write,
+	.llseek		= noop_llseek,
+};
+
+static int __init reclaim_async_init(void)
+{
+	struct workqueue_attrs *attrs;
+
+	reclaim_async_wq = alloc_workqueue("proc_reclaim",
+				WQ_UNBOUND | WQ_FREEZABLE | WQ_SYSFS, 0);
+	if (!reclaim_async_wq)
+		return -ENOMEM;
+
+	attrs = alloc_workqueue_attrs(GFP_KERNEL);
+	if (attrs) {
+		cpumask_copy(attrs->cpumask, topology_core_cpumask(0));
+		attrs->nice = MAX_NICE;
+		if (apply_workqueue_attrs(reclaim_async_wq, attrs))
+			pr_warn("proc_reclaim: keeps the default cpumask\n");
+		free_workqueue_attrs(attrs);
+	}
+	return 0;
+}
+late_initcall(reclaim_async_init);
+#endif /* CONFIG_PROCESS_RECLAIM_ASYNC */
 #endif
 #ifdef CONFIG_NUMA
 
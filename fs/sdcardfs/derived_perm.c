@@ -20,6 +20,19 @@
 
 #include "sdcardfs.h"
 
+/* source of derive_seq values, never reused for another state */
+static atomic_t derive_seq = ATOMIC_INIT(0);
+
+static unsigned int next_derive_seq(void)
+{
+	unsigned int seq;
+
+	do {
+		seq = (unsigned int)atomic_inc_return(&derive_seq);
+	} while (!seq);
+	return seq;
+}
+
 /* copy derived state from parent inode */
 static void inherit_derived_state(struct inode *parent, struct inode *child)
 {
@@ -45,6 +58,25 @@ void setup_derived_state(struct inode *inode, perm_t perm,
 	info->d_uid = uid;
 	info->d_gid = gid;
 	info->d_mode = mode;
+	info->derive_seq = next_derive_seq();
+}
+
+/* forget the cached derived state, e.g. once the dentry got a new name */
+void reset_derived_permission(struct inode *inode)
+{
+	SDCARDFS_I(inode)->derive_parent_seq = 0;
+}
+
+static bool derived_permission_valid(struct sdcardfs_sb_info *sbi,
+				     struct sdcardfs_inode_info *info,
+				     struct sdcardfs_inode_info *parent_info,
+				     struct dentry *dentry)
+{
+	return info->derive_seq && parent_info->derive_seq &&
+	       info->derive_parent_seq == parent_info->derive_seq &&
+	       info->derive_name_hash == dentry->d_name.hash &&
+	       (sbi->options.derive == DERIVE_NONE ||
+		info->derive_pkgl_gen == get_packagelist_generation(sbi->pkgl_id));
 }
 
 void get_derived_permission(struct dentry *parent, struct dentry *dentry)
@@ -53,6 +85,11 @@ void get_derived_permission(struct dentry *parent, struct dentry *dentry)
 	struct sdcardfs_inode_info *info = SDCARDFS_I(dentry->d_inode);
 	struct sdcardfs_inode_info *parent_info = SDCARDFS_I(parent->d_inode);
 	appid_t appid;
+	unsigned int pkgl_gen = 0;
+
+	/* Nothing the state depends on has changed since it was derived */
+	if (derived_permission_valid(sbi, info, parent_info, dentry))
+		return;
 
 	/* By default, each inode inherits from its parent.
 	 * the properties are maintained on its private fields
@@ -68,9 +105,14 @@ void get_derived_permission(struct dentry *parent, struct dentry *dentry)
 	   dentry->d_name.name, parent_info->perm); */
 
 	if (sbi->options.derive == DERIVE_NONE) {
-		return;
+		goto out;
 	}
 
+	/* read before the lookups below, a reload racing with them is
+	 * then caught by the next call */
+	pkgl_gen = get_packagelist_generation(sbi->pkgl_id);
+	smp_rmb();
+
 	/* Derive custom permissions based on parent and current node */
 	switch (parent_info->perm) {
 	case PERM_INHERIT:
@@ -140,6 +182,11 @@ void get_derived_permission(struct dentry *parent, struct dentry *dentry)
 		info->d_gid = AID_SDCARD_R;
 		break;
 	}
+out:
+	info->derive_seq = next_derive_seq();
+	info->derive_parent_seq = parent_info->derive_seq;
+	info->derive_name_hash = dentry->d_name.hash;
+	info->derive_pkgl_gen = pkgl_gen;
 }
 
 /* main function for updating derived permission */
@@ -2,10 +2,52 @@
 
 #include "sdcardfs.h"
 #include <linux/uio.h>
+#include <linux/fsnotify.h>
+#include <linux/splice.h>
 #ifdef CONFIG_SDCARD_FS_FADV_NOACTIVE
 #include <linux/backing-dev.h>
 #endif
 
+/*
+ * passthrough mount option: the caller's access was checked when the file
+ * was opened, and the upper read or write has been through rw_verify_area()
+ * and the LSM already. Go to the lower file's methods directly instead of
+ * repeating all of it on the lower file for every call.
+ */
+static inline bool sdcardfs_passthrough(struct file *file)
+{
+	return SDCARDFS_SB(file->f_path.dentry->d_sb)->options.passthrough;
+}
+
+static ssize_t sdcardfs_lower_iter(struct file *lower_file,
+				   struct kiocb *iocb, struct iov_iter *iter,
+				   int rw)
+{
+	struct kiocb kiocb;
+	ssize_t ret;
+
+	init_sync_kiocb(&kiocb, lower_file);
+	kiocb.ki_pos = iocb->ki_pos;
+	if (rw == WRITE) {
+		file_start_write(lower_file);
+		ret = lower_file->f_op->write_iter(&kiocb, iter);
+		file_end_write(lower_file);
+	} else {
+		ret = lower_file->f_op->read_iter(&kiocb, iter);
+	}
+	BUG_ON(ret == -EIOCBQUEUED);
+	iocb->ki_pos = kiocb.ki_pos;
+
+	if (ret > 0) {
+		if (rw == WRITE)
+			fsnotify_modify(lower_file);
+		else
+			fsnotify_access(lower_file);
+	}
+
+	return ret;
+}
+
 static ssize_t sdcardfs_read(struct file *file, char __user *buf,
 			     size_t count, loff_t *ppos)
 {
@@ -30,7 +72,13 @@ static ssize_t sdcardfs_read(struct file *file, char __user *buf,
 	}
 #endif
 
-	err = vfs_read(lower_file, buf, count, ppos);
+	if (sdcardfs_passthrough(file)) {
+		err = __vfs_read(lower_file, buf, count, ppos);
+		if (err > 0)
+			fsnotify_access(lower_file);
+	} else {
+		err = vfs_read(lower_file, buf, count, ppos);
+	}
 	/* update our inode atime upon a successful lower read */
 	if (err >= 0)
 		fsstack_copy_attr_atime(dentry->d_inode,
@@ -65,7 +113,10 @@ static ssize_t sdcardfs_read_iter(struct kiocb *iocb, struct iov_iter *to)
 	}
 #endif
 
-	err = vfs_iter_read(lower_file, to, &iocb->ki_pos);
+	if (sdcardfs_passthrough(file) && lower_file->f_op->read_iter)
+		err = sdcardfs_lower_iter(lower_file, iocb, to, READ);
+	else
+		err = vfs_iter_read(lower_file, to, &iocb->ki_pos);
 	/* update our inode atime upon a successful lower read */
 	if (err >= 0)
 		fsstack_copy_attr_atime(dentry->d_inode,
@@ -92,7 +143,10 @@ static ssize_t sdcardfs_write_iter(struct kiocb *iocb, struct iov_iter *from)
 	}
 
 	lower_file = sdcardfs_lower_file(file);
-	err = vfs_iter_write(lower_file, from, &iocb->ki_pos);
+	if (sdcardfs_passthrough(file) && lower_file->f_op->write_iter)
+		err = sdcardfs_lower_iter(lower_file, iocb, from, WRITE);
+	else
+		err = vfs_iter_write(lower_file, from, &iocb->ki_pos);
 	/* update our inode times+sizes upon a successful lower write */
 	if (err >= 0) {
 		fsstack_copy_inode_size(dentry->d_inode,
@@ -118,7 +172,15 @@ static ssize_t sdcardfs_write(struct file *file, const char __user *buf,
 	}
 
 	lower_file = sdcardfs_lower_file(file);
-	err = vfs_write(lower_file, buf, count, ppos);
+	if (sdcardfs_passthrough(file)) {
+		file_start_write(lower_file);
+		err = __vfs_write(lower_file, buf, count, ppos);
+		file_end_write(lower_file);
+		if (err > 0)
+			fsnotify_modify(lower_file);
+	} else {
+		err = vfs_write(lower_file, buf, count, ppos);
+	}
 	/* update our inode times+sizes upon a successful lower write */
 	if (err >= 0) {
 		fsstack_copy_inode_size(dentry->d_inode,
@@ -130,6 +192,33 @@ static ssize_t sdcardfs_write(struct file *file, const char __user *buf,
 	return err;
 }
 
+/*
+ * Splice straight from the lower file's page cache. Splicing into the file
+ * goes through sdcardfs_write_iter(), with its free space check.
+ */
+static ssize_t sdcardfs_splice_read(struct file *file, loff_t *ppos,
+				    struct pipe_inode_info *pipe, size_t len,
+				    unsigned int flags)
+{
+	ssize_t err;
+	struct file *lower_file;
+	struct dentry *dentry = file->f_path.dentry;
+
+	lower_file = sdcardfs_lower_file(file);
+	if (lower_file->f_op->splice_read)
+		err = lower_file->f_op->splice_read(lower_file, ppos, pipe,
+						    len, flags);
+	else
+		err = default_file_splice_read(lower_file, ppos, pipe, len,
+					       flags);
+	/* update our inode atime upon a successful lower read */
+	if (err >= 0)
+		fsstack_copy_attr_atime(dentry->d_inode,
+					lower_file->f_path.dentry->d_inode);
+
+	return err;
+}
+
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3, 11, 0))
 static int sdcardfs_readdir(struct file *file, struct dir_context *ctx)
 #else
@@ -388,6 +477,8 @@ const struct file_operations sdcardfs_main_fops = {
 	.write = sdcardfs_write,
 	.read_iter = sdcardfs_read_iter,
 	.write_iter = sdcardfs_write_iter,
+	.splice_read = sdcardfs_splice_read,
+	.splice_write = iter_file_splice_write,
 	.unlocked_ioctl = sdcardfs_unlocked_ioctl,
 #ifdef CONFIG_COMPAT
 	.compat_ioctl = sdcardfs_compat_ioctl,
@@ -55,6 +55,9 @@ static int sdcardfs_create(struct inode *dir, struct dentry *dentry,
 		goto out_eacces;
 	}
 
+	/* the name may exist from now on */
+	sdcardfs_neg_cache_invalidate(dir);
+
 	/* save current_cred and override it */
 	OVERRIDE_CRED(SDCARDFS_SB(dir->i_sb), saved_cred);
 
@@ -357,6 +360,9 @@ static int sdcardfs_mkdir(struct inode *dir, struct dentry *dentry,
 		goto out_eacces;
 	}
 
+	/* the name may exist from now on */
+	sdcardfs_neg_cache_invalidate(dir);
+
 	/* save current_cred and override it */
 	OVERRIDE_CRED(SDCARDFS_SB(dir->i_sb), saved_cred);
 
@@ -635,6 +641,9 @@ static int sdcardfs_rename(struct inode *old_dir, struct dentry *old_dentry,
 		goto out_eacces;
 	}
 
+	/* the name may exist from now on */
+	sdcardfs_neg_cache_invalidate(new_dir);
+
 	/* save current_cred and override it */
 	OVERRIDE_CRED(SDCARDFS_SB(old_dir->i_sb), saved_cred);
 
@@ -695,6 +704,9 @@ static int sdcardfs_rename(struct inode *old_dir, struct dentry *old_dentry,
 			dput(new_parent);
 		}
 	}
+	/* the name only changes once we return, derive again on next use */
+	if (old_dentry->d_inode)
+		reset_derived_permission(old_dentry->d_inode);
 
 out_err:
 	mnt_drop_write(lower_new_path.mnt);
@@ -211,6 +211,152 @@ out:
 	return err;
 }
 
+/*
+ * Negative lookup cache.
+ *
+ * A case insensitive miss costs a scan of the whole lower directory, and
+ * apps keep probing for the same missing files. Each directory remembers
+ * the last names found missing, keyed by their case folded hash from
+ * sdcardfs_hash_ci(). The entries hold as long as the lower directory's
+ * mtime and ctime are those seen when they were added, so names created
+ * through another view or directly on the lower fs are noticed; creates
+ * through this view also drop the cache explicitly.
+ */
+#define SDCARDFS_NEG_CACHE_SIZE	16
+
+struct sdcardfs_neg_entry {
+	unsigned int hash;
+	unsigned int len;
+	char *name;
+};
+
+struct sdcardfs_neg_cache {
+	spinlock_t lock;
+	struct timespec mtime;	/* of the lower dir, when the entries were added */
+	struct timespec ctime;
+	unsigned int next;	/* entry to replace */
+	struct sdcardfs_neg_entry entries[SDCARDFS_NEG_CACHE_SIZE];
+};
+
+static void neg_cache_clear(struct sdcardfs_neg_cache *nc)
+{
+	int i;
+
+	for (i = 0; i < SDCARDFS_NEG_CACHE_SIZE; i++) {
+		kfree(nc->entries[i].name);
+		nc->entries[i].name = NULL;
+	}
+	nc->next = 0;
+}
+
+/* drop the entries if the lower dir changed since they were added */
+static void neg_cache_check(struct sdcardfs_neg_cache *nc,
+			    struct inode *lower_dir)
+{
+	if (!timespec_equal(&nc->mtime, &lower_dir->i_mtime) ||
+	    !timespec_equal(&nc->ctime, &lower_dir->i_ctime)) {
+		neg_cache_clear(nc);
+		nc->mtime = lower_dir->i_mtime;
+		nc->ctime = lower_dir->i_ctime;
+	}
+}
+
+static bool sdcardfs_neg_cache_lookup(struct inode *dir,
+				      struct inode *lower_dir,
+				      const struct qstr *name)
+{
+	struct sdcardfs_neg_cache *nc = SDCARDFS_I(dir)->neg_cache;
+	struct sdcardfs_neg_entry *e;
+	bool found = false;
+	int i;
+
+	if (!nc)
+		return false;
+
+	spin_lock(&nc->lock);
+	neg_cache_check(nc, lower_dir);
+	for (i = 0; i < SDCARDFS_NEG_CACHE_SIZE; i++) {
+		e = &nc->entries[i];
+		if (e->name && e->hash == name->hash && e->len == name->len &&
+		    !strncasecmp(e->name, name->name, name->len)) {
+			found = true;
+			break;
+		}
+	}
+	spin_unlock(&nc->lock);
+
+	return found;
+}
+
+static void sdcardfs_neg_cache_add(struct inode *dir, struct inode *lower_dir,
+				   const struct qstr *name)
+{
+	struct sdcardfs_inode_info *info = SDCARDFS_I(dir);
+	struct sdcardfs_neg_cache *nc = info->neg_cache;
+	struct timespec now = current_fs_time(lower_dir->i_sb);
+	struct sdcardfs_neg_entry *e;
+	char *old, *copy;
+
+	/*
+	 * A name created within the same timestamp tick would not change
+	 * the lower dir's mtime, so don't trust a dir modified this tick.
+	 */
+	if (timespec_equal(&lower_dir->i_mtime, &now) ||
+	    timespec_equal(&lower_dir->i_ctime, &now))
+		return;
+
+	if (!nc) {
+		nc = kzalloc(sizeof(*nc), GFP_KERNEL);
+		if (!nc)
+			return;
+		spin_lock_init(&nc->lock);
+		nc->mtime = lower_dir->i_mtime;
+		nc->ctime = lower_dir->i_ctime;
+		/* the caller holds dir->i_mutex */
+		info->neg_cache = nc;
+	}
+
+	copy = kstrndup(name->name, name->len, GFP_KERNEL);
+	if (!copy)
+		return;
+
+	spin_lock(&nc->lock);
+	neg_cache_check(nc, lower_dir);
+	e = &nc->entries[nc->next];
+	nc->next = (nc->next + 1) % SDCARDFS_NEG_CACHE_SIZE;
+	old = e->name;
+	e->name = copy;
+	e->hash = name->hash;
+	e->len = name->len;
+	spin_unlock(&nc->lock);
+
+	kfree(old);
+}
+
+void sdcardfs_neg_cache_invalidate(struct inode *dir)
+{
+	struct sdcardfs_neg_cache *nc = SDCARDFS_I(dir)->neg_cache;
+
+	if (!nc)
+		return;
+
+	spin_lock(&nc->lock);
+	neg_cache_clear(nc);
+	spin_unlock(&nc->lock);
+}
+
+void sdcardfs_neg_cache_free(struct inode *dir)
+{
+	struct sdcardfs_neg_cache *nc = SDCARDFS_I(dir)->neg_cache;
+
+	if (!nc)
+		return;
+
+	neg_cache_clear(nc);
+	kfree(nc);
+	SDCARDFS_I(dir)->neg_cache = NULL;
+}
+
 /*
  * Main driver function for sdcardfs's lookup.
  *
@@ -229,6 +375,7 @@ static struct dentry *__sdcardfs_lookup(struct dentry *dentry,
 	struct path lower_path;
 	struct qstr this;
 	struct sdcardfs_sb_info *sbi;
+	struct inode *dir;
 
 	sbi = SDCARDFS_SB(dentry->d_sb);
 	/* must initialize dentry operations */
@@ -242,6 +389,14 @@ static struct dentry *__sdcardfs_lookup(struct dentry *dentry,
 	/* now start the actual lookup procedure */
 	lower_dir_dentry = lower_parent_path->dentry;
 	lower_dir_mnt = lower_parent_path->mnt;
+	dir = dentry->d_parent->d_inode;
+
+	/* a name recently found missing needs no lower lookup */
+	if (sdcardfs_neg_cache_lookup(dir, lower_dir_dentry->d_inode,
+				      &dentry->d_name)) {
+		err = -ENOENT;
+		goto negative;
+	}
 
 	/* Use vfs_path_lookup to check if the dentry exists or not */
 	if (sbi->options.lower_fs == LOWER_FS_EXT4) {
@@ -294,6 +449,9 @@ static struct dentry *__sdcardfs_lookup(struct dentry *dentry,
 	if (err && err != -ENOENT)
 		goto out;
 
+	sdcardfs_neg_cache_add(dir, lower_dir_dentry->d_inode, &dentry->d_name);
+
+negative:
 	/* instatiate a new negative dentry */
 	this.name = name;
 	this.len = strlen(name);
@@ -36,6 +36,7 @@ enum {
 	Opt_lower_fs,
 	Opt_reserved_mb,
 	Opt_mask,
+	Opt_passthrough,
 	Opt_err,
 };
 
@@ -50,6 +51,7 @@ static const match_table_t sdcardfs_tokens = {
 	{Opt_lower_fs, "lower_fs=%s"},
 	{Opt_reserved_mb, "reserved_mb=%u"},
 	{Opt_mask, "mask=%u"},
+	{Opt_passthrough, "passthrough"},
 	{Opt_err, NULL}
 };
 
@@ -74,6 +76,7 @@ static int parse_options(struct super_block *sb, char *options, int silent,
 	opts->lower_fs = LOWER_FS_EXT4;
 	/* by default, 0MB is reserved */
 	opts->reserved_mb = 0;
+	opts->passthrough = 0;
 	opts->m_gid = AID_SDCARD_RW;
 
 	*debug = 0;
@@ -160,6 +163,9 @@ static int parse_options(struct super_block *sb, char *options, int silent,
 			else
 				opts->mask = 0007;
 			break;
+		case Opt_passthrough:
+			opts->passthrough = 1;
+			break;
 
 			/* unknown option */
 		default:
@@ -28,16 +28,25 @@
 
 #define STRING_BUF_SIZE		(512)
 
+/*
+ * Lookups walk the tables under rcu_read_lock(); updates are done by the
+ * pkgld thread under hashtable_lock and entries are freed after a grace
+ * period.
+ */
 struct hashtable_entry {
 	struct hlist_node hlist;
 	void *key;
 	int value;
+	unsigned int reload;	/* read_package_list() pass that saw it last */
+	struct rcu_head rcu;
 };
 
 struct packagelist_data {
 	DECLARE_HASHTABLE(package_to_appid, 8);
 	DECLARE_HASHTABLE(appid_with_rw, 7);
 	struct mutex hashtable_lock;
+	unsigned int reload;
+	unsigned int generation;	/* bumped after each reload */
 	struct task_struct *thread_id;
 	gid_t write_gid;
 	char *strtok_last;
@@ -70,12 +79,17 @@ static unsigned int str_hash(void *key)
 static int contain_appid_key(struct packagelist_data *pkgl_dat, void *appid)
 {
 	struct hashtable_entry *hash_cur;
-
-	hash_for_each_possible(pkgl_dat->appid_with_rw, hash_cur, hlist,
-			       (uintptr_t) appid)
-	    if (appid == hash_cur->key)
-		return 1;
-	return 0;
+	int ret = 0;
+
+	rcu_read_lock();
+	hash_for_each_possible_rcu(pkgl_dat->appid_with_rw, hash_cur, hlist,
+				   (uintptr_t) appid)
+		if (appid == hash_cur->key) {
+			ret = 1;
+			break;
+		}
+	rcu_read_unlock();
+	return ret;
 }
 
 /* Return if the calling UID holds sdcard_rw. */
@@ -92,9 +106,7 @@ int get_caller_has_rw_locked(void *pkgl_id, derive_t derive)
 	}
 
 	appid = multiuser_get_app_id(xfs_kuid_to_uid(current_fsuid()));
-	mutex_lock(&pkgl_dat->hashtable_lock);
 	ret = contain_appid_key(pkgl_dat, (void *)(uintptr_t) appid);
-	mutex_unlock(&pkgl_dat->hashtable_lock);
 	return ret;
 #endif
         return 0;
@@ -105,19 +117,29 @@ appid_t get_appid(void *pkgl_id, const char *app_name)
 	struct packagelist_data *pkgl_dat = (struct packagelist_data *)pkgl_id;
 	struct hashtable_entry *hash_cur;
 	unsigned int hash = str_hash((void *)app_name);
-	appid_t ret_id;
+	appid_t ret_id = 0;
 
-	mutex_lock(&pkgl_dat->hashtable_lock);
-	hash_for_each_possible(pkgl_dat->package_to_appid, hash_cur, hlist,
-			       hash) {
+	rcu_read_lock();
+	hash_for_each_possible_rcu(pkgl_dat->package_to_appid, hash_cur, hlist,
+				   hash) {
 		if (!strcasecmp(app_name, hash_cur->key)) {
-			ret_id = (appid_t) hash_cur->value;
-			mutex_unlock(&pkgl_dat->hashtable_lock);
-			return ret_id;
+			ret_id = (appid_t) ACCESS_ONCE(hash_cur->value);
+			break;
 		}
 	}
-	mutex_unlock(&pkgl_dat->hashtable_lock);
-	return 0;
+	rcu_read_unlock();
+	return ret_id;
+}
+
+/*
+ * Changes whenever a reload of packages.list may have changed an appid,
+ * so that state derived from get_appid() can be revalidated cheaply.
+ */
+unsigned int get_packagelist_generation(void *pkgl_id)
+{
+	struct packagelist_data *pkgl_dat = (struct packagelist_data *)pkgl_id;
+
+	return ACCESS_ONCE(pkgl_dat->generation);
 }
 
 /* Kernel has already enforced everything we returned through
@@ -187,7 +209,8 @@ static int insert_str_to_int(struct packagelist_data *pkgl_dat, void *key,
 	hash_for_each_possible(pkgl_dat->package_to_appid, hash_cur, hlist,
 			       hash) {
 		if (!strcasecmp(key, hash_cur->key)) {
-			hash_cur->value = value;
+			ACCESS_ONCE(hash_cur->value) = value;
+			hash_cur->reload = pkgl_dat->reload;
 			return 0;
 		}
 	}
@@ -195,18 +218,32 @@ static int insert_str_to_int(struct packagelist_data *pkgl_dat, void *key,
 	if (!new_entry)
 		return -ENOMEM;
 	new_entry->key = kstrdup(key, GFP_KERNEL);
+	if (!new_entry->key) {
+		kmem_cache_free(hashtable_entry_cachep, new_entry);
+		return -ENOMEM;
+	}
 	new_entry->value = value;
-	hash_add(pkgl_dat->package_to_appid, &new_entry->hlist, hash);
+	new_entry->reload = pkgl_dat->reload;
+	hash_add_rcu(pkgl_dat->package_to_appid, &new_entry->hlist, hash);
 	return 0;
 }
 
-static void remove_str_to_int(struct hashtable_entry *h_entry)
+static void free_str_to_int(struct rcu_head *head)
 {
-	/* printk(KERN_INFO "sdcardfs: %s: %s: %d\n", __func__, (char *)h_entry->key, h_entry->value); */
+	struct hashtable_entry *h_entry =
+		container_of(head, struct hashtable_entry, rcu);
+
 	kfree(h_entry->key);
 	kmem_cache_free(hashtable_entry_cachep, h_entry);
 }
 
+static void remove_str_to_int(struct hashtable_entry *h_entry)
+{
+	/* printk(KERN_INFO "sdcardfs: %s: %s: %d\n", __func__, (char *)h_entry->key, h_entry->value); */
+	hash_del_rcu(&h_entry->hlist);
+	call_rcu(&h_entry->rcu, free_str_to_int);
+}
+
 static int insert_int_to_null(struct packagelist_data *pkgl_dat, void *key,
 			      int value)
 {
@@ -217,7 +254,8 @@ static int insert_int_to_null(struct packagelist_data *pkgl_dat, void *key,
 	hash_for_each_possible(pkgl_dat->appid_with_rw, hash_cur, hlist,
 			       (uintptr_t) key) {
 		if (key == hash_cur->key) {
-			hash_cur->value = value;
+			ACCESS_ONCE(hash_cur->value) = value;
+			hash_cur->reload = pkgl_dat->reload;
 			return 0;
 		}
 	}
@@ -226,30 +264,39 @@ static int insert_int_to_null(struct packagelist_data *pkgl_dat, void *key,
 		return -ENOMEM;
 	new_entry->key = key;
 	new_entry->value = value;
-	hash_add(pkgl_dat->appid_with_rw, &new_entry->hlist,
-		 (uintptr_t) new_entry->key);
+	new_entry->reload = pkgl_dat->reload;
+	hash_add_rcu(pkgl_dat->appid_with_rw, &new_entry->hlist,
+		     (uintptr_t) new_entry->key);
 	return 0;
 }
 
+static void free_int_to_null(struct rcu_head *head)
+{
+	kmem_cache_free(hashtable_entry_cachep,
+			container_of(head, struct hashtable_entry, rcu));
+}
+
 static void remove_int_to_null(struct hashtable_entry *h_entry)
 {
 	/* printk(KERN_INFO "sdcardfs: %s: %d: %d\n", __func__, (int)h_entry->key, h_entry->value); */
-	kmem_cache_free(hashtable_entry_cachep, h_entry);
+	hash_del_rcu(&h_entry->hlist);
+	call_rcu(&h_entry->rcu, free_int_to_null);
 }
 
-static void remove_all_hashentrys(struct packagelist_data *pkgl_dat)
+/* drop the entries the last reload did not see, or all with stale_only 0 */
+static void remove_hashentrys(struct packagelist_data *pkgl_dat,
+			      bool stale_only)
 {
 	struct hashtable_entry *hash_cur;
 	struct hlist_node *h_t;
 	int i;
 
 	hash_for_each_safe(pkgl_dat->package_to_appid, i, h_t, hash_cur, hlist)
-	    remove_str_to_int(hash_cur);
+		if (!stale_only || hash_cur->reload != pkgl_dat->reload)
+			remove_str_to_int(hash_cur);
 	hash_for_each_safe(pkgl_dat->appid_with_rw, i, h_t, hash_cur, hlist)
-	    remove_int_to_null(hash_cur);
-
-	hash_init(pkgl_dat->package_to_appid);
-	hash_init(pkgl_dat->appid_with_rw);
+		if (!stale_only || hash_cur->reload != pkgl_dat->reload)
+			remove_int_to_null(hash_cur);
 }
 
 static int read_package_list(struct packagelist_data *pkgl_dat)
@@ -260,9 +307,12 @@ static int read_package_list(struct packagelist_data *pkgl_dat)
 
 	printk(KERN_INFO "sdcardfs: read_package_list\n");
 
+	/*
+	 * Entries are updated in place and the ones gone from the file are
+	 * dropped at the end, so concurrent lookups never see an empty table.
+	 */
 	mutex_lock(&pkgl_dat->hashtable_lock);
-
-	remove_all_hashentrys(pkgl_dat);
+	pkgl_dat->reload++;
 
 	fd = sys_open(kpackageslist_file, O_RDONLY, 0);
 	if (fd < 0) {
@@ -294,22 +344,16 @@ static int read_package_list(struct packagelist_data *pkgl_dat)
 				pkgl_dat->app_name_buf, &appid,
 				pkgl_dat->gids_buf) == 3) {
 			ret = insert_str_to_int(pkgl_dat, pkgl_dat->app_name_buf, appid);
-			if (ret) {
-				sys_close(fd);
-				mutex_unlock(&pkgl_dat->hashtable_lock);
-				return ret;
-			}
+			if (ret)
+				goto out;
 
 			token = strtok_r(pkgl_dat->gids_buf, ",", &pkgl_dat->strtok_last);
 			while (token != NULL) {
 				if (!kstrtoul(token, 10, &ret_gid) &&
 						(ret_gid == pkgl_dat->write_gid)) {
 					ret = insert_int_to_null(pkgl_dat, (void *)(uintptr_t)appid, 1);
-					if (ret) {
-						sys_close(fd);
-						mutex_unlock(&pkgl_dat->hashtable_lock);
-						return ret;
-					}
+					if (ret)
+						goto out;
 					break;
 				}
 				token = strtok_r(NULL, ",", &pkgl_dat->strtok_last);
@@ -317,9 +361,14 @@ static int read_package_list(struct packagelist_data *pkgl_dat)
 		}
 	}
 
+	remove_hashentrys(pkgl_dat, true);
+	ret = 0;
+out:
 	sys_close(fd);
+	smp_wmb();
+	ACCESS_ONCE(pkgl_dat->generation) = pkgl_dat->generation + 1;
 	mutex_unlock(&pkgl_dat->hashtable_lock);
-	return 0;
+	return ret;
 }
 
 static int packagelist_reader(void *thread_data)
@@ -451,7 +500,9 @@ void packagelist_destroy(void *pkgl_id)
 
 	force_sig_info(SIGINT, SEND_SIG_PRIV, pkgl_dat->thread_id);
 	kthread_stop(pkgl_dat->thread_id);
-	remove_all_hashentrys(pkgl_dat);
+	mutex_lock(&pkgl_dat->hashtable_lock);
+	remove_hashentrys(pkgl_dat, false);
+	mutex_unlock(&pkgl_dat->hashtable_lock);
 	printk(KERN_INFO "sdcardfs: destroyed packagelist pkgld/%d\n",
 	       (int)pkgl_pid);
 	kfree(pkgl_dat);
@@ -473,6 +524,8 @@ int packagelist_init(void)
 
 void packagelist_exit(void)
 {
-	if (hashtable_entry_cachep)
+	if (hashtable_entry_cachep) {
+		rcu_barrier();
 		kmem_cache_destroy(hashtable_entry_cachep);
+	}
 }
@@ -179,6 +179,8 @@ extern struct dentry *sdcardfs_lookup(struct inode *dir, struct dentry *dentry,
 				      unsigned int flags);
 extern int sdcardfs_interpose(struct dentry *dentry, struct super_block *sb,
 			      struct path *lower_path, userid_t id);
+extern void sdcardfs_neg_cache_invalidate(struct inode *dir);
+extern void sdcardfs_neg_cache_free(struct inode *dir);
 /*
  *  namei.c
  */
@@ -201,6 +203,8 @@ struct sdcardfs_file_info {
 	const struct vm_operations_struct *lower_vm_ops;
 };
 
+struct sdcardfs_neg_cache;
+
 /* sdcardfs inode data in memory */
 struct sdcardfs_inode_info {
 	struct inode *lower_inode;
@@ -214,6 +218,18 @@ struct sdcardfs_inode_info {
 	mode_t d_mode;
 
 	bool under_android;
+
+	/* the state above is current while the parent's derive_seq, the
+	 * name hash and the packages.list generation stay as recorded;
+	 * derive_seq is 0 until the state is first derived
+	 */
+	unsigned int derive_seq;
+	unsigned int derive_parent_seq;
+	unsigned int derive_name_hash;
+	unsigned int derive_pkgl_gen;
+
+	/* directories only: names the lower dir is known not to contain */
+	struct sdcardfs_neg_cache *neg_cache;
 	struct inode vfs_inode;
 };
 
@@ -234,6 +250,7 @@ struct sdcardfs_mount_options {
 	lower_fs_t lower_fs;
 	unsigned int reserved_mb;
 	mode_t mask;
+	int passthrough;
 };
 
 /* sdcardfs super-block data in memory */
@@ -249,6 +266,9 @@ struct sdcardfs_sb_info {
 	struct path obbpath;
 	void *pkgl_id;
 	char *devpath;
+	/* passthrough: lower free space from a recent statfs, less writes since */
+	atomic64_t avail_cache;
+	unsigned long avail_stamp;
 };
 
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3, 12, 0))
@@ -477,6 +497,7 @@ void sdcardfs_add_super(struct sdcardfs_sb_info *, struct super_block *);
 /* for packagelist.c */
 extern int get_caller_has_rw_locked(void *pkgl_id, derive_t derive);
 extern appid_t get_appid(void *pkgl_id, const char *app_name);
+extern unsigned int get_packagelist_generation(void *pkgl_id);
 extern int check_caller_access_to_name(struct inode *parent_node,
 				       const char *name, derive_t derive,
 				       int w_ok, int has_rw);
@@ -493,6 +514,7 @@ extern void setup_derived_state(struct inode *inode, perm_t perm,
 extern void get_derived_permission(struct dentry *parent,
 				   struct dentry *dentry);
 extern void update_derived_permission(struct dentry *dentry);
+extern void reset_derived_permission(struct inode *inode);
 extern int need_graft_path(struct dentry *dentry);
 extern int is_base_obbpath(struct dentry *dentry);
 extern int is_obbpath_invalid(struct dentry *dentry);
@@ -618,6 +640,9 @@ static inline void fix_derived_permission(struct inode *x)
 
 }
 
+/* how long a lower statfs is trusted in passthrough mode */
+#define SDCARDFS_AVAIL_CACHE_JIFFIES	(HZ / 10)
+
 /*
  * Return 1, if a disk has enough free space, otherwise 0.
  * We assume that any files can not be overwritten.
@@ -632,6 +657,18 @@ static inline int check_min_free_space(struct dentry *dentry, size_t size,
 	struct sdcardfs_sb_info *sbi = SDCARDFS_SB(dentry->d_sb);
 
 	if (sbi->options.reserved_mb) {
+		/*
+		 * In passthrough mode a statfs of the lower fs per write is
+		 * too much. Trust the last one for a little while, charging
+		 * it with what was written since.
+		 */
+		if (sbi->options.passthrough && !dir &&
+		    time_before(jiffies, ACCESS_ONCE(sbi->avail_stamp) +
+				SDCARDFS_AVAIL_CACHE_JIFFIES) &&
+		    atomic64_sub_return(size, &sbi->avail_cache) >
+		    (s64)sbi->options.reserved_mb * 1024 * 1024)
+			return 1;
+
 		/* Get fs stat of lower filesystem. */
 		sdcardfs_get_lower_path(dentry, &lower_path);
 		err = vfs_statfs(&lower_path, &statfs);
@@ -651,6 +688,11 @@ static inline int check_min_free_space(struct dentry *dentry, size_t size,
 		/* available size */
 		avail = statfs.f_bavail * statfs.f_bsize;
 
+		if (sbi->options.passthrough && !dir) {
+			atomic64_set(&sbi->avail_cache, avail - min_t(u64, avail, size));
+			ACCESS_ONCE(sbi->avail_stamp) = jiffies;
+		}
+
 		/* not enough space */
 		if ((u64) size > avail)
 			goto out_nospc;
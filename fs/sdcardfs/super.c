@@ -172,6 +172,7 @@ static void sdcardfs_evict_inode(struct inode *inode)
 
 	truncate_inode_pages(&inode->i_data, 0);
 	clear_inode(inode);
+	sdcardfs_neg_cache_free(inode);
 	/*
 	 * Decrement a reference to a lower_inode, which was incremented
 	 * by our read_inode when it was created initially.
@@ -262,6 +263,8 @@ static int sdcardfs_show_options(struct seq_file *m, struct dentry *root)
 
 	if (opts->reserved_mb != 0)
 		seq_printf(m, ",reserved=%uMB", opts->reserved_mb);
+	if (opts->passthrough)
+		seq_printf(m, ",passthrough");
 
 	return 0;
 };
@@ -497,7 +497,55 @@ out:
 	return 0;
 }
 
+#ifdef CONFIG_SQUASHFS_FILE_DIRECT
+/*
+ * Readahead: queue every datablock of the window for decompression at
+ * once. Fragments and sparse blocks are rare and left to readpage; pages
+ * left on the list are dropped by the caller and read on demand.
+ */
+static int squashfs_readpages(struct file *file, struct address_space *mapping,
+	struct list_head *pages, unsigned nr_pages)
+{
+	struct inode *inode = mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_CACHE_SHIFT;
+	int file_end = i_size_read(inode) >> msblk->block_log;
+	pgoff_t last_page = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	struct page *page;
+	pgoff_t start_index, end_index;
+	u64 block;
+	int index, bsize;
+
+	while (!list_empty(pages)) {
+		page = list_entry(pages->prev, struct page, lru);
+		if (page->index > last_page)
+			break;
+
+		index = page->index >> shift;
+		if (index >= file_end && squashfs_i(inode)->fragment_block !=
+						SQUASHFS_INVALID_BLK)
+			break;
+
+		block = 0;
+		bsize = read_blocklist(inode, index, &block);
+		if (bsize <= 0)
+			break;
+
+		start_index = (pgoff_t)index << shift;
+		end_index = min_t(pgoff_t, start_index | ((1 << shift) - 1),
+				  last_page);
+		if (squashfs_readahead_block(inode, pages, start_index,
+				end_index - start_index + 1, block, bsize))
+			break;
+	}
+
+	return 0;
+}
+#endif
 
 const struct address_space_operations squashfs_aops = {
-	.readpage = squashfs_readpage
+	.readpage = squashfs_readpage,
+#ifdef CONFIG_SQUASHFS_FILE_DIRECT
+	.readpages = squashfs_readpages,
+#endif
 };
@@ -13,6 +13,7 @@
 #include <linux/string.h>
 #include <linux/pagemap.h>
 #include <linux/mutex.h>
+#include <linux/workqueue.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -23,6 +24,20 @@
 static int squashfs_read_cache(struct page *target_page, u64 block, int bsize,
 	int pages, struct page **page);
 
+/*
+ * A datablock read on behalf of readahead. The pages are locked and
+ * referenced; the ones that could not be grabbed are NULL.
+ */
+struct squashfs_readahead {
+	struct work_struct work;
+	struct inode *inode;
+	u64 block;
+	int bsize;
+	int pages;
+	int missing_pages;
+	struct page *page[0];
+};
+
 /* Read separately compressed datablock directly into page cache */
 int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
 
@@ -174,3 +189,152 @@ out:
 	squashfs_cache_put(buffer);
 	return res;
 }
+
+
+static int squashfs_readahead_cache(struct squashfs_readahead *ra)
+{
+	struct squashfs_cache_entry *buffer = squashfs_get_datablock(
+				ra->inode->i_sb, ra->block, ra->bsize);
+	int bytes = buffer->length, res = buffer->error, n, offset = 0;
+	void *pageaddr;
+
+	if (res)
+		goto out;
+
+	for (n = 0; n < ra->pages; n++, bytes -= PAGE_CACHE_SIZE,
+			offset += PAGE_CACHE_SIZE) {
+		int avail = clamp_t(int, bytes, 0, PAGE_CACHE_SIZE);
+
+		if (ra->page[n] == NULL)
+			continue;
+
+		pageaddr = kmap_atomic(ra->page[n]);
+		squashfs_copy_data(pageaddr, buffer, offset, avail);
+		memset(pageaddr + avail, 0, PAGE_CACHE_SIZE - avail);
+		kunmap_atomic(pageaddr);
+	}
+
+out:
+	squashfs_cache_put(buffer);
+	return res;
+}
+
+static int squashfs_readahead_direct(struct squashfs_readahead *ra)
+{
+	struct squashfs_page_actor *actor;
+	void *pageaddr;
+	int res, bytes;
+
+	actor = squashfs_page_actor_init_special(ra->page, ra->pages, 0);
+	if (actor == NULL)
+		return -ENOMEM;
+
+	res = squashfs_read_data(ra->inode->i_sb, ra->block, ra->bsize, NULL,
+				 actor);
+	kfree(actor);
+	if (res < 0)
+		return res;
+
+	/* Last page may have trailing bytes not filled */
+	bytes = res % PAGE_CACHE_SIZE;
+	if (bytes) {
+		pageaddr = kmap_atomic(ra->page[ra->pages - 1]);
+		memset(pageaddr + bytes, 0, PAGE_CACHE_SIZE - bytes);
+		kunmap_atomic(pageaddr);
+	}
+
+	return 0;
+}
+
+static void squashfs_readahead_work(struct work_struct *work)
+{
+	struct squashfs_readahead *ra =
+		container_of(work, struct squashfs_readahead, work);
+	int i, res;
+
+	if (ra->missing_pages)
+		res = squashfs_readahead_cache(ra);
+	else
+		res = squashfs_readahead_direct(ra);
+
+	if (res < 0)
+		ERROR("Unable to read page, block %llx, size %x\n", ra->block,
+			ra->bsize);
+
+	for (i = 0; i < ra->pages; i++) {
+		if (ra->page[i] == NULL)
+			continue;
+		flush_dcache_page(ra->page[i]);
+		if (res < 0)
+			SetPageError(ra->page[i]);
+		else
+			SetPageUptodate(ra->page[i]);
+		unlock_page(ra->page[i]);
+		page_cache_release(ra->page[i]);
+	}
+
+	kfree(ra);
+}
+
+/*
+ * Read a datablock for readahead: the pages covered by the block, starting
+ * at 'start_index', are taken from the head of 'pages' and added to the
+ * page cache, or grabbed from it. The block is then decompressed from the
+ * unbound workqueue, so the blocks of one readahead window are read and
+ * decompressed in parallel on all CPUs, each directly into its pages.
+ * Pages of the list not used are left on it.
+ */
+int squashfs_readahead_block(struct inode *inode, struct list_head *pages,
+	pgoff_t start_index, int nr, u64 block, int bsize)
+{
+	struct address_space *mapping = inode->i_mapping;
+	struct squashfs_readahead *ra;
+	struct page *page;
+	int i, got = 0;
+
+	ra = kzalloc(sizeof(*ra) + nr * sizeof(struct page *), GFP_KERNEL);
+	if (ra == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < nr; i++) {
+		pgoff_t index = start_index + i;
+
+		page = list_empty(pages) ? NULL : list_entry(pages->prev,
+							struct page, lru);
+		if (page && page->index == index) {
+			list_del(&page->lru);
+			if (add_to_page_cache_lru(page, mapping, index,
+						  GFP_KERNEL)) {
+				page_cache_release(page);
+				page = NULL;
+			}
+		} else {
+			page = grab_cache_page_nowait(mapping, index);
+			if (page && PageUptodate(page)) {
+				unlock_page(page);
+				page_cache_release(page);
+				page = NULL;
+			}
+		}
+
+		ra->page[i] = page;
+		if (page)
+			got++;
+		else
+			ra->missing_pages++;
+	}
+
+	if (!got) {
+		kfree(ra);
+		return 0;
+	}
+
+	ra->inode = inode;
+	ra->block = block;
+	ra->bsize = bsize;
+	ra->pages = nr;
+	INIT_WORK(&ra->work, squashfs_readahead_work);
+	queue_work(system_unbound_wq, &ra->work);
+
+	return 0;
+}
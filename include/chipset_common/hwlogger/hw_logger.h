@@ -77,6 +77,8 @@ struct hw_logger_msg {
 
 extern struct huawei_log_tag __start_hwlog_tag, __stop_hwlog_tag;
 
+extern bool hw_logger_over_budget(const char *name, const char *tag, size_t len);
+
 #define LOGGER_LOG_EXCEPTION	"hwlog_exception"	/* exception */
 #define LOGGER_LOG_JANK    "hwlog_jank"	/* system performance messages */
 #define LOGGER_LOG_BDAT    "hwlog_bdat"	/* system power messages */
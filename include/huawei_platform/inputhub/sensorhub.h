@@ -19,6 +19,36 @@
 #define SHB_IOCTL_APP_SENSOR_BATCH          _IOR(SHBIO, 0x04, short)
 #define SHB_IOCTL_APP_SENSOR_FLUSH          _IOR(SHBIO, 0x05, short)
 #define SHB_IOCTL_APP_GET_SENSOR_MCU_MODE   _IOR(SHBIO, 0x51, short)
+#define SHB_IOCTL_APP_MMAP_CONSUME          _IOW(SHBIO, 0x06, unsigned int)
+#define SHB_IOCTL_APP_SET_WAKE_LATENCY      _IOW(SHBIO, 0x07, struct shb_wake_latency)
+
+/*
+ * Read-only mmap of /dev/sensorhub, for readers that take events in bulk:
+ * the first page is struct shb_mmap_ctrl, the event ring follows it.
+ * Each record is a u32 length, then that many bytes: the s64 timestamp
+ * and the event as read() returns them. Records may wrap around the end
+ * of the ring. The 'avail' bytes from 'read_off' are valid while 'seq'
+ * is even and unchanged across reading them; once processed, they are
+ * handed back with SHB_IOCTL_APP_MMAP_CONSUME(bytes), in whole records.
+ * poll() reports POLLIN while avail is not 0.
+ */
+struct shb_mmap_ctrl {
+	uint32_t ring_size;
+	uint32_t read_off;
+	uint32_t avail;
+	uint32_t seq;
+};
+
+/*
+ * Wakeup budget of the reader: batched events wake it at most latency_ms
+ * after the first one not yet read, or as soon as watermark bytes are
+ * unread (0 for half the ring). Flush complete events always wake it.
+ * latency_ms 0, the default, wakes it on every event.
+ */
+struct shb_wake_latency {
+	uint32_t latency_ms;
+	uint32_t watermark;
+};
 struct ioctl_para {
 	int32_t shbtype;
 	union {
@@ -58,6 +58,8 @@
 #define BST_IOC_FILTER_HB_REPLY			_IOW(BST_IOC_MAGIC, 35, struct bst_sock_id)
 #define BST_IOC_SET_FREEZER_STATE		_IOW(BST_IOC_MAGIC, 36, struct freezer_state)
 #define BST_IOC_SET_PRIO_CH_ENABLE		_IOW(BST_IOC_MAGIC, 37, int32_t)
+#define BST_IOC_SCHED_HB				_IOW(BST_IOC_MAGIC, 38, struct heartbeat_sched)
+#define BST_IOC_CANCEL_HB				_IOW(BST_IOC_MAGIC, 39, struct bst_sock_id)
 
 typedef enum {
 	BST_SOCK_NOT_USED = 0,
@@ -92,6 +94,8 @@ typedef enum {
 	BST_IND_FG_KEY_MSG,
 	BST_IND_FG_UID_SOCK_CHG,
 	BST_IND_HB_REPLY_RECV,
+	BST_IND_HB_SEND_FAIL,
+	BST_IND_FILTER_STAT,
 } bst_ind_type;
 
 typedef enum {
@@ -258,6 +262,18 @@ struct heartbeat_content {
 	uint8_t content[0];				/* heartbeat content */
 };
 
+/*
+ * heartbeat sent by the kernel every interval ms; it may go out up to
+ * jitter ms early, to share a radio wake with the heartbeats of other sockets
+ */
+struct heartbeat_sched {
+	struct bst_sock_id guide;		/* pid and fd to find sock */
+	uint32_t interval;				/* heartbeat period, in ms */
+	uint32_t jitter;				/* tolerated advance, in ms */
+	uint32_t len;					/* length of heartbeat content */
+	uint8_t content[0];				/* heartbeat content */
+};
+
 struct freezer_state {
 	struct bst_sock_id guide;		/* pid and fd to find sock */
 	bool frozen;					/* process freeze state */
@@ -86,6 +86,9 @@
 #define BATTERY_TEMPERATURE_5_C             (5)
 
 #define CHARGING_WORK_TIMEOUT                (30000)
+/* monitor period once nothing changed for a few runs, below the 80s watchdog */
+#define CHARGING_WORK_STABLE_TIMEOUT         (60000)
+#define CHARGING_WORK_STABLE_CNT             (4)
 #define MIN_CHARGING_CURRENT_OFFSET          (-10)
 #define BATTERY_FULL_CHECK_TIMIES            (2)
 
@@ -360,6 +363,16 @@ struct fcp_adapter_device_ops {
 #ifdef CONFIG_TCPC_CLASS
 struct tcpc_device;
 #endif
+/* what the monitor work decided, to tell a stable charge from a changing one */
+struct charge_monitor_snapshot {
+	enum usb_charger_type charger_type;
+	unsigned int input_current;
+	unsigned int charge_current;
+	unsigned int charge_enable;
+	unsigned int iin_thl;
+	unsigned int ichg_thl;
+};
+
 struct charge_device_info {
 	struct device *dev;
 	struct notifier_block usb_nb;
@@ -404,6 +417,8 @@ struct charge_device_info {
 #ifdef CONFIG_DIRECT_CHARGER
 	int ignore_pluggin_and_plugout_flag;
 #endif
+	struct charge_monitor_snapshot monitor_last;
+	unsigned int monitor_stable_cnt;
 };
 
 enum charge_wakelock_flag {
@@ -21,6 +21,7 @@ typedef enum {
 	CHANNEL_ID_LOCAL_CLIENT = 0x1 << 1,
 	CHANNEL_ID_NETLINK      = 0x1 << 2,
 	CHANNEL_ID_KCOLLECT     = 0x1 << 3,
+	CHANNEL_ID_KWAKEUP      = 0x1 << 4,
 	CHANNEL_ID_END
 } CHANNEL_ID;
 
@@ -30,6 +31,7 @@ typedef enum {
 	PACKET_TAG_MONITOR_CMD,
 	PACKET_TAG_MONITOR_INFO,
 	PACKET_TAG_KCOLLECT,
+	PACKET_TAG_KWAKEUP,
 	PACKET_TAG_END
 } PACKET_TAG;
 
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 1998-2014. All rights reserved.
+ *
+ * File name: hw_kwakeup.h
+ * Description: This file use to collect wakeup statistics and report them
+ *              as periodic binary records.
+ * Version: 0.1
+ */
+
+#ifndef _HW_KWAKEUP_H
+#define _HW_KWAKEUP_H
+
+#include <linux/types.h>
+#include <linux/uidgid.h>
+
+#define KWAKEUP_RECORD_VERSION		1
+#define KWAKEUP_NAME_LEN		16
+#define KWAKEUP_MAX_SOURCES		32
+#define KWAKEUP_MAX_UIDS		32
+
+/*
+ * record sent with PACKET_TAG_KWAKEUP once per period that saw a wakeup:
+ * the header, nr_sources struct kwakeup_source_rec, then nr_uids struct
+ * kwakeup_uid_rec. Times are boottime seconds.
+ */
+struct kwakeup_record_hdr {
+	u32 version;
+	u32 start_s;
+	u32 end_s;
+	u32 nr_wakeups;
+	u32 nr_sources;
+	u32 nr_uids;
+	u32 dropped;	/* wakeups or packets with no free slot */
+};
+
+/* irq -1 is a resume without a known wakeup irq */
+struct kwakeup_source_rec {
+	s32 irq;
+	char name[KWAKEUP_NAME_LEN];
+	u32 count;
+	u32 resume_us_avg;	/* from wakeup to userspace running again */
+	u32 resume_us_max;
+};
+
+struct kwakeup_uid_rec {
+	u32 uid;
+	u32 packets;	/* first inbound packet after a wakeup */
+};
+
+/* userspace sends the report period in seconds, 0 stops collecting */
+struct kwakeup_cmd {
+	u32 period_s;
+};
+
+#if defined(CONFIG_HUAWEI_KSTATE) || defined(CONFIG_HUAWEI_KSTATE_MODULE)
+bool kwakeup_packet_armed(void);
+void kwakeup_packet(kuid_t uid);
+#else
+static inline bool kwakeup_packet_armed(void)
+{
+	return false;
+}
+static inline void kwakeup_packet(kuid_t uid) {}
+#endif
+
+#endif
@@ -46,5 +46,11 @@ extern void user_describe(const struct key *user, struct seq_file *m);
 extern long user_read(const struct key *key,
 		      char __user *buffer, size_t buflen);
 
+struct notifier_block;
+
+extern int register_logon_key_notifier(struct notifier_block *nb);
+extern int unregister_logon_key_notifier(struct notifier_block *nb);
+extern void logon_key_unlinked(struct key *key);
+
 
 #endif /* _KEYS_USER_TYPE_H */
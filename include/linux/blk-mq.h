@@ -59,6 +59,15 @@ struct blk_mq_hw_ctx {
 
 	struct blk_mq_cpu_notifier	cpu_notifier;
 	struct kobject		kobj;
+#ifdef CONFIG_HISI_MQ_CLASS_DISPATCH
+	struct hisi_mq_class_dispatch	*class_dispatch;
+#endif
+#ifdef CONFIG_HISI_MQ_ROW
+	struct hisi_mq_row_data	*row_data;
+#endif
+#ifdef CONFIG_HISI_MQ_IONICE_WEIGHT
+	struct hisi_mq_ionice	*ionice;
+#endif
 };
 
 struct blk_mq_tag_set {
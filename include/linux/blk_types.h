@@ -316,6 +316,17 @@ struct blk_rq_stat {
 	s64 time;
 };
 
+/*
+ * log2 latency histogram, bucket i counts completions in
+ * [2^i, 2^(i+1)) usecs, bucket 0 also holds everything below 2us
+ * and the last bucket everything above.
+ */
+#define BLK_STAT_HIST_BUCKETS	24
+
+struct blk_rq_stat_hist {
+	u64 buckets[BLK_STAT_HIST_BUCKETS];
+};
+
 #define BIO_DELAY_WARNING_GENERIC_MAKE_REQ			(10)
 #define BIO_DELAY_WARNING_MERGED					(10)
 #define BIO_DELAY_WARNING_MQ_MAKE					(10)
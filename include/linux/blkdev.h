@@ -39,6 +39,7 @@ struct bsg_job;
 struct blkcg_gq;
 struct blk_flush_queue;
 struct rq_wb;
+struct blk_ra_tune;
 
 #define BLKDEV_MIN_RQ	4
 #define BLKDEV_MAX_RQ	128	/* Default maximum */
@@ -167,6 +168,20 @@ struct request {
 	unsigned char mq_process_runqueue_index;
 #endif
 	unsigned long rq_start_jiffies;
+#ifdef CONFIG_HISI_MQ_CLASS_DISPATCH
+	unsigned char mq_dispatch_class;
+	unsigned char mq_dispatch_counted;
+#endif
+#ifdef CONFIG_HISI_MQ_ROW
+	unsigned char mq_row_prio;
+	unsigned char mq_row_dispatched;
+#endif
+#ifdef CONFIG_HISI_MQ_IONICE_WEIGHT
+	unsigned char mq_ionice_grp;
+	unsigned char mq_ionice_counted;
+	unsigned int mq_ionice_bytes;
+	u64 mq_ionice_start_ns;
+#endif
 #endif /* CONFIG_HISI_BLK_MQ */
 #ifdef CONFIG_HISI_IO_LATENCY_TRACE
 	unsigned long req_stage_jiffies[REQ_PROC_STAGE_MAX];
@@ -391,6 +406,9 @@ struct request_queue {
 	int			nr_rqs_elvpriv;	/* # allocated rqs w/ elvpriv */
 
 	struct rq_wb		*rq_wb;
+#ifdef CONFIG_BLK_ADAPTIVE_RA
+	struct blk_ra_tune	*ra_tune;
+#endif
 
 	/*
 	 * If blkcg is not used, @q->root_rl serves all requests.  If blkcg
@@ -455,6 +473,15 @@ struct request_queue {
 	atomic_t flush_work_trigger;
 	atomic_t flush_from_flush_work;
 
+	/*
+	 * adaptive flush coalescing window, see flush_reducing_window()
+	 */
+	u64 flush_last_arrival_ns;
+	u64 flush_interval_avg_us;
+	u64 flush_cost_avg_us;
+	atomic64_t flush_absorbed;
+	atomic64_t flush_issued;
+
 #ifdef CONFIG_HISI_MQ_DISPATCH_DECISION
 	int sync_write_io_limit;
 	int async_write_io_limit;
@@ -539,6 +566,7 @@ struct request_queue {
 
 #ifdef CONFIG_WBT
 	struct blk_rq_stat	rq_stats[4];
+	struct blk_rq_stat_hist	rq_stats_hist[4];
 #endif
 
 	/*
@@ -30,8 +30,10 @@ static inline bool vma_is_anonymous(struct vm_area_struct *vma)
 
 #ifdef CONFIG_HW_BOOST_SIGKILL_FREE
 extern void fast_free_user_mem(void);
+extern bool fast_free_mm(struct mm_struct *mm);
 #else
 static inline void fast_free_user_mem(void) { }
+static inline bool fast_free_mm(struct mm_struct *mm) { return false; }
 #endif
 
 #endif
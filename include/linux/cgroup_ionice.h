@@ -0,0 +1,66 @@
+#ifndef _LINUX_CGROUP_IONICE_H
+#define _LINUX_CGROUP_IONICE_H
+
+#include <linux/types.h>
+#include <linux/atomic.h>
+
+/*
+ * Every ionice cgroup but the root gets a small group id which the
+ * block layer tags its requests with. Id 0 stands for the root and for
+ * the cgroups that did not get one, and is never throttled.
+ */
+#define IONICE_MAX_GROUPS	32
+#define IONICE_WEIGHT_MIN	10
+#define IONICE_WEIGHT_DEFAULT	100
+#define IONICE_WEIGHT_MAX	1000
+
+struct ionice_io_group {
+	unsigned int	weight;
+	unsigned int	latency_target_us;	/* 0 none */
+
+	atomic64_t	bytes[2];		/* READ, WRITE */
+	atomic64_t	ios[2];
+	atomic64_t	lat_ns;			/* sum, from queueing to completion */
+	u64		lat_max_ns;
+	unsigned int	lat_avg_us;		/* moving average */
+	int		missed;			/* lat_avg_us above the target */
+};
+
+#ifdef CONFIG_HW_CGROUP_IONICE
+extern struct ionice_io_group ionice_io_groups[IONICE_MAX_GROUPS];
+
+unsigned int ionice_current_group(void);
+void ionice_io_done(unsigned int id, int rw, unsigned int bytes, u64 lat_ns);
+bool ionice_latency_pressure(void);
+
+static inline unsigned int ionice_group_weight(unsigned int id)
+{
+	return ACCESS_ONCE(ionice_io_groups[id].weight);
+}
+
+static inline bool ionice_group_has_target(unsigned int id)
+{
+	return ACCESS_ONCE(ionice_io_groups[id].latency_target_us) != 0;
+}
+#else /* CONFIG_HW_CGROUP_IONICE */
+static inline unsigned int ionice_current_group(void)
+{
+	return 0;
+}
+static inline void ionice_io_done(unsigned int id, int rw,
+		unsigned int bytes, u64 lat_ns) {}
+static inline bool ionice_latency_pressure(void)
+{
+	return false;
+}
+static inline unsigned int ionice_group_weight(unsigned int id)
+{
+	return IONICE_WEIGHT_DEFAULT;
+}
+static inline bool ionice_group_has_target(unsigned int id)
+{
+	return false;
+}
+#endif /* CONFIG_HW_CGROUP_IONICE */
+
+#endif /* _LINUX_CGROUP_IONICE_H */
@@ -502,6 +502,15 @@ extern struct cpufreq_governor cpufreq_gov_sched;
 #define CPUFREQ_DEFAULT_GOVERNOR	(&cpufreq_gov_sched)
 #endif
 
+#if defined(CONFIG_CPU_FREQ_GOV_INTERACTIVE) && defined(CONFIG_ARCH_HISI)
+int cpufreq_interactive_input_boost(unsigned int duration_us);
+#else
+static inline int cpufreq_interactive_input_boost(unsigned int duration_us)
+{
+	return -ENODEV;
+}
+#endif
+
 /*********************************************************************
  *                     FREQUENCY TABLE HELPERS                       *
  *********************************************************************/
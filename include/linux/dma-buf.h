@@ -70,6 +70,10 @@ struct dma_buf_attachment;
  * @vmap: [optional] creates a virtual mapping for the buffer into kernel
  *	  address space. Same restrictions as for vmap and friends apply.
  * @vunmap: [optional] unmaps a vmap from the buffer
+ * @cache_sgt_mapping: keep the sg_table of an attachment mapped from its
+ *		       first map until detach, so that mapping it again
+ *		       returns it without calling map_dma_buf; attach() can
+ *		       turn it off per attachment
  */
 struct dma_buf_ops {
 	int (*attach)(struct dma_buf *, struct device *,
@@ -106,6 +110,8 @@ struct dma_buf_ops {
 
 	void *(*vmap)(struct dma_buf *);
 	void (*vunmap)(struct dma_buf *, void *vaddr);
+
+	bool cache_sgt_mapping;
 };
 
 /**
@@ -150,6 +156,11 @@ struct dma_buf {
  * @dev: device attached to the buffer.
  * @node: list of dma_buf_attachment.
  * @priv: exporter specific attachment data.
+ * @cache_sgt: the mapping is cached, see &dma_buf_ops.cache_sgt_mapping.
+ * @sgt: cached mapping, NULL if none.
+ * @dir: direction @sgt was mapped for.
+ * @sgt_users: users of @sgt between map and unmap.
+ * @sgt_stale: @sgt was invalidated while in use, unmap it when released.
  *
  * This structure holds the attachment information between the dma_buf buffer
  * and its user device(s). The list contains one attachment struct per device
@@ -160,6 +171,11 @@ struct dma_buf_attachment {
 	struct device *dev;
 	struct list_head node;
 	void *priv;
+	bool cache_sgt;
+	struct sg_table *sgt;
+	enum dma_data_direction dir;
+	unsigned int sgt_users;
+	bool sgt_stale;
 };
 
 /**
@@ -218,6 +234,7 @@ struct sg_table *dma_buf_map_attachment(struct dma_buf_attachment *,
 					enum dma_data_direction);
 void dma_buf_unmap_attachment(struct dma_buf_attachment *, struct sg_table *,
 				enum dma_data_direction);
+void dma_buf_invalidate_mappings(struct dma_buf *dmabuf);
 int dma_buf_begin_cpu_access(struct dma_buf *dma_buf, size_t start, size_t len,
 			     enum dma_data_direction dir);
 void dma_buf_end_cpu_access(struct dma_buf *dma_buf, size_t start, size_t len,
@@ -336,6 +336,8 @@ extern int fscrypt_inherit_context(struct inode *, struct inode *,
 extern int derive_aes_gcm_key(u8 *, u8 *, u8 *, u8 *, int);
 extern struct key *fscrypt_request_key(u8 *, u8 *, int);
 extern int get_crypt_info(struct inode *);
+extern void fscrypt_key_cache_init(void);
+extern void fscrypt_key_cache_exit(void);
 extern int fscrypt_get_encryption_info(struct inode *);
 extern void fscrypt_put_encryption_info(struct inode *, struct fscrypt_info *);
 
@@ -34,6 +34,9 @@ enum {
 	HISI_MQ_FORCE_SOFTIRQ		= 1,
 	HISI_MQ_FLUSH_REDUCING		= 2,
 	HISI_MQ_DISPATCH_DICISION	= 3,
+	HISI_MQ_CLASS_DISPATCH		= 4,
+	HISI_MQ_ROW			= 5,
+	HISI_MQ_IONICE_WEIGHT		= 6,
 };
 
 #ifdef CONFIG_HISI_BLK_MQ
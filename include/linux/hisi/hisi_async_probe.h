@@ -0,0 +1,40 @@
+/*
+ * hisi_async_probe - parallel registration of hisi platform drivers
+ *
+ * Copyright (c) 2013 Huawei Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __HISI_ASYNC_PROBE_H__
+#define __HISI_ASYNC_PROBE_H__
+
+#include <linux/platform_device.h>
+
+#ifdef CONFIG_HISI_ASYNC_PROBE
+int hisi_platform_driver_register_async(struct platform_driver *drv);
+void hisi_platform_driver_unregister_async(struct platform_driver *drv);
+#else
+static inline int hisi_platform_driver_register_async(struct platform_driver *drv)
+{
+	return platform_driver_register(drv);
+}
+
+static inline void hisi_platform_driver_unregister_async(struct platform_driver *drv)
+{
+	platform_driver_unregister(drv);
+}
+#endif
+
+/*
+ * module_hisi_async_platform_driver - like module_platform_driver(), for
+ * drivers whose probe does not depend on anything registered after them,
+ * other than the nodes listed in "hisi,async-depends".
+ */
+#define module_hisi_async_platform_driver(__platform_driver) \
+	module_driver(__platform_driver, hisi_platform_driver_register_async, \
+		      hisi_platform_driver_unregister_async)
+
+#endif
@@ -0,0 +1,56 @@
+/*
+ * hisi_boottime - timing of initcalls and driver probes during boot
+ *
+ * Copyright (c) 2013 Huawei Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __HISI_BOOTTIME_H__
+#define __HISI_BOOTTIME_H__
+
+#include <linux/types.h>
+#include <linux/ktime.h>
+
+enum boot_time_type {
+	BOOT_TIME_INITCALL = 0,
+	BOOT_TIME_PROBE,
+	BOOT_TIME_DEFERRED_PROBE,
+	BOOT_TIME_PROBE_WAIT,
+	BOOT_TIME_TYPE_MAX,
+};
+
+#ifdef CONFIG_HISI_BOOT_TIME
+extern bool boot_time_recording;
+
+void boot_time_end_fn(enum boot_time_type type, void *fn, ktime_t start,
+		      int ret);
+void boot_time_end_dev(enum boot_time_type type, const char *drv,
+		       const char *dev, ktime_t start, int ret);
+
+/* returns 0 once boot is over, so the end hooks can skip the record */
+static inline ktime_t boot_time_start(void)
+{
+	return boot_time_recording ? ktime_get() : ktime_set(0, 0);
+}
+#else
+static inline ktime_t boot_time_start(void)
+{
+	return ktime_set(0, 0);
+}
+
+static inline void boot_time_end_fn(enum boot_time_type type, void *fn,
+				    ktime_t start, int ret)
+{
+}
+
+static inline void boot_time_end_dev(enum boot_time_type type,
+				     const char *drv, const char *dev,
+				     ktime_t start, int ret)
+{
+}
+#endif
+
+#endif
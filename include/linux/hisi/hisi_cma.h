@@ -20,15 +20,60 @@
  */
 int of_hisi_cma_contiguous_reserve_area(phys_addr_t limit);
 
+struct device;
+struct page;
+struct hisi_cma_prep;
+
+enum hisi_cma_prep_state {
+	HISI_CMA_PREP_PENDING,		/* queued or waiting to retry */
+	HISI_CMA_PREP_READY,		/* region evacuated and held */
+	HISI_CMA_PREP_FAILED,		/* gave up after all the tries */
+};
+
 #ifdef CONFIG_HISI_CMA
 /*
  * some module will get the hisi cma device;
  *and then will call cma_alloc.
  */
 struct device *hisi_get_cma_area_device(char *name);
+
+/*
+ * Asynchronous pre-reservation: evacuate @count pages of the cma area
+ * of @dev in the background, ahead of the allocation that needs them.
+ * hisi_cma_prepare_take() ends the request and hands over the pages,
+ * to be released with dma_release_from_contiguous(), or NULL so the
+ * caller allocates the usual way. hisi_cma_prepare_cancel() ends it
+ * and gives back whatever was reserved.
+ */
+struct hisi_cma_prep *hisi_cma_prepare(struct device *dev, size_t count,
+				       unsigned int align);
+enum hisi_cma_prep_state hisi_cma_prepare_state(struct hisi_cma_prep *prep,
+						unsigned int *tries);
+struct page *hisi_cma_prepare_take(struct hisi_cma_prep *prep, bool wait);
+void hisi_cma_prepare_cancel(struct hisi_cma_prep *prep);
 #else
 static inline struct device *hisi_get_cma_area_device(char *name)
 {
 	return NULL;
 }
+
+static inline struct hisi_cma_prep *hisi_cma_prepare(struct device *dev,
+		size_t count, unsigned int align)
+{
+	return NULL;
+}
+
+static inline enum hisi_cma_prep_state hisi_cma_prepare_state(
+		struct hisi_cma_prep *prep, unsigned int *tries)
+{
+	return HISI_CMA_PREP_FAILED;
+}
+
+static inline struct page *hisi_cma_prepare_take(struct hisi_cma_prep *prep,
+		bool wait)
+{
+	return NULL;
+}
+
+static inline void hisi_cma_prepare_cancel(struct hisi_cma_prep *prep) {}
 #endif
@@ -0,0 +1,31 @@
+/*
+ * hisi_ddrflux - measured DDR bandwidth from the ddrc flux statistics
+ *
+ * Copyright (c) 2013 Huawei Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __HISI_DDRFLUX_H__
+#define __HISI_DDRFLUX_H__
+
+#include <linux/errno.h>
+
+#ifdef CONFIG_HISI_DDRC_FLUX
+/*
+ * ddrflux_get_bandwidth - DDR traffic of all masters over the last
+ * streaming interval, in MB/s. Returns -ENODATA while streaming is off or
+ * the last sample is older than a few intervals; callers then fall back
+ * to their static votes.
+ */
+int ddrflux_get_bandwidth(unsigned int *mbps);
+#else
+static inline int ddrflux_get_bandwidth(unsigned int *mbps)
+{
+	return -ENODEV;
+}
+#endif
+
+#endif
@@ -1,8 +1,17 @@
 #ifndef _HISI_DEVFREQ_H
 #define _HISI_DEVFREQ_H
 
+#include <linux/types.h>
+
 int hisi_devfreq_free_freq_table(struct device *dev, unsigned int **table);
 
 int hisi_devfreq_init_freq_table(struct device *dev, unsigned int **table);
 
+#ifdef CONFIG_DEVFREQ_GOV_MALI_FRAME
+/* GPU busy time of the frame that just completed its fragment job */
+void mali_frame_report(u64 busy_ns);
+#else
+static inline void mali_frame_report(u64 busy_ns) {}
+#endif
+
 #endif /* _HISI_DEVFREQ_H */
@@ -92,6 +92,18 @@ struct ion_smart_pool_info_data {
 	int water_mark;
 };
 
+/*
+ * Tell the smart pool a graphic buffer burst of @trigger (camera open,
+ * video record...) starts, so it prefills what that trigger used last
+ * times. Ids are chosen by userspace, below ION_SMART_POOL_NR_TRIGGERS;
+ * 0 is the one bursts without a hint are learned as.
+ */
+#define ION_SMART_POOL_NR_TRIGGERS	8
+
+struct ion_smart_pool_hint_data {
+	int trigger;
+};
+
 #define HISI_ION_NAME_LEN 16
 
 struct ion_heap_info_data{
@@ -128,6 +140,7 @@ enum ION_HISI_CUSTOM_CMD {
     ION_HISI_CUSTOM_GET_MEDIA_HEAP_MODE,
     ION_HISI_CUSTOM_SET_FLAG,
     ION_HISI_CUSTOM_SET_SMART_POOL_INFO,
+    ION_HISI_CUSTOM_SMART_POOL_HINT,
 };
 
 enum ION_HISI_HEAP_MODE {
@@ -148,6 +161,8 @@ enum ION_HISI_HEAP_MODE {
  */
 struct ion_client *
 hisi_ion_client_create(const char *name);
+struct ion_heap;
+struct ion_heap *hisi_ion_get_heap(int index);
 int hisi_ion_get_heap_info(unsigned int id,struct ion_heap_info_data* data);
 int hisi_ion_get_media_mode(void);
 unsigned long long get_system_type(void);
@@ -161,13 +176,23 @@ struct ion_device * get_ion_device(void);
 #define ION_IOC_FLUSH_ALL_CACHES _IOWR(ION_IOC_HISI_MAGIC, 3, \
 				struct ion_flush_data)
 
+struct ion_task_size {
+	pid_t pid;
+	size_t size;
+};
+
 #ifdef CONFIG_ION
 extern unsigned long hisi_ion_total(void);
+extern int hisi_ion_task_sizes(struct ion_task_size *sizes, int max);
 #else
 static inline unsigned long hisi_ion_total(void)
 {
 	return 0;
 }
+static inline int hisi_ion_task_sizes(struct ion_task_size *sizes, int max)
+{
+	return 0;
+}
 #endif
 
 /*k3 add to calc free memory*/
@@ -4,14 +4,23 @@
 #define HISI_IIRQ_AFFINITY_H
 
 #include <linux/errno.h>
+#include <linux/types.h>
+
+struct seq_file;
 
 #ifdef CONFIG_HISI_IRQ_AFFINITY
 extern void hisi_irqaffinity_status(void);
 extern int hisi_irqaffinity_register(unsigned int irq, int cpu);
 extern void hisi_irqaffinity_unregister(unsigned int irq);
+extern int hisi_irqaffinity_set_balance(unsigned int irq, bool balance,
+					pid_t consumer);
+extern void hisi_irqaffinity_rates(struct seq_file *s);
 #else
 static inline int hisi_irqaffinity_register(unsigned int irq, int cpu) { return -ENOSYS; }
 static inline void hisi_irqaffinity_unregister(unsigned int irq) { return; }
 static inline void hisi_irqaffinity_status(void) { return; }
+static inline int hisi_irqaffinity_set_balance(unsigned int irq, bool balance,
+					       pid_t consumer) { return -ENOSYS; }
+static inline void hisi_irqaffinity_rates(struct seq_file *s) { return; }
 #endif /* CONFIG_HISI_IRQ_AFFINITY */
 #endif /* HISI_IRQ_AFFINITY_H */
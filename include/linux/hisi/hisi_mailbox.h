@@ -43,6 +43,18 @@
 #define CONTINUOUS_FAIL_CNT_MAX   50
 #define CONTINUOUS_FAIL_JUDGE    (likely(g_ContinuousFailCnt < CONTINUOUS_FAIL_CNT_MAX))
 
+/*
+ * Batch frame, on channels whose remote processor unpacks it ("batch" in
+ * the channel's dts node): several short messages in one channel
+ * transaction, so they cost one doorbell interrupt instead of one each.
+ * word 0: MBOX_BATCH_MAGIC << 16 | number of messages,
+ * then for each message its length in words, followed by the message.
+ */
+#define MBOX_BATCH_MAGIC		0xBA7C
+#define MBOX_BATCH_HEAD(nr)		((MBOX_BATCH_MAGIC << 16) | (nr))
+#define MBOX_IS_BATCH(word)		(((word) >> 16) == MBOX_BATCH_MAGIC)
+#define MBOX_BATCH_NR(word)		((word) & 0xffff)
+
 #define MAILBOX_AUTOACK_TIMEOUT msecs_to_jiffies(300)
 #define MAILBOX_MANUACK_TIMEOUT msecs_to_jiffies(300)
 /* IPC_DEFAULT_BOARD_TYPE means hardware_board_type is not UDP&FPGA */
@@ -72,6 +84,37 @@ enum {
 #define MBOX_IS_DEBUG_ON(mbox)	(0)
 #endif
 
+#ifdef CONFIG_HISI_MAILBOX_DEBUGFS
+/* latency histograms, bucket i counts [2^(i-1), 2^i) us, the last one the rest */
+#define MBOX_HIST_BUCKETS	16
+
+enum {
+	MBOX_HIST_TX_QUEUE = 0,	/* send call to the task leaving the queue */
+	MBOX_HIST_TX_ACK,	/* channel written to ack interrupt, sync sends */
+	MBOX_HIST_RX_BH,	/* interrupt to bottom half */
+	MBOX_HIST_MAX
+};
+
+struct hisi_mbox_stats {
+	u32		hist[MBOX_HIST_MAX][MBOX_HIST_BUCKETS];
+	u64		max_ns[MBOX_HIST_MAX];
+	/* tx fifo high-water mark, in tasks */
+	u32		fifo_hwm;
+	/* async sends refused on a full tx fifo */
+	u32		fifo_full;
+	/* sends that found the channel busy, and lost hardware lock attempts */
+	u32		busy_waits;
+	u32		occupy_retries;
+	/* timestamps of the current sync send and of the last interrupt */
+	u64		tx_ns;
+	u64		irq_ns;
+};
+
+#define MBOX_STAT_INC(mdev, field)	((mdev)->stats.field++)
+#else
+#define MBOX_STAT_INC(mdev, field)	do {} while (0)
+#endif
+
 #define IDLE_STATUS				(1 << 4)
 #define SOURCE_STATUS			(1 << 5)
 #define DESTINATION_STATUS		(1 << 6)
@@ -122,6 +165,16 @@ struct hisi_mbox_task {
 	mbox_msg_len_t			tx_buffer_len;
 	mbox_msg_len_t			ack_buffer_len;
 	int				need_auto_ack;
+	/*
+	 * called by the mailbox core instead of hisi_mbox_task_free once an
+	 * async task is sent (tx_ret 0), failed or dropped; for tasks that
+	 * do not come from hisi_mbox_task_alloc
+	 */
+	mbox_complete_t			tx_complete;
+	int				tx_ret;
+#ifdef CONFIG_HISI_MAILBOX_DEBUGFS
+	u64				enqueue_ns;
+#endif
 	/* for performance */
 #ifdef CONFIG_HISI_MAILBOX_PERFORMANCE_DEBUG
 	int				perf_debug;
@@ -159,6 +212,13 @@ struct hisi_mbox_device {
 	struct task_struct * tx_kthread;
 
 	wait_queue_head_t tx_wait;
+
+	/* batch frame size in words, 0 if the remote does not unpack them */
+	int				batch_size;
+
+#ifdef CONFIG_HISI_MAILBOX_DEBUGFS
+	struct hisi_mbox_stats		stats;
+#endif
 };
 
 struct hisi_mbox_dev_ops {
@@ -182,6 +242,7 @@ struct hisi_mbox_dev_ops {
 	unsigned int	(*get_sched_priority)(struct hisi_mbox_device *mdev);
 	unsigned int	(*get_sched_policy)(struct hisi_mbox_device *mdev);
 	unsigned int	(*read_board_type)(struct hisi_mbox_device *mdev);
+	unsigned int	(*get_batch_size)(struct hisi_mbox_device *mdev);
 	/* irq */
 	int		(*request_irq)(struct hisi_mbox_device *mdev, irq_handler_t handler, void *p);
 	void		(*free_irq)(struct hisi_mbox_device *mdev, void *p);
@@ -230,6 +291,14 @@ extern int hisi_mbox_msg_send_sync(struct hisi_mbox *mbox,
  */
 extern int hisi_mbox_msg_send_async(struct hisi_mbox *mbox, struct hisi_mbox_task *tx_task);
 
+/*
+ * atomic context function
+ * queue num tasks at once, all or none, with a single wakeup of the tx
+ * thread, which packs them into batch frames where the channel allows.
+ */
+extern int hisi_mbox_msg_send_async_batch(struct hisi_mbox *mbox,
+				struct hisi_mbox_task **tx_tasks, int num);
+
 extern struct hisi_mbox *hisi_mbox_get(int mdev_index, struct notifier_block *nb);
 extern void hisi_mbox_put(struct hisi_mbox **mbox);
 
@@ -0,0 +1,44 @@
+/*
+ * hisi_pm_async - asynchronous suspend/resume of hisi devices
+ *
+ * Copyright (c) 2013 Huawei Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __HISI_PM_ASYNC_H__
+#define __HISI_PM_ASYNC_H__
+
+#include <linux/device.h>
+#include <linux/pm.h>
+
+#ifdef CONFIG_HISI_SR_ASYNC
+int hisi_pm_for_each_dep(struct device *dev, bool suppliers, void *data,
+			 int (*fn)(struct device *, void *));
+bool hisi_pm_dev_times_enabled(void);
+void hisi_pm_dev_time_record(struct device *dev, pm_message_t state,
+			     const char *info, int error, s64 nsecs);
+#else
+static inline int hisi_pm_for_each_dep(struct device *dev, bool suppliers,
+				       void *data,
+				       int (*fn)(struct device *, void *))
+{
+	return 0;
+}
+
+static inline bool hisi_pm_dev_times_enabled(void)
+{
+	return false;
+}
+
+static inline void hisi_pm_dev_time_record(struct device *dev,
+					   pm_message_t state,
+					   const char *info, int error,
+					   s64 nsecs)
+{
+}
+#endif
+
+#endif
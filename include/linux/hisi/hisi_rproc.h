@@ -80,6 +80,17 @@ extern int hisi_rproc_xfer_async(rproc_id_t rproc_id,
 				rproc_msg_t *msg,
 				rproc_msg_len_t len
 				);
+/*
+ * preallocated async send with a completion callback, one producer per
+ * rproc at a time; hisi_rproc_xfer_async_poll busy waits for them.
+ */
+extern int hisi_rproc_xfer_async_cb(rproc_id_t rproc_id,
+				rproc_msg_t *msg,
+				rproc_msg_len_t len,
+				rproc_complete_t complete,
+				void *data);
+extern int hisi_rproc_xfer_async_poll(rproc_id_t rproc_id,
+				unsigned int timeout_us);
 extern int
 hisi_rproc_rx_register(rproc_id_t rproc_id, struct notifier_block *nb);
 extern int
@@ -27,6 +27,9 @@ struct syscnt_device {
 	u32 sync_interval;      /* period of sync work */
 	struct delayed_work sync_record_work;
 	struct syscnt_to_timespec_record record;
+	u32 vdso_mult;          /* syscounter to ns for the vDSO */
+	u32 vdso_shift;
+	struct delayed_work vdso_work;
 };
 
 #define SYSCOUNTER_L32 SOC_SYSCOUNTER_CNTCV_L32_NS_ADDR(0)
@@ -0,0 +1,34 @@
+#ifndef _HISI_BLK_SCSI_KERN_H_
+#define _HISI_BLK_SCSI_KERN_H_
+
+#include <linux/types.h>
+#include <linux/bsg.h>
+
+struct blk_scsi_kern_ring;
+
+long blk_scsi_kern_ioctl(unsigned int fd, unsigned int cmd, unsigned long arg);
+
+/*
+ * Batched asynchronous sg_io_v4 submission for in-kernel users.
+ *
+ * The ring keeps up to @depth commands in flight on the bsg device
+ * behind @fd. Headers passed to blk_scsi_kern_ring_submit() are used
+ * in place, including the cdb and data buffers they point to, and are
+ * owned by the ring until blk_scsi_kern_ring_reap() hands them back
+ * with their status filled in.
+ *
+ * Submission may stop short of @nr. The return value is the number of
+ * leading headers that were queued; the caller must check hdrs[ret]
+ * for SG_INFO_CHECK to tell a mapping error (errno in spare_out) from
+ * a full ring, and resubmit or fail the rest itself.
+ */
+struct blk_scsi_kern_ring *blk_scsi_kern_ring_alloc(unsigned int fd,
+						    unsigned int depth);
+int blk_scsi_kern_ring_submit(struct blk_scsi_kern_ring *ring,
+			      struct sg_io_v4 *hdrs, unsigned int nr);
+int blk_scsi_kern_ring_reap(struct blk_scsi_kern_ring *ring,
+			    struct sg_io_v4 **done, unsigned int max,
+			    bool wait);
+void blk_scsi_kern_ring_free(struct blk_scsi_kern_ring *ring);
+
+#endif /* _HISI_BLK_SCSI_KERN_H_ */
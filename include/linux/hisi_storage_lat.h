@@ -0,0 +1,87 @@
+#ifndef _HISI_STORAGE_LAT_H_
+#define _HISI_STORAGE_LAT_H_
+
+#include <linux/types.h>
+
+struct request;
+struct stor_lat_ring;
+
+enum stor_lat_backend {
+	STOR_LAT_BACKEND_UFS	= 1,
+	STOR_LAT_BACKEND_EMMC	= 2,
+};
+
+enum stor_lat_stage {
+	STOR_LAT_QUEUE		= 0,	/* request allocated in the block layer */
+	STOR_LAT_DISPATCH	= 1,	/* taken by the host driver */
+	STOR_LAT_DOORBELL	= 2,	/* handed to the controller */
+	STOR_LAT_IRQ		= 3,	/* seen done by the interrupt handler */
+	STOR_LAT_COMPLETE	= 4,	/* handed back to the upper layer */
+	STOR_LAT_NR_STAGES,
+};
+
+enum stor_lat_op {
+	STOR_LAT_OP_READ	= 0,
+	STOR_LAT_OP_WRITE	= 1,
+	STOR_LAT_OP_FLUSH	= 2,
+	STOR_LAT_OP_DISCARD	= 3,
+	STOR_LAT_OP_OTHER	= 4,
+};
+
+/*
+ * Binary format of the debugfs "trace" file of every storage device:
+ * one struct stor_lat_file_hdr followed by nr_recs records, oldest
+ * first. Timestamps are sched_clock() ns, 0 when a stage was not seen.
+ * It is the same for UFS and eMMC so one parser reads both, only
+ * status is the host's own: the scsi result on UFS, -errno on eMMC.
+ */
+#define STOR_LAT_MAGIC		0x54414c53	/* "SLAT" */
+#define STOR_LAT_VERSION	1
+
+struct stor_lat_file_hdr {
+	__u32	magic;
+	__u16	version;
+	__u16	rec_size;
+	__u32	backend;
+	__u32	nr_recs;
+	__u64	lost;		/* records overwritten before being read */
+	char	name[16];
+};
+
+struct stor_lat_rec {
+	__u64	ts_ns[STOR_LAT_NR_STAGES];
+	__u64	sector;
+	__u32	bytes;
+	__s32	status;
+	__u32	seq;
+	__u16	tag;
+	__u8	op;
+	__u8	flags;
+};
+
+#ifdef CONFIG_HISI_STORAGE_LAT_TRACE
+struct stor_lat_ring *stor_lat_ring_alloc(const char *name,
+					  enum stor_lat_backend backend,
+					  unsigned int nr_tags);
+void stor_lat_ring_free(struct stor_lat_ring *ring);
+void stor_lat_start(struct stor_lat_ring *ring, unsigned int tag,
+		    struct request *rq);
+void stor_lat_mark(struct stor_lat_ring *ring, unsigned int tag,
+		   enum stor_lat_stage stage, u64 ts_ns);
+void stor_lat_end(struct stor_lat_ring *ring, unsigned int tag, int status);
+#else /* CONFIG_HISI_STORAGE_LAT_TRACE */
+static inline struct stor_lat_ring *stor_lat_ring_alloc(const char *name,
+		enum stor_lat_backend backend, unsigned int nr_tags)
+{
+	return NULL;
+}
+static inline void stor_lat_ring_free(struct stor_lat_ring *ring) {}
+static inline void stor_lat_start(struct stor_lat_ring *ring,
+		unsigned int tag, struct request *rq) {}
+static inline void stor_lat_mark(struct stor_lat_ring *ring, unsigned int tag,
+		enum stor_lat_stage stage, u64 ts_ns) {}
+static inline void stor_lat_end(struct stor_lat_ring *ring, unsigned int tag,
+		int status) {}
+#endif /* CONFIG_HISI_STORAGE_LAT_TRACE */
+
+#endif /* _HISI_STORAGE_LAT_H_ */
@@ -1199,6 +1199,16 @@ struct mm_walk {
 
 int walk_page_range(unsigned long addr, unsigned long end,
 		struct mm_walk *walk);
+#ifdef CONFIG_PROCESS_RECLAIM_ASYNC
+int process_reclaim_async(struct task_struct *task, bool anon,
+			  unsigned long nr_pages);
+#else
+static inline int process_reclaim_async(struct task_struct *task, bool anon,
+					unsigned long nr_pages)
+{
+	return -ENODEV;
+}
+#endif
 int walk_page_vma(struct vm_area_struct *vma, struct mm_walk *walk);
 void free_pgd_range(struct mmu_gather *tlb, unsigned long addr,
 		unsigned long end, unsigned long floor, unsigned long ceiling);
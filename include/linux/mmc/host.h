@@ -16,6 +16,7 @@
 #include <linux/device.h>
 #include <linux/fault-inject.h>
 #include <linux/wakelock.h>
+#include <linux/hisi_storage_lat.h>
 
 #include <linux/mmc/core.h>
 #include <linux/mmc/card.h>
@@ -488,6 +489,8 @@ struct mmc_host {
 
 	unsigned int    cmdq_slots;
 	struct mmc_cmdq_context_info    cmdq_ctx;
+	/* cmdq latency trace, NULL unless CONFIG_HISI_STORAGE_LAT_TRACE */
+	struct stor_lat_ring	*lat_ring;
 	/*
 	* several cmdq supporting host controllers are extensions
 	* of legacy controllers. This variable can be used to store
@@ -196,6 +196,9 @@ struct xt_table {
 	u_int8_t af;		/* address/protocol family */
 	int priority;		/* hook order */
 
+	/* Verdicts of established flows may be cached (ipt_do_table) */
+	bool flowcache;
+
 	/* A unique name... */
 	const char name[XT_TABLE_MAXNAMELEN];
 };
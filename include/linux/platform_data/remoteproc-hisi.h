@@ -84,6 +84,8 @@ int hisi_isp_rproc_case_set(enum hisi_isp_rproc_case_attr);
 enum hisi_isp_rproc_case_attr hisi_isp_rproc_case_get(void);
 struct regulator *get_isp_regulator(void);
 
+int hisi_atfisp_cma_prepare(void);
+void hisi_atfisp_cma_prepare_cancel(void);
 int hisi_atfisp_cma_alloc(void);
 void hisi_atfisp_cma_free(void);
 void *hisi_fstcma_alloc(dma_addr_t *dma_handle, size_t size, gfp_t flag);
@@ -40,7 +40,10 @@
  * @relax_count: Number of times the wakeup source was deactivated.
  * @expire_count: Number of times the wakeup source's timeout has expired.
  * @wakeup_count: Number of times the wakeup source might abort suspend.
+ * @blocked_count: Number of suspend attempts the wakeup source blocked.
+ * @blocked_time: Total duration of the holds that blocked a suspend attempt.
  * @active: Status of the wakeup source.
+ * @blocking: The current hold has blocked a suspend attempt.
  * @has_timeout: The wakeup source has been activated with a timeout.
  */
 struct wakeup_source {
@@ -59,8 +62,11 @@ struct wakeup_source {
 	unsigned long		relax_count;
 	unsigned long		expire_count;
 	unsigned long		wakeup_count;
+	unsigned long		blocked_count;
+	ktime_t blocked_time;
 	bool			active:1;
 	bool			autosleep_enabled:1;
+	bool			blocking:1;
 };
 
 #ifdef CONFIG_PM_SLEEP
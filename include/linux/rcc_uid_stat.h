@@ -0,0 +1,29 @@
+#ifndef _LINUX_RCC_UID_STAT_H
+#define _LINUX_RCC_UID_STAT_H
+
+#include <linux/types.h>
+
+/*
+ * Per-uid swap telemetry of rcc, read from /proc/rcc_uid_stat.
+ *
+ * Swap device drivers report every swap cache page they store or read
+ * back.
+ * Stores are charged to the uid a process reclaim is working on, see
+ * rcc_uid_reclaim_begin(), and are not charged otherwise, since the
+ * reclaimer does not know whose page it is writing. Reads are charged
+ * to the uid being reclaimed or, outside of a reclaim, to the faulting
+ * task.
+ */
+#ifdef CONFIG_HUAWEI_RCC_UID_STAT
+void rcc_uid_reclaim_begin(uid_t uid);
+void rcc_uid_reclaim_end(void);
+void rcc_uid_swap_out(size_t orig_size, size_t compr_size);
+void rcc_uid_swap_in(void);
+#else
+static inline void rcc_uid_reclaim_begin(uid_t uid) {}
+static inline void rcc_uid_reclaim_end(void) {}
+static inline void rcc_uid_swap_out(size_t orig_size, size_t compr_size) {}
+static inline void rcc_uid_swap_in(void) {}
+#endif
+
+#endif /* _LINUX_RCC_UID_STAT_H */
@@ -503,6 +503,8 @@ enum rproc_crash_type {
  * @cached_table: copy of the resource table
  * @table_csum: checksum of the resource table
  * @has_iommu: flag to indicate if remote processor is behind an MMU
+ * @fw_cache: firmware image kept across power cycles in warm standby
+ * @bw_cache: bootware image kept across power cycles in warm standby
  */
 struct rproc {
 	struct klist_node node;
@@ -547,6 +549,8 @@ struct rproc {
 	u32 table_csum;
 	bool has_iommu;
 	struct work_struct sec_rscwork;
+	const struct firmware *fw_cache;
+	const struct firmware *bw_cache;
 };
 
 /* we currently support only two vrings per rvdev */
@@ -399,6 +399,8 @@ extern bool pm_save_wakeup_count(unsigned int count);
 extern void pm_wakep_autosleep_enabled(bool set);
 extern void pm_print_active_wakeup_sources(void);
 extern void pm_get_active_wakeup_sources(char *pending_sources, size_t max);
+struct seq_file;
+extern void pm_wakeup_blockers_show(struct seq_file *m);
 
 static inline void lock_system_sleep(void)
 {
@@ -41,5 +41,13 @@ struct task_io_accounting {
 	 * information loss in doing that.
 	 */
 	u64 cancelled_write_bytes;
+
+	/*
+	 * Time in ns this task spent blocked on storage: waiting for a page
+	 * cache miss to be read, in fsync, and throttled for dirtying pages.
+	 */
+	u64 read_wait_ns;
+	u64 fsync_wait_ns;
+	u64 dirty_wait_ns;
 #endif /* CONFIG_TASK_IO_ACCOUNTING */
 };
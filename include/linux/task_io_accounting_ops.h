@@ -5,11 +5,13 @@
 #define __TASK_IO_ACCOUNTING_OPS_INCLUDED
 
 #include <linux/sched.h>
+#include <linux/uid_iostats.h>
 
 #ifdef CONFIG_TASK_IO_ACCOUNTING
 static inline void task_io_account_read(size_t bytes)
 {
 	current->ioac.read_bytes += bytes;
+	uid_iostats_account(bytes, false);
 }
 
 /*
@@ -24,6 +26,7 @@ static inline unsigned long task_io_get_inblock(const struct task_struct *p)
 static inline void task_io_account_write(size_t bytes)
 {
 	current->ioac.write_bytes += bytes;
+	uid_iostats_account(bytes, true);
 }
 
 /*
@@ -40,6 +43,27 @@ static inline void task_io_account_cancelled_write(size_t bytes)
 	current->ioac.cancelled_write_bytes += bytes;
 }
 
+/* ns spent waiting for a page cache miss to be read from storage */
+static inline void task_io_account_read_wait(u64 ns)
+{
+	current->ioac.read_wait_ns += ns;
+	uid_iostats_account_wait(UID_IO_WAIT_READ, ns);
+}
+
+/* ns spent in fsync */
+static inline void task_io_account_fsync_wait(u64 ns)
+{
+	current->ioac.fsync_wait_ns += ns;
+	uid_iostats_account_wait(UID_IO_WAIT_FSYNC, ns);
+}
+
+/* ns spent throttled in balance_dirty_pages() */
+static inline void task_io_account_dirty_wait(u64 ns)
+{
+	current->ioac.dirty_wait_ns += ns;
+	uid_iostats_account_wait(UID_IO_WAIT_DIRTY, ns);
+}
+
 static inline void task_io_accounting_init(struct task_io_accounting *ioac)
 {
 	memset(ioac, 0, sizeof(*ioac));
@@ -51,6 +75,9 @@ static inline void task_blk_io_accounting_add(struct task_io_accounting *dst,
 	dst->read_bytes += src->read_bytes;
 	dst->write_bytes += src->write_bytes;
 	dst->cancelled_write_bytes += src->cancelled_write_bytes;
+	dst->read_wait_ns += src->read_wait_ns;
+	dst->fsync_wait_ns += src->fsync_wait_ns;
+	dst->dirty_wait_ns += src->dirty_wait_ns;
 }
 
 #else
@@ -77,6 +104,18 @@ static inline void task_io_account_cancelled_write(size_t bytes)
 {
 }
 
+static inline void task_io_account_read_wait(u64 ns)
+{
+}
+
+static inline void task_io_account_fsync_wait(u64 ns)
+{
+}
+
+static inline void task_io_account_dirty_wait(u64 ns)
+{
+}
+
 static inline void task_io_accounting_init(struct task_io_accounting *ioac)
 {
 }
@@ -553,6 +553,8 @@ enum ipa_actor
 void ipa_freq_limit_init(void);
 unsigned int ipa_freq_limit(enum ipa_actor actor,unsigned int target_freq);
 unsigned long get_soc_temp(void);
+void ipa_frame_demand_hint(enum ipa_actor actor, u64 work_ns, u64 deadline_ns);
+u32 ipa_actor_demand(struct thermal_cooling_device *cdev, u32 *min_power);
 #else
 static inline unsigned long get_soc_temp(void)
 {
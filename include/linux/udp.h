@@ -71,6 +71,11 @@ struct udp_sock {
 	 */
 	int (*encap_rcv)(struct sock *sk, struct sk_buff *skb);
 	void (*encap_destroy)(struct sock *sk);
+
+	/* datagrams moved off sk_receive_queue a batch at a time, read
+	 * without contending with the softirq producer
+	 */
+	struct sk_buff_head	reader_queue ____cacheline_aligned_in_smp;
 };
 
 static inline struct udp_sock *udp_sk(const struct sock *sk)
@@ -0,0 +1,41 @@
+#ifndef _LINUX_UID_IOSTATS_H
+#define _LINUX_UID_IOSTATS_H
+
+#include <linux/types.h>
+#include <linux/jump_label.h>
+
+enum uid_io_wait {
+	UID_IO_WAIT_READ = 0,
+	UID_IO_WAIT_FSYNC,
+	UID_IO_WAIT_DIRTY,
+	UID_IO_WAIT_NR
+};
+
+/*
+ * Per-uid io bytes and storage wait time of /proc/uid_iostats. What a
+ * task accounts for itself is also charged to its uid while that uid
+ * is listed in uid_iomonitor_list. The key stays off while the list is
+ * empty.
+ */
+#ifdef CONFIG_HUAWEI_UID_IO_STATS
+extern struct static_key_false uid_iostats_key;
+void __uid_iostats_account(size_t bytes, bool write);
+void __uid_iostats_account_wait(enum uid_io_wait type, u64 ns);
+
+static inline void uid_iostats_account(size_t bytes, bool write)
+{
+	if (static_branch_unlikely(&uid_iostats_key))
+		__uid_iostats_account(bytes, write);
+}
+
+static inline void uid_iostats_account_wait(enum uid_io_wait type, u64 ns)
+{
+	if (static_branch_unlikely(&uid_iostats_key))
+		__uid_iostats_account_wait(type, ns);
+}
+#else
+static inline void uid_iostats_account(size_t bytes, bool write) {}
+static inline void uid_iostats_account_wait(enum uid_io_wait type, u64 ns) {}
+#endif
+
+#endif /* _LINUX_UID_IOSTATS_H */
@@ -23,5 +23,6 @@
 void log_wakeup_reason(int irq);
 void log_suspend_abort_reason(const char *fmt, ...);
 int check_wakeup_reason(int irq);
+int get_wakeup_reason_irqs(int *irqs, int max);
 
 #endif /* _LINUX_WAKEUP_REASON_H */
@@ -71,6 +71,17 @@ struct nf_conn_help {
 #include <net/netfilter/ipv4/nf_conntrack_ipv4.h>
 #include <net/netfilter/ipv6/nf_conntrack_ipv6.h>
 
+/* verdict of one iptables table for one direction, see ipt_do_table() */
+struct nf_conn_flowcache {
+	unsigned int	gen;		/* ruleset generation, 0 if empty */
+	u8		hook;
+	u8		verdict;
+	int		iif;
+	int		oif;
+	unsigned int	rule;		/* offset of the deciding entry */
+	const void	*table;		/* the xt_table_info it was found in */
+};
+
 struct nf_conn {
 	/* Usage count in here is 1 for hash table/destruct timer, 1 per skb,
 	 * plus 1 for any connection(s) we are `master' for
@@ -114,6 +125,10 @@ struct nf_conn {
 	/* Extensions */
 	struct nf_ct_ext *ext;
 
+#ifdef CONFIG_IP_NF_FILTER_FLOWCACHE
+	struct nf_conn_flowcache flowcache[IP_CT_DIR_MAX];
+#endif
+
 	/* Storage reserved for other modules, must be the last member */
 	union nf_conntrack_proto proto;
 };
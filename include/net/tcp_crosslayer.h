@@ -114,22 +114,44 @@ extern unsigned int aspen_log_level;
 
 /* Switch of crosslayer dropped notification */
 extern int aspen_tcp_cdn;
+/* Dropped packet reported by source port only */
 struct aspen_cdn_info {
 	unsigned int		seq;
 	unsigned short		port;
 	unsigned short		type;
 };
 
+/* Addresses in network order, ports in host order */
+struct aspen_cdn_tuple {
+	__be32			saddr;
+	__be32			daddr;
+	unsigned short		sport;
+	unsigned short		dport;
+};
+
+/* Dropped packet reported with the full 4-tuple of its flow */
+struct aspen_cdn_tuple_info {
+	struct aspen_cdn_tuple	tuple;
+	unsigned int		seq;
+	unsigned int		type;
+};
+
 struct aspen_cdn_hashtable {
 	struct hlist_head	head;
 	spinlock_t		lock;
 };
 
+/*
+ * One per marked socket, hashed twice: by 4-tuple, and by source port for
+ * the notifications which only carry the port. Lookups are RCU, the bucket
+ * locks only serialize writers.
+ */
 struct aspen_cdn_hashbucket {
 	struct hlist_node	node;
+	struct hlist_node	port_node;
+	struct rcu_head		rcu;
 	struct sock		*sk;
-	int			refs;
-	unsigned short		port;
+	struct aspen_cdn_tuple	tuple;
 };
 
 #ifdef CONFIG_HW_CROSSLAYER_OPT_DBG_MODULE
@@ -189,6 +211,7 @@ extern int aspen_init_hashtable(void);
 extern void aspen_mark_hashtable(struct sock *sk, unsigned short int port);
 extern void aspen_unmark_hashtable(struct sock *sk);
 extern void aspen_crosslayer_recovery(void *ptr, int length);
+extern void aspen_crosslayer_recovery_tuple(void *ptr, int length);
 extern void aspen_tcp_crosslayer_retransmit(struct sock *sk);
 extern bool aspen_tcp_try_undo_modem_drop(struct sock *sk,
 					  enum tcp_undo_from_state state);
@@ -375,6 +375,36 @@ TRACE_EVENT(IPA_actor_gpu_get_power,
 		 __entry->dynamic_power, __entry->static_power, __entry->req_power)
 );/* [false alarm]:fortify */
 
+TRACE_EVENT(IPA_actor_budget,
+	TP_PROTO(const char *type, u32 req_power, u32 weighted_req_power,
+		 u32 demand, u32 min_power, u32 granted_power),
+
+	TP_ARGS(type, req_power, weighted_req_power, demand, min_power,
+		granted_power),
+
+	TP_STRUCT__entry(
+		__string(type, type)
+		__field(u32, req_power         )
+		__field(u32, weighted_req_power)
+		__field(u32, demand            )
+		__field(u32, min_power         )
+		__field(u32, granted_power     )
+	),
+
+	TP_fast_assign(
+		__assign_str(type, type);
+		__entry->req_power = req_power;
+		__entry->weighted_req_power = weighted_req_power;
+		__entry->demand = demand;
+		__entry->min_power = min_power;
+		__entry->granted_power = granted_power;
+	),
+
+	TP_printk("%s,%u,%u,%u,%u,%u",
+		__get_str(type), __entry->req_power,
+		__entry->weighted_req_power, __entry->demand,
+		__entry->min_power, __entry->granted_power)
+);/* [false alarm]:fortify */
 
 TRACE_EVENT(IPA_get_tsens_value,
 	TP_PROTO(unsigned long tsens_value0, unsigned long tsens_value1, unsigned long tsens_value2,
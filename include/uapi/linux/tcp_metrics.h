@@ -50,6 +50,7 @@ enum {
 	TCP_METRICS_CMD_UNSPEC,
 	TCP_METRICS_CMD_GET,
 	TCP_METRICS_CMD_DEL,
+	TCP_METRICS_CMD_SET,	/* restore an entry saved with CMD_GET */
 
 	__TCP_METRICS_CMD_MAX,
 };
@@ -307,6 +307,12 @@ struct adf_device {
 
 	struct sw_sync_timeline *timeline;
 	int timeline_max;
+
+	/* early release of the on-screen config, see
+	 * adf_device_scanout_done() */
+	spinlock_t release_lock;
+	bool timeline_posted;
+	bool onscreen_released;
 };
 
 /**
@@ -491,6 +497,7 @@ static inline void adf_vsync_put(struct adf_interface *intf)
 
 int adf_vsync_wait(struct adf_interface *intf, long timeout);
 void adf_vsync_notify(struct adf_interface *intf, ktime_t timestamp);
+void adf_device_scanout_done(struct adf_device *dev);
 
 int adf_hotplug_notify_connected(struct adf_interface *intf,
 		struct drm_mode_modeinfo *modelist, size_t n_modes);
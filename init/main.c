@@ -81,6 +81,7 @@
 #include <linux/integrity.h>
 #include <linux/proc_ns.h>
 #include <linux/io.h>
+#include <linux/hisi/hisi_boottime.h>
 
 #include <asm/io.h>
 #include <asm/bugs.h>
@@ -792,14 +793,17 @@ int __init_or_module do_one_initcall(initcall_t fn)
 	int count = preempt_count();
 	int ret;
 	char msgbuf[64];
+	ktime_t start;
 
 	if (initcall_blacklisted(fn))
 		return -EPERM;
 
+	start = boot_time_start();
 	if (initcall_debug)
 		ret = do_one_initcall_debug(fn);
 	else
 		ret = fn();
+	boot_time_end_fn(BOOT_TIME_INITCALL, (void *)fn, start, ret);
 
 	msgbuf[0] = 0;
 
@@ -963,10 +967,14 @@ static inline void mark_readonly(void)
 static int __ref kernel_init(void *unused)
 {
 	int ret;
+	ktime_t start;
 
 	kernel_init_freeable();
 	/* need to finish all async __init code before freeing the memory */
+	start = boot_time_start();
 	async_synchronize_full();
+	boot_time_end_fn(BOOT_TIME_PROBE_WAIT, (void *)async_synchronize_full,
+			 start, 0);
 	free_initmem();
 	mark_readonly();
 	system_state = SYSTEM_RUNNING;
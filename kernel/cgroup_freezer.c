@@ -22,6 +22,9 @@
 #include <linux/freezer.h>
 #include <linux/seq_file.h>
 #include <linux/mutex.h>
+#include <linux/ioprio.h>
+#include <linux/iocontext.h>
+#include <linux/mm.h>
 
 /*
  * A cgroup is freezing if any FREEZING flags are set.  FREEZING_SELF is
@@ -43,6 +46,10 @@ enum freezer_state_flags {
 struct freezer {
 	struct cgroup_subsys_state	css;
 	unsigned int			state;
+#ifdef CONFIG_CGROUP_FREEZER_BG
+	bool				background;
+	unsigned long			reclaim_pages;
+#endif
 };
 
 static DEFINE_MUTEX(freezer_mutex);
@@ -62,6 +69,15 @@ static struct freezer *parent_freezer(struct freezer *freezer)
 	return css_freezer(freezer->css.parent);
 }
 
+static inline bool freezer_background(struct freezer *freezer)
+{
+#ifdef CONFIG_CGROUP_FREEZER_BG
+	return freezer->background;
+#else
+	return false;
+#endif
+}
+
 bool cgroup_freezing(struct task_struct *task)
 {
 	bool ret;
@@ -340,6 +356,78 @@ static void unfreeze_cgroup(struct freezer *freezer)
 	css_task_iter_end(&it);
 }
 
+#ifdef CONFIG_CGROUP_FREEZER_BG
+static int task_ioprio_class(struct task_struct *task)
+{
+	int ioprio = IOPRIO_PRIO_VALUE(IOPRIO_CLASS_NONE, 0);
+
+	task_lock(task);
+	if (task->io_context)
+		ioprio = task->io_context->ioprio;
+	task_unlock(task);
+
+	return IOPRIO_PRIO_CLASS(ioprio);
+}
+
+/*
+ * A background cgroup going frozen gives up its io bandwidth and its
+ * memory: its tasks move to the idle io class, so whatever they still
+ * have in flight yields to the foreground, and each process gets its
+ * anon pages swapped to zram and its clean file pages dropped, up to
+ * reclaim_pages of each, so that they are reclaimed before the pages
+ * of the apps in use. The reclaim is asynchronous, see
+ * process_reclaim_async(). Tasks already in the rt class are left as
+ * they are.
+ */
+static void background_freeze_cgroup(struct freezer *freezer)
+{
+	struct css_task_iter it;
+	struct task_struct *task;
+
+	css_task_iter_start(&freezer->css, &it);
+	while ((task = css_task_iter_next(&it))) {
+		if (task->flags & PF_KTHREAD)
+			continue;
+
+		if (task_ioprio_class(task) != IOPRIO_CLASS_RT)
+			set_task_ioprio(task,
+				IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0));
+
+		if (!freezer->reclaim_pages || !thread_group_leader(task))
+			continue;
+		process_reclaim_async(task, true, freezer->reclaim_pages);
+		process_reclaim_async(task, false, freezer->reclaim_pages);
+	}
+	css_task_iter_end(&it);
+}
+
+/*
+ * The io class the task had before the freeze is not kept, idle tasks
+ * go back to the default one, which follows their nice value.
+ */
+static void background_thaw_cgroup(struct freezer *freezer)
+{
+	struct css_task_iter it;
+	struct task_struct *task;
+
+	css_task_iter_start(&freezer->css, &it);
+	while ((task = css_task_iter_next(&it))) {
+		if (task_ioprio_class(task) == IOPRIO_CLASS_IDLE)
+			set_task_ioprio(task,
+				IOPRIO_PRIO_VALUE(IOPRIO_CLASS_NONE, 0));
+	}
+	css_task_iter_end(&it);
+}
+#else
+static inline void background_freeze_cgroup(struct freezer *freezer)
+{
+}
+
+static inline void background_thaw_cgroup(struct freezer *freezer)
+{
+}
+#endif
+
 /**
  * freezer_apply_state - apply state change to a single cgroup_freezer
  * @freezer: freezer to apply state change to
@@ -359,10 +447,14 @@ static void freezer_apply_state(struct freezer *freezer, bool freeze,
 		return;
 
 	if (freeze) {
-		if (!(freezer->state & CGROUP_FREEZING))
+		bool was_freezing = freezer->state & CGROUP_FREEZING;
+
+		if (!was_freezing)
 			atomic_inc(&system_freezing_cnt);
 		freezer->state |= state;
 		freeze_cgroup(freezer);
+		if (!was_freezing && freezer_background(freezer))
+			background_freeze_cgroup(freezer);
 	} else {
 		bool was_freezing = freezer->state & CGROUP_FREEZING;
 
@@ -373,6 +465,8 @@ static void freezer_apply_state(struct freezer *freezer, bool freeze,
 				atomic_dec(&system_freezing_cnt);
 			freezer->state &= ~CGROUP_FROZEN;
 			unfreeze_cgroup(freezer);
+			if (was_freezing && freezer_background(freezer))
+				background_thaw_cgroup(freezer);
 		}
 	}
 }
@@ -453,6 +547,44 @@ static u64 freezer_parent_freezing_read(struct cgroup_subsys_state *css,
 	return (bool)(freezer->state & CGROUP_FREEZING_PARENT);
 }
 
+#ifdef CONFIG_CGROUP_FREEZER_BG
+static u64 freezer_background_read(struct cgroup_subsys_state *css,
+				   struct cftype *cft)
+{
+	return css_freezer(css)->background;
+}
+
+static int freezer_background_write(struct cgroup_subsys_state *css,
+				    struct cftype *cft, u64 val)
+{
+	if (val > 1)
+		return -EINVAL;
+
+	mutex_lock(&freezer_mutex);
+	css_freezer(css)->background = val;
+	mutex_unlock(&freezer_mutex);
+	return 0;
+}
+
+static u64 freezer_reclaim_pages_read(struct cgroup_subsys_state *css,
+				      struct cftype *cft)
+{
+	return css_freezer(css)->reclaim_pages;
+}
+
+static int freezer_reclaim_pages_write(struct cgroup_subsys_state *css,
+				       struct cftype *cft, u64 val)
+{
+	if (val > totalram_pages)
+		return -EINVAL;
+
+	mutex_lock(&freezer_mutex);
+	css_freezer(css)->reclaim_pages = val;
+	mutex_unlock(&freezer_mutex);
+	return 0;
+}
+#endif
+
 static struct cftype files[] = {
 	{
 		.name = "state",
@@ -470,6 +602,20 @@ static struct cftype files[] = {
 		.flags = CFTYPE_NOT_ON_ROOT,
 		.read_u64 = freezer_parent_freezing_read,
 	},
+#ifdef CONFIG_CGROUP_FREEZER_BG
+	{
+		.name = "background",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = freezer_background_read,
+		.write_u64 = freezer_background_write,
+	},
+	{
+		.name = "reclaim_pages",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = freezer_reclaim_pages_read,
+		.write_u64 = freezer_reclaim_pages_write,
+	},
+#endif
 	{ }	/* terminate */
 };
 
@@ -39,9 +39,28 @@
 #include <linux/eventfd.h>
 #include <linux/poll.h>
 #include <linux/file.h>
+#include <linux/moduleparam.h>
+#include <linux/workqueue.h>
+#include <linux/jiffies.h>
+#include <linux/rcupdate.h>
 
 #define PIDS_MAX (PID_MAX_LIMIT + 1ULL)
 
+/*
+ * A fork charges every level of the hierarchy, which makes the counters
+ * of the top levels the hottest cache lines of a fork storm. Each cgroup
+ * therefore keeps a reserve of pids charged to the whole hierarchy but
+ * not used yet: forks take from it and exits give back to it, so the
+ * hierarchy is only walked once per PIDS_CHARGE_BATCH forks. The reserve
+ * is drained before a fork is refused, which keeps the limits exact, and
+ * it is not part of pids.current.
+ */
+#define PIDS_CHARGE_BATCH	16
+
+/* soft limit crossings are reported at most once per this interval */
+static unsigned int event_interval_ms = 100;
+module_param(event_interval_ms, uint, 0644);
+
 struct pids_cgroup {
 	struct cgroup_subsys_state	css;
 
@@ -55,13 +74,25 @@ struct pids_cgroup {
 	/*each group_pids is default limit*/
 	int64_t				group_soft_limit;
 	int64_t				group_limit;
-	/* The list of pid_event structs. */
+	/* The list of pids_cgroup_event structs. */
 	struct		list_head event_list;
+	/* The list of pid_event structs. */
+	struct		list_head efd_list;
 	/* Have to grab the lock on events traversal or modifications. */
 	spinlock_t		event_list_lock;
 	struct list_head		group_pids_list;
+	/* protects group_pids_list and the task lists of its group_pids */
+	spinlock_t			group_pids_lock;
 
 	int64_t				token;
+
+	/* pids charged to the hierarchy but not used yet */
+	atomic64_t			reserve;
+
+	/* soft limit crossings not reported yet */
+	atomic_t			events;
+	unsigned long			last_event;
+	struct delayed_work		event_work;
 };
 
 static struct pids_cgroup *css_pids(struct cgroup_subsys_state *css)
@@ -82,19 +113,20 @@ static struct pids_cgroup *parent_pids(struct pids_cgroup *pids)
 struct group_pids {
 	/* All the tasks in the same QoS group are in this list */
 	struct list_head	head;
-	/* Linked to the global group_pids_list */
+	/* Linked to the group_pids_list of its cgroup */
 	struct list_head	node;
+	struct pids_cgroup	*pids;
+	struct rcu_head		rcu;
 	int64_t				soft_limit;
 	int64_t				limit;
 
 	atomic64_t	counter;
 	int64_t		token;
 	/*true: has signal to user space, at default, it is false, no */
-	bool	signal;
+	int	signal;
 };
 
 static void pids_event(struct pids_cgroup *pids, struct group_pids *gp);
-static DEFINE_SPINLOCK(group_pids_lock);
 
 static int group_pids_try_charge(struct group_pids *gp, int num)
 {
@@ -123,23 +155,35 @@ static void group_pids_uncharge(struct group_pids *gp, int num)
 	WARN_ON_ONCE(atomic64_add_negative(-num, &gp->counter));
 }
 
-static void group_pids_migrate(struct task_struct *tsk, struct group_pids *gp)
+/* forks charge the group_pids of current under rcu only */
+static void group_pids_del(struct task_struct *tsk)
 {
-	struct group_pids *old_gp = tsk->group_pids;
+	struct group_pids *gp = tsk->group_pids;
+	struct pids_cgroup *pids;
 
-	if (old_gp) {
-		list_del(&tsk->group_pids_list);
-		atomic64_dec(&old_gp->counter);
+	if (!gp)
+		return;
 
-		if (list_empty(&old_gp->head)) {
-			list_del(&old_gp->node);
-			kfree(old_gp);
-		}
+	pids = gp->pids;
+	spin_lock(&pids->group_pids_lock);
+	list_del(&tsk->group_pids_list);
+	atomic64_dec(&gp->counter);
+	if (list_empty(&gp->head)) {
+		list_del(&gp->node);
+		kfree_rcu(gp, rcu);
 	}
+	spin_unlock(&pids->group_pids_lock);
+}
+
+static void group_pids_migrate(struct task_struct *tsk, struct group_pids *gp)
+{
+	group_pids_del(tsk);
 
+	spin_lock(&gp->pids->group_pids_lock);
 	list_add_tail(&tsk->group_pids_list, &gp->head);
 	atomic64_inc(&gp->counter);
 	tsk->group_pids = gp;
+	spin_unlock(&gp->pids->group_pids_lock);
 }
 
 static int group_pids_max_show(struct seq_file *m, void *V)
@@ -148,7 +192,7 @@ static int group_pids_max_show(struct seq_file *m, void *V)
 	struct group_pids *gp;
 	struct task_struct *task;
 
-	spin_lock(&group_pids_lock);
+	spin_lock(&pids->group_pids_lock);
 
 	list_for_each_entry(gp, &pids->group_pids_list, node) {
 		WARN_ON(list_empty(&gp->head));
@@ -163,7 +207,7 @@ static int group_pids_max_show(struct seq_file *m, void *V)
 			   (long long)atomic64_read(&gp->counter));
 	}
 
-	spin_unlock(&group_pids_lock);
+	spin_unlock(&pids->group_pids_lock);
 	return 0;
 }
 
@@ -193,17 +237,18 @@ static ssize_t group_pids_limit_write(struct kernfs_open_file *of,
 	pids->group_soft_limit = soft_limit;
 	pids->group_limit = max;
 
-	spin_lock(&group_pids_lock);
+	spin_lock(&pids->group_pids_lock);
 
 	list_for_each_entry(gp, &pids->group_pids_list, node) {
 		gp->soft_limit = soft_limit;
 		gp->limit = max;
 	}
 
-	spin_unlock(&group_pids_lock);
+	spin_unlock(&pids->group_pids_lock);
 	return nbytes;
 }
 
+static void pids_event_work_fn(struct work_struct *work);
 
 static struct cgroup_subsys_state *pids_css_alloc(
 				    struct cgroup_subsys_state *parent_css)
@@ -220,13 +265,25 @@ static struct cgroup_subsys_state *pids_css_alloc(
 	atomic64_set(&pids->counter, 0);
 	INIT_LIST_HEAD(&pids->group_pids_list);
 	INIT_LIST_HEAD(&pids->event_list);
+	INIT_LIST_HEAD(&pids->efd_list);
 	spin_lock_init(&pids->event_list_lock);
+	spin_lock_init(&pids->group_pids_lock);
+	atomic64_set(&pids->reserve, 0);
+	atomic_set(&pids->events, 0);
+	INIT_DELAYED_WORK(&pids->event_work, pids_event_work_fn);
 	return &pids->css;
 }
 
+static void pids_drain_reserve(struct pids_cgroup *pids);
+
 static void pids_css_free(struct cgroup_subsys_state *css)
 {
-	kfree(css_pids(css));
+	struct pids_cgroup *pids = css_pids(css);
+
+	cancel_delayed_work_sync(&pids->event_work);
+	/* exits after offline may have refilled it */
+	pids_drain_reserve(pids);
+	kfree(pids);
 }
 
 
@@ -286,7 +343,8 @@ static void pids_charge(struct pids_cgroup *pids, int num)
  * would cause the new value to exceed the hierarchical limit.
  * Returns 0 if the charge succeded, otherwise -EAGAIN.
  */
-static int pids_try_charge(struct pids_cgroup *pids, int num)
+static int pids_try_charge(struct pids_cgroup *pids, int num,
+			   struct pids_cgroup **fail)
 {
 	struct pids_cgroup *p, *q;
 
@@ -304,9 +362,61 @@ revert:
 		pids_cancel(q, num);
 	pids_cancel(p, num);
 
+	if (fail)
+		*fail = p;
 	return -EAGAIN;
 }
 
+/* give the reserve of @pids back to the hierarchy */
+static void pids_drain_reserve(struct pids_cgroup *pids)
+{
+	int64_t nr = atomic64_xchg(&pids->reserve, 0);
+
+	if (nr)
+		pids_uncharge(pids, nr);
+}
+
+/**
+ * pids_fork_charge - charge one fork, from the reserve if possible
+ * @pids: the pid cgroup state
+ *
+ * Falls back to an exact charge near a limit, and before failing drains
+ * the reserves below the level that refused, so that pids charged but
+ * not used never make a fork fail.
+ */
+static int pids_fork_charge(struct pids_cgroup *pids)
+{
+	struct cgroup_subsys_state *pos;
+	struct pids_cgroup *fail;
+
+	if (atomic64_dec_if_positive(&pids->reserve) >= 0)
+		return 0;
+
+	if (!pids_try_charge(pids, PIDS_CHARGE_BATCH, NULL)) {
+		atomic64_add(PIDS_CHARGE_BATCH - 1, &pids->reserve);
+		return 0;
+	}
+
+	if (!pids_try_charge(pids, 1, &fail))
+		return 0;
+
+	rcu_read_lock();
+	css_for_each_descendant_pre(pos, &fail->css)
+		pids_drain_reserve(css_pids(pos));
+	rcu_read_unlock();
+
+	return pids_try_charge(pids, 1, NULL);
+}
+
+static void pids_fork_uncharge(struct pids_cgroup *pids)
+{
+	if ((pids->css.flags & CSS_ONLINE) &&
+	    atomic64_read(&pids->reserve) < PIDS_CHARGE_BATCH)
+		atomic64_inc(&pids->reserve);
+	else
+		pids_uncharge(pids, 1);
+}
+
 /* This is protected by cgroup lock */
 static struct group_pids *tmp_gp;
 static struct pids_cgroup *pids_attach_old_cs;
@@ -347,7 +457,10 @@ static void pids_attach(struct cgroup_subsys_state *css,
 	struct task_struct *task;
 	int64_t num = 0;
 
-	spin_lock(&group_pids_lock);
+	tmp_gp->pids = pids;
+	spin_lock(&pids->group_pids_lock);
+	list_add(&tmp_gp->node, &pids->group_pids_list);
+	spin_unlock(&pids->group_pids_lock);
 
 	cgroup_taskset_for_each(task, tset) {
 		num++;
@@ -355,9 +468,6 @@ static void pids_attach(struct cgroup_subsys_state *css,
 
 		group_pids_migrate(task, tmp_gp);
 	}
-	list_add(&tmp_gp->node, &pids->group_pids_list);
-
-	spin_unlock(&group_pids_lock);
 
 	/*
 	 * Attaching to a cgroup is allowed to overcome the
@@ -372,26 +482,29 @@ static void pids_attach(struct cgroup_subsys_state *css,
 int cgroup_pids_can_fork(void)
 {
 	struct pids_cgroup *pids = NULL;
+	struct group_pids *gp;
 	int ret;
 
 	rcu_read_lock();
 	pids = task_pids(current);
 	rcu_read_unlock();
-	ret = pids_try_charge(pids, 1);
+	ret = pids_fork_charge(pids);
 	if (ret)
 		return ret;
 
-	spin_lock(&group_pids_lock);
-	ret = group_pids_try_charge(current->group_pids, 1);
+	/* a racing attach frees the old group_pids after a grace period */
+	rcu_read_lock();
+	gp = ACCESS_ONCE(current->group_pids);
+	ret = group_pids_try_charge(gp, 1);
 	if (ret == -ENOMEM) {
 		pr_warn("Pid %d(%s) over pids cgroup hard_limit\n",
 		     task_tgid_vnr(current), current->comm);
-		pids_uncharge(pids, 1);
+		pids_fork_uncharge(pids);
 	} else if (ret == -EDQUOT) {
-		pids_event(pids, current->group_pids);
+		pids_event(pids, gp);
 		ret = 0;
 	}
-	spin_unlock(&group_pids_lock);
+	rcu_read_unlock();
 	return ret;
 }
 
@@ -402,22 +515,26 @@ void cgroup_pids_cancel_fork(void)
 	rcu_read_lock();
 	pids = task_pids(current);
 	rcu_read_unlock();
-	pids_uncharge(pids, 1);
+	pids_fork_uncharge(pids);
 
-	spin_lock(&group_pids_lock);
-	group_pids_uncharge(current->group_pids, 1);
-	spin_unlock(&group_pids_lock);
+	rcu_read_lock();
+	group_pids_uncharge(ACCESS_ONCE(current->group_pids), 1);
+	rcu_read_unlock();
 }
 
 static void pids_fork(struct task_struct *tsk)
 {
-	spin_lock(&group_pids_lock);
-	if (current->group_pids) {
-		tsk->group_pids = current->group_pids;
-		list_add_tail(&tsk->group_pids_list,
-			      &current->group_pids->head);
+	struct group_pids *gp;
+
+	rcu_read_lock();
+	gp = ACCESS_ONCE(current->group_pids);
+	if (gp) {
+		spin_lock(&gp->pids->group_pids_lock);
+		tsk->group_pids = gp;
+		list_add_tail(&tsk->group_pids_list, &gp->head);
+		spin_unlock(&gp->pids->group_pids_lock);
 	}
-	spin_unlock(&group_pids_lock);
+	rcu_read_unlock();
 }
 
 static void pids_exit(struct cgroup_subsys_state *css,
@@ -426,20 +543,9 @@ static void pids_exit(struct cgroup_subsys_state *css,
 {
 	struct pids_cgroup *pids = css_pids(old_css);
 
-	pids_uncharge(pids, 1);
-
-	spin_lock(&group_pids_lock);
+	pids_fork_uncharge(pids);
 
-	if (task->group_pids) {
-		atomic64_dec(&task->group_pids->counter);
-		list_del(&task->group_pids_list);
-		if (list_empty(&task->group_pids->head)) {
-			list_del(&task->group_pids->node);
-			kfree(task->group_pids);
-		}
-	}
-
-	spin_unlock(&group_pids_lock);
+	group_pids_del(task);
 }
 
 static int pids_max_write(struct cgroup_subsys_state *css,
@@ -470,8 +576,16 @@ static s64 pids_current_read(struct cgroup_subsys_state *css,
 		     struct cftype *cft)
 {
 	struct pids_cgroup *pids = css_pids(css);
+	struct cgroup_subsys_state *pos;
+	s64 nr = atomic64_read(&pids->counter);
 
-	return atomic64_read(&pids->counter);
+	/* the reserves below are charged here but hold no task */
+	rcu_read_lock();
+	css_for_each_descendant_pre(pos, css)
+		nr -= atomic64_read(&css_pids(pos)->reserve);
+	rcu_read_unlock();
+
+	return max_t(s64, nr, 0);
 }
 
 /**
@@ -482,24 +596,44 @@ struct pids_event {
 	struct list_head node;
 };
 
+static void pids_event_work_fn(struct work_struct *work)
+{
+	struct pids_cgroup *pids = container_of(to_delayed_work(work),
+					struct pids_cgroup, event_work);
+	struct pids_event *ev;
+	int nr;
+
+	pids->last_event = jiffies;
+	nr = atomic_xchg(&pids->events, 0);
+	if (!nr)
+		return;
+
+	spin_lock(&pids->event_list_lock);
+	list_for_each_entry(ev, &pids->efd_list, node)
+		eventfd_signal(ev->efd, nr);
+	spin_unlock(&pids->event_list_lock);
+}
+
 /**
  * when a process have soft limit
+ *
+ * The crossings of a fork storm are batched and delivered from a work
+ * at most once per event_interval_ms, the count being their number.
  */
 static void pids_event(struct pids_cgroup *pids, struct group_pids *gp)
 {
-	struct pids_event *ev;
+	unsigned long next;
 
-	/*is gp has signal to user space, protect by group_pids_lock*/
-	if (gp->signal)
+	/* a group_pids is reported once */
+	if (gp->signal || xchg(&gp->signal, 1))
 		return;
 
-	spin_lock(&pids->event_list_lock);
-	list_for_each_entry(ev, &pids->event_list, node) {
-		eventfd_signal(ev->efd, 1);
-		gp->signal = true;
-	}
-	spin_unlock(&pids->event_list_lock);
+	if (atomic_inc_return(&pids->events) != 1)
+		return;
 
+	next = pids->last_event + msecs_to_jiffies(event_interval_ms);
+	schedule_delayed_work(&pids->event_work,
+			      time_after(next, jiffies) ? next - jiffies : 0);
 }
 
 static int group_pids_events_show(struct seq_file *m, void *V)
@@ -509,7 +643,7 @@ static int group_pids_events_show(struct seq_file *m, void *V)
 	struct task_struct *task;
 	int64_t count;
 
-	spin_lock(&group_pids_lock);
+	spin_lock(&pids->group_pids_lock);
 	list_for_each_entry(gp, &pids->group_pids_list, node) {
 		WARN_ON(list_empty(&gp->head));
 
@@ -524,7 +658,7 @@ static int group_pids_events_show(struct seq_file *m, void *V)
 			    (long)from_kuid_munged(current_user_ns(), task_uid(task)),
 			    (long long)count);
 	}
-	spin_unlock(&group_pids_lock);
+	spin_unlock(&pids->group_pids_lock);
 	return 0;
 }
 
@@ -580,7 +714,7 @@ static int pids_cgroup_usage_register_event(struct pids_cgroup *pids,
 	ev->efd = eventfd;
 
 	spin_lock(&pids->event_list_lock);
-	list_add(&ev->node, &pids->event_list);
+	list_add(&ev->node, &pids->efd_list);
 	spin_unlock(&pids->event_list_lock);
 
 	return 0;
@@ -592,7 +726,7 @@ static void pids_cgroup_usage_unregister_event(struct pids_cgroup *pids,
 	struct pids_event *ev;
 
 	spin_lock(&pids->event_list_lock);
-	list_for_each_entry(ev, &pids->event_list, node) {
+	list_for_each_entry(ev, &pids->efd_list, node) {
 		if (ev->efd != eventfd)
 			continue;
 		list_del(&ev->node);
@@ -832,6 +966,8 @@ static void pids_css_offline(struct cgroup_subsys_state *css)
 		schedule_work(&event->remove);
 	}
 	spin_unlock(&pids->event_list_lock);
+
+	pids_drain_reserve(pids);
 }
 
 static struct cftype files[] = {
@@ -19,14 +19,29 @@
 #include <linux/ioprio.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
+#include <linux/idr.h>
+#include <linux/cgroup_ionice.h>
+
+/*
+ * Besides the ioprio, a cgroup has an I/O weight and an optional latency
+ * target which the hisi blk-mq dispatcher enforces between the groups
+ * sharing a hardware queue, and the block layer reports the bytes, ios
+ * and latency of the requests of each group back here.
+ */
+#define IONICE_LAT_AVG_SHIFT	3
 
 struct cgroup_subsys ionice_cgrp_subsys;
 struct ionice_cgroup {
 	struct cgroup_subsys_state css;
 	int prio;
 	spinlock_t lock;
+	int id;
 };
 
+struct ionice_io_group ionice_io_groups[IONICE_MAX_GROUPS];
+static DEFINE_IDA(ionice_ida);
+static atomic_t ionice_nr_missed = ATOMIC_INIT(0);
+
 static struct ionice_cgroup *cgroup_to_ionice(struct cgroup_subsys_state *css)
 {
 	return css ? container_of(css, struct ionice_cgroup, css) : NULL;
@@ -38,6 +53,73 @@ static struct ionice_cgroup *task_to_ionice(struct task_struct *task)
 		struct ionice_cgroup, css);
 }
 
+static void ionice_reset_io_group(struct ionice_io_group *g)
+{
+	int rw;
+
+	if (xchg(&g->missed, 0))
+		atomic_dec(&ionice_nr_missed);
+	g->weight = IONICE_WEIGHT_DEFAULT;
+	g->latency_target_us = 0;
+	for (rw = 0; rw < 2; rw++) {
+		atomic64_set(&g->bytes[rw], 0);
+		atomic64_set(&g->ios[rw], 0);
+	}
+	atomic64_set(&g->lat_ns, 0);
+	g->lat_max_ns = 0;
+	g->lat_avg_us = 0;
+}
+
+/* the group id of the submitter, for the block layer */
+unsigned int ionice_current_group(void)
+{
+	unsigned int id;
+
+	rcu_read_lock();
+	id = task_to_ionice(current)->id;
+	rcu_read_unlock();
+
+	return id;
+}
+
+/* called from request completion, can be hard irq context */
+void ionice_io_done(unsigned int id, int rw, unsigned int bytes, u64 lat_ns)
+{
+	struct ionice_io_group *g;
+	unsigned int lat_us, avg, target;
+	int missed;
+
+	if (id >= IONICE_MAX_GROUPS)
+		return;
+
+	g = &ionice_io_groups[id];
+	atomic64_add(bytes, &g->bytes[rw & 1]);
+	atomic64_inc(&g->ios[rw & 1]);
+	atomic64_add(lat_ns, &g->lat_ns);
+	if (lat_ns > g->lat_max_ns)
+		g->lat_max_ns = lat_ns;
+
+	lat_us = (unsigned int)min_t(u64, div_u64(lat_ns, NSEC_PER_USEC),
+				     UINT_MAX >> IONICE_LAT_AVG_SHIFT);
+	avg = g->lat_avg_us;
+	avg = avg - (avg >> IONICE_LAT_AVG_SHIFT) +
+	      (lat_us >> IONICE_LAT_AVG_SHIFT);
+	g->lat_avg_us = avg;
+
+	target = ACCESS_ONCE(g->latency_target_us);
+	missed = target && avg > target;
+	if (missed != ACCESS_ONCE(g->missed) && xchg(&g->missed, missed) != missed)
+		atomic_add(missed ? 1 : -1, &ionice_nr_missed);
+}
+EXPORT_SYMBOL(ionice_io_done);
+
+/* some group with a latency target is missing it */
+bool ionice_latency_pressure(void)
+{
+	return atomic_read(&ionice_nr_missed) > 0;
+}
+EXPORT_SYMBOL(ionice_latency_pressure);
+
 static struct cgroup_subsys_state *ionice_alloc(struct cgroup_subsys_state
 		*parent_css)
 {
@@ -49,12 +131,29 @@ static struct cgroup_subsys_state *ionice_alloc(struct cgroup_subsys_state
 
 	spin_lock_init(&ionice_cgroup->lock);
 
+	/* out of ids, the group just is not weighted */
+	ionice_cgroup->id = 0;
+	if (parent_css) {
+		int id = ida_simple_get(&ionice_ida, 1, IONICE_MAX_GROUPS,
+					GFP_KERNEL);
+
+		if (id > 0)
+			ionice_cgroup->id = id;
+	}
+	ionice_reset_io_group(&ionice_io_groups[ionice_cgroup->id]);
+
 	return &ionice_cgroup->css;
 }
 
 static void ionice_free(struct cgroup_subsys_state *css)
 {
-	kfree(cgroup_to_ionice(css));
+	struct ionice_cgroup *ionice = cgroup_to_ionice(css);
+
+	if (ionice->id) {
+		ionice_reset_io_group(&ionice_io_groups[ionice->id]);
+		ida_simple_remove(&ionice_ida, ionice->id);
+	}
+	kfree(ionice);
 }
 
 static s64 ionice_read_prio(struct cgroup_subsys_state *css, struct cftype *cft)
@@ -198,6 +297,69 @@ static void ionice_fork(struct task_struct *task)
 	rcu_read_unlock();
 }
 
+static struct ionice_io_group *css_io_group(struct cgroup_subsys_state *css)
+{
+	return &ionice_io_groups[cgroup_to_ionice(css)->id];
+}
+
+static u64 ionice_read_weight(struct cgroup_subsys_state *css,
+		struct cftype *cft)
+{
+	return css_io_group(css)->weight;
+}
+
+static int ionice_write_weight(struct cgroup_subsys_state *css,
+		struct cftype *cft, u64 val)
+{
+	if (val < IONICE_WEIGHT_MIN || val > IONICE_WEIGHT_MAX)
+		return -EINVAL;
+	if (!cgroup_to_ionice(css)->id)
+		return -ENOSPC;
+
+	css_io_group(css)->weight = (unsigned int)val;
+	return 0;
+}
+
+static u64 ionice_read_latency_target(struct cgroup_subsys_state *css,
+		struct cftype *cft)
+{
+	return css_io_group(css)->latency_target_us;
+}
+
+static int ionice_write_latency_target(struct cgroup_subsys_state *css,
+		struct cftype *cft, u64 val)
+{
+	struct ionice_io_group *g = css_io_group(css);
+
+	if (val > USEC_PER_SEC)
+		return -EINVAL;
+	if (!cgroup_to_ionice(css)->id)
+		return -ENOSPC;
+
+	g->latency_target_us = (unsigned int)val;
+	if (!val && xchg(&g->missed, 0))
+		atomic_dec(&ionice_nr_missed);
+	return 0;
+}
+
+static int ionice_read_io_stat(struct seq_file *m, void *v)
+{
+	struct ionice_io_group *g = css_io_group(seq_css(m));
+	u64 ios = atomic64_read(&g->ios[READ]) + atomic64_read(&g->ios[WRITE]);
+	u64 lat = atomic64_read(&g->lat_ns);
+
+	seq_printf(m, "rbytes %llu\nwbytes %llu\nrios %llu\nwios %llu\n",
+		   (u64)atomic64_read(&g->bytes[READ]),
+		   (u64)atomic64_read(&g->bytes[WRITE]),
+		   (u64)atomic64_read(&g->ios[READ]),
+		   (u64)atomic64_read(&g->ios[WRITE]));
+	seq_printf(m, "lat_mean_us %llu\nlat_avg_us %u\nlat_max_us %llu\n",
+		   ios ? div64_u64(lat, ios * NSEC_PER_USEC) : 0,
+		   g->lat_avg_us, div_u64(g->lat_max_ns, NSEC_PER_USEC));
+	seq_printf(m, "missed %d\n", g->missed);
+	return 0;
+}
+
 static struct cftype files[] = {
 	{
 		.name = "class",
@@ -218,6 +380,23 @@ static struct cftype files[] = {
 		.read_s64 = ionice_read_prio,
 		.write_s64 = ionice_write_prio,
 	},
+	{
+		.name = "weight",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = ionice_read_weight,
+		.write_u64 = ionice_write_weight,
+	},
+	{
+		.name = "latency_target_us",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = ionice_read_latency_target,
+		.write_u64 = ionice_write_latency_target,
+	},
+	{
+		.name = "io_stat",
+		.mode = S_IRUGO,
+		.seq_show = ionice_read_io_stat,
+	},
 	{ }    /* terminate */
 };
 
@@ -175,6 +175,19 @@ int check_wakeup_reason(int irq)
 	return ret;
 }
 
+/* copies at most 'max' irqs of the last wakeup, returns how many */
+int get_wakeup_reason_irqs(int *irqs, int max)
+{
+	int n;
+
+	spin_lock(&resume_reason_lock);
+	n = min(irqcount, max);
+	memcpy(irqs, irq_list, n * sizeof(*irqs));
+	spin_unlock(&resume_reason_lock);
+	return n;
+}
+EXPORT_SYMBOL(get_wakeup_reason_irqs);
+
 void log_suspend_abort_reason(const char *fmt, ...)
 {
 	va_list args;
@@ -43,6 +43,7 @@
 #include <linux/rculist.h>
 #include <linux/poll.h>
 #include <linux/irq_work.h>
+#include <linux/kthread.h>
 #include <linux/utsname.h>
 #include <linux/ctype.h>
 #include <linux/uio.h>
@@ -1504,6 +1505,35 @@ static inline int can_use_console(unsigned int cpu)
 	return cpu_online(cpu) || have_callable_console();
 }
 
+#ifdef CONFIG_PRINTK_ASYNC
+/*
+ * With asynchronous printk, vprintk_emit() only stores the message and
+ * printk_kthread writes it to the consoles, so a slow serial console
+ * does not stall whoever logs. printk.synchronous=1 restores the old
+ * behaviour. Oopses, panics and messages logged before the thread runs
+ * or once the system goes down are still printed synchronously.
+ */
+static bool printk_sync;
+module_param_named(synchronous, printk_sync, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(synchronous, "print to the consoles from the caller");
+
+static struct task_struct *printk_kthread;
+static bool printk_kthread_need_flush;
+
+static bool printk_async(void)
+{
+	return !printk_sync && printk_kthread && !oops_in_progress &&
+	       system_state == SYSTEM_RUNNING;
+}
+#else
+static inline bool printk_async(void)
+{
+	return false;
+}
+#endif
+
+static void printk_queue_output(void);
+
 /*
  * Try to get console ownership to actually show the kernel
  * messages from a 'printk'. Return true (and with the
@@ -1824,7 +1854,9 @@ asmlinkage int vprintk_emit(int facility, int level,
 	local_irq_restore(flags);
 
 	/* If called from the scheduler, we can not call up(). */
-	if (!in_sched) {
+	if (!in_sched && printk_async()) {
+		printk_queue_output();
+	} else if (!in_sched) {
 		lockdep_off();
 		/*
 		 * Disable preemption to avoid being preempted while holding
@@ -2713,6 +2745,12 @@ static void wake_up_klogd_work_func(struct irq_work *irq_work)
 	int pending = __this_cpu_xchg(printk_pending, 0);
 
 	if (pending & PRINTK_PENDING_OUTPUT) {
+#ifdef CONFIG_PRINTK_ASYNC
+		if (printk_async()) {
+			printk_kthread_need_flush = true;
+			wake_up_process(printk_kthread);
+		} else
+#endif
 		/* If trylock fails, someone else is doing the printing */
 		if (console_trylock())
 			console_unlock();
@@ -2727,6 +2765,46 @@ static DEFINE_PER_CPU(struct irq_work, wake_up_klogd_work) = {
 	.flags = IRQ_WORK_LAZY,
 };
 
+/* hand the console output to printk_kthread, from any context */
+static void printk_queue_output(void)
+{
+	preempt_disable();
+	this_cpu_or(printk_pending, PRINTK_PENDING_OUTPUT);
+	irq_work_queue(this_cpu_ptr(&wake_up_klogd_work));
+	preempt_enable();
+}
+
+#ifdef CONFIG_PRINTK_ASYNC
+static int printk_kthread_func(void *data)
+{
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!printk_kthread_need_flush)
+			schedule();
+		__set_current_state(TASK_RUNNING);
+
+		printk_kthread_need_flush = false;
+		console_lock();
+		console_unlock();
+	}
+	return 0;
+}
+
+static int __init printk_kthread_init(void)
+{
+	struct task_struct *task;
+
+	task = kthread_run(printk_kthread_func, NULL, "printk");
+	if (IS_ERR(task)) {
+		pr_err("printk: unable to create the printing thread\n");
+		return PTR_ERR(task);
+	}
+	printk_kthread = task;
+	return 0;
+}
+early_initcall(printk_kthread_init);
+#endif
+
 void wake_up_klogd(void)
 {
 	preempt_disable();
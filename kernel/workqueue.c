@@ -48,6 +48,8 @@
 #include <linux/nodemask.h>
 #include <linux/moduleparam.h>
 #include <linux/uaccess.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "workqueue_internal.h"
 #ifdef CONFIG_HISI_BB
@@ -1291,6 +1293,167 @@ fail:
 	return -EAGAIN;
 }
 
+#ifdef CONFIG_WQ_LATENCY_STATS
+/*
+ * Queue-to-execute latency and run time per work function.  The table is
+ * open addressed on the function pointer, entries are claimed with
+ * cmpxchg() and never released, so accounting takes no lock.
+ */
+#define WQ_LAT_BITS		9
+#define WQ_LAT_ENTRIES		(1 << WQ_LAT_BITS)
+#define WQ_LAT_BUCKETS		16	/* < 1us, < 2us ... >= 16ms */
+
+struct wq_lat_entry {
+	work_func_t func;
+	atomic_long_t count;
+	atomic64_t lat_total_us;
+	atomic64_t run_total_us;
+	u32 lat_max_us;
+	u32 run_max_us;
+	atomic_t lat_hist[WQ_LAT_BUCKETS];
+	atomic_t run_hist[WQ_LAT_BUCKETS];
+};
+
+static struct wq_lat_entry wq_lat_table[WQ_LAT_ENTRIES];
+static atomic_long_t wq_lat_overflow;
+
+static inline void wq_lat_queued(struct work_struct *work)
+{
+	work->queue_ns = local_clock();
+}
+
+static inline int wq_lat_bucket(u32 us)
+{
+	return min_t(int, fls(us), WQ_LAT_BUCKETS - 1);
+}
+
+static void wq_lat_account(work_func_t func, u64 queued, u64 start, u64 end)
+{
+	struct wq_lat_entry *e;
+	unsigned int i, n;
+	u32 lat, run;
+
+	i = hash_ptr(func, WQ_LAT_BITS);
+	for (n = 0; n < WQ_LAT_ENTRIES; n++, i = (i + 1) & (WQ_LAT_ENTRIES - 1)) {
+		e = &wq_lat_table[i];
+		if (e->func == func)
+			break;
+		if (!e->func && !cmpxchg(&e->func, NULL, func))
+			break;
+		/* lost the race to the same function */
+		if (e->func == func)
+			break;
+	}
+	if (n == WQ_LAT_ENTRIES) {
+		atomic_long_inc(&wq_lat_overflow);
+		return;
+	}
+
+	/* local_clock() of the queueing cpu may be slightly ahead */
+	lat = start > queued ? (start - queued) / NSEC_PER_USEC : 0;
+	run = (end - start) / NSEC_PER_USEC;
+
+	atomic_long_inc(&e->count);
+	atomic64_add(lat, &e->lat_total_us);
+	atomic64_add(run, &e->run_total_us);
+	atomic_inc(&e->lat_hist[wq_lat_bucket(lat)]);
+	atomic_inc(&e->run_hist[wq_lat_bucket(run)]);
+	/* racy, a concurrent larger value may rarely be lost */
+	if (lat > ACCESS_ONCE(e->lat_max_us))
+		ACCESS_ONCE(e->lat_max_us) = lat;
+	if (run > ACCESS_ONCE(e->run_max_us))
+		ACCESS_ONCE(e->run_max_us) = run;
+}
+
+static void wq_lat_show_hist(struct seq_file *m, const char *name,
+			     atomic_t *hist)
+{
+	int i;
+
+	seq_printf(m, " %s=", name);
+	for (i = 0; i < WQ_LAT_BUCKETS; i++)
+		seq_printf(m, "%s%d", i ? "," : "", atomic_read(&hist[i]));
+}
+
+static int wq_lat_show(struct seq_file *m, void *v)
+{
+	struct wq_lat_entry *e;
+	unsigned long count;
+	int i;
+
+	seq_puts(m, "# buckets: <1us <2us <4us ... <16384us >=16384us\n");
+	for (i = 0; i < WQ_LAT_ENTRIES; i++) {
+		e = &wq_lat_table[i];
+		count = atomic_long_read(&e->count);
+		if (!e->func || !count)
+			continue;
+		seq_printf(m, "%pf count=%lu lat_avg_us=%llu lat_max_us=%u run_avg_us=%llu run_max_us=%u",
+			   e->func, count,
+			   div64_u64(atomic64_read(&e->lat_total_us), count),
+			   e->lat_max_us,
+			   div64_u64(atomic64_read(&e->run_total_us), count),
+			   e->run_max_us);
+		wq_lat_show_hist(m, "lat_hist", e->lat_hist);
+		wq_lat_show_hist(m, "run_hist", e->run_hist);
+		seq_putc(m, '\n');
+	}
+	if (atomic_long_read(&wq_lat_overflow))
+		seq_printf(m, "# %ld work items not accounted, table full\n",
+			   atomic_long_read(&wq_lat_overflow));
+	return 0;
+}
+
+static int wq_lat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wq_lat_show, NULL);
+}
+
+static ssize_t wq_lat_write(struct file *file, const char __user *buf,
+			    size_t count, loff_t *ppos)
+{
+	struct wq_lat_entry *e;
+	int i, j;
+
+	/* keep the functions, their slots may be in use right now */
+	for (i = 0; i < WQ_LAT_ENTRIES; i++) {
+		e = &wq_lat_table[i];
+		atomic_long_set(&e->count, 0);
+		atomic64_set(&e->lat_total_us, 0);
+		atomic64_set(&e->run_total_us, 0);
+		e->lat_max_us = 0;
+		e->run_max_us = 0;
+		for (j = 0; j < WQ_LAT_BUCKETS; j++) {
+			atomic_set(&e->lat_hist[j], 0);
+			atomic_set(&e->run_hist[j], 0);
+		}
+	}
+	atomic_long_set(&wq_lat_overflow, 0);
+	return count;
+}
+
+static const struct file_operations wq_lat_fops = {
+	.open		= wq_lat_open,
+	.read		= seq_read,
+	.write		= wq_lat_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init wq_lat_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("workqueue", NULL);
+	if (!dir)
+		return -ENOMEM;
+	debugfs_create_file("latency", 0600, dir, NULL, &wq_lat_fops);
+	return 0;
+}
+late_initcall(wq_lat_debugfs_init);
+#else
+static inline void wq_lat_queued(struct work_struct *work) { }
+#endif	/* CONFIG_WQ_LATENCY_STATS */
+
 /**
  * insert_work - insert a work into a pool
  * @pwq: pwq @work belongs to
@@ -1312,6 +1475,7 @@ static void insert_work(struct pool_workqueue *pwq, struct work_struct *work,
 	/* we own @work, set data and link */
 	set_work_pwq(work, pwq, extra_flags);
 	list_add_tail(&work->entry, head);
+	wq_lat_queued(work);
 	get_pwq(pwq);
 
 	/*
@@ -2004,6 +2168,9 @@ __acquires(&pool->lock)
 	bool cpu_intensive = pwq->wq->flags & WQ_CPU_INTENSIVE;
 	int work_color;
 	struct worker *collision;
+#ifdef CONFIG_WQ_LATENCY_STATS
+	u64 queued, start;
+#endif
 #ifdef CONFIG_LOCKDEP
 	/*
 	 * It is permissible to free the struct work_struct from
@@ -2076,8 +2243,15 @@ __acquires(&pool->lock)
 	trace_workqueue_execute_start(work);
 #ifdef CONFIG_HISI_BB
 	worker_hook((u64)(worker->current_func), 0);
+#endif
+#ifdef CONFIG_WQ_LATENCY_STATS
+	queued = work->queue_ns;
+	start = local_clock();
 #endif
 	worker->current_func(work);
+#ifdef CONFIG_WQ_LATENCY_STATS
+	wq_lat_account(worker->current_func, queued, start, local_clock());
+#endif
 #ifdef CONFIG_HISI_BB
 	worker_hook((u64)(worker->current_func), 1);
 #endif
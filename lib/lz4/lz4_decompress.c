@@ -47,11 +47,69 @@
 
 #include "lz4defs.h"
 
+#if defined(CONFIG_LZ4_DECOMPRESS_NEON) && !defined(STATIC)
+#define LZ4_NEON 1
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <asm/neon.h>
+#else
+#define LZ4_NEON 0
+#endif
+
 static const int dec32table[] = {0, 3, 2, 3, 0, 0, 0, 0};
 #if LZ4_ARCH64
 static const int dec64table[] = {0, 0, 0, -1, 0, 1, 2, 3};
 #endif
 
+#if LZ4_NEON
+/*
+ * Wide copies for the decompressor, only valid between kernel_neon_begin
+ * and kernel_neon_end. A copy of n bytes reads all of them before it
+ * writes, so a match may use it when its offset is at least n.
+ */
+static inline void lz4_neon_copy16(u8 *d, const u8 *s)
+{
+	__asm__ __volatile__(
+		"	ld1	{v0.16b}, [%[s]]		;"
+		"	st1	{v0.16b}, [%[d]]		;"
+	:
+	:	[d] "r"(d), [s] "r"(s)
+	:	"memory");
+}
+
+static inline void lz4_neon_copy32(u8 *d, const u8 *s)
+{
+	__asm__ __volatile__(
+		"	ld1	{v0.16b, v1.16b}, [%[s]]	;"
+		"	st1	{v0.16b, v1.16b}, [%[d]]	;"
+	:
+	:	[d] "r"(d), [s] "r"(s)
+	:	"memory");
+}
+
+/*
+ * Like LZ4_WILDCOPY, but in steps of 'step' (16 or 32) bytes as long as
+ * they fit before 'e', so it never writes further past 'e' than
+ * LZ4_WILDCOPY does.
+ */
+#define LZ4_NEON_WILDCOPY(s, d, e, step)		\
+	do {						\
+		while ((e) - (d) >= (step)) {		\
+			if ((step) == 32)		\
+				lz4_neon_copy32(d, s);	\
+			else				\
+				lz4_neon_copy16(d, s);	\
+			d += (step);			\
+			s += (step);			\
+		}					\
+		if (d < (e))				\
+			LZ4_WILDCOPY(s, d, e);		\
+	} while (0)
+
+static bool lz4_neon = true;
+module_param_named(neon, lz4_neon, bool, S_IRUGO | S_IWUSR);
+#endif
+
 static int lz4_uncompress(const char *source, char *dest, int osize)
 {
 	const BYTE *ip = (const BYTE *) source;
@@ -170,8 +228,14 @@ _output_error:
 	return -1;
 }
 
-static int lz4_uncompress_unknownoutputsize(const char *source, char *dest,
-				int isize, size_t maxoutputsize)
+/*
+ * 'neon' is a constant in each caller, the compiler drops the other copy
+ * routines from each instance.
+ */
+static __always_inline int __lz4_uncompress_unknownoutputsize(
+				const char *source, char *dest,
+				int isize, size_t maxoutputsize,
+				const bool neon)
 {
 	const BYTE *ip = (const BYTE *) source;
 	const BYTE *const iend = ip + isize;
@@ -218,7 +282,12 @@ static int lz4_uncompress_unknownoutputsize(const char *source, char *dest,
 			op += length;
 			break;/* Necessarily EOF, due to parsing restrictions */
 		}
-		LZ4_WILDCOPY(ip, op, cpy);
+#if LZ4_NEON
+		if (neon)
+			LZ4_NEON_WILDCOPY(ip, op, cpy, 32);
+		else
+#endif
+			LZ4_WILDCOPY(ip, op, cpy);
 		ip -= (op - cpy);
 		op = cpy;
 
@@ -289,7 +358,14 @@ static int lz4_uncompress_unknownoutputsize(const char *source, char *dest,
 				goto _output_error;
 			continue;
 		}
-		LZ4_SECURECOPY(ref, op, cpy);
+#if LZ4_NEON
+		if (neon && op - ref >= 32)
+			LZ4_NEON_WILDCOPY(ref, op, cpy, 32);
+		else if (neon && op - ref >= 16)
+			LZ4_NEON_WILDCOPY(ref, op, cpy, 16);
+		else
+#endif
+			LZ4_SECURECOPY(ref, op, cpy);
 		op = cpy; /* correction */
 	}
 	/* end of decoding */
@@ -300,6 +376,24 @@ _output_error:
 	return -1;
 }
 
+static int lz4_uncompress_unknownoutputsize(const char *source, char *dest,
+				int isize, size_t maxoutputsize)
+{
+#if LZ4_NEON
+	int ret;
+
+	if (lz4_neon) {
+		kernel_neon_begin_partial(2);
+		ret = __lz4_uncompress_unknownoutputsize(source, dest, isize,
+							 maxoutputsize, true);
+		kernel_neon_end();
+		return ret;
+	}
+#endif
+	return __lz4_uncompress_unknownoutputsize(source, dest, isize,
+						  maxoutputsize, false);
+}
+
 int lz4_decompress(const unsigned char *src, size_t *src_len,
 		unsigned char *dest, size_t actual_dest_len)
 {
@@ -338,6 +432,117 @@ exit_0:
 #ifndef STATIC
 EXPORT_SYMBOL(lz4_decompress_unknownoutputsize);
 
+#if LZ4_NEON
+#define LZ4_TEST_SIZE		4096
+#define LZ4_TEST_LOOPS		64
+
+/* appends one sequence to the block at *ip and its output at *op */
+static void lz4_test_emit(u8 **ip, u8 **op, u32 *seed, size_t lit,
+			  size_t offset, size_t match)
+{
+	u8 *token = (*ip)++;
+	size_t len;
+
+	len = lit;
+	*token = min_t(size_t, len, RUN_MASK) << ML_BITS;
+	if (len >= RUN_MASK) {
+		for (len -= RUN_MASK; len >= 255; len -= 255)
+			*(*ip)++ = 255;
+		*(*ip)++ = len;
+	}
+	while (lit--) {
+		*seed = *seed * 1103515245 + 12345;
+		*(*op)++ = *(*ip)++ = *seed >> 24;
+	}
+	if (!match)
+		return;
+
+	*(*ip)++ = offset & 0xff;
+	*(*ip)++ = offset >> 8;
+	len = match - MINMATCH;
+	*token |= min_t(size_t, len, ML_MASK);
+	if (len >= ML_MASK) {
+		for (len -= ML_MASK; len >= 255; len -= 255)
+			*(*ip)++ = 255;
+		*(*ip)++ = len;
+	}
+	for (; match; match--, (*op)++)
+		**op = *(*op - offset);
+}
+
+/*
+ * Check the NEON decompressor against a block covering every short match
+ * offset, the 16 and 32 byte boundaries and long lengths, and keep it
+ * only when it decodes the block right and faster than the scalar one.
+ */
+static int __init lz4_neon_selftest(void)
+{
+	static const size_t offsets[] = {
+		1, 2, 3, 4, 5, 6, 7, 8, 9, 12, 15, 16, 17, 24, 31, 32, 33, 64, 200
+	};
+	static const size_t lits[] = { 0, 3, 15, 20, 40 };
+	static const size_t matches[] = { 4, 19, 40, 300 };
+	u8 *src, *exp, *out, *ip, *op;
+	size_t src_len, exp_len, i;
+	u32 seed = 1;
+	s64 ns[2];
+	int n, k, ret[2];
+
+	src = kmalloc(3 * LZ4_TEST_SIZE, GFP_KERNEL);
+	if (!src)
+		return -ENOMEM;
+	exp = src + LZ4_TEST_SIZE;
+	out = exp + LZ4_TEST_SIZE;
+
+	ip = src;
+	op = exp;
+	lz4_test_emit(&ip, &op, &seed, 256, 0, 0);
+	for (i = 0; op - exp < LZ4_TEST_SIZE - 512; i++)
+		lz4_test_emit(&ip, &op, &seed, lits[i % ARRAY_SIZE(lits)],
+			      offsets[i % ARRAY_SIZE(offsets)],
+			      matches[i % ARRAY_SIZE(matches)]);
+	/* a block ends with literals */
+	lz4_test_emit(&ip, &op, &seed, 64, 0, 0);
+	src_len = ip - src;
+	exp_len = op - exp;
+
+	for (k = 0; k < 2; k++) {
+		ktime_t start;
+
+		lz4_neon = k;
+		memset(out, 0, LZ4_TEST_SIZE);
+		ret[k] = lz4_uncompress_unknownoutputsize(src, out, src_len,
+							  LZ4_TEST_SIZE);
+		if (ret[k] != exp_len || memcmp(out, exp, exp_len)) {
+			ret[k] = -1;
+			continue;
+		}
+		start = ktime_get();
+		for (n = 0; n < LZ4_TEST_LOOPS; n++)
+			lz4_uncompress_unknownoutputsize(src, out, src_len,
+							 LZ4_TEST_SIZE);
+		ns[k] = ktime_to_ns(ktime_sub(ktime_get(), start)) ?: 1;
+	}
+	kfree(src);
+
+	if (ret[0] < 0)
+		pr_err("lz4: scalar decompressor self-test failed\n");
+	if (ret[1] < 0) {
+		pr_err("lz4: NEON decompressor self-test failed, disabled\n");
+		lz4_neon = false;
+		return 0;
+	}
+
+	lz4_neon = ret[0] < 0 || ns[1] <= ns[0];
+	pr_info("lz4: decompress scalar %lld MB/s, NEON %lld MB/s, using %s\n",
+		ret[0] < 0 ? 0 : div64_s64((s64)exp_len * LZ4_TEST_LOOPS * 1000, ns[0]),
+		div64_s64((s64)exp_len * LZ4_TEST_LOOPS * 1000, ns[1]),
+		lz4_neon ? "NEON" : "scalar");
+	return 0;
+}
+module_init(lz4_neon_selftest);
+#endif
+
 MODULE_LICENSE("Dual BSD/GPL");
 MODULE_DESCRIPTION("LZ4 Decompressor");
 #endif
@@ -0,0 +1,172 @@
+/*
+ * Kernel module measuring memcpy and copy_to/from_user throughput.
+ *
+ * Copyright (c) 2016 Huawei Technologies Co., Ltd.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/cpufreq.h>
+#include <linux/cpumask.h>
+#include <linux/ktime.h>
+#include <linux/mman.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <asm/cputype.h>
+
+/*
+ * Each size is copied until BENCH_BYTES have moved, once per online cpu.
+ * The result is printed in bytes per cycle, the cycles are derived from
+ * the elapsed time and the current cpufreq rate of the cpu, which is
+ * only meaningful with the userspace or performance governor.
+ */
+#define BENCH_BYTES	(64 << 20)
+#define BENCH_MAX_SIZE	(64 << 10)
+
+static const size_t bench_sizes[] = {
+	64, 128, 256, 512, 1024, 4096, 16384, BENCH_MAX_SIZE,
+};
+
+enum bench_op {
+	BENCH_MEMCPY,
+	BENCH_TO_USER,
+	BENCH_FROM_USER,
+	BENCH_OPS,
+};
+
+static const char * const bench_names[BENCH_OPS] = {
+	"memcpy", "copy_to_user", "copy_from_user",
+};
+
+static s64 bench_one(enum bench_op op, char *kdst, char *ksrc,
+		     char __user *umem, size_t size)
+{
+	unsigned long loops = BENCH_BYTES / size;
+	unsigned long i;
+	ktime_t start;
+
+	start = ktime_get();
+	for (i = 0; i < loops; i++) {
+		switch (op) {
+		case BENCH_MEMCPY:
+			memcpy(kdst, ksrc, size);
+			break;
+		case BENCH_TO_USER:
+			if (copy_to_user(umem, ksrc, size))
+				return -EFAULT;
+			break;
+		case BENCH_FROM_USER:
+			if (copy_from_user(kdst, umem, size))
+				return -EFAULT;
+			break;
+		default:
+			break;
+		}
+	}
+
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static int bench_cpu(int cpu, char *kdst, char *ksrc, char __user *umem)
+{
+	unsigned int khz;
+	int op, i, ret;
+
+	ret = set_cpus_allowed_ptr(current, cpumask_of(cpu));
+	if (ret)
+		return ret;
+
+	khz = cpufreq_quick_get(cpu);
+	pr_info("cpu%d part 0x%03x at %u kHz\n", cpu,
+		read_cpuid_part_number(), khz);
+
+	for (op = 0; op < BENCH_OPS; op++) {
+		for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+			size_t size = bench_sizes[i];
+			u64 bytes = BENCH_BYTES / size * size;
+			u64 cycles;
+			s64 ns;
+
+			/* warm the caches and the cpufreq governor */
+			bench_one(op, kdst, ksrc, umem, size);
+			ns = bench_one(op, kdst, ksrc, umem, size);
+			if (ns < 0)
+				return (int)ns;
+
+			cycles = div_u64((u64)ns * khz, USEC_PER_SEC);
+			if (!cycles)
+				cycles = 1;
+			pr_info("  %-14s %6zu: %llu.%02llu bytes/cycle, %llu MB/s\n",
+				bench_names[op], size,
+				div64_u64(bytes, cycles),
+				div64_u64(bytes * 100, cycles) % 100,
+				div64_u64(bytes * 1000, ns ? ns : 1));
+		}
+	}
+
+	return 0;
+}
+
+static int __init test_copy_bench_init(void)
+{
+	cpumask_var_t saved;
+	unsigned long user_addr;
+	char *kdst, *ksrc;
+	int cpu, ret = 0;
+
+	if (!alloc_cpumask_var(&saved, GFP_KERNEL))
+		return -ENOMEM;
+	cpumask_copy(saved, tsk_cpus_allowed(current));
+
+	kdst = kmalloc(BENCH_MAX_SIZE, GFP_KERNEL);
+	ksrc = kmalloc(BENCH_MAX_SIZE, GFP_KERNEL);
+	if (!kdst || !ksrc) {
+		ret = -ENOMEM;
+		goto out_free;
+	}
+	memset(ksrc, 0x5a, BENCH_MAX_SIZE);
+
+	user_addr = vm_mmap(NULL, 0, BENCH_MAX_SIZE, PROT_READ | PROT_WRITE,
+			    MAP_ANONYMOUS | MAP_PRIVATE, 0);
+	if (user_addr >= (unsigned long)(TASK_SIZE)) {
+		pr_warn("Failed to allocate user memory\n");
+		ret = -ENOMEM;
+		goto out_free;
+	}
+
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		ret = bench_cpu(cpu, kdst, ksrc, (char __user *)user_addr);
+		if (ret) {
+			pr_warn("cpu%d failed: %d\n", cpu, ret);
+			break;
+		}
+	}
+	put_online_cpus();
+
+	set_cpus_allowed_ptr(current, saved);
+	vm_munmap(user_addr, BENCH_MAX_SIZE);
+out_free:
+	kfree(ksrc);
+	kfree(kdst);
+	free_cpumask_var(saved);
+
+	/* the results are in the log, there is nothing to keep loaded */
+	return ret ? ret : -EAGAIN;
+}
+
+module_init(test_copy_bench_init);
+
+MODULE_AUTHOR("Huawei Technologies Co., Ltd.");
+MODULE_LICENSE("GPL");
@@ -38,6 +38,26 @@ static void __fast_free_user_mem(struct mm_struct *mm)
 	tlb_finish_mmu(&tlb, 0, -1);
 }
 
+/*
+ * Free the memory of @mm on behalf of a killed task, from another
+ * context. Returns false if mmap_sem was busy or the memory is already
+ * being freed.
+ */
+bool fast_free_mm(struct mm_struct *mm)
+{
+	if (!down_read_trylock(&mm->mmap_sem))
+		return false;
+	if (test_and_set_bit(MMF_FAST_FREEING, &mm->flags)) {
+		up_read(&mm->mmap_sem);
+		return false;
+	}
+
+	__fast_free_user_mem(mm);
+
+	up_read(&mm->mmap_sem);
+	return true;
+}
+
 void fast_free_user_mem(void)
 {
 	struct mm_struct *mm = current->mm;
@@ -26,6 +26,11 @@
 #include <linux/module.h>
 #include <linux/moduleparam.h>
 #include <linux/seq_file.h>
+#include <linux/mmzone.h>
+#include <linux/sched.h>
+#include <linux/log2.h>
+
+#include "slowpath_count.h"
 
 #define FIRST_APP_UID KUIDT_INIT(10000)
 #define LAST_APP_UID  KUIDT_INIT(19999)
@@ -39,6 +44,37 @@ static bool enable;
 static atomic_long_t pgalloc_count = ATOMIC_LONG_INIT(0);
 static atomic_long_t slowpath_pgalloc_count = ATOMIC_LONG_INIT(0);
 
+/*
+ * Latency histograms, bucket 0 is below 16us, bucket i below 16us << i,
+ * and the last one is everything above. Orders and migratetypes are
+ * kept apart rather than crossed to keep the tables small.
+ */
+#define SLOWPATH_BUCKETS	16
+#define SLOWPATH_BUCKET_SHIFT	4
+
+enum {
+	SLOWPATH_FG,
+	SLOWPATH_BG,
+	NR_SLOWPATH_CTX,
+};
+
+struct slowpath_hist {
+	atomic_long_t count[SLOWPATH_BUCKETS];
+	atomic_long_t total_us;
+};
+
+static struct slowpath_hist
+	order_hist[NR_SLOWPATH_STAGES][NR_SLOWPATH_CTX][MAX_ORDER];
+static struct slowpath_hist
+	mt_hist[NR_SLOWPATH_STAGES][NR_SLOWPATH_CTX][MIGRATE_TYPES];
+
+static const char * const stage_names[NR_SLOWPATH_STAGES] = {
+	"reclaim", "compact", "total",
+};
+static const char * const ctx_names[NR_SLOWPATH_CTX] = {
+	"fg", "bg",
+};
+
 module_param_named(enable, enable, bool, S_IRUGO | S_IWUSR);
 
 static int is_background(void)
@@ -91,12 +127,88 @@ void pgalloc_count_inc(bool is_slowpath, unsigned int order)
 }
 EXPORT_SYMBOL(pgalloc_count_inc);
 
+u64 pgalloc_slowpath_start(void)
+{
+	if (!enable)
+		return 0;
+	return sched_clock();
+}
+EXPORT_SYMBOL(pgalloc_slowpath_start);
+
+static void slowpath_hist_add(struct slowpath_hist *hist, u64 us)
+{
+	int bucket = 0;
+
+	if (us >> SLOWPATH_BUCKET_SHIFT)
+		bucket = min_t(int, ilog2(us >> SLOWPATH_BUCKET_SHIFT) + 1,
+			       SLOWPATH_BUCKETS - 1);
+
+	atomic_long_inc(&hist->count[bucket]);
+	atomic_long_add((long)us, &hist->total_us);
+}
+
+void pgalloc_slowpath_end(enum slowpath_stage stage, unsigned int order,
+			  int migratetype, u64 start)
+{
+	int ctx;
+	u64 us;
+
+	if (!start || stage >= NR_SLOWPATH_STAGES || order >= MAX_ORDER ||
+	    migratetype < 0 || migratetype >= MIGRATE_TYPES)
+		return;
+
+	us = div_u64(sched_clock() - start, NSEC_PER_USEC);
+	ctx = is_background() ? SLOWPATH_BG : SLOWPATH_FG;
+
+	slowpath_hist_add(&order_hist[stage][ctx][order], us);
+	slowpath_hist_add(&mt_hist[stage][ctx][migratetype], us);
+}
+EXPORT_SYMBOL(pgalloc_slowpath_end);
+
+static void slowpath_hist_show(struct seq_file *s, const char *stage,
+			       const char *ctx, const char *what, int idx,
+			       struct slowpath_hist *hist)
+{
+	long count[SLOWPATH_BUCKETS], nr = 0;
+	int i;
+
+	for (i = 0; i < SLOWPATH_BUCKETS; i++) {
+		count[i] = atomic_long_read(&hist->count[i]);
+		nr += count[i];
+	}
+	if (!nr)
+		return;
+
+	seq_printf(s, "%-7s %s %s%-2d avg %6ldus:", stage, ctx, what, idx,
+		   atomic_long_read(&hist->total_us) / nr);
+	for (i = 0; i < SLOWPATH_BUCKETS; i++)
+		seq_printf(s, " %ld", count[i]);
+	seq_puts(s, "\n");
+}
+
 static int slowpath_count_show(struct seq_file *s, void *unused)
 {
+	int stage, ctx, i;
+
 	seq_printf(s, "Total page alloc count:%ld\n",
 		   atomic_long_read(&pgalloc_count));
 	seq_printf(s, "Total slow path page alloc count:%ld\n",
 		   atomic_long_read(&slowpath_pgalloc_count));
+
+	seq_printf(s, "Latency buckets: <%dus, then doubling\n",
+		   1 << SLOWPATH_BUCKET_SHIFT);
+	for (stage = 0; stage < NR_SLOWPATH_STAGES; stage++) {
+		for (ctx = 0; ctx < NR_SLOWPATH_CTX; ctx++) {
+			for (i = 0; i < MAX_ORDER; i++)
+				slowpath_hist_show(s, stage_names[stage],
+						   ctx_names[ctx], "order", i,
+						   &order_hist[stage][ctx][i]);
+			for (i = 0; i < MIGRATE_TYPES; i++)
+				slowpath_hist_show(s, stage_names[stage],
+						   ctx_names[ctx], "mt", i,
+						   &mt_hist[stage][ctx][i]);
+		}
+	}
 	return 0;
 }
 
@@ -105,17 +217,28 @@ static int slowpath_count_open(struct inode *inode, struct file *file)
 	return single_open(file, slowpath_count_show, NULL);
 }
 
+/* any write clears the latency histograms */
+static ssize_t slowpath_count_write(struct file *file,
+				    const char __user *buf,
+				    size_t count, loff_t *ppos)
+{
+	memset(order_hist, 0, sizeof(order_hist));
+	memset(mt_hist, 0, sizeof(mt_hist));
+	return count;
+}
+
 static const struct file_operations fops = {
 	.owner = THIS_MODULE,
 	.open = slowpath_count_open,
 	.read = seq_read,
+	.write = slowpath_count_write,
 	.llseek = seq_lseek,
 	.release = single_release,
 };
 
 static int __init slowpath_count_init(void)
 {
-	debugfs_create_file("slowpath_count", 0444, NULL, NULL, &fops);
+	debugfs_create_file("slowpath_count", 0644, NULL, NULL, &fops);
 	return 0;
 }
 
@@ -22,10 +22,38 @@
 #ifndef SLOWPATH_COUNT_H
 #define SLOWPATH_COUNT_H
 
+enum slowpath_stage {
+	SLOWPATH_RECLAIM,	/* direct reclaim */
+	SLOWPATH_COMPACT,	/* direct compaction */
+	SLOWPATH_TOTAL,		/* the whole slow path */
+	NR_SLOWPATH_STAGES,
+};
+
+/*
+ * Slow path latency is measured as
+ *
+ *	start = pgalloc_slowpath_start();
+ *	page = __alloc_pages_direct_reclaim(...);
+ *	pgalloc_slowpath_end(SLOWPATH_RECLAIM, order, migratetype, start);
+ *
+ * pgalloc_slowpath_start() returns 0 while counting is disabled, so
+ * the clock is not even read then.
+ */
 #ifdef CONFIG_HISI_SLOW_PATH_COUNT
 extern void pgalloc_count_inc(bool is_slowpath, unsigned int order);
+extern u64 pgalloc_slowpath_start(void);
+extern void pgalloc_slowpath_end(enum slowpath_stage stage,
+				 unsigned int order, int migratetype,
+				 u64 start);
 #else
 static inline void pgalloc_count_inc(bool is_slowpath, unsigned int order) {}
+static inline u64 pgalloc_slowpath_start(void)
+{
+	return 0;
+}
+static inline void pgalloc_slowpath_end(enum slowpath_stage stage,
+					unsigned int order, int migratetype,
+					u64 start) {}
 #endif
 
 #endif
@@ -83,8 +83,8 @@ static int receiver_wake_function(wait_queue_t *wait, unsigned int mode, int syn
 /*
  * Wait for the last received packet to be different from skb
  */
-static int wait_for_more_packets(struct sock *sk, int *err, long *timeo_p,
-				 const struct sk_buff *skb)
+int __skb_wait_for_more_packets(struct sock *sk, int *err, long *timeo_p,
+				const struct sk_buff *skb)
 {
 	int error;
 	DEFINE_WAIT_FUNC(wait, receiver_wake_function);
@@ -130,6 +130,7 @@ out_noerr:
 	error = 1;
 	goto out;
 }
+EXPORT_SYMBOL(__skb_wait_for_more_packets);
 
 static struct sk_buff *skb_set_peeked(struct sk_buff *skb)
 {
@@ -160,6 +161,56 @@ done:
 	return skb;
 }
 
+/**
+ *	__skb_try_recv_from_queue - dequeue or peek a datagram from a queue
+ *	@sk: socket
+ *	@queue: queue to look into, locked by the caller
+ *	@flags: MSG_ flags
+ *	@peeked: returns non-zero if this packet has been seen before
+ *	@off: as for __skb_recv_datagram()
+ *	@err: error code, set only on failure
+ *	@last: returns the last skb of the queue, for the wait
+ *
+ *	The non-blocking part of __skb_recv_datagram(), for protocols that
+ *	receive from a queue of their own rather than sk_receive_queue.
+ */
+struct sk_buff *__skb_try_recv_from_queue(struct sock *sk,
+					  struct sk_buff_head *queue,
+					  unsigned int flags,
+					  int *peeked, int *off, int *err,
+					  struct sk_buff **last)
+{
+	struct sk_buff *skb;
+	int _off = *off;
+
+	*last = queue->prev;
+	skb_queue_walk(queue, skb) {
+		*peeked = skb->peeked;
+		if (flags & MSG_PEEK) {
+			if (_off >= skb->len && (skb->len || _off ||
+						 skb->peeked)) {
+				_off -= skb->len;
+				continue;
+			}
+
+			skb = skb_set_peeked(skb);
+			if (IS_ERR(skb)) {
+				*err = PTR_ERR(skb);
+				return NULL;
+			}
+
+			atomic_inc(&skb->users);
+		} else
+			__skb_unlink(skb, queue);
+
+		*off = _off;
+		return skb;
+	}
+
+	return NULL;
+}
+EXPORT_SYMBOL(__skb_try_recv_from_queue);
+
 /**
  *	__skb_recv_datagram - Receive a datagram skbuff
  *	@sk: socket
@@ -215,34 +266,15 @@ struct sk_buff *__skb_recv_datagram(struct sock *sk, unsigned int flags,
 		 * Look at current nfs client by the way...
 		 * However, this function was correct in any case. 8)
 		 */
-		int _off = *off;
-
-		last = (struct sk_buff *)queue;
+		error = 0;
 		spin_lock_irqsave(&queue->lock, cpu_flags);
-		skb_queue_walk(queue, skb) {
-			last = skb;
-			*peeked = skb->peeked;
-			if (flags & MSG_PEEK) {
-				if (_off >= skb->len && (skb->len || _off ||
-							 skb->peeked)) {
-					_off -= skb->len;
-					continue;
-				}
-
-				skb = skb_set_peeked(skb);
-				error = PTR_ERR(skb);
-				if (IS_ERR(skb))
-					goto unlock_err;
-
-				atomic_inc(&skb->users);
-			} else
-				__skb_unlink(skb, queue);
-
-			spin_unlock_irqrestore(&queue->lock, cpu_flags);
-			*off = _off;
-			return skb;
-		}
+		skb = __skb_try_recv_from_queue(sk, queue, flags, peeked, off,
+						&error, &last);
 		spin_unlock_irqrestore(&queue->lock, cpu_flags);
+		if (error)
+			goto no_packet;
+		if (skb)
+			return skb;
 
 		if (sk_can_busy_loop(sk) &&
 		    sk_busy_loop(sk, flags & MSG_DONTWAIT))
@@ -253,12 +285,10 @@ struct sk_buff *__skb_recv_datagram(struct sock *sk, unsigned int flags,
 		if (!timeo)
 			goto no_packet;
 
-	} while (!wait_for_more_packets(sk, err, &timeo, last));
+	} while (!__skb_wait_for_more_packets(sk, err, &timeo, last));
 
 	return NULL;
 
-unlock_err:
-	spin_unlock_irqrestore(&queue->lock, cpu_flags);
 no_packet:
 	*err = error;
 	return NULL;
@@ -323,18 +353,26 @@ EXPORT_SYMBOL(skb_free_datagram_locked);
  */
 
 int skb_kill_datagram(struct sock *sk, struct sk_buff *skb, unsigned int flags)
+{
+	return __sk_queue_drop_skb(sk, &sk->sk_receive_queue, skb, flags);
+}
+EXPORT_SYMBOL(skb_kill_datagram);
+
+/* skb_kill_datagram() for a datagram received from 'sk_queue' */
+int __sk_queue_drop_skb(struct sock *sk, struct sk_buff_head *sk_queue,
+			struct sk_buff *skb, unsigned int flags)
 {
 	int err = 0;
 
 	if (flags & MSG_PEEK) {
 		err = -ENOENT;
-		spin_lock_bh(&sk->sk_receive_queue.lock);
-		if (skb == skb_peek(&sk->sk_receive_queue)) {
-			__skb_unlink(skb, &sk->sk_receive_queue);
+		spin_lock_bh(&sk_queue->lock);
+		if (skb == skb_peek(sk_queue)) {
+			__skb_unlink(skb, sk_queue);
 			atomic_dec(&skb->users);
 			err = 0;
 		}
-		spin_unlock_bh(&sk->sk_receive_queue.lock);
+		spin_unlock_bh(&sk_queue->lock);
 	}
 
 	kfree_skb(skb);
@@ -343,7 +381,7 @@ int skb_kill_datagram(struct sock *sk, struct sk_buff *skb, unsigned int flags)
 
 	return err;
 }
-EXPORT_SYMBOL(skb_kill_datagram);
+EXPORT_SYMBOL(__sk_queue_drop_skb);
 
 /**
  *	skb_copy_datagram_iter - Copy a datagram to an iovec iterator.
@@ -435,12 +435,15 @@ static void sock_disable_timestamp(struct sock *sk, unsigned long flags)
 	}
 }
 
+static void sock_def_readable(struct sock *sk);
 
-int sock_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
+static int __sock_queue_rcv_skb(struct sock *sk, struct sk_buff *skb,
+				bool coalesce)
 {
 	int err;
 	unsigned long flags;
 	struct sk_buff_head *list = &sk->sk_receive_queue;
+	bool was_empty;
 
 	if (atomic_read(&sk->sk_rmem_alloc) >= sk->sk_rcvbuf) {
 		atomic_inc(&sk->sk_drops);
@@ -467,15 +470,41 @@ int sock_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 
 	spin_lock_irqsave(&list->lock, flags);
 	sock_skb_set_dropcount(sk, skb);
+	was_empty = skb_queue_empty(list);
 	__skb_queue_tail(list, skb);
 	spin_unlock_irqrestore(&list->lock, flags);
 
-	if (!sock_flag(sk, SOCK_DEAD))
+	if (sock_flag(sk, SOCK_DEAD))
+		return 0;
+
+	if (!coalesce || was_empty || sk->sk_data_ready != sock_def_readable) {
 		sk->sk_data_ready(sk);
+	} else {
+		rcu_read_lock();
+		sk_wake_async(sk, SOCK_WAKE_WAITD, POLL_IN);
+		rcu_read_unlock();
+	}
 	return 0;
 }
+
+int sock_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
+{
+	return __sock_queue_rcv_skb(sk, skb, false);
+}
 EXPORT_SYMBOL(sock_queue_rcv_skb);
 
+/*
+ * As sock_queue_rcv_skb(), but readers are only woken up when the queue
+ * turns non-empty: a reader drains the queue before it sleeps again, and
+ * a busy polling one does not sleep at all. Sockets with their own
+ * sk_data_ready still see every skb.
+ */
+int sock_queue_rcv_skb_coalesce(struct sock *sk, struct sk_buff *skb)
+{
+	return __sock_queue_rcv_skb(sk, skb, true);
+}
+EXPORT_SYMBOL(sock_queue_rcv_skb_coalesce);
+
 int sk_receive_skb(struct sock *sk, struct sk_buff *skb, const int nested)
 {
 	int rc = NET_RX_SUCCESS;
@@ -986,6 +1015,9 @@ set_rcvbuf:
 #endif
 
 	case SO_MAX_PACING_RATE:
+		if (val != ~0U)
+			cmpxchg(&sk->sk_pacing_status, SK_PACING_NONE,
+				SK_PACING_NEEDED);
 		sk->sk_max_pacing_rate = val;
 		sk->sk_pacing_rate = min(sk->sk_pacing_rate,
 					 sk->sk_max_pacing_rate);
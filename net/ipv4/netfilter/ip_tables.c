@@ -27,8 +27,10 @@
 #include <linux/cpumask.h>
 
 #include <linux/netfilter/x_tables.h>
+#include <linux/netfilter/xt_tcpudp.h>
 #include <linux/netfilter_ipv4/ip_tables.h>
 #include <net/netfilter/nf_log.h>
+#include <net/netfilter/nf_conntrack.h>
 #include "../../netfilter/xt_repldata.h"
 
 MODULE_LICENSE("GPL");
@@ -284,6 +286,106 @@ struct ipt_entry *ipt_next_entry(const struct ipt_entry *entry)
 	return (void *)entry + entry->next_offset;
 }
 
+#ifdef CONFIG_IP_NF_FILTER_FLOWCACHE
+/*
+ * Verdict cache for established connections. A slot of the conntrack
+ * is valid while its generation and table match the current ones; the
+ * generation is bumped on both sides of every table replacement, so a
+ * slot never outlives the entries its rule offset points into.
+ */
+#define IPT_FLOWCACHE_BUSY	(~0U)
+
+static atomic_t ipt_flowcache_gen = ATOMIC_INIT(1);
+
+static void ipt_flowcache_flush(void)
+{
+	unsigned int gen;
+
+	do {
+		gen = atomic_inc_return(&ipt_flowcache_gen);
+	} while (gen == 0 || gen == IPT_FLOWCACHE_BUSY);
+}
+
+/* Matches whose result is the same for every packet of a flow direction */
+static bool ipt_flowcache_match_ok(const struct xt_entry_match *m)
+{
+	const char *name = m->u.kernel.match->name;
+
+	if (strcmp(name, "tcp") == 0) {
+		const struct xt_tcp *tcpinfo = (const void *)m->data;
+
+		return tcpinfo->flg_mask == 0 && tcpinfo->option == 0;
+	}
+	return strcmp(name, "udp") == 0 || strcmp(name, "icmp") == 0 ||
+	       strcmp(name, "state") == 0 || strcmp(name, "multiport") == 0;
+}
+
+static struct nf_conn_flowcache *
+ipt_flowcache_slot(const struct sk_buff *skb)
+{
+	enum ip_conntrack_info ctinfo;
+	struct nf_conn *ct;
+
+	ct = nf_ct_get(skb, &ctinfo);
+	if (ct == NULL || nf_ct_is_untracked(ct))
+		return NULL;
+	if (ctinfo != IP_CT_ESTABLISHED && ctinfo != IP_CT_ESTABLISHED_REPLY)
+		return NULL;
+	return &ct->flowcache[CTINFO2DIR(ctinfo)];
+}
+
+static struct ipt_entry *
+ipt_flowcache_lookup(const struct nf_conn_flowcache *fc, unsigned int hook,
+		     const struct nf_hook_state *state,
+		     const struct xt_table_info *private,
+		     const void *table_base, unsigned int *verdict)
+{
+	unsigned int gen = ACCESS_ONCE(fc->gen);
+	unsigned int rule;
+	bool hit;
+
+	if (gen != atomic_read(&ipt_flowcache_gen))
+		return NULL;
+	smp_rmb();
+	hit = fc->table == private && fc->hook == hook &&
+	      fc->iif == (state->in ? state->in->ifindex : 0) &&
+	      fc->oif == (state->out ? state->out->ifindex : 0);
+	rule = fc->rule;
+	*verdict = fc->verdict;
+	smp_rmb();
+	if (!hit || ACCESS_ONCE(fc->gen) != gen)
+		return NULL;
+	return (struct ipt_entry *)(table_base + rule);
+}
+
+static void
+ipt_flowcache_store(struct nf_conn_flowcache *fc, unsigned int hook,
+		    const struct nf_hook_state *state,
+		    const struct xt_table_info *private, unsigned int gen,
+		    unsigned int rule, unsigned int verdict)
+{
+	unsigned int old = ACCESS_ONCE(fc->gen);
+
+	/* one writer at a time, readers treat a busy slot as a miss */
+	if (old == IPT_FLOWCACHE_BUSY ||
+	    cmpxchg(&fc->gen, old, IPT_FLOWCACHE_BUSY) != old)
+		return;
+	smp_wmb();
+	fc->table = private;
+	fc->hook = hook;
+	fc->iif = state->in ? state->in->ifindex : 0;
+	fc->oif = state->out ? state->out->ifindex : 0;
+	fc->rule = rule;
+	fc->verdict = verdict;
+	smp_wmb();
+	ACCESS_ONCE(fc->gen) = gen;
+}
+#else
+static inline void ipt_flowcache_flush(void)
+{
+}
+#endif
+
 /* Returns one of the generic firewall policies, like NF_ACCEPT. */
 unsigned int
 ipt_do_table(struct sk_buff *skb,
@@ -302,6 +404,11 @@ ipt_do_table(struct sk_buff *skb,
 	const struct xt_table_info *private;
 	struct xt_action_param acpar;
 	unsigned int addend;
+#ifdef CONFIG_IP_NF_FILTER_FLOWCACHE
+	struct nf_conn_flowcache *fc = NULL;
+	unsigned int fc_gen = 0;
+	bool cacheable = false;
+#endif
 
 	/* Initialization */
 	ip = ip_hdr(skb);
@@ -336,6 +443,27 @@ ipt_do_table(struct sk_buff *skb,
 	stackptr   = per_cpu_ptr(private->stackptr, cpu);
 	origptr    = *stackptr;
 
+#ifdef CONFIG_IP_NF_FILTER_FLOWCACHE
+	if (table->flowcache && !acpar.fragoff
+#if IS_ENABLED(CONFIG_NETFILTER_XT_TARGET_TRACE)
+	    && !skb->nf_trace
+#endif
+	    )
+		fc = ipt_flowcache_slot(skb);
+	if (fc) {
+		e = ipt_flowcache_lookup(fc, hook, state, private,
+					 table_base, &verdict);
+		if (e) {
+			ADD_COUNTER(e->counters, skb->len, 1);
+			goto out;
+		}
+		/* read after private, see ipt_flowcache_flush() callers */
+		smp_rmb();
+		fc_gen = atomic_read(&ipt_flowcache_gen);
+		cacheable = true;
+	}
+#endif
+
 	e = get_entry(table_base, private->hook_entry[hook]);
 
 	pr_debug("Entering %s(hook %u); sp at %u (UF %p)\n",
@@ -355,6 +483,10 @@ ipt_do_table(struct sk_buff *skb,
 		}
 
 		xt_ematch_foreach(ematch, e) {
+#ifdef CONFIG_IP_NF_FILTER_FLOWCACHE
+			if (cacheable && !ipt_flowcache_match_ok(ematch))
+				cacheable = false;
+#endif
 			acpar.match     = ematch->u.kernel.match;
 			acpar.matchinfo = ematch->data;
 			if (!acpar.match->match(skb, &acpar))
@@ -411,6 +543,9 @@ ipt_do_table(struct sk_buff *skb,
 			continue;
 		}
 
+#ifdef CONFIG_IP_NF_FILTER_FLOWCACHE
+		cacheable = false;
+#endif
 		acpar.target   = t->u.kernel.target;
 		acpar.targinfo = t->data;
 
@@ -423,6 +558,17 @@ ipt_do_table(struct sk_buff *skb,
 			/* Verdict */
 			break;
 	} while (!acpar.hotdrop);
+
+#ifdef CONFIG_IP_NF_FILTER_FLOWCACHE
+	/* the stack overflow drop is not given by a rule, hence the check */
+	if (cacheable && !acpar.hotdrop &&
+	    (verdict == NF_ACCEPT || verdict == NF_DROP) &&
+	    ((struct xt_standard_target *)ipt_get_target(e))->verdict ==
+	    -(int)verdict - 1)
+		ipt_flowcache_store(fc, hook, state, private, fc_gen,
+				    (void *)e - table_base, verdict);
+ out:
+#endif
 	pr_debug("Exiting %s; resetting sp from %u to %u\n",
 		 __func__, *stackptr, origptr);
 	*stackptr = origptr;
@@ -1205,7 +1351,9 @@ __do_replace(struct net *net, const char *name, unsigned int valid_hooks,
 		goto put_module;
 	}
 
+	ipt_flowcache_flush();
 	oldinfo = xt_replace_table(t, num_counters, newinfo, &ret);
+	ipt_flowcache_flush();
 	if (!oldinfo)
 		goto put_module;
 
@@ -2113,6 +2261,7 @@ void ipt_unregister_table(struct net *net, struct xt_table *table)
 	struct ipt_entry *iter;
 
 	private = xt_unregister_table(table);
+	ipt_flowcache_flush();
 
 	/* Decrease module usage counts and free resources */
 	loc_cpu_entry = private->entries[raw_smp_processor_id()];
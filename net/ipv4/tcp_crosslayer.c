@@ -655,11 +655,32 @@ static int aspen_skb_crosslayer_retransmit(struct sock *sk,
 		return -EINVAL;
 	}
 
+	/* While the socket is paced, only mark the skb lost:
+	 * tcp_xmit_retransmit_queue() sends it when the pacing timer fires.
+	 */
+	if (tcp_pacing_check(sk)) {
+		if (!(tcb->sacked & TCPCB_LOST)) {
+			tp->lost_out += tcp_skb_pcount(skb);
+			tp->lost += tcp_skb_pcount(skb);
+			tcb->sacked |= TCPCB_LOST;
+		}
+		if (!tp->retransmit_skb_hint ||
+		    before(tcb->seq, TCP_SKB_CB(tp->retransmit_skb_hint)->seq))
+			tp->retransmit_skb_hint = skb;
+		if (after(tcb->end_seq, tp->retransmit_high))
+			tp->retransmit_high = tcb->end_seq;
+		ASPEN_DEBUG("Paced dropped skb(%u:%u) length(%u) sk(%p).",
+			    tcb->seq, tcb->end_seq, length, sk);
+		return 0;
+	}
+
 	err = __tcp_retransmit_skb(sk, skb);
 	if (!err) {
 		tp->retrans_out += tcp_skb_pcount(skb);
-		if (!(tcb->sacked & TCPCB_LOST))
+		if (!(tcb->sacked & TCPCB_LOST)) {
 			tp->lost_out += tcp_skb_pcount(skb);
+			tp->lost += tcp_skb_pcount(skb);
+		}
 		tcb->sacked |= (TCPCB_LOST | TCPCB_RETRANS);
 		tcb->ack_seq = tp->snd_nxt;
 		ASPEN_DEBUG("Rexmitted dropped skb(%u:%u) length(%u) sk(%p).",
@@ -770,19 +770,21 @@ static struct nla_policy tcp_metrics_nl_policy[TCP_METRICS_ATTR_MAX + 1] = {
 	[TCP_METRICS_ATTR_ADDR_IPV4]	= { .type = NLA_U32, },
 	[TCP_METRICS_ATTR_ADDR_IPV6]	= { .type = NLA_BINARY,
 					    .len = sizeof(struct in6_addr), },
-	/* Following attributes are not received for GET/DEL,
-	 * we keep them for reference
-	 */
-#if 0
+	[TCP_METRICS_ATTR_SADDR_IPV4]	= { .type = NLA_U32, },
+	[TCP_METRICS_ATTR_SADDR_IPV6]	= { .type = NLA_BINARY,
+					    .len = sizeof(struct in6_addr), },
+	/* Received for SET only */
 	[TCP_METRICS_ATTR_AGE]		= { .type = NLA_MSECS, },
-	[TCP_METRICS_ATTR_TW_TSVAL]	= { .type = NLA_U32, },
-	[TCP_METRICS_ATTR_TW_TS_STAMP]	= { .type = NLA_S32, },
 	[TCP_METRICS_ATTR_VALS]		= { .type = NLA_NESTED, },
 	[TCP_METRICS_ATTR_FOPEN_MSS]	= { .type = NLA_U16, },
-	[TCP_METRICS_ATTR_FOPEN_SYN_DROPS]	= { .type = NLA_U16, },
-	[TCP_METRICS_ATTR_FOPEN_SYN_DROP_TS]	= { .type = NLA_MSECS, },
 	[TCP_METRICS_ATTR_FOPEN_COOKIE]	= { .type = NLA_BINARY,
 					    .len = TCP_FASTOPEN_COOKIE_MAX, },
+	/* Following attributes are not received, we keep them for reference */
+#if 0
+	[TCP_METRICS_ATTR_TW_TSVAL]	= { .type = NLA_U32, },
+	[TCP_METRICS_ATTR_TW_TS_STAMP]	= { .type = NLA_S32, },
+	[TCP_METRICS_ATTR_FOPEN_SYN_DROPS]	= { .type = NLA_U16, },
+	[TCP_METRICS_ATTR_FOPEN_SYN_DROP_TS]	= { .type = NLA_MSECS, },
 #endif
 };
 
@@ -1113,6 +1115,172 @@ static int tcp_metrics_nl_cmd_del(struct sk_buff *skb, struct genl_info *info)
 	return 0;
 }
 
+/* Metrics and Fast Open state of one entry, as given to CMD_SET */
+struct tcpm_restore {
+	unsigned long	age;
+	u32		vals[TCP_METRIC_MAX_KERNEL + 1];
+	u16		fopen_mss;
+	struct tcp_fastopen_cookie cookie;
+};
+
+static int parse_nl_restore(struct genl_info *info, struct tcpm_restore *r)
+{
+	struct nlattr *vals[TCP_METRIC_MAX + 2];
+	struct nlattr *a;
+	int err;
+
+	memset(r, 0, sizeof(*r));
+
+	a = info->attrs[TCP_METRICS_ATTR_AGE];
+	if (a)
+		r->age = min_t(unsigned long, nla_get_msecs(a),
+			       TCP_METRICS_TIMEOUT);
+
+	a = info->attrs[TCP_METRICS_ATTR_VALS];
+	if (a) {
+		err = nla_parse_nested(vals, TCP_METRIC_MAX + 1, a, NULL);
+		if (err < 0)
+			return err;
+
+		/* The kernel keeps RTT and RTTVAR in usec, prefer those */
+		if (vals[TCP_METRIC_RTT_US + 1])
+			r->vals[TCP_METRIC_RTT] =
+				nla_get_u32(vals[TCP_METRIC_RTT_US + 1]);
+		else if (vals[TCP_METRIC_RTT + 1])
+			r->vals[TCP_METRIC_RTT] = USEC_PER_MSEC *
+				nla_get_u32(vals[TCP_METRIC_RTT + 1]);
+		if (vals[TCP_METRIC_RTTVAR_US + 1])
+			r->vals[TCP_METRIC_RTTVAR] =
+				nla_get_u32(vals[TCP_METRIC_RTTVAR_US + 1]);
+		else if (vals[TCP_METRIC_RTTVAR + 1])
+			r->vals[TCP_METRIC_RTTVAR] = USEC_PER_MSEC *
+				nla_get_u32(vals[TCP_METRIC_RTTVAR + 1]);
+		if (vals[TCP_METRIC_SSTHRESH + 1])
+			r->vals[TCP_METRIC_SSTHRESH] =
+				nla_get_u32(vals[TCP_METRIC_SSTHRESH + 1]);
+		if (vals[TCP_METRIC_CWND + 1])
+			r->vals[TCP_METRIC_CWND] =
+				nla_get_u32(vals[TCP_METRIC_CWND + 1]);
+		if (vals[TCP_METRIC_REORDERING + 1])
+			r->vals[TCP_METRIC_REORDERING] =
+				nla_get_u32(vals[TCP_METRIC_REORDERING + 1]);
+	}
+
+	a = info->attrs[TCP_METRICS_ATTR_FOPEN_MSS];
+	if (a)
+		r->fopen_mss = nla_get_u16(a);
+
+	a = info->attrs[TCP_METRICS_ATTR_FOPEN_COOKIE];
+	if (a) {
+		if (nla_len(a) < TCP_FASTOPEN_COOKIE_MIN ||
+		    nla_len(a) > TCP_FASTOPEN_COOKIE_MAX)
+			return -EINVAL;
+		r->cookie.len = nla_len(a);
+		memcpy(r->cookie.val, nla_data(a), r->cookie.len);
+	}
+
+	return 0;
+}
+
+static void tcpm_restore(struct tcp_metrics_block *tm,
+			 const struct tcpm_restore *r)
+{
+	struct tcp_fastopen_metrics *tfom = &tm->tcpm_fastopen;
+	int i;
+
+	tm->tcpm_stamp = jiffies - r->age;
+	for (i = 0; i < TCP_METRIC_MAX_KERNEL + 1; i++) {
+		if (r->vals[i] && !tcp_metric_locked(tm, i))
+			tcp_metric_set(tm, i, r->vals[i]);
+	}
+
+	write_seqlock_bh(&fastopen_seqlock);
+	if (r->fopen_mss)
+		tfom->mss = r->fopen_mss;
+	if (r->cookie.len > 0) {
+		tfom->cookie = r->cookie;
+		tfom->syn_loss = 0;
+	}
+	write_sequnlock_bh(&fastopen_seqlock);
+}
+
+/*
+ * Restore an entry dumped with CMD_GET, e.g. the cache the connectivity
+ * service saved for a network before reboot or before it switched away:
+ * the first connection to each peer then finds its Fast Open cookie and
+ * its RTT estimates. Existing entries are updated, missing ones created.
+ * Fast Open SYN drop history and timewait timestamps are not restored.
+ */
+static int tcp_metrics_nl_cmd_set(struct sk_buff *skb, struct genl_info *info)
+{
+	struct tcp_metrics_block *tm;
+	struct inetpeer_addr saddr, daddr;
+	struct net *net = genl_info_net(info);
+	struct tcpm_restore r;
+	unsigned int hash;
+	bool reclaim = false;
+	int ret;
+
+	ret = parse_nl_addr(info, &daddr, &hash, 0);
+	if (ret < 0)
+		return ret;
+	ret = parse_nl_saddr(info, &saddr);
+	if (ret < 0)
+		return ret;
+	if (saddr.family != daddr.family)
+		return -EINVAL;
+	ret = parse_nl_restore(info, &r);
+	if (ret < 0)
+		return ret;
+
+	hash ^= net_hash_mix(net);
+	hash = hash_32(hash, tcp_metrics_hash_log);
+
+	spin_lock_bh(&tcp_metrics_lock);
+	tm = __tcp_get_metrics(&saddr, &daddr, net, hash);
+	if (tm == TCP_METRICS_RECLAIM_PTR) {
+		reclaim = true;
+		tm = NULL;
+	}
+	if (!tm) {
+		if (unlikely(reclaim)) {
+			struct tcp_metrics_block *oldest;
+
+			oldest = deref_locked(tcp_metrics_hash[hash].chain);
+			for (tm = deref_locked(oldest->tcpm_next); tm;
+			     tm = deref_locked(tm->tcpm_next)) {
+				if (time_before(tm->tcpm_stamp,
+						oldest->tcpm_stamp))
+					oldest = tm;
+			}
+			tm = oldest;
+		} else {
+			tm = kmalloc(sizeof(*tm), GFP_ATOMIC);
+			if (!tm) {
+				spin_unlock_bh(&tcp_metrics_lock);
+				return -ENOMEM;
+			}
+		}
+		write_pnet(&tm->tcpm_net, net);
+		tm->tcpm_saddr = saddr;
+		tm->tcpm_daddr = daddr;
+		tm->tcpm_lock = 0;
+		tm->tcpm_ts = 0;
+		tm->tcpm_ts_stamp = 0;
+		memset(tm->tcpm_vals, 0, sizeof(tm->tcpm_vals));
+		memset(&tm->tcpm_fastopen, 0, sizeof(tm->tcpm_fastopen));
+
+		if (likely(!reclaim)) {
+			tm->tcpm_next = tcp_metrics_hash[hash].chain;
+			rcu_assign_pointer(tcp_metrics_hash[hash].chain, tm);
+		}
+	}
+	tcpm_restore(tm, &r);
+	spin_unlock_bh(&tcp_metrics_lock);
+
+	return 0;
+}
+
 static const struct genl_ops tcp_metrics_nl_ops[] = {
 	{
 		.cmd = TCP_METRICS_CMD_GET,
@@ -1126,6 +1294,12 @@ static const struct genl_ops tcp_metrics_nl_ops[] = {
 		.policy = tcp_metrics_nl_policy,
 		.flags = GENL_ADMIN_PERM,
 	},
+	{
+		.cmd = TCP_METRICS_CMD_SET,
+		.doit = tcp_metrics_nl_cmd_set,
+		.policy = tcp_metrics_nl_policy,
+		.flags = GENL_ADMIN_PERM,
+	},
 };
 
 static unsigned int tcpmhash_entries;
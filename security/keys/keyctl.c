@@ -23,6 +23,7 @@
 #include <linux/vmalloc.h>
 #include <linux/security.h>
 #include <linux/uio.h>
+#include <keys/user-type.h>
 #include <asm/uaccess.h>
 #include "internal.h"
 
@@ -537,6 +538,8 @@ long keyctl_keyring_unlink(key_serial_t id, key_serial_t ringid)
 	}
 
 	ret = key_unlink(key_ref_to_ptr(keyring_ref), key_ref_to_ptr(key_ref));
+	if (ret == 0)
+		logon_key_unlinked(key_ref_to_ptr(key_ref));
 
 	key_ref_put(key_ref);
 error2:
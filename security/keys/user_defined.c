@@ -14,6 +14,7 @@
 #include <linux/slab.h>
 #include <linux/seq_file.h>
 #include <linux/err.h>
+#include <linux/notifier.h>
 #include <keys/user-type.h>
 #include <asm/uaccess.h>
 #include "internal.h"
@@ -57,6 +58,47 @@ struct key_type key_type_logon = {
 };
 EXPORT_SYMBOL_GPL(key_type_logon);
 
+/*
+ * Users of logon key payloads (fscrypt caches keys derived from them) are
+ * told when a payload is replaced, revoked, unlinked or destroyed. The
+ * notifier data is the payload going away.
+ */
+static BLOCKING_NOTIFIER_HEAD(logon_key_notifier);
+
+int register_logon_key_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_register(&logon_key_notifier, nb);
+}
+EXPORT_SYMBOL_GPL(register_logon_key_notifier);
+
+int unregister_logon_key_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_unregister(&logon_key_notifier, nb);
+}
+EXPORT_SYMBOL_GPL(unregister_logon_key_notifier);
+
+static void logon_key_notify(struct key *key,
+			     struct user_key_payload *upayload)
+{
+	if (key->type == &key_type_logon && upayload)
+		blocking_notifier_call_chain(&logon_key_notifier, 0, upayload);
+}
+
+/*
+ * a logon key was unlinked from a keyring
+ * - the key's semaphore must not be held
+ */
+void logon_key_unlinked(struct key *key)
+{
+	if (key->type != &key_type_logon)
+		return;
+
+	down_read(&key->sem);
+	if (key_is_instantiated(key))
+		logon_key_notify(key, rcu_dereference_key(key));
+	up_read(&key->sem);
+}
+
 /*
  * Preparse a user defined key payload
  */
@@ -124,6 +166,7 @@ int user_update(struct key *key, struct key_preparsed_payload *prep)
 			zap = key->payload.data;
 		else
 			zap = NULL;
+		logon_key_notify(key, zap);
 		rcu_assign_keypointer(key, upayload);
 		key->expiry = 0;
 	}
@@ -149,6 +192,7 @@ void user_revoke(struct key *key)
 	key_payload_reserve(key, 0);
 
 	if (upayload) {
+		logon_key_notify(key, upayload);
 		rcu_assign_keypointer(key, NULL);
 		kfree_rcu(upayload, rcu);
 	}
@@ -163,6 +207,8 @@ void user_destroy(struct key *key)
 {
 	struct user_key_payload *upayload = key->payload.data;
 
+	if (!test_bit(KEY_FLAG_NEGATIVE, &key->flags))
+		logon_key_notify(key, upayload);
 	kfree(upayload);
 }
 
@@ -46,6 +46,8 @@
 #define PCM_PORTS_MAX           (4) /* max ports num for all stream type - same as soc hifi */
 #define PCM_PORTS_NUM           (2) /* actual ports num supported by asp dma driver */
 #define DMA_CHANNEL_MAX         (16)
+/* largest a_count of one lli node, longer periods are split over several */
+#define DMA_NODE_MAX_BYTES      (16 * 1024)
 #define CODEC_NAME_HI6402       "hi6402-codec"
 #define CODEC_NAME_HI6403ES     "hi6403es-codec"
 #define CODEC_NAME_HI6403       "hi6403-codec"
@@ -182,7 +184,8 @@ struct hi3xxx_asp_dmac_runtime_data {
 	unsigned int dma_addr;
 	unsigned int period_size;
 	unsigned int period_cur;
-	unsigned int dma_buf_next[PCM_PORTS_NUM];
+	unsigned int lli_num;		/* lli nodes per port, a whole buffer */
+	unsigned int nodes_per_period;	/* > 1 for deep buffer streams */
 	unsigned int irq_cnt;
 	unsigned long preIrqTimeNs;
 	unsigned long prePeriodTimeNs;
@@ -211,33 +214,44 @@ static const struct snd_pcm_hardware hi3xxx_asp_dmac_hardware = {
 				  SNDRV_PCM_FMTBIT_S24_LE |
 				  SNDRV_PCM_FMTBIT_S24_BE,
 	.period_bytes_min	= 32,
-	.period_bytes_max	= 16 * 1024,
+	.period_bytes_max	= 64 * 1024,
 	.periods_min		= 2,
 	.periods_max		= 32,
-	.buffer_bytes_max	= 128 * 1024,
+	.buffer_bytes_max	= 512 * 1024,
 };
 
 /*
 *dma operations
 */
 
-/*dma config lli node*/
+/*
+ * dma config lli node
+ *
+ * Each period is split in ports_cnt chunks of dma_size, one per port, and
+ * the chunk of a port is covered by nodes_per_period nodes. Only the last
+ * node of a period raises an interrupt, so a deep buffer stream with large
+ * periods wakes the AP once per period whatever the node size limit.
+ */
 static void asp_dma_set_lli_node(struct snd_pcm_substream *substream, unsigned int port_index, unsigned int lli_index)
 {
 	struct hi3xxx_asp_dmac_runtime_data *prtd = substream->runtime->private_data;
+	struct dma_lli_cfg *node = &prtd->pdma_lli_cfg[port_index][lli_index];
 	unsigned int ports_cnt = prtd->ports.ports_cnt;
 	unsigned int dma_size = prtd->period_size/ports_cnt;
-	unsigned int dma_buf_num = substream->runtime->periods * ports_cnt;
+	unsigned int period = lli_index / prtd->nodes_per_period;
+	unsigned int part = lli_index % prtd->nodes_per_period;
+	unsigned int offset = part * DMA_NODE_MAX_BYTES;
+	unsigned int addr = prtd->dma_addr + (period * ports_cnt + port_index) * dma_size + offset;
 
-	pr_debug("[%s:%d] set dma buf[%d/%d] dma_size: %d\n", __FUNCTION__, __LINE__, prtd->dma_buf_next[port_index], dma_buf_num, dma_size);
+	node->a_count = min_t(unsigned int, dma_size - offset, DMA_NODE_MAX_BYTES);
+	if (part != prtd->nodes_per_period - 1)
+		node->config &= ~CONFIG_ITC_EN;
 
 	if (SNDRV_PCM_STREAM_PLAYBACK == substream->stream) {
-		prtd->pdma_lli_cfg[port_index][lli_index].src_addr = prtd->dma_addr + prtd->dma_buf_next[port_index] * dma_size;
+		node->src_addr = addr;
 	} else {
-		prtd->pdma_lli_cfg[port_index][lli_index].des_addr = prtd->dma_addr + prtd->dma_buf_next[port_index] * dma_size;
+		node->des_addr = addr;
 	}
-
-	prtd->dma_buf_next[port_index] = (prtd->dma_buf_next[port_index] + ports_cnt) % dma_buf_num;
 }
 
 static void asp_dma_lli_cfg(struct snd_pcm_substream *substream, unsigned int port_index)
@@ -246,11 +260,9 @@ static void asp_dma_lli_cfg(struct snd_pcm_substream *substream, unsigned int po
 	unsigned int lli_index;
 	unsigned int next_addr 		 = 0x0;
 	unsigned int config			 = 0x0;
-	unsigned int dma_lli_num 	 = DMA_LLI_NUM;
+	unsigned int dma_lli_num 	 = prtd->lli_num;
 	unsigned int tx_dma_addr = 0X0;
 	unsigned int rx_dma_addr = 0X0;
-	unsigned int ports_cnt = prtd->ports.ports_cnt;
-	unsigned int dma_size = prtd->period_size/ports_cnt;
 
 	config = prtd->dma_cfg[port_index].config;
 	if (SNDRV_PCM_STREAM_PLAYBACK == substream->stream) {
@@ -266,8 +278,7 @@ static void asp_dma_lli_cfg(struct snd_pcm_substream *substream, unsigned int po
 		prtd->pdma_lli_cfg[port_index][lli_index].config 	= config;
 		prtd->pdma_lli_cfg[port_index][lli_index].des_addr 	= tx_dma_addr;
 		prtd->pdma_lli_cfg[port_index][lli_index].src_addr 	= rx_dma_addr;
-		prtd->pdma_lli_cfg[port_index][lli_index].a_count 	= dma_size;
-		/* reset the src or dest addr of one dma list */
+		/* set the src or dest addr, count and irq of one dma list */
 		asp_dma_set_lli_node(substream, port_index, lli_index);
 	}
 
@@ -335,6 +346,7 @@ static int hi3xxx_asp_dmac_hw_params(struct snd_pcm_substream *substream,
 	unsigned int channels = params_channels(params);
 	unsigned int ports_cnt = prtd->ports.ports_cnt;
 	unsigned int port_index;
+	unsigned int nodes_per_period;
 	int ret = 0;
 
 	if (channels > 2) {
@@ -351,9 +363,13 @@ static int hi3xxx_asp_dmac_hw_params(struct snd_pcm_substream *substream,
 
 	mutex_lock(&prtd->mutex);
 
+	nodes_per_period = DIV_ROUND_UP(params_period_bytes(params) / ports_cnt, DMA_NODE_MAX_BYTES);
+	prtd->nodes_per_period = nodes_per_period;
+	prtd->lli_num = params_periods(params) * nodes_per_period;
+
 	for (port_index = 0; port_index < ports_cnt; port_index++) {
 		prtd->pdma_lli_cfg[port_index] = (struct dma_lli_cfg *)dma_alloc_coherent(prtd->pdata->dev,
-			DMA_LLI_NUM * sizeof(struct dma_lli_cfg), (dma_addr_t *)&lli_dma_addr, GFP_KERNEL);
+			prtd->lli_num * sizeof(struct dma_lli_cfg), (dma_addr_t *)&lli_dma_addr, GFP_KERNEL);
 
 		if (NULL == prtd->pdma_lli_cfg[port_index]) {
 			pr_err("[%s:%d] prtd->pdma_lli_cfg dma alloc coherent error!", __FUNCTION__, __LINE__);
@@ -366,7 +382,7 @@ static int hi3xxx_asp_dmac_hw_params(struct snd_pcm_substream *substream,
 	prtd->period_size = params_period_bytes(params);
 	prtd->sampleRate = params_rate(params);
 
-	pr_info("[%s:%d] dma buffer bytes: %lu(size: %lu), prtd->period_size: %u, sampleRate: %u\n", __FUNCTION__, __LINE__, bytes, buffer_size, prtd->period_size, prtd->sampleRate);
+	pr_info("[%s:%d] dma buffer bytes: %lu(size: %lu), prtd->period_size: %u, sampleRate: %u, nodes_per_period: %u\n", __FUNCTION__, __LINE__, bytes, buffer_size, prtd->period_size, prtd->sampleRate, nodes_per_period);
 
 	mutex_unlock(&prtd->mutex);
 	return ret;
@@ -375,7 +391,7 @@ err_out:
 	pr_err("[%s:%d] hw params error, ret : %d\n", __FUNCTION__, __LINE__, ret);
 	for (port_index = 0; port_index < ports_cnt; port_index++) {
 		if (prtd->pdma_lli_cfg[port_index]) {
-			dma_free_coherent(prtd->pdata->dev, DMA_LLI_NUM * sizeof(struct dma_lli_cfg),
+			dma_free_coherent(prtd->pdata->dev, prtd->lli_num * sizeof(struct dma_lli_cfg),
 					(void*)prtd->pdma_lli_cfg[port_index], prtd->lli_dma_addr[port_index]);
 			prtd->pdma_lli_cfg[port_index] = NULL;
 		}
@@ -398,7 +414,7 @@ static int hi3xxx_asp_dmac_hw_free(struct snd_pcm_substream *substream)
 
 	for (port_index = 0; port_index < ports_cnt; port_index++) {
 		if (prtd->pdma_lli_cfg[port_index]) {
-			dma_free_coherent(prtd->pdata->dev, DMA_LLI_NUM * sizeof(struct dma_lli_cfg),
+			dma_free_coherent(prtd->pdata->dev, prtd->lli_num * sizeof(struct dma_lli_cfg),
 					(void*)prtd->pdma_lli_cfg[port_index], prtd->lli_dma_addr[port_index]);
 			prtd->pdma_lli_cfg[port_index] = NULL;
 		}
@@ -571,9 +587,6 @@ static int hi3xxx_asp_dmac_prepare(struct snd_pcm_substream *substream)
 	mutex_lock(&prtd->mutex);
 
 	prtd->status = STATUS_DMAC_STOP;
-	for (port_index = 0; port_index < ports_cnt; port_index++) {
-		prtd->dma_buf_next[port_index] = port_index;
-	}
 	prtd->period_cur = 0;
 	prtd->dma_addr = runtime->dma_addr;
 
@@ -619,7 +632,7 @@ static int hi3xxx_asp_dmac_trigger(struct snd_pcm_substream *substream, int cmd)
 	case SNDRV_PCM_TRIGGER_SUSPEND:
 	case SNDRV_PCM_TRIGGER_PAUSE_PUSH:
 		for (port_index = 0; port_index < ports_cnt; port_index++) {
-			for (lli_index = 0; lli_index < DMA_LLI_NUM; lli_index++) {
+			for (lli_index = 0; lli_index < prtd->lli_num; lli_index++) {
 				prtd->pdma_lli_cfg[port_index][lli_index].lli = 0x0;
 			}
 			asp_dma_stop(prtd->dma_cfg[port_index].channel);
@@ -797,6 +810,17 @@ static int hi3xxx_asp_dmac_open(struct snd_pcm_substream *substream)
 	spin_unlock(&prtd->lock);
 
 	ret = snd_soc_set_runtime_hwparams(substream, &hi3xxx_asp_dmac_hardware);
+	if (ret < 0)
+		return ret;
+
+	/*
+	 * The low latency path keeps one node per period and so one interrupt
+	 * per period, handled right from the asp dma irq. Any other stream may
+	 * take large periods and run as a deep buffer.
+	 */
+	if (pcm->device == PCM_DEVICE_LOW_LATENCY)
+		ret = snd_pcm_hw_constraint_minmax(substream->runtime, SNDRV_PCM_HW_PARAM_PERIOD_BYTES,
+				hi3xxx_asp_dmac_hardware.period_bytes_min, DMA_NODE_MAX_BYTES);
 
 	return ret;
 